@@ -4,11 +4,13 @@
 //
 // This file is part of Nitro Engine Advanced
 //
-// ARM7 main: libnds services + Maxmod audio + NEA rigid body physics.
+// ARM7 main: libnds services + Maxmod audio + NEA rigid body physics + pose
+// service.
 
 #include <nds.h>
 #include <maxmod7.h>
 #include "nea_rb7.h"
+#include "nea_pose7.h"
 
 volatile bool exit_loop = false;
 
@@ -20,6 +22,7 @@ void power_button_callback(void)
 void vblank_handler(void)
 {
     inputGetAndSend();
+    nea_pose7_vblank();
 }
 
 int main(int argc, char *argv[])
@@ -55,11 +58,11 @@ int main(int argc, char *argv[])
         // Process ARM9 commands
         nea_rb7_listen();
 
-        // Run physics sub-steps
+        // Run physics sub-steps. The number of sub-steps depends on how
+        // fast the bodies move and on the budget set by the ARM9.
         if (nea_rb7_running)
         {
-            for (int i = 0; i < NEA_RB7_SUBSTEPS; i++)
-                nea_rb7_update();
+            nea_rb7_step();
 
             // Sleep check once per frame (not per sub-step)
             nea_rb7_sleep_check_all();
@@ -73,7 +76,9 @@ int main(int argc, char *argv[])
         if ((keys_pressed & key_mask) == key_mask)
             exit_loop = true;
 
-        swiWaitForVBlank();
+        // Interpolate the skeletal poses requested by the ARM9 until the
+        // next frame starts.
+        nea_pose7_wait_vblank();
     }
 
     return 0;
@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+/// @file   nea_pose7.c
+/// @brief  ARM7 interpolation of the joints of DSA animations.
+
+#include "nea_pose7.h"
+
+// =========================================================================
+// DSA file format
+// =========================================================================
+//
+// Same layout as the structs of source/dsma/dsma.c, which the ARM7 can't
+// include.
+
+#define NEA_POSE7_DSA_VERSION_NUMBER  1
+#define NEA_POSE7_DSA_VERSION_REDUCED 2
+
+#define NEA_POSE7_JOINT_POS_ANIMATED    (1 << 0)
+#define NEA_POSE7_JOINT_ORIENT_ANIMATED (1 << 1)
+
+typedef struct {
+    int32_t pos[3];
+    int32_t orient[4];
+} nea_pose7_dsa_joint_t;
+
+typedef struct {
+    uint32_t version;
+    uint32_t num_frames;
+    uint32_t num_joints;
+    nea_pose7_dsa_joint_t joints[0];
+} nea_pose7_dsa_t;
+
+typedef struct {
+    int32_t pos[3];
+    int16_t orient[4];
+    uint16_t flags;
+    uint16_t offset;
+} nea_pose7_dsa2_joint_t;
+
+typedef struct {
+    uint32_t version;
+    uint32_t num_frames;
+    uint32_t num_joints;
+    uint32_t num_keys;
+    uint32_t key_size;
+    uint16_t key_frame[0];
+} nea_pose7_dsa2_t;
+
+// =========================================================================
+// State
+// =========================================================================
+
+// Shared block owned by the ARM9, NULL until it sends its address
+static NEA_POSE_SharedState *nea_pose7_shared;
+static u32 nea_pose7_head; // Last write position sent by the ARM9
+static u32 nea_pose7_tail;
+
+static volatile u32 nea_pose7_vblanks;
+
+void nea_pose7_vblank(void)
+{
+    nea_pose7_vblanks++;
+}
+
+// =========================================================================
+// Interpolation
+// =========================================================================
+
+static inline int32_t nea_pose7_lerp(int32_t start, int32_t end, int32_t pos)
+{
+    return start + (((end - start) * pos) >> 12);
+}
+
+// Version 1: every frame has all the joints
+ARM_CODE static bool nea_pose7_sample_v1(const nea_pose7_dsa_t *dsa,
+                                         uint32_t frame, uint32_t interp,
+                                         NEA_POSE_Request *req)
+{
+    uint32_t num_joints = dsa->num_joints;
+
+    uint32_t next_frame = frame + 1;
+    if (next_frame == dsa->num_frames)
+        next_frame = 0;
+
+    const nea_pose7_dsa_joint_t *j1 = &dsa->joints[frame * num_joints];
+    const nea_pose7_dsa_joint_t *j2 = &dsa->joints[next_frame * num_joints];
+
+    for (uint32_t i = 0; i < num_joints; i++)
+    {
+        for (int k = 0; k < 3; k++)
+            req->pos[i][k] = nea_pose7_lerp(j1[i].pos[k], j2[i].pos[k], interp);
+        for (int k = 0; k < 4; k++)
+        {
+            req->orient[i][k] = nea_pose7_lerp(j1[i].orient[k],
+                                               j2[i].orient[k], interp);
+        }
+    }
+
+    return true;
+}
+
+// Version 2: only keys are stored, and joints can be constant
+ARM_CODE static bool nea_pose7_sample_v2(const nea_pose7_dsa2_t *dsa2,
+                                         uint32_t frame, uint32_t interp,
+                                         NEA_POSE_Request *req)
+{
+    uint32_t num_keys = dsa2->num_keys;
+    uint32_t num_joints = dsa2->num_joints;
+    const uint16_t *key_frame = dsa2->key_frame;
+
+    if (num_keys == 0)
+        return false;
+
+    const nea_pose7_dsa2_joint_t *joints =
+            (const nea_pose7_dsa2_joint_t *)&key_frame[(num_keys + 1) & ~1];
+    const uint8_t *keys = (const uint8_t *)&joints[num_joints];
+
+    // Last key that isn't after the frame
+    uint32_t lo = 0;
+    uint32_t hi = num_keys;
+    while ((hi - lo) > 1)
+    {
+        uint32_t mid = (lo + hi) >> 1;
+        if (key_frame[mid] <= frame)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    uint32_t next_key = lo + 1;
+    uint32_t end_frame;
+    if (next_key == num_keys)
+    {
+        next_key = 0;
+        end_frame = dsa2->num_frames;
+    }
+    else
+    {
+        end_frame = key_frame[next_key];
+    }
+
+    uint32_t start_frame = key_frame[lo];
+    uint32_t len = end_frame - start_frame;
+    if (len > 1)
+        interp = (((frame - start_frame) << 12) + interp) / len;
+
+    const uint8_t *key_1 = keys + lo * dsa2->key_size;
+    const uint8_t *key_2 = keys + next_key * dsa2->key_size;
+
+    for (uint32_t i = 0; i < num_joints; i++)
+    {
+        const nea_pose7_dsa2_joint_t *joint = &joints[i];
+        uint32_t offset = joint->offset;
+
+        if (joint->flags & NEA_POSE7_JOINT_POS_ANIMATED)
+        {
+            const int32_t *p1 = (const int32_t *)(key_1 + offset);
+            const int32_t *p2 = (const int32_t *)(key_2 + offset);
+            for (int k = 0; k < 3; k++)
+                req->pos[i][k] = nea_pose7_lerp(p1[k], p2[k], interp);
+            offset += 3 * sizeof(int32_t);
+        }
+        else
+        {
+            for (int k = 0; k < 3; k++)
+                req->pos[i][k] = joint->pos[k];
+        }
+
+        if (joint->flags & NEA_POSE7_JOINT_ORIENT_ANIMATED)
+        {
+            const int16_t *o1 = (const int16_t *)(key_1 + offset);
+            const int16_t *o2 = (const int16_t *)(key_2 + offset);
+            for (int k = 0; k < 4; k++)
+                req->orient[i][k] = nea_pose7_lerp(o1[k], o2[k], interp);
+        }
+        else
+        {
+            for (int k = 0; k < 4; k++)
+                req->orient[i][k] = joint->orient[k];
+        }
+    }
+
+    return true;
+}
+
+// Fills the joints of a request. Returns false if it can't be done.
+ARM_CODE static bool nea_pose7_sample(NEA_POSE_Request *req)
+{
+    const nea_pose7_dsa_t *dsa =
+            (const nea_pose7_dsa_t *)(uintptr_t)req->dsa_file;
+    if (dsa == NULL)
+        return false;
+
+    uint32_t num_joints = dsa->num_joints;
+    if (num_joints > NEA_POSE_MAX_JOINTS)
+        return false;
+
+    uint32_t frame = req->frame_interp >> 12;
+    uint32_t interp = req->frame_interp & 0xFFF;
+
+    if (frame >= dsa->num_frames)
+        return false;
+
+    req->num_joints = num_joints;
+
+    if (dsa->version == NEA_POSE7_DSA_VERSION_NUMBER)
+        return nea_pose7_sample_v1(dsa, frame, interp, req);
+
+    if (dsa->version == NEA_POSE7_DSA_VERSION_REDUCED)
+    {
+        return nea_pose7_sample_v2((const nea_pose7_dsa2_t *)dsa, frame,
+                                   interp, req);
+    }
+
+    return false;
+}
+
+// =========================================================================
+// Command listener (ARM9 -> ARM7)
+// =========================================================================
+
+static void nea_pose7_listen(void)
+{
+    while (fifoCheckValue32(NEA_POSE_FIFO_CMD))
+    {
+        u32 signal = fifoGetValue32(NEA_POSE_FIFO_CMD);
+        u32 param = NEA_POSE_DECODE_PARAM(signal);
+
+        switch (NEA_POSE_DECODE_CMD(signal))
+        {
+        case NEA_POSE_CMD_SET_BUFFER:
+        {
+            while (!fifoCheckValue32(NEA_POSE_FIFO_CMD))
+                ;
+            u32 addr = fifoGetValue32(NEA_POSE_FIFO_CMD);
+
+            nea_pose7_shared = (NEA_POSE_SharedState *)(uintptr_t)addr;
+            if (nea_pose7_shared != NULL)
+            {
+                nea_pose7_tail = nea_pose7_shared->tail;
+                nea_pose7_head = nea_pose7_tail;
+            }
+            break;
+        }
+
+        case NEA_POSE_CMD_KICK:
+            nea_pose7_head = param & (NEA_POSE_MAX_REQUESTS - 1);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+// Handles the oldest request. Returns false if there are no requests.
+static bool nea_pose7_run_one(void)
+{
+    if ((nea_pose7_shared == NULL) || (nea_pose7_tail == nea_pose7_head))
+        return false;
+
+    NEA_POSE_Request *req = &nea_pose7_shared->requests[nea_pose7_tail];
+
+    if (req->status == NEA_POSE_STATUS_PENDING)
+    {
+        if (nea_pose7_sample(req))
+        {
+            req->status = NEA_POSE_STATUS_DONE;
+            nea_pose7_shared->served++;
+        }
+        else
+        {
+            req->status = NEA_POSE_STATUS_FAILED;
+        }
+    }
+
+    // Let the ARM9 reuse the entry
+    nea_pose7_tail = (nea_pose7_tail + 1) & (NEA_POSE_MAX_REQUESTS - 1);
+    nea_pose7_shared->tail = nea_pose7_tail;
+
+    return true;
+}
+
+void nea_pose7_wait_vblank(void)
+{
+    u32 vblanks = nea_pose7_vblanks;
+
+    while (nea_pose7_vblanks == vblanks)
+    {
+        nea_pose7_listen();
+
+        if (nea_pose7_run_one())
+            continue;
+
+        // Sleep until the ARM9 sends something or the VBlank starts. If any of
+        // them has happened since the last call this returns right away.
+        swiIntrWait(0, IRQ_VBLANK | IRQ_FIFO_NOT_EMPTY);
+    }
+}
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_POSE7_H__
+#define NEA_POSE7_H__
+
+/// @file   nea_pose7.h
+/// @brief  ARM7-side skeletal pose interpolation service.
+
+#include <nds.h>
+#include "NEA_POSE_IPC.h"
+
+// Counts VBlanks. Call it from the VBlank interrupt handler.
+void nea_pose7_vblank(void);
+
+// Reads the commands of the ARM9 and interpolates the poses it has requested
+// until the next VBlank. Use it instead of swiWaitForVBlank() at the end of
+// the main loop.
+void nea_pose7_wait_vblank(void);
+
+#endif // NEA_POSE7_H__
@@ -21,6 +21,184 @@ bool              nea_rb7_running = false;
 
 int nea_rb7_num_contacts = 0;
 
+// Frame budget set by the ARM9 and cost of the last frame
+uint32_t     nea_rb7_step_budget = 0;
+NEA_RB_Stats nea_rb7_stats;
+
+// Bodies in use, sorted by ID, so that loops don't check every slot
+uint8_t nea_rb7_active[NEA_RB_MAX_BODIES];
+int     nea_rb7_num_active = 0;
+
+// =========================================================================
+// Broadphase state
+// =========================================================================
+//
+// Sort and sweep on the X axis. Bodies and statics share one list, sorted by
+// the minimum X of their bounding boxes. It is sorted again with an insertion
+// sort every sub-step, which is fast because bodies barely move between
+// sub-steps and statics never move. The sweep marks the pairs whose boxes
+// overlap in bitmasks, which are read in ID order so that contacts are
+// generated in the same order as when testing all pairs.
+
+typedef struct {
+    nea_vec3_t min, max;
+} nea_rb7_box_t;
+
+// Entries of the list: bodies are 0 to NEA_RB_MAX_BODIES - 1, statics are
+// NEA_RB_MAX_BODIES + their ID.
+#define NEA_RB7_SAP_MAX         (NEA_RB_MAX_BODIES + NEA_RB_MAX_STATICS)
+#define NEA_RB7_BODY_WORDS      ((NEA_RB_MAX_BODIES + 31) / 32)
+#define NEA_RB7_STATIC_WORDS    ((NEA_RB_MAX_STATICS + 31) / 32)
+
+// Limit used for box sides that don't exist (statics are half-spaces along
+// their normal). It leaves room for margins without overflowing.
+#define NEA_RB7_BOX_INFINITE    (1 << 30)
+
+static nea_rb7_box_t nea_rb7_body_boxes[NEA_RB_MAX_BODIES];
+static nea_rb7_box_t nea_rb7_static_boxes[NEA_RB_MAX_STATICS];
+static uint8_t nea_rb7_sap[NEA_RB7_SAP_MAX];
+static int nea_rb7_sap_count;
+static bool nea_rb7_sap_dirty = true;
+
+// Candidate pairs of each awake body: bodies with a higher ID (or sleeping
+// bodies with a lower ID), and statics
+static uint32_t nea_rb7_pair_bodies[NEA_RB_MAX_BODIES][NEA_RB7_BODY_WORDS];
+static uint32_t nea_rb7_pair_statics[NEA_RB_MAX_BODIES][NEA_RB7_STATIC_WORDS];
+
+// =========================================================================
+// Mesh collider state
+// =========================================================================
+//
+// The triangles and BVH of a NEA_ColMesh, read straight from main RAM. The
+// ARM9 keeps them alive while they are used.
+
+static const NEA_RB_MeshTriangle *nea_rb7_mesh_tris;
+static const NEA_RB_MeshNode *nea_rb7_mesh_nodes;
+static int nea_rb7_mesh_num_tris;
+static int nea_rb7_mesh_num_nodes;
+static nea_vec3_t nea_rb7_mesh_pos;
+
+// =========================================================================
+// Contact cache
+// =========================================================================
+//
+// Accumulated impulses of the contacts of the previous sub-step, found by the
+// key of the contact with a small open addressing hash table. The solver starts
+// from them (warm starting), so resting contacts need few iterations.
+
+#define NEA_RB7_CACHE_BITS      8
+#define NEA_RB7_CACHE_SIZE      (1 << NEA_RB7_CACHE_BITS)
+#define NEA_RB7_CACHE_EMPTY     0xFF
+
+#if NEA_RB_MAX_CONTACTS >= NEA_RB7_CACHE_EMPTY || \
+    NEA_RB_MAX_CONTACTS > (NEA_RB7_CACHE_SIZE * 3) / 4
+#error "The contact cache is too small for NEA_RB_MAX_CONTACTS"
+#endif
+
+typedef struct {
+    uint32_t key;
+    int32_t normalImpulse;
+    int32_t tangentImpulse[2];
+} nea_rb7_cached_t;
+
+static nea_rb7_cached_t nea_rb7_cache[NEA_RB_MAX_CONTACTS];
+static uint8_t nea_rb7_cache_table[NEA_RB7_CACHE_SIZE];
+static int32_t nea_rb7_cache_dt; // Sub-step of the cached impulses, 0 if empty
+
+static inline uint32_t nea_rb7_cache_hash(uint32_t key)
+{
+    return (key * 2654435761u) >> (32 - NEA_RB7_CACHE_BITS);
+}
+
+static void nea_rb7_cache_clear(void)
+{
+    for (int i = 0; i < NEA_RB7_CACHE_SIZE; i++)
+        nea_rb7_cache_table[i] = NEA_RB7_CACHE_EMPTY;
+    nea_rb7_cache_dt = 0;
+}
+
+static const nea_rb7_cached_t *nea_rb7_cache_find(uint32_t key)
+{
+    if (nea_rb7_cache_dt == 0)
+        return NULL;
+
+    uint32_t h = nea_rb7_cache_hash(key);
+
+    while (nea_rb7_cache_table[h] != NEA_RB7_CACHE_EMPTY)
+    {
+        const nea_rb7_cached_t *c = &nea_rb7_cache[nea_rb7_cache_table[h]];
+        if (c->key == key)
+            return c;
+        h = (h + 1) & (NEA_RB7_CACHE_SIZE - 1);
+    }
+
+    return NULL;
+}
+
+// Saves the impulses of the contacts of this sub-step
+static void nea_rb7_cache_store(int32_t dt)
+{
+    nea_rb7_cache_clear();
+
+    int count = 0;
+
+    for (int c = 0; c < nea_rb7_num_contacts; c++)
+    {
+        const nea_rb7_contact_t *cp = &nea_rb7_contacts[c];
+
+        // Injected contacts don't persist
+        if ((cp->key >> 30) == NEA_RB7_KEY_EXTERNAL)
+            continue;
+
+        nea_rb7_cached_t *e = &nea_rb7_cache[count];
+        e->key = cp->key;
+        e->normalImpulse = cp->normalImpulse;
+        e->tangentImpulse[0] = cp->tangentImpulse[0];
+        e->tangentImpulse[1] = cp->tangentImpulse[1];
+
+        uint32_t h = nea_rb7_cache_hash(cp->key);
+        while (nea_rb7_cache_table[h] != NEA_RB7_CACHE_EMPTY)
+            h = (h + 1) & (NEA_RB7_CACHE_SIZE - 1);
+        nea_rb7_cache_table[h] = (uint8_t)count;
+
+        count++;
+    }
+
+    nea_rb7_cache_dt = dt;
+}
+
+// Bounding box of the region where a vertex generates a contact with a
+// static: inside its rectangle, and behind its plane (plus the threshold).
+static void nea_rb7_static_box(const nea_rb7_aar_t *aar, nea_rb7_box_t *box)
+{
+    const int32_t *pos = &aar->position.x;
+    const int32_t *size = &aar->size.x;
+    const int32_t *n = &aar->normal.x;
+    int32_t *min = &box->min.x;
+    int32_t *max = &box->max.x;
+
+    int axis_count = (n[0] != 0) + (n[1] != 0) + (n[2] != 0);
+
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = -NEA_RB7_BOX_INFINITE;
+        max[i] = NEA_RB7_BOX_INFINITE;
+
+        if (n[i] == 0)
+        {
+            min[i] = pos[i] - size[i];
+            max[i] = pos[i] + size[i];
+        }
+        else if (axis_count == 1)
+        {
+            if (n[i] > 0)
+                max[i] = pos[i] + NEA_RB7_PENETRATION_THRESHOLD;
+            else
+                min[i] = pos[i] - NEA_RB7_PENETRATION_THRESHOLD;
+        }
+    }
+}
+
 // =========================================================================
 // 3x3 Matrix operations (row-major, f32)
 // =========================================================================
@@ -106,69 +284,133 @@ void nea_rb7_reset(void)
         nea_rb7_bodies[i].used = false;
     for (int i = 0; i < NEA_RB_MAX_STATICS; i++)
         nea_rb7_statics[i].used = false;
+    nea_rb7_num_active = 0;
+    nea_rb7_sap_dirty = true;
+    nea_rb7_set_mesh(NULL, 0, NULL, 0, nea_v3(0, 0, 0));
     nea_rb7_num_contacts = 0;
     nea_rb7_gravity = 0;
     nea_rb7_running = false;
+    nea_rb7_step_budget = 0;
 }
 
 // =========================================================================
 // Body management
 // =========================================================================
 
-int nea_rb7_create_body(nea_vec3_t size, int32_t mass, nea_vec3_t pos)
+static inline int32_t nea_rb7_mulf32(int32_t a, int32_t b)
 {
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    return (int32_t)(((int64_t)a * b) >> 12);
+}
+
+// Diagonal inertia of a shape in its local frame (f32)
+static void nea_rb7_shape_inertia(int shape, nea_vec3_t size, int32_t mass,
+                                  int32_t inertia[3])
+{
+    if (shape == NEA_RB_SHAPE_SPHERE)
     {
-        if (!nea_rb7_bodies[i].used)
+        // I = 2/5 m r²
+        int32_t i = nea_rb7_mulf32(mass, nea_rb7_mulf32(size.x, size.x)) * 2 / 5;
+        inertia[0] = inertia[1] = inertia[2] = i;
+    }
+    else if (shape == NEA_RB_SHAPE_CAPSULE)
+    {
+        // Cylinder of half-height h along Y and two hemispheres, with the
+        // mass split by volume: m_cyl = m * 3h / (3h + 2r)
+        int32_t r = size.x;
+        int32_t h = size.y - size.x;
+        int32_t r2 = nea_rb7_mulf32(r, r);
+        int32_t h2 = nea_rb7_mulf32(h, h);
+        int32_t m_cyl = (3 * h + 2 * r) > 0 ?
+            (int32_t)((int64_t)mass * 3 * h / (3 * h + 2 * r)) : 0;
+        int32_t m_hemi = mass - m_cyl;
+
+        // Cylinder: Iy = m r² / 2, Ix = m (r² / 4 + h² / 3).
+        // Hemispheres: Iy = 2/5 m r², Ix = m (2/5 r² + h² + 3/4 h r).
+        int32_t iy = nea_rb7_mulf32(m_cyl, r2) / 2 +
+                     nea_rb7_mulf32(m_hemi, r2) * 2 / 5;
+        int32_t ix = nea_rb7_mulf32(m_cyl, r2 / 4 + h2 / 3) +
+                     nea_rb7_mulf32(m_hemi, r2 * 2 / 5 + h2 +
+                                    nea_rb7_mulf32(h, r) * 3 / 4);
+        inertia[0] = inertia[2] = ix;
+        inertia[1] = iy;
+    }
+    else
+    {
+        // Box with half-extents: I = m/3 * diag(y²+z², x²+z², x²+y²)
+        int32_t sx2 = nea_rb7_mulf32(size.x, size.x);
+        int32_t sy2 = nea_rb7_mulf32(size.y, size.y);
+        int32_t sz2 = nea_rb7_mulf32(size.z, size.z);
+        inertia[0] = nea_rb7_mulf32(mass, sy2 + sz2) / 3;
+        inertia[1] = nea_rb7_mulf32(mass, sx2 + sz2) / 3;
+        inertia[2] = nea_rb7_mulf32(mass, sx2 + sy2) / 3;
+    }
+}
+
+void nea_rb7_init_body(int id, int shape, nea_vec3_t size, int32_t mass,
+                       nea_vec3_t pos)
+{
+    nea_rb7_body_t *b = &nea_rb7_bodies[id];
+
+    // Replace the body that was in this slot, if any
+    nea_rb7_destroy_body(id);
+
+    // Zero everything
+    for (int j = 0; j < (int)(sizeof(*b) / sizeof(int32_t)); j++)
+        ((int32_t *)b)[j] = 0;
+
+    b->used = true;
+    b->sleep = false;
+    b->position = pos;
+    b->shape = shape;
+    b->size = size;
+    b->mass = mass;
+    b->restitution = (1 << 12) / 2; // 0.5
+    b->friction = (1 << 12) / 2;    // 0.5
+
+    // Identity rotation
+    nea_mat3_identity(b->transform);
+
+    // Diagonal inverse inertia in the local frame
+    if (mass > 0)
+    {
+        int32_t inertia[3];
+        nea_rb7_shape_inertia(shape, size, mass, inertia);
+        for (int k = 0; k < 3; k++)
         {
-            nea_rb7_body_t *b = &nea_rb7_bodies[i];
-
-            // Zero everything
-            for (int j = 0; j < (int)(sizeof(*b) / sizeof(int32_t)); j++)
-                ((int32_t *)b)[j] = 0;
-
-            b->used = true;
-            b->sleep = false;
-            b->position = pos;
-            b->size = size;
-            b->mass = mass;
-            b->restitution = (1 << 12) / 2; // 0.5
-            b->friction = (1 << 12) / 2;    // 0.5
-
-            // Identity rotation
-            nea_mat3_identity(b->transform);
-
-            // Compute diagonal inverse inertia for a box:
-            // I = (m/12) * diag(y²+z², x²+z², x²+y²)
-            // I⁻¹ = diag(12/(m*(y²+z²)), ...)
-            if (mass > 0)
-            {
-                int32_t sx2 = (int32_t)(((int64_t)size.x * size.x) >> 12);
-                int32_t sy2 = (int32_t)(((int64_t)size.y * size.y) >> 12);
-                int32_t sz2 = (int32_t)(((int64_t)size.z * size.z) >> 12);
-
-                int32_t denom_x = (int32_t)(((int64_t)mass * (sy2 + sz2)) >> 12);
-                int32_t denom_y = (int32_t)(((int64_t)mass * (sx2 + sz2)) >> 12);
-                int32_t denom_z = (int32_t)(((int64_t)mass * (sx2 + sy2)) >> 12);
-
-                // I⁻¹ = 3 / denom (using half-extents, so factor is 3 not 12)
-                int32_t three_f32 = 3 << 12;
-                b->invInertia[0] = denom_x > 0 ?
-                    (int32_t)(((int64_t)three_f32 << 12) / denom_x) : 0;
-                b->invInertia[1] = denom_y > 0 ?
-                    (int32_t)(((int64_t)three_f32 << 12) / denom_y) : 0;
-                b->invInertia[2] = denom_z > 0 ?
-                    (int32_t)(((int64_t)three_f32 << 12) / denom_z) : 0;
-            }
+            b->invInertia[k] = inertia[k] > 0 ?
+                (int32_t)((1ll << 24) / inertia[k]) : 0;
+        }
+    }
+
+    // Initial world-space inverse inertia = identity * I⁻¹
+    // (since transform is identity)
+    for (int j = 0; j < 9; j++)
+        b->invWInertia[j] = 0;
+    b->invWInertia[0] = b->invInertia[0];
+    b->invWInertia[4] = b->invInertia[1];
+    b->invWInertia[8] = b->invInertia[2];
+
+    // Insert the body in the list of active bodies, sorted by ID
+    int n = nea_rb7_num_active;
+    while (n > 0 && nea_rb7_active[n - 1] > id)
+    {
+        nea_rb7_active[n] = nea_rb7_active[n - 1];
+        n--;
+    }
+    nea_rb7_active[n] = (uint8_t)id;
+    nea_rb7_num_active++;
 
-            // Initial world-space inverse inertia = identity * I⁻¹
-            // (since transform is identity)
-            for (int j = 0; j < 9; j++)
-                b->invWInertia[j] = 0;
-            b->invWInertia[0] = b->invInertia[0];
-            b->invWInertia[4] = b->invInertia[1];
-            b->invWInertia[8] = b->invInertia[2];
+    nea_rb7_sap_dirty = true;
+}
 
+int nea_rb7_create_body(int shape, nea_vec3_t size, int32_t mass,
+                        nea_vec3_t pos)
+{
+    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    {
+        if (!nea_rb7_bodies[i].used)
+        {
+            nea_rb7_init_body(i, shape, size, mass, pos);
             return i;
         }
     }
@@ -177,24 +419,47 @@ int nea_rb7_create_body(nea_vec3_t size, int32_t mass, nea_vec3_t pos)
 
 void nea_rb7_destroy_body(int id)
 {
-    if (id >= 0 && id < NEA_RB_MAX_BODIES)
-        nea_rb7_bodies[id].used = false;
+    if (id < 0 || id >= NEA_RB_MAX_BODIES || !nea_rb7_bodies[id].used)
+        return;
+
+    nea_rb7_bodies[id].used = false;
+
+    int n = 0;
+    for (int i = 0; i < nea_rb7_num_active; i++)
+    {
+        if (nea_rb7_active[i] != id)
+            nea_rb7_active[n++] = nea_rb7_active[i];
+    }
+    nea_rb7_num_active = n;
+
+    nea_rb7_sap_dirty = true;
 }
 
 // =========================================================================
 // Static collider management
 // =========================================================================
 
+void nea_rb7_set_static(int id, nea_vec3_t pos, nea_vec3_t size,
+                        nea_vec3_t normal)
+{
+    nea_rb7_aar_t *aar = &nea_rb7_statics[id];
+
+    aar->position = pos;
+    aar->size = size;
+    aar->normal = nea_v3_normalize(normal);
+    aar->used = true;
+
+    nea_rb7_static_box(aar, &nea_rb7_static_boxes[id]);
+    nea_rb7_sap_dirty = true;
+}
+
 int nea_rb7_add_static(nea_vec3_t pos, nea_vec3_t size, nea_vec3_t normal)
 {
     for (int i = 0; i < NEA_RB_MAX_STATICS; i++)
     {
         if (!nea_rb7_statics[i].used)
         {
-            nea_rb7_statics[i].position = pos;
-            nea_rb7_statics[i].size = size;
-            nea_rb7_statics[i].normal = nea_v3_normalize(normal);
-            nea_rb7_statics[i].used = true;
+            nea_rb7_set_static(i, pos, size, normal);
             return i;
         }
     }
@@ -204,7 +469,32 @@ int nea_rb7_add_static(nea_vec3_t pos, nea_vec3_t size, nea_vec3_t normal)
 void nea_rb7_remove_static(int id)
 {
     if (id >= 0 && id < NEA_RB_MAX_STATICS)
+    {
         nea_rb7_statics[id].used = false;
+        nea_rb7_sap_dirty = true;
+    }
+}
+
+void nea_rb7_set_mesh(const NEA_RB_MeshTriangle *tris, int num_tris,
+                      const NEA_RB_MeshNode *nodes, int num_nodes,
+                      nea_vec3_t pos)
+{
+    if (tris == NULL)
+    {
+        num_tris = 0;
+        nodes = NULL;
+    }
+    if (nodes == NULL)
+        num_nodes = 0;
+
+    nea_rb7_mesh_tris = tris;
+    nea_rb7_mesh_num_tris = num_tris;
+    nea_rb7_mesh_nodes = nodes;
+    nea_rb7_mesh_num_nodes = num_nodes;
+    nea_rb7_mesh_pos = pos;
+
+    // Drop the cached contacts with the old triangles
+    nea_rb7_sap_dirty = true;
 }
 
 // =========================================================================
@@ -281,10 +571,11 @@ ARM_CODE static void nea_rb7_integrate(nea_rb7_body_t *o, int32_t dt)
     nea_vec3_t new_vel = nea_v3_add(o->velocity, dv);
 
     // x_new = x_old + v_new * dt
+    // Rounded, or bodies that are almost at rest creep in the negative axes.
     nea_vec3_t dx;
-    dx.x = (int32_t)(((int64_t)new_vel.x * dt) >> 12);
-    dx.y = (int32_t)(((int64_t)new_vel.y * dt) >> 12);
-    dx.z = (int32_t)(((int64_t)new_vel.z * dt) >> 12);
+    dx.x = (int32_t)(((int64_t)new_vel.x * dt + (1 << 11)) >> 12);
+    dx.y = (int32_t)(((int64_t)new_vel.y * dt + (1 << 11)) >> 12);
+    dx.z = (int32_t)(((int64_t)new_vel.z * dt + (1 << 11)) >> 12);
 
     o->position = nea_v3_add(o->position, dx);
     o->velocity = new_vel;
@@ -576,16 +867,20 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
     nea_rb7_obb_vertices(b, verts_b);
 
     // Temp contact buffer for this pair (keep deepest 4)
+    // Features of the contacts: vertices of A (0-7) and B (8-15), edges of A
+    // (16-27) and B (28-39), and the SAT midpoint (40).
     nea_vec3_t pair_points[NEA_RB7_MAX_PAIR_CONTACTS];
     int32_t pair_depths[NEA_RB7_MAX_PAIR_CONTACTS];
+    uint8_t pair_features[NEA_RB7_MAX_PAIR_CONTACTS];
     int pair_count = 0;
 
     // Helper: insert a contact, replacing shallowest if full
-    #define PAIR_ADD(pt, depth)                                          \
+    #define PAIR_ADD(pt, depth, feature)                                 \
     do {                                                                 \
         if (pair_count < NEA_RB7_MAX_PAIR_CONTACTS) {                    \
             pair_points[pair_count] = (pt);                              \
             pair_depths[pair_count] = (depth);                           \
+            pair_features[pair_count] = (feature);                       \
             pair_count++;                                                \
         } else {                                                         \
             int _sh = 0;                                                 \
@@ -594,6 +889,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             if ((depth) > pair_depths[_sh]) {                            \
                 pair_points[_sh] = (pt);                                 \
                 pair_depths[_sh] = (depth);                              \
+                pair_features[_sh] = (feature);                          \
             }                                                            \
         }                                                                \
     } while (0)
@@ -610,7 +906,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             int32_t pen = px;
             if (py < pen) pen = py;
             if (pz < pen) pen = pz;
-            PAIR_ADD(verts_a[i], pen);
+            PAIR_ADD(verts_a[i], pen, i);
         }
     }
 
@@ -626,7 +922,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             int32_t pen = px;
             if (py < pen) pen = py;
             if (pz < pen) pen = pz;
-            PAIR_ADD(verts_b[i], pen);
+            PAIR_ADD(verts_b[i], pen, 8 + i);
         }
     }
 
@@ -675,7 +971,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             if (py < pen) pen = py;
             if (pz < pen) pen = pz;
             if (pen > 0)
-                PAIR_ADD(contact, pen);
+                PAIR_ADD(contact, pen, 16 + e);
         }
 
         // Clip edges of B against A
@@ -716,7 +1012,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             if (py < pen) pen = py;
             if (pz < pen) pen = pz;
             if (pen > 0)
-                PAIR_ADD(contact, pen);
+                PAIR_ADD(contact, pen, 28 + e);
         }
     }
 
@@ -726,12 +1022,14 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
         for (int i = 0; i < pair_count && nea_rb7_num_contacts < NEA_RB_MAX_CONTACTS; i++)
         {
             nea_rb7_contact_t *cp = &nea_rb7_contacts[nea_rb7_num_contacts++];
-            cp->normal = best_axis;
+            cp->normal = nea_v3_neg(best_axis); // From B to A
             cp->penetration = pair_depths[i];
             cp->point = pair_points[i];
             cp->body = a;
             cp->target = b;
             cp->type = 0;
+            cp->key = NEA_RB7_CONTACT_KEY(NEA_RB7_KEY_BODY, a - nea_rb7_bodies,
+                                          b - nea_rb7_bodies, pair_features[i]);
 
             if (pair_depths[i] > a->maxPenetration)
                 a->maxPenetration = pair_depths[i];
@@ -748,7 +1046,7 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
         if (nea_rb7_num_contacts < NEA_RB_MAX_CONTACTS)
         {
             nea_rb7_contact_t *cp = &nea_rb7_contacts[nea_rb7_num_contacts++];
-            cp->normal = best_axis;
+            cp->normal = nea_v3_neg(best_axis); // From B to A
             cp->penetration = min_overlap;
             int32_t proj_a_center = nea_v3_dot(a->position, best_axis);
             int32_t proj_b_center = nea_v3_dot(b->position, best_axis);
@@ -758,6 +1056,8 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
             cp->body = a;
             cp->target = b;
             cp->type = 0;
+            cp->key = NEA_RB7_CONTACT_KEY(NEA_RB7_KEY_BODY, a - nea_rb7_bodies,
+                                          b - nea_rb7_bodies, 40);
 
             if (min_overlap > a->maxPenetration)
                 a->maxPenetration = min_overlap;
@@ -778,25 +1078,29 @@ ARM_CODE static bool nea_rb7_collide_obb_obb(nea_rb7_body_t *a, nea_rb7_body_t *
 // OBB-AAR collision (body vs static plane)
 // =========================================================================
 
-ARM_CODE static bool nea_rb7_collide_obb_aar(nea_rb7_body_t *body, nea_rb7_aar_t *aar)
+// Contacts of a set of points of a body with a static. Each point is the center
+// of a sphere of the given radius: 0 for the vertices of boxes, the radius of
+// the body for the ends of the core of spheres and capsules.
+ARM_CODE static bool nea_rb7_collide_points_aar(nea_rb7_body_t *body,
+                                                nea_rb7_aar_t *aar,
+                                                const nea_vec3_t *points,
+                                                int num_points, int32_t radius)
 {
-    nea_vec3_t verts[8];
-    nea_rb7_obb_vertices(body, verts);
-
     bool any_contact = false;
 
-    for (int i = 0; i < 8; i++)
+    for (int i = 0; i < num_points; i++)
     {
         // Distance from vertex to AAR plane
-        nea_vec3_t diff = nea_v3_sub(verts[i], aar->position);
-        int32_t dist = nea_v3_dot(diff, aar->normal);
+        nea_vec3_t diff = nea_v3_sub(points[i], aar->position);
+        int32_t dist = nea_v3_dot(diff, aar->normal) - radius;
 
         if (dist < NEA_RB7_PENETRATION_THRESHOLD)
         {
             // Check if vertex is within AAR bounds
             // Project diff onto the two tangent axes of the AAR
             // For axis-aligned normals, the tangent axes are the other two world axes
-            nea_vec3_t proj = nea_v3_sub(diff, nea_v3_scale(aar->normal, dist));
+            nea_vec3_t proj = nea_v3_sub(diff,
+                nea_v3_scale(aar->normal, dist + radius));
             bool inside = true;
 
             // Check bounds on all 3 axes (only the 2 non-normal ones matter,
@@ -817,12 +1121,16 @@ ARM_CODE static bool nea_rb7_collide_obb_aar(nea_rb7_body_t *body, nea_rb7_aar_t
             if (inside && nea_rb7_num_contacts < NEA_RB_MAX_CONTACTS)
             {
                 nea_rb7_contact_t *cp = &nea_rb7_contacts[nea_rb7_num_contacts++];
-                cp->point = verts[i];
+                cp->point = nea_v3_sub(points[i],
+                                       nea_v3_scale(aar->normal, radius));
                 cp->normal = aar->normal;
                 cp->penetration = -dist; // Positive = overlap
                 cp->body = body;         // Owning body
                 cp->target = NULL;       // Static
                 cp->type = 1;            // body-AAR
+                cp->key = NEA_RB7_CONTACT_KEY(NEA_RB7_KEY_STATIC,
+                                              body - nea_rb7_bodies,
+                                              aar - nea_rb7_statics, i);
 
                 if (cp->penetration > body->maxPenetration)
                     body->maxPenetration = cp->penetration;
@@ -836,41 +1144,685 @@ ARM_CODE static bool nea_rb7_collide_obb_aar(nea_rb7_body_t *body, nea_rb7_aar_t
     return any_contact;
 }
 
+ARM_CODE static bool nea_rb7_collide_obb_aar(nea_rb7_body_t *body,
+                                             nea_rb7_aar_t *aar)
+{
+    nea_vec3_t verts[8];
+    nea_rb7_obb_vertices(body, verts);
+    return nea_rb7_collide_points_aar(body, aar, verts, 8, 0);
+}
+
+// Contacts of the vertices of a body with the mesh collider. Like with statics,
+// each vertex that is close to the front of a triangle, or behind it but less
+// deep than the size of the body, generates one contact with the triangle
+// where it is deepest. Points have a radius like in
+// nea_rb7_collide_points_aar().
+ARM_CODE static void nea_rb7_collide_points_mesh(nea_rb7_body_t *body,
+                                                 const nea_rb7_box_t *box,
+                                                 const nea_vec3_t *points,
+                                                 int num_points, int32_t radius)
+{
+    const nea_vec3_t pos = nea_rb7_mesh_pos;
+    nea_vec3_t verts[8];
+    for (int i = 0; i < num_points; i++)
+        verts[i] = nea_v3_sub(points[i], pos);
+
+    // Box of the body in the space of the mesh
+    int32_t min[3], max[3];
+    {
+        const int32_t *bmin = &box->min.x;
+        const int32_t *bmax = &box->max.x;
+        const int32_t *p = &pos.x;
+        for (int k = 0; k < 3; k++)
+        {
+            min[k] = bmin[k] - p[k] - NEA_RB7_PENETRATION_THRESHOLD;
+            max[k] = bmax[k] - p[k] + NEA_RB7_PENETRATION_THRESHOLD;
+        }
+    }
+
+    int32_t max_depth = body->size.x;
+    if (body->size.y > max_depth)
+        max_depth = body->size.y;
+    if (body->size.z > max_depth)
+        max_depth = body->size.z;
+    max_depth <<= 1;
+
+    int32_t best_pen[8];
+    const NEA_RB_MeshTriangle *best_tri[8];
+    for (int i = 0; i < num_points; i++)
+        best_tri[i] = NULL;
+
+    uint16_t stack[NEA_RB_MESH_MAX_DEPTH + 1];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0)
+    {
+        int first, count;
+
+        if (nea_rb7_mesh_nodes == NULL)
+        {
+            sp--;
+            first = 0;
+            count = nea_rb7_mesh_num_tris;
+        }
+        else
+        {
+            const NEA_RB_MeshNode *node = &nea_rb7_mesh_nodes[stack[--sp]];
+
+            if ((max[0] < node->min[0]) || (min[0] > node->max[0]) ||
+                (max[1] < node->min[1]) || (min[1] > node->max[1]) ||
+                (max[2] < node->min[2]) || (min[2] > node->max[2]))
+                continue;
+
+            if (node->count == 0)
+            {
+                int index = node - nea_rb7_mesh_nodes;
+                stack[sp++] = index + 1;
+                stack[sp++] = node->first;
+                continue;
+            }
+
+            first = node->first;
+            count = node->count;
+        }
+
+        for (int t = first; t < first + count; t++)
+        {
+            const NEA_RB_MeshTriangle *tri = &nea_rb7_mesh_tris[t];
+
+            // Degenerate triangle, or bounding sphere outside of the box
+            int32_t r = tri->radius;
+            if ((r < 0) ||
+                (max[0] < tri->center[0] - r) || (min[0] > tri->center[0] + r) ||
+                (max[1] < tri->center[1] - r) || (min[1] > tri->center[1] + r) ||
+                (max[2] < tri->center[2] - r) || (min[2] > tri->center[2] + r))
+                continue;
+
+            nea_rb7_stats.mesh_tests++;
+
+            nea_vec3_t n = nea_v3(tri->normal[0], tri->normal[1],
+                                  tri->normal[2]);
+
+            for (int i = 0; i < num_points; i++)
+            {
+                int32_t dist = nea_v3_dot(verts[i], n) - tri->plane_d - radius;
+                if (dist >= NEA_RB7_PENETRATION_THRESHOLD || dist <= -max_depth)
+                    continue;
+
+                // Ties go to the first triangle, so that the result doesn't
+                // depend on the order of the BVH.
+                int32_t pen = -dist;
+                if (best_tri[i] != NULL &&
+                    (pen < best_pen[i] || (pen == best_pen[i] && tri > best_tri[i])))
+                    continue;
+
+                // The vertex must be over the triangle
+                const int32_t *start[3] = { tri->v0, tri->v1, tri->v2 };
+                bool inside = true;
+                for (int e = 0; e < 3; e++)
+                {
+                    const int16_t *en = tri->edge_normal[e];
+                    int64_t d = (int64_t)(verts[i].x - start[e][0]) * en[0]
+                              + (int64_t)(verts[i].y - start[e][1]) * en[1]
+                              + (int64_t)(verts[i].z - start[e][2]) * en[2];
+                    if (d < 0)
+                    {
+                        inside = false;
+                        break;
+                    }
+                }
+
+                if (inside)
+                {
+                    best_pen[i] = pen;
+                    best_tri[i] = tri;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < num_points; i++)
+    {
+        const NEA_RB_MeshTriangle *tri = best_tri[i];
+        if (tri == NULL || nea_rb7_num_contacts >= NEA_RB_MAX_CONTACTS)
+            continue;
+
+        nea_rb7_contact_t *cp = &nea_rb7_contacts[nea_rb7_num_contacts++];
+        cp->normal = nea_v3(tri->normal[0], tri->normal[1], tri->normal[2]);
+        cp->point = nea_v3_sub(nea_v3_add(verts[i], pos),
+                               nea_v3_scale(cp->normal, radius));
+        cp->penetration = best_pen[i]; // Positive = overlap
+        cp->body = body;               // Owning body
+        cp->target = NULL;             // Static
+        cp->type = 1;                  // body-static
+        cp->key = NEA_RB7_CONTACT_KEY(NEA_RB7_KEY_MESH, body - nea_rb7_bodies,
+                                      tri - nea_rb7_mesh_tris, i);
+
+        if (cp->penetration > body->maxPenetration)
+            body->maxPenetration = cp->penetration;
+
+        body->numContacts++;
+    }
+}
+
+ARM_CODE static void nea_rb7_collide_obb_mesh(nea_rb7_body_t *body,
+                                              const nea_rb7_box_t *box)
+{
+    nea_vec3_t verts[8];
+    nea_rb7_obb_vertices(body, verts);
+    nea_rb7_collide_points_mesh(body, box, verts, 8, 0);
+}
+
 // =========================================================================
-// Collision detection (all pairs)
+// Spheres and capsules
+// =========================================================================
+//
+// Round bodies are a core segment along their local Y axis swept by a sphere.
+// The radius is size.x and the segment goes from -(size.y - size.x) to
+// +(size.y - size.x), so size is the box that contains the body, and spheres
+// are capsules with a segment of length 0.
+
+// Ends of the core segment of a round body (world space). They are the same
+// point for spheres.
+static void nea_rb7_round_segment(const nea_rb7_body_t *b,
+                                  nea_vec3_t *p0, nea_vec3_t *p1)
+{
+    const int32_t *m = b->transform;
+    nea_vec3_t axis = nea_v3(m[1], m[4], m[7]);
+    nea_vec3_t half = nea_v3_scale(axis, b->size.y - b->size.x);
+    *p0 = nea_v3_sub(b->position, half);
+    *p1 = nea_v3_add(b->position, half);
+}
+
+static inline int32_t nea_rb7_clamp_param(int64_t num, int64_t den)
+{
+    if (num <= 0 || den <= 0)
+        return 0;
+    if (num >= den)
+        return 1 << 12;
+    return (int32_t)((num << 12) / den);
+}
+
+static inline nea_vec3_t nea_rb7_segment_point(nea_vec3_t p, nea_vec3_t d,
+                                               int32_t t)
+{
+    return nea_v3_add(p, nea_v3_scale(d, t));
+}
+
+// Parameter (0 to 1, f32) of the point of segment p + t * d closest to q
+static int32_t nea_rb7_segment_closest(nea_vec3_t p, nea_vec3_t d, nea_vec3_t q)
+{
+    return nea_rb7_clamp_param(nea_v3_dot(nea_v3_sub(q, p), d),
+                               nea_v3_length_sq(d));
+}
+
+// Closest points of segments p1 + s * d1 and p2 + t * d2 (Real-Time Collision
+// Detection, 5.1.9). The parameters are returned in f32.
+ARM_CODE static void nea_rb7_segments_closest(nea_vec3_t p1, nea_vec3_t d1,
+                                              nea_vec3_t p2, nea_vec3_t d2,
+                                              int32_t *s_out, int32_t *t_out)
+{
+    nea_vec3_t r = nea_v3_sub(p1, p2);
+    int64_t a = nea_v3_length_sq(d1);
+    int64_t e = nea_v3_length_sq(d2);
+    int64_t f = nea_v3_dot(d2, r);
+    int32_t s, t;
+
+    if (a == 0 && e == 0)
+    {
+        s = t = 0;
+    }
+    else if (a == 0)
+    {
+        s = 0;
+        t = nea_rb7_clamp_param(f, e);
+    }
+    else
+    {
+        int64_t c = nea_v3_dot(d1, r);
+        if (e == 0)
+        {
+            t = 0;
+            s = nea_rb7_clamp_param(-c, a);
+        }
+        else
+        {
+            int64_t b = nea_v3_dot(d1, d2);
+            int64_t denom = a * e - b * b;
+
+            // Parallel segments: any s works, start from 0
+            s = denom > 0 ? nea_rb7_clamp_param(b * f - c * e, denom) : 0;
+
+            int64_t t_num = ((b * s) >> 12) + f;
+            if (t_num < 0)
+            {
+                t = 0;
+                s = nea_rb7_clamp_param(-c, a);
+            }
+            else if (t_num > e)
+            {
+                t = 1 << 12;
+                s = nea_rb7_clamp_param(b - c, a);
+            }
+            else
+            {
+                t = nea_rb7_clamp_param(t_num, e);
+            }
+        }
+    }
+
+    *s_out = s;
+    *t_out = t;
+}
+
+static void nea_rb7_add_body_contact(nea_rb7_body_t *a, nea_rb7_body_t *b,
+                                     nea_vec3_t point, nea_vec3_t normal,
+                                     int32_t depth, int feature)
+{
+    if (nea_rb7_num_contacts >= NEA_RB_MAX_CONTACTS)
+        return;
+
+    nea_rb7_contact_t *cp = &nea_rb7_contacts[nea_rb7_num_contacts++];
+    cp->normal = normal; // From B to A
+    cp->penetration = depth;
+    cp->point = point;
+    cp->body = a;
+    cp->target = b;
+    cp->type = 0;
+    cp->key = NEA_RB7_CONTACT_KEY(NEA_RB7_KEY_BODY, a - nea_rb7_bodies,
+                                  b - nea_rb7_bodies, feature);
+
+    if (depth > a->maxPenetration)
+        a->maxPenetration = depth;
+    if (depth > b->maxPenetration)
+        b->maxPenetration = depth;
+
+    a->numContacts++;
+    b->numContacts++;
+}
+
+// One contact between the closest points of the cores of two round bodies
+ARM_CODE static void nea_rb7_collide_round_round(nea_rb7_body_t *a,
+                                                 nea_rb7_body_t *b)
+{
+    nea_vec3_t a0, a1, b0, b1;
+    nea_rb7_round_segment(a, &a0, &a1);
+    nea_rb7_round_segment(b, &b0, &b1);
+
+    nea_vec3_t da = nea_v3_sub(a1, a0);
+    nea_vec3_t db = nea_v3_sub(b1, b0);
+    int32_t s, t;
+    nea_rb7_segments_closest(a0, da, b0, db, &s, &t);
+
+    nea_vec3_t pa = nea_rb7_segment_point(a0, da, s);
+    nea_vec3_t pb = nea_rb7_segment_point(b0, db, t);
+    nea_vec3_t delta = nea_v3_sub(pa, pb);
+
+    int32_t dist = nea_v3_length(delta);
+    int32_t depth = a->size.x + b->size.x - dist;
+    if (depth <= 0)
+        return;
+
+    nea_vec3_t normal;
+    if (dist > 0)
+        normal = nea_v3_normalize(delta);
+    else
+        normal = nea_v3(0, 1 << 12, 0); // Same center, push A up
+
+    // Midpoint of the two surfaces
+    nea_vec3_t point = nea_v3_add(pb,
+        nea_v3_scale(normal, (b->size.x - a->size.x + dist) >> 1));
+
+    nea_rb7_add_body_contact(a, b, point, normal, depth, 0);
+}
+
+// Contact of a sphere with a box. It returns the penetration (negative if they
+// don't touch), with the normal from the box to the sphere and the closest
+// point of the surface of the box.
+ARM_CODE static int32_t nea_rb7_sphere_obb(const nea_rb7_body_t *box,
+                                           nea_vec3_t center, int32_t radius,
+                                           nea_vec3_t *point, nea_vec3_t *normal)
+{
+    nea_vec3_t local = nea_world_to_local(box, center);
+    const int32_t half[3] = { box->size.x, box->size.y, box->size.z };
+    int32_t *l = &local.x;
+
+    nea_vec3_t clamped = local;
+    int32_t *c = &clamped.x;
+    bool inside = true;
+    for (int k = 0; k < 3; k++)
+    {
+        if (c[k] > half[k])
+        {
+            c[k] = half[k];
+            inside = false;
+        }
+        else if (c[k] < -half[k])
+        {
+            c[k] = -half[k];
+            inside = false;
+        }
+    }
+
+    nea_vec3_t n_local;
+    int32_t depth;
+    if (inside)
+    {
+        // Push the center out through the closest face
+        int axis = 0;
+        int32_t gap = half[0] - nea_abs(l[0]);
+        for (int k = 1; k < 3; k++)
+        {
+            if (half[k] - nea_abs(l[k]) < gap)
+            {
+                gap = half[k] - nea_abs(l[k]);
+                axis = k;
+            }
+        }
+
+        n_local = nea_v3(0, 0, 0);
+        (&n_local.x)[axis] = l[axis] < 0 ? -(1 << 12) : (1 << 12);
+        c[axis] = l[axis] < 0 ? -half[axis] : half[axis];
+        depth = radius + gap;
+    }
+    else
+    {
+        nea_vec3_t diff = nea_v3_sub(local, clamped);
+        depth = radius - nea_v3_length(diff);
+        n_local = nea_v3_normalize(diff);
+    }
+
+    *normal = nea_mat3_mul_vec(box->transform, n_local);
+    *point = nea_v3_add(box->position, nea_mat3_mul_vec(box->transform, clamped));
+    return depth;
+}
+
+// Contacts of the ends of the core of a round body with a box, and of the point
+// of the core closest to the box if it is between them.
+ARM_CODE static void nea_rb7_collide_obb_round(nea_rb7_body_t *a,
+                                               nea_rb7_body_t *b)
+{
+    bool a_is_box = a->shape == NEA_RB_SHAPE_BOX;
+    const nea_rb7_body_t *box = a_is_box ? a : b;
+    const nea_rb7_body_t *round = a_is_box ? b : a;
+
+    nea_vec3_t p0, p1;
+    nea_rb7_round_segment(round, &p0, &p1);
+    nea_vec3_t d = nea_v3_sub(p1, p0);
+
+    nea_vec3_t centers[3] = { p0, p1 };
+    int num_centers = 1;
+
+    if (round->shape == NEA_RB_SHAPE_CAPSULE)
+    {
+        num_centers = 2;
+
+        // Closest point of the core to the box, refined twice
+        int32_t t = nea_rb7_segment_closest(p0, d, box->position);
+        for (int it = 0; it < 2; it++)
+        {
+            nea_vec3_t q, n;
+            nea_vec3_t c = nea_rb7_segment_point(p0, d, t);
+            if (nea_rb7_sphere_obb(box, c, 0, &q, &n) > 0)
+                break; // The core is inside the box
+            t = nea_rb7_segment_closest(p0, d, q);
+        }
+        if (t > 0 && t < (1 << 12))
+            centers[num_centers++] = nea_rb7_segment_point(p0, d, t);
+    }
+
+    for (int i = 0; i < num_centers; i++)
+    {
+        nea_vec3_t point, normal;
+        int32_t depth = nea_rb7_sphere_obb(box, centers[i], round->size.x,
+                                           &point, &normal);
+        if (depth <= 0)
+            continue;
+
+        // The normal goes from the box to the round body
+        if (a_is_box)
+            normal = nea_v3_neg(normal);
+
+        nea_rb7_add_body_contact(a, b, point, normal, depth, i);
+    }
+}
+
+static int nea_rb7_round_points(const nea_rb7_body_t *b, nea_vec3_t points[2])
+{
+    nea_rb7_round_segment(b, &points[0], &points[1]);
+    return b->shape == NEA_RB_SHAPE_SPHERE ? 1 : 2;
+}
+
+ARM_CODE static void nea_rb7_collide_bodies(nea_rb7_body_t *a, nea_rb7_body_t *b)
+{
+    if (a->shape == NEA_RB_SHAPE_BOX && b->shape == NEA_RB_SHAPE_BOX)
+        nea_rb7_collide_obb_obb(a, b);
+    else if (a->shape != NEA_RB_SHAPE_BOX && b->shape != NEA_RB_SHAPE_BOX)
+        nea_rb7_collide_round_round(a, b);
+    else
+        nea_rb7_collide_obb_round(a, b);
+}
+
+ARM_CODE static void nea_rb7_collide_static(nea_rb7_body_t *body,
+                                            nea_rb7_aar_t *aar)
+{
+    if (body->shape == NEA_RB_SHAPE_BOX)
+    {
+        nea_rb7_collide_obb_aar(body, aar);
+        return;
+    }
+
+    nea_vec3_t points[2];
+    int num_points = nea_rb7_round_points(body, points);
+    nea_rb7_collide_points_aar(body, aar, points, num_points, body->size.x);
+}
+
+ARM_CODE static void nea_rb7_collide_mesh(nea_rb7_body_t *body,
+                                          const nea_rb7_box_t *box)
+{
+    if (body->shape == NEA_RB_SHAPE_BOX)
+    {
+        nea_rb7_collide_obb_mesh(body, box);
+        return;
+    }
+
+    nea_vec3_t points[2];
+    int num_points = nea_rb7_round_points(body, points);
+    nea_rb7_collide_points_mesh(body, box, points, num_points, body->size.x);
+}
+
+// =========================================================================
+// Broadphase (sort and sweep)
+// =========================================================================
+
+// Bounding box of a body. It contains both the box used by
+// nea_rb7_aabb_overlap() and the vertices of the body.
+ARM_CODE static void nea_rb7_body_box(const nea_rb7_body_t *b, nea_rb7_box_t *box)
+{
+    const int32_t *m = b->transform;
+    const int32_t size[3] = { b->size.x, b->size.y, b->size.z };
+    const int32_t *pos = &b->position.x;
+
+    for (int k = 0; k < 3; k++)
+    {
+        int64_t row = 0, col = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            row += (int64_t)nea_abs(m[k * 3 + j]) * size[j];
+            col += (int64_t)nea_abs(m[j * 3 + k]) * size[j];
+        }
+
+        // Round up, vertices are calculated with a different rounding
+        int32_t half = (int32_t)(((row > col ? row : col) >> 12) + 1);
+
+        (&box->min.x)[k] = pos[k] - half;
+        (&box->max.x)[k] = pos[k] + half;
+    }
+}
+
+static inline const nea_rb7_box_t *nea_rb7_sap_box(int entry)
+{
+    if (entry < NEA_RB_MAX_BODIES)
+        return &nea_rb7_body_boxes[entry];
+    return &nea_rb7_static_boxes[entry - NEA_RB_MAX_BODIES];
+}
+
+// Rebuilds the list after bodies or statics have been added or removed
+static void nea_rb7_sap_rebuild(void)
+{
+    int count = 0;
+
+    for (int i = 0; i < nea_rb7_num_active; i++)
+        nea_rb7_sap[count++] = nea_rb7_active[i];
+
+    for (int i = 0; i < NEA_RB_MAX_STATICS; i++)
+    {
+        if (nea_rb7_statics[i].used)
+            nea_rb7_sap[count++] = (uint8_t)(NEA_RB_MAX_BODIES + i);
+    }
+
+    nea_rb7_sap_count = count;
+    nea_rb7_sap_dirty = false;
+
+    // The keys of the cached contacts may refer to removed bodies or statics
+    nea_rb7_cache_clear();
+}
+
+// Finds the pairs of bodies and statics whose boxes overlap
+ARM_CODE static void nea_rb7_broadphase(void)
+{
+    if (nea_rb7_sap_dirty)
+        nea_rb7_sap_rebuild();
+
+    for (int i = 0; i < nea_rb7_num_active; i++)
+    {
+        int id = nea_rb7_active[i];
+        nea_rb7_body_box(&nea_rb7_bodies[id], &nea_rb7_body_boxes[id]);
+
+        for (int w = 0; w < NEA_RB7_BODY_WORDS; w++)
+            nea_rb7_pair_bodies[id][w] = 0;
+        for (int w = 0; w < NEA_RB7_STATIC_WORDS; w++)
+            nea_rb7_pair_statics[id][w] = 0;
+    }
+
+    // Insertion sort by minimum X
+    for (int i = 1; i < nea_rb7_sap_count; i++)
+    {
+        uint8_t entry = nea_rb7_sap[i];
+        int32_t key = nea_rb7_sap_box(entry)->min.x;
+        int j = i;
+
+        while (j > 0 && nea_rb7_sap_box(nea_rb7_sap[j - 1])->min.x > key)
+        {
+            nea_rb7_sap[j] = nea_rb7_sap[j - 1];
+            j--;
+        }
+        nea_rb7_sap[j] = entry;
+    }
+
+    // Sweep. Boxes closer than the margin are considered overlapping, like in
+    // nea_rb7_aabb_overlap().
+    const int32_t margin = NEA_RB7_PENETRATION_THRESHOLD;
+
+    for (int i = 0; i < nea_rb7_sap_count; i++)
+    {
+        int ea = nea_rb7_sap[i];
+        const nea_rb7_box_t *a = nea_rb7_sap_box(ea);
+
+        for (int j = i + 1; j < nea_rb7_sap_count; j++)
+        {
+            int eb = nea_rb7_sap[j];
+            const nea_rb7_box_t *b = nea_rb7_sap_box(eb);
+
+            if (b->min.x > a->max.x + margin)
+                break;
+
+            bool a_static = ea >= NEA_RB_MAX_BODIES;
+            bool b_static = eb >= NEA_RB_MAX_BODIES;
+
+            if (a_static && b_static)
+                continue;
+
+            if (b->min.y > a->max.y + margin || a->min.y > b->max.y + margin ||
+                b->min.z > a->max.z + margin || a->min.z > b->max.z + margin)
+                continue;
+
+            if (a_static || b_static)
+            {
+                int body = a_static ? eb : ea;
+                int aar = (a_static ? ea : eb) - NEA_RB_MAX_BODIES;
+
+                if (!nea_rb7_bodies[body].sleep)
+                    nea_rb7_pair_statics[body][aar >> 5] |= 1u << (aar & 31);
+                continue;
+            }
+
+            // Body pairs are tested by the body with the lowest ID, unless it
+            // is sleeping. Then the other body has to test it, or it would
+            // fall through the sleeping body.
+            int lo = ea < eb ? ea : eb;
+            int hi = ea < eb ? eb : ea;
+
+            if (!nea_rb7_bodies[lo].sleep)
+                nea_rb7_pair_bodies[lo][hi >> 5] |= 1u << (hi & 31);
+            else if (!nea_rb7_bodies[hi].sleep)
+                nea_rb7_pair_bodies[hi][lo >> 5] |= 1u << (lo & 31);
+        }
+    }
+}
+
+// =========================================================================
+// Collision detection
 // =========================================================================
 
 ARM_CODE static void nea_rb7_detect_collisions(void)
 {
     nea_rb7_num_contacts = 0;
 
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    nea_rb7_broadphase();
+
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
+        int i = nea_rb7_active[n];
         nea_rb7_body_t *a = &nea_rb7_bodies[i];
-        if (!a->used || a->sleep)
+        if (a->sleep)
             continue;
 
         a->numContacts = 0;
         a->maxPenetration = 0;
 
         // Body vs body
-        for (int j = i + 1; j < NEA_RB_MAX_BODIES; j++)
+        for (int w = 0; w < NEA_RB7_BODY_WORDS; w++)
         {
-            nea_rb7_body_t *b = &nea_rb7_bodies[j];
-            if (!b->used)
-                continue;
+            uint32_t mask = nea_rb7_pair_bodies[i][w];
+            while (mask)
+            {
+                int j = (w << 5) + __builtin_ctz(mask);
+                mask &= mask - 1;
 
-            nea_rb7_collide_obb_obb(a, b);
+                nea_rb7_collide_bodies(a, &nea_rb7_bodies[j]);
+                nea_rb7_stats.pair_tests++;
+            }
         }
 
         // Body vs statics
-        for (int j = 0; j < NEA_RB_MAX_STATICS; j++)
+        for (int w = 0; w < NEA_RB7_STATIC_WORDS; w++)
         {
-            if (!nea_rb7_statics[j].used)
-                continue;
+            uint32_t mask = nea_rb7_pair_statics[i][w];
+            while (mask)
+            {
+                int j = (w << 5) + __builtin_ctz(mask);
+                mask &= mask - 1;
 
-            nea_rb7_collide_obb_aar(a, &nea_rb7_statics[j]);
+                nea_rb7_collide_static(a, &nea_rb7_statics[j]);
+                nea_rb7_stats.pair_tests++;
+            }
         }
+
+        // Body vs mesh
+        if (nea_rb7_mesh_num_tris > 0)
+            nea_rb7_collide_mesh(a, &nea_rb7_body_boxes[i]);
     }
 }
 
@@ -878,245 +1830,354 @@ ARM_CODE static void nea_rb7_detect_collisions(void)
 // Impulse-based collision response
 // =========================================================================
 
-ARM_CODE static void nea_rb7_resolve_contact(nea_rb7_body_t *body, nea_rb7_contact_t *cp)
+// Other body of a contact that takes part in the response, or NULL if it is
+// static. Sleeping bodies are treated as static until they are woken up.
+static inline nea_rb7_body_t *nea_rb7_contact_other(const nea_rb7_contact_t *cp)
 {
-    nea_vec3_t r1 = nea_v3_sub(cp->point, body->position);
+    nea_rb7_body_t *other = (nea_rb7_body_t *)cp->target;
 
-    nea_vec3_t v1 = nea_v3_add(body->velocity,
-                                nea_v3_cross(body->angularVelocity, r1));
+    if (cp->type != 0 || other == NULL || other->sleep)
+        return NULL;
 
-    int32_t inv_mass1 = body->mass > 0 ?
-        (int32_t)(((int64_t)(1 << 12) << 12) / body->mass) : 0;
+    return other;
+}
 
-    if (cp->type == 0 && cp->target != NULL)
+static inline int32_t nea_rb7_inv_mass(const nea_rb7_body_t *b)
+{
+    return b->mass > 0 ? (int32_t)(((int64_t)(1 << 12) << 12) / b->mass) : 0;
+}
+
+// Velocity of a point of a body, r relative to its center
+static inline nea_vec3_t nea_rb7_point_velocity(const nea_rb7_body_t *b,
+                                                nea_vec3_t r)
+{
+    return nea_v3_add(b->velocity, nea_v3_cross(b->angularVelocity, r));
+}
+
+// Relative velocity of the body of a contact with respect to the other one
+static inline nea_vec3_t nea_rb7_contact_velocity(const nea_rb7_body_t *body,
+                                                  const nea_rb7_body_t *other,
+                                                  nea_vec3_t point)
+{
+    nea_vec3_t dv = nea_rb7_point_velocity(body,
+                                           nea_v3_sub(point, body->position));
+    if (other != NULL)
     {
-        // Body-body contact
-        nea_rb7_body_t *other = (nea_rb7_body_t *)cp->target;
-        nea_vec3_t r2 = nea_v3_sub(cp->point, other->position);
-        nea_vec3_t v2 = nea_v3_add(other->velocity,
-                                    nea_v3_cross(other->angularVelocity, r2));
+        dv = nea_v3_sub(dv, nea_rb7_point_velocity(other,
+                                nea_v3_sub(point, other->position)));
+    }
+    return dv;
+}
 
-        nea_vec3_t dv = nea_v3_sub(v1, v2);
-        int32_t vn = nea_v3_dot(dv, cp->normal);
+// Effective mass of a contact along a direction:
+// 1/m_eff = 1/m1 + 1/m2 + (r1×d)ᵀ I1⁻¹ (r1×d) + (r2×d)ᵀ I2⁻¹ (r2×d)
+// It returns m_eff, or 0 if the contact can't move along that direction.
+static int32_t nea_rb7_contact_mass(const nea_rb7_body_t *body,
+                                    const nea_rb7_body_t *other,
+                                    nea_vec3_t point, nea_vec3_t dir)
+{
+    nea_vec3_t r1 = nea_v3_sub(point, body->position);
+    nea_vec3_t Ir1 = nea_mat3_mul_vec(body->invWInertia, nea_v3_cross(r1, dir));
+    int32_t inv_meff = nea_rb7_inv_mass(body) +
+        nea_v3_dot(nea_v3_cross(Ir1, r1), dir);
 
-        // Only resolve if approaching (vn < 0 means moving into contact)
-        if (vn >= 0)
-            return;
+    if (other != NULL)
+    {
+        nea_vec3_t r2 = nea_v3_sub(point, other->position);
+        nea_vec3_t Ir2 = nea_mat3_mul_vec(other->invWInertia,
+                                          nea_v3_cross(r2, dir));
+        inv_meff += nea_rb7_inv_mass(other) +
+            nea_v3_dot(nea_v3_cross(Ir2, r2), dir);
+    }
 
-        int32_t inv_mass2 = other->mass > 0 ?
-            (int32_t)(((int64_t)(1 << 12) << 12) / other->mass) : 0;
+    if (inv_meff <= 0)
+        return 0;
 
-        // Effective mass along normal:
-        // 1/m_eff = 1/m1 + 1/m2 + (r1×n)ᵀ I1⁻¹ (r1×n) + (r2×n)ᵀ I2⁻¹ (r2×n)
-        nea_vec3_t r1xn = nea_v3_cross(r1, cp->normal);
-        nea_vec3_t r2xn = nea_v3_cross(r2, cp->normal);
-        nea_vec3_t Ir1 = nea_mat3_mul_vec(body->invWInertia, r1xn);
-        nea_vec3_t Ir2 = nea_mat3_mul_vec(other->invWInertia, r2xn);
+    return (int32_t)(((int64_t)(1 << 12) << 12) / inv_meff);
+}
+
+// The solver applies many small impulses, so the products are rounded to the
+// nearest value. Truncating them makes bodies drift and spin slowly.
+static inline int32_t nea_rb7_round(int64_t v)
+{
+    return (int32_t)((v + (1 << 11)) >> 12);
+}
 
-        int32_t inv_meff = inv_mass1 + inv_mass2 +
-            nea_v3_dot(nea_v3_cross(Ir1, r1), cp->normal) +
-            nea_v3_dot(nea_v3_cross(Ir2, r2), cp->normal);
+static inline nea_vec3_t nea_rb7_round_scale(nea_vec3_t a, int32_t s)
+{
+    return nea_v3(nea_rb7_round((int64_t)a.x * s),
+                  nea_rb7_round((int64_t)a.y * s),
+                  nea_rb7_round((int64_t)a.z * s));
+}
 
-        if (inv_meff == 0)
-            return;
+static inline nea_vec3_t nea_rb7_round_cross(nea_vec3_t a, nea_vec3_t b)
+{
+    return nea_v3(nea_rb7_round((int64_t)a.y * b.z - (int64_t)a.z * b.y),
+                  nea_rb7_round((int64_t)a.z * b.x - (int64_t)a.x * b.z),
+                  nea_rb7_round((int64_t)a.x * b.y - (int64_t)a.y * b.x));
+}
+
+// Applies an impulse to the body of a contact, and the opposite to the other
+ARM_CODE static void nea_rb7_contact_impulse(nea_rb7_body_t *body,
+                                             nea_rb7_body_t *other,
+                                             nea_vec3_t point,
+                                             nea_vec3_t impulse)
+{
+    body->velocity = nea_v3_add(body->velocity,
+                        nea_rb7_round_scale(impulse, nea_rb7_inv_mass(body)));
+    body->angularMomentum = nea_v3_add(body->angularMomentum,
+        nea_rb7_round_cross(nea_v3_sub(point, body->position), impulse));
+    body->angularVelocity = nea_mat3_mul_vec(body->invWInertia,
+                                             body->angularMomentum);
+
+    if (other == NULL)
+        return;
+
+    nea_vec3_t neg_impulse = nea_v3_neg(impulse);
+    other->velocity = nea_v3_add(other->velocity,
+                        nea_rb7_round_scale(neg_impulse, nea_rb7_inv_mass(other)));
+    other->angularMomentum = nea_v3_add(other->angularMomentum,
+        nea_rb7_round_cross(nea_v3_sub(point, other->position), neg_impulse));
+    other->angularVelocity = nea_mat3_mul_vec(other->invWInertia,
+                                              other->angularMomentum);
+}
+
+static inline nea_vec3_t nea_rb7_contact_tangent2(const nea_rb7_contact_t *cp)
+{
+    return nea_v3_cross(cp->normal, cp->tangent);
+}
 
-        // Use average restitution
-        int32_t e = (body->restitution + other->restitution) >> 1;
+// Prepares a contact for the solver. It must be done for all contacts before
+// any impulse is applied, so that the velocities used for restitution are the
+// ones of the start of the sub-step.
+ARM_CODE static void nea_rb7_prepare_contact(nea_rb7_contact_t *cp)
+{
+    nea_rb7_body_t *body = (nea_rb7_body_t *)cp->body;
+    nea_rb7_body_t *other = nea_rb7_contact_other(cp);
+    nea_vec3_t n = cp->normal;
 
-        // Normal impulse: J = -(1+e) * vn / inv_meff
-        int32_t jn = (int32_t)(-((int64_t)((1 << 12) + e) * vn) >> 12);
-        jn = (int32_t)(((int64_t)jn << 12) / inv_meff);
+    cp->normalImpulse = 0;
+    cp->tangentImpulse[0] = 0;
+    cp->tangentImpulse[1] = 0;
 
-        // Add penetration bias to prevent sinking
-        jn += cp->penetration >> 1;
+    if (body == NULL || !body->used)
+    {
+        cp->normalMass = 0;
+        cp->tangentMass[0] = 0;
+        cp->tangentMass[1] = 0;
+        return;
+    }
 
-        if (jn < 0)
-            jn = 0;
+    // Friction directions, derived from the normal only so that they match
+    // the ones of the cached impulses.
+    if (nea_abs(n.x) >= 2365) // 1 / sqrt(3)
+        cp->tangent = nea_v3_normalize(nea_v3(n.y, -n.x, 0));
+    else
+        cp->tangent = nea_v3_normalize(nea_v3(0, n.z, -n.y));
+    nea_vec3_t t2 = nea_rb7_contact_tangent2(cp);
 
-        nea_vec3_t impulse = nea_v3_scale(cp->normal, jn);
+    cp->normalMass = nea_rb7_contact_mass(body, other, cp->point, n);
+    cp->tangentMass[0] = nea_rb7_contact_mass(body, other, cp->point,
+                                              cp->tangent);
+    cp->tangentMass[1] = nea_rb7_contact_mass(body, other, cp->point, t2);
 
-        // Apply to body 1
-        body->velocity = nea_v3_add(body->velocity,
-                                     nea_v3_scale(impulse, inv_mass1));
-        body->angularMomentum = nea_v3_add(body->angularMomentum,
-                                            nea_v3_cross(r1, impulse));
+    // Restitution is only applied to contacts that approach fast enough, so
+    // that resting contacts don't keep bouncing. The penetration bias is the
+    // velocity that used to be added as an impulse of half the penetration.
+    int32_t vn = nea_v3_dot(nea_rb7_contact_velocity(body, other, cp->point), n);
 
-        // Apply to body 2 (opposite)
-        nea_vec3_t neg_impulse = nea_v3_neg(impulse);
-        other->velocity = nea_v3_add(other->velocity,
-                                      nea_v3_scale(neg_impulse, inv_mass2));
-        other->angularMomentum = nea_v3_add(other->angularMomentum,
-                                             nea_v3_cross(r2, neg_impulse));
+    cp->bias = 0;
+    if (vn < 0)
+    {
+        int32_t e;
+        if (cp->type == 0 && cp->target != NULL)
+            e = (body->restitution + ((nea_rb7_body_t *)cp->target)->restitution) >> 1;
+        else
+            e = body->restitution >> 1; // Less bouncy against statics
 
-        // --- Coulomb friction ---
-        nea_vec3_t tangent = nea_v3_sub(dv,
-            nea_v3_scale(cp->normal, nea_v3_dot(dv, cp->normal)));
-        int32_t tang_len = nea_v3_length(tangent);
+        if (-vn > NEA_RB7_RESTITUTION_THRESHOLD)
+            cp->bias = (int32_t)(-((int64_t)e * vn) >> 12);
 
-        if (tang_len > 10)
+        if (cp->normalMass > 0)
         {
-            tangent = nea_v3_normalize(tangent);
+            cp->bias += (int32_t)(((int64_t)(cp->penetration >> 1) << 12) /
+                                  cp->normalMass);
+        }
+    }
+}
 
-            int32_t vt = nea_v3_dot(dv, tangent);
+// Applies the impulses that a contact had in the previous sub-step. They are
+// scaled if dt has changed.
+ARM_CODE static void nea_rb7_warm_start(nea_rb7_contact_t *cp, int32_t dt_ratio)
+{
+    if (cp->normalMass == 0)
+        return;
 
-            // Friction impulse
-            nea_vec3_t r1xt = nea_v3_cross(r1, tangent);
-            nea_vec3_t r2xt = nea_v3_cross(r2, tangent);
-            nea_vec3_t It1 = nea_mat3_mul_vec(body->invWInertia, r1xt);
-            nea_vec3_t It2 = nea_mat3_mul_vec(other->invWInertia, r2xt);
+    const nea_rb7_cached_t *cached = nea_rb7_cache_find(cp->key);
+    if (cached == NULL)
+        return;
 
-            int32_t inv_meff_t = inv_mass1 + inv_mass2 +
-                nea_v3_dot(nea_v3_cross(It1, r1), tangent) +
-                nea_v3_dot(nea_v3_cross(It2, r2), tangent);
+    cp->normalImpulse = (int32_t)(((int64_t)cached->normalImpulse * dt_ratio) >> 12);
+    cp->tangentImpulse[0] = (int32_t)(((int64_t)cached->tangentImpulse[0] * dt_ratio) >> 12);
+    cp->tangentImpulse[1] = (int32_t)(((int64_t)cached->tangentImpulse[1] * dt_ratio) >> 12);
 
-            if (inv_meff_t > 0)
-            {
-                int32_t jt = (int32_t)(-((int64_t)vt << 12) / inv_meff_t);
-
-                // Coulomb clamp: |jt| <= μ * |jn|
-                int32_t mu = (body->friction + other->friction) >> 1;
-                int32_t max_jt = (int32_t)(((int64_t)mu * nea_abs(jn)) >> 12);
-                jt = nea_clamp(jt, -max_jt, max_jt);
-
-                nea_vec3_t friction_imp = nea_v3_scale(tangent, jt);
-                body->velocity = nea_v3_add(body->velocity,
-                    nea_v3_scale(friction_imp, inv_mass1));
-                body->angularMomentum = nea_v3_add(body->angularMomentum,
-                    nea_v3_cross(r1, friction_imp));
-
-                nea_vec3_t neg_fric = nea_v3_neg(friction_imp);
-                other->velocity = nea_v3_add(other->velocity,
-                    nea_v3_scale(neg_fric, inv_mass2));
-                other->angularMomentum = nea_v3_add(other->angularMomentum,
-                    nea_v3_cross(r2, neg_fric));
-            }
-        }
+    nea_vec3_t t2 = nea_rb7_contact_tangent2(cp);
+    nea_vec3_t impulse = nea_v3_add(nea_v3_scale(cp->normal, cp->normalImpulse),
+        nea_v3_add(nea_v3_scale(cp->tangent, cp->tangentImpulse[0]),
+                   nea_v3_scale(t2, cp->tangentImpulse[1])));
+    nea_rb7_contact_impulse((nea_rb7_body_t *)cp->body,
+                            nea_rb7_contact_other(cp), cp->point, impulse);
+}
 
-        // Update angular velocities
-        body->angularVelocity = nea_mat3_mul_vec(body->invWInertia,
-                                                  body->angularMomentum);
-        other->angularVelocity = nea_mat3_mul_vec(other->invWInertia,
-                                                   other->angularMomentum);
-    }
+// One iteration of the solver for a contact. The accumulated normal impulse
+// can't be negative, and the friction impulses are kept inside the Coulomb
+// limit of the accumulated normal impulse.
+ARM_CODE static void nea_rb7_solve_contact(nea_rb7_contact_t *cp)
+{
+    nea_rb7_body_t *body = (nea_rb7_body_t *)cp->body;
+    nea_rb7_body_t *other = nea_rb7_contact_other(cp);
+
+    // --- Coulomb friction ---
+    int32_t mu;
+    if (cp->type == 0 && cp->target != NULL)
+        mu = (body->friction + ((nea_rb7_body_t *)cp->target)->friction) >> 1;
     else
-    {
-        // Body-AAR (static) contact
-        int32_t vn = nea_v3_dot(v1, cp->normal);
+        mu = body->friction;
 
-        // Only resolve if approaching (vn < 0 means moving into surface)
-        if (vn >= 0)
-            return;
+    int32_t max_jt = (int32_t)(((int64_t)mu * cp->normalImpulse) >> 12);
 
-        nea_vec3_t r1xn = nea_v3_cross(r1, cp->normal);
-        nea_vec3_t Ir1 = nea_mat3_mul_vec(body->invWInertia, r1xn);
+    for (int k = 0; k < 2; k++)
+    {
+        if (cp->tangentMass[k] == 0)
+            continue;
 
-        int32_t inv_meff = inv_mass1 +
-            nea_v3_dot(nea_v3_cross(Ir1, r1), cp->normal);
+        nea_vec3_t t = k == 0 ? cp->tangent : nea_rb7_contact_tangent2(cp);
+        nea_vec3_t dv = nea_rb7_contact_velocity(body, other, cp->point);
+        int32_t vt = nea_v3_dot(dv, t);
 
-        if (inv_meff == 0)
-            return;
+        int32_t jt = (int32_t)(-((int64_t)vt * cp->tangentMass[k]) >> 12);
+        int32_t old = cp->tangentImpulse[k];
+        cp->tangentImpulse[k] = nea_clamp(old + jt, -max_jt, max_jt);
+        jt = cp->tangentImpulse[k] - old;
 
-        // Lower restitution for static contacts (less bouncy)
-        int32_t e = body->restitution >> 1; // Half of body's restitution
+        if (jt != 0)
+            nea_rb7_contact_impulse(body, other, cp->point, nea_v3_scale(t, jt));
+    }
 
-        int32_t jn = (int32_t)(-((int64_t)((1 << 12) + e) * vn) >> 12);
-        jn = (int32_t)(((int64_t)jn << 12) / inv_meff);
-        jn += cp->penetration >> 1;
+    // --- Normal impulse ---
+    if (cp->normalMass == 0)
+        return;
 
-        if (jn < 0)
-            jn = 0;
+    nea_vec3_t dv = nea_rb7_contact_velocity(body, other, cp->point);
+    int32_t vn = nea_v3_dot(dv, cp->normal);
 
-        nea_vec3_t impulse = nea_v3_scale(cp->normal, jn);
+    int32_t jn = (int32_t)(((int64_t)cp->bias - vn) * cp->normalMass >> 12);
+    int32_t old = cp->normalImpulse;
+    cp->normalImpulse = old + jn > 0 ? old + jn : 0;
+    jn = cp->normalImpulse - old;
 
-        body->velocity = nea_v3_add(body->velocity,
-                                     nea_v3_scale(impulse, inv_mass1));
-        body->angularMomentum = nea_v3_add(body->angularMomentum,
-                                            nea_v3_cross(r1, impulse));
+    if (jn != 0)
+        nea_rb7_contact_impulse(body, other, cp->point,
+                                nea_v3_scale(cp->normal, jn));
+}
 
-        // Coulomb friction against static surface
-        nea_vec3_t tangent = nea_v3_sub(v1,
-            nea_v3_scale(cp->normal, nea_v3_dot(v1, cp->normal)));
-        int32_t tang_len = nea_v3_length(tangent);
+// Wakes up the sleeping body of a contact if the impulse it has received would
+// have woken it up in nea_rb7_check_sleep().
+static void nea_rb7_wake_target(nea_rb7_contact_t *cp)
+{
+    nea_rb7_body_t *other = (nea_rb7_body_t *)cp->target;
 
-        if (tang_len > 10)
-        {
-            tangent = nea_v3_normalize(tangent);
-            int32_t vt = nea_v3_dot(v1, tangent);
+    if (cp->type != 0 || other == NULL || !other->sleep)
+        return;
 
-            nea_vec3_t r1xt = nea_v3_cross(r1, tangent);
-            nea_vec3_t It1 = nea_mat3_mul_vec(body->invWInertia, r1xt);
-            int32_t inv_meff_t = inv_mass1 +
-                nea_v3_dot(nea_v3_cross(It1, r1), tangent);
+    int32_t dv = (int32_t)(((int64_t)cp->normalImpulse *
+                            nea_rb7_inv_mass(other)) >> 12);
+    int32_t energy = (int32_t)(((int64_t)dv * dv) >> 13);
 
-            if (inv_meff_t > 0)
-            {
-                int32_t jt = (int32_t)(-((int64_t)vt << 12) / inv_meff_t);
-                int32_t max_jt = (int32_t)(((int64_t)body->friction * nea_abs(jn)) >> 12);
-                jt = nea_clamp(jt, -max_jt, max_jt);
-
-                nea_vec3_t friction_imp = nea_v3_scale(tangent, jt);
-                body->velocity = nea_v3_add(body->velocity,
-                    nea_v3_scale(friction_imp, inv_mass1));
-                body->angularMomentum = nea_v3_add(body->angularMomentum,
-                    nea_v3_cross(r1, friction_imp));
-            }
-        }
-
-        body->angularVelocity = nea_mat3_mul_vec(body->invWInertia,
-                                                  body->angularMomentum);
+    if (energy >= NEA_RB7_SLEEP_THRESHOLD * NEA_RB7_WAKE_MULTIPLIER)
+    {
+        other->sleep = false;
+        other->sleepCounter = 0;
     }
 }
 
-// Resolve all contacts — simple O(contacts) loop using stored body owner
-ARM_CODE static void nea_rb7_resolve_all(void)
+// Resolve all contacts with sequential impulses, starting from the impulses
+// of the previous sub-step.
+ARM_CODE static void nea_rb7_resolve_all(int32_t dt)
 {
+    int32_t dt_ratio = 1 << 12;
+    if (nea_rb7_cache_dt > 0 && nea_rb7_cache_dt != dt)
+        dt_ratio = (int32_t)(((int64_t)dt << 12) / nea_rb7_cache_dt);
+
     for (int c = 0; c < nea_rb7_num_contacts; c++)
-    {
-        nea_rb7_contact_t *cp = &nea_rb7_contacts[c];
-        nea_rb7_body_t *body = (nea_rb7_body_t *)cp->body;
+        nea_rb7_prepare_contact(&nea_rb7_contacts[c]);
 
-        if (body == NULL || !body->used)
-            continue;
+    for (int c = 0; c < nea_rb7_num_contacts; c++)
+        nea_rb7_warm_start(&nea_rb7_contacts[c], dt_ratio);
 
-        nea_rb7_resolve_contact(body, cp);
+    for (int it = 0; it < NEA_RB7_SOLVER_ITERATIONS; it++)
+    {
+        for (int c = 0; c < nea_rb7_num_contacts; c++)
+            nea_rb7_solve_contact(&nea_rb7_contacts[c]);
     }
 
+    for (int c = 0; c < nea_rb7_num_contacts; c++)
+        nea_rb7_wake_target(&nea_rb7_contacts[c]);
+
+    nea_rb7_cache_store(dt);
+
     // Position correction: push bodies out of penetration.
     // Apply ONCE per body using the deepest contact to avoid multi-contact
     // over-correction (4 contacts × 80% = 320% pushout without this).
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    // Find the deepest contact involving each body (as owner or target).
+    static nea_rb7_contact_t *deepest_contact[NEA_RB_MAX_BODIES];
+    static int32_t deepest_pen[NEA_RB_MAX_BODIES];
+    static bool deepest_as_target[NEA_RB_MAX_BODIES];
+
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
-        nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used || b->mass == 0)
-            continue;
+        int i = nea_rb7_active[n];
+        deepest_contact[i] = NULL;
+        deepest_pen[i] = 0;
+    }
 
-        // Find the deepest contact involving this body (as owner or target)
-        nea_rb7_contact_t *deepest = NULL;
-        int32_t max_pen = 0;
-        bool as_target = false;
+    for (int c = 0; c < nea_rb7_num_contacts; c++)
+    {
+        nea_rb7_contact_t *cp = &nea_rb7_contacts[c];
 
-        for (int c = 0; c < nea_rb7_num_contacts; c++)
+        if (cp->body != NULL)
         {
-            nea_rb7_contact_t *cp = &nea_rb7_contacts[c];
-            if (cp->body == b)
+            int i = (nea_rb7_body_t *)cp->body - nea_rb7_bodies;
+            if (cp->penetration > deepest_pen[i])
             {
-                if (cp->penetration > max_pen)
-                {
-                    max_pen = cp->penetration;
-                    deepest = cp;
-                    as_target = false;
-                }
+                deepest_pen[i] = cp->penetration;
+                deepest_contact[i] = cp;
+                deepest_as_target[i] = false;
             }
-            else if (cp->type == 0 && cp->target == b)
+        }
+
+        if (cp->type == 0 && cp->target != NULL)
+        {
+            int i = (nea_rb7_body_t *)cp->target - nea_rb7_bodies;
+            if (cp->penetration > deepest_pen[i])
             {
-                if (cp->penetration > max_pen)
-                {
-                    max_pen = cp->penetration;
-                    deepest = cp;
-                    as_target = true;
-                }
+                deepest_pen[i] = cp->penetration;
+                deepest_contact[i] = cp;
+                deepest_as_target[i] = true;
             }
         }
+    }
+
+    for (int n = 0; n < nea_rb7_num_active; n++)
+    {
+        int i = nea_rb7_active[n];
+        nea_rb7_body_t *b = &nea_rb7_bodies[i];
+        if (b->mass == 0)
+            continue;
+
+        nea_rb7_contact_t *deepest = deepest_contact[i];
+        int32_t max_pen = deepest_pen[i];
+        bool as_target = deepest_as_target[i];
 
         if (deepest == NULL)
             continue;
@@ -1130,7 +2191,7 @@ ARM_CODE static void nea_rb7_resolve_all(void)
         // Push out 80% of penetration along normal
         int32_t push = (int32_t)(((int64_t)correction * 3277) >> 12); // 3277/4096 ≈ 0.8
 
-        // Determine push direction (normal points from body to target)
+        // Determine push direction (normal points from target to body)
         nea_vec3_t normal = deepest->normal;
         if (as_target)
             normal = nea_v3_neg(normal); // Target gets pushed opposite
@@ -1140,9 +2201,8 @@ ARM_CODE static void nea_rb7_resolve_all(void)
             // Body-body: scale push by inverse mass ratio
             nea_rb7_body_t *other = as_target ?
                 (nea_rb7_body_t *)deepest->body : (nea_rb7_body_t *)deepest->target;
-            int32_t inv_m_self = (int32_t)(((int64_t)(1 << 12) << 12) / b->mass);
-            int32_t inv_m_other = other->mass > 0 ?
-                (int32_t)(((int64_t)(1 << 12) << 12) / other->mass) : 0;
+            int32_t inv_m_self = nea_rb7_inv_mass(b);
+            int32_t inv_m_other = other->sleep ? 0 : nea_rb7_inv_mass(other);
             int32_t total_inv = inv_m_self + inv_m_other;
             if (total_inv > 0)
             {
@@ -1199,10 +2259,11 @@ static void nea_rb7_check_sleep(nea_rb7_body_t *body)
 // Save/restore helpers for adaptive bisection
 static void nea_rb7_save_state(nea_rb7_backup_t backups[])
 {
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
+        int i = nea_rb7_active[n];
         nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used || b->sleep)
+        if (b->sleep)
             continue;
         backups[i].position = b->position;
         backups[i].velocity = b->velocity;
@@ -1217,10 +2278,11 @@ static void nea_rb7_save_state(nea_rb7_backup_t backups[])
 
 static void nea_rb7_restore_state(const nea_rb7_backup_t backups[])
 {
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
+        int i = nea_rb7_active[n];
         nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used || b->sleep)
+        if (b->sleep)
             continue;
         b->position = backups[i].position;
         b->velocity = backups[i].velocity;
@@ -1236,61 +2298,67 @@ static void nea_rb7_restore_state(const nea_rb7_backup_t backups[])
 // Run one sub-step: apply gravity, integrate, detect, resolve
 ARM_CODE static void nea_rb7_substep(int32_t dt)
 {
+    uint32_t start = cpuGetTiming();
+
     // Apply gravity
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
-        nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used || b->sleep || b->mass == 0)
+        nea_rb7_body_t *b = &nea_rb7_bodies[nea_rb7_active[n]];
+        if (b->sleep || b->mass == 0)
             continue;
         int32_t fy = (int32_t)(((int64_t)b->mass * nea_rb7_gravity) >> 12);
         b->forces.y += fy;
     }
 
     // Integrate
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
-        nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used || b->sleep)
+        nea_rb7_body_t *b = &nea_rb7_bodies[nea_rb7_active[n]];
+        if (b->sleep)
             continue;
         nea_rb7_integrate(b, dt);
     }
 
+    uint32_t integrated = cpuGetTiming();
+    nea_rb7_stats.integrate_cycles += integrated - start;
+
     // Detect and resolve
     nea_rb7_detect_collisions();
-    nea_rb7_resolve_all();
-}
 
-ARM_CODE void nea_rb7_update(void)
-{
-    if (!nea_rb7_running)
-        return;
+    uint32_t detected = cpuGetTiming();
+    nea_rb7_stats.detect_cycles += detected - integrated;
+
+    nea_rb7_stats.contacts += nea_rb7_num_contacts;
+    if ((uint32_t)nea_rb7_num_contacts > nea_rb7_stats.max_contacts)
+        nea_rb7_stats.max_contacts = nea_rb7_num_contacts;
 
-    // Fixed timestep: dt = 1.0 / (60 * substeps) in f32
-    // 60 FPS, 4 substeps = dt ~= 0.00417 = 17 in f32
-    int32_t dt = (1 << 12) / (60 * NEA_RB7_SUBSTEPS);
-    if (dt < 1)
-        dt = 1;
+    nea_rb7_resolve_all(dt);
+
+    nea_rb7_stats.resolve_cycles += cpuGetTiming() - detected;
+}
 
+ARM_CODE int nea_rb7_update(int32_t dt, int max_bisections)
+{
     // Save state before this substep for potential bisection
     static nea_rb7_backup_t backups[NEA_RB_MAX_BODIES];
-    nea_rb7_save_state(backups);
+    if (max_bisections > 0)
+        nea_rb7_save_state(backups);
 
     // Try full substep
     nea_rb7_substep(dt);
+    int runs = 1;
 
     // Check for deep penetration — if found, bisect
     int32_t pen_threshold = NEA_RB7_PENETRATION_THRESHOLD * 4;
-    for (int bisect = 0; bisect < NEA_RB7_MAX_BISECTIONS; bisect++)
+    for (int bisect = 0; bisect < max_bisections; bisect++)
     {
         // Find worst penetration across all bodies
         int32_t worst_pen = 0;
-        for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+        for (int n = 0; n < nea_rb7_num_active; n++)
         {
-            if (nea_rb7_bodies[i].used && !nea_rb7_bodies[i].sleep &&
-                nea_rb7_bodies[i].maxPenetration > worst_pen)
-            {
-                worst_pen = nea_rb7_bodies[i].maxPenetration;
-            }
+            const nea_rb7_body_t *b = &nea_rb7_bodies[nea_rb7_active[n]];
+            if (!b->sleep && b->maxPenetration > worst_pen)
+                worst_pen = b->maxPenetration;
         }
 
         if (worst_pen <= pen_threshold)
@@ -1298,6 +2366,7 @@ ARM_CODE void nea_rb7_update(void)
 
         // Restore and redo with halved timestep.
         // bisect=0: dt/2, 2 steps. bisect=1: dt/4, 4 steps. etc.
+        uint32_t start = cpuGetTiming();
         nea_rb7_restore_state(backups);
         dt >>= 1;
         if (dt < 1)
@@ -1306,17 +2375,130 @@ ARM_CODE void nea_rb7_update(void)
         int num_steps = 1 << (bisect + 1); // 2, 4, ...
         for (int s = 0; s < num_steps; s++)
             nea_rb7_substep(dt);
+        runs += num_steps;
+
+        nea_rb7_stats.bisect_cycles += cpuGetTiming() - start;
     }
+
+    return runs;
 }
 
-void nea_rb7_sleep_check_all(void)
+// Number of sub-steps that the next frame needs, from the state at the end of
+// the last one. Bodies that are about to fall asleep only need one. Bodies
+// that are touching something need NEA_RB7_SUBSTEPS so that stacks stay
+// stable, and fast bodies need enough sub-steps to not move more than half
+// their smallest half-extent in one of them, so that they don't tunnel.
+ARM_CODE static int nea_rb7_plan_substeps(void)
 {
-    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    int steps = 0;
+
+    for (int n = 0; n < nea_rb7_num_active; n++)
     {
-        nea_rb7_body_t *b = &nea_rb7_bodies[i];
-        if (!b->used)
+        const nea_rb7_body_t *b = &nea_rb7_bodies[nea_rb7_active[n]];
+        if (b->sleep || b->mass == 0)
             continue;
 
-        nea_rb7_check_sleep(b);
+        if (steps < 1)
+            steps = 1;
+
+        if (b->maxPenetration > NEA_RB7_PENETRATION_THRESHOLD ||
+            (b->numContacts > 0 &&
+             b->energy > NEA_RB7_SLEEP_THRESHOLD))
+        {
+            if (steps < NEA_RB7_SUBSTEPS)
+                steps = NEA_RB7_SUBSTEPS;
+        }
+
+        int32_t size_min = b->size.x;
+        int32_t size_max = b->size.x;
+        if (b->size.y < size_min) size_min = b->size.y;
+        if (b->size.z < size_min) size_min = b->size.z;
+        if (b->size.y > size_max) size_max = b->size.y;
+        if (b->size.z > size_max) size_max = b->size.z;
+        if (size_min <= 0)
+            continue;
+
+        // Speed of the point of the box that moves the fastest
+        int64_t speed = (int64_t)nea_v3_length(b->velocity) +
+                        (((int64_t)nea_v3_length(b->angularVelocity) *
+                          size_max) >> 12);
+
+        // Distance moved in one frame divided by half the half-extent
+        int64_t need = (speed * 2) / ((int64_t)size_min * 60) + 1;
+        if (need > NEA_RB7_MAX_SUBSTEPS)
+            need = NEA_RB7_MAX_SUBSTEPS;
+        if (need > steps)
+            steps = (int)need;
+    }
+
+    return steps;
+}
+
+// Average cost of one sub-step in cycles, used to fit the frame in the budget
+static uint32_t nea_rb7_substep_cycles = 0;
+
+ARM_CODE int nea_rb7_step(void)
+{
+    // The time of the commands has already been measured by nea_rb7_listen()
+    NEA_RB_Stats stats = { 0 };
+    stats.ipc_cycles = nea_rb7_stats.ipc_cycles;
+    nea_rb7_stats = stats;
+
+    if (!nea_rb7_running)
+        return 0;
+
+    int steps = nea_rb7_plan_substeps();
+    if (steps == 0)
+        return 0; // Everything is asleep
+
+    uint32_t budget = nea_rb7_step_budget;
+    if (budget > 0 && nea_rb7_substep_cycles > 0)
+    {
+        uint32_t affordable = budget / nea_rb7_substep_cycles;
+        if (affordable < 1)
+            affordable = 1;
+        if ((uint32_t)steps > affordable)
+            steps = affordable;
     }
+
+    // Fixed timestep in each frame: dt = 1.0 / (60 * steps) in f32
+    // 60 FPS, 2 substeps = dt ~= 0.00833 = 34 in f32
+    int32_t dt = (1 << 12) / (60 * steps);
+
+    cpuStartTiming(NEA_RB7_TIMER);
+
+    int runs = 0;
+    for (int i = 0; i < steps; i++)
+    {
+        // A bisection runs this sub-step again as two halves. Only allow it if
+        // the rest of the frame still fits in the budget afterwards.
+        int bisections = NEA_RB7_MAX_BISECTIONS;
+        if (budget > 0)
+        {
+            uint32_t left = (uint32_t)(steps - i + 2) * nea_rb7_substep_cycles;
+            if (cpuGetTiming() + left > budget)
+                bisections = 0;
+        }
+
+        runs += nea_rb7_update(dt, bisections);
+    }
+
+    uint32_t cycles = cpuEndTiming();
+
+    uint32_t cost = cycles / runs;
+    if (nea_rb7_substep_cycles == 0)
+        nea_rb7_substep_cycles = cost;
+    else
+        nea_rb7_substep_cycles = (nea_rb7_substep_cycles * 3 + cost) / 4;
+
+    nea_rb7_stats.substeps = runs;
+    nea_rb7_stats.cycles = cycles;
+
+    return runs;
+}
+
+void nea_rb7_sleep_check_all(void)
+{
+    for (int n = 0; n < nea_rb7_num_active; n++)
+        nea_rb7_check_sleep(&nea_rb7_bodies[nea_rb7_active[n]]);
 }
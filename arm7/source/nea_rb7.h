@@ -103,9 +103,38 @@ ARM_CODE static inline int32_t nea_sqrtf32(int32_t a)
     return (int32_t)(r << 6);
 }
 
+// Integer square root of a 64-bit value (bit-scanning, no division)
+ARM_CODE static inline uint32_t nea_sqrt64(uint64_t n)
+{
+    uint64_t r = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > n)
+        bit >>= 2;
+    while (bit != 0)
+    {
+        if (n >= r + bit)
+        {
+            n -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+        {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+// The squared length is kept with 24 fractional bits so that the result has
+// the full precision of f32. With nea_sqrtf32() normalized vectors could be
+// off by more than 1%, which made rotation matrices grow and shrink.
 static inline int32_t nea_v3_length(nea_vec3_t a)
 {
-    return nea_sqrtf32(nea_v3_dot(a, a));
+    uint64_t len_sq = (uint64_t)((int64_t)a.x * a.x) +
+                      (uint64_t)((int64_t)a.y * a.y) +
+                      (uint64_t)((int64_t)a.z * a.z);
+    return (int32_t)nea_sqrt64(len_sq);
 }
 
 static inline nea_vec3_t nea_v3_normalize(nea_vec3_t a)
@@ -159,7 +188,10 @@ nea_vec3_t nea_mat3_mul_vec(const int32_t *m, nea_vec3_t v);
 #define NEA_RB7_SLEEP_TIME         48   // Frames below threshold to sleep
 #define NEA_RB7_WAKE_MULTIPLIER    10   // Wake if energy > threshold * this
 #define NEA_RB7_PENETRATION_THRESHOLD (1 << 6) // 64 in f32 ~ 0.015 units
-#define NEA_RB7_SUBSTEPS           4    // Physics sub-steps per frame
+#define NEA_RB7_SUBSTEPS           2    // Sub-steps per frame of busy bodies
+#define NEA_RB7_MAX_SUBSTEPS       8    // Sub-steps per frame of fast bodies
+#define NEA_RB7_SOLVER_ITERATIONS  4    // Velocity iterations per sub-step
+#define NEA_RB7_RESTITUTION_THRESHOLD 256 // Min approach speed to bounce (f32)
 
 typedef struct {
     nea_vec3_t position;
@@ -179,6 +211,8 @@ typedef struct {
     int32_t friction;             // f32. Default 0.5.
 
     uint8_t numContacts;
+    uint8_t shape;                // NEA_RB_SHAPE_*. Round bodies use size.x
+                                  // as radius (see nea_rb7.c).
     bool used;
     bool sleep;
     uint16_t sleepCounter;
@@ -197,13 +231,39 @@ typedef struct {
 // Contact point
 typedef struct {
     nea_vec3_t point;             // World-space contact position
-    nea_vec3_t normal;            // Contact normal (body A -> B)
+    nea_vec3_t normal;            // Contact normal (towards body A)
     int32_t penetration;          // Penetration depth (positive = overlap)
     void *body;                   // Owning body (body A)
     void *target;                 // Other body pointer, or NULL for static
     uint8_t type;                 // 0 = body-body, 1 = body-AAR
+
+    // Persistent contact data. The key identifies the pair of features that
+    // touch, so that the impulses of the previous sub-step can be reused.
+    uint32_t key;
+    int32_t normalImpulse;        // Accumulated impulses (f32)
+    int32_t tangentImpulse[2];
+    nea_vec3_t tangent;           // First friction direction. The second
+                                  // one is normal x tangent.
+    int32_t normalMass;           // Effective masses (f32)
+    int32_t tangentMass[2];
+    int32_t bias;                 // Target normal velocity (f32)
 } nea_rb7_contact_t;
 
+// Contact keys: kind (2 bits), body ID (6 bits), other body, static or mesh
+// triangle index (16 bits), feature of the pair (8 bits).
+#define NEA_RB7_KEY_BODY        0
+#define NEA_RB7_KEY_STATIC      1
+#define NEA_RB7_KEY_EXTERNAL    2
+#define NEA_RB7_KEY_MESH        3
+
+#define NEA_RB7_CONTACT_KEY(kind, body, other, feature) \
+    (((uint32_t)(kind) << 30) | ((uint32_t)(body) << 24) | \
+     ((uint32_t)(other) << 8) | (uint32_t)(feature))
+
+#if NEA_RB_MAX_BODIES > 64
+#error "Contact keys only have 6 bits for body IDs"
+#endif
+
 // Body state backup for adaptive timestep bisection
 typedef struct {
     nea_vec3_t position;
@@ -215,7 +275,11 @@ typedef struct {
     int32_t transform[9];
 } nea_rb7_backup_t;
 
-#define NEA_RB7_MAX_BISECTIONS  2    // Max bisection retries (min dt = original/4)
+#define NEA_RB7_MAX_BISECTIONS  1    // Max bisection retries (min dt = original/2)
+
+// The step is timed with this timer and the next one (see cpuStartTiming()).
+// Timer 0 is used by Maxmod and timer 1 by the RTC.
+#define NEA_RB7_TIMER           2
 
 // =========================================================================
 // Global state
@@ -225,8 +289,12 @@ extern nea_rb7_body_t    nea_rb7_bodies[NEA_RB_MAX_BODIES];
 extern nea_rb7_aar_t     nea_rb7_statics[NEA_RB_MAX_STATICS];
 extern nea_rb7_contact_t nea_rb7_contacts[NEA_RB_MAX_CONTACTS];
 extern int               nea_rb7_num_contacts;
+extern uint8_t           nea_rb7_active[NEA_RB_MAX_BODIES]; // Sorted IDs
+extern int               nea_rb7_num_active;
 extern int32_t           nea_rb7_gravity;     // f32, Y-axis
 extern bool              nea_rb7_running;
+extern uint32_t          nea_rb7_step_budget; // Cycles per frame, 0 = no limit
+extern NEA_RB_Stats      nea_rb7_stats;       // Profile of the last frame
 
 // =========================================================================
 // Public functions (ARM7 internal)
@@ -235,11 +303,15 @@ extern bool              nea_rb7_running;
 // Simulation
 void nea_rb7_init(void);
 void nea_rb7_reset(void);
-void nea_rb7_update(void);            // One sub-step
+int  nea_rb7_step(void);              // One frame, returns sub-steps run
+int  nea_rb7_update(int32_t dt, int max_bisections); // One sub-step
 void nea_rb7_sleep_check_all(void);   // Run once per frame (not per sub-step)
 
 // Body management
-int  nea_rb7_create_body(nea_vec3_t size, int32_t mass, nea_vec3_t pos);
+void nea_rb7_init_body(int id, int shape, nea_vec3_t size, int32_t mass,
+                       nea_vec3_t pos);
+int  nea_rb7_create_body(int shape, nea_vec3_t size, int32_t mass,
+                         nea_vec3_t pos);
 void nea_rb7_destroy_body(int id);
 
 // Force / impulse
@@ -247,11 +319,16 @@ void nea_rb7_apply_force(int id, nea_vec3_t force, nea_vec3_t point);
 void nea_rb7_apply_impulse(int id, nea_vec3_t impulse, nea_vec3_t point);
 
 // Static colliders
+void nea_rb7_set_static(int id, nea_vec3_t pos, nea_vec3_t size,
+                        nea_vec3_t normal);
 int  nea_rb7_add_static(nea_vec3_t pos, nea_vec3_t size, nea_vec3_t normal);
 void nea_rb7_remove_static(int id);
+void nea_rb7_set_mesh(const NEA_RB_MeshTriangle *tris, int num_tris,
+                      const NEA_RB_MeshNode *nodes, int num_nodes,
+                      nea_vec3_t pos);
 
 // IPC
 void nea_rb7_listen(void);       // Process ARM9 commands
-void nea_rb7_send_state(void);   // Send body states to ARM9
+void nea_rb7_send_state(void);   // Publish body states to ARM9
 
 #endif // NEA_RB7_H__
@@ -277,6 +277,12 @@ class NEA_SceneNodeProps(bpy.types.PropertyGroup):
         description="Node and its children are visible on load",
         default=True,
     )
+    is_static: BoolProperty(
+        name="Static",
+        description="Mesh never moves, it is merged with other static "
+                    "meshes that use the same material when it is loaded",
+        default=False,
+    )
     script_id: IntProperty(
         name="Script ID",
         description="Identifier for trigger scripts (0-255)",
@@ -517,6 +523,7 @@ def _collect_scene_nodes(context, scale):
                 'asset_index': 0,
                 'material_index': 0xFFFF,
                 'is_animated': False,
+                'static': props.is_static,
             }
         elif ntype == 'camera':
             # Compute look-at direction from camera's forward vector
@@ -656,10 +663,11 @@ def _write_neascene_binary(output_path, nodes, assets, mat_refs,
             type_str = node.get('type', 'empty')
             if type_str == 'mesh':
                 mesh = node.get('mesh', {})
-                struct.pack_into('<HHB', buf, 60,
+                struct.pack_into('<HHBB', buf, 60,
                                  mesh.get('asset_index', 0),
                                  mesh.get('material_index', 0xFFFF),
-                                 1 if mesh.get('is_animated', False) else 0)
+                                 1 if mesh.get('is_animated', False) else 0,
+                                 1 if mesh.get('static', False) else 0)
             elif type_str == 'camera':
                 cam = node.get('camera', {})
                 to = cam.get('to', [0.0, 0.0, -1.0])
@@ -787,6 +795,9 @@ class OBJECT_PT_nea_scene_node(bpy.types.Panel):
 
         resolved = _resolve_node_type(obj)
 
+        if resolved == 'mesh':
+            layout.prop(props, "is_static")
+
         if resolved == 'camera':
             layout.prop(props, "is_active_camera")
 
@@ -1401,6 +1412,19 @@ class NEA_ToolSettings(bpy.types.PropertyGroup):
         name="Multi-Material (DLMM)", default=False)
     obj2dl_collision: BoolProperty(
         name="Generate .colmesh", default=False)
+    obj2dl_bake_lighting: BoolProperty(
+        name="Bake Lighting",
+        description="Bake the sun lamps of the scene into vertex colors and "
+                    "export the mesh without normals",
+        default=False)
+    obj2dl_bake_ambient: FloatVectorProperty(
+        name="Ambient", subtype='COLOR', size=3, min=0.0, max=1.0,
+        default=(0.25, 0.25, 0.25))
+    obj2dl_bake_ao: IntProperty(
+        name="AO Rays", description="Ambient occlusion rays per vertex",
+        default=0, min=0, max=256)
+    obj2dl_bake_ao_distance: FloatProperty(
+        name="AO Distance", default=1.0, min=0.001, max=1000.0)
     md5_mesh_path: StringProperty(
         name="MD5mesh File",
         description="Path to the .md5mesh file",
@@ -1990,6 +2014,25 @@ class NEA_OT_RunObj2dl(bpy.types.Operator):
             cmd.append('--multi-material')
         if ts.obj2dl_collision:
             cmd.append('--collision')
+        if ts.obj2dl_bake_lighting:
+            cmd.append('--bake-lighting')
+            for lamp in context.scene.objects:
+                if lamp.type != 'LIGHT' or lamp.data.type != 'SUN':
+                    continue
+                if lamp.hide_render:
+                    continue
+                # Suns shine along their local -Z axis. Convert the direction
+                # to the axes used by the OBJ export (forward -Z, up Y).
+                d = lamp.matrix_world.to_3x3() @ mu.Vector((0.0, 0.0, -1.0))
+                c = lamp.data.color * min(lamp.data.energy, 1.0)
+                cmd.append('--bake-light')
+                cmd.extend(str(v) for v in (d.x, d.z, -d.y, c[0], c[1], c[2]))
+            cmd.append('--bake-ambient')
+            cmd.extend(str(v) for v in ts.obj2dl_bake_ambient)
+            if ts.obj2dl_bake_ao > 0:
+                cmd.extend(['--bake-ao', str(ts.obj2dl_bake_ao),
+                            '--bake-ao-distance',
+                            str(ts.obj2dl_bake_ao_distance)])
 
         print(f"NEA: Running: {' '.join(cmd)}")
         if not _run_tool(cmd, self.report):
@@ -2208,6 +2251,11 @@ class VIEW3D_PT_nea_tools(bpy.types.Panel):
         box.prop(ts, "obj2dl_vertex_color")
         box.prop(ts, "obj2dl_multi_material")
         box.prop(ts, "obj2dl_collision")
+        box.prop(ts, "obj2dl_bake_lighting")
+        if ts.obj2dl_bake_lighting:
+            box.prop(ts, "obj2dl_bake_ambient")
+            box.prop(ts, "obj2dl_bake_ao")
+            box.prop(ts, "obj2dl_bake_ao_distance")
         row = box.row()
         row.scale_y = 1.4
         row.operator("nea.run_obj2dl", icon='EXPORT')
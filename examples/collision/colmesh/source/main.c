@@ -7,7 +7,8 @@
 // Example: Triangle mesh collision (ColMesh) with --collision generated data.
 // A sphere and animated robot fall onto a teapot used as a colmesh obstacle.
 // The robot uses per-bone collision (NEA_BoneCollisionData) for accurate
-// collision with the sphere against its animated skeleton.
+// collision with the sphere against its animated skeleton. The sphere and the
+// robot have blob shadows projected on the teapot.
 
 #include <NEAMain.h>
 
@@ -26,8 +27,34 @@ typedef struct {
     NEA_Physics *Physics[3];
     NEA_BoneCollisionData *BonCol;
     int hit_bone;           // last bone hit by sphere (-1 = none)
+    NEA_BlobShadowBatch *Shadows;
 } SceneData;
 
+// Texture of the blob shadows: black, with an alpha that fades from the center
+#define BLOB_SIZE 32
+
+static u8 blob_texels[BLOB_SIZE * BLOB_SIZE]; // A5PAL8
+static const u16 blob_palette[8] = { 0 };
+
+static void GenerateBlobTexture(void)
+{
+    const int r2 = BLOB_SIZE * BLOB_SIZE;
+
+    for (int y = 0; y < BLOB_SIZE; y++)
+    {
+        for (int x = 0; x < BLOB_SIZE; x++)
+        {
+            int dx = 2 * x + 1 - BLOB_SIZE;
+            int dy = 2 * y + 1 - BLOB_SIZE;
+            int d2 = dx * dx + dy * dy;
+
+            int alpha = (d2 < r2) ? (31 * (r2 - d2)) / r2 : 0;
+
+            blob_texels[y * BLOB_SIZE + x] = alpha << 3;
+        }
+    }
+}
+
 static void ResetScene(SceneData *Scene)
 {
     NEA_ModelSetCoord(Scene->Model[1], -1, 5, 0);
@@ -54,6 +81,9 @@ void Draw3DScene(void *arg)
     // Robot (textured)
     NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, 0);
     NEA_ModelDraw(Scene->Model[2]);
+
+    // All shadows are drawn with one material bind
+    NEA_BlobShadowBatchDraw(Scene->Shadows);
 }
 
 int main(int argc, char *argv[])
@@ -153,6 +183,24 @@ int main(int argc, char *argv[])
     NEA_PhysicsOnCollision(Scene.Physics[2], NEA_ColBounce);
     NEA_PhysicsSetBounceEnergy(Scene.Physics[2], 50);
 
+    // Blob shadows on the teapot
+    GenerateBlobTexture();
+
+    NEA_Material *BlobMat = NEA_MaterialCreate();
+    NEA_MaterialTexLoad(BlobMat, NEA_A5PAL8, BLOB_SIZE, BLOB_SIZE,
+                        NEA_TEXGEN_TEXCOORD, blob_texels);
+
+    NEA_Palette *BlobPal = NEA_PaletteCreate();
+    NEA_PaletteLoad(BlobPal, blob_palette, 8, NEA_A5PAL8);
+    NEA_MaterialSetPalette(BlobMat, BlobPal);
+
+    Scene.Shadows = NEA_BlobShadowBatchCreate(2);
+    NEA_BlobShadowBatchSetMaterial(Scene.Shadows, BlobMat);
+    NEA_BlobShadowBatchSetGround(Scene.Shadows, &teapot_shape,
+                                 NEA_Vec3Make(0, 0, 0));
+    NEA_BlobShadowBatchSetRange(Scene.Shadows, 6);
+    NEA_BlobShadowBatchSetParams(Scene.Shadows, NEA_Black, 24, 1);
+
     ResetScene(&Scene);
 
     printf("ColMesh Demo\n\n");
@@ -204,13 +252,20 @@ int main(int argc, char *argv[])
             // Push sphere out along collision normal
             NEA_Vec3 push = NEA_Vec3Scale(bone_result.normal,
                                           bone_result.depth);
-            Scene.Model[1]->x -= push.x;
-            Scene.Model[1]->y -= push.y;
-            Scene.Model[1]->z -= push.z;
+            NEA_ModelTranslateI(Scene.Model[1], -push.x, -push.y, -push.z);
         }
 
         printf("\x1b[10;0HBone hit: %3d  ", Scene.hit_bone);
 
+        // Find the ground under the sphere and the robot. The ray of the robot
+        // starts a bit above its feet.
+        NEA_BlobShadowBatchClear(Scene.Shadows);
+        NEA_BlobShadowBatchAddI(Scene.Shadows, sphere_pos.x, sphere_pos.y,
+                                sphere_pos.z, floattof32(0.5));
+        NEA_BlobShadowBatchAddI(Scene.Shadows, Scene.Model[2]->x,
+                                Scene.Model[2]->y + floattof32(0.5),
+                                Scene.Model[2]->z, floattof32(0.75));
+
         NEA_ProcessArg(Draw3DScene, &Scene);
     }
 
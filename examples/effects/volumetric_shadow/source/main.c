@@ -9,14 +9,46 @@
 #include "teapot_bin.h"
 #include "teapot.h"
 
+// Polygon IDs of the shadows. Each caster is drawn with the ID of its shadow so
+// that it doesn't cast a shadow on itself, but it can receive the shadows of
+// other casters.
+#define TEAPOT_ID 62
+#define LID_ID    63
+
 typedef struct {
     NEA_Camera *Camera;
     NEA_Model *Teapot;
     NEA_Material *Material;
 
+    NEA_ShadowVolume *TeapotShadow;
+    NEA_ShadowVolume *LidShadow;
+
+    int32_t light[3]; // Direction of the light (f32)
+
     bool draw_edges;
 } SceneData;
 
+// Thin box under the lid, used to generate its shadow volume
+static const NEA_Vec3 lid_vertices[8] = {
+    { floattof32(-0.75), floattof32(2.95), floattof32(-0.75) },
+    { floattof32(0.75), floattof32(2.95), floattof32(-0.75) },
+    { floattof32(-0.75), floattof32(3), floattof32(-0.75) },
+    { floattof32(0.75), floattof32(3), floattof32(-0.75) },
+    { floattof32(-0.75), floattof32(2.95), floattof32(0.75) },
+    { floattof32(0.75), floattof32(2.95), floattof32(0.75) },
+    { floattof32(-0.75), floattof32(3), floattof32(0.75) },
+    { floattof32(0.75), floattof32(3), floattof32(0.75) },
+};
+
+static const uint16_t lid_indices[12 * 3] = {
+    0, 1, 3, 0, 3, 2, // Back
+    4, 6, 7, 4, 7, 5, // Front
+    0, 4, 5, 0, 5, 1, // Bottom
+    2, 3, 7, 2, 7, 6, // Top
+    0, 2, 6, 0, 6, 4, // Left
+    1, 5, 7, 1, 7, 3, // Right
+};
+
 void DrawFloor(void)
 {
     NEA_PolyNormal(0, -0.97, 0);
@@ -59,123 +91,51 @@ void DrawLid(void)
     NEA_PolyEnd();
 }
 
-void DrawShadowVolume(void)
-{
-    // Lid
-
-    NEA_PolyBegin(GL_QUAD);
-
-        NEA_PolyVertex(-0.75, 3, -0.75);
-        NEA_PolyVertex(-0.75, 3,  0.75);
-        NEA_PolyVertex( 0.75, 3,  0.75);
-        NEA_PolyVertex( 0.75, 3, -0.75);
-
-    NEA_PolyEnd();
-
-    // Walls
-
-    NEA_PolyBegin(GL_QUAD_STRIP);
-
-        NEA_PolyVertex(-0.75, 3, -0.75);
-        NEA_PolyVertex(-0.75, 0, -0.75);
-        NEA_PolyVertex(-0.75, 3,  0.75);
-        NEA_PolyVertex(-0.75, 0,  0.75);
-
-        NEA_PolyVertex( 0.75, 3,  0.75);
-        NEA_PolyVertex( 0.75, 0,  0.75);
-
-        NEA_PolyVertex( 0.75, 3, -0.75);
-        NEA_PolyVertex( 0.75, 0, -0.75);
-
-        NEA_PolyVertex(-0.75, 3, -0.75);
-        NEA_PolyVertex(-0.75, 0, -0.75);
-
-    NEA_PolyEnd();
-
-    // Bottom
-
-    NEA_PolyBegin(GL_QUAD);
-
-        NEA_PolyVertex(-0.75, 0, -0.75);
-        NEA_PolyVertex(-0.75, 0,  0.75);
-        NEA_PolyVertex( 0.75, 0,  0.75);
-        NEA_PolyVertex( 0.75, 0, -0.75);
-
-    NEA_PolyEnd();
-}
-
-void Draw3DSceneBright(void *arg)
+void Draw3DScene(SceneData *Scene, u32 light_color, u32 shadow_color)
 {
-    NEA_LightSet(0, NEA_White, 0, -0.97, -0.0);
-
-    SceneData *Scene = arg;
+    NEA_LightSetI(0, light_color, Scene->light[0] >> 3, Scene->light[1] >> 3,
+                  Scene->light[2] >> 3);
 
     // Set camera
     NEA_CameraUse(Scene->Camera);
 
-    // Set polygon format for regular models
-    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, NEA_MODULATION);
-
-    // Draw regular models
+    // Draw regular models. The casters use the polygon ID of their shadows.
+    NEA_PolyFormat(31, TEAPOT_ID, NEA_LIGHT_0, NEA_CULL_BACK, NEA_MODULATION);
     NEA_ModelDraw(Scene->Teapot);
 
     NEA_MaterialUse(Scene->Material);
+
+    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, NEA_MODULATION);
     DrawFloor();
-    DrawLid();
 
-    // Draw shadow volume as a black volume (shadow)
-    NEA_MaterialUse(NULL);
-    NEA_PolyColor(NEA_Black);
+    NEA_PolyFormat(31, LID_ID, NEA_LIGHT_0, NEA_CULL_BACK, NEA_MODULATION);
+    DrawLid();
 
     if (Scene->draw_edges)
     {
-        // Draw the shadow volume in wireframe mode to see where it is
+        // Draw the shadow volumes in wireframe mode to see where they are
+        NEA_MaterialUse(NULL);
         NEA_PolyFormat(0, 0, 0, NEA_CULL_NONE, NEA_MODULATION);
-        DrawShadowVolume();
+        NEA_PolyColor(shadow_color);
+        NEA_ShadowVolumeDrawList(Scene->LidShadow, NULL);
+        NEA_ShadowVolumeDrawListModel(Scene->TeapotShadow, Scene->Teapot);
     }
 
-    NEA_PolyFormat(1, 0, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
-    DrawShadowVolume();
+    NEA_ShadowVolumeDraw(Scene->LidShadow, NULL, shadow_color, 20, LID_ID);
+    NEA_ShadowVolumeDrawModel(Scene->TeapotShadow, Scene->Teapot,
+                              shadow_color, 20, TEAPOT_ID);
+}
 
-    NEA_PolyFormat(20, 63, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
-    DrawShadowVolume();
+void Draw3DSceneBright(void *arg)
+{
+    // Draw shadow volumes as a black volume (shadow)
+    Draw3DScene(arg, NEA_White, NEA_Black);
 }
 
 void Draw3DSceneDark(void *arg)
 {
-    NEA_LightSet(0, RGB15(8, 8, 8), 0, -0.97, -0.0);
-
-    SceneData *Scene = arg;
-
-    // Set camera
-    NEA_CameraUse(Scene->Camera);
-
-    // Set polygon format for regular models
-    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, NEA_MODULATION);
-
-    // Draw regular models
-    NEA_ModelDraw(Scene->Teapot);
-
-    NEA_MaterialUse(Scene->Material);
-    DrawFloor();
-    DrawLid();
-
-    // Draw shadow volume as a yellow volume (light)
-    NEA_MaterialUse(NULL);
-    NEA_PolyColor(RGB15(15, 15, 0));
-
-    if (Scene->draw_edges)
-    {
-        // Draw the shadow volume in wireframe mode to see where it is
-        NEA_PolyFormat(0, 0, 0, NEA_CULL_NONE, NEA_MODULATION);
-        DrawShadowVolume();
-    }
-
-    NEA_PolyFormat(1, 0, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
-    DrawShadowVolume();
-
-    NEA_PolyFormat(20, 63, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
-    DrawShadowVolume();
+    // Draw shadow volumes as a yellow volume (light)
+    Draw3DScene(arg, RGB15(8, 8, 8), RGB15(15, 15, 0));
 }
 
 int main(int argc, char *argv[])
@@ -227,9 +187,21 @@ int main(int argc, char *argv[])
                           floattof32(0), floattof32(1.5), floattof32(0));
     }
 
+    // Generate the shadow volumes. The edges of the meshes are only found
+    // once, and the volumes are only built again when the light direction
+    // changes in the space of each object.
+    Scene.TeapotShadow = NEA_ShadowVolumeCreateFromList(teapot_bin);
+    Scene.LidShadow = NEA_ShadowVolumeCreate(lid_vertices, 8, lid_indices, 12);
+
+    NEA_ShadowVolumeSetExtrusion(Scene.TeapotShadow, 4);
+    NEA_ShadowVolumeSetExtrusion(Scene.LidShadow, 4);
+
+    int light_angle = 0;
+
     printf("\x1b[0;0H"
            "ABXY:    Rotate\n"
            "Pad:     Move\n"
+           "L/R:     Rotate light\n"
            "SELECT:  Show edges of shadow\n"
            "START:   Exit to loader\n");
 
@@ -261,6 +233,31 @@ int main(int argc, char *argv[])
         if (keys & KEY_A)
             NEA_ModelRotate(Scene.Teapot, 0, -2, 0);
 
+        if (keys & KEY_L)
+            light_angle -= 64;
+        if (keys & KEY_R)
+            light_angle += 64;
+
+        if (light_angle < -degreesToAngle(45))
+            light_angle = -degreesToAngle(45);
+        if (light_angle > degreesToAngle(45))
+            light_angle = degreesToAngle(45);
+
+        Scene.light[0] = sinLerp(light_angle);
+        Scene.light[1] = -cosLerp(light_angle);
+        Scene.light[2] = 0;
+
+        // Update the shadow volumes. They are only built again if the light
+        // or the teapot have rotated.
+        NEA_ShadowVolumeUpdateI(Scene.LidShadow, NULL, Scene.light[0],
+                                Scene.light[1], Scene.light[2]);
+        NEA_ShadowVolumeUpdateModelI(Scene.TeapotShadow, Scene.Teapot,
+                                     Scene.light[0], Scene.light[1],
+                                     Scene.light[2]);
+
+        printf("\x1b[6;0HVolume rebuilds: %lu %lu  ",
+               Scene.TeapotShadow->rebuilds, Scene.LidShadow->rebuilds);
+
         if (keys & KEY_SELECT)
             Scene.draw_edges = true;
         else
@@ -273,5 +270,8 @@ int main(int argc, char *argv[])
         NEA_ProcessDualArg(Draw3DSceneBright, Draw3DSceneDark, &Scene, &Scene);
     }
 
+    NEA_ShadowVolumeDelete(Scene.TeapotShadow);
+    NEA_ShadowVolumeDelete(Scene.LidShadow);
+
     return 0;
 }
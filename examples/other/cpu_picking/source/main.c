@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Antonio Niño Díaz, 2008-2024
+//
+// This file is part of Nitro Engine Advanced
+
+// The object under the stylus is found with NEA_PickStart() and
+// NEA_PickModel(), which test the bounding spheres of the models on the CPU.
+// The result is available in the same frame, without drawing the models again
+// like the touch test functions (NEA_TouchTestStart() and related functions).
+
+#include <NEAMain.h>
+
+#include "sphere_bin.h"
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Model *Model[10];
+
+    int object_touched;
+
+    int rotz, roty;
+} SceneData;
+
+// Places the camera on a sphere around the models, looking at the center
+void UpdateCamera(SceneData *Scene)
+{
+    int32_t sy = sinLerp(Scene->roty << 6), cy = cosLerp(Scene->roty << 6);
+    int32_t sz = sinLerp(Scene->rotz << 6), cz = cosLerp(Scene->rotz << 6);
+
+    int32_t dist = inttof32(4);
+
+    NEA_CameraSetI(Scene->Camera,
+                   -mulf32(mulf32(dist, cz), cy), mulf32(dist, sz),
+                   mulf32(mulf32(dist, cz), sy),
+                   0, 0, 0,
+                   0, inttof32(1), 0);
+}
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    // Picking only takes the camera into account, so the models must be drawn
+    // without any additional transformation.
+    NEA_CameraUse(Scene->Camera);
+
+    // Draw everything
+    for (int i = 0; i < 10; i++)
+    {
+        if (i == Scene->object_touched)
+            NEA_PolyFormat(31, 0, NEA_LIGHT_1, NEA_CULL_BACK, 0);
+        else
+            NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, 0);
+
+        NEA_ModelDraw(Scene->Model[i]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // Move 3D screen to lower screen
+    NEA_SwapScreens();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    // Init console in non-3D screen
+    consoleDemoInit();
+
+    for (int i = 0; i < 10; i++)
+        Scene.Model[i] = NEA_ModelCreate(NEA_Static);
+
+    // Allocate everything
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                 -4, 0, 0,
+                  0, 0, 0,
+                  0, 1, 0);
+
+    // Load model. The mesh doesn't have a bounding sphere, so it is set here.
+    for (int i = 0; i < 10; i++)
+    {
+        NEA_ModelLoadStaticMesh(Scene.Model[i], sphere_bin);
+        NEA_ModelSetBoundingSphere(Scene.Model[i], 0, 0, 0, 0.46);
+    }
+
+    // Set up lights
+    NEA_LightSet(0, NEA_Yellow, 0, -0.5, -0.5);
+    NEA_LightSet(1, NEA_Red, 0, -0.5, -0.5);
+
+    printf("Press any key to start...");
+
+    int framecount = 0;
+
+    while (1)
+    {
+        if (framecount < 30)
+            printf("\x1b[1;0H_");
+        else
+            printf("\x1b[1;0H ");
+
+        if (framecount == 60)
+            framecount = 0;
+
+        framecount++;
+
+        scanKeys();
+
+        // Set random coordinates
+        for (int i = 0; i < 10; i++)
+        {
+            NEA_ModelSetCoordI(Scene.Model[i],
+                (rand() & (inttof32(3) - 1)) - floattof32(1.5),
+                (rand() & (inttof32(3) - 1)) - floattof32(1.5),
+                (rand() & (inttof32(3) - 1)) - floattof32(1.5));
+        }
+
+        if (keysHeld())
+            break;
+
+        swiWaitForVBlank();
+    }
+
+    printf("\x1b[0;0H                         ");
+    printf("\x1b[1;0H ");
+
+    printf("\x1b[22;0HPAD: Rotate.");
+    printf("\x1b[23;0HSTART: New positions.");
+
+    while (1)
+    {
+        NEA_WaitForVBL(0);
+
+        scanKeys();
+        uint32_t keys = keysHeld();
+
+        // Rotate the camera around the models
+        if (keys & KEY_RIGHT)
+            Scene.roty--;
+        if (keys & KEY_LEFT)
+            Scene.roty++;
+        if ((keys & KEY_UP) && Scene.rotz < 120)
+            Scene.rotz++;
+        if ((keys & KEY_DOWN) && Scene.rotz > -120)
+            Scene.rotz--;
+
+        UpdateCamera(&Scene);
+
+        if (keysDown() & KEY_START)
+        {
+            // Set random coordinates
+            for (int i = 0; i < 10; i++)
+            {
+                NEA_ModelSetCoordI(Scene.Model[i],
+                    (rand() & (inttof32(3) - 1)) - floattof32(1.5),
+                    (rand() & (inttof32(3) - 1)) - floattof32(1.5) ,
+                    (rand() & (inttof32(3) - 1)) - floattof32(1.5));
+            }
+        }
+
+        Scene.object_touched = -1;
+
+        if (keys & KEY_TOUCH)
+        {
+            touchPosition touch;
+            touchRead(&touch);
+
+            // Find the closest model under the stylus
+            NEA_Pick pick;
+            if (NEA_PickStart(&pick, Scene.Camera, touch.px, touch.py))
+            {
+                for (int i = 0; i < 10; i++)
+                {
+                    if (NEA_PickModel(&pick, Scene.Model[i]))
+                        Scene.object_touched = i;
+                }
+            }
+        }
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// A ribbon that follows a moving point. Its geometry changes every frame, so it
+// is recorded into a double-buffered display list recorder and sent to the GPU
+// with one DMA transfer.
+
+#include <NEAMain.h>
+
+#define TRAIL_POINTS 48
+
+// Quad strip with 2 vertices per point, each one with a color and a vertex.
+// Commands take 3 words per vertex, plus one word of IDs every 4 commands.
+#define TRAIL_WORDS (TRAIL_POINTS * 2 * 4 + 8)
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_DisplayListRecorder *Recorder;
+    int32_t x[TRAIL_POINTS];
+    int32_t y[TRAIL_POINTS];
+    int count;
+} SceneData;
+
+void RecordTrail(SceneData *Scene)
+{
+    NEA_DisplayListRecordBegin(Scene->Recorder);
+
+    NEA_PolyFormat(31, 0, 0, NEA_CULL_NONE, 0);
+
+    NEA_PolyBegin(GL_QUAD_STRIP);
+
+    for (int i = 0; i < Scene->count; i++)
+    {
+        // The ribbon gets thinner and darker towards the tail
+        int32_t width = floattof32(0.15) * (Scene->count - i) / Scene->count;
+        int shade = 31 - (i * 24) / Scene->count;
+
+        NEA_PolyColor(RGB15(shade, shade / 2, 31 - shade));
+        NEA_PolyVertexI(Scene->x[i], Scene->y[i] + width, 0);
+
+        NEA_PolyColor(RGB15(shade, shade / 2, 31 - shade));
+        NEA_PolyVertexI(Scene->x[i], Scene->y[i] - width, 0);
+    }
+
+    NEA_PolyEnd();
+
+    if (NEA_DisplayListRecordEnd(Scene->Recorder) == 0)
+        printf("\x1b[4;0HList too small!");
+}
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    NEA_CameraUse(Scene->Camera);
+
+    NEA_DisplayListRecorderDraw(Scene->Recorder);
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+
+    // The list of the previous frame can still be sent while the new one is
+    // recorded, because it is in the other buffer.
+    NEA_DisplayListSetDefaultFunction(NEA_DL_DMA_GFX_FIFO_ASYNC);
+
+    consoleDemoInit();
+
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                  0, 0, 4,
+                  0, 0, 0,
+                  0, 1, 0);
+
+    Scene.Recorder = NEA_DisplayListRecorderCreate(TRAIL_WORDS, true);
+
+    int frame = 0;
+
+    while (1)
+    {
+        NEA_WaitForVBL(0);
+
+        scanKeys();
+        if (keysHeld() & KEY_START)
+            break;
+
+        // Move the trail and add the new head
+        if (Scene.count < TRAIL_POINTS)
+            Scene.count++;
+
+        for (int i = Scene.count - 1; i > 0; i--)
+        {
+            Scene.x[i] = Scene.x[i - 1];
+            Scene.y[i] = Scene.y[i - 1];
+        }
+
+        Scene.x[0] = sinLerp(frame * 150) * 3 / 2;
+        Scene.y[0] = cosLerp(frame * 230);
+        frame++;
+
+        RecordTrail(&Scene);
+
+        const uint32_t *list = NEA_DisplayListRecorderGet(Scene.Recorder);
+
+        printf("\x1b[0;0HSTART: Exit");
+        printf("\x1b[2;0HList size: %lu words   ", list ? list[0] : 0);
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+    }
+
+    NEA_DisplayListRecorderDelete(Scene.Recorder);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Stress test of animated models: up to 200 clones of the robot of the
+// animated_model example, each one with its own animation state. Press X to
+// make all of them members of one animation group with 4 phases, so that the
+// animation is only advanced once per frame and the pose cache of DSMA only
+// evaluates the skeleton 4 times.
+
+#include <NEAMain.h>
+
+#include "stress.h"
+
+#include "robot_dsm_bin.h"
+#include "robot_walk_dsa_bin.h"
+#include "robot_wave_dsa_bin.h"
+#include "texture.h"
+
+#define MAX_MODELS 200
+#define COLUMNS    20
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Model *Source;
+    NEA_Animation *Animation[2];
+    NEA_Model *Model[MAX_MODELS];
+    int count;
+    NEA_ModelAnimGroup *Group;
+} SceneData;
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, 0);
+
+    NEA_CameraUse(Scene->Camera);
+
+    for (int i = 0; i < Scene->count; i++)
+        NEA_ModelDraw(Scene->Model[i]);
+}
+
+static void JoinGroup(SceneData *Scene, int i)
+{
+    NEA_ModelAnimGroupJoin(Scene->Group, Scene->Model[i],
+                           i % NEA_ANIM_GROUP_MAX_PHASES);
+}
+
+static void SetCount(SceneData *Scene, int count)
+{
+    // Clones are created in a grid, and they all share the mesh and material
+    // of the source model.
+    while (Scene->count < count)
+    {
+        int i = Scene->count;
+        NEA_Model *model = NEA_ModelCreate(NEA_Animated);
+        NEA_ModelClone(model, Scene->Source);
+
+        NEA_ModelSetAnimation(model, Scene->Animation[i & 1]);
+        NEA_ModelAnimStart(model, NEA_ANIM_LOOP, floattof32(0.1));
+        NEA_ModelAnimSetFrame(model, inttof32(i % 16));
+
+        NEA_ModelSetCoordI(model, inttof32(i % COLUMNS - COLUMNS / 2) * 2,
+                           0, inttof32(i / COLUMNS) * 2);
+
+        Scene->Model[i] = model;
+        Scene->count++;
+
+        if (Scene->Group != NULL)
+            JoinGroup(Scene, i);
+    }
+
+    while (Scene->count > count)
+    {
+        Scene->count--;
+        NEA_ModelDelete(Scene->Model[Scene->count]);
+    }
+}
+
+static void ToggleGroup(SceneData *Scene)
+{
+    if (Scene->Group != NULL)
+    {
+        for (int i = 0; i < Scene->count; i++)
+            NEA_ModelAnimGroupLeave(Scene->Model[i]);
+
+        Scene->Group = NULL;
+        return;
+    }
+
+    Scene->Group = NEA_ModelAnimGroupCreate(Scene->Model[0]);
+    if (Scene->Group == NULL)
+        return;
+
+    for (int p = 0; p < NEA_ANIM_GROUP_MAX_PHASES; p++)
+        NEA_ModelAnimGroupSetPhaseI(Scene->Group, p, inttof32(p * 4));
+
+    for (int i = 1; i < Scene->count; i++)
+        JoinGroup(Scene, i);
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    NEA_ModelSystemReset(MAX_MODELS + 1);
+
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                  0, 12, -12,
+                  0, 0, 8,
+                  0, 1, 0);
+
+    // The clones are created from this model, which isn't drawn
+    Scene.Source = NEA_ModelCreate(NEA_Animated);
+    NEA_ModelLoadDSM(Scene.Source, robot_dsm_bin);
+
+    Scene.Animation[0] = NEA_AnimationCreate();
+    NEA_AnimationLoad(Scene.Animation[0], robot_walk_dsa_bin);
+    Scene.Animation[1] = NEA_AnimationCreate();
+    NEA_AnimationLoad(Scene.Animation[1], robot_wave_dsa_bin);
+    NEA_ModelSetAnimation(Scene.Source, Scene.Animation[0]);
+
+    NEA_Material *Texture = NEA_MaterialCreate();
+    NEA_MaterialTexLoad(Texture, NEA_A1RGB5, 256, 256, NEA_TEXGEN_TEXCOORD,
+                        textureBitmap);
+    NEA_ModelSetMaterial(Scene.Source, Texture);
+
+    NEA_LightSet(0, NEA_White, -0.9, -0.5, 0);
+    NEA_ClearColorSet(NEA_Black, 31, 63);
+
+    StressInit("animated_models", 20, MAX_MODELS, 20, MAX_MODELS);
+    SetCount(&Scene, MAX_MODELS);
+
+    printf("\x1b[21;0HX: Animation group (off)");
+
+    while (1)
+    {
+        NEA_WaitForVBL(NEA_UPDATE_ANIMATIONS);
+
+        scanKeys();
+        uint32_t keys = keysDown();
+
+        if (keys & KEY_START)
+            break;
+
+        // The first model is never deleted, so the group is kept
+        int count = StressUpdate();
+        if (count != Scene.count)
+            SetCount(&Scene, count);
+
+        if (keys & KEY_X)
+        {
+            ToggleGroup(&Scene);
+            printf("\x1b[21;0HX: Animation group (%s)",
+                   Scene.Group ? "on " : "off");
+        }
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+
+        StressPrint();
+    }
+
+    return 0;
+}
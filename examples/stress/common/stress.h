@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Code shared by the stress tests. Every test draws a number of objects that
+// can be changed with UP and DOWN, and it shows the frame time, the polygons
+// and vertices drawn and the CPU usage on the console. If the library and the
+// test are built with "make NEA_PROFILE=1", the scopes of the profiler and the
+// counters of the engine are shown too.
+//
+// Pressing A starts a sweep: the test goes from the minimum to the maximum
+// number of objects, and it measures each step for STRESS_SWEEP_FRAMES frames.
+// The results are sent to the debug console of the emulator with one line per
+// step so that they can be parsed by scripts:
+//
+//     STRESS <test> <objects> <avg. frame cycles> <peak frame cycles> <cpu %>
+//
+// The last line is "STRESS <test> done". Frame times are measured between
+// calls to NEA_WaitForVBL() with the cascaded timers 0 and 1, which count bus
+// cycles (33.51 MHz, 560190 cycles per frame). The console is only refreshed
+// every STRESS_HUD_FRAMES frames so that printing doesn't dominate the results.
+
+#ifndef STRESS_H__
+#define STRESS_H__
+
+#include <stdio.h>
+
+#include <NEAMain.h>
+
+#define STRESS_SWEEP_SETTLE 30  // Frames ignored after changing the count
+#define STRESS_SWEEP_FRAMES 120 // Frames measured per step of a sweep
+#define STRESS_HUD_FRAMES   16  // Frames between refreshes of the console
+
+#define STRESS_CYCLES_PER_MS 33514
+
+typedef struct {
+    const char *name;
+    int count, min, max, step;
+    bool sweeping;
+
+    // Frames since the count changed, and results of the current step
+    int frames;
+    int measured;
+    u64 total_cycles;
+    u32 peak_cycles;
+    int total_cpu;
+
+    // Average frame time since the last refresh of the console
+    u32 hud_cycles;
+    int hud_frames;
+} StressState;
+
+static StressState Stress;
+
+// Prints the controls. Call it once after setting up the console.
+static void StressInit(const char *name, int min, int max, int step, int count)
+{
+    Stress = (StressState){ 0 };
+    Stress.name = name;
+    Stress.min = min;
+    Stress.max = max;
+    Stress.step = step;
+    Stress.count = count;
+
+#ifdef NEA_PROFILE
+    NEA_GPUStatsEnable(true);
+#endif
+
+    printf("\x1b[22;0HUP/DOWN: Objects  A: Sweep\n");
+    printf("B: Stop sweep     START: Exit");
+
+    cpuStartTiming(0);
+}
+
+static void StressSetCount(int count)
+{
+    if (count < Stress.min)
+        count = Stress.min;
+    if (count > Stress.max)
+        count = Stress.max;
+
+    Stress.count = count;
+    Stress.frames = 0;
+    Stress.measured = 0;
+    Stress.total_cycles = 0;
+    Stress.peak_cycles = 0;
+    Stress.total_cpu = 0;
+}
+
+// Call it right after NEA_WaitForVBL() and scanKeys(). It returns the number of
+// objects to draw this frame.
+static int StressUpdate(void)
+{
+    u32 cycles = cpuGetTiming();
+    cpuStartTiming(0);
+
+    Stress.hud_cycles += cycles;
+    Stress.hud_frames++;
+
+    uint32_t down = keysDown();
+
+    if (down & KEY_A)
+    {
+        Stress.sweeping = true;
+        StressSetCount(Stress.min);
+        return Stress.count;
+    }
+
+    if (down & KEY_B)
+        Stress.sweeping = false;
+
+    if (!Stress.sweeping)
+    {
+        if (down & KEY_UP)
+            StressSetCount(Stress.count + Stress.step);
+        else if (down & KEY_DOWN)
+            StressSetCount(Stress.count - Stress.step);
+
+        return Stress.count;
+    }
+
+    // The first frames after a change include the time of creating objects
+    Stress.frames++;
+    if (Stress.frames <= STRESS_SWEEP_SETTLE)
+        return Stress.count;
+
+    Stress.measured++;
+    Stress.total_cycles += cycles;
+    Stress.total_cpu += NEA_GetCPUPercent();
+    if (cycles > Stress.peak_cycles)
+        Stress.peak_cycles = cycles;
+
+    if (Stress.measured < STRESS_SWEEP_FRAMES)
+        return Stress.count;
+
+    char line[80];
+    snprintf(line, sizeof(line), "STRESS %s %d %lu %lu %d", Stress.name,
+             Stress.count, (u32)(Stress.total_cycles / Stress.measured),
+             Stress.peak_cycles, Stress.total_cpu / Stress.measured);
+    nocashMessage(line);
+
+    if (Stress.count >= Stress.max)
+    {
+        snprintf(line, sizeof(line), "STRESS %s done", Stress.name);
+        nocashMessage(line);
+        Stress.sweeping = false;
+        return Stress.count;
+    }
+
+    StressSetCount(Stress.count + Stress.step);
+    return Stress.count;
+}
+
+// Call it after NEA_Process() and before NEA_WaitForVBL(), so that the polygon
+// and vertex counts are the ones of the frame that has just been drawn.
+static void StressPrint(void)
+{
+    if (Stress.hud_frames < STRESS_HUD_FRAMES)
+        return;
+
+    u32 cycles = Stress.hud_cycles / Stress.hud_frames;
+    u32 us = (cycles * 1000ULL) / STRESS_CYCLES_PER_MS;
+
+    Stress.hud_cycles = 0;
+    Stress.hud_frames = 0;
+
+    printf("\x1b[0;0H%s%s  \n", Stress.name,
+           Stress.sweeping ? " (sweep)" : "");
+    printf("Objects: %d / %d    \n", Stress.count, Stress.max);
+    printf("Frame:   %lu.%02lu ms    \n", us / 1000, (us % 1000) / 10);
+    printf("CPU:     %d%%    \n", NEA_GetCPUPercent());
+    printf("Polys:   %d    \n", NEA_GetPolygonCount());
+    printf("Verts:   %d    \n", NEA_GetVertexCount());
+
+#ifdef NEA_PROFILE
+    NEA_Stats stats;
+    NEA_StatsGet(&stats);
+
+    printf("Models:  %lu (%lu culled)    \n", stats.models_drawn,
+           stats.models_culled);
+    printf("Col. pairs/tris: %lu/%lu    \n", stats.col_pair_tests,
+           stats.col_tri_tests);
+
+    char buffer[NEA_PROFILE_MAX_SCOPES * 32];
+    NEA_ProfileFormat(buffer, sizeof(buffer));
+    printf("\x1b[9;0HScope         Avg.   Peak\n%s", buffer);
+#endif
+}
+
+#endif // STRESS_H__
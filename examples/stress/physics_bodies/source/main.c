@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Stress test of the physics engine: up to 64 spheres fall onto the teapot of
+// the colmesh example, which is used as a triangle mesh level. The spheres
+// collide with the level and with each other, and they are thrown again from
+// the top when they fall off the level.
+
+#include <NEAMain.h>
+
+#include "stress.h"
+
+#include "sphere_bin.h"
+#include "teapot_bin.h"
+#include "teapot_col_bin.h"
+
+#define MAX_BODIES 64
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Model *Level;
+    NEA_Model *Source;
+    NEA_Model *Model[MAX_BODIES];
+    NEA_Physics *Physics[MAX_BODIES];
+    int count;
+} SceneData;
+
+// Same generator as the benchmarks, so that every run is the same
+static unsigned int seed = 12345;
+
+static unsigned int my_rand(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+// Random f32 value between -range and range
+static int32_t rand_f32(int32_t range)
+{
+    return (int32_t)(my_rand() % (2 * range + 1)) - range;
+}
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    NEA_CameraUse(Scene->Camera);
+
+    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, 0);
+    NEA_ModelDraw(Scene->Level);
+
+    NEA_PolyFormat(31, 0, NEA_LIGHT_1, NEA_CULL_BACK, 0);
+    for (int i = 0; i < Scene->count; i++)
+        NEA_ModelDraw(Scene->Model[i]);
+}
+
+static void Throw(SceneData *Scene, int i)
+{
+    NEA_ModelSetCoordI(Scene->Model[i], rand_f32(floattof32(3)),
+                       floattof32(6) + rand_f32(floattof32(2)),
+                       rand_f32(floattof32(3)));
+    NEA_PhysicsSetSpeedI(Scene->Physics[i], rand_f32(floattof32(0.02)), 0,
+                         rand_f32(floattof32(0.02)));
+}
+
+static void SetCount(SceneData *Scene, int count)
+{
+    while (Scene->count < count)
+    {
+        int i = Scene->count;
+
+        NEA_Model *model = NEA_ModelCreate(NEA_Static);
+        NEA_ModelClone(model, Scene->Source);
+
+        NEA_Physics *physics = NEA_PhysicsCreateEx(NEA_COL_SPHERE);
+        NEA_PhysicsSetModel(physics, model);
+        NEA_PhysicsSetRadius(physics, 0.5);
+        NEA_PhysicsEnable(physics, true);
+        NEA_PhysicsSetGravity(physics, 0.001);
+        NEA_PhysicsOnCollision(physics, NEA_ColBounce);
+        NEA_PhysicsSetBounceEnergy(physics, 60);
+
+        Scene->Model[i] = model;
+        Scene->Physics[i] = physics;
+        Scene->count++;
+
+        Throw(Scene, i);
+    }
+
+    while (Scene->count > count)
+    {
+        Scene->count--;
+        NEA_PhysicsDelete(Scene->Physics[Scene->count]);
+        NEA_ModelDelete(Scene->Model[Scene->count]);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    // The level uses one more physics object
+    NEA_PhysicsSystemReset(MAX_BODIES + 1);
+
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                  -7, 7, -7,
+                  0, 1, 0,
+                  0, 1, 0);
+
+    Scene.Level = NEA_ModelCreate(NEA_Static);
+    NEA_ModelLoadStaticMesh(Scene.Level, teapot_bin);
+
+    NEA_ColMesh *level_mesh = NEA_ColMeshLoad(teapot_col_bin);
+    NEA_ColShape level_shape;
+    NEA_ColShapeInitMesh(&level_shape, level_mesh);
+
+    NEA_Physics *level = NEA_PhysicsCreateEx(NEA_COL_TRIMESH);
+    NEA_PhysicsSetModel(level, Scene.Level);
+    NEA_PhysicsSetColShape(level, &level_shape);
+    NEA_PhysicsEnable(level, false); // Static obstacle
+
+    // The spheres are clones of this model, which isn't drawn
+    Scene.Source = NEA_ModelCreate(NEA_Static);
+    NEA_ModelLoadStaticMesh(Scene.Source, sphere_bin);
+
+    NEA_LightSet(0, NEA_Green, -1, -1, 0);
+    NEA_LightSet(1, NEA_Blue, -1, -1, 0);
+    NEA_ClearColorSet(NEA_Black, 31, 63);
+
+    StressInit("physics_bodies", 8, MAX_BODIES, 8, MAX_BODIES);
+    SetCount(&Scene, MAX_BODIES);
+
+    while (1)
+    {
+        NEA_WaitForVBL(NEA_UPDATE_PHYSICS);
+
+        scanKeys();
+        if (keysDown() & KEY_START)
+            break;
+
+        int count = StressUpdate();
+        if (count != Scene.count)
+            SetCount(&Scene, count);
+
+        for (int i = 0; i < Scene.count; i++)
+        {
+            if (Scene.Model[i]->y < floattof32(-4))
+                Throw(&Scene, i);
+        }
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+
+        StressPrint();
+    }
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Stress test of the scene system: a scene of up to 2000 nodes. The root has
+// 50 group nodes, and the remaining nodes are cubes split between the groups.
+// The groups rotate every frame, so the world matrices and bounds of all the
+// cubes are updated every frame.
+//
+// The scene is generated in RAM as a version 1 .neascene file, which is the
+// simplest version supported by the loader, and it's loaded again with
+// NEA_SceneLoad() whenever the number of nodes changes. Version 1 files store
+// the index of the parent of a node in one byte, so all group nodes must be in
+// the first 255 nodes.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <NEAMain.h>
+
+#include "stress.h"
+
+#include "cube_bin.h"
+
+#define MAX_NODES  2000
+#define NUM_GROUPS 50
+
+// Layout of version 1 files
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint16_t num_nodes;
+    uint16_t num_assets;
+    uint16_t num_mat_refs;
+    uint16_t active_camera_idx;
+} SceneHeader;
+
+#define NODE_SIZE 128
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Scene *Scene;
+    int count;
+    int angle;
+} SceneData;
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    NEA_PolyFormat(31, 0, NEA_LIGHT_0, NEA_CULL_BACK, 0);
+
+    // The scene doesn't have a camera node
+    NEA_CameraUse(Scene->Camera);
+
+    NEA_SceneDraw(Scene->Scene);
+}
+
+static void WriteNode(uint8_t *node, const char *name, NEA_NodeType type,
+                      uint8_t parent, int32_t x, int32_t y, int32_t z,
+                      int32_t scale)
+{
+    int32_t pos[3] = { x, y, z };
+    int32_t scl[3] = { scale, scale, scale };
+
+    strncpy((char *)node, name, NEA_NODE_NAME_LEN - 1);
+    node[24] = type;
+    node[25] = parent;
+    node[26] = 0;    // Tags
+    node[27] = 1;    // Visible
+    memcpy(node + 28, pos, sizeof(pos));
+    memcpy(node + 48, scl, sizeof(scl));
+
+    if (type == NEA_NODE_MESH)
+    {
+        uint16_t mesh[2] = { 0xFFFF, 0 }; // No asset, the mesh is set later
+        memcpy(node + 60, mesh, sizeof(mesh));
+    }
+}
+
+static NEA_Scene *CreateScene(int num_nodes)
+{
+    size_t size = sizeof(SceneHeader) + num_nodes * NODE_SIZE;
+    uint8_t *data = calloc(1, size);
+    if (data == NULL)
+        return NULL;
+
+    SceneHeader *header = (SceneHeader *)data;
+    header->magic = NEA_SCENE_MAGIC;
+    header->version = 1;
+    header->num_nodes = num_nodes;
+    header->active_camera_idx = 0xFFFF; // No camera node
+
+    uint8_t *node = data + sizeof(SceneHeader);
+    char name[NEA_NODE_NAME_LEN];
+
+    WriteNode(node, "root", NEA_NODE_EMPTY, 0xFF, 0, 0, 0, inttof32(1));
+
+    // Groups in a grid of 10 x 5
+    for (int i = 0; i < NUM_GROUPS; i++)
+    {
+        node += NODE_SIZE;
+        snprintf(name, sizeof(name), "group%d", i);
+        WriteNode(node, name, NEA_NODE_EMPTY, 0,
+                  inttof32(i % 10 - 5) * 3, 0, inttof32(i / 10) * 3,
+                  inttof32(1));
+    }
+
+    // Cubes in a spiral around their group
+    for (int i = 1 + NUM_GROUPS; i < num_nodes; i++)
+    {
+        int n = i - 1 - NUM_GROUPS;
+        int k = n / NUM_GROUPS;
+        int angle = (k * 37) & 511;
+
+        node += NODE_SIZE;
+        snprintf(name, sizeof(name), "cube%d", n);
+        WriteNode(node, name, NEA_NODE_MESH, 1 + (n % NUM_GROUPS),
+                  sinLerp(angle << 6), floattof32(0.05) * k,
+                  cosLerp(angle << 6), floattof32(0.1));
+    }
+
+    NEA_Scene *scene = NEA_SceneLoad(data, size);
+    free(data);
+
+    if (scene == NULL)
+        return NULL;
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *n = &scene->nodes[i];
+        if ((n->type != NEA_NODE_MESH) || (n->model == NULL))
+            continue;
+
+        NEA_ModelLoadStaticMesh(n->model, cube_bin);
+        NEA_SceneNodeTransformChanged(n);
+    }
+
+    return scene;
+}
+
+static void SetCount(SceneData *Scene, int count)
+{
+    if (Scene->Scene != NULL)
+        NEA_SceneFree(Scene->Scene);
+
+    Scene->Scene = CreateScene(count);
+    Scene->count = count;
+
+    if (Scene->Scene == NULL)
+    {
+        printf("\x1b[9;0HCan't create the scene");
+        while (1)
+            swiWaitForVBlank();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    // Every mesh node has its own model
+    NEA_ModelSystemReset(MAX_NODES);
+    NEA_SceneSystemReset(MAX_NODES);
+
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                  0, 10, -12,
+                  0, 0, 5,
+                  0, 1, 0);
+
+    NEA_LightSet(0, NEA_White, -0.5, -0.5, -0.5);
+    NEA_ClearColorSet(NEA_Black, 31, 63);
+
+    StressInit("scene_nodes", 250, MAX_NODES, 250, MAX_NODES);
+    SetCount(&Scene, MAX_NODES);
+
+    while (1)
+    {
+        NEA_WaitForVBL(0);
+
+        scanKeys();
+        if (keysDown() & KEY_START)
+            break;
+
+        int count = StressUpdate();
+        if (count != Scene.count)
+            SetCount(&Scene, count);
+
+        Scene.angle = (Scene.angle + 2) & 511;
+
+        for (int i = 1; i <= NUM_GROUPS; i++)
+        {
+            NEA_SceneNodeSetRot(&Scene.Scene->nodes[i], 0,
+                                (Scene.angle + i * 8) & 511, 0);
+        }
+
+        NEA_SceneUpdate(Scene.Scene);
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+
+        StressPrint();
+    }
+
+    NEA_SceneFree(Scene.Scene);
+    NEA_SceneSystemEnd();
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Stress test of the sound system: up to 32 looping spatial sound sources
+// attached to cubes that orbit around the listener, so the volume and panning
+// of all of them change every frame. There are more sources than Maxmod
+// voices, so the quietest ones become virtual, and they get a voice back when
+// they get louder.
+
+#include <NEAMain.h>
+
+#include "stress.h"
+
+#include "soundbank.h"
+#include "soundbank_bin.h"
+#include "cube_bin.h"
+
+#define MAX_SOURCES 32
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Model *Source;
+    NEA_Model *Cube[MAX_SOURCES];
+    NEA_SoundSource *Sound[MAX_SOURCES];
+    int count;
+    int angle;
+} SceneData;
+
+void Draw3DScene(void *arg)
+{
+    SceneData *Scene = arg;
+
+    NEA_CameraUse(Scene->Camera);
+
+    for (int i = 0; i < Scene->count; i++)
+        NEA_ModelDraw(Scene->Cube[i]);
+}
+
+static void SetCount(SceneData *Scene, int count)
+{
+    while (Scene->count < count)
+    {
+        int i = Scene->count;
+
+        NEA_Model *cube = NEA_ModelCreate(NEA_Static);
+        NEA_ModelClone(cube, Scene->Source);
+
+        // Alternate between two different sound effects
+        mm_word sfx_id = (i % 2 == 0) ? SFX_FIRE_EXPLOSION : SFX_NATURE;
+        NEA_SoundSource *sound = NEA_SoundSourceCreate(sfx_id);
+        NEA_SoundSourceSetModel(sound, cube);
+        NEA_SoundSourceSetDistance(sound, 2.0, 15.0);
+        NEA_SoundSourceSetLoop(sound, true);
+        NEA_SoundSourceSetLoopDelay(sound, (i % 2 == 0) ? 90 : 180);
+        NEA_SoundSourcePlay(sound);
+
+        Scene->Cube[i] = cube;
+        Scene->Sound[i] = sound;
+        Scene->count++;
+    }
+
+    while (Scene->count > count)
+    {
+        Scene->count--;
+        NEA_SoundSourceDelete(Scene->Sound[Scene->count]);
+        NEA_ModelDelete(Scene->Cube[Scene->count]);
+    }
+}
+
+// Every source orbits at a different distance and speed
+static void MoveCubes(SceneData *Scene)
+{
+    Scene->angle++;
+
+    for (int i = 0; i < Scene->count; i++)
+    {
+        int angle = (Scene->angle * (1 + (i & 3)) + i * 37) & 511;
+        int32_t radius = floattof32(2) + floattof32(0.5) * i;
+
+        NEA_ModelSetCoordI(Scene->Cube[i],
+                           mulf32(sinLerp(angle << 6), radius),
+                           floattof32(1),
+                           mulf32(cosLerp(angle << 6), radius));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    NEA_SoundSystemReset((mm_addr)soundbank_bin, MAX_SOURCES);
+
+    NEA_SfxLoad(SFX_FIRE_EXPLOSION);
+    NEA_SfxLoad(SFX_NATURE);
+
+    // The camera is the listener, in the center of the orbits
+    Scene.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Scene.Camera,
+                  0, 12, -4,
+                  0, 0, 0,
+                  0, 1, 0);
+    NEA_SoundSetListener(Scene.Camera);
+
+    // The cubes are clones of this model, which isn't drawn
+    Scene.Source = NEA_ModelCreate(NEA_Static);
+    NEA_ModelLoadStaticMesh(Scene.Source, cube_bin);
+
+    NEA_LightSet(0, NEA_White, -0.5, -0.5, -0.5);
+    NEA_ClearColorSet(NEA_Black, 31, 63);
+
+    StressInit("sound_sources", 4, MAX_SOURCES, 4, MAX_SOURCES);
+    SetCount(&Scene, MAX_SOURCES);
+
+    while (1)
+    {
+        NEA_WaitForVBL(NEA_UPDATE_SOUND);
+
+        scanKeys();
+        if (keysDown() & KEY_START)
+            break;
+
+        int count = StressUpdate();
+        if (count != Scene.count)
+            SetCount(&Scene, count);
+
+        MoveCubes(&Scene);
+
+        NEA_ProcessArg(Draw3DScene, &Scene);
+
+        StressPrint();
+    }
+
+    NEA_SoundSystemEnd();
+
+    return 0;
+}
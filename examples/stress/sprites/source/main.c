@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Stress test of the 2D system: up to 500 sprites bounce around the screen.
+// Press X to enable the batched mode of NEA_SpriteDrawAll(), and Y to rotate
+// the sprites, which makes them skip the batches.
+
+#include <NEAMain.h>
+
+#include "stress.h"
+
+#include "icon.h"
+
+#define MAX_SPRITES 500
+#define SPRITE_SIZE 16
+
+typedef struct {
+    NEA_Sprite *Sprite[MAX_SPRITES];
+    s16 x[MAX_SPRITES], y[MAX_SPRITES];
+    s8 dx[MAX_SPRITES], dy[MAX_SPRITES];
+    int count;
+    NEA_Material *Material;
+    bool batch;
+    bool rotate;
+    int angle;
+} SceneData;
+
+// Same generator as the benchmarks, so that every run is the same
+static unsigned int seed = 12345;
+
+static unsigned int my_rand(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+void Draw3DScene(void)
+{
+    NEA_2DViewInit();
+
+    NEA_SpriteDrawAll();
+}
+
+static void SetCount(SceneData *Scene, int count)
+{
+    while (Scene->count < count)
+    {
+        int i = Scene->count;
+
+        NEA_Sprite *sprite = NEA_SpriteCreate();
+        NEA_SpriteSetMaterial(sprite, Scene->Material);
+        NEA_SpriteSetSize(sprite, SPRITE_SIZE, SPRITE_SIZE);
+        NEA_SpriteSetPriority(sprite, i & 3);
+
+        Scene->Sprite[i] = sprite;
+        Scene->x[i] = my_rand() % (256 - SPRITE_SIZE);
+        Scene->y[i] = my_rand() % (192 - SPRITE_SIZE);
+        Scene->dx[i] = (my_rand() & 1) ? 1 : -1;
+        Scene->dy[i] = (my_rand() & 1) ? 1 : -1;
+        Scene->count++;
+    }
+
+    while (Scene->count > count)
+    {
+        Scene->count--;
+        NEA_SpriteDelete(Scene->Sprite[Scene->count]);
+    }
+}
+
+static void MoveSprites(SceneData *Scene)
+{
+    if (Scene->rotate)
+        Scene->angle = (Scene->angle + 4) & 511;
+
+    for (int i = 0; i < Scene->count; i++)
+    {
+        Scene->x[i] += Scene->dx[i];
+        Scene->y[i] += Scene->dy[i];
+
+        if ((Scene->x[i] <= 0) || (Scene->x[i] >= 256 - SPRITE_SIZE))
+            Scene->dx[i] = -Scene->dx[i];
+        if ((Scene->y[i] <= 0) || (Scene->y[i] >= 192 - SPRITE_SIZE))
+            Scene->dy[i] = -Scene->dy[i];
+
+        NEA_SpriteSetPos(Scene->Sprite[i], Scene->x[i], Scene->y[i]);
+        NEA_SpriteSetRot(Scene->Sprite[i], Scene->rotate ? Scene->angle : 0);
+    }
+}
+
+static void PrintModes(const SceneData *Scene)
+{
+    printf("\x1b[20;0HX: Batch (%s)  Y: Rotate (%s)",
+           Scene->batch ? "on " : "off", Scene->rotate ? "on " : "off");
+}
+
+int main(int argc, char *argv[])
+{
+    static SceneData Scene = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses VRAM_C for the text console, reserve A and B only
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    NEA_SpriteSystemReset(MAX_SPRITES);
+
+    Scene.Material = NEA_MaterialCreate();
+    NEA_Palette *Palette = NEA_PaletteCreate();
+
+    NEA_MaterialTexLoad(Scene.Material, NEA_PAL16, 128, 128,
+                        NEA_TEXGEN_TEXCOORD | NEA_TEXTURE_COLOR0_TRANSPARENT,
+                        iconBitmap);
+    NEA_PaletteLoad(Palette, iconPal, iconPalLen / 2, NEA_PAL16);
+    NEA_MaterialSetPalette(Scene.Material, Palette);
+
+    NEA_ClearColorSet(NEA_Gray, 31, 63);
+
+    StressInit("sprites", 50, MAX_SPRITES, 50, MAX_SPRITES);
+    SetCount(&Scene, MAX_SPRITES);
+    PrintModes(&Scene);
+
+    while (1)
+    {
+        NEA_WaitForVBL(0);
+
+        scanKeys();
+        uint32_t keys = keysDown();
+
+        if (keys & KEY_START)
+            break;
+
+        int count = StressUpdate();
+        if (count != Scene.count)
+            SetCount(&Scene, count);
+
+        if (keys & (KEY_X | KEY_Y))
+        {
+            if (keys & KEY_X)
+            {
+                Scene.batch = !Scene.batch;
+                NEA_SpriteSetBatchMode(Scene.batch);
+            }
+            if (keys & KEY_Y)
+                Scene.rotate = !Scene.rotate;
+
+            PrintModes(&Scene);
+        }
+
+        MoveSprites(&Scene);
+
+        NEA_Process(Draw3DScene);
+
+        StressPrint();
+    }
+
+    return 0;
+}
@@ -24,6 +24,10 @@
 #define NEA_DEFAULT_SPRITES 128 ///< Default max number of sprites.
 
 /// Holds information of a 2D sprite.
+///
+/// The fields can be read, but they must be modified with the functions of
+/// this module: the words sent to the GPU for the corners of the sprite are
+/// calculated when the position, size, scale, material or canvas change.
 typedef struct {
     s16 x;            ///< X position in pixels
     s16 y;            ///< Y position in pixels
@@ -42,6 +46,10 @@ typedef struct {
     bool visible;     ///< true if visible, false if not
     u8 alpha;         ///< Alpha value
     u8 id;            ///< Polygon ID
+    void *hw_obj;     ///< NEA_Hw2DOBJ, see NEA_Hw2DSpriteAttach()
+    s8 hw_affine;     ///< Affine matrix of the hardware OBJ (-1 = none)
+    u32 texcoord[4];  ///< GFX_TEX_COORD words of the corners (internal)
+    u32 vertex[4];    ///< GFX_VERTEX_XY words of the scaled corners (internal)
 } NEA_Sprite;
 
 /// Creates a new sprite.
@@ -187,6 +195,10 @@ void NEA_SpriteSystemEnd(void);
 /// You have to call NEA_2DViewInit() before drawing any sprite with this
 /// function.
 ///
+/// Sprites that aren't rotated are sent as a quad with precalculated corners,
+/// scaled around their center by the CPU, so the matrix isn't modified. Rotated
+/// sprites use their own matrix.
+///
 /// @param sprite Sprite to be drawn.
 void NEA_SpriteDraw(const NEA_Sprite *sprite);
 
@@ -194,8 +206,24 @@ void NEA_SpriteDraw(const NEA_Sprite *sprite);
 ///
 /// You have to call NEA_2DViewInit() before drawing any sprite with this
 /// function.
+///
+/// In batched mode (see NEA_SpriteSetBatchMode()) the sprites are drawn from
+/// the highest to the lowest priority value, grouped by material and polygon
+/// format inside each priority.
 void NEA_SpriteDrawAll(void);
 
+/// Enables or disables the batched mode of NEA_SpriteDrawAll().
+///
+/// In batched mode the sprites are sorted, and consecutive sprites without
+/// rotation that share a material and polygon format are sent as a single
+/// list of quads. The material and polygon format are only set when they
+/// change. Rotated sprites are drawn as usual.
+///
+/// It is disabled by default.
+///
+/// @param enable True to enable it, false to disable it.
+void NEA_SpriteSetBatchMode(bool enable);
+
 /// @}
 
 /// @defgroup 2d_view 2D View System
@@ -210,6 +238,11 @@ void NEA_SpriteDrawAll(void);
 /// to draw 2D elements using 3D hardware easily. The matrix is formed so that
 /// the X and Y coordinates of a polygon correspond to the X and Y coordinates
 /// of the screen.
+///
+/// The projection matrix is only loaded again if the engine may have modified
+/// it since the last call, so calling this function several times in a frame
+/// (before drawing sprites, the GUI, text...) is cheap. If you modify the
+/// projection matrix manually, call NEA_MaterialStateInvalidate() afterwards.
 void NEA_2DViewInit(void);
 
 /// Rotates the current 2D view from the specified point.
@@ -18,11 +18,23 @@ typedef enum {
     NEA_STATE_LOCKED
 } ne_chunk_state;
 
+typedef enum {
+    NEA_ALLOC_LIST,      // Walk the list of chunks for every operation
+    NEA_ALLOC_SEGREGATED // Keep free lists per size class and a hash of chunks
+} ne_alloc_mode;
+
+struct NEAAllocIndex;
+
 typedef struct NEAChunk {
     struct NEAChunk *previous; // Pointer to previous chunk. NULL if this is the first one
     struct NEAChunk *next;     // Pointer to next chunk. NULL if this is the last one
     ne_chunk_state state;     // Used, free or locked
     void *start, *end;        // Pointers to the start and end of this memory chunk
+
+    // Only used in NEA_ALLOC_SEGREGATED mode
+    struct NEAChunk *free_previous, *free_next; // Free list of its size class
+    struct NEAChunk *hash_next;                 // Next chunk in the same bucket
+    struct NEAAllocIndex *index;                // Only set in the first chunk
 } NEAChunk;
 
 typedef struct {
@@ -37,6 +49,24 @@ typedef struct {
 int NEA_AllocInit(NEAChunk **first_element, void *start, void *end);
 int NEA_AllocEnd(NEAChunk **first_element);
 
+// Like NEA_AllocInit(), but it lets the caller select the mode of the pool.
+//
+// In NEA_ALLOC_LIST mode all operations walk the list of chunks, so they get
+// slower as the number of chunks grows. In NEA_ALLOC_SEGREGATED mode free chunks
+// are also kept in one list per power-of-two size class, and all chunks are
+// kept in a hash table indexed by their start address:
+//
+// - NEA_Alloc() takes a chunk from the smallest non-empty size class that is
+//   big enough, so it doesn't necessarily return the lowest free address.
+// - NEA_AllocFromEnd() only looks at free chunks that are big enough, and it
+//   still returns the highest possible address.
+// - NEA_Free(), NEA_Lock() and NEA_Unlock() find chunks in constant time.
+// - NEA_AllocFindInRange() and NEA_AllocAddress() behave like in list mode.
+//
+// The list of chunks is kept in both modes, so it can always be walked.
+int NEA_AllocInitMode(NEAChunk **first_element, void *start, void *end,
+                     ne_alloc_mode mode);
+
 // This function takes a memory range defined by ["start", "end"] and tries to
 // look a chunk of free memory that is at least as big as "size". It doesn't
 // allocate it, that needs to be done with NEA_AllocAddress(). On error, this
@@ -69,4 +99,11 @@ int NEA_Unlock(NEAChunk *first_element, void *pointer);
 // Returns 0 on success. On error, it returns a negative number.
 int NEA_MemGetInformation(NEAChunk *first_element, NEAMemInfo *info);
 
+struct NEA_MemReport;
+
+// Fills the fields of a report that can be obtained from the allocator. The
+// used memory is assigned to NEA_MEM_OWNER_OTHER, the caller can distribute it
+// between other owners. Returns 0 on success, a negative number on error.
+int NEA_AllocGetReport(NEAChunk *first_element, struct NEA_MemReport *report);
+
 #endif // NEA_ALLOC_H__
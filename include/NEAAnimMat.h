@@ -37,6 +37,9 @@
 #define NEA_ANIMMAT_MAX_TRACKS    16  ///< Max property tracks per animation.
 #define NEA_ANIMMAT_MAX_KEYFRAMES 64  ///< Max keyframes per track.
 
+/// Max length in frames of the tracks baked by NEA_AnimMatDataBake().
+#define NEA_ANIMMAT_MAX_BAKED_FRAMES 1024
+
 /// Binary file magic: "AMKF" in little-endian.
 #define NEA_ANIMMAT_MAGIC 0x464B4D41
 
@@ -86,7 +89,9 @@ typedef struct {
     NEA_AnimMatTrackType type;    ///< Which property this track animates.
     NEA_AnimMatInterp    interp;  ///< Interpolation mode.
     uint16_t             num_keys; ///< Number of keyframes.
+    uint16_t             num_baked; ///< Number of values in the baked table.
     const NEA_AnimMatKeyframe *keys; ///< Pointer to keyframe array.
+    const uint32_t *baked; ///< Value of each frame, or NULL if not baked.
 } NEA_AnimMatTrack;
 
 /// Animation data template (can be shared by multiple instances).
@@ -97,6 +102,7 @@ typedef struct {
     uint16_t num_frames;   ///< Total animation length in frames.
     NEA_AnimMatTrack tracks[NEA_ANIMMAT_MAX_TRACKS]; ///< Track array.
     void *_base_data;      ///< Base pointer for file data (for free).
+    void *_baked_data;     ///< Baked tables of the tracks (for free).
     bool _loaded_from_fat; ///< Whether _base_data needs free().
 } NEA_AnimMatData;
 
@@ -115,6 +121,10 @@ typedef struct NEA_AnimMatInstance_ {
     int32_t currframe;           ///< Current frame (f32 fixed-point).
     bool paused;                 ///< If true, currframe doesn't advance.
     bool active;                 ///< If false, apply does nothing.
+    bool dirty;                  ///< The output state is out of date.
+
+    /// Instance whose frame and results are copied, or NULL.
+    const struct NEA_AnimMatInstance_ *sync_leader;
 
     /// Material table for MATERIAL_SWAP track.
     NEA_Material **mat_table;
@@ -179,6 +189,21 @@ NEA_AnimMatData *NEA_AnimMatDataLoadFAT(const char *path);
 /// @return Pointer to parsed data, or NULL on error.
 NEA_AnimMatData *NEA_AnimMatDataLoad(const void *pointer);
 
+/// Bake the linear tracks of animated material data into tables.
+///
+/// Each track with NEA_AMINTERP_LINEAR interpolation gets a table with its
+/// value at every frame, so evaluating it at an integer frame is a single load
+/// instead of a search of the keyframes and an interpolation. Fractional
+/// frames (with speeds that aren't a whole number of frames per VBL) are still
+/// interpolated from the keyframes. The results are the same in both cases.
+///
+/// Tracks longer than NEA_ANIMMAT_MAX_BAKED_FRAMES aren't baked. The tables
+/// use 4 bytes per frame, and they are freed by NEA_AnimMatDataFree().
+///
+/// @param data Animation data.
+/// @return It returns 1 on success, 0 on error (not enough memory).
+int NEA_AnimMatDataBake(NEA_AnimMatData *data);
+
 /// Free animated material data.
 ///
 /// @param data Pointer to the data.
@@ -265,6 +290,21 @@ void NEA_AnimMatSetSpeed(NEA_AnimMatInstance *inst, int32_t speed);
 /// @param frame Frame to set (f32).
 void NEA_AnimMatSetFrame(NEA_AnimMatInstance *inst, int32_t frame);
 
+/// Make an instance share the results of another one.
+///
+/// Instances in a sync group aren't advanced or evaluated by
+/// NEA_AnimMatUpdateAll(): they copy the frame and the output state of the
+/// leader after it has been evaluated. This saves the evaluation of all tracks
+/// when many instances show the same animation at the same phase. The results
+/// include the material selected by MATERIAL_SWAP tracks from the table of the
+/// leader, and the result of the base polygon format of the leader.
+///
+/// @param inst Instance.
+/// @param leader Instance to follow. It can't follow another instance. NULL
+///               removes the instance from its sync group.
+void NEA_AnimMatSync(NEA_AnimMatInstance *inst,
+                     const NEA_AnimMatInstance *leader);
+
 /// Get current frame.
 ///
 /// @param inst Instance.
@@ -277,13 +317,17 @@ int32_t NEA_AnimMatGetFrame(const NEA_AnimMatInstance *inst);
 
 /// Advance all active animated material instances by one tick.
 ///
-/// Called from NEA_WaitForVBL() when NEA_UPDATE_ANIM_MAT is set.
+/// Called from NEA_WaitForVBL() when NEA_UPDATE_ANIM_MAT is set. It only
+/// advances the frames. The tracks of an instance are evaluated the next time
+/// that NEA_AnimMatApply() is called with it, so instances of models that
+/// aren't drawn (because they are culled, for example) cost almost nothing.
 void NEA_AnimMatUpdateAll(void);
 
 /// Evaluate the current frame and compute output values.
 ///
-/// Called internally by NEA_AnimMatUpdateAll(), or can be called manually
-/// after setting the frame with NEA_AnimMatSetFrame().
+/// Called internally by NEA_AnimMatApply() when the frame has changed. It can
+/// be called manually to read the output state of an instance without
+/// applying it.
 ///
 /// @param inst Instance.
 void NEA_AnimMatEvaluate(NEA_AnimMatInstance *inst);
@@ -293,10 +337,14 @@ void NEA_AnimMatEvaluate(NEA_AnimMatInstance *inst);
 /// Call this before NEA_ModelDraw() for the affected model.
 /// Sets GFX_POLY_FORMAT, calls NEA_MaterialUse(), sets color registers,
 /// and/or applies texture matrix transforms depending on which tracks
-/// are active.
+/// are active. The texture matrix and the material colors aren't sent to the
+/// GPU again if they already have the same values.
+///
+/// If the instance has advanced since it was last evaluated, it's evaluated
+/// first (or it copies the results of its sync leader).
 ///
 /// @param inst Instance.
-void NEA_AnimMatApply(const NEA_AnimMatInstance *inst);
+void NEA_AnimMatApply(NEA_AnimMatInstance *inst);
 
 /// @}
 
@@ -18,10 +18,24 @@
 
 #define NEA_DEFAULT_ANIMATIONS 32 ///< Default max number of model animations.
 
+/// Animation bounds chunk magic number ("ABOX" in little-endian).
+///
+/// DSA files exported by md5_to_dsma with "--anim-bounds" start with this
+/// chunk: the magic number, the number of ranges, the number of frames of each
+/// range and, for each range, the min and max corners of the box that contains
+/// the model in all the poses of the range (6 f32 values, in model space).
+/// Range i covers the frames from i * frames to (i + 1) * frames, including
+/// the interpolation to the next frame.
+#define NEA_ANIM_BOUNDS_MAGIC 0x584F4241
+
 /// Holds information of an animation.
 typedef struct {
     bool loadedfromfat; ///< True if it was loaded from a filesystem.
     const void *data;   ///< Pointer to the animation data (DSA file).
+    const void *baked;  ///< Baked joint matrices, or NULL.
+    bool baked_has_to_free; ///< True if the baked matrices have to be freed.
+    const void *file;   ///< Start of the file, before the bounds chunk.
+    const int32_t *bounds; ///< Bounds chunk of the file, or NULL.
 } NEA_Animation;
 
 /// Creates a new animation object.
@@ -48,6 +62,52 @@ int NEA_AnimationLoad(NEA_Animation *animation, const void *pointer);
 /// @return It returns 1 on success.
 int NEA_AnimationLoadFAT(NEA_Animation *animation, const char *path);
 
+/// Returns the box that contains a model in the poses around a frame.
+///
+/// @param animation Pointer to the animation.
+/// @param frame Frame (f32).
+/// @param min Min corner of the box (3 f32 values, model space).
+/// @param max Max corner of the box (3 f32 values, model space).
+/// @return It returns true on success, false if the file has no bounds.
+bool NEA_AnimationGetBounds(const NEA_Animation *animation, int32_t frame,
+                            int32_t *min, int32_t *max);
+
+/// Generates the joint matrices of all frames of an animation.
+///
+/// Models drawn with a baked animation at a whole frame load the matrices
+/// instead of generating them from the DSA file, which saves a lot of CPU time
+/// for models with many joints. Frames between two whole frames and blended
+/// animations still generate them. This uses 48 bytes of RAM per joint and
+/// frame, so it's better to only bake the animations that are used the most.
+///
+/// The matrices are freed if a new DSA file is loaded to the animation.
+///
+/// @param animation Pointer to the animation.
+/// @return It returns 1 on success, 0 on error.
+int NEA_AnimationBake(NEA_Animation *animation);
+
+/// Uses baked joint matrices in RAM for an animation.
+///
+/// They can be generated with md5_to_dsma with "--bake-matrices". They must
+/// have been generated from the DSA file loaded in the animation.
+///
+/// @param animation Pointer to the animation.
+/// @param pointer Pointer to the file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_AnimationLoadBaked(NEA_Animation *animation, const void *pointer);
+
+/// Loads baked joint matrices from FAT for an animation.
+///
+/// @param animation Pointer to the animation.
+/// @param path Path to the file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_AnimationLoadBakedFAT(NEA_Animation *animation, const char *path);
+
+/// Stops using the baked joint matrices of an animation.
+///
+/// @param animation Pointer to the animation.
+void NEA_AnimationClearBaked(NEA_Animation *animation);
+
 /// Deletes all animations.
 void NEA_AnimationDeleteAll(void);
 
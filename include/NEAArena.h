@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_ARENA_H__
+#define NEA_ARENA_H__
+
+#include <nds.h>
+
+/// @file   NEAArena.h
+/// @brief  Arena allocators for transient data.
+
+/// @defgroup arena Arena allocators
+///
+/// Allocating and freeing lots of short-lived buffers with malloc() fragments
+/// the heap, and the time it takes to find a free block isn't predictable. An
+/// arena is a block of memory allocated once. Allocations only move a pointer
+/// forward, and all of them are freed at the same time when the arena is
+/// reset.
+///
+/// There are two arenas:
+///
+/// - The frame arena is reset by NEA_WaitForVBL() after every vertical blank.
+///   It is meant for data that is only needed during one frame. The engine
+///   also uses it for the temporary buffers of some functions, like the file
+///   data read by NEA_ColMeshLoadFAT() or the BMP conversions of
+///   NEA_FATMaterialTexLoadBMPtoRGBA(). If the arena doesn't exist or it is
+///   full, they use malloc() as usual.
+/// - The level arena is only reset by NEA_ArenaReset(). It is meant for data
+///   that lives until the current level is unloaded.
+///
+/// NEA_ArenaMark() and NEA_ArenaRelease() free the allocations done after a
+/// given point, so an arena can also be used as a stack.
+///
+/// @{
+
+/// Alignment of all allocations of an arena in bytes.
+#define NEA_ARENA_ALIGNMENT 8
+
+/// Available arenas.
+typedef enum {
+    NEA_ARENA_FRAME, ///< Reset after every vertical blank
+    NEA_ARENA_LEVEL, ///< Reset by the game
+    NEA_ARENA_COUNT  ///< Number of arenas
+} NEA_Arena;
+
+/// Usage statistics of an arena.
+typedef struct {
+    size_t size;       ///< Size of the arena
+    size_t used;       ///< Memory used right now
+    size_t high_water; ///< Max memory used since the stats were reset
+    u32 failures;      ///< Allocations that didn't fit
+} NEA_ArenaStats;
+
+/// Creates an arena, or changes its size.
+///
+/// All allocations of the arena are freed.
+///
+/// @param arena Arena.
+/// @param size Size in bytes. If it is 0, the arena is destroyed.
+/// @return It returns 1 on success, 0 on error.
+int NEA_ArenaInit(NEA_Arena arena, size_t size);
+
+/// Destroys an arena and frees its memory.
+///
+/// @param arena Arena.
+void NEA_ArenaEnd(NEA_Arena arena);
+
+/// Allocates memory from an arena.
+///
+/// @param arena Arena.
+/// @param size Size in bytes.
+/// @return Pointer to the memory, aligned to NEA_ARENA_ALIGNMENT bytes, or
+///         NULL if it doesn't fit.
+void *NEA_ArenaAlloc(NEA_Arena arena, size_t size);
+
+/// Returns the current position of an arena.
+///
+/// @param arena Arena.
+/// @return Mark to be used with NEA_ArenaRelease().
+size_t NEA_ArenaMark(NEA_Arena arena);
+
+/// Frees all allocations done in an arena after a call to NEA_ArenaMark().
+///
+/// @param arena Arena.
+/// @param mark Value returned by NEA_ArenaMark().
+void NEA_ArenaRelease(NEA_Arena arena, size_t mark);
+
+/// Frees all allocations of an arena.
+///
+/// @param arena Arena.
+void NEA_ArenaReset(NEA_Arena arena);
+
+/// Returns true if a pointer has been allocated from an arena.
+///
+/// @param arena Arena.
+/// @param ptr Pointer.
+/// @return True if the pointer is inside the memory of the arena.
+bool NEA_ArenaOwns(NEA_Arena arena, const void *ptr);
+
+/// Gets the usage statistics of an arena.
+///
+/// @param arena Arena.
+/// @param stats Pointer to the struct to fill.
+void NEA_ArenaGetStats(NEA_Arena arena, NEA_ArenaStats *stats);
+
+/// Resets the high-water mark and the failure count of an arena.
+///
+/// @param arena Arena.
+void NEA_ArenaResetStats(NEA_Arena arena);
+
+/// @}
+
+#endif // NEA_ARENA_H__
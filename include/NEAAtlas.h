@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_ATLAS_H__
+#define NEA_ATLAS_H__
+
+/// @file   NEAAtlas.h
+/// @brief  Texture atlases.
+
+/// @defgroup atlas Texture atlases
+///
+/// An atlas is a texture that contains several images, with a list of
+/// rectangles that tells where each image is. img2ds creates them with
+/// "--atlas", and it saves the rectangles in a metadata file that can be loaded
+/// with NEA_AtlasCreate() or NEA_AtlasCreateFAT().
+///
+/// The texture of the atlas is loaded into a regular material. Sprites and
+/// particle pools can use a region of the atlas with the texture canvas, see
+/// NEA_SpriteSetAtlasRegion(). Meshes can use a region with a material created
+/// with NEA_AtlasCreateMaterial(), which shares the texture of the atlas and
+/// moves the texture coordinates with the texture matrix. This means that all
+/// sprites and meshes that use the same atlas use the same texture in VRAM.
+///
+/// Texture coordinates that go outside of a region show the images next to it,
+/// so textures that need to be repeated shouldn't be part of an atlas.
+///
+/// @{
+
+#define NEA_ATLAS_NAME_LEN 24 ///< Length of the names of regions (with NUL)
+
+/// Holds information of a region of an atlas.
+typedef struct {
+    s16 x, y; ///< Top left corner (in texels)
+    s16 w, h; ///< Size (in texels)
+    char name[NEA_ATLAS_NAME_LEN]; ///< Name of the region
+} NEA_AtlasRegion;
+
+/// Holds information of an atlas.
+typedef struct {
+    NEA_Material *mat;        ///< Material with the texture of the atlas
+    int width, height;        ///< Size of the texture
+    int num_regions;          ///< Number of regions
+    NEA_AtlasRegion *regions; ///< Array of regions
+} NEA_Atlas;
+
+/// Creates an atlas from a metadata file generated by img2ds.
+///
+/// The data is copied, so it can be freed after calling this function.
+///
+/// @param mat Material with the texture of the atlas.
+/// @param data Pointer to the metadata file.
+/// @return Pointer to the newly created atlas, or NULL on error.
+NEA_Atlas *NEA_AtlasCreate(NEA_Material *mat, const void *data);
+
+/// Creates an atlas from a metadata file generated by img2ds stored in the
+/// filesystem.
+///
+/// @param mat Material with the texture of the atlas.
+/// @param path Path to the metadata file.
+/// @return Pointer to the newly created atlas, or NULL on error.
+NEA_Atlas *NEA_AtlasCreateFAT(NEA_Material *mat, const char *path);
+
+/// Deletes an atlas.
+///
+/// The material of the atlas isn't deleted.
+///
+/// @param atlas Pointer to the atlas.
+void NEA_AtlasDelete(NEA_Atlas *atlas);
+
+/// Looks for a region of an atlas by name.
+///
+/// The names are the file names of the images without the extension.
+///
+/// @param atlas Pointer to the atlas.
+/// @param name Name of the region.
+/// @return Index of the region, or -1 if it isn't found.
+int NEA_AtlasFindRegion(const NEA_Atlas *atlas, const char *name);
+
+/// Returns a region of an atlas.
+///
+/// @param atlas Pointer to the atlas.
+/// @param index Index of the region.
+/// @return Pointer to the region.
+const NEA_AtlasRegion *NEA_AtlasGetRegion(const NEA_Atlas *atlas, int index);
+
+/// Creates a material that draws meshes with a region of an atlas.
+///
+/// The material shares the texture of the atlas, and it has a texture offset
+/// that moves texture coordinates (0, 0) to the top left corner of the region
+/// (see NEA_MaterialSetTexOffset()). Meshes must use texture coordinates in the
+/// range of the size of the region, and the texture of the atlas must have been
+/// loaded with NEA_TEXGEN_TEXCOORD.
+///
+/// The material must be deleted with NEA_MaterialDelete() when it isn't needed.
+///
+/// @param atlas Pointer to the atlas.
+/// @param index Index of the region.
+/// @return Pointer to the newly created material, or NULL on error.
+NEA_Material *NEA_AtlasCreateMaterial(const NEA_Atlas *atlas, int index);
+
+/// Sets the material of a sprite to an atlas and selects one of its regions.
+///
+/// The size of the sprite is set to the size of the region.
+///
+/// @param sprite Sprite.
+/// @param atlas Pointer to the atlas.
+/// @param index Index of the region.
+void NEA_SpriteSetAtlasRegion(NEA_Sprite *sprite, const NEA_Atlas *atlas,
+                              int index);
+
+/// Sets the material of a particle pool to an atlas and selects one of its
+/// regions.
+///
+/// @param pool Pointer to the pool.
+/// @param atlas Pointer to the atlas.
+/// @param index Index of the region.
+void NEA_ParticlePoolSetAtlasRegion(NEA_ParticlePool *pool,
+                                    const NEA_Atlas *atlas, int index);
+
+/// @}
+
+#endif // NEA_ATLAS_H__
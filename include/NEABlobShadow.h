@@ -0,0 +1,159 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_BLOBSHADOW_H__
+#define NEA_BLOBSHADOW_H__
+
+#include <nds.h>
+
+#include "NEACollision.h"
+#include "NEATexture.h"
+
+/// @file   NEABlobShadow.h
+/// @brief  Batched blob shadows projected on the ground.
+
+/// @defgroup blob_shadow Blob shadows
+///
+/// A blob shadow is a textured quad under an actor, aligned to the ground. A
+/// batch finds the ground under each actor with one raycast against a
+/// collision shape (ColMeshes use their BVH), and draws all its shadows as
+/// quads inside a single GFX_BEGIN, binding the material once.
+///
+/// Shadows are added every frame after NEA_BlobShadowBatchClear(). Shadows
+/// get smaller as the actor moves away from the ground, and actors that are
+/// further than the range of the batch don't get a shadow. Coordinates must
+/// stay within NEA_BLOB_SHADOW_MAX_RANGE units of the origin.
+///
+/// @{
+
+/// Max distance from a shadow to the origin (in units)
+#define NEA_BLOB_SHADOW_MAX_RANGE 128
+
+/// Holds information of one blob shadow.
+typedef struct {
+    NEA_Vec3 point;  ///< Point of the ground under the actor (f32)
+    NEA_Vec3 normal; ///< Normal of the ground (f32, unit length)
+    int32_t size;    ///< Half size of the quad (f32)
+} NEA_BlobShadow;
+
+/// Holds information of a batch of blob shadows.
+typedef struct {
+    NEA_BlobShadow *shadows;    ///< Shadows added since the last clear
+    int num_shadows;            ///< Number of shadows
+    int max_shadows;            ///< Size of the array of shadows
+    const NEA_ColShape *ground; ///< Shape that receives the shadows
+    NEA_Vec3 ground_pos;        ///< Position of the ground shape (f32)
+    int32_t range;              ///< Max distance to the ground (f32)
+    int32_t offset;             ///< Distance from the ground to the quads (f32)
+    NEA_Material *mat;          ///< Material
+    s16 tl;                     ///< Left coordinate of the texture canvas
+    s16 tr;                     ///< Right coordinate of the texture canvas
+    s16 tt;                     ///< Top coordinate of the texture canvas
+    s16 tb;                     ///< Bottom coordinate of the texture canvas
+    u32 color;                  ///< Color of the quads
+    u8 alpha;                   ///< Alpha value
+    u8 id;                      ///< Polygon ID
+} NEA_BlobShadowBatch;
+
+/// Creates a new batch of blob shadows.
+///
+/// @param max_shadows Max number of shadows per frame.
+/// @return Pointer to the batch, or NULL on error.
+NEA_BlobShadowBatch *NEA_BlobShadowBatchCreate(int max_shadows);
+
+/// Deletes a batch of blob shadows.
+///
+/// @param batch Pointer to the batch.
+void NEA_BlobShadowBatchDelete(NEA_BlobShadowBatch *batch);
+
+/// Sets the material of a batch.
+///
+/// The texture canvas is set to the whole texture.
+///
+/// @param batch Pointer to the batch.
+/// @param mat Material.
+void NEA_BlobShadowBatchSetMaterial(NEA_BlobShadowBatch *batch,
+                                    NEA_Material *mat);
+
+/// Sets the shape that receives the shadows of a batch.
+///
+/// @param batch Pointer to the batch.
+/// @param shape Collision shape of the ground. It must stay valid while the
+///              batch uses it.
+/// @param pos World-space position of the shape (f32).
+void NEA_BlobShadowBatchSetGround(NEA_BlobShadowBatch *batch,
+                                  const NEA_ColShape *shape, NEA_Vec3 pos);
+
+/// Sets the max distance from an actor to the ground.
+///
+/// The shadow of an actor that is at this distance from the ground is half
+/// the size of the shadow of an actor that touches the ground.
+///
+/// @param batch Pointer to the batch.
+/// @param range Distance (f32).
+void NEA_BlobShadowBatchSetRangeI(NEA_BlobShadowBatch *batch, int32_t range);
+
+/// Sets the max distance from an actor to the ground.
+///
+/// @param b Pointer to the batch.
+/// @param r Distance (float).
+#define NEA_BlobShadowBatchSetRange(b, r) \
+    NEA_BlobShadowBatchSetRangeI(b, floattof32(r))
+
+/// Sets the color, alpha value and polygon ID of the shadows of a batch.
+///
+/// All the shadows share the polygon ID, so overlapping shadows aren't
+/// blended on top of each other.
+///
+/// @param batch Pointer to the batch.
+/// @param color Color of the quads.
+/// @param alpha Alpha value (1 - 31).
+/// @param id Polygon ID (0 - 63).
+void NEA_BlobShadowBatchSetParams(NEA_BlobShadowBatch *batch, u32 color,
+                                  u8 alpha, u8 id);
+
+/// Removes all the shadows of a batch.
+///
+/// @param batch Pointer to the batch.
+void NEA_BlobShadowBatchClear(NEA_BlobShadowBatch *batch);
+
+/// Adds the shadow of an actor to a batch.
+///
+/// The ground is searched straight down from the given position.
+///
+/// @param batch Pointer to the batch.
+/// @param x (x, y, z) Position of the actor (f32).
+/// @param y (x, y, z) Position of the actor (f32).
+/// @param z (x, y, z) Position of the actor (f32).
+/// @param size Half size of the shadow when the actor touches the ground
+///             (f32).
+/// @return Returns 1 if the shadow has been added, 0 if there is no ground in
+///         range or the batch is full.
+int NEA_BlobShadowBatchAddI(NEA_BlobShadowBatch *batch,
+                            int32_t x, int32_t y, int32_t z, int32_t size);
+
+/// Adds the shadow of an actor to a batch.
+///
+/// @param b Pointer to the batch.
+/// @param x (x, y, z) Position of the actor (float).
+/// @param y (x, y, z) Position of the actor (float).
+/// @param z (x, y, z) Position of the actor (float).
+/// @param s Half size of the shadow (float).
+/// @return Returns 1 if the shadow has been added, 0 if not.
+#define NEA_BlobShadowBatchAdd(b, x, y, z, s) \
+    NEA_BlobShadowBatchAddI(b, floattof32(x), floattof32(y), floattof32(z), \
+                            floattof32(s))
+
+/// Draws all the shadows of a batch.
+///
+/// It must be called after NEA_CameraUse() and after drawing the ground.
+///
+/// @param batch Pointer to the batch.
+void NEA_BlobShadowBatchDraw(const NEA_BlobShadowBatch *batch);
+
+/// @}
+
+#endif // NEA_BLOBSHADOW_H__
@@ -26,6 +26,11 @@
 /// Maximum bones supported for collision (matches DSMA matrix stack limit).
 #define NEA_MAX_COLLISION_BONES 30
 
+/// Number of models whose bone positions are cached.
+#ifndef NEA_BONE_COLLISION_CACHE_ENTRIES
+#define NEA_BONE_COLLISION_CACHE_ENTRIES 4
+#endif
+
 /// Bone collision shape types in the binary .boncol format.
 #define NEA_BONCOL_TYPE_NONE    0
 #define NEA_BONCOL_TYPE_SPHERE  1
@@ -79,10 +84,31 @@ int NEA_BoneCollisionGetWorldShape(const NEA_Model *model,
                                    NEA_Vec3 *out_pos,
                                    NEA_ColShape *out_shape);
 
+/// Get a sphere that contains the collision shapes of all bones of a model.
+///
+/// @param model Pointer to the animated model.
+/// @param bcd Bone collision data for this model.
+/// @param out_center Output: world-space center of the sphere.
+/// @param out_radius Output: radius of the sphere (f32).
+/// @return 1 on success, 0 on error.
+int NEA_BoneCollisionGetBounds(const NEA_Model *model,
+                               const NEA_BoneCollisionData *bcd,
+                               NEA_Vec3 *out_center, int32_t *out_radius);
+
+/// Forget the cached world-space positions of all bones.
+///
+/// The positions of the bones of the last models that have been queried are
+/// cached, and they are reused while the animation, frame, position and scale
+/// of the model don't change. This only needs to be called if the animation
+/// data is modified in place. NEA_BoneCollisionFree() calls it.
+void NEA_BoneCollisionCacheClear(void);
+
 /// Test collision between an animated model's bones and a collision shape.
 ///
 /// Tests all bones that have collision data against the given shape.
 /// Returns the deepest collision found and the index of the colliding bone.
+/// Shapes that are outside of the sphere returned by
+/// NEA_BoneCollisionGetBounds() are rejected without testing any bone.
 ///
 /// @param model The animated model.
 /// @param bcd Bone collision data for the model.
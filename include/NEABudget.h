@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_BUDGET_H__
+#define NEA_BUDGET_H__
+
+/// @file   NEABudget.h
+/// @brief  Polygon budget governor.
+
+/// @defgroup budget Polygon budget governor
+///
+/// The GPU can't hold more than 2048 polygons or 6144 vertices per frame, and
+/// anything sent after that is silently dropped. When the governor is enabled,
+/// the polygon and vertex counters are read at the end of every frame (of every
+/// pass in two-pass and dual 3D modes) and compared against a target that is
+/// lower than the hardware limit.
+///
+/// When the recent peak goes over the target, the degradation level goes up:
+///
+/// - NEA_ModelLODDraw() switches to simpler levels closer to the camera.
+/// - Frustum culling of models is enabled even if the application hasn't
+///   enabled it with NEA_ModelFrustumCulling().
+/// - The callback set with NEA_BudgetSetCallback() is called, so that the
+///   application can reduce particles, effects, etc.
+///
+/// The level goes down again when the usage stays well below the target.
+///
+/// @{
+
+#define NEA_BUDGET_MAX_POLYGONS 2048 ///< Max number of polygons per frame
+#define NEA_BUDGET_MAX_VERTICES 6144 ///< Max number of vertices per frame
+
+/// Default target of polygons (80% of the hardware limit)
+#define NEA_BUDGET_DEFAULT_POLYGONS (NEA_BUDGET_MAX_POLYGONS * 4 / 5)
+/// Default target of vertices (80% of the hardware limit)
+#define NEA_BUDGET_DEFAULT_VERTICES (NEA_BUDGET_MAX_VERTICES * 4 / 5)
+
+#define NEA_BUDGET_HISTORY 8   ///< Number of frames used to find the peak usage
+#define NEA_BUDGET_LEVEL_MAX 3 ///< Highest degradation level
+
+/// Function called when the degradation level changes.
+///
+/// @param level New degradation level (0 to NEA_BUDGET_LEVEL_MAX).
+/// @param headroom Polygons that were left in the last frame.
+typedef void (*NEA_BudgetCallback)(int level, int headroom);
+
+/// Enables or disables the governor.
+///
+/// When it is disabled, the degradation level is reset to 0.
+///
+/// @param enable True to enable it, false to disable it.
+void NEA_BudgetEnable(bool enable);
+
+/// Sets the number of polygons and vertices that the governor tries to stay
+/// under.
+///
+/// @param polygons Target of polygons. If it is lower than 1, it uses
+///                 NEA_BUDGET_DEFAULT_POLYGONS.
+/// @param vertices Target of vertices. If it is lower than 1, it uses
+///                 NEA_BUDGET_DEFAULT_VERTICES.
+void NEA_BudgetSetTarget(int polygons, int vertices);
+
+/// Sets a function that is called when the degradation level changes.
+///
+/// @param callback Function, or NULL to remove it.
+void NEA_BudgetSetCallback(NEA_BudgetCallback callback);
+
+/// Returns the current degradation level.
+///
+/// @return Level (0 to NEA_BUDGET_LEVEL_MAX). It is always 0 if the governor is
+///         disabled.
+int NEA_BudgetGetLevel(void);
+
+/// Returns the factor that NEA_ModelLODDraw() applies to the switch distances
+/// of LOD objects.
+///
+/// @return Factor (f32). It is 1.0 at level 0 and goes down with each level.
+int32_t NEA_BudgetGetLODScale(void);
+
+/// Returns the number of polygons that were left before the hardware limit in
+/// the last frame.
+///
+/// In two-pass and dual 3D modes it is the lowest value of all passes.
+///
+/// @return Polygons left. It is 0 if the limit was reached.
+int NEA_BudgetGetPolygonHeadroom(void);
+
+/// Returns the number of vertices that were left before the hardware limit in
+/// the last frame.
+///
+/// In two-pass and dual 3D modes it is the lowest value of all passes.
+///
+/// @return Vertices left. It is 0 if the limit was reached.
+int NEA_BudgetGetVertexHeadroom(void);
+
+/// Returns the number of polygons drawn in the last frame of a pass.
+///
+/// @param pass Pass index (0 to NEA_TWO_PASS_MAX_BANDS - 1). It is always 0 in
+///             single 3D modes.
+/// @return Number of polygons.
+int NEA_BudgetGetPassPolygons(int pass);
+
+/// @}
+
+#endif // NEA_BUDGET_H__
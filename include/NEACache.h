@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_CACHE_H__
+#define NEA_CACHE_H__
+
+#include <nds.h>
+
+#include "NEAAnimation.h"
+#include "NEAAnimMat.h"
+#include "NEACollision.h"
+#include "NEAPalette.h"
+#include "NEATexture.h"
+
+/// @file   NEACache.h
+/// @brief  Reference-counted cache of assets loaded from the filesystem.
+
+/// @defgroup cache Asset cache
+///
+/// The asset cache keeps one copy of each asset loaded from the filesystem,
+/// identified by its path. Loading an asset that is already in the cache
+/// returns the same copy and increases its reference count instead of reading
+/// the file again. NEA_CacheRelease() decreases the count, and the asset is
+/// deleted when nobody uses it anymore.
+///
+/// Paths are compared like in asset packs, after removing "nitro:" and the
+/// leading slashes (see NEA_PackFind()).
+///
+/// Scenes load their meshes and textures through the cache, so scenes that
+/// share assets share the same copies in RAM and VRAM. Loading the next scene
+/// before freeing the current one only reads the assets that the current one
+/// doesn't use.
+///
+/// Cached assets are shared by all their users, so they must not be deleted
+/// with their regular delete functions, and they shouldn't be modified. For
+/// example, use NEA_MaterialClone() to get a material with the texture of a
+/// cached material and different colors.
+///
+/// @{
+
+#define NEA_CACHE_MAX_ENTRIES 128 ///< Max number of cached assets
+
+/// Types of assets that can be cached.
+typedef enum {
+    NEA_CACHE_MESH,      ///< Data of a mesh (DL or DSM)
+    NEA_CACHE_ANIMATION, ///< Animation (DSA)
+    NEA_CACHE_TEXTURE,   ///< Material with a GRF texture
+    NEA_CACHE_PALETTE,   ///< Palette
+    NEA_CACHE_COLMESH,   ///< Collision mesh
+    NEA_CACHE_ANIMMAT    ///< Animated material data
+} NEA_CacheType;
+
+/// Loads the data of a mesh, or gets it from the cache.
+///
+/// The data can be used with NEA_ModelLoadStaticMesh() or NEA_ModelLoadDSM().
+/// It must not be freed by the models, so don't use
+/// NEA_ModelFreeMeshWhenDeleted() with it. Delete all models that use it before
+/// releasing it.
+///
+/// @param path Path of the mesh file.
+/// @return Pointer to the data, or NULL on error.
+void *NEA_CacheLoadMesh(const char *path);
+
+/// Loads an animation, or gets it from the cache.
+///
+/// @param path Path of the DSA file.
+/// @return Pointer to the animation, or NULL on error.
+NEA_Animation *NEA_CacheLoadAnimation(const char *path);
+
+/// Loads a GRF texture to a new material, or gets it from the cache.
+///
+/// If the GRF file has a palette, it belongs to the material. The flags are
+/// part of the key of the cache: loading the same file with different flags
+/// creates a different material.
+///
+/// @param path Path of the GRF file.
+/// @param flags Parameters of the texture.
+/// @return Pointer to the material, or NULL on error.
+NEA_Material *NEA_CacheLoadTextureGRF(const char *path, NEA_TextureFlags flags);
+
+/// Loads a palette, or gets it from the cache.
+///
+/// The format is only used the first time the palette is loaded.
+///
+/// @param path Path of the palette file.
+/// @param format Format of the texture that uses the palette.
+/// @return Pointer to the palette, or NULL on error.
+NEA_Palette *NEA_CacheLoadPalette(const char *path, NEA_TextureFormat format);
+
+/// Loads a collision mesh, or gets it from the cache.
+///
+/// @param path Path of the .colmesh file.
+/// @return Pointer to the collision mesh, or NULL on error.
+NEA_ColMesh *NEA_CacheLoadColMesh(const char *path);
+
+/// Loads animated material data, or gets it from the cache.
+///
+/// @param path Path of the .neaanimmat file.
+/// @return Pointer to the data, or NULL on error.
+NEA_AnimMatData *NEA_CacheLoadAnimMatData(const char *path);
+
+/// Gets an asset from the cache without loading it.
+///
+/// If the asset is cached, its reference count is increased. If a GRF texture
+/// has been loaded with different flags, any of its materials may be returned.
+///
+/// @param type Type of the asset.
+/// @param path Path of the asset.
+/// @return Pointer to the asset, or NULL if it isn't cached.
+void *NEA_CacheGet(NEA_CacheType type, const char *path);
+
+/// Adds an asset loaded by other means to the cache.
+///
+/// The cache takes ownership of the asset, with a reference count of 1. If
+/// there is already an asset of the same type and path in the cache, the new
+/// one is deleted, and the cached one is returned with its reference count
+/// increased. This is useful to cache files read with the background loader.
+///
+/// The data of meshes must have been allocated with malloc().
+///
+/// @param type Type of the asset.
+/// @param path Path of the asset.
+/// @param asset Pointer to the asset.
+/// @return Pointer to the cached asset, or NULL on error (the asset is deleted).
+void *NEA_CacheAdd(NEA_CacheType type, const char *path, void *asset);
+
+/// Increases the reference count of a cached asset.
+///
+/// @param asset Pointer to the asset.
+/// @return Returns 1 on success, 0 if the asset isn't cached.
+int NEA_CacheRetain(const void *asset);
+
+/// Decreases the reference count of a cached asset.
+///
+/// The asset is deleted when the count reaches zero.
+///
+/// @param asset Pointer to the asset. If it is NULL, nothing happens.
+void NEA_CacheRelease(const void *asset);
+
+/// Returns the reference count of a cached asset.
+///
+/// @param asset Pointer to the asset.
+/// @return The reference count, or 0 if the asset isn't cached.
+int NEA_CacheGetRefCount(const void *asset);
+
+/// Returns the number of assets in the cache.
+///
+/// @return Number of cached assets.
+int NEA_CacheGetCount(void);
+
+/// Deletes all cached assets, even if they are still used.
+///
+/// It is called by NEA_End() and when the engine is initialized again.
+void NEA_CacheDeleteAll(void);
+
+/// @}
+
+#endif // NEA_CACHE_H__
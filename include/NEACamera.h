@@ -22,6 +22,16 @@
 ///
 /// @{
 
+/// Planes of the view frustum of a camera.
+typedef enum {
+    NEA_FRUSTUM_LEFT   = 0, ///< Left plane
+    NEA_FRUSTUM_RIGHT  = 1, ///< Right plane
+    NEA_FRUSTUM_BOTTOM = 2, ///< Bottom plane
+    NEA_FRUSTUM_TOP    = 3, ///< Top plane
+    NEA_FRUSTUM_NEAR   = 4, ///< Near plane
+    NEA_FRUSTUM_FAR    = 5, ///< Far plane
+} NEA_FrustumPlane;
+
 /// Holds information of the camera.
 typedef struct {
     m4x4 matrix;   ///< Matrix that represents the transformation
@@ -29,6 +39,10 @@ typedef struct {
     int32_t to[3];   ///< Where the camera is looking at
     int32_t up[3];   ///< Vector that points "up"
     bool matrix_is_updated; ///< Set to false when the matrix isn't up-to-date
+    bool frustum_is_updated; ///< Set to false when the planes aren't up-to-date
+    m4x4 view_proj;        ///< View matrix multiplied by the projection
+    int32_t planes[6][4];  ///< Frustum planes in world space (f32)
+    int32_t frustum[6];    ///< Projection the planes were calculated with
 } NEA_Camera;
 
 #define NEA_DEFAULT_CAMERAS 16 ///< Default max number of cameras.
@@ -74,9 +88,84 @@ void NEA_CameraSetI(NEA_Camera *cam, int xfrom, int yfrom, int zfrom,
 
 /// Set current view to the one of the specified camera.
 ///
+/// It also makes the frustum of the camera the one used by the culling
+/// functions of the engine, see NEA_CameraFrustumTestSphereI().
+///
 /// @param cam Camera to be used.
 void NEA_CameraUse(NEA_Camera *cam);
 
+/// Captures the view frustum from the current clip matrix.
+///
+/// The planes are extracted from the product of the current position and
+/// projection matrices, so this should be called right after NEA_CameraUse().
+/// NEA_CameraUse() already sets the frustum of the camera calculated with the
+/// projection of the engine, so this is only needed if the projection matrix
+/// has been modified by the application.
+///
+/// Note that this needs to wait until the geometry engine isn't busy.
+void NEA_CameraFrustumUpdate(void);
+
+/// Tests a sphere against the active view frustum.
+///
+/// The active frustum is the one of the last camera passed to NEA_CameraUse(),
+/// or the one captured by NEA_CameraFrustumUpdate() after it. The coordinates
+/// are in the space of the camera (the world space in most cases). If no
+/// camera has been used, this function always returns true.
+///
+/// @param x (x, y, z) Center of the sphere (f32).
+/// @param y (x, y, z) Center of the sphere (f32).
+/// @param z (x, y, z) Center of the sphere (f32).
+/// @param radius Radius of the sphere (f32).
+/// @return Returns false if the sphere is completely outside of the frustum.
+bool NEA_CameraFrustumTestSphereI(int x, int y, int z, int radius);
+
+/// Returns the view matrix of a camera multiplied by the projection matrix.
+///
+/// The matrix and the frustum planes of a camera are cached. They are only
+/// calculated again when the camera moves or when the projection of the engine
+/// changes (NEA_SetFov(), NEA_ClippingPlanesSetI(), NEA_Viewport() or the half
+/// of the screen drawn by the current pass in two-pass modes).
+///
+/// @param cam Camera.
+/// @return Pointer to the matrix. It's valid until the camera is deleted.
+const m4x4 *NEA_CameraGetViewProjection(NEA_Camera *cam);
+
+/// Returns one of the frustum planes of a camera in world space.
+///
+/// The plane is (a, b, c, d) in f32 format. The normal (a, b, c) has a length
+/// of 1 and it points inside the frustum, so a point p is inside of the plane
+/// if dot(normal, p) + d >= 0.
+///
+/// @param cam Camera.
+/// @param plane Plane to return.
+/// @return Pointer to the 4 values of the plane.
+const int32_t *NEA_CameraGetFrustumPlane(NEA_Camera *cam,
+                                         NEA_FrustumPlane plane);
+
+/// Tests a sphere against the frustum of a camera.
+///
+/// Unlike NEA_CameraFrustumTestSphereI(), this doesn't need the camera to be
+/// the active one.
+///
+/// @param cam Camera.
+/// @param x (x, y, z) Center of the sphere in world space (f32).
+/// @param y (x, y, z) Center of the sphere in world space (f32).
+/// @param z (x, y, z) Center of the sphere in world space (f32).
+/// @param radius Radius of the sphere (f32).
+/// @return Returns false if the sphere is completely outside of the frustum.
+bool NEA_CameraTestSphereI(NEA_Camera *cam, int x, int y, int z, int radius);
+
+/// Tests a sphere against the frustum of a camera.
+///
+/// @param c Camera.
+/// @param x (x, y, z) Center of the sphere in world space (float).
+/// @param y (x, y, z) Center of the sphere in world space (float).
+/// @param z (x, y, z) Center of the sphere in world space (float).
+/// @param r Radius of the sphere (float).
+#define NEA_CameraTestSphere(c, x, y, z, r) \
+    NEA_CameraTestSphereI(c, floattof32(x), floattof32(y), floattof32(z), \
+                          floattof32(r))
+
 /// Moves a camera on the global x, y and z axes.
 ///
 /// @param cam Camera to be moved.
@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_CAPTURE_H__
+#define NEA_CAPTURE_H__
+
+#include <nds.h>
+
+#include "NEATexture.h"
+
+/// @file   NEACapture.h
+/// @brief  Screenshots that don't stop the game.
+
+/// @defgroup capture Frame capture
+///
+/// NEA_ScreenshotBMP() waits for the display capture unit, converts the frame
+/// and writes the whole file before returning, which stops the game for many
+/// frames. The functions of this module do the same work in the background, so
+/// they can be used to save frames during benchmarks or automated tests:
+///
+///     NEA_CaptureStart("fat:/frame.bmp", NEA_VRAM_D);
+///
+///     while (1)
+///     {
+///         NEA_WaitForVBL(NEA_UPDATE_CAPTURE);
+///         NEA_Process(Draw3DScene);
+///         ...
+///     }
+///
+/// NEA_CaptureStart() enables the display capture unit, which saves the next
+/// frame that is displayed (3D and 2D) to a VRAM bank while the game keeps
+/// running. The next call to NEA_CaptureUpdate() after the frame has been saved
+/// copies it to RAM and gives the bank back. After that, each call converts
+/// and writes a few rows of the BMP file, see NEA_CaptureSetRowsPerUpdate().
+///
+/// The bank used for the capture must not be used by the texture allocator
+/// (see NEA_TextureSystemReset() and NEA_TextureBanksRelease()), by the Hw2D
+/// system, or by impostors if it is VRAM_D. It is mapped as LCD memory during
+/// the frame that is captured, and its previous mapping is restored when the
+/// frame has been copied.
+///
+/// Only the single 3D mode is supported, the other modes already use the
+/// capture unit every frame.
+///
+/// @{
+
+/// Default number of rows written by NEA_CaptureUpdate()
+#define NEA_CAPTURE_DEFAULT_ROWS 16
+
+/// States of the capture system.
+typedef enum {
+    NEA_CAPTURE_IDLE,     ///< There is no frame
+    NEA_CAPTURE_WAITING,  ///< The capture unit is saving a frame to VRAM
+    NEA_CAPTURE_WRITING,  ///< The frame is in RAM and it is being written
+    NEA_CAPTURE_DONE,     ///< The frame is in RAM and the file is complete
+    NEA_CAPTURE_ERROR     ///< The file couldn't be written
+} NEA_CaptureState;
+
+/// Starts capturing the next frame that is displayed.
+///
+/// The buffer of the frame in RAM (96 KB) is allocated the first time this is
+/// called, and it is kept until NEA_CaptureEnd() is called.
+///
+/// @param filename File to save as BMP, or NULL to only copy the frame to RAM.
+/// @param bank VRAM bank used by the capture unit (NEA_VRAM_A to NEA_VRAM_D).
+/// @return Returns 1 on success, 0 on error.
+int NEA_CaptureStart(const char *filename, NEA_VRAMBankFlags bank);
+
+/// Sets the number of rows of the BMP file written by NEA_CaptureUpdate().
+///
+/// @param rows Number of rows. If it is 0, NEA_CAPTURE_DEFAULT_ROWS is used.
+void NEA_CaptureSetRowsPerUpdate(int rows);
+
+/// Advances the capture in progress.
+///
+/// NEA_WaitForVBL() calls it if NEA_UPDATE_CAPTURE is used. It must not be
+/// called from an interrupt handler because it writes to the filesystem.
+void NEA_CaptureUpdate(void);
+
+/// Writes the rest of the file of the capture in progress right now.
+///
+/// If the capture unit hasn't saved the frame yet, it waits for it.
+void NEA_CaptureFlush(void);
+
+/// Returns the state of the capture system.
+///
+/// @return State.
+NEA_CaptureState NEA_CaptureGetState(void);
+
+/// Returns the last frame that has been captured.
+///
+/// The frame is 256x192 pixels in RGB15 format, with the top row first. It's
+/// available from the moment the state stops being NEA_CAPTURE_WAITING until
+/// the next capture starts.
+///
+/// @return Pointer to the pixels, or NULL if there is no frame.
+const u16 *NEA_CaptureGetFrame(void);
+
+/// Stops the capture in progress and frees the buffer of the frame.
+///
+/// The file of a capture that hasn't been written completely is closed.
+void NEA_CaptureEnd(void);
+
+/// @}
+
+#endif // NEA_CAPTURE_H__
@@ -89,14 +89,63 @@ static inline NEA_Vec3 NEA_Vec3Cross(NEA_Vec3 a, NEA_Vec3 b)
     return v;
 }
 
-/// Normalize a vector in-place and return it.
-static inline NEA_Vec3 NEA_Vec3Normalize(NEA_Vec3 a)
-{
-    int32_t v[3] = { a.x, a.y, a.z };
-    normalizef32(v);
-    NEA_Vec3 r = { v[0], v[1], v[2] };
-    return r;
-}
+/// Normalize a vector and return it.
+///
+/// A zero vector is returned unchanged.
+NEA_Vec3 NEA_Vec3Normalize(NEA_Vec3 a);
+
+/// Normalize a vector with an approximate reciprocal square root.
+///
+/// It doesn't use the hardware square root and divider units. The relative
+/// error of the length is below 0.04%, so the components of the result are
+/// off by 3 units of f32 at most. It's good enough for vectors that are only
+/// used for lighting, directions, etc.
+///
+/// A zero vector is returned unchanged.
+NEA_Vec3 NEA_Vec3NormalizeFast(NEA_Vec3 a);
+
+/// Transform an array of vectors by a 4x3 matrix (rotation, scale and
+/// translation).
+///
+/// The array functions process all the vectors in one loop, without the
+/// copies of the single vector helpers. The destination can be the source.
+///
+/// @param dst Destination array.
+/// @param src Source array.
+/// @param count Number of vectors.
+/// @param mat Matrix.
+void NEA_Vec3ArrayTransform(NEA_Vec3 *dst, const NEA_Vec3 *src, int count,
+                            const m4x3 *mat);
+
+/// Calculate the dot products of two arrays of vectors (f32 results).
+///
+/// @param dst Destination array (one value per pair of vectors).
+/// @param a First array.
+/// @param b Second array.
+/// @param count Number of vectors of each array.
+void NEA_Vec3ArrayDot(int32_t *dst, const NEA_Vec3 *a, const NEA_Vec3 *b,
+                      int count);
+
+/// Extend an axis-aligned box so that it contains an array of points.
+///
+/// The box isn't reset: initialize min and max to the first point to get the
+/// bounds of the array.
+///
+/// @param src Array of points.
+/// @param count Number of points.
+/// @param min Minimum corner of the box (in and out).
+/// @param max Maximum corner of the box (in and out).
+void NEA_Vec3ArrayBounds(const NEA_Vec3 *src, int count, NEA_Vec3 *min,
+                         NEA_Vec3 *max);
+
+/// Move an array of positions by their velocities: pos += vel * dt.
+///
+/// @param pos Array of positions (f32).
+/// @param vel Array of velocities (f32 per time unit).
+/// @param count Number of vectors of each array.
+/// @param dt Time step (f32).
+void NEA_Vec3ArrayIntegrate(NEA_Vec3 *pos, const NEA_Vec3 *vel, int count,
+                            int32_t dt);
 
 /// Clamp a scalar to [min, max].
 static inline int32_t NEA_Clamp(int32_t val, int32_t min, int32_t max)
@@ -143,28 +192,63 @@ typedef struct {
 } NEA_ColCapsule;
 
 /// A single triangle for ColMesh collision.
+///
+/// Everything except the vertices is derived from them, so that collision
+/// tests can reject the triangle with cheap tests.
 typedef struct {
     NEA_Vec3 v0, v1, v2; ///< Vertices in model-local space (f32).
     NEA_Vec3 normal;      ///< Pre-computed face normal (f32, unit length).
+    int32_t  plane_d;     ///< Distance of the plane to the origin (f32).
+    NEA_Vec3 center;      ///< Center of the bounding sphere (f32).
+    int32_t  radius;      ///< Radius of the bounding sphere (f32, -1 if empty).
+    int16_t  edge_normal[3][3]; ///< Inward normals of v0-v1, v1-v2, v2-v0 (f32).
+    int16_t  padding;
 } NEA_ColTriangle;
 
+/// Node of the bounding volume hierarchy (BVH) of a ColMesh.
+///
+/// Leaves point to a range of triangles. Other nodes have two children: the
+/// next node of the array, and the node at index "first".
+typedef struct {
+    NEA_Vec3 min;   ///< Minimum corner of the box (f32).
+    NEA_Vec3 max;   ///< Maximum corner of the box (f32).
+    uint16_t first; ///< First triangle of a leaf, or index of the second child.
+    uint16_t count; ///< Number of triangles of a leaf, or 0.
+} NEA_ColBVHNode;
+
+/// Max depth of the BVH of a ColMesh.
+#define NEA_COLMESH_BVH_MAX_DEPTH 32
+
 /// ColMesh flags.
 #define NEA_COLMESH_STATIC  0       ///< Position-only transform (default).
 #define NEA_COLMESH_DYNAMIC (1 << 0) ///< Full transform (rotate/scale).
+#define NEA_COLMESH_TRANSFORMED (1 << 1) ///< Queries in local space.
 
 /// Triangle mesh collider (ColMesh).
 ///
 /// Uses a flat triangle array with a whole-mesh AABB for early rejection.
-/// Supports two modes:
+/// Files generated by "obj2dl --collision" also have a BVH, so that the tests
+/// only look at the triangles close to the other shape.
+///
+/// Supports three modes:
 /// - Static: position-only offset, triangles stay in local space.
+/// - Transformed: rigid transform via NEA_ColMeshSetMatrix(). Triangles stay
+///   in local space, and the other shapes are moved to local space.
 /// - Dynamic: full transform via NEA_ColMeshUpdateTransform().
 typedef struct {
     NEA_ColAABB bounds;          ///< Whole-mesh AABB half-extents for early rejection.
     NEA_Vec3    center;          ///< AABB center in local space (f32).
     uint16_t    num_triangles;   ///< Number of triangles (max 65535).
-    uint16_t    flags;           ///< NEA_COLMESH_STATIC or NEA_COLMESH_DYNAMIC.
+    uint16_t    flags;           ///< NEA_COLMESH_* flags.
     NEA_ColTriangle *triangles;  ///< Local-space triangles (original data).
     NEA_ColTriangle *world_tris; ///< World-space triangles (NULL if static).
+    uint16_t        num_nodes;   ///< Number of BVH nodes (0 if there is no BVH).
+    NEA_ColBVHNode *nodes;       ///< Local-space BVH (NULL if there is none).
+    NEA_ColBVHNode *world_nodes; ///< World-space BVH (NULL if static).
+    m4x3        matrix;          ///< Local to world transform (if transformed).
+    m4x3        inverse;         ///< World to local transform (if transformed).
+    int32_t     scale;           ///< Scale of the matrix (f32, if transformed).
+    void       *load;            ///< Internal state of an incremental load.
 } NEA_ColMesh;
 
 /// Unified collision shape.
@@ -190,6 +274,14 @@ typedef struct {
     NEA_Vec3 point;  ///< Approximate contact point in world space (f32).
 } NEA_ColResult;
 
+/// Result of a raycast or a sweep.
+typedef struct {
+    bool     hit;      ///< True if the ray hits the shape.
+    int32_t  distance; ///< Distance moved from the start until the hit (f32).
+    NEA_Vec3 normal;   ///< Surface normal, toward the ray (f32, unit length).
+    NEA_Vec3 point;    ///< Contact point in world space (f32).
+} NEA_ColRayResult;
+
 // =========================================================================
 // Shape initialization
 // =========================================================================
@@ -241,10 +333,55 @@ void NEA_ColShapeInitMesh(NEA_ColShape *shape, NEA_ColMesh *mesh);
 
 /// Load a ColMesh from a .colmesh binary in RAM.
 ///
+/// This is the same as NEA_ColMeshCreate() followed by NEA_ColMeshLoadStart()
+/// and one call to NEA_ColMeshLoadStep() that processes all the triangles.
+///
 /// @param data Pointer to the .colmesh binary data.
 /// @return Pointer to the loaded ColMesh, or NULL on error.
 NEA_ColMesh *NEA_ColMeshLoad(const void *data);
 
+/// Create an empty ColMesh to be filled with NEA_ColMeshLoadStart().
+///
+/// An empty mesh has no triangles, so it never collides with anything.
+///
+/// @return Pointer to the ColMesh, or NULL on error.
+NEA_ColMesh *NEA_ColMeshCreate(void);
+
+/// Start loading a .colmesh binary into an empty ColMesh in small steps.
+///
+/// Big level meshes can take several frames to convert, so this lets the game
+/// spread the work with NEA_ColMeshLoadStep(). The bounds of the mesh are set
+/// right away, and the triangles are added as they are processed. The mesh can
+/// be used in collision tests while it is being loaded: they only see the
+/// triangles that have been processed, and they check them one by one until
+/// the BVH is loaded with the last step.
+///
+/// The data must not be freed until the mesh has been loaded. If free_data is
+/// true, the mesh owns the data, and it is freed with free() when the load
+/// ends, when the mesh is freed, or right away if this function fails.
+///
+/// @param mesh Pointer to a ColMesh created with NEA_ColMeshCreate().
+/// @param data Pointer to the .colmesh binary data.
+/// @param free_data True to free the data with free() when it isn't needed.
+/// @return Returns 1 on success, 0 on error.
+int NEA_ColMeshLoadStart(NEA_ColMesh *mesh, const void *data, bool free_data);
+
+/// Process some triangles of a ColMesh started with NEA_ColMeshLoadStart().
+///
+/// Version 1 files cost more per triangle than version 2 files, because the
+/// edge normals of their triangles are calculated when they are loaded.
+///
+/// @param mesh Pointer to the ColMesh.
+/// @param max_triangles Max number of triangles to process (at least 1).
+/// @return True if the mesh has been loaded completely.
+bool NEA_ColMeshLoadStep(NEA_ColMesh *mesh, int max_triangles);
+
+/// Returns true if a ColMesh is still being loaded with NEA_ColMeshLoadStep().
+///
+/// @param mesh Pointer to the ColMesh.
+/// @return True if the load hasn't finished.
+bool NEA_ColMeshIsLoading(const NEA_ColMesh *mesh);
+
 /// Load a ColMesh from a .colmesh file on the filesystem (FAT).
 ///
 /// @param path Path to the .colmesh file.
@@ -255,16 +392,35 @@ NEA_ColMesh *NEA_ColMeshLoadFAT(const char *path);
 ///
 /// In dynamic mode, NEA_ColMeshUpdateTransform() can be used to transform
 /// all triangles by a matrix each frame. This allocates a second triangle
-/// buffer for world-space data.
+/// buffer for world-space data. For rigid transforms, NEA_ColMeshSetMatrix()
+/// is faster and doesn't need the buffer.
+///
+/// It can't be used while the mesh is being loaded (see
+/// NEA_ColMeshIsLoading()).
 ///
 /// @param mesh Pointer to the ColMesh.
 /// @param dynamic True to enable dynamic mode, false for static.
 void NEA_ColMeshSetDynamic(NEA_ColMesh *mesh, bool dynamic);
 
+/// Set the transformation of a ColMesh without transforming its triangles.
+///
+/// The mesh keeps the matrix and its inverse. Collision tests move the other
+/// shape to the space of the mesh, and move the result back to world space.
+/// This costs the same for any number of triangles, and it doesn't need a
+/// second copy of them, so it is the best option for moving platforms.
+///
+/// The matrix can only rotate, translate and scale uniformly. The position
+/// passed to the collision tests is added to its translation. Dynamic meshes
+/// stop being dynamic.
+///
+/// @param mesh Pointer to the ColMesh.
+/// @param matrix 4x3 transformation matrix, or NULL to go back to static mode.
+void NEA_ColMeshSetMatrix(NEA_ColMesh *mesh, const m4x3 *matrix);
+
 /// Transform a dynamic ColMesh by a 4x3 matrix.
 ///
 /// This transforms all triangles from local to world space and recomputes
-/// the bounding AABB. Call once per frame for dynamic meshes before
+/// the bounding AABB and the boxes of the BVH. Call once per frame for dynamic meshes before
 /// collision tests. Only works if NEA_ColMeshSetDynamic() was called.
 ///
 /// @param mesh Pointer to the ColMesh.
@@ -273,6 +429,9 @@ void NEA_ColMeshUpdateTransform(NEA_ColMesh *mesh, const m4x3 *matrix);
 
 /// Free a ColMesh and all associated memory.
 ///
+/// Meshes that are being loaded can be freed too. They are also removed from
+/// the queue of the background loader (see NEA_LoaderAddColMesh()).
+///
 /// @param mesh Pointer to the ColMesh.
 void NEA_ColMeshFree(NEA_ColMesh *mesh);
 
@@ -327,6 +486,63 @@ NEA_ColResult NEA_ColTestCapsuleVsMesh(const NEA_ColCapsule *a,
                                        const NEA_ColMesh *mesh,
                                        NEA_Vec3 mesh_pos);
 
+/// Contacts with normals closer than this (cosine, f32) are merged into one.
+#define NEA_COL_CONTACT_MERGE_DOT floattof32(0.95)
+
+/// Test Sphere vs ColMesh collision, returning several contacts.
+///
+/// The mesh is only traversed once. Each triangle that touches the sphere
+/// gives one contact. Contacts with almost the same normal (see
+/// NEA_COL_CONTACT_MERGE_DOT) are merged and only the deepest one is kept, so
+/// a flat floor made of many triangles gives one contact, but the floor and a
+/// wall of a corner give two. If there are more contacts than "max_contacts",
+/// the deepest ones are kept.
+///
+/// @param a Sphere.
+/// @param pos_a World-space position of the sphere (f32).
+/// @param mesh Collision mesh.
+/// @param mesh_pos World-space position of the mesh (f32).
+/// @param contacts Array of "max_contacts" results, sorted from the deepest
+///                 to the shallowest contact.
+/// @param max_contacts Size of the array (at least 1).
+/// @return Number of contacts found.
+int NEA_ColTestSphereVsMeshContacts(const NEA_ColSphere *a, NEA_Vec3 pos_a,
+                                    const NEA_ColMesh *mesh, NEA_Vec3 mesh_pos,
+                                    NEA_ColResult *contacts, int max_contacts);
+
+/// Test AABB vs ColMesh collision, returning several contacts.
+///
+/// See NEA_ColTestSphereVsMeshContacts(). Like NEA_ColTestAABBvsMesh(), the
+/// box is tested as a sphere with the radius of its smallest half-extent.
+///
+/// @param a AABB.
+/// @param pos_a World-space position of the AABB (f32).
+/// @param mesh Collision mesh.
+/// @param mesh_pos World-space position of the mesh (f32).
+/// @param contacts Array of "max_contacts" results.
+/// @param max_contacts Size of the array (at least 1).
+/// @return Number of contacts found.
+int NEA_ColTestAABBvsMeshContacts(const NEA_ColAABB *a, NEA_Vec3 pos_a,
+                                  const NEA_ColMesh *mesh, NEA_Vec3 mesh_pos,
+                                  NEA_ColResult *contacts, int max_contacts);
+
+/// Test Capsule vs ColMesh collision, returning several contacts.
+///
+/// See NEA_ColTestSphereVsMeshContacts().
+///
+/// @param a Capsule.
+/// @param pos_a World-space position of the capsule (f32).
+/// @param mesh Collision mesh.
+/// @param mesh_pos World-space position of the mesh (f32).
+/// @param contacts Array of "max_contacts" results.
+/// @param max_contacts Size of the array (at least 1).
+/// @return Number of contacts found.
+int NEA_ColTestCapsuleVsMeshContacts(const NEA_ColCapsule *a, NEA_Vec3 pos_a,
+                                     const NEA_ColMesh *mesh,
+                                     NEA_Vec3 mesh_pos,
+                                     NEA_ColResult *contacts,
+                                     int max_contacts);
+
 /// Generic collision test dispatcher.
 ///
 /// Tests any pair of collision shapes. Automatically selects the correct
@@ -340,6 +556,92 @@ NEA_ColResult NEA_ColTestCapsuleVsMesh(const NEA_ColCapsule *a,
 NEA_ColResult NEA_ColTest(const NEA_ColShape *a, NEA_Vec3 pos_a,
                           const NEA_ColShape *b, NEA_Vec3 pos_b);
 
+/// Generic collision test dispatcher that returns several contacts.
+///
+/// If one of the shapes is a collision mesh, it returns the contacts of
+/// NEA_ColTestSphereVsMeshContacts() and similar functions. The normals have
+/// the same direction as in NEA_ColTest(). Other pairs of shapes only have one
+/// contact.
+///
+/// @param a First collision shape.
+/// @param pos_a World-space position of shape A (f32).
+/// @param b Second collision shape.
+/// @param pos_b World-space position of shape B (f32).
+/// @param contacts Array of "max_contacts" results, sorted from the deepest
+///                 to the shallowest contact.
+/// @param max_contacts Size of the array (at least 1).
+/// @return Number of contacts found.
+int NEA_ColTestContacts(const NEA_ColShape *a, NEA_Vec3 pos_a,
+                        const NEA_ColShape *b, NEA_Vec3 pos_b,
+                        NEA_ColResult *contacts, int max_contacts);
+
+/// Shape and position of each target of NEA_ColTestBatch().
+typedef struct {
+    const NEA_ColShape *shape; ///< Collision shape.
+    NEA_Vec3 pos;              ///< World-space position of the shape (f32).
+} NEA_ColTarget;
+
+/// Tests one collision shape against many shapes.
+///
+/// It gives the same results as calling NEA_ColTest() for each target, but
+/// the test function is selected once for all targets of the same type, and
+/// targets are rejected with their bounding boxes before the narrow-phase
+/// test. This is useful to test the view of an AI or an explosion against
+/// all the objects of a room.
+///
+/// @param shape Collision shape of the query.
+/// @param pos World-space position of the query shape (f32).
+/// @param targets Array of target shapes.
+/// @param count Number of targets.
+/// @param results Array of "count" results, one per target, in the same order.
+/// @return Number of targets hit by the query shape.
+int NEA_ColTestBatch(const NEA_ColShape *shape, NEA_Vec3 pos,
+                     const NEA_ColTarget *targets, int count,
+                     NEA_ColResult *results);
+
+// =========================================================================
+// Raycasts and sweeps
+// =========================================================================
+
+/// Casts a ray from one point to another against a collision shape.
+///
+/// It returns the first hit along the segment. ColMeshes use their BVH, so
+/// only the triangles close to the ray are tested. Triangles are hit from both
+/// sides. If the ray starts inside an AABB, sphere or capsule, it hits it at
+/// distance 0.
+///
+/// This is useful for line-of-sight checks, ground snapping and
+/// projectiles.
+///
+/// @param from Start of the ray in world space (f32).
+/// @param to End of the ray in world space (f32).
+/// @param shape Collision shape.
+/// @param pos World-space position of the shape (f32).
+/// @return Result of the raycast. There is no hit if the points are the same.
+NEA_ColRayResult NEA_ColRaycast(NEA_Vec3 from, NEA_Vec3 to,
+                                const NEA_ColShape *shape, NEA_Vec3 pos);
+
+/// Moves a sphere from one point to another and finds the first hit with a
+/// collision shape.
+///
+/// The distance of the result is the distance moved by the center of the
+/// sphere before touching the shape, and the point is the contact point on
+/// the surface of the shape. If the sphere already touches the shape at the
+/// start, the distance is 0.
+///
+/// Unlike testing the sphere at several points of its path, fast objects can't
+/// go through thin walls.
+///
+/// @param sphere Sphere shape.
+/// @param from Start position of the center of the sphere (f32).
+/// @param to End position of the center of the sphere (f32).
+/// @param shape Collision shape.
+/// @param pos World-space position of the shape (f32).
+/// @return Result of the sweep. There is no hit if the points are the same.
+NEA_ColRayResult NEA_ColSweepSphere(const NEA_ColSphere *sphere,
+                                    NEA_Vec3 from, NEA_Vec3 to,
+                                    const NEA_ColShape *shape, NEA_Vec3 pos);
+
 /// @}
 
 #endif // NEA_COLLISION_H__
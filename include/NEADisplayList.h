@@ -7,6 +7,8 @@
 #ifndef NEA_DISPLAYLIST_H__
 #define NEA_DISPLAYLIST_H__
 
+#include <nds.h>
+
 /// @file   NEADisplayList.h
 /// @brief  Functions to send display lists to the GPU.
 
@@ -20,6 +22,7 @@
 typedef enum {
     NEA_DL_CPU,          ///< Send all data to the GPU with CPU copy loop.
     NEA_DL_DMA_GFX_FIFO, ///< Default. DMA in GFX FIFO mode (incompatible with safe dual 3D)
+    NEA_DL_DMA_GFX_FIFO_ASYNC, ///< Non-blocking DMA in GFX FIFO mode (same restrictions)
     // TODO: Support DMA without GFX FIFO DMA mode, using GFX FIFO IRQ instead.
 } NEA_DisplayListDrawFunction;
 
@@ -31,6 +34,30 @@ typedef enum {
 /// @param list Pointer to the display list
 void NEA_DisplayListDrawDMA_GFX_FIFO(const void *list);
 
+/// Sends a display list to the GPU by using the DMA without waiting for it.
+///
+/// The transfer is started (or queued if there is one in progress) and the
+/// function returns right away, so the CPU can do other work while the GPU
+/// consumes the list. The DMA IRQ starts the next queued list when a transfer
+/// ends. The CPU only waits if there are too many lists in the queue.
+///
+/// The list must stay in memory and unmodified until it has been sent. GX
+/// registers can't be written while a list is being sent: call
+/// NEA_DisplayListWait() before writing to them if you do it manually. All
+/// Nitro Engine Advanced functions that write to the GX registers do it for
+/// you.
+///
+/// This has the same restrictions as NEA_DisplayListDrawDMA_GFX_FIFO().
+///
+/// @param list Pointer to the display list
+void NEA_DisplayListDrawDMA_GFX_FIFO_Async(const void *list);
+
+/// Waits until all lists sent with NEA_DisplayListDrawDMA_GFX_FIFO_Async()
+/// have been sent to the GPU.
+///
+/// This returns right away if the asynchronous backend isn't in use.
+void NEA_DisplayListWait(void);
+
 /// Sends a display list to the GPU by using a CPU copy loop.
 ///
 /// @param list Pointer to the display list
@@ -50,9 +77,114 @@ void NEA_DisplayListSetDefaultFunction(NEA_DisplayListDrawFunction type);
 ///
 /// This will use the function selected by NEA_DisplayListSetDefaultFunction().
 ///
+/// If the list changes the polygon format, call NEA_PolyFormat() before drawing
+/// models with BoxTest culling enabled: the engine doesn't know the format set
+/// by the list and restores the last one set with NEA_PolyFormat() after each
+/// test.
+///
 /// @param list Pointer to the display list
 void NEA_DisplayListDrawDefault(const void *list);
 
+/// Writes a display list from the data cache to main RAM.
+///
+/// The DMA backends read the list from main RAM, so they flush it from the
+/// data cache every time it's drawn. A list that doesn't change can be flushed
+/// once with this function and drawn with NEA_DisplayListDrawDefaultFlushed().
+///
+/// @param list Pointer to the display list
+void NEA_DisplayListFlush(const void *list);
+
+/// Draw a display list that has already been flushed from the data cache.
+///
+/// It's like NEA_DisplayListDrawDefault(), but it doesn't flush the list. It
+/// must have been flushed with NEA_DisplayListFlush() after the last time the
+/// CPU modified it, or the GPU may receive old data.
+///
+/// @param list Pointer to the display list
+void NEA_DisplayListDrawDefaultFlushed(const void *list);
+
+/// @}
+
+/// @defgroup display_list_recorder Display list recorder
+///
+/// A recorder captures the geometry sent with the NEA_Poly functions
+/// (NEA_PolyBegin(), NEA_PolyEnd(), NEA_PolyColor(), NEA_PolyNormal(),
+/// NEA_PolyTexCoord(), NEA_PolyVertex() and NEA_PolyFormat()) and packs it
+/// into a display list, 4 command IDs per word, with the same format as the
+/// lists used by NEA_DisplayListDrawDefault(). Sending the list is a single
+/// DMA transfer instead of one register write per command.
+///
+/// Calls to other functions, like NEA_MaterialUse() or the matrix functions,
+/// aren't recorded: they are sent to the GPU right away, so they have to be
+/// called before drawing the list.
+///
+/// Geometry that changes every frame can use a double-buffered recorder: the
+/// new list is recorded in one buffer while the list of the previous frame,
+/// in the other buffer, may still be sent by the asynchronous DMA backend.
+/// Lists must be recorded at most once per frame. A recorder with one buffer
+/// waits for the lists in the queue to be sent before recording a new one.
+///
+/// @{
+
+/// Holds information of a display list recorder.
+typedef struct {
+    uint32_t *list[2]; ///< Lists (the same buffer twice with one buffer)
+    size_t capacity;   ///< Size of each list in words (without the size word)
+    int front;         ///< Index of the list that is drawn
+    size_t words;      ///< Words used in the list being recorded
+    size_t cmd;        ///< Word with the command IDs being packed
+    int slot;          ///< Number of command IDs in that word
+    bool recording;    ///< A list is being recorded
+    bool overflow;     ///< The list being recorded ran out of space
+    uint32_t poly_format[2];  ///< Last polygon format recorded in each list
+    bool has_poly_format[2];  ///< The list has a polygon format command
+} NEA_DisplayListRecorder;
+
+/// Creates a display list recorder.
+///
+/// A vertex uses 2 or 3 words, and colors, normals and texture coordinates
+/// use 1 or 2 words each.
+///
+/// @param max_words Max size of a list in words.
+/// @param double_buffer True to allocate two buffers.
+/// @return Pointer to the recorder, or NULL on error.
+NEA_DisplayListRecorder *NEA_DisplayListRecorderCreate(size_t max_words,
+                                                       bool double_buffer);
+
+/// Deletes a display list recorder.
+///
+/// @param rec Pointer to the recorder.
+void NEA_DisplayListRecorderDelete(NEA_DisplayListRecorder *rec);
+
+/// Starts recording a new list.
+///
+/// Until NEA_DisplayListRecordEnd() is called, the NEA_Poly functions write
+/// to the list instead of the GPU. Only one recorder can record at a time.
+///
+/// @param rec Pointer to the recorder.
+void NEA_DisplayListRecordBegin(NEA_DisplayListRecorder *rec);
+
+/// Stops recording and makes the new list the one that is drawn.
+///
+/// If the list ran out of space, the commands that didn't fit are dropped.
+///
+/// @param rec Pointer to the recorder.
+/// @return Returns 1 if all commands fit in the list, 0 if not.
+int NEA_DisplayListRecordEnd(NEA_DisplayListRecorder *rec);
+
+/// Returns the last list recorded by a recorder.
+///
+/// @param rec Pointer to the recorder.
+/// @return Pointer to the display list, or NULL if it is empty.
+const void *NEA_DisplayListRecorderGet(const NEA_DisplayListRecorder *rec);
+
+/// Draws the last list recorded by a recorder with NEA_DisplayListDrawDefault().
+///
+/// It does nothing if the list is empty.
+///
+/// @param rec Pointer to the recorder.
+void NEA_DisplayListRecorderDraw(const NEA_DisplayListRecorder *rec);
+
 /// @}
 
 #endif // NEA_DISPLAYLIST_H__
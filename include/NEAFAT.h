@@ -7,6 +7,8 @@
 #ifndef NEA_FAT_H__
 #define NEA_FAT_H__
 
+#include <stdio.h>
+
 #include <nds.h>
 
 /// @file   NEAFAT.h
@@ -16,10 +18,31 @@
 ///
 /// Functions to load data from FAT, and to take screenshots.
 ///
+/// Files can be loaded to RAM at once with NEA_FATLoadData(), or read in
+/// chunks with the NEA_FATStream functions, which lets loaders copy data
+/// straight to its final destination without a temporary copy of the file.
+///
+/// Files can be compressed with the formats of the BIOS of the DS (LZ77, RLE
+/// and Huffman). A compressed file starts with NEA_FAT_COMPRESSED_MAGIC,
+/// followed by the compressed data as expected by the BIOS (with its header).
+/// The tools of Nitro Engine Advanced generate them with "--compress". All
+/// functions that load files decompress them automatically, so all
+/// NEA_*LoadFAT() functions accept compressed files. Data is decompressed as
+/// it is read, straight to its destination when possible (including VRAM).
+///
+/// All functions that load files look for them in the mounted asset packs
+/// before opening them from the filesystem (see NEA_PackMount()). This
+/// includes all NEA_*LoadFAT() functions of the engine.
+///
 /// @{
 
+/// Magic number at the start of compressed files ("NECZ").
+#define NEA_FAT_COMPRESSED_MAGIC 0x5A43454E
+
 /// Loads a file to RAM from a filesystem.
 ///
+/// Compressed files are decompressed.
+///
 /// @param filename Path to the file.
 /// @return Returns a pointer to the location of the file that will have to be
 ///         freed with free().
@@ -27,10 +50,95 @@ char *NEA_FATLoadData(const char *filename);
 
 /// Returns size of a file.
 ///
+/// The size of compressed files is their size after decompressing them.
+///
 /// @param filename File to check.
 /// @return Returns the file of the size, or -1 on error.
 size_t NEA_FATFileSize(const char *filename);
 
+/// Size of the buffer used by NEA_FATStreamReadVRAM() in bytes.
+#define NEA_FAT_STREAM_BUFFER_SIZE 4096
+
+/// Holds information of a file opened for streaming.
+typedef struct {
+    FILE *file;         ///< File handle
+    size_t size;        ///< Size of the file in bytes (after decompressing it)
+    size_t offset;      ///< Start of the data inside the file handle
+    size_t position;    ///< Read position from the start of the file
+    bool shared;        ///< True if the file handle belongs to an asset pack
+    u32 compression;    ///< BIOS header of compressed files, or 0
+    size_t packed_size; ///< Size of the compressed data in bytes
+} NEA_FATStream;
+
+/// Opens a file to read it in chunks.
+///
+/// This avoids loading the whole file to RAM when the data is going to be
+/// copied somewhere else, like VRAM.
+///
+/// @param filename Path to the file.
+/// @return Pointer to the stream, or NULL on error.
+NEA_FATStream *NEA_FATStreamOpen(const char *filename);
+
+/// Closes a stream opened with NEA_FATStreamOpen().
+///
+/// @param stream Pointer to the stream.
+void NEA_FATStreamClose(NEA_FATStream *stream);
+
+/// Moves the read position of a stream.
+///
+/// @param stream Pointer to the stream.
+/// @param offset Offset from the start of the file in bytes.
+/// @return Returns 1 on success, 0 on error.
+int NEA_FATStreamSeek(NEA_FATStream *stream, size_t offset);
+
+/// Reads data from a stream into RAM.
+///
+/// Compressed files can only be read at once: the read must start at the
+/// beginning of the file and it must include the whole file. The destination
+/// must be aligned to 4 bytes, and it must have space for the size of the
+/// file rounded up to a multiple of 4 bytes.
+///
+/// @param stream Pointer to the stream.
+/// @param dst Destination buffer.
+/// @param size Number of bytes to read.
+/// @return Number of bytes read.
+size_t NEA_FATStreamRead(NEA_FATStream *stream, void *dst, size_t size);
+
+/// Reads data from a stream into VRAM.
+///
+/// VRAM doesn't support 8-bit writes, so the data is read in chunks of
+/// NEA_FAT_STREAM_BUFFER_SIZE bytes into a static buffer and copied from there
+/// with 32-bit writes. The destination VRAM must be mapped so that the CPU can
+/// write to it (for example, in LCD mode).
+///
+/// Compressed files are decompressed straight into VRAM, with the same
+/// restrictions as NEA_FATStreamRead().
+///
+/// @param stream Pointer to the stream.
+/// @param dst Destination in VRAM. It must be aligned to 4 bytes.
+/// @param size Number of bytes to read. It must be a multiple of 4.
+/// @return Returns 1 on success, 0 on error.
+int NEA_FATStreamReadVRAM(NEA_FATStream *stream, void *dst, size_t size);
+
+/// Returns the size of compressed data in RAM after decompressing it.
+///
+/// @param data Pointer to the data. It must start with NEA_FAT_COMPRESSED_MAGIC.
+/// @return Size in bytes, or 0 if the data isn't compressed.
+size_t NEA_FATDecompressedSize(const void *data);
+
+/// Decompresses data in RAM.
+///
+/// This is meant for data that isn't loaded from the filesystem, like data
+/// included in the binary, which can then be passed to the loaders that take
+/// data from RAM. The destination must be aligned to 4 bytes, and it must
+/// have space for the size returned by NEA_FATDecompressedSize() rounded up
+/// to a multiple of 4 bytes. It can be in VRAM.
+///
+/// @param data Pointer to the data. It must start with NEA_FAT_COMPRESSED_MAGIC.
+/// @param dst Destination buffer.
+/// @return Returns 1 on success, 0 on error.
+int NEA_FATDecompress(const void *data, void *dst);
+
 /// Takes a screenshot of the 3D screen.
 ///
 /// It takes a screenshot of the 3D screen (or both screens if in dual 3D mode)
@@ -38,6 +146,9 @@ size_t NEA_FATFileSize(const char *filename);
 ///
 /// Warning: This function hasn't been tested with all dual 3D modes.
 ///
+/// It doesn't return until the file has been written. NEA_CaptureStart() does
+/// the same work in the background, in single 3D mode.
+///
 /// @param filename File to save the screenshot.
 /// @return Returns 1 on success, 0 on error.
 int NEA_ScreenshotBMP(const char *filename);
@@ -15,7 +15,9 @@
 /// @defgroup formats Format coversion functions
 ///
 /// Functions to convert BMP files into DS textures. They support BMP of 4, 8,
-/// 16 (X1RGB5) and 24 bits per pixel.
+/// 16 (X1RGB5) and 24 bits per pixel. Images are converted one row at a time
+/// straight into the VRAM of the texture, without a temporary buffer for the
+/// converted image.
 ///
 /// It is discouraged to use this set of functions. Instead, use preconverted
 /// textures.
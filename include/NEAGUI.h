@@ -56,13 +56,33 @@ typedef struct {
 /// Updates all GUI objects.
 ///
 /// NEA_UpdateInput() must be called every frame for this function to work.
+///
+/// If there is no touch input and no object was pressed during the last
+/// update, this function returns right away. The objects are sorted in a grid
+/// of cells of the screen, so only the objects under the stylus and the ones
+/// that were pressed during the last update are checked.
 void NEA_GUIUpdate(void);
 
 /// Draw all GUI objects.
 ///
 /// You must call NEA_2DViewInit() before this.
+///
+/// The commands used to draw the objects are saved in a display list, which
+/// is only built again when the state of an object changes. Call
+/// NEA_GUIInvalidate() if a material used by the GUI is modified.
+///
+/// Objects can also be drawn on a hardware 2D background, see
+/// NEA_GUISetHw2DBackground().
 void NEA_GUIDraw(void);
 
+/// Forces the next update to check all GUI objects and the next draw to build
+/// the draw list again.
+///
+/// This is done automatically when objects are created, configured or deleted.
+/// It only needs to be called after a material used by an object is reloaded
+/// or its color or lighting properties are changed.
+void NEA_GUIInvalidate(void);
+
 /// Creates a new button object.
 ///
 /// @param x1 (x1, y1) Top left corner.
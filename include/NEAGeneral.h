@@ -49,6 +49,14 @@ typedef struct {
 /// scanKeys() each frame for this to work.
 void NEA_UpdateInput(void);
 
+/// Returns the input read by the last call to NEA_UpdateInput().
+///
+/// When a replay is being played it's the input of the replay (see
+/// NEAReplay.h).
+///
+/// @return Pointer to the input.
+const NEA_Input *NEA_GetInput(void);
+
 /// List of all the possible initialization states of Nitro Engine Advanced.
 typedef enum {
     NEA_ModeUninitialized        = 0, ///< Nitro Engine Advanced hasn't been initialized.
@@ -142,7 +150,8 @@ int NEA_InitDual3D_DMA(void);
 ///
 /// This mode doubles the polygon budget by splitting the screen into left and
 /// right halves and rendering each half in a separate hardware frame. The
-/// effective framerate is 30 FPS.
+/// effective framerate is 30 FPS. NEA_TwoPassSetBands() can split the screen
+/// in more bands.
 ///
 /// VRAM bank D is used for display capture. VRAM banks A, B, and C are
 /// available for textures (75% of the normally available VRAM).
@@ -193,7 +202,8 @@ int NEA_Init3D_TwoPass_FB(void);
 ///
 /// This mode doubles the polygon budget by splitting the screen into left and
 /// right halves and rendering each half in a separate hardware frame. The
-/// effective framerate is 30 FPS.
+/// effective framerate is 30 FPS. NEA_TwoPassSetBands() can split the screen
+/// in more bands.
 ///
 /// VRAM bank D is used for display capture. VRAM banks A, B, and C are
 /// available for textures (75% of the normally available VRAM). VRAM bank F is
@@ -234,17 +244,96 @@ void NEA_ProcessTwoPassArg(NEA_VoidArgfunc drawscene, void *arg);
 ///
 /// Works with all three two-pass modes (FIFO, FB, DMA).
 ///
-/// Returns 0 when the next pass will render the left half (meaning a complete
-/// frame has just finished). Returns 1 when the next pass will render the right
-/// half. Use this to only update scene state every other frame:
+/// It's the index of the band that the next pass will render. Returns 0 when
+/// the next pass will render the left band (meaning a complete frame has just
+/// finished), and NEA_TwoPassGetBands() - 1 when it will render the right band.
+/// Use this to only update scene state once per complete frame:
 ///
 /// @code
 /// NEA_WaitForVBL(NEA_TwoPassGetPass() == 0 ? NEA_UPDATE_ANIMATIONS : 0);
 /// @endcode
 ///
-/// @return Current pass index (0 or 1).
+/// @return Current pass index (0 to NEA_TwoPassGetBands() - 1).
 int NEA_TwoPassGetPass(void);
 
+/// Max number of bands of two-pass modes. See NEA_TwoPassSetBands().
+#define NEA_TWO_PASS_MAX_BANDS 4
+
+/// Sets the number of bands of columns that two-pass modes split the screen in.
+///
+/// Each band is rendered in a separate hardware frame, so N bands multiply the
+/// polygon budget by N and the effective framerate is 60 / N FPS. By default
+/// the screen is split in two halves.
+///
+/// More than two bands are only supported in the FIFO and DMA modes. The FB
+/// mode composites both halves with the BG layers, so it only supports two.
+/// The adaptive split line (NEA_TwoPassAdaptiveSplit()) is only used with two
+/// bands.
+///
+/// The frame that is being drawn is lost if the number of bands changes, so
+/// this should be called before starting to draw, or right after a complete
+/// frame (when NEA_TwoPassGetPass() returns 0).
+///
+/// @param bands Number of bands (2 to NEA_TWO_PASS_MAX_BANDS).
+/// @param bounds First column of each band except for the first one
+///               (bands - 1 values in increasing order, multiples of 8). If
+///               NULL, the bands have the same width.
+/// @return It returns 1 on success, 0 on error.
+int NEA_TwoPassSetBands(int bands, const int *bounds);
+
+/// Returns the number of bands of two-pass modes.
+///
+/// @return Number of bands (2 to NEA_TWO_PASS_MAX_BANDS).
+int NEA_TwoPassGetBands(void);
+
+/// Enables or disables moving the split line of two-pass modes.
+///
+/// By default the screen is split in two halves of 128 columns. When this is
+/// enabled, the split column moves at the start of each frame, based on the
+/// number of polygons that each pass drew in the previous frame, so that both
+/// passes get a similar number of polygons. It works with all three two-pass
+/// modes (FIFO, FB, DMA).
+///
+/// Both passes draw a few columns past the split line, so polygons close to it
+/// are sent in both passes.
+///
+/// @param enable True to enable it, false to go back to a fixed split line.
+void NEA_TwoPassAdaptiveSplit(bool enable);
+
+/// Returns the column where the screen is split in two-pass modes.
+///
+/// The left pass draws columns 0 to split - 1, the right pass draws columns
+/// split to 255. With more than two bands it's the first column of band 1.
+///
+/// @return Split column.
+int NEA_TwoPassGetSplit(void);
+
+/// Enables or disables per-pass culling in two-pass modes.
+///
+/// It is disabled by default. When it is enabled, NEA_CameraUse() captures the
+/// frustum of the current pass, which only covers the columns drawn by that
+/// pass.
+/// NEA_ModelDraw() and NEA_SceneDraw() skip models with a bounding sphere that
+/// is completely outside of it, even if NEA_ModelFrustumCulling() hasn't been
+/// enabled. NEA_CameraFrustumTestSphereI() can be used to test other objects
+/// against the same frustum.
+///
+/// Models without bounds, or with bounds that don't contain all their
+/// vertices, may disappear when they are close to the border between passes.
+/// That's why this has to be enabled explicitly.
+///
+/// @param enable True to enable it, false to disable it.
+void NEA_TwoPassCulling(bool enable);
+
+/// Returns the columns of the screen drawn by the current two-pass pass.
+///
+/// The range is [x0, x1), the band of the current pass. With an adaptive split
+/// line both passes overlap by a few columns.
+///
+/// @param x0 Pointer to store the first column. It can be NULL.
+/// @param x1 Pointer to store the column after the last one. It can be NULL.
+void NEA_TwoPassGetPassColumns(int *x0, int *x1);
+
 /// Draws 3D scenes in both screens.
 ///
 /// By default, the main screen is the top screen and the sub screen is the
@@ -270,6 +359,35 @@ void NEA_ProcessDual(NEA_Voidfunc mainscreen, NEA_Voidfunc subscreen);
 void NEA_ProcessDualArg(NEA_VoidArgfunc mainscreen, NEA_VoidArgfunc subscreen,
                        void *argmain, void *argsub);
 
+/// Max number of frames of a screen in NEA_DualFrameRatioSet().
+#define NEA_DUAL_MAX_FRAMES 16
+
+/// Sets how often each screen is drawn by NEA_ProcessDual().
+///
+/// The 3D engine only draws one screen per frame, and the other screen keeps
+/// showing its last picture. By default the screens are drawn in alternate
+/// frames, at 30 FPS each. Out of every (main_frames + sub_frames) frames, the
+/// main screen is drawn main_frames times and the sub screen sub_frames times,
+/// spread as evenly as possible. For example, 2 and 1 draw the main screen at
+/// 40 FPS and the sub screen at 20 FPS.
+///
+/// If sub_frames is 0, the sub screen is only drawn after a call to
+/// NEA_DualSubScreenInvalidate(), and the main screen is drawn at 60 FPS the
+/// rest of the time. The sub screen is always drawn in the frame after this
+/// function is called.
+///
+/// The values are reset to 1 and 1 when a dual 3D mode is initialized.
+///
+/// @param main_frames Frames of the main screen (1 - NEA_DUAL_MAX_FRAMES).
+/// @param sub_frames Frames of the sub screen (0 - NEA_DUAL_MAX_FRAMES).
+void NEA_DualFrameRatioSet(int main_frames, int sub_frames);
+
+/// Draws the sub screen in the next call to NEA_ProcessDual().
+///
+/// Use it when the sub screen is only drawn on demand (see
+/// NEA_DualFrameRatioSet()) and its scene has changed.
+void NEA_DualSubScreenInvalidate(void);
+
 /// Inits the console of libnds in the main screen.
 ///
 /// It works in dual 3D mode as well, and it uses VRAM_F for the background
@@ -379,11 +497,51 @@ int NEA_GetPolygonCount(void);
 /// @return Returns the number of vertices (0 - 6144).
 int NEA_GetVertexCount(void);
 
+/// Statistics of the geometry pipeline during one frame.
+///
+/// Cycles are bus cycles (33.51 MHz, 560190 per frame) measured with the timers
+/// of the profiler (see NEA_PROFILE_TIMER). Passes are the bands of two-pass
+/// modes and the screens of dual 3D modes. Other modes only use pass 0.
+typedef struct {
+    u32 lists;            ///< Display lists sent
+    u32 fifo_words;       ///< Words sent to the GX FIFO by display lists
+    u32 stall_cycles;     ///< Cycles the CPU waited for DMA or the GX FIFO
+    u32 cpu_send_cycles;  ///< Cycles spent sending display lists with the CPU
+    u32 passes;           ///< Number of passes that ended in the frame
+    u32 pass_words[NEA_TWO_PASS_MAX_BANDS];    ///< FIFO words of each pass
+    u32 pass_polygons[NEA_TWO_PASS_MAX_BANDS]; ///< Polygons of each pass
+    u32 pass_vertices[NEA_TWO_PASS_MAX_BANDS]; ///< Vertices of each pass
+    /// GXSTAT FIFO entries left at the end of a pass
+    u32 pass_fifo_entries[NEA_TWO_PASS_MAX_BANDS];
+    /// Cycles from the end of a pass until the geometry engine went idle
+    u32 pass_idle_cycles[NEA_TWO_PASS_MAX_BANDS];
+    /// Scanline when the geometry engine went idle
+    u32 pass_idle_vcount[NEA_TWO_PASS_MAX_BANDS];
+} NEA_GPUStats;
+
+/// Enables or disables the statistics of the geometry pipeline.
+///
+/// When they are enabled, the display list functions count the words they send
+/// and the time they wait, and the CPU waits for the geometry engine to be idle
+/// at the end of every pass to measure how long it takes. Disable them when
+/// they aren't needed.
+///
+/// @param enable true to enable them.
+void NEA_GPUStatsEnable(bool enable);
+
+/// Gets the statistics of the geometry pipeline of the last complete frame.
+///
+/// A frame ends when NEA_WaitForVBL() is called.
+///
+/// @param stats Destination.
+void NEA_GPUStatsGet(NEA_GPUStats *stats);
+
 /// Effects supported by NEA_SpecialEffectSet().
 typedef enum {
     NEA_NONE,  ///< Disable effects
     NEA_NOISE, ///< Horizontal noise
-    NEA_SINE   ///< Horizontal sine waves
+    NEA_SINE,  ///< Horizontal sine waves
+    NEA_TABLE  ///< Values of a register per line, see NEA_SpecialEffectTableSet()
 } NEA_SpecialEffects;
 
 /// Vertical blank interrupt handler.
@@ -412,6 +570,30 @@ void NEA_HBLFunc(void);
 /// @param effect One effect out of NEA_NOISE, NEA_SINE or NEA_NONE.
 void NEA_SpecialEffectSet(NEA_SpecialEffects effect);
 
+/// Selects how NEA_NOISE and NEA_SINE are drawn.
+///
+/// By default, NEA_HBLFunc() calculates the value of each line. If DMA is
+/// enabled, the values of all possible frames are calculated when the effect is
+/// configured, and DMA channel 1 copies the values of each frame to the
+/// register at every horizontal blank. NEA_HBLFunc() is then only needed to
+/// measure CPU usage. NEA_NOISE repeats the same random values in a different
+/// order every frame.
+///
+/// @param enable true to use DMA, false to use the HBL interrupt.
+void NEA_SpecialEffectDMA(bool enable);
+
+/// Writes a different value to a register at each line with HBL DMA.
+///
+/// The table has one value per line (192 values), and it is copied during
+/// every vertical blank, so it can be modified at any time and the changes
+/// are displayed from the next frame. The register can be any 16-bit register
+/// of the 2D engines, like scroll or blending registers. This uses DMA channel
+/// 1, and it can be stopped with NEA_SpecialEffectSet(NEA_NONE).
+///
+/// @param reg Register to write to.
+/// @param table Values of each line.
+void NEA_SpecialEffectTableSet(vu16 *reg, const u16 *table);
+
 /// Configures the special effect NEA_NOISE.
 ///
 /// If the effect is paused, the values won't be refreshed until it is unpaused.
@@ -437,7 +619,8 @@ typedef enum {
     /// Allows Nitro Engine Advanced to skip the wait to the vertical blank if CPU load
     /// is greater than 100%. You can use this if you don't need to load
     /// textures or do anything else during the VBL. It is needed to set
-    /// NEA_HBLFunc() as a HBL interrupt handler for this flag to work.
+    /// NEA_HBLFunc() as a HBL interrupt handler for this flag to work. It is
+    /// ignored if frame pacing is enabled, see NEA_FramePacingSet().
     NEA_CAN_SKIP_VBL = BIT(3),
     /// Updates spatial sound sources (volume/panning from camera distance).
     NEA_UPDATE_SOUND = BIT(4),
@@ -446,7 +629,33 @@ typedef enum {
     /// Synchronizes ARM7 rigid body physics state.
     NEA_UPDATE_RIGIDBODY = BIT(6),
     /// Flushes hardware 2D OAM data for sprites.
-    NEA_UPDATE_HW2D = BIT(7)
+    NEA_UPDATE_HW2D = BIT(7),
+    /// Updates all particle pools.
+    NEA_UPDATE_PARTICLES = BIT(8),
+    /// Defragments texture memory a bit after the vertical blank, see
+    /// NEA_TextureDefragMemStep().
+    NEA_UPDATE_TEXTURE_DEFRAG = BIT(9),
+    /// Uploads streamed textures after the vertical blank, see
+    /// NEA_TextureStreamUpdate().
+    NEA_UPDATE_TEXTURE_STREAM = BIT(10),
+    /// Copies pending texture and palette uploads after the vertical blank,
+    /// see NEA_UploadUpdate(), and the queued palette colors, see
+    /// NEA_PaletteQueueUpdate().
+    NEA_UPDATE_UPLOADS = BIT(11),
+    /// Reads files of the background loader after the uploads, see
+    /// NEA_LoaderUpdate().
+    NEA_UPDATE_LOADER = BIT(12),
+    /// Fills the ring buffer of the audio stream after the vertical blank, see
+    /// NEA_StreamUpdate().
+    NEA_UPDATE_AUDIO_STREAM = BIT(13),
+    /// Runs jobs of the scheduler until the vertical blank, see NEA_JobRun().
+    NEA_UPDATE_JOBS = BIT(14),
+    /// Defragments palette memory a bit after the vertical blank, see
+    /// NEA_PaletteDefragMemStep().
+    NEA_UPDATE_PALETTE_DEFRAG = BIT(15),
+    /// Copies and writes the frame saved by NEA_CaptureStart() after the
+    /// background loader, see NEA_CaptureUpdate().
+    NEA_UPDATE_CAPTURE = BIT(16)
 } NEA_UpdateFlags;
 
 /// Waits for the vertical blank and updates the selected systems.
@@ -457,6 +666,95 @@ typedef enum {
 /// @param flags Look at NEA_UpdateFlags.
 void NEA_WaitForVBL(NEA_UpdateFlags flags);
 
+/// Default max number of steps simulated by each call to NEA_WaitForVBL().
+#define NEA_FIXED_STEP_DEFAULT_MAX 4
+
+/// Makes animations and physics advance at a fixed rate.
+///
+/// By default, NEA_WaitForVBL() updates animations and physics once per call,
+/// so the game slows down if it can't draw one frame per vertical blank (for
+/// example, in two-pass and dual 3D modes, or when NEA_CAN_SKIP_VBL skips a
+/// frame). With a fixed timestep, NEA_WaitForVBL() counts the vertical blanks
+/// since the previous call and updates them once for every vbls_per_step
+/// vertical blanks. For example, a game that draws at 30 FPS with a step of 1
+/// vertical blank updates them twice per frame.
+///
+/// If the game is so slow that it needs more than max_steps steps in one
+/// call, the rest of the time is dropped and the game slows down instead of
+/// spending even more time catching up.
+///
+/// The vertical blanks are counted by NEA_VBLFunc(), so it must be set as the
+/// VBL interrupt handler.
+///
+/// @param vbls_per_step Vertical blanks per step. 0 disables the fixed
+///                      timestep.
+/// @param max_steps Max number of steps per call to NEA_WaitForVBL(). If it is
+///                  lower than 1, NEA_FIXED_STEP_DEFAULT_MAX is used.
+void NEA_FixedStepSet(int vbls_per_step, int max_steps);
+
+/// Returns the number of steps simulated by the last call to NEA_WaitForVBL().
+///
+/// It is always 1 if the fixed timestep is disabled, and it can be 0 if the
+/// game runs faster than the timestep.
+///
+/// @return Number of steps.
+int NEA_FixedStepGetSteps(void);
+
+/// Returns the fraction of a step that hasn't been simulated yet (f32).
+///
+/// Games can use it to interpolate the positions of objects between their
+/// last two steps, so that they move smoothly with steps longer than one
+/// vertical blank.
+///
+/// @return Fraction between 0 and 1 (f32), or 0 with no fixed timestep.
+int32_t NEA_FixedStepGetAlpha(void);
+
+/// Number of drawn frames used by frame pacing to choose the frame rate.
+#define NEA_FRAME_PACING_HISTORY 8
+
+/// Number of late frames in the history that lock frame pacing to 30 FPS.
+#define NEA_FRAME_PACING_OVERLOAD 3
+
+/// Enables or disables frame pacing.
+///
+/// NEA_CAN_SKIP_VBL doesn't wait for the vertical blank when the game is slow,
+/// so the game drifts from the vertical blanks and it doesn't do less work.
+/// With frame pacing, NEA_WaitForVBL() always waits and measures the time
+/// spent in each frame, and NEA_Process() and NEA_ProcessArg() skip the draw
+/// callback of some frames. The hardware keeps displaying the last frame that
+/// was drawn, and NEA_WaitForVBL() keeps updating all systems every frame.
+///
+/// - If a frame takes longer than a vertical blank, the next one isn't drawn
+///   so that the game can catch up.
+/// - If NEA_FRAME_PACING_OVERLOAD of the last NEA_FRAME_PACING_HISTORY drawn
+///   frames have been late, only one of every two frames is drawn (30 FPS),
+///   which is smoother than skipping frames at random.
+/// - It goes back to 60 FPS when the last NEA_FRAME_PACING_HISTORY drawn
+///   frames have used less than 3/4 of a frame.
+///
+/// Use it with NEA_FixedStepSet() so that the game doesn't slow down. The time
+/// is measured by NEA_VBLFunc(), so it must be set as the VBL interrupt
+/// handler. The other process functions (two-pass and dual 3D modes) always
+/// draw.
+///
+/// @param enable True to enable it, false to disable it.
+void NEA_FramePacingSet(bool enable);
+
+/// Returns the number of vertical blanks per drawn frame chosen by frame
+/// pacing.
+///
+/// @return 1 (60 FPS) or 2 (30 FPS). It is 1 if frame pacing is disabled.
+int NEA_FramePacingGetInterval(void);
+
+/// Returns true if NEA_Process() will draw this frame.
+///
+/// Games can use it to skip their own work that is only needed to draw, like
+/// preparing text or sorting objects.
+///
+/// @return True if the frame will be drawn. It is always true if frame pacing
+///         is disabled.
+bool NEA_FramePacingWillDraw(void);
+
 /// Returns the approximate CPU usage in the previous frame.
 ///
 /// You need to set NEA_WaitForVBL() as a VBL interrupt handler and NEA_HBLFunc()
@@ -609,6 +907,9 @@ void NEA_DebugSetHandlerConsole(void);
 ///
 /// This doesn't work in most emulators, but it works in melonDS.
 ///
+/// Note: The picking functions of NEAPick.h find the object under the stylus on
+/// the CPU, without drawing the objects again, and they work in all emulators.
+///
 /// How to use this test:
 ///
 /// 1. Init the "touch test mode" with NEA_TouchTestStart() to prepare the
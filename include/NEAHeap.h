@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_HEAP_H__
+#define NEA_HEAP_H__
+
+#include <nds.h>
+
+/// @file   NEAHeap.h
+/// @brief  Main RAM heap usage of each system of the engine.
+
+/// @defgroup heap Heap accounting
+///
+/// The VRAM reports (see NEAMemReport.h) show how VRAM is used, but most of
+/// the data of a game lives in the heap of main RAM. The engine counts the
+/// heap memory that each one of its systems allocates, so that the memory of
+/// a level can be budgeted, and so that leaks can be found by checking that
+/// the counters go back to the same values after a level is unloaded.
+///
+/// The size of an allocation is the size of the block reserved by malloc(),
+/// which may be a bit bigger than the size that was requested. Buffers that
+/// are given to another system or to the game (like the data of a file loaded
+/// by the loader that is given to a model) stop being counted by the system
+/// that has allocated them. Memory allocated by the game isn't counted.
+///
+/// @{
+
+/// Systems of the engine whose heap usage is counted.
+typedef enum {
+    NEA_HEAP_MODEL,     ///< Models, meshes and animation groups
+    NEA_HEAP_SCENE,     ///< Scenes and their nodes, grids and batches
+    NEA_HEAP_COLLISION, ///< Collision meshes and their BVHs
+    NEA_HEAP_ANIMATION, ///< Animation files and baked animations
+    NEA_HEAP_SOUND,     ///< Sound effect cache and music streams
+    NEA_HEAP_TEXT,      ///< Compiled text
+    NEA_HEAP_LOADER,    ///< Buffers of the background loader
+    NEA_HEAP_TAG_COUNT  ///< Number of systems
+} NEA_HeapTag;
+
+/// Heap usage of a system.
+typedef struct {
+    size_t current;    ///< Memory used right now
+    size_t peak;       ///< Max memory used since the stats were reset
+    u32 count;         ///< Number of blocks allocated right now
+    u32 allocs;        ///< Allocations done since the stats were reset
+    u32 failures;      ///< Allocations that failed since the stats were reset
+} NEA_HeapStats;
+
+/// Gets the heap usage of a system.
+///
+/// @param tag System.
+/// @param stats Pointer to the struct to fill.
+void NEA_HeapGetStats(NEA_HeapTag tag, NEA_HeapStats *stats);
+
+/// Gets the heap usage of all the systems added together.
+///
+/// The peak is the sum of the peaks of all systems, so it may be bigger than
+/// the real peak.
+///
+/// @param stats Pointer to the struct to fill.
+void NEA_HeapGetTotalStats(NEA_HeapStats *stats);
+
+/// Resets the peaks, the allocation counts and the failure counts of all
+/// systems.
+///
+/// The peaks are set to the memory used right now.
+void NEA_HeapResetStats(void);
+
+/// Returns the name of a system.
+///
+/// @param tag System.
+/// @return Name of the system.
+const char *NEA_HeapGetTagName(NEA_HeapTag tag);
+
+/// Formats the usage of all systems as a table with one line per system.
+///
+/// Each line has the name of the system, the memory used right now and the
+/// peak in KB, and the number of blocks allocated right now.
+///
+/// @param buffer Buffer to write the table to.
+/// @param size Size of the buffer in bytes.
+void NEA_HeapFormat(char *buffer, size_t size);
+
+/// Prints the table of NEA_HeapFormat() with printf().
+///
+/// It can be used to send the table to the console of libnds, or to the debug
+/// console of an emulator if the standard output is redirected there.
+void NEA_HeapPrint(void);
+
+/// @}
+
+#endif // NEA_HEAP_H__
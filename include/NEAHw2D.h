@@ -28,6 +28,12 @@ extern "C" {
 // Enumerations
 // ---------------------------------------------------------------------------
 
+/// Default number of bytes of streamed OBJ frames copied to VRAM per frame.
+#define NEA_HW2D_OBJ_STREAM_DEFAULT_BUDGET (8 * 1024)
+
+/// Max width and height of the cells of a glyph cache, in tiles.
+#define NEA_HW2D_GLYPH_MAX_CELL 4
+
 /// 2D engine selection.
 typedef enum {
     NEA_ENGINE_MAIN = 0, ///< Main engine (top screen by default)
@@ -102,6 +108,14 @@ typedef struct {
     int scroll_x;            ///< Horizontal scroll
     int scroll_y;            ///< Vertical scroll
     bool visible;            ///< Whether the BG is visible
+    const u16 *stream_map;   ///< Large map streamed to VRAM (NULL if none)
+    u16 *stream_owned;       ///< Large map loaded from a file (freed on delete)
+    int stream_width;        ///< Width of the large map in tiles
+    int stream_height;       ///< Height of the large map in tiles
+    int stream_x, stream_y;  ///< First tile of the area written to VRAM
+    bool stream_refill;      ///< The whole visible area must be written
+    bool stream_pending;     ///< The scroll has changed since the last update
+    void *glyph_cache;       ///< Glyph tile cache (NULL if none)
 } NEA_Hw2DBG;
 
 /// Hardware OBJ sprite state.
@@ -122,6 +136,10 @@ typedef struct {
     int num_frames;          ///< Total animation frames
     int affine_index;        ///< Affine matrix (-1 = none)
     bool double_size;        ///< Double area for affine sprites
+    bool dirty;              ///< OAM entry must be rebuilt
+    const u8 *frame_data;    ///< Streamed frames in RAM (NULL if not streamed)
+    void *frame_owned;       ///< Frames loaded from a file (freed on delete)
+    int loaded_frame;        ///< Streamed frame in VRAM (-1 if none)
 } NEA_Hw2DOBJ;
 
 // ---------------------------------------------------------------------------
@@ -146,6 +164,35 @@ void NEA_Hw2DSystemEnd(void);
 /// Used by the texture system to avoid allocating 3D textures in 2D banks.
 NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void);
 
+/// Claims more VRAM banks for the 2D pipeline after NEA_Hw2DInit().
+///
+/// The banks of each field are added to the banks that the field already has.
+/// If any of banks A to D is used for textures, the textures are moved out of
+/// it with NEA_TextureBanksRelease() first, so this should be called right
+/// after the vertical blank starts. Nothing changes if the textures can't be
+/// moved.
+///
+/// Bank E can't be claimed if it holds texture palettes, and bank D can't be
+/// claimed while the impostors use it. Backgrounds are allocated one after the
+/// other, so banks for backgrounds should be added right after the ones that
+/// the field already has.
+///
+/// @param config Banks to add to each field.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DClaimBanks(const NEA_Hw2DVRAMConfig *config);
+
+/// Releases VRAM banks claimed by the 2D pipeline.
+///
+/// All the backgrounds or sprites of the fields that use any of those banks
+/// must have been deleted. Banks that were taken from the texture system by
+/// NEA_Hw2DClaimBanks() are given back to it with NEA_TextureBanksAcquire(),
+/// the rest are left in LCD mode.
+///
+/// @param banks Banks to release. Banks not claimed by Hw2D are ignored.
+/// @return 0 on success, -1 on error (a background or sprite is still using
+///         the banks).
+int NEA_Hw2DReleaseBanks(NEA_VRAMBankFlags banks);
+
 // ---------------------------------------------------------------------------
 // Tiled backgrounds
 // ---------------------------------------------------------------------------
@@ -202,6 +249,9 @@ int NEA_Hw2DBGLoadPalette(NEA_Hw2DBG *bg, const void *data,
                            int num_colors, int slot);
 
 /// Set background scroll offset.
+///
+/// For backgrounds that stream a large map, the offset is relative to the
+/// large map, and it is applied during the next NEA_Hw2DBGUpdateAll().
 void NEA_Hw2DBGSetScroll(NEA_Hw2DBG *bg, int x, int y);
 
 /// Set background draw priority (0 = highest, 3 = lowest).
@@ -221,6 +271,55 @@ void NEA_Hw2DBGSetTile(NEA_Hw2DBG *bg, int x, int y, u16 value);
 /// Get a tile entry from a tiled background's map.
 u16 NEA_Hw2DBGGetTile(const NEA_Hw2DBG *bg, int x, int y);
 
+/// Stream a tile map bigger than the hardware map into a tiled background.
+///
+/// The hardware map is used as a window over the large map. When the scroll
+/// set with NEA_Hw2DBGSetScroll() moves, only the rows and columns of tiles
+/// that become visible are written to VRAM, and the scroll registers are
+/// updated at the same time by NEA_Hw2DBGUpdateAll() during the vertical
+/// blank. The cost per frame depends on the scroll speed, not on the size of
+/// the map. Tiles outside of the large map are written as 0.
+///
+/// A background 256 pixels wide has no spare column, so a column of tiles
+/// is wrong while it scrolls in. Use a width of 512 pixels to scroll
+/// horizontally.
+///
+/// The map must remain valid until the background is deleted or
+/// NEA_Hw2DBGStreamStop() is called.
+///
+/// @param bg     Tiled background.
+/// @param map    Tile entries of the large map, row by row.
+/// @param width  Width of the large map in tiles.
+/// @param height Height of the large map in tiles.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DBGStreamSetMap(NEA_Hw2DBG *bg, const u16 *map, int width,
+                            int height);
+
+/// Load a large tile map from a NitroFS file and stream it.
+///
+/// The file is loaded to RAM and it is freed when the background is deleted or
+/// NEA_Hw2DBGStreamStop() is called. See NEA_Hw2DBGStreamSetMap().
+///
+/// @param bg     Tiled background.
+/// @param path   Path to the file with the tile entries, row by row.
+/// @param width  Width of the large map in tiles.
+/// @param height Height of the large map in tiles.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DBGStreamLoadMapFAT(NEA_Hw2DBG *bg, const char *path, int width,
+                                int height);
+
+/// Stop streaming a large map into a background.
+///
+/// The contents of the hardware map are left untouched.
+///
+/// @param bg Tiled background.
+void NEA_Hw2DBGStreamStop(NEA_Hw2DBG *bg);
+
+/// Write the tiles of streamed maps that have become visible. Called via weak
+/// reference from NEA_WaitForVBL() during the vertical blank when
+/// NEA_UPDATE_HW2D is set.
+void NEA_Hw2DBGUpdateAll(void);
+
 // ---------------------------------------------------------------------------
 // Bitmap backgrounds
 // ---------------------------------------------------------------------------
@@ -305,8 +404,45 @@ void NEA_Hw2DOBJSetFlip(NEA_Hw2DOBJ *obj, bool hflip, bool vflip);
 void NEA_Hw2DOBJSetPriority(NEA_Hw2DOBJ *obj, int priority);
 
 /// Set the current animation frame (for multi-frame sprite sheets).
+///
+/// For sprites with streamed frames, the new frame is copied to VRAM during one
+/// of the next vertical blanks, see NEA_Hw2DOBJStreamFrames().
 void NEA_Hw2DOBJSetFrame(NEA_Hw2DOBJ *obj, int frame);
 
+/// Stream the animation frames of a sprite from RAM.
+///
+/// The sprite only has VRAM for one frame. When the frame changes, the new
+/// graphics are copied with DMA during the vertical blank by
+/// NEA_Hw2DOBJUpdateAll(). All sprites share the byte budget set with
+/// NEA_Hw2DOBJSetStreamBudget(), so a sprite may show its previous frame for a
+/// few frames if many sprites change at once.
+///
+/// The data must remain valid until the sprite is deleted.
+///
+/// @param obj  OBJ sprite.
+/// @param data Graphics of all frames, one after the other.
+/// @param size Size of the data in bytes.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DOBJStreamFrames(NEA_Hw2DOBJ *obj, const void *data, size_t size);
+
+/// Load the animation frames of a sprite from a NitroFS file and stream them.
+///
+/// The file is kept in RAM until the sprite is deleted. See
+/// NEA_Hw2DOBJStreamFrames().
+///
+/// @param obj  OBJ sprite.
+/// @param path Path to the file.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DOBJStreamFramesFAT(NEA_Hw2DOBJ *obj, const char *path);
+
+/// Set the max number of bytes of streamed frames copied to VRAM per frame.
+///
+/// At least one frame is copied every vertical blank even if it's bigger than
+/// the budget.
+///
+/// @param bytes Budget in bytes (NEA_HW2D_OBJ_STREAM_DEFAULT_BUDGET by default).
+void NEA_Hw2DOBJSetStreamBudget(size_t bytes);
+
 /// Assign an affine transformation matrix to a sprite.
 ///
 /// @param obj         OBJ sprite.
@@ -325,14 +461,56 @@ void NEA_Hw2DOBJSetRotScaleI(NEA_Hw2DEngine engine, int rot_index,
                               int angle, int32_t sx, int32_t sy);
 
 /// Flush OAM data for a specific engine. Called internally during VBL.
+///
+/// Only the sprites and affine matrices that have changed since the last call
+/// are written to the OAM shadow copy, and only the range of modified entries
+/// is copied to OAM.
 void NEA_Hw2DOBJUpdate(NEA_Hw2DEngine engine);
 
 /// Flush OAM data for all engines. Called via weak reference from
-/// NEA_WaitForVBL() when NEA_UPDATE_HW2D is set.
+/// NEA_WaitForVBL() right after the vertical blank starts when NEA_UPDATE_HW2D
+/// is set.
 void NEA_Hw2DOBJUpdateAll(void);
 
 // ---------------------------------------------------------------------------
-// Text rendering on bitmap backgrounds
+// 3D sprites drawn as OBJ sprites
+// ---------------------------------------------------------------------------
+
+/// Draw a 3D sprite with a hardware OBJ of the main engine when possible.
+///
+/// The texture of the material of the sprite is converted to OBJ tiles, so the
+/// sprite doesn't use any polygon of the 3D engine when it's drawn by
+/// NEA_SpriteDraw() or NEA_SpriteDrawAll(). It is only drawn as an OBJ if its
+/// alpha value is 31, its color is NEA_White, its canvas is the whole texture,
+/// and the execution mode is NEA_ModeSingle3D. Rotated or scaled sprites also
+/// need an affine matrix, and the rotated and scaled sprite must fit in the
+/// double size area of the OBJ. If not, it is drawn as a 3D quad.
+///
+/// OBJs are always displayed over the 3D layer, and color 0 of the palette is
+/// always transparent. The OBJ keeps the graphics converted by this function,
+/// call it again after changing the material.
+///
+/// @param sprite       Sprite with a material of a valid OBJ size.
+/// @param fmt          Format of the texture (NEA_PAL16 or NEA_PAL256).
+/// @param texture      Texels, like the ones passed to NEA_MaterialTexLoad().
+/// @param palette      Palette (16 or 256 colors), or NULL if it's loaded.
+/// @param palette_slot Palette slot (0-15, 16-color textures only).
+/// @param affine_index Affine matrix for rotation and scale (0-31), or -1 to
+///                     always draw rotated and scaled sprites with 3D quads.
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DSpriteAttach(NEA_Sprite *sprite, NEA_TextureFormat fmt,
+                         const void *texture, const u16 *palette,
+                         int palette_slot, int affine_index);
+
+/// Stop drawing a 3D sprite with a hardware OBJ and delete the OBJ.
+///
+/// It is called by NEA_SpriteDelete().
+///
+/// @param sprite Sprite.
+void NEA_Hw2DSpriteDetach(NEA_Sprite *sprite);
+
+// ---------------------------------------------------------------------------
+// Text rendering
 // ---------------------------------------------------------------------------
 
 /// Render text onto a 16bpp bitmap background using a rich text font slot.
@@ -351,6 +529,138 @@ void NEA_Hw2DOBJUpdateAll(void);
 int NEA_Hw2DTextRender(NEA_Hw2DBG *bg, u32 slot, const char *str,
                         int x, int y);
 
+/// Create a glyph tile cache to render text on a tiled background.
+///
+/// Each character is drawn in a cell of cell_w x cell_h tiles. The first time
+/// that a character is rendered, its glyph is rasterized into the tiles of a
+/// free cell. After that, rendering it again only writes the map entries of
+/// its cell, so updating text that changes often (scores, timers, chat) only
+/// costs a few halfword writes. When all cells are used, the glyph that was
+/// rendered least recently is replaced.
+///
+/// The cache must have enough cells for all the different characters shown on
+/// the screen at the same time: if a glyph is replaced while it's still on the
+/// screen, the new glyph is shown in its place.
+///
+/// The tiles of the cells start at first_tile in the tile base of the
+/// background. They must fit in it (512 tiles for 4bpp backgrounds, 256 for
+/// 8bpp backgrounds), and they must not be used by other graphics. Any font
+/// format except GL_COMPRESSED is supported: pixels with alpha (or with a
+/// palette index other than 0) use the color set with
+/// NEA_Hw2DGlyphCacheSetColor(). Kerning isn't applied, the font should be
+/// monospaced or the cells wide enough for the widest glyph.
+///
+/// @param bg         Tiled background (NEA_HW2D_BG_TILED_4BPP or 8BPP).
+/// @param slot       Rich text font slot with a bitmap loaded to RAM.
+/// @param first_tile First tile used by the cache.
+/// @param num_cells  Number of glyphs kept in the cache.
+/// @param cell_w     Width of a cell in tiles (1 - NEA_HW2D_GLYPH_MAX_CELL).
+/// @param cell_h     Height of a cell in tiles (1 - NEA_HW2D_GLYPH_MAX_CELL).
+/// @return 0 on success, -1 on error.
+int NEA_Hw2DGlyphCacheInit(NEA_Hw2DBG *bg, u32 slot, int first_tile,
+                            int num_cells, int cell_w, int cell_h);
+
+/// Delete the glyph tile cache of a background.
+///
+/// The map and the tiles aren't cleared. It is called by NEA_Hw2DBGDelete().
+///
+/// @param bg Tiled background.
+void NEA_Hw2DGlyphCacheEnd(NEA_Hw2DBG *bg);
+
+/// Set the color of the glyphs of a glyph tile cache.
+///
+/// By default, glyphs use color 1 of palette 0. Changing the color empties the
+/// cache, text already on the screen has to be rendered again.
+///
+/// @param bg      Tiled background with a glyph cache.
+/// @param palette Palette slot of the map entries (0-15, 4bpp only).
+/// @param color   Palette index of the pixels of the glyphs (1-15 for 4bpp,
+///                1-255 for 8bpp).
+void NEA_Hw2DGlyphCacheSetColor(NEA_Hw2DBG *bg, int palette, int color);
+
+/// Render text onto a tiled background using its glyph tile cache.
+///
+/// Every character takes one cell, and line breaks move to the first column
+/// of the next row of cells. Only the map entries of the cells are written,
+/// and the glyphs that aren't in the cache are rasterized first. Shorter text
+/// doesn't clear the cells of older text, pad it with spaces if needed. Cells
+/// outside of the background aren't written.
+///
+/// @param bg  Tiled background with a glyph cache.
+/// @param str Null-terminated UTF-8 string to render.
+/// @param x   X position of the first cell in tiles.
+/// @param y   Y position of the first cell in tiles.
+/// @return 0 on success, -1 on error (a glyph needed by this string would
+///         have replaced another one used by it).
+int NEA_Hw2DTextRenderTiled(NEA_Hw2DBG *bg, const char *str, int x, int y);
+
+// ---------------------------------------------------------------------------
+// GUI backend
+// ---------------------------------------------------------------------------
+
+/// Draw the GUI objects configured for Hw2D on a tiled background.
+///
+/// NEA_GUIDraw() writes the map entries of the objects configured with the
+/// NEA_GUI*ConfigHw2D() functions to the map of the background instead of
+/// drawing them with the 3D engine, and it only writes them again when the
+/// state of an object changes. The rest of the objects are still drawn with
+/// the 3D engine. If all of them are configured for Hw2D, NEA_GUIDraw() doesn't
+/// use the 3D engine, so it can be called outside of the 3D drawing function,
+/// and NEA_2DViewInit() isn't needed.
+///
+/// The rectangles of the objects should be aligned to 8 pixels. The tiles of
+/// an object are consecutive, a button of 64x16 pixels uses 16 tiles, 8 per
+/// row. Deleting an object clears its map entries to 0.
+///
+/// This must be called again with NULL before the background is deleted or
+/// NEA_Hw2DSystemEnd() is called.
+///
+/// @param bg Tiled background, or NULL to draw everything with the 3D engine.
+void NEA_GUISetHw2DBackground(NEA_Hw2DBG *bg);
+
+/// Configure the tiles of a button.
+///
+/// @param btn          Button.
+/// @param tiles        Map entry of the first tile when not pressed.
+/// @param pressedtiles Map entry of the first tile when pressed.
+void NEA_GUIButtonConfigHw2D(NEA_GUIObj *btn, u16 tiles, u16 pressedtiles);
+
+/// Configure the tiles of a check box.
+///
+/// @param chbx           Check box.
+/// @param tilestrue      Map entry of the first tile when checked.
+/// @param tilesfalse     Map entry of the first tile when not checked.
+/// @param pressedpalette Palette of the map entries when pressed (0-15, 4bpp
+///                       backgrounds only), or -1 to keep the same palette.
+void NEA_GUICheckBoxConfigHw2D(NEA_GUIObj *chbx, u16 tilestrue,
+                               u16 tilesfalse, int pressedpalette);
+
+/// Configure the tiles of a radio button.
+///
+/// @param rdbtn          Radio button.
+/// @param tilestrue      Map entry of the first tile when checked.
+/// @param tilesfalse     Map entry of the first tile when not checked.
+/// @param pressedpalette Palette of the map entries when pressed (0-15, 4bpp
+///                       backgrounds only), or -1 to keep the same palette.
+void NEA_GUIRadioButtonConfigHw2D(NEA_GUIObj *rdbtn, u16 tilestrue,
+                                  u16 tilesfalse, int pressedpalette);
+
+/// Configure the tiles and the sliding button of a slide bar.
+///
+/// The buttons on the sides use consecutive tiles, the bar between them uses
+/// the same tile everywhere. The sliding button is an OBJ of the engine of the
+/// background, because it moves one pixel at a time. Its second frame, if it
+/// has one, is used while it's pressed.
+///
+/// @param sldbar          Slide bar.
+/// @param btntiles        Map entry of the first tile of the side buttons.
+/// @param pressedbtntiles Map entry of the first tile of pressed side buttons.
+/// @param bartile         Map entry of the tile of the bar.
+/// @param barbtn          OBJ of the sliding button, or NULL to not draw it.
+void NEA_GUISlideBarConfigHw2D(NEA_GUIObj *sldbar, u16 btntiles,
+                               u16 pressedbtntiles, u16 bartile,
+                               NEA_Hw2DOBJ *barbtn);
+
 /// @}
 
 #ifdef __cplusplus
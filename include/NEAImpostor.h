@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_IMPOSTOR_H__
+#define NEA_IMPOSTOR_H__
+
+#include <nds.h>
+
+#include "NEAModel.h"
+#include "NEATexture.h"
+
+/// @file   NEAImpostor.h
+/// @brief  Billboards that replace distant models by a picture of them.
+
+/// @defgroup impostor Impostors
+///
+/// An impostor draws a model that is far away from the camera as a single
+/// textured quad that faces the camera. The picture of the model is rendered
+/// by the 3D engine and saved with the display capture unit into a texture
+/// atlas, and it is only rendered again when the direction from the model to
+/// the camera changes more than a threshold.
+///
+/// Refreshing the pictures uses the 3D engine for one whole frame. The
+/// displayed picture of the previous frame is captured into VRAM_D and shown
+/// again during that frame, so refreshes are seen as a repeated frame. They
+/// are done at most once every NEA_IMPOSTOR_REFRESH_INTERVAL frames:
+///
+///     NEA_Init3D();
+///     NEA_TextureSystemReset(0, 0, NEA_VRAM_ABC);
+///     NEA_ImpostorSystemInit();
+///
+///     NEA_Impostor *tree = NEA_ImpostorCreate(tree_model);
+///     NEA_ImpostorSetDistance(tree, 10);
+///
+///     void Draw3DScene(void)
+///     {
+///         NEA_CameraUse(camera);
+///         NEA_ImpostorDraw(tree); // Draws the model or the quad
+///     }
+///
+///     while (1)
+///     {
+///         NEA_WaitForVBL(NEA_UPDATE_UPLOADS);
+///         NEA_Process(Draw3DScene);
+///     }
+///
+/// The pictures are copied from VRAM_D to the atlas with the upload queue, so
+/// NEA_WaitForVBL() must be called with NEA_UPDATE_UPLOADS. Impostors are
+/// only supported in NEA_ModeSingle3D, with NEA_Process() or
+/// NEA_ProcessArg(). Models need a bounding sphere, see
+/// NEA_ModelSetBoundingSphereI().
+///
+/// @{
+
+#define NEA_IMPOSTOR_MAX        4  ///< Max number of impostors
+#define NEA_IMPOSTOR_CELL_SIZE  64 ///< Size of the picture of an impostor
+
+/// Min number of frames between two refreshes of the pictures.
+#define NEA_IMPOSTOR_REFRESH_INTERVAL 8
+
+/// Default angle that the view has to turn before refreshing a picture.
+#define NEA_IMPOSTOR_DEFAULT_THRESHOLD 10
+
+/// Holds information of an impostor.
+typedef struct {
+    NEA_Model *model;      ///< Model replaced by the impostor
+    int cell;              ///< Cell of the texture atlas
+    int32_t distance;      ///< Distance to the camera to use the quad (f32)
+    int32_t cos_threshold; ///< Cosine of the angle of the threshold (f32)
+    int32_t view_dir[3];   ///< Direction to the camera of the picture (f32)
+    int32_t next_dir[3];   ///< Direction of the picture being captured (f32)
+    bool valid;            ///< The picture is in the atlas
+    bool dirty;            ///< The picture has to be rendered again
+    bool capturing;        ///< The picture is being captured
+    u8 alpha;              ///< Alpha value of the quad
+    u8 id;                 ///< Polygon ID of the quad
+} NEA_Impostor;
+
+/// Initializes the impostor system.
+///
+/// It takes VRAM_D for the display capture, so the texture system must have
+/// been reset without it. Hw2D must not have claimed VRAM_D either. The
+/// system is ended when the texture system is ended or reset.
+///
+/// @return It returns 0 on success, -1 on error.
+int NEA_ImpostorSystemInit(void);
+
+/// Ends the impostor system and deletes all impostors.
+///
+/// The models aren't deleted.
+void NEA_ImpostorSystemEnd(void);
+
+/// Creates an impostor for a model.
+///
+/// @param model Model. It must have a bounding sphere.
+/// @return Pointer to the impostor, or NULL if there are no free impostors.
+NEA_Impostor *NEA_ImpostorCreate(NEA_Model *model);
+
+/// Deletes an impostor.
+///
+/// The model isn't deleted.
+///
+/// @param imp Pointer to the impostor.
+void NEA_ImpostorDelete(NEA_Impostor *imp);
+
+/// Sets the distance to the camera from which the quad is drawn.
+///
+/// @param imp Pointer to the impostor.
+/// @param distance Distance (f32).
+void NEA_ImpostorSetDistanceI(NEA_Impostor *imp, int32_t distance);
+
+/// Sets the distance to the camera from which the quad is drawn.
+///
+/// @param i Pointer to the impostor.
+/// @param d Distance (float).
+#define NEA_ImpostorSetDistance(i, d) \
+    NEA_ImpostorSetDistanceI(i, floattof32(d))
+
+/// Sets the angle that the view has to turn to refresh the picture.
+///
+/// @param imp Pointer to the impostor.
+/// @param degrees Angle in degrees (1 - 90).
+void NEA_ImpostorSetThreshold(NEA_Impostor *imp, int degrees);
+
+/// Sets the alpha value and polygon ID of the quad.
+///
+/// @param imp Pointer to the impostor.
+/// @param alpha Alpha value (1 - 31).
+/// @param id Polygon ID (0 - 63).
+void NEA_ImpostorSetParams(NEA_Impostor *imp, u8 alpha, u8 id);
+
+/// Renders the picture of an impostor again in the next refresh.
+///
+/// This must be called if the model changes in a way that can be seen, like
+/// a new animation frame or material.
+///
+/// @param imp Pointer to the impostor.
+void NEA_ImpostorInvalidate(NEA_Impostor *imp);
+
+/// Draws an impostor.
+///
+/// It draws the model if it's closer to the camera than the distance of the
+/// impostor, or if the picture isn't ready yet. If not, it draws a quad with
+/// the picture of the model, and it asks for a refresh if the view has turned
+/// more than the threshold. It must be called after NEA_CameraUse().
+///
+/// @param imp Pointer to the impostor.
+void NEA_ImpostorDraw(NEA_Impostor *imp);
+
+/// Returns the material of the texture atlas.
+///
+/// @return Material, or NULL if the system isn't initialized.
+NEA_Material *NEA_ImpostorGetAtlas(void);
+
+/// @}
+
+#endif // NEA_IMPOSTOR_H__
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_JOB_H__
+#define NEA_JOB_H__
+
+#include <nds.h>
+
+/// @file   NEAJob.h
+/// @brief  Cooperative job scheduler.
+
+/// @defgroup job Job scheduler
+///
+/// The CPU spends a lot of time waiting: for the GX FIFO to accept more
+/// commands, for DMA transfers of display lists, and for the vertical blank.
+/// The scheduler keeps a queue of short jobs (AI, decoding assets, etc) and runs
+/// them during those waits:
+///
+/// - NEA_DisplayListWait() and the DMA display list functions run jobs while
+///   they wait, as long as their cost is below the budget set with
+///   NEA_JobSetWaitBudget().
+/// - NEA_WaitForVBL() runs jobs that fit in the time left until the vertical
+///   blank if NEA_UPDATE_JOBS is used.
+///
+/// Jobs can't be interrupted, so each job has an estimated cost in bus cycles
+/// (33.51 MHz, 560190 cycles per frame) and it only runs if it fits in the time
+/// available. The cost is measured with the timers of the profiler (see
+/// NEA_PROFILE_TIMER) every time the job runs, and the estimate is updated.
+///
+/// A job can do its work in small steps: it returns false to be run again
+/// later, and true when it has finished.
+///
+/// Jobs may run while a display list is being sent, so they must not send
+/// commands to the GPU or start DMA transfers.
+///
+/// @{
+
+#define NEA_JOB_QUEUE_SIZE 32 ///< Max number of pending jobs
+
+/// Default cost limit of jobs run while waiting for the GPU, in bus cycles.
+#define NEA_JOB_DEFAULT_WAIT_BUDGET (8 * 1024)
+
+/// Function of a job.
+///
+/// @param arg Argument given to NEA_JobAdd().
+/// @return true if the job has finished, false to run it again later.
+typedef bool (*NEA_JobFunc)(void *arg);
+
+/// Adds a job to the queue.
+///
+/// Jobs with a higher priority run first. Jobs with the same priority run in
+/// the order they were added, and a job that needs to run again goes after the
+/// other jobs of its priority.
+///
+/// @param fn Function of the job.
+/// @param arg Argument passed to the function.
+/// @param priority Priority of the job.
+/// @param cost Estimated cost of one run of the job in bus cycles.
+/// @return It returns 1 on success, 0 on error.
+int NEA_JobAdd(NEA_JobFunc fn, void *arg, int priority, u32 cost);
+
+/// Removes all pending jobs with the given function and argument.
+///
+/// @param fn Function of the jobs.
+/// @param arg Argument of the jobs.
+void NEA_JobCancel(NEA_JobFunc fn, void *arg);
+
+/// Returns the number of pending jobs.
+///
+/// @return Number of jobs.
+int NEA_JobGetCount(void);
+
+/// Sets the max cost of the jobs run while waiting for the GPU.
+///
+/// @param cycles Cost in bus cycles. If it is 0, no jobs are run while waiting.
+void NEA_JobSetWaitBudget(u32 cycles);
+
+/// Runs jobs until a budget is used.
+///
+/// @param cycles Budget in bus cycles.
+/// @return Number of jobs that have been run.
+int NEA_JobRun(u32 cycles);
+
+/// Runs all jobs until they have finished.
+void NEA_JobFlush(void);
+
+/// @}
+
+#endif // NEA_JOB_H__
@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_LIGHTMANAGER_H__
+#define NEA_LIGHTMANAGER_H__
+
+#include <nds.h>
+
+#include "NEACollision.h"
+#include "NEAModel.h"
+
+/// @file   NEALightManager.h
+/// @brief  Selection of the 4 hardware lights from a list of scene lights.
+
+/// @defgroup light_manager Light manager
+///
+/// The hardware only has 4 lights. A light manager holds any number of point
+/// and directional lights, and picks the 4 lights that affect each model the
+/// most right before it is drawn:
+///
+///     NEA_LightManager *lights = NEA_LightManagerCreate(32);
+///
+///     NEA_SceneLight *torch = NEA_SceneLightCreate(lights, NEA_LIGHT_POINT);
+///     NEA_SceneLightSetColor(torch, RGB15(31, 20, 8), inttof32(1));
+///     NEA_SceneLightSetPosition(torch, 2.0, 1.5, -3.0);
+///     NEA_SceneLightSetRadius(torch, 6.0);
+///
+///     NEA_LightManagerUse(lights);
+///
+/// NEA_ModelDraw() (and everything that uses it, like scenes and the render
+/// queue) asks the manager in use for the lights of the bounding sphere of the
+/// model. Point lights are found with a grid on the XZ plane, so the cost of
+/// the selection depends on the number of lights close to the model, not on
+/// the total number of lights. Directional lights are always considered.
+///
+/// The hardware doesn't support point lights. They are converted into a
+/// directional light that goes from the light to the center of the model, and
+/// their color gets darker with the distance. Hardware slots that aren't
+/// needed are switched off by setting their color to black.
+///
+/// The registers of the lights are only written when their value changes. The
+/// light vectors are transformed by the view matrix when they are written, so
+/// models must be drawn right after NEA_CameraUse(), and materials must enable
+/// all lights (NEA_LIGHT_0123). NEA_CameraUse() and the functions of
+/// NEAPolygon.h that set lights make the manager write the registers again.
+///
+/// @{
+
+/// Type of a scene light.
+typedef enum {
+    NEA_LIGHT_DIRECTIONAL, ///< Light with a direction and no position
+    NEA_LIGHT_POINT        ///< Light with a position and a radius
+} NEA_LightType;
+
+/// Opaque light manager type.
+typedef struct NEA_LightManager_ NEA_LightManager;
+
+/// Holds information of a scene light.
+///
+/// Use the NEA_SceneLight*() functions to modify it, they tell the manager that
+/// it has to update its grid.
+typedef struct {
+    NEA_LightManager *manager; ///< Manager that owns the light
+    NEA_LightType type;        ///< Type of the light
+    bool used;                 ///< True if the light has been created
+    bool enabled;              ///< True if the light can be selected
+    u32 color;                 ///< Color of the light (RGB15)
+    int32_t intensity;         ///< Strength of the light (f32)
+    NEA_Vec3 position;         ///< Position of point lights (f32)
+    NEA_Vec3 direction;        ///< Direction of directional lights (f32)
+    int32_t radius;            ///< Range of point lights (f32)
+} NEA_SceneLight;
+
+/// Default size of the cells of the grid of a light manager (f32).
+#define NEA_LIGHT_MANAGER_CELL_SIZE inttof32(4)
+
+/// Creates a light manager.
+///
+/// @param max_lights Max number of lights.
+/// @return Pointer to the manager, or NULL on error.
+NEA_LightManager *NEA_LightManagerCreate(int max_lights);
+
+/// Deletes a light manager and all its lights.
+///
+/// If it's the manager in use, NEA_LightManagerUse(NULL) is called first.
+///
+/// @param mgr Pointer to the manager.
+void NEA_LightManagerDelete(NEA_LightManager *mgr);
+
+/// Sets the manager used by NEA_ModelDraw().
+///
+/// @param mgr Pointer to the manager, or NULL to stop selecting lights.
+void NEA_LightManagerUse(NEA_LightManager *mgr);
+
+/// Sets the size of the cells of the grid used to find point lights.
+///
+/// Cells should be about as big as the radius of most lights.
+///
+/// @param mgr Pointer to the manager.
+/// @param size Size of the cells (f32).
+void NEA_LightManagerSetCellSizeI(NEA_LightManager *mgr, int32_t size);
+
+/// Sets the size of the cells of the grid used to find point lights.
+///
+/// @param m Pointer to the manager.
+/// @param s Size of the cells (float).
+#define NEA_LightManagerSetCellSize(m, s) \
+    NEA_LightManagerSetCellSizeI(m, floattof32(s))
+
+/// Selects the lights of a sphere and writes them to the hardware.
+///
+/// NEA_ModelDraw() calls this automatically. It can be used before drawing
+/// objects that aren't models, like display lists.
+///
+/// @param x (x, y, z) Center of the sphere in world space (f32).
+/// @param y (x, y, z) Center of the sphere in world space (f32).
+/// @param z (x, y, z) Center of the sphere in world space (f32).
+/// @param radius Radius of the sphere (f32).
+/// @return Returns the number of lights selected.
+int NEA_LightManagerApplyI(int32_t x, int32_t y, int32_t z, int32_t radius);
+
+/// Forgets the values written to the light registers.
+///
+/// The next selection writes all the registers again. Call this after changing
+/// the view matrix without NEA_CameraUse().
+void NEA_LightManagerInvalidate(void);
+
+/// Creates a light in a manager.
+///
+/// The new light is white, with intensity 1. Point lights are at the origin
+/// with a radius of 1, and directional lights point down.
+///
+/// @param mgr Pointer to the manager.
+/// @param type Type of the light.
+/// @return Pointer to the light, or NULL if the manager is full.
+NEA_SceneLight *NEA_SceneLightCreate(NEA_LightManager *mgr,
+                                     NEA_LightType type);
+
+/// Deletes a light.
+///
+/// @param light Pointer to the light.
+void NEA_SceneLightDelete(NEA_SceneLight *light);
+
+/// Enables or disables a light.
+///
+/// @param light Pointer to the light.
+/// @param enabled True to let the manager select the light.
+void NEA_SceneLightSetEnabled(NEA_SceneLight *light, bool enabled);
+
+/// Sets the color and intensity of a light.
+///
+/// The intensity is used to compare lights. Intensities over 1 make the light
+/// reach full brightness further from its center.
+///
+/// @param light Pointer to the light.
+/// @param color Color (RGB15).
+/// @param intensity Intensity (f32).
+void NEA_SceneLightSetColor(NEA_SceneLight *light, u32 color,
+                            int32_t intensity);
+
+/// Sets the position of a point light.
+///
+/// @param light Pointer to the light.
+/// @param x (x, y, z) Position (f32).
+/// @param y (x, y, z) Position (f32).
+/// @param z (x, y, z) Position (f32).
+void NEA_SceneLightSetPositionI(NEA_SceneLight *light,
+                                int32_t x, int32_t y, int32_t z);
+
+/// Sets the position of a point light.
+///
+/// @param l Pointer to the light.
+/// @param x (x, y, z) Position (float).
+/// @param y (x, y, z) Position (float).
+/// @param z (x, y, z) Position (float).
+#define NEA_SceneLightSetPosition(l, x, y, z) \
+    NEA_SceneLightSetPositionI(l, floattof32(x), floattof32(y), floattof32(z))
+
+/// Sets the direction of a directional light.
+///
+/// @param light Pointer to the light.
+/// @param x (x, y, z) Direction, it doesn't need to be normalized (f32).
+/// @param y (x, y, z) Direction, it doesn't need to be normalized (f32).
+/// @param z (x, y, z) Direction, it doesn't need to be normalized (f32).
+void NEA_SceneLightSetDirectionI(NEA_SceneLight *light,
+                                 int32_t x, int32_t y, int32_t z);
+
+/// Sets the direction of a directional light.
+///
+/// @param l Pointer to the light.
+/// @param x (x, y, z) Direction (float).
+/// @param y (x, y, z) Direction (float).
+/// @param z (x, y, z) Direction (float).
+#define NEA_SceneLightSetDirection(l, x, y, z) \
+    NEA_SceneLightSetDirectionI(l, floattof32(x), floattof32(y), floattof32(z))
+
+/// Sets the radius of a point light.
+///
+/// Objects further than this distance from the light aren't affected by it.
+///
+/// @param light Pointer to the light.
+/// @param radius Radius (f32).
+void NEA_SceneLightSetRadiusI(NEA_SceneLight *light, int32_t radius);
+
+/// Sets the radius of a point light.
+///
+/// @param l Pointer to the light.
+/// @param r Radius (float).
+#define NEA_SceneLightSetRadius(l, r) \
+    NEA_SceneLightSetRadiusI(l, floattof32(r))
+
+/// @}
+
+#endif // NEA_LIGHTMANAGER_H__
@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_LOADER_H__
+#define NEA_LOADER_H__
+
+#include <nds.h>
+
+#include "NEACollision.h"
+#include "NEAModel.h"
+#include "NEAPalette.h"
+#include "NEATexture.h"
+
+/// @file   NEALoader.h
+/// @brief  Queue of files loaded in the background.
+
+/// @defgroup loader Background loader
+///
+/// Loading all the assets of a level at once freezes the game for as long as
+/// it takes to read them. The background loader keeps a queue of files, and
+/// NEA_LoaderUpdate() reads a limited number of bytes of them each time it is
+/// called. When a file has been read, it is decoded and its textures and
+/// palettes are added to the upload queue (see NEA_UploadUpdate()), so they are
+/// copied to VRAM during the next vertical blanks.
+///
+/// This lets the game animate a loading screen, or load the next area while the
+/// player is still in the current one. The progress is reported in bytes, see
+/// NEA_LoaderGetProgress().
+///
+/// NEA_WaitForVBL() calls NEA_LoaderUpdate() if NEA_UPDATE_LOADER is used.
+/// NEA_LoaderUpdate() must never be called from an interrupt handler, because
+/// the filesystem can't be used from them.
+///
+/// The size of each file is read when it is added to the queue. This is cheap
+/// for files inside mounted asset packs (see NEA_PackMount()).
+///
+/// Compressed files (see NEA_FATDecompress()) are read and decompressed in one
+/// step, even if they are bigger than the budget of NEA_LoaderUpdate().
+///
+/// Collision meshes are also converted in steps after they have been read, see
+/// NEA_LoaderAddColMesh().
+///
+/// Deleting a material, palette, model or collision mesh removes the pending
+/// loads that use it.
+///
+/// @{
+
+#define NEA_LOADER_QUEUE_SIZE 32 ///< Max number of pending files
+#define NEA_LOADER_PATH_LEN 64   ///< Max length of paths (with NUL)
+
+/// Default number of bytes read by NEA_LoaderUpdate()
+#define NEA_LOADER_DEFAULT_BUDGET (8 * 1024)
+
+/// Function called when a file added with NEA_LoaderAddFile() has been read.
+///
+/// The data belongs to the callback, and it must be freed with free().
+///
+/// @param path Path of the file.
+/// @param data Data of the file, or NULL if it couldn't be read.
+/// @param size Size of the data in bytes.
+/// @param arg Argument given when the file was added.
+typedef void (*NEA_LoaderCallback)(const char *path, void *data, size_t size,
+                                   void *arg);
+
+/// Function called when the progress changes.
+///
+/// @param done Bytes read since the queue was last empty.
+/// @param total Bytes added since the queue was last empty.
+/// @param arg Argument given to NEA_LoaderSetProgressCallback().
+typedef void (*NEA_LoaderProgressCallback)(size_t done, size_t total,
+                                           void *arg);
+
+/// Adds a file to the queue to be read to RAM.
+///
+/// @param path Path to the file.
+/// @param callback Function called when the file has been read.
+/// @param arg Argument passed to the callback.
+/// @return It returns 1 on success, 0 on error.
+int NEA_LoaderAddFile(const char *path, NEA_LoaderCallback callback,
+                      void *arg);
+
+/// Adds a texture to the queue to be loaded to a material.
+///
+/// The arguments are the same as in NEA_MaterialTexLoadFAT().
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param path Path of the texture file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_LoaderAddTexture(NEA_Material *tex, NEA_TextureFormat fmt,
+                         int sizeX, int sizeY, NEA_TextureFlags flags,
+                         const char *path);
+
+/// Adds a GRF file to the queue to be loaded to a material and palette.
+///
+/// The arguments are the same as in NEA_MaterialTexLoadGRF().
+///
+/// @param tex Material.
+/// @param pal Palette. If the format is 16 bit, nothing will be loaded here.
+/// @param flags Parameters of the texture.
+/// @param path Path of the GRF file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_LoaderAddTextureGRF(NEA_Material *tex, NEA_Palette *pal,
+                            NEA_TextureFlags flags, const char *path);
+
+/// Adds a static mesh to the queue to be loaded to a model.
+///
+/// The mesh is freed when the model is deleted.
+///
+/// @param model Pointer to the model.
+/// @param path Path of the mesh file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_LoaderAddStaticMesh(NEA_Model *model, const char *path);
+
+/// Adds a collision mesh to the queue to be loaded to an empty ColMesh.
+///
+/// The mesh must have been created with NEA_ColMeshCreate(). When the file has
+/// been read, NEA_LoaderUpdate() converts some of its triangles every time it
+/// is called with NEA_ColMeshLoadStep(), and each triangle counts as
+/// sizeof(NEA_ColTriangle) bytes of its budget. The mesh can be used before it
+/// is complete, see NEA_ColMeshLoadStart(). The file is freed when the mesh has
+/// been loaded.
+///
+/// The progress (see NEA_LoaderGetProgress()) only counts the bytes read from
+/// the file, so it can reach the total before the mesh is complete. The job
+/// stays in the queue until then, so NEA_LoaderIsIdle() returns false.
+///
+/// @param mesh Pointer to the mesh.
+/// @param path Path of the .colmesh file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_LoaderAddColMesh(NEA_ColMesh *mesh, const char *path);
+
+/// Removes all pending loads that use a material, palette, model, collision
+/// mesh or callback argument.
+///
+/// If a collision mesh is being converted, it keeps the triangles that have
+/// been converted, and NEA_ColMeshLoadStep() can be used to finish it.
+///
+/// @param target Pointer to the object.
+void NEA_LoaderCancel(const void *target);
+
+/// Sets the max number of bytes read by each call to NEA_LoaderUpdate().
+///
+/// @param bytes Number of bytes. If it is 0, NEA_LOADER_DEFAULT_BUDGET is used.
+void NEA_LoaderSetBudget(size_t bytes);
+
+/// Reads pending files.
+///
+/// It stops when the budget has been used. Files that have been read
+/// completely are decoded and their callbacks are called from this function.
+///
+/// @return Returns the number of bytes that have been read.
+size_t NEA_LoaderUpdate(void);
+
+/// Reads all pending files right now.
+///
+/// The textures and palettes of the files are still copied to VRAM by the
+/// upload queue. Call NEA_UploadFlush() after this function to copy them too.
+void NEA_LoaderFlush(void);
+
+/// Returns true if there are no pending files.
+///
+/// @return True if the queue is empty.
+bool NEA_LoaderIsIdle(void);
+
+/// Returns the progress of the queue in bytes.
+///
+/// The counters are reset when a file is added to an empty queue.
+///
+/// @param done Pointer to store the number of bytes read, or NULL.
+/// @param total Pointer to store the number of bytes of all files, or NULL.
+void NEA_LoaderGetProgress(size_t *done, size_t *total);
+
+/// Sets a function that is called every time the progress changes.
+///
+/// @param callback Function to call, or NULL to disable it.
+/// @param arg Argument passed to the callback.
+void NEA_LoaderSetProgressCallback(NEA_LoaderProgressCallback callback,
+                                   void *arg);
+
+/// @}
+
+#endif // NEA_LOADER_H__
@@ -52,6 +52,30 @@ extern "C" {
 #include "NEASound.h"
 #include "NEAAnimMat.h"
 #include "NEAHw2D.h"
+#include "NEARenderQueue.h"
+#include "NEAModelLOD.h"
+#include "NEABudget.h"
+#include "NEAParticle.h"
+#include "NEAUpload.h"
+#include "NEAAtlas.h"
+#include "NEAMemReport.h"
+#include "NEAPack.h"
+#include "NEALoader.h"
+#include "NEACache.h"
+#include "NEAProfile.h"
+#include "NEAJob.h"
+#include "NEAArena.h"
+#include "NEAHeap.h"
+#include "NEAShadowVolume.h"
+#include "NEABlobShadow.h"
+#include "NEAPick.h"
+#include "NEALightManager.h"
+#include "NEAPoseService.h"
+#include "NEAImpostor.h"
+#include "NEAReplay.h"
+#include "NEACapture.h"
+#include "NEATex4x4.h"
+#include "NEAStaticConfig.h"
 
 /// Major version of Nitro Engine Advanced
 #define NITRO_ENGINE_ADVANCED_MAJOR (2)
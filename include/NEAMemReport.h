@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_MEMREPORT_H__
+#define NEA_MEMREPORT_H__
+
+/// @file   NEAMemReport.h
+/// @brief  VRAM occupancy and fragmentation reports.
+
+/// @defgroup mem_report VRAM reports
+///
+/// Detailed information about the state of the VRAM used by textures,
+/// palettes and the 2D hardware engines. A report tells how much memory is
+/// used, how the free memory is split in blocks, and what kind of data uses the
+/// memory. It is useful to tell apart a pool that is really full from one that
+/// has enough free memory, but not in a single block.
+///
+/// A callback can be registered to receive a report whenever an allocation
+/// fails. Reports are only generated when they are requested or when an
+/// allocation fails, so there is no cost during normal operation.
+///
+/// @{
+
+/// Number of entries of the histogram of free blocks.
+///
+/// Entry N counts the free blocks with a size between 16 << N and
+/// (16 << (N + 1)) - 1 bytes. The last entry also counts all bigger blocks.
+#define NEA_MEM_HISTOGRAM_SIZE 12
+
+/// Memory pools that can be reported.
+typedef enum {
+    NEA_MEM_POOL_TEXTURE,   ///< Texture VRAM
+    NEA_MEM_POOL_PALETTE,   ///< Texture palette VRAM
+    NEA_MEM_POOL_HW2D_MAIN, ///< 2D VRAM of the main engine
+    NEA_MEM_POOL_HW2D_SUB   ///< 2D VRAM of the sub engine
+} NEA_MemPool;
+
+/// Kinds of data that use memory of a pool.
+typedef enum {
+    NEA_MEM_OWNER_TEXTURE,        ///< Regular textures
+    NEA_MEM_OWNER_TEXTURE_TEX4X4, ///< Compressed textures (both parts)
+    NEA_MEM_OWNER_TEXTURE_STREAM, ///< Streamed textures
+    NEA_MEM_OWNER_PALETTE,        ///< Palettes
+    NEA_MEM_OWNER_HW2D_BG,        ///< 2D backgrounds
+    NEA_MEM_OWNER_HW2D_OBJ,       ///< 2D OBJ graphics
+    NEA_MEM_OWNER_OTHER,          ///< Memory used by anything else
+    NEA_MEM_OWNER_COUNT           ///< Number of kinds of owners
+} NEA_MemOwner;
+
+/// Occupancy and fragmentation report of a memory pool.
+typedef struct NEA_MemReport {
+    size_t total;          ///< Memory of the pool, without locked memory
+    size_t free;           ///< Free memory
+    size_t used;           ///< Used memory
+    size_t locked;         ///< Locked memory (like VRAM banks used by 2D)
+    size_t largest_free;   ///< Size of the largest free block
+    unsigned int free_blocks; ///< Number of free blocks
+    unsigned int used_blocks; ///< Number of used blocks
+    /// Percentage of the free memory that is outside of the largest free block
+    unsigned int fragmentation;
+    /// Number of free blocks by size, see NEA_MEM_HISTOGRAM_SIZE
+    unsigned int histogram[NEA_MEM_HISTOGRAM_SIZE];
+    /// Used memory of each kind of owner
+    size_t owner[NEA_MEM_OWNER_COUNT];
+} NEA_MemReport;
+
+/// Callback called when an allocation fails.
+///
+/// @param pool Pool in which the allocation has failed.
+/// @param size Size that was requested in bytes.
+/// @param report Report of the pool right after the failure.
+typedef void (*NEA_MemFailCallback)(NEA_MemPool pool, size_t size,
+                                    const NEA_MemReport *report);
+
+/// Generates a report of the texture VRAM.
+///
+/// @param report Pointer to the report to fill.
+/// @return Returns 1 on success, 0 on error.
+int NEA_TextureGetMemReport(NEA_MemReport *report);
+
+/// Generates a report of the texture palette VRAM.
+///
+/// @param report Pointer to the report to fill.
+/// @return Returns 1 on success, 0 on error.
+int NEA_PaletteGetMemReport(NEA_MemReport *report);
+
+/// Generates a report of the 2D VRAM of an engine.
+///
+/// Backgrounds and OBJ graphics are reported as one pool. Backgrounds are
+/// allocated sequentially, so their free memory is always one block. OBJ
+/// graphics are allocated by libnds, so their free memory is reported as one
+/// block as well, even if it may be fragmented.
+///
+/// @param engine Engine.
+/// @param report Pointer to the report to fill.
+/// @return Returns 1 on success, 0 on error.
+int NEA_Hw2DGetMemReport(NEA_Hw2DEngine engine, NEA_MemReport *report);
+
+/// Generates a report of a memory pool.
+///
+/// @param pool Pool.
+/// @param report Pointer to the report to fill.
+/// @return Returns 1 on success, 0 on error.
+int NEA_MemGetReport(NEA_MemPool pool, NEA_MemReport *report);
+
+/// Returns true if an allocation can't fit in a pool only because of
+/// fragmentation.
+///
+/// @param report Report of the pool.
+/// @param size Size of the allocation in bytes.
+/// @return true if there is enough free memory, but not in a single block.
+bool NEA_MemReportIsFragmented(const NEA_MemReport *report, size_t size);
+
+/// Sets the function called when an allocation fails.
+///
+/// In debug builds a summary of the report is also sent to the debug handler.
+///
+/// @param callback Function to call, or NULL to disable it.
+void NEA_MemSetFailCallback(NEA_MemFailCallback callback);
+
+/// @}
+
+#endif // NEA_MEMREPORT_H__
@@ -48,10 +48,23 @@ typedef enum {
 /// DLMM file magic number ("DLMM" in little-endian).
 #define NEA_DLMM_MAGIC 0x4D4D4C44
 
+/// Bounding sphere chunk magic number ("BSPH" in little-endian).
+///
+/// Mesh files (static display lists, DSM and DLMM) may start with an optional
+/// 20-byte chunk: the magic, followed by the center (x, y, z) and radius of a
+/// sphere that contains the whole mesh, all of them in f32 format. obj2dl and
+/// md5_to_dsma write it when they are called with "--bounding-sphere".
+#define NEA_MESH_BOUNDS_MAGIC 0x48505342
+
 /// Submesh flag: this submesh has a texture reference.
 #define NEA_SUBMESH_HAS_TEXTURE (1 << 0)
 
 /// Holds information for one submesh within a multi-material model.
+///
+/// DLMM files store their submesh records with this layout, with the offset of
+/// the display list in dl_data. In version 2 files the material field is 0, and
+/// files loaded with NEA_ModelLoadMultiMeshFAT() are used in place: the loader
+/// only replaces the offsets by pointers.
 typedef struct {
     void *dl_data;             ///< Pointer to display list data in the loaded file
     NEA_Material *material;    ///< Runtime material (NULL = use embedded defaults)
@@ -64,14 +77,37 @@ typedef struct {
 } NEA_SubMesh;
 
 /// Container for multi-material mesh data loaded from a DLMM file.
+///
+/// It is shared by a model and all its clones. Version 2 files loaded from a
+/// filesystem keep it in the reserved space of their header, so they don't need
+/// any allocation other than the file itself.
 typedef struct {
-    int num_submeshes;         ///< Number of submeshes
+    NEA_SubMesh *submeshes;    ///< Submesh records
     void *base_data;           ///< Base allocation pointer (for free)
+    u16 num_submeshes;         ///< Number of submeshes
+    u16 refcount;              ///< Number of models that use this data
     bool base_has_to_free;     ///< Whether base_data should be freed on delete
-    int *base_refcount;        ///< Shared reference count for clone support
-    NEA_SubMesh submeshes[NEA_MAX_SUBMESHES]; ///< Submesh array
+    bool in_place;             ///< This struct is stored inside base_data
+    bool flushed;              ///< Lists have been flushed from the data cache
 } NEA_MultiMeshData;
 
+/// Maximum number of phases of an animation group.
+///
+/// It matches the number of poses kept by the pose cache of DSMA, so that the
+/// poses of all phases can stay in the cache while a crowd is drawn.
+#define NEA_ANIM_GROUP_MAX_PHASES 4
+
+/// Animation state shared by a group of models.
+///
+/// See NEA_ModelAnimGroupCreate().
+typedef struct {
+    NEA_AnimInfo animinfo[2]; ///< Animations of all members (two can be blended)
+    int32_t anim_blend;       ///< Animation blend factor of all members
+    int32_t phase_offset[NEA_ANIM_GROUP_MAX_PHASES]; ///< Frame offset of each phase (f32)
+    int members;              ///< Number of models in the group
+    unsigned int tick;        ///< Last update of NEA_ModelAnimateAll()
+} NEA_ModelAnimGroup;
+
 /// Holds information of a model.
 typedef struct {
     NEA_ModelType modeltype;   ///< Model type (static or animated)
@@ -80,6 +116,7 @@ typedef struct {
     int32_t anim_blend;       ///< Animation blend factor
     NEA_Material *texture;     ///< Material used by this model (single-material)
     NEA_MultiMeshData *multi;  ///< Multi-material data, or NULL for single-material
+    NEA_Material **submesh_materials; ///< Materials of this model, or NULL
     int x;                    ///< X position of the model (f32)
     int y;                    ///< Y position of the model (f32)
     int z;                    ///< Z position of the model (f32)
@@ -90,6 +127,20 @@ typedef struct {
     int sy;                   ///< Y scale of the model (f32)
     int sz;                   ///< Z scale of the model (f32)
     m4x3 *mat;                ///< Transformation matrix assigned by the user.
+    int32_t bound_center[3];  ///< Center of the bounding sphere (f32)
+    int32_t bound_radius;     ///< Radius of the bounding sphere (f32, 0 = none)
+    m4x3 transform;           ///< Cached matrix built from position, rotation and scale
+    bool transform_dirty;     ///< The cached matrix has to be built again
+    int32_t anim_lod_distance[3]; ///< Start distance of each animation LOD level (f32)
+    int anim_lod_level;       ///< Animation LOD level of the last update
+    int anim_lod_pending;     ///< Frames that the animation hasn't advanced yet
+    NEA_ModelAnimGroup *anim_group; ///< Animation group of the model, or NULL
+    int anim_phase;           ///< Phase of the model in its animation group
+    const uint16_t *anim_mask; ///< Joint weights of the secondary animation
+    int32_t cam_pos[3];       ///< Position of the camera distance cache (f32)
+    int64_t cam_dist2;        ///< Cached squared distance to the camera
+    int32_t cam_dist;         ///< Cached distance to the camera (f32, or -1)
+    uint32_t cam_stamp;       ///< Camera of the cached distance (0 = none)
 } NEA_Model;
 
 /// Creates a new model object.
@@ -124,6 +175,19 @@ void NEA_ModelDelete(NEA_Model *model);
 /// @param model Pointer to the model.
 void NEA_ModelFreeMeshWhenDeleted(NEA_Model *model);
 
+/// Tells Nitro Engine Advanced that the CPU has modified the mesh of a model.
+///
+/// The display lists of static models and multi-material models are flushed
+/// from the data cache when they are loaded, not every time they are drawn. If
+/// the CPU writes to the display list of a model after loading it, this must
+/// be called before drawing it so that it's flushed again (once).
+///
+/// Clones of a model share its mesh, including the submeshes of multi-material
+/// models, so it's enough to call this for the model or for any of its clones.
+///
+/// @param model Pointer to the model.
+void NEA_ModelInvalidateMesh(NEA_Model *model);
+
 /// Assign a display list in RAM to a static model.
 ///
 /// @param model Pointer to the model.
@@ -170,11 +234,142 @@ void NEA_ModelSetAnimation(NEA_Model *model, NEA_Animation *anim);
 /// @param anim Pointer to the animation.
 void NEA_ModelSetAnimationSecondary(NEA_Model *model, NEA_Animation *anim);
 
+/// Limits the secondary animation of a model to some joints.
+///
+/// The mask has one weight per joint of the animations (f32, from 0.0 to
+/// 1.0), which is multiplied by the blending factor of the model. For example,
+/// a mask with 1.0 in the joints of the upper body and 0.0 in the others plays
+/// the secondary animation in the upper body and the main one in the legs.
+/// Joints that only use one of the animations don't read the other one, so it
+/// doesn't cost much more than drawing a single animation.
+///
+/// The mask isn't copied, it must remain valid while it's used. Clones of the
+/// model use the same mask.
+///
+/// @param model Pointer to the model.
+/// @param mask Weights of the joints, or NULL to blend all joints the same.
+void NEA_ModelSetAnimationMask(NEA_Model *model, const uint16_t *mask);
+
 /// Draw a model.
 ///
 /// @param model Pointer to the model.
 void NEA_ModelDraw(const NEA_Model *model);
 
+/// Draw the mesh of a model several times with different transformations.
+///
+/// The material of the model (or the materials of each submesh) is only set
+/// once, and then each instance only loads its matrix and sends the display
+/// list. The position, rotation, scale and matrix of the model are ignored.
+/// This is useful to draw crowds of models created with NEA_ModelClone(),
+/// which share the same mesh and material.
+///
+/// Animated models are drawn with the animation state of the model, but their
+/// bones need to be set up for each instance, so they don't save as much time.
+///
+/// If frustum culling is enabled, each instance is tested individually.
+///
+/// @param model Pointer to the model.
+/// @param transforms Array of matrices, one per instance.
+/// @param count Number of instances.
+void NEA_ModelDrawInstanced(const NEA_Model *model, const m4x3 *transforms,
+                            int count);
+
+/// Set the bounding sphere of a model.
+///
+/// The sphere is in model space (before applying the position, rotation and
+/// scale of the model). It is normally read from the mesh file when it is
+/// loaded, so this is only needed for meshes exported without bounds. A radius
+/// of 0 means that the model is never culled.
+///
+/// @param model Pointer to the model.
+/// @param x (x, y, z) Center of the sphere (f32).
+/// @param y (x, y, z) Center of the sphere (f32).
+/// @param z (x, y, z) Center of the sphere (f32).
+/// @param radius Radius of the sphere (f32).
+void NEA_ModelSetBoundingSphereI(NEA_Model *model, int x, int y, int z,
+                                 int radius);
+
+/// Set the bounding sphere of a model.
+///
+/// @param m Pointer to the model.
+/// @param x (x, y, z) Center of the sphere (float).
+/// @param y (x, y, z) Center of the sphere (float).
+/// @param z (x, y, z) Center of the sphere (float).
+/// @param r Radius of the sphere (float).
+#define NEA_ModelSetBoundingSphere(m, x, y, z, r) \
+    NEA_ModelSetBoundingSphereI(m, floattof32(x), floattof32(y), \
+                                floattof32(z), floattof32(r))
+
+/// Gets the distance from the camera used last to a model.
+///
+/// The location of the model is the translation of its matrix if it has one
+/// (see NEA_ModelSetMatrix()), or its position. The squared distance is cached
+/// in the model until the model or the camera move, and it's shared with the
+/// LOD selection (see NEA_ModelLODSelect() and NEA_ModelAnimSetLODI()) and the
+/// sound sources attached to the model, so it's only calculated once per frame.
+/// The distance itself is calculated the first time it's requested.
+///
+/// @param model Pointer to the model.
+/// @return Distance (f32), or -1 if no camera has been used yet.
+int32_t NEA_ModelGetCameraDistance(NEA_Model *model);
+
+/// Gets the box that contains a model in model space.
+///
+/// It is the box of the bounding sphere of the model. Animated models whose
+/// DSA files have animation bounds (see NEA_ANIM_BOUNDS_MAGIC) use instead the
+/// box of the frames that are drawn, merged with the one of the secondary
+/// animation while both animations are blended. The frustum culling functions
+/// use the sphere around this box, so skinned models are culled with the same
+/// functions as static ones. Animation bounds are only used by models that
+/// have a bounding sphere.
+///
+/// @param model Pointer to the model.
+/// @param min Min corner of the box (3 f32 values).
+/// @param max Max corner of the box (3 f32 values).
+/// @return It returns true on success, false if the model has no bounds.
+bool NEA_ModelGetBounds(const NEA_Model *model, int32_t *min, int32_t *max);
+
+/// Enable or disable frustum culling of models.
+///
+/// When it is enabled, NEA_ModelDraw() tests the bounding sphere of the model
+/// against the view frustum of the last camera set with NEA_CameraUse(), and
+/// it returns without sending anything to the GPU if the model is outside of
+/// it. Models without a bounding sphere are always drawn.
+///
+/// The test assumes that models are drawn right after NEA_CameraUse(), without
+/// any additional transformation in the matrix stack (this is what the scene
+/// system does). It is disabled by default.
+///
+/// @param enable True to enable culling, false to disable it.
+void NEA_ModelFrustumCulling(bool enable);
+
+/// Enable or disable culling of models with the box test of the GPU.
+///
+/// When it is enabled, NEA_ModelDraw() sets the matrix of the model and then
+/// asks the GPU if its bounds (see NEA_ModelGetBounds()) are inside the view
+/// volume. If it isn't, the display list of the model isn't sent. Models
+/// drawn by the scene system and the render queue are tested the same way.
+///
+/// The test uses the real projection and the current matrix stack, so it also
+/// works with models drawn with additional transformations and with the half of
+/// the screen drawn by each pass in two-pass modes. The frustum test of
+/// NEA_ModelFrustumCulling() isn't done for models drawn with NEA_ModelDraw(),
+/// but it's still used for scene subtrees and instanced models.
+///
+/// Each test makes the CPU wait for the GPU to process all the commands sent
+/// before it. The GPU only tests the faces of the cube, so a model is culled if
+/// its cube contains the whole view volume. Models that can surround the camera
+/// like that should have no bounding sphere. It is disabled by default.
+///
+/// @param enable True to enable culling, false to disable it.
+void NEA_ModelBoxTestCulling(bool enable);
+
+/// Checks if the bounding sphere of a model is inside the view frustum.
+///
+/// @param model Pointer to the model.
+/// @return Returns false if the model is completely outside of the frustum.
+bool NEA_ModelIsInFrustum(const NEA_Model *model);
+
 /// Clone model.
 ///
 /// This clones the mesh, including the animation, the material it uses. It
@@ -278,9 +473,66 @@ int NEA_ModelSetMatrix(NEA_Model *model, m4x3 *mat);
 /// @param model Pointer to the model.
 void NEA_ModelClearMatrix(NEA_Model *model);
 
+/// Tells the engine that the position, rotation or scale of a model have been
+/// modified directly.
+///
+/// The transformation matrix of a model is cached, and it is only built again
+/// when any of the functions that modify the position, rotation or scale are
+/// called. If the fields of NEA_Model are modified directly, this function has
+/// to be called before the model is drawn.
+///
+/// @param model Pointer to the model.
+void NEA_ModelTransformChanged(NEA_Model *model);
+
 /// Update internal state of the animation of all models.
+///
+/// Models with animation LOD distances (see NEA_ModelAnimSetLODI()) that are
+/// far from the camera that was last passed to NEA_CameraUse() are only
+/// updated every 2 or 4 frames. They advance all the frames that they missed
+/// at once, so the animation speed doesn't change. The updates of different
+/// models are spread over the frames.
 void NEA_ModelAnimateAll(void);
 
+/// Animation LOD levels.
+typedef enum {
+    NEA_ANIM_LOD_FULL = 0,    ///< Updated every frame
+    NEA_ANIM_LOD_HALF = 1,    ///< Updated every 2 frames
+    NEA_ANIM_LOD_QUARTER = 2, ///< Updated every 4 frames
+    NEA_ANIM_LOD_SNAP = 3     ///< Updated every 4 frames, whole keyframes only
+} NEA_AnimLODLevel;
+
+/// Sets the distances at which the animation of a model is updated less often.
+///
+/// Each distance is the distance to the camera at which a level starts. A
+/// distance of 0 disables that level. In NEA_ANIM_LOD_SNAP the pose isn't
+/// interpolated between keyframes, which also makes it more likely to be found
+/// in the pose cache of DSMA. The distances are scaled down by the polygon
+/// budget governor like the ones of LOD objects, see NEA_BudgetGetLODScale().
+///
+/// All distances are 0 by default, so the animation is updated every frame.
+///
+/// @param model Pointer to the model.
+/// @param half Distance of NEA_ANIM_LOD_HALF (f32).
+/// @param quarter Distance of NEA_ANIM_LOD_QUARTER (f32).
+/// @param snap Distance of NEA_ANIM_LOD_SNAP (f32).
+void NEA_ModelAnimSetLODI(NEA_Model *model, int32_t half, int32_t quarter,
+                          int32_t snap);
+
+/// Sets the distances at which the animation of a model is updated less often.
+///
+/// @param m Pointer to the model.
+/// @param h Distance of NEA_ANIM_LOD_HALF (float).
+/// @param q Distance of NEA_ANIM_LOD_QUARTER (float).
+/// @param s Distance of NEA_ANIM_LOD_SNAP (float).
+#define NEA_ModelAnimSetLOD(m, h, q, s) \
+    NEA_ModelAnimSetLODI(m, floattof32(h), floattof32(q), floattof32(s))
+
+/// Returns the animation LOD level used in the last update of a model.
+///
+/// @param model Pointer to the model.
+/// @return Level (NEA_ANIM_LOD_FULL to NEA_ANIM_LOD_SNAP).
+int NEA_ModelAnimGetLODLevel(const NEA_Model *model);
+
 /// Starts the animation of an animated model.
 ///
 /// The speed can be positive or negative. A speed of 0 stops the animation, a
@@ -362,6 +614,71 @@ void NEA_ModelAnimSecondarySetFactor(NEA_Model *model, int32_t factor);
 ///                          secondary animation.
 void NEA_ModelAnimSecondaryClear(NEA_Model *model, bool replace_base_anim);
 
+/// Creates an animation group with the animation state of a model.
+///
+/// The members of an animation group share one animation state, which is only
+/// advanced once per call to NEA_ModelAnimateAll(), however many members it
+/// has. This is meant for crowds of clones of the same model. All the
+/// animation functions called on a member (NEA_ModelSetAnimation(),
+/// NEA_ModelAnimStart(), etc) change the animation of the whole group.
+///
+/// Each member can use one of NEA_ANIM_GROUP_MAX_PHASES phases, and its frame
+/// is moved forward by the offset of its phase (see
+/// NEA_ModelAnimGroupSetPhaseI()), so that the members don't look like they
+/// move in sync. All the members with the same phase draw the same pose, so the
+/// pose cache of DSMA only has to evaluate the skeleton once per phase (this
+/// doesn't apply to blended animations, they aren't cached).
+///
+/// The model becomes the first member of the group, with phase 0. Clones of a
+/// member made with NEA_ModelClone() join the same group with the same phase.
+/// The group is deleted when its last member leaves it or is deleted.
+///
+/// @param model Animated model that isn't a member of another group.
+/// @return Returns the new group, or NULL on error.
+NEA_ModelAnimGroup *NEA_ModelAnimGroupCreate(NEA_Model *model);
+
+/// Adds a model to an animation group.
+///
+/// The model stops using its own animation state. If it is a member of another
+/// group it leaves it first. If it's already a member of this group, only its
+/// phase is changed. The model must use the same skeleton as the rest of the
+/// members of the group.
+///
+/// @param group Animation group.
+/// @param model Animated model.
+/// @param phase Phase of the model (0 to NEA_ANIM_GROUP_MAX_PHASES - 1).
+/// @return Returns 1 on success, 0 on error.
+int NEA_ModelAnimGroupJoin(NEA_ModelAnimGroup *group, NEA_Model *model,
+                           int phase);
+
+/// Removes a model from its animation group.
+///
+/// The model keeps a copy of the current state of the animation of the group,
+/// without the offset of its phase, and it's animated on its own again.
+///
+/// @param model Model.
+void NEA_ModelAnimGroupLeave(NEA_Model *model);
+
+/// Sets the frame offset of a phase of an animation group.
+///
+/// The offset is added to the frame of the animations of the group when the
+/// members with this phase are drawn. Looping animations wrap around, and
+/// one-shot animations stop at the last frame. All offsets are 0 by default.
+///
+/// @param group Animation group.
+/// @param phase Phase (0 to NEA_ANIM_GROUP_MAX_PHASES - 1).
+/// @param offset Frame offset (f32).
+void NEA_ModelAnimGroupSetPhaseI(NEA_ModelAnimGroup *group, int phase,
+                                 int32_t offset);
+
+/// Sets the frame offset of a phase of an animation group.
+///
+/// @param g Animation group.
+/// @param p Phase (0 to NEA_ANIM_GROUP_MAX_PHASES - 1).
+/// @param o Frame offset (float).
+#define NEA_ModelAnimGroupSetPhase(g, p, o) \
+    NEA_ModelAnimGroupSetPhaseI(g, p, floattof32(o))
+
 /// Loads a DSM file stored in RAM to a model.
 ///
 /// @param model Pointer to the model.
@@ -396,6 +713,10 @@ int NEA_ModelLoadMultiMeshFAT(NEA_Model *model, const char *path);
 
 /// Assign a material to a submesh by index.
 ///
+/// The submeshes of a model and its clones are shared. The material is stored
+/// in the submesh while only one model uses it. Otherwise, the model gets its
+/// own table of materials, so the other models aren't affected.
+///
 /// @param model Pointer to the model.
 /// @param submesh_index Index of the submesh (0-based).
 /// @param material Pointer to the material.
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_MODELLOD_H__
+#define NEA_MODELLOD_H__
+
+/// @file   NEAModelLOD.h
+/// @brief  Models with several levels of detail.
+
+/// @defgroup model_lod Level of detail
+///
+/// A LOD object groups a model with up to three simplified versions of its
+/// mesh. When it is drawn, the level is selected from the distance between the
+/// model and the camera that was last passed to NEA_CameraUse().
+///
+/// The base model holds the transformation, material and animation that are
+/// used for all levels. The other levels are regular models that are only used
+/// as mesh sources: load a static display list, DSM or DLMM file into them as
+/// usual. Animated models need DSM variants that use the same skeleton as the
+/// base model.
+///
+/// The polygon budget governor can scale down the switch distances when the
+/// scene gets close to the polygon limit, see NEA_BudgetGetLODScale().
+///
+/// obj2dl can generate the simplified meshes with "--lod".
+///
+/// @{
+
+#define NEA_MODEL_LOD_MAX_LEVELS 4 ///< Max number of levels of a LOD object
+
+/// Holds information of a model with levels of detail.
+typedef struct {
+    NEA_Model *model;   ///< Base model (transformation, material and animation)
+    const NEA_Model *level[NEA_MODEL_LOD_MAX_LEVELS]; ///< Mesh source of each level
+    int32_t distance[NEA_MODEL_LOD_MAX_LEVELS]; ///< Max distance of each level (f32)
+    int num_levels;     ///< Number of levels
+    int last_level;     ///< Level used last time (-1 if it wasn't drawn)
+} NEA_ModelLOD;
+
+/// Creates a new LOD object.
+///
+/// The model is used as level 0, and it is used at any distance until more
+/// levels are added.
+///
+/// @param model Base model.
+/// @return Pointer to the newly created LOD object, or NULL on error.
+NEA_ModelLOD *NEA_ModelLODCreate(NEA_Model *model);
+
+/// Deletes a LOD object.
+///
+/// The models used by it aren't deleted.
+///
+/// @param lod Pointer to the LOD object.
+void NEA_ModelLODDelete(NEA_ModelLOD *lod);
+
+/// Sets the mesh and maximum distance of one level of a LOD object.
+///
+/// Levels must be set in order, and each level must have a higher distance
+/// than the previous one. If the distance is 0, the level is used at any
+/// distance; otherwise the model isn't drawn when it is further away than the
+/// distance of the last level. Setting a level removes all levels after it.
+///
+/// @param lod Pointer to the LOD object.
+/// @param level Level index (0 to NEA_MODEL_LOD_MAX_LEVELS - 1).
+/// @param mesh Model to take the mesh from. For level 0, NULL means the base
+///             model.
+/// @param distance Max distance of this level (f32).
+/// @return Returns 1 on success, 0 on error.
+int NEA_ModelLODSetLevelI(NEA_ModelLOD *lod, int level, const NEA_Model *mesh,
+                          int32_t distance);
+
+/// Sets the mesh and maximum distance of one level of a LOD object.
+///
+/// @param l Pointer to the LOD object.
+/// @param v Level index (0 to NEA_MODEL_LOD_MAX_LEVELS - 1).
+/// @param m Model to take the mesh from.
+/// @param d Max distance of this level (float).
+/// @return Returns 1 on success, 0 on error.
+#define NEA_ModelLODSetLevel(l, v, m, d) \
+    NEA_ModelLODSetLevelI(l, v, m, floattof32(d))
+
+/// Returns the level that would be used to draw a LOD object right now.
+///
+/// @param lod Pointer to the LOD object.
+/// @return Level index, or -1 if the model is too far away to be drawn.
+int NEA_ModelLODSelect(const NEA_ModelLOD *lod);
+
+/// Draws a LOD object with the level that corresponds to its distance to the
+/// active camera.
+///
+/// @param lod Pointer to the LOD object.
+void NEA_ModelLODDraw(NEA_ModelLOD *lod);
+
+/// Returns the level used the last time that a LOD object was drawn.
+///
+/// @param lod Pointer to the LOD object.
+/// @return Level index, or -1 if it wasn't drawn.
+int NEA_ModelLODGetLevel(const NEA_ModelLOD *lod);
+
+/// @}
+
+#endif // NEA_MODELLOD_H__
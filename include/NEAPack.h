@@ -0,0 +1,121 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_PACK_H__
+#define NEA_PACK_H__
+
+#include <stdio.h>
+
+#include <nds.h>
+
+#include "NEAFAT.h"
+
+/// @file   NEAPack.h
+/// @brief  Asset packs.
+
+/// @defgroup pack Asset packs
+///
+/// An asset pack is a single file that contains many other files, created with
+/// the tool "neapack". Opening one file of the filesystem is slow, so games
+/// with many small assets load faster if the assets are stored in a pack: the
+/// pack is opened once, its directory is kept in RAM, and files are read from
+/// it with a seek and a read.
+///
+/// The directory is sorted by the hash of the paths, so finding a file is a
+/// binary search. The data of each file is aligned to NEA_PACK_ALIGNMENT bytes.
+///
+/// Files can be loaded from a pack with NEA_PackLoadData() and
+/// NEA_PackStreamOpen(). A pack can also be mounted with NEA_PackMount(). All
+/// NEA_*LoadFAT() functions look for files in the mounted packs before looking
+/// for them in the filesystem, so the same path can be used for files inside
+/// and outside of packs.
+///
+/// Paths are compared after removing "nitro:" and the leading slashes, so
+/// "nitro:/models/robot.bin", "/models/robot.bin" and "models/robot.bin" all
+/// refer to the same file. Comparisons are case sensitive.
+///
+/// @{
+
+#define NEA_PACK_ALIGNMENT 32  ///< Alignment of the data of files in bytes
+#define NEA_PACK_MAX_MOUNTED 4 ///< Max number of packs mounted at once
+
+/// Holds information of an asset pack.
+typedef struct {
+    FILE *file;          ///< File handle of the pack
+    size_t size;         ///< Size of the pack in bytes
+    u32 num_entries;     ///< Number of files in the pack
+    const void *entries; ///< Directory (internal use)
+    const char *names;   ///< Table of paths (internal use)
+} NEA_Pack;
+
+/// Opens an asset pack.
+///
+/// The directory of the pack is loaded to RAM. The file stays open until the
+/// pack is closed.
+///
+/// @param path Path to the pack in the filesystem.
+/// @return Pointer to the pack, or NULL on error.
+NEA_Pack *NEA_PackOpen(const char *path);
+
+/// Closes an asset pack.
+///
+/// The pack is unmounted if it was mounted. All streams opened from the pack
+/// must be closed before closing it.
+///
+/// @param pack Pointer to the pack.
+void NEA_PackClose(NEA_Pack *pack);
+
+/// Mounts an asset pack so that all NEA_*LoadFAT() functions can use it.
+///
+/// Packs mounted later are searched first.
+///
+/// @param pack Pointer to the pack.
+/// @return Returns 1 on success, 0 on error.
+int NEA_PackMount(NEA_Pack *pack);
+
+/// Unmounts an asset pack.
+///
+/// @param pack Pointer to the pack.
+void NEA_PackUnmount(NEA_Pack *pack);
+
+/// Looks for a file in a pack.
+///
+/// @param pack Pointer to the pack.
+/// @param path Path to the file.
+/// @return Index of the file, or -1 if it isn't in the pack.
+int NEA_PackFind(const NEA_Pack *pack, const char *path);
+
+/// Returns the size of a file of a pack.
+///
+/// The size of compressed files is their size after decompressing them.
+///
+/// @param pack Pointer to the pack.
+/// @param path Path to the file.
+/// @return Returns the size of the file, or -1 on error.
+size_t NEA_PackFileSize(NEA_Pack *pack, const char *path);
+
+/// Loads a file of a pack to RAM.
+///
+/// Compressed files are decompressed.
+///
+/// @param pack Pointer to the pack.
+/// @param path Path to the file.
+/// @return Returns a pointer to the data of the file that will have to be
+///         freed with free(), or NULL on error.
+char *NEA_PackLoadData(NEA_Pack *pack, const char *path);
+
+/// Opens a file of a pack to read it in chunks.
+///
+/// The stream must be closed with NEA_FATStreamClose().
+///
+/// @param pack Pointer to the pack.
+/// @param path Path to the file.
+/// @return Pointer to the stream, or NULL on error.
+NEA_FATStream *NEA_PackStreamOpen(NEA_Pack *pack, const char *path);
+
+/// @}
+
+#endif // NEA_PACK_H__
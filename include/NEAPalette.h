@@ -10,6 +10,7 @@
 #include <nds.h>
 
 #include "NEAPolygon.h"
+#include "NEAUpload.h"
 
 /// @file   NEAPalette.h
 /// @brief  Functions for loading, using and deleting palettes.
@@ -18,6 +19,12 @@
 ///
 /// Functions to load and manipulate texture palettes.
 ///
+/// Palettes with the same data and format share the same VRAM. When a palette
+/// is loaded, the system looks for a loaded palette with the same contents and,
+/// if there is one, the new palette object uses it instead of allocating new
+/// memory. The memory is freed when the last palette object that uses it is
+/// deleted. This can be disabled with NEA_PaletteSharing().
+///
 /// @{
 
 #define NEA_DEFAULT_PALETTES 64 ///< Default max number of palettes
@@ -50,6 +57,27 @@ int NEA_PaletteLoadFAT(NEA_Palette *pal, const char *path, NEA_TextureFormat for
 int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
                    NEA_TextureFormat format);
 
+/// Assign a palette in RAM to a palette object, copying it during the next
+/// vertical blanks.
+///
+/// The palette is allocated right away, but the data is copied by
+/// NEA_UploadUpdate(). Materials that use it are drawn without texture until
+/// it has been copied. The data must remain valid until the callback is called.
+/// If the palette is shared with one that is already in VRAM, nothing is copied
+/// and the callback is called before this function returns.
+///
+/// @param pal Pointer to the palette object.
+/// @param pointer Pointer to the palette in RAM.
+/// @param numcolor Number of colors of the palette.
+/// @param format Format of the palette.
+/// @param callback Function called when the copy has finished or has been
+///                 cancelled, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return It returns 1 on success, 0 on error.
+int NEA_PaletteLoadAsync(NEA_Palette *pal, const void *pointer, u16 numcolor,
+                         NEA_TextureFormat format,
+                         NEA_UploadCallback callback, void *arg);
+
 /// Assign a palette in RAM to a palette object, given its size.
 ///
 /// This function is like NEA_PaletteLoad(), but it takes the size of the texture
@@ -65,9 +93,28 @@ int NEA_PaletteLoadSize(NEA_Palette *pal, const void *pointer, size_t size,
 
 /// Deletes a palette object.
 ///
+/// If the palette data is shared with other palette objects, it stays in VRAM
+/// until all of them have been deleted.
+///
 /// @param pal Pointer to the palette object.
 void NEA_PaletteDelete(NEA_Palette *pal);
 
+/// Enables or disables sharing the VRAM of palettes with the same data.
+///
+/// It is enabled by default. It only affects palettes loaded after calling
+/// this function. Palettes loaded while it is disabled are never shared, so
+/// they can be modified with NEA_PaletteModificationStart() without changing
+/// other palettes.
+///
+/// @param enable true to enable sharing, false to disable it.
+void NEA_PaletteSharing(bool enable);
+
+/// Returns the number of palette objects that share the data of a palette.
+///
+/// @param pal Pointer to the palette object.
+/// @return Number of palette objects (0 if the palette isn't loaded).
+int NEA_PaletteGetUses(const NEA_Palette *pal);
+
 /// Tells the GPU to use the palette in the specified object.
 ///
 /// @param pal Pointer to the palette object.
@@ -94,9 +141,38 @@ int NEA_PaletteFreeMem(void);
 /// @return Returns the percentage of available memory (0-100).
 int NEA_PaletteFreeMemPercent(void);
 
+/// Max number of bytes moved by NEA_WaitForVBL() with NEA_UPDATE_PALETTE_DEFRAG.
+#define NEA_PALETTE_DEFRAG_STEP_BYTES 1024
+
+/// Defragment part of the memory used for palettes.
+///
+/// Palettes are moved towards the start of VRAM to join the gaps left by the
+/// palettes that have been deleted. The new addresses keep the alignment
+/// required by the hardware (8 bytes for NEA_PAL4, 16 bytes for the rest). The
+/// materials that use a palette that has been moved use the new address right
+/// away.
+///
+/// At least one palette is moved if there is any that can be moved, even if it
+/// is bigger than the limit. Palettes are only moved if a palette has been
+/// deleted since the last time that the memory was fully defragmented, so it
+/// is cheap to call this every frame. Nothing is moved while a palette is
+/// being modified with NEA_PaletteModificationStart(), and palettes with a
+/// pending upload of NEA_PaletteLoadAsync() stay where they are.
+///
+/// VRAM is unlocked while the palettes are copied, so this should be called
+/// right after the vertical blank starts. It stops before moving a palette if
+/// the 3D engine has started rendering (see NEA_GPUIsRendering()), and it
+/// doesn't move anything if it is called while the GPU is rendering.
+///
+/// @param max_bytes Number of bytes to move before returning.
+/// @return Returns the number of bytes that have been moved, or 0 if there is
+///         nothing left to move.
+size_t NEA_PaletteDefragMemStep(size_t max_bytes);
+
 /// Defragment memory used for palettes.
 ///
-/// WARNING: This function is currently not working.
+/// It moves palettes until there is nothing else to move. Palette loads call it
+/// if there is enough free memory for a new palette, but not in one gap.
 void NEA_PaletteDefragMem(void);
 
 /// End palette system and free all memory used by it.
@@ -111,6 +187,12 @@ void NEA_PaletteSystemEnd(void);
 /// finish. If you don't, the GPU won't be able to render textures to the
 /// screen.
 ///
+/// If the palette is shared (see NEA_PaletteGetUses()), the changes affect all
+/// the palette objects that share it.
+///
+/// To change colors outside of the vertical blank, use
+/// NEA_PaletteQueueColors() instead.
+///
 /// @param pal Palette to modify.
 /// @return Returns a pointer to the base address of the palette in VRAM.
 void *NEA_PaletteModificationStart(const NEA_Palette *pal);
@@ -128,6 +210,57 @@ void NEA_PaletteRGB256SetColor(u8 colorindex, u16 color);
 /// Use this during VBL.
 void NEA_PaletteModificationEnd(void);
 
+/// Max number of colors that can be waiting in the palette update queue.
+#define NEA_PALETTE_QUEUE_COLORS 512
+
+/// Max number of ranges of colors that can be waiting in the queue.
+#define NEA_PALETTE_QUEUE_RANGES 32
+
+/// Adds a range of colors of a palette to the palette update queue.
+///
+/// The colors are copied to a staging buffer, so the array can be reused right
+/// away. They are written to VRAM by NEA_PaletteQueueUpdate() during the next
+/// vertical blank, so this can be called at any moment of the frame without
+/// glitches in the rendered image. This is meant for palette cycling effects:
+/// keep the colors in RAM, rotate them and queue the range that changes every
+/// frame.
+///
+/// If the palette is shared (see NEA_PaletteGetUses()), the changes affect all
+/// the palette objects that share it.
+///
+/// @param pal Palette to modify.
+/// @param first First color index to change.
+/// @param colors New colors.
+/// @param count Number of colors.
+/// @return It returns 1 on success, 0 if there isn't enough space in the queue.
+int NEA_PaletteQueueColors(const NEA_Palette *pal, int first,
+                           const u16 *colors, int count);
+
+/// Adds one color of a palette to the palette update queue.
+///
+/// Colors that follow the last color queued in the same palette are added to
+/// the same range, so setting colors one by one in order doesn't use more
+/// ranges than NEA_PaletteQueueColors().
+///
+/// @param pal Palette to modify.
+/// @param index Color index to change.
+/// @param color New color.
+/// @return It returns 1 on success, 0 if there isn't enough space in the queue.
+int NEA_PaletteQueueSetColor(const NEA_Palette *pal, int index, u16 color);
+
+/// Writes the colors of the palette update queue to VRAM.
+///
+/// It must be called right after the vertical blank starts. It unlocks palette
+/// VRAM once and copies each range with DMA. If the 3D engine is drawing, it
+/// doesn't do anything. Ranges of palettes that are still waiting in the
+/// upload queue (see NEA_PaletteLoadAsync()) are kept until the palette has
+/// been copied.
+///
+/// NEA_WaitForVBL() calls it if NEA_UPDATE_UPLOADS is used.
+///
+/// @return Returns the number of colors that have been written.
+int NEA_PaletteQueueUpdate(void);
+
 /// @}
 
 #endif // NEA_PALETTE_H__
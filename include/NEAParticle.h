@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_PARTICLE_H__
+#define NEA_PARTICLE_H__
+
+/// @file   NEAParticle.h
+/// @brief  Batched billboard particles.
+
+/// @defgroup particle Particle system
+///
+/// A particle pool holds a fixed number of particles that share a material, a
+/// polygon format and the same gravity. Each particle has a position, a
+/// velocity, a lifetime, and it fades from the start color and size of the
+/// pool to the end ones.
+///
+/// All the particles of a pool are drawn as quads that face the camera that
+/// was last passed to NEA_CameraUse(), inside a single GFX_BEGIN. The material
+/// is only bound once per pool. The positions of the particles are relative to
+/// the origin of the pool, and they must stay within NEA_PARTICLE_MAX_RANGE
+/// units of it.
+///
+/// The system needs to be initialized with NEA_ParticleSystemReset().
+/// NEA_WaitForVBL() updates all pools if NEA_UPDATE_PARTICLES is used.
+///
+/// @{
+
+#define NEA_DEFAULT_PARTICLE_POOLS 8 ///< Default max number of pools
+
+/// Max distance from a particle to the origin of its pool (in units)
+#define NEA_PARTICLE_MAX_RANGE 128
+
+/// Holds information of one particle.
+typedef struct {
+    int32_t x, y, z;    ///< Position relative to the pool (f32)
+    int32_t vx, vy, vz; ///< Velocity in units per frame (f32)
+    int32_t age;        ///< Fraction of the lifetime that has passed (f32)
+    int32_t age_step;   ///< Increment of the age per frame (f32)
+} NEA_Particle;
+
+/// Holds information of a particle pool.
+typedef struct {
+    NEA_Particle *particles; ///< Array of live particles
+    int num_particles;      ///< Number of live particles
+    int max_particles;      ///< Size of the array of particles
+    int32_t x, y, z;        ///< Origin of the pool (f32)
+    int32_t gx, gy, gz;     ///< Gravity in units per frame per frame (f32)
+    int32_t size_start;     ///< Half size of new particles (f32)
+    int32_t size_end;       ///< Half size of particles that are about to die (f32)
+    u32 color_start;        ///< Color of new particles
+    u32 color_end;          ///< Color of particles that are about to die
+    NEA_Material *mat;      ///< Material
+    s16 tl;                 ///< Left coordinate of the texture canvas
+    s16 tr;                 ///< Right coordinate of the texture canvas
+    s16 tt;                 ///< Top coordinate of the texture canvas
+    s16 tb;                 ///< Bottom coordinate of the texture canvas
+    bool visible;           ///< true if visible, false if not
+    u8 alpha;               ///< Alpha value
+    u8 id;                  ///< Polygon ID
+} NEA_ParticlePool;
+
+/// Creates a new particle pool.
+///
+/// @param max_particles Max number of live particles.
+/// @return Pointer to the newly created pool, or NULL on error.
+NEA_ParticlePool *NEA_ParticlePoolCreate(int max_particles);
+
+/// Deletes a particle pool.
+///
+/// @param pool Pointer to the pool.
+void NEA_ParticlePoolDelete(NEA_ParticlePool *pool);
+
+/// Deletes all particle pools.
+void NEA_ParticlePoolDeleteAll(void);
+
+/// Sets the material of a particle pool.
+///
+/// The texture canvas is set to the whole texture.
+///
+/// @param pool Pointer to the pool.
+/// @param mat Material.
+void NEA_ParticlePoolSetMaterial(NEA_ParticlePool *pool, NEA_Material *mat);
+
+/// Sets the part of the texture used by the particles of a pool.
+///
+/// This works like NEA_SpriteSetMaterialCanvas().
+///
+/// @param pool Pointer to the pool.
+/// @param tl Left coordinate of the canvas (in texels).
+/// @param tt Top coordinate of the canvas (in texels).
+/// @param tr Right coordinate of the canvas (in texels).
+/// @param tb Bottom coordinate of the canvas (in texels).
+void NEA_ParticlePoolSetMaterialCanvas(NEA_ParticlePool *pool,
+                                       int tl, int tt, int tr, int tb);
+
+/// Sets the origin of a particle pool.
+///
+/// Moving the origin moves all the particles of the pool.
+///
+/// @param pool Pointer to the pool.
+/// @param x (x, y, z) Coordinates (f32).
+/// @param y (x, y, z) Coordinates (f32).
+/// @param z (x, y, z) Coordinates (f32).
+void NEA_ParticlePoolSetCoordI(NEA_ParticlePool *pool,
+                               int32_t x, int32_t y, int32_t z);
+
+/// Sets the origin of a particle pool.
+///
+/// @param p Pointer to the pool.
+/// @param x (x, y, z) Coordinates (float).
+/// @param y (x, y, z) Coordinates (float).
+/// @param z (x, y, z) Coordinates (float).
+#define NEA_ParticlePoolSetCoord(p, x, y, z) \
+    NEA_ParticlePoolSetCoordI(p, floattof32(x), floattof32(y), floattof32(z))
+
+/// Sets the acceleration applied to all particles of a pool every frame.
+///
+/// @param pool Pointer to the pool.
+/// @param x (x, y, z) Acceleration (f32).
+/// @param y (x, y, z) Acceleration (f32).
+/// @param z (x, y, z) Acceleration (f32).
+void NEA_ParticlePoolSetGravityI(NEA_ParticlePool *pool,
+                                 int32_t x, int32_t y, int32_t z);
+
+/// Sets the acceleration applied to all particles of a pool every frame.
+///
+/// @param p Pointer to the pool.
+/// @param x (x, y, z) Acceleration (float).
+/// @param y (x, y, z) Acceleration (float).
+/// @param z (x, y, z) Acceleration (float).
+#define NEA_ParticlePoolSetGravity(p, x, y, z) \
+    NEA_ParticlePoolSetGravityI(p, floattof32(x), floattof32(y), floattof32(z))
+
+/// Sets the half size of the particles of a pool at the start and end of
+/// their lifetime.
+///
+/// @param pool Pointer to the pool.
+/// @param start Half size of new particles (f32).
+/// @param end Half size of particles that are about to die (f32).
+void NEA_ParticlePoolSetSizeI(NEA_ParticlePool *pool,
+                              int32_t start, int32_t end);
+
+/// Sets the half size of the particles of a pool at the start and end of
+/// their lifetime.
+///
+/// @param p Pointer to the pool.
+/// @param s Half size of new particles (float).
+/// @param e Half size of particles that are about to die (float).
+#define NEA_ParticlePoolSetSize(p, s, e) \
+    NEA_ParticlePoolSetSizeI(p, floattof32(s), floattof32(e))
+
+/// Sets the color of the particles of a pool at the start and end of their
+/// lifetime.
+///
+/// @param pool Pointer to the pool.
+/// @param start Color of new particles.
+/// @param end Color of particles that are about to die.
+void NEA_ParticlePoolSetColors(NEA_ParticlePool *pool, u32 start, u32 end);
+
+/// Sets the alpha value and polygon ID of the particles of a pool.
+///
+/// @param pool Pointer to the pool.
+/// @param alpha Alpha value (0 - 31).
+/// @param id Polygon ID (0 - 63).
+void NEA_ParticlePoolSetParams(NEA_ParticlePool *pool, u8 alpha, u8 id);
+
+/// Shows or hides a particle pool.
+///
+/// Hidden pools are still updated.
+///
+/// @param pool Pointer to the pool.
+/// @param visible true to show it, false to hide it.
+void NEA_ParticlePoolVisible(NEA_ParticlePool *pool, bool visible);
+
+/// Emits a new particle.
+///
+/// @param pool Pointer to the pool.
+/// @param x (x, y, z) Position relative to the pool (f32).
+/// @param y (x, y, z) Position relative to the pool (f32).
+/// @param z (x, y, z) Position relative to the pool (f32).
+/// @param vx (vx, vy, vz) Velocity in units per frame (f32).
+/// @param vy (vx, vy, vz) Velocity in units per frame (f32).
+/// @param vz (vx, vy, vz) Velocity in units per frame (f32).
+/// @param frames Lifetime of the particle in frames.
+/// @return Returns 1 on success, 0 if the pool is full.
+int NEA_ParticleEmitI(NEA_ParticlePool *pool, int32_t x, int32_t y, int32_t z,
+                      int32_t vx, int32_t vy, int32_t vz, int frames);
+
+/// Emits a new particle.
+///
+/// @param p Pointer to the pool.
+/// @param x (x, y, z) Position relative to the pool (float).
+/// @param y (x, y, z) Position relative to the pool (float).
+/// @param z (x, y, z) Position relative to the pool (float).
+/// @param vx (vx, vy, vz) Velocity in units per frame (float).
+/// @param vy (vx, vy, vz) Velocity in units per frame (float).
+/// @param vz (vx, vy, vz) Velocity in units per frame (float).
+/// @param f Lifetime of the particle in frames.
+/// @return Returns 1 on success, 0 if the pool is full.
+#define NEA_ParticleEmit(p, x, y, z, vx, vy, vz, f) \
+    NEA_ParticleEmitI(p, floattof32(x), floattof32(y), floattof32(z), \
+                      floattof32(vx), floattof32(vy), floattof32(vz), f)
+
+/// Returns the number of live particles of a pool.
+///
+/// @param pool Pointer to the pool.
+/// @return Number of particles.
+int NEA_ParticlePoolGetCount(const NEA_ParticlePool *pool);
+
+/// Removes all particles of a pool.
+///
+/// @param pool Pointer to the pool.
+void NEA_ParticlePoolClear(NEA_ParticlePool *pool);
+
+/// Moves the particles of a pool and removes the ones that have died.
+///
+/// @param pool Pointer to the pool.
+void NEA_ParticlePoolUpdate(NEA_ParticlePool *pool);
+
+/// Updates all particle pools.
+void NEA_ParticleUpdateAll(void);
+
+/// Draws all particles of a pool.
+///
+/// It must be called after NEA_CameraUse(). The particles face that camera.
+///
+/// @param pool Pointer to the pool.
+void NEA_ParticlePoolDraw(const NEA_ParticlePool *pool);
+
+/// Draws all visible particle pools.
+void NEA_ParticleDrawAll(void);
+
+/// Resets the particle system and sets the maximum number of pools.
+///
+/// @param max_pools Number of pools. If it is lower than 1, it will create
+///                  space for NEA_DEFAULT_PARTICLE_POOLS.
+/// @return Returns 0 on success, -1 on error.
+int NEA_ParticleSystemReset(int max_pools);
+
+/// Ends the particle system and frees all memory used by it.
+void NEA_ParticleSystemEnd(void);
+
+/// @}
+
+#endif // NEA_PARTICLE_H__
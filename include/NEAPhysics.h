@@ -24,11 +24,26 @@
 
 #define NEA_DEFAULT_PHYSICS  64 ///< Default max number of physics objects.
 
+/// Default size of the collision event buffer, see NEA_PhysicsSetEventMode().
+#define NEA_DEFAULT_PHYSICS_EVENTS 64
+
 /// Minimum speed that an object needs to have to rebound after a collision.
 ///
 /// If the object has less speed than this, it will stop after a collision.
 #define NEA_MIN_BOUNCE_SPEED (floattof32(0.01))
 
+/// Max distance that an object can move in each axis and still be at rest.
+#define NEA_PHYSICS_SLEEP_DISTANCE (floattof32(0.05))
+
+/// Number of frames that an object needs to be at rest to fall asleep.
+#define NEA_PHYSICS_SLEEP_TIME 48
+
+/// Max number of contacts with a collision mesh resolved in the same update.
+///
+/// An object in the corner between a floor and a wall is pushed out of both of
+/// them at the same time instead of one of them per frame.
+#define NEA_PHYSICS_MAX_CONTACTS 4
+
 /// Legacy object types (kept for backward compatibility).
 ///
 /// Prefer using NEA_PhysicsCreateEx() with NEA_ColShapeType for new code.
@@ -61,6 +76,25 @@ typedef void (*NEA_CollisionCallback)(NEA_Physics *self,
                                       NEA_Physics *other,
                                       const NEA_ColResult *result);
 
+/// How NEA_PhysicsUpdateAll() reports collisions.
+typedef enum {
+    /// Collision callbacks are called as soon as the collision is found.
+    NEA_PHYSICS_EVENTS_IMMEDIATE = 0,
+    /// Collisions of objects with a callback are saved to the event buffer,
+    /// and the callbacks are called after all objects have been updated.
+    NEA_PHYSICS_EVENTS_DEFERRED,
+    /// All collisions are saved to the event buffer, and no callback is
+    /// called. Read them with NEA_PhysicsGetEvents().
+    NEA_PHYSICS_EVENTS_BUFFERED
+} NEA_PhysicsEventMode;
+
+/// Collision saved by NEA_PhysicsUpdateAll() to the event buffer.
+typedef struct {
+    NEA_Physics *self;    ///< Object that was being updated.
+    NEA_Physics *other;   ///< Object it collided with.
+    NEA_ColResult result; ///< Deepest contact of the collision.
+} NEA_PhysicsEvent;
+
 /// Holds information of a physics object.
 ///
 /// Values are in fixed point (f32). The position of the object is obtained
@@ -99,6 +133,7 @@ struct NEA_Physics_ {
     NEA_CollisionCallback on_collision_cb; ///< Optional collision callback.
 
     bool is_static;        ///< If true, never moves (floor, walls, etc.).
+    bool continuous;       ///< If true, motion is swept against meshes.
 };
 
 /// Creates a new physics object (legacy API).
@@ -309,6 +344,21 @@ void NEA_PhysicsSetCallback(NEA_Physics *physics, NEA_CollisionCallback cb);
 /// @param is_static True for static, false for dynamic.
 void NEA_PhysicsSetStatic(NEA_Physics *physics, bool is_static);
 
+/// Enables or disables continuous collision against collision meshes.
+///
+/// By default, objects are only tested at the end of each step, so fast
+/// objects can go through thin walls. If continuous collision is enabled, a
+/// sphere or capsule that moves more than its radius in one step is swept
+/// against the BVH of the meshes that it can collide with, and it's moved back
+/// to the first point where it goes into one of them. The normal response of
+/// the object is applied there. Objects with other shapes aren't affected.
+///
+/// This costs one sweep per mesh in the steps where the object moves fast.
+///
+/// @param physics Pointer to the physics object.
+/// @param enable True to enable it, false to disable it.
+void NEA_PhysicsSetContinuous(NEA_Physics *physics, bool enable);
+
 /// Returns true if given object is colliding.
 ///
 /// This doesn't work with objects that have been disabled with
@@ -318,11 +368,77 @@ void NEA_PhysicsSetStatic(NEA_Physics *physics, bool is_static);
 /// @return True if there is a collision, false otherwise.
 bool NEA_PhysicsIsColliding(const NEA_Physics *pointer);
 
+/// Allows or forbids an object to fall asleep.
+///
+/// Objects are allowed to sleep by default. See NEA_PhysicsUpdateAll().
+///
+/// @param physics Pointer to the object.
+/// @param allow True to allow the object to sleep, false to keep it awake.
+void NEA_PhysicsAllowSleep(NEA_Physics *physics, bool allow);
+
+/// Wakes up a sleeping object and all the objects of its island.
+///
+/// This is only needed after modifying the fields of the object directly. The
+/// setters of the physics objects wake them up.
+///
+/// @param physics Pointer to the object.
+void NEA_PhysicsWake(NEA_Physics *physics);
+
+/// Returns true if the object is sleeping.
+///
+/// @param pointer Pointer to the object.
+/// @return True if the object is sleeping, false otherwise.
+bool NEA_PhysicsIsSleeping(const NEA_Physics *pointer);
+
+/// Selects how NEA_PhysicsUpdateAll() reports collisions.
+///
+/// Callbacks called in the middle of the update can't safely move or change
+/// other objects, because they may have been updated already or not. In the
+/// deferred modes the update only saves the collisions to a buffer of fixed
+/// size, and they are reported after all objects have been updated. If the
+/// buffer is full, the next collisions of the update are dropped, see
+/// NEA_PhysicsGetDroppedEvents().
+///
+/// NEA_PhysicsUpdate() always calls the callbacks right away.
+///
+/// @param mode Mode (NEA_PHYSICS_EVENTS_IMMEDIATE by default).
+/// @param max_events Size of the buffer. If it is lower than 1, it will create
+///                   space for NEA_DEFAULT_PHYSICS_EVENTS.
+/// @return It returns 1 on success, 0 on error.
+int NEA_PhysicsSetEventMode(NEA_PhysicsEventMode mode, int max_events);
+
+/// Returns the collisions saved by the last call to NEA_PhysicsUpdateAll().
+///
+/// The events are sorted in the order the collisions were found. They are kept
+/// until the next update. Events with objects that have been deleted since the
+/// update must be skipped by the caller.
+///
+/// @param events Pointer to store the address of the first event.
+/// @return Number of events.
+int NEA_PhysicsGetEvents(const NEA_PhysicsEvent **events);
+
+/// Returns the number of collisions of the last update that didn't fit in
+/// the event buffer.
+///
+/// @return Number of events dropped.
+int NEA_PhysicsGetDroppedEvents(void);
+
 /// Updates all physics objects.
+///
+/// Objects that have moved less than NEA_PHYSICS_SLEEP_DISTANCE in
+/// NEA_PHYSICS_SLEEP_TIME frames fall asleep, and they aren't updated until
+/// they are woken up. Objects that touch each other form an island, and they
+/// fall asleep at the same time. They wake up at the same time too, when one
+/// of them is hit by an awake object, when its model is moved or its speed is
+/// changed, or when one of its setters is called. Sleeping objects keep the
+/// result of NEA_PhysicsIsColliding() of the frame they fell asleep, and their
+/// collision callbacks aren't called.
 void NEA_PhysicsUpdateAll(void);
 
 /// Updates the provided physics object.
 ///
+/// If the object is sleeping, it is woken up.
+///
 /// @param pointer Pointer to the object.
 void NEA_PhysicsUpdate(NEA_Physics *pointer);
 
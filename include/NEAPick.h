@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_PICK_H__
+#define NEA_PICK_H__
+
+#include <nds.h>
+
+#include "NEACamera.h"
+#include "NEACollision.h"
+#include "NEAModel.h"
+#include "NEAScene.h"
+
+/// @file   NEAPick.h
+/// @brief  Selection of objects with the stylus on the CPU.
+
+/// @defgroup pick Picking
+///
+/// Picking finds the object under a point of the screen without drawing
+/// anything, so the result is available right away (the touch test functions
+/// need to draw the objects again and read the result in the next frame).
+///
+/// NEA_PickStart() converts a point of the screen into a ray that goes from the
+/// near plane to the far plane of a camera. The other functions test the ray
+/// against bounding spheres, models, collision shapes (ColMeshes use their
+/// BVH) and the nodes of a scene, and remember the closest hit:
+///
+///     NEA_Pick pick;
+///     if (NEA_PickStart(&pick, camera, touch.px, touch.py))
+///     {
+///         for (int i = 0; i < num_models; i++)
+///             NEA_PickModel(&pick, models[i]);
+///
+///         if (pick.hit)
+///             selected = pick.object;
+///     }
+///
+/// The ray only takes the camera into account, so objects must be drawn right
+/// after NEA_CameraUse() without additional view transformations, and the
+/// camera must be on the screen that is touched.
+///
+/// @{
+
+/// Type of the object hit by a ray.
+typedef enum {
+    NEA_PICK_NONE,   ///< Nothing has been hit
+    NEA_PICK_SPHERE, ///< Sphere tested with NEA_PickSphereI()
+    NEA_PICK_MODEL,  ///< Model (NEA_Model)
+    NEA_PICK_SHAPE,  ///< Collision shape tested with NEA_PickShape()
+    NEA_PICK_NODE    ///< Node of a scene (NEA_SceneNode)
+} NEA_PickType;
+
+/// Holds the ray of a pick and its closest hit.
+typedef struct {
+    NEA_Vec3 from;     ///< Start of the ray (f32)
+    NEA_Vec3 to;       ///< End of the ray, moved to the closest hit (f32)
+    bool hit;          ///< True if something has been hit
+    NEA_PickType type; ///< Type of the closest object
+    void *object;      ///< Closest object
+    int32_t distance;  ///< Distance from the start of the ray to the hit (f32)
+    NEA_Vec3 point;    ///< Point hit in world space (f32)
+} NEA_Pick;
+
+/// Starts a pick from a point of the screen.
+///
+/// @param pick Pick to start.
+/// @param cam Camera used to draw the scene, or NULL for the camera used last
+///            with NEA_CameraUse().
+/// @param px (px, py) Point of the screen in pixels, like the values returned
+///           by touchRead().
+/// @param py (px, py) Point of the screen in pixels.
+/// @return Returns 1 on success, 0 if there is no camera.
+int NEA_PickStart(NEA_Pick *pick, NEA_Camera *cam, int px, int py);
+
+/// Starts a pick with a ray between two points.
+///
+/// @param pick Pick to start.
+/// @param from Start of the ray in world space (f32).
+/// @param to End of the ray in world space (f32).
+void NEA_PickStartRay(NEA_Pick *pick, NEA_Vec3 from, NEA_Vec3 to);
+
+/// Tests the ray of a pick against a sphere.
+///
+/// @param pick Pick.
+/// @param x (x, y, z) Center of the sphere in world space (f32).
+/// @param y (x, y, z) Center of the sphere in world space (f32).
+/// @param z (x, y, z) Center of the sphere in world space (f32).
+/// @param radius Radius of the sphere (f32).
+/// @param object Value to save in the pick if this is the closest hit.
+/// @return Returns true if this is the closest hit so far.
+bool NEA_PickSphereI(NEA_Pick *pick, int32_t x, int32_t y, int32_t z,
+                     int32_t radius, void *object);
+
+/// Tests the ray of a pick against the bounding sphere of a model.
+///
+/// It uses the matrix assigned with NEA_ModelSetMatrix() if there is one, or
+/// the position, rotation and scale of the model. Models without a bounding
+/// sphere or without a mesh can't be picked.
+///
+/// @param pick Pick.
+/// @param model Model.
+/// @return Returns true if this is the closest hit so far.
+bool NEA_PickModel(NEA_Pick *pick, NEA_Model *model);
+
+/// Tests the ray of a pick against a collision shape.
+///
+/// This is more precise than the bounding sphere of a model. For example, a
+/// ColMesh of a model can be tested after its bounding sphere has been hit.
+///
+/// @param pick Pick.
+/// @param shape Collision shape.
+/// @param pos World-space position of the shape (f32).
+/// @param object Value to save in the pick if this is the closest hit.
+/// @return Returns true if this is the closest hit so far.
+bool NEA_PickShape(NEA_Pick *pick, const NEA_ColShape *shape, NEA_Vec3 pos,
+                   void *object);
+
+/// Tests the ray of a pick against the visible mesh nodes of a scene.
+///
+/// The nodes are tested with the bounding spheres built by NEA_SceneUpdate(),
+/// so subtrees that the ray doesn't touch are skipped with one test. The
+/// scenes of the sectors that are loaded are tested too. Nodes whose model has
+/// no bounds can't be picked.
+///
+/// @param pick Pick.
+/// @param scene Scene, updated with NEA_SceneUpdate().
+/// @return Returns the closest node hit by the ray, or NULL if none of the
+///         nodes of the scene is closer than the previous hits.
+NEA_SceneNode *NEA_PickScene(NEA_Pick *pick, const NEA_Scene *scene);
+
+/// @}
+
+#endif // NEA_PICK_H__
@@ -8,6 +8,7 @@
 #define NEA_POLYGON_H__
 
 #include "NEAMain.h"
+#include "NEADisplayList.h"
 
 /// @file   NEAPolygon.h
 /// @brief  Functions to draw polygons and more...
@@ -99,17 +100,36 @@ typedef enum {
 /// @param function The name of the function used to generate the table.
 void NEA_ShininessTableGenerate(NEA_ShininessFunction function);
 
+// Internal use. See NEADisplayList.c
+extern NEA_DisplayListRecorder *ne_dl_recorder;
+void ne_dl_record(uint32_t id, int num_params, uint32_t p0, uint32_t p1);
+
 /// Begins a polygon.
 ///
+/// This and the other NEA_Poly functions are recorded if a display list
+/// recorder is active (see NEA_DisplayListRecordBegin()).
+///
 /// @param mode Type of polygon to draw (GL_TRIANGLE, GL_QUAD...).
 static inline void NEA_PolyBegin(int mode)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_BEGIN, 1, mode, 0);
+        return;
+    }
+
     GFX_BEGIN = mode;
 }
 
 /// Stops drawing polygons.
 static inline void NEA_PolyEnd(void)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_END, 0, 0, 0);
+        return;
+    }
+
     GFX_END = 0;
 }
 
@@ -118,6 +138,12 @@ static inline void NEA_PolyEnd(void)
 /// @param color Color.
 static inline void NEA_PolyColor(u32 color)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_COLOR, 1, color, 0);
+        return;
+    }
+
     GFX_COLOR = color;
 }
 
@@ -128,6 +154,12 @@ static inline void NEA_PolyColor(u32 color)
 /// @param z (x, y, z) Unit vector (v10).
 static inline void NEA_PolyNormalI(int x, int y, int z)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_NORMAL, 1, NORMAL_PACK(x, y, z), 0);
+        return;
+    }
+
     GFX_NORMAL = NORMAL_PACK(x, y, z);
 }
 
@@ -146,6 +178,13 @@ static inline void NEA_PolyNormalI(int x, int y, int z)
 /// @param z (x, y, z) Vertex coordinates (v16).
 static inline void NEA_PolyVertexI(int x, int y, int z)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_VERTEX16, 2, (y << 16) | (x & 0xFFFF),
+                     (uint32_t)(uint16_t)z);
+        return;
+    }
+
     GFX_VERTEX16 = (y << 16) | (x & 0xFFFF);
     GFX_VERTEX16 = (uint32_t)(uint16_t)z;
 }
@@ -169,6 +208,13 @@ static inline void NEA_PolyVertexI(int x, int y, int z)
 /// @param v (u, v) Texture coordinates (0 - texturesize).
 static inline void NEA_PolyTexCoord(int u, int v)
 {
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_TEX_COORD, 1,
+                     TEXTURE_PACK(inttot16(u), inttot16(v)), 0);
+        return;
+    }
+
     GFX_TEX_COORD = TEXTURE_PACK(inttot16(u), inttot16(v));
 }
 
@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_POSESERVICE_H__
+#define NEA_POSESERVICE_H__
+
+#include <nds.h>
+
+/// @file   NEAPoseService.h
+/// @brief  Interpolation of skeletal animations on the ARM7.
+
+/// @defgroup pose_service Pose service
+///
+/// The ARM7 binaries of Nitro Engine Advanced (arm7_nea.elf and
+/// arm7_nea_maxmod.elf) can interpolate the joints of DSA animations while
+/// they wait for the next VBlank. When the service is running,
+/// NEA_ModelAnimateAll() asks the ARM7 for the pose that each animated model
+/// will need when it's drawn, and the ARM9 only has to convert the joints to
+/// matrices and send them to the hardware.
+///
+///     NEA_PoseServiceStart();
+///
+///     while (1)
+///     {
+///         NEA_WaitForVBL(NEA_UPDATE_ANIMATIONS);
+///         // The ARM7 works on the poses while the game logic runs
+///         ...
+///         NEA_ProcessFrame(Draw3DScene);
+///     }
+///
+/// Poses that aren't ready when a model is drawn are interpolated by the ARM9
+/// as usual, so the result is the same with or without the service. Blended
+/// animations, models split in bone batches and whole frames of baked
+/// animations aren't requested.
+///
+/// The ARM7 reads the DSA files directly from main RAM. NEA_AnimationLoad()
+/// and NEA_AnimationLoadFAT() flush them from the data cache, DSA files used
+/// in any other way must be flushed with DC_FlushRange().
+///
+/// @{
+
+/// Starts sending pose requests to the ARM7.
+///
+/// @return It returns 1 on success, 0 if the shared block can't be set up.
+int NEA_PoseServiceStart(void);
+
+/// Stops sending pose requests to the ARM7.
+void NEA_PoseServiceStop(void);
+
+/// Returns true if the pose service is running.
+///
+/// @return True if it's running.
+bool NEA_PoseServiceIsActive(void);
+
+/// Requests the pose of an animation at a frame.
+///
+/// NEA_ModelAnimateAll() calls this for all animated models. Requests of the
+/// same pose as a previous request are ignored.
+///
+/// @param dsa_file Pointer to the DSA file.
+/// @param frame_interp Frame (20.12 fixed point).
+/// @return It returns 1 if the pose has been requested, 0 on error (the
+///         service isn't running, the ring is full or the animation has too
+///         many joints).
+int NEA_PoseServiceRequest(const void *dsa_file, uint32_t frame_interp);
+
+/// Forgets all the poses that have been requested.
+///
+/// This must be called if the data of a DSA file is modified or freed.
+/// NEA_AnimationDelete() and the functions that load animations call it.
+void NEA_PoseServiceInvalidate(void);
+
+/// Returns the number of poses that the ARM7 has interpolated since the
+/// service was started for the first time.
+///
+/// @return Number of poses.
+uint32_t NEA_PoseServiceGetServed(void);
+
+/// @}
+
+#endif // NEA_POSESERVICE_H__
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_PROFILE_H__
+#define NEA_PROFILE_H__
+
+#include <nds.h>
+
+/// @file   NEAProfile.h
+/// @brief  Frame profiler.
+
+/// @defgroup profile Frame profiler
+///
+/// NEA_GetCPUPercent() only says how busy the CPU is. The profiler measures how
+/// much time each system of the engine takes every frame, using two cascaded
+/// hardware timers that count bus cycles (33.51 MHz, 560190 cycles per frame).
+///
+/// NEA_WaitForVBL() measures the systems it updates, NEA_Process() and the
+/// other process functions measure the draw callback and the wait for the
+/// display lists to be sent to the GPU, and the game can measure its own code
+/// with NEA_ProfileBegin() and NEA_ProfileEnd(). The results of the last
+/// NEA_PROFILE_HISTORY frames are kept, and they can be printed to the console
+/// with NEA_ProfilePrint(), or formatted into a string to print it with the
+/// text system (see NEA_ProfileFormat()).
+///
+/// The library also counts the work done in its hot paths every frame (models
+/// drawn, material changes, collision tests, etc), and the counters of the last
+/// complete frame can be read with NEA_StatsGet().
+///
+/// The profiler is only built if NEA_PROFILE is defined when building both the
+/// library (with "make NEA_PROFILE=1") and the game. If not, all functions are
+/// replaced by empty macros and they don't add any code. The counters aren't
+/// built into the library either.
+///
+/// @{
+
+#define NEA_PROFILE_HISTORY 32 ///< Number of frames kept by the profiler
+
+/// Hardware timer used by the profiler. The next one is used as well.
+#ifndef NEA_PROFILE_TIMER
+#define NEA_PROFILE_TIMER 2
+#endif
+
+/// Bus cycles per frame (263 lines of 2130 cycles).
+#define NEA_PROFILE_FRAME_CYCLES 560190
+
+/// Scopes measured by the profiler.
+typedef enum {
+    NEA_PROFILE_ANIMATIONS = 0, ///< NEA_ModelAnimateAll()
+    NEA_PROFILE_PHYSICS,        ///< NEA_PhysicsUpdateAll()
+    NEA_PROFILE_SOUND,          ///< NEA_SoundUpdateAll()
+    NEA_PROFILE_ANIM_MAT,       ///< NEA_AnimMatUpdateAll()
+    NEA_PROFILE_RIGIDBODY,      ///< NEA_RigidBodySync()
+    NEA_PROFILE_PARTICLES,      ///< NEA_ParticleUpdateAll()
+    NEA_PROFILE_DRAW,           ///< Draw callbacks of NEA_Process() and others
+    NEA_PROFILE_FIFO_WAIT,      ///< Wait for display lists to be sent
+    NEA_PROFILE_VBL_WAIT,       ///< Wait for the vertical blank
+    NEA_PROFILE_VBL_UPDATES,    ///< Updates done after the vertical blank
+    NEA_PROFILE_JOBS,           ///< Jobs of the scheduler (see NEAJob.h)
+    NEA_PROFILE_USER,           ///< First scope available for the game
+    NEA_PROFILE_MAX_SCOPES = 16 ///< Number of scopes
+} NEA_ProfileScope;
+
+/// Work done by the engine during one frame.
+typedef struct {
+    u32 models_drawn;     ///< Models sent to the GPU by NEA_ModelDraw()
+    u32 models_culled;    ///< Models skipped by frustum culling
+    u32 dl_words;         ///< Display list words sent to the GX FIFO
+    u32 material_binds;   ///< Calls to NEA_MaterialUse()
+    u32 col_pair_tests;   ///< Shape pairs tested by NEACollision.c
+    u32 col_tri_tests;    ///< Triangles tested by NEACollision.c
+    u32 bone_matrices;    ///< Bone matrices built by DSMA (not from the cache)
+    u32 sound_updates;    ///< Sound sources updated by NEA_SoundUpdateAll()
+    u32 alloc_calls;      ///< Allocations and frees of the VRAM allocator
+} NEA_Stats;
+
+#ifdef NEA_PROFILE
+
+/// Starts measuring a scope.
+///
+/// A scope can be measured several times in the same frame, the times are
+/// added. Different scopes can be nested.
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+void NEA_ProfileBegin(int scope);
+
+/// Stops measuring a scope started with NEA_ProfileBegin().
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+void NEA_ProfileEnd(int scope);
+
+/// Sets the name printed for a scope (for example, one added by the game).
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+/// @param name Name. It must remain valid while the profiler is used.
+void NEA_ProfileSetName(int scope, const char *name);
+
+/// Returns the name printed for a scope.
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+/// @return Name, or NULL if the scope doesn't have a name.
+const char *NEA_ProfileGetName(int scope);
+
+/// Ends the current frame and starts a new one.
+///
+/// NEA_WaitForVBL() calls it after the vertical blank starts.
+void NEA_ProfileFrameEnd(void);
+
+/// Returns the cycles taken by a scope in a previous frame.
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+/// @param frames_ago 0 for the last complete frame, up to
+///                   NEA_PROFILE_HISTORY - 1.
+/// @return Number of bus cycles.
+u32 NEA_ProfileGetCycles(int scope, int frames_ago);
+
+/// Returns the average cycles taken by a scope in the kept frames.
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+/// @return Number of bus cycles.
+u32 NEA_ProfileGetAverage(int scope);
+
+/// Returns the peak cycles taken by a scope in the kept frames.
+///
+/// @param scope Scope (0 to NEA_PROFILE_MAX_SCOPES - 1).
+/// @return Number of bus cycles.
+u32 NEA_ProfileGetPeak(int scope);
+
+/// Writes a table with the average and peak usage of all scopes used recently.
+///
+/// Each line has the name of the scope and its average and peak usage as a
+/// percentage of a frame. The lines are separated by '\n'.
+///
+/// @param buffer Destination buffer.
+/// @param size Size of the buffer in bytes.
+void NEA_ProfileFormat(char *buffer, size_t size);
+
+/// Prints the table of NEA_ProfileFormat() with printf().
+///
+/// A console must have been initialized, for example with
+/// NEA_InitConsole().
+void NEA_ProfilePrint(void);
+
+/// Gets the counters of the last complete frame.
+///
+/// The counters are reset by NEA_ProfileFrameEnd().
+///
+/// @param stats Destination.
+void NEA_StatsGet(NEA_Stats *stats);
+
+#else // #ifndef NEA_PROFILE
+
+#define NEA_ProfileBegin(scope)                 do { (void)(scope); } while (0)
+#define NEA_ProfileEnd(scope)                   do { (void)(scope); } while (0)
+#define NEA_ProfileSetName(scope, name)         do { } while (0)
+#define NEA_ProfileGetName(scope)               (NULL)
+#define NEA_ProfileFrameEnd()                   do { } while (0)
+#define NEA_ProfileGetCycles(scope, frames_ago) (0)
+#define NEA_ProfileGetAverage(scope)            (0)
+#define NEA_ProfileGetPeak(scope)               (0)
+#define NEA_ProfileFormat(buffer, size)         do { } while (0)
+#define NEA_ProfilePrint()                      do { } while (0)
+#define NEA_StatsGet(stats)                     (*(stats) = (NEA_Stats){ 0 })
+
+#endif // NEA_PROFILE
+
+/// @}
+
+#endif // NEA_PROFILE_H__
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_RENDERQUEUE_H__
+#define NEA_RENDERQUEUE_H__
+
+/// @file   NEARenderQueue.h
+/// @brief  Queue of draw commands sorted by material and translucency.
+
+/// @defgroup render_queue Render queue
+///
+/// Models, scene nodes and sprites can be submitted to the render queue instead
+/// of being drawn right away. When the queue is flushed, the objects are sorted
+/// and drawn in this order:
+///
+/// 1. Opaque objects that use the current polygon format, grouped by material
+///    and palette to reduce the number of material changes.
+/// 2. Opaque objects with their own polygon format, grouped the same way.
+/// 3. Translucent objects, from back to front along the view direction (if a
+///    camera has been set with NEA_RenderQueueSetCamera(), in submission order
+///    otherwise).
+/// 4. Sprites, after calling NEA_2DViewInit(). Opaque sprites are grouped by
+///    material, translucent sprites are drawn by priority.
+///
+/// NEA_Process() and NEA_ProcessTwoPass() flush the queue automatically after
+/// calling the draw function. In two-pass mode the sorted list can be replayed
+/// in the second pass without calling the draw function again, see
+/// NEA_RenderQueueSetTwoPassReplay().
+///
+/// The queue is sorted with a radix sort, so the cost of the sort grows
+/// linearly with the number of objects. Objects with the same material or depth
+/// are drawn in submission order.
+///
+/// NEA_RenderQueueSystemReset() must be called before submitting anything. The
+/// NEA_Init*() functions don't do it, so that the queue isn't linked if it
+/// isn't used. Objects submitted before that are dropped.
+///
+/// @{
+
+#define NEA_DEFAULT_RENDER_QUEUE_ENTRIES 256 ///< Default max number of entries
+
+/// Function that draws an object submitted to the queue with
+/// NEA_RenderQueueAddTranslucentI().
+///
+/// @param arg Argument given when the object was submitted.
+typedef void (*NEA_RenderQueueDrawFunc)(void *arg);
+
+/// Submit a model to the queue.
+///
+/// It will be drawn with the polygon format that is active when the queue is
+/// flushed.
+///
+/// @param model Pointer to the model.
+void NEA_RenderQueueAddModel(const NEA_Model *model);
+
+/// Submit a model to the queue with its own polygon format.
+///
+/// The arguments are the same ones as the ones of NEA_PolyFormat(). Models with
+/// an alpha value between 1 and 30 are considered translucent.
+///
+/// @param model Pointer to the model.
+/// @param alpha Alpha value (0 - 31).
+/// @param id Polygon ID (0 - 63).
+/// @param lights Lights enabled.
+/// @param culling Which polygons must be drawn.
+/// @param other Other parameters.
+void NEA_RenderQueueAddModelPolyFormat(const NEA_Model *model, u32 alpha,
+                                       u32 id, NEA_LightEnum lights,
+                                       NEA_CullingEnum culling,
+                                       NEA_OtherFormatEnum other);
+
+/// Submit a scene node to the queue.
+///
+/// Only mesh nodes with a model are added. If the node has an animated
+/// material, it is applied right before drawing the model.
+///
+/// @param node Pointer to the node.
+void NEA_RenderQueueAddSceneNode(const NEA_SceneNode *node);
+
+/// Submit a sprite to the queue.
+///
+/// @param sprite Pointer to the sprite.
+void NEA_RenderQueueAddSprite(const NEA_Sprite *sprite);
+
+/// Submit a translucent object drawn by a function to the queue.
+///
+/// This can be used for effects that aren't models, like particles or glass
+/// drawn with NEA_PolyBegin(). The function is called in the group of the
+/// translucent objects, sorted with the other ones by the depth of the
+/// provided position. It has to set its own polygon format.
+///
+/// @param fn Function that draws the object.
+/// @param arg Argument passed to the function.
+/// @param x (x, y, z) Position used to sort the object in world space (f32).
+/// @param y (x, y, z) Position used to sort the object in world space (f32).
+/// @param z (x, y, z) Position used to sort the object in world space (f32).
+void NEA_RenderQueueAddTranslucentI(NEA_RenderQueueDrawFunc fn, void *arg,
+                                    int32_t x, int32_t y, int32_t z);
+
+/// Submit a translucent object drawn by a function to the queue.
+///
+/// @param f Function that draws the object.
+/// @param a Argument passed to the function.
+/// @param x (x, y, z) Position used to sort the object in world space (float).
+/// @param y (x, y, z) Position used to sort the object in world space (float).
+/// @param z (x, y, z) Position used to sort the object in world space (float).
+#define NEA_RenderQueueAddTranslucent(f, a, x, y, z) \
+    NEA_RenderQueueAddTranslucentI(f, a, floattof32(x), floattof32(y), \
+                                   floattof32(z))
+
+/// Set the camera used to sort translucent objects and to replay the queue.
+///
+/// @param cam Camera, or NULL to sort translucent objects in submission order.
+void NEA_RenderQueueSetCamera(NEA_Camera *cam);
+
+/// Enable or disable replaying the queue in the other passes of two-pass modes.
+///
+/// When it is enabled, the draw function passed to NEA_ProcessTwoPass() is
+/// only called in the first pass. In the other passes, the sorted queue of the
+/// first pass is drawn again after calling NEA_CameraUse() with the camera set
+/// with NEA_RenderQueueSetCamera(). This only works if the draw function does
+/// everything through the queue.
+///
+/// @param enable True to enable replaying, false to disable it.
+void NEA_RenderQueueSetTwoPassReplay(bool enable);
+
+/// Sort and draw all objects in the queue, and clear it.
+///
+/// This is called automatically by NEA_Process() and NEA_ProcessTwoPass().
+void NEA_RenderQueueFlush(void);
+
+/// Remove all objects from the queue without drawing them.
+void NEA_RenderQueueClear(void);
+
+/// Returns the number of objects in the queue.
+///
+/// @return Number of objects.
+int NEA_RenderQueueGetCount(void);
+
+/// Resets the render queue and sets the maximum number of objects in it.
+///
+/// @param max_entries Number of objects. If it is lower than 1, it will
+///                    create space for NEA_DEFAULT_RENDER_QUEUE_ENTRIES.
+/// @return Returns 0 on success.
+int NEA_RenderQueueSystemReset(int max_entries);
+
+/// Ends the render queue system and frees all memory used by it.
+void NEA_RenderQueueSystemEnd(void);
+
+/// @}
+
+#endif // NEA_RENDERQUEUE_H__
@@ -0,0 +1,172 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_REPLAY_H__
+#define NEA_REPLAY_H__
+
+#include <nds.h>
+
+#include "NEAGeneral.h"
+#include "NEAProfile.h"
+
+/// @file   NEAReplay.h
+/// @brief  Input recording and replay, and benchmarks of replays.
+
+/// @defgroup replay Input replay
+///
+/// NEA_UpdateInput() can record the keys and the touch screen of every frame,
+/// and replay them later instead of reading the real input. A recording can be
+/// saved to a file and loaded again from NitroFS or FAT, so the same gameplay
+/// can be played again on different builds of the engine:
+///
+///     NEA_ReplayPlayFile("nitro:/bench.rpl");
+///     NEA_ReplayBenchmarkStart(0); // Until the end of the replay
+///
+///     while (!NEA_ReplayBenchmarkIsDone())
+///     {
+///         scanKeys();
+///         const NEA_Input *input = NEA_GetInput();
+///         ... // Game logic using input, not keysHeld()
+///         NEA_WaitForVBL(NEA_UPDATE_GUI);
+///         NEA_Process(Draw3DScene);
+///     }
+///
+///     NEA_ReplayBenchmarkDump("fat:/bench.csv");
+///
+/// A frame of the replay ends when NEA_WaitForVBL() is called. Only the state
+/// returned by NEA_GetInput() and used by the GUI is replayed: the game must
+/// read its input from it instead of calling keysHeld() or touchRead(), and it
+/// must start from the same state (like the seed of random numbers) as when it
+/// was recorded. Only the px and py fields of the touch screen are replayed.
+///
+/// Recording stores 4 bytes per frame. The file starts with the magic
+/// NEA_REPLAY_MAGIC, the version NEA_REPLAY_VERSION, the number of frames and
+/// the keys held before the first frame (32 bits each), followed by one
+/// NEA_ReplayFrame per frame.
+///
+/// @{
+
+#define NEA_REPLAY_MAGIC   0x4C50524E ///< "NRPL"
+#define NEA_REPLAY_VERSION 1          ///< Version of the replay format
+
+/// Input of one frame of a replay.
+typedef struct {
+    u16 keys; ///< Keys that are pressed (keysHeld())
+    u8 px;    ///< Touch screen X coordinate
+    u8 py;    ///< Touch screen Y coordinate
+} NEA_ReplayFrame;
+
+/// States of the replay system.
+typedef enum {
+    NEA_REPLAY_IDLE,      ///< The real input is used
+    NEA_REPLAY_RECORDING, ///< The real input is used and recorded
+    NEA_REPLAY_PLAYING    ///< The input is replayed
+} NEA_ReplayState;
+
+/// Statistics of one frame saved by the benchmark of a replay.
+///
+/// The cycles of the profiler and the counters are 0 if NEA_PROFILE isn't
+/// defined, see NEAProfile.h.
+typedef struct {
+    u32 cycles[NEA_PROFILE_MAX_SCOPES]; ///< Cycles of each profiler scope
+    NEA_Stats stats;                    ///< Counters of the engine
+    NEA_GPUStats gpu;                   ///< Statistics of the geometry engine
+} NEA_ReplayFrameStats;
+
+/// Starts recording the input.
+///
+/// The recording starts in the next call to NEA_UpdateInput(). It stops when
+/// NEA_ReplayStop() is called or when the buffer is full.
+///
+/// @param max_frames Max number of frames to record.
+/// @return It returns 1 on success, 0 on error (not enough memory).
+int NEA_ReplayRecordStart(int max_frames);
+
+/// Saves the recording to a file.
+///
+/// It can be called while recording or after it has stopped.
+///
+/// @param path Path to the file (in FAT, NitroFS is read-only).
+/// @return It returns 1 on success, 0 on error.
+int NEA_ReplaySave(const char *path);
+
+/// Starts replaying a recording from a buffer.
+///
+/// The buffer isn't copied, it must remain valid while it's replayed. It can be
+/// the contents of a file saved with NEA_ReplaySave().
+///
+/// @param data Pointer to the recording.
+/// @param size Size of the recording in bytes.
+/// @return It returns 1 on success, 0 if the data isn't a valid recording.
+int NEA_ReplayPlayBuffer(const void *data, size_t size);
+
+/// Starts replaying a recording from a file in NitroFS or FAT.
+///
+/// @param path Path to the file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_ReplayPlayFile(const char *path);
+
+/// Stops recording or replaying and goes back to the real input.
+///
+/// A recording is kept until the next call to NEA_ReplayRecordStart(),
+/// NEA_ReplayPlayBuffer() or NEA_ReplayPlayFile(), so it can still be saved.
+void NEA_ReplayStop(void);
+
+/// Returns the state of the replay system.
+///
+/// The state goes back to NEA_REPLAY_IDLE after the last frame of a replay.
+///
+/// @return State.
+NEA_ReplayState NEA_ReplayGetState(void);
+
+/// Returns the frame being recorded or replayed.
+///
+/// @return Frame index.
+int NEA_ReplayGetFrame(void);
+
+/// Returns the number of frames of the current recording or replay.
+///
+/// @return Number of frames.
+int NEA_ReplayGetFrameCount(void);
+
+/// Saves the statistics of every frame of the replay that is being played.
+///
+/// It must be called right after starting a replay. It enables the statistics
+/// of the geometry engine (see NEA_GPUStatsEnable()), and it saves the results
+/// of the profiler and the statistics of each frame when NEA_WaitForVBL()
+/// ends it. The buffer needs sizeof(NEA_ReplayFrameStats) bytes per frame.
+///
+/// @param frames Number of frames. If it's lower than 1, or bigger than the
+///               replay, the whole replay is used.
+/// @return It returns 1 on success, 0 on error.
+int NEA_ReplayBenchmarkStart(int frames);
+
+/// Returns true when all the frames of a benchmark have been saved.
+///
+/// @return True if the benchmark has ended.
+bool NEA_ReplayBenchmarkIsDone(void);
+
+/// Returns the statistics of a frame of the benchmark.
+///
+/// @param frame Frame index.
+/// @return Statistics, or NULL if the frame hasn't been saved.
+const NEA_ReplayFrameStats *NEA_ReplayBenchmarkGetFrame(int frame);
+
+/// Writes the statistics of the benchmark as a CSV table.
+///
+/// There is one line per frame saved and a last line with the average of each
+/// column. The profiler scopes are only written if NEA_PROFILE is defined.
+///
+/// @param path Path to the file (in FAT), or NULL to print it with printf().
+/// @return It returns 1 on success, 0 on error.
+int NEA_ReplayBenchmarkDump(const char *path);
+
+/// Frees the statistics of the benchmark.
+void NEA_ReplayBenchmarkEnd(void);
+
+/// @}
+
+#endif // NEA_REPLAY_H__
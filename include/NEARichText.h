@@ -37,6 +37,9 @@
 #define NEA_DEFAULT_RICH_TEXT_FONTS 8 ///< Default max number of rich text fonts
 #define NEA_MAX_RICH_TEXT_FONTS NEA_DEFAULT_RICH_TEXT_FONTS ///< Deprecated and unused, left for compatibility
 
+#define NEA_DEFAULT_RICH_TEXT_CACHE_ENTRIES 16 ///< Default max number of cached strings
+#define NEA_DEFAULT_RICH_TEXT_CACHE_BYTES (64 * 1024) ///< Default texture VRAM budget of the cache
+
 /// Change the priority of rich text drawn after this function call.
 ///
 /// @param priority New priority.
@@ -297,6 +300,132 @@ int NEA_RichTextRender3DAlpha(u32 slot, const char *str, s32 x, s32 y,
 int NEA_RichTextRenderMaterial(u32 slot, const char *str, NEA_Material **mat,
                               NEA_Palette **pal);
 
+/// Holds a string laid out with a rich text font.
+///
+/// A layout stores the position of every glyph of a string, so it can be
+/// measured and drawn many times without parsing the string again.
+typedef struct {
+    u32 slot;       ///< Font slot used to lay out the string
+    size_t size_x;  ///< Width of the string
+    size_t size_y;  ///< Height of the string
+    size_t final_x; ///< Final X position of the cursor
+    size_t final_y; ///< Final Y position of the cursor
+    void *glyphs;   ///< Internal glyph data
+} NEA_RichTextLayout;
+
+/// Lay out a string to draw it later.
+///
+/// The positions of the glyphs are calculated once. The layout can be drawn as
+/// 3D quads with NEA_RichTextLayoutRender3D() or rendered to a material with
+/// NEA_RichTextLayoutRenderMaterial() as many times as needed. Its size is
+/// available in the size_x and size_y fields, which hold the same values as
+/// NEA_RichTextRenderDryRun() returns.
+///
+/// The layout uses the metrics of the font of the slot, so it must be created
+/// again if the font of the slot changes.
+///
+/// @param slot The slot to use.
+/// @param str The string to lay out.
+/// @param xIndent The horizontal indentation to apply to the first line of text.
+/// @return Pointer to the new layout, or NULL on failure.
+NEA_RichTextLayout *NEA_RichTextLayoutCreateWithIndent(u32 slot,
+                                                       const char *str,
+                                                       s32 xIndent);
+
+/// Lay out a string to draw it later.
+///
+/// @param slot The slot to use.
+/// @param str The string to lay out.
+/// @return Pointer to the new layout, or NULL on failure.
+NEA_RichTextLayout *NEA_RichTextLayoutCreate(u32 slot, const char *str);
+
+/// Delete a layout.
+///
+/// @param layout The layout to delete.
+void NEA_RichTextLayoutDelete(NEA_RichTextLayout *layout);
+
+/// Render a layout by rendering one 3D quad per glyph.
+///
+/// This works like NEA_RichTextRender3D().
+///
+/// @param layout The layout to render.
+/// @param x The left coordinate of the text.
+/// @param y The top coordinate of the text.
+/// @return Returns 1 on success, 0 on failure.
+int NEA_RichTextLayoutRender3D(const NEA_RichTextLayout *layout, s32 x, s32 y);
+
+/// Render a layout by rendering one 3D quad per glyph with alternating
+/// polygon IDs.
+///
+/// This works like NEA_RichTextRender3DAlpha().
+///
+/// @param layout The layout to render.
+/// @param x The left coordinate of the text.
+/// @param y The top coordinate of the text.
+/// @param poly_fmt The polygon format values to be used for the quads.
+/// @param poly_id_base The base polygon ID to use for the quads.
+/// @return Returns 1 on success, 0 on failure.
+int NEA_RichTextLayoutRender3DAlpha(const NEA_RichTextLayout *layout,
+                                    s32 x, s32 y,
+                                    uint32_t poly_fmt, int poly_id_base);
+
+/// Render a layout and create a material from it.
+///
+/// This works like NEA_RichTextRenderMaterial().
+///
+/// @param layout The layout to render.
+/// @param mat A pointer to a NEA_Material to store the new material.
+/// @param pal A pointer to a NEA_Palette to store the new palette, or NULL.
+/// @return Returns 1 on success, 0 on failure.
+int NEA_RichTextLayoutRenderMaterial(const NEA_RichTextLayout *layout,
+                                     NEA_Material **mat, NEA_Palette **pal);
+
+/// Starts the cache of materials used by NEA_RichTextRenderMaterialCached().
+///
+/// If the cache was already started, all materials in it are deleted.
+///
+/// @param max_entries Max number of strings in the cache. If it is lower than
+///                    1, NEA_DEFAULT_RICH_TEXT_CACHE_ENTRIES is used.
+/// @param max_bytes Max texture VRAM used by all materials of the cache. If it
+///                  is 0, NEA_DEFAULT_RICH_TEXT_CACHE_BYTES is used.
+/// @return Returns 1 on success, 0 on failure.
+int NEA_RichTextCacheStart(int max_entries, size_t max_bytes);
+
+/// Deletes all materials of the cache and frees the memory used by it.
+void NEA_RichTextCacheEnd(void);
+
+/// Deletes all materials of the cache.
+void NEA_RichTextCacheClear(void);
+
+/// Returns the texture VRAM used by the materials of the cache.
+///
+/// @return Size in bytes.
+size_t NEA_RichTextCacheGetUsedBytes(void);
+
+/// Render a string to a material, or get it from the cache if it has been
+/// rendered recently.
+///
+/// This works like NEA_RichTextRenderMaterial(), but the materials are kept in
+/// a cache (see NEA_RichTextCacheStart()). Asking for the same string with the
+/// same font slot again returns the same material without rendering it again.
+/// When the cache is full or its VRAM budget would be exceeded, the strings
+/// that haven't been requested for the longest time are deleted.
+///
+/// The material belongs to the cache, so it must not be deleted by the caller.
+/// It stays valid until it is evicted, so don't keep the pointer: ask for the
+/// string again every time it is going to be drawn. Palettes are deleted
+/// together with their materials.
+///
+/// All materials that were rendered with a font slot are deleted when the slot
+/// is cleared with NEA_RichTextEnd().
+///
+/// @param slot The font slot to use.
+/// @param str The string to print.
+/// @param mat A pointer to a NEA_Material to store the material.
+/// @return Returns 1 on success, 0 on failure.
+int NEA_RichTextRenderMaterialCached(u32 slot, const char *str,
+                                     NEA_Material **mat);
+
 /// Retrieve internal bitmap font state for a rich text slot.
 ///
 /// Used by NEA_Hw2DTextRender() to access font data for bitmap BG rendering.
@@ -43,7 +43,9 @@ typedef struct NEA_RigidBody_ {
     int32_t rotation[9];   ///< Last known 3x3 rotation matrix (row-major, f32).
     bool sleeping;         ///< True if ARM7 has put this body to sleep.
 
-    int32_t half_extents[3]; ///< OBB half-extents (f32), cached for collision bridge.
+    NEA_RB_Shape shape;    ///< Shape of the body.
+    int32_t half_extents[3]; ///< Half-extents of the box that contains the
+                             ///< body (f32), cached for collision bridge.
 } NEA_RigidBody;
 
 // =========================================================================
@@ -63,11 +65,44 @@ void NEA_RigidBodyEnd(void);
 
 /// Synchronize rigid body state from ARM7.
 ///
-/// Reads position and rotation updates sent by ARM7 via FIFO and updates
-/// the linked NEA_Model transforms. Call this once per frame, typically
-/// before rendering.
+/// Reads the latest positions and rotations that the ARM7 has written to the
+/// shared state block and updates the linked NEA_Model transforms. The ARM7
+/// only announces each frame with one FIFO value, and frames that haven't been
+/// read before the next one is ready are skipped. Call this once per frame,
+/// typically before rendering.
+///
+/// The other functions of this module don't talk to the ARM7 right away. They
+/// write their commands to a ring in shared memory, and this function hands
+/// all of them to the ARM7 at once, which runs them at the start of its next
+/// step. If the ring fills up during the frame, it is handed over early.
 void NEA_RigidBodySync(void);
 
+/// Enable or disable the interpolation of the transforms of linked models.
+///
+/// The ARM7 simulates at its own rate, so without interpolation models jump
+/// to each new frame when it arrives, and motion stutters if the two CPUs
+/// drift or the game renders at a different rate. With interpolation,
+/// NEA_RigidBodySync() keeps the last two frames of each body. Models are
+/// placed between them, based on the time since the latest frame arrived.
+/// They are always one frame late, but they move smoothly.
+///
+/// The time is measured with the VCOUNT register and the vertical blanks
+/// counted by NEA_VBLFunc(), so it must be the VBL interrupt handler.
+///
+/// NEA_RigidBodyGetPosition() still returns the latest simulated position.
+///
+/// @param enable True to interpolate, false to use the latest frame.
+void NEA_RigidBodySetInterpolation(bool enable);
+
+/// Returns the interpolation factor used by NEA_RigidBodySync().
+///
+/// It goes from 0 when a frame arrives to 1 when the time between the last
+/// two frames has passed. Games can use it to interpolate other objects
+/// driven by rigid bodies.
+///
+/// @return Factor between 0 and 1 (f32). It is 1 without interpolation.
+int32_t NEA_RigidBodyGetAlpha(void);
+
 // =========================================================================
 // Body creation / destruction
 // =========================================================================
@@ -90,6 +125,38 @@ NEA_RigidBody *NEA_RigidBodyCreateI(int32_t mass,
     NEA_RigidBodyCreateI(floattof32(mass), \
                           floattof32(hx), floattof32(hy), floattof32(hz))
 
+/// Create a rigid body (sphere shape).
+///
+/// Spheres and capsules are much cheaper to collide than boxes on the ARM7.
+/// See NEA_RigidBodyCreateI() for the initial state of the body.
+///
+/// @param mass Mass (f32). Must be > 0 for dynamic bodies.
+/// @param radius Radius (f32).
+/// @return Pointer to the rigid body proxy, or NULL if no slots available.
+NEA_RigidBody *NEA_RigidBodyCreateSphereI(int32_t mass, int32_t radius);
+
+/// Create a rigid body (sphere shape, float parameters).
+#define NEA_RigidBodyCreateSphere(mass, radius) \
+    NEA_RigidBodyCreateSphereI(floattof32(mass), floattof32(radius))
+
+/// Create a rigid body (capsule shape).
+///
+/// The capsule is a segment from (0, -half_height, 0) to (0, half_height, 0)
+/// in the local space of the body swept by a sphere, like NEA_ColCapsule.
+/// See NEA_RigidBodyCreateI() for the initial state of the body.
+///
+/// @param mass Mass (f32). Must be > 0 for dynamic bodies.
+/// @param radius Radius (f32).
+/// @param half_height Half the length of the segment (f32).
+/// @return Pointer to the rigid body proxy, or NULL if no slots available.
+NEA_RigidBody *NEA_RigidBodyCreateCapsuleI(int32_t mass, int32_t radius,
+                                            int32_t half_height);
+
+/// Create a rigid body (capsule shape, float parameters).
+#define NEA_RigidBodyCreateCapsule(mass, radius, half_height) \
+    NEA_RigidBodyCreateCapsuleI(floattof32(mass), floattof32(radius), \
+                                floattof32(half_height))
+
 /// Delete a rigid body.
 ///
 /// @param rb Pointer to the rigid body proxy.
@@ -182,6 +249,41 @@ void NEA_RigidBodySetGravityI(int32_t g);
 #define NEA_RigidBodySetGravity(g) \
     NEA_RigidBodySetGravityI(floattof32(g))
 
+/// Set the ARM7 time budget of the simulation of one frame.
+///
+/// The ARM7 runs between 1 and 8 sub-steps per frame, depending on how fast
+/// the bodies move and whether they are touching something. When sleeping
+/// bodies are the only ones left it runs no sub-steps. With a budget it
+/// never runs more sub-steps than it estimates that fit in it, and it skips
+/// bisections that would go over it.
+///
+/// A frame at 60 FPS lasts about 560000 cycles of the ARM7.
+///
+/// @param cycles ARM7 cycles (33.51 MHz), or 0 for no limit (default).
+void NEA_RigidBodySetStepBudget(u32 cycles);
+
+/// Returns the number of sub-steps run by the ARM7 in the latest frame.
+///
+/// Sub-steps repeated with a smaller time step by bisections are included.
+///
+/// @return Number of sub-steps.
+int NEA_RigidBodyGetSubsteps(void);
+
+/// Returns the ARM7 cycles used by the sub-steps of the latest frame.
+///
+/// @return Number of cycles (33.51 MHz).
+u32 NEA_RigidBodyGetStepCycles(void);
+
+/// Get the profile of the ARM7 in the latest frame.
+///
+/// It has the time spent in each phase of the simulation and reading
+/// commands, the number of narrow phase tests and contacts, and the number of
+/// awake and sleeping bodies. If ipc_cycles is high the ARM9 sends too many
+/// commands. If cycles is high the scene is too busy for the solver.
+///
+/// @param stats Where to store the profile.
+void NEA_RigidBodyGetStats(NEA_RB_Stats *stats);
+
 // =========================================================================
 // Static colliders (walls, floors, ceilings)
 // =========================================================================
@@ -210,6 +312,28 @@ int NEA_RigidBodyAddStaticI(int32_t px, int32_t py, int32_t pz,
 /// Remove a static collider by ID.
 void NEA_RigidBodyRemoveStatic(int id);
 
+/// Set the triangle mesh collider of the level (f32).
+///
+/// The ARM7 reads the triangles and the BVH of the mesh straight from main RAM
+/// and collides the bodies against them, so there is no need to test the
+/// mesh with NEA_RigidBodyCollideWithI() every frame. There can only be one
+/// mesh, and setting a new one replaces the old one.
+///
+/// The mesh must be static (see NEA_ColMeshSetDynamic()), and its triangles
+/// must not be modified or freed while it is used. This function waits until
+/// the ARM7 stops using the previous mesh, so it can be freed right after
+/// replacing or removing it.
+///
+/// @param mesh Mesh collider, or NULL to remove the current one.
+/// @param x,y,z Position of the mesh (f32).
+/// @return Returns 1 on success, 0 on error.
+int NEA_RigidBodySetMeshI(const NEA_ColMesh *mesh,
+                          int32_t x, int32_t y, int32_t z);
+
+/// Set the triangle mesh collider of the level (float).
+#define NEA_RigidBodySetMesh(mesh, x, y, z) \
+    NEA_RigidBodySetMeshI(mesh, floattof32(x), floattof32(y), floattof32(z))
+
 // =========================================================================
 // Queries
 // =========================================================================
@@ -226,8 +350,8 @@ bool NEA_RigidBodyIsSleeping(const NEA_RigidBody *rb);
 
 /// Test a rigid body against a NEA collision shape and inject contacts.
 ///
-/// Constructs an AABB from the rigid body's position and half-extents,
-/// tests it against the given collision shape using NEA_ColTest(), and
+/// Constructs an AABB, sphere or capsule from the rigid body's position and
+/// half-extents (without its rotation), tests it against the given collision shape using NEA_ColTest(), and
 /// sends any resulting contact to ARM7 via FIFO for impulse resolution.
 ///
 /// Call this once per frame for each (rigid body, shape) pair you want
@@ -11,9 +11,9 @@
 /// @brief  Scene management system with node hierarchy, tags, and triggers.
 ///
 /// Provides a parent-children node tree for organizing 3D scenes. Nodes can
-/// be meshes, cameras, triggers (collision zones with callbacks), or empties
-/// (transform groups). Scenes are loaded from binary .neascene files exported
-/// from Blender.
+/// be meshes, cameras, triggers (collision zones with callbacks), empties
+/// (transform groups), or rooms and portals for indoor visibility. Scenes are
+/// loaded from binary .neascene files exported from Blender.
 ///
 /// Each node can carry up to 3 string tags for grouping/querying and a
 /// user_data pointer for attaching game-specific state.
@@ -31,6 +31,24 @@
 /// pointers. Scenes are loaded from binary .neascene files and automatically
 /// create/manage NEA_Model and NEA_Camera objects.
 ///
+/// Indoor levels can be split into rooms. A room node is a box that groups the
+/// nodes of one area as its children, and a portal node is a box (usually a
+/// doorway or a window) that joins two rooms. When the scene is drawn, the
+/// room that contains the active camera is drawn, as well as all rooms that can
+/// be seen through portals that are on screen. The screen rectangle of each
+/// portal limits what can be seen through the portals behind it. Nodes that
+/// aren't inside any room are always drawn. Hidden portals (see
+/// NEA_SceneNodeSetVisible()) behave like closed doors.
+///
+/// Big worlds can be split into sectors. A sector node references another
+/// .neascene file, which is loaded when the camera (or a node chosen with
+/// NEA_SceneStreamSetTarget()) gets closer to the sector node than its load
+/// radius, and freed when it goes farther than its unload radius. See
+/// NEA_SceneStreamUpdate(). The nodes of sectors use world coordinates, the
+/// sector node only sets the center used to measure distances. Loaded sectors
+/// are updated, drawn and tested for triggers with the scene that contains
+/// them.
+///
 /// @{
 
 // =========================================================================
@@ -38,13 +56,15 @@
 // =========================================================================
 
 #define NEA_SCENE_MAGIC          0x4E53434E  ///< "NSCN" little-endian.
-#define NEA_SCENE_VERSION        1           ///< Current .neascene version.
+#define NEA_SCENE_VERSION        3           ///< Current .neascene version.
+#define NEA_SCENE_NODE_SIZE      232         ///< Size of nodes in versions 2-3.
 #define NEA_DEFAULT_SCENE_NODES  64          ///< Default max nodes per scene.
 #define NEA_NODE_TAG_LEN         16          ///< Max tag length (15 + null).
 #define NEA_NODE_NAME_LEN        24          ///< Max node name length (23 + null).
 #define NEA_NODE_MAX_TAGS        6           ///< Max tags per node.
 #define NEA_SCENE_MAX_ASSETS     256         ///< Max asset references per scene.
 #define NEA_SCENE_MAX_MATERIALS  128         ///< Max material references per scene.
+#define NEA_SCENE_MAX_PORTAL_DEPTH 8         ///< Max rooms in a chain of portals.
 
 // =========================================================================
 // Enums
@@ -56,6 +76,9 @@ typedef enum {
     NEA_NODE_MESH    = 1, ///< Renderable mesh (static or animated).
     NEA_NODE_CAMERA  = 2, ///< Camera node.
     NEA_NODE_TRIGGER = 3, ///< Collision zone with enter/exit/tick callbacks.
+    NEA_NODE_ROOM    = 4, ///< Box that groups the nodes of an indoor area.
+    NEA_NODE_PORTAL  = 5, ///< Box that joins two rooms.
+    NEA_NODE_SECTOR  = 6, ///< Scene loaded and freed by distance.
 } NEA_NodeType;
 
 /// Trigger event types for callbacks.
@@ -87,6 +110,19 @@ typedef void (*NEA_TriggerCallback)(NEA_SceneNode *trigger,
 /// @param arg   User data passed to NEA_SceneForEachTag().
 typedef void (*NEA_NodeVisitor)(NEA_SceneNode *node, void *arg);
 
+/// Forward declaration.
+typedef struct NEA_Scene_ NEA_Scene;
+
+/// Sector callback function signature.
+///
+/// @param sector  The sector node.
+/// @param scene   Scene of the sector.
+/// @param loaded  True if the scene has just been loaded, false if it is
+///                going to be freed.
+/// @param arg     Argument passed to NEA_SceneStreamSetCallback().
+typedef void (*NEA_SectorCallback)(NEA_SceneNode *sector, NEA_Scene *scene,
+                                   bool loaded, void *arg);
+
 // =========================================================================
 // Trigger data
 // =========================================================================
@@ -108,6 +144,9 @@ typedef struct {
 /// Nodes form a left-child right-sibling tree. Each node has a local
 /// transform (position, rotation, scale) and optionally references an
 /// NEA_Model or NEA_Camera created during scene loading.
+///
+/// Version 2 and 3 .neascene files store nodes with the layout of this struct,
+/// so the order of the fields must not change (see NEA_SCENE_NODE_SIZE).
 struct NEA_SceneNode_ {
     // --- Hierarchy (left-child right-sibling tree) ---
     NEA_SceneNode *parent;       ///< Parent node (NULL for root).
@@ -117,17 +156,19 @@ struct NEA_SceneNode_ {
     // --- Identity ---
     char          name[NEA_NODE_NAME_LEN]; ///< Unique node name.
     char          tags[NEA_NODE_MAX_TAGS][NEA_NODE_TAG_LEN]; ///< Tag strings.
-    uint8_t       num_tags;      ///< Number of active tags (0-3).
+    uint8_t       num_tags;      ///< Number of active tags (0-6).
+    bool          visible;       ///< If false, skip draw for this subtree.
+    bool          room_visible;  ///< Room nodes: drawn in the last draw call.
+    uint8_t       dirty;         ///< Transform and activity flags (internal).
     NEA_NodeType  type;          ///< Node type.
 
     // --- Local transform (same conventions as NEA_Model) ---
     int32_t  x, y, z;           ///< Local position (f32 fixed-point).
     int      rx, ry, rz;        ///< Local rotation (0-511).
     int32_t  sx, sy, sz;        ///< Local scale (f32, default = inttof32(1)).
-    bool     visible;           ///< If false, skip draw for this subtree.
 
     // --- World position (computed by NEA_SceneUpdate) ---
-    int32_t  wx, wy, wz;       ///< World position (f32, accumulated from parents).
+    int32_t  wx, wy, wz;       ///< World position (f32, transformed by parents).
 
     // --- Type-specific file references ---
     union {
@@ -135,11 +176,28 @@ struct NEA_SceneNode_ {
             uint16_t asset_index;    ///< Index into scene asset table.
             uint16_t material_index; ///< Index into scene material table (0xFFFF = none).
             uint8_t  is_animated;    ///< 1 = animated, 0 = static.
+            uint8_t  is_static;      ///< 1 = never moves (see
+                                     ///< NEA_SceneBatchStatic()), 2 = merged
+                                     ///< into a batch, 0 = regular node.
         } mesh;
         struct {
             int32_t  to[3];  ///< Look-at target (f32).
             int32_t  up[3];  ///< Up vector (f32).
         } cam;
+        struct {
+            int32_t  half[3]; ///< Half extents of the room box (f32).
+        } room;
+        struct {
+            int32_t  half[3]; ///< Half extents of the portal box (f32).
+            uint8_t  room_a;  ///< Node index of one of the rooms (0xFF = none).
+            uint8_t  room_b;  ///< Node index of the other room (0xFF = none).
+        } portal;
+        struct {
+            uint16_t asset_index;   ///< Index of the .neascene file in the asset table.
+            uint16_t slot;          ///< Index in the list of sectors (set on load).
+            int32_t  load_radius;   ///< Distance at which it is loaded (f32).
+            int32_t  unload_radius; ///< Distance at which it is freed (f32).
+        } sector;
     } ref;
 
     NEA_TriggerData *trigger;    ///< Non-NULL only for NEA_NODE_TRIGGER.
@@ -162,9 +220,9 @@ struct NEA_SceneNode_ {
 /// Asset entry loaded from the scene file.
 typedef struct {
     char     path[48];  ///< Filesystem path (e.g. "nitro:/level/wall.bin").
-    uint8_t  type;      ///< 0=static, 1=dsm, 2=dsa, 3=colmesh, 4=boncol.
+    uint8_t  type;      ///< 0=static, 1=dsm, 2=dsa, 3=colmesh, 4=boncol, 5=scene.
     bool     loaded;    ///< True if data is loaded into RAM.
-    void    *data;      ///< Runtime pointer to loaded data.
+    void    *data;      ///< Loaded data (NEA_ColMesh for colmesh assets).
 } NEA_SceneAsset;
 
 /// Material reference in the scene file.
@@ -173,12 +231,35 @@ typedef struct {
     char tex_path[48];  ///< Texture file path (or empty for manual bind).
 } NEA_SceneMaterialRef;
 
+/// Bounding sphere of a scene node and all its children.
+///
+/// It is also used for the local bounds of nodes stored in version 3 files. In
+/// that case the center is in the space of the node, and the radius is
+/// negative if the node has no bounds.
+typedef struct {
+    int32_t center[3]; ///< Center in world space (f32).
+    int32_t radius;    ///< Radius (f32), negative if there is nothing to draw.
+} NEA_SceneBounds;
+
 // =========================================================================
 // Scene
 // =========================================================================
 
-/// A loaded scene containing a node hierarchy and asset references.
+/// Static geometry of a scene merged by NEA_SceneBatchStatic().
 typedef struct {
+    NEA_Model     *model; ///< Model with one submesh per material.
+    NEA_SceneNode *room;  ///< Room of the nodes, or NULL if they aren't in one.
+} NEA_SceneBatch;
+
+/// Sector of a scene.
+typedef struct {
+    NEA_SceneNode *node;  ///< Sector node.
+    NEA_Scene     *scene; ///< Scene of the sector, or NULL if it isn't loaded.
+    bool           failed; ///< The scene couldn't be loaded.
+} NEA_SceneSector;
+
+/// A loaded scene containing a node hierarchy and asset references.
+struct NEA_Scene_ {
     NEA_SceneNode *nodes;          ///< Flat array of all nodes.
     int            num_nodes;      ///< Number of nodes in the scene.
     NEA_SceneNode *root;           ///< Root node (nodes[0]).
@@ -191,8 +272,33 @@ typedef struct {
 
     NEA_Material *materials[NEA_SCENE_MAX_MATERIALS]; ///< Auto-loaded materials.
 
+    void            *blob;         ///< Version 2-3 file that holds the nodes.
+    void            *arena;        ///< Block with the tables of the nodes.
+    NEA_TriggerData *triggers;     ///< Trigger data of all nodes, in the arena.
+    m4x3            *world;        ///< World matrix of each node.
+    NEA_SceneBounds *bounds;       ///< Bounds of the subtree of each node.
+    const NEA_SceneBounds *local_bounds; ///< Bounds of the file, or NULL.
+
+    NEA_SceneNode **portals;       ///< Portal nodes (NULL if there are none).
+    int             num_portals;   ///< Number of portal nodes.
+    int             num_rooms;     ///< Number of room nodes.
+    NEA_SceneNode  *camera_room;   ///< Room of the camera in the last draw call.
+    bool            portal_culling; ///< If true, only visible rooms are drawn.
+
+    void *trigger_grid; ///< Spatial index of triggers (internal).
+    void *lookup;       ///< Hash tables of names and tags (internal).
+
+    NEA_SceneSector *sectors;      ///< Sectors (NULL if there are none).
+    int              num_sectors;  ///< Number of sector nodes.
+    const NEA_SceneNode *stream_target; ///< Node tracked by the streaming.
+    NEA_SectorCallback sector_callback; ///< Called when sectors change.
+    void              *sector_callback_arg; ///< Argument of the callback.
+
+    NEA_SceneBatch *batches;       ///< Static batches (NULL if there are none).
+    int             num_batches;   ///< Number of static batches.
+
     bool loaded; ///< True if the scene is currently loaded.
-} NEA_Scene;
+};
 
 // =========================================================================
 // System lifecycle
@@ -200,6 +306,10 @@ typedef struct {
 
 /// Reset the scene system. Call during engine initialization.
 ///
+/// There is no pool of nodes shared by all scenes. Each scene allocates one
+/// block for the tables of its nodes, sized from the header of its file, and
+/// the limit is only used to reject invalid files.
+///
 /// @param max_nodes  Per-scene node limit. If < 1, uses
 ///                   NEA_DEFAULT_SCENE_NODES.
 /// @return 0 on success, -1 on failure.
@@ -217,12 +327,48 @@ void NEA_SceneSystemEnd(void);
 /// Creates NEA_Model and NEA_Camera objects for mesh and camera nodes.
 /// Assets referenced by the scene must be loadable from the filesystem.
 ///
+/// Static mesh nodes are merged with NEA_SceneBatchStatic() once their meshes
+/// and materials are ready.
+///
+/// Meshes and textures are loaded through the asset cache (see
+/// NEA_CacheLoadMesh()), so they are shared with other scenes that use them.
+///
+/// The nodes of version 2 and 3 files are used in place in the buffer of the
+/// file, so loading them doesn't need any allocation per node.
+///
 /// @param path  Path to the .neascene file.
 /// @return Pointer to the loaded scene, or NULL on error.
 NEA_Scene *NEA_SceneLoadFAT(const char *path);
 
+/// Load a scene from a .neascene file on NitroFS/FAT in the background.
+///
+/// The scene file itself is loaded right away, and all its nodes are created.
+/// The meshes and GRF textures are added to the background loader (see
+/// NEA_LoaderUpdate()), and they are assigned to their models and materials
+/// as they are loaded. Models are drawn without mesh until then.
+///
+/// Collision meshes are added with NEA_LoaderAddColMesh(), so their triangles
+/// are converted in steps too. They are in the cache from the start, and they
+/// only collide with the triangles that have been converted until they are
+/// complete.
+///
+/// The scene can be freed before all assets have been loaded.
+///
+/// Static mesh nodes are merged with NEA_SceneBatchStatic() when the last of
+/// their meshes has been loaded.
+///
+/// @param path  Path to the .neascene file.
+/// @return Pointer to the loaded scene, or NULL on error.
+NEA_Scene *NEA_SceneLoadFATAsync(const char *path);
+
 /// Load a scene from a .neascene binary already in RAM.
 ///
+/// The data isn't used after this call, so it can be freed. The nodes of
+/// version 2 and 3 files are copied in a single block.
+///
+/// Materials aren't loaded, so static nodes aren't merged. Call
+/// NEA_SceneBatchStatic() after assigning materials to the models.
+///
 /// @param data  Pointer to the binary data.
 /// @param size  Size of the data in bytes.
 /// @return Pointer to the loaded scene, or NULL on error.
@@ -230,11 +376,42 @@ NEA_Scene *NEA_SceneLoad(const void *data, size_t size);
 
 /// Free a scene and all its engine objects (models, cameras, triggers).
 ///
+/// Loaded sectors are freed too.
+///
+/// Meshes and textures are released, and they are only deleted if no other
+/// scene uses them.
+///
 /// Does NOT free user_data on nodes -- the game must clean that up first.
 ///
 /// @param scene  Pointer to the scene.
 void NEA_SceneFree(NEA_Scene *scene);
 
+/// Merge the static mesh nodes of a scene into a few multi-material models.
+///
+/// Mesh nodes marked as static in the .neascene file are drawn with one
+/// NEA_ModelDraw() each, which sets a matrix, a material and a display list
+/// every time. This function bakes the world matrix of each static node into
+/// the vertices and normals of its display list, and joins the lists of all
+/// static nodes that use the same material into one. Each room gets its own
+/// batches, and so do the nodes that aren't inside any room. The time needed
+/// to draw the static geometry then depends on the number of materials, not on
+/// the number of nodes.
+///
+/// Only nodes with a static display list and a material can be merged, and
+/// nodes with an animated material or that are hidden are skipped. Merged
+/// nodes keep their models (to build bounds, for picking, etc), but they
+/// aren't drawn anymore, and changing their transform or visibility has no
+/// effect. Batches are culled as a whole, and they are hidden with their room
+/// or with the parents of the room.
+///
+/// The scene loading functions call this function, so it is only needed if
+/// the materials are assigned after the scene has been loaded. Nodes that have
+/// already been merged are skipped, so it can be called again.
+///
+/// @param scene  Pointer to the scene.
+/// @return Number of nodes merged, or -1 if there isn't enough memory.
+int NEA_SceneBatchStatic(NEA_Scene *scene);
+
 // =========================================================================
 // Node access
 // =========================================================================
@@ -245,7 +422,11 @@ void NEA_SceneFree(NEA_Scene *scene);
 /// @return Root node, or NULL if scene is empty.
 NEA_SceneNode *NEA_SceneGetRoot(const NEA_Scene *scene);
 
-/// Find a node by name (linear search, O(n)).
+/// Find a node by name.
+///
+/// Names and tags are added to hash tables when the scene is loaded, so the
+/// search doesn't look at all the nodes. Changes to the names and tags of nodes
+/// after the scene is loaded aren't seen by the searches.
 ///
 /// @param scene  Pointer to the scene.
 /// @param name   Node name to search for.
@@ -322,12 +503,71 @@ void NEA_SceneNodeSetCoordI(NEA_SceneNode *node,
 /// @param rz    Z rotation (0-511).
 void NEA_SceneNodeSetRot(NEA_SceneNode *node, int rx, int ry, int rz);
 
+/// Set a node's local scale (f32 fixed-point).
+///
+/// @param node  Pointer to the node.
+/// @param sx    X scale (f32).
+/// @param sy    Y scale (f32).
+/// @param sz    Z scale (f32).
+void NEA_SceneNodeSetScaleI(NEA_SceneNode *node,
+                             int32_t sx, int32_t sy, int32_t sz);
+
+/// Set a node's local scale (float).
+///
+/// @param n  Pointer to the node.
+/// @param x  X scale (float).
+/// @param y  Y scale (float).
+/// @param z  Z scale (float).
+#define NEA_SceneNodeSetScale(n, x, y, z) \
+    NEA_SceneNodeSetScaleI(n, floattof32(x), floattof32(y), floattof32(z))
+
+/// Tell the scene that the local transform of a node has changed.
+///
+/// The setters of position, rotation and scale call this function. Call it
+/// after modifying the fields of the node directly, or NEA_SceneUpdate() won't
+/// see the change. Call it too after changing the mesh or the bounding sphere
+/// of the model of a node, so that the bounds of the node are built again.
+///
+/// @param node  Pointer to the node.
+void NEA_SceneNodeTransformChanged(NEA_SceneNode *node);
+
 /// Set a node's visibility. Hidden nodes and their children are not drawn.
 ///
 /// @param node     Pointer to the node.
 /// @param visible  True to show, false to hide.
 void NEA_SceneNodeSetVisible(NEA_SceneNode *node, bool visible);
 
+/// Enable or disable a branch of the scene.
+///
+/// Inactive nodes and their children are skipped by NEA_SceneUpdate(),
+/// NEA_SceneTestTriggers() and the draw functions, and the scenes of their
+/// sectors aren't updated or tested either. Use it for the parts of a level
+/// that can't be reached at the moment, like closed rooms or disabled zones.
+///
+/// The transforms of the branch aren't updated while it's inactive. They are
+/// updated by the first call to NEA_SceneUpdate() after enabling it again.
+/// Triggers keep their state, and they don't get any event while they are
+/// inactive.
+///
+/// @param node   Pointer to the node.
+/// @param active True to enable the branch, false to disable it.
+void NEA_SceneNodeSetActive(NEA_SceneNode *node, bool active);
+
+/// Freeze or unfreeze a branch of the scene.
+///
+/// Frozen branches are like inactive branches (see NEA_SceneNodeSetActive()),
+/// but they are still drawn with the last transforms they had.
+///
+/// @param node   Pointer to the node.
+/// @param frozen True to freeze the branch, false to unfreeze it.
+void NEA_SceneNodeSetFrozen(NEA_SceneNode *node, bool frozen);
+
+/// Returns true if a node is inactive or frozen, or if any of its parents is.
+///
+/// @param node Pointer to the node.
+/// @return True if the node isn't updated or tested.
+bool NEA_SceneNodeIsDormant(const NEA_SceneNode *node);
+
 /// Set user data on a node.
 ///
 /// @param node  Pointer to the node.
@@ -349,6 +589,16 @@ void *NEA_SceneNodeGetUserData(const NEA_SceneNode *node);
 /// Propagates transforms through the hierarchy and syncs NEA_Model and
 /// NEA_Camera positions from their corresponding nodes. Call once per frame.
 ///
+/// The world matrix of each node is the local transform of the node combined
+/// with the world matrix of its parent, so the rotation and scale of parents
+/// also apply to their children. Matrices are cached: only nodes whose
+/// transform has changed since the last call (see
+/// NEA_SceneNodeTransformChanged()) and their children are computed again, and
+/// subtrees without changes aren't visited.
+///
+/// The world matrix of mesh nodes is assigned to their models with
+/// NEA_ModelSetMatrix().
+///
 /// @param scene  Pointer to the scene.
 void NEA_SceneUpdate(NEA_Scene *scene);
 
@@ -357,6 +607,16 @@ void NEA_SceneUpdate(NEA_Scene *scene);
 /// Calls trigger callbacks (enter/exit/tick) as appropriate. Call after
 /// NEA_SceneUpdate so that trigger world positions are up to date.
 ///
+/// Triggers are sorted in a grid over the X and Z axes when the scene is
+/// loaded, so only the triggers close to the shape are tested. Triggers that
+/// are moved are updated in the grid by NEA_SceneUpdate(). Triggers that have
+/// something inside and are too far from the shape get an exit event without
+/// being tested.
+///
+/// Version 3 files can have a tree of boxes around the triggers. It is used
+/// instead of the grid until a trigger is moved, or the grid is built again
+/// with NEA_SceneRebuildTriggerGrid().
+///
 /// @param scene      Pointer to the scene.
 /// @param shape      Collision shape to test against triggers.
 /// @param pos        World position of the test shape (f32).
@@ -364,16 +624,111 @@ void NEA_SceneUpdate(NEA_Scene *scene);
 void NEA_SceneTestTriggers(NEA_Scene *scene, const NEA_ColShape *shape,
                            NEA_Vec3 pos, void *user_data);
 
+/// Sort the triggers of a scene in its grid again.
+///
+/// The grid is built when the scene is loaded. The size of its cells depends
+/// on the size of the triggers, so call this function after changing the
+/// shape of a trigger. It isn't needed after moving triggers.
+///
+/// @param scene  Pointer to the scene.
+void NEA_SceneRebuildTriggerGrid(NEA_Scene *scene);
+
+/// Enable or disable portal visibility of a scene.
+///
+/// It is enabled by default. When it is disabled, all rooms are drawn.
+///
+/// @param scene   Pointer to the scene.
+/// @param enable  True to draw only the rooms that can be seen.
+void NEA_ScenePortalCulling(NEA_Scene *scene, bool enable);
+
+/// Get the room that contained the active camera in the last draw call.
+///
+/// @param scene  Pointer to the scene.
+/// @return Room node, or NULL if the camera wasn't inside any room (in that
+///         case all rooms are drawn).
+NEA_SceneNode *NEA_SceneGetCameraRoom(const NEA_Scene *scene);
+
+/// Check if a room was drawn in the last draw call.
+///
+/// @param room  Pointer to a room node.
+/// @return True if the room was visible.
+bool NEA_SceneRoomIsVisible(const NEA_SceneNode *room);
+
 /// Draw the entire scene.
 ///
 /// Activates the active camera, then traverses the node tree depth-first,
-/// drawing all visible mesh nodes. Designed to be used with NEA_ProcessArg():
+/// drawing all visible mesh nodes. Rooms that can't be seen from the room of
+/// the camera are skipped. Designed to be used with NEA_ProcessArg():
 ///
 ///     NEA_ProcessArg(NEA_SceneDraw, scene);
 ///
+/// NEA_SceneUpdate() builds a bounding sphere for each node that contains the
+/// models of the node and all its children. If frustum culling is enabled (see
+/// NEA_ModelFrustumCulling()), subtrees whose sphere isn't in the view frustum
+/// are skipped with one test. Subtrees without models are always skipped.
+///
+/// Version 3 files can store the bounds of each node and of each subtree. The
+/// bounds of the subtrees are used until the nodes change, so they aren't built
+/// when the scene is loaded. The bounds of a node are used when its model has
+/// no bounding sphere or its mesh is still being loaded, and for sector nodes,
+/// which are only culled if they have bounds.
+///
 /// @param arg  Pointer to the NEA_Scene (cast to void* for ProcessArg).
 void NEA_SceneDraw(void *arg);
 
+/// Submit the entire scene to the render queue.
+///
+/// Like NEA_SceneDraw(), but the visible mesh nodes are added to the render
+/// queue instead of being drawn right away, and the active camera is set as
+/// the camera of the queue. The queue is sorted and drawn when NEA_Process()
+/// or NEA_ProcessTwoPass() flush it:
+///
+///     NEA_ProcessArg(NEA_SceneDrawQueued, scene);
+///
+/// @param arg  Pointer to the NEA_Scene (cast to void* for ProcessArg).
+void NEA_SceneDrawQueued(void *arg);
+
+// =========================================================================
+// Sector streaming
+// =========================================================================
+
+/// Set the node whose position decides which sectors are loaded.
+///
+/// @param scene  Pointer to the scene.
+/// @param node   Node of the scene, or NULL to use the active camera.
+void NEA_SceneStreamSetTarget(NEA_Scene *scene, const NEA_SceneNode *node);
+
+/// Set a function called when sectors are loaded and before they are freed.
+///
+/// It can be used to load and free data of the sectors that the scene doesn't
+/// handle, like collision meshes (see NEA_CacheLoadColMesh()).
+///
+/// @param scene     Pointer to the scene.
+/// @param callback  Function to call, or NULL.
+/// @param arg       Argument passed to the callback.
+void NEA_SceneStreamSetCallback(NEA_Scene *scene, NEA_SectorCallback callback,
+                                void *arg);
+
+/// Load the sectors that are close to the target and free the ones that are
+/// far from it.
+///
+/// Sectors are loaded with NEA_SceneLoadFATAsync(), so their meshes and
+/// textures are read by the background loader. Freed sectors release their
+/// meshes and textures, which are deleted if no other scene uses them. Sectors
+/// of sectors are streamed with the same target. Call it after
+/// NEA_SceneUpdate().
+///
+/// @param scene  Pointer to the scene.
+void NEA_SceneStreamUpdate(NEA_Scene *scene);
+
+/// Get the scene of a sector.
+///
+/// @param scene   Pointer to the scene.
+/// @param sector  Sector node of the scene.
+/// @return Scene of the sector, or NULL if it isn't loaded.
+NEA_Scene *NEA_SceneSectorGetScene(const NEA_Scene *scene,
+                                   const NEA_SceneNode *sector);
+
 /// @}
 
 #endif // NEA_SCENE_H__
@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_SHADOWVOLUME_H__
+#define NEA_SHADOWVOLUME_H__
+
+#include <nds.h>
+
+#include "NEACollision.h"
+#include "NEAModel.h"
+
+/// @file   NEAShadowVolume.h
+/// @brief  Cached shadow volumes for directional lights.
+
+/// @defgroup shadow_volume Shadow volumes
+///
+/// The GPU can draw volumetric shadows with shadow polygons: the volume is
+/// drawn once with polygon ID 0 to build a mask, and again with a different
+/// polygon ID to darken the pixels of the mask (see the example
+/// "effects/volumetric_shadow").
+///
+/// A shadow volume object generates the volume of a static mesh. The edges
+/// that are shared by two triangles are found once when the object is
+/// created. The volume is the front cap (the triangles that face the light),
+/// the same triangles moved along the light direction (the back cap) and a
+/// quad for each silhouette edge. It is compiled to a display list that is
+/// only built again when the direction of the light changes in the space of
+/// the object, which happens when the light or the object rotate, or when the
+/// scale of the object changes. Small changes are ignored, so the list of a
+/// caster that doesn't move is never rebuilt, and the CPU cost of having many
+/// casters is just sending their lists.
+///
+/// The mesh must be closed (every edge shared by two triangles) for the
+/// volume to be closed. Open edges are extruded if their triangle faces the
+/// light, which is good enough for meshes with small holes.
+///
+/// @{
+
+/// Value of NEA_ShadowEdge.face if the edge only has one triangle.
+#define NEA_SHADOW_NO_FACE 0xFFFF
+
+/// Default length of the extrusion (f32, world units).
+#define NEA_SHADOW_DEFAULT_EXTRUSION inttof32(8)
+
+/// Default threshold of NEA_ShadowVolumeSetThreshold() (f32).
+#define NEA_SHADOW_DEFAULT_THRESHOLD floattof32(0.02)
+
+/// Edge of a shadow volume mesh.
+typedef struct {
+    uint16_t v[2];    ///< Vertices of the edge.
+    uint16_t face[2]; ///< Triangles that share the edge, or NEA_SHADOW_NO_FACE.
+} NEA_ShadowEdge;
+
+/// Holds information of a shadow volume.
+typedef struct {
+    int num_vertices;        ///< Number of vertices (after merging duplicates)
+    NEA_Vec3 *vertices;      ///< Vertices in model space (f32)
+    int num_triangles;       ///< Number of triangles
+    uint16_t *triangles;     ///< Vertex indices, 3 per triangle
+    NEA_Vec3 *normals;       ///< Normal of each triangle (not normalized)
+    int num_edges;           ///< Number of edges
+    NEA_ShadowEdge *edges;   ///< Edges of the mesh
+    uint8_t *lit;            ///< Triangles that faced the light in the list
+    uint32_t *list;          ///< Display list of the volume
+    size_t capacity;         ///< Size of the display list buffer in words
+    int32_t extrusion;       ///< Length of the extrusion (f32, world units)
+    int32_t threshold;       ///< Change that rebuilds the list (f32)
+    int32_t max_coord;       ///< Largest absolute coordinate of the mesh (f32)
+    NEA_Vec3 extrude;        ///< Extrusion of the list in model space (f32)
+    bool valid;              ///< The display list is up to date
+    u32 rebuilds;            ///< Number of times the list has been built
+} NEA_ShadowVolume;
+
+/// Creates a shadow volume from a list of triangles.
+///
+/// Vertices with the same coordinates are merged, so meshes with vertices
+/// duplicated because of their texture coordinates or normals are fine.
+///
+/// @param vertices Coordinates of the vertices (f32).
+/// @param num_vertices Number of vertices.
+/// @param indices Vertex indices, 3 per triangle.
+/// @param num_triangles Number of triangles (max 65534).
+/// @return Pointer to the shadow volume, or NULL on error.
+NEA_ShadowVolume *NEA_ShadowVolumeCreate(const NEA_Vec3 *vertices,
+                                         int num_vertices,
+                                         const uint16_t *indices,
+                                         int num_triangles);
+
+/// Creates a shadow volume from the triangles of a static display list.
+///
+/// This accepts the meshes used by NEA_ModelLoadStaticMesh(), like the ones
+/// generated by obj2dl. All vertex commands and primitive types are supported.
+/// Matrix commands are ignored, so the list must be drawn with one matrix.
+///
+/// @param list Pointer to the display list.
+/// @return Pointer to the shadow volume, or NULL on error.
+NEA_ShadowVolume *NEA_ShadowVolumeCreateFromList(const void *list);
+
+/// Creates a shadow volume from the local-space triangles of a ColMesh.
+///
+/// The ColMesh isn't needed after this call.
+///
+/// @param mesh Pointer to the ColMesh.
+/// @return Pointer to the shadow volume, or NULL on error.
+NEA_ShadowVolume *NEA_ShadowVolumeCreateFromColMesh(const NEA_ColMesh *mesh);
+
+/// Deletes a shadow volume.
+///
+/// @param vol Pointer to the shadow volume.
+void NEA_ShadowVolumeDelete(NEA_ShadowVolume *vol);
+
+/// Sets the length of the extrusion of a shadow volume.
+///
+/// It needs to be long enough for the volume to go through the surfaces that
+/// receive the shadow. Shorter volumes cover fewer pixels, which is faster.
+/// The display list is built again in the next update.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param length Length in world units (f32).
+void NEA_ShadowVolumeSetExtrusionI(NEA_ShadowVolume *vol, int32_t length);
+
+/// Sets the length of the extrusion of a shadow volume.
+///
+/// @param v Pointer to the shadow volume.
+/// @param l Length in world units (float).
+#define NEA_ShadowVolumeSetExtrusion(v, l) \
+    NEA_ShadowVolumeSetExtrusionI(v, floattof32(l))
+
+/// Sets how much the light has to change before the volume is built again.
+///
+/// The list is built again when the extrusion vector in model space changes
+/// by more than this fraction of its length. For rotations, this is roughly
+/// the angle in radians. Use 0 to build the list whenever anything changes.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param threshold Threshold (f32).
+void NEA_ShadowVolumeSetThreshold(NEA_ShadowVolume *vol, int32_t threshold);
+
+/// Updates a shadow volume for a directional light.
+///
+/// It only builds the display list again if the light direction in the
+/// space of the object has changed more than the threshold, or if this is the
+/// first update. Translations never need a new list.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param mat Transformation of the object, or NULL for the identity.
+/// @param x (x, y, z) Direction in which the light travels (f32).
+/// @param y (x, y, z) Direction in which the light travels (f32).
+/// @param z (x, y, z) Direction in which the light travels (f32).
+/// @return Returns 1 if the list has been built, 0 if it has been reused, -1
+///         on error.
+int NEA_ShadowVolumeUpdateI(NEA_ShadowVolume *vol, const m4x3 *mat,
+                            int32_t x, int32_t y, int32_t z);
+
+/// Updates a shadow volume for a directional light.
+///
+/// @param v Pointer to the shadow volume.
+/// @param m Transformation of the object, or NULL for the identity.
+/// @param x (x, y, z) Direction in which the light travels (float).
+/// @param y (x, y, z) Direction in which the light travels (float).
+/// @param z (x, y, z) Direction in which the light travels (float).
+#define NEA_ShadowVolumeUpdate(v, m, x, y, z) \
+    NEA_ShadowVolumeUpdateI(v, m, floattof32(x), floattof32(y), floattof32(z))
+
+/// Updates a shadow volume using the transformation of a model.
+///
+/// This uses the matrix assigned with NEA_ModelSetMatrix() if there is one,
+/// or the position, rotation and scale of the model.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param model Model that casts the shadow.
+/// @param x (x, y, z) Direction in which the light travels (f32).
+/// @param y (x, y, z) Direction in which the light travels (f32).
+/// @param z (x, y, z) Direction in which the light travels (f32).
+/// @return Returns 1 if the list has been built, 0 if it has been reused, -1
+///         on error.
+int NEA_ShadowVolumeUpdateModelI(NEA_ShadowVolume *vol, NEA_Model *model,
+                                 int32_t x, int32_t y, int32_t z);
+
+/// Updates a shadow volume using the transformation of a model.
+///
+/// @param v Pointer to the shadow volume.
+/// @param m Model that casts the shadow.
+/// @param x (x, y, z) Direction in which the light travels (float).
+/// @param y (x, y, z) Direction in which the light travels (float).
+/// @param z (x, y, z) Direction in which the light travels (float).
+#define NEA_ShadowVolumeUpdateModel(v, m, x, y, z) \
+    NEA_ShadowVolumeUpdateModelI(v, m, floattof32(x), floattof32(y), \
+                                 floattof32(z))
+
+/// Sends the display list of a shadow volume to the GPU.
+///
+/// It uses the current polygon format and color, which is useful to draw the
+/// volume in wireframe mode to see where it is. NEA_ShadowVolumeDraw() does
+/// both passes of shadow polygons.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param mat Transformation of the object, or NULL for the identity.
+void NEA_ShadowVolumeDrawList(const NEA_ShadowVolume *vol, const m4x3 *mat);
+
+/// Sends the display list of a shadow volume using the transformation of a
+/// model.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param model Model that casts the shadow.
+void NEA_ShadowVolumeDrawListModel(const NEA_ShadowVolume *vol,
+                                   NEA_Model *model);
+
+/// Draws the shadow of a shadow volume.
+///
+/// It draws the mask with polygon ID 0, and then the shadow with the given
+/// polygon ID. The shadow isn't drawn on polygons that have the same ID, so
+/// draw the caster with this ID to keep it from shadowing itself. Casters can
+/// share an ID if they don't need to cast shadows on each other. This must be
+/// called after drawing all opaque polygons. The material is set to NULL.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param mat Transformation of the object, or NULL for the identity.
+/// @param color Color of the shadow.
+/// @param alpha Alpha value of the shadow (1 - 30).
+/// @param id Polygon ID of the shadow (1 - 63).
+void NEA_ShadowVolumeDraw(const NEA_ShadowVolume *vol, const m4x3 *mat,
+                          u32 color, u32 alpha, u32 id);
+
+/// Draws the shadow of a shadow volume using the transformation of a model.
+///
+/// @param vol Pointer to the shadow volume.
+/// @param model Model that casts the shadow.
+/// @param color Color of the shadow.
+/// @param alpha Alpha value of the shadow (1 - 30).
+/// @param id Polygon ID of the shadow (1 - 63).
+void NEA_ShadowVolumeDrawModel(const NEA_ShadowVolume *vol, NEA_Model *model,
+                               u32 color, u32 alpha, u32 id);
+
+/// @}
+
+#endif // NEA_SHADOWVOLUME_H__
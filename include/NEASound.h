@@ -34,6 +34,22 @@
 /// @{
 
 #define NEA_DEFAULT_SOUND_SOURCES 32 ///< Default max number of sound sources.
+#define NEA_DEFAULT_SOUND_VOICES   8 ///< Default max number of Maxmod voices.
+#define NEA_SOUND_MAX_VOICES      16 ///< Max number of Maxmod voices.
+#define NEA_DEFAULT_SOUND_PRIORITY 128 ///< Default priority of sources.
+
+/// Attenuation curves of spatial sources.
+///
+/// The curves are tables indexed by the squared distance to the listener, so
+/// that no square root is needed to find the volume of a source.
+typedef enum {
+    /// Volume decreases linearly with the distance (default). It is exact when
+    /// min_dist is 0, and very close to it in other cases.
+    NEA_SOUND_CURVE_LINEAR = 0,
+    /// Volume decreases linearly with the squared distance. Sources stay loud
+    /// for longer and fade out quickly close to max_dist.
+    NEA_SOUND_CURVE_SQUARED = 1,
+} NEA_SoundCurve;
 
 /// Holds information for a spatial sound source.
 typedef struct {
@@ -57,6 +73,15 @@ typedef struct {
 
     mm_byte computed_volume;  ///< Attenuated volume after spatial update.
     mm_byte computed_panning; ///< Spatial panning after spatial update.
+
+    uint8_t priority;         ///< Priority to get a voice (0-255).
+    bool virtual_voice;       ///< True if playing without a Maxmod voice.
+    bool had_voice;           ///< True if it has had a voice since played.
+    mm_byte sent_volume;      ///< Volume last sent to Maxmod.
+    mm_byte sent_panning;     ///< Panning last sent to Maxmod.
+
+    uint8_t atten_shift;      ///< Precomputed from the distance range.
+    uint32_t atten_scale;     ///< Precomputed from the distance range.
 } NEA_SoundSource;
 
 // =========================================================================
@@ -108,13 +133,52 @@ void NEA_SoundSystemEnd(void);
 /// @param cam Pointer to the camera.
 void NEA_SoundSetListener(NEA_Camera *cam);
 
+/// Set the attenuation curve used by all spatial sources.
+///
+/// @param curve Curve (NEA_SOUND_CURVE_LINEAR by default).
+void NEA_SoundSetAttenuationCurve(NEA_SoundCurve curve);
+
+// =========================================================================
+// Voices
+// =========================================================================
+
+/// Set the max number of Maxmod voices used by spatial sources.
+///
+/// Every update the playing sources that can be heard are sorted by priority
+/// and then by volume, and only the first ones get a Maxmod voice. The rest
+/// are virtual: their position is still tracked, but nothing is sent to the
+/// ARM7. Looping sources start again from the beginning when they get a voice
+/// back. One-shot sources are stopped when they lose their voice, because
+/// Maxmod can't resume an effect in the middle.
+///
+/// @param voices Number of voices (1 to NEA_SOUND_MAX_VOICES). The default
+///               is NEA_DEFAULT_SOUND_VOICES.
+void NEA_SoundSetMaxVoices(int voices);
+
+/// Returns the number of Maxmod voices used by spatial sources.
+///
+/// @return Number of voices.
+int NEA_SoundGetVoiceCount(void);
+
+/// Set how much volume and panning must change before they are sent.
+///
+/// Sending the new volume and panning of every source every frame uses a lot
+/// of FIFO messages. They are only sent when they move by at least these
+/// amounts, or when the volume reaches 0.
+///
+/// @param volume Volume threshold (0-255, default 4).
+/// @param panning Panning threshold (0-255, default 4).
+void NEA_SoundSetUpdateThreshold(int volume, int panning);
+
 // =========================================================================
 // Sound source management
 // =========================================================================
 
 /// Create a new spatial sound source.
 ///
-/// The effect must already be loaded via mmLoadEffect(). Default distance
+/// The effect must already be loaded via mmLoadEffect(), unless the SFX cache
+/// is used (see NEA_SfxCacheInit()): then it's loaded the first time the source
+/// is played, and it isn't unloaded while the source exists. Default distance
 /// range is 1.0 (full volume) to 20.0 (silence).
 ///
 /// @param sample_id Maxmod sample ID (SFX_xxx).
@@ -161,7 +225,8 @@ void NEA_SoundSourceSetPositionI(NEA_SoundSource *source,
 
 /// Set the distance range for volume attenuation (f32).
 ///
-/// Volume is 100% at min_dist, 0% at max_dist, linearly interpolated.
+/// Volume is 100% at min_dist, 0% at max_dist, interpolated with the curve set
+/// with NEA_SoundSetAttenuationCurve().
 ///
 /// @param source Pointer to the source.
 /// @param min_dist Minimum distance for full volume (f32).
@@ -197,13 +262,23 @@ void NEA_SoundSourceSetLoop(NEA_SoundSource *source, bool loop);
 
 /// Set the delay between loop re-triggers (in frames).
 ///
-/// Only used when looping is enabled. Default is 60 frames (1 second at
-/// 60 fps). Set to a value matching the length of the sound effect.
+/// Default is 60 frames (1 second at 60 fps). Set to a value matching the
+/// length of the sound effect. For one-shot sources this is how long they
+/// keep their voice and are considered to be playing.
 ///
 /// @param source Pointer to the source.
 /// @param frames Number of frames between re-triggers.
 void NEA_SoundSourceSetLoopDelay(NEA_SoundSource *source, uint16_t frames);
 
+/// Set the priority of a source to get a Maxmod voice.
+///
+/// Sources with a higher priority always get a voice before sources with a
+/// lower one. Between sources with the same priority the loudest win.
+///
+/// @param source Pointer to the source.
+/// @param priority Priority (0-255, default NEA_DEFAULT_SOUND_PRIORITY).
+void NEA_SoundSourceSetPriority(NEA_SoundSource *source, int priority);
+
 // =========================================================================
 // Sound source playback
 // =========================================================================
@@ -224,12 +299,21 @@ void NEA_SoundSourceStop(NEA_SoundSource *source);
 /// @return True if playing.
 bool NEA_SoundSourceIsPlaying(const NEA_SoundSource *source);
 
+/// Returns true if a source is playing without a Maxmod voice.
+///
+/// @param source Pointer to the source.
+/// @return True if it is virtual.
+bool NEA_SoundSourceIsVirtual(const NEA_SoundSource *source);
+
 // =========================================================================
 // Spatial update
 // =========================================================================
 
 /// Update all spatial sound sources (recompute volume and panning).
 ///
+/// It also hands out the Maxmod voices to the sources that are playing (see
+/// NEA_SoundSetMaxVoices()).
+///
 /// Called automatically by NEA_WaitForVBL(NEA_UPDATE_SOUND), or call
 /// manually if you need more control over timing.
 void NEA_SoundUpdateAll(void);
@@ -273,17 +357,76 @@ void NEA_MusicSetPitch(mm_word pitch);
 /// @return True if playing.
 bool NEA_MusicIsPlaying(void);
 
+// =========================================================================
+// SFX cache
+// =========================================================================
+
+/// Starts a cache of the samples of the soundbank with a budget of RAM.
+///
+/// With the cache, the samples are loaded the first time they are played by
+/// NEA_SfxPlay(), NEA_SfxPlayEx() or a sound source. When a sample doesn't fit
+/// in the budget, the samples that have been used least recently are unloaded
+/// until it fits. Samples used by sound sources or by effects that are still
+/// playing are never unloaded. If nothing can be unloaded, the budget is
+/// exceeded instead of not playing the sound.
+///
+/// The first time a sample is played it's read from the filesystem, which can
+/// take a moment. Samples can be loaded in advance with NEA_SfxCachePrefetch(),
+/// for example when a level is loaded.
+///
+/// The soundbank must have been loaded with NEA_SoundSystemResetFAT(), because
+/// soundbanks in RAM don't need to load their samples. The sizes of the
+/// samples are read from the file. The cache is ended by
+/// NEA_SoundSystemEnd().
+///
+/// @param budget Max number of bytes used by the samples.
+/// @return 0 on success, -1 on error.
+int NEA_SfxCacheInit(size_t budget);
+
+/// Unloads all the samples of the SFX cache and ends it.
+void NEA_SfxCacheEnd(void);
+
+/// Loads a sample in the SFX cache if it isn't loaded.
+///
+/// It also marks it as the most recently used sample.
+///
+/// @param sample_id Sample ID (SFX_xxx).
+/// @return It returns 1 on success, 0 on error.
+int NEA_SfxCacheRequest(mm_word sample_id);
+
+/// Loads a list of samples in the SFX cache.
+///
+/// @param sample_ids Sample IDs (SFX_xxx).
+/// @param count Number of samples.
+void NEA_SfxCachePrefetch(const mm_word *sample_ids, int count);
+
+/// Returns true if a sample is loaded in the SFX cache.
+///
+/// @param sample_id Sample ID (SFX_xxx).
+/// @return True if it's loaded.
+bool NEA_SfxCacheIsLoaded(mm_word sample_id);
+
+/// Returns the number of bytes used by the samples loaded in the SFX cache.
+///
+/// @return Number of bytes.
+size_t NEA_SfxCacheGetUsed(void);
+
 // =========================================================================
 // Non-spatial SFX convenience
 // =========================================================================
 
 /// Load a sound effect into memory. Must be called before playing.
 ///
+/// With the SFX cache it's the same as NEA_SfxCacheRequest(), and it isn't
+/// needed before playing.
+///
 /// @param sample_id Sample ID (SFX_xxx).
 void NEA_SfxLoad(mm_word sample_id);
 
 /// Unload a sound effect from memory.
 ///
+/// With the SFX cache, samples used by sound sources aren't unloaded.
+///
 /// @param sample_id Sample ID (SFX_xxx).
 void NEA_SfxUnload(mm_word sample_id);
 
@@ -349,7 +492,72 @@ void NEA_StreamOpen(mm_word sampling_rate, mm_word buffer_length,
                     mm_stream_func callback, mm_word format,
                     mm_word timer);
 
+/// Default number of samples kept in the ring of NEA_StreamOpenFile().
+#define NEA_STREAM_DEFAULT_LOOKAHEAD 8192
+
+/// Open an audio stream that plays a WAV file.
+///
+/// The samples are read into a ring buffer by NEA_StreamUpdate(), which must be
+/// called from the main loop (or with NEA_UPDATE_AUDIO_STREAM). The Maxmod
+/// callback only copies samples from the ring, so it never waits for the
+/// filesystem. If the ring runs out of samples, silence is played and the
+/// underrun is counted, see NEA_StreamGetUnderruns().
+///
+/// Only uncompressed PCM files with 8 or 16 bits per sample and 1 or 2 channels
+/// are supported. Any open stream is closed first.
+///
+/// @param path Path to the file.
+/// @param buffer_length Buffer size of Maxmod in samples (multiple of 16).
+/// @param lookahead Size of the ring buffer in samples. It is at least twice
+///                  the buffer size (NEA_STREAM_DEFAULT_LOOKAHEAD is a good
+///                  value).
+/// @param timer Hardware timer to use (MM_TIMER0, etc).
+/// @param loop If true, the file starts again from the beginning when it ends.
+/// @return Returns 1 on success, 0 on error.
+int NEA_StreamOpenFile(const char *path, mm_word buffer_length,
+                       size_t lookahead, mm_word timer, bool loop);
+
+/// Open an audio stream that plays a file of raw samples.
+///
+/// This works like NEA_StreamOpenFile(), but the whole file is played as
+/// samples in the format used by Maxmod (8-bit samples are signed).
+///
+/// @param path Path to the file.
+/// @param sampling_rate Sampling rate in Hz (1024-32768).
+/// @param format Stream format (MM_STREAM_8BIT_MONO, etc).
+/// @param buffer_length Buffer size of Maxmod in samples (multiple of 16).
+/// @param lookahead Size of the ring buffer in samples.
+/// @param timer Hardware timer to use (MM_TIMER0, etc).
+/// @param loop If true, the file starts again from the beginning when it ends.
+/// @return Returns 1 on success, 0 on error.
+int NEA_StreamOpenRaw(const char *path, mm_word sampling_rate, mm_word format,
+                      mm_word buffer_length, size_t lookahead, mm_word timer,
+                      bool loop);
+
+/// Fill the ring buffer of the stream opened with NEA_StreamOpenFile().
+///
+/// It must never be called from an interrupt handler, because the filesystem
+/// can't be used from them.
+///
+/// @return Number of bytes read.
+size_t NEA_StreamUpdate(void);
+
+/// Returns true until a stream opened from a file has played all its samples.
+///
+/// @return True if the stream has samples left.
+bool NEA_StreamIsPlaying(void);
+
+/// Returns the number of times the stream ran out of samples.
+///
+/// If this number grows, call NEA_StreamUpdate() more often or use a bigger
+/// look-ahead.
+///
+/// @return Number of underruns since the stream was opened.
+uint32_t NEA_StreamGetUnderruns(void);
+
 /// Close audio stream.
+///
+/// This also closes the file of NEA_StreamOpenFile() and NEA_StreamOpenRaw().
 void NEA_StreamClose(void);
 
 /// Get stream position in elapsed samples.
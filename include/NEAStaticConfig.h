@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_STATIC_CONFIG_H__
+#define NEA_STATIC_CONFIG_H__
+
+/// @file   NEAStaticConfig.h
+/// @brief  Capacities of the systems in static builds.
+
+/// @defgroup static_config Static builds
+///
+/// By default, the reset functions of the systems (NEA_ModelSystemReset(),
+/// NEA_CameraSystemReset(), etc) allocate their tables from the heap, and
+/// every object is allocated when it's created. If NEA_STATIC_POOLS is defined
+/// when building the library (with "make NEA_STATIC_POOLS=1"), all of them are
+/// static arrays sized at build time instead. Creating and deleting objects
+/// never uses the heap, so it can't fragment it or fail because of it, and the
+/// memory used by the engine is known when linking the game.
+///
+/// The heap is only used for the data of the assets: model and animation files,
+/// textures loaded from the filesystem, scenes, multi-mesh models and the
+/// groups of animations of a model, etc.
+///
+/// The reset functions can still be called with a number of objects, but it's
+/// limited to the capacity of the static arrays. The capacities are defined
+/// below, and they can be changed by defining them when building the library,
+/// or by writing them to a header and building with
+/// "make NEA_STATIC_POOLS=1 NEA_STATIC_CONFIG=path/to/config.h":
+///
+///     #define NEA_STATIC_MAX_MODELS    64
+///     #define NEA_STATIC_MAX_MATERIALS 32
+///
+/// NEA_STATIC_POOLS only changes the library, games don't need to define it.
+///
+/// @{
+
+#ifndef NEA_STATIC_MAX_MODELS
+#define NEA_STATIC_MAX_MODELS 512 ///< Max number of models
+#endif
+
+#ifndef NEA_STATIC_MAX_MATERIALS
+#define NEA_STATIC_MAX_MATERIALS 128 ///< Max number of materials
+#endif
+
+#ifndef NEA_STATIC_MAX_ANIMATIONS
+#define NEA_STATIC_MAX_ANIMATIONS 32 ///< Max number of animations
+#endif
+
+#ifndef NEA_STATIC_MAX_PALETTES
+#define NEA_STATIC_MAX_PALETTES 64 ///< Max number of palettes
+#endif
+
+#ifndef NEA_STATIC_MAX_CAMERAS
+#define NEA_STATIC_MAX_CAMERAS 16 ///< Max number of cameras
+#endif
+
+#ifndef NEA_STATIC_MAX_SPRITES
+#define NEA_STATIC_MAX_SPRITES 128 ///< Max number of 2D sprites
+#endif
+
+#ifndef NEA_STATIC_MAX_PHYSICS
+#define NEA_STATIC_MAX_PHYSICS 64 ///< Max number of physics objects
+#endif
+
+#ifndef NEA_STATIC_MAX_PHYSICS_EVENTS
+#define NEA_STATIC_MAX_PHYSICS_EVENTS 64 ///< Size of the physics event buffer
+#endif
+
+#ifndef NEA_STATIC_MAX_SOUND_SOURCES
+#define NEA_STATIC_MAX_SOUND_SOURCES 32 ///< Max number of sound sources
+#endif
+
+#ifndef NEA_STATIC_MAX_ANIMMAT
+#define NEA_STATIC_MAX_ANIMMAT 32 ///< Max number of animated materials
+#endif
+
+/// @}
+
+#endif // NEA_STATIC_CONFIG_H__
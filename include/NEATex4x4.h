@@ -0,0 +1,140 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_TEX4X4_H__
+#define NEA_TEX4X4_H__
+
+#include <nds.h>
+
+#include "NEAPalette.h"
+#include "NEATexture.h"
+
+/// @file   NEATex4x4.h
+/// @brief  Compression of textures to the 4x4 Texel format at runtime.
+
+/// @defgroup tex4x4_encoder Tex4x4 encoder
+///
+/// Textures created at runtime (drawn with NEA_TexturePutPixelRGBA(), rendered
+/// text, etc) can be compressed to the NEA_TEX4X4 format to use less VRAM. A
+/// direct color texture uses 2 bytes per pixel, a compressed one uses 5 bits
+/// per pixel at most (texels, block indices and palette together).
+///
+/// The encoder is fast rather than accurate: each block of 4x4 pixels uses two
+/// colors of the palette and the two colors that the GPU interpolates between
+/// them. Blocks with transparent pixels use the color halfway between them
+/// and the transparent color instead. Consecutive blocks with the same colors
+/// share them in the palette.
+///
+/// A texture can be compressed in one call with NEA_MaterialTex4x4Compress(),
+/// or a few rows of blocks at a time with an encoder, for example from a job:
+///
+///     NEA_Tex4x4Encoder enc;
+///     NEA_Tex4x4EncoderInit(&enc, pixels, 128, 128);
+///     NEA_Tex4x4EncoderStartJob(&enc, 0);
+///
+///     // Later, outside of the drawing function
+///     if (NEA_Tex4x4EncoderIsDone(&enc))
+///     {
+///         NEA_Tex4x4EncoderLoad(&enc, material, palette, NEA_TEXGEN_TEXCOORD);
+///         NEA_Tex4x4EncoderEnd(&enc);
+///     }
+///
+/// The source is an image in NEA_A1RGB5 format, one row after the other. Pixels
+/// with the alpha bit cleared are transparent.
+///
+/// @{
+
+/// Rows of blocks encoded every time the job of an encoder runs.
+#define NEA_TEX4X4_JOB_ROWS 2
+
+/// Estimated cost of the job of an encoder of a 64 pixel wide texture, in bus
+/// cycles. It's multiplied by the width of the texture divided by 64.
+#define NEA_TEX4X4_JOB_COST (8 * 1024)
+
+/// Holds the state of a Tex4x4 encoder.
+typedef struct {
+    const u16 *src;     ///< Source image (NEA_A1RGB5)
+    int sizex;          ///< Width of the image
+    int sizey;          ///< Height of the image
+    int next_row;       ///< Next row of blocks to encode
+    u32 *texels;        ///< Texel data (slot 0 or 2 of the texture)
+    u16 *indices;       ///< Palette indices of the blocks (slot 1)
+    u16 *palette;       ///< Colors of the palette
+    int num_colors;     ///< Colors used in the palette
+    bool job;           ///< The encoder is run by a job
+} NEA_Tex4x4Encoder;
+
+/// Prepares an encoder to compress an image.
+///
+/// The image isn't copied, it must remain valid until it has been encoded.
+///
+/// @param enc Encoder.
+/// @param src Image in NEA_A1RGB5 format.
+/// @param sizeX (sizeX, sizeY) Size of the image (powers of two, 8 - 512).
+/// @param sizeY (sizeX, sizeY) Size of the image (powers of two, 8 - 512).
+/// @return It returns 1 on success, 0 on error (not enough memory).
+int NEA_Tex4x4EncoderInit(NEA_Tex4x4Encoder *enc, const u16 *src,
+                          int sizeX, int sizeY);
+
+/// Encodes some rows of blocks of the image.
+///
+/// @param enc Encoder.
+/// @param rows Max number of rows of blocks (4 rows of pixels each).
+/// @return It returns true when the whole image has been encoded.
+bool NEA_Tex4x4EncoderRun(NEA_Tex4x4Encoder *enc, int rows);
+
+/// Encodes the image with a job of the job scheduler.
+///
+/// Each run of the job encodes NEA_TEX4X4_JOB_ROWS rows of blocks. Use
+/// NEA_Tex4x4EncoderIsDone() to check when it has finished.
+///
+/// @param enc Encoder. It must remain valid until the job has finished.
+/// @param priority Priority of the job.
+/// @return It returns 1 on success, 0 on error.
+int NEA_Tex4x4EncoderStartJob(NEA_Tex4x4Encoder *enc, int priority);
+
+/// Returns true when the whole image has been encoded.
+///
+/// @param enc Encoder.
+/// @return True if the image has been encoded.
+bool NEA_Tex4x4EncoderIsDone(const NEA_Tex4x4Encoder *enc);
+
+/// Loads the encoded texture to a material, see NEA_MaterialTex4x4Load().
+///
+/// The palette is loaded to the palette object and assigned to the material.
+/// It must not be called while drawing, or from a job.
+///
+/// @param enc Encoder. The whole image must have been encoded.
+/// @param tex Material.
+/// @param pal Palette object.
+/// @param flags Parameters of the texture.
+/// @return It returns 1 on success, 0 on error.
+int NEA_Tex4x4EncoderLoad(const NEA_Tex4x4Encoder *enc, NEA_Material *tex,
+                          NEA_Palette *pal, NEA_TextureFlags flags);
+
+/// Frees the memory used by an encoder.
+///
+/// If the job of the encoder is still pending, it's cancelled.
+///
+/// @param enc Encoder.
+void NEA_Tex4x4EncoderEnd(NEA_Tex4x4Encoder *enc);
+
+/// Compresses an image and loads it to a material.
+///
+/// @param tex Material.
+/// @param pal Palette object.
+/// @param src Image in NEA_A1RGB5 format.
+/// @param sizeX (sizeX, sizeY) Size of the image (powers of two, 8 - 512).
+/// @param sizeY (sizeX, sizeY) Size of the image (powers of two, 8 - 512).
+/// @param flags Parameters of the texture.
+/// @return It returns 1 on success, 0 on error.
+int NEA_MaterialTex4x4Compress(NEA_Material *tex, NEA_Palette *pal,
+                               const u16 *src, int sizeX, int sizeY,
+                               NEA_TextureFlags flags);
+
+/// @}
+
+#endif // NEA_TEX4X4_H__
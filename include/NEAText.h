@@ -25,6 +25,14 @@
 
 #define NEA_MAX_TEXT_FONTS 8 ///< Default max number of text fonts
 
+/// Holds a string that has been laid out with NEA_TextCompile().
+typedef struct {
+    uint32_t *list; ///< Display list with the quads of all characters
+    int slot;       ///< Text font slot used to compile it
+    int count;      ///< Number of characters that have been compiled
+    int capacity;   ///< Max number of characters that fit in the list
+} NEA_TextCompiled;
+
 /// Change the priority of text drawn after this function call.
 ///
 /// @param priority New priority.
@@ -103,6 +111,43 @@ int NEA_TextPrintFree(int slot, int x, int y, u32 color, const char *text);
 int NEA_TextPrintBoxFree(int slot, int x, int y, int endx, int endy, u32 color,
             int charnum, const char *text);
 
+/// Lays out text once so that it can be drawn many times.
+///
+/// The quads of all characters are stored in a display list, so drawing it
+/// with NEA_TextCompiledDraw() doesn't need to walk the string again. The text
+/// is laid out like with NEA_TextPrintFree(), but '\n' is supported: it moves
+/// to the start of the next line.
+///
+/// @param slot Text font slot to use.
+/// @param text Text to compile.
+/// @return Pointer to the compiled text, or NULL on error.
+NEA_TextCompiled *NEA_TextCompile(int slot, const char *text);
+
+/// Replaces the text of a compiled text.
+///
+/// The display list is only reallocated if the new text doesn't fit in it.
+///
+/// @param compiled Pointer to the compiled text.
+/// @param text New text.
+/// @return Returns 1 on success, 0 on error.
+int NEA_TextRecompile(NEA_TextCompiled *compiled, const char *text);
+
+/// Draws a compiled text.
+///
+/// The text is drawn with the priority set with NEA_TextPrioritySet().
+///
+/// @param compiled Pointer to the compiled text.
+/// @param x (x, y) Position in pixels.
+/// @param y (x, y) Position in pixels.
+/// @param color Text color.
+void NEA_TextCompiledDraw(const NEA_TextCompiled *compiled, int x, int y,
+                          u32 color);
+
+/// Deletes a compiled text.
+///
+/// @param compiled Pointer to the compiled text.
+void NEA_TextCompiledDelete(NEA_TextCompiled *compiled);
+
 /// @}
 
 #endif // NEA_TEXT_H__
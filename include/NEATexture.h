@@ -39,6 +39,8 @@ typedef struct {
     u32 specular_emission;   ///< Specular and emission lighting material color
     bool palette_autodelete; ///< Set to true for the palette to be deleted with the material.
     char name[NEA_MATERIAL_NAME_LEN]; ///< Name/alias for material lookup
+    s16 tex_offset_s;        ///< Texture coordinates offset in texels (S axis)
+    s16 tex_offset_t;        ///< Texture coordinates offset in texels (T axis)
 } NEA_Material;
 
 /// Supported texture options
@@ -73,7 +75,10 @@ const char *NEA_MaterialGetName(const NEA_Material *mat);
 
 /// Find a material by name.
 ///
-/// Searches all created materials for one matching the given name.
+/// Searches all created materials for one matching the given name. Names are
+/// kept in a hash table. It is built again in the first search after a
+/// material is created, deleted, cloned or renamed, so change names with
+/// NEA_MaterialSetName() instead of writing them directly.
 ///
 /// @param name Name to search for.
 /// @return Pointer to the matching material, or NULL if not found.
@@ -152,6 +157,21 @@ int NEA_MaterialTex4x4LoadFAT(NEA_Material *tex, int sizeX, int sizeY,
 int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
                           NEA_TextureFlags flags, const char *path);
 
+/// Loads a texture in any format from a GRF file in RAM to a material and
+/// palette, copying it during the next vertical blanks.
+///
+/// The GRF file is decoded right away, so it can be freed after calling this
+/// function. The decoded texture and palette are copied to VRAM by
+/// NEA_UploadUpdate(), and they are freed when the copies finish.
+///
+/// @param tex Material.
+/// @param pal Palette. If the format is 16 bit, nothing will be loaded here.
+/// @param flags Parameters of the texture.
+/// @param data Pointer to the GRF file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_MaterialTexLoadGRFAsync(NEA_Material *tex, NEA_Palette *pal,
+                               NEA_TextureFlags flags, const void *data);
+
 /// Loads a texture from RAM and assigns it to a material object.
 ///
 /// Textures with width that isn't a power of two need to be resized manually,
@@ -180,6 +200,29 @@ int NEA_MaterialTexLoad(NEA_Material *tex, NEA_TextureFormat fmt,
                        int sizeX, int sizeY, NEA_TextureFlags flags,
                        const void *texture);
 
+/// Loads a texture from RAM and assigns it to a material object, copying it
+/// to VRAM during the next vertical blanks.
+///
+/// VRAM is allocated right away, but the data is copied by NEA_UploadUpdate().
+/// The material is drawn without texture until it has been copied. The data
+/// must remain valid until the callback is called. The format of the data is
+/// the same as in NEA_MaterialTexLoad().
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param texture Pointer to the texture data.
+/// @param callback Function called when the copy has finished or has been
+///                 cancelled, or NULL.
+/// @param arg Argument passed to the callback.
+/// @return It returns 1 on success, 0 on error.
+int NEA_MaterialTexLoadAsync(NEA_Material *tex, NEA_TextureFormat fmt,
+                            int sizeX, int sizeY, NEA_TextureFlags flags,
+                            const void *texture,
+                            NEA_UploadCallback callback, void *arg);
+
 /// Loads a texture from RAM and assigns it to a material object.
 ///
 /// Width and height need to be powers of two.
@@ -195,6 +238,60 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
                           NEA_TextureFlags flags, const void *texture02,
                           const void *texture1);
 
+/// Assigns a streamed texture with data in RAM to a material object.
+///
+/// The texture isn't copied to VRAM right away. The first time the material
+/// is used it is drawn without texture and an upload is requested, which is
+/// done by NEA_TextureStreamUpdate(). If there isn't enough VRAM, the streamed
+/// textures that have been used least recently are evicted from VRAM, and they
+/// are uploaded again the next time they are used.
+///
+/// The data isn't copied, so it must remain valid until the material is
+/// deleted or it gets a different texture. The format of the data is the same
+/// as in NEA_MaterialTexLoad().
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param texture Pointer to the texture data.
+/// @return It returns 1 on success, 0 on error.
+int NEA_MaterialTexStream(NEA_Material *tex, NEA_TextureFormat fmt,
+                          int sizeX, int sizeY, NEA_TextureFlags flags,
+                          const void *texture);
+
+/// Assigns a streamed texture stored in the filesystem to a material object.
+///
+/// This works like NEA_MaterialTexStream(), but the file is read every time
+/// the texture is uploaded to VRAM, and the data isn't kept in RAM.
+///
+/// @param tex Material.
+/// @param fmt Texture format.
+/// @param sizeX (sizeX, sizeY) Texture size.
+/// @param sizeY (sizeX, sizeY) Texture size.
+/// @param flags Parameters of the texture.
+/// @param path Path of the texture file.
+/// @return It returns 1 on success, 0 on error.
+int NEA_MaterialTexStreamFAT(NEA_Material *tex, NEA_TextureFormat fmt,
+                             int sizeX, int sizeY, NEA_TextureFlags flags,
+                             const char *path);
+
+/// Returns true if the texture of a material is in VRAM.
+///
+/// Textures that aren't streamed are always in VRAM.
+///
+/// @param tex Material.
+/// @return Returns true if the texture is in VRAM.
+bool NEA_MaterialIsResident(const NEA_Material *tex);
+
+/// Removes the streamed texture of a material from VRAM.
+///
+/// It will be uploaded again the next time it is used.
+///
+/// @param tex Material.
+void NEA_MaterialTexEvict(NEA_Material *tex);
+
 /// Tell a material that it has to delete its palette on deletion.
 ///
 /// Normally, when a material is deleted, the palette isn't deleted with it.
@@ -205,6 +302,21 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
 /// @param mat Material.
 void NEA_MaterialAutodeletePalette(NEA_Material *mat);
 
+/// Sets an offset that is added to the texture coordinates of a material.
+///
+/// This is meant to draw meshes with a part of a bigger texture, like a
+/// rectangle of an atlas (see NEA_AtlasCreateMaterial()). The offset is applied
+/// with the texture matrix when the material is used, so it only works with
+/// textures loaded with NEA_TEXGEN_TEXCOORD, and it replaces any other
+/// transformation of the texture matrix. Using a material with
+/// NEA_TEXGEN_TEXCOORD and no offset afterwards resets the texture matrix,
+/// unless it has been modified after the offset was applied.
+///
+/// @param tex Material.
+/// @param s Offset on the S axis in texels.
+/// @param t Offset on the T axis in texels.
+void NEA_MaterialSetTexOffset(NEA_Material *tex, int s, int t);
+
 /// Copies the texture of a material into another material.
 ///
 /// Unlike with models, you can delete the source and destination materials as
@@ -243,6 +355,30 @@ void NEA_MaterialSetPalette(NEA_Material *tex, NEA_Palette *pal);
 /// @param tex Material to be used.
 void NEA_MaterialUse(const NEA_Material *tex);
 
+/// Forget the current material state of the GPU.
+///
+/// NEA_MaterialUse() keeps track of the values of the texture format, palette
+/// format, diffuse/ambient and specular/emission registers, and it skips
+/// writing them if they already have the right values. The draw functions of
+/// the engine do the same with the polygon format, the matrix mode, the texture
+/// matrix (see NEA_TextureMatrixIdentity()) and the projection matrix of the 2D
+/// view (see NEA_2DViewInit()). If you write any of these registers or
+/// matrices manually (with glPolyFmt(), glMatrixMode(), etc), call this
+/// function afterwards so that the engine writes all of them again.
+///
+/// This is done automatically at the start of every frame.
+void NEA_MaterialStateInvalidate(void);
+
+/// Returns the number of register writes skipped by the material state.
+///
+/// Each skipped write is one command that wasn't sent to the GX FIFO.
+///
+/// @return Number of writes avoided since the last reset.
+uint32_t NEA_MaterialStateGetAvoidedWrites(void);
+
+/// Resets the counter returned by NEA_MaterialStateGetAvoidedWrites().
+void NEA_MaterialStateResetAvoidedWrites(void);
+
 /// Flags to choose which VRAM banks Nitro Engine Advanced can use to allocate textures.
 typedef enum {
     NEA_VRAM_A = (1 << 0), ///< Bank A
@@ -306,11 +442,131 @@ int NEA_TextureFreeMem(void);
 /// @return Returns the percentage of available memory (0-100).
 int NEA_TextureFreeMemPercent(void);
 
+/// Result of the allocation of a compressed texture.
+typedef enum {
+    /// The texture has been allocated.
+    NEA_TEX4X4_ALLOC_OK,
+    /// There is no gap in slots 0 or 2 big enough for the texel data.
+    NEA_TEX4X4_ALLOC_NO_TEXEL_SPACE,
+    /// There is no gap in slot 1 big enough for the palette index data.
+    NEA_TEX4X4_ALLOC_NO_INDEX_SPACE,
+    /// There are gaps in slots 0/2 and 1, but they aren't at matching
+    /// addresses. Defragmenting texture memory may help.
+    NEA_TEX4X4_ALLOC_NO_PAIR
+} NEA_Tex4x4AllocResult;
+
+/// Returns the result of the last allocation of a compressed texture.
+///
+/// The data of NEA_TEX4X4 textures goes to slot 0 or 2, and to the matching
+/// address of slot 1. The allocator looks at the ranges that are free in both
+/// slots at the same time, and it picks the smallest one that fits, so that
+/// big ranges are kept for big textures. When it fails, this function tells
+/// the reason.
+///
+/// @return Returns the result of the last allocation.
+NEA_Tex4x4AllocResult NEA_TextureGetTex4x4AllocResult(void);
+
+/// Max number of bytes uploaded by NEA_WaitForVBL() with
+/// NEA_UPDATE_TEXTURE_STREAM.
+#define NEA_TEXTURE_STREAM_STEP_BYTES (16 * 1024)
+
+/// Sets the max amount of VRAM that streamed textures can use.
+///
+/// If it is 0 (the default), streamed textures can use all the VRAM banks
+/// given to NEA_TextureSystemReset(), and they are only evicted when there
+/// isn't space for a new one.
+///
+/// @param bytes Max size in bytes, or 0 for no limit.
+void NEA_TextureStreamSetBudget(size_t bytes);
+
+/// Returns the amount of VRAM used by streamed textures.
+///
+/// @return Size in bytes.
+size_t NEA_TextureStreamGetResidentSize(void);
+
+/// Uploads the streamed textures that have been used while not in VRAM.
+///
+/// It must be called once per frame, right after the vertical blank, because
+/// it also counts frames to know which textures have been used recently.
+/// Textures used in the last two frames are never evicted. At least one
+/// texture is uploaded if there is any pending, even if it is bigger than the
+/// limit, unless the 3D engine is already rendering (see NEA_GPUIsRendering()).
+/// It stops uploading textures as soon as the 3D engine starts rendering. If
+/// VRAM needs to be defragmented, it moves at most
+/// NEA_TEXTURE_DEFRAG_STEP_BYTES per texture and, if that isn't enough, it
+/// tries again in the next frame.
+///
+/// NEA_WaitForVBL() calls it if NEA_UPDATE_TEXTURE_STREAM is used.
+///
+/// @param max_bytes Number of bytes to upload before returning.
+/// @return Returns the number of bytes that have been uploaded.
+size_t NEA_TextureStreamUpdate(size_t max_bytes);
+
+/// Max number of bytes moved by NEA_WaitForVBL() with NEA_UPDATE_TEXTURE_DEFRAG.
+#define NEA_TEXTURE_DEFRAG_STEP_BYTES (8 * 1024)
+
+/// Moves some textures to join the free gaps of texture memory.
+///
+/// Regular textures are moved towards the end of VRAM, where they are
+/// allocated. Compressed textures are moved towards the start of slot 0 or 2,
+/// together with their data in slot 1. The materials that use a texture that
+/// has been moved use the new address right away.
+///
+/// At least one texture is moved if there is any that can be moved, even if it
+/// is bigger than the limit. Textures are only moved if a texture has been
+/// deleted since the last time that the memory was fully defragmented, so it
+/// is cheap to call this every frame.
+///
+/// VRAM is unlocked while the textures are copied, so this should be called
+/// right after the vertical blank starts. It stops before moving a texture if
+/// the 3D engine has started rendering (see NEA_GPUIsRendering()), and it
+/// doesn't move anything if it is called while the GPU is rendering. A texture
+/// that is moved a distance smaller than its size may look corrupted during
+/// the next frame.
+///
+/// @param max_bytes Number of bytes to move before returning.
+/// @return Returns the number of bytes that have been moved, or 0 if there is
+///         nothing left to move.
+size_t NEA_TextureDefragMemStep(size_t max_bytes);
+
 /// Defragment memory used for textures.
 ///
-/// WARNING: This function is currently not working.
+/// It moves textures until there is nothing else to move. It may take a long
+/// time, use NEA_TextureDefragMemStep() to split the work into several frames.
 void NEA_TextureDefragMem(void);
 
+/// Stops using some VRAM banks for textures so that they can be used for
+/// something else, like the Hw2D system.
+///
+/// The streamed textures in those banks are evicted, and the rest of the
+/// textures are moved to the banks that are kept. Compressed textures need
+/// banks A and B or banks B and C to be kept. The materials that use a texture
+/// that has been moved use the new address right away. The banks are left in
+/// LCD mode.
+///
+/// It fails if a texture is being uploaded asynchronously to those banks, or if
+/// there isn't enough space for all the textures in the other banks. In that
+/// case, the textures that have already been moved stay in their new place and
+/// all the banks are still used for textures.
+///
+/// VRAM is unlocked while the textures are copied, so this should be called
+/// right after the vertical blank starts.
+///
+/// @param banks Banks to release. Banks not used for textures are ignored.
+/// @return Returns 1 on success, 0 on error.
+int NEA_TextureBanksRelease(NEA_VRAMBankFlags banks);
+
+/// Starts using some VRAM banks for textures, after they have been released
+/// with NEA_TextureBanksRelease() or not used in NEA_TextureSystemReset().
+///
+/// It fails if a bank is claimed by the Hw2D system, if bank D is used by the
+/// impostors, or if the current execution mode uses the bank.
+///
+/// @param banks Banks to add to texture memory. Banks already used for
+///              textures and banks other than A to D are ignored.
+/// @return Returns 1 on success, 0 on error.
+int NEA_TextureBanksAcquire(NEA_VRAMBankFlags banks);
+
 /// End texture system and free all memory used by it.
 void NEA_TextureSystemEnd(void);
 
@@ -422,6 +678,70 @@ void NEA_TexturePutPixelRGBA(u32 x, u32 y, u16 color);
 /// @param palettecolor New palette color index.
 void NEA_TexturePutPixelRGB256(u32 x, u32 y, u8 palettecolor);
 
+/// Fills a horizontal span of pixels of the active texture.
+///
+/// The drawing functions below work with NEA_A1RGB5 and NEA_PAL256 textures.
+/// The value is a RGB15 color (bit 15 must be set to make the pixels visible)
+/// or a palette index, depending on the format. They clip the shape to the
+/// texture once instead of checking every pixel, and long spans are filled
+/// with DMA.
+///
+/// Use this during VBL.
+///
+/// @param x (x, y) First pixel.
+/// @param y (x, y) First pixel.
+/// @param w Number of pixels.
+/// @param value Color or palette index.
+void NEA_TextureDrawSpan(int x, int y, int w, u16 value);
+
+/// Fills a rectangle of the active texture.
+///
+/// Use this during VBL.
+///
+/// @param x (x, y) Top left corner.
+/// @param y (x, y) Top left corner.
+/// @param w Width.
+/// @param h Height.
+/// @param value Color or palette index.
+void NEA_TextureDrawRect(int x, int y, int w, int h, u16 value);
+
+/// Draws a line of one pixel of width on the active texture.
+///
+/// Use this during VBL.
+///
+/// @param x1 (x1, y1) First point.
+/// @param y1 (x1, y1) First point.
+/// @param x2 (x2, y2) Last point.
+/// @param y2 (x2, y2) Last point.
+/// @param value Color or palette index.
+void NEA_TextureDrawLine(int x1, int y1, int x2, int y2, u16 value);
+
+/// Draws a filled circle on the active texture.
+///
+/// Use this during VBL.
+///
+/// @param x (x, y) Center.
+/// @param y (x, y) Center.
+/// @param radius Radius (0 draws one pixel).
+/// @param value Color or palette index.
+void NEA_TextureDrawCircle(int x, int y, int radius, u16 value);
+
+/// Draws a stroke of a round brush between two points on the active texture.
+///
+/// The brush is stamped along the line close enough to leave no gaps. It can
+/// be used to join the positions of the stylus of two frames.
+///
+/// Use this during VBL.
+///
+/// @param x1 (x1, y1) First point.
+/// @param y1 (x1, y1) First point.
+/// @param x2 (x2, y2) Last point.
+/// @param y2 (x2, y2) Last point.
+/// @param radius Radius of the brush (0 draws a line of one pixel).
+/// @param value Color or palette index.
+void NEA_TextureDrawStroke(int x1, int y1, int x2, int y2, int radius,
+                           u16 value);
+
 /// Disables modification of textures.
 ///
 /// Use this during VBL.
@@ -439,7 +759,8 @@ void NEA_TextureDrawingEnd(void);
 
 /// Reset the texture matrix to identity.
 ///
-/// Call this before applying new texture transforms.
+/// Call this before applying new texture transforms. Nothing is sent to the GPU
+/// if the matrix hasn't been modified since the last reset.
 void NEA_TextureMatrixIdentity(void);
 
 /// Translate the texture matrix (fixed-point).
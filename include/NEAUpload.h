@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_UPLOAD_H__
+#define NEA_UPLOAD_H__
+
+#include <nds.h>
+
+/// @file   NEAUpload.h
+/// @brief  Queue of texture and palette uploads done during the vertical blank.
+
+/// @defgroup upload_queue Upload queue
+///
+/// NEA_MaterialTexLoadAsync() and NEA_PaletteLoadAsync() allocate VRAM right
+/// away, but they don't copy the data. The copies are added to a queue that is
+/// processed by NEA_UploadUpdate(), which only unlocks the VRAM banks while the
+/// 3D engine isn't reading from them, so there is no need to blank the screen
+/// to load textures.
+///
+/// Materials are drawn without texture until their texture and palette have
+/// been copied. The data must remain valid until the callback of the upload
+/// is called (it can be freed from the callback).
+///
+/// NEA_WaitForVBL() processes the queue if NEA_UPDATE_UPLOADS is used.
+///
+/// @{
+
+#define NEA_UPLOAD_QUEUE_SIZE 32 ///< Max number of pending copies
+
+/// Default number of bytes copied by NEA_UploadUpdate()
+#define NEA_UPLOAD_DEFAULT_BUDGET (16 * 1024)
+
+/// Function called when an upload has finished.
+///
+/// It's also called if the upload is cancelled because its texture or palette
+/// is deleted, or the texture or palette system is reset, so it can always be
+/// used to free the source data.
+///
+/// @param arg Argument given when the upload was requested.
+typedef void (*NEA_UploadCallback)(void *arg);
+
+/// Sets the max number of bytes copied by each call to NEA_UploadUpdate().
+///
+/// @param bytes Number of bytes. If it is 0, NEA_UPLOAD_DEFAULT_BUDGET is used.
+void NEA_UploadSetBudget(size_t bytes);
+
+/// Copies pending uploads to VRAM.
+///
+/// It must be called right after the vertical blank starts. It stops when the
+/// budget has been used, or when the 3D engine starts drawing the next frame.
+/// If it's called while the 3D engine is drawing, it doesn't do anything.
+///
+/// The callbacks of the uploads that finish are called from this function.
+///
+/// @return Returns the number of bytes that have been copied.
+size_t NEA_UploadUpdate(void);
+
+/// Copies all pending uploads to VRAM right now.
+///
+/// This doesn't wait for the vertical blank, so the current frame may look
+/// corrupted. It is meant for loading screens.
+void NEA_UploadFlush(void);
+
+/// Returns the number of bytes that are waiting to be copied to VRAM.
+///
+/// @return Size in bytes.
+size_t NEA_UploadGetPendingSize(void);
+
+/// @}
+
+#endif // NEA_UPLOAD_H__
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_POSE_IPC_H__
+#define NEA_POSE_IPC_H__
+
+/// @file   NEA_POSE_IPC.h
+/// @brief  Shared ARM7/ARM9 IPC protocol for the skeletal pose service.
+///
+/// This header is included by both the ARM7 pose interpolator and the ARM9
+/// API layer (NEAPoseService.c). It defines FIFO commands, limits and the
+/// layout of the shared request ring.
+
+#include <nds/fifocommon.h>
+#include <nds/ndstypes.h>
+
+// =========================================================================
+// Limits
+// =========================================================================
+
+/// Max joints of a pose. It's the limit of DSMA_PrepareBones().
+#define NEA_POSE_MAX_JOINTS   30
+
+/// Number of entries of the request ring (power of two).
+#define NEA_POSE_MAX_REQUESTS 8
+
+// =========================================================================
+// FIFO channel
+// =========================================================================
+
+#define NEA_POSE_FIFO_CMD FIFO_USER_06 ///< ARM9 -> ARM7 commands.
+
+// =========================================================================
+// Command encoding
+// =========================================================================
+//
+// Same encoding as the commands of the rigid body engine (see NEA_RB_IPC.h):
+//   bits [5:0]  = command ID (NEA_POSE_Command)
+//   bits [31:6] = parameter
+
+#define NEA_POSE_CMD_BITS  6
+#define NEA_POSE_CMD_MASK  ((1u << NEA_POSE_CMD_BITS) - 1u)
+
+#define NEA_POSE_ENCODE_CMD(cmd, param) \
+    ((u32)(cmd) | ((u32)(param) << NEA_POSE_CMD_BITS))
+
+#define NEA_POSE_DECODE_CMD(val)   ((val) & NEA_POSE_CMD_MASK)
+#define NEA_POSE_DECODE_PARAM(val) ((val) >> NEA_POSE_CMD_BITS)
+
+/// Command IDs for NEA_POSE_FIFO_CMD (ARM9 -> ARM7).
+typedef enum {
+    NEA_POSE_CMD_SET_BUFFER = 1, ///< Set shared block. +1 word: address.
+    NEA_POSE_CMD_KICK       = 2, ///< New requests. Write position in parameter.
+} NEA_POSE_Command;
+
+// =========================================================================
+// Shared request ring
+// =========================================================================
+//
+// The ARM9 owns a NEA_POSE_SharedState block in main RAM and sends its address
+// with NEA_POSE_CMD_SET_BUFFER. To request a pose it fills the DSA address and
+// frame of the entry at its write position, sets its status to
+// NEA_POSE_STATUS_PENDING and sends the new write position with
+// NEA_POSE_CMD_KICK.
+//
+// The ARM7 handles the requests in order while it waits for the next VBlank.
+// It writes the joints of the pose to the entry, then the status, and then
+// moves 'tail' past the entry. The ARM9 only reuses entries that are behind
+// 'tail', and it only accesses the block through the uncached mirror of main
+// RAM. DSA files read by the ARM7 must not have dirty lines in the data cache
+// of the ARM9.
+
+/// Status of a request.
+typedef enum {
+    NEA_POSE_STATUS_EMPTY   = 0, ///< Never used.
+    NEA_POSE_STATUS_PENDING = 1, ///< Waiting for the ARM7.
+    NEA_POSE_STATUS_DONE    = 2, ///< The joints are ready.
+    NEA_POSE_STATUS_FAILED  = 3, ///< Invalid DSA file, frame or joint count.
+} NEA_POSE_Status;
+
+/// Request of one pose and, when it's done, its joints.
+typedef struct {
+    volatile u32 status;  ///< NEA_POSE_Status, written last by the ARM7.
+    u32 dsa_file;         ///< Address of the DSA file.
+    u32 frame_interp;     ///< Frame (20.12 fixed point).
+    u32 num_joints;       ///< Joints of the pose.
+    s32 pos[NEA_POSE_MAX_JOINTS][3];    ///< Translation (x, y, z)
+    s32 orient[NEA_POSE_MAX_JOINTS][4]; ///< Orientation (w, x, y, z)
+} NEA_POSE_Request;
+
+/// Request ring shared by both CPUs.
+///
+/// It is aligned to a cache line and its size is a multiple of it, so that no
+/// other data of the ARM9 shares its cache lines.
+typedef struct {
+    NEA_POSE_Request requests[NEA_POSE_MAX_REQUESTS];
+    volatile u32 tail; ///< Next entry handled by the ARM7.
+    u32 served;        ///< Poses interpolated by the ARM7 so far.
+} __attribute__((aligned(32))) NEA_POSE_SharedState;
+
+#endif // NEA_POSE_IPC_H__
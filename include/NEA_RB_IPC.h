@@ -11,7 +11,8 @@
 /// @brief  Shared ARM7/ARM9 IPC protocol for the rigid body physics engine.
 ///
 /// This header is included by both the ARM7 physics simulation and the ARM9
-/// API layer. It defines FIFO command IDs, limits, and encoding conventions.
+/// API layer. It defines FIFO command IDs, limits, encoding conventions and
+/// the layout of the shared state block.
 
 #include <nds/fifocommon.h>
 #include <nds/ndstypes.h>
@@ -20,16 +21,19 @@
 // Limits
 // =========================================================================
 
-#define NEA_RB_MAX_BODIES   16   ///< Max simultaneous rigid bodies.
+#define NEA_RB_MAX_BODIES   48   ///< Max simultaneous rigid bodies.
 #define NEA_RB_MAX_STATICS  128  ///< Max static AAR colliders.
-#define NEA_RB_MAX_CONTACTS 64   ///< Max contact points per simulation step.
+#define NEA_RB_MAX_CONTACTS 192  ///< Max contact points per simulation step.
+
+/// Size of the command ring in words (power of two).
+#define NEA_RB_CMD_RING_WORDS 1024
 
 // =========================================================================
 // FIFO channels
 // =========================================================================
 
 #define NEA_RB_FIFO_CMD   FIFO_USER_08  ///< ARM9 -> ARM7 commands.
-#define NEA_RB_FIFO_STATE FIFO_USER_07  ///< ARM7 -> ARM9 state updates.
+#define NEA_RB_FIFO_STATE FIFO_USER_07  ///< ARM7 -> ARM9 frame numbers.
 
 // =========================================================================
 // Command encoding
@@ -41,6 +45,12 @@
 //
 // Multi-word commands send the command word first, followed by data words
 // on the same FIFO channel.
+//
+// Most commands aren't sent through the FIFO. The ARM9 writes them to the ring
+// of the shared block (see NEA_RB_SharedState) during the frame, with the same
+// encoding, and hands them over with one NEA_RB_CMD_BATCH word whose parameter
+// is the new write position in the ring. The ARM7 runs all commands up to that
+// position at the start of its next step and then updates cmd_tail.
 
 #define NEA_RB_CMD_BITS  6
 #define NEA_RB_CMD_MASK  ((1u << NEA_RB_CMD_BITS) - 1u)
@@ -56,7 +66,7 @@ typedef enum {
     NEA_RB_CMD_START         = 1,  ///< Enable simulation. No extra words.
     NEA_RB_CMD_PAUSE         = 2,  ///< Pause simulation. No extra words.
     NEA_RB_CMD_RESET         = 3,  ///< Reset all bodies & statics. No extra words.
-    NEA_RB_CMD_ADD_BODY      = 4,  ///< Create OBB. +7 words: hx,hy,hz, mass, px,py,pz.
+    NEA_RB_CMD_ADD_BODY      = 4,  ///< Create body. +7 words: hx,hy,hz, mass, px,py,pz.
     NEA_RB_CMD_KILL_BODY     = 5,  ///< Destroy body. ID in header. No extra words.
     NEA_RB_CMD_APPLY_FORCE   = 6,  ///< Apply force at point. +6 words: fx,fy,fz, px,py,pz.
     NEA_RB_CMD_APPLY_IMPULSE = 7,  ///< Apply impulse at point. +6 words: jx,jy,jz, px,py,pz.
@@ -68,33 +78,78 @@ typedef enum {
     NEA_RB_CMD_SET_FRICTION  = 13, ///< Set friction. +1 word: mu (f32).
     NEA_RB_CMD_SET_POSITION  = 14, ///< Teleport body. +3 words: px,py,pz.
     NEA_RB_CMD_INJECT_CONTACT = 15, ///< Inject external contact. +7 words: nx,ny,nz, px,py,pz, depth.
+    NEA_RB_CMD_SET_STATE_BUFFER = 16, ///< Set shared block. +1 word: address (0 to stop).
+    NEA_RB_CMD_BATCH         = 17, ///< Run ring commands. Write position in header.
+    NEA_RB_CMD_SET_MESH      = 18, ///< Set mesh collider. +6 words: tris, nodes, counts, px,py,pz.
+    NEA_RB_CMD_SET_STEP_BUDGET = 19, ///< Set ARM7 cycles per frame (0 = no limit) in header.
 } NEA_RB_Command;
 
+/// Shapes of bodies, sent in the ID of NEA_RB_CMD_ADD_BODY.
+///
+/// The half-extents of NEA_RB_CMD_ADD_BODY are the box that contains the body:
+/// (radius, radius, radius) for spheres and (radius, half_height + radius,
+/// radius) for capsules, which are aligned with their local Y axis.
+typedef enum {
+    NEA_RB_SHAPE_BOX     = 0, ///< Oriented box.
+    NEA_RB_SHAPE_SPHERE  = 1, ///< Sphere.
+    NEA_RB_SHAPE_CAPSULE = 2, ///< Capsule.
+} NEA_RB_Shape;
+
+#define NEA_RB_BODY_SHAPE_SHIFT 8
+
+#define NEA_RB_ENCODE_BODY(id, shape) \
+    ((u32)(id) | ((u32)(shape) << NEA_RB_BODY_SHAPE_SHIFT))
+
+#define NEA_RB_DECODE_BODY_ID(val)    ((val) & 0xFFu)
+#define NEA_RB_DECODE_BODY_SHAPE(val) ((val) >> NEA_RB_BODY_SHAPE_SHIFT)
+
 // =========================================================================
-// State packet encoding (ARM7 -> ARM9 via NEA_RB_FIFO_STATE)
+// Mesh collider
 // =========================================================================
 //
-// Per active (non-sleeping) body, ARM7 sends 7 words:
-//
-//   Word 0: body_id (bits 7:0) | flags (bits 15:8)
-//           flags bit 0 = sleeping
-//   Word 1: position.x (f32)
-//   Word 2: position.y (f32)
-//   Word 3: position.z (f32)
-//   Word 4: transform[0] (f32)  -- rotation matrix row-major
-//   Word 5: transform[1] (f32)
-//   Word 6: transform[2] (f32)
-//   Word 7: transform[3] (f32)
-//   Word 8: transform[4] (f32)
-//   Word 9: transform[5] (f32)
-//   Word 10: transform[6] (f32)
-//   Word 11: transform[7] (f32)
-//   Word 12: transform[8] (f32)
+// NEA_RB_CMD_SET_MESH gives the ARM7 the address of the triangles and BVH of a
+// NEA_ColMesh in main RAM, which it reads directly. The counts word is
+// num_triangles | (num_nodes << 16), and px, py, pz is the position of the
+// mesh. A triangle address of 0 removes the mesh.
 //
-// A sentinel word 0xFFFFFFFF marks end of frame.
+// These structs have the same layout as NEA_ColTriangle and NEA_ColBVHNode,
+// which the ARM7 can't include.
+
+/// Triangle of a mesh collider (same layout as NEA_ColTriangle).
+typedef struct {
+    s32 v0[3], v1[3], v2[3]; ///< Vertices (f32)
+    s32 normal[3];           ///< Unit face normal (f32)
+    s32 plane_d;             ///< Distance of the plane to the origin (f32)
+    s32 center[3];           ///< Center of the bounding sphere (f32)
+    s32 radius;              ///< Radius of the bounding sphere (f32, -1 if empty)
+    s16 edge_normal[3][3];   ///< Inward normals of v0-v1, v1-v2, v2-v0 (f32)
+    s16 padding;
+} NEA_RB_MeshTriangle;
+
+/// BVH node of a mesh collider (same layout as NEA_ColBVHNode).
+typedef struct {
+    s32 min[3], max[3]; ///< Box (f32)
+    u16 first;          ///< First triangle of a leaf, or index of the second child.
+    u16 count;          ///< Number of triangles of a leaf, or 0.
+} NEA_RB_MeshNode;
+
+/// Max depth of the BVH of a mesh collider.
+#define NEA_RB_MESH_MAX_DEPTH 32
 
-#define NEA_RB_STATE_WORDS    13  ///< Words per body state packet.
-#define NEA_RB_STATE_END      0xFFFFFFFFu ///< End-of-frame sentinel.
+// =========================================================================
+// Shared state (ARM7 -> ARM9)
+// =========================================================================
+//
+// The ARM9 owns a NEA_RB_SharedState block in main RAM and sends its address
+// with NEA_RB_CMD_SET_STATE_BUFFER. After every frame the ARM7 writes the
+// state of all used bodies to buffers[seq & 1] and sends seq through
+// NEA_RB_FIFO_STATE. The ARM9 only accesses the block through the uncached
+// mirror of main RAM.
+//
+// The ARM7 writes seq before the bodies and seq_end after them. A reader that
+// sees seq_end == seq == the value announced by the FIFO, reading seq_end
+// first and seq last, has copied a buffer that the ARM7 didn't touch while it
+// was being read.
 
 #define NEA_RB_STATE_FLAG_SLEEP  (1u << 8)
 
@@ -104,4 +159,50 @@ typedef enum {
 #define NEA_RB_STATE_DECODE_ID(hdr)    ((hdr) & 0xFFu)
 #define NEA_RB_STATE_DECODE_FLAGS(hdr) ((hdr) & 0xFF00u)
 
+/// State of one body.
+typedef struct {
+    u32 hdr;          ///< body_id (bits 7:0) | flags (bits 15:8)
+    s32 position[3];  ///< Position (f32)
+    s32 rotation[9];  ///< Rotation matrix, row-major (f32)
+} NEA_RB_BodyState;
+
+/// Profile of the simulation of one frame on the ARM7.
+///
+/// Times are in ARM7 cycles (33.51 MHz). The sub-steps repeated by bisections
+/// are counted in bisect_cycles as well as in the time of each phase.
+typedef struct {
+    u32 substeps;         ///< Sub-steps run, with the ones of bisections.
+    u32 cycles;           ///< Time of all the sub-steps.
+    u32 integrate_cycles; ///< Time applying gravity and integrating.
+    u32 detect_cycles;    ///< Time of the broadphase and narrow phase.
+    u32 resolve_cycles;   ///< Time of the contact solver.
+    u32 bisect_cycles;    ///< Time of the sub-steps repeated by bisections.
+    u32 ipc_cycles;       ///< Time reading the commands of the ARM9.
+    u32 pair_tests;       ///< Body-body and body-static narrow phase tests.
+    u32 mesh_tests;       ///< Mesh triangles tested against bodies.
+    u32 contacts;         ///< Contacts found in all the sub-steps.
+    u32 max_contacts;     ///< Contacts of the sub-step with the most.
+    u32 awake;            ///< Bodies awake at the end of the frame.
+    u32 sleeping;         ///< Bodies sleeping at the end of the frame.
+} NEA_RB_Stats;
+
+/// State of all used bodies after one frame.
+typedef struct {
+    volatile u32 seq;     ///< Written before the bodies.
+    u32 count;            ///< Number of valid entries in bodies[].
+    NEA_RB_Stats stats;   ///< Profile of the frame.
+    NEA_RB_BodyState bodies[NEA_RB_MAX_BODIES];
+    volatile u32 seq_end; ///< Written after the bodies.
+} NEA_RB_StateBuffer;
+
+/// Double-buffered state block shared by both CPUs.
+///
+/// It is aligned to a cache line and its size is a multiple of it, so that no
+/// other data of the ARM9 shares its cache lines.
+typedef struct {
+    NEA_RB_StateBuffer buffers[2];
+    u32 cmd_ring[NEA_RB_CMD_RING_WORDS]; ///< Commands written by the ARM9.
+    volatile u32 cmd_tail; ///< Next ring position read by the ARM7.
+} __attribute__((aligned(32))) NEA_RB_SharedState;
+
 #endif // NEA_RB_IPC_H__
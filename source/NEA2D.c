@@ -5,15 +5,94 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAPool.h"
 
 /// @file NEA2D.c
 
-static NEA_Sprite **NEA_spritepointers = NULL;
+static ne_pool_t ne_sprite_pool;
 
 static int NEA_MAX_SPRITES;
 
 static bool ne_sprite_system_inited = false;
 
+// Visible sprites sorted by NEA_SpriteDrawAll() in batched mode
+typedef struct {
+    NEA_Sprite *sprite;
+    u32 poly_format;
+    int order; // Slot index, to make sorting stable
+} ne_sprite_batch_entry;
+
+static ne_sprite_batch_entry *ne_sprite_batch = NULL;
+static bool ne_sprite_batch_enabled = false;
+
+// Internal use... see NEAHw2D.c
+extern bool ne_hw2d_sprite_draw(const NEA_Sprite *sprite) __attribute__((weak));
+extern void NEA_Hw2DSpriteDetach(NEA_Sprite *sprite) __attribute__((weak));
+
+// Internal use... see NEATexture.c
+void ne_material_state_tex_format(u32 value);
+void ne_material_state_poly_format(u32 value);
+void ne_material_state_matrix_mode(u32 mode);
+uint32_t ne_projection_get_stamp(void);
+
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_sprite_static, NEA_Sprite, NEA_STATIC_MAX_SPRITES);
+static ne_sprite_batch_entry ne_sprite_batch_static[NEA_STATIC_MAX_SPRITES];
+#endif
+
+// Calculates the words sent to the GPU for the corners of a sprite, in the
+// order up-left, down-left, down-right and up-right. They are updated whenever
+// the canvas, size, scale or position change, so drawing a sprite that isn't
+// rotated doesn't need any calculation.
+static void ne_sprite_update_words(NEA_Sprite *sprite)
+{
+    s16 tl = inttot16(sprite->tl);
+    s16 tr = inttot16(sprite->tr);
+    s16 tt = inttot16(sprite->tt);
+    s16 tb = inttot16(sprite->tb);
+
+    sprite->texcoord[0] = TEXTURE_PACK(tl, tt);
+    sprite->texcoord[1] = TEXTURE_PACK(tl, tb);
+    sprite->texcoord[2] = TEXTURE_PACK(tr, tb);
+    sprite->texcoord[3] = TEXTURE_PACK(tr, tt);
+
+    // Apply the scale around the center of the sprite here instead of
+    // modifying the matrix, like NEA_2DViewScaleByPositionXYI() does.
+    int cx = sprite->x + (sprite->w >> 1);
+    int cy = sprite->y + (sprite->h >> 1);
+    int hw = sprite->w >> 1;
+    int hh = sprite->h >> 1;
+
+    s16 x1 = cx - ((hw * sprite->xscale) >> 12);
+    s16 x2 = cx + (((sprite->w - hw) * sprite->xscale) >> 12);
+    s16 y1 = cy - ((hh * sprite->yscale) >> 12);
+    s16 y2 = cy + (((sprite->h - hh) * sprite->yscale) >> 12);
+
+    sprite->vertex[0] = (y1 << 16) | (x1 & 0xFFFF);
+    sprite->vertex[1] = (y2 << 16) | (x1 & 0xFFFF);
+    sprite->vertex[2] = (y2 << 16) | (x2 & 0xFFFF);
+    sprite->vertex[3] = (y1 << 16) | (x2 & 0xFFFF);
+}
+
+// Sends the quad of a sprite that isn't rotated inside a GL_QUADS list
+static inline void ne_sprite_send_quad(const NEA_Sprite *sprite)
+{
+    GFX_COLOR = sprite->color;
+
+    GFX_TEX_COORD = sprite->texcoord[0];
+    GFX_VERTEX16 = sprite->vertex[0]; // Up-left
+    GFX_VERTEX16 = sprite->priority;
+
+    GFX_TEX_COORD = sprite->texcoord[1];
+    GFX_VERTEX_XY = sprite->vertex[1]; // Down-left
+
+    GFX_TEX_COORD = sprite->texcoord[2];
+    GFX_VERTEX_XY = sprite->vertex[2]; // Down-right
+
+    GFX_TEX_COORD = sprite->texcoord[3];
+    GFX_VERTEX_XY = sprite->vertex[3]; // Up-right
+}
+
 NEA_Sprite *NEA_SpriteCreate(void)
 {
     if (!ne_sprite_system_inited)
@@ -22,32 +101,32 @@ NEA_Sprite *NEA_SpriteCreate(void)
         return NULL;
     }
 
-    for (int i = 0; i < NEA_MAX_SPRITES; i++)
+    if (ne_pool_next_slot(&ne_sprite_pool) < 0)
     {
-        if (NEA_spritepointers[i] != NULL)
-            continue;
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        NEA_Sprite *sprite = calloc(1, sizeof(NEA_Sprite));
-        if (sprite == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    NEA_Sprite *sprite = ne_pool_object_alloc(&ne_sprite_pool,
+                                              sizeof(NEA_Sprite));
+    if (sprite == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        sprite->visible = true;
-        sprite->xscale = inttof32(1);
-        sprite->yscale = inttof32(1);
-        sprite->color = NEA_White;
-        sprite->mat = NULL;
-        sprite->alpha = 31;
+    sprite->visible = true;
+    sprite->xscale = inttof32(1);
+    sprite->yscale = inttof32(1);
+    sprite->color = NEA_White;
+    sprite->mat = NULL;
+    sprite->alpha = 31;
 
-        NEA_spritepointers[i] = sprite;
+    ne_sprite_update_words(sprite);
 
-        return sprite;
-    }
+    ne_pool_add(&ne_sprite_pool, sprite);
 
-    NEA_DebugPrint("No free slots");
-    return NULL;
+    return sprite;
 }
 
 void NEA_SpriteSetPos(NEA_Sprite *sprite, int x, int y)
@@ -55,6 +134,7 @@ void NEA_SpriteSetPos(NEA_Sprite *sprite, int x, int y)
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->x = x;
     sprite->y = y;
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetSize(NEA_Sprite *sprite, int w, int h)
@@ -62,6 +142,7 @@ void NEA_SpriteSetSize(NEA_Sprite *sprite, int w, int h)
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->w = w;
     sprite->h = h;
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetRot(NEA_Sprite *sprite, int angle)
@@ -75,18 +156,21 @@ void NEA_SpriteSetScaleI(NEA_Sprite *sprite, int scale)
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->xscale = scale;
     sprite->yscale = scale;
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetXScaleI(NEA_Sprite *sprite, int scale)
 {
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->xscale = scale;
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetYScaleI(NEA_Sprite *sprite, int scale)
 {
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->yscale = scale;
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetMaterial(NEA_Sprite *sprite, NEA_Material *mat)
@@ -105,6 +189,8 @@ void NEA_SpriteSetMaterial(NEA_Sprite *sprite, NEA_Material *mat)
     sprite->tr = mat_w;
     sprite->tt = 0;
     sprite->tb = mat_h;
+
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetMaterialCanvas(NEA_Sprite *sprite, int tl, int tt, int tr, int tb)
@@ -116,6 +202,8 @@ void NEA_SpriteSetMaterialCanvas(NEA_Sprite *sprite, int tl, int tt, int tr, int
     sprite->tr = tr;
     sprite->tt = tt;
     sprite->tb = tb;
+
+    ne_sprite_update_words(sprite);
 }
 
 void NEA_SpriteSetPriority(NEA_Sprite *sprite, int priority)
@@ -128,6 +216,10 @@ void NEA_SpriteVisible(NEA_Sprite *sprite, bool visible)
 {
     NEA_AssertPointer(sprite, "NULL pointer");
     sprite->visible = visible;
+
+    // Hide the hardware OBJ now in case the sprite isn't drawn again
+    if (!visible && (sprite->hw_obj != NULL))
+        ne_hw2d_sprite_draw(sprite);
 }
 
 void NEA_SpriteSetParams(NEA_Sprite *sprite, u8 alpha, u8 id, u32 color)
@@ -148,19 +240,18 @@ void NEA_SpriteDelete(NEA_Sprite *sprite)
 
     NEA_AssertPointer(sprite, "NULL pointer");
 
-    for (int i = 0; i < NEA_MAX_SPRITES; i++)
+    int slot = ne_pool_find(&ne_sprite_pool, sprite);
+    if (slot < 0)
     {
-        if (NEA_spritepointers[i] != sprite)
-            continue;
-
-        NEA_spritepointers[i] = NULL;
-        free((void *)sprite);
-
+        NEA_DebugPrint("Object not found");
         return;
     }
 
-    NEA_DebugPrint("Object not found");
-    return;
+    if (sprite->hw_obj != NULL)
+        NEA_Hw2DSpriteDetach(sprite);
+
+    ne_pool_remove(&ne_sprite_pool, slot);
+    ne_pool_object_free(&ne_sprite_pool, sprite);
 }
 
 void NEA_SpriteDeleteAll(void)
@@ -168,8 +259,12 @@ void NEA_SpriteDeleteAll(void)
     if (!ne_sprite_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_SPRITES; i++)
-        NEA_SpriteDelete(NEA_spritepointers[i]);
+    for (int i = ne_pool_count(&ne_sprite_pool) - 1; i >= 0; i--)
+    {
+        NEA_Sprite *sprite = ne_pool_get(&ne_sprite_pool, i);
+        if (sprite != NULL)
+            NEA_SpriteDelete(sprite);
+    }
 }
 
 int NEA_SpriteSystemReset(int max_sprites)
@@ -182,9 +277,17 @@ int NEA_SpriteSystemReset(int max_sprites)
     else
         NEA_MAX_SPRITES = max_sprites;
 
-    NEA_spritepointers = calloc(NEA_MAX_SPRITES, sizeof(NEA_spritepointers));
-    if (NEA_spritepointers == NULL)
+    NEA_MAX_SPRITES = NE_STATIC_CAPACITY(NEA_MAX_SPRITES,
+                                         NEA_STATIC_MAX_SPRITES);
+
+    if (NE_POOL_INIT(&ne_sprite_pool, ne_sprite_static, NEA_MAX_SPRITES) == 0)
+        return -1;
+
+    ne_sprite_batch = NE_STATIC_CALLOC(ne_sprite_batch_static, NEA_MAX_SPRITES,
+                                       sizeof(ne_sprite_batch_entry));
+    if (ne_sprite_batch == NULL)
     {
+        ne_pool_end(&ne_sprite_pool);
         NEA_DebugPrint("Not enough memory");
         return -1;
     }
@@ -200,96 +303,202 @@ void NEA_SpriteSystemEnd(void)
 
     NEA_SpriteDeleteAll();
 
-    free(NEA_spritepointers);
+    ne_pool_end(&ne_sprite_pool);
+    NE_STATIC_FREE(ne_sprite_batch_static, ne_sprite_batch);
+    ne_sprite_batch = NULL;
 
     ne_sprite_system_inited = false;
 }
 
+// Internal use... see NEAHw2D.c
+void ne_sprite_hw2d_forget(void)
+{
+    if (!ne_sprite_system_inited)
+        return;
+
+    // The OBJs have been freed by NEA_Hw2DSystemEnd()
+    for (int i = 0; i < ne_pool_count(&ne_sprite_pool); i++)
+    {
+        NEA_Sprite *sprite = ne_pool_get(&ne_sprite_pool, i);
+        if (sprite != NULL)
+            sprite->hw_obj = NULL;
+    }
+}
+
+// Draws a sprite that uses the 3D hardware
+static void ne_sprite_draw(const NEA_Sprite *sprite)
+{
+    NEA_AssertPointer(sprite->mat, "NULL pointer");
+    NEA_Assert(sprite->mat->texindex != NEA_NO_TEXTURE, "No texture");
+
+    ne_material_state_poly_format(POLY_ALPHA(sprite->alpha) |
+                                  POLY_ID(sprite->id) | NEA_CULL_NONE);
+
+    if (sprite->rot_angle == 0)
+    {
+        NEA_MaterialUse(sprite->mat);
+        GFX_BEGIN = GL_QUADS;
+        ne_sprite_send_quad(sprite);
+        return;
+    }
+
+    // The scale is applied after the rotation, so rotated sprites can't use
+    // the precalculated corners.
+    MATRIX_PUSH = 0;
+
+    NEA_2DViewRotateScaleByPositionXYI(sprite->x + (sprite->w >> 1),
+                                       sprite->y + (sprite->h >> 1),
+                                       sprite->rot_angle,
+                                       sprite->xscale, sprite->yscale);
+
+    NEA_2DDrawTexturedQuadColorCanvas(sprite->x, sprite->y,
+                                      sprite->x + sprite->w,
+                                      sprite->y + sprite->h,
+                                      sprite->priority,
+                                      sprite->tl, sprite->tt,
+                                      sprite->tr, sprite->tb,
+                                      sprite->mat, sprite->color);
+
+    MATRIX_POP = 1;
+}
+
 void NEA_SpriteDraw(const NEA_Sprite *sprite)
 {
+    NEA_DisplayListWait();
+
     if (!ne_sprite_system_inited)
         return;
 
     NEA_AssertPointer(sprite, "NULL pointer");
 
+    if ((sprite->hw_obj != NULL) && ne_hw2d_sprite_draw(sprite))
+        return;
+
     if (!sprite->visible)
         return;
 
-    if (sprite->rot_angle)
-    {
-        MATRIX_PUSH = 0;
+    ne_sprite_draw(sprite);
+}
 
-        NEA_2DViewRotateScaleByPositionXYI(sprite->x + (sprite->w >> 1),
-                                        sprite->y + (sprite->h >> 1),
-                                        sprite->rot_angle,
-                                        sprite->xscale, sprite->yscale);
-    }
-    else
+void NEA_SpriteSetBatchMode(bool enable)
+{
+    ne_sprite_batch_enabled = enable;
+}
+
+static int ne_sprite_batch_compare(const void *a, const void *b)
+{
+    const ne_sprite_batch_entry *ea = a;
+    const ne_sprite_batch_entry *eb = b;
+
+    // Low priority values are drawn over high priority values
+    if (ea->sprite->priority != eb->sprite->priority)
+        return (ea->sprite->priority > eb->sprite->priority) ? -1 : 1;
+
+    if (ea->sprite->mat != eb->sprite->mat)
     {
-        NEA_2DViewScaleByPositionXYI(sprite->x + (sprite->w >> 1),
-                                  sprite->y + (sprite->h >> 1),
-                                  sprite->xscale, sprite->yscale);
+        return ((uintptr_t)ea->sprite->mat < (uintptr_t)eb->sprite->mat) ?
+               -1 : 1;
     }
 
-    GFX_POLY_FORMAT = POLY_ALPHA(sprite->alpha) | POLY_ID(sprite->id) |
-                      NEA_CULL_NONE;
-
-    NEA_2DDrawTexturedQuadColorCanvas(sprite->x, sprite->y,
-                                     sprite->x + sprite->w,
-                                     sprite->y + sprite->h,
-                                     sprite->priority,
-                                     sprite->tl, sprite->tt,
-                                     sprite->tr, sprite->tb,
-                                     sprite->mat, sprite->color);
+    if (ea->poly_format != eb->poly_format)
+        return (ea->poly_format < eb->poly_format) ? -1 : 1;
 
-    if (sprite->rot_angle)
-        MATRIX_POP = 1;
+    return ea->order - eb->order;
 }
 
-void NEA_SpriteDrawAll(void)
+static void ne_sprite_draw_all_batched(void)
 {
-    if (!ne_sprite_system_inited)
-        return;
+    int count = 0;
 
-    for (int i = 0; i < NEA_MAX_SPRITES; i++)
+    for (int i = 0; i < ne_pool_count(&ne_sprite_pool); i++)
     {
-        if (NEA_spritepointers[i] == NULL)
+        NEA_Sprite *sprite = ne_pool_get(&ne_sprite_pool, i);
+
+        if (sprite == NULL)
             continue;
 
-        NEA_Sprite *sprite = NEA_spritepointers[i];
+        if ((sprite->hw_obj != NULL) && ne_hw2d_sprite_draw(sprite))
+            continue;
 
         if (!sprite->visible)
             continue;
 
+        ne_sprite_batch_entry *entry = &ne_sprite_batch[count++];
+        entry->sprite = sprite;
+        entry->poly_format = POLY_ALPHA(sprite->alpha) | POLY_ID(sprite->id) |
+                             NEA_CULL_NONE;
+        entry->order = ne_pool_slot(&ne_sprite_pool, i);
+    }
+
+    if (count == 0)
+        return;
+
+    qsort(ne_sprite_batch, count, sizeof(ne_sprite_batch_entry),
+          ne_sprite_batch_compare);
+
+    // A new quad list is started whenever the material or the polygon format
+    // change, or after a rotated sprite has been drawn with its own matrix.
+    const NEA_Material *cur_mat = NULL;
+    u32 cur_format = 0;
+    bool in_batch = false;
+
+    for (int i = 0; i < count; i++)
+    {
+        const NEA_Sprite *sprite = ne_sprite_batch[i].sprite;
+        u32 format = ne_sprite_batch[i].poly_format;
+
         if (sprite->rot_angle)
         {
-            MATRIX_PUSH = 0;
-
-            NEA_2DViewRotateScaleByPositionXYI(sprite->x + (sprite->w >> 1),
-                                            sprite->y + (sprite->h >> 1),
-                                            sprite->rot_angle,
-                                            sprite->xscale, sprite->yscale);
+            ne_sprite_draw(sprite);
+            in_batch = false;
+            continue;
         }
-        else
+
+        if (!in_batch || (sprite->mat != cur_mat) || (format != cur_format))
         {
-            NEA_2DViewScaleByPositionXYI(sprite->x + (sprite->w >> 1),
-                                      sprite->y + (sprite->h >> 1),
-                                      sprite->xscale, sprite->yscale);
+            NEA_AssertPointer(sprite->mat, "NULL pointer");
+            NEA_Assert(sprite->mat->texindex != NEA_NO_TEXTURE, "No texture");
+
+            ne_material_state_poly_format(format);
+            NEA_MaterialUse(sprite->mat);
+            GFX_BEGIN = GL_QUADS;
+
+            cur_mat = sprite->mat;
+            cur_format = format;
+            in_batch = true;
         }
 
-        GFX_POLY_FORMAT = POLY_ALPHA(sprite->alpha) |
-                          POLY_ID(sprite->id) | NEA_CULL_NONE;
+        ne_sprite_send_quad(sprite);
+    }
+}
 
-        NEA_2DDrawTexturedQuadColorCanvas(sprite->x, sprite->y,
-                                         sprite->x + sprite->w,
-                                         sprite->y + sprite->h,
-                                         sprite->priority,
-                                         sprite->tl, sprite->tt,
-                                         sprite->tr, sprite->tb,
-                                         sprite->mat, sprite->color);
+void NEA_SpriteDrawAll(void)
+{
+    NEA_DisplayListWait();
 
-        if (sprite->rot_angle)
-            MATRIX_POP = 1;
+    if (!ne_sprite_system_inited)
+        return;
+
+    if (ne_sprite_batch_enabled)
+    {
+        ne_sprite_draw_all_batched();
+        return;
+    }
+
+    for (int i = 0; i < ne_pool_count(&ne_sprite_pool); i++)
+    {
+        NEA_Sprite *sprite = ne_pool_get(&ne_sprite_pool, i);
+
+        if (sprite == NULL)
+            continue;
+
+        if ((sprite->hw_obj != NULL) && ne_hw2d_sprite_draw(sprite))
+            continue;
+
+        if (!sprite->visible)
+            continue;
+
+        ne_sprite_draw(sprite);
     }
 }
 
@@ -306,8 +515,13 @@ int __NEA_TextureGetRawY(const NEA_Material *tex);
 
 //--------------------------------------------
 
+// Value of the projection stamp after NEA_2DViewInit() set the 2D projection
+static uint32_t ne_2d_view_stamp = UINT32_MAX;
+
 void NEA_2DViewInit(void)
 {
+    NEA_DisplayListWait();
+
     GFX_VIEWPORT = 0 | (0 << 8) | (255 << 16) | (191 << 24);
 
     // The projection matrix actually thinks that the size of the DS is
@@ -337,14 +551,22 @@ void NEA_2DViewInit(void)
     // In my tests, Y axis distortion starts to happen with a factor of 4, so a
     // factor of 2 should be safe and reduce enough flickering.
 
-    MATRIX_CONTROL = GL_PROJECTION;
-    MATRIX_IDENTITY = 0;
-
     int factor = 2;
 
-    glOrthof32(0, 256 << factor, 192 << factor, 0, inttof32(1), inttof32(-1));
+    // The projection is only set again if something may have modified it
+    // since the last call, which is usually the case only once per frame.
+    if (ne_2d_view_stamp != ne_projection_get_stamp())
+    {
+        ne_material_state_matrix_mode(GL_PROJECTION);
+        MATRIX_IDENTITY = 0;
+
+        glOrthof32(0, 256 << factor, 192 << factor, 0,
+                   inttof32(1), inttof32(-1));
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+        ne_2d_view_stamp = ne_projection_get_stamp();
+    }
+
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_IDENTITY = 0;
 
     MATRIX_SCALE = inttof32(1 << factor);
@@ -397,9 +619,11 @@ void NEA_2DViewRotateScaleByPositionI(int x, int y, int rotz, int scale) {
 
 void NEA_2DDrawQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z, u32 color)
 {
+    NEA_DisplayListWait();
+
     GFX_BEGIN = GL_QUADS;
 
-    GFX_TEX_FORMAT = 0;
+    ne_material_state_tex_format(0);
 
     GFX_COLOR = color;
 
@@ -416,9 +640,11 @@ void NEA_2DDrawQuad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z, u32 color)
 void NEA_2DDrawQuadGradient(s16 x1, s16 y1, s16 x2, s16 y2, s16 z, u32 color1,
                            u32 color2, u32 color3, u32 color4)
 {
+    NEA_DisplayListWait();
+
     GFX_BEGIN = GL_QUADS;
 
-    GFX_TEX_FORMAT = 0;
+    ne_material_state_tex_format(0);
 
     GFX_COLOR = color1;
     GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
@@ -8,8 +8,136 @@
 
 #include "NEAMain.h"
 #include "NEAAlloc.h"
+#include "NEAStats.h"
+
+// Number of size classes. Class N holds free chunks with a size between
+// NEA_ALLOC_MIN_SIZE << N and (NEA_ALLOC_MIN_SIZE << (N + 1)) - 1.
+#define NEA_ALLOC_CLASSES 32
+
+// Limits of the number of buckets of the hash table of chunks
+#define NEA_ALLOC_HASH_MIN_BITS 4
+#define NEA_ALLOC_HASH_MAX_BITS 10
+
+typedef struct NEAAllocIndex {
+    NEAChunk *free_list[NEA_ALLOC_CLASSES];
+    uint32_t free_mask; // Bit N is set if free_list[N] isn't empty
+    NEAChunk **hash;
+    unsigned int hash_bits;
+} NEAAllocIndex;
+
+static size_t ne_chunk_size(const NEAChunk *chunk)
+{
+    return (uintptr_t)chunk->end - (uintptr_t)chunk->start;
+}
+
+// Returns the size class of a size (which must be at least NEA_ALLOC_MIN_SIZE)
+static unsigned int ne_size_class(size_t size)
+{
+    return 31 - __builtin_clz(size / NEA_ALLOC_MIN_SIZE);
+}
+
+static unsigned int ne_hash_bucket(const NEAAllocIndex *index, void *address)
+{
+    uint32_t key = (uintptr_t)address / NEA_ALLOC_MIN_SIZE;
+
+    // Fibonacci hashing
+    return (key * 2654435761U) >> (32 - index->hash_bits);
+}
+
+static void ne_hash_add(NEAAllocIndex *index, NEAChunk *chunk)
+{
+    if (index == NULL)
+        return;
+
+    unsigned int bucket = ne_hash_bucket(index, chunk->start);
+
+    chunk->hash_next = index->hash[bucket];
+    index->hash[bucket] = chunk;
+}
+
+static void ne_hash_remove(NEAAllocIndex *index, NEAChunk *chunk)
+{
+    if (index == NULL)
+        return;
+
+    NEAChunk **link = &index->hash[ne_hash_bucket(index, chunk->start)];
+
+    while (*link != NULL)
+    {
+        if (*link == chunk)
+        {
+            *link = chunk->hash_next;
+            return;
+        }
+
+        link = &(*link)->hash_next;
+    }
+
+    NEA_Assert(0, "Chunk not found in hash table");
+}
+
+// Returns the chunk that starts at the provided address, or NULL.
+static NEAChunk *ne_hash_find(const NEAAllocIndex *index, void *address)
+{
+    NEAChunk *this = index->hash[ne_hash_bucket(index, address)];
+
+    for ( ; this != NULL; this = this->hash_next)
+    {
+        if (this->start == address)
+            return this;
+    }
+
+    return NULL;
+}
+
+// Adds a free chunk to the free list of its size class
+static void ne_free_list_add(NEAAllocIndex *index, NEAChunk *chunk)
+{
+    if (index == NULL)
+        return;
+
+    NEA_Assert(chunk->state == NEA_STATE_FREE, "Chunk isn't free");
+
+    unsigned int class = ne_size_class(ne_chunk_size(chunk));
+    NEAChunk *head = index->free_list[class];
+
+    chunk->free_previous = NULL;
+    chunk->free_next = head;
+    if (head != NULL)
+        head->free_previous = chunk;
+
+    index->free_list[class] = chunk;
+    index->free_mask |= 1U << class;
+}
+
+// Removes a free chunk from the free list of its size class. It must be called
+// before changing the size or state of the chunk.
+static void ne_free_list_remove(NEAAllocIndex *index, NEAChunk *chunk)
+{
+    if (index == NULL)
+        return;
+
+    unsigned int class = ne_size_class(ne_chunk_size(chunk));
+
+    if (chunk->free_previous != NULL)
+        chunk->free_previous->free_next = chunk->free_next;
+    else
+        index->free_list[class] = chunk->free_next;
+
+    if (chunk->free_next != NULL)
+        chunk->free_next->free_previous = chunk->free_previous;
+
+    if (index->free_list[class] == NULL)
+        index->free_mask &= ~(1U << class);
+}
 
 int NEA_AllocInit(NEAChunk **first_chunk, void *start, void *end)
+{
+    return NEA_AllocInitMode(first_chunk, start, end, NEA_ALLOC_LIST);
+}
+
+int NEA_AllocInitMode(NEAChunk **first_chunk, void *start, void *end,
+                     ne_alloc_mode mode)
 {
     if (first_chunk == NULL)
     {
@@ -35,8 +163,41 @@ int NEA_AllocInit(NEAChunk **first_chunk, void *start, void *end)
     (*first_chunk)->start = start;
     (*first_chunk)->end = end;
     (*first_chunk)->next = NULL;
+    (*first_chunk)->index = NULL;
+
+    if (mode == NEA_ALLOC_LIST)
+        return 0;
+
+    NEAAllocIndex *index = calloc(1, sizeof(NEAAllocIndex));
+    if (index == NULL)
+        goto cleanup;
+
+    // Aim for one bucket per 1 KB of memory
+    size_t size = (uintptr_t)end - (uintptr_t)start;
+    unsigned int bits = NEA_ALLOC_HASH_MIN_BITS;
+    while ((bits < NEA_ALLOC_HASH_MAX_BITS) && ((size >> (bits + 10)) > 0))
+        bits++;
+
+    index->hash_bits = bits;
+    index->hash = calloc(1U << bits, sizeof(NEAChunk *));
+    if (index->hash == NULL)
+    {
+        free(index);
+        goto cleanup;
+    }
+
+    (*first_chunk)->index = index;
+
+    ne_hash_add(index, *first_chunk);
+    ne_free_list_add(index, *first_chunk);
 
     return 0;
+
+cleanup:
+    NEA_DebugPrint("Not enough memory");
+    free(*first_chunk);
+    *first_chunk = NULL;
+    return -3;
 }
 
 int NEA_AllocEnd(NEAChunk **first_chunk)
@@ -49,6 +210,12 @@ int NEA_AllocEnd(NEAChunk **first_chunk)
 
     NEAChunk *this = *first_chunk;
 
+    if ((this != NULL) && (this->index != NULL))
+    {
+        free(this->index->hash);
+        free(this->index);
+    }
+
     while (this != NULL)
     {
         NEAChunk *next = this->next;
@@ -71,8 +238,10 @@ int NEA_AllocEnd(NEAChunk **first_chunk)
 // | THIS |   NEW    | NEXT |  After
 // +------+----------+------+
 //
-// It returns a pointer to the new chunk.
-static NEAChunk *ne_split_chunk(NEAChunk *this, size_t this_size)
+// It returns a pointer to the new chunk. The state of the new chunk isn't set,
+// and free chunks must be removed from their free list before calling this.
+static NEAChunk *ne_split_chunk(NEAAllocIndex *index, NEAChunk *this,
+                                size_t this_size)
 {
     NEA_AssertPointer(this, "NULL pointer");
 
@@ -113,6 +282,9 @@ static NEAChunk *ne_split_chunk(NEAChunk *this, size_t this_size)
     new->end = this->end;
     this->end = (void *)((uintptr_t)this->start + this_size);
     new->start = this->end;
+    new->index = NULL;
+
+    ne_hash_add(index, new);
 
     return new;
 }
@@ -124,6 +296,14 @@ static NEAChunk *ne_search_address(NEAChunk *first_chunk, void *address)
 {
     NEA_AssertPointer(first_chunk, "NULL pointer");
 
+    // Most of the time the address is the start of a chunk
+    if (first_chunk->index != NULL)
+    {
+        NEAChunk *chunk = ne_hash_find(first_chunk->index, address);
+        if (chunk != NULL)
+            return chunk;
+    }
+
     NEAChunk *this = first_chunk;
 
     uintptr_t addr = (uintptr_t)address;
@@ -145,8 +325,82 @@ static NEAChunk *ne_search_address(NEAChunk *first_chunk, void *address)
     return NULL;
 }
 
+// This returns a pointer to the chunk that starts at the provided address, or
+// NULL if there isn't any.
+static NEAChunk *ne_search_start(NEAChunk *first_chunk, void *address)
+{
+    if (first_chunk->index != NULL)
+        return ne_hash_find(first_chunk->index, address);
+
+    for (NEAChunk *this = first_chunk; this != NULL; this = this->next)
+    {
+        if (this->start == address)
+            return this;
+    }
+
+    return NULL;
+}
+
+// Returns a free chunk that is at least as big as the provided size, or NULL.
+static NEAChunk *ne_search_free_class(NEAAllocIndex *index, size_t size)
+{
+    unsigned int class = ne_size_class(size);
+
+    // All chunks in the classes above this one are big enough. If the size is
+    // the minimum size of its class, all chunks in its class are big enough too.
+    uint32_t mask;
+    if (size == ((size_t)NEA_ALLOC_MIN_SIZE << class))
+        mask = ~((1U << class) - 1);
+    else
+        mask = (class == NEA_ALLOC_CLASSES - 1) ? 0 : ~((2U << class) - 1);
+
+    mask &= index->free_mask;
+    if (mask != 0)
+        return index->free_list[__builtin_ctz(mask)];
+
+    // Only chunks of the same class are left, and they may be too small
+    NEAChunk *this = index->free_list[class];
+    for ( ; this != NULL; this = this->free_next)
+    {
+        if (ne_chunk_size(this) >= size)
+            return this;
+    }
+
+    return NULL;
+}
+
+// Returns the free chunk with the highest address that is at least as big as
+// the provided size, or NULL. Only the free chunks of the size classes that may
+// be big enough are checked.
+static NEAChunk *ne_search_free_highest(NEAAllocIndex *index, size_t size)
+{
+    NEAChunk *best = NULL;
+
+    uint32_t mask = index->free_mask & ~((1U << ne_size_class(size)) - 1);
+
+    while (mask != 0)
+    {
+        unsigned int class = __builtin_ctz(mask);
+        mask &= ~(1U << class);
+
+        NEAChunk *this = index->free_list[class];
+        for ( ; this != NULL; this = this->free_next)
+        {
+            if (ne_chunk_size(this) < size)
+                continue;
+
+            if ((best == NULL) || (this->start > best->start))
+                best = this;
+        }
+    }
+
+    return best;
+}
+
 void *NEA_AllocFindInRange(NEAChunk *first_chunk, void *start, void *end, size_t size)
 {
+    NE_STAT_ADD(alloc_calls, 1);
+
     if ((first_chunk == NULL) || (start == NULL) || (end == NULL) || (size == 0))
     {
         NEA_DebugPrint("Invalid arguments");
@@ -227,6 +481,8 @@ static NEAChunk *ne_search_free_range_chunk(NEAChunk *first_chunk,
 
 int NEA_AllocAddress(NEAChunk *first_chunk, void *address, size_t size)
 {
+    NE_STAT_ADD(alloc_calls, 1);
+
     if ((first_chunk == NULL) || (address == NULL) || (size == 0))
     {
         NEA_DebugPrint("Invalid arguments");
@@ -245,6 +501,10 @@ int NEA_AllocAddress(NEAChunk *first_chunk, void *address, size_t size)
     if (this == NULL)
         return -2;
 
+    NEAAllocIndex *index = first_chunk->index;
+
+    ne_free_list_remove(index, this);
+
     uintptr_t alloc_start = (uintptr_t)address;
     uintptr_t alloc_end = alloc_start + size;
 
@@ -267,7 +527,12 @@ int NEA_AllocAddress(NEAChunk *first_chunk, void *address, size_t size)
     {
         // Split this chunk into two, ignore the first one and get the second
         // one (which contains the start address)
-        this = ne_split_chunk(this, alloc_start - this_start);
+        NEAChunk *prev = this;
+        this = ne_split_chunk(index, prev, alloc_start - this_start);
+
+        // The first one stays free in both cases
+        ne_free_list_add(index, prev);
+
         if (this == NULL)
             return -3;
 
@@ -285,16 +550,24 @@ int NEA_AllocAddress(NEAChunk *first_chunk, void *address, size_t size)
     {
         // Split this chunk into two as well. The first one is the final desired
         // chunk, the second one is more free space.
-        NEAChunk *next = ne_split_chunk(this, size);
+        NEAChunk *next = ne_split_chunk(index, this, size);
         if (next == NULL)
         {
             if (this_is_modified)
+            {
                 NEA_Free(first_chunk, this);
+            }
+            else
+            {
+                this->state = NEA_STATE_FREE;
+                ne_free_list_add(index, this);
+            }
 
             return -4;
         }
 
         next->state = NEA_STATE_FREE;
+        ne_free_list_add(index, next);
 
         // Only the end has changed
         this_end = (uintptr_t)this->end;
@@ -310,6 +583,8 @@ int NEA_AllocAddress(NEAChunk *first_chunk, void *address, size_t size)
 
 void *NEA_Alloc(NEAChunk *first_chunk, size_t size)
 {
+    NE_STAT_ADD(alloc_calls, 1);
+
     if ((first_chunk == NULL) || (size == 0))
     {
         NEA_DebugPrint("Invalid arguments");
@@ -321,7 +596,13 @@ void *NEA_Alloc(NEAChunk *first_chunk, size_t size)
     if ((size & mask) != 0)
         size += NEA_ALLOC_MIN_SIZE - (size & mask);
 
-    NEAChunk *this = first_chunk;
+    NEAAllocIndex *index = first_chunk->index;
+
+    NEAChunk *this;
+    if (index != NULL)
+        this = ne_search_free_class(index, size);
+    else
+        this = first_chunk;
 
     for ( ; this != NULL; this = this->next)
     {
@@ -335,6 +616,8 @@ void *NEA_Alloc(NEAChunk *first_chunk, size_t size)
         if (this_size < size)
             continue;
 
+        ne_free_list_remove(index, this);
+
         // If we have exactly the space requested, we're done.
         if (this_size == size)
         {
@@ -352,13 +635,17 @@ void *NEA_Alloc(NEAChunk *first_chunk, size_t size)
         // +------+----------+------+  After
         // | USED | NOT USED | USED |
 
-        NEAChunk *new = ne_split_chunk(this, size);
+        NEAChunk *new = ne_split_chunk(index, this, size);
         if (new == NULL)
+        {
+            ne_free_list_add(index, this);
             return NULL;
+        }
 
         // Flag this chunk as used and the new one as free
         this->state = NEA_STATE_USED;
         new->state = NEA_STATE_FREE;
+        ne_free_list_add(index, new);
 
         return this->start;
     }
@@ -369,6 +656,8 @@ void *NEA_Alloc(NEAChunk *first_chunk, size_t size)
 
 void *NEA_AllocFromEnd(NEAChunk *first_chunk, size_t size)
 {
+    NE_STAT_ADD(alloc_calls, 1);
+
     if ((first_chunk == NULL) || (size == 0))
     {
         NEA_DebugPrint("Invalid arguments");
@@ -380,10 +669,21 @@ void *NEA_AllocFromEnd(NEAChunk *first_chunk, size_t size)
     if ((size & mask) != 0)
         size += NEA_ALLOC_MIN_SIZE - (size & mask);
 
-    // Find last chunk
-    NEAChunk *this = first_chunk;
-    while (this->next != NULL)
-        this = this->next;
+    NEAAllocIndex *index = first_chunk->index;
+
+    NEAChunk *this;
+    if (index != NULL)
+    {
+        // The loop below only runs once, with the right chunk or NULL
+        this = ne_search_free_highest(index, size);
+    }
+    else
+    {
+        // Find last chunk
+        this = first_chunk;
+        while (this->next != NULL)
+            this = this->next;
+    }
 
     // Traverse list from end to beginning
     for ( ; this != NULL; this = this->previous)
@@ -398,6 +698,8 @@ void *NEA_AllocFromEnd(NEAChunk *first_chunk, size_t size)
         if (this_size < size)
             continue;
 
+        ne_free_list_remove(index, this);
+
         // If we have exactly the space requested, we're done.
         if (this_size == size)
         {
@@ -417,7 +719,11 @@ void *NEA_AllocFromEnd(NEAChunk *first_chunk, size_t size)
 
         // The size of this chunk has to be the current one minus the requested
         // size for the new chunk.
-        NEAChunk *new = ne_split_chunk(this, this_size - size);
+        NEAChunk *new = ne_split_chunk(index, this, this_size - size);
+
+        // This chunk stays free, but its size has changed
+        ne_free_list_add(index, this);
+
         if (new == NULL)
             return NULL;
 
@@ -433,27 +739,19 @@ void *NEA_AllocFromEnd(NEAChunk *first_chunk, size_t size)
 
 int NEA_Free(NEAChunk *first_chunk, void *pointer)
 {
+    NE_STAT_ADD(alloc_calls, 1);
+
     if (first_chunk == NULL)
     {
         NEA_DebugPrint("Invalid arguments");
         return -1;
     }
 
-    NEAChunk *this = first_chunk;
-
-    // Look for the chunk that corresponds to the given pointer
-    while (1)
-    {
-        // Check if we have reached the end without finding the chunk
-        if (this == NULL)
-            return -2;
-
-        // If this is the chunk we're looking for, exit loop
-        if (this->start == pointer)
-            break;
+    NEAAllocIndex *index = first_chunk->index;
 
-        this = this->next;
-    }
+    NEAChunk *this = ne_search_start(first_chunk, pointer);
+    if (this == NULL)
+        return -2;
 
     // If the specified chunk is free or locked, it can't be freed.
     if (this->state != NEA_STATE_USED)
@@ -470,6 +768,9 @@ int NEA_Free(NEAChunk *first_chunk, void *pointer)
     // Check the previous one
     if (previous && previous->state == NEA_STATE_FREE)
     {
+        ne_free_list_remove(index, previous);
+        ne_hash_remove(index, this);
+
         // We can join them
         //
         // | PREVIOUS |   THIS   | NEXT |
@@ -504,6 +805,9 @@ int NEA_Free(NEAChunk *first_chunk, void *pointer)
     // Check the next one
     if (next && next->state == NEA_STATE_FREE)
     {
+        ne_free_list_remove(index, next);
+        ne_hash_remove(index, next);
+
         // We can join them
         //
         // |   THIS   |   NEXT   | NEXT NEXT |
@@ -539,6 +843,8 @@ int NEA_Free(NEAChunk *first_chunk, void *pointer)
         free(next);
     }
 
+    ne_free_list_add(index, this);
+
     return 0;
 }
 
@@ -550,26 +856,18 @@ int NEA_Lock(NEAChunk *first_chunk, void *pointer)
         return -1;
     }
 
-    NEAChunk *this = first_chunk;
-
-    while (1)
-    {
-        if (this->start == pointer)
-        {
-            // Check if we are trying to lock a chunk that isn't in use
-            if (this->state != NEA_STATE_USED)
-                return -2;
+    NEAChunk *this = ne_search_start(first_chunk, pointer);
 
-            this->state = NEA_STATE_LOCKED;
-            return 0;
-        }
+    // Couldn't find a chunk at the specified address
+    if (this == NULL)
+        return -3;
 
-        // Couldn't find a chunk at the specified address
-        if (this->next == NULL)
-            return -3;
+    // Check if we are trying to lock a chunk that isn't in use
+    if (this->state != NEA_STATE_USED)
+        return -2;
 
-        this = this->next;
-    }
+    this->state = NEA_STATE_LOCKED;
+    return 0;
 }
 
 int NEA_Unlock(NEAChunk *first_chunk, void *pointer)
@@ -580,26 +878,18 @@ int NEA_Unlock(NEAChunk *first_chunk, void *pointer)
         return -1;
     }
 
-    NEAChunk *this = first_chunk;
-
-    while (1)
-    {
-        if (this->start == pointer)
-        {
-            // Check if we are trying to unlock a chunk that isn't locked
-            if (this->state != NEA_STATE_LOCKED)
-                return -2;
+    NEAChunk *this = ne_search_start(first_chunk, pointer);
 
-            this->state = NEA_STATE_USED;
-            return 0;
-        }
+    // Couldn't find a chunk at the specified address
+    if (this == NULL)
+        return -3;
 
-        // Couldn't find a chunk at the specified address
-        if (this->next == NULL)
-            return -3;
+    // Check if we are trying to unlock a chunk that isn't locked
+    if (this->state != NEA_STATE_LOCKED)
+        return -2;
 
-        this = this->next;
-    }
+    this->state = NEA_STATE_USED;
+    return 0;
 }
 
 int NEA_MemGetInformation(NEAChunk *first_chunk, NEAMemInfo *info)
@@ -644,3 +934,56 @@ int NEA_MemGetInformation(NEAChunk *first_chunk, NEAMemInfo *info)
     info->free_percent = (info->free * 100) / info->total;
     return 0;
 }
+
+int NEA_AllocGetReport(NEAChunk *first_chunk, NEA_MemReport *report)
+{
+    if ((first_chunk == NULL) || (report == NULL))
+    {
+        NEA_DebugPrint("Invalid arguments");
+        return -1;
+    }
+
+    memset(report, 0, sizeof(NEA_MemReport));
+
+    for (NEAChunk *this = first_chunk; this != NULL; this = this->next)
+    {
+        size_t size = ne_chunk_size(this);
+
+        switch (this->state)
+        {
+            case NEA_STATE_FREE:
+            {
+                report->free += size;
+                report->free_blocks++;
+                if (size > report->largest_free)
+                    report->largest_free = size;
+
+                unsigned int class = ne_size_class(size);
+                if (class >= NEA_MEM_HISTOGRAM_SIZE)
+                    class = NEA_MEM_HISTOGRAM_SIZE - 1;
+                report->histogram[class]++;
+                break;
+            }
+            case NEA_STATE_USED:
+                report->used += size;
+                report->used_blocks++;
+                break;
+            case NEA_STATE_LOCKED:
+                report->locked += size;
+                break;
+            default:
+                return -2;
+        }
+    }
+
+    report->total = report->free + report->used;
+    report->owner[NEA_MEM_OWNER_OTHER] = report->used;
+
+    if (report->free > 0)
+    {
+        report->fragmentation = ((report->free - report->largest_free) * 100)
+                                / report->free;
+    }
+
+    return 0;
+}
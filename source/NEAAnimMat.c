@@ -5,6 +5,8 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAPool.h"
+#include "NEATCM.h"
 
 /// @file NEAAnimMat.c
 
@@ -12,10 +14,15 @@
 // Pool management
 // =========================================================================
 
-static NEA_AnimMatInstance **NEA_AnimMatPointers = NULL;
+static ne_pool_t ne_animmat_pool;
 static int NEA_MAX_ANIMMAT = 0;
 static bool ne_animmat_system_inited = false;
 
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_animmat_static, NEA_AnimMatInstance,
+                      NEA_STATIC_MAX_ANIMMAT);
+#endif
+
 // =========================================================================
 // Binary format header
 // =========================================================================
@@ -50,9 +57,11 @@ int NEA_AnimMatSystemReset(int max_instances)
     else
         NEA_MAX_ANIMMAT = max_instances;
 
-    NEA_AnimMatPointers = calloc(NEA_MAX_ANIMMAT,
-                                 sizeof(NEA_AnimMatInstance *));
-    if (NEA_AnimMatPointers == NULL)
+    NEA_MAX_ANIMMAT = NE_STATIC_CAPACITY(NEA_MAX_ANIMMAT,
+                                         NEA_STATIC_MAX_ANIMMAT);
+
+    if (NE_POOL_INIT(&ne_animmat_pool, ne_animmat_static,
+                     NEA_MAX_ANIMMAT) == 0)
     {
         NEA_DebugPrint("Not enough memory for animmat pool");
         return -1;
@@ -67,17 +76,13 @@ void NEA_AnimMatSystemEnd(void)
     if (!ne_animmat_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_ANIMMAT; i++)
+    for (int i = 0; i < ne_pool_count(&ne_animmat_pool); i++)
     {
-        if (NEA_AnimMatPointers[i] != NULL)
-        {
-            free(NEA_AnimMatPointers[i]);
-            NEA_AnimMatPointers[i] = NULL;
-        }
+        ne_pool_object_free(&ne_animmat_pool,
+                            ne_pool_get(&ne_animmat_pool, i));
     }
 
-    free(NEA_AnimMatPointers);
-    NEA_AnimMatPointers = NULL;
+    ne_pool_end(&ne_animmat_pool);
     NEA_MAX_ANIMMAT = 0;
     ne_animmat_system_inited = false;
 }
@@ -177,6 +182,7 @@ void NEA_AnimMatDataFree(NEA_AnimMatData *data)
     if (data->_loaded_from_fat && data->_base_data != NULL)
         free(data->_base_data);
 
+    free(data->_baked_data);
     free(data);
 }
 
@@ -192,34 +198,29 @@ NEA_AnimMatInstance *NEA_AnimMatCreate(void)
         return NULL;
     }
 
-    NEA_AnimMatInstance *inst = calloc(1, sizeof(NEA_AnimMatInstance));
+    NEA_AnimMatInstance *inst = ne_pool_object_alloc(&ne_animmat_pool,
+                                                  sizeof(NEA_AnimMatInstance));
     if (inst == NULL)
     {
         NEA_DebugPrint("Not enough memory");
         return NULL;
     }
 
-    // Find free pool slot
-    for (int i = 0; i < NEA_MAX_ANIMMAT; i++)
+    if (ne_pool_add(&ne_animmat_pool, inst) < 0)
     {
-        if (NEA_AnimMatPointers[i] == NULL)
-        {
-            NEA_AnimMatPointers[i] = inst;
-
-            // Sensible defaults
-            inst->base_alpha = 31;
-            inst->base_polyid = 0;
-            inst->base_lights = NEA_LIGHT_0;
-            inst->base_culling = NEA_CULL_BACK;
-            inst->base_other = 0;
-
-            return inst;
-        }
+        NEA_DebugPrint("No free animmat slots");
+        ne_pool_object_free(&ne_animmat_pool, inst);
+        return NULL;
     }
 
-    NEA_DebugPrint("No free animmat slots");
-    free(inst);
-    return NULL;
+    // Sensible defaults
+    inst->base_alpha = 31;
+    inst->base_polyid = 0;
+    inst->base_lights = NEA_LIGHT_0;
+    inst->base_culling = NEA_CULL_BACK;
+    inst->base_other = 0;
+
+    return inst;
 }
 
 void NEA_AnimMatDelete(NEA_AnimMatInstance *inst)
@@ -230,16 +231,23 @@ void NEA_AnimMatDelete(NEA_AnimMatInstance *inst)
     if (!ne_animmat_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_ANIMMAT; i++)
+    int slot = ne_pool_find(&ne_animmat_pool, inst);
+    if (slot < 0)
     {
-        if (NEA_AnimMatPointers[i] == inst)
-        {
-            NEA_AnimMatPointers[i] = NULL;
-            break;
-        }
+        NEA_DebugPrint("Instance not found");
+        return;
+    }
+
+    ne_pool_remove(&ne_animmat_pool, slot);
+
+    for (int i = 0; i < ne_pool_count(&ne_animmat_pool); i++)
+    {
+        NEA_AnimMatInstance *other = ne_pool_get(&ne_animmat_pool, i);
+        if ((other != NULL) && (other->sync_leader == inst))
+            other->sync_leader = NULL;
     }
 
-    free(inst);
+    ne_pool_object_free(&ne_animmat_pool, inst);
 }
 
 void NEA_AnimMatSetData(NEA_AnimMatInstance *inst,
@@ -288,6 +296,17 @@ void NEA_AnimMatSetData(NEA_AnimMatInstance *inst,
     }
 }
 
+void NEA_AnimMatSync(NEA_AnimMatInstance *inst,
+                     const NEA_AnimMatInstance *leader)
+{
+    NEA_AssertPointer(inst, "NULL instance");
+    NEA_Assert(leader != inst, "An instance can't follow itself");
+    NEA_Assert((leader == NULL) || (leader->sync_leader == NULL),
+               "The leader follows another instance");
+
+    inst->sync_leader = leader;
+}
+
 void NEA_AnimMatSetMaterialTable(NEA_AnimMatInstance *inst,
                                  NEA_Material **table, int count)
 {
@@ -412,7 +431,7 @@ static inline uint32_t ne_packed_color_lerp(uint32_t a, uint32_t b,
 // =========================================================================
 
 // Evaluate a single track at the given frame. Returns the interpolated value.
-ARM_CODE static uint32_t ne_animmat_eval_track(
+NEA_HOT_CODE static uint32_t ne_animmat_eval_track(
     const NEA_AnimMatTrack *track, int32_t frame_f32)
 {
     if (track->num_keys == 0)
@@ -422,6 +441,17 @@ ARM_CODE static uint32_t ne_animmat_eval_track(
         return track->keys[0].value;
 
     int frame_int = frame_f32 >> 12; // Integer part
+
+    // Baked tracks hold the value of every integer frame
+    if ((track->baked != NULL) && ((frame_f32 & 0xFFF) == 0))
+    {
+        if (frame_int <= 0)
+            return track->baked[0];
+        if (frame_int >= track->num_baked)
+            return track->baked[track->num_baked - 1];
+        return track->baked[frame_int];
+    }
+
     const NEA_AnimMatKeyframe *keys = track->keys;
     int num_keys = track->num_keys;
 
@@ -520,6 +550,65 @@ ARM_CODE static uint32_t ne_animmat_eval_track(
     }
 }
 
+// =========================================================================
+// Baking
+// =========================================================================
+
+// Number of values of the baked table of a track, or 0 if it isn't baked
+static int ne_animmat_bake_length(const NEA_AnimMatTrack *track)
+{
+    if ((track->interp != NEA_AMINTERP_LINEAR) || (track->num_keys < 2))
+        return 0;
+
+    // The last keyframe holds its value until the end of the animation
+    int length = track->keys[track->num_keys - 1].frame + 1;
+    if (length > NEA_ANIMMAT_MAX_BAKED_FRAMES)
+        return 0;
+
+    return length;
+}
+
+int NEA_AnimMatDataBake(NEA_AnimMatData *data)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    if (data->_baked_data != NULL)
+        return 1;
+
+    size_t total = 0;
+    for (int i = 0; i < data->num_tracks; i++)
+        total += ne_animmat_bake_length(&data->tracks[i]);
+
+    if (total == 0)
+        return 1;
+
+    uint32_t *table = malloc(total * sizeof(uint32_t));
+    if (table == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for baked tracks");
+        return 0;
+    }
+
+    data->_baked_data = table;
+
+    for (int i = 0; i < data->num_tracks; i++)
+    {
+        NEA_AnimMatTrack *track = &data->tracks[i];
+        int length = ne_animmat_bake_length(track);
+        if (length == 0)
+            continue;
+
+        for (int f = 0; f < length; f++)
+            table[f] = ne_animmat_eval_track(track, inttof32(f));
+
+        track->baked = table;
+        track->num_baked = length;
+        table += length;
+    }
+
+    return 1;
+}
+
 // =========================================================================
 // Evaluate
 // =========================================================================
@@ -531,6 +620,8 @@ void NEA_AnimMatEvaluate(NEA_AnimMatInstance *inst)
     if (inst->data == NULL)
         return;
 
+    inst->dirty = false;
+
     // Start from base values
     uint32_t alpha = inst->base_alpha;
     uint32_t polyid = inst->base_polyid;
@@ -611,19 +702,46 @@ void NEA_AnimMatEvaluate(NEA_AnimMatInstance *inst)
 // Update all instances
 // =========================================================================
 
+// Copies the frame and output state of the leader of a sync group.
+static void ne_animmat_copy_results(NEA_AnimMatInstance *inst,
+                                    const NEA_AnimMatInstance *leader)
+{
+    inst->currframe = leader->currframe;
+
+    inst->out_poly_format = leader->out_poly_format;
+    inst->out_material = leader->out_material;
+    inst->out_color = leader->out_color;
+    inst->out_diff_amb = leader->out_diff_amb;
+    inst->out_spec_emi = leader->out_spec_emi;
+    inst->has_poly_format = leader->has_poly_format;
+    inst->has_material_swap = leader->has_material_swap;
+    inst->has_color_props = leader->has_color_props;
+
+    inst->out_tex_scroll_x = leader->out_tex_scroll_x;
+    inst->out_tex_scroll_y = leader->out_tex_scroll_y;
+    inst->out_tex_rotate = leader->out_tex_rotate;
+    inst->out_tex_scale_x = leader->out_tex_scale_x;
+    inst->out_tex_scale_y = leader->out_tex_scale_y;
+    inst->has_tex_transform = leader->has_tex_transform;
+}
+
 void NEA_AnimMatUpdateAll(void)
 {
     if (!ne_animmat_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_ANIMMAT; i++)
+    for (int i = 0; i < ne_pool_count(&ne_animmat_pool); i++)
     {
-        NEA_AnimMatInstance *inst = NEA_AnimMatPointers[i];
+        NEA_AnimMatInstance *inst = ne_pool_get(&ne_animmat_pool, i);
         if (inst == NULL || !inst->active || inst->paused)
             continue;
         if (inst->data == NULL)
             continue;
 
+        // Instances in a sync group are updated after their leaders
+        if (inst->sync_leader != NULL)
+            continue;
+
         // Advance frame
         inst->currframe += inst->speed;
 
@@ -651,22 +769,80 @@ void NEA_AnimMatUpdateAll(void)
             }
         }
 
-        // Evaluate output state
-        NEA_AnimMatEvaluate(inst);
+        // The output state is evaluated when it's applied
+        inst->dirty = true;
+    }
+
+    for (int i = 0; i < ne_pool_count(&ne_animmat_pool); i++)
+    {
+        NEA_AnimMatInstance *inst = ne_pool_get(&ne_animmat_pool, i);
+        if (inst == NULL || inst->sync_leader == NULL)
+            continue;
+
+        inst->currframe = inst->sync_leader->currframe;
+        inst->dirty = true;
     }
 }
 
+// Evaluates an instance if its frame has changed since the last evaluation
+static void ne_animmat_refresh(NEA_AnimMatInstance *inst)
+{
+    if (!inst->dirty)
+        return;
+
+    if (inst->sync_leader != NULL)
+    {
+        // Leaders are instances of the pool too, so they can be modified
+        NEA_AnimMatInstance *leader =
+                (NEA_AnimMatInstance *)inst->sync_leader;
+        ne_animmat_refresh(leader);
+        ne_animmat_copy_results(inst, leader);
+        inst->dirty = false;
+        return;
+    }
+
+    NEA_AnimMatEvaluate(inst);
+}
+
 // =========================================================================
 // Apply to GPU
 // =========================================================================
 
-void NEA_AnimMatApply(const NEA_AnimMatInstance *inst)
+// Internal use... see NEATexture.c
+void ne_material_state_diffuse_ambient(u32 value);
+void ne_material_state_specular_emission(u32 value);
+void ne_material_state_poly_format(u32 value);
+uint32_t ne_texture_matrix_get_stamp(void);
+
+// Internal use... see NEAPolygon.c
+extern u32 ne_poly_format_last;
+
+// Texture matrix left by the last call to NEA_AnimMatApply()
+typedef struct {
+    uint32_t stamp; // Value of the texture matrix stamp after it was built
+    int32_t scroll_x, scroll_y;
+    int32_t rotate;
+    int32_t scale_x, scale_y;
+} ne_animmat_tex_state_t;
+
+static ne_animmat_tex_state_t ne_animmat_tex_state = {
+    .stamp = UINT32_MAX
+};
+
+void NEA_AnimMatApply(NEA_AnimMatInstance *inst)
 {
+    NEA_DisplayListWait();
+
     if (inst == NULL || !inst->active)
         return;
 
+    ne_animmat_refresh(inst);
+
     if (inst->has_poly_format)
-        GFX_POLY_FORMAT = inst->out_poly_format;
+    {
+        ne_material_state_poly_format(inst->out_poly_format);
+        ne_poly_format_last = inst->out_poly_format;
+    }
 
     if (inst->has_material_swap && inst->out_material != NULL)
         NEA_MaterialUse(inst->out_material);
@@ -674,25 +850,48 @@ void NEA_AnimMatApply(const NEA_AnimMatInstance *inst)
     if (inst->has_color_props)
     {
         GFX_COLOR = inst->out_color;
-        GFX_DIFFUSE_AMBIENT = inst->out_diff_amb;
-        GFX_SPECULAR_EMISSION = inst->out_spec_emi;
+        ne_material_state_diffuse_ambient(inst->out_diff_amb);
+        ne_material_state_specular_emission(inst->out_spec_emi);
     }
 
-    // Always reset the texture matrix so that a previous apply's transform
-    // does not leak into this draw call.  When this instance has its own
-    // texture tracks the matrix is then rebuilt; otherwise it stays at identity.
-    NEA_TextureMatrixIdentity();
+    // The texture matrix is reset so that a previous apply's transform does
+    // not leak into this draw call. When this instance has its own texture
+    // tracks the matrix is then rebuilt; otherwise it stays at identity.
+    int32_t scroll_x = 0, scroll_y = 0, rotate = 0;
+    int32_t scale_x = inttof32(1), scale_y = inttof32(1);
 
     if (inst->has_tex_transform)
     {
-        if (inst->out_tex_scroll_x != 0 || inst->out_tex_scroll_y != 0)
-            NEA_TextureMatrixTranslateI(inst->out_tex_scroll_x,
-                                         inst->out_tex_scroll_y);
-        if (inst->out_tex_rotate != 0)
-            NEA_TextureMatrixRotate(inst->out_tex_rotate);
-        if (inst->out_tex_scale_x != inttof32(1) ||
-            inst->out_tex_scale_y != inttof32(1))
-            NEA_TextureMatrixScaleI(inst->out_tex_scale_x,
-                                     inst->out_tex_scale_y);
+        scroll_x = inst->out_tex_scroll_x;
+        scroll_y = inst->out_tex_scroll_y;
+        rotate = inst->out_tex_rotate;
+        scale_x = inst->out_tex_scale_x;
+        scale_y = inst->out_tex_scale_y;
     }
+
+    // Skip it if nothing has modified the matrix since the last apply that
+    // left it with the same values.
+    ne_animmat_tex_state_t *st = &ne_animmat_tex_state;
+
+    if ((st->stamp == ne_texture_matrix_get_stamp()) &&
+        (st->scroll_x == scroll_x) && (st->scroll_y == scroll_y) &&
+        (st->rotate == rotate) &&
+        (st->scale_x == scale_x) && (st->scale_y == scale_y))
+        return;
+
+    NEA_TextureMatrixIdentity();
+
+    if (scroll_x != 0 || scroll_y != 0)
+        NEA_TextureMatrixTranslateI(scroll_x, scroll_y);
+    if (rotate != 0)
+        NEA_TextureMatrixRotate(rotate);
+    if (scale_x != inttof32(1) || scale_y != inttof32(1))
+        NEA_TextureMatrixScaleI(scale_x, scale_y);
+
+    st->stamp = ne_texture_matrix_get_stamp();
+    st->scroll_x = scroll_x;
+    st->scroll_y = scroll_y;
+    st->rotate = rotate;
+    st->scale_x = scale_x;
+    st->scale_y = scale_y;
 }
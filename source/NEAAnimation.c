@@ -6,14 +6,57 @@
 
 #include <nds/arm9/postest.h>
 
+#include "dsma/dsma.h"
+
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+#include "NEAPool.h"
 
 /// @file NEAAnimation.c
 
-static NEA_Animation **NEA_AnimationPointers;
+// The pose service (see NEAPoseService.c) may have requests of animations that
+// are deleted or replaced, and its ARM7 reads the DSA files from main RAM.
+static void ne_animation_pose_service_invalidate(void)
+{
+    extern void NEA_PoseServiceInvalidate(void) __attribute__((weak));
+    if (NEA_PoseServiceInvalidate)
+        NEA_PoseServiceInvalidate();
+}
+
+static void ne_animation_flush(const void *dsa_file)
+{
+    DC_FlushRange(dsa_file, DSMA_GetSize(dsa_file));
+}
+
+static ne_pool_t ne_animation_pool;
 static int NEA_MAX_ANIMATIONS;
 static bool ne_animation_system_inited = false;
 
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_animation_static, NEA_Animation,
+                      NEA_STATIC_MAX_ANIMATIONS);
+#endif
+
+// If the file starts with an animation bounds chunk, save a pointer to it and
+// return a pointer to the DSA data after it.
+static const void *ne_animation_read_bounds(NEA_Animation *animation,
+                                            const void *pointer)
+{
+    const int32_t *chunk = pointer;
+
+    animation->file = pointer;
+
+    if ((uint32_t)chunk[0] != NEA_ANIM_BOUNDS_MAGIC)
+    {
+        animation->bounds = NULL;
+        return pointer;
+    }
+
+    animation->bounds = chunk;
+
+    return chunk + 3 + chunk[1] * 6;
+}
+
 NEA_Animation *NEA_AnimationCreate(void)
 {
     if (!ne_animation_system_inited)
@@ -22,28 +65,19 @@ NEA_Animation *NEA_AnimationCreate(void)
         return NULL;
     }
 
-    NEA_Animation *animation = calloc(1, sizeof(NEA_Animation));
+    NEA_Animation *animation = ne_pool_object_alloc(&ne_animation_pool,
+                                                    sizeof(NEA_Animation));
     if (animation == NULL)
     {
         NEA_DebugPrint("Not enough memory");
         return NULL;
     }
 
-    int i = 0;
-    while (1)
+    if (ne_pool_add(&ne_animation_pool, animation) < 0)
     {
-        if (NEA_AnimationPointers[i] == NULL)
-        {
-            NEA_AnimationPointers[i] = animation;
-            break;
-        }
-        i++;
-        if (i == NEA_MAX_ANIMATIONS)
-        {
-            NEA_DebugPrint("No free slots");
-            free(animation);
-            return NULL;
-        }
+        NEA_DebugPrint("No free slots");
+        ne_pool_object_free(&ne_animation_pool, animation);
+        return NULL;
     }
 
     return animation;
@@ -56,26 +90,25 @@ void NEA_AnimationDelete(NEA_Animation *animation)
 
     NEA_AssertPointer(animation, "NULL pointer");
 
-    int i = 0;
-    while (1)
+    int slot = ne_pool_find(&ne_animation_pool, animation);
+    if (slot < 0)
     {
-        if (i == NEA_MAX_ANIMATIONS)
-        {
-            NEA_DebugPrint("Animation not found");
-            return;
-        }
-        if (NEA_AnimationPointers[i] == animation)
-        {
-            NEA_AnimationPointers[i] = NULL;
-            break;
-        }
-        i++;
+        NEA_DebugPrint("Animation not found");
+        return;
     }
 
+    ne_pool_remove(&ne_animation_pool, slot);
+
+    // The cache may have poses of this animation
+    DSMA_PoseCacheClear();
+    ne_animation_pose_service_invalidate();
+
+    NEA_AnimationClearBaked(animation);
+
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        ne_heap_free(NEA_HEAP_ANIMATION, (void *)animation->file);
 
-    free(animation);
+    ne_pool_object_free(&ne_animation_pool, animation);
 }
 
 int NEA_AnimationLoadFAT(NEA_Animation *animation, const char *dsa_path)
@@ -86,27 +119,41 @@ int NEA_AnimationLoadFAT(NEA_Animation *animation, const char *dsa_path)
     NEA_AssertPointer(animation, "NULL animation pointer");
     NEA_AssertPointer(dsa_path, "NULL path pointer");
 
+    // The baked matrices belong to the old DSA file
+    NEA_AnimationClearBaked(animation);
+
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        ne_heap_free(NEA_HEAP_ANIMATION, (void *)animation->file);
 
     animation->loadedfromfat = true;
+    animation->file = NULL;
+    animation->data = NULL;
 
-    uint32_t *pointer = (uint32_t *)NEA_FATLoadData(dsa_path);
-    if (pointer == NULL)
+    void *file = NEA_FATLoadData(dsa_path);
+    if (file == NULL)
     {
         NEA_DebugPrint("Couldn't load file from FAT");
         return 0;
     }
 
+    ne_heap_track(NEA_HEAP_ANIMATION, file);
+
+    const uint32_t *pointer = ne_animation_read_bounds(animation, file);
+
     // Check version
     uint32_t version = pointer[0];
-    if (version != 1)
+    if ((version != 1) && (version != 2))
     {
-        NEA_DebugPrint("file version is %ld, it should be 1", version);
-        free(pointer);
+        NEA_DebugPrint("file version is %ld, it should be 1 or 2", version);
+        ne_heap_free(NEA_HEAP_ANIMATION, file);
+        animation->file = NULL;
+        animation->bounds = NULL;
         return 0;
     }
 
+    ne_animation_flush(pointer);
+    ne_animation_pose_service_invalidate();
+
     animation->data = (void *)pointer;
     return 1;
 }
@@ -119,36 +166,192 @@ int NEA_AnimationLoad(NEA_Animation *animation, const void *dsa_pointer)
     NEA_AssertPointer(animation, "NULL animation pointer");
     NEA_AssertPointer(dsa_pointer, "NULL data pointer");
 
+    // The baked matrices belong to the old DSA file
+    NEA_AnimationClearBaked(animation);
+
     if (animation->loadedfromfat)
-        free((void *)animation->data);
+        ne_heap_free(NEA_HEAP_ANIMATION, (void *)animation->file);
 
     animation->loadedfromfat = false;
 
-    const u32 *pointer = dsa_pointer;
+    const u32 *pointer = ne_animation_read_bounds(animation, dsa_pointer);
 
     // Check version
     uint32_t version = pointer[0];
-    if (version != 1)
+    if ((version != 1) && (version != 2))
     {
-        NEA_DebugPrint("file version is %ld, it should be 1", version);
-        free((void *)pointer);
+        NEA_DebugPrint("file version is %ld, it should be 1 or 2", version);
+        animation->file = NULL;
+        animation->bounds = NULL;
+        animation->data = NULL;
         return 0;
     }
 
+    ne_animation_flush(pointer);
+    ne_animation_pose_service_invalidate();
+
     animation->data = (void *)pointer;
 
     return 1;
 }
 
+bool NEA_AnimationGetBounds(const NEA_Animation *animation, int32_t frame,
+                            int32_t *min, int32_t *max)
+{
+    NEA_AssertPointer(animation, "NULL animation pointer");
+
+    const int32_t *chunk = animation->bounds;
+    if (chunk == NULL)
+        return false;
+
+    int32_t num_ranges = chunk[1];
+    int32_t range = (frame >> 12) / chunk[2];
+    if (range < 0)
+        range = 0;
+    else if (range >= num_ranges)
+        range = num_ranges - 1;
+
+    const int32_t *box = &chunk[3 + range * 6];
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = box[i];
+        max[i] = box[3 + i];
+    }
+
+    return true;
+}
+
+int NEA_AnimationBake(NEA_Animation *animation)
+{
+    NEA_AssertPointer(animation, "NULL pointer");
+
+    if (animation->data == NULL)
+    {
+        NEA_DebugPrint("Animation has no data");
+        return 0;
+    }
+
+    NEA_AnimationClearBaked(animation);
+
+    void *baked = ne_heap_malloc(NEA_HEAP_ANIMATION,
+                                 DSMA_GetBakedSize(animation->data));
+    if (baked == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    if (DSMA_BakeMatrices(animation->data, baked) != DSMA_SUCCESS)
+    {
+        NEA_DebugPrint("Couldn't bake animation");
+        ne_heap_free(NEA_HEAP_ANIMATION, baked);
+        return 0;
+    }
+
+    animation->baked = baked;
+    animation->baked_has_to_free = true;
+
+    return 1;
+}
+
+// Checks that baked matrices have been generated for the DSA file of an
+// animation.
+static bool ne_animation_baked_valid(const NEA_Animation *animation,
+                                     const u32 *pointer)
+{
+    if (pointer[0] != DSMA_BAKED_MAGIC)
+    {
+        NEA_DebugPrint("Invalid baked matrices file");
+        return false;
+    }
+
+    if ((pointer[1] != DSMA_GetNumFrames(animation->data)) ||
+        (pointer[2] != ((const u32 *)animation->data)[2]))
+    {
+        NEA_DebugPrint("Baked matrices don't match the animation");
+        return false;
+    }
+
+    return true;
+}
+
+int NEA_AnimationLoadBaked(NEA_Animation *animation, const void *pointer)
+{
+    NEA_AssertPointer(animation, "NULL animation pointer");
+    NEA_AssertPointer(pointer, "NULL data pointer");
+
+    if (animation->data == NULL)
+    {
+        NEA_DebugPrint("Animation has no data");
+        return 0;
+    }
+
+    if (!ne_animation_baked_valid(animation, pointer))
+        return 0;
+
+    NEA_AnimationClearBaked(animation);
+
+    animation->baked = pointer;
+    animation->baked_has_to_free = false;
+
+    return 1;
+}
+
+int NEA_AnimationLoadBakedFAT(NEA_Animation *animation, const char *path)
+{
+    NEA_AssertPointer(animation, "NULL animation pointer");
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    if (animation->data == NULL)
+    {
+        NEA_DebugPrint("Animation has no data");
+        return 0;
+    }
+
+    u32 *pointer = (u32 *)NEA_FATLoadData(path);
+    if (pointer == NULL)
+    {
+        NEA_DebugPrint("Couldn't load file from FAT");
+        return 0;
+    }
+
+    ne_heap_track(NEA_HEAP_ANIMATION, pointer);
+
+    if (!ne_animation_baked_valid(animation, pointer))
+    {
+        ne_heap_free(NEA_HEAP_ANIMATION, pointer);
+        return 0;
+    }
+
+    NEA_AnimationClearBaked(animation);
+
+    animation->baked = pointer;
+    animation->baked_has_to_free = true;
+
+    return 1;
+}
+
+void NEA_AnimationClearBaked(NEA_Animation *animation)
+{
+    NEA_AssertPointer(animation, "NULL pointer");
+
+    if (animation->baked_has_to_free)
+        ne_heap_free(NEA_HEAP_ANIMATION, (void *)animation->baked);
+
+    animation->baked = NULL;
+    animation->baked_has_to_free = false;
+}
+
 void NEA_AnimationDeleteAll(void)
 {
     if (!ne_animation_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_ANIMATIONS; i++)
+    for (int i = ne_pool_count(&ne_animation_pool) - 1; i >= 0; i--)
     {
-        if (NEA_AnimationPointers[i] != NULL)
-            NEA_AnimationDelete(NEA_AnimationPointers[i]);
+        NEA_Animation *animation = ne_pool_get(&ne_animation_pool, i);
+        if (animation != NULL)
+            NEA_AnimationDelete(animation);
     }
 }
 
@@ -162,12 +365,14 @@ int NEA_AnimationSystemReset(int max_animations)
     else
         NEA_MAX_ANIMATIONS = max_animations;
 
-    NEA_AnimationPointers = calloc(NEA_MAX_ANIMATIONS, sizeof(NEA_AnimationPointers));
-    if (NEA_AnimationPointers == NULL)
-    {
-        NEA_DebugPrint("Not enough memory");
+    NEA_MAX_ANIMATIONS = NE_STATIC_CAPACITY(NEA_MAX_ANIMATIONS,
+                                            NEA_STATIC_MAX_ANIMATIONS);
+
+    if (NE_POOL_INIT(&ne_animation_pool, ne_animation_static,
+                     NEA_MAX_ANIMATIONS) == 0)
         return -1;
-    }
+
+    ne_pool_set_heap_tag(&ne_animation_pool, NEA_HEAP_ANIMATION);
 
     ne_animation_system_inited = true;
     return 0;
@@ -180,7 +385,7 @@ void NEA_AnimationSystemEnd(void)
 
     NEA_AnimationDeleteAll();
 
-    free(NEA_AnimationPointers);
+    ne_pool_end(&ne_animation_pool);
 
     ne_animation_system_inited = false;
 }
@@ -0,0 +1,201 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAArena.c
+
+typedef struct {
+    u8 *base;   // NULL if the arena doesn't exist
+    size_t size;
+    size_t used;
+    size_t high_water;
+    u32 failures;
+} ne_arena_t;
+
+static ne_arena_t ne_arenas[NEA_ARENA_COUNT];
+
+#define NE_ARENA_CHECK(arena)                                           \
+    NEA_AssertMinMax(0, arena, NEA_ARENA_COUNT - 1, "Invalid arena %d", \
+                     arena)
+
+int NEA_ArenaInit(NEA_Arena arena, size_t size)
+{
+    NE_ARENA_CHECK(arena);
+
+    NEA_ArenaEnd(arena);
+
+    if (size == 0)
+        return 1;
+
+    ne_arena_t *a = &ne_arenas[arena];
+
+    size = (size + NEA_ARENA_ALIGNMENT - 1) & ~(NEA_ARENA_ALIGNMENT - 1);
+
+    a->base = malloc(size);
+    if (a->base == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    a->size = size;
+
+    return 1;
+}
+
+void NEA_ArenaEnd(NEA_Arena arena)
+{
+    NE_ARENA_CHECK(arena);
+
+    ne_arena_t *a = &ne_arenas[arena];
+
+    free(a->base);
+    memset(a, 0, sizeof(ne_arena_t));
+}
+
+void *NEA_ArenaAlloc(NEA_Arena arena, size_t size)
+{
+    NE_ARENA_CHECK(arena);
+
+    ne_arena_t *a = &ne_arenas[arena];
+
+    size = (size + NEA_ARENA_ALIGNMENT - 1) & ~(NEA_ARENA_ALIGNMENT - 1);
+
+    if ((a->base == NULL) || (size > a->size - a->used))
+    {
+        a->failures++;
+        return NULL;
+    }
+
+    void *ptr = a->base + a->used;
+
+    a->used += size;
+    if (a->used > a->high_water)
+        a->high_water = a->used;
+
+    return ptr;
+}
+
+size_t NEA_ArenaMark(NEA_Arena arena)
+{
+    NE_ARENA_CHECK(arena);
+
+    return ne_arenas[arena].used;
+}
+
+void NEA_ArenaRelease(NEA_Arena arena, size_t mark)
+{
+    NE_ARENA_CHECK(arena);
+
+    ne_arena_t *a = &ne_arenas[arena];
+
+    NEA_Assert(mark <= a->used, "Invalid mark");
+
+    if (mark < a->used)
+        a->used = mark;
+}
+
+void NEA_ArenaReset(NEA_Arena arena)
+{
+    NE_ARENA_CHECK(arena);
+
+    ne_arenas[arena].used = 0;
+}
+
+bool NEA_ArenaOwns(NEA_Arena arena, const void *ptr)
+{
+    NE_ARENA_CHECK(arena);
+
+    const ne_arena_t *a = &ne_arenas[arena];
+
+    if (a->base == NULL)
+        return false;
+
+    const u8 *p = ptr;
+    return (p >= a->base) && (p < a->base + a->size);
+}
+
+void NEA_ArenaGetStats(NEA_Arena arena, NEA_ArenaStats *stats)
+{
+    NE_ARENA_CHECK(arena);
+    NEA_AssertPointer(stats, "NULL stats pointer");
+
+    const ne_arena_t *a = &ne_arenas[arena];
+
+    stats->size = a->size;
+    stats->used = a->used;
+    stats->high_water = a->high_water;
+    stats->failures = a->failures;
+}
+
+void NEA_ArenaResetStats(NEA_Arena arena)
+{
+    NE_ARENA_CHECK(arena);
+
+    ne_arena_t *a = &ne_arenas[arena];
+
+    a->high_water = a->used;
+    a->failures = 0;
+}
+
+// Internal use... see NEAGeneral.c
+void ne_arena_frame_end(void)
+{
+    ne_arenas[NEA_ARENA_FRAME].used = 0;
+}
+
+// Internal use... Temporary buffers of the engine that are freed before the
+// function that allocates them returns. They come from the frame arena if it
+// has space, and from the heap if not. If they are freed in the opposite order
+// in which they are allocated, the memory of the arena is reused right away.
+
+// Header of temporary buffers allocated from the frame arena
+typedef struct {
+    u32 mark; // Used memory of the arena before the allocation
+    u32 end;  // Used memory of the arena after the allocation
+} ne_arena_temp_t;
+
+_Static_assert(sizeof(ne_arena_temp_t) == NEA_ARENA_ALIGNMENT,
+               "The header must keep the buffers aligned");
+
+void *ne_arena_temp_alloc(size_t size)
+{
+    ne_arena_t *a = &ne_arenas[NEA_ARENA_FRAME];
+
+    size_t total = sizeof(ne_arena_temp_t) + size;
+    total = (total + NEA_ARENA_ALIGNMENT - 1) & ~(NEA_ARENA_ALIGNMENT - 1);
+
+    // Failures of the engine aren't counted, it uses malloc() instead
+    if ((a->base == NULL) || (total > a->size - a->used))
+        return malloc(size);
+
+    size_t mark = a->used;
+    ne_arena_temp_t *header = NEA_ArenaAlloc(NEA_ARENA_FRAME, total);
+
+    header->mark = mark;
+    header->end = a->used;
+
+    return header + 1;
+}
+
+void ne_arena_temp_free(void *ptr)
+{
+    if (ptr == NULL)
+        return;
+
+    if (!NEA_ArenaOwns(NEA_ARENA_FRAME, ptr))
+    {
+        free(ptr);
+        return;
+    }
+
+    // If it isn't the last allocation it is freed when the arena is reset
+    ne_arena_t *a = &ne_arenas[NEA_ARENA_FRAME];
+    ne_arena_temp_t *header = (ne_arena_temp_t *)ptr - 1;
+    if (header->end == a->used)
+        a->used = header->mark;
+}
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAAtlas.c
+
+#define NEA_ATLAS_MAGIC   0x534C5441 // "ATLS"
+#define NEA_ATLAS_VERSION 1
+
+// Format of the metadata files generated by img2ds. All values are little
+// endian.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 num_regions;
+    u16 width;
+    u16 height;
+} ne_atlas_header_t;
+
+typedef struct {
+    u16 x, y, w, h;
+    char name[NEA_ATLAS_NAME_LEN];
+} ne_atlas_file_region_t;
+
+NEA_Atlas *NEA_AtlasCreate(NEA_Material *mat, const void *data)
+{
+    NEA_AssertPointer(mat, "NULL material pointer");
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    const ne_atlas_header_t *header = data;
+
+    if (header->magic != NEA_ATLAS_MAGIC)
+    {
+        NEA_DebugPrint("Not an atlas file");
+        return NULL;
+    }
+
+    if (header->version != NEA_ATLAS_VERSION)
+    {
+        NEA_DebugPrint("Unsupported atlas version %d", header->version);
+        return NULL;
+    }
+
+    if ((header->width != NEA_TextureGetSizeX(mat)) ||
+        (header->height != NEA_TextureGetSizeY(mat)))
+    {
+        NEA_DebugPrint("Atlas size doesn't match the texture");
+        return NULL;
+    }
+
+    NEA_Atlas *atlas = calloc(1, sizeof(NEA_Atlas));
+    if (atlas == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    int num = header->num_regions;
+
+    atlas->regions = calloc(num, sizeof(NEA_AtlasRegion));
+    if ((atlas->regions == NULL) && (num > 0))
+    {
+        NEA_DebugPrint("Not enough memory");
+        free(atlas);
+        return NULL;
+    }
+
+    const ne_atlas_file_region_t *src = (const void *)(header + 1);
+
+    for (int i = 0; i < num; i++)
+    {
+        NEA_AtlasRegion *r = &atlas->regions[i];
+
+        r->x = src[i].x;
+        r->y = src[i].y;
+        r->w = src[i].w;
+        r->h = src[i].h;
+        memcpy(r->name, src[i].name, NEA_ATLAS_NAME_LEN);
+        r->name[NEA_ATLAS_NAME_LEN - 1] = '\0';
+    }
+
+    atlas->mat = mat;
+    atlas->width = header->width;
+    atlas->height = header->height;
+    atlas->num_regions = num;
+
+    return atlas;
+}
+
+// Internal use... see NEAFAT.c and NEAArena.c
+char *ne_fat_load_data_temp(const char *filename);
+void ne_arena_temp_free(void *ptr);
+
+NEA_Atlas *NEA_AtlasCreateFAT(NEA_Material *mat, const char *path)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    void *data = ne_fat_load_data_temp(path);
+    if (data == NULL)
+        return NULL;
+
+    NEA_Atlas *atlas = NEA_AtlasCreate(mat, data);
+
+    ne_arena_temp_free(data);
+
+    return atlas;
+}
+
+void NEA_AtlasDelete(NEA_Atlas *atlas)
+{
+    NEA_AssertPointer(atlas, "NULL pointer");
+
+    free(atlas->regions);
+    free(atlas);
+}
+
+int NEA_AtlasFindRegion(const NEA_Atlas *atlas, const char *name)
+{
+    NEA_AssertPointer(atlas, "NULL atlas pointer");
+    NEA_AssertPointer(name, "NULL name pointer");
+
+    for (int i = 0; i < atlas->num_regions; i++)
+    {
+        if (strncmp(atlas->regions[i].name, name, NEA_ATLAS_NAME_LEN) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+const NEA_AtlasRegion *NEA_AtlasGetRegion(const NEA_Atlas *atlas, int index)
+{
+    NEA_AssertPointer(atlas, "NULL atlas pointer");
+    NEA_AssertMinMax(0, index, atlas->num_regions - 1,
+                     "Invalid region %d", index);
+
+    return &atlas->regions[index];
+}
+
+NEA_Material *NEA_AtlasCreateMaterial(const NEA_Atlas *atlas, int index)
+{
+    const NEA_AtlasRegion *r = NEA_AtlasGetRegion(atlas, index);
+
+    NEA_Material *mat = NEA_MaterialCreate();
+    if (mat == NULL)
+        return NULL;
+
+    NEA_MaterialClone(atlas->mat, mat);
+
+    // The clone must not delete the palette of the atlas
+    mat->palette_autodelete = false;
+
+    NEA_MaterialSetTexOffset(mat, r->x, r->y);
+
+    return mat;
+}
+
+void NEA_SpriteSetAtlasRegion(NEA_Sprite *sprite, const NEA_Atlas *atlas,
+                              int index)
+{
+    NEA_AssertPointer(sprite, "NULL sprite pointer");
+
+    const NEA_AtlasRegion *r = NEA_AtlasGetRegion(atlas, index);
+
+    NEA_SpriteSetMaterial(sprite, atlas->mat);
+    NEA_SpriteSetMaterialCanvas(sprite, r->x, r->y, r->x + r->w, r->y + r->h);
+
+    NEA_SpriteSetSize(sprite, r->w, r->h);
+}
+
+void NEA_ParticlePoolSetAtlasRegion(NEA_ParticlePool *pool,
+                                    const NEA_Atlas *atlas, int index)
+{
+    NEA_AssertPointer(pool, "NULL pool pointer");
+
+    const NEA_AtlasRegion *r = NEA_AtlasGetRegion(atlas, index);
+
+    NEA_ParticlePoolSetMaterial(pool, atlas->mat);
+    NEA_ParticlePoolSetMaterialCanvas(pool, r->x, r->y,
+                                      r->x + r->w, r->y + r->h);
+}
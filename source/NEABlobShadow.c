@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAMath.h"
+
+/// @file NEABlobShadow.c
+
+// Vertices are sent with this shift and the matrix is scaled up to compensate,
+// like in NEAParticle.c.
+#define NEA_BLOB_SHADOW_SHIFT 4
+
+// Default distance from the ground to the quads, to avoid Z-fighting
+#define NEA_BLOB_SHADOW_OFFSET (inttof32(1) / 32)
+
+// Internal use... see NEATexture.c
+void ne_material_state_poly_format(u32 value);
+
+NEA_BlobShadowBatch *NEA_BlobShadowBatchCreate(int max_shadows)
+{
+    NEA_AssertMinMax(1, max_shadows, 0xFFFF, "Invalid number of shadows %d",
+                     max_shadows);
+
+    NEA_BlobShadowBatch *batch = calloc(1, sizeof(NEA_BlobShadowBatch));
+    if (batch == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    batch->shadows = calloc(max_shadows, sizeof(NEA_BlobShadow));
+    if (batch->shadows == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        free(batch);
+        return NULL;
+    }
+
+    batch->max_shadows = max_shadows;
+    batch->range = inttof32(4);
+    batch->offset = NEA_BLOB_SHADOW_OFFSET;
+    batch->color = NEA_Black;
+    batch->alpha = 16;
+    batch->id = 1;
+
+    return batch;
+}
+
+void NEA_BlobShadowBatchDelete(NEA_BlobShadowBatch *batch)
+{
+    if (batch == NULL)
+        return;
+
+    free(batch->shadows);
+    free(batch);
+}
+
+void NEA_BlobShadowBatchSetMaterial(NEA_BlobShadowBatch *batch,
+                                    NEA_Material *mat)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+    NEA_AssertPointer(mat, "NULL material pointer");
+
+    batch->mat = mat;
+
+    batch->tl = 0;
+    batch->tr = NEA_TextureGetSizeX(mat);
+    batch->tt = 0;
+    batch->tb = NEA_TextureGetSizeY(mat);
+}
+
+void NEA_BlobShadowBatchSetGround(NEA_BlobShadowBatch *batch,
+                                  const NEA_ColShape *shape, NEA_Vec3 pos)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+
+    batch->ground = shape;
+    batch->ground_pos = pos;
+}
+
+void NEA_BlobShadowBatchSetRangeI(NEA_BlobShadowBatch *batch, int32_t range)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+    NEA_Assert(range > 0, "Invalid range");
+
+    batch->range = range;
+}
+
+void NEA_BlobShadowBatchSetParams(NEA_BlobShadowBatch *batch, u32 color,
+                                  u8 alpha, u8 id)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+    NEA_AssertMinMax(1, alpha, 31, "Invalid alpha value %d", alpha);
+    NEA_AssertMinMax(0, id, 63, "Invalid polygon ID %d", id);
+
+    batch->color = color;
+    batch->alpha = alpha;
+    batch->id = id;
+}
+
+void NEA_BlobShadowBatchClear(NEA_BlobShadowBatch *batch)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+
+    batch->num_shadows = 0;
+}
+
+int NEA_BlobShadowBatchAddI(NEA_BlobShadowBatch *batch,
+                            int32_t x, int32_t y, int32_t z, int32_t size)
+{
+    NEA_AssertPointer(batch, "NULL batch pointer");
+
+    if (batch->num_shadows == batch->max_shadows)
+        return 0;
+
+    if (batch->ground == NULL)
+    {
+        NEA_DebugPrint("Batch doesn't have a ground");
+        return 0;
+    }
+
+    NEA_Vec3 from = NEA_Vec3Make(x, y, z);
+    NEA_Vec3 to = NEA_Vec3Make(x, y - batch->range, z);
+
+    NEA_ColRayResult hit = NEA_ColRaycast(from, to, batch->ground,
+                                          batch->ground_pos);
+    if (!hit.hit)
+        return 0;
+
+    NEA_BlobShadow *shadow = &batch->shadows[batch->num_shadows++];
+
+    shadow->point = hit.point;
+    shadow->normal = hit.normal;
+
+    // The shadow is half the size at the end of the range
+    int32_t scale = inttof32(1) - divf32(hit.distance, batch->range) / 2;
+    shadow->size = mulf32(size, scale);
+
+    return 1;
+}
+
+static inline void ne_blob_shadow_vertex(u32 texcoord, NEA_Vec3 v)
+{
+    int32_t x = v.x >> NEA_BLOB_SHADOW_SHIFT;
+    int32_t y = v.y >> NEA_BLOB_SHADOW_SHIFT;
+    int32_t z = v.z >> NEA_BLOB_SHADOW_SHIFT;
+
+    GFX_TEX_COORD = texcoord;
+    GFX_VERTEX16 = (y << 16) | (x & 0xFFFF);
+    GFX_VERTEX16 = z & 0xFFFF;
+}
+
+ARM_CODE void NEA_BlobShadowBatchDraw(const NEA_BlobShadowBatch *batch)
+{
+    NEA_DisplayListWait();
+
+    NEA_AssertPointer(batch, "NULL pointer");
+
+    if (batch->num_shadows == 0)
+        return;
+
+    if (batch->mat == NULL)
+    {
+        NEA_DebugPrint("Batch doesn't have a material");
+        return;
+    }
+
+    // Same texture coordinates as NEA_2DDrawTexturedQuadColorCanvas()
+    u32 tex_ul = TEXTURE_PACK(inttot16(batch->tl), inttot16(batch->tt));
+    u32 tex_dl = TEXTURE_PACK(inttot16(batch->tl), inttot16(batch->tb));
+    u32 tex_dr = TEXTURE_PACK(inttot16(batch->tr), inttot16(batch->tb));
+    u32 tex_ur = TEXTURE_PACK(inttot16(batch->tr), inttot16(batch->tt));
+
+    MATRIX_PUSH = 0;
+
+    MATRIX_SCALE = inttof32(1 << NEA_BLOB_SHADOW_SHIFT);
+    MATRIX_SCALE = inttof32(1 << NEA_BLOB_SHADOW_SHIFT);
+    MATRIX_SCALE = inttof32(1 << NEA_BLOB_SHADOW_SHIFT);
+
+    ne_material_state_poly_format(POLY_ALPHA(batch->alpha) |
+                                  POLY_ID(batch->id) | NEA_CULL_NONE);
+
+    NEA_MaterialUse(batch->mat);
+
+    GFX_COLOR = batch->color;
+
+    GFX_BEGIN = GL_QUADS;
+
+    const NEA_BlobShadow *s = batch->shadows;
+
+    for (int i = 0; i < batch->num_shadows; i++, s++)
+    {
+        NEA_Vec3 n = s->normal;
+
+        // Axes of the quad on the plane of the ground. The reference axis is
+        // X unless the ground is almost perpendicular to it.
+        NEA_Vec3 ref = (abs(n.x) < floattof32(0.9)) ?
+                       NEA_Vec3Make(inttof32(1), 0, 0) :
+                       NEA_Vec3Make(0, 0, inttof32(1));
+        NEA_Vec3 u = NEA_Vec3Cross(n, ref);
+        ne_normalize((int32_t *)&u);
+        NEA_Vec3 v = NEA_Vec3Cross(u, n);
+
+        NEA_Vec3 center = NEA_Vec3Add(s->point,
+                                      NEA_Vec3Scale(n, batch->offset));
+
+        // Diagonals of the quad
+        NEA_Vec3 a = NEA_Vec3Scale(NEA_Vec3Add(u, v), s->size);
+        NEA_Vec3 b = NEA_Vec3Scale(NEA_Vec3Sub(u, v), s->size);
+
+        ne_blob_shadow_vertex(tex_ul, NEA_Vec3Sub(center, b));
+        ne_blob_shadow_vertex(tex_dl, NEA_Vec3Sub(center, a));
+        ne_blob_shadow_vertex(tex_dr, NEA_Vec3Add(center, b));
+        ne_blob_shadow_vertex(tex_ur, NEA_Vec3Add(center, a));
+    }
+
+    MATRIX_POP = 1;
+}
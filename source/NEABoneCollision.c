@@ -67,85 +67,20 @@ static inline NEA_Vec3 ne_quat_rotate_vec(const int32_t *q, NEA_Vec3 v)
     return r;
 }
 
-// Linear interpolation (same as dsma.c)
-static inline int32_t ne_lerp(int32_t start, int32_t end, int32_t pos)
-{
-    int32_t diff = end - start;
-    return start + ((diff * pos) >> 12);
-}
-
-// =========================================================================
-// DSA file format (replicated from dsma.c for CPU-side access)
-// =========================================================================
-
-typedef struct {
-    int32_t pos[3];
-    int32_t orient[4];
-} ne_dsa_joint_t;
-
-typedef struct {
-    uint32_t version;
-    uint32_t num_frames;
-    uint32_t num_joints;
-    ne_dsa_joint_t joints[0];
-} ne_dsa_t;
-
-static inline const ne_dsa_joint_t *ne_dsa_get_frame(const ne_dsa_t *dsa,
-                                                      uint32_t frame)
-{
-    return &dsa->joints[frame * dsa->num_joints];
-}
-
 // Get the interpolated position and orientation for a specific bone.
 static void ne_get_bone_transform(const void *dsa_file, uint32_t frame_interp,
                                   uint32_t bone_idx,
                                   int32_t *out_pos, int32_t *out_orient)
 {
-    const ne_dsa_t *dsa = (const ne_dsa_t *)dsa_file;
-
-    uint32_t frame = frame_interp >> 12;
-    uint32_t interp = frame_interp & 0xFFF;
+    if ((frame_interp >> 12) >= DSMA_GetNumFrames(dsa_file))
+        frame_interp &= 0xFFF;
 
-    if (frame >= dsa->num_frames)
-        frame = 0;
-
-    if (bone_idx >= dsa->num_joints)
+    if (DSMA_GetJointTransform(dsa_file, frame_interp, bone_idx,
+                               out_pos, out_orient) != DSMA_SUCCESS)
     {
         out_pos[0] = out_pos[1] = out_pos[2] = 0;
         out_orient[0] = inttof32(1);
         out_orient[1] = out_orient[2] = out_orient[3] = 0;
-        return;
-    }
-
-    const ne_dsa_joint_t *j1 = &ne_dsa_get_frame(dsa, frame)[bone_idx];
-
-    if (interp != 0)
-    {
-        uint32_t next_frame = frame + 1;
-        if (next_frame >= dsa->num_frames)
-            next_frame = 0;
-
-        const ne_dsa_joint_t *j2 = &ne_dsa_get_frame(dsa, next_frame)[bone_idx];
-
-        out_pos[0] = ne_lerp(j1->pos[0], j2->pos[0], interp);
-        out_pos[1] = ne_lerp(j1->pos[1], j2->pos[1], interp);
-        out_pos[2] = ne_lerp(j1->pos[2], j2->pos[2], interp);
-
-        out_orient[0] = ne_lerp(j1->orient[0], j2->orient[0], interp);
-        out_orient[1] = ne_lerp(j1->orient[1], j2->orient[1], interp);
-        out_orient[2] = ne_lerp(j1->orient[2], j2->orient[2], interp);
-        out_orient[3] = ne_lerp(j1->orient[3], j2->orient[3], interp);
-    }
-    else
-    {
-        out_pos[0] = j1->pos[0];
-        out_pos[1] = j1->pos[1];
-        out_pos[2] = j1->pos[2];
-
-        out_orient[0] = j1->orient[0];
-        out_orient[1] = j1->orient[1];
-        out_orient[2] = j1->orient[2];
-        out_orient[3] = j1->orient[3];
     }
 }
 
@@ -214,40 +149,229 @@ NEA_BoneCollisionData *NEA_BoneCollisionLoad(const void *data)
     return bcd;
 }
 
+// Internal use... see NEAFAT.c and NEAArena.c
+char *ne_fat_load_data_temp(const char *filename);
+void ne_arena_temp_free(void *ptr);
+
 NEA_BoneCollisionData *NEA_BoneCollisionLoadFAT(const char *path)
 {
     NEA_AssertPointer(path, "NULL path");
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
-    {
-        NEA_DebugPrint("Can't open %s", path);
+    void *data = ne_fat_load_data_temp(path);
+    if (data == NULL)
         return NULL;
+
+    NEA_BoneCollisionData *bcd = NEA_BoneCollisionLoad(data);
+    ne_arena_temp_free(data);
+    return bcd;
+}
+
+void NEA_BoneCollisionFree(NEA_BoneCollisionData *bcd)
+{
+    NEA_BoneCollisionCacheClear();
+    free(bcd);
+}
+
+// =========================================================================
+// Cache of world-space bone positions
+// =========================================================================
+
+// World-space positions of the bones of a model. They are only valid while
+// the animation, frame, position and scale of the model don't change, so they
+// are usually reused by all queries done in the same frame.
+typedef struct {
+    const NEA_Model *model; // NULL if the entry is free
+    const NEA_BoneCollisionData *bcd;
+    const void *dsa_file;
+    int32_t frame;
+    int32_t x, y, z;
+    int32_t sx, sy, sz;
+    uint32_t valid;         // Bit mask of bones whose position is in 'pos'
+    bool has_bounds;
+    NEA_Vec3 center;        // Sphere that contains all bone shapes
+    int32_t radius;
+    NEA_Vec3 pos[NEA_MAX_COLLISION_BONES];
+} ne_bone_cache_t;
+
+static ne_bone_cache_t ne_bone_cache[NEA_BONE_COLLISION_CACHE_ENTRIES];
+static int ne_bone_cache_next; // Next entry to replace
+
+void NEA_BoneCollisionCacheClear(void)
+{
+    for (int i = 0; i < NEA_BONE_COLLISION_CACHE_ENTRIES; i++)
+        ne_bone_cache[i].model = NULL;
+
+    ne_bone_cache_next = 0;
+}
+
+// Internal use... see NEAModel.c
+int32_t ne_model_anim_phase_frame(const NEA_Model *model, int layer);
+
+// Returns the cache entry of a model, emptying it if the model has changed
+// since it was filled.
+static ne_bone_cache_t *ne_bone_cache_get(const NEA_Model *model,
+                                          const NEA_BoneCollisionData *bcd,
+                                          const NEA_AnimInfo *anim)
+{
+    ne_bone_cache_t *c = NULL;
+
+    // Members of animation groups use the frame of their phase
+    int32_t frame = ne_model_anim_phase_frame(model, 0);
+
+    for (int i = 0; i < NEA_BONE_COLLISION_CACHE_ENTRIES; i++)
+    {
+        if ((ne_bone_cache[i].model == model) && (ne_bone_cache[i].bcd == bcd))
+        {
+            c = &ne_bone_cache[i];
+            break;
+        }
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    if (c == NULL)
+    {
+        c = &ne_bone_cache[ne_bone_cache_next];
+        ne_bone_cache_next = (ne_bone_cache_next + 1)
+                             % NEA_BONE_COLLISION_CACHE_ENTRIES;
+        c->model = model;
+        c->bcd = bcd;
+        c->valid = 0;
+        c->has_bounds = false;
+    }
 
-    void *data = malloc(size);
-    if (data == NULL)
+    if ((c->dsa_file != anim->animation->data) ||
+        (c->frame != frame) ||
+        (c->x != model->x) || (c->y != model->y) || (c->z != model->z) ||
+        (c->sx != model->sx) || (c->sy != model->sy) || (c->sz != model->sz))
     {
-        NEA_DebugPrint("Not enough memory");
-        fclose(f);
-        return NULL;
+        c->dsa_file = anim->animation->data;
+        c->frame = frame;
+        c->x = model->x;
+        c->y = model->y;
+        c->z = model->z;
+        c->sx = model->sx;
+        c->sy = model->sy;
+        c->sz = model->sz;
+        c->valid = 0;
+        c->has_bounds = false;
     }
 
-    fread(data, 1, size, f);
-    fclose(f);
+    return c;
+}
 
-    NEA_BoneCollisionData *bcd = NEA_BoneCollisionLoad(data);
-    free(data);
-    return bcd;
+// Returns the world-space position of the shape of a bone, from the cache if
+// possible.
+static NEA_Vec3 ne_bone_cache_pos(ne_bone_cache_t *c, const NEA_Model *model,
+                                  const NEA_BoneCollisionData *bcd,
+                                  uint32_t bone_idx)
+{
+    if (c->valid & BIT(bone_idx))
+        return c->pos[bone_idx];
+
+    // Use the actual joint index from the binary (not the array index)
+    // to look up the correct bone in the animation data.
+    uint32_t joint = bcd->bones[bone_idx].joint_idx;
+
+    int32_t bone_pos[3];
+    int32_t bone_orient[4];
+    ne_get_bone_transform(c->dsa_file, c->frame, joint, bone_pos, bone_orient);
+
+    // Transform the collision offset by the bone's quaternion rotation
+    NEA_Vec3 rotated_offset = ne_quat_rotate_vec(bone_orient,
+                                                  bcd->bones[bone_idx].offset);
+
+    // Local position = bone position + rotated offset (in model space)
+    NEA_Vec3 local_pos = NEA_Vec3Add(
+        NEA_Vec3Make(bone_pos[0], bone_pos[1], bone_pos[2]),
+        rotated_offset);
+
+    // Apply model scale to the local-space position
+    local_pos.x = mulf32(local_pos.x, model->sx);
+    local_pos.y = mulf32(local_pos.y, model->sy);
+    local_pos.z = mulf32(local_pos.z, model->sz);
+
+    // World position = model position + scaled local position
+    NEA_Vec3 pos = NEA_Vec3Add(NEA_Vec3Make(model->x, model->y, model->z),
+                               local_pos);
+
+    c->pos[bone_idx] = pos;
+    c->valid |= BIT(bone_idx);
+
+    return pos;
 }
 
-void NEA_BoneCollisionFree(NEA_BoneCollisionData *bcd)
+// Returns the radius of a sphere centered at the shape that contains it, or -1
+// if it can't be calculated.
+static int32_t ne_shape_bounding_radius(const NEA_ColShape *shape)
 {
-    free(bcd);
+    switch (shape->type)
+    {
+        case NEA_COL_SPHERE:
+            return shape->shape.sphere.radius;
+        case NEA_COL_CAPSULE:
+            return shape->shape.capsule.radius
+                   + shape->shape.capsule.half_height;
+        case NEA_COL_AABB:
+            // Not tight, but it avoids the square root
+            return abs(shape->shape.aabb.half.x) + abs(shape->shape.aabb.half.y)
+                   + abs(shape->shape.aabb.half.z);
+        default:
+            return -1;
+    }
+}
+
+static void ne_bone_cache_bounds(ne_bone_cache_t *c, const NEA_Model *model,
+                                 const NEA_BoneCollisionData *bcd)
+{
+    if (c->has_bounds)
+        return;
+
+    NEA_Vec3 min = { 0 }, max = { 0 };
+    bool first = true;
+
+    for (uint32_t i = 0; i < bcd->num_bones; i++)
+    {
+        if (bcd->bones[i].shape.type == NEA_COL_NONE)
+            continue;
+
+        NEA_Vec3 p = ne_bone_cache_pos(c, model, bcd, i);
+
+        if (first)
+        {
+            min = max = p;
+            first = false;
+            continue;
+        }
+
+        min.x = p.x < min.x ? p.x : min.x;
+        min.y = p.y < min.y ? p.y : min.y;
+        min.z = p.z < min.z ? p.z : min.z;
+        max.x = p.x > max.x ? p.x : max.x;
+        max.y = p.y > max.y ? p.y : max.y;
+        max.z = p.z > max.z ? p.z : max.z;
+    }
+
+    NEA_Vec3 center = NEA_Vec3Make((min.x + max.x) / 2, (min.y + max.y) / 2,
+                                   (min.z + max.z) / 2);
+    int32_t radius = 0;
+
+    for (uint32_t i = 0; i < bcd->num_bones; i++)
+    {
+        if (bcd->bones[i].shape.type == NEA_COL_NONE)
+            continue;
+
+        NEA_Vec3 d = NEA_Vec3Sub(c->pos[i], center);
+        int64_t dist2 = (int64_t)d.x * d.x + (int64_t)d.y * d.y
+                      + (int64_t)d.z * d.z;
+        int32_t r = (int32_t)sqrt64((uint64_t)dist2)
+                  + ne_shape_bounding_radius(&bcd->bones[i].shape);
+
+        if (r > radius)
+            radius = r;
+    }
+
+    c->center = center;
+    c->radius = radius;
+    c->has_bounds = true;
 }
 
 // =========================================================================
@@ -276,33 +400,32 @@ int NEA_BoneCollisionGetWorldShape(const NEA_Model *model,
     if (anim == NULL || anim->animation == NULL)
         return 0;
 
-    // Use the actual joint index from the binary (not the array index)
-    // to look up the correct bone in the animation data.
-    uint32_t joint = bcd->bones[bone_idx].joint_idx;
+    ne_bone_cache_t *c = ne_bone_cache_get(model, bcd, anim);
 
-    int32_t bone_pos[3];
-    int32_t bone_orient[4];
-    ne_get_bone_transform(anim->animation->data, anim->currframe,
-                          joint, bone_pos, bone_orient);
+    *out_pos = ne_bone_cache_pos(c, model, bcd, bone_idx);
+    *out_shape = bcd->bones[bone_idx].shape;
 
-    // Transform the collision offset by the bone's quaternion rotation
-    NEA_Vec3 rotated_offset = ne_quat_rotate_vec(bone_orient,
-                                                  bcd->bones[bone_idx].offset);
+    return 1;
+}
 
-    // Local position = bone position + rotated offset (in model space)
-    NEA_Vec3 local_pos = NEA_Vec3Add(
-        NEA_Vec3Make(bone_pos[0], bone_pos[1], bone_pos[2]),
-        rotated_offset);
+int NEA_BoneCollisionGetBounds(const NEA_Model *model,
+                               const NEA_BoneCollisionData *bcd,
+                               NEA_Vec3 *out_center, int32_t *out_radius)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+    NEA_AssertPointer(bcd, "NULL bone collision data");
+    NEA_AssertPointer(out_center, "NULL out_center");
+    NEA_AssertPointer(out_radius, "NULL out_radius");
 
-    // Apply model scale to the local-space position
-    local_pos.x = mulf32(local_pos.x, model->sx);
-    local_pos.y = mulf32(local_pos.y, model->sy);
-    local_pos.z = mulf32(local_pos.z, model->sz);
+    const NEA_AnimInfo *anim = model->animinfo[0];
+    if (anim == NULL || anim->animation == NULL)
+        return 0;
 
-    // World position = model position + scaled local position
-    *out_pos = NEA_Vec3Add(NEA_Vec3Make(model->x, model->y, model->z),
-                           local_pos);
-    *out_shape = bcd->bones[bone_idx].shape;
+    ne_bone_cache_t *c = ne_bone_cache_get(model, bcd, anim);
+    ne_bone_cache_bounds(c, model, bcd);
+
+    *out_center = c->center;
+    *out_radius = c->radius;
 
     return 1;
 }
@@ -322,6 +445,25 @@ NEA_ColResult NEA_BoneCollisionTest(const NEA_Model *model,
     if (out_bone != NULL)
         *out_bone = -1;
 
+    // Reject shapes that are far from all bones before testing them
+    int32_t other_radius = ne_shape_bounding_radius(other);
+    if (other_radius >= 0)
+    {
+        NEA_Vec3 center;
+        int32_t radius;
+
+        if (!NEA_BoneCollisionGetBounds(model, bcd, &center, &radius))
+            return best;
+
+        NEA_Vec3 d = NEA_Vec3Sub(other_pos, center);
+        int64_t dist2 = (int64_t)d.x * d.x + (int64_t)d.y * d.y
+                      + (int64_t)d.z * d.z;
+        int64_t sum = (int64_t)radius + other_radius;
+
+        if (dist2 > sum * sum)
+            return best;
+    }
+
     for (uint32_t i = 0; i < bcd->num_bones; i++)
     {
         if (bcd->bones[i].shape.type == NEA_COL_NONE)
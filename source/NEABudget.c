@@ -0,0 +1,200 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEABudget.c
+
+// Internal use... see NEAModel.c
+extern bool ne_model_frustum_culling;
+
+static bool ne_budget_enabled = false;
+static int ne_budget_target_polys = NEA_BUDGET_DEFAULT_POLYGONS;
+static int ne_budget_target_verts = NEA_BUDGET_DEFAULT_VERTICES;
+static NEA_BudgetCallback ne_budget_callback = NULL;
+
+static int ne_budget_level = 0;
+static bool ne_budget_user_culling; // Culling setting before the first level
+
+// Peak usage of the last frames, as a fraction of the target (f32)
+static int32_t ne_budget_history[NEA_BUDGET_HISTORY];
+static int ne_budget_history_pos;
+static int ne_budget_samples; // Samples since the last change of level
+
+// Counters of the last frame of each pass
+static int ne_budget_pass_polys[NEA_TWO_PASS_MAX_BANDS];
+static int ne_budget_pass_verts[NEA_TWO_PASS_MAX_BANDS];
+static unsigned int ne_budget_pass_stamp[NEA_TWO_PASS_MAX_BANDS];
+static unsigned int ne_budget_stamp;
+
+static void ne_budget_reset_history(void)
+{
+    for (int i = 0; i < NEA_BUDGET_HISTORY; i++)
+        ne_budget_history[i] = 0;
+
+    ne_budget_history_pos = 0;
+    ne_budget_samples = 0;
+}
+
+static void ne_budget_set_level(int level)
+{
+    if (level == ne_budget_level)
+        return;
+
+    // Force frustum culling while there is pressure, and restore the setting
+    // of the application afterwards.
+    if (ne_budget_level == 0)
+    {
+        ne_budget_user_culling = ne_model_frustum_culling;
+        ne_model_frustum_culling = true;
+    }
+    else if (level == 0)
+    {
+        ne_model_frustum_culling = ne_budget_user_culling;
+    }
+
+    ne_budget_level = level;
+    ne_budget_reset_history();
+
+    if (ne_budget_callback)
+        ne_budget_callback(level, NEA_BudgetGetPolygonHeadroom());
+}
+
+void NEA_BudgetEnable(bool enable)
+{
+    if (enable == ne_budget_enabled)
+        return;
+
+    if (!enable)
+        ne_budget_set_level(0);
+
+    ne_budget_reset_history();
+    ne_budget_enabled = enable;
+}
+
+void NEA_BudgetSetTarget(int polygons, int vertices)
+{
+    if (polygons < 1)
+        polygons = NEA_BUDGET_DEFAULT_POLYGONS;
+    if (vertices < 1)
+        vertices = NEA_BUDGET_DEFAULT_VERTICES;
+
+    NEA_AssertMinMax(1, polygons, NEA_BUDGET_MAX_POLYGONS,
+                     "Invalid polygon target %d", polygons);
+    NEA_AssertMinMax(1, vertices, NEA_BUDGET_MAX_VERTICES,
+                     "Invalid vertex target %d", vertices);
+
+    ne_budget_target_polys = polygons;
+    ne_budget_target_verts = vertices;
+}
+
+void NEA_BudgetSetCallback(NEA_BudgetCallback callback)
+{
+    ne_budget_callback = callback;
+}
+
+int NEA_BudgetGetLevel(void)
+{
+    return ne_budget_level;
+}
+
+int32_t NEA_BudgetGetLODScale(void)
+{
+    // 1.0, 0.75, 0.5, 0.25
+    return inttof32(NEA_BUDGET_LEVEL_MAX + 1 - ne_budget_level)
+           / (NEA_BUDGET_LEVEL_MAX + 1);
+}
+
+// Returns true if the pass has been sampled recently enough to be part of the
+// current execution mode. Two-pass modes sample each band once every
+// NEA_TwoPassGetBands() frames.
+static bool ne_budget_pass_active(int pass)
+{
+    return (ne_budget_stamp - ne_budget_pass_stamp[pass])
+           < NEA_TWO_PASS_MAX_BANDS;
+}
+
+int NEA_BudgetGetPolygonHeadroom(void)
+{
+    int used = 0;
+
+    for (int i = 0; i < NEA_TWO_PASS_MAX_BANDS; i++)
+    {
+        if (ne_budget_pass_active(i) && (ne_budget_pass_polys[i] > used))
+            used = ne_budget_pass_polys[i];
+    }
+
+    return NEA_BUDGET_MAX_POLYGONS - used;
+}
+
+int NEA_BudgetGetVertexHeadroom(void)
+{
+    int used = 0;
+
+    for (int i = 0; i < NEA_TWO_PASS_MAX_BANDS; i++)
+    {
+        if (ne_budget_pass_active(i) && (ne_budget_pass_verts[i] > used))
+            used = ne_budget_pass_verts[i];
+    }
+
+    return NEA_BUDGET_MAX_VERTICES - used;
+}
+
+int NEA_BudgetGetPassPolygons(int pass)
+{
+    NEA_AssertMinMax(0, pass, NEA_TWO_PASS_MAX_BANDS - 1,
+                     "Invalid pass %d", pass);
+
+    return ne_budget_pass_polys[pass];
+}
+
+// Internal use... see NEAGeneral.c. It is called before swapping the buffers
+// at the end of each 3D frame.
+void ne_budget_frame_end(int pass)
+{
+    if (!ne_budget_enabled)
+        return;
+
+    int polys = NEA_GetPolygonCount();
+    int verts = NEA_GetVertexCount();
+
+    ne_budget_stamp++;
+    ne_budget_pass_polys[pass] = polys;
+    ne_budget_pass_verts[pass] = verts;
+    ne_budget_pass_stamp[pass] = ne_budget_stamp;
+
+    int32_t usage = divf32(inttof32(polys), inttof32(ne_budget_target_polys));
+    int32_t usage_verts = divf32(inttof32(verts),
+                                 inttof32(ne_budget_target_verts));
+    if (usage_verts > usage)
+        usage = usage_verts;
+
+    ne_budget_history[ne_budget_history_pos] = usage;
+    ne_budget_history_pos = (ne_budget_history_pos + 1) % NEA_BUDGET_HISTORY;
+    if (ne_budget_samples < NEA_BUDGET_HISTORY)
+        ne_budget_samples++;
+
+    int32_t peak = 0;
+    for (int i = 0; i < NEA_BUDGET_HISTORY; i++)
+    {
+        if (ne_budget_history[i] > peak)
+            peak = ne_budget_history[i];
+    }
+
+    // React to a peak right away, but only relax the level after a whole
+    // window of frames well under the target.
+    if (usage > inttof32(1))
+    {
+        if (ne_budget_level < NEA_BUDGET_LEVEL_MAX)
+            ne_budget_set_level(ne_budget_level + 1);
+    }
+    else if ((ne_budget_samples == NEA_BUDGET_HISTORY) &&
+             (peak < floattof32(0.75)))
+    {
+        if (ne_budget_level > 0)
+            ne_budget_set_level(ne_budget_level - 1);
+    }
+}
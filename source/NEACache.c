@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEACache.c
+
+// Internal use... see NEAPack.c
+const char *ne_pack_normalize(const char *path);
+u32 ne_pack_hash(const char *path);
+
+typedef struct {
+    char *path;       // Normalized path, or NULL if the entry is free
+    u32 hash;         // Hash of the normalized path
+    NEA_CacheType type;
+    u32 params;       // Load parameters that are part of the key (GRF flags)
+    void *asset;
+    int refs;
+} ne_cache_entry_t;
+
+// Value of params that matches any entry in ne_cache_find()
+#define NE_CACHE_ANY_PARAMS UINT32_MAX
+
+static ne_cache_entry_t ne_cache_entries[NEA_CACHE_MAX_ENTRIES];
+static int ne_cache_count;
+
+static void ne_cache_delete_asset(NEA_CacheType type, void *asset)
+{
+    switch (type)
+    {
+        case NEA_CACHE_MESH:
+            free(asset);
+            break;
+        case NEA_CACHE_ANIMATION:
+            NEA_AnimationDelete(asset);
+            break;
+        case NEA_CACHE_TEXTURE:
+            NEA_MaterialDelete(asset);
+            break;
+        case NEA_CACHE_PALETTE:
+            NEA_PaletteDelete(asset);
+            break;
+        case NEA_CACHE_COLMESH:
+            NEA_ColMeshFree(asset);
+            break;
+        case NEA_CACHE_ANIMMAT:
+            NEA_AnimMatDataFree(asset);
+            break;
+    }
+}
+
+static ne_cache_entry_t *ne_cache_find(NEA_CacheType type, const char *path,
+                                       u32 params)
+{
+    path = ne_pack_normalize(path);
+    u32 hash = ne_pack_hash(path);
+
+    for (int i = 0; i < NEA_CACHE_MAX_ENTRIES; i++)
+    {
+        ne_cache_entry_t *e = &ne_cache_entries[i];
+
+        if ((e->path == NULL) || (e->hash != hash) || (e->type != type))
+            continue;
+
+        if ((params != NE_CACHE_ANY_PARAMS) && (e->params != params))
+            continue;
+
+        if (strcmp(e->path, path) == 0)
+            return e;
+    }
+
+    return NULL;
+}
+
+static ne_cache_entry_t *ne_cache_find_asset(const void *asset)
+{
+    for (int i = 0; i < NEA_CACHE_MAX_ENTRIES; i++)
+    {
+        ne_cache_entry_t *e = &ne_cache_entries[i];
+
+        if ((e->path != NULL) && (e->asset == asset))
+            return e;
+    }
+
+    return NULL;
+}
+
+static void *ne_cache_get(NEA_CacheType type, const char *path, u32 params)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    ne_cache_entry_t *e = ne_cache_find(type, path, params);
+    if (e == NULL)
+        return NULL;
+
+    e->refs++;
+    return e->asset;
+}
+
+static void *ne_cache_add(NEA_CacheType type, const char *path, u32 params,
+                          void *asset)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+    NEA_AssertPointer(asset, "NULL asset pointer");
+
+    // The same file may have been loaded twice, keep the first copy
+    ne_cache_entry_t *e = ne_cache_find(type, path, params);
+    if (e != NULL)
+    {
+        if (e->asset != asset)
+            ne_cache_delete_asset(type, asset);
+
+        e->refs++;
+        return e->asset;
+    }
+
+    for (int i = 0; i < NEA_CACHE_MAX_ENTRIES; i++)
+    {
+        e = &ne_cache_entries[i];
+        if (e->path != NULL)
+            continue;
+
+        const char *normalized = ne_pack_normalize(path);
+
+        e->path = malloc(strlen(normalized) + 1);
+        if (e->path == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            ne_cache_delete_asset(type, asset);
+            return NULL;
+        }
+
+        strcpy(e->path, normalized);
+        e->hash = ne_pack_hash(normalized);
+        e->type = type;
+        e->params = params;
+        e->asset = asset;
+        e->refs = 1;
+
+        ne_cache_count++;
+
+        return asset;
+    }
+
+    NEA_DebugPrint("No free slots in the cache");
+    ne_cache_delete_asset(type, asset);
+    return NULL;
+}
+
+void *NEA_CacheGet(NEA_CacheType type, const char *path)
+{
+    return ne_cache_get(type, path, NE_CACHE_ANY_PARAMS);
+}
+
+void *NEA_CacheAdd(NEA_CacheType type, const char *path, void *asset)
+{
+    return ne_cache_add(type, path, 0, asset);
+}
+
+void *NEA_CacheLoadMesh(const char *path)
+{
+    void *data = NEA_CacheGet(NEA_CACHE_MESH, path);
+    if (data != NULL)
+        return data;
+
+    data = NEA_FATLoadData(path);
+    if (data == NULL)
+        return NULL;
+
+    return NEA_CacheAdd(NEA_CACHE_MESH, path, data);
+}
+
+NEA_Animation *NEA_CacheLoadAnimation(const char *path)
+{
+    NEA_Animation *anim = NEA_CacheGet(NEA_CACHE_ANIMATION, path);
+    if (anim != NULL)
+        return anim;
+
+    anim = NEA_AnimationCreate();
+    if (anim == NULL)
+        return NULL;
+
+    if (NEA_AnimationLoadFAT(anim, path) == 0)
+    {
+        NEA_AnimationDelete(anim);
+        return NULL;
+    }
+
+    return NEA_CacheAdd(NEA_CACHE_ANIMATION, path, anim);
+}
+
+// Internal use... see NEAScene.c. Like NEA_CacheGet() and NEA_CacheAdd() for
+// textures loaded with the provided flags.
+NEA_Material *ne_cache_get_texture(const char *path, NEA_TextureFlags flags)
+{
+    return ne_cache_get(NEA_CACHE_TEXTURE, path, flags);
+}
+
+NEA_Material *ne_cache_add_texture(const char *path, NEA_TextureFlags flags,
+                                   NEA_Material *mat)
+{
+    return ne_cache_add(NEA_CACHE_TEXTURE, path, flags, mat);
+}
+
+NEA_Material *NEA_CacheLoadTextureGRF(const char *path, NEA_TextureFlags flags)
+{
+    // The same file loaded with different flags is a different texture
+    NEA_Material *mat = ne_cache_get(NEA_CACHE_TEXTURE, path, flags);
+    if (mat != NULL)
+        return mat;
+
+    mat = NEA_MaterialCreate();
+    if (mat == NULL)
+        return NULL;
+
+    if (NEA_MaterialTexLoadGRF(mat, NULL, flags, path) == 0)
+    {
+        NEA_MaterialDelete(mat);
+        return NULL;
+    }
+
+    return ne_cache_add(NEA_CACHE_TEXTURE, path, flags, mat);
+}
+
+NEA_Palette *NEA_CacheLoadPalette(const char *path, NEA_TextureFormat format)
+{
+    NEA_Palette *pal = NEA_CacheGet(NEA_CACHE_PALETTE, path);
+    if (pal != NULL)
+        return pal;
+
+    pal = NEA_PaletteCreate();
+    if (pal == NULL)
+        return NULL;
+
+    if (NEA_PaletteLoadFAT(pal, path, format) == 0)
+    {
+        NEA_PaletteDelete(pal);
+        return NULL;
+    }
+
+    return NEA_CacheAdd(NEA_CACHE_PALETTE, path, pal);
+}
+
+NEA_ColMesh *NEA_CacheLoadColMesh(const char *path)
+{
+    NEA_ColMesh *mesh = NEA_CacheGet(NEA_CACHE_COLMESH, path);
+    if (mesh != NULL)
+        return mesh;
+
+    mesh = NEA_ColMeshLoadFAT(path);
+    if (mesh == NULL)
+        return NULL;
+
+    return NEA_CacheAdd(NEA_CACHE_COLMESH, path, mesh);
+}
+
+NEA_AnimMatData *NEA_CacheLoadAnimMatData(const char *path)
+{
+    NEA_AnimMatData *data = NEA_CacheGet(NEA_CACHE_ANIMMAT, path);
+    if (data != NULL)
+        return data;
+
+    data = NEA_AnimMatDataLoadFAT(path);
+    if (data == NULL)
+        return NULL;
+
+    return NEA_CacheAdd(NEA_CACHE_ANIMMAT, path, data);
+}
+
+int NEA_CacheRetain(const void *asset)
+{
+    NEA_AssertPointer(asset, "NULL asset pointer");
+
+    ne_cache_entry_t *e = ne_cache_find_asset(asset);
+    if (e == NULL)
+    {
+        NEA_DebugPrint("Asset not cached");
+        return 0;
+    }
+
+    e->refs++;
+    return 1;
+}
+
+void NEA_CacheRelease(const void *asset)
+{
+    if (asset == NULL)
+        return;
+
+    ne_cache_entry_t *e = ne_cache_find_asset(asset);
+    if (e == NULL)
+    {
+        NEA_DebugPrint("Asset not cached");
+        return;
+    }
+
+    e->refs--;
+    if (e->refs > 0)
+        return;
+
+    ne_cache_delete_asset(e->type, e->asset);
+    free(e->path);
+    e->path = NULL;
+    e->asset = NULL;
+
+    ne_cache_count--;
+}
+
+int NEA_CacheGetRefCount(const void *asset)
+{
+    ne_cache_entry_t *e = ne_cache_find_asset(asset);
+    if (e == NULL)
+        return 0;
+
+    return e->refs;
+}
+
+int NEA_CacheGetCount(void)
+{
+    return ne_cache_count;
+}
+
+void NEA_CacheDeleteAll(void)
+{
+    for (int i = 0; i < NEA_CACHE_MAX_ENTRIES; i++)
+    {
+        ne_cache_entry_t *e = &ne_cache_entries[i];
+        if (e->path == NULL)
+            continue;
+
+        ne_cache_delete_asset(e->type, e->asset);
+        free(e->path);
+        e->path = NULL;
+        e->asset = NULL;
+    }
+
+    ne_cache_count = 0;
+}
@@ -5,13 +5,38 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAMath.h"
+#include "NEAPool.h"
 
 /// @file NEACamera.c
 
-static NEA_Camera **NEA_UserCamera;
+static ne_pool_t ne_camera_pool;
+
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_camera_static, NEA_Camera, NEA_STATIC_MAX_CAMERAS);
+#endif
 static int NEA_MAX_CAMERAS;
 static bool ne_camera_system_inited = false;
 
+// Planes of the active view frustum (a, b, c, d) with a normal of length 1
+// that points inside the frustum. All of them are f32.
+static int32_t ne_frustum_planes[6][4];
+static int32_t ne_frustum_clip[16]; // Clip matrix the planes were taken from
+static bool ne_frustum_valid = false;
+
+// Location and axes of the last camera passed to NEA_CameraUse()
+static int32_t ne_camera_active_from[3];
+static int32_t ne_camera_active_right[3];
+static int32_t ne_camera_active_up[3];
+static int32_t ne_camera_active_back[3];
+static bool ne_camera_active_valid = false;
+
+// Changes whenever the camera used last moves. It's never 0.
+static uint32_t ne_camera_active_stamp_value = 1;
+
+// Internal use... see NEAGeneral.c
+void ne_projection_frustum(int32_t *frustum);
+
 // Internal use only
 ARM_CODE static void __NEA_CameraUpdateMatrix(NEA_Camera * cam)
 {
@@ -21,11 +46,11 @@ ARM_CODE static void __NEA_CameraUpdateMatrix(NEA_Camera * cam)
     for (int i = 0; i < 3; i++)
         forward[i] = cam->from[i] - cam->to[i];
 
-    normalizef32(forward);
+    ne_normalize(forward);
 
     crossf32(cam->up, forward, side);
 
-    normalizef32(side);
+    ne_normalize(side);
 
     // Recompute local up
     crossf32(forward, side, up);
@@ -51,38 +76,137 @@ ARM_CODE static void __NEA_CameraUpdateMatrix(NEA_Camera * cam)
     cam->matrix.m[15] = inttof32(1);
 }
 
-NEA_Camera *NEA_CameraCreate(void)
+// Makes the normal of a plane (a, b, c, d) have a length of 1
+static void ne_plane_normalize(int32_t *plane)
 {
-    if (!ne_camera_system_inited)
+    int64_t len2 = (int64_t)plane[0] * plane[0]
+                 + (int64_t)plane[1] * plane[1]
+                 + (int64_t)plane[2] * plane[2];
+
+    int32_t len = sqrt64(len2);
+    if (len == 0)
+        return;
+
+    for (int i = 0; i < 4; i++)
+        plane[i] = divf32(plane[i], len);
+}
+
+// Calculates the view-projection matrix and the frustum planes of a camera
+// from its view matrix and a frustum in the format of glFrustumf32().
+ARM_CODE static void ne_camera_update_frustum(NEA_Camera *cam,
+                                              const int32_t *frustum)
+{
+    int32_t l = frustum[0], r = frustum[1];
+    int32_t b = frustum[2], t = frustum[3];
+    int32_t n = frustum[4], f = frustum[5];
+
+    // Same matrix as glFrustumf32()
+    int32_t proj[16] = { 0 };
+    proj[0] = divf32(2 * n, r - l);
+    proj[5] = divf32(2 * n, t - b);
+    proj[8] = divf32(r + l, r - l);
+    proj[9] = divf32(t + b, t - b);
+    proj[10] = -divf32(f + n, f - n);
+    proj[11] = -inttof32(1);
+    proj[14] = -divf32(2 * mulf32(f, n), f - n);
+
+    const int32_t *view = cam->matrix.m;
+
+    for (int i = 0; i < 4; i++)
     {
-        NEA_DebugPrint("System not initialized");
-        return NULL;
+        for (int j = 0; j < 4; j++)
+        {
+            int64_t sum = 0;
+            for (int k = 0; k < 4; k++)
+                sum += (int64_t)view[i * 4 + k] * proj[k * 4 + j];
+            cam->view_proj.m[i * 4 + j] = sum >> 12;
+        }
     }
 
-    for (int i = 0; i < NEA_MAX_CAMERAS; i++)
+    // Planes in view space, the camera looks at -Z. The side planes go through
+    // the origin and the edges of the near plane.
+    int32_t planes[6][4] = {
+        { n, 0, l, 0 },             // Left
+        { -n, 0, -r, 0 },           // Right
+        { 0, n, b, 0 },             // Bottom
+        { 0, -n, -t, 0 },           // Top
+        { 0, 0, -inttof32(1), -n }, // Near
+        { 0, 0, inttof32(1), f },   // Far
+    };
+
+    for (int i = 0; i < 6; i++)
     {
-        if (NEA_UserCamera[i] != NULL)
-            continue;
+        int32_t *in = &planes[i][0];
+        int32_t *out = &cam->planes[i][0];
 
-        NEA_Camera *cam = calloc(1, sizeof(NEA_Camera));
-        if (cam == NULL)
+        if (i < 4)
+            ne_plane_normalize(in);
+
+        // The view matrix is orthonormal, so the normal keeps its length
+        for (int k = 0; k < 3; k++)
         {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
+            out[k] = mulf32(in[0], view[k * 4]) + mulf32(in[1], view[k * 4 + 1])
+                   + mulf32(in[2], view[k * 4 + 2]);
         }
 
-        cam->to[2] = inttof32(1);
-        cam->up[1] = inttof32(1);
+        out[3] = in[3] + mulf32(in[0], view[12]) + mulf32(in[1], view[13])
+               + mulf32(in[2], view[14]);
+    }
+
+    for (int i = 0; i < 6; i++)
+        cam->frustum[i] = frustum[i];
+    cam->frustum_is_updated = true;
+}
 
-        cam->matrix_is_updated = false;
-        NEA_UserCamera[i] = cam;
+// Updates the view matrix of a camera if it has changed, and its frustum if the
+// view matrix or the projection of the engine have changed.
+static void ne_camera_update(NEA_Camera *cam)
+{
+    int32_t frustum[6];
+    ne_projection_frustum(frustum);
+
+    if (!cam->matrix_is_updated)
+    {
+        __NEA_CameraUpdateMatrix(cam);
+        cam->matrix_is_updated = true;
+        cam->frustum_is_updated = false;
+    }
+
+    if (cam->frustum_is_updated &&
+        memcmp(frustum, cam->frustum, sizeof(frustum)) == 0)
+        return;
+
+    ne_camera_update_frustum(cam, frustum);
+}
+
+NEA_Camera *NEA_CameraCreate(void)
+{
+    if (!ne_camera_system_inited)
+    {
+        NEA_DebugPrint("System not initialized");
+        return NULL;
+    }
+
+    if (ne_pool_next_slot(&ne_camera_pool) < 0)
+    {
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        return cam;
+    NEA_Camera *cam = ne_pool_object_alloc(&ne_camera_pool, sizeof(NEA_Camera));
+    if (cam == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
     }
 
-    NEA_DebugPrint("No free slots");
+    cam->to[2] = inttof32(1);
+    cam->up[1] = inttof32(1);
 
-    return NULL;
+    cam->matrix_is_updated = false;
+    ne_pool_add(&ne_camera_pool, cam);
+
+    return cam;
 }
 
 void NEA_CameraSetI(NEA_Camera *cam, int xfrom, int yfrom, int zfrom,
@@ -107,15 +231,211 @@ void NEA_CameraSetI(NEA_Camera *cam, int xfrom, int yfrom, int zfrom,
 
 void NEA_CameraUse(NEA_Camera *cam)
 {
+    NEA_DisplayListWait();
+
     NEA_AssertPointer(cam, "NULL pointer");
 
-    if (!cam->matrix_is_updated)
+    ne_camera_update(cam);
+
+    glLoadMatrix4x4(&cam->matrix);
+
+    // The distances cached by the models stay valid if the camera that is used
+    // is at the same place, like the same camera used for several frames.
+    if (!ne_camera_active_valid ||
+        (ne_camera_active_from[0] != cam->from[0]) ||
+        (ne_camera_active_from[1] != cam->from[1]) ||
+        (ne_camera_active_from[2] != cam->from[2]))
     {
-        __NEA_CameraUpdateMatrix(cam);
-        cam->matrix_is_updated = true;
+        if (++ne_camera_active_stamp_value == 0)
+            ne_camera_active_stamp_value = 1;
     }
 
-    glLoadMatrix4x4(&cam->matrix);
+    for (int i = 0; i < 3; i++)
+    {
+        ne_camera_active_from[i] = cam->from[i];
+        ne_camera_active_right[i] = cam->matrix.m[i * 4];
+        ne_camera_active_up[i] = cam->matrix.m[i * 4 + 1];
+        ne_camera_active_back[i] = cam->matrix.m[i * 4 + 2];
+    }
+    ne_camera_active_valid = true;
+
+    // Engine culling uses the cached frustum of the camera
+    memcpy(ne_frustum_planes, cam->planes, sizeof(ne_frustum_planes));
+    memcpy(ne_frustum_clip, cam->view_proj.m, sizeof(ne_frustum_clip));
+    ne_frustum_valid = true;
+
+    // Weak reference: the light manager has to write the light vectors again
+    // because they are transformed by the new matrix.
+    extern void NEA_LightManagerInvalidate(void) __attribute__((weak));
+    if (NEA_LightManagerInvalidate)
+        NEA_LightManagerInvalidate();
+}
+
+// Internal use: returns the location of the camera used last. It returns false
+// if no camera has been used since the camera system was reset.
+bool ne_camera_active_position(int32_t *pos)
+{
+    if (!ne_camera_active_valid)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        pos[i] = ne_camera_active_from[i];
+
+    return true;
+}
+
+// Internal use: returns a value that changes whenever the camera used last
+// moves, or 0 if no camera has been used since the camera system was reset.
+// See NEAModel.c
+uint32_t ne_camera_active_stamp(void)
+{
+    if (!ne_camera_active_valid)
+        return 0;
+
+    return ne_camera_active_stamp_value;
+}
+
+// Internal use: returns the right and up vectors of the camera used last, in
+// world space. It returns false if no camera has been used since the camera
+// system was reset.
+bool ne_camera_active_axes(int32_t *right, int32_t *up)
+{
+    if (!ne_camera_active_valid)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+    {
+        right[i] = ne_camera_active_right[i];
+        up[i] = ne_camera_active_up[i];
+    }
+
+    return true;
+}
+
+// Internal use: returns the location and the axes of a camera in world space,
+// or of the camera used last if cam is NULL. The back vector points away from
+// the point the camera looks at. It returns false if there is no camera. See
+// NEAPick.c
+bool ne_camera_get_basis(NEA_Camera *cam, int32_t *pos, int32_t *right,
+                         int32_t *up, int32_t *back)
+{
+    if (cam == NULL)
+    {
+        if (!ne_camera_active_valid)
+            return false;
+
+        for (int i = 0; i < 3; i++)
+        {
+            pos[i] = ne_camera_active_from[i];
+            right[i] = ne_camera_active_right[i];
+            up[i] = ne_camera_active_up[i];
+            back[i] = ne_camera_active_back[i];
+        }
+
+        return true;
+    }
+
+    ne_camera_update(cam);
+
+    for (int i = 0; i < 3; i++)
+    {
+        pos[i] = cam->from[i];
+        right[i] = cam->matrix.m[i * 4];
+        up[i] = cam->matrix.m[i * 4 + 1];
+        back[i] = cam->matrix.m[i * 4 + 2];
+    }
+
+    return true;
+}
+
+// Internal use: returns the clip matrix that the frustum was captured from, or
+// NULL if it hasn't been captured since the last call to NEA_CameraUse().
+const int32_t *ne_camera_frustum_clip(void)
+{
+    if (!ne_frustum_valid)
+        return NULL;
+
+    return ne_frustum_clip;
+}
+
+ARM_CODE void NEA_CameraFrustumUpdate(void)
+{
+    int32_t *m = ne_frustum_clip;
+
+    // The clip matrix transforms row vectors, so column j of the matrix
+    // generates the clip coordinate j. The planes are w + x, w - x, w + y,
+    // w - y, w + z and w - z.
+    glGetFixed(GL_GET_MATRIX_CLIP, m);
+
+    for (int i = 0; i < 6; i++)
+    {
+        int axis = i >> 1;
+        int sign = (i & 1) ? -1 : 1;
+
+        int32_t *plane = &ne_frustum_planes[i][0];
+
+        for (int j = 0; j < 4; j++)
+            plane[j] = m[j * 4 + 3] + sign * m[j * 4 + axis];
+
+        ne_plane_normalize(plane);
+    }
+
+    ne_frustum_valid = true;
+}
+
+// Returns false if the sphere is completely outside of the planes
+ARM_CODE static bool ne_frustum_test_sphere(const int32_t (*planes)[4],
+                                            int x, int y, int z, int radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        const int32_t *plane = &planes[i][0];
+
+        int64_t dist = (int64_t)plane[0] * x + (int64_t)plane[1] * y
+                     + (int64_t)plane[2] * z + ((int64_t)plane[3] << 12);
+
+        if (dist < -((int64_t)radius << 12))
+            return false;
+    }
+
+    return true;
+}
+
+ARM_CODE bool NEA_CameraFrustumTestSphereI(int x, int y, int z, int radius)
+{
+    if (!ne_frustum_valid)
+        return true;
+
+    return ne_frustum_test_sphere(ne_frustum_planes, x, y, z, radius);
+}
+
+const m4x4 *NEA_CameraGetViewProjection(NEA_Camera *cam)
+{
+    NEA_AssertPointer(cam, "NULL pointer");
+
+    ne_camera_update(cam);
+
+    return &cam->view_proj;
+}
+
+const int32_t *NEA_CameraGetFrustumPlane(NEA_Camera *cam,
+                                         NEA_FrustumPlane plane)
+{
+    NEA_AssertPointer(cam, "NULL pointer");
+    NEA_AssertMinMax(0, plane, 5, "Invalid plane %d", plane);
+
+    ne_camera_update(cam);
+
+    return &cam->planes[plane][0];
+}
+
+bool NEA_CameraTestSphereI(NEA_Camera *cam, int x, int y, int z, int radius)
+{
+    NEA_AssertPointer(cam, "NULL pointer");
+
+    ne_camera_update(cam);
+
+    return ne_frustum_test_sphere(cam->planes, x, y, z, radius);
 }
 
 ARM_CODE void NEA_CameraMoveFreeI(NEA_Camera *cam, int front, int right, int up)
@@ -359,17 +679,15 @@ void NEA_CameraDelete(NEA_Camera *cam)
 {
     NEA_AssertPointer(cam, "NULL pointer");
 
-    for (int i = 0; i < NEA_MAX_CAMERAS; i++)
+    int slot = ne_pool_find(&ne_camera_pool, cam);
+    if (slot < 0)
     {
-        if (NEA_UserCamera[i] != cam)
-            continue;
-
-        NEA_UserCamera[i] = NULL;
-        free(cam);
+        NEA_DebugPrint("Object not found");
         return;
     }
 
-    NEA_DebugPrint("Object not found");
+    ne_pool_remove(&ne_camera_pool, slot);
+    ne_pool_object_free(&ne_camera_pool, cam);
 }
 
 int NEA_CameraSystemReset(int max_cameras)
@@ -382,12 +700,13 @@ int NEA_CameraSystemReset(int max_cameras)
     else
         NEA_MAX_CAMERAS = max_cameras;
 
-    NEA_UserCamera = calloc(NEA_MAX_CAMERAS, sizeof(NEA_UserCamera));
-    if (NEA_UserCamera == NULL)
-    {
-        NEA_DebugPrint("Not enough memory");
+    NEA_MAX_CAMERAS = NE_STATIC_CAPACITY(NEA_MAX_CAMERAS,
+                                         NEA_STATIC_MAX_CAMERAS);
+
+    if (NE_POOL_INIT(&ne_camera_pool, ne_camera_static, NEA_MAX_CAMERAS) == 0)
         return -1;
-    }
+
+    ne_camera_active_valid = false;
 
     ne_camera_system_inited = true;
     return 0;
@@ -398,29 +717,36 @@ void NEA_CameraSystemEnd(void)
     if (!ne_camera_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_CAMERAS; i++)
+    for (int i = ne_pool_count(&ne_camera_pool) - 1; i >= 0; i--)
     {
-        if (NEA_UserCamera[i])
-            NEA_CameraDelete(NEA_UserCamera[i]);
+        NEA_Camera *cam = ne_pool_get(&ne_camera_pool, i);
+        if (cam != NULL)
+            NEA_CameraDelete(cam);
     }
 
-    free(NEA_UserCamera);
+    ne_pool_end(&ne_camera_pool);
 
     ne_camera_system_inited = false;
 }
 
 void NEA_ViewPush(void)
 {
+    NEA_DisplayListWait();
+
     MATRIX_PUSH = 0;
 }
 
 void NEA_ViewPop(void)
 {
+    NEA_DisplayListWait();
+
     MATRIX_POP = 1;
 }
 
 void NEA_ViewMoveI(int x, int y, int z)
 {
+    NEA_DisplayListWait();
+
     MATRIX_TRANSLATE = x;
     MATRIX_TRANSLATE = y;
     MATRIX_TRANSLATE = z;
@@ -428,6 +754,8 @@ void NEA_ViewMoveI(int x, int y, int z)
 
 void NEA_ViewRotate(int rx, int ry, int rz)
 {
+    NEA_DisplayListWait();
+
     if (rx != 0)
         glRotateXi(rx << 6);
     if (ry != 0)
@@ -438,6 +766,8 @@ void NEA_ViewRotate(int rx, int ry, int rz)
 
 void NEA_ViewScaleI(int x, int y, int z)
 {
+    NEA_DisplayListWait();
+
     MATRIX_SCALE = x;
     MATRIX_SCALE = y;
     MATRIX_SCALE = z;
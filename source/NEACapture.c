@@ -0,0 +1,303 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEACapture.c
+
+#define NE_CAPTURE_WIDTH  256
+#define NE_CAPTURE_HEIGHT 192
+
+// Internal use... see NEATexture.c and NEAImpostor.c
+NEA_VRAMBankFlags ne_texture_used_banks(void);
+bool ne_impostor_uses_vram_d(void) __attribute__((weak));
+
+// Weak reference: the Hw2D system is only linked if the user uses it
+extern NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void) __attribute__((weak));
+
+typedef struct PACKED {
+    NEA_BMPHeader header;
+    NEA_BMPInfoHeader info;
+} ne_capture_bmp_t;
+
+static NEA_CaptureState ne_capture_state = NEA_CAPTURE_IDLE;
+static u16 *ne_capture_frame;   // Frame in RAM, top row first
+static FILE *ne_capture_file;   // File being written, or NULL
+static int ne_capture_bank;     // Bank used by the capture unit (0 to 3)
+static u8 ne_capture_bank_cr;   // Mapping of the bank before the capture
+static int ne_capture_row;      // Next row of the file
+static int ne_capture_rows = NEA_CAPTURE_DEFAULT_ROWS;
+
+static bool ne_capture_bank_free(NEA_VRAMBankFlags bank)
+{
+    if (ne_texture_used_banks() & bank)
+    {
+        NEA_DebugPrint("Bank used by textures");
+        return false;
+    }
+
+    if (NEA_Hw2DGetClaimedBanks && (NEA_Hw2DGetClaimedBanks() & bank))
+    {
+        NEA_DebugPrint("Bank used by Hw2D");
+        return false;
+    }
+
+    if ((bank == NEA_VRAM_D) && ne_impostor_uses_vram_d &&
+        ne_impostor_uses_vram_d())
+    {
+        NEA_DebugPrint("VRAM_D used by impostors");
+        return false;
+    }
+
+    return true;
+}
+
+static void ne_capture_close(void)
+{
+    if (ne_capture_file == NULL)
+        return;
+
+    fclose(ne_capture_file);
+    ne_capture_file = NULL;
+}
+
+static int ne_capture_write_header(void)
+{
+    size_t image_size = NE_CAPTURE_WIDTH * NE_CAPTURE_HEIGHT * 3;
+    ne_capture_bmp_t bmp = { 0 };
+
+    bmp.header.type = 0x4D42;
+    bmp.header.size = sizeof(bmp) + image_size;
+    bmp.header.offset = sizeof(bmp);
+
+    bmp.info.size = sizeof(NEA_BMPInfoHeader);
+    bmp.info.width = NE_CAPTURE_WIDTH;
+    bmp.info.height = NE_CAPTURE_HEIGHT;
+    bmp.info.planes = 1;
+    bmp.info.bits = 24;
+    bmp.info.imagesize = image_size;
+
+    return fwrite(&bmp, 1, sizeof(bmp), ne_capture_file) == sizeof(bmp);
+}
+
+// BMP files store the bottom row first, with pixels in BGR order
+static int ne_capture_write_row(int row)
+{
+    u8 line[NE_CAPTURE_WIDTH * 3];
+    const u16 *src = ne_capture_frame
+                   + (NE_CAPTURE_HEIGHT - 1 - row) * NE_CAPTURE_WIDTH;
+
+    for (int x = 0; x < NE_CAPTURE_WIDTH; x++)
+    {
+        u16 color = src[x];
+
+        line[x * 3 + 0] = ((color >> 10) & 31) << 3;
+        line[x * 3 + 1] = ((color >> 5) & 31) << 3;
+        line[x * 3 + 2] = (color & 31) << 3;
+    }
+
+    return fwrite(line, 1, sizeof(line), ne_capture_file) == sizeof(line);
+}
+
+int NEA_CaptureStart(const char *filename, NEA_VRAMBankFlags bank)
+{
+    if (NEA_CurrentExecutionMode() != NEA_ModeSingle3D)
+    {
+        NEA_DebugPrint("Only supported in single 3D mode");
+        return 0;
+    }
+
+    if ((ne_capture_state == NEA_CAPTURE_WAITING) ||
+        (ne_capture_state == NEA_CAPTURE_WRITING))
+    {
+        NEA_DebugPrint("Capture in progress");
+        return 0;
+    }
+
+    int index;
+    switch (bank)
+    {
+        case NEA_VRAM_A:
+            index = 0;
+            break;
+        case NEA_VRAM_B:
+            index = 1;
+            break;
+        case NEA_VRAM_C:
+            index = 2;
+            break;
+        case NEA_VRAM_D:
+            index = 3;
+            break;
+        default:
+            NEA_DebugPrint("Invalid bank");
+            return 0;
+    }
+
+    if (!ne_capture_bank_free(bank))
+        return 0;
+
+    if (REG_DISPCAPCNT & DCAP_ENABLE)
+    {
+        NEA_DebugPrint("Display capture is busy");
+        return 0;
+    }
+
+    if (ne_capture_frame == NULL)
+    {
+        ne_capture_frame = malloc(NE_CAPTURE_WIDTH * NE_CAPTURE_HEIGHT * 2);
+        if (ne_capture_frame == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+    }
+
+    if (filename != NULL)
+    {
+        ne_capture_file = fopen(filename, "wb");
+        if (ne_capture_file == NULL)
+        {
+            NEA_DebugPrint("%s couldn't be opened", filename);
+            return 0;
+        }
+    }
+
+    vu8 *cr = &VRAM_A_CR + index;
+    ne_capture_bank = index;
+    ne_capture_bank_cr = *cr;
+    *cr = VRAM_ENABLE; // LCD mode
+
+    // The capture starts with the next frame and it ends before its vertical
+    // blank, so the CPU doesn't need to wait for it.
+    REG_DISPCAPCNT = DCAP_BANK(index)
+                   | DCAP_SIZE(DCAP_SIZE_256x192)
+                   | DCAP_MODE(DCAP_MODE_A)
+                   | DCAP_SRC_A(DCAP_SRC_A_COMPOSITED)
+                   | DCAP_ENABLE;
+
+    ne_capture_state = NEA_CAPTURE_WAITING;
+    return 1;
+}
+
+void NEA_CaptureSetRowsPerUpdate(int rows)
+{
+    NEA_Assert(rows >= 0, "Invalid number of rows");
+
+    ne_capture_rows = rows > 0 ? rows : NEA_CAPTURE_DEFAULT_ROWS;
+}
+
+// Copies the captured frame to RAM and gives the bank back
+static void ne_capture_copy(void)
+{
+    const u16 *src = (const u16 *)((uintptr_t)VRAM_A
+                                   + ne_capture_bank * 128 * 1024);
+
+    memcpy(ne_capture_frame, src, NE_CAPTURE_WIDTH * NE_CAPTURE_HEIGHT * 2);
+
+    (&VRAM_A_CR)[ne_capture_bank] = ne_capture_bank_cr;
+
+    if (ne_capture_file == NULL)
+    {
+        ne_capture_state = NEA_CAPTURE_DONE;
+        return;
+    }
+
+    ne_capture_row = 0;
+    ne_capture_state = NEA_CAPTURE_WRITING;
+
+    if (!ne_capture_write_header())
+    {
+        NEA_DebugPrint("Failed to write file");
+        ne_capture_close();
+        ne_capture_state = NEA_CAPTURE_ERROR;
+    }
+}
+
+// Writes some rows of the file. It returns true when the file is complete.
+static bool ne_capture_write(int rows)
+{
+    int end = ne_capture_row + rows;
+    if (end > NE_CAPTURE_HEIGHT)
+        end = NE_CAPTURE_HEIGHT;
+
+    for ( ; ne_capture_row < end; ne_capture_row++)
+    {
+        if (!ne_capture_write_row(ne_capture_row))
+        {
+            NEA_DebugPrint("Failed to write file");
+            ne_capture_close();
+            ne_capture_state = NEA_CAPTURE_ERROR;
+            return true;
+        }
+    }
+
+    if (ne_capture_row < NE_CAPTURE_HEIGHT)
+        return false;
+
+    ne_capture_close();
+    ne_capture_state = NEA_CAPTURE_DONE;
+    return true;
+}
+
+void NEA_CaptureUpdate(void)
+{
+    if (ne_capture_state == NEA_CAPTURE_WAITING)
+    {
+        if (REG_DISPCAPCNT & DCAP_ENABLE)
+            return;
+
+        // Copying the frame is enough work for one update
+        ne_capture_copy();
+        return;
+    }
+
+    if (ne_capture_state == NEA_CAPTURE_WRITING)
+        ne_capture_write(ne_capture_rows);
+}
+
+void NEA_CaptureFlush(void)
+{
+    if (ne_capture_state == NEA_CAPTURE_WAITING)
+    {
+        while (REG_DISPCAPCNT & DCAP_ENABLE);
+
+        ne_capture_copy();
+    }
+
+    if (ne_capture_state == NEA_CAPTURE_WRITING)
+        ne_capture_write(NE_CAPTURE_HEIGHT);
+}
+
+NEA_CaptureState NEA_CaptureGetState(void)
+{
+    return ne_capture_state;
+}
+
+const u16 *NEA_CaptureGetFrame(void)
+{
+    if ((ne_capture_state == NEA_CAPTURE_IDLE) ||
+        (ne_capture_state == NEA_CAPTURE_WAITING))
+        return NULL;
+
+    return ne_capture_frame;
+}
+
+void NEA_CaptureEnd(void)
+{
+    if (ne_capture_state == NEA_CAPTURE_WAITING)
+    {
+        REG_DISPCAPCNT = 0;
+        (&VRAM_A_CR)[ne_capture_bank] = ne_capture_bank_cr;
+    }
+
+    ne_capture_close();
+
+    free(ne_capture_frame);
+    ne_capture_frame = NULL;
+
+    ne_capture_state = NEA_CAPTURE_IDLE;
+}
@@ -6,6 +6,10 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+#include "NEAMath.h"
+#include "NEAStats.h"
+#include "NEATCM.h"
 
 /// @file NEACollision.c
 
@@ -14,7 +18,9 @@
 // =========================================================================
 
 #define COLM_MAGIC   0x4D4C4F43  // "COLM" little-endian
-#define COLM_VERSION 1
+#define COLM_VERSION 2
+
+#define COLM_FLAG_BVH (1 << 0) // The triangles are followed by a BVH
 
 // .colmesh header layout
 typedef struct {
@@ -26,7 +32,7 @@ typedef struct {
     int32_t  aabb_max[3]; // f32
 } colmesh_header_t;
 
-// .colmesh per-triangle layout (12 x int32 = 48 bytes)
+// .colmesh per-triangle layout of version 1 (12 x int32 = 48 bytes)
 typedef struct {
     int32_t v0[3];
     int32_t v1[3];
@@ -34,6 +40,159 @@ typedef struct {
     int32_t normal[3];
 } colmesh_triangle_t;
 
+// Version 2 stores the derived data of the triangles too, with the layout of
+// NEA_ColTriangle (88 bytes).
+_Static_assert(sizeof(NEA_ColTriangle) == 88, "Triangle layout changed");
+
+// .colmesh BVH node layout (28 bytes). The BVH starts with the number of nodes
+// as an uint32_t. Nodes are stored in depth-first order.
+typedef struct {
+    int32_t  min[3];
+    int32_t  max[3];
+    uint16_t first;
+    uint16_t count;
+} colmesh_bvh_node_t;
+
+// =========================================================================
+// Vector math
+// =========================================================================
+
+// Returns d / len, with len bigger than 0. The reciprocal of len must have
+// been started with ne_recip_start(), so that the caller can do other work
+// while the divider is busy.
+static inline NEA_Vec3 ne_vec3_div_recip(NEA_Vec3 d, int32_t len)
+{
+    // The reciprocal of a very short length doesn't fit in 32 bits
+    if (len <= NE_RECIP_MIN_LEN)
+        return NEA_Vec3Make(divf32(d.x, len), divf32(d.y, len),
+                            divf32(d.z, len));
+
+    int32_t recip = ne_recip_result();
+    return NEA_Vec3Make(ne_recip_mul(d.x, recip), ne_recip_mul(d.y, recip),
+                        ne_recip_mul(d.z, recip));
+}
+
+NEA_Vec3 NEA_Vec3Normalize(NEA_Vec3 a)
+{
+    // The length is calculated with 24 fractional bits
+    uint64_t len_sq = (int64_t)a.x * a.x + (int64_t)a.y * a.y
+                    + (int64_t)a.z * a.z;
+    if (len_sq == 0)
+        return a;
+
+    int32_t len = sqrt64(len_sq);
+    ne_recip_start(len);
+    return ne_vec3_div_recip(a, len);
+}
+
+NEA_Vec3 NEA_Vec3NormalizeFast(NEA_Vec3 a)
+{
+    int32_t v[3] = { a.x, a.y, a.z };
+    ne_normalize_fast(v);
+    return NEA_Vec3Make(v[0], v[1], v[2]);
+}
+
+// =========================================================================
+// Vector3 arrays
+// =========================================================================
+
+// The components of each vector are read into locals before anything is
+// written, so that each iteration is one ldm and one stm, and so that the
+// destination can be the source array. Products are accumulated in 64 bits
+// (smull/smlal) and shifted once.
+
+NEA_HOT_CODE
+void NEA_Vec3ArrayTransform(NEA_Vec3 *dst, const NEA_Vec3 *src, int count,
+                            const m4x3 *mat)
+{
+    NEA_AssertPointer(dst, "NULL destination pointer");
+    NEA_AssertPointer(src, "NULL source pointer");
+    NEA_AssertPointer(mat, "NULL matrix pointer");
+
+    const int32_t *m = mat->m;
+    const int32_t m0 = m[0], m1 = m[1], m2 = m[2];
+    const int32_t m3 = m[3], m4 = m[4], m5 = m[5];
+    const int32_t m6 = m[6], m7 = m[7], m8 = m[8];
+    const int32_t tx = m[9], ty = m[10], tz = m[11];
+
+    for (int i = 0; i < count; i++)
+    {
+        int32_t x = src[i].x, y = src[i].y, z = src[i].z;
+
+        int64_t rx = (int64_t)x * m0 + (int64_t)y * m3 + (int64_t)z * m6;
+        int64_t ry = (int64_t)x * m1 + (int64_t)y * m4 + (int64_t)z * m7;
+        int64_t rz = (int64_t)x * m2 + (int64_t)y * m5 + (int64_t)z * m8;
+
+        dst[i].x = (int32_t)(rx >> 12) + tx;
+        dst[i].y = (int32_t)(ry >> 12) + ty;
+        dst[i].z = (int32_t)(rz >> 12) + tz;
+    }
+}
+
+NEA_HOT_CODE
+void NEA_Vec3ArrayDot(int32_t *dst, const NEA_Vec3 *a, const NEA_Vec3 *b,
+                      int count)
+{
+    NEA_AssertPointer(dst, "NULL destination pointer");
+    NEA_AssertPointer(a, "NULL vector pointer");
+    NEA_AssertPointer(b, "NULL vector pointer");
+
+    for (int i = 0; i < count; i++)
+    {
+        int32_t ax = a[i].x, ay = a[i].y, az = a[i].z;
+        int32_t bx = b[i].x, by = b[i].y, bz = b[i].z;
+
+        int64_t d = (int64_t)ax * bx + (int64_t)ay * by + (int64_t)az * bz;
+
+        dst[i] = (int32_t)(d >> 12);
+    }
+}
+
+NEA_HOT_CODE
+void NEA_Vec3ArrayBounds(const NEA_Vec3 *src, int count, NEA_Vec3 *min,
+                         NEA_Vec3 *max)
+{
+    NEA_AssertPointer(src, "NULL source pointer");
+    NEA_AssertPointer(min, "NULL min pointer");
+    NEA_AssertPointer(max, "NULL max pointer");
+
+    int32_t min_x = min->x, min_y = min->y, min_z = min->z;
+    int32_t max_x = max->x, max_y = max->y, max_z = max->z;
+
+    for (int i = 0; i < count; i++)
+    {
+        int32_t x = src[i].x, y = src[i].y, z = src[i].z;
+
+        if (x < min_x) min_x = x;
+        if (x > max_x) max_x = x;
+        if (y < min_y) min_y = y;
+        if (y > max_y) max_y = y;
+        if (z < min_z) min_z = z;
+        if (z > max_z) max_z = z;
+    }
+
+    *min = NEA_Vec3Make(min_x, min_y, min_z);
+    *max = NEA_Vec3Make(max_x, max_y, max_z);
+}
+
+NEA_HOT_CODE
+void NEA_Vec3ArrayIntegrate(NEA_Vec3 *pos, const NEA_Vec3 *vel, int count,
+                            int32_t dt)
+{
+    NEA_AssertPointer(pos, "NULL position pointer");
+    NEA_AssertPointer(vel, "NULL velocity pointer");
+
+    for (int i = 0; i < count; i++)
+    {
+        int32_t vx = vel[i].x, vy = vel[i].y, vz = vel[i].z;
+        int32_t px = pos[i].x, py = pos[i].y, pz = pos[i].z;
+
+        pos[i].x = px + (int32_t)(((int64_t)vx * dt) >> 12);
+        pos[i].y = py + (int32_t)(((int64_t)vy * dt) >> 12);
+        pos[i].z = pz + (int32_t)(((int64_t)vz * dt) >> 12);
+    }
+}
+
 // =========================================================================
 // Shape initialization
 // =========================================================================
@@ -88,90 +247,223 @@ static void ne_colmesh_compute_bounds(NEA_ColMesh *mesh)
         return;
     }
 
-    int32_t min_x = INT32_MAX, min_y = INT32_MAX, min_z = INT32_MAX;
-    int32_t max_x = INT32_MIN, max_y = INT32_MIN, max_z = INT32_MIN;
-
     NEA_ColTriangle *tris = mesh->triangles;
+    NEA_Vec3 min = tris[0].v0;
+    NEA_Vec3 max = tris[0].v0;
+
+    // The vertices of a triangle are consecutive
     for (int i = 0; i < mesh->num_triangles; i++)
+        NEA_Vec3ArrayBounds(&tris[i].v0, 3, &min, &max);
+
+    // Store center and half-extents
+    mesh->center.x = (min.x + max.x) >> 1;
+    mesh->center.y = (min.y + max.y) >> 1;
+    mesh->center.z = (min.z + max.z) >> 1;
+    mesh->bounds.half.x = (max.x - min.x) >> 1;
+    mesh->bounds.half.y = (max.y - min.y) >> 1;
+    mesh->bounds.half.z = (max.z - min.z) >> 1;
+}
+
+// Computes the data of a triangle derived from its vertices and normal
+static void ne_colmesh_prepare_triangle(NEA_ColTriangle *tri)
+{
+    const NEA_Vec3 *verts[3] = { &tri->v0, &tri->v1, &tri->v2 };
+
+    tri->padding = 0;
+    tri->plane_d = NEA_Vec3Dot(tri->normal, tri->v0);
+
+    tri->center = NEA_Vec3Make((tri->v0.x + tri->v1.x + tri->v2.x) / 3,
+                               (tri->v0.y + tri->v1.y + tri->v2.y) / 3,
+                               (tri->v0.z + tri->v1.z + tri->v2.z) / 3);
+
+    int64_t max_sq = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        NEA_Vec3 d = NEA_Vec3Sub(*verts[i], tri->center);
+        int64_t dist_sq = (int64_t)d.x * d.x + (int64_t)d.y * d.y
+                        + (int64_t)d.z * d.z;
+        if (dist_sq > max_sq)
+            max_sq = dist_sq;
+    }
+    tri->radius = sqrt64(max_sq) + 1;
+
+    // Degenerate triangles are never hit
+    NEA_Vec3 e0 = NEA_Vec3Sub(tri->v1, tri->v0);
+    NEA_Vec3 e1 = NEA_Vec3Sub(tri->v2, tri->v0);
+    if (((int64_t)e0.y * e1.z == (int64_t)e0.z * e1.y) &&
+        ((int64_t)e0.z * e1.x == (int64_t)e0.x * e1.z) &&
+        ((int64_t)e0.x * e1.y == (int64_t)e0.y * e1.x))
+    {
+        memset(tri->edge_normal, 0, sizeof(tri->edge_normal));
+        tri->radius = -1;
+        return;
+    }
+
+    for (int i = 0; i < 3; i++)
     {
-        NEA_Vec3 *verts[3] = { &tris[i].v0, &tris[i].v1, &tris[i].v2 };
-        for (int j = 0; j < 3; j++)
+        const NEA_Vec3 *start = verts[i];
+        const NEA_Vec3 *end = verts[(i + 1) % 3];
+        const NEA_Vec3 *opposite = verts[(i + 2) % 3];
+
+        NEA_Vec3 n = NEA_Vec3Cross(tri->normal, NEA_Vec3Sub(*end, *start));
+        if (n.x == 0 && n.y == 0 && n.z == 0)
         {
-            if (verts[j]->x < min_x) min_x = verts[j]->x;
-            if (verts[j]->y < min_y) min_y = verts[j]->y;
-            if (verts[j]->z < min_z) min_z = verts[j]->z;
-            if (verts[j]->x > max_x) max_x = verts[j]->x;
-            if (verts[j]->y > max_y) max_y = verts[j]->y;
-            if (verts[j]->z > max_z) max_z = verts[j]->z;
+            memset(tri->edge_normal, 0, sizeof(tri->edge_normal));
+            tri->radius = -1;
+            return;
         }
+
+        n = NEA_Vec3Normalize(n);
+        if (NEA_Vec3Dot(n, NEA_Vec3Sub(*opposite, *start)) < 0)
+            n = NEA_Vec3Neg(n);
+
+        tri->edge_normal[i][0] = n.x;
+        tri->edge_normal[i][1] = n.y;
+        tri->edge_normal[i][2] = n.z;
     }
+}
 
-    // Store center and half-extents
-    mesh->center.x = (min_x + max_x) >> 1;
-    mesh->center.y = (min_y + max_y) >> 1;
-    mesh->center.z = (min_z + max_z) >> 1;
-    mesh->bounds.half.x = (max_x - min_x) >> 1;
-    mesh->bounds.half.y = (max_y - min_y) >> 1;
-    mesh->bounds.half.z = (max_z - min_z) >> 1;
+// Copies the BVH of a .colmesh file to a mesh. Returns 0 if it isn't valid.
+static int ne_colmesh_load_bvh(NEA_ColMesh *mesh, uint32_t num_nodes,
+                               const colmesh_bvh_node_t *src)
+{
+    if (num_nodes == 0 || num_nodes > UINT16_MAX)
+        return 0;
+
+    NEA_ColBVHNode *nodes = ne_heap_malloc(NEA_HEAP_COLLISION,
+                                           num_nodes * sizeof(NEA_ColBVHNode));
+    uint8_t *depth = ne_heap_calloc(NEA_HEAP_COLLISION, num_nodes, 1);
+    if (nodes == NULL || depth == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for BVH");
+        ne_heap_free(NEA_HEAP_COLLISION, nodes);
+        ne_heap_free(NEA_HEAP_COLLISION, depth);
+        return 0;
+    }
+
+    depth[0] = 1;
+
+    for (uint32_t i = 0; i < num_nodes; i++)
+    {
+        NEA_ColBVHNode *node = &nodes[i];
+
+        node->min = NEA_Vec3Make(src[i].min[0], src[i].min[1], src[i].min[2]);
+        node->max = NEA_Vec3Make(src[i].max[0], src[i].max[1], src[i].max[2]);
+        node->first = src[i].first;
+        node->count = src[i].count;
+
+        if (node->count > 0)
+        {
+            if (node->first + node->count > mesh->num_triangles)
+                goto error;
+            continue;
+        }
+
+        // Children always come after their parent, so the tree has no loops
+        // and the depth of the children is known when they are reached.
+        if ((i + 1 >= num_nodes) || (node->first <= i + 1) ||
+            (node->first >= num_nodes) ||
+            (depth[i] >= NEA_COLMESH_BVH_MAX_DEPTH))
+            goto error;
+
+        uint8_t d = depth[i] + 1;
+        if (depth[i + 1] < d)
+            depth[i + 1] = d;
+        if (depth[node->first] < d)
+            depth[node->first] = d;
+    }
+
+    ne_heap_free(NEA_HEAP_COLLISION, depth);
+
+    mesh->nodes = nodes;
+    mesh->num_nodes = num_nodes;
+    return 1;
+
+error:
+    ne_heap_free(NEA_HEAP_COLLISION, nodes);
+    ne_heap_free(NEA_HEAP_COLLISION, depth);
+    return 0;
 }
 
-NEA_ColMesh *NEA_ColMeshLoad(const void *data)
+// State of a mesh that is being loaded with NEA_ColMeshLoadStart()
+typedef struct {
+    const colmesh_header_t *hdr;
+    void *owned;       // Data to free with free() at the end, or NULL
+    uint32_t total;    // Number of triangles of the file
+} ne_colmesh_load_t;
+
+NEA_ColMesh *NEA_ColMeshCreate(void)
+{
+    NEA_ColMesh *mesh = ne_heap_calloc(NEA_HEAP_COLLISION,
+                                       1, sizeof(NEA_ColMesh));
+    if (mesh == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for ColMesh");
+        return NULL;
+    }
+
+    mesh->flags = NEA_COLMESH_STATIC;
+
+    return mesh;
+}
+
+int NEA_ColMeshLoadStart(NEA_ColMesh *mesh, const void *data, bool free_data)
 {
+    NEA_AssertPointer(mesh, "NULL mesh pointer");
     NEA_AssertPointer(data, "NULL data pointer");
 
     const colmesh_header_t *hdr = (const colmesh_header_t *)data;
 
+    if ((mesh->triangles != NULL) || (mesh->load != NULL))
+    {
+        NEA_DebugPrint("ColMesh already loaded");
+        goto error;
+    }
     if (hdr->magic != COLM_MAGIC)
     {
         NEA_DebugPrint("Invalid .colmesh magic");
-        return NULL;
+        goto error;
     }
-    if (hdr->version != COLM_VERSION)
+    if (hdr->version != 1 && hdr->version != COLM_VERSION)
     {
         NEA_DebugPrint("Unsupported .colmesh version");
-        return NULL;
+        goto error;
     }
 
     uint32_t num_tris = hdr->num_triangles;
+    if (num_tris > UINT16_MAX)
+    {
+        NEA_DebugPrint("Too many triangles in .colmesh");
+        goto error;
+    }
 
-    NEA_ColMesh *mesh = calloc(1, sizeof(NEA_ColMesh));
-    if (mesh == NULL)
+    ne_colmesh_load_t *load = ne_heap_malloc(NEA_HEAP_COLLISION,
+                                             sizeof(ne_colmesh_load_t));
+    if (load == NULL)
     {
         NEA_DebugPrint("Not enough memory for ColMesh");
-        return NULL;
+        goto error;
     }
 
-    mesh->num_triangles = (uint16_t)num_tris;
-    mesh->flags = NEA_COLMESH_STATIC;
-    mesh->world_tris = NULL;
-
     if (num_tris > 0)
     {
-        mesh->triangles = malloc(num_tris * sizeof(NEA_ColTriangle));
+        mesh->triangles = ne_heap_malloc(NEA_HEAP_COLLISION,
+                                         num_tris * sizeof(NEA_ColTriangle));
         if (mesh->triangles == NULL)
         {
             NEA_DebugPrint("Not enough memory for triangles");
-            free(mesh);
-            return NULL;
+            ne_heap_free(NEA_HEAP_COLLISION, load);
+            goto error;
         }
+    }
 
-        const colmesh_triangle_t *src =
-            (const colmesh_triangle_t *)((const uint8_t *)data
-                                         + sizeof(colmesh_header_t));
+    load->hdr = hdr;
+    load->owned = free_data ? (void *)data : NULL;
+    load->total = num_tris;
 
-        for (uint32_t i = 0; i < num_tris; i++)
-        {
-            mesh->triangles[i].v0 = NEA_Vec3Make(src[i].v0[0], src[i].v0[1],
-                                                  src[i].v0[2]);
-            mesh->triangles[i].v1 = NEA_Vec3Make(src[i].v1[0], src[i].v1[1],
-                                                  src[i].v1[2]);
-            mesh->triangles[i].v2 = NEA_Vec3Make(src[i].v2[0], src[i].v2[1],
-                                                  src[i].v2[2]);
-            mesh->triangles[i].normal = NEA_Vec3Make(src[i].normal[0],
-                                                     src[i].normal[1],
-                                                     src[i].normal[2]);
-        }
-    }
+    // The triangles are made available as they are processed
+    mesh->num_triangles = 0;
+    mesh->load = load;
 
     // Compute bounding AABB center and half-extents from file min/max
     mesh->center.x = (hdr->aabb_min[0] + hdr->aabb_max[0]) >> 1;
@@ -181,37 +473,128 @@ NEA_ColMesh *NEA_ColMeshLoad(const void *data)
     mesh->bounds.half.y = (hdr->aabb_max[1] - hdr->aabb_min[1]) >> 1;
     mesh->bounds.half.z = (hdr->aabb_max[2] - hdr->aabb_min[2]) >> 1;
 
-    return mesh;
+    return 1;
+
+error:
+    if (free_data)
+        free((void *)data);
+    return 0;
 }
 
-NEA_ColMesh *NEA_ColMeshLoadFAT(const char *path)
+// Frees the state of a mesh that is being loaded, and its data if it owns it
+static void ne_colmesh_load_end(NEA_ColMesh *mesh)
 {
-    NEA_AssertPointer(path, "NULL path");
+    ne_colmesh_load_t *load = mesh->load;
+
+    free(load->owned);
+    ne_heap_free(NEA_HEAP_COLLISION, load);
+    mesh->load = NULL;
+}
+
+bool NEA_ColMeshLoadStep(NEA_ColMesh *mesh, int max_triangles)
+{
+    NEA_AssertPointer(mesh, "NULL mesh pointer");
+    NEA_Assert(max_triangles > 0, "Invalid number of triangles");
+
+    ne_colmesh_load_t *load = mesh->load;
+    if (load == NULL)
+        return true;
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
+    const colmesh_header_t *hdr = load->hdr;
+    const uint8_t *tri_data = (const uint8_t *)hdr + sizeof(colmesh_header_t);
+
+    uint32_t first = mesh->num_triangles;
+    uint32_t end = load->total;
+    if (end - first > (uint32_t)max_triangles)
+        end = first + max_triangles;
+
+    if (hdr->version == COLM_VERSION)
     {
-        NEA_DebugPrint("Can't open %s", path);
-        return NULL;
+        memcpy(mesh->triangles + first,
+               tri_data + first * sizeof(NEA_ColTriangle),
+               (end - first) * sizeof(NEA_ColTriangle));
+    }
+    else
+    {
+        const colmesh_triangle_t *src = (const colmesh_triangle_t *)tri_data;
+
+        for (uint32_t i = first; i < end; i++)
+        {
+            NEA_ColTriangle *tri = &mesh->triangles[i];
+
+            tri->v0 = NEA_Vec3Make(src[i].v0[0], src[i].v0[1], src[i].v0[2]);
+            tri->v1 = NEA_Vec3Make(src[i].v1[0], src[i].v1[1], src[i].v1[2]);
+            tri->v2 = NEA_Vec3Make(src[i].v2[0], src[i].v2[1], src[i].v2[2]);
+            tri->normal = NEA_Vec3Make(src[i].normal[0], src[i].normal[1],
+                                       src[i].normal[2]);
+            ne_colmesh_prepare_triangle(tri);
+        }
     }
 
-    fseek(f, 0, SEEK_END);
-    long size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    // Until the BVH is loaded, the tests check the triangles one by one
+    mesh->num_triangles = (uint16_t)end;
 
-    void *data = malloc(size);
-    if (data == NULL)
+    if (end < load->total)
+        return false;
+
+    if (hdr->flags & COLM_FLAG_BVH)
+    {
+        size_t tri_size = (hdr->version == COLM_VERSION) ?
+                sizeof(NEA_ColTriangle) : sizeof(colmesh_triangle_t);
+
+        const uint32_t *bvh = (const uint32_t *)(tri_data + end * tri_size);
+
+        // Meshes without a BVH still work, they are just slower
+        if (ne_colmesh_load_bvh(mesh, bvh[0],
+                                (const colmesh_bvh_node_t *)(bvh + 1)) == 0)
+            NEA_DebugPrint("Invalid ColMesh BVH");
+    }
+
+    ne_colmesh_load_end(mesh);
+
+    return true;
+}
+
+bool NEA_ColMeshIsLoading(const NEA_ColMesh *mesh)
+{
+    NEA_AssertPointer(mesh, "NULL mesh pointer");
+
+    return mesh->load != NULL;
+}
+
+NEA_ColMesh *NEA_ColMeshLoad(const void *data)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    NEA_ColMesh *mesh = NEA_ColMeshCreate();
+    if (mesh == NULL)
+        return NULL;
+
+    if (NEA_ColMeshLoadStart(mesh, data, false) == 0)
     {
-        NEA_DebugPrint("Not enough memory");
-        fclose(f);
+        NEA_ColMeshFree(mesh);
         return NULL;
     }
 
-    fread(data, 1, size, f);
-    fclose(f);
+    NEA_ColMeshLoadStep(mesh, UINT16_MAX);
+
+    return mesh;
+}
+
+// Internal use... see NEAFAT.c and NEAArena.c
+char *ne_fat_load_data_temp(const char *filename);
+void ne_arena_temp_free(void *ptr);
+
+NEA_ColMesh *NEA_ColMeshLoadFAT(const char *path)
+{
+    NEA_AssertPointer(path, "NULL path");
+
+    void *data = ne_fat_load_data_temp(path);
+    if (data == NULL)
+        return NULL;
 
     NEA_ColMesh *mesh = NEA_ColMeshLoad(data);
-    free(data);
+    ne_arena_temp_free(data);
     return mesh;
 }
 
@@ -219,11 +602,20 @@ void NEA_ColMeshSetDynamic(NEA_ColMesh *mesh, bool dynamic)
 {
     NEA_AssertPointer(mesh, "NULL mesh pointer");
 
+    if (mesh->load != NULL)
+    {
+        NEA_DebugPrint("ColMesh is still being loaded");
+        return;
+    }
+
     if (dynamic && !(mesh->flags & NEA_COLMESH_DYNAMIC))
     {
+        mesh->flags &= ~NEA_COLMESH_TRANSFORMED;
+
         // Allocate world-space triangle buffer
-        mesh->world_tris = malloc(mesh->num_triangles
-                                  * sizeof(NEA_ColTriangle));
+        mesh->world_tris = ne_heap_malloc(NEA_HEAP_COLLISION,
+                                          mesh->num_triangles
+                                          * sizeof(NEA_ColTriangle));
         if (mesh->world_tris == NULL)
         {
             NEA_DebugPrint("Not enough memory for dynamic ColMesh");
@@ -232,12 +624,31 @@ void NEA_ColMeshSetDynamic(NEA_ColMesh *mesh, bool dynamic)
         // Initialize to local-space copy
         memcpy(mesh->world_tris, mesh->triangles,
                mesh->num_triangles * sizeof(NEA_ColTriangle));
+
+        if (mesh->nodes != NULL)
+        {
+            mesh->world_nodes = ne_heap_malloc(NEA_HEAP_COLLISION,
+                                               mesh->num_nodes
+                                               * sizeof(NEA_ColBVHNode));
+            if (mesh->world_nodes == NULL)
+            {
+                NEA_DebugPrint("Not enough memory for dynamic ColMesh");
+                ne_heap_free(NEA_HEAP_COLLISION, mesh->world_tris);
+                mesh->world_tris = NULL;
+                return;
+            }
+            memcpy(mesh->world_nodes, mesh->nodes,
+                   mesh->num_nodes * sizeof(NEA_ColBVHNode));
+        }
+
         mesh->flags |= NEA_COLMESH_DYNAMIC;
     }
     else if (!dynamic && (mesh->flags & NEA_COLMESH_DYNAMIC))
     {
-        free(mesh->world_tris);
+        ne_heap_free(NEA_HEAP_COLLISION, mesh->world_tris);
         mesh->world_tris = NULL;
+        ne_heap_free(NEA_HEAP_COLLISION, mesh->world_nodes);
+        mesh->world_nodes = NULL;
         mesh->flags &= ~NEA_COLMESH_DYNAMIC;
         // Recompute bounds from original triangles
         ne_colmesh_compute_bounds(mesh);
@@ -273,6 +684,94 @@ static inline NEA_Vec3 ne_vec3_rotate(NEA_Vec3 v, const m4x3 *mat)
     return r;
 }
 
+// Recomputes the boxes of the world-space BVH from the world-space triangles.
+// Children come after their parents, so the nodes are refitted backwards.
+static void ne_colmesh_refit_bvh(NEA_ColMesh *mesh)
+{
+    NEA_ColBVHNode *nodes = mesh->world_nodes;
+
+    for (int i = mesh->num_nodes - 1; i >= 0; i--)
+    {
+        NEA_ColBVHNode *node = &nodes[i];
+
+        if (node->count == 0)
+        {
+            const NEA_ColBVHNode *a = &nodes[i + 1];
+            const NEA_ColBVHNode *b = &nodes[node->first];
+
+            node->min.x = a->min.x < b->min.x ? a->min.x : b->min.x;
+            node->min.y = a->min.y < b->min.y ? a->min.y : b->min.y;
+            node->min.z = a->min.z < b->min.z ? a->min.z : b->min.z;
+            node->max.x = a->max.x > b->max.x ? a->max.x : b->max.x;
+            node->max.y = a->max.y > b->max.y ? a->max.y : b->max.y;
+            node->max.z = a->max.z > b->max.z ? a->max.z : b->max.z;
+            continue;
+        }
+
+        node->min = NEA_Vec3Make(INT32_MAX, INT32_MAX, INT32_MAX);
+        node->max = NEA_Vec3Make(INT32_MIN, INT32_MIN, INT32_MIN);
+
+        const NEA_ColTriangle *tri = &mesh->world_tris[node->first];
+        for (int t = 0; t < node->count; t++, tri++)
+        {
+            const NEA_Vec3 *verts[3] = { &tri->v0, &tri->v1, &tri->v2 };
+            for (int j = 0; j < 3; j++)
+            {
+                if (verts[j]->x < node->min.x) node->min.x = verts[j]->x;
+                if (verts[j]->y < node->min.y) node->min.y = verts[j]->y;
+                if (verts[j]->z < node->min.z) node->min.z = verts[j]->z;
+                if (verts[j]->x > node->max.x) node->max.x = verts[j]->x;
+                if (verts[j]->y > node->max.y) node->max.y = verts[j]->y;
+                if (verts[j]->z > node->max.z) node->max.z = verts[j]->z;
+            }
+        }
+    }
+}
+
+void NEA_ColMeshSetMatrix(NEA_ColMesh *mesh, const m4x3 *matrix)
+{
+    NEA_AssertPointer(mesh, "NULL mesh pointer");
+
+    NEA_ColMeshSetDynamic(mesh, false);
+
+    if (matrix == NULL)
+    {
+        mesh->flags &= ~NEA_COLMESH_TRANSFORMED;
+        return;
+    }
+
+    const int32_t *m = matrix->m;
+
+    // All columns of the matrix have the same length, the scale
+    int32_t scale_sq = mulf32(m[0], m[0]) + mulf32(m[1], m[1])
+                     + mulf32(m[2], m[2]);
+    if (scale_sq <= 0)
+    {
+        NEA_DebugPrint("Invalid ColMesh matrix");
+        return;
+    }
+
+    mesh->matrix = *matrix;
+    mesh->scale = sqrtf32(scale_sq);
+
+    // The inverse of a rotation with a uniform scale is its transpose divided
+    // by the square of the scale.
+    int32_t *inv = mesh->inverse.m;
+    for (int c = 0; c < 3; c++)
+    {
+        for (int r = 0; r < 3; r++)
+            inv[c * 3 + r] = divf32(m[r * 3 + c], scale_sq);
+    }
+
+    NEA_Vec3 t = ne_vec3_rotate(NEA_Vec3Make(m[9], m[10], m[11]),
+                                &mesh->inverse);
+    inv[9] = -t.x;
+    inv[10] = -t.y;
+    inv[11] = -t.z;
+
+    mesh->flags |= NEA_COLMESH_TRANSFORMED;
+}
+
 void NEA_ColMeshUpdateTransform(NEA_ColMesh *mesh, const m4x3 *matrix)
 {
     NEA_AssertPointer(mesh, "NULL mesh pointer");
@@ -286,15 +785,13 @@ void NEA_ColMeshUpdateTransform(NEA_ColMesh *mesh, const m4x3 *matrix)
 
     for (int i = 0; i < mesh->num_triangles; i++)
     {
-        mesh->world_tris[i].v0 = ne_vec3_transform(mesh->triangles[i].v0,
-                                                    matrix);
-        mesh->world_tris[i].v1 = ne_vec3_transform(mesh->triangles[i].v1,
-                                                    matrix);
-        mesh->world_tris[i].v2 = ne_vec3_transform(mesh->triangles[i].v2,
-                                                    matrix);
+        NEA_Vec3ArrayTransform(&mesh->world_tris[i].v0,
+                               &mesh->triangles[i].v0, 3, matrix);
         // Rotate normal (no translation), then re-normalize
         NEA_Vec3 n = ne_vec3_rotate(mesh->triangles[i].normal, matrix);
         mesh->world_tris[i].normal = NEA_Vec3Normalize(n);
+
+        ne_colmesh_prepare_triangle(&mesh->world_tris[i]);
     }
 
     // Recompute bounding AABB from transformed triangles
@@ -302,6 +799,9 @@ void NEA_ColMeshUpdateTransform(NEA_ColMesh *mesh, const m4x3 *matrix)
     mesh->triangles = mesh->world_tris;
     ne_colmesh_compute_bounds(mesh);
     mesh->triangles = old_tris;
+
+    if (mesh->world_nodes != NULL)
+        ne_colmesh_refit_bvh(mesh);
 }
 
 void NEA_ColMeshFree(NEA_ColMesh *mesh)
@@ -309,9 +809,17 @@ void NEA_ColMeshFree(NEA_ColMesh *mesh)
     if (mesh == NULL)
         return;
 
-    free(mesh->triangles);
-    free(mesh->world_tris);
-    free(mesh);
+    // The mesh may still be in the queue of the background loader
+    NEA_LoaderCancel(mesh);
+
+    if (mesh->load != NULL)
+        ne_colmesh_load_end(mesh);
+
+    ne_heap_free(NEA_HEAP_COLLISION, mesh->triangles);
+    ne_heap_free(NEA_HEAP_COLLISION, mesh->world_tris);
+    ne_heap_free(NEA_HEAP_COLLISION, mesh->nodes);
+    ne_heap_free(NEA_HEAP_COLLISION, mesh->world_nodes);
+    ne_heap_free(NEA_HEAP_COLLISION, mesh);
 }
 
 // =========================================================================
@@ -381,19 +889,20 @@ NEA_ColResult NEA_ColTestSphereVsSphere(const NEA_ColSphere *a,
     if (dist_sq_64 >= sum_r_sq)
         return r;
 
-    r.hit = true;
-
     // dist_sq_64 is f32*f32 = 24 fractional bits. sqrt64 yields 12 frac
     // bits, which is already f32 format — no additional shift needed.
-    uint32_t dist_f32 = (uint32_t)sqrt64((uint64_t)dist_sq_64);
+    ne_sqrt64_start((uint64_t)dist_sq_64);
+
+    r.hit = true;
+
+    uint32_t dist_f32 = ne_sqrt64_result();
 
     if (dist_f32 > 0)
     {
-        r.depth = sum_r - (int32_t)dist_f32;
         // Normalize: n = d / dist
-        r.normal.x = divf32(d.x, (int32_t)dist_f32);
-        r.normal.y = divf32(d.y, (int32_t)dist_f32);
-        r.normal.z = divf32(d.z, (int32_t)dist_f32);
+        ne_recip_start(dist_f32);
+        r.depth = sum_r - (int32_t)dist_f32;
+        r.normal = ne_vec3_div_recip(d, dist_f32);
     }
     else
     {
@@ -431,17 +940,18 @@ NEA_ColResult NEA_ColTestAABBvsSphere(const NEA_ColAABB *a, NEA_Vec3 pos_a,
     if (dist_sq_64 >= r_sq)
         return r;
 
+    ne_sqrt64_start((uint64_t)dist_sq_64);
+
     r.hit = true;
     r.point = closest;
 
-    uint32_t dist_f32 = (uint32_t)sqrt64((uint64_t)dist_sq_64);
+    uint32_t dist_f32 = ne_sqrt64_result();
 
     if (dist_f32 > 0)
     {
+        ne_recip_start(dist_f32);
         r.depth = b->radius - (int32_t)dist_f32;
-        r.normal.x = divf32(d.x, (int32_t)dist_f32);
-        r.normal.y = divf32(d.y, (int32_t)dist_f32);
-        r.normal.z = divf32(d.z, (int32_t)dist_f32);
+        r.normal = ne_vec3_div_recip(d, dist_f32);
     }
     else
     {
@@ -574,56 +1084,63 @@ NEA_ColResult NEA_ColTestCapsuleVsCapsule(const NEA_ColCapsule *a,
 // Sphere vs Triangle helper (for ColMesh tests)
 // =========================================================================
 
+// Returns true if the closest point of an edge is inside of the edge, so it
+// needs the division t = t_num / edge_len_sq.
+static inline bool ne_edge_needs_div(int32_t t_num, int32_t edge_len_sq)
+{
+    return (t_num > 0) && (t_num < edge_len_sq);
+}
+
 // Test a sphere against a single triangle. Returns collision result.
-static NEA_ColResult ne_sphere_vs_triangle(NEA_Vec3 center, int32_t radius,
-                                           const NEA_ColTriangle *tri)
+NEA_HOT_CODE static
+NEA_ColResult ne_sphere_vs_triangle(NEA_Vec3 center, int32_t radius,
+                                    const NEA_ColTriangle *tri)
 {
     NEA_ColResult r = { .hit = false };
 
+    NE_STAT_ADD(col_tri_tests, 1);
+
+    // Quick reject: too far from the bounding sphere (or degenerate)
+    int32_t reach = radius + tri->radius;
+    NEA_Vec3 to_center = NEA_Vec3Sub(center, tri->center);
+    if ((tri->radius < 0) || (abs(to_center.x) > reach) ||
+        (abs(to_center.y) > reach) || (abs(to_center.z) > reach))
+        return r;
+
     // Distance from sphere center to triangle plane
-    NEA_Vec3 v0_to_center = NEA_Vec3Sub(center, tri->v0);
-    int32_t dist_to_plane = NEA_Vec3Dot(v0_to_center, tri->normal);
+    int32_t dist_to_plane = NEA_Vec3Dot(center, tri->normal) - tri->plane_d;
 
     // Quick reject: too far from plane
     if (abs(dist_to_plane) > radius)
         return r;
 
-    // Project center onto triangle plane
-    NEA_Vec3 projected = NEA_Vec3Sub(center,
-                                     NEA_Vec3Scale(tri->normal,
-                                                   dist_to_plane));
+    // Distances to the planes of the edges, positive inside the triangle
+    NEA_Vec3 edges_start[3] = { tri->v0, tri->v1, tri->v2 };
+    int32_t edge_dist[3];
+    bool inside = true;
+
+    for (int i = 0; i < 3; i++)
+    {
+        NEA_Vec3 d = NEA_Vec3Sub(center, edges_start[i]);
+        const int16_t *n = tri->edge_normal[i];
+        edge_dist[i] = ((int64_t)d.x * n[0] + (int64_t)d.y * n[1]
+                        + (int64_t)d.z * n[2]) >> 12;
 
-    // Check if projected point is inside triangle using barycentric coords
-    NEA_Vec3 e0 = NEA_Vec3Sub(tri->v1, tri->v0);
-    NEA_Vec3 e1 = NEA_Vec3Sub(tri->v2, tri->v0);
-    NEA_Vec3 e2 = NEA_Vec3Sub(projected, tri->v0);
-
-    int32_t d00 = NEA_Vec3Dot(e0, e0);
-    int32_t d01 = NEA_Vec3Dot(e0, e1);
-    int32_t d02 = NEA_Vec3Dot(e0, e2);
-    int32_t d11 = NEA_Vec3Dot(e1, e1);
-    int32_t d12 = NEA_Vec3Dot(e1, e2);
-
-    // denom = d00*d11 - d01*d01
-    int64_t denom_64 = (int64_t)d00 * d11 - (int64_t)d01 * d01;
-    if (denom_64 == 0)
-        return r; // Degenerate triangle
-
-    // u = (d11*d02 - d01*d12) / denom
-    // v = (d00*d12 - d01*d02) / denom
-    int64_t u_num = (int64_t)d11 * d02 - (int64_t)d01 * d12;
-    int64_t v_num = (int64_t)d00 * d12 - (int64_t)d01 * d02;
-
-    bool inside = false;
-    if (denom_64 > 0)
-        inside = (u_num >= 0) && (v_num >= 0)
-              && (u_num + v_num <= denom_64);
-    else
-        inside = (u_num <= 0) && (v_num <= 0)
-              && (u_num + v_num >= denom_64);
+        // Quick reject: too far from an edge
+        if (edge_dist[i] < -radius)
+            return r;
+
+        if (edge_dist[i] < 0)
+            inside = false;
+    }
 
     if (inside)
     {
+        // Project center onto triangle plane
+        NEA_Vec3 projected = NEA_Vec3Sub(center,
+                                         NEA_Vec3Scale(tri->normal,
+                                                       dist_to_plane));
+
         // Closest point is the projection on the plane
         r.hit = true;
         // Normal points from sphere toward triangle (first arg toward second)
@@ -635,41 +1152,76 @@ static NEA_ColResult ne_sphere_vs_triangle(NEA_Vec3 center, int32_t radius,
         return r;
     }
 
-    // Not inside triangle — find closest point on triangle edges
-    // Check all 3 edges and pick the closest
+    // Not inside triangle — find closest point on triangle edges. It is on
+    // one of the edges that have the center outside.
 
-    NEA_Vec3 edges_start[3] = { tri->v0, tri->v1, tri->v2 };
     NEA_Vec3 edges_end[3]   = { tri->v1, tri->v2, tri->v0 };
 
-    int64_t best_dist_sq_64 = INT64_MAX;
-    NEA_Vec3 best_point = tri->v0;
+    // t = t_num / edge_len_sq of each edge. The divider works while the CPU
+    // does something else, so the division of an edge is started as soon as
+    // possible and the products of the other edges are calculated meanwhile.
+    NEA_Vec3 edge[3];
+    int32_t edge_len_sq[3] = { 0, 0, 0 };
+    int32_t t_num[3];
+    bool div_started = false;
 
     for (int i = 0; i < 3; i++)
     {
-        NEA_Vec3 edge = NEA_Vec3Sub(edges_end[i], edges_start[i]);
-        int32_t edge_len_sq = NEA_Vec3Dot(edge, edge);
+        if (edge_dist[i] >= 0)
+            continue;
+
+        edge[i] = NEA_Vec3Sub(edges_end[i], edges_start[i]);
+        edge_len_sq[i] = NEA_Vec3Dot(edge[i], edge[i]);
 
-        if (edge_len_sq == 0)
+        if (edge_len_sq[i] == 0)
             continue;
 
         NEA_Vec3 to_center = NEA_Vec3Sub(center, edges_start[i]);
-        int32_t t_num = NEA_Vec3Dot(to_center, edge);
+        t_num[i] = NEA_Vec3Dot(to_center, edge[i]);
 
-        // t = t_num / edge_len_sq, clamped to [0, 1]
-        NEA_Vec3 closest;
-        if (t_num <= 0)
+        if (!div_started && ne_edge_needs_div(t_num[i], edge_len_sq[i]))
         {
-            closest = edges_start[i];
+            ne_divf32_start(t_num[i], edge_len_sq[i]);
+            div_started = true;
         }
-        else if (t_num >= edge_len_sq)
+    }
+
+    int64_t best_dist_sq_64 = INT64_MAX;
+    NEA_Vec3 best_point = tri->v0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if ((edge_dist[i] >= 0) || (edge_len_sq[i] == 0))
+            continue;
+
+        // t clamped to [0, 1]
+        NEA_Vec3 closest;
+        if (t_num[i] <= 0)
+        {
+            closest = edges_start[i];
+        }
+        else if (t_num[i] >= edge_len_sq[i])
         {
             closest = edges_end[i];
         }
         else
         {
+            // The division of this edge is the one in progress
+            int32_t t = ne_divf32_result();
+
+            // Start the division of the next edge before using this result
+            for (int j = i + 1; j < 3; j++)
+            {
+                if ((edge_dist[j] < 0) && (edge_len_sq[j] != 0) &&
+                    ne_edge_needs_div(t_num[j], edge_len_sq[j]))
+                {
+                    ne_divf32_start(t_num[j], edge_len_sq[j]);
+                    break;
+                }
+            }
+
             // closest = start + edge * (t_num / edge_len_sq)
-            int32_t t = divf32(t_num, edge_len_sq);
-            closest = NEA_Vec3Add(edges_start[i], NEA_Vec3Scale(edge, t));
+            closest = NEA_Vec3Add(edges_start[i], NEA_Vec3Scale(edge[i], t));
         }
 
         NEA_Vec3 diff = NEA_Vec3Sub(center, closest);
@@ -691,20 +1243,28 @@ static NEA_ColResult ne_sphere_vs_triangle(NEA_Vec3 center, int32_t radius,
     if (best_dist_sq_64 >= r_sq_64)
         return r;
 
-    // Normal points from sphere toward triangle (first arg toward second)
-    NEA_Vec3 diff = NEA_Vec3Sub(best_point, center);
     // best_dist_sq_64 has 24 fractional bits. sqrt64 yields 12 frac
     // bits, which is already f32 format — no additional shift needed.
-    uint32_t dist_f32 = (uint32_t)sqrt64((uint64_t)best_dist_sq_64);
+    ne_sqrt64_start((uint64_t)best_dist_sq_64);
+
+    // Normal points from sphere toward triangle (first arg toward second)
+    NEA_Vec3 diff = NEA_Vec3Sub(best_point, center);
+
+    uint32_t dist_f32 = ne_sqrt64_result();
 
     if (dist_f32 > 0)
     {
+#ifndef NEA_FAST_NORMALIZE
+        ne_recip_start(dist_f32);
+#endif
         r.hit = true;
         r.depth = radius - (int32_t)dist_f32;
-        r.normal.x = divf32(diff.x, (int32_t)dist_f32);
-        r.normal.y = divf32(diff.y, (int32_t)dist_f32);
-        r.normal.z = divf32(diff.z, (int32_t)dist_f32);
         r.point = best_point;
+#ifdef NEA_FAST_NORMALIZE
+        r.normal = NEA_Vec3NormalizeFast(diff);
+#else
+        r.normal = ne_vec3_div_recip(diff, dist_f32);
+#endif
     }
 
     return r;
@@ -723,6 +1283,75 @@ static inline const NEA_ColTriangle *ne_colmesh_get_tris(
     return mesh->triangles;
 }
 
+// Get the effective BVH (world_nodes if dynamic, nodes otherwise)
+static inline const NEA_ColBVHNode *ne_colmesh_get_nodes(
+    const NEA_ColMesh *mesh)
+{
+    if ((mesh->flags & NEA_COLMESH_DYNAMIC) && mesh->world_tris != NULL)
+        return mesh->world_nodes;
+    return mesh->nodes;
+}
+
+// Iterator over the ranges of triangles of a ColMesh that may touch a box. If
+// the mesh doesn't have a BVH, all triangles are returned as one range.
+typedef struct {
+    const NEA_ColBVHNode *nodes;
+    NEA_Vec3 min, max;
+    int num_triangles;
+    int sp;
+    uint16_t stack[NEA_COLMESH_BVH_MAX_DEPTH];
+} ne_colmesh_iter_t;
+
+// The box is given by its center and half-extents, in the space of the
+// triangles returned by ne_colmesh_get_tris().
+static inline void ne_colmesh_iter_init(ne_colmesh_iter_t *it,
+                                        const NEA_ColMesh *mesh,
+                                        NEA_Vec3 center, NEA_Vec3 half)
+{
+    it->nodes = ne_colmesh_get_nodes(mesh);
+    it->min = NEA_Vec3Sub(center, half);
+    it->max = NEA_Vec3Add(center, half);
+    it->num_triangles = mesh->num_triangles;
+    it->stack[0] = 0;
+    it->sp = 1;
+}
+
+// Returns false when there are no more triangles
+static bool ne_colmesh_iter_next(ne_colmesh_iter_t *it, int *first,
+                                 int *count)
+{
+    if (it->nodes == NULL)
+    {
+        *first = 0;
+        *count = it->num_triangles;
+        return it->sp-- > 0;
+    }
+
+    while (it->sp > 0)
+    {
+        int index = it->stack[--it->sp];
+        const NEA_ColBVHNode *node = &it->nodes[index];
+
+        if ((it->max.x < node->min.x) || (it->min.x > node->max.x) ||
+            (it->max.y < node->min.y) || (it->min.y > node->max.y) ||
+            (it->max.z < node->min.z) || (it->min.z > node->max.z))
+            continue;
+
+        if (node->count > 0)
+        {
+            *first = node->first;
+            *count = node->count;
+            return true;
+        }
+
+        // The loader has checked that the stack can't overflow
+        it->stack[it->sp++] = node->first;
+        it->stack[it->sp++] = index + 1;
+    }
+
+    return false;
+}
+
 // AABB early rejection: test if a shape's AABB overlaps the mesh's AABB
 static inline bool ne_aabb_overlap_check(NEA_Vec3 shape_pos,
                                          NEA_Vec3 shape_half,
@@ -739,239 +1368,1186 @@ static inline bool ne_aabb_overlap_check(NEA_Vec3 shape_pos,
         && (abs(d.z) < sum_half.z);
 }
 
-NEA_ColResult NEA_ColTestSphereVsMesh(const NEA_ColSphere *a, NEA_Vec3 pos_a,
-                                      const NEA_ColMesh *mesh,
-                                      NEA_Vec3 mesh_pos)
+// Contacts found while the triangles of a mesh are traversed. With only one
+// contact, it keeps the deepest one.
+typedef struct {
+    NEA_ColResult *contacts;
+    int count;
+    int max;
+} ne_col_manifold_t;
+
+// Adds a contact to a manifold. If a contact with almost the same normal has
+// already been found, only the deepest one of them is kept. If the manifold is
+// full, the new contact replaces the shallowest one if it's deeper.
+static void ne_col_manifold_add(ne_col_manifold_t *m, const NEA_ColResult *r)
 {
-    NEA_ColResult r = { .hit = false };
+    if (!r->hit || r->depth <= 0)
+        return;
 
-    // AABB early rejection
-    NEA_Vec3 sphere_half = NEA_Vec3Make(a->radius, a->radius, a->radius);
-    if (!ne_aabb_overlap_check(pos_a, sphere_half, mesh, mesh_pos))
-        return r;
+    int shallowest = 0;
+
+    for (int i = 0; i < m->count; i++)
+    {
+        NEA_ColResult *c = &m->contacts[i];
+
+        if (NEA_Vec3Dot(c->normal, r->normal) >= NEA_COL_CONTACT_MERGE_DOT)
+        {
+            if (r->depth > c->depth)
+                *c = *r;
+            return;
+        }
+
+        if (c->depth < m->contacts[shallowest].depth)
+            shallowest = i;
+    }
+
+    if (m->count < m->max)
+        m->contacts[m->count++] = *r;
+    else if (r->depth > m->contacts[shallowest].depth)
+        m->contacts[shallowest] = *r;
+}
+
+// Sorts the contacts of a manifold from the deepest to the shallowest one
+static void ne_col_manifold_sort(ne_col_manifold_t *m)
+{
+    for (int i = 1; i < m->count; i++)
+    {
+        NEA_ColResult r = m->contacts[i];
+        int j = i;
+        while (j > 0 && m->contacts[j - 1].depth < r.depth)
+        {
+            m->contacts[j] = m->contacts[j - 1];
+            j--;
+        }
+        m->contacts[j] = r;
+    }
+}
 
+// Sphere vs the triangles of a mesh, in the space of the triangles
+static void ne_sphere_vs_mesh_tris(const NEA_ColMesh *mesh, NEA_Vec3 center,
+                                   int32_t radius, ne_col_manifold_t *m)
+{
     const NEA_ColTriangle *tris = ne_colmesh_get_tris(mesh);
 
-    // For static meshes, offset sphere position by -mesh_pos to work in
-    // local space. For dynamic meshes, triangles are already in world space.
-    NEA_Vec3 local_pos = pos_a;
-    if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
-        local_pos = NEA_Vec3Sub(pos_a, mesh_pos);
+    ne_colmesh_iter_t it;
+    ne_colmesh_iter_init(&it, mesh, center,
+                         NEA_Vec3Make(radius, radius, radius));
 
-    NEA_ColResult best = { .hit = false, .depth = 0 };
+    int first, count;
+    while (ne_colmesh_iter_next(&it, &first, &count))
+    {
+        for (int i = first; i < first + count; i++)
+        {
+            NEA_ColResult tri_r = ne_sphere_vs_triangle(center, radius,
+                                                        &tris[i]);
+            ne_col_manifold_add(m, &tri_r);
+        }
+    }
+}
 
-    for (int i = 0; i < mesh->num_triangles; i++)
+// Returns the closest point of the segment from a to b to the target point
+static NEA_Vec3 ne_closest_point_on_segment(NEA_Vec3 a, NEA_Vec3 b,
+                                            NEA_Vec3 target)
+{
+    // Segments along the Y axis are the most common ones
+    if (a.x == b.x && a.z == b.z)
+        return NEA_Vec3Make(a.x, NEA_Clamp(target.y, a.y, b.y), a.z);
+
+    NEA_Vec3 ab = NEA_Vec3Sub(b, a);
+    int32_t len_sq = NEA_Vec3Dot(ab, ab);
+    if (len_sq <= 0)
+        return a;
+
+    int32_t t = NEA_Clamp(NEA_Vec3Dot(NEA_Vec3Sub(target, a), ab), 0, len_sq);
+
+    return NEA_Vec3Add(a, NEA_Vec3Scale(ab, divf32(t, len_sq)));
+}
+
+// Capsule vs the triangles of a mesh, in the space of the triangles. The
+// segment goes from a to b, and a must be the lowest point if the segment is
+// vertical.
+static void ne_capsule_vs_mesh_tris(const NEA_ColMesh *mesh, NEA_Vec3 a,
+                                    NEA_Vec3 b, int32_t radius,
+                                    ne_col_manifold_t *m)
+{
+    const NEA_ColTriangle *tris = ne_colmesh_get_tris(mesh);
+
+    NEA_Vec3 center = NEA_Vec3Make((a.x + b.x) / 2, (a.y + b.y) / 2,
+                                   (a.z + b.z) / 2);
+    NEA_Vec3 half = NEA_Vec3Make(abs(b.x - a.x) / 2 + radius,
+                                 abs(b.y - a.y) / 2 + radius,
+                                 abs(b.z - a.z) / 2 + radius);
+
+    ne_colmesh_iter_t it;
+    ne_colmesh_iter_init(&it, mesh, center, half);
+
+    // For each triangle, find closest point on capsule segment to triangle,
+    // then test sphere at that point against the triangle.
+    int first, count;
+    while (ne_colmesh_iter_next(&it, &first, &count))
     {
-        NEA_ColResult tri_r = ne_sphere_vs_triangle(local_pos, a->radius,
-                                                    &tris[i]);
-        if (tri_r.hit && tri_r.depth > best.depth)
+        for (int i = first; i < first + count; i++)
         {
-            best = tri_r;
+            // Find approximate closest point on segment to triangle center
+            NEA_Vec3 seg_point = ne_closest_point_on_segment(a, b,
+                                                             tris[i].center);
+
+            NEA_ColResult tri_r = ne_sphere_vs_triangle(seg_point, radius,
+                                                        &tris[i]);
+            ne_col_manifold_add(m, &tri_r);
         }
     }
+}
+
+// Moves a result from the local space of a transformed mesh to world space
+static void ne_colmesh_result_to_world(NEA_ColResult *r,
+                                       const NEA_ColMesh *mesh,
+                                       NEA_Vec3 mesh_pos)
+{
+    if (!r->hit)
+        return;
+
+    r->point = NEA_Vec3Add(ne_vec3_transform(r->point, &mesh->matrix),
+                           mesh_pos);
+    r->normal = NEA_Vec3Normalize(ne_vec3_rotate(r->normal, &mesh->matrix));
+    r->depth = mulf32(r->depth, mesh->scale);
+}
+
+// Moves the contacts of a manifold to world space
+static void ne_col_manifold_to_world(ne_col_manifold_t *m,
+                                     const NEA_ColMesh *mesh,
+                                     NEA_Vec3 mesh_pos)
+{
+    for (int i = 0; i < m->count; i++)
+    {
+        NEA_ColResult *r = &m->contacts[i];
+
+        if (mesh->flags & NEA_COLMESH_TRANSFORMED)
+            ne_colmesh_result_to_world(r, mesh, mesh_pos);
+        else if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
+            r->point = NEA_Vec3Add(r->point, mesh_pos);
+    }
 
-    if (best.hit && !(mesh->flags & NEA_COLMESH_DYNAMIC))
+    ne_col_manifold_sort(m);
+}
+
+int NEA_ColTestSphereVsMeshContacts(const NEA_ColSphere *a, NEA_Vec3 pos_a,
+                                    const NEA_ColMesh *mesh, NEA_Vec3 mesh_pos,
+                                    NEA_ColResult *contacts, int max_contacts)
+{
+    NEA_AssertPointer(contacts, "NULL pointer");
+    NEA_Assert(max_contacts > 0, "Invalid number of contacts");
+
+    ne_col_manifold_t m = { contacts, 0, max_contacts };
+
+    if (mesh->flags & NEA_COLMESH_TRANSFORMED)
     {
-        // Convert contact point back to world space
-        best.point = NEA_Vec3Add(best.point, mesh_pos);
+        ne_divf32_start(a->radius, mesh->scale);
+        NEA_Vec3 local_pos = ne_vec3_transform(NEA_Vec3Sub(pos_a, mesh_pos),
+                                               &mesh->inverse);
+        int32_t radius = ne_divf32_result();
+
+        NEA_Vec3 half = NEA_Vec3Make(radius, radius, radius);
+        if (!ne_aabb_overlap_check(local_pos, half, mesh,
+                                   NEA_Vec3Make(0, 0, 0)))
+            return 0;
+
+        ne_sphere_vs_mesh_tris(mesh, local_pos, radius, &m);
+        ne_col_manifold_to_world(&m, mesh, mesh_pos);
+        return m.count;
     }
 
-    return best;
+    // AABB early rejection
+    NEA_Vec3 sphere_half = NEA_Vec3Make(a->radius, a->radius, a->radius);
+    if (!ne_aabb_overlap_check(pos_a, sphere_half, mesh, mesh_pos))
+        return 0;
+
+    // For static meshes, offset sphere position by -mesh_pos to work in
+    // local space. For dynamic meshes, triangles are already in world space.
+    NEA_Vec3 local_pos = pos_a;
+    if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
+        local_pos = NEA_Vec3Sub(pos_a, mesh_pos);
+
+    ne_sphere_vs_mesh_tris(mesh, local_pos, a->radius, &m);
+    ne_col_manifold_to_world(&m, mesh, mesh_pos);
+    return m.count;
 }
 
-NEA_ColResult NEA_ColTestAABBvsMesh(const NEA_ColAABB *a, NEA_Vec3 pos_a,
-                                    const NEA_ColMesh *mesh,
-                                    NEA_Vec3 mesh_pos)
+NEA_ColResult NEA_ColTestSphereVsMesh(const NEA_ColSphere *a, NEA_Vec3 pos_a,
+                                      const NEA_ColMesh *mesh,
+                                      NEA_Vec3 mesh_pos)
 {
     NEA_ColResult r = { .hit = false };
+    NEA_ColTestSphereVsMeshContacts(a, pos_a, mesh, mesh_pos, &r, 1);
+    return r;
+}
 
-    // AABB early rejection
-    if (!ne_aabb_overlap_check(pos_a, a->half, mesh, mesh_pos))
-        return r;
+// Approximate AABB-vs-mesh by treating AABB as a sphere with radius equal to
+// the smallest half-extent. This is a simplification but avoids the
+// complexity of full SAT on arbitrary triangles.
+int NEA_ColTestAABBvsMeshContacts(const NEA_ColAABB *a, NEA_Vec3 pos_a,
+                                  const NEA_ColMesh *mesh, NEA_Vec3 mesh_pos,
+                                  NEA_ColResult *contacts, int max_contacts)
+{
+    // AABB early rejection. Transformed meshes do it in their own space.
+    if (!(mesh->flags & NEA_COLMESH_TRANSFORMED) &&
+        !ne_aabb_overlap_check(pos_a, a->half, mesh, mesh_pos))
+        return 0;
 
-    // Approximate AABB-vs-mesh by treating AABB as a sphere with radius
-    // equal to the smallest half-extent. This is a simplification but
-    // avoids the complexity of full SAT on arbitrary triangles.
     int32_t min_half = a->half.x;
     if (a->half.y < min_half) min_half = a->half.y;
     if (a->half.z < min_half) min_half = a->half.z;
 
     NEA_ColSphere approx = { .radius = min_half };
-    return NEA_ColTestSphereVsMesh(&approx, pos_a, mesh, mesh_pos);
+    return NEA_ColTestSphereVsMeshContacts(&approx, pos_a, mesh, mesh_pos,
+                                           contacts, max_contacts);
 }
 
-NEA_ColResult NEA_ColTestCapsuleVsMesh(const NEA_ColCapsule *a,
-                                       NEA_Vec3 pos_a,
-                                       const NEA_ColMesh *mesh,
-                                       NEA_Vec3 mesh_pos)
+NEA_ColResult NEA_ColTestAABBvsMesh(const NEA_ColAABB *a, NEA_Vec3 pos_a,
+                                    const NEA_ColMesh *mesh,
+                                    NEA_Vec3 mesh_pos)
 {
     NEA_ColResult r = { .hit = false };
+    NEA_ColTestAABBvsMeshContacts(a, pos_a, mesh, mesh_pos, &r, 1);
+    return r;
+}
+
+int NEA_ColTestCapsuleVsMeshContacts(const NEA_ColCapsule *a, NEA_Vec3 pos_a,
+                                     const NEA_ColMesh *mesh,
+                                     NEA_Vec3 mesh_pos,
+                                     NEA_ColResult *contacts,
+                                     int max_contacts)
+{
+    NEA_AssertPointer(contacts, "NULL pointer");
+    NEA_Assert(max_contacts > 0, "Invalid number of contacts");
+
+    ne_col_manifold_t m = { contacts, 0, max_contacts };
+
+    if (mesh->flags & NEA_COLMESH_TRANSFORMED)
+    {
+        ne_divf32_start(a->radius, mesh->scale);
+        NEA_Vec3 p = NEA_Vec3Sub(pos_a, mesh_pos);
+        NEA_Vec3 bottom = ne_vec3_transform(
+            NEA_Vec3Make(p.x, p.y - a->half_height, p.z), &mesh->inverse);
+        NEA_Vec3 top = ne_vec3_transform(
+            NEA_Vec3Make(p.x, p.y + a->half_height, p.z), &mesh->inverse);
+        int32_t radius = ne_divf32_result();
+
+        NEA_Vec3 center = NEA_Vec3Make((bottom.x + top.x) / 2,
+                                       (bottom.y + top.y) / 2,
+                                       (bottom.z + top.z) / 2);
+        NEA_Vec3 half = NEA_Vec3Make(abs(top.x - bottom.x) / 2 + radius,
+                                     abs(top.y - bottom.y) / 2 + radius,
+                                     abs(top.z - bottom.z) / 2 + radius);
+        if (!ne_aabb_overlap_check(center, half, mesh, NEA_Vec3Make(0, 0, 0)))
+            return 0;
+
+        // The clamp of vertical segments needs the lowest point first
+        if (bottom.x == top.x && bottom.z == top.z && bottom.y > top.y)
+        {
+            NEA_Vec3 tmp = bottom;
+            bottom = top;
+            top = tmp;
+        }
+
+        ne_capsule_vs_mesh_tris(mesh, bottom, top, radius, &m);
+        ne_col_manifold_to_world(&m, mesh, mesh_pos);
+        return m.count;
+    }
 
     // AABB early rejection with capsule's bounding AABB
     NEA_Vec3 cap_half = NEA_Vec3Make(a->radius,
                                      a->half_height + a->radius,
                                      a->radius);
     if (!ne_aabb_overlap_check(pos_a, cap_half, mesh, mesh_pos))
-        return r;
-
-    const NEA_ColTriangle *tris = ne_colmesh_get_tris(mesh);
+        return 0;
 
     NEA_Vec3 local_pos = pos_a;
     if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
         local_pos = NEA_Vec3Sub(pos_a, mesh_pos);
 
-    NEA_ColResult best = { .hit = false, .depth = 0 };
+    NEA_Vec3 bottom = NEA_Vec3Make(local_pos.x, local_pos.y - a->half_height,
+                                   local_pos.z);
+    NEA_Vec3 top = NEA_Vec3Make(local_pos.x, local_pos.y + a->half_height,
+                                local_pos.z);
 
-    // For each triangle, find closest point on capsule segment to triangle,
-    // then test sphere at that point against the triangle.
-    for (int i = 0; i < mesh->num_triangles; i++)
+    ne_capsule_vs_mesh_tris(mesh, bottom, top, a->radius, &m);
+    ne_col_manifold_to_world(&m, mesh, mesh_pos);
+    return m.count;
+}
+
+NEA_ColResult NEA_ColTestCapsuleVsMesh(const NEA_ColCapsule *a,
+                                       NEA_Vec3 pos_a,
+                                       const NEA_ColMesh *mesh,
+                                       NEA_Vec3 mesh_pos)
+{
+    NEA_ColResult r = { .hit = false };
+    NEA_ColTestCapsuleVsMeshContacts(a, pos_a, mesh, mesh_pos, &r, 1);
+    return r;
+}
+
+// =========================================================================
+// Generic collision dispatcher
+// =========================================================================
+
+// Tests between two generic shapes. Each pair of shape types has a function,
+// so the type is only checked once for tests against many shapes.
+typedef NEA_ColResult (*ne_col_test_fn)(const NEA_ColShape *a, NEA_Vec3 pos_a,
+                                        const NEA_ColShape *b, NEA_Vec3 pos_b);
+
+static NEA_ColResult ne_col_test_none(const NEA_ColShape *a, NEA_Vec3 pos_a,
+                                      const NEA_ColShape *b, NEA_Vec3 pos_b)
+{
+    (void)a;
+    (void)pos_a;
+    (void)b;
+    (void)pos_b;
+
+    NEA_ColResult r = { .hit = false };
+    return r;
+}
+
+// Defines the test of a pair of shapes with the function of that pair
+#define NE_COL_PAIR(name, func, field_a, field_b)                           \
+    static NEA_ColResult name(const NEA_ColShape *a, NEA_Vec3 pos_a,        \
+                              const NEA_ColShape *b, NEA_Vec3 pos_b)        \
+    {                                                                       \
+        return func(&a->shape.field_a, pos_a, &b->shape.field_b, pos_b);    \
+    }
+
+// Defines the test of a pair of shapes with the function of the reversed pair
+#define NE_COL_PAIR_REVERSED(name, func, field_a, field_b)                  \
+    static NEA_ColResult name(const NEA_ColShape *a, NEA_Vec3 pos_a,        \
+                              const NEA_ColShape *b, NEA_Vec3 pos_b)        \
+    {                                                                       \
+        NEA_ColResult r = func(&b->shape.field_b, pos_b,                    \
+                               &a->shape.field_a, pos_a);                   \
+        r.normal = NEA_Vec3Neg(r.normal);                                   \
+        return r;                                                           \
+    }
+
+NE_COL_PAIR(ne_col_test_aabb_aabb, NEA_ColTestAABBvsAABB, aabb, aabb)
+NE_COL_PAIR(ne_col_test_sphere_sphere, NEA_ColTestSphereVsSphere,
+            sphere, sphere)
+NE_COL_PAIR(ne_col_test_aabb_sphere, NEA_ColTestAABBvsSphere, aabb, sphere)
+NE_COL_PAIR_REVERSED(ne_col_test_sphere_aabb, NEA_ColTestAABBvsSphere,
+                     sphere, aabb)
+NE_COL_PAIR(ne_col_test_capsule_sphere, NEA_ColTestCapsuleVsSphere,
+            capsule, sphere)
+NE_COL_PAIR_REVERSED(ne_col_test_sphere_capsule, NEA_ColTestCapsuleVsSphere,
+                     sphere, capsule)
+NE_COL_PAIR(ne_col_test_capsule_aabb, NEA_ColTestCapsuleVsAABB,
+            capsule, aabb)
+NE_COL_PAIR_REVERSED(ne_col_test_aabb_capsule, NEA_ColTestCapsuleVsAABB,
+                     aabb, capsule)
+NE_COL_PAIR(ne_col_test_capsule_capsule, NEA_ColTestCapsuleVsCapsule,
+            capsule, capsule)
+
+// ColMeshes are stored as pointers in the shapes
+#define NE_COL_PAIR_MESH(name, func, field_a)                               \
+    static NEA_ColResult name(const NEA_ColShape *a, NEA_Vec3 pos_a,        \
+                              const NEA_ColShape *b, NEA_Vec3 pos_b)        \
+    {                                                                       \
+        return func(&a->shape.field_a, pos_a, b->shape.mesh, pos_b);        \
+    }
+
+#define NE_COL_PAIR_MESH_REVERSED(name, func, field_b)                      \
+    static NEA_ColResult name(const NEA_ColShape *a, NEA_Vec3 pos_a,        \
+                              const NEA_ColShape *b, NEA_Vec3 pos_b)        \
+    {                                                                       \
+        NEA_ColResult r = func(&b->shape.field_b, pos_b,                    \
+                               a->shape.mesh, pos_a);                       \
+        r.normal = NEA_Vec3Neg(r.normal);                                   \
+        return r;                                                           \
+    }
+
+NE_COL_PAIR_MESH(ne_col_test_sphere_mesh, NEA_ColTestSphereVsMesh, sphere)
+NE_COL_PAIR_MESH_REVERSED(ne_col_test_mesh_sphere, NEA_ColTestSphereVsMesh,
+                          sphere)
+NE_COL_PAIR_MESH(ne_col_test_aabb_mesh, NEA_ColTestAABBvsMesh, aabb)
+NE_COL_PAIR_MESH_REVERSED(ne_col_test_mesh_aabb, NEA_ColTestAABBvsMesh, aabb)
+NE_COL_PAIR_MESH(ne_col_test_capsule_mesh, NEA_ColTestCapsuleVsMesh, capsule)
+NE_COL_PAIR_MESH_REVERSED(ne_col_test_mesh_capsule, NEA_ColTestCapsuleVsMesh,
+                          capsule)
+
+#define NE_COL_NUM_TYPES (NEA_COL_TRIMESH + 1)
+
+// Indexed by the type of the first shape and the type of the second shape.
+// ColMesh vs ColMesh isn't supported.
+static const ne_col_test_fn ne_col_tests[NE_COL_NUM_TYPES][NE_COL_NUM_TYPES] = {
+    [NEA_COL_NONE] = {
+        ne_col_test_none, ne_col_test_none, ne_col_test_none,
+        ne_col_test_none, ne_col_test_none
+    },
+    [NEA_COL_AABB] = {
+        [NEA_COL_NONE]    = ne_col_test_none,
+        [NEA_COL_AABB]    = ne_col_test_aabb_aabb,
+        [NEA_COL_SPHERE]  = ne_col_test_aabb_sphere,
+        [NEA_COL_CAPSULE] = ne_col_test_aabb_capsule,
+        [NEA_COL_TRIMESH] = ne_col_test_aabb_mesh,
+    },
+    [NEA_COL_SPHERE] = {
+        [NEA_COL_NONE]    = ne_col_test_none,
+        [NEA_COL_AABB]    = ne_col_test_sphere_aabb,
+        [NEA_COL_SPHERE]  = ne_col_test_sphere_sphere,
+        [NEA_COL_CAPSULE] = ne_col_test_sphere_capsule,
+        [NEA_COL_TRIMESH] = ne_col_test_sphere_mesh,
+    },
+    [NEA_COL_CAPSULE] = {
+        [NEA_COL_NONE]    = ne_col_test_none,
+        [NEA_COL_AABB]    = ne_col_test_capsule_aabb,
+        [NEA_COL_SPHERE]  = ne_col_test_capsule_sphere,
+        [NEA_COL_CAPSULE] = ne_col_test_capsule_capsule,
+        [NEA_COL_TRIMESH] = ne_col_test_capsule_mesh,
+    },
+    [NEA_COL_TRIMESH] = {
+        [NEA_COL_NONE]    = ne_col_test_none,
+        [NEA_COL_AABB]    = ne_col_test_mesh_aabb,
+        [NEA_COL_SPHERE]  = ne_col_test_mesh_sphere,
+        [NEA_COL_CAPSULE] = ne_col_test_mesh_capsule,
+        [NEA_COL_TRIMESH] = ne_col_test_none,
+    },
+};
+
+static inline ne_col_test_fn ne_col_get_test(NEA_ColShapeType a,
+                                             NEA_ColShapeType b)
+{
+    if ((unsigned)a >= NE_COL_NUM_TYPES || (unsigned)b >= NE_COL_NUM_TYPES)
+        return ne_col_test_none;
+
+    return ne_col_tests[a][b];
+}
+
+NEA_ColResult NEA_ColTest(const NEA_ColShape *a, NEA_Vec3 pos_a,
+                          const NEA_ColShape *b, NEA_Vec3 pos_b)
+{
+    NE_STAT_ADD(col_pair_tests, 1);
+
+    return ne_col_get_test(a->type, b->type)(a, pos_a, b, pos_b);
+}
+
+int NEA_ColTestContacts(const NEA_ColShape *a, NEA_Vec3 pos_a,
+                        const NEA_ColShape *b, NEA_Vec3 pos_b,
+                        NEA_ColResult *contacts, int max_contacts)
+{
+    NEA_AssertPointer(contacts, "NULL pointer");
+    NEA_Assert(max_contacts > 0, "Invalid number of contacts");
+
+    // The mesh is always tested as the second shape, and the normals are
+    // flipped if it was the first one.
+    bool reversed = false;
+    if (a->type == NEA_COL_TRIMESH && b->type != NEA_COL_TRIMESH)
     {
-        // Find approximate closest Y on segment to triangle center
-        NEA_Vec3 tri_center = NEA_Vec3Make(
-            (tris[i].v0.x + tris[i].v1.x + tris[i].v2.x) / 3,
-            (tris[i].v0.y + tris[i].v1.y + tris[i].v2.y) / 3,
-            (tris[i].v0.z + tris[i].v1.z + tris[i].v2.z) / 3);
+        const NEA_ColShape *tmp_shape = a;
+        a = b;
+        b = tmp_shape;
+
+        NEA_Vec3 tmp_pos = pos_a;
+        pos_a = pos_b;
+        pos_b = tmp_pos;
+
+        reversed = true;
+    }
 
-        NEA_Vec3 seg_point = ne_closest_point_on_segment_y(
-            local_pos, a->half_height, tri_center);
+    NE_STAT_ADD(col_pair_tests, 1);
 
-        NEA_ColResult tri_r = ne_sphere_vs_triangle(seg_point, a->radius,
-                                                    &tris[i]);
-        if (tri_r.hit && tri_r.depth > best.depth)
+    int count;
+
+    if (b->type != NEA_COL_TRIMESH)
+    {
+        contacts[0] = ne_col_get_test(a->type, b->type)(a, pos_a, b, pos_b);
+        count = contacts[0].hit ? 1 : 0;
+    }
+    else
+    {
+        switch (a->type)
         {
-            best = tri_r;
+            case NEA_COL_SPHERE:
+                count = NEA_ColTestSphereVsMeshContacts(&a->shape.sphere,
+                            pos_a, b->shape.mesh, pos_b, contacts,
+                            max_contacts);
+                break;
+            case NEA_COL_AABB:
+                count = NEA_ColTestAABBvsMeshContacts(&a->shape.aabb, pos_a,
+                            b->shape.mesh, pos_b, contacts, max_contacts);
+                break;
+            case NEA_COL_CAPSULE:
+                count = NEA_ColTestCapsuleVsMeshContacts(&a->shape.capsule,
+                            pos_a, b->shape.mesh, pos_b, contacts,
+                            max_contacts);
+                break;
+            default:
+                count = 0;
+                break;
         }
     }
 
-    if (best.hit && !(mesh->flags & NEA_COLMESH_DYNAMIC))
+    if (reversed)
     {
-        best.point = NEA_Vec3Add(best.point, mesh_pos);
+        for (int i = 0; i < count; i++)
+            contacts[i].normal = NEA_Vec3Neg(contacts[i].normal);
     }
 
-    return best;
+    return count;
+}
+
+// Half-extents of the box around a primitive shape, centered at its position.
+// It returns false for ColMeshes and shapes without a type.
+static inline bool ne_col_shape_half(const NEA_ColShape *shape,
+                                     NEA_Vec3 *half)
+{
+    switch (shape->type)
+    {
+        case NEA_COL_AABB:
+            *half = shape->shape.aabb.half;
+            return true;
+        case NEA_COL_SPHERE:
+        {
+            int32_t r = shape->shape.sphere.radius;
+            *half = NEA_Vec3Make(r, r, r);
+            return true;
+        }
+        case NEA_COL_CAPSULE:
+        {
+            int32_t r = shape->shape.capsule.radius;
+            *half = NEA_Vec3Make(r, shape->shape.capsule.half_height + r, r);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+int NEA_ColTestBatch(const NEA_ColShape *shape, NEA_Vec3 pos,
+                     const NEA_ColTarget *targets, int count,
+                     NEA_ColResult *results)
+{
+    NEA_AssertPointer(shape, "NULL shape pointer");
+    NEA_AssertMinMax(0, count, INT32_MAX, "Invalid target count %d", count);
+    if (count > 0)
+    {
+        NEA_AssertPointer(targets, "NULL targets pointer");
+        NEA_AssertPointer(results, "NULL results pointer");
+    }
+
+    // Values of the query shared by all tests
+    NEA_Vec3 half;
+    bool has_box = ne_col_shape_half(shape, &half);
+    const ne_col_test_fn *tests = ne_col_tests[NEA_COL_NONE];
+    if ((unsigned)shape->type < NE_COL_NUM_TYPES)
+        tests = ne_col_tests[shape->type];
+
+    // Test the targets grouped by their type, so the function is selected
+    // once per group.
+    int hits = 0;
+
+    for (int type = NEA_COL_NONE; type < NE_COL_NUM_TYPES; type++)
+    {
+        ne_col_test_fn test = tests[type];
+        bool reject = has_box && (type != NEA_COL_NONE)
+                      && (type != NEA_COL_TRIMESH);
+
+        for (int i = 0; i < count; i++)
+        {
+            const NEA_ColShape *target = targets[i].shape;
+
+            // Shapes with invalid types are tested like shapes without type
+            int target_type = target->type;
+            if ((unsigned)target_type >= NE_COL_NUM_TYPES)
+                target_type = NEA_COL_NONE;
+            if (target_type != type)
+                continue;
+
+            NEA_ColResult *r = &results[i];
+            NEA_Vec3 target_pos = targets[i].pos;
+
+            // Reject targets with their bounding boxes
+            if (reject)
+            {
+                NEA_Vec3 target_half;
+                ne_col_shape_half(target, &target_half);
+
+                if ((abs(target_pos.x - pos.x) > half.x + target_half.x) ||
+                    (abs(target_pos.y - pos.y) > half.y + target_half.y) ||
+                    (abs(target_pos.z - pos.z) > half.z + target_half.z))
+                {
+                    r->hit = false;
+                    continue;
+                }
+            }
+
+            NE_STAT_ADD(col_pair_tests, 1);
+
+            *r = test(shape, pos, target, target_pos);
+            hits += r->hit;
+        }
+    }
+
+    return hits;
 }
 
 // =========================================================================
-// Generic collision dispatcher
+// Raycasts and sweeps
 // =========================================================================
+// Rays are tested as segments. Sweeping a sphere is the same as casting a ray
+// from its center against the shape grown by its radius, so all functions
+// below support a radius, and raycasts use a radius of 0.
 
-NEA_ColResult NEA_ColTest(const NEA_ColShape *a, NEA_Vec3 pos_a,
-                          const NEA_ColShape *b, NEA_Vec3 pos_b)
+// Tolerance of the tests against the edges of the triangles, so that rays that
+// go through the edge shared by two triangles don't miss both (f32)
+#define NE_RAY_EDGE_TOLERANCE 4
+
+typedef struct {
+    NEA_Vec3 origin; // Start of the ray (f32)
+    NEA_Vec3 delta;  // Vector from the start to the end of the ray (f32)
+    NEA_Vec3 dir;    // Direction of the ray (f32, unit length)
+    int32_t length;  // Length of the segment (f32)
+    int32_t radius;  // Radius of the swept sphere (f32)
+    int64_t inv[3];  // (1 << 36) / dir, or 0 if dir is 0 in that axis
+} ne_ray_t;
+
+// Returns a pointer to a component of a vector (0 = X, 1 = Y, 2 = Z)
+static inline int32_t *ne_vec3_axis(NEA_Vec3 *v, int axis)
 {
-    NEA_ColResult r = { .hit = false };
+    return (axis == 0) ? &v->x : (axis == 1) ? &v->y : &v->z;
+}
 
-    if (a->type == NEA_COL_NONE || b->type == NEA_COL_NONE)
-        return r;
+// Dot product of two vectors with 24 fractional bits
+static inline int64_t ne_dot64(NEA_Vec3 a, NEA_Vec3 b)
+{
+    return (int64_t)a.x * b.x + (int64_t)a.y * b.y + (int64_t)a.z * b.z;
+}
 
-    // Dispatch based on shape pair
-    // For non-symmetric pairs, we call with a specific argument order
-    // and negate the normal if needed.
+// Cross product of two vectors, without the overflows of NEA_Vec3Cross()
+static inline NEA_Vec3 ne_cross64(NEA_Vec3 a, NEA_Vec3 b)
+{
+    return NEA_Vec3Make(((int64_t)a.y * b.z - (int64_t)a.z * b.y) >> 12,
+                        ((int64_t)a.z * b.x - (int64_t)a.x * b.z) >> 12,
+                        ((int64_t)a.x * b.y - (int64_t)a.y * b.x) >> 12);
+}
 
-    // AABB vs AABB
-    if (a->type == NEA_COL_AABB && b->type == NEA_COL_AABB)
+// Discriminant of the intersection of a ray with direction d with a circle of
+// the given radius, when m is the vector from the center to the origin. It is
+// calculated as |d|^2 r^2 - |m x d|^2 instead of (m.d)^2 - |d|^2 (|m|^2 - r^2),
+// which loses too much precision when the ray is close to the edge. The result
+// has 24 fractional bits.
+static inline int64_t ne_ray_disc(NEA_Vec3 m, NEA_Vec3 d, int32_t radius)
+{
+    NEA_Vec3 cross = ne_cross64(m, d);
+    return (((int64_t)radius * radius) >> 12) * (ne_dot64(d, d) >> 12)
+           - ne_dot64(cross, cross);
+}
+
+// Returns false if the segment has a length of 0
+static bool ne_ray_init(ne_ray_t *ray, NEA_Vec3 from, NEA_Vec3 to,
+                        int32_t radius)
+{
+    NEA_Vec3 d = NEA_Vec3Sub(to, from);
+
+    ray->origin = from;
+    ray->delta = d;
+    ray->radius = radius;
+    ray->length = sqrt64(ne_dot64(d, d));
+    if (ray->length == 0)
+        return false;
+
+    ne_recip_start(ray->length);
+    ray->dir = ne_vec3_div_recip(d, ray->length);
+
+    for (int i = 0; i < 3; i++)
     {
-        return NEA_ColTestAABBvsAABB(&a->shape.aabb, pos_a,
-                                     &b->shape.aabb, pos_b);
+        int32_t dir = *ne_vec3_axis(&ray->dir, i);
+        ray->inv[i] = (dir != 0) ? (1LL << 36) / dir : 0;
     }
 
-    // Sphere vs Sphere
-    if (a->type == NEA_COL_SPHERE && b->type == NEA_COL_SPHERE)
+    return true;
+}
+
+// Position of the ray at a distance from its origin. It uses the vector to the
+// end of the ray because it is more precise than the direction.
+static inline NEA_Vec3 ne_ray_at(const ne_ray_t *ray, int32_t dist)
+{
+    NEA_Vec3 d = ray->delta;
+    int32_t len = ray->length;
+    return NEA_Vec3Make(ray->origin.x + ((int64_t)d.x * dist) / len,
+                        ray->origin.y + ((int64_t)d.y * dist) / len,
+                        ray->origin.z + ((int64_t)d.z * dist) / len);
+}
+
+// Saves a hit if it is closer than the current one. The distance of the result
+// is initialized to a value past the end of the ray.
+static inline void ne_ray_set_hit(NEA_ColRayResult *best, int32_t dist,
+                                  NEA_Vec3 normal)
+{
+    if (dist >= best->distance)
+        return;
+
+    best->hit = true;
+    best->distance = dist;
+    best->normal = normal;
+}
+
+// Normal of a hit at a point, or the opposite of the ray direction if the
+// point is the center of the shape.
+static inline NEA_Vec3 ne_ray_normal(const ne_ray_t *ray, NEA_Vec3 v)
+{
+    if (v.x == 0 && v.y == 0 && v.z == 0)
+        return NEA_Vec3Neg(ray->dir);
+    return NEA_Vec3Normalize(v);
+}
+
+static void ne_ray_vs_sphere(const ne_ray_t *ray, NEA_Vec3 center,
+                             int32_t radius, NEA_ColRayResult *best)
+{
+    radius += ray->radius;
+
+    NEA_Vec3 m = NEA_Vec3Sub(ray->origin, center);
+
+    // Distance to the surface, with 24 fractional bits
+    int64_t c = ne_dot64(m, m) - (int64_t)radius * radius;
+    if (c <= 0)
     {
-        return NEA_ColTestSphereVsSphere(&a->shape.sphere, pos_a,
-                                         &b->shape.sphere, pos_b);
+        ne_ray_set_hit(best, 0, ne_ray_normal(ray, m));
+        return;
     }
 
-    // AABB vs Sphere (and reverse)
-    if (a->type == NEA_COL_AABB && b->type == NEA_COL_SPHERE)
+    // Moving away from the sphere
+    int32_t b = ne_dot64(m, ray->dir) >> 12;
+    if (b >= 0)
+        return;
+
+    int64_t disc = ne_ray_disc(m, ray->dir, radius);
+    if (disc < 0)
+        return;
+
+    // Closest root of at^2 + 2bt + c = 0, written as c / (-b + sqrt(disc)) to
+    // avoid the cancellation of -b - sqrt(disc).
+    int32_t dist = div64(c, -b + (int32_t)sqrt64(disc));
+    if (dist >= best->distance)
+        return;
+
+    NEA_Vec3 n = NEA_Vec3Sub(ne_ray_at(ray, dist), center);
+    ne_ray_set_hit(best, dist, ne_ray_normal(ray, n));
+}
+
+// Capsule around the segment from a to b
+static void ne_ray_vs_capsule(const ne_ray_t *ray, NEA_Vec3 a, NEA_Vec3 b,
+                              int32_t radius, NEA_ColRayResult *best)
+{
+    ne_ray_vs_sphere(ray, a, radius, best);
+    ne_ray_vs_sphere(ray, b, radius, best);
+
+    NEA_Vec3 ab = NEA_Vec3Sub(b, a);
+    int32_t height = sqrt64(ne_dot64(ab, ab));
+    if (height == 0)
+        return;
+
+    ne_recip_start(height);
+
+    radius += ray->radius;
+    NEA_Vec3 m = NEA_Vec3Sub(ray->origin, a);
+
+    // Remove the components along the axis of the cylinder
+    NEA_Vec3 w = ne_vec3_div_recip(ab, height);
+    int32_t md = ne_dot64(m, w) >> 12;
+    int32_t nd = ne_dot64(ray->dir, w) >> 12;
+    NEA_Vec3 mp = NEA_Vec3Sub(m, NEA_Vec3Scale(w, md));
+    NEA_Vec3 dp = NEA_Vec3Sub(ray->dir, NEA_Vec3Scale(w, nd));
+
+    int64_t c = ne_dot64(mp, mp) - (int64_t)radius * radius;
+    if (c <= 0)
     {
-        return NEA_ColTestAABBvsSphere(&a->shape.aabb, pos_a,
-                                       &b->shape.sphere, pos_b);
+        if ((md >= 0) && (md <= height))
+            ne_ray_set_hit(best, 0, ne_ray_normal(ray, mp));
+        return;
     }
-    if (a->type == NEA_COL_SPHERE && b->type == NEA_COL_AABB)
+
+    // Moving away from the axis, or parallel to it
+    int32_t bb = ne_dot64(mp, dp) >> 12;
+    if (bb >= 0)
+        return;
+
+    int64_t disc = ne_ray_disc(mp, dp, radius);
+    if (disc < 0)
+        return;
+
+    int32_t dist = div64(c, -bb + (int32_t)sqrt64(disc));
+    if (dist >= best->distance)
+        return;
+
+    // The ends are tested by the spheres
+    int32_t s = md + mulf32(nd, dist);
+    if ((s < 0) || (s > height))
+        return;
+
+    NEA_Vec3 n = NEA_Vec3Add(mp, NEA_Vec3Scale(dp, dist));
+    ne_ray_set_hit(best, dist, ne_ray_normal(ray, n));
+}
+
+// Slab test of a ray against a box, not grown by the radius of the ray. It
+// returns false if the ray doesn't enter the box before max_dist. The axis is
+// -1 if the ray starts inside the box.
+static bool ne_ray_slab(const ne_ray_t *ray, NEA_Vec3 min, NEA_Vec3 max,
+                        int32_t max_dist, int32_t *enter, int *axis)
+{
+    NEA_Vec3 origin = ray->origin;
+
+    int64_t t_min = 0;
+    int64_t t_max = max_dist;
+    *axis = -1;
+
+    for (int i = 0; i < 3; i++)
     {
-        r = NEA_ColTestAABBvsSphere(&b->shape.aabb, pos_b,
-                                    &a->shape.sphere, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        int32_t o = *ne_vec3_axis(&origin, i);
+        int32_t lo = *ne_vec3_axis(&min, i);
+        int32_t hi = *ne_vec3_axis(&max, i);
+
+        if (ray->inv[i] == 0)
+        {
+            if ((o < lo) || (o > hi))
+                return false;
+            continue;
+        }
+
+        int64_t t1 = ((int64_t)(lo - o) * ray->inv[i]) >> 24;
+        int64_t t2 = ((int64_t)(hi - o) * ray->inv[i]) >> 24;
+        if (t1 > t2)
+        {
+            int64_t tmp = t1;
+            t1 = t2;
+            t2 = tmp;
+        }
+
+        if (t1 > t_min)
+        {
+            t_min = t1;
+            *axis = i;
+        }
+        if (t2 < t_max)
+            t_max = t2;
+
+        if (t_min > t_max)
+            return false;
     }
 
-    // Capsule vs Sphere (and reverse)
-    if (a->type == NEA_COL_CAPSULE && b->type == NEA_COL_SPHERE)
+    *enter = t_min;
+    return true;
+}
+
+static void ne_ray_vs_box(const ne_ray_t *ray, NEA_Vec3 min, NEA_Vec3 max,
+                          NEA_ColRayResult *best)
+{
+    int32_t dist;
+    int axis;
+    if (!ne_ray_slab(ray, min, max, best->distance, &dist, &axis))
+        return;
+
+    NEA_Vec3 n = NEA_Vec3Neg(ray->dir);
+    if (axis >= 0)
     {
-        return NEA_ColTestCapsuleVsSphere(&a->shape.capsule, pos_a,
-                                          &b->shape.sphere, pos_b);
+        // Get the distance again with the vector to the end, which is more
+        // precise than the direction.
+        NEA_Vec3 origin = ray->origin, delta = ray->delta;
+        int32_t o = *ne_vec3_axis(&origin, axis);
+        int32_t d = *ne_vec3_axis(&delta, axis);
+        int32_t plane = (d > 0) ? *ne_vec3_axis(&min, axis)
+                                : *ne_vec3_axis(&max, axis);
+        int32_t exact = ((int64_t)(plane - o) * ray->length) / d;
+        if ((exact >= 0) && (exact < best->distance))
+            dist = exact;
+
+        n = NEA_Vec3Make(0, 0, 0);
+        *ne_vec3_axis(&n, axis) = (d > 0) ? -inttof32(1) : inttof32(1);
     }
-    if (a->type == NEA_COL_SPHERE && b->type == NEA_COL_CAPSULE)
+
+    ne_ray_set_hit(best, dist, n);
+}
+
+// Box grown by the radius of the ray, with rounded edges and corners
+static void ne_ray_vs_rounded_box(const ne_ray_t *ray, NEA_Vec3 min,
+                                  NEA_Vec3 max, NEA_ColRayResult *best)
+{
+    int32_t r = ray->radius;
+    if (r == 0)
     {
-        r = NEA_ColTestCapsuleVsSphere(&b->shape.capsule, pos_b,
-                                       &a->shape.sphere, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        ne_ray_vs_box(ray, min, max, best);
+        return;
     }
 
-    // Capsule vs AABB (and reverse)
-    if (a->type == NEA_COL_CAPSULE && b->type == NEA_COL_AABB)
+    // Reject the ray with the box grown in all axes
+    int32_t dist;
+    int axis;
+    if (!ne_ray_slab(ray, NEA_Vec3Make(min.x - r, min.y - r, min.z - r),
+                     NEA_Vec3Make(max.x + r, max.y + r, max.z + r),
+                     best->distance, &dist, &axis))
+        return;
+
+    // The rounded box is the union of the box grown in each axis and the
+    // capsules around its edges.
+    for (int i = 0; i < 3; i++)
     {
-        return NEA_ColTestCapsuleVsAABB(&a->shape.capsule, pos_a,
-                                        &b->shape.aabb, pos_b);
+        NEA_Vec3 lo = min, hi = max;
+        *ne_vec3_axis(&lo, i) -= r;
+        *ne_vec3_axis(&hi, i) += r;
+        ne_ray_vs_box(ray, lo, hi, best);
     }
-    if (a->type == NEA_COL_AABB && b->type == NEA_COL_CAPSULE)
+
+    ne_ray_t edge_ray = *ray;
+    edge_ray.radius = 0;
+
+    for (int i = 0; i < 3; i++)
     {
-        r = NEA_ColTestCapsuleVsAABB(&b->shape.capsule, pos_b,
-                                     &a->shape.aabb, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        int j = (i + 1) % 3;
+        int k = (i + 2) % 3;
+
+        for (int corner = 0; corner < 4; corner++)
+        {
+            NEA_Vec3 a = min;
+            if (corner & 1)
+                *ne_vec3_axis(&a, j) = *ne_vec3_axis(&max, j);
+            if (corner & 2)
+                *ne_vec3_axis(&a, k) = *ne_vec3_axis(&max, k);
+
+            NEA_Vec3 b = a;
+            *ne_vec3_axis(&b, i) = *ne_vec3_axis(&max, i);
+
+            ne_ray_vs_capsule(&edge_ray, a, b, r, best);
+        }
     }
+}
+
+static void ne_ray_vs_triangle(const ne_ray_t *ray, const NEA_ColTriangle *tri,
+                               NEA_ColRayResult *best)
+{
+    NE_STAT_ADD(col_tri_tests, 1);
+
+    if (tri->radius < 0)
+        return;
+
+    int32_t r = ray->radius;
+
+    // Signed distance of the start of the ray to the plane, and how much it
+    // changes until the end of the ray. The distance at the closest hit found
+    // so far is compared multiplied by the length of the ray.
+    int32_t len = ray->length;
+    int32_t s0 = (ne_dot64(ray->origin, tri->normal) >> 12) - tri->plane_d;
+    int32_t ds = ne_dot64(ray->delta, tri->normal) >> 12;
+    int64_t s1 = (int64_t)s0 * len + (int64_t)ds * best->distance;
+    int64_t r_len = (int64_t)r * len;
+
+    if (((s0 > r) && (s1 > r_len)) || ((s0 < -r) && (s1 < -r_len)))
+        return;
+
+    // Hit against the face, where the sphere touches the plane
+    int32_t side = (s0 >= 0) ? 1 : -1;
+    int32_t dist;
+    if (abs(s0) <= r)
+        dist = 0;
+    else if ((ds * side) < 0)
+        dist = ((int64_t)(abs(s0) - r) * len) / abs(ds);
+    else
+        dist = best->distance;
+
+    if (dist < best->distance)
+    {
+        NEA_Vec3 normal = NEA_Vec3Scale(tri->normal, inttof32(side));
+        NEA_Vec3 p = ne_ray_at(ray, dist);
+        int32_t plane_dist = (dist == 0) ? s0 : r * side;
+        p = NEA_Vec3Sub(p, NEA_Vec3Scale(tri->normal, plane_dist));
+
+        NEA_Vec3 verts[3] = { tri->v0, tri->v1, tri->v2 };
+        bool inside = true;
+        for (int i = 0; i < 3; i++)
+        {
+            NEA_Vec3 d = NEA_Vec3Sub(p, verts[i]);
+            const int16_t *n = tri->edge_normal[i];
+            int32_t edge_dist = ((int64_t)d.x * n[0] + (int64_t)d.y * n[1]
+                                 + (int64_t)d.z * n[2]) >> 12;
+            if (edge_dist < -NE_RAY_EDGE_TOLERANCE)
+            {
+                inside = false;
+                break;
+            }
+        }
+
+        // The face is the first part of the triangle touched by the sphere
+        if (inside)
+        {
+            ne_ray_set_hit(best, dist, normal);
+            return;
+        }
+    }
+
+    if (r == 0)
+        return;
+
+    ne_ray_t edge_ray = *ray;
+    edge_ray.radius = 0;
+
+    ne_ray_vs_capsule(&edge_ray, tri->v0, tri->v1, r, best);
+    ne_ray_vs_capsule(&edge_ray, tri->v1, tri->v2, r, best);
+    ne_ray_vs_capsule(&edge_ray, tri->v2, tri->v0, r, best);
+}
 
-    // Capsule vs Capsule
-    if (a->type == NEA_COL_CAPSULE && b->type == NEA_COL_CAPSULE)
+// Ray vs the triangles of a mesh, in the space of the triangles
+static void ne_ray_vs_mesh_tris(const ne_ray_t *ray, const NEA_ColMesh *mesh,
+                                NEA_ColRayResult *best)
+{
+    const NEA_ColTriangle *tris = ne_colmesh_get_tris(mesh);
+    const NEA_ColBVHNode *nodes = ne_colmesh_get_nodes(mesh);
+    int32_t r = ray->radius;
+    int32_t dist;
+    int axis;
+
+    NEA_Vec3 min = NEA_Vec3Sub(mesh->center, mesh->bounds.half);
+    NEA_Vec3 max = NEA_Vec3Add(mesh->center, mesh->bounds.half);
+    if (!ne_ray_slab(ray, NEA_Vec3Make(min.x - r, min.y - r, min.z - r),
+                     NEA_Vec3Make(max.x + r, max.y + r, max.z + r),
+                     best->distance, &dist, &axis))
+        return;
+
+    if (nodes == NULL)
     {
-        return NEA_ColTestCapsuleVsCapsule(&a->shape.capsule, pos_a,
-                                           &b->shape.capsule, pos_b);
+        for (int i = 0; i < mesh->num_triangles; i++)
+            ne_ray_vs_triangle(ray, &tris[i], best);
+        return;
     }
 
-    // Sphere vs ColMesh (and reverse)
-    if (a->type == NEA_COL_SPHERE && b->type == NEA_COL_TRIMESH)
+    uint16_t stack[NEA_COLMESH_BVH_MAX_DEPTH];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while (sp > 0)
     {
-        return NEA_ColTestSphereVsMesh(&a->shape.sphere, pos_a,
-                                       b->shape.mesh, pos_b);
+        int index = stack[--sp];
+        const NEA_ColBVHNode *node = &nodes[index];
+
+        // Nodes farther than the closest hit found so far are skipped too
+        if (!ne_ray_slab(ray,
+                         NEA_Vec3Make(node->min.x - r, node->min.y - r,
+                                      node->min.z - r),
+                         NEA_Vec3Make(node->max.x + r, node->max.y + r,
+                                      node->max.z + r),
+                         best->distance, &dist, &axis))
+            continue;
+
+        if (node->count > 0)
+        {
+            for (int i = node->first; i < node->first + node->count; i++)
+                ne_ray_vs_triangle(ray, &tris[i], best);
+            continue;
+        }
+
+        // The loader has checked that the stack can't overflow
+        stack[sp++] = node->first;
+        stack[sp++] = index + 1;
     }
-    if (a->type == NEA_COL_TRIMESH && b->type == NEA_COL_SPHERE)
+}
+
+static NEA_ColRayResult ne_col_sweep(int32_t radius, NEA_Vec3 from,
+                                     NEA_Vec3 to, const NEA_ColShape *shape,
+                                     NEA_Vec3 pos)
+{
+    NEA_ColRayResult best = { .hit = false };
+
+    NEA_AssertPointer(shape, "NULL shape pointer");
+
+    const NEA_ColMesh *mesh = NULL;
+    if (shape->type == NEA_COL_TRIMESH)
     {
-        r = NEA_ColTestSphereVsMesh(&b->shape.sphere, pos_b,
-                                    a->shape.mesh, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        mesh = shape->shape.mesh;
+        NEA_AssertPointer(mesh, "NULL mesh pointer");
+
+        // Move the ray to the space of the triangles
+        if (mesh->flags & NEA_COLMESH_TRANSFORMED)
+        {
+            ne_divf32_start(radius, mesh->scale);
+            from = ne_vec3_transform(NEA_Vec3Sub(from, pos), &mesh->inverse);
+            to = ne_vec3_transform(NEA_Vec3Sub(to, pos), &mesh->inverse);
+            radius = ne_divf32_result();
+        }
+        else if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
+        {
+            from = NEA_Vec3Sub(from, pos);
+            to = NEA_Vec3Sub(to, pos);
+        }
     }
 
-    // AABB vs ColMesh (and reverse)
-    if (a->type == NEA_COL_AABB && b->type == NEA_COL_TRIMESH)
+    ne_ray_t ray;
+    if (!ne_ray_init(&ray, from, to, radius))
+        return best;
+
+    best.distance = ray.length + 1;
+
+    switch (shape->type)
     {
-        return NEA_ColTestAABBvsMesh(&a->shape.aabb, pos_a,
-                                     b->shape.mesh, pos_b);
+        case NEA_COL_AABB:
+            ne_ray_vs_rounded_box(&ray, NEA_Vec3Sub(pos, shape->shape.aabb.half),
+                                  NEA_Vec3Add(pos, shape->shape.aabb.half),
+                                  &best);
+            break;
+
+        case NEA_COL_SPHERE:
+            ne_ray_vs_sphere(&ray, pos, shape->shape.sphere.radius, &best);
+            break;
+
+        case NEA_COL_CAPSULE:
+        {
+            int32_t h = shape->shape.capsule.half_height;
+            ne_ray_vs_capsule(&ray, NEA_Vec3Make(pos.x, pos.y - h, pos.z),
+                              NEA_Vec3Make(pos.x, pos.y + h, pos.z),
+                              shape->shape.capsule.radius, &best);
+            break;
+        }
+
+        case NEA_COL_TRIMESH:
+            ne_ray_vs_mesh_tris(&ray, mesh, &best);
+            break;
+
+        default:
+            break;
     }
-    if (a->type == NEA_COL_TRIMESH && b->type == NEA_COL_AABB)
+
+    if (!best.hit)
     {
-        r = NEA_ColTestAABBvsMesh(&b->shape.aabb, pos_b,
-                                  a->shape.mesh, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        best.distance = 0;
+        return best;
     }
 
-    // Capsule vs ColMesh (and reverse)
-    if (a->type == NEA_COL_CAPSULE && b->type == NEA_COL_TRIMESH)
+    NEA_Vec3 center = ne_ray_at(&ray, best.distance);
+    best.point = NEA_Vec3Sub(center, NEA_Vec3Scale(best.normal, radius));
+
+    if (mesh == NULL)
+        return best;
+
+    // Move the result back to world space
+    if (mesh->flags & NEA_COLMESH_TRANSFORMED)
     {
-        return NEA_ColTestCapsuleVsMesh(&a->shape.capsule, pos_a,
-                                        b->shape.mesh, pos_b);
+        best.point = NEA_Vec3Add(ne_vec3_transform(best.point, &mesh->matrix),
+                                 pos);
+        best.normal = NEA_Vec3Normalize(ne_vec3_rotate(best.normal,
+                                                       &mesh->matrix));
+        best.distance = mulf32(best.distance, mesh->scale);
     }
-    if (a->type == NEA_COL_TRIMESH && b->type == NEA_COL_CAPSULE)
+    else if (!(mesh->flags & NEA_COLMESH_DYNAMIC))
     {
-        r = NEA_ColTestCapsuleVsMesh(&b->shape.capsule, pos_b,
-                                     a->shape.mesh, pos_a);
-        r.normal = NEA_Vec3Neg(r.normal);
-        return r;
+        best.point = NEA_Vec3Add(best.point, pos);
     }
 
-    // ColMesh vs ColMesh: not supported
-    return r;
+    return best;
+}
+
+NEA_ColRayResult NEA_ColRaycast(NEA_Vec3 from, NEA_Vec3 to,
+                                const NEA_ColShape *shape, NEA_Vec3 pos)
+{
+    return ne_col_sweep(0, from, to, shape, pos);
+}
+
+NEA_ColRayResult NEA_ColSweepSphere(const NEA_ColSphere *sphere,
+                                    NEA_Vec3 from, NEA_Vec3 to,
+                                    const NEA_ColShape *shape, NEA_Vec3 pos)
+{
+    NEA_AssertPointer(sphere, "NULL sphere pointer");
+
+    return ne_col_sweep(sphere->radius, from, to, shape, pos);
 }
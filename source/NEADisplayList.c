@@ -7,8 +7,53 @@
 #include <nds.h>
 
 #include "NEAMain.h"
+#include "NEAStats.h"
 
-void NEA_DisplayListDrawDMA_GFX_FIFO(const void *list)
+// Internal use... see NEAGeneral.c and NEAProfile.c
+extern bool ne_gpu_stats_enabled;
+extern NEA_GPUStats ne_gpu_stats_current;
+u32 ne_cycles_now(void);
+
+// Internal use... see NEAPolygon.c and NEATexture.c
+extern u32 ne_poly_format_last;
+void ne_material_state_forget_poly_format(void);
+
+// Weak reference: the job scheduler is only linked if the user uses it
+extern void ne_job_idle(void) __attribute__((weak));
+
+// Runs a job of the scheduler while the CPU waits for the GPU
+static inline void ne_dl_idle(void)
+{
+    if (ne_job_idle)
+        ne_job_idle();
+}
+
+static inline void ne_dl_stats_list(uint32_t words)
+{
+    NE_STAT_ADD(dl_words, words);
+
+    if (ne_gpu_stats_enabled)
+    {
+        ne_gpu_stats_current.lists++;
+        ne_gpu_stats_current.fifo_words += words;
+    }
+}
+
+static inline u32 ne_dl_stats_time(void)
+{
+    return ne_gpu_stats_enabled ? ne_cycles_now() : 0;
+}
+
+static inline void ne_dl_stats_stall(u32 start)
+{
+    if (ne_gpu_stats_enabled)
+        ne_gpu_stats_current.stall_cycles += ne_cycles_now() - start;
+}
+
+// Lists that haven't been modified since they were flushed with
+// NEA_DisplayListFlush() don't need to be flushed again before the DMA reads
+// them. Flushing a big list every time it's drawn wastes a lot of CPU time.
+static void ne_dl_dma_draw(const void *list, bool flush)
 {
     const uint32_t *p = list;
 
@@ -18,7 +63,11 @@ void NEA_DisplayListDrawDMA_GFX_FIFO(const void *list)
 
     NEA_Assert(words > 0, "Empty display list");
 
-    DC_FlushRange(p, words * 4);
+    if (flush)
+        DC_FlushRange(p, words * 4);
+
+    ne_dl_stats_list(words);
+    u32 start = ne_dl_stats_time();
 
     // There is a hardware bug that affects DMA when there are multiple channels
     // active, under certain conditions. Instead of checking for said
@@ -33,10 +82,123 @@ void NEA_DisplayListDrawDMA_GFX_FIFO(const void *list)
     DMA_CR(0) = DMA_FIFO | words;
 #endif
 
-    while (dmaBusy(0));
+    // The CPU waits while the DMA is blocked by the GX FIFO being full
+    while (dmaBusy(0))
+        ne_dl_idle();
+
+    ne_dl_stats_stall(start);
 }
 
-void NEA_DisplayListDrawCPU(const void *list)
+// Lists of the user may change the polygon format, so the shadow copy of the
+// register can't be trusted after drawing them.
+static inline void ne_dl_forget_state(void)
+{
+    ne_material_state_forget_poly_format();
+}
+
+void NEA_DisplayListDrawDMA_GFX_FIFO(const void *list)
+{
+    ne_dl_dma_draw(list, true);
+    ne_dl_forget_state();
+}
+
+// Asynchronous DMA backend
+// -------------------------
+//
+// Lists are sent with DMA channel 0 in GFX FIFO mode. When a transfer ends, the
+// DMA IRQ handler starts the next list of the queue. The CPU only has to wait
+// when the queue is full, or when it needs to write to the GX registers
+// directly (see NEA_DisplayListWait()).
+
+#define NE_DL_ASYNC_QUEUE_SIZE 16 // Must be a power of 2
+
+typedef struct {
+    const uint32_t *data;
+    uint32_t words;
+} ne_dl_async_entry;
+
+static ne_dl_async_entry ne_dl_async_queue[NE_DL_ASYNC_QUEUE_SIZE];
+static volatile unsigned int ne_dl_async_head; // Next entry to be sent
+static volatile unsigned int ne_dl_async_tail; // Next free entry
+static volatile bool ne_dl_async_busy = false;
+static bool ne_dl_async_irq_set = false;
+
+static void ne_dl_async_start(const uint32_t *p, uint32_t words)
+{
+#ifdef NEA_BLOCKSDS
+    dmaSetParams(0, p, (void *)&GFX_FIFO, DMA_FIFO | DMA_IRQ_REQ | words);
+#else
+    DMA_SRC(0) = (uint32_t)p;
+    DMA_DEST(0) = (uint32_t)&GFX_FIFO;
+    DMA_CR(0) = DMA_FIFO | DMA_IRQ_REQ | words;
+#endif
+}
+
+static void ne_dl_async_irq_handler(void)
+{
+    if (ne_dl_async_head == ne_dl_async_tail)
+    {
+        ne_dl_async_busy = false;
+        return;
+    }
+
+    ne_dl_async_entry *entry =
+        &ne_dl_async_queue[ne_dl_async_head & (NE_DL_ASYNC_QUEUE_SIZE - 1)];
+    ne_dl_async_head++;
+
+    ne_dl_async_start(entry->data, entry->words);
+}
+
+static void ne_dl_async_send(const uint32_t *p, uint32_t words)
+{
+    if (!ne_dl_async_irq_set)
+    {
+        irqSet(IRQ_DMA0, ne_dl_async_irq_handler);
+        irqEnable(IRQ_DMA0);
+        ne_dl_async_irq_set = true;
+    }
+
+    ne_dl_stats_list(words);
+    u32 start = ne_dl_stats_time();
+
+    while (1)
+    {
+        int oldIME = enterCriticalSection();
+
+        if (!ne_dl_async_busy)
+        {
+            // See NEA_DisplayListDrawDMA_GFX_FIFO(). Channel 0 is idle, so
+            // only the other ones need to be checked.
+            while (dmaBusy(1) || dmaBusy(2) || dmaBusy(3));
+
+            ne_dl_async_busy = true;
+            ne_dl_async_start(p, words);
+
+            leaveCriticalSection(oldIME);
+            ne_dl_stats_stall(start);
+            return;
+        }
+
+        if ((ne_dl_async_tail - ne_dl_async_head) < NE_DL_ASYNC_QUEUE_SIZE)
+        {
+            ne_dl_async_entry *entry =
+                &ne_dl_async_queue[ne_dl_async_tail & (NE_DL_ASYNC_QUEUE_SIZE - 1)];
+            entry->data = p;
+            entry->words = words;
+            ne_dl_async_tail++;
+
+            leaveCriticalSection(oldIME);
+            ne_dl_stats_stall(start);
+            return;
+        }
+
+        // The queue is full, wait for the IRQ handler to make some space
+        leaveCriticalSection(oldIME);
+        ne_dl_idle();
+    }
+}
+
+static void ne_dl_async_draw(const void *list, bool flush)
 {
     const uint32_t *p = list;
 
@@ -46,16 +208,87 @@ void NEA_DisplayListDrawCPU(const void *list)
 
     NEA_Assert(words > 0, "Empty display list");
 
+    if (flush)
+        DC_FlushRange(p, words * 4);
+
+    ne_dl_async_send(p, words);
+}
+
+void NEA_DisplayListDrawDMA_GFX_FIFO_Async(const void *list)
+{
+    ne_dl_async_draw(list, true);
+    ne_dl_forget_state();
+}
+
+void NEA_DisplayListWait(void)
+{
+    if (!ne_dl_async_busy)
+        return;
+
+    u32 start = ne_dl_stats_time();
+    while (ne_dl_async_busy)
+        ne_dl_idle();
+    ne_dl_stats_stall(start);
+}
+
+// MTX_POP command (ID 0x12, the other 3 commands are NOPs) with its parameter,
+// as a display list. It is in RAM so that the DMA can read it.
+static uint32_t ne_dl_matrix_pop_list[] = {
+    2, 0x12, 1
+};
+
+static void ne_dl_cpu_draw(const void *list)
+{
+    const uint32_t *p = list;
+
+    NEA_AssertPointer(p, "NULL display list pointer");
+
+    uint32_t words = *p++;
+
+    NEA_Assert(words > 0, "Empty display list");
+
+    ne_dl_stats_list(words);
+    u32 start = ne_dl_stats_time();
+
+    // Writes stall the CPU while the GX FIFO is full
     while (words--)
         GFX_FIFO = *p++;
+
+    if (ne_gpu_stats_enabled)
+        ne_gpu_stats_current.cpu_send_cycles += ne_cycles_now() - start;
+}
+
+void NEA_DisplayListDrawCPU(const void *list)
+{
+    ne_dl_cpu_draw(list);
+    ne_dl_forget_state();
 }
 
 typedef void (*ne_display_list_draw_fn)(const void *);
 
 static ne_display_list_draw_fn ne_display_list_draw = NEA_DisplayListDrawDMA_GFX_FIFO;
 
+// Internal use: pops the matrix stack after a display list. With the
+// asynchronous backend the command is added to the queue, so the CPU doesn't
+// need to wait for the previous list to be sent.
+void ne_display_list_matrix_pop(void)
+{
+    if (ne_display_list_draw == NEA_DisplayListDrawDMA_GFX_FIFO_Async)
+    {
+        ne_dl_async_send(&ne_dl_matrix_pop_list[1], 2);
+    }
+    else
+    {
+        ne_dl_stats_list(1);
+        MATRIX_POP = 1;
+    }
+}
+
 void NEA_DisplayListSetDefaultFunction(NEA_DisplayListDrawFunction type)
 {
+    // Make sure that no list is being sent before switching
+    NEA_DisplayListWait();
+
     if (type == NEA_DL_CPU)
     {
         ne_display_list_draw = NEA_DisplayListDrawCPU;
@@ -64,6 +297,10 @@ void NEA_DisplayListSetDefaultFunction(NEA_DisplayListDrawFunction type)
     {
         ne_display_list_draw = NEA_DisplayListDrawDMA_GFX_FIFO;
     }
+    else if (type == NEA_DL_DMA_GFX_FIFO_ASYNC)
+    {
+        ne_display_list_draw = NEA_DisplayListDrawDMA_GFX_FIFO_Async;
+    }
     else
     {
         NEA_Assert(0, "Invalid display list function type");
@@ -71,7 +308,214 @@ void NEA_DisplayListSetDefaultFunction(NEA_DisplayListDrawFunction type)
     }
 }
 
+// Internal use: draws a list of the engine with the default function. Unlike
+// the public functions, it doesn't forget the polygon format, because the lists
+// of the engine don't change it. See NEAModel.c
+void ne_display_list_draw_default(const void *list, bool flushed)
+{
+    if (ne_display_list_draw == NEA_DisplayListDrawDMA_GFX_FIFO)
+        ne_dl_dma_draw(list, !flushed);
+    else if (ne_display_list_draw == NEA_DisplayListDrawDMA_GFX_FIFO_Async)
+        ne_dl_async_draw(list, !flushed);
+    else
+        ne_dl_cpu_draw(list);
+}
+
 void NEA_DisplayListDrawDefault(const void *list)
 {
-    ne_display_list_draw(list);
+    ne_display_list_draw_default(list, false);
+    ne_dl_forget_state();
+}
+
+void NEA_DisplayListFlush(const void *list)
+{
+    const uint32_t *p = list;
+
+    NEA_AssertPointer(p, "NULL display list pointer");
+
+    uint32_t words = *p++;
+
+    DC_FlushRange(p, words * 4);
+}
+
+void NEA_DisplayListDrawDefaultFlushed(const void *list)
+{
+    ne_display_list_draw_default(list, true);
+    ne_dl_forget_state();
+}
+
+// Display list recorder
+// ---------------------
+//
+// While a recorder is active, the NEA_Poly functions call ne_dl_record()
+// instead of writing to the GX registers. Command IDs are packed 4 per word,
+// and their parameters are placed after the word that contains them.
+
+// Internal use: recorder that receives the NEA_Poly commands. See
+// NEAPolygon.h and NEAPolygon.c
+NEA_DisplayListRecorder *ne_dl_recorder = NULL;
+
+void ne_dl_record(uint32_t id, int num_params, uint32_t p0, uint32_t p1)
+{
+    NEA_DisplayListRecorder *rec = ne_dl_recorder;
+
+    // Skip the size word
+    uint32_t *list = rec->list[rec->front ^ 1] + 1;
+
+    size_t needed = num_params + ((rec->slot == 4) ? 1 : 0);
+
+    // Once a command doesn't fit the following ones are dropped too, so that
+    // the list isn't missing commands in the middle.
+    if (rec->overflow || (rec->words + needed > rec->capacity))
+    {
+        rec->overflow = true;
+        return;
+    }
+
+    if (rec->slot == 4)
+    {
+        rec->cmd = rec->words++;
+        list[rec->cmd] = 0;
+        rec->slot = 0;
+    }
+
+    list[rec->cmd] |= id << (rec->slot * 8);
+    rec->slot++;
+
+    if (num_params > 0)
+        list[rec->words++] = p0;
+    if (num_params > 1)
+        list[rec->words++] = p1;
+
+    // NEA_PolyFormat() doesn't update the state of the engine while recording,
+    // it's updated when the list is drawn.
+    if (id == FIFO_POLY_FORMAT)
+    {
+        rec->poly_format[rec->front ^ 1] = p0;
+        rec->has_poly_format[rec->front ^ 1] = true;
+    }
+}
+
+NEA_DisplayListRecorder *NEA_DisplayListRecorderCreate(size_t max_words,
+                                                       bool double_buffer)
+{
+    NEA_Assert(max_words > 0, "Invalid list size");
+
+    NEA_DisplayListRecorder *rec = calloc(1, sizeof(NEA_DisplayListRecorder));
+    if (rec == NULL)
+        goto error;
+
+    // The first word of each list is its size
+    rec->list[0] = calloc(max_words + 1, sizeof(uint32_t));
+    if (rec->list[0] == NULL)
+        goto error;
+
+    if (double_buffer)
+    {
+        rec->list[1] = calloc(max_words + 1, sizeof(uint32_t));
+        if (rec->list[1] == NULL)
+            goto error;
+    }
+    else
+    {
+        rec->list[1] = rec->list[0];
+    }
+
+    rec->capacity = max_words;
+
+    return rec;
+
+error:
+    NEA_DebugPrint("Not enough memory");
+    if (rec != NULL)
+    {
+        free(rec->list[0]);
+        free(rec);
+    }
+    return NULL;
+}
+
+void NEA_DisplayListRecorderDelete(NEA_DisplayListRecorder *rec)
+{
+    if (rec == NULL)
+        return;
+
+    if (ne_dl_recorder == rec)
+        ne_dl_recorder = NULL;
+
+    // The lists may still be in the queue of the asynchronous backend
+    NEA_DisplayListWait();
+
+    if (rec->list[1] != rec->list[0])
+        free(rec->list[1]);
+    free(rec->list[0]);
+    free(rec);
+}
+
+void NEA_DisplayListRecordBegin(NEA_DisplayListRecorder *rec)
+{
+    NEA_AssertPointer(rec, "NULL recorder pointer");
+    NEA_Assert(ne_dl_recorder == NULL, "Another recorder is recording");
+
+    // With one buffer, the list that is overwritten may still be in the queue
+    if (rec->list[1] == rec->list[0])
+        NEA_DisplayListWait();
+
+    rec->words = 0;
+    rec->slot = 4; // Start a new word of command IDs with the first command
+    rec->recording = true;
+    rec->overflow = false;
+    rec->has_poly_format[rec->front ^ 1] = false;
+
+    ne_dl_recorder = rec;
+}
+
+int NEA_DisplayListRecordEnd(NEA_DisplayListRecorder *rec)
+{
+    NEA_AssertPointer(rec, "NULL recorder pointer");
+    NEA_Assert(rec->recording, "The recorder isn't recording");
+
+    ne_dl_recorder = NULL;
+    rec->recording = false;
+
+    rec->front ^= 1;
+    rec->list[rec->front][0] = rec->words;
+
+    if (rec->overflow)
+    {
+        NEA_DebugPrint("Display list too small");
+        return 0;
+    }
+
+    return 1;
+}
+
+const void *NEA_DisplayListRecorderGet(const NEA_DisplayListRecorder *rec)
+{
+    NEA_AssertPointer(rec, "NULL recorder pointer");
+
+    const uint32_t *list = rec->list[rec->front];
+
+    if (list[0] == 0)
+        return NULL;
+
+    return list;
+}
+
+void NEA_DisplayListRecorderDraw(const NEA_DisplayListRecorder *rec)
+{
+    const void *list = NEA_DisplayListRecorderGet(rec);
+
+    if (list == NULL)
+        return;
+
+    ne_display_list_draw_default(list, false);
+
+    // The list only has NEA_Poly commands, so the polygon format is the only
+    // state that it may have changed.
+    if (rec->has_poly_format[rec->front])
+    {
+        ne_material_state_forget_poly_format();
+        ne_poly_format_last = rec->poly_format[rec->front];
+    }
 }
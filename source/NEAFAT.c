@@ -8,64 +8,651 @@
 
 /// @file NEAFAT.c
 
-char *NEA_FATLoadData(const char *filename)
+// Internal use... see NEAPack.c
+NEA_Pack *ne_pack_find_mounted(const char *path);
+
+static u32 ne_fat_stream_buffer[NEA_FAT_STREAM_BUFFER_SIZE / 4];
+
+// The file handle of a pack is shared by all its streams, so they need to move
+// the read position of the file before reading from it.
+static int ne_fat_stream_prepare(NEA_FATStream *stream)
 {
-    FILE *f = fopen(filename, "rb");
-    if (f == NULL)
+    if (!stream->shared)
+        return 1;
+
+    return fseek(stream->file, stream->offset + stream->position,
+                 SEEK_SET) == 0;
+}
+
+// Internal use... see NEAPack.c. Checks if the file of a stream is compressed
+// right after opening it. If it is, the size of the stream is set to the size
+// of the decompressed data.
+int ne_fat_stream_check_compression(NEA_FATStream *stream)
+{
+    stream->compression = 0;
+    stream->packed_size = 0;
+
+    if (stream->size < 8)
+        return 1;
+
+    u32 header[2];
+
+    if (!ne_fat_stream_prepare(stream) ||
+        (fread(header, 1, sizeof(header), stream->file) != sizeof(header)))
     {
-        NEA_DebugPrint("%s could't be opened", filename);
-        return NULL;
+        NEA_DebugPrint("Failed to read header");
+        return 0;
     }
 
-    if (fseek(f, 0, SEEK_END) != 0)
+    if (header[0] == NEA_FAT_COMPRESSED_MAGIC)
     {
-        NEA_DebugPrint("Failed to fseek: %s", filename);
-        fclose(f);
-        return NULL;
+        // The data read by the BIOS starts after the magic number
+        stream->offset += 4;
+        stream->packed_size = stream->size - 4;
+        stream->compression = header[1];
+        stream->size = header[1] >> 8;
+    }
+
+    if (fseek(stream->file, stream->offset, SEEK_SET) != 0)
+    {
+        NEA_DebugPrint("Failed to fseek");
+        return 0;
+    }
+
+    return 1;
+}
+
+// Source of compressed data used by the decompression callbacks. Data is read
+// from a stream through the bounce buffer, or from RAM if there is no stream.
+typedef struct {
+    NEA_FATStream *stream;
+    const u8 *mem;
+    size_t left;     // Bytes of the stream that haven't been buffered yet
+    size_t pos, len; // Position and amount of data in the buffer
+    bool error;
+} ne_fat_source_t;
+
+static u8 ne_fat_source_byte(u8 *source)
+{
+    ne_fat_source_t *src = (ne_fat_source_t *)source;
+
+    if (src->mem != NULL)
+        return *src->mem++;
+
+    if (src->pos == src->len)
+    {
+        size_t len = src->left;
+        if (len > NEA_FAT_STREAM_BUFFER_SIZE)
+            len = NEA_FAT_STREAM_BUFFER_SIZE;
+
+        if ((len == 0) ||
+            (fread(ne_fat_stream_buffer, 1, len, src->stream->file) != len))
+        {
+            // Let the decompression finish, the error is checked at the end
+            src->error = true;
+            return 0;
+        }
+
+        src->left -= len;
+        src->pos = 0;
+        src->len = len;
+    }
+
+    return ((u8 *)ne_fat_stream_buffer)[src->pos++];
+}
+
+static u32 ne_fat_source_word(ne_fat_source_t *src)
+{
+    u32 value = ne_fat_source_byte((u8 *)src);
+    value |= ne_fat_source_byte((u8 *)src) << 8;
+    value |= ne_fat_source_byte((u8 *)src) << 16;
+    value |= ne_fat_source_byte((u8 *)src) << 24;
+    return value;
+}
+
+static int ne_fat_source_header(u8 *source, u16 *dest, u32 arg)
+{
+    (void)dest;
+    (void)arg;
+
+    return ne_fat_source_word((ne_fat_source_t *)source);
+}
+
+static int ne_fat_source_result(u8 *source)
+{
+    ne_fat_source_t *src = (ne_fat_source_t *)source;
+
+    return src->error ? -1 : 0;
+}
+
+static TDecompressionStream ne_fat_decompression_stream = {
+    ne_fat_source_header,
+    ne_fat_source_result,
+    ne_fat_source_byte
+};
+
+// The BIOS of the DS needs a callback to read 32-bit words to decompress
+// Huffman data from a stream, which libnds doesn't support, so it's done here.
+// All writes are 32-bit, so the destination can be VRAM.
+static void ne_fat_decompress_huffman(ne_fat_source_t *src, u32 header,
+                                      u32 *dst)
+{
+    unsigned int bits = header & 0xF;
+    size_t size = header >> 8;
+
+    // The first byte of the table is its size, the root node goes after it
+    u8 tree[512];
+    tree[0] = ne_fat_source_byte((u8 *)src);
+    size_t tree_size = (tree[0] + 1) * 2;
+    for (size_t i = 1; i < tree_size; i++)
+        tree[i] = ne_fat_source_byte((u8 *)src);
+
+    if ((bits != 4) && (bits != 8))
+    {
+        NEA_DebugPrint("Invalid Huffman data size: %u", bits);
+        src->error = true;
+        return;
+    }
+
+    size_t node = 1;
+    u32 out = 0;
+    unsigned int out_bits = 0;
+
+    while (size > 0)
+    {
+        u32 word = ne_fat_source_word(src);
+        if (src->error)
+            return;
+
+        for (int i = 31; i >= 0; i--)
+        {
+            unsigned int bit = (word >> i) & 1;
+            u8 value = tree[node];
+            size_t next = (node & ~1) + (value & 0x3F) * 2 + 2 + bit;
+
+            if (next >= tree_size)
+            {
+                NEA_DebugPrint("Invalid Huffman tree");
+                src->error = true;
+                return;
+            }
+
+            // Bit 7 is the end flag of child 0, bit 6 is the one of child 1
+            if ((value << bit) & 0x80)
+            {
+                out |= (u32)tree[next] << out_bits;
+                out_bits += bits;
+                node = 1;
+
+                // The last word may be incomplete if the size isn't a
+                // multiple of 4 bytes.
+                if ((out_bits == 32) || (out_bits >= size * 8))
+                {
+                    *dst++ = out;
+                    out = 0;
+                    out_bits = 0;
+
+                    if (size <= 4)
+                        return;
+                    size -= 4;
+                }
+            }
+            else
+            {
+                node = next;
+            }
+        }
+    }
+}
+
+// Decompresses data with the BIOS header provided. The header must have been
+// read already. Returns 1 on success, 0 on error.
+static int ne_fat_decompress(ne_fat_source_t *src, u32 header, void *dst)
+{
+    NEA_Assert(((uintptr_t)dst & 3) == 0, "Unaligned destination");
+
+    switch ((header >> 4) & 0xF)
+    {
+        case 1: // LZ77
+            swiDecompressLZSSVram(src, dst, header, &ne_fat_decompression_stream);
+            break;
+        case 2: // Huffman
+            ne_fat_decompress_huffman(src, header, dst);
+            break;
+        case 3: // RLE
+            swiDecompressRLEVram(src, dst, header, &ne_fat_decompression_stream);
+            break;
+        default:
+            NEA_DebugPrint("Unknown compression type: 0x%X", header & 0xFF);
+            return 0;
+    }
+
+    if (src->error)
+    {
+        NEA_DebugPrint("Failed to decompress data");
+        return 0;
+    }
+
+    return 1;
+}
+
+// Decompresses the whole file of a stream to its destination
+static int ne_fat_stream_decompress(NEA_FATStream *stream, void *dst)
+{
+    if (stream->position != 0)
+    {
+        NEA_DebugPrint("Compressed files must be read at once");
+        return 0;
     }
 
-    size_t size = ftell(f);
-    rewind(f);
+    if (fseek(stream->file, stream->offset, SEEK_SET) != 0)
+    {
+        NEA_DebugPrint("Failed to fseek");
+        return 0;
+    }
 
-    char *buffer = malloc(size);
+    ne_fat_source_t src = {
+        .stream = stream,
+        .left = stream->packed_size,
+    };
+
+    u32 header;
+    if (((stream->compression >> 4) & 0xF) == 2)
+    {
+        // The Huffman decoder reads the header by itself
+        header = ne_fat_source_word(&src);
+    }
+    else
+    {
+        // The BIOS reads the header with the header callback
+        header = stream->compression;
+    }
+
+    if (!ne_fat_decompress(&src, header, dst))
+        return 0;
+
+    stream->position = stream->size;
+
+    return 1;
+}
+
+size_t NEA_FATDecompressedSize(const void *data)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    const u32 *header = data;
+
+    if (header[0] != NEA_FAT_COMPRESSED_MAGIC)
+        return 0;
+
+    return header[1] >> 8;
+}
+
+int NEA_FATDecompress(const void *data, void *dst)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+    NEA_AssertPointer(dst, "NULL destination pointer");
+
+    const u32 *header = data;
+
+    if (header[0] != NEA_FAT_COMPRESSED_MAGIC)
+    {
+        NEA_DebugPrint("Data isn't compressed");
+        return 0;
+    }
+
+    ne_fat_source_t src = {
+        .mem = (const u8 *)&header[1],
+    };
+
+    u32 bios_header = header[1];
+    if (((bios_header >> 4) & 0xF) == 2)
+        src.mem += 4;
+
+    return ne_fat_decompress(&src, bios_header, dst);
+}
+
+// Internal use... see NEAArena.c
+void *ne_arena_temp_alloc(size_t size);
+void ne_arena_temp_free(void *ptr);
+
+// Loads the whole file of a stream to a new buffer and closes the stream. The
+// buffer is a temporary buffer of the arena code if requested.
+static char *ne_fat_stream_load_common(NEA_FATStream *stream, bool temp)
+{
+    // Compressed data is written in 16-bit or 32-bit units
+    size_t size = (stream->size + 3) & ~3;
+    char *buffer = temp ? ne_arena_temp_alloc(size) : malloc(size);
     if (buffer == NULL)
     {
-        NEA_DebugPrint("Not enought memory to load %s", filename);
-        fclose(f);
+        NEA_DebugPrint("Not enough memory to load file");
+        NEA_FATStreamClose(stream);
         return NULL;
     }
 
-    if (fread(buffer, 1, size, f) != size)
+    if (NEA_FATStreamRead(stream, buffer, stream->size) != stream->size)
     {
-        NEA_DebugPrint("Failed to read data of %s", filename);
-        fclose(f);
+        NEA_DebugPrint("Failed to read data of file");
+        if (temp)
+            ne_arena_temp_free(buffer);
+        else
+            free(buffer);
+        NEA_FATStreamClose(stream);
         return NULL;
     }
 
-    fclose(f);
+    NEA_FATStreamClose(stream);
     return buffer;
 }
 
+// Internal use... see NEAPack.c
+char *ne_fat_stream_load(NEA_FATStream *stream)
+{
+    return ne_fat_stream_load_common(stream, false);
+}
+
+char *NEA_FATLoadData(const char *filename)
+{
+    NEA_FATStream *stream = NEA_FATStreamOpen(filename);
+    if (stream == NULL)
+        return NULL;
+
+    return ne_fat_stream_load(stream);
+}
+
+// Internal use... Like NEA_FATLoadData(), but the file is only needed until
+// the caller returns, so it's loaded to the frame arena if there is space. It
+// must be freed with ne_arena_temp_free().
+char *ne_fat_load_data_temp(const char *filename)
+{
+    NEA_FATStream *stream = NEA_FATStreamOpen(filename);
+    if (stream == NULL)
+        return NULL;
+
+    return ne_fat_stream_load_common(stream, true);
+}
+
 size_t NEA_FATFileSize(const char *filename)
 {
-    FILE *f = fopen(filename, "rb");
-    if (f == NULL)
+    NEA_FATStream *stream = NEA_FATStreamOpen(filename);
+    if (stream == NULL)
+        return -1;
+
+    size_t size = stream->size;
+    NEA_FATStreamClose(stream);
+    return size;
+}
+
+NEA_FATStream *NEA_FATStreamOpen(const char *filename)
+{
+    NEA_AssertPointer(filename, "NULL filename pointer");
+
+    NEA_Pack *pack = ne_pack_find_mounted(filename);
+    if (pack != NULL)
+        return NEA_PackStreamOpen(pack, filename);
+
+    NEA_FATStream *stream = malloc(sizeof(NEA_FATStream));
+    if (stream == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    stream->file = fopen(filename, "rb");
+    if (stream->file == NULL)
     {
         NEA_DebugPrint("%s could't be opened", filename);
-        return -1;
+        free(stream);
+        return NULL;
     }
 
-    if (fseek(f, 0, SEEK_END) != 0)
+    if (fseek(stream->file, 0, SEEK_END) != 0)
     {
         NEA_DebugPrint("Failed to fseek: %s", filename);
-        fclose(f);
-        return -1;
+        fclose(stream->file);
+        free(stream);
+        return NULL;
     }
 
-    size_t size = ftell(f);
-    fclose(f);
-    return size;
+    stream->size = ftell(stream->file);
+    stream->offset = 0;
+    stream->position = 0;
+    stream->shared = false;
+    rewind(stream->file);
+
+    if (!ne_fat_stream_check_compression(stream))
+    {
+        fclose(stream->file);
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+void NEA_FATStreamClose(NEA_FATStream *stream)
+{
+    NEA_AssertPointer(stream, "NULL pointer");
+
+    if (!stream->shared)
+        fclose(stream->file);
+    free(stream);
+}
+
+int NEA_FATStreamSeek(NEA_FATStream *stream, size_t offset)
+{
+    NEA_AssertPointer(stream, "NULL pointer");
+
+    if (offset > stream->size)
+    {
+        NEA_DebugPrint("Offset outside of the file");
+        return 0;
+    }
+
+    if (stream->compression != 0)
+    {
+        // Compressed files can only be read from the start
+        if (offset != 0)
+        {
+            NEA_DebugPrint("Can't seek in compressed files");
+            return 0;
+        }
+
+        stream->position = 0;
+        return 1;
+    }
+
+    if (fseek(stream->file, stream->offset + offset, SEEK_SET) != 0)
+    {
+        NEA_DebugPrint("Failed to fseek");
+        return 0;
+    }
+
+    stream->position = offset;
+
+    return 1;
+}
+
+size_t NEA_FATStreamRead(NEA_FATStream *stream, void *dst, size_t size)
+{
+    NEA_AssertPointer(stream, "NULL stream pointer");
+    NEA_AssertPointer(dst, "NULL destination pointer");
+
+    if (stream->compression != 0)
+    {
+        if (size < stream->size)
+        {
+            NEA_DebugPrint("Compressed files must be read at once");
+            return 0;
+        }
+
+        if (!ne_fat_stream_decompress(stream, dst))
+            return 0;
+
+        return stream->size;
+    }
+
+    if (size > stream->size - stream->position)
+        size = stream->size - stream->position;
+
+    if (!ne_fat_stream_prepare(stream))
+        return 0;
+
+    size_t ret = fread(dst, 1, size, stream->file);
+    stream->position += ret;
+
+    return ret;
+}
+
+// Maps the texture banks as LCD memory if the copy has to do it by itself
+static u32 ne_fat_vram_unlock(bool unlock)
+{
+    if (!unlock)
+        return 0;
+
+    return vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD, VRAM_D_LCD);
+}
+
+static void ne_fat_vram_lock(bool unlock, u32 saved)
+{
+    if (unlock)
+        vramRestorePrimaryBanks(saved);
+}
+
+// Internal use... see NEATexture.c. Like NEA_FATStreamReadVRAM(), but all words
+// are ORed with the provided mask before writing them to VRAM. If unlock is
+// true, the destination is a texture bank that hasn't been mapped as LCD
+// memory. The banks are only mapped while each chunk is copied, so the GPU can
+// keep reading textures while the file is read.
+int ne_fat_stream_read_vram(NEA_FATStream *stream, void *dst, size_t size,
+                            u32 or_mask, bool unlock)
+{
+    NEA_AssertPointer(stream, "NULL stream pointer");
+    NEA_AssertPointer(dst, "NULL destination pointer");
+    NEA_Assert((((uintptr_t)dst | size) & 3) == 0, "Unaligned copy");
+
+    if (size > stream->size - stream->position)
+    {
+        NEA_DebugPrint("Not enough data in file");
+        return 0;
+    }
+
+    u32 *dest = dst;
+
+    if (stream->compression != 0)
+    {
+        // The whole file is decompressed, so it can't be bigger than the
+        // destination.
+        if (size != stream->size)
+        {
+            NEA_DebugPrint("Compressed files must be read at once");
+            return 0;
+        }
+
+        // Decompress to RAM first if the banks can't stay mapped as LCD
+        // memory while the file is read.
+        u32 *src = dest;
+        if (unlock)
+        {
+            src = malloc(size);
+            if (src == NULL)
+            {
+                NEA_DebugPrint("Not enough memory to decompress");
+                return 0;
+            }
+        }
+
+        if (!ne_fat_stream_decompress(stream, src))
+        {
+            if (unlock)
+                free(src);
+            return 0;
+        }
+
+        u32 saved = ne_fat_vram_unlock(unlock);
+
+        if (or_mask != 0)
+        {
+            for (size_t i = 0; i < size / 4; i++)
+                dest[i] = src[i] | or_mask;
+        }
+        else if (src != dest)
+        {
+            swiCopy(src, dest, (size >> 2) | COPY_MODE_WORD);
+        }
+
+        ne_fat_vram_lock(unlock, saved);
+
+        if (unlock)
+            free(src);
+
+        return 1;
+    }
+
+    if (!ne_fat_stream_prepare(stream))
+    {
+        NEA_DebugPrint("Failed to fseek");
+        return 0;
+    }
+
+    while (size > 0)
+    {
+        size_t len = size;
+        if (len > NEA_FAT_STREAM_BUFFER_SIZE)
+            len = NEA_FAT_STREAM_BUFFER_SIZE;
+
+        if (fread(ne_fat_stream_buffer, 1, len, stream->file) != len)
+        {
+            NEA_DebugPrint("Failed to read data");
+            return 0;
+        }
+
+        stream->position += len;
+
+        u32 saved = ne_fat_vram_unlock(unlock);
+
+        if (or_mask != 0)
+        {
+            for (size_t i = 0; i < len / 4; i++)
+                *dest++ = ne_fat_stream_buffer[i] | or_mask;
+        }
+        else
+        {
+            swiCopy(ne_fat_stream_buffer, dest, (len >> 2) | COPY_MODE_WORD);
+            dest += len / 4;
+        }
+
+        ne_fat_vram_lock(unlock, saved);
+
+        size -= len;
+    }
+
+    return 1;
+}
+
+int NEA_FATStreamReadVRAM(NEA_FATStream *stream, void *dst, size_t size)
+{
+    return ne_fat_stream_read_vram(stream, dst, size, 0, false);
+}
+
+#ifdef NEA_BLOCKSDS
+// Internal use... see NEATexture.c and NEARichText.c. libnds opens GRF files by
+// itself, so they are loaded with NEA_FATLoadData() to support packs and
+// compressed files.
+GRFError ne_fat_grf_load_path(const char *path, GRFHeader *header,
+                              void **gfx, void **pal, size_t *pal_size)
+{
+    void *data = ne_fat_load_data_temp(path);
+    if (data == NULL)
+        return GRF_FILE_NOT_OPENED;
+
+    GRFError err = grfLoadMem(data, header, gfx, NULL, NULL, NULL, pal,
+                              pal_size);
+    ne_arena_temp_free(data);
+
+    return err;
 }
+#endif // NEA_BLOCKSDS
 
 static void NEA_write16(u16 *address, u16 value)
 {
@@ -8,18 +8,40 @@
 
 /// @file NEAFormats.c
 
-static int lastx = 0, lasty = 0;
-static u32 numcolors = 0;
-
-static void *NEA_ConvertBMPtoRGBA(void *pointer, bool transpcolor)
+// Internal use... see NEAFAT.c and NEAArena.c. The files are only needed until
+// they are converted.
+char *ne_fat_load_data_temp(const char *filename);
+void ne_arena_temp_free(void *ptr);
+
+// Internal use... see NEATexture.c
+int ne_material_tex_load_rows(NEA_Material *tex, NEA_TextureFormat fmt,
+                              int sizeX, int sizeY, NEA_TextureFlags flags,
+                              void (*write_row)(u16 *dst, int y, void *arg),
+                              void *arg);
+
+// BMP files are decoded one row at a time, straight into the VRAM of the
+// texture, so they don't need a temporary buffer for the converted image.
+typedef struct {
+    const u8 *data;  // First row in the file (the bottom row of the image)
+    int sizex;
+    int sizey;
+    int bits;
+    size_t stride;   // Size of a row in the file, including padding
+    bool transpcolor;
+    u16 transcolor;  // Transparent color of 16 bit BMPs
+    u8 transr, transg, transb; // Transparent color of 24 bit BMPs
+} ne_bmp_stream;
+
+static int ne_bmp_stream_open(ne_bmp_stream *bmp, const void *pointer)
 {
-    NEA_BMPHeader *header = pointer;
-    NEA_BMPInfoHeader *infoheader = (void *)(u8 *)header + sizeof(NEA_BMPHeader);
-    u8 *IMAGEDATA = (void *)((u8 *)infoheader + sizeof(NEA_BMPInfoHeader));
+    const NEA_BMPHeader *header = pointer;
+    const NEA_BMPInfoHeader *infoheader =
+            (const void *)((const u8 *)header + sizeof(NEA_BMPHeader));
+
     if (header->type != 0x4D42)
     {
         NEA_DebugPrint("Not a BMP file");
-        return NULL;
+        return 0;
     }
 
     int sizex = infoheader->width;
@@ -27,257 +49,93 @@ static void *NEA_ConvertBMPtoRGBA(void *pointer, bool transpcolor)
     if (sizex > 1024 || sizey > 1024)
     {
         NEA_DebugPrint("BMP file too big (%d, %d)", sizex, sizey);
-        return NULL;
+        return 0;
     }
 
     if (infoheader->compression != 0)
     {
         NEA_DebugPrint("Compressed BMP not supported");
-        return NULL;
-    }
-
-    if (infoheader->bits != 16 && infoheader->bits != 24)
-    {
-        NEA_DebugPrint("Unsuported depth for NEA_A1RGB5 conversion (%d)",
-                      infoheader->bits);
-        return NULL;
+        return 0;
     }
 
-    // Decode
-    u16 *buffer = malloc(2 * sizex * sizey);
-    NEA_AssertPointer(buffer, "Couldn't allocate temporary buffer");
+    bmp->sizex = sizex;
+    bmp->sizey = sizey;
+    bmp->bits = infoheader->bits;
 
-    u8 transr = 0, transb = 0, transg = 0;
-    u16 transcolor16bit = 0;
+    // Rows are padded to a multiple of 4 bytes
+    bmp->stride = ((sizex * bmp->bits + 31) >> 5) << 2;
 
-    if (transpcolor)
-    {
-        if (infoheader->bits == 16) // X1RGB5
-        {
-            u16 red, green, blue;
-            transcolor16bit = (u16)IMAGEDATA[2 * sizey * (sizex - 1)]
-                            | (((u16)IMAGEDATA[2 * sizey * (sizex - 1) + 1]) << 8);
+    return 1;
+}
 
-            // Swap R and B channels
-            red = (transcolor16bit & 0x7C00) >> 10;
-            green = (transcolor16bit & 0x3E0);
-            blue = (transcolor16bit & 0x1F);
-            transcolor16bit = red | green | (blue << 10);
-        }
-        else // 24 bits
-        {
-            transr = IMAGEDATA[3 * sizey * (sizex - 1) + 2];
-            transg = IMAGEDATA[3 * sizey * (sizex - 1) + 1];
-            transb = IMAGEDATA[3 * sizey * (sizex - 1) + 0];
-        }
-    }
-    // IMAGEDATA -> buffer
+static const u8 *ne_bmp_stream_row(const ne_bmp_stream *bmp, int y)
+{
+    // Rows are stored from the bottom to the top of the image
+    return bmp->data + bmp->stride * (bmp->sizey - y - 1);
+}
 
-    int disalign = ((sizex * infoheader->bits) >> 3) & 3;
-    if (disalign)
-        disalign = 4 - disalign;
+static void ne_bmp_write_row_rgba(u16 *dst, int y, void *arg)
+{
+    const ne_bmp_stream *bmp = arg;
+    const u8 *src = ne_bmp_stream_row(bmp, y);
 
-    if (infoheader->bits == 16) // X1RGB5
+    if (bmp->bits == 16) // X1RGB5
     {
-        for (int y = 0; y < sizey; y++)
+        for (int x = 0; x < bmp->sizex; x++, src += 2)
         {
-            for (int x = 0; x < sizex; x++)
-            {
-                u16 red, green, blue;
-
-                int base_pos = (sizex * (sizey - y - 1) + x) << 1;
-
-                if (disalign)
-                    base_pos += disalign * (sizey - y - 1);
-
-                u16 color = (u16) IMAGEDATA[base_pos]
-                          | ((u16)IMAGEDATA[base_pos + 1] << 8);
-
-                // Swap R and B channels
-                red = (color & 0x7C00) >> 10;
-                green = (color & 0x3E0);
-                blue = (color & 0x1F);
-                color = red | green | (blue << 10);
+            u16 color = (u16)src[0] | ((u16)src[1] << 8);
 
-                if (!(transpcolor && color == transcolor16bit))
-                    buffer[y * sizex + x] = color | BIT(15);
-                else
-                    buffer[y * sizex + x] = 0;
-            }
+            // Swap R and B channels
+            u16 red = (color & 0x7C00) >> 10;
+            u16 green = (color & 0x3E0);
+            u16 blue = (color & 0x1F);
+            color = red | green | (blue << 10);
+
+            if (!(bmp->transpcolor && color == bmp->transcolor))
+                dst[x] = color | BIT(15);
+            else
+                dst[x] = 0;
         }
     }
     else // 24 bits
     {
-        for (int y = 0; y < sizey; y++)
+        for (int x = 0; x < bmp->sizex; x++, src += 3)
         {
-            for (int x = 0; x < sizex; x++)
+            u8 r = src[2];
+            u8 g = src[1];
+            u8 b = src[0];
+
+            if (!(bmp->transpcolor && r == bmp->transr && g == bmp->transg &&
+                  b == bmp->transb))
+            {
+                dst[x] = RGB15((r >> 3) & 31, (g >> 3) & 31, (b >> 3) & 31)
+                       | BIT(15);
+            }
+            else
             {
-                u8 r, g, b;
-
-                int base_pos = 3 * (sizex * (sizey - y - 1) + x);
-
-                if (disalign)
-                    base_pos += disalign * (sizey - y - 1);
-
-                r = IMAGEDATA[base_pos + 2];
-                g = IMAGEDATA[base_pos + 1];
-                b = IMAGEDATA[base_pos + 0];
-
-                if (!(transpcolor && r == transr && g == transg && b == transb))
-                {
-                    buffer[y * sizex + x] = RGB15((r >> 3) & 31, (g >> 3) & 31,
-                                                  (b >> 3) & 31) | BIT(15);
-                }
-                else
-                {
-                    buffer[y * sizex + x] = 0;
-                }
+                dst[x] = 0;
             }
         }
     }
-
-    lasty = sizey;
-    lastx = sizex;
-
-    return (void *)buffer;
 }
 
-static void *NEA_ConvertBMPtoRGB256(void *pointer, u16 *palettebuffer)
+static void ne_bmp_write_row_rgb256(u16 *dst, int y, void *arg)
 {
-    NEA_BMPHeader *header = pointer;
-    NEA_BMPInfoHeader *infoheader = (void *)((u8 *)header + sizeof(NEA_BMPHeader));
-    if (header->type != 0x4D42)
-    {
-        NEA_DebugPrint("Not a BMP file");
-        return NULL;
-    }
-
-    int sizex = infoheader->width;
-    int sizey = infoheader->height;
-    if (sizex > 1024 || sizey > 1024)
-    {
-        NEA_DebugPrint("BMP file too big (%d, %d)", sizex, sizey);
-        return NULL;
-    }
-
-    if (infoheader->compression != 0)
-    {
-        NEA_DebugPrint("Compressed BMP not supported");
-        return NULL;
-    }
-
-    if (infoheader->bits != 8 && infoheader->bits != 4)
-    {
-        NEA_DebugPrint("Unsupported depth for NEA_PAL256 conversion (%d)",
-                      infoheader->bits);
-        return NULL;
-    }
-
-    // Decode
-    int colornumber = (infoheader->bits == 8) ? 256 : 16;
-    u8 *PALETTEDATA = (u8 *)infoheader + sizeof(NEA_BMPInfoHeader);
-    u8 *IMAGEDATA = (u8 *)header + header->offset;
+    const ne_bmp_stream *bmp = arg;
+    const u8 *src = ne_bmp_stream_row(bmp, y);
 
-    // numcolors is used by the other functions (look at the start of this
-    // file)
-    numcolors = colornumber;
-
-    // First, we read the palette
-    int i = 0;
-    while (i < numcolors)
+    // Two pixels are written at a time because VRAM doesn't support 8 bit
+    // writes. The width of a texture is always even.
+    if (bmp->bits == 8)
     {
-        u8 r, g, b;
-        g = PALETTEDATA[(i << 2) + 1] & 0xFF;
-        r = PALETTEDATA[(i << 2) + 2] & 0xFF;
-        b = PALETTEDATA[(i << 2) + 0] & 0xFF;
-        palettebuffer[i] = RGB15(r >> 3, g >> 3, b >> 3);
-        i++;
+        for (int x = 0; x < bmp->sizex; x += 2, src += 2)
+            *dst++ = src[0] | (src[1] << 8);
     }
-
-    u8 *buffer = malloc(sizex * sizey);
-    NEA_AssertPointer(buffer, "Couldn't allocate temporary buffer");
-
-    // Then, the image
-    if (colornumber == 256)
+    else // 4 bits, the first pixel is in the top half of the byte
     {
-        // For BMPs with width not multiple of 4
-        int disalign = sizex & 3;
-
-        if (disalign)
-        {
-            disalign = 4 - disalign;
-
-            for (int y = 0; y < sizey; y++)
-            {
-                for (int x = 0; x < sizex; x++)
-                {
-                    buffer[y * sizex + x] = IMAGEDATA[(sizex * (sizey - y - 1)) + x
-                                          + (((disalign) * (sizey - y - 1)) * 1)];
-                }
-            }
-        }
-        else
-        {
-            for (int y = 0; y < sizey; y++)
-            {
-                for (int x = 0; x < sizex; x++)
-                {
-                    buffer[y * sizex + x] =
-                        IMAGEDATA[(sizex * (sizey - y - 1)) + x];
-                }
-            }
-        }
+        for (int x = 0; x < bmp->sizex; x += 2, src++)
+            *dst++ = (src[0] >> 4) | ((src[0] & 0x0F) << 8);
     }
-    else // colornumber == 16
-    {
-        // For BMPs with width not multiple of 8
-        int disalign = sizex & 7;
-
-        if (disalign)
-        {
-            disalign = 8 - disalign;
-
-            for (int y = 0; y < sizey; y++)
-            {
-                for (int x = 0; x < sizex; x++)
-                {
-                    u32 value;
-                    u32 srcidx = ((sizex * (sizey - y - 1) + x)
-                               + (disalign * (sizey - y - 1))) >> 1;
-
-                    if (x & 1)
-                        value = IMAGEDATA[srcidx] & 0x0F;
-                    else
-                        value = (IMAGEDATA[srcidx] >> 4) & 0x0F;
-
-                    buffer[y * sizex + x] = value;
-                }
-            }
-        }
-        else
-        {
-            for (int y = 0; y < sizey; y++)
-            {
-                for (int x = 0; x < sizex; x++)
-                {
-                    u32 value;
-                    u32 srcidx = (sizex * (sizey - y - 1) + x) >> 1;
-
-                    if (x & 1)
-                        value = IMAGEDATA[srcidx] & 0x0F;
-                    else
-                        value = (IMAGEDATA[srcidx] >> 4) & 0x0F;
-
-                    buffer[y * sizex + x] = value;
-                }
-            }
-        }
-    }
-
-    lastx = sizex;
-    lasty = sizey;
-
-    return (void *)buffer;
 }
 
 int NEA_FATMaterialTexLoadBMPtoRGBA(NEA_Material *tex, char *filename,
@@ -286,9 +144,9 @@ int NEA_FATMaterialTexLoadBMPtoRGBA(NEA_Material *tex, char *filename,
     NEA_AssertPointer(tex, "NULL material pointer");
     NEA_AssertPointer(filename, "NULL filename pointer");
 
-    void *pointer = NEA_FATLoadData(filename);
+    void *pointer = ne_fat_load_data_temp(filename);
     int ret = NEA_MaterialTexLoadBMPtoRGBA(tex, pointer, transpcolor);
-    free(pointer);
+    ne_arena_temp_free(pointer);
 
     return ret;
 }
@@ -300,9 +158,9 @@ int NEA_FATMaterialTexLoadBMPtoRGB256(NEA_Material *tex, NEA_Palette *pal,
     NEA_AssertPointer(pal, "NULL palette pointer");
     NEA_AssertPointer(filename, "NULL filename pointer");
 
-    char *pointer = NEA_FATLoadData(filename);
+    char *pointer = ne_fat_load_data_temp(filename);
     int ret = NEA_MaterialTexLoadBMPtoRGB256(tex, pal, pointer, transpcolor);
-    free(pointer);
+    ne_arena_temp_free(pointer);
 
     return ret;
 }
@@ -313,18 +171,48 @@ int NEA_MaterialTexLoadBMPtoRGBA(NEA_Material *tex, void *pointer,
     NEA_AssertPointer(tex, "NULL material pointer");
     NEA_AssertPointer(pointer, "NULL data pointer");
 
-    void *temp = NEA_ConvertBMPtoRGBA(pointer, transpcolor);
-    if (temp == NULL)
+    ne_bmp_stream bmp;
+    if (ne_bmp_stream_open(&bmp, pointer) == 0)
         return 0;
 
-    int ret = NEA_MaterialTexLoad(tex, NEA_A1RGB5, lastx, lasty,
-                                 NEA_TEXGEN_TEXCOORD, (u8 *)temp);
-    free(temp);
-
-    if (ret == 0)
+    if (bmp.bits != 16 && bmp.bits != 24)
+    {
+        NEA_DebugPrint("Unsuported depth for NEA_A1RGB5 conversion (%d)",
+                       bmp.bits);
         return 0;
+    }
 
-    return 1;
+    bmp.data = (u8 *)pointer + sizeof(NEA_BMPHeader)
+             + sizeof(NEA_BMPInfoHeader);
+    bmp.transpcolor = transpcolor;
+
+    if (transpcolor)
+    {
+        int sizex = bmp.sizex;
+        int sizey = bmp.sizey;
+
+        if (bmp.bits == 16) // X1RGB5
+        {
+            u16 color = (u16)bmp.data[2 * sizey * (sizex - 1)]
+                      | (((u16)bmp.data[2 * sizey * (sizex - 1) + 1]) << 8);
+
+            // Swap R and B channels
+            u16 red = (color & 0x7C00) >> 10;
+            u16 green = (color & 0x3E0);
+            u16 blue = (color & 0x1F);
+            bmp.transcolor = red | green | (blue << 10);
+        }
+        else // 24 bits
+        {
+            bmp.transr = bmp.data[3 * sizey * (sizex - 1) + 2];
+            bmp.transg = bmp.data[3 * sizey * (sizex - 1) + 1];
+            bmp.transb = bmp.data[3 * sizey * (sizex - 1) + 0];
+        }
+    }
+
+    return ne_material_tex_load_rows(tex, NEA_A1RGB5, bmp.sizex, bmp.sizey,
+                                     NEA_TEXGEN_TEXCOORD,
+                                     ne_bmp_write_row_rgba, &bmp);
 }
 
 int NEA_MaterialTexLoadBMPtoRGB256(NEA_Material *tex, NEA_Palette *pal,
@@ -334,35 +222,46 @@ int NEA_MaterialTexLoadBMPtoRGB256(NEA_Material *tex, NEA_Palette *pal,
     NEA_AssertPointer(pal, "NULL palette pointer");
     NEA_AssertPointer(pointer, "NULL data pointer");
 
-    u16 *palettebuffer = malloc(256 * sizeof(u16));
-    NEA_AssertPointer(palettebuffer, "Couldn't allocate temp palette buffer");
-    if (palettebuffer == NULL)
+    ne_bmp_stream bmp;
+    if (ne_bmp_stream_open(&bmp, pointer) == 0)
         return 0;
 
-    void *texturepointer = NEA_ConvertBMPtoRGB256(pointer, palettebuffer);
-    NEA_AssertPointer(texturepointer, "Couldn't convert BMP file to NEA_PAL256");
-    if (texturepointer == NULL)
+    if (bmp.bits != 8 && bmp.bits != 4)
     {
-        free(palettebuffer);
+        NEA_DebugPrint("Unsupported depth for NEA_PAL256 conversion (%d)",
+                       bmp.bits);
         return 0;
     }
 
-    u32 transp = transpcolor ? NEA_TEXTURE_COLOR0_TRANSPARENT : 0;
+    NEA_BMPHeader *header = pointer;
+    bmp.data = (u8 *)header + header->offset;
 
-    int ret = NEA_MaterialTexLoad(tex, NEA_PAL256, lastx, lasty,
-                                 NEA_TEXGEN_TEXCOORD | transp,
-                                 (u8 *)texturepointer);
-    free(texturepointer);
+    u32 transp = transpcolor ? NEA_TEXTURE_COLOR0_TRANSPARENT : 0;
 
+    int ret = ne_material_tex_load_rows(tex, NEA_PAL256, bmp.sizex, bmp.sizey,
+                                        NEA_TEXGEN_TEXCOORD | transp,
+                                        ne_bmp_write_row_rgb256, &bmp);
     if (ret == 0)
     {
         NEA_DebugPrint("Error while loading texture");
-        free(palettebuffer);
         return 0;
     }
-    ret = NEA_PaletteLoad(pal, palettebuffer, numcolors, NEA_PAL256);
-    free(palettebuffer);
 
+    // The palette goes after the info header
+    const u8 *PALETTEDATA = (u8 *)pointer + sizeof(NEA_BMPHeader)
+                          + sizeof(NEA_BMPInfoHeader);
+    int numcolors = (bmp.bits == 8) ? 256 : 16;
+
+    u16 palettebuffer[256];
+    for (int i = 0; i < numcolors; i++)
+    {
+        u8 r = PALETTEDATA[(i << 2) + 2];
+        u8 g = PALETTEDATA[(i << 2) + 1];
+        u8 b = PALETTEDATA[(i << 2) + 0];
+        palettebuffer[i] = RGB15(r >> 3, g >> 3, b >> 3);
+    }
+
+    ret = NEA_PaletteLoad(pal, palettebuffer, numcolors, NEA_PAL256);
     if (ret == 0)
     {
         NEA_DebugPrint("Error while loading palette");
@@ -5,15 +5,96 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAPool.h"
 
 /// @file NEAGUI.c
 
 extern NEA_Input ne_input;
 
-static NEA_GUIObj **NEA_guipointers;
+static ne_pool_t ne_gui_pool;
 static int NEA_GUI_OBJECTS;
 static bool ne_gui_system_inited = false;
 
+// True if the last update didn't find any touch input or pressed object, so
+// the next update can be skipped if there is still no touch input.
+static bool ne_gui_idle = false;
+
+// True if the draw list has to be built again
+static bool ne_gui_dirty = true;
+
+// Coarse grid of the screen used to find the objects under the stylus. Each
+// cell has the slots of the objects that overlap it.
+#define NE_GUI_GRID_SHIFT 5 // Cells of 32x32 pixels
+#define NE_GUI_GRID_W     (256 >> NE_GUI_GRID_SHIFT)
+#define NE_GUI_GRID_H     (192 >> NE_GUI_GRID_SHIFT)
+#define NE_GUI_GRID_CELLS (NE_GUI_GRID_W * NE_GUI_GRID_H)
+
+static int ne_gui_grid_start[NE_GUI_GRID_CELLS + 1]; // First entry of a cell
+static u16 *ne_gui_grid = NULL;
+static size_t ne_gui_grid_capacity; // In entries
+
+// True if the next update has to check all objects and build the grid again
+static bool ne_gui_full_update = true;
+
+// Slots of the objects with an event after the last update. They are updated
+// even if the stylus isn't in their cell, so that they can be released.
+static u16 *ne_gui_active = NULL;
+static u16 *ne_gui_active_next = NULL;
+static int ne_gui_active_count;
+
+// Number of the last update that has checked each slot
+static u32 *ne_gui_update_stamp = NULL;
+static u32 ne_gui_update_count;
+
+// Display list with the commands to draw all objects. The first word is the
+// number of words after it, like in the display lists of models.
+static u32 *ne_gui_list = NULL;
+static size_t ne_gui_list_capacity; // In words
+static u32 *ne_gui_list_ptr;  // Next free word
+static u32 *ne_gui_list_cmd;  // Word with the packed commands being written
+static int ne_gui_list_slots; // Number of commands in the packed word
+
+// Materials used by the list. Streamed textures are marked as used every time
+// that the list is drawn, so that they aren't evicted while it is cached.
+static const NEA_Material **ne_gui_list_mats = NULL;
+static size_t ne_gui_list_mats_capacity;
+static size_t ne_gui_list_mats_count;
+
+// Internal use... see NEATexture.c and NEAPalette.c
+u32 ne_material_tex_format(const NEA_Material *tex);
+void ne_material_touch(const NEA_Material *tex);
+u32 ne_palette_format(const NEA_Palette *pal);
+
+// Objects drawn on a hardware 2D background, see NEA_GUISetHw2DBackground()
+typedef struct {
+    bool used;          // The object has been configured for Hw2D
+    u16 tiles[2];       // First map entries: not pressed/pressed, false/true
+    u16 bar;            // Map entry of the background of slide bars
+    int palette;        // Palette of pressed check boxes (-1 = no change)
+    NEA_Hw2DOBJ *knob;  // Sliding button of slide bars
+    int state;          // State written to the map (-1 = not written)
+} ne_gui_hw2d_t;
+
+static NEA_Hw2DBG *ne_gui_hw2d_bg = NULL;
+static ne_gui_hw2d_t *ne_gui_hw2d = NULL; // One entry per slot
+
+// True if the state of an object may have changed since the last draw
+static bool ne_gui_hw2d_dirty = true;
+
+extern void NEA_Hw2DBGSetTile(NEA_Hw2DBG *bg, int x, int y, u16 value)
+    __attribute__((weak));
+extern void NEA_Hw2DOBJSetPos(NEA_Hw2DOBJ *obj, int x, int y)
+    __attribute__((weak));
+extern void NEA_Hw2DOBJSetVisible(NEA_Hw2DOBJ *obj, bool visible)
+    __attribute__((weak));
+extern void NEA_Hw2DOBJSetFrame(NEA_Hw2DOBJ *obj, int frame)
+    __attribute__((weak));
+
+// All objects start with their rectangle
+typedef struct {
+    int x1, y1, x2, y2;
+} ne_gui_rect_t;
+
 typedef struct {
     int x1, y1, x2, y2;
     int event; // 0 = nothing, 1 = just pressed, 2 = held, 3 = just released
@@ -59,24 +140,26 @@ typedef struct {
 // Internal use
 static void NEA_ResetRadioButtonGroup(int group)
 {
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
     {
-        if (NEA_guipointers[i] == NULL)
+        NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
+        if (obj == NULL)
             continue;
 
-        if (NEA_guipointers[i]->type != NEA_RadioButton)
+        if (obj->type != NEA_RadioButton)
             continue;
 
-        ne_radiobutton_t *rabtn = (void *)NEA_guipointers[i]->pointer;
+        ne_radiobutton_t *rabtn = (void *)obj->pointer;
 
         if (rabtn->group == group)
             rabtn->checked = false;
     }
 }
 
-static void NEA_GUIUpdateButton(NEA_GUIObj *obj)
+static bool NEA_GUIUpdateButton(NEA_GUIObj *obj)
 {
     ne_button_t *button = (void *)obj;
+    int old_event = button->event;
 
     if (button->x1 < ne_input.touch.px && button->x2 > ne_input.touch.px
      && button->y1 < ne_input.touch.py && button->y2 > ne_input.touch.py)
@@ -103,11 +186,15 @@ static void NEA_GUIUpdateButton(NEA_GUIObj *obj)
     {
         button->event = 0;
     }
+
+    return button->event != old_event;
 }
 
-static void NEA_GUIUpdateCheckBox(NEA_GUIObj *obj)
+static bool NEA_GUIUpdateCheckBox(NEA_GUIObj *obj)
 {
     ne_checkbox_t *chbox = (void *)obj;
+    int old_event = chbox->event;
+    bool old_checked = chbox->checked;
 
     if (chbox->x1 < ne_input.touch.px && chbox->x2 > ne_input.touch.px
      && chbox->y1 < ne_input.touch.py && chbox->y2 > ne_input.touch.py)
@@ -135,11 +222,15 @@ static void NEA_GUIUpdateCheckBox(NEA_GUIObj *obj)
     {
         chbox->event = 0;
     }
+
+    return (chbox->event != old_event) || (chbox->checked != old_checked);
 }
 
-static void NEA_GUIUpdateRadioButton(NEA_GUIObj *obj)
+static bool NEA_GUIUpdateRadioButton(NEA_GUIObj *obj)
 {
     ne_radiobutton_t *rabtn = (void *)obj;
+    int old_event = rabtn->event;
+    bool old_checked = rabtn->checked;
 
     if (rabtn->x1 < ne_input.touch.px && rabtn->x2 > ne_input.touch.px
      && rabtn->y1 < ne_input.touch.py && rabtn->y2 > ne_input.touch.py)
@@ -168,11 +259,14 @@ static void NEA_GUIUpdateRadioButton(NEA_GUIObj *obj)
     {
         rabtn->event = 0;
     }
+
+    return (rabtn->event != old_event) || (rabtn->checked != old_checked);
 }
 
-static void NEA_GUIUpdateSlideBar(NEA_GUIObj *obj)
+static bool NEA_GUIUpdateSlideBar(NEA_GUIObj *obj)
 {
     ne_slidebar_t *sldbar = (void *)obj;
+    ne_slidebar_t old = *sldbar;
 
     // Simplify code...
     int x1 = sldbar->x1, x2 = sldbar->x2;
@@ -314,6 +408,156 @@ static void NEA_GUIUpdateSlideBar(NEA_GUIObj *obj)
     {
         sldbar->event_bar = 0;
     }
+
+    return (sldbar->event_plus != old.event_plus)
+        || (sldbar->event_minus != old.event_minus)
+        || (sldbar->event_bar != old.event_bar)
+        || (sldbar->coord != old.coord);
+}
+
+// Updates one object. Returns true if it has an event after the update.
+static bool ne_gui_update_object(NEA_GUIObj *obj)
+{
+    NEA_GUITypes type = obj->type;
+    bool changed = false;
+
+    if (type == NEA_Button)
+        changed = NEA_GUIUpdateButton(obj->pointer);
+    else if (type == NEA_CheckBox)
+        changed = NEA_GUIUpdateCheckBox(obj->pointer);
+    else if (type == NEA_RadioButton)
+        changed = NEA_GUIUpdateRadioButton(obj->pointer);
+    else if (type == NEA_SlideBar)
+        changed = NEA_GUIUpdateSlideBar(obj->pointer);
+    else
+        NEA_DebugPrint("Unknown GUI object type: %d", type);
+
+    if (changed)
+    {
+        ne_gui_dirty = true;
+        ne_gui_hw2d_dirty = true;
+    }
+
+    return NEA_GUIObjectGetEvent(obj) != NEA_None;
+}
+
+// Gets the range of cells covered by an object. Returns false if it's outside
+// of the screen.
+static bool ne_gui_object_cells(const NEA_GUIObj *obj, int *cx1, int *cy1,
+                                int *cx2, int *cy2)
+{
+    const ne_gui_rect_t *rect = obj->pointer;
+
+    // The objects are only pressed strictly inside of their rectangle
+    int x1 = rect->x1 + 1;
+    int y1 = rect->y1 + 1;
+    int x2 = rect->x2 - 1;
+    int y2 = rect->y2 - 1;
+
+    if (x1 < 0)
+        x1 = 0;
+    if (y1 < 0)
+        y1 = 0;
+    if (x2 > 255)
+        x2 = 255;
+    if (y2 > 191)
+        y2 = 191;
+
+    if ((x1 > x2) || (y1 > y2))
+        return false;
+
+    *cx1 = x1 >> NE_GUI_GRID_SHIFT;
+    *cy1 = y1 >> NE_GUI_GRID_SHIFT;
+    *cx2 = x2 >> NE_GUI_GRID_SHIFT;
+    *cy2 = y2 >> NE_GUI_GRID_SHIFT;
+    return true;
+}
+
+// Sorts the objects in the cells of the grid. Returns 1 on success, 0 if
+// there isn't enough memory.
+static int ne_gui_grid_build(void)
+{
+    memset(ne_gui_grid_start, 0, sizeof(ne_gui_grid_start));
+
+    // Count the objects of each cell
+    for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
+    {
+        NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
+        if (obj == NULL)
+            continue;
+
+        int cx1, cy1, cx2, cy2;
+        if (!ne_gui_object_cells(obj, &cx1, &cy1, &cx2, &cy2))
+            continue;
+
+        for (int cy = cy1; cy <= cy2; cy++)
+        {
+            for (int cx = cx1; cx <= cx2; cx++)
+                ne_gui_grid_start[cy * NE_GUI_GRID_W + cx + 1]++;
+        }
+    }
+
+    for (int i = 0; i < NE_GUI_GRID_CELLS; i++)
+        ne_gui_grid_start[i + 1] += ne_gui_grid_start[i];
+
+    size_t entries = ne_gui_grid_start[NE_GUI_GRID_CELLS];
+
+    if (entries > ne_gui_grid_capacity)
+    {
+        u16 *grid = realloc(ne_gui_grid, entries * sizeof(u16));
+        if (grid == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        ne_gui_grid = grid;
+        ne_gui_grid_capacity = entries;
+    }
+
+    // Fill the cells
+    int pos[NE_GUI_GRID_CELLS];
+    memcpy(pos, ne_gui_grid_start, sizeof(pos));
+
+    for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
+    {
+        NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
+        if (obj == NULL)
+            continue;
+
+        int cx1, cy1, cx2, cy2;
+        if (!ne_gui_object_cells(obj, &cx1, &cy1, &cx2, &cy2))
+            continue;
+
+        int slot = ne_pool_slot(&ne_gui_pool, i);
+
+        for (int cy = cy1; cy <= cy2; cy++)
+        {
+            for (int cx = cx1; cx <= cx2; cx++)
+                ne_gui_grid[pos[cy * NE_GUI_GRID_W + cx]++] = slot;
+        }
+    }
+
+    return 1;
+}
+
+// Updates an object if it hasn't been updated yet by the current update, and
+// adds it to the list of active objects if it has an event.
+static int ne_gui_update_slot(int slot, int active_count)
+{
+    if (ne_gui_update_stamp[slot] == ne_gui_update_count)
+        return active_count;
+
+    NEA_GUIObj *obj = ne_pool_at(&ne_gui_pool, slot);
+    if (obj == NULL)
+        return active_count;
+
+    ne_gui_update_stamp[slot] = ne_gui_update_count;
+
+    if (ne_gui_update_object(obj))
+        ne_gui_active_next[active_count++] = slot;
+
+    return active_count;
 }
 
 void NEA_GUIUpdate(void)
@@ -321,24 +565,144 @@ void NEA_GUIUpdate(void)
     if (!ne_gui_system_inited)
         return;
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    bool touch = (ne_input.kdown | ne_input.kheld | ne_input.kup) & KEY_TOUCH;
+
+    // Without touch input, objects that aren't pressed stay the same
+    if (ne_gui_idle && !touch)
+        return;
+
+    ne_gui_update_count++;
+
+    int active_count = 0;
+
+    if (ne_gui_full_update)
     {
-        if (NEA_guipointers[i] == NULL)
-            continue;
+        for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
+        {
+            active_count = ne_gui_update_slot(ne_pool_slot(&ne_gui_pool, i),
+                                              active_count);
+        }
 
-        NEA_GUITypes type = NEA_guipointers[i]->type;
+        // If there isn't enough memory for the grid all objects are checked
+        // again in the next update.
+        if (ne_gui_grid_build())
+            ne_gui_full_update = false;
+    }
+    else
+    {
+        for (int i = 0; i < ne_gui_active_count; i++)
+            active_count = ne_gui_update_slot(ne_gui_active[i], active_count);
 
-        if (type == NEA_Button)
-            NEA_GUIUpdateButton(NEA_guipointers[i]->pointer);
-        else if (type == NEA_CheckBox)
-            NEA_GUIUpdateCheckBox(NEA_guipointers[i]->pointer);
-        else if (type == NEA_RadioButton)
-            NEA_GUIUpdateRadioButton(NEA_guipointers[i]->pointer);
-        else if (type == NEA_SlideBar)
-            NEA_GUIUpdateSlideBar(NEA_guipointers[i]->pointer);
-        else
-            NEA_DebugPrint("Unknown GUI object type: %d", type);
+        // Only the objects in the cell under the stylus can be pressed. The
+        // rest of the objects don't have an event, so they stay the same.
+        int px = ne_input.touch.px;
+        int py = ne_input.touch.py;
+
+        if (touch && (px >= 0) && (px < 256) && (py >= 0) && (py < 192))
+        {
+            int cell = (py >> NE_GUI_GRID_SHIFT) * NE_GUI_GRID_W
+                     + (px >> NE_GUI_GRID_SHIFT);
+
+            for (int i = ne_gui_grid_start[cell];
+                 i < ne_gui_grid_start[cell + 1]; i++)
+                active_count = ne_gui_update_slot(ne_gui_grid[i], active_count);
+        }
+    }
+
+    u16 *active = ne_gui_active;
+    ne_gui_active = ne_gui_active_next;
+    ne_gui_active_next = active;
+    ne_gui_active_count = active_count;
+
+    ne_gui_idle = !touch && (active_count == 0);
+}
+
+void NEA_GUIInvalidate(void)
+{
+    ne_gui_idle = false;
+    ne_gui_dirty = true;
+    ne_gui_hw2d_dirty = true;
+    ne_gui_full_update = true;
+}
+
+// Draw list
+// ---------
+//
+// The draw functions of the objects write their commands to a display list
+// instead of sending them to the GPU. The list is only built again when an
+// object changes, the rest of the frames it is sent as it is.
+
+static void ne_gui_list_command(u32 command, int num_params, u32 p0, u32 p1)
+{
+    if (ne_gui_list_slots == 4)
+    {
+        ne_gui_list_cmd = ne_gui_list_ptr++;
+        *ne_gui_list_cmd = 0;
+        ne_gui_list_slots = 0;
     }
+
+    *ne_gui_list_cmd |= command << (ne_gui_list_slots * 8);
+    ne_gui_list_slots++;
+
+    if (num_params > 0)
+        *ne_gui_list_ptr++ = p0;
+    if (num_params > 1)
+        *ne_gui_list_ptr++ = p1;
+}
+
+static void ne_gui_list_poly_format(u32 value)
+{
+    ne_gui_list_command(FIFO_POLY_FORMAT, 1, value, 0);
+}
+
+// Same quads as NEA_2DDrawQuad() and NEA_2DDrawTexturedQuadColor()
+static void ne_gui_list_quad(s16 x1, s16 y1, s16 x2, s16 y2, s16 z,
+                             const NEA_Material *tex, u32 color)
+{
+    if (tex == NULL)
+    {
+        ne_gui_list_command(FIFO_TEX_FORMAT, 1, 0, 0);
+        ne_gui_list_command(FIFO_COLOR, 1, color, 0);
+
+        ne_gui_list_command(FIFO_BEGIN, 1, GL_QUADS, 0);
+
+        ne_gui_list_command(FIFO_VERTEX16, 2, (y1 << 16) | (x1 & 0xFFFF), z);
+        ne_gui_list_command(FIFO_VERTEX_XY, 1, (y2 << 16) | (x1 & 0xFFFF), 0);
+        ne_gui_list_command(FIFO_VERTEX_XY, 1, (y2 << 16) | (x2 & 0xFFFF), 0);
+        ne_gui_list_command(FIFO_VERTEX_XY, 1, (y1 << 16) | (x2 & 0xFFFF), 0);
+        return;
+    }
+
+    int x = NEA_TextureGetSizeX(tex), y = NEA_TextureGetSizeY(tex);
+
+    ne_gui_list_mats[ne_gui_list_mats_count++] = tex;
+
+    // Same registers as NEA_MaterialUse(), but the vertex color is the one of
+    // the object.
+    ne_gui_list_command(FIFO_DIFFUSE_AMBIENT, 1, tex->diffuse_ambient, 0);
+    ne_gui_list_command(FIFO_SPECULAR_EMISSION, 1, tex->specular_emission, 0);
+    if (tex->palette)
+    {
+        ne_gui_list_command(FIFO_PAL_FORMAT, 1,
+                            ne_palette_format(tex->palette), 0);
+    }
+    ne_gui_list_command(FIFO_TEX_FORMAT, 1, ne_material_tex_format(tex), 0);
+    ne_gui_list_command(FIFO_COLOR, 1, color, 0);
+
+    ne_gui_list_command(FIFO_BEGIN, 1, GL_QUADS, 0);
+
+    ne_gui_list_command(FIFO_TEX_COORD, 1, TEXTURE_PACK(0, 0), 0);
+    ne_gui_list_command(FIFO_VERTEX16, 2, (y1 << 16) | (x1 & 0xFFFF), z);
+
+    ne_gui_list_command(FIFO_TEX_COORD, 1, TEXTURE_PACK(0, inttot16(y)), 0);
+    ne_gui_list_command(FIFO_VERTEX_XY, 1, (y2 << 16) | (x1 & 0xFFFF), 0);
+
+    ne_gui_list_command(FIFO_TEX_COORD, 1,
+                        TEXTURE_PACK(inttot16(x), inttot16(y)), 0);
+    ne_gui_list_command(FIFO_VERTEX_XY, 1, (y2 << 16) | (x2 & 0xFFFF), 0);
+
+    ne_gui_list_command(FIFO_TEX_COORD, 1, TEXTURE_PACK(inttot16(x), 0), 0);
+    ne_gui_list_command(FIFO_VERTEX_XY, 1, (y1 << 16) | (x2 & 0xFFFF), 0);
 }
 
 static void NEA_GUIDrawButton(NEA_GUIObj *obj, int priority)
@@ -350,29 +714,29 @@ static void NEA_GUIDrawButton(NEA_GUIObj *obj, int priority)
     if (button->event > 0)
     {
         // Pressed
-        GFX_POLY_FORMAT = POLY_ALPHA(button->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(button->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         tex = button->tex_2;
         color = button->color2;
     }
     else
     {
         // Not-pressed
-        GFX_POLY_FORMAT = POLY_ALPHA(button->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(button->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         tex = button->tex_1;
         color = button->color1;
     }
 
     if (tex == NULL)
     {
-        NEA_2DDrawQuad(button->x1, button->y1, button->x2, button->y2,
-                      priority, color);
+        ne_gui_list_quad(button->x1, button->y1, button->x2, button->y2,
+                         priority, NULL, color);
     }
     else
     {
-        NEA_2DDrawTexturedQuadColor(button->x1, button->y1, button->x2,
-                                   button->y2, priority, tex, color);
+        ne_gui_list_quad(button->x1, button->y1, button->x2,
+                         button->y2, priority, tex, color);
     }
 }
 
@@ -383,14 +747,14 @@ static void NEA_GUIDrawCheckBox(NEA_GUIObj *obj, int priority)
 
     if (chbox->event > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(chbox->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(chbox->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = chbox->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(chbox->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(chbox->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = chbox->color1;
     }
 
@@ -398,13 +762,13 @@ static void NEA_GUIDrawCheckBox(NEA_GUIObj *obj, int priority)
 
     if (tex == NULL)
     {
-        NEA_2DDrawQuad(chbox->x1, chbox->y1, chbox->x2, chbox->y2,
-                      priority, color);
+        ne_gui_list_quad(chbox->x1, chbox->y1, chbox->x2, chbox->y2,
+                         priority, NULL, color);
     }
     else
     {
-        NEA_2DDrawTexturedQuadColor(chbox->x1, chbox->y1, chbox->x2,
-                                   chbox->y2, priority, tex, color);
+        ne_gui_list_quad(chbox->x1, chbox->y1, chbox->x2,
+                         chbox->y2, priority, tex, color);
     }
 }
 
@@ -415,14 +779,14 @@ static void NEA_GUIDrawRadioButton(NEA_GUIObj *obj, int priority)
 
     if (rabtn->event > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(rabtn->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(rabtn->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = rabtn->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(rabtn->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(rabtn->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = rabtn->color1;
     }
 
@@ -430,13 +794,13 @@ static void NEA_GUIDrawRadioButton(NEA_GUIObj *obj, int priority)
 
     if (tex == NULL)
     {
-        NEA_2DDrawQuad(rabtn->x1, rabtn->y1, rabtn->x2, rabtn->y2,
-                  priority, color);
+        ne_gui_list_quad(rabtn->x1, rabtn->y1, rabtn->x2, rabtn->y2,
+                         priority, NULL, color);
     }
     else
     {
-        NEA_2DDrawTexturedQuadColor(rabtn->x1, rabtn->y1, rabtn->x2,
-                       rabtn->y2, priority, tex, color);
+        ne_gui_list_quad(rabtn->x1, rabtn->y1, rabtn->x2,
+                         rabtn->y2, priority, tex, color);
     }
 }
 
@@ -469,30 +833,30 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
 
     if (sldbar->event_plus > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color1;
     }
 
     if (sldbar->isvertical)
     {
         if (tex == NULL)
-            NEA_2DDrawQuad(x1, tmp2, x2, y2, priority, color);
+            ne_gui_list_quad(x1, tmp2, x2, y2, priority, NULL, color);
         else
-            NEA_2DDrawTexturedQuadColor(x1, tmp2, x2, y2, priority, tex, color);
+            ne_gui_list_quad(x1, tmp2, x2, y2, priority, tex, color);
     }
     else
     {
         if (tex == NULL)
-            NEA_2DDrawQuad(tmp2, y1, x2, y2, priority, color);
+            ne_gui_list_quad(tmp2, y1, x2, y2, priority, NULL, color);
         else
-            NEA_2DDrawTexturedQuadColor(tmp2, y1, x2, y2, priority, tex, color);
+            ne_gui_list_quad(tmp2, y1, x2, y2, priority, tex, color);
     }
 
     // Minus button
@@ -500,30 +864,30 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
 
     if (sldbar->event_minus > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color1;
     }
 
     if (sldbar->isvertical)
     {
         if (tex == NULL)
-            NEA_2DDrawQuad(x1, y1, x2, tmp1, priority, color);
+            ne_gui_list_quad(x1, y1, x2, tmp1, priority, NULL, color);
         else
-            NEA_2DDrawTexturedQuadColor(x1, y1, x2, tmp1, priority, tex, color);
+            ne_gui_list_quad(x1, y1, x2, tmp1, priority, tex, color);
     }
     else
     {
         if (tex == NULL)
-            NEA_2DDrawQuad(x1, y1, tmp1, y2, priority, color);
+            ne_gui_list_quad(x1, y1, tmp1, y2, priority, NULL, color);
         else
-            NEA_2DDrawTexturedQuadColor(x1, y1, tmp1, y2, priority, tex, color);
+            ne_gui_list_quad(x1, y1, tmp1, y2, priority, tex, color);
     }
 
     // Bar button
@@ -534,14 +898,14 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
 
     if (sldbar->event_bar > 0)
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha2)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha2)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color2;
     }
     else
     {
-        GFX_POLY_FORMAT = POLY_ALPHA(sldbar->alpha1)
-                        | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE;
+        ne_gui_list_poly_format(POLY_ALPHA(sldbar->alpha1)
+                              | POLY_ID(NEA_GUI_POLY_ID) | NEA_CULL_NONE);
         color = sldbar->color1;
     }
 
@@ -549,30 +913,30 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
     {
         if (tex == NULL)
         {
-            NEA_2DDrawQuad(x1, sldbar->coord,
-                          x2, sldbar->coord + sldbar->barsize,
-                          priority, color);
+            ne_gui_list_quad(x1, sldbar->coord,
+                             x2, sldbar->coord + sldbar->barsize,
+                             priority, NULL, color);
         }
         else
         {
-            NEA_2DDrawTexturedQuadColor(x1, sldbar->coord,
-                                       x2, sldbar->coord + sldbar->barsize,
-                                       priority, tex, color);
+            ne_gui_list_quad(x1, sldbar->coord,
+                             x2, sldbar->coord + sldbar->barsize,
+                             priority, tex, color);
         }
     }
     else
     {
         if (tex == NULL)
         {
-            NEA_2DDrawQuad(sldbar->coord, y1,
-                          sldbar->coord + sldbar->barsize, y2,
-                          priority, color);
+            ne_gui_list_quad(sldbar->coord, y1,
+                             sldbar->coord + sldbar->barsize, y2,
+                             priority, NULL, color);
         }
         else
         {
-            NEA_2DDrawTexturedQuadColor(sldbar->coord, y1,
-                                       sldbar->coord + sldbar->barsize, y2,
-                                       priority, tex, color);
+            ne_gui_list_quad(sldbar->coord, y1,
+                             sldbar->coord + sldbar->barsize, y2,
+                             priority, tex, color);
         }
     }
 
@@ -582,8 +946,8 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
     // Load texture and color of the slide bar background
     tex = sldbar->texlong;
     color = sldbar->barcolor;
-    GFX_POLY_FORMAT = POLY_ALPHA(sldbar->baralpha)
-                    | POLY_ID(NEA_GUI_POLY_ID_ALT) | NEA_CULL_NONE;
+    ne_gui_list_poly_format(POLY_ALPHA(sldbar->baralpha)
+                          | POLY_ID(NEA_GUI_POLY_ID_ALT) | NEA_CULL_NONE);
 
     // Now we need to use `priority + 1` as priority. The bar button must
     // be in front of bar. `priority + 1` is less priority than `priority`.
@@ -592,41 +956,98 @@ static void NEA_GUIDrawSlideBar(NEA_GUIObj *obj, int priority)
     {
         if (tex == NULL)
         {
-            NEA_2DDrawQuad(x1, tmp1, x2, tmp2, priority + 1, color);
+            ne_gui_list_quad(x1, tmp1, x2, tmp2, priority + 1, NULL, color);
         }
         else
         {
-            NEA_2DDrawTexturedQuadColor(x1, tmp1, x2, tmp2,
-                                       priority + 1, tex, color);
+            ne_gui_list_quad(x1, tmp1, x2, tmp2,
+                             priority + 1, tex, color);
         }
     }
     else
     {
         if (tex == NULL)
         {
-            NEA_2DDrawQuad(tmp1, y1, tmp2, y2, priority + 1, color);
+            ne_gui_list_quad(tmp1, y1, tmp2, y2, priority + 1, NULL, color);
         }
         else
         {
-            NEA_2DDrawTexturedQuadColor(tmp1, y1, tmp2, y2,
-                                       priority + 1, tex, color);
+            ne_gui_list_quad(tmp1, y1, tmp2, y2,
+                             priority + 1, tex, color);
         }
     }
 }
 
-void NEA_GUIDraw(void)
+// Max number of words used by one quad of the draw list (15 commands and 16
+// parameters)
+#define NE_GUI_LIST_QUAD_WORDS 20
+
+// Returns true if an object is drawn on the Hw2D background
+static bool ne_gui_hw2d_active(int slot)
 {
-    if (!ne_gui_system_inited)
-        return;
+    return (ne_gui_hw2d_bg != NULL) && ne_gui_hw2d[slot].used;
+}
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+static int ne_gui_list_build(void)
+{
+    // Slide bars have 4 quads, the other objects have one
+    size_t quads = 0;
+
+    for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
+    {
+        NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
+        if ((obj == NULL) || ne_gui_hw2d_active(ne_pool_slot(&ne_gui_pool, i)))
+            continue;
+
+        quads += (obj->type == NEA_SlideBar) ? 4 : 1;
+    }
+
+    size_t words = 1 + quads * NE_GUI_LIST_QUAD_WORDS;
+
+    // The list may still be in the queue of the asynchronous backend
+    NEA_DisplayListWait();
+
+    if (words > ne_gui_list_capacity)
+    {
+        u32 *list = realloc(ne_gui_list, words * sizeof(u32));
+        if (list == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        ne_gui_list = list;
+        ne_gui_list_capacity = words;
+    }
+
+    if (quads > ne_gui_list_mats_capacity)
+    {
+        const NEA_Material **mats = realloc(ne_gui_list_mats,
+                                            quads * sizeof(NEA_Material *));
+        if (mats == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        ne_gui_list_mats = mats;
+        ne_gui_list_mats_capacity = quads;
+    }
+
+    ne_gui_list_ptr = &ne_gui_list[1];
+    ne_gui_list_slots = 4;
+    ne_gui_list_mats_count = 0;
+
+    for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
     {
-        if (NEA_guipointers[i] == NULL)
+        NEA_GUIObj *handle = ne_pool_get(&ne_gui_pool, i);
+        if ((handle == NULL) ||
+            ne_gui_hw2d_active(ne_pool_slot(&ne_gui_pool, i)))
             continue;
 
-        NEA_GUIObj *obj = NEA_guipointers[i]->pointer;
-        NEA_GUITypes type = NEA_guipointers[i]->type;
-        int priority = i + NEA_GUI_MIN_PRIORITY;
+        NEA_GUIObj *obj = handle->pointer;
+        NEA_GUITypes type = handle->type;
+        int priority = ne_pool_slot(&ne_gui_pool, i) + NEA_GUI_MIN_PRIORITY;
 
         if (type == NEA_Button)
             NEA_GUIDrawButton(obj, priority);
@@ -639,57 +1060,294 @@ void NEA_GUIDraw(void)
         else
             NEA_DebugPrint("Unknown GUI object type: %d", type);
     }
+
+    ne_gui_list[0] = ne_gui_list_ptr - &ne_gui_list[1];
+
+    return 1;
 }
 
-NEA_GUIObj *NEA_GUIButtonCreate(s16 x1, s16 y1, s16 x2, s16 y2)
+// Hardware 2D backend
+// -------------------
+//
+// Objects configured with the NEA_GUI*ConfigHw2D() functions write their tiles
+// to the map of a background instead of adding quads to the draw list. Their
+// map entries are only written again when their state changes.
+
+// Writes the map entries of a rectangle of the screen. If block is true, the
+// tiles are consecutive, starting at the first one. If not, all of them are
+// the first one.
+static void ne_gui_hw2d_fill(int x1, int y1, int x2, int y2, u16 first,
+                             bool block)
 {
-    if (!ne_gui_system_inited)
+    int tx1 = x1 >> 3;
+    int ty1 = y1 >> 3;
+    int tw = (x2 - x1) >> 3;
+    int th = (y2 - y1) >> 3;
+    int map_w = ne_gui_hw2d_bg->width >> 3;
+    int map_h = ne_gui_hw2d_bg->height >> 3;
+
+    for (int y = 0; y < th; y++)
     {
-        NEA_DebugPrint("System not initialized");
+        int ty = ty1 + y;
+        if ((ty < 0) || (ty >= map_h))
+            continue;
+
+        for (int x = 0; x < tw; x++)
+        {
+            int tx = tx1 + x;
+            if ((tx < 0) || (tx >= map_w))
+                continue;
+
+            u16 entry = block ? first + y * tw + x : first;
+            NEA_Hw2DBGSetTile(ne_gui_hw2d_bg, tx, ty, entry);
+        }
+    }
+}
+
+static void ne_gui_hw2d_draw_slidebar(ne_slidebar_t *sldbar, ne_gui_hw2d_t *hw)
+{
+    int x1 = sldbar->x1, x2 = sldbar->x2;
+    int y1 = sldbar->y1, y2 = sldbar->y2;
+
+    if (hw->knob != NULL)
+    {
+        if (sldbar->isvertical)
+            NEA_Hw2DOBJSetPos(hw->knob, x1, sldbar->coord);
+        else
+            NEA_Hw2DOBJSetPos(hw->knob, sldbar->coord, y1);
+
+        NEA_Hw2DOBJSetFrame(hw->knob, (sldbar->event_bar > 0) ? 1 : 0);
+        NEA_Hw2DOBJSetVisible(hw->knob, true);
+    }
+
+    bool minus = sldbar->event_minus > 0;
+    bool plus = sldbar->event_plus > 0;
+    int state = (minus ? 1 : 0) | (plus ? 2 : 0);
+
+    if (state == hw->state)
+        return;
+
+    hw->state = state;
+
+    if (sldbar->isvertical)
+    {
+        int tmp1 = y1 + (x2 - x1);
+        int tmp2 = y2 - (x2 - x1);
+
+        ne_gui_hw2d_fill(x1, y1, x2, tmp1, hw->tiles[minus], true);
+        ne_gui_hw2d_fill(x1, tmp1, x2, tmp2, hw->bar, false);
+        ne_gui_hw2d_fill(x1, tmp2, x2, y2, hw->tiles[plus], true);
+    }
+    else
+    {
+        int tmp1 = x1 + (y2 - y1);
+        int tmp2 = x2 - (y2 - y1);
+
+        ne_gui_hw2d_fill(x1, y1, tmp1, y2, hw->tiles[minus], true);
+        ne_gui_hw2d_fill(tmp1, y1, tmp2, y2, hw->bar, false);
+        ne_gui_hw2d_fill(tmp2, y1, x2, y2, hw->tiles[plus], true);
+    }
+}
+
+static void ne_gui_hw2d_draw(NEA_GUIObj *handle, ne_gui_hw2d_t *hw)
+{
+    const ne_gui_rect_t *rect = handle->pointer;
+    int state;
+    u16 first;
+
+    if (handle->type == NEA_Button)
+    {
+        ne_button_t *button = handle->pointer;
+        state = (button->event > 0) ? 1 : 0;
+        first = hw->tiles[state];
+    }
+    else if (handle->type == NEA_CheckBox)
+    {
+        ne_checkbox_t *chbox = handle->pointer;
+        bool pressed = chbox->event > 0;
+        state = (chbox->checked ? 1 : 0) | (pressed ? 2 : 0);
+        first = hw->tiles[chbox->checked];
+        if (pressed && (hw->palette >= 0))
+            first = (first & 0x0FFF) | (hw->palette << 12);
+    }
+    else if (handle->type == NEA_RadioButton)
+    {
+        ne_radiobutton_t *rabtn = handle->pointer;
+        bool pressed = rabtn->event > 0;
+        state = (rabtn->checked ? 1 : 0) | (pressed ? 2 : 0);
+        first = hw->tiles[rabtn->checked];
+        if (pressed && (hw->palette >= 0))
+            first = (first & 0x0FFF) | (hw->palette << 12);
+    }
+    else
+    {
+        ne_gui_hw2d_draw_slidebar(handle->pointer, hw);
+        return;
+    }
+
+    if (state == hw->state)
+        return;
+
+    hw->state = state;
+    ne_gui_hw2d_fill(rect->x1, rect->y1, rect->x2, rect->y2, first, true);
+}
+
+// Clears the map entries of an object and forgets its configuration
+static void ne_gui_hw2d_clear(int slot)
+{
+    ne_gui_hw2d_t *hw = &ne_gui_hw2d[slot];
+
+    if (ne_gui_hw2d_active(slot))
+    {
+        const NEA_GUIObj *obj = ne_pool_at(&ne_gui_pool, slot);
+        const ne_gui_rect_t *rect = obj->pointer;
+
+        ne_gui_hw2d_fill(rect->x1, rect->y1, rect->x2, rect->y2, 0, false);
+        if (hw->knob != NULL)
+            NEA_Hw2DOBJSetVisible(hw->knob, false);
+    }
+
+    memset(hw, 0, sizeof(ne_gui_hw2d_t));
+}
+
+// Returns the Hw2D configuration of an object, or NULL if it isn't found
+static ne_gui_hw2d_t *ne_gui_hw2d_config(NEA_GUIObj *obj)
+{
+    int slot = ne_pool_find(&ne_gui_pool, obj);
+    if (slot < 0)
+    {
+        NEA_DebugPrint("Object not found");
         return NULL;
     }
 
+    ne_gui_hw2d_t *hw = &ne_gui_hw2d[slot];
+    hw->used = true;
+    hw->state = -1;
+    hw->palette = -1;
+
+    NEA_GUIInvalidate();
+    return hw;
+}
+
+void NEA_GUISetHw2DBackground(NEA_Hw2DBG *bg)
+{
+    NEA_Assert(ne_gui_system_inited, "System not initialized");
+    NEA_Assert((bg == NULL) || (bg->map_ptr != NULL), "Not a tiled BG");
+
+    ne_gui_hw2d_bg = bg;
+
     for (int i = 0; i < NEA_GUI_OBJECTS; i++)
-    {
-        if (NEA_guipointers[i] != NULL)
-            continue;
+        ne_gui_hw2d[i].state = -1;
 
-        ne_button_t *ptr = malloc(sizeof(ne_button_t));
-        if (ptr == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    NEA_GUIInvalidate();
+}
+
+void NEA_GUIButtonConfigHw2D(NEA_GUIObj *btn, u16 tiles, u16 pressedtiles)
+{
+    NEA_AssertPointer(btn, "NULL pointer");
+    NEA_Assert(btn->type == NEA_Button, "Not a button");
+
+    ne_gui_hw2d_t *hw = ne_gui_hw2d_config(btn);
+    if (hw == NULL)
+        return;
+
+    hw->tiles[0] = tiles;
+    hw->tiles[1] = pressedtiles;
+}
+
+void NEA_GUICheckBoxConfigHw2D(NEA_GUIObj *chbx, u16 tilestrue,
+                               u16 tilesfalse, int pressedpalette)
+{
+    NEA_AssertPointer(chbx, "NULL pointer");
+    NEA_Assert(chbx->type == NEA_CheckBox, "Not a check box");
+    NEA_AssertMinMax(-1, pressedpalette, 15, "Invalid palette %d",
+                     pressedpalette);
+
+    ne_gui_hw2d_t *hw = ne_gui_hw2d_config(chbx);
+    if (hw == NULL)
+        return;
+
+    hw->tiles[0] = tilesfalse;
+    hw->tiles[1] = tilestrue;
+    hw->palette = pressedpalette;
+}
+
+void NEA_GUIRadioButtonConfigHw2D(NEA_GUIObj *rdbtn, u16 tilestrue,
+                                  u16 tilesfalse, int pressedpalette)
+{
+    NEA_AssertPointer(rdbtn, "NULL pointer");
+    NEA_Assert(rdbtn->type == NEA_RadioButton, "Not a radio button");
+    NEA_AssertMinMax(-1, pressedpalette, 15, "Invalid palette %d",
+                     pressedpalette);
+
+    ne_gui_hw2d_t *hw = ne_gui_hw2d_config(rdbtn);
+    if (hw == NULL)
+        return;
+
+    hw->tiles[0] = tilesfalse;
+    hw->tiles[1] = tilestrue;
+    hw->palette = pressedpalette;
+}
+
+void NEA_GUISlideBarConfigHw2D(NEA_GUIObj *sldbar, u16 btntiles,
+                               u16 pressedbtntiles, u16 bartile,
+                               NEA_Hw2DOBJ *barbtn)
+{
+    NEA_AssertPointer(sldbar, "NULL pointer");
+    NEA_Assert(sldbar->type == NEA_SlideBar, "Not a slide bar");
+
+    ne_gui_hw2d_t *hw = ne_gui_hw2d_config(sldbar);
+    if (hw == NULL)
+        return;
+
+    hw->tiles[0] = btntiles;
+    hw->tiles[1] = pressedbtntiles;
+    hw->bar = bartile;
+    hw->knob = barbtn;
+}
+
+void NEA_GUIDraw(void)
+{
+    if (!ne_gui_system_inited)
+        return;
 
-        NEA_guipointers[i] = malloc(sizeof(NEA_GUIObj));
-        if (NEA_guipointers[i] == NULL)
+    if (ne_gui_hw2d_dirty && (ne_gui_hw2d_bg != NULL))
+    {
+        for (int i = 0; i < ne_pool_count(&ne_gui_pool); i++)
         {
-            free(ptr);
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+            int slot = ne_pool_slot(&ne_gui_pool, i);
+            NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
 
-        NEA_guipointers[i]->pointer = (void *)ptr;
-        NEA_guipointers[i]->type = NEA_Button;
+            if ((obj != NULL) && ne_gui_hw2d[slot].used)
+                ne_gui_hw2d_draw(obj, &ne_gui_hw2d[slot]);
+        }
+    }
+    ne_gui_hw2d_dirty = false;
 
-        ptr->x1 = x1;
-        ptr->y1 = y1;
-        ptr->x2 = x2;
-        ptr->y2 = y2;
-        ptr->event = -1;
-        ptr->tex_1 = ptr->tex_2 = NULL;
-        ptr->color1 = ptr->color2 = NEA_White;
-        ptr->alpha1 = ptr->alpha2 = 31;
+    if (ne_gui_dirty)
+    {
+        if (ne_gui_list_build() == 0)
+            return;
 
-        return NEA_guipointers[i];
+        ne_gui_dirty = false;
+    }
+    else
+    {
+        // Building the list has already marked them as used in this frame
+        for (size_t i = 0; i < ne_gui_list_mats_count; i++)
+            ne_material_touch(ne_gui_list_mats[i]);
     }
 
-    NEA_DebugPrint("No free slots");
+    if (ne_gui_list[0] == 0)
+        return;
+
+    NEA_DisplayListDrawDefault(ne_gui_list);
 
-    return NULL;
+    // The list writes the material registers directly
+    NEA_MaterialStateInvalidate();
 }
 
-NEA_GUIObj *NEA_GUICheckBoxCreate(s16 x1, s16 y1, s16 x2, s16 y2, bool initialvalue)
+NEA_GUIObj *NEA_GUIButtonCreate(s16 x1, s16 y1, s16 x2, s16 y2)
 {
     if (!ne_gui_system_inited)
     {
@@ -697,45 +1355,91 @@ NEA_GUIObj *NEA_GUICheckBoxCreate(s16 x1, s16 y1, s16 x2, s16 y2, bool initialva
         return NULL;
     }
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    if (ne_pool_next_slot(&ne_gui_pool) < 0)
     {
-        if (NEA_guipointers[i] != NULL)
-            continue;
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        ne_checkbox_t *ptr = malloc(sizeof(ne_checkbox_t));
-        if (ptr == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    ne_button_t *ptr = malloc(sizeof(ne_button_t));
+    if (ptr == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        NEA_guipointers[i] = malloc(sizeof(NEA_GUIObj));
-        if (NEA_guipointers[i] == NULL)
-        {
-            free(ptr);
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    NEA_GUIObj *obj = malloc(sizeof(NEA_GUIObj));
+    if (obj == NULL)
+    {
+        free(ptr);
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    obj->pointer = (void *)ptr;
+    obj->type = NEA_Button;
+
+    ptr->x1 = x1;
+    ptr->y1 = y1;
+    ptr->x2 = x2;
+    ptr->y2 = y2;
+    ptr->event = -1;
+    ptr->tex_1 = ptr->tex_2 = NULL;
+    ptr->color1 = ptr->color2 = NEA_White;
+    ptr->alpha1 = ptr->alpha2 = 31;
+
+    ne_pool_add(&ne_gui_pool, obj);
+    NEA_GUIInvalidate();
+
+    return obj;
+}
+
+NEA_GUIObj *NEA_GUICheckBoxCreate(s16 x1, s16 y1, s16 x2, s16 y2, bool initialvalue)
+{
+    if (!ne_gui_system_inited)
+    {
+        NEA_DebugPrint("System not initialized");
+        return NULL;
+    }
 
-        NEA_guipointers[i]->pointer = (void *)ptr;
-        NEA_guipointers[i]->type = NEA_CheckBox;
+    if (ne_pool_next_slot(&ne_gui_pool) < 0)
+    {
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        ptr->x1 = x1;
-        ptr->y1 = y1;
-        ptr->x2 = x2;
-        ptr->y2 = y2;
-        ptr->event = -1;
-        ptr->tex_1 = ptr->tex_2 = NULL;
-        ptr->color1 = ptr->color2 = NEA_White;
-        ptr->alpha1 = ptr->alpha2 = 31;
-        ptr->checked = initialvalue;
+    ne_checkbox_t *ptr = malloc(sizeof(ne_checkbox_t));
+    if (ptr == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        return NEA_guipointers[i];
+    NEA_GUIObj *obj = malloc(sizeof(NEA_GUIObj));
+    if (obj == NULL)
+    {
+        free(ptr);
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
     }
 
-    NEA_DebugPrint("No free slots");
+    obj->pointer = (void *)ptr;
+    obj->type = NEA_CheckBox;
 
-    return NULL;
+    ptr->x1 = x1;
+    ptr->y1 = y1;
+    ptr->x2 = x2;
+    ptr->y2 = y2;
+    ptr->event = -1;
+    ptr->tex_1 = ptr->tex_2 = NULL;
+    ptr->color1 = ptr->color2 = NEA_White;
+    ptr->alpha1 = ptr->alpha2 = 31;
+    ptr->checked = initialvalue;
+
+    ne_pool_add(&ne_gui_pool, obj);
+    NEA_GUIInvalidate();
+
+    return obj;
 }
 
 NEA_GUIObj *NEA_GUIRadioButtonCreate(s16 x1, s16 y1, s16 x2, s16 y2, int group,
@@ -747,49 +1451,48 @@ NEA_GUIObj *NEA_GUIRadioButtonCreate(s16 x1, s16 y1, s16 x2, s16 y2, int group,
         return NULL;
     }
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    if (ne_pool_next_slot(&ne_gui_pool) < 0)
     {
-        if (NEA_guipointers[i] != NULL)
-            continue;
-
-        ne_radiobutton_t *ptr = malloc(sizeof(ne_radiobutton_t));
-        if (ptr == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        NEA_guipointers[i] = malloc(sizeof(NEA_GUIObj));
-        if (NEA_guipointers[i] == NULL)
-        {
-            free(ptr);
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    ne_radiobutton_t *ptr = malloc(sizeof(ne_radiobutton_t));
+    if (ptr == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        NEA_guipointers[i]->pointer = (void *)ptr;
-        NEA_guipointers[i]->type = NEA_RadioButton;
+    NEA_GUIObj *obj = malloc(sizeof(NEA_GUIObj));
+    if (obj == NULL)
+    {
+        free(ptr);
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        ptr->x1 = x1;
-        ptr->y1 = y1;
-        ptr->x2 = x2;
-        ptr->y2 = y2;
-        ptr->event = -1;
-        ptr->tex_1 = ptr->tex_2 = NULL;
-        ptr->color1 = ptr->color2 = NEA_White;
-        ptr->alpha1 = ptr->alpha2 = 31;
-        ptr->group = group;
+    obj->pointer = (void *)ptr;
+    obj->type = NEA_RadioButton;
 
-        if (initialvalue)
-            NEA_ResetRadioButtonGroup(group);
+    ptr->x1 = x1;
+    ptr->y1 = y1;
+    ptr->x2 = x2;
+    ptr->y2 = y2;
+    ptr->event = -1;
+    ptr->tex_1 = ptr->tex_2 = NULL;
+    ptr->color1 = ptr->color2 = NEA_White;
+    ptr->alpha1 = ptr->alpha2 = 31;
+    ptr->group = group;
 
-        ptr->checked = initialvalue;
-        return NEA_guipointers[i];
-    }
+    if (initialvalue)
+        NEA_ResetRadioButtonGroup(group);
 
-    NEA_DebugPrint("No free slots");
+    ptr->checked = initialvalue;
+    ne_pool_add(&ne_gui_pool, obj);
+    NEA_GUIInvalidate();
 
-    return NULL;
+    return obj;
 }
 
 NEA_GUIObj *NEA_GUISlideBarCreate(s16 x1, s16 y1, s16 x2, s16 y2, int min,
@@ -801,64 +1504,63 @@ NEA_GUIObj *NEA_GUISlideBarCreate(s16 x1, s16 y1, s16 x2, s16 y2, int min,
         return NULL;
     }
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    if (ne_pool_next_slot(&ne_gui_pool) < 0)
     {
-        if (NEA_guipointers[i] != NULL)
-            continue;
-
-        ne_slidebar_t *ptr = malloc(sizeof(ne_slidebar_t));
-        if (ptr == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        NEA_guipointers[i] = malloc(sizeof(NEA_GUIObj));
-        if (NEA_guipointers[i] == NULL)
-        {
-            free(ptr);
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
+    ne_slidebar_t *ptr = malloc(sizeof(ne_slidebar_t));
+    if (ptr == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        NEA_guipointers[i]->pointer = (void *)ptr;
-        NEA_guipointers[i]->type = NEA_SlideBar;
-
-        ptr->x1 = x1;
-        ptr->y1 = y1;
-        ptr->x2 = x2;
-        ptr->y2 = y2;
-        ptr->event_minus = ptr->event_plus = ptr->event_bar = -1;
-        ptr->texbtn = ptr->texbar = ptr->texlong = NULL;
-        ptr->color1 = ptr->color2 = ptr->barcolor = NEA_White;
-        ptr->alpha1 = ptr->alpha2 = ptr->baralpha = 31;
-        ptr->value = initialvalue - min;
-        ptr->desp = min;
-        ptr->range = max - min;
-
-        ptr->isvertical = (x2 - x1 > y2 - y1) ? false : true;
-
-        if (ptr->isvertical)
-            ptr->totalsize = y2 - y1 - ((x2 - x1) << 1);
-        else
-            ptr->totalsize = x2 - x1 - ((y2 - y1) << 1);
+    NEA_GUIObj *obj = malloc(sizeof(NEA_GUIObj));
+    if (obj == NULL)
+    {
+        free(ptr);
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
 
-        ptr->barsize = 100 - ptr->range;
-        ptr->barsize = (ptr->barsize < 20) ?  (20 << 12) : (ptr->barsize << 12);
-        ptr->barsize = (divf32(ptr->barsize, 100 << 12) * ptr->totalsize) >> 12;
+    obj->pointer = (void *)ptr;
+    obj->type = NEA_SlideBar;
+
+    ptr->x1 = x1;
+    ptr->y1 = y1;
+    ptr->x2 = x2;
+    ptr->y2 = y2;
+    ptr->event_minus = ptr->event_plus = ptr->event_bar = -1;
+    ptr->texbtn = ptr->texbar = ptr->texlong = NULL;
+    ptr->color1 = ptr->color2 = ptr->barcolor = NEA_White;
+    ptr->alpha1 = ptr->alpha2 = ptr->baralpha = 31;
+    ptr->value = initialvalue - min;
+    ptr->desp = min;
+    ptr->range = max - min;
+
+    ptr->isvertical = (x2 - x1 > y2 - y1) ? false : true;
+
+    if (ptr->isvertical)
+        ptr->totalsize = y2 - y1 - ((x2 - x1) << 1);
+    else
+        ptr->totalsize = x2 - x1 - ((y2 - y1) << 1);
 
-        ptr->coord = (ptr->totalsize - ptr->barsize) * ptr->value;
-        ptr->coord = divf32(ptr->coord << 12, ptr->range << 12) >> 12;
-        ptr->coord += (ptr->isvertical) ?
-                            ptr->y1 + (ptr->x2 - ptr->x1) :
-                            ptr->x1 + (ptr->y2 - ptr->y1);
+    ptr->barsize = 100 - ptr->range;
+    ptr->barsize = (ptr->barsize < 20) ?  (20 << 12) : (ptr->barsize << 12);
+    ptr->barsize = (divf32(ptr->barsize, 100 << 12) * ptr->totalsize) >> 12;
 
-        return NEA_guipointers[i];
-    }
+    ptr->coord = (ptr->totalsize - ptr->barsize) * ptr->value;
+    ptr->coord = divf32(ptr->coord << 12, ptr->range << 12) >> 12;
+    ptr->coord += (ptr->isvertical) ?
+                        ptr->y1 + (ptr->x2 - ptr->x1) :
+                        ptr->x1 + (ptr->y2 - ptr->y1);
 
-    NEA_DebugPrint("No free slots");
+    ne_pool_add(&ne_gui_pool, obj);
+    NEA_GUIInvalidate();
 
-    return NULL;
+    return obj;
 }
 
 void NEA_GUIButtonConfig(NEA_GUIObj *btn, NEA_Material *material, u32 color,
@@ -876,6 +1578,8 @@ void NEA_GUIButtonConfig(NEA_GUIObj *btn, NEA_Material *material, u32 color,
     button->color2 = pressedcolor;
     button->alpha1 = alpha;
     button->alpha2 = pressedalpha;
+
+    NEA_GUIInvalidate();
 }
 
 void NEA_GUICheckBoxConfig(NEA_GUIObj *chbx, NEA_Material *materialtrue,
@@ -893,6 +1597,8 @@ void NEA_GUICheckBoxConfig(NEA_GUIObj *chbx, NEA_Material *materialtrue,
     checkbox->color2 = pressedcolor;
     checkbox->alpha1 = alpha;
     checkbox->alpha2 = pressedalpha;
+
+    NEA_GUIInvalidate();
 }
 
 void NEA_GUIRadioButtonConfig(NEA_GUIObj *rdbtn, NEA_Material *materialtrue,
@@ -910,6 +1616,8 @@ void NEA_GUIRadioButtonConfig(NEA_GUIObj *rdbtn, NEA_Material *materialtrue,
     radiobutton->color2 = pressedcolor;
     radiobutton->alpha1 = alpha;
     radiobutton->alpha2 = pressedalpha;
+
+    NEA_GUIInvalidate();
 }
 
 void NEA_GUISlideBarConfig(NEA_GUIObj *sldbar, NEA_Material *matbtn,
@@ -931,6 +1639,8 @@ void NEA_GUISlideBarConfig(NEA_GUIObj *sldbar, NEA_Material *matbtn,
     slidebar->alpha1 = alpha;
     slidebar->alpha2 = pressedalpha;
     slidebar->baralpha = baralpha;
+
+    NEA_GUIInvalidate();
 }
 
 void NEA_GUISlideBarSetMinMax(NEA_GUIObj *sldbr, int min, int max)
@@ -958,6 +1668,8 @@ void NEA_GUISlideBarSetMinMax(NEA_GUIObj *sldbr, int min, int max)
     slidebar->coord += (slidebar->isvertical) ?
         slidebar->y1 + (slidebar->x2 - slidebar->x1) :
         slidebar->x1 + (slidebar->y2 - slidebar->y1);
+
+    NEA_GUIInvalidate();
 }
 
 NEA_GUIState NEA_GUIObjectGetEvent(const NEA_GUIObj *obj)
@@ -1009,18 +1721,18 @@ void NEA_GUIDeleteObject(NEA_GUIObj *obj)
 {
     NEA_AssertPointer(obj, "NULL pointer");
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    int slot = ne_pool_find(&ne_gui_pool, obj);
+    if (slot < 0)
     {
-        if (NEA_guipointers[i] == obj)
-        {
-            free(obj->pointer);
-            free(obj);
-            NEA_guipointers[i] = NULL;
-            return;
-        }
+        NEA_DebugPrint("Object not found");
+        return;
     }
 
-    NEA_DebugPrint("Object not found");
+    ne_gui_hw2d_clear(slot);
+    ne_pool_remove(&ne_gui_pool, slot);
+    free(obj->pointer);
+    free(obj);
+    NEA_GUIInvalidate();
 }
 
 void NEA_GUIDeleteAll(void)
@@ -1028,15 +1740,20 @@ void NEA_GUIDeleteAll(void)
     if (!ne_gui_system_inited)
         return;
 
-    for (int i = 0; i < NEA_GUI_OBJECTS; i++)
+    for (int i = ne_pool_count(&ne_gui_pool) - 1; i >= 0; i--)
     {
-        if (NEA_guipointers[i])
-        {
-            free(NEA_guipointers[i]->pointer);
-            free(NEA_guipointers[i]);
-            NEA_guipointers[i] = NULL;
-        }
+        NEA_GUIObj *obj = ne_pool_get(&ne_gui_pool, i);
+        if (obj == NULL)
+            continue;
+
+        int slot = ne_pool_slot(&ne_gui_pool, i);
+        ne_gui_hw2d_clear(slot);
+        ne_pool_remove(&ne_gui_pool, slot);
+        free(obj->pointer);
+        free(obj);
     }
+
+    NEA_GUIInvalidate();
 }
 
 int NEA_GUISystemReset(int max_objects)
@@ -1049,14 +1766,34 @@ int NEA_GUISystemReset(int max_objects)
     else
         NEA_GUI_OBJECTS = max_objects;
 
-    NEA_guipointers = calloc(NEA_GUI_OBJECTS, sizeof(NEA_guipointers));
-    if (NEA_guipointers == NULL)
+    if (ne_pool_init(&ne_gui_pool, NEA_GUI_OBJECTS) == 0)
+        return -1;
+
+    ne_gui_active = malloc(NEA_GUI_OBJECTS * sizeof(u16));
+    ne_gui_active_next = malloc(NEA_GUI_OBJECTS * sizeof(u16));
+    ne_gui_update_stamp = calloc(NEA_GUI_OBJECTS, sizeof(u32));
+    ne_gui_hw2d = calloc(NEA_GUI_OBJECTS, sizeof(ne_gui_hw2d_t));
+    if ((ne_gui_active == NULL) || (ne_gui_active_next == NULL) ||
+        (ne_gui_update_stamp == NULL) || (ne_gui_hw2d == NULL))
     {
         NEA_DebugPrint("Not enough memory");
+        free(ne_gui_active);
+        free(ne_gui_active_next);
+        free(ne_gui_update_stamp);
+        free(ne_gui_hw2d);
+        ne_gui_active = NULL;
+        ne_gui_active_next = NULL;
+        ne_gui_update_stamp = NULL;
+        ne_gui_hw2d = NULL;
+        ne_pool_end(&ne_gui_pool);
         return -1;
     }
 
+    ne_gui_active_count = 0;
+    ne_gui_update_count = 0;
+
     ne_gui_system_inited = true;
+    NEA_GUIInvalidate();
     return 0;
 }
 
@@ -1067,7 +1804,34 @@ void NEA_GUISystemEnd(void)
 
     NEA_GUIDeleteAll();
 
-    free(NEA_guipointers);
+    ne_pool_end(&ne_gui_pool);
+
+    NEA_DisplayListWait();
+    free(ne_gui_list);
+    ne_gui_list = NULL;
+    ne_gui_list_capacity = 0;
+
+    free(ne_gui_list_mats);
+    ne_gui_list_mats = NULL;
+    ne_gui_list_mats_capacity = 0;
+    ne_gui_list_mats_count = 0;
+
+    free(ne_gui_grid);
+    ne_gui_grid = NULL;
+    ne_gui_grid_capacity = 0;
+
+    free(ne_gui_active);
+    free(ne_gui_active_next);
+    ne_gui_active = NULL;
+    ne_gui_active_next = NULL;
+    ne_gui_active_count = 0;
+
+    free(ne_gui_update_stamp);
+    ne_gui_update_stamp = NULL;
+
+    free(ne_gui_hw2d);
+    ne_gui_hw2d = NULL;
+    ne_gui_hw2d_bg = NULL;
 
     ne_gui_system_inited = false;
 }
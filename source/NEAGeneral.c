@@ -11,6 +11,8 @@
 #include "NEAMain.h"
 #include "NEAMath.h"
 
+#include "dsma/dsma.h"
+
 /// @file NEAGeneral.c
 
 const char NEA_VersionString[] =
@@ -23,6 +25,22 @@ static int NEA_screenratio;
 static uint32_t NEA_viewport;
 static u8 NEA_Screen; // 1 = main screen, 0 = sub screen
 
+// Screens drawn by the dual 3D modes, see NEA_DualFrameRatioSet(). Index 1 is
+// the main screen, like in NEA_Screen.
+static int ne_dual_frames[2] = { 1, 1 };
+static int ne_dual_credit[2];
+static bool ne_dual_sub_dirty;
+
+// Both screens are drawn in alternate frames by default
+static void ne_dual_reset(void)
+{
+    ne_dual_frames[0] = 1;
+    ne_dual_frames[1] = 1;
+    ne_dual_credit[0] = 0;
+    ne_dual_credit[1] = 0;
+    ne_dual_sub_dirty = false;
+}
+
 static NEA_ExecutionModes ne_execution_mode = NEA_ModeUninitialized;
 
 NEA_Input ne_input;
@@ -48,11 +66,29 @@ static uint32_t ne_dma_cr = 0;
 static u16 *ne_two_pass_fb[2];              // Two framebuffers in main RAM
 static volatile u8 ne_two_pass_displayed;   // Index of framebuffer being displayed
 static volatile bool ne_two_pass_next_ready;// Next framebuffer ready to swap
-static u8 ne_two_pass_frame;                // Current pass: 0 = left, 1 = right
+static u8 ne_two_pass_frame;                // Current pass: band being drawn
 static bool ne_two_pass_enabled;            // True when in two-pass mode
 
 #define NEA_TWO_PASS_SPLIT 128 // Horizontal split at screen center
 
+// Bands of columns drawn by each pass (see NEA_TwoPassSetBands()). Band i goes
+// from column ne_two_pass_bounds[i] to ne_two_pass_bounds[i + 1].
+static int ne_two_pass_bands = 2;
+static int ne_two_pass_bounds[NEA_TWO_PASS_MAX_BANDS + 1] = {
+    0, NEA_TWO_PASS_SPLIT, 256
+};
+
+// Adaptive split line (see NEA_TwoPassAdaptiveSplit())
+#define NEA_TWO_PASS_SPLIT_STEP 8  // Max movement per frame, also the overlap
+#define NEA_TWO_PASS_SPLIT_MIN  32 // Min width of each half
+static bool ne_two_pass_adaptive;   // True if the split line can move
+static int ne_two_pass_split = NEA_TWO_PASS_SPLIT; // Current split column
+static int ne_two_pass_polys[NEA_TWO_PASS_MAX_BANDS]; // Polygons of each pass
+
+// Per-pass culling (see NEA_TwoPassCulling())
+static bool ne_two_pass_culling = false;
+static int ne_two_pass_x0, ne_two_pass_x1; // Columns drawn by the current pass
+
 // Scanline row offset in the VRAM_F bitmap used for HBL DMA display.
 // Same technique as NEA_DUAL_DMA_3D_LINES_OFFSET: the bitmap BG has PD=0 so it
 // repeats one row, and DMA writes new scanline data to that row at each HBL.
@@ -68,6 +104,11 @@ void NEA_End(void)
     if (ne_execution_mode == NEA_ModeUninitialized)
         return;
 
+    // Weak reference: frame captures are only linked if the user uses them
+    extern void NEA_CaptureEnd(void) __attribute__((weak));
+    if (NEA_CaptureEnd)
+        NEA_CaptureEnd();
+
     vramSetBankA(VRAM_A_LCD);
     vramSetBankB(VRAM_B_LCD);
 
@@ -194,6 +235,12 @@ void NEA_End(void)
     NEA_SpriteSystemEnd();
     NEA_PhysicsSystemEnd();
     NEA_ModelSystemEnd();
+
+    // Weak reference: the asset cache is only linked if the user uses it
+    extern void NEA_CacheDeleteAll(void) __attribute__((weak));
+    if (NEA_CacheDeleteAll)
+        NEA_CacheDeleteAll();
+
     NEA_AnimationSystemEnd();
     NEA_TextResetSystem();
     NEA_TextureSystemEnd();
@@ -208,6 +255,9 @@ void NEA_End(void)
     ne_execution_mode = NEA_ModeUninitialized;
 }
 
+// Internal use... see NEATexture.c
+void ne_material_state_matrix_mode(u32 mode);
+
 void NEA_Viewport(int x1, int y1, int x2, int y2)
 {
     // Start calculating screen ratio in f32 format
@@ -215,16 +265,20 @@ void NEA_Viewport(int x1, int y1, int x2, int y2)
 
     // Save viewport
     NEA_viewport = x1 | (y1 << 8) | (x2 << 16) | (y2 << 24);
+
+    NEA_DisplayListWait();
+
     GFX_VIEWPORT = NEA_viewport;
 
-    MATRIX_CONTROL = GL_PROJECTION; // New projection matix for this viewport
+    // New projection matix for this viewport
+    ne_material_state_matrix_mode(GL_PROJECTION);
     MATRIX_IDENTITY = 0;
 
     int fovy = fov * DEGREES_IN_CIRCLE / 360;
     NEA_screenratio = ne_div_result();
     gluPerspectivef32(fovy, NEA_screenratio, ne_znear, ne_zfar);
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 }
 
 void NEA_MainScreenSetOnTop(void)
@@ -259,10 +313,26 @@ static void ne_systems_end_all(void)
     if (NEA_Hw2DSystemEnd)
         NEA_Hw2DSystemEnd();
 
+    // Weak reference: the render queue is only linked if the user uses it
+    extern void NEA_RenderQueueSystemEnd(void) __attribute__((weak));
+    if (NEA_RenderQueueSystemEnd)
+        NEA_RenderQueueSystemEnd();
+
+    // Weak reference: the particle system is only linked if the user uses it
+    extern void NEA_ParticleSystemEnd(void) __attribute__((weak));
+    if (NEA_ParticleSystemEnd)
+        NEA_ParticleSystemEnd();
+
     NEA_GUISystemEnd();
     NEA_SpriteSystemEnd();
     NEA_PhysicsSystemEnd();
     NEA_ModelSystemEnd();
+
+    // Weak reference: the asset cache is only linked if the user uses it
+    extern void NEA_CacheDeleteAll(void) __attribute__((weak));
+    if (NEA_CacheDeleteAll)
+        NEA_CacheDeleteAll();
+
     NEA_AnimationSystemEnd();
     NEA_TextResetSystem();
     NEA_TextureSystemEnd();
@@ -297,6 +367,9 @@ cleanup:
     return -1;
 }
 
+// Internal use... see NEAPolygon.c
+extern u32 ne_poly_format_last;
+
 static void ne_init_registers(void)
 {
     // This function is usually called when the program boots. We don't know
@@ -366,6 +439,7 @@ static void ne_init_registers(void)
 
     GFX_COLOR = 0;
     GFX_POLY_FORMAT = 0;
+    ne_poly_format_last = 0;
 
     for (int i = 0; i < 8; i++)
         NEA_OutliningSetColor(i, 0);
@@ -378,6 +452,9 @@ static void ne_init_registers(void)
     MATRIX_CONTROL = GL_MODELVIEW;
     MATRIX_IDENTITY = 0;
 
+    // The registers have been written without going through their shadows
+    NEA_MaterialStateInvalidate();
+
     // Make sure that this function is left always at the same time regardless
     // of whether it runs on hardware or emulators (which can be more or less
     // accurate). If not, the output of the screens in dual 3D mode may be
@@ -391,6 +468,10 @@ static void ne_init_registers(void)
     videoSetMode(MODE_0_3D);
 }
 
+// Weak references: input replays are only linked if the user uses them
+extern void ne_replay_update_input(NEA_Input *input) __attribute__((weak));
+extern void ne_replay_frame_end(void) __attribute__((weak));
+
 void NEA_UpdateInput(void)
 {
     ne_input.kdown = keysDown();
@@ -399,6 +480,15 @@ void NEA_UpdateInput(void)
 
     if (ne_input.kheld & KEY_TOUCH)
         touchRead(&ne_input.touch);
+
+    // Record the input, or replace it by the recorded one
+    if (ne_replay_update_input)
+        ne_replay_update_input(&ne_input);
+}
+
+const NEA_Input *NEA_GetInput(void)
+{
+    return &ne_input;
 }
 
 void NEA_SetDepthBufferMode(NEA_DepthBufferMode mode)
@@ -506,6 +596,7 @@ int NEA_InitDual3D(void)
     ne_execution_mode = NEA_ModeDual3D;
 
     NEA_Screen = 0;
+    ne_dual_reset();
 
     NEA_DebugPrint("Nitro Engine Advanced initialized in dual 3D mode");
 
@@ -555,6 +646,7 @@ int NEA_InitDual3D_FB(void)
     ne_execution_mode = NEA_ModeDual3D_FB;
 
     NEA_Screen = 0;
+    ne_dual_reset();
 
     NEA_DebugPrint("Nitro Engine Advanced initialized in dual 3D FB mode");
 
@@ -580,6 +672,7 @@ int NEA_InitDual3D_DMA(void)
     ne_execution_mode = NEA_ModeDual3D_DMA;
 
     NEA_Screen = 0;
+    ne_dual_reset();
 
     NEA_DebugPrint("Nitro Engine Advanced initialized in dual 3D DMA mode");
 
@@ -645,6 +738,7 @@ int NEA_Init3D_TwoPass(void)
     ne_two_pass_next_ready = false;
     ne_two_pass_frame = 0;
     ne_two_pass_enabled = true;
+    ne_two_pass_split = ne_two_pass_bounds[1];
 
     // Use VRAM D as destination for video capture
     vramSetBankD(VRAM_D_LCD);
@@ -687,10 +781,18 @@ int NEA_Init3D_TwoPass_FB(void)
 
     ne_init_registers();
 
+    // The compositing of this mode only works with two halves
+    if (ne_two_pass_bands != 2)
+    {
+        NEA_DebugPrint("FB mode only supports 2 bands, using 2 halves");
+        NEA_TwoPassSetBands(2, NULL);
+    }
+
     ne_two_pass_displayed = 0;
     ne_two_pass_next_ready = false;
     ne_two_pass_frame = 0;
     ne_two_pass_enabled = true;
+    ne_two_pass_split = ne_two_pass_bounds[1];
 
     // No main RAM framebuffers needed - VRAM C/D serve as framebuffers.
     ne_two_pass_fb[0] = NULL;
@@ -751,6 +853,7 @@ int NEA_Init3D_TwoPass_DMA(void)
     ne_two_pass_next_ready = false;
     ne_two_pass_frame = 0;
     ne_two_pass_enabled = true;
+    ne_two_pass_split = ne_two_pass_bounds[1];
 
     // Use VRAM D as destination for video capture
     vramSetBankD(VRAM_D_LCD);
@@ -911,6 +1014,8 @@ void NEA_SetConsoleColor(u32 color)
 static void ne_process_common(void)
 {
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
+    DSMA_PoseCacheClear();
 
     if (ne_main_screen == 1)
         lcdMainOnTop();
@@ -921,33 +1026,183 @@ static void ne_process_common(void)
 
     GFX_VIEWPORT = NEA_viewport;
 
-    MATRIX_CONTROL = GL_PROJECTION;
+    ne_material_state_matrix_mode(GL_PROJECTION);
     MATRIX_IDENTITY = 0;
     gluPerspectivef32(fov * DEGREES_IN_CIRCLE / 360, NEA_screenratio,
                       ne_znear, ne_zfar);
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_IDENTITY = 0;
 }
 
+// Weak references: the render queue is only linked if the user uses it
+extern void NEA_RenderQueueFlush(void) __attribute__((weak));
+extern bool ne_render_queue_replay(void) __attribute__((weak));
+
+static void ne_render_queue_flush(void)
+{
+    if (NEA_RenderQueueFlush)
+        NEA_RenderQueueFlush();
+}
+
+// Weak reference: the budget governor is only linked if the user uses it
+extern void ne_budget_frame_end(int pass) __attribute__((weak));
+
+// Internal use... see NEAProfile.c
+void ne_cycles_start(void);
+u32 ne_cycles_now(void);
+
+// Internal use... see NEAArena.c
+void ne_arena_frame_end(void);
+
+// Statistics of the geometry pipeline. The display list functions add to the
+// current frame when they are enabled.
+bool ne_gpu_stats_enabled;
+NEA_GPUStats ne_gpu_stats_current;
+static NEA_GPUStats ne_gpu_stats_last;
+static u32 ne_gpu_stats_pass_start; // FIFO words when the pass started
+
+void NEA_GPUStatsEnable(bool enable)
+{
+    if (enable)
+        ne_cycles_start();
+
+    ne_gpu_stats_enabled = enable;
+    memset(&ne_gpu_stats_current, 0, sizeof(ne_gpu_stats_current));
+    memset(&ne_gpu_stats_last, 0, sizeof(ne_gpu_stats_last));
+    ne_gpu_stats_pass_start = 0;
+}
+
+void NEA_GPUStatsGet(NEA_GPUStats *stats)
+{
+    NEA_AssertPointer(stats, "NULL stats pointer");
+    *stats = ne_gpu_stats_last;
+}
+
+// Samples GXSTAT at the end of a pass, and waits for the geometry engine to
+// finish the commands that are still in the FIFO.
+static void ne_gpu_stats_pass_end(int pass)
+{
+    NEA_GPUStats *stats = &ne_gpu_stats_current;
+    u32 start = ne_cycles_now();
+
+    stats->pass_fifo_entries[pass] = (GFX_STATUS >> 16) & 0x1FF;
+
+    while (GFX_STATUS & BIT(27));
+
+    stats->pass_idle_cycles[pass] = ne_cycles_now() - start;
+    stats->pass_idle_vcount[pass] = REG_VCOUNT;
+    stats->pass_polygons[pass] = GFX_POLYGON_RAM_USAGE;
+    stats->pass_vertices[pass] = GFX_VERTEX_RAM_USAGE;
+    stats->pass_words[pass] = stats->fifo_words - ne_gpu_stats_pass_start;
+    stats->passes++;
+
+    ne_gpu_stats_pass_start = stats->fifo_words;
+}
+
+static void ne_gpu_stats_frame_end(void)
+{
+    ne_gpu_stats_last = ne_gpu_stats_current;
+    memset(&ne_gpu_stats_current, 0, sizeof(ne_gpu_stats_current));
+    ne_gpu_stats_pass_start = 0;
+}
+
+// Ends a 3D frame and swaps the buffers. The pass is the two-pass half or the
+// screen in dual 3D modes, and 0 in the other modes.
+static void ne_flush_3d(int pass)
+{
+    NEA_ProfileBegin(NEA_PROFILE_FIFO_WAIT);
+    NEA_DisplayListWait();
+    NEA_ProfileEnd(NEA_PROFILE_FIFO_WAIT);
+
+    if (ne_gpu_stats_enabled)
+        ne_gpu_stats_pass_end(pass);
+
+    if (ne_budget_frame_end)
+        ne_budget_frame_end(pass);
+
+    if (ne_two_pass_enabled && ne_two_pass_adaptive)
+        ne_two_pass_polys[pass] = NEA_GetPolygonCount();
+
+    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+}
+
+// Frame pacing, see NEA_FramePacingSet(). NEA_WaitForVBL() decides if the next
+// frame is drawn.
+static bool ne_pacing_enabled;
+static bool ne_pacing_draw = true; // The next frame is drawn
+static bool ne_pacing_drawn;       // NEA_Process() has drawn this frame
+
+// Returns true if NEA_Process() has to skip the draw callback of this frame
+static bool ne_pacing_skip(void)
+{
+    if (!ne_pacing_enabled)
+        return false;
+
+    if (ne_pacing_draw)
+    {
+        ne_pacing_drawn = true;
+        return false;
+    }
+
+    // The geometry engine isn't flushed, so the hardware keeps rendering the
+    // polygons of the last frame. The input is still updated.
+    NEA_UpdateInput();
+    return true;
+}
+
+// Weak references: impostors are only linked if the user uses them
+extern bool ne_impostor_capture_pass(void) __attribute__((weak));
+extern void ne_impostor_vblank(void) __attribute__((weak));
+
 void NEA_Process(NEA_Voidfunc drawscene)
 {
+    if (ne_pacing_skip())
+        return;
+
     ne_process_common();
 
     NEA_AssertPointer(drawscene, "NULL function pointer");
+
+    // The impostor atlas uses the whole frame when it's refreshed
+    if (ne_impostor_capture_pass && ne_impostor_capture_pass())
+    {
+        ne_flush_3d(0);
+        return;
+    }
+
+    NEA_ProfileBegin(NEA_PROFILE_DRAW);
     drawscene();
+    NEA_ProfileEnd(NEA_PROFILE_DRAW);
 
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_render_queue_flush();
+
+    ne_flush_3d(0);
 }
 
 void NEA_ProcessArg(NEA_VoidArgfunc drawscene, void *arg)
 {
+    if (ne_pacing_skip())
+        return;
+
     ne_process_common();
 
     NEA_AssertPointer(drawscene, "NULL function pointer");
+
+    // The impostor atlas uses the whole frame when it's refreshed
+    if (ne_impostor_capture_pass && ne_impostor_capture_pass())
+    {
+        ne_flush_3d(0);
+        return;
+    }
+
+    NEA_ProfileBegin(NEA_PROFILE_DRAW);
     drawscene(arg);
+    NEA_ProfileEnd(NEA_PROFILE_DRAW);
 
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_render_queue_flush();
+
+    ne_flush_3d(0);
 }
 
 int NEA_TwoPassGetPass(void)
@@ -955,32 +1210,261 @@ int NEA_TwoPassGetPass(void)
     return ne_two_pass_frame;
 }
 
+int NEA_TwoPassSetBands(int bands, const int *bounds)
+{
+    NEA_AssertMinMax(2, bands, NEA_TWO_PASS_MAX_BANDS,
+                     "Invalid number of bands %d", bands);
+
+    if ((bands < 2) || (bands > NEA_TWO_PASS_MAX_BANDS))
+        return 0;
+
+    if ((bands != 2) && (ne_execution_mode == NEA_ModeSingle3D_TwoPass_FB))
+    {
+        NEA_DebugPrint("FB mode only supports 2 bands");
+        return 0;
+    }
+
+    int new_bounds[NEA_TWO_PASS_MAX_BANDS + 1];
+    new_bounds[0] = 0;
+    new_bounds[bands] = 256;
+
+    for (int i = 1; i < bands; i++)
+    {
+        // Keep them aligned so that the capture copies stay word-aligned
+        if (bounds == NULL)
+            new_bounds[i] = ((256 * i) / bands) & ~7;
+        else
+            new_bounds[i] = bounds[i - 1];
+
+        if ((new_bounds[i] & 7) || (new_bounds[i] <= new_bounds[i - 1]))
+        {
+            NEA_DebugPrint("Invalid band boundary %d", new_bounds[i]);
+            return 0;
+        }
+    }
+
+    if (new_bounds[bands - 1] >= 256)
+    {
+        NEA_DebugPrint("Invalid band boundary %d", new_bounds[bands - 1]);
+        return 0;
+    }
+
+    memcpy(ne_two_pass_bounds, new_bounds, sizeof(new_bounds));
+
+    // Start again from the first band. The frame that was being drawn is lost.
+    if (bands != ne_two_pass_bands)
+    {
+        ne_two_pass_bands = bands;
+        ne_two_pass_frame = 0;
+        ne_two_pass_next_ready = false;
+    }
+
+    ne_two_pass_split = ne_two_pass_bounds[1];
+
+    for (int i = 0; i < NEA_TWO_PASS_MAX_BANDS; i++)
+        ne_two_pass_polys[i] = 0;
+
+    return 1;
+}
+
+int NEA_TwoPassGetBands(void)
+{
+    return ne_two_pass_bands;
+}
+
+void NEA_TwoPassAdaptiveSplit(bool enable)
+{
+    ne_two_pass_adaptive = enable;
+
+    if (!enable)
+        ne_two_pass_split = ne_two_pass_bounds[1];
+
+    for (int i = 0; i < NEA_TWO_PASS_MAX_BANDS; i++)
+        ne_two_pass_polys[i] = 0;
+}
+
+int NEA_TwoPassGetSplit(void)
+{
+    return ne_two_pass_split;
+}
+
+void NEA_TwoPassCulling(bool enable)
+{
+    ne_two_pass_culling = enable;
+}
+
+// Internal use: true if models must be culled against the frustum of the
+// current pass. See NEAModel.c and NEACamera.c
+bool ne_two_pass_culling_active(void)
+{
+    return ne_two_pass_enabled && ne_two_pass_culling;
+}
+
+// Internal use: returns the tangent of half the vertical field of view, the
+// aspect ratio, the clipping planes (all f32) and the viewport of the whole
+// screen. See NEAPick.c
+void ne_projection_get(int32_t *tan_half_fov, int32_t *ratio, int32_t *znear,
+                       int32_t *zfar, uint32_t *viewport)
+{
+    int fovy = fov * DEGREES_IN_CIRCLE / 360;
+    *tan_half_fov = tanLerp(fovy >> 1);
+    *znear = ne_znear;
+    *zfar = ne_zfar;
+
+    if (ne_two_pass_enabled)
+    {
+        // Each pass draws one half, but the projection covers the whole screen
+        *ratio = divf32(256 << 12, 192 << 12);
+        *viewport = 0 | (0 << 8) | (255 << 16) | (191 << 24);
+    }
+    else
+    {
+        *ratio = NEA_screenratio;
+        *viewport = NEA_viewport;
+    }
+}
+
+// Internal use: returns the frustum of the projection used by the engine in
+// the current pass, as (left, right, bottom, top, near, far) in the same format
+// as glFrustumf32(). See NEACamera.c
+void ne_projection_frustum(int32_t *frustum)
+{
+    int32_t fovy = fov * DEGREES_IN_CIRCLE / 360;
+    int32_t top = mulf32(ne_znear, tanLerp(fovy >> 1));
+
+    if (ne_two_pass_enabled)
+    {
+        // Same perspective as a full-screen render, but only the columns
+        // between x0 and x1.
+        int x0 = ne_two_pass_x0;
+        int x1 = ne_two_pass_x1;
+        if (x1 <= x0)
+        {
+            x0 = 0;
+            x1 = 256;
+        }
+
+        int32_t full_aspect = divf32(256 << 12, 192 << 12);
+        int32_t right_full = mulf32(top, full_aspect);
+
+        frustum[0] = (right_full * (2 * x0 - 256)) / 256;
+        frustum[1] = (right_full * (2 * x1 - 256)) / 256;
+    }
+    else
+    {
+        // Same as gluPerspectivef32()
+        frustum[0] = mulf32(-top, NEA_screenratio);
+        frustum[1] = mulf32(top, NEA_screenratio);
+    }
+
+    frustum[2] = -top;
+    frustum[3] = top;
+    frustum[4] = ne_znear;
+    frustum[5] = ne_zfar;
+}
+
+void NEA_TwoPassGetPassColumns(int *x0, int *x1)
+{
+    if (x0 != NULL)
+        *x0 = ne_two_pass_x0;
+    if (x1 != NULL)
+        *x1 = ne_two_pass_x1;
+}
+
+// Moves the split line towards the column that would leave the same number of
+// polygons at each side, assuming that the polygons of each half of the last
+// frame are spread evenly. It only moves when a new frame starts, so that both
+// halves of a frame use the same split line. It's only used with two bands.
+static void ne_two_pass_update_split(void)
+{
+    if (ne_two_pass_bands != 2)
+        return;
+
+    int left = ne_two_pass_polys[0];
+    int right = ne_two_pass_polys[1];
+    int total = left + right;
+
+    // Don't react to small differences
+    if (abs(left - right) * 16 <= total)
+        return;
+
+    int split = ne_two_pass_split;
+    int target;
+
+    if (left > right)
+        target = (split * total) / (2 * left);
+    else
+        target = 256 - ((256 - split) * total) / (2 * right);
+
+    if (target > split + NEA_TWO_PASS_SPLIT_STEP)
+        target = split + NEA_TWO_PASS_SPLIT_STEP;
+    else if (target < split - NEA_TWO_PASS_SPLIT_STEP)
+        target = split - NEA_TWO_PASS_SPLIT_STEP;
+
+    if (target < NEA_TWO_PASS_SPLIT_MIN)
+        target = NEA_TWO_PASS_SPLIT_MIN;
+    else if (target > 256 - NEA_TWO_PASS_SPLIT_MIN)
+        target = 256 - NEA_TWO_PASS_SPLIT_MIN;
+
+    // Keep it aligned so that the capture copies stay word-aligned
+    ne_two_pass_split = target & ~(NEA_TWO_PASS_SPLIT_STEP - 1);
+}
+
+// Returns the columns [x0, x1) of a band, extended by the overlap at the sides
+// that touch other bands. With two bands the split line may be adaptive.
+static void ne_two_pass_band_columns(int band, int overlap, int *x0, int *x1)
+{
+    int first = ne_two_pass_bounds[band];
+    int last = ne_two_pass_bounds[band + 1];
+
+    if (ne_two_pass_bands == 2)
+    {
+        if (band == 0)
+            last = ne_two_pass_split;
+        else
+            first = ne_two_pass_split;
+    }
+
+    if (band > 0)
+        first -= overlap;
+    if (band < ne_two_pass_bands - 1)
+        last += overlap;
+
+    *x0 = first;
+    *x1 = last;
+}
+
 // Shared helper: compute asymmetric frustum and set viewport for the current
-// two-pass half. Used by all three two-pass modes.
+// two-pass band. Used by all three two-pass modes.
 static void ne_two_pass_setup_frustum(void)
 {
-    const int split = NEA_TWO_PASS_SPLIT;
+    // With an adaptive split line, both halves overlap by the max distance
+    // that the line can move in one frame. The captures of the previous frame
+    // still cover their half of the screen after the line moves, and the FB
+    // mode doesn't show a gap between halves rendered with different splits.
+    int x0, x1;
+    const int overlap = (ne_two_pass_adaptive && (ne_two_pass_bands == 2)) ?
+                        NEA_TWO_PASS_SPLIT_STEP : 0;
 
-    if (ne_two_pass_frame == 0)
-        GFX_VIEWPORT = 0 | (0 << 8) | ((split - 1) << 16) | (191 << 24);
-    else
-        GFX_VIEWPORT = (split) | (0 << 8) | (255 << 16) | (191 << 24);
+    ne_two_pass_band_columns(ne_two_pass_frame, overlap, &x0, &x1);
+
+    NEA_DisplayListWait();
+
+    GFX_VIEWPORT = x0 | (0 << 8) | ((x1 - 1) << 16) | (191 << 24);
+
+    ne_two_pass_x0 = x0;
+    ne_two_pass_x1 = x1;
 
     // Compute asymmetric frustum from the user's FOV/znear/zfar settings.
     // This gives the same perspective as a full-screen render, but only
-    // draws the left or right half.
-    int32_t fovy = fov * DEGREES_IN_CIRCLE / 360;
-    int32_t top = mulf32(ne_znear, tanLerp(fovy >> 1));
-    int32_t full_aspect = divf32(256 << 12, 192 << 12);
-    int32_t right_full = mulf32(top, full_aspect);
+    // draws the columns between x0 and x1.
+    int32_t f[6];
+    ne_projection_frustum(f);
 
-    MATRIX_CONTROL = GL_PROJECTION;
+    ne_material_state_matrix_mode(GL_PROJECTION);
     MATRIX_IDENTITY = 0;
 
-    if (ne_two_pass_frame == 0)
-        glFrustumf32(-right_full, 0, -top, top, ne_znear, ne_zfar);
-    else
-        glFrustumf32(0, right_full, -top, top, ne_znear, ne_zfar);
+    glFrustumf32(f[0], f[1], f[2], f[3], f[4], f[5]);
 }
 
 // Processing for FIFO and DMA modes: copy capture from VRAM_D to main RAM
@@ -988,6 +1472,7 @@ static void ne_two_pass_setup_frustum(void)
 static void ne_process_two_pass_fifo_dma(void)
 {
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
 
     if (ne_main_screen == 1)
         lcdMainOnTop();
@@ -1001,45 +1486,38 @@ static void ne_process_two_pass_fifo_dma(void)
                    | DCAP_SRC_A(DCAP_SRC_A_3DONLY)
                    | DCAP_ENABLE;
 
-    const int split = NEA_TWO_PASS_SPLIT;
+    if ((ne_two_pass_frame == 0) && ne_two_pass_adaptive)
+        ne_two_pass_update_split();
 
-    if (ne_two_pass_frame == 0)
-    {
-        // Copy the previous left-half capture from VRAM_D to the next
-        // framebuffer. VRAM_D contains the capture from the previous frame's
-        // GPU output (one-frame delay due to double-buffered 3D rendering).
-        const u16 *fb_src = VRAM_D;
-        u16 *fb_dst = ne_two_pass_fb[ne_two_pass_displayed ^ 1];
+    // Copy the previous capture of a band from VRAM_D to the next framebuffer.
+    // VRAM_D contains the capture from the previous frame's GPU output
+    // (one-frame delay due to double-buffered 3D rendering), which is the band
+    // sent two passes ago. With two bands it's the band of this pass.
+    const int bands = ne_two_pass_bands;
+    const int band = (ne_two_pass_frame + bands - 2) % bands;
 
-        for (int j = 0; j < 192; j++)
-        {
-            dmaCopy(fb_src, fb_dst, split * sizeof(u16));
-            fb_src += 256;
-            fb_dst += 256;
-        }
-    }
-    else
-    {
-        // Copy the previous right-half capture from VRAM_D
-        const u16 *fb_src = VRAM_D + split;
-        u16 *fb_dst = ne_two_pass_fb[ne_two_pass_displayed ^ 1] + split;
+    int x0, x1;
+    ne_two_pass_band_columns(band, 0, &x0, &x1);
 
-        for (int j = 0; j < 192; j++)
-        {
-            dmaCopy(fb_src, fb_dst, (256 - split) * sizeof(u16));
-            fb_src += 256;
-            fb_dst += 256;
-        }
+    const u16 *fb_src = VRAM_D + x0;
+    u16 *fb_dst = ne_two_pass_fb[ne_two_pass_displayed ^ 1] + x0;
 
-        // Both halves are now filled in the next framebuffer
-        ne_two_pass_next_ready = true;
+    for (int j = 0; j < 192; j++)
+    {
+        dmaCopy(fb_src, fb_dst, (x1 - x0) * sizeof(u16));
+        fb_src += 256;
+        fb_dst += 256;
     }
 
+    // All bands are now filled in the next framebuffer
+    if (band == bands - 1)
+        ne_two_pass_next_ready = true;
+
     ne_two_pass_setup_frustum();
 
     NEA_PolyFormat(31, 0, NEA_LIGHT_ALL, NEA_CULL_BACK, 0);
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_IDENTITY = 0;
 }
 
@@ -1067,6 +1545,7 @@ static void ne_process_two_pass_fifo_dma(void)
 static void ne_process_two_pass_fb(void)
 {
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
 
     if (ne_main_screen == 1)
         lcdMainOnTop();
@@ -1075,6 +1554,9 @@ static void ne_process_two_pass_fb(void)
 
     u32 clearcolor = NEA_ClearColorGet();
 
+    if ((ne_two_pass_frame == 0) && ne_two_pass_adaptive)
+        ne_two_pass_update_split();
+
     if (ne_two_pass_frame == 0)
     {
         // Left pass: submit left-half geometry.
@@ -1136,15 +1618,17 @@ static void ne_process_two_pass_fb(void)
 
     NEA_PolyFormat(31, 0, NEA_LIGHT_ALL, NEA_CULL_BACK, 0);
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_IDENTITY = 0;
 }
 
 static void ne_process_two_pass_end(void)
 {
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_flush_3d(ne_two_pass_frame);
 
-    ne_two_pass_frame ^= 1;
+    ne_two_pass_frame++;
+    if (ne_two_pass_frame >= ne_two_pass_bands)
+        ne_two_pass_frame = 0;
 }
 
 void NEA_ProcessTwoPass(NEA_Voidfunc drawscene)
@@ -1156,7 +1640,15 @@ void NEA_ProcessTwoPass(NEA_Voidfunc drawscene)
     else
         ne_process_two_pass_fifo_dma();
 
-    drawscene();
+    // The render queue may replay the list sorted in the first pass
+    bool replayed = ne_render_queue_replay && ne_render_queue_replay();
+    if (!replayed)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_DRAW);
+        drawscene();
+        NEA_ProfileEnd(NEA_PROFILE_DRAW);
+        ne_render_queue_flush();
+    }
 
     ne_process_two_pass_end();
 }
@@ -1170,14 +1662,71 @@ void NEA_ProcessTwoPassArg(NEA_VoidArgfunc drawscene, void *arg)
     else
         ne_process_two_pass_fifo_dma();
 
-    drawscene(arg);
+    bool replayed = ne_render_queue_replay && ne_render_queue_replay();
+    if (!replayed)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_DRAW);
+        drawscene(arg);
+        NEA_ProfileEnd(NEA_PROFILE_DRAW);
+        ne_render_queue_flush();
+    }
 
     ne_process_two_pass_end();
 }
 
+void NEA_DualFrameRatioSet(int main_frames, int sub_frames)
+{
+    NEA_AssertMinMax(1, main_frames, NEA_DUAL_MAX_FRAMES,
+                     "Invalid number of frames %d", main_frames);
+    NEA_AssertMinMax(0, sub_frames, NEA_DUAL_MAX_FRAMES,
+                     "Invalid number of frames %d", sub_frames);
+
+    ne_dual_frames[1] = main_frames;
+    ne_dual_frames[0] = sub_frames;
+    ne_dual_credit[0] = 0;
+    ne_dual_credit[1] = 0;
+
+    // Draw the sub screen at least once with the new settings
+    ne_dual_sub_dirty = true;
+}
+
+void NEA_DualSubScreenInvalidate(void)
+{
+    ne_dual_sub_dirty = true;
+}
+
+// Returns the screen drawn in this frame. Each screen earns its number of
+// frames every frame, and the screen with the most earned frames is drawn and
+// pays the frames of the whole cycle, so the frames of each screen are spread
+// evenly over the cycle. With one frame each the screens alternate.
+static int ne_dual_next_screen(void)
+{
+    if (ne_dual_sub_dirty)
+    {
+        ne_dual_sub_dirty = false;
+        return 0;
+    }
+
+    if (ne_dual_frames[0] == 0)
+        return 1;
+
+    ne_dual_credit[0] += ne_dual_frames[0];
+    ne_dual_credit[1] += ne_dual_frames[1];
+
+    int screen = (ne_dual_credit[0] >= ne_dual_credit[1]) ? 0 : 1;
+    ne_dual_credit[screen] -= ne_dual_frames[0] + ne_dual_frames[1];
+
+    return screen;
+}
+
+// The registers set up by the dual 3D modes depend on NEA_Screen. The picture
+// drawn in the previous frame is displayed during this one, and NEA_Screen is
+// always the other screen, so the setup matches that picture even if the same
+// screen is drawn in several frames in a row.
 static void ne_process_dual_3d_common_start(void)
 {
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
 
     if (NEA_Screen == ne_main_screen)
         lcdMainOnTop();
@@ -1226,23 +1775,26 @@ static void ne_process_dual_3d_common_start(void)
     MATRIX_IDENTITY = 0;
 }
 
-static void ne_process_dual_3d_common_end(void)
+static void ne_process_dual_3d_common_end(int screen)
 {
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_flush_3d(screen);
 
-    NEA_Screen ^= 1;
+    // The picture of this screen is displayed (and captured) in the next
+    // frame with the setup of the other screen.
+    NEA_Screen = screen ^ 1;
 }
 
 static void ne_process_dual_3d(NEA_Voidfunc mainscreen, NEA_Voidfunc subscreen)
 {
     ne_process_dual_3d_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen();
     else
         subscreen();
 
-    ne_process_dual_3d_common_end();
+    ne_process_dual_3d_common_end(screen);
 }
 
 static void ne_process_dual_3d_arg(NEA_VoidArgfunc mainscreen,
@@ -1251,12 +1803,13 @@ static void ne_process_dual_3d_arg(NEA_VoidArgfunc mainscreen,
 {
     ne_process_dual_3d_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen(argmain);
     else
         subscreen(argsub);
 
-    ne_process_dual_3d_common_end();
+    ne_process_dual_3d_common_end(screen);
 }
 
 #define NEA_DUAL_DMA_3D_LINES_OFFSET 20
@@ -1264,6 +1817,7 @@ static void ne_process_dual_3d_arg(NEA_VoidArgfunc mainscreen,
 static void ne_process_dual_3d_fb_common_start(void)
 {
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
 
     if (NEA_Screen == ne_main_screen)
         lcdMainOnTop();
@@ -1306,23 +1860,26 @@ static void ne_process_dual_3d_fb_common_start(void)
     MATRIX_IDENTITY = 0;
 }
 
-static void ne_process_dual_3d_fb_common_end(void)
+static void ne_process_dual_3d_fb_common_end(int screen)
 {
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_flush_3d(screen);
 
-    NEA_Screen ^= 1;
+    // The picture of this screen is displayed (and captured) in the next
+    // frame with the setup of the other screen.
+    NEA_Screen = screen ^ 1;
 }
 
 static void ne_process_dual_3d_fb(NEA_Voidfunc mainscreen, NEA_Voidfunc subscreen)
 {
     ne_process_dual_3d_fb_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen();
     else
         subscreen();
 
-    ne_process_dual_3d_fb_common_end();
+    ne_process_dual_3d_fb_common_end(screen);
 }
 
 static void ne_process_dual_3d_fb_arg(NEA_VoidArgfunc mainscreen,
@@ -1331,12 +1888,13 @@ static void ne_process_dual_3d_fb_arg(NEA_VoidArgfunc mainscreen,
 {
     ne_process_dual_3d_fb_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen(argmain);
     else
         subscreen(argsub);
 
-    ne_process_dual_3d_fb_common_end();
+    ne_process_dual_3d_fb_common_end(screen);
 }
 
 static void ne_do_dma(void)
@@ -1475,25 +2033,29 @@ static void ne_process_dual_3d_dma_common_start(void)
     }
 }
 
-static void ne_process_dual_3d_dma_common_end(void)
+static void ne_process_dual_3d_dma_common_end(int screen)
 {
-    GFX_FLUSH = GL_TRANS_MANUALSORT | ne_depth_buffer_mode;
+    ne_flush_3d(screen);
 
-    NEA_Screen ^= 1;
+    // The picture of this screen is displayed (and captured) in the next
+    // frame with the setup of the other screen.
+    NEA_Screen = screen ^ 1;
 
     NEA_UpdateInput();
+    NEA_MaterialStateInvalidate();
 }
 
 static void ne_process_dual_3d_dma(NEA_Voidfunc mainscreen, NEA_Voidfunc subscreen)
 {
     ne_process_dual_3d_dma_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen();
     else
         subscreen();
 
-    ne_process_dual_3d_dma_common_end();
+    ne_process_dual_3d_dma_common_end(screen);
 }
 
 static void ne_process_dual_3d_dma_arg(NEA_VoidArgfunc mainscreen,
@@ -1502,12 +2064,13 @@ static void ne_process_dual_3d_dma_arg(NEA_VoidArgfunc mainscreen,
 {
     ne_process_dual_3d_dma_common_start();
 
-    if (NEA_Screen == 1)
+    int screen = ne_dual_next_screen();
+    if (screen == 1)
         mainscreen(argmain);
     else
         subscreen(argsub);
 
-    ne_process_dual_3d_dma_common_end();
+    ne_process_dual_3d_dma_common_end(screen);
 }
 
 void NEA_ProcessDual(NEA_Voidfunc mainscreen, NEA_Voidfunc subscreen)
@@ -1610,14 +2173,120 @@ static bool NEA_effectpause;
 #define NEA_NOISEPAUSE_SIZE 512
 static int *ne_noisepause;
 static int ne_cpucount;
+static volatile u32 ne_vbl_count;
 static int ne_noise_value = 0xF;
 static int ne_sine_mult = 10, ne_sine_shift = 9;
 
+// Effects copied by HBL DMA. The value of the first line is written during the
+// VBL, and the DMA copies one value after each line: 192 values plus the one
+// written after the last line.
+#define NE_EFFECT_DMA_CHANNEL 1
+#define NE_EFFECT_LINES 193
+static bool ne_effect_dma;
+static u16 *ne_effect_table; // NEA_NOISE and NEA_SINE values, with wrap-around
+static int ne_effect_offset;
+static u16 ne_effect_lines[NE_EFFECT_LINES]; // Copy of the NEA_TABLE values
+static const u16 *ne_effect_user;
+static vu16 *ne_effect_reg;
+
+static void ne_effect_dma_stop(void)
+{
+#ifdef NEA_BLOCKSDS
+    dmaStopSafe(NE_EFFECT_DMA_CHANNEL);
+#else
+    DMA_CR(NE_EFFECT_DMA_CHANNEL) = 0;
+#endif
+}
+
+// Precalculates the values of NEA_NOISE and NEA_SINE for all the positions of
+// NEA_lastvbladd. The first lines are repeated at the end so that the values of
+// a frame are always contiguous.
+static void ne_effect_build_table(void)
+{
+    if (!ne_effect_dma || (NEA_Effect != NEA_NOISE && NEA_Effect != NEA_SINE))
+        return;
+
+    if (ne_effect_table == NULL)
+    {
+        ne_effect_table = malloc((NEA_NOISEPAUSE_SIZE + NE_EFFECT_LINES)
+                                 * sizeof(u16));
+        if (ne_effect_table == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return;
+        }
+    }
+
+    for (int i = 0; i < NEA_NOISEPAUSE_SIZE; i++)
+    {
+        if (NEA_Effect == NEA_NOISE)
+        {
+            ne_effect_table[i] = (rand() & ne_noise_value)
+                               - (ne_noise_value >> 1);
+        }
+        else
+        {
+            s16 angle = i * ne_sine_mult;
+            ne_effect_table[i] = sinLerp(angle << 6) >> ne_sine_shift;
+        }
+    }
+
+    for (int i = 0; i < NE_EFFECT_LINES; i++)
+        ne_effect_table[NEA_NOISEPAUSE_SIZE + i] = ne_effect_table[i];
+
+    DC_FlushRange(ne_effect_table,
+                  (NEA_NOISEPAUSE_SIZE + NE_EFFECT_LINES) * sizeof(u16));
+}
+
+static void ne_effect_dma_start(void)
+{
+    const u16 *src;
+
+    if (NEA_Effect == NEA_TABLE)
+    {
+        memcpy(ne_effect_lines, ne_effect_user,
+               (NE_EFFECT_LINES - 1) * sizeof(u16));
+        ne_effect_lines[NE_EFFECT_LINES - 1] =
+            ne_effect_lines[NE_EFFECT_LINES - 2];
+        DC_FlushRange(ne_effect_lines, sizeof(ne_effect_lines));
+        src = ne_effect_lines;
+    }
+    else if (ne_effect_table != NULL)
+    {
+        if (NEA_Effect == NEA_SINE)
+            ne_effect_offset = NEA_lastvbladd;
+        else if (!NEA_effectpause)
+            ne_effect_offset = rand() & (NEA_NOISEPAUSE_SIZE - 1);
+        src = ne_effect_table + ne_effect_offset;
+    }
+    else
+    {
+        return;
+    }
+
+    ne_effect_dma_stop();
+
+    *ne_effect_reg = src[0];
+
+    uint32_t cr = DMA_COPY_HALFWORDS | 1 | DMA_START_HBL | DMA_REPEAT
+                | DMA_SRC_INC | DMA_DST_FIX;
+
+#ifdef NEA_BLOCKSDS
+    dmaSetParams(NE_EFFECT_DMA_CHANNEL, src + 1, (void *)ne_effect_reg, cr);
+#else
+    DMA_SRC(NE_EFFECT_DMA_CHANNEL) = (uint32_t)(src + 1);
+    DMA_DEST(NE_EFFECT_DMA_CHANNEL) = (uint32_t)ne_effect_reg;
+    DMA_CR(NE_EFFECT_DMA_CHANNEL) = cr;
+#endif
+}
+
 void NEA_VBLFunc(void)
 {
     if (ne_execution_mode == NEA_ModeUninitialized)
         return;
 
+    ne_vbl_count++;
+
     if (ne_dma_enabled)
     {
         // The first line of the sub screen must be set to black during VBL
@@ -1713,6 +2382,10 @@ void NEA_VBLFunc(void)
         if (!NEA_effectpause)
             NEA_lastvbladd = (NEA_lastvbladd + 1) & (NEA_NOISEPAUSE_SIZE - 1);
     }
+
+    if (NEA_Effect == NEA_TABLE ||
+        (ne_effect_dma && NEA_Effect != NEA_NONE))
+        ne_effect_dma_start();
 }
 
 void NEA_SpecialEffectPause(bool pause)
@@ -1763,6 +2436,10 @@ void NEA_HBLFunc(void)
     if (vcount == 262)
         vcount = 0;
 
+    // Effects copied by DMA don't need to do anything here
+    if (ne_effect_dma)
+        return;
+
     switch (NEA_Effect)
     {
         case NEA_NOISE:
@@ -1786,62 +2463,308 @@ void NEA_HBLFunc(void)
 void NEA_SpecialEffectNoiseConfig(int value)
 {
     ne_noise_value = value;
+    ne_effect_build_table();
 }
 
 void NEA_SpecialEffectSineConfig(int mult, int shift)
 {
     ne_sine_mult = mult;
     ne_sine_shift = shift;
+    ne_effect_build_table();
 }
 
 void NEA_SpecialEffectSet(NEA_SpecialEffects effect)
 {
+    NEA_Assert(effect != NEA_TABLE, "Use NEA_SpecialEffectTableSet()");
+
+    ne_effect_dma_stop();
+    if (NEA_Effect == NEA_TABLE)
+        ne_effect_dma = false;
+
     NEA_Effect = effect;
+    ne_effect_reg = &REG_BG0HOFS;
 
     if (effect == NEA_NONE)
+    {
         REG_BG0HOFS = 0;
+        free(ne_effect_table);
+        ne_effect_table = NULL;
+    }
+    else
+    {
+        ne_effect_build_table();
+    }
+}
+
+void NEA_SpecialEffectDMA(bool enable)
+{
+    ne_effect_dma = enable;
+
+    if (NEA_Effect == NEA_TABLE)
+        return;
+
+    ne_effect_dma_stop();
+    ne_effect_build_table();
+}
+
+void NEA_SpecialEffectTableSet(vu16 *reg, const u16 *table)
+{
+    NEA_AssertPointer(reg, "NULL register pointer");
+    NEA_AssertPointer(table, "NULL table pointer");
+
+    ne_effect_dma_stop();
+
+    NEA_Effect = NEA_TABLE;
+    ne_effect_dma = true;
+    ne_effect_reg = reg;
+    ne_effect_user = table;
 }
 
 static int NEA_CPUPercent;
 
+// Fixed timestep of the animations and physics. The accumulator counts the
+// vertical blanks that haven't been simulated yet.
+static int ne_fixed_step_vbls; // 0 if the fixed timestep is disabled
+static int ne_fixed_step_max = NEA_FIXED_STEP_DEFAULT_MAX;
+static int ne_fixed_step_acc;
+static int ne_fixed_step_count = 1;
+static u32 ne_fixed_step_last_vbl;
+static bool ne_fixed_step_started;
+
+void NEA_FixedStepSet(int vbls_per_step, int max_steps)
+{
+    if (vbls_per_step < 0)
+        vbls_per_step = 0;
+    if (max_steps < 1)
+        max_steps = NEA_FIXED_STEP_DEFAULT_MAX;
+
+    ne_fixed_step_vbls = vbls_per_step;
+    ne_fixed_step_max = max_steps;
+    ne_fixed_step_acc = 0;
+    ne_fixed_step_started = false;
+}
+
+int NEA_FixedStepGetSteps(void)
+{
+    return ne_fixed_step_count;
+}
+
+int32_t NEA_FixedStepGetAlpha(void)
+{
+    if (ne_fixed_step_vbls == 0)
+        return 0;
+
+    return (ne_fixed_step_acc << 12) / ne_fixed_step_vbls;
+}
+
+// Internal use... see NEARigidBody.c
+//
+// Time in scanlines, counted from the first vertical blank. It only advances
+// by whole frames if NEA_VBLFunc() is the VBL interrupt handler.
+u32 ne_scanline_time(void)
+{
+    u32 vbl, vcount;
+
+    do
+    {
+        vbl = ne_vbl_count;
+        vcount = REG_VCOUNT;
+    }
+    while (vbl != ne_vbl_count);
+
+    // ne_vbl_count is increased at the start of the vertical blank
+    vcount = (vcount + 263 - 192) % 263;
+
+    return vbl * 263 + vcount;
+}
+
+// Returns the number of steps to simulate in this call to NEA_WaitForVBL()
+static int ne_fixed_step_advance(void)
+{
+    if (ne_fixed_step_vbls == 0)
+        return 1;
+
+    u32 now = ne_vbl_count;
+
+    // Simulate one step right away when the timestep is enabled
+    if (!ne_fixed_step_started)
+    {
+        ne_fixed_step_started = true;
+        ne_fixed_step_last_vbl = now;
+        ne_fixed_step_acc = ne_fixed_step_vbls;
+    }
+
+    u32 elapsed = now - ne_fixed_step_last_vbl;
+    ne_fixed_step_last_vbl = now;
+
+    // Don't let the accumulator overflow if the game has been stopped
+    u32 limit = (u32)ne_fixed_step_vbls * (ne_fixed_step_max + 1);
+    if (elapsed > limit)
+        elapsed = limit;
+
+    ne_fixed_step_acc += elapsed;
+
+    int steps = ne_fixed_step_acc / ne_fixed_step_vbls;
+    ne_fixed_step_acc -= steps * ne_fixed_step_vbls;
+
+    // Drop the time that can't be simulated, or the game would never catch up
+    if (steps > ne_fixed_step_max)
+        steps = ne_fixed_step_max;
+
+    return steps;
+}
+
+// Length of a frame in scanlines
+#define NE_PACING_FRAME_LINES 263
+
+static int ne_pacing_interval = 1;
+static u32 ne_pacing_start; // Time when the work of the frame started
+static u16 ne_pacing_history[NEA_FRAME_PACING_HISTORY]; // Drawn frames (lines)
+static int ne_pacing_count;
+static int ne_pacing_next;
+
+void NEA_FramePacingSet(bool enable)
+{
+    ne_pacing_enabled = enable;
+    ne_pacing_interval = 1;
+    ne_pacing_draw = true;
+    ne_pacing_drawn = false;
+    ne_pacing_count = 0;
+    ne_pacing_next = 0;
+    ne_pacing_start = ne_scanline_time();
+}
+
+int NEA_FramePacingGetInterval(void)
+{
+    return ne_pacing_enabled ? ne_pacing_interval : 1;
+}
+
+bool NEA_FramePacingWillDraw(void)
+{
+    return !ne_pacing_enabled || ne_pacing_draw;
+}
+
+// Called before waiting for the vertical blank. It measures the time spent in
+// the frame and decides if the next one is drawn.
+static void ne_pacing_frame_end(void)
+{
+    u32 work = ne_scanline_time() - ne_pacing_start;
+    bool late = work > NE_PACING_FRAME_LINES;
+
+    // Only drawn frames show the real cost of a frame
+    if (ne_pacing_drawn)
+    {
+        if (work > UINT16_MAX)
+            work = UINT16_MAX;
+
+        ne_pacing_history[ne_pacing_next] = work;
+        ne_pacing_next = (ne_pacing_next + 1) % NEA_FRAME_PACING_HISTORY;
+        if (ne_pacing_count < NEA_FRAME_PACING_HISTORY)
+            ne_pacing_count++;
+    }
+
+    int overruns = 0;
+    u32 peak = 0;
+    for (int i = 0; i < ne_pacing_count; i++)
+    {
+        if (ne_pacing_history[i] > NE_PACING_FRAME_LINES)
+            overruns++;
+        if (ne_pacing_history[i] > peak)
+            peak = ne_pacing_history[i];
+    }
+
+    // Lock to 30 FPS if the game is slow for a while, and only go back to 60
+    // FPS when all the frames of the history would fit with some margin.
+    if (ne_pacing_interval == 1 && overruns >= NEA_FRAME_PACING_OVERLOAD)
+    {
+        ne_pacing_interval = 2;
+        ne_pacing_count = 0;
+        ne_pacing_next = 0;
+    }
+    else if (ne_pacing_interval == 2 &&
+             ne_pacing_count == NEA_FRAME_PACING_HISTORY &&
+             peak < NE_PACING_FRAME_LINES * 3 / 4)
+    {
+        ne_pacing_interval = 1;
+        ne_pacing_count = 0;
+        ne_pacing_next = 0;
+    }
+
+    if (ne_pacing_interval == 2)
+        ne_pacing_draw = !ne_pacing_draw;
+    else // Skip one frame after a late one to catch up, but never two in a row
+        ne_pacing_draw = !late || !ne_pacing_drawn;
+
+    ne_pacing_drawn = false;
+}
+
 void NEA_WaitForVBL(NEA_UpdateFlags flags)
 {
     if (flags & NEA_UPDATE_GUI)
     {
         NEA_GUIUpdate();
     }
-    if (flags & NEA_UPDATE_ANIMATIONS)
-        NEA_ModelAnimateAll();
-    if (flags & NEA_UPDATE_PHYSICS)
-        NEA_PhysicsUpdateAll();
+
+    ne_fixed_step_count = ne_fixed_step_advance();
+    for (int i = 0; i < ne_fixed_step_count; i++)
+    {
+        if (flags & NEA_UPDATE_ANIMATIONS)
+        {
+            NEA_ProfileBegin(NEA_PROFILE_ANIMATIONS);
+            NEA_ModelAnimateAll();
+            NEA_ProfileEnd(NEA_PROFILE_ANIMATIONS);
+        }
+        if (flags & NEA_UPDATE_PHYSICS)
+        {
+            NEA_ProfileBegin(NEA_PROFILE_PHYSICS);
+            NEA_PhysicsUpdateAll();
+            NEA_ProfileEnd(NEA_PROFILE_PHYSICS);
+        }
+    }
     // Weak reference: if user code links NEASound (by calling any NEA_Sound*
     // function), the strong definition is pulled from the archive and used.
     // Otherwise this resolves to NULL and the call is safely skipped.
     // This avoids forcing -lmm9 on examples that don't use sound.
     extern void NEA_SoundUpdateAll(void) __attribute__((weak));
     if ((flags & NEA_UPDATE_SOUND) && NEA_SoundUpdateAll)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_SOUND);
         NEA_SoundUpdateAll();
+        NEA_ProfileEnd(NEA_PROFILE_SOUND);
+    }
 
     // Weak reference: animated material update is only linked when
     // the user calls any NEA_AnimMat* function.
     extern void NEA_AnimMatUpdateAll(void) __attribute__((weak));
     if ((flags & NEA_UPDATE_ANIM_MAT) && NEA_AnimMatUpdateAll)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_ANIM_MAT);
         NEA_AnimMatUpdateAll();
+        NEA_ProfileEnd(NEA_PROFILE_ANIM_MAT);
+    }
 
     // Weak reference: rigid body sync is only linked when
     // the user calls any NEA_RigidBody* function.
     extern void NEA_RigidBodySync(void) __attribute__((weak));
     if ((flags & NEA_UPDATE_RIGIDBODY) && NEA_RigidBodySync)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_RIGIDBODY);
         NEA_RigidBodySync();
+        NEA_ProfileEnd(NEA_PROFILE_RIGIDBODY);
+    }
 
-    // Weak reference: Hw2D OAM flush is only linked when
-    // the user calls any NEA_Hw2D* function.
-    extern void NEA_Hw2DOBJUpdateAll(void) __attribute__((weak));
-    if ((flags & NEA_UPDATE_HW2D) && NEA_Hw2DOBJUpdateAll)
-        NEA_Hw2DOBJUpdateAll();
+    // Weak reference: particle update is only linked when
+    // the user calls any NEA_Particle* function.
+    extern void NEA_ParticleUpdateAll(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_PARTICLES) && NEA_ParticleUpdateAll)
+    {
+        NEA_ProfileBegin(NEA_PROFILE_PARTICLES);
+        NEA_ParticleUpdateAll();
+        NEA_ProfileEnd(NEA_PROFILE_PARTICLES);
+    }
 
     NEA_CPUPercent = div32(ne_cpucount * 100, 263);
-    if (flags & NEA_CAN_SKIP_VBL)
+    if ((flags & NEA_CAN_SKIP_VBL) && !ne_pacing_enabled)
     {
         if (NEA_CPUPercent > 100)
         {
@@ -1852,8 +2775,82 @@ void NEA_WaitForVBL(NEA_UpdateFlags flags)
         }
     }
 
+    if (ne_pacing_enabled)
+        ne_pacing_frame_end();
+
+    // Weak reference: the job scheduler is only linked if the user uses it.
+    // The time until the vertical blank would be wasted otherwise.
+    extern void ne_job_before_vbl(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_JOBS) && ne_job_before_vbl)
+        ne_job_before_vbl();
+
+    NEA_ProfileBegin(NEA_PROFILE_VBL_WAIT);
     swiWaitForVBlank();
+    NEA_ProfileEnd(NEA_PROFILE_VBL_WAIT);
     ne_cpucount = 0;
+    ne_pacing_start = ne_scanline_time();
+
+    // The display and capture registers of impostor refreshes are changed
+    // when the new frame starts.
+    if (ne_impostor_vblank)
+        ne_impostor_vblank();
+
+    // Everything allocated from the frame arena belongs to the previous frame
+    ne_arena_frame_end();
+
+    if (ne_gpu_stats_enabled)
+        ne_gpu_stats_frame_end();
+
+    // The updates of the vertical blank are counted in the next frame
+    NEA_ProfileFrameEnd();
+
+    // The replay saves the statistics of the frame that has just ended
+    if (ne_replay_frame_end)
+        ne_replay_frame_end();
+
+    NEA_ProfileBegin(NEA_PROFILE_VBL_UPDATES);
+
+    // Weak reference: Hw2D OAM flush is only linked when
+    // the user calls any NEA_Hw2D* function. OAM can only be written safely
+    // during the vertical blank, and only the modified entries are copied.
+    extern void NEA_Hw2DOBJUpdateAll(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_HW2D) && NEA_Hw2DOBJUpdateAll)
+        NEA_Hw2DOBJUpdateAll();
+
+    // Weak reference: map streaming of Hw2D backgrounds. The new tiles are
+    // written at the same time as the scroll registers.
+    extern void NEA_Hw2DBGUpdateAll(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_HW2D) && NEA_Hw2DBGUpdateAll)
+        NEA_Hw2DBGUpdateAll();
+
+    // The 3D engine doesn't read textures during the start of the vertical
+    // blank, so this is the best moment to upload or move them.
+    if (flags & NEA_UPDATE_UPLOADS)
+    {
+        NEA_UploadUpdate();
+        NEA_PaletteQueueUpdate();
+    }
+    if (flags & NEA_UPDATE_TEXTURE_STREAM)
+        NEA_TextureStreamUpdate(NEA_TEXTURE_STREAM_STEP_BYTES);
+    if (flags & NEA_UPDATE_TEXTURE_DEFRAG)
+        NEA_TextureDefragMemStep(NEA_TEXTURE_DEFRAG_STEP_BYTES);
+    if (flags & NEA_UPDATE_PALETTE_DEFRAG)
+        NEA_PaletteDefragMemStep(NEA_PALETTE_DEFRAG_STEP_BYTES);
+
+    // Reading files doesn't need VRAM, so it's done after everything else. The
+    // audio stream goes first, running out of samples can be heard.
+    extern size_t NEA_StreamUpdate(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_AUDIO_STREAM) && NEA_StreamUpdate)
+        NEA_StreamUpdate();
+    if (flags & NEA_UPDATE_LOADER)
+        NEA_LoaderUpdate();
+
+    // Weak reference: frame captures are only linked if the user uses them
+    extern void NEA_CaptureUpdate(void) __attribute__((weak));
+    if ((flags & NEA_UPDATE_CAPTURE) && NEA_CaptureUpdate)
+        NEA_CaptureUpdate();
+
+    NEA_ProfileEnd(NEA_PROFILE_VBL_UPDATES);
 }
 
 int NEA_GetCPUPercent(void)
@@ -1902,13 +2899,15 @@ static int ne_vertexcount;
 
 void NEA_TouchTestStart(void)
 {
+    NEA_DisplayListWait();
+
     // Hide what we are going to draw
     GFX_VIEWPORT = 255 | (255 << 8) | (255 << 16) | (255 << 24);
 
     // Save current state
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_PUSH = 0;
-    MATRIX_CONTROL = GL_PROJECTION;
+    ne_material_state_matrix_mode(GL_PROJECTION);
     MATRIX_PUSH = 0;
 
     // Setup temporary render environment
@@ -1926,7 +2925,7 @@ void NEA_TouchTestStart(void)
     gluPerspectivef32(fov * DEGREES_IN_CIRCLE / 360, NEA_screenratio,
                       ne_znear, ne_zfar);
 
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 
     NEA_Assert(!NEA_TestTouch, "Test already active");
 
@@ -1937,6 +2936,9 @@ void NEA_TouchTestObject(void)
 {
     NEA_Assert(NEA_TestTouch, "No active test");
 
+    // The position test may still be in a list that is being sent
+    NEA_DisplayListWait();
+
     // Wait for the position test to finish
     while (PosTestBusy());
 
@@ -1951,6 +2953,8 @@ int NEA_TouchTestResult(void)
 {
     NEA_Assert(NEA_TestTouch, "No active test");
 
+    NEA_DisplayListWait();
+
     // Wait for geometry engine operations to end
     while (GFX_STATUS & BIT(27));
 
@@ -1970,12 +2974,14 @@ void NEA_TouchTestEnd(void)
 
     NEA_TestTouch = false;
 
+    NEA_DisplayListWait();
+
     // Reset the viewport
     GFX_VIEWPORT = NEA_viewport;
 
     // Restore previous state
-    MATRIX_CONTROL = GL_PROJECTION;
+    ne_material_state_matrix_mode(GL_PROJECTION);
     MATRIX_POP = 1;
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
     MATRIX_POP = 1;
 }
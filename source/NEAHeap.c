@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include <malloc.h>
+
+#include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+
+/// @file NEAHeap.c
+
+static NEA_HeapStats ne_heap_stats[NEA_HEAP_TAG_COUNT];
+
+static const char *ne_heap_names[NEA_HEAP_TAG_COUNT] = {
+    [NEA_HEAP_MODEL] = "Model",
+    [NEA_HEAP_SCENE] = "Scene",
+    [NEA_HEAP_COLLISION] = "Collision",
+    [NEA_HEAP_ANIMATION] = "Animation",
+    [NEA_HEAP_SOUND] = "Sound",
+    [NEA_HEAP_TEXT] = "Text",
+    [NEA_HEAP_LOADER] = "Loader",
+};
+
+#define NE_HEAP_CHECK(tag)                                                \
+    NEA_AssertMinMax(0, tag, NEA_HEAP_TAG_COUNT - 1, "Invalid tag %d", tag)
+
+static void ne_heap_add(NEA_HeapTag tag, void *ptr)
+{
+    NEA_HeapStats *s = &ne_heap_stats[tag];
+
+    if (ptr == NULL)
+    {
+        s->failures++;
+        return;
+    }
+
+    s->current += malloc_usable_size(ptr);
+    s->count++;
+    s->allocs++;
+
+    if (s->current > s->peak)
+        s->peak = s->current;
+}
+
+void ne_heap_track(NEA_HeapTag tag, void *ptr)
+{
+    NE_HEAP_CHECK(tag);
+
+    if (ptr != NULL)
+        ne_heap_add(tag, ptr);
+}
+
+void ne_heap_untrack(NEA_HeapTag tag, const void *ptr)
+{
+    NE_HEAP_CHECK(tag);
+
+    if (ptr == NULL)
+        return;
+
+    NEA_HeapStats *s = &ne_heap_stats[tag];
+    size_t size = malloc_usable_size((void *)ptr);
+
+    NEA_Assert((s->count > 0) && (s->current >= size),
+               "Block not allocated by tag %d", tag);
+
+    s->current -= size;
+    s->count--;
+}
+
+void *ne_heap_malloc(NEA_HeapTag tag, size_t size)
+{
+    NE_HEAP_CHECK(tag);
+
+    void *ptr = malloc(size);
+    ne_heap_add(tag, ptr);
+    return ptr;
+}
+
+void *ne_heap_calloc(NEA_HeapTag tag, size_t count, size_t size)
+{
+    NE_HEAP_CHECK(tag);
+
+    void *ptr = calloc(count, size);
+    ne_heap_add(tag, ptr);
+    return ptr;
+}
+
+void *ne_heap_realloc(NEA_HeapTag tag, void *ptr, size_t size)
+{
+    NE_HEAP_CHECK(tag);
+
+    if (size == 0)
+    {
+        ne_heap_free(tag, ptr);
+        return NULL;
+    }
+
+    // The old block is only freed if the new one can be allocated, so it can't
+    // stop being counted until realloc() returns.
+    size_t old_size = (ptr != NULL) ? malloc_usable_size(ptr) : 0;
+
+    void *new_ptr = realloc(ptr, size);
+    if (new_ptr == NULL)
+    {
+        ne_heap_stats[tag].failures++;
+        return NULL;
+    }
+
+    NEA_HeapStats *s = &ne_heap_stats[tag];
+
+    if (ptr != NULL)
+    {
+        s->current -= old_size;
+        s->count--;
+    }
+
+    ne_heap_add(tag, new_ptr);
+    return new_ptr;
+}
+
+char *ne_heap_strdup(NEA_HeapTag tag, const char *str)
+{
+    NE_HEAP_CHECK(tag);
+
+    char *ptr = strdup(str);
+    ne_heap_add(tag, ptr);
+    return ptr;
+}
+
+void ne_heap_free(NEA_HeapTag tag, void *ptr)
+{
+    ne_heap_untrack(tag, ptr);
+    free(ptr);
+}
+
+void NEA_HeapGetStats(NEA_HeapTag tag, NEA_HeapStats *stats)
+{
+    NE_HEAP_CHECK(tag);
+    NEA_AssertPointer(stats, "NULL stats pointer");
+
+    *stats = ne_heap_stats[tag];
+}
+
+void NEA_HeapGetTotalStats(NEA_HeapStats *stats)
+{
+    NEA_AssertPointer(stats, "NULL stats pointer");
+
+    memset(stats, 0, sizeof(NEA_HeapStats));
+
+    for (int i = 0; i < NEA_HEAP_TAG_COUNT; i++)
+    {
+        const NEA_HeapStats *s = &ne_heap_stats[i];
+
+        stats->current += s->current;
+        stats->peak += s->peak;
+        stats->count += s->count;
+        stats->allocs += s->allocs;
+        stats->failures += s->failures;
+    }
+}
+
+void NEA_HeapResetStats(void)
+{
+    for (int i = 0; i < NEA_HEAP_TAG_COUNT; i++)
+    {
+        NEA_HeapStats *s = &ne_heap_stats[i];
+
+        s->peak = s->current;
+        s->allocs = 0;
+        s->failures = 0;
+    }
+}
+
+const char *NEA_HeapGetTagName(NEA_HeapTag tag)
+{
+    NE_HEAP_CHECK(tag);
+
+    return ne_heap_names[tag];
+}
+
+void NEA_HeapFormat(char *buffer, size_t size)
+{
+    NEA_AssertPointer(buffer, "NULL buffer");
+
+    if (size == 0)
+        return;
+
+    buffer[0] = '\0';
+    size_t used = 0;
+
+    for (int i = 0; i < NEA_HEAP_TAG_COUNT; i++)
+    {
+        const NEA_HeapStats *s = &ne_heap_stats[i];
+
+        int ret = snprintf(buffer + used, size - used,
+                           "%-10s %5u %5u %5u\n", ne_heap_names[i],
+                           (unsigned int)(s->current / 1024),
+                           (unsigned int)(s->peak / 1024),
+                           (unsigned int)s->count);
+        if ((ret < 0) || ((size_t)ret >= size - used))
+            break;
+
+        used += ret;
+    }
+}
+
+void NEA_HeapPrint(void)
+{
+    char buffer[NEA_HEAP_TAG_COUNT * 32];
+    NEA_HeapFormat(buffer, sizeof(buffer));
+
+    printf("System        KB  Peak Count\n%s", buffer);
+}
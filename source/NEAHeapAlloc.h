@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_HEAP_ALLOC_H__
+#define NEA_HEAP_ALLOC_H__
+
+#include "NEAHeap.h"
+
+// Wrappers of the allocation functions of the C library that count the memory
+// used by each system of the engine. See NEA_HeapGetStats().
+//
+// A block must be freed with the same tag that was used to allocate it. If a
+// block is given to another system or to the game, ne_heap_untrack() must be
+// called so that the block stops being counted, and the new owner will free
+// it with free(). ne_heap_track() starts counting a block allocated with
+// malloc() that a system has become the owner of, like the data returned by
+// NEA_FATLoadData(), which must then be freed with ne_heap_free().
+
+void *ne_heap_malloc(NEA_HeapTag tag, size_t size);
+void *ne_heap_calloc(NEA_HeapTag tag, size_t count, size_t size);
+void *ne_heap_realloc(NEA_HeapTag tag, void *ptr, size_t size);
+char *ne_heap_strdup(NEA_HeapTag tag, const char *str);
+void ne_heap_free(NEA_HeapTag tag, void *ptr);
+void ne_heap_track(NEA_HeapTag tag, void *ptr);
+void ne_heap_untrack(NEA_HeapTag tag, const void *ptr);
+
+#endif // NEA_HEAP_ALLOC_H__
@@ -9,16 +9,32 @@
 
 /// @file NEAHw2D.c
 
+// Internal use... see NEAFAT.c and NEAArena.c
+char *ne_fat_load_data_temp(const char *filename);
+void ne_arena_temp_free(void *ptr);
+
 // ---------------------------------------------------------------------------
 // Internal state
 // ---------------------------------------------------------------------------
 
 #define NEA_HW2D_MAX_OAM 128
 
+// Internal use... see NEA2D.c
+void ne_sprite_hw2d_forget(void);
+
+// Internal use... see NEATexture.c and NEAImpostor.c
+NEA_VRAMBankFlags ne_texture_used_banks(void);
+bool ne_impostor_uses_vram_d(void) __attribute__((weak));
+
+// Internal use... see NEAMemReport.c
+void ne_mem_report_failure(NEA_MemPool pool, size_t size);
+void ne_mem_report_add_free_block(NEA_MemReport *report, size_t size);
+
 static struct {
     bool initialized;
     NEA_Hw2DVRAMConfig vram_config;
     NEA_VRAMBankFlags claimed_banks;
+    NEA_VRAMBankFlags borrowed_banks; // Claimed banks taken from textures
 
     NEA_Hw2DBG bgs_main[4];
     NEA_Hw2DBG bgs_sub[4];
@@ -34,76 +50,91 @@ static struct {
     int next_oam_main;
     int next_oam_sub;
 
+    // Range of OAM entries modified since the last upload, per engine. It is
+    // empty if the first entry is bigger than the last one.
+    int oam_dirty_first[2];
+    int oam_dirty_last[2];
+
+    // Bytes of streamed OBJ frames copied per frame, and next sprite to check
+    // (main engine sprites first, then sub engine sprites).
+    size_t obj_stream_budget;
+    int obj_stream_next;
+
     bool main_obj_inited;
     bool sub_obj_inited;
     bool main_has_bitmap;
 } ne_hw2d_state;
 
+// Adds a range of OAM entries to the ones uploaded by NEA_Hw2DOBJUpdate()
+static void ne_hw2d_oam_mark(NEA_Hw2DEngine engine, int first, int last)
+{
+    if (first < ne_hw2d_state.oam_dirty_first[engine])
+        ne_hw2d_state.oam_dirty_first[engine] = first;
+    if (last > ne_hw2d_state.oam_dirty_last[engine])
+        ne_hw2d_state.oam_dirty_last[engine] = last;
+}
+
 // ---------------------------------------------------------------------------
 // Phase 1: System initialization
 // ---------------------------------------------------------------------------
 
-int NEA_Hw2DInit(const NEA_Hw2DVRAMConfig *config)
+// Checks that no bank is assigned to multiple fields and that all the banks can
+// be used for their fields. Returns 0 if the configuration is valid, -1 if not.
+static int ne_hw2d_check_config(const NEA_Hw2DVRAMConfig *config)
 {
-    if (ne_hw2d_state.initialized)
-        NEA_Hw2DSystemEnd();
-
-    NEA_AssertPointer(config, "NEA_Hw2DInit: NULL config");
-
-    memset(&ne_hw2d_state, 0, sizeof(ne_hw2d_state));
-    ne_hw2d_state.vram_config = *config;
-
     NEA_VRAMBankFlags mb = config->main_bg;
     NEA_VRAMBankFlags mo = config->main_obj;
     NEA_VRAMBankFlags sb = config->sub_bg;
     NEA_VRAMBankFlags so = config->sub_obj;
 
     // Check that no bank is assigned to multiple fields
-    NEA_VRAMBankFlags all = mb | mo | sb | so;
     NEA_VRAMBankFlags overlap = 0;
     overlap |= (mb & mo) | (mb & sb) | (mb & so);
     overlap |= (mo & sb) | (mo & so);
     overlap |= (sb & so);
     if (overlap)
     {
-        NEA_DebugPrint("NEA_Hw2DInit: VRAM bank assigned to multiple fields");
+        NEA_DebugPrint("VRAM bank assigned to multiple fields");
         return -1;
     }
 
     // Validate main BG banks (valid: A, B, C, E)
     if (mb & ~(NEA_VRAM_A | NEA_VRAM_B | NEA_VRAM_C | NEA_VRAM_E))
     {
-        NEA_DebugPrint("NEA_Hw2DInit: Invalid main_bg banks");
+        NEA_DebugPrint("Invalid main_bg banks");
         return -1;
     }
 
     // Validate main OBJ banks (valid: A, B, E)
     if (mo & ~(NEA_VRAM_A | NEA_VRAM_B | NEA_VRAM_E))
     {
-        NEA_DebugPrint("NEA_Hw2DInit: Invalid main_obj banks");
+        NEA_DebugPrint("Invalid main_obj banks");
         return -1;
     }
 
     // Validate sub BG banks (valid: C, H, I)
     if (sb & ~(NEA_VRAM_C | NEA_VRAM_H | NEA_VRAM_I))
     {
-        NEA_DebugPrint("NEA_Hw2DInit: Invalid sub_bg banks");
+        NEA_DebugPrint("Invalid sub_bg banks");
         return -1;
     }
 
     // Validate sub OBJ banks (valid: D, I)
     if (so & ~(NEA_VRAM_D | NEA_VRAM_I))
     {
-        NEA_DebugPrint("NEA_Hw2DInit: Invalid sub_obj banks");
+        NEA_DebugPrint("Invalid sub_obj banks");
         return -1;
     }
 
-    // --- Configure VRAM banks ---
+    return 0;
+}
 
-    // If bank E is claimed for 2D, remove it from texture palette duty.
-    // This prevents ne_init_registers() from re-assigning it on future inits.
-    if ((mb | mo) & NEA_VRAM_E)
-        NEA_SetTexPaletteBank(0);
+static void ne_hw2d_map_banks(const NEA_Hw2DVRAMConfig *config)
+{
+    NEA_VRAMBankFlags mb = config->main_bg;
+    NEA_VRAMBankFlags mo = config->main_obj;
+    NEA_VRAMBankFlags sb = config->sub_bg;
+    NEA_VRAMBankFlags so = config->sub_obj;
 
     // Main BG
     if (mb & NEA_VRAM_A)
@@ -136,10 +167,31 @@ int NEA_Hw2DInit(const NEA_Hw2DVRAMConfig *config)
         vramSetBankD(VRAM_D_SUB_SPRITE);
     if (so & NEA_VRAM_I)
         vramSetBankI(VRAM_I_SUB_SPRITE);
+}
 
-    ne_hw2d_state.claimed_banks = all;
+static void ne_hw2d_unmap_banks(NEA_VRAMBankFlags banks)
+{
+    if (banks & NEA_VRAM_A)
+        vramSetBankA(VRAM_A_LCD);
+    if (banks & NEA_VRAM_B)
+        vramSetBankB(VRAM_B_LCD);
+    if (banks & NEA_VRAM_C)
+        vramSetBankC(VRAM_C_LCD);
+    if (banks & NEA_VRAM_D)
+        vramSetBankD(VRAM_D_LCD);
+    if (banks & NEA_VRAM_E)
+        vramSetBankE(VRAM_E_LCD);
+    if (banks & NEA_VRAM_H)
+        vramSetBankH(VRAM_H_LCD);
+    if (banks & NEA_VRAM_I)
+        vramSetBankI(VRAM_I_LCD);
+}
 
-    // --- Configure video modes ---
+// Sets up OAM for the OBJ spaces that have banks and haven't been set up yet,
+// and the video mode of the sub engine the first time that it gets banks.
+static void ne_hw2d_setup_engines(bool sub_was_used)
+{
+    const NEA_Hw2DVRAMConfig *cfg = &ne_hw2d_state.vram_config;
 
     // Main engine: BG0 is already 3D (MODE_0_3D).
     // Individual BG layers are enabled by bgInit()/bgShow() when
@@ -147,27 +199,60 @@ int NEA_Hw2DInit(const NEA_Hw2DVRAMConfig *config)
     // as unconfigured layers would render garbage at priority 0.
 
     // Main engine sprites
-    if (mo)
+    if (cfg->main_obj && !ne_hw2d_state.main_obj_inited)
     {
         oamInit(&oamMain, SpriteMapping_1D_128, false);
         REG_DISPCNT |= DISPLAY_SPR_ACTIVE | DISPLAY_SPR_1D;
         ne_hw2d_state.main_obj_inited = true;
+        ne_hw2d_oam_mark(NEA_ENGINE_MAIN, 0, NEA_HW2D_MAX_OAM - 1);
     }
 
-    // Sub engine: set up base video mode. Individual BG layers are enabled
-    // by bgInitSub()/bgShow() in NEA_Hw2DBGCreate().
-    if (sb || so)
+    // Sub engine sprites
+    if (cfg->sub_obj && !ne_hw2d_state.sub_obj_inited)
     {
-        u32 sub_mode = MODE_0_2D;
-        if (so)
-        {
-            sub_mode |= DISPLAY_SPR_ACTIVE | DISPLAY_SPR_1D;
-            oamInit(&oamSub, SpriteMapping_1D_128, false);
-            ne_hw2d_state.sub_obj_inited = true;
-        }
-        videoSetModeSub(sub_mode);
+        oamInit(&oamSub, SpriteMapping_1D_128, false);
+        ne_hw2d_state.sub_obj_inited = true;
+        ne_hw2d_oam_mark(NEA_ENGINE_SUB, 0, NEA_HW2D_MAX_OAM - 1);
     }
 
+    // Sub engine: set up base video mode. Individual BG layers are enabled
+    // by bgInitSub()/bgShow() in NEA_Hw2DBGCreate(), so the mode isn't set
+    // again after that.
+    if ((cfg->sub_bg || cfg->sub_obj) && !sub_was_used)
+        videoSetModeSub(MODE_0_2D);
+    if (ne_hw2d_state.sub_obj_inited)
+        REG_DISPCNT_SUB |= DISPLAY_SPR_ACTIVE | DISPLAY_SPR_1D;
+}
+
+int NEA_Hw2DInit(const NEA_Hw2DVRAMConfig *config)
+{
+    if (ne_hw2d_state.initialized)
+        NEA_Hw2DSystemEnd();
+
+    NEA_AssertPointer(config, "NEA_Hw2DInit: NULL config");
+
+    memset(&ne_hw2d_state, 0, sizeof(ne_hw2d_state));
+    ne_hw2d_state.vram_config = *config;
+
+    if (ne_hw2d_check_config(config) != 0)
+        return -1;
+
+    // --- Configure VRAM banks ---
+
+    // If bank E is claimed for 2D, remove it from texture palette duty.
+    // This prevents ne_init_registers() from re-assigning it on future inits.
+    if ((config->main_bg | config->main_obj) & NEA_VRAM_E)
+        NEA_SetTexPaletteBank(0);
+
+    ne_hw2d_map_banks(config);
+
+    ne_hw2d_state.claimed_banks = config->main_bg | config->main_obj
+                                | config->sub_bg | config->sub_obj;
+
+    // --- Configure video modes ---
+
+    ne_hw2d_setup_engines(false);
+
     // Allocation layout (matching standard NDS/BlocksDS convention):
     // Maps at low offsets (base 0+), tiles at higher offsets (base 1+ = 16KB+).
     // This keeps map and tile data separate with no overlap.
@@ -176,6 +261,7 @@ int NEA_Hw2DInit(const NEA_Hw2DVRAMConfig *config)
     ne_hw2d_state.tile_base_next_main = 1;
     ne_hw2d_state.tile_base_next_sub = 1;
 
+    ne_hw2d_state.obj_stream_budget = NEA_HW2D_OBJ_STREAM_DEFAULT_BUDGET;
     ne_hw2d_state.initialized = true;
     return 0;
 }
@@ -191,11 +277,15 @@ void NEA_Hw2DSystemEnd(void)
         if (ne_hw2d_state.bgs_main[i].used)
         {
             bgHide(ne_hw2d_state.bgs_main[i].bg_id);
+            free(ne_hw2d_state.bgs_main[i].stream_owned);
+            free(ne_hw2d_state.bgs_main[i].glyph_cache);
             ne_hw2d_state.bgs_main[i].used = false;
         }
         if (ne_hw2d_state.bgs_sub[i].used)
         {
             bgHide(ne_hw2d_state.bgs_sub[i].bg_id);
+            free(ne_hw2d_state.bgs_sub[i].stream_owned);
+            free(ne_hw2d_state.bgs_sub[i].glyph_cache);
             ne_hw2d_state.bgs_sub[i].used = false;
         }
     }
@@ -214,27 +304,17 @@ void NEA_Hw2DSystemEnd(void)
             if (objs[i].used && objs[i].gfx)
             {
                 oamFreeGfx(oam, objs[i].gfx);
+                free(objs[i].frame_owned);
                 objs[i].used = false;
             }
         }
     }
 
+    // Sprites drawn with OBJs go back to 3D quads
+    ne_sprite_hw2d_forget();
+
     // Reset VRAM banks to LCD mode
-    NEA_VRAMBankFlags claimed = ne_hw2d_state.claimed_banks;
-    if (claimed & NEA_VRAM_A)
-        vramSetBankA(VRAM_A_LCD);
-    if (claimed & NEA_VRAM_B)
-        vramSetBankB(VRAM_B_LCD);
-    if (claimed & NEA_VRAM_C)
-        vramSetBankC(VRAM_C_LCD);
-    if (claimed & NEA_VRAM_D)
-        vramSetBankD(VRAM_D_LCD);
-    if (claimed & NEA_VRAM_E)
-        vramSetBankE(VRAM_E_LCD);
-    if (claimed & NEA_VRAM_H)
-        vramSetBankH(VRAM_H_LCD);
-    if (claimed & NEA_VRAM_I)
-        vramSetBankI(VRAM_I_LCD);
+    ne_hw2d_unmap_banks(ne_hw2d_state.claimed_banks);
 
     memset(&ne_hw2d_state, 0, sizeof(ne_hw2d_state));
 }
@@ -244,6 +324,156 @@ NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void)
     return ne_hw2d_state.claimed_banks;
 }
 
+int NEA_Hw2DClaimBanks(const NEA_Hw2DVRAMConfig *config)
+{
+    NEA_AssertPointer(config, "NULL config");
+
+    if (!ne_hw2d_state.initialized)
+    {
+        NEA_DebugPrint("System not initialized");
+        return -1;
+    }
+
+    if (ne_hw2d_check_config(config) != 0)
+        return -1;
+
+    NEA_VRAMBankFlags banks = config->main_bg | config->main_obj
+                            | config->sub_bg | config->sub_obj;
+
+    if (banks & ne_hw2d_state.claimed_banks)
+    {
+        NEA_DebugPrint("VRAM bank already claimed");
+        return -1;
+    }
+
+    // The palettes in VRAM_E can't be moved to other banks
+    if ((banks & NEA_VRAM_E) && (NEA_GetTexPaletteBank() & NEA_VRAM_E))
+    {
+        NEA_DebugPrint("VRAM_E is used for texture palettes");
+        return -1;
+    }
+
+    if ((banks & NEA_VRAM_D) && ne_impostor_uses_vram_d &&
+        ne_impostor_uses_vram_d())
+    {
+        NEA_DebugPrint("VRAM_D is used by impostors");
+        return -1;
+    }
+
+    // Move the textures out of the banks that are used for textures
+    NEA_VRAMBankFlags borrowed = banks & ne_texture_used_banks();
+    if (NEA_TextureBanksRelease(borrowed) == 0)
+        return -1;
+
+    ne_hw2d_map_banks(config);
+
+    NEA_Hw2DVRAMConfig *cfg = &ne_hw2d_state.vram_config;
+    bool sub_was_used = cfg->sub_bg || cfg->sub_obj;
+
+    cfg->main_bg |= config->main_bg;
+    cfg->main_obj |= config->main_obj;
+    cfg->sub_bg |= config->sub_bg;
+    cfg->sub_obj |= config->sub_obj;
+
+    ne_hw2d_state.claimed_banks |= banks;
+    ne_hw2d_state.borrowed_banks |= borrowed;
+
+    ne_hw2d_setup_engines(sub_was_used);
+
+    return 0;
+}
+
+static bool ne_hw2d_bgs_used(const NEA_Hw2DBG *bgs)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        if (bgs[i].used)
+            return true;
+    }
+
+    return false;
+}
+
+static bool ne_hw2d_objs_used(const NEA_Hw2DOBJ *objs)
+{
+    for (int i = 0; i < NEA_HW2D_MAX_OAM; i++)
+    {
+        if (objs[i].used)
+            return true;
+    }
+
+    return false;
+}
+
+int NEA_Hw2DReleaseBanks(NEA_VRAMBankFlags banks)
+{
+    if (!ne_hw2d_state.initialized)
+    {
+        NEA_DebugPrint("System not initialized");
+        return -1;
+    }
+
+    banks &= ne_hw2d_state.claimed_banks;
+    if (banks == 0)
+        return 0;
+
+    NEA_Hw2DVRAMConfig *cfg = &ne_hw2d_state.vram_config;
+
+    // Backgrounds and sprites can't be moved, so the spaces that lose banks
+    // must be empty.
+    if (((cfg->main_bg & banks) && ne_hw2d_bgs_used(ne_hw2d_state.bgs_main)) ||
+        ((cfg->sub_bg & banks) && ne_hw2d_bgs_used(ne_hw2d_state.bgs_sub)) ||
+        ((cfg->main_obj & banks) &&
+         ne_hw2d_objs_used(ne_hw2d_state.objs_main)) ||
+        ((cfg->sub_obj & banks) && ne_hw2d_objs_used(ne_hw2d_state.objs_sub)))
+    {
+        NEA_DebugPrint("Banks used by backgrounds or sprites");
+        return -1;
+    }
+
+    // The next backgrounds start again from the start of the space
+    if (cfg->main_bg & banks)
+    {
+        ne_hw2d_state.map_base_next_main = 0;
+        ne_hw2d_state.tile_base_next_main = 1;
+    }
+    if (cfg->sub_bg & banks)
+    {
+        ne_hw2d_state.map_base_next_sub = 0;
+        ne_hw2d_state.tile_base_next_sub = 1;
+    }
+
+    // OAM is set up again if there are banks left for sprites
+    if (cfg->main_obj & banks)
+    {
+        REG_DISPCNT &= ~DISPLAY_SPR_ACTIVE;
+        ne_hw2d_state.main_obj_inited = false;
+    }
+    if (cfg->sub_obj & banks)
+    {
+        REG_DISPCNT_SUB &= ~DISPLAY_SPR_ACTIVE;
+        ne_hw2d_state.sub_obj_inited = false;
+    }
+
+    cfg->main_bg &= ~banks;
+    cfg->main_obj &= ~banks;
+    cfg->sub_bg &= ~banks;
+    cfg->sub_obj &= ~banks;
+
+    ne_hw2d_state.claimed_banks &= ~banks;
+
+    ne_hw2d_unmap_banks(banks);
+    ne_hw2d_setup_engines(true);
+
+    // Banks taken from the texture system are given back to it
+    NEA_VRAMBankFlags borrowed = ne_hw2d_state.borrowed_banks & banks;
+    ne_hw2d_state.borrowed_banks &= ~banks;
+    if (borrowed)
+        NEA_TextureBanksAcquire(borrowed);
+
+    return 0;
+}
+
 // ---------------------------------------------------------------------------
 // Phase 2: Tiled backgrounds
 // ---------------------------------------------------------------------------
@@ -430,6 +660,8 @@ void NEA_Hw2DBGDelete(NEA_Hw2DBG *bg)
         return;
 
     bgHide(bg->bg_id);
+    free(bg->stream_owned);
+    free(bg->glyph_cache);
     memset(bg, 0, sizeof(*bg));
 }
 
@@ -451,30 +683,16 @@ int NEA_Hw2DBGLoadTilesFAT(NEA_Hw2DBG *bg, const char *path)
     NEA_Assert(bg->used, "BG not active");
     NEA_Assert(bg->type <= NEA_HW2D_BG_TILED_8BPP, "Not a tiled BG");
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
-    {
-        NEA_DebugPrint("Failed to open: %s", path);
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
         return -1;
-    }
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    void *buf = malloc(size);
+    void *buf = ne_fat_load_data_temp(path);
     if (buf == NULL)
-    {
-        fclose(f);
-        NEA_DebugPrint("Out of memory");
         return -1;
-    }
-
-    fread(buf, 1, size, f);
-    fclose(f);
 
     memcpy(bg->gfx_ptr, buf, size);
-    free(buf);
+    ne_arena_temp_free(buf);
     return 0;
 }
 
@@ -496,30 +714,16 @@ int NEA_Hw2DBGLoadMapFAT(NEA_Hw2DBG *bg, const char *path)
     NEA_Assert(bg->used, "BG not active");
     NEA_Assert(bg->map_ptr != NULL, "Not a tiled BG");
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
-    {
-        NEA_DebugPrint("Failed to open: %s", path);
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
         return -1;
-    }
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    void *buf = malloc(size);
+    void *buf = ne_fat_load_data_temp(path);
     if (buf == NULL)
-    {
-        fclose(f);
-        NEA_DebugPrint("Out of memory");
         return -1;
-    }
-
-    fread(buf, 1, size, f);
-    fclose(f);
 
     memcpy(bg->map_ptr, buf, size);
-    free(buf);
+    ne_arena_temp_free(buf);
     return 0;
 }
 
@@ -551,6 +755,15 @@ void NEA_Hw2DBGSetScroll(NEA_Hw2DBG *bg, int x, int y)
 
     bg->scroll_x = x;
     bg->scroll_y = y;
+
+    // The new tiles of streamed maps are written at the same time as the
+    // scroll registers, during the vertical blank
+    if (bg->stream_map != NULL)
+    {
+        bg->stream_pending = true;
+        return;
+    }
+
     bgSetScroll(bg->bg_id, x, y);
     bgUpdate();
 }
@@ -593,6 +806,181 @@ u16 NEA_Hw2DBGGetTile(const NEA_Hw2DBG *bg, int x, int y)
     return bg->map_ptr[y * tiles_per_row + x];
 }
 
+// Number of columns and rows of tiles written to VRAM for streamed maps. The
+// screen shows 33x25 tiles when the scroll isn't a multiple of 8 pixels.
+static int ne_hw2d_stream_cols(const NEA_Hw2DBG *bg)
+{
+    return (bg->width / 8 > 32) ? 33 : 32;
+}
+
+#define NE_HW2D_STREAM_ROWS 25
+
+// Writes a rectangle of tiles of the large map into the hardware map. The
+// hardware map is split in blocks of 32x32 tiles.
+static void ne_hw2d_stream_write(NEA_Hw2DBG *bg, int x, int y, int w, int h)
+{
+    int hw_w = bg->width / 8;
+    int hw_h = bg->height / 8;
+
+    for (int ty = y; ty < y + h; ty++)
+    {
+        int hy = ty & (hw_h - 1);
+        u16 *row = bg->map_ptr + (hy >> 5) * (hw_w >> 5) * 1024
+                 + (hy & 31) * 32;
+        const u16 *src = NULL;
+        if (ty >= 0 && ty < bg->stream_height)
+            src = bg->stream_map + ty * bg->stream_width;
+
+        for (int tx = x; tx < x + w; tx++)
+        {
+            int hx = tx & (hw_w - 1);
+            u16 value = 0;
+            if (src != NULL && tx >= 0 && tx < bg->stream_width)
+                value = src[tx];
+            row[(hx >> 5) * 1024 + (hx & 31)] = value;
+        }
+    }
+}
+
+static void ne_hw2d_stream_update(NEA_Hw2DBG *bg)
+{
+    int cols = ne_hw2d_stream_cols(bg);
+    int rows = NE_HW2D_STREAM_ROWS;
+
+    int nx = bg->scroll_x >> 3;
+    int ny = bg->scroll_y >> 3;
+    int dx = nx - bg->stream_x;
+    int dy = ny - bg->stream_y;
+
+    if (bg->stream_refill || dx >= cols || -dx >= cols ||
+        dy >= rows || -dy >= rows)
+    {
+        ne_hw2d_stream_write(bg, nx, ny, cols, rows);
+    }
+    else
+    {
+        // Columns that have become visible, for the new rows
+        if (dx > 0)
+            ne_hw2d_stream_write(bg, bg->stream_x + cols, ny, dx, rows);
+        else if (dx < 0)
+            ne_hw2d_stream_write(bg, nx, ny, -dx, rows);
+
+        // Rows that have become visible, for the new columns
+        if (dy > 0)
+            ne_hw2d_stream_write(bg, nx, bg->stream_y + rows, cols, dy);
+        else if (dy < 0)
+            ne_hw2d_stream_write(bg, nx, ny, cols, -dy);
+    }
+
+    bg->stream_x = nx;
+    bg->stream_y = ny;
+    bg->stream_refill = false;
+    bg->stream_pending = false;
+
+    // The hardware wraps the scroll around the size of the map
+    bgSetScroll(bg->bg_id, bg->scroll_x, bg->scroll_y);
+}
+
+int NEA_Hw2DBGStreamSetMap(NEA_Hw2DBG *bg, const u16 *map, int width,
+                            int height)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+    NEA_AssertPointer(map, "NULL map");
+    NEA_Assert(bg->used && bg->map_ptr, "Invalid tiled BG");
+
+    if (width <= 0 || height <= 0)
+    {
+        NEA_DebugPrint("Invalid map size");
+        return -1;
+    }
+
+    if (bg->stream_owned != map)
+    {
+        free(bg->stream_owned);
+        bg->stream_owned = NULL;
+    }
+
+    bg->stream_map = map;
+    bg->stream_width = width;
+    bg->stream_height = height;
+    bg->stream_refill = true;
+    bg->stream_pending = true;
+    return 0;
+}
+
+int NEA_Hw2DBGStreamLoadMapFAT(NEA_Hw2DBG *bg, const char *path, int width,
+                                int height)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+    NEA_AssertPointer(path, "NULL path");
+
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
+        return -1;
+
+    if (size < (size_t)width * height * sizeof(u16))
+    {
+        NEA_DebugPrint("File is too small for the map size");
+        return -1;
+    }
+
+    u16 *map = (u16 *)NEA_FATLoadData(path);
+    if (map == NULL)
+        return -1;
+
+    free(bg->stream_owned);
+    bg->stream_owned = map;
+
+    if (NEA_Hw2DBGStreamSetMap(bg, map, width, height) != 0)
+    {
+        free(map);
+        bg->stream_owned = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void NEA_Hw2DBGStreamStop(NEA_Hw2DBG *bg)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+
+    free(bg->stream_owned);
+    bg->stream_owned = NULL;
+    bg->stream_map = NULL;
+
+    bgSetScroll(bg->bg_id, bg->scroll_x, bg->scroll_y);
+    bgUpdate();
+}
+
+void NEA_Hw2DBGUpdateAll(void)
+{
+    if (!ne_hw2d_state.initialized)
+        return;
+
+    bool updated = false;
+
+    for (int i = 0; i < 4; i++)
+    {
+        NEA_Hw2DBG *bgs[2] = {
+            &ne_hw2d_state.bgs_main[i], &ne_hw2d_state.bgs_sub[i]
+        };
+
+        for (int e = 0; e < 2; e++)
+        {
+            NEA_Hw2DBG *bg = bgs[e];
+            if (!bg->used || bg->stream_map == NULL || !bg->stream_pending)
+                continue;
+
+            ne_hw2d_stream_update(bg);
+            updated = true;
+        }
+    }
+
+    if (updated)
+        bgUpdate();
+}
+
 // ---------------------------------------------------------------------------
 // Phase 3: Bitmap backgrounds
 // ---------------------------------------------------------------------------
@@ -615,30 +1003,16 @@ int NEA_Hw2DBGLoadBitmapFAT(NEA_Hw2DBG *bg, const char *path)
     NEA_Assert(bg->used, "BG not active");
     NEA_Assert(bg->type >= NEA_HW2D_BG_BITMAP_8, "Not a bitmap BG");
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
-    {
-        NEA_DebugPrint("Failed to open: %s", path);
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
         return -1;
-    }
 
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-
-    void *buf = malloc(size);
+    void *buf = ne_fat_load_data_temp(path);
     if (buf == NULL)
-    {
-        fclose(f);
-        NEA_DebugPrint("Out of memory");
         return -1;
-    }
-
-    fread(buf, 1, size, f);
-    fclose(f);
 
     memcpy(bg->gfx_ptr, buf, size);
-    free(buf);
+    ne_arena_temp_free(buf);
     return 0;
 }
 
@@ -756,20 +1130,23 @@ NEA_Hw2DOBJ *NEA_Hw2DOBJCreate(NEA_Hw2DEngine engine, NEA_OBJSize size,
     ObjSize libnds_size = ne_hw2d_obj_size(size);
     SpriteColorFormat libnds_color = ne_hw2d_obj_color(mode);
 
+    // Compute bytes per frame
+    int w = ne_hw2d_obj_width(size);
+    int h = ne_hw2d_obj_height(size);
+    int bpp = (mode == NEA_OBJ_COLOR_256) ? 8 : 4;
+    int frame_size = (w * h * bpp) / 8;
+
     u16 *gfx = oamAllocateGfx(oam, libnds_size, libnds_color);
     if (gfx == NULL)
     {
         NEA_DebugPrint("NEA_Hw2DOBJCreate: gfx alloc failed");
+        ne_mem_report_failure((engine == NEA_ENGINE_MAIN) ?
+                              NEA_MEM_POOL_HW2D_MAIN : NEA_MEM_POOL_HW2D_SUB,
+                              frame_size);
         (*next)--;
         return NULL;
     }
 
-    // Compute bytes per frame
-    int w = ne_hw2d_obj_width(size);
-    int h = ne_hw2d_obj_height(size);
-    int bpp = (mode == NEA_OBJ_COLOR_256) ? 8 : 4;
-    int frame_size = (w * h * bpp) / 8;
-
     NEA_Hw2DOBJ *obj = &objs[idx];
     memset(obj, 0, sizeof(*obj));
     obj->used = true;
@@ -784,6 +1161,8 @@ NEA_Hw2DOBJ *NEA_Hw2DOBJCreate(NEA_Hw2DEngine engine, NEA_OBJSize size,
     obj->palette_slot = 0;
     obj->affine_index = -1;
     obj->double_size = false;
+    obj->dirty = true;
+    obj->loaded_frame = -1;
 
     return obj;
 }
@@ -803,7 +1182,9 @@ void NEA_Hw2DOBJDelete(NEA_Hw2DOBJ *obj)
            ne_hw2d_obj_size(obj->nea_size),
            ne_hw2d_obj_color(obj->color),
            NULL, -1, false, true, false, false, false);
+    ne_hw2d_oam_mark(obj->engine, obj->oam_index, obj->oam_index);
 
+    free(obj->frame_owned);
     memset(obj, 0, sizeof(*obj));
 }
 
@@ -830,34 +1211,20 @@ int NEA_Hw2DOBJLoadGfxFAT(NEA_Hw2DOBJ *obj, const char *path)
     NEA_AssertPointer(path, "NULL path");
     NEA_Assert(obj->used, "OBJ not active");
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
-    {
-        NEA_DebugPrint("Failed to open: %s", path);
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
         return -1;
-    }
-
-    fseek(f, 0, SEEK_END);
-    size_t size = ftell(f);
-    fseek(f, 0, SEEK_SET);
 
-    void *buf = malloc(size);
+    void *buf = ne_fat_load_data_temp(path);
     if (buf == NULL)
-    {
-        fclose(f);
-        NEA_DebugPrint("Out of memory");
         return -1;
-    }
-
-    fread(buf, 1, size, f);
-    fclose(f);
 
     memcpy(obj->gfx, buf, obj->gfx_size);
     obj->num_frames = size / obj->gfx_size;
     if (obj->num_frames < 1)
         obj->num_frames = 1;
 
-    free(buf);
+    ne_arena_temp_free(buf);
     return 0;
 }
 
@@ -877,27 +1244,39 @@ int NEA_Hw2DOBJLoadPalette(NEA_Hw2DEngine engine, const void *data,
 void NEA_Hw2DOBJSetPos(NEA_Hw2DOBJ *obj, int x, int y)
 {
     NEA_AssertPointer(obj, "NULL obj");
+    if (obj->x == x && obj->y == y)
+        return;
     obj->x = x;
     obj->y = y;
+    obj->dirty = true;
 }
 
 void NEA_Hw2DOBJSetVisible(NEA_Hw2DOBJ *obj, bool visible)
 {
     NEA_AssertPointer(obj, "NULL obj");
+    if (obj->visible == visible)
+        return;
     obj->visible = visible;
+    obj->dirty = true;
 }
 
 void NEA_Hw2DOBJSetFlip(NEA_Hw2DOBJ *obj, bool hflip, bool vflip)
 {
     NEA_AssertPointer(obj, "NULL obj");
+    if (obj->hflip == hflip && obj->vflip == vflip)
+        return;
     obj->hflip = hflip;
     obj->vflip = vflip;
+    obj->dirty = true;
 }
 
 void NEA_Hw2DOBJSetPriority(NEA_Hw2DOBJ *obj, int priority)
 {
     NEA_AssertPointer(obj, "NULL obj");
+    if (obj->priority == priority)
+        return;
     obj->priority = priority;
+    obj->dirty = true;
 }
 
 void NEA_Hw2DOBJSetFrame(NEA_Hw2DOBJ *obj, int frame)
@@ -908,21 +1287,139 @@ void NEA_Hw2DOBJSetFrame(NEA_Hw2DOBJ *obj, int frame)
     if (frame >= obj->num_frames)
         frame = 0;
 
+    if (obj->frame == frame)
+        return;
     obj->frame = frame;
+    obj->dirty = true;
+}
+
+int NEA_Hw2DOBJStreamFrames(NEA_Hw2DOBJ *obj, const void *data, size_t size)
+{
+    NEA_AssertPointer(obj, "NULL obj");
+    NEA_AssertPointer(data, "NULL data");
+    NEA_Assert(obj->used, "OBJ not active");
+
+    if (size < (size_t)obj->gfx_size)
+    {
+        NEA_DebugPrint("Not enough data for one frame");
+        return -1;
+    }
+
+    if (obj->frame_owned != data)
+    {
+        free(obj->frame_owned);
+        obj->frame_owned = NULL;
+    }
+
+    obj->frame_data = data;
+    obj->num_frames = size / obj->gfx_size;
+    if (obj->frame >= obj->num_frames)
+        obj->frame = 0;
+    obj->loaded_frame = -1;
+
+    return 0;
+}
+
+int NEA_Hw2DOBJStreamFramesFAT(NEA_Hw2DOBJ *obj, const char *path)
+{
+    NEA_AssertPointer(obj, "NULL obj");
+    NEA_AssertPointer(path, "NULL path");
+    NEA_Assert(obj->used, "OBJ not active");
+
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
+        return -1;
+
+    void *buf = NEA_FATLoadData(path);
+    if (buf == NULL)
+        return -1;
+
+    free(obj->frame_owned);
+    obj->frame_owned = buf;
+
+    if (NEA_Hw2DOBJStreamFrames(obj, buf, size) != 0)
+    {
+        free(buf);
+        obj->frame_owned = NULL;
+        obj->frame_data = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+void NEA_Hw2DOBJSetStreamBudget(size_t bytes)
+{
+    ne_hw2d_state.obj_stream_budget = bytes;
+}
+
+// Copies the frames of streamed sprites that have changed, starting after the
+// last sprite copied during the previous call so that all of them get a turn.
+static void ne_hw2d_obj_stream_update(void)
+{
+    size_t budget = ne_hw2d_state.obj_stream_budget;
+    size_t done = 0;
+    int start = ne_hw2d_state.obj_stream_next;
+
+    for (int n = 0; n < 2 * NEA_HW2D_MAX_OAM; n++)
+    {
+        int i = (start + n) % (2 * NEA_HW2D_MAX_OAM);
+        NEA_Hw2DOBJ *o = (i < NEA_HW2D_MAX_OAM)
+                       ? &ne_hw2d_state.objs_main[i]
+                       : &ne_hw2d_state.objs_sub[i - NEA_HW2D_MAX_OAM];
+
+        if (!o->used || o->frame_data == NULL || o->loaded_frame == o->frame)
+            continue;
+
+        size_t size = o->gfx_size;
+        if (done > 0 && done + size > budget)
+        {
+            ne_hw2d_state.obj_stream_next = i;
+            return;
+        }
+
+        const u8 *src = o->frame_data + (size_t)o->frame * size;
+        DC_FlushRange(src, size);
+        dmaCopy(src, o->gfx, size);
+
+        o->loaded_frame = o->frame;
+        done += size;
+    }
 }
 
 void NEA_Hw2DOBJSetAffine(NEA_Hw2DOBJ *obj, int rot_index, bool double_size)
 {
     NEA_AssertPointer(obj, "NULL obj");
+    if (obj->affine_index == rot_index && obj->double_size == double_size)
+        return;
     obj->affine_index = rot_index;
     obj->double_size = double_size;
+    obj->dirty = true;
 }
 
 void NEA_Hw2DOBJSetRotScaleI(NEA_Hw2DEngine engine, int rot_index,
                               int angle, int32_t sx, int32_t sy)
 {
+    NEA_Assert(rot_index >= 0 && rot_index < 32, "Invalid affine index");
+
     OamState *oam = (engine == NEA_ENGINE_MAIN) ? &oamMain : &oamSub;
+
+    // The matrix is stored in the last halfword of 4 consecutive entries
+    SpriteEntry *e = &oam->oamMemory[rot_index * 4];
+    u16 prev[4];
+    for (int i = 0; i < 4; i++)
+        prev[i] = e[i].attribute[3];
+
     oamRotateScale(oam, rot_index, angle, sx, sy);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (e[i].attribute[3] != prev[i])
+        {
+            ne_hw2d_oam_mark(engine, rot_index * 4, rot_index * 4 + 3);
+            break;
+        }
+    }
 }
 
 void NEA_Hw2DOBJUpdate(NEA_Hw2DEngine engine)
@@ -951,9 +1448,12 @@ void NEA_Hw2DOBJUpdate(NEA_Hw2DEngine engine)
     for (int i = 0; i < count; i++)
     {
         NEA_Hw2DOBJ *o = &objs[i];
-        if (!o->used)
+        if (!o->used || !o->dirty)
             continue;
 
+        o->dirty = false;
+        ne_hw2d_oam_mark(engine, o->oam_index, o->oam_index);
+
         oamSet(oam, o->oam_index,
                o->x, o->y,
                o->priority,
@@ -968,7 +1468,21 @@ void NEA_Hw2DOBJUpdate(NEA_Hw2DEngine engine)
                false);       // mosaic
     }
 
-    oamUpdate(oam);
+    // Only copy the entries that have changed since the last upload
+    int first = ne_hw2d_state.oam_dirty_first[engine];
+    int last = ne_hw2d_state.oam_dirty_last[engine];
+    if (first > last)
+        return;
+
+    ne_hw2d_state.oam_dirty_first[engine] = NEA_HW2D_MAX_OAM;
+    ne_hw2d_state.oam_dirty_last[engine] = -1;
+
+    SpriteEntry *src = &oam->oamMemory[first];
+    u16 *dst = (engine == NEA_ENGINE_MAIN) ? OAM : OAM_SUB;
+    size_t size = (last - first + 1) * sizeof(SpriteEntry);
+
+    DC_FlushRange(src, size);
+    dmaCopy(src, dst + first * 4, size);
 }
 
 void NEA_Hw2DOBJUpdateAll(void)
@@ -976,12 +1490,225 @@ void NEA_Hw2DOBJUpdateAll(void)
     if (!ne_hw2d_state.initialized)
         return;
 
+    ne_hw2d_obj_stream_update();
+
     NEA_Hw2DOBJUpdate(NEA_ENGINE_MAIN);
     NEA_Hw2DOBJUpdate(NEA_ENGINE_SUB);
 }
 
 // ---------------------------------------------------------------------------
-// Phase 5: Text rendering on bitmap backgrounds
+// Phase 4b: 3D sprites drawn as OBJ sprites
+// ---------------------------------------------------------------------------
+
+// Returns the OBJ size with the given dimensions, or -1 if there isn't any
+static int ne_hw2d_obj_size_from_dims(int w, int h)
+{
+    for (int s = NEA_OBJ_SIZE_8x8; s <= NEA_OBJ_SIZE_32x64; s++)
+    {
+        if ((ne_hw2d_obj_width(s) == w) && (ne_hw2d_obj_height(s) == h))
+            return s;
+    }
+
+    return -1;
+}
+
+int NEA_Hw2DSpriteAttach(NEA_Sprite *sprite, NEA_TextureFormat fmt,
+                         const void *texture, const u16 *palette,
+                         int palette_slot, int affine_index)
+{
+    NEA_AssertPointer(sprite, "NULL sprite");
+    NEA_AssertPointer(texture, "NULL texture");
+    NEA_AssertPointer(sprite->mat, "Sprite doesn't have a material");
+    NEA_Assert(ne_hw2d_state.main_obj_inited, "Main OBJ not configured");
+    NEA_AssertMinMax(-1, affine_index, 31, "Invalid affine index %d",
+                     affine_index);
+    NEA_AssertMinMax(0, palette_slot, 15, "Invalid palette slot %d",
+                     palette_slot);
+
+    if ((fmt != NEA_PAL16) && (fmt != NEA_PAL256))
+    {
+        NEA_DebugPrint("Texture format not supported by OBJs");
+        return -1;
+    }
+
+    int w = NEA_TextureGetSizeX(sprite->mat);
+    int h = NEA_TextureGetSizeY(sprite->mat);
+    int size = ne_hw2d_obj_size_from_dims(w, h);
+    if (size < 0)
+    {
+        NEA_DebugPrint("No OBJ size is %dx%d", w, h);
+        return -1;
+    }
+
+    NEA_Hw2DSpriteDetach(sprite);
+
+    NEA_OBJColorMode mode = (fmt == NEA_PAL16) ? NEA_OBJ_COLOR_16
+                                               : NEA_OBJ_COLOR_256;
+    NEA_Hw2DOBJ *obj = NEA_Hw2DOBJCreate(NEA_ENGINE_MAIN, size, mode);
+    if (obj == NULL)
+        return -1;
+
+    u8 *tiles = malloc(obj->gfx_size);
+    if (tiles == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        NEA_Hw2DOBJDelete(obj);
+        return -1;
+    }
+
+    // Textures are stored row by row, OBJs are 8x8 tiles in 1D mapping order
+    int row_size = (fmt == NEA_PAL16) ? 4 : 8; // Bytes per row of a tile
+    int pitch = (w / 8) * row_size;
+    const u8 *src = texture;
+    u8 *dst = tiles;
+
+    for (int ty = 0; ty < h; ty += 8)
+    {
+        for (int tx = 0; tx < w / 8; tx++)
+        {
+            for (int y = 0; y < 8; y++)
+            {
+                memcpy(dst, src + (ty + y) * pitch + tx * row_size, row_size);
+                dst += row_size;
+            }
+        }
+    }
+
+    NEA_Hw2DOBJLoadGfx(obj, tiles, obj->gfx_size);
+    free(tiles);
+
+    if (fmt == NEA_PAL16)
+    {
+        if (palette != NULL)
+            NEA_Hw2DOBJLoadPalette(NEA_ENGINE_MAIN, palette, 16, palette_slot);
+        obj->palette_slot = palette_slot;
+    }
+    else if (palette != NULL)
+    {
+        NEA_Hw2DOBJLoadPalette(NEA_ENGINE_MAIN, palette, 256, 0);
+    }
+
+    sprite->hw_obj = obj;
+    sprite->hw_affine = affine_index;
+    return 0;
+}
+
+void NEA_Hw2DSpriteDetach(NEA_Sprite *sprite)
+{
+    NEA_AssertPointer(sprite, "NULL sprite");
+
+    if (sprite->hw_obj == NULL)
+        return;
+
+    NEA_Hw2DOBJDelete(sprite->hw_obj);
+    sprite->hw_obj = NULL;
+}
+
+// Internal use... see NEA2D.c
+//
+// Updates the OBJ of a sprite. It returns true if the OBJ draws the sprite, or
+// false if the OBJ has been hidden and the sprite has to be drawn in 3D.
+bool ne_hw2d_sprite_draw(const NEA_Sprite *sprite)
+{
+    NEA_Hw2DOBJ *obj = sprite->hw_obj;
+
+    if (!sprite->visible)
+    {
+        NEA_Hw2DOBJSetVisible(obj, false);
+        return true;
+    }
+
+    int ow = ne_hw2d_obj_width(obj->nea_size);
+    int oh = ne_hw2d_obj_height(obj->nea_size);
+
+    bool compatible = (sprite->alpha == 31) && (sprite->color == NEA_White)
+                   && (sprite->tl == 0) && (sprite->tt == 0)
+                   && (sprite->tr == ow) && (sprite->tb == oh)
+                   && (NEA_CurrentExecutionMode() == NEA_ModeSingle3D);
+
+    // Size of the sprite on the screen, and scale relative to the OBJ
+    int dw = (abs(sprite->w) * sprite->xscale) >> 12;
+    int dh = (abs(sprite->h) * sprite->yscale) >> 12;
+    int32_t sx = (abs(sprite->w) * sprite->xscale) / ow;
+    int32_t sy = (abs(sprite->h) * sprite->yscale) / oh;
+
+    bool affine = (sprite->rot_angle != 0) || (sx != inttof32(1)) ||
+                  (sy != inttof32(1));
+
+    if (affine)
+    {
+        if (sprite->hw_affine < 0)
+        {
+            compatible = false;
+        }
+        else if (sprite->rot_angle == 0)
+        {
+            // The double size area is twice as big as the OBJ
+            if ((dw > 2 * ow) || (dh > 2 * oh))
+                compatible = false;
+        }
+        else
+        {
+            // The sprite must fit in the double size area at any angle
+            int side = (ow < oh) ? ow : oh;
+            if (dw * dw + dh * dh > 4 * side * side)
+                compatible = false;
+        }
+    }
+
+    if (!compatible)
+    {
+        NEA_Hw2DOBJSetVisible(obj, false);
+        return false;
+    }
+
+    // Center of the sprite, like in NEA_SpriteDraw()
+    int cx = sprite->x + (sprite->w >> 1);
+    int cy = sprite->y + (sprite->h >> 1);
+    int x, y, area_w, area_h;
+
+    if (affine)
+    {
+        // Flips are part of the matrix of affine OBJs
+        if (sprite->w < 0)
+            sx = -sx;
+        if (sprite->h < 0)
+            sy = -sy;
+
+        NEA_Hw2DOBJSetRotScaleI(NEA_ENGINE_MAIN, sprite->hw_affine,
+                                sprite->rot_angle & 511, sx, sy);
+        NEA_Hw2DOBJSetAffine(obj, sprite->hw_affine, true);
+
+        area_w = ow * 2;
+        area_h = oh * 2;
+    }
+    else
+    {
+        NEA_Hw2DOBJSetAffine(obj, -1, false);
+        NEA_Hw2DOBJSetFlip(obj, sprite->w < 0, sprite->h < 0);
+
+        area_w = ow;
+        area_h = oh;
+    }
+
+    x = cx - (area_w >> 1);
+    y = cy - (area_h >> 1);
+
+    // OBJ coordinates wrap around, hide OBJs that are outside of the screen
+    if ((x + area_w <= 0) || (x >= 256) || (y + area_h <= 0) || (y >= 192))
+    {
+        NEA_Hw2DOBJSetVisible(obj, false);
+        return true;
+    }
+
+    NEA_Hw2DOBJSetPos(obj, x, y);
+    NEA_Hw2DOBJSetPriority(obj, 0); // Over the 3D layer
+    NEA_Hw2DOBJSetVisible(obj, true);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Phase 5: Text rendering
 // ---------------------------------------------------------------------------
 
 int NEA_Hw2DTextRender(NEA_Hw2DBG *bg, u32 slot, const char *str,
@@ -1050,3 +1777,489 @@ int NEA_Hw2DTextRender(NEA_Hw2DBG *bg, u32 slot, const char *str,
     free(out_texture);
     return 0;
 }
+
+// Glyph tile cache of a tiled background. Each entry owns one cell of
+// cell_w x cell_h tiles, starting at first_tile.
+typedef struct {
+    u32 key;      // Bytes of the UTF-8 character, 0 if the cell is free
+    u32 last_use; // Value of the stamp of the cache when it was last rendered
+} ne_hw2d_glyph_t;
+
+typedef struct {
+    u32 font_slot;
+    int first_tile;
+    int num_cells;
+    int cell_w, cell_h;
+    int palette;
+    int color;
+    u32 stamp;               // Incremented every time a string is rendered
+    s16 ascii[128];          // Cell of each ASCII character, or -1
+    ne_hw2d_glyph_t cells[]; // One per cell
+} ne_hw2d_glyph_cache_t;
+
+// Returns the number of bytes of the UTF-8 character at the start of a string
+static int ne_hw2d_utf8_len(const char *str)
+{
+    u8 c = *str;
+    int len = (c >= 0xF0) ? 4 : (c >= 0xE0) ? 3 : (c >= 0xC0) ? 2 : 1;
+
+    // Don't read past the end of truncated strings
+    for (int i = 1; i < len; i++)
+    {
+        if (str[i] == '\0')
+            return i;
+    }
+
+    return len;
+}
+
+// Returns true if a texel of a font texture isn't transparent
+static bool ne_hw2d_font_texel(const void *tex, size_t tex_w,
+                               unsigned int fmt, int x, int y)
+{
+    const u8 *tex8 = tex;
+    size_t i = y * tex_w + x;
+
+    switch (fmt)
+    {
+    case GL_RGBA:
+        return ((const u16 *)tex)[i] & BIT(15);
+    case GL_RGB:
+        return true;
+    case GL_RGB256:
+        return tex8[i] != 0;
+    case GL_RGB16:
+        return ((tex8[i >> 1] >> ((i & 1) * 4)) & 0xF) != 0;
+    case GL_RGB4:
+        return ((tex8[i >> 2] >> ((i & 3) * 2)) & 0x3) != 0;
+    case GL_RGB32_A3:
+        return (tex8[i] >> 5) != 0;
+    case GL_RGB8_A5:
+        return (tex8[i] >> 3) != 0;
+    default:
+        return false;
+    }
+}
+
+// Rasterizes the glyph of a character into the tiles of a cell
+static void ne_hw2d_glyph_raster(NEA_Hw2DBG *bg, ne_hw2d_glyph_cache_t *cache,
+                                 int cell, const char *chr, int len)
+{
+    int w = cache->cell_w * 8;
+    int h = cache->cell_h * 8;
+    u8 pixels[NEA_HW2D_GLYPH_MAX_CELL * 8 * NEA_HW2D_GLYPH_MAX_CELL * 8];
+    memset(pixels, 0, w * h);
+
+    uintptr_t handle;
+    const void *font_texture;
+    size_t font_w, font_h;
+    unsigned int font_fmt;
+
+    char str[5];
+    memcpy(str, chr, len);
+    str[len] = '\0';
+
+    dsf_layout *layout = NULL;
+    if ((NEA_RichTextGetBitmapState(cache->font_slot, &handle, &font_texture,
+                                    &font_w, &font_h, &font_fmt) == 0) &&
+        (DSF_StringLayout((dsf_handle)handle, str, 0, &layout) == DSF_NO_ERROR))
+    {
+        for (size_t i = 0; i < layout->num_glyphs; i++)
+        {
+            const dsf_glyph *g = &layout->glyphs[i];
+
+            for (int gy = 0; gy < g->height; gy++)
+            {
+                int py = g->y + gy;
+                if (py < 0 || py >= h)
+                    continue;
+
+                for (int gx = 0; gx < g->width; gx++)
+                {
+                    int px = g->x + gx;
+                    if (px < 0 || px >= w)
+                        continue;
+
+                    if (ne_hw2d_font_texel(font_texture, font_w, font_fmt,
+                                           g->tx + gx, g->ty + gy))
+                        pixels[py * w + px] = cache->color;
+                }
+            }
+        }
+
+        DSF_LayoutFree(layout);
+    }
+
+    // VRAM can't be written with 8-bit accesses, the tiles are written in
+    // 32-bit words.
+    bool is_4bpp = (bg->type == NEA_HW2D_BG_TILED_4BPP);
+    int tile_words = is_4bpp ? 8 : 16;
+    u32 *dst = (u32 *)bg->gfx_ptr
+             + (cache->first_tile + cell * cache->cell_w * cache->cell_h)
+             * tile_words;
+
+    for (int ty = 0; ty < cache->cell_h; ty++)
+    {
+        for (int tx = 0; tx < cache->cell_w; tx++)
+        {
+            const u8 *src = &pixels[ty * 8 * w + tx * 8];
+
+            for (int row = 0; row < 8; row++)
+            {
+                const u8 *p = &src[row * w];
+
+                if (is_4bpp)
+                {
+                    u32 word = 0;
+                    for (int i = 0; i < 8; i++)
+                        word |= (u32)p[i] << (i * 4);
+                    *dst++ = word;
+                }
+                else
+                {
+                    *dst++ = p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24);
+                    *dst++ = p[4] | (p[5] << 8) | (p[6] << 16) | (p[7] << 24);
+                }
+            }
+        }
+    }
+}
+
+// Returns the cell with the glyph of a character, rasterizing it if needed, or
+// -1 if all cells are used by the string being rendered.
+static int ne_hw2d_glyph_get(NEA_Hw2DBG *bg, ne_hw2d_glyph_cache_t *cache,
+                             const char *chr, int len)
+{
+    u32 key = 0;
+    memcpy(&key, chr, len);
+
+    int cell = -1;
+
+    if (key < 128)
+    {
+        cell = cache->ascii[key];
+    }
+    else
+    {
+        for (int i = 0; i < cache->num_cells; i++)
+        {
+            if (cache->cells[i].key == key)
+            {
+                cell = i;
+                break;
+            }
+        }
+    }
+
+    if (cell >= 0)
+    {
+        cache->cells[cell].last_use = cache->stamp;
+        return cell;
+    }
+
+    // Replace the glyph that was rendered least recently. Free cells have
+    // never been used, so they are taken first.
+    cell = 0;
+    for (int i = 1; i < cache->num_cells; i++)
+    {
+        if ((cache->stamp - cache->cells[i].last_use) >
+            (cache->stamp - cache->cells[cell].last_use))
+            cell = i;
+    }
+
+    ne_hw2d_glyph_t *entry = &cache->cells[cell];
+    if ((entry->key != 0) && (entry->last_use == cache->stamp))
+        return -1;
+
+    if (entry->key != 0 && entry->key < 128)
+        cache->ascii[entry->key] = -1;
+
+    entry->key = key;
+    entry->last_use = cache->stamp;
+    if (key < 128)
+        cache->ascii[key] = cell;
+
+    ne_hw2d_glyph_raster(bg, cache, cell, chr, len);
+
+    return cell;
+}
+
+// Returns the map entry of a tile. The map is split in blocks of 32x32 tiles.
+static u16 *ne_hw2d_map_entry(const NEA_Hw2DBG *bg, int x, int y)
+{
+    int hw_w = bg->width / 8;
+
+    return bg->map_ptr + ((y >> 5) * (hw_w >> 5) + (x >> 5)) * 1024
+         + (y & 31) * 32 + (x & 31);
+}
+
+static void ne_hw2d_glyph_cache_clear(ne_hw2d_glyph_cache_t *cache)
+{
+    for (int i = 0; i < 128; i++)
+        cache->ascii[i] = -1;
+
+    // Make all cells look older than any glyph rendered from now on
+    cache->stamp = 1;
+    memset(cache->cells, 0, cache->num_cells * sizeof(ne_hw2d_glyph_t));
+}
+
+int NEA_Hw2DGlyphCacheInit(NEA_Hw2DBG *bg, u32 slot, int first_tile,
+                            int num_cells, int cell_w, int cell_h)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+    NEA_Assert(bg->used, "BG not active");
+
+    if (bg->type > NEA_HW2D_BG_TILED_8BPP)
+    {
+        NEA_DebugPrint("NEA_Hw2DGlyphCacheInit: not a tiled BG");
+        return -1;
+    }
+
+    if (cell_w < 1 || cell_w > NEA_HW2D_GLYPH_MAX_CELL ||
+        cell_h < 1 || cell_h > NEA_HW2D_GLYPH_MAX_CELL || num_cells < 1)
+    {
+        NEA_DebugPrint("NEA_Hw2DGlyphCacheInit: invalid size");
+        return -1;
+    }
+
+    int max_tiles = (bg->type == NEA_HW2D_BG_TILED_4BPP) ? 512 : 256;
+    if (first_tile < 0 || first_tile + num_cells * cell_w * cell_h > max_tiles)
+    {
+        NEA_DebugPrint("NEA_Hw2DGlyphCacheInit: tiles outside of tile base");
+        return -1;
+    }
+
+    uintptr_t handle;
+    const void *font_texture;
+    size_t font_w, font_h;
+    unsigned int font_fmt;
+
+    if ((NEA_RichTextGetBitmapState(slot, &handle, &font_texture,
+                                    &font_w, &font_h, &font_fmt) != 0) ||
+        (font_fmt == GL_COMPRESSED))
+    {
+        NEA_DebugPrint("NEA_Hw2DGlyphCacheInit: invalid rich text slot");
+        return -1;
+    }
+
+    NEA_Hw2DGlyphCacheEnd(bg);
+
+    ne_hw2d_glyph_cache_t *cache = malloc(sizeof(ne_hw2d_glyph_cache_t)
+                                   + num_cells * sizeof(ne_hw2d_glyph_t));
+    if (cache == NULL)
+    {
+        NEA_DebugPrint("NEA_Hw2DGlyphCacheInit: not enough memory");
+        return -1;
+    }
+
+    cache->font_slot = slot;
+    cache->first_tile = first_tile;
+    cache->num_cells = num_cells;
+    cache->cell_w = cell_w;
+    cache->cell_h = cell_h;
+    cache->palette = 0;
+    cache->color = 1;
+    ne_hw2d_glyph_cache_clear(cache);
+
+    bg->glyph_cache = cache;
+    return 0;
+}
+
+void NEA_Hw2DGlyphCacheEnd(NEA_Hw2DBG *bg)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+
+    free(bg->glyph_cache);
+    bg->glyph_cache = NULL;
+}
+
+void NEA_Hw2DGlyphCacheSetColor(NEA_Hw2DBG *bg, int palette, int color)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+    NEA_AssertPointer(bg->glyph_cache, "No glyph cache");
+
+    ne_hw2d_glyph_cache_t *cache = bg->glyph_cache;
+
+    int max_color = (bg->type == NEA_HW2D_BG_TILED_4BPP) ? 15 : 255;
+    NEA_Assert(palette >= 0 && palette <= 15, "Invalid palette");
+    NEA_Assert(color >= 1 && color <= max_color, "Invalid color");
+
+    if (cache->palette == palette && cache->color == color)
+        return;
+
+    cache->palette = palette;
+    cache->color = color;
+    ne_hw2d_glyph_cache_clear(cache);
+}
+
+int NEA_Hw2DTextRenderTiled(NEA_Hw2DBG *bg, const char *str, int x, int y)
+{
+    NEA_AssertPointer(bg, "NULL bg");
+    NEA_AssertPointer(str, "NULL str");
+    NEA_Assert(bg->used, "BG not active");
+
+    ne_hw2d_glyph_cache_t *cache = bg->glyph_cache;
+    if (cache == NULL)
+    {
+        NEA_DebugPrint("NEA_Hw2DTextRenderTiled: no glyph cache");
+        return -1;
+    }
+
+    cache->stamp++;
+
+    int map_w = bg->width / 8;
+    int map_h = bg->height / 8;
+    int cells = cache->cell_w * cache->cell_h;
+    u16 attr = (bg->type == NEA_HW2D_BG_TILED_4BPP) ? cache->palette << 12 : 0;
+
+    int cx = x;
+    int cy = y;
+
+    while (*str != '\0')
+    {
+        if (*str == '\n')
+        {
+            cx = x;
+            cy += cache->cell_h;
+            str++;
+            continue;
+        }
+
+        int len = ne_hw2d_utf8_len(str);
+
+        // Characters outside of the background don't need a glyph
+        if (cx + cache->cell_w <= 0 || cx >= map_w ||
+            cy + cache->cell_h <= 0 || cy >= map_h)
+        {
+            cx += cache->cell_w;
+            str += len;
+            continue;
+        }
+
+        int cell = ne_hw2d_glyph_get(bg, cache, str, len);
+        if (cell < 0)
+        {
+            NEA_DebugPrint("NEA_Hw2DTextRenderTiled: glyph cache too small");
+            return -1;
+        }
+
+        u16 tile = cache->first_tile + cell * cells;
+
+        for (int ty = 0; ty < cache->cell_h; ty++)
+        {
+            int my = cy + ty;
+            if (my < 0 || my >= map_h)
+                continue;
+
+            for (int tx = 0; tx < cache->cell_w; tx++)
+            {
+                int mx = cx + tx;
+                if (mx < 0 || mx >= map_w)
+                    continue;
+
+                u16 value = (tile + ty * cache->cell_w + tx) | attr;
+                *ne_hw2d_map_entry(bg, mx, my) = value;
+            }
+        }
+
+        cx += cache->cell_w;
+        str += len;
+    }
+
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Memory report
+// ---------------------------------------------------------------------------
+
+static size_t ne_hw2d_banks_size(NEA_VRAMBankFlags banks)
+{
+    size_t size = 0;
+
+    if (banks & NEA_VRAM_A)
+        size += 128 * 1024;
+    if (banks & NEA_VRAM_B)
+        size += 128 * 1024;
+    if (banks & NEA_VRAM_C)
+        size += 128 * 1024;
+    if (banks & NEA_VRAM_D)
+        size += 128 * 1024;
+    if (banks & NEA_VRAM_E)
+        size += 64 * 1024;
+    if (banks & NEA_VRAM_H)
+        size += 32 * 1024;
+    if (banks & NEA_VRAM_I)
+        size += 16 * 1024;
+
+    return size;
+}
+
+int NEA_Hw2DGetMemReport(NEA_Hw2DEngine engine, NEA_MemReport *report)
+{
+    NEA_AssertPointer(report, "NULL pointer");
+
+    if (!ne_hw2d_state.initialized)
+        return 0;
+
+    memset(report, 0, sizeof(NEA_MemReport));
+
+    bool is_main = (engine == NEA_ENGINE_MAIN);
+    const NEA_Hw2DVRAMConfig *cfg = &ne_hw2d_state.vram_config;
+    NEA_Hw2DBG *bgs = is_main ? ne_hw2d_state.bgs_main : ne_hw2d_state.bgs_sub;
+    NEA_Hw2DOBJ *objs = is_main ? ne_hw2d_state.objs_main
+                                : ne_hw2d_state.objs_sub;
+
+    size_t bg_total = ne_hw2d_banks_size(is_main ? cfg->main_bg : cfg->sub_bg);
+    size_t obj_total = ne_hw2d_banks_size(is_main ? cfg->main_obj
+                                                  : cfg->sub_obj);
+
+    // Map and tile bases are never reused, so all the bases that have been
+    // handed out are used. Bitmap backgrounds start at base 0.
+    int map_next = is_main ? ne_hw2d_state.map_base_next_main
+                           : ne_hw2d_state.map_base_next_sub;
+    int tile_next = is_main ? ne_hw2d_state.tile_base_next_main
+                            : ne_hw2d_state.tile_base_next_sub;
+
+    size_t bg_used = (map_next * 2 * 1024) + ((tile_next - 1) * 16 * 1024);
+
+    for (int i = 0; i < 4; i++)
+    {
+        if (!bgs[i].used)
+            continue;
+
+        report->used_blocks++;
+
+        if (bgs[i].type == NEA_HW2D_BG_BITMAP_8)
+            bg_used += bgs[i].width * bgs[i].height;
+        else if (bgs[i].type == NEA_HW2D_BG_BITMAP_16)
+            bg_used += bgs[i].width * bgs[i].height * 2;
+    }
+
+    if (bg_used > bg_total)
+        bg_used = bg_total;
+
+    size_t obj_used = 0;
+
+    for (int i = 0; i < NEA_HW2D_MAX_OAM; i++)
+    {
+        if (!objs[i].used)
+            continue;
+
+        report->used_blocks++;
+        obj_used += objs[i].gfx_size;
+    }
+
+    if (obj_used > obj_total)
+        obj_used = obj_total;
+
+    report->used = bg_used + obj_used;
+    report->total = bg_total + obj_total;
+    report->owner[NEA_MEM_OWNER_HW2D_BG] = bg_used;
+    report->owner[NEA_MEM_OWNER_HW2D_OBJ] = obj_used;
+
+    ne_mem_report_add_free_block(report, bg_total - bg_used);
+    ne_mem_report_add_free_block(report, obj_total - obj_used);
+
+    return 1;
+}
@@ -0,0 +1,580 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAMath.h"
+
+/// @file NEAImpostor.c
+
+// Size of the texture atlas. The cells are placed in the top left corner of
+// the screen when they are rendered, and the capture unit saves that corner
+// as a texture.
+#define NE_IMPOSTOR_ATLAS_SIZE (2 * NEA_IMPOSTOR_CELL_SIZE)
+
+// Offset in VRAM_D of the capture of the atlas. The first 0x18000 bytes hold
+// the picture of the whole screen that is displayed while it's rendered.
+#define NE_IMPOSTOR_ATLAS_OFFSET 0x18000
+
+// Steps of a refresh. Each step of NEA_Process() is followed by a step of the
+// vertical blank.
+typedef enum {
+    NE_IMPOSTOR_IDLE,
+    NE_IMPOSTOR_SNAPSHOT_ARMED, // The next frame is captured into VRAM_D
+    NE_IMPOSTOR_SNAPSHOT,       // The frame is being captured
+    NE_IMPOSTOR_ATLAS_ARMED,    // The atlas has been sent to the 3D engine
+    NE_IMPOSTOR_ATLAS,          // The atlas is being captured
+} ne_impostor_step_t;
+
+static NEA_Impostor ne_impostors[NEA_IMPOSTOR_MAX];
+static bool ne_impostor_used[NEA_IMPOSTOR_MAX];
+static NEA_Material *ne_impostor_atlas;
+static bool ne_impostor_inited = false;
+
+static ne_impostor_step_t ne_impostor_step;
+static int ne_impostor_cooldown; // Frames until the next refresh
+static bool ne_impostor_copy_pending;
+static u32 ne_impostor_dispcnt; // DISPCNT before showing VRAM_D
+
+// Internal use... see NEAModel.c
+extern bool ne_model_frustum_culling;
+void ne_model_update_transform(NEA_Model *model);
+void ne_model_sphere_transform(const NEA_Model *model, const m4x3 *mat,
+                               int32_t *out);
+
+// Internal use... see NEACamera.c
+bool ne_camera_active_position(int32_t *pos);
+bool ne_camera_active_axes(int32_t *right, int32_t *up);
+
+// Internal use... see NEATexture.c
+NEA_VRAMBankFlags ne_texture_used_banks(void);
+int ne_texture_copy_async(const NEA_Material *tex, const void *src,
+                          size_t size, NEA_UploadCallback callback, void *arg);
+void ne_material_state_poly_format(u32 value);
+void ne_material_state_matrix_mode(u32 mode);
+
+int NEA_ImpostorSystemInit(void)
+{
+    if (ne_impostor_inited)
+        return 0;
+
+    if (NEA_CurrentExecutionMode() != NEA_ModeSingle3D)
+    {
+        NEA_DebugPrint("Only supported in single 3D mode");
+        return -1;
+    }
+
+    // VRAM_D must be free. It's used for textures by default.
+    if (ne_texture_used_banks() & NEA_VRAM_D)
+    {
+        NEA_DebugPrint("VRAM_D is used for textures");
+        return -1;
+    }
+
+    extern NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void) __attribute__((weak));
+    if (NEA_Hw2DGetClaimedBanks && (NEA_Hw2DGetClaimedBanks() & NEA_VRAM_D))
+    {
+        NEA_DebugPrint("VRAM_D is claimed by Hw2D");
+        return -1;
+    }
+
+    size_t size = NE_IMPOSTOR_ATLAS_SIZE * NE_IMPOSTOR_ATLAS_SIZE * 2;
+    void *blank = calloc(1, size);
+    if (blank == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return -1;
+    }
+
+    ne_impostor_atlas = NEA_MaterialCreate();
+    if (ne_impostor_atlas == NULL)
+    {
+        free(blank);
+        return -1;
+    }
+
+    if (NEA_MaterialTexLoad(ne_impostor_atlas, NEA_A1RGB5,
+                            NE_IMPOSTOR_ATLAS_SIZE, NE_IMPOSTOR_ATLAS_SIZE,
+                            NEA_TEXGEN_TEXCOORD, blank) == 0)
+    {
+        free(blank);
+        NEA_MaterialDelete(ne_impostor_atlas);
+        ne_impostor_atlas = NULL;
+        return -1;
+    }
+
+    free(blank);
+
+    vramSetBankD(VRAM_D_LCD);
+
+    memset(ne_impostors, 0, sizeof(ne_impostors));
+    memset(ne_impostor_used, 0, sizeof(ne_impostor_used));
+
+    ne_impostor_step = NE_IMPOSTOR_IDLE;
+    ne_impostor_cooldown = 0;
+    ne_impostor_copy_pending = false;
+
+    ne_impostor_inited = true;
+    return 0;
+}
+
+void NEA_ImpostorSystemEnd(void)
+{
+    if (!ne_impostor_inited)
+        return;
+
+    // Don't leave the screen showing VRAM_D
+    if (ne_impostor_step == NE_IMPOSTOR_ATLAS)
+        REG_DISPCNT = ne_impostor_dispcnt;
+
+    REG_DISPCAPCNT = 0;
+    GFX_CLEAR_COLOR = NEA_ClearColorGet();
+
+    // This also cancels the copy to the atlas if it's still pending
+    NEA_MaterialDelete(ne_impostor_atlas);
+    ne_impostor_atlas = NULL;
+
+    ne_impostor_inited = false;
+}
+
+// Internal use... see NEATexture.c. VRAM_D can't be given back to the texture
+// allocator while the impostors use it.
+bool ne_impostor_uses_vram_d(void)
+{
+    return ne_impostor_inited;
+}
+
+NEA_Impostor *NEA_ImpostorCreate(NEA_Model *model)
+{
+    if (!ne_impostor_inited)
+    {
+        NEA_DebugPrint("System not initialized");
+        return NULL;
+    }
+
+    NEA_AssertPointer(model, "NULL pointer");
+
+    if (model->bound_radius == 0)
+    {
+        NEA_DebugPrint("Model without bounding sphere");
+        return NULL;
+    }
+
+    for (int i = 0; i < NEA_IMPOSTOR_MAX; i++)
+    {
+        if (ne_impostor_used[i])
+            continue;
+
+        NEA_Impostor *imp = &ne_impostors[i];
+        memset(imp, 0, sizeof(NEA_Impostor));
+
+        imp->model = model;
+        imp->cell = i;
+        imp->distance = inttof32(8);
+        imp->alpha = 31;
+        NEA_ImpostorSetThreshold(imp, NEA_IMPOSTOR_DEFAULT_THRESHOLD);
+
+        ne_impostor_used[i] = true;
+        return imp;
+    }
+
+    NEA_DebugPrint("No free impostors");
+    return NULL;
+}
+
+void NEA_ImpostorDelete(NEA_Impostor *imp)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+
+    // The cell can't be reused until the copy that writes to it has finished,
+    // the new impostor would mark the old picture as valid.
+    imp->model = NULL;
+    imp->dirty = false;
+
+    if (!imp->capturing)
+        ne_impostor_used[imp->cell] = false;
+}
+
+void NEA_ImpostorSetDistanceI(NEA_Impostor *imp, int32_t distance)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+    NEA_Assert(distance >= 0, "Negative distance");
+    imp->distance = distance;
+}
+
+void NEA_ImpostorSetThreshold(NEA_Impostor *imp, int degrees)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+    NEA_AssertMinMax(1, degrees, 90, "Invalid angle %d", degrees);
+    imp->cos_threshold = cosLerp(degreesToAngle(degrees));
+}
+
+void NEA_ImpostorSetParams(NEA_Impostor *imp, u8 alpha, u8 id)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+    NEA_AssertMinMax(1, alpha, 31, "Invalid alpha value %d", alpha);
+    NEA_AssertMinMax(0, id, 63, "Invalid polygon ID %d", id);
+    imp->alpha = alpha;
+    imp->id = id;
+}
+
+void NEA_ImpostorInvalidate(NEA_Impostor *imp)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+    imp->dirty = true;
+}
+
+NEA_Material *NEA_ImpostorGetAtlas(void)
+{
+    return ne_impostor_atlas;
+}
+
+// Gets the bounding sphere of the model in world space as (x, y, z, radius)
+static void ne_impostor_sphere(const NEA_Impostor *imp, int32_t *sphere)
+{
+    NEA_Model *model = imp->model;
+
+    const m4x3 *mat = model->mat;
+    if (mat == NULL)
+    {
+        ne_model_update_transform(model);
+        mat = &model->transform;
+    }
+
+    ne_model_sphere_transform(model, mat, sphere);
+}
+
+// Gets the unit vector from the center of the sphere to the camera. It
+// returns false if there is no camera or it's at the center.
+static bool ne_impostor_view_dir(const int32_t *sphere, int32_t *dir)
+{
+    int32_t cam[3];
+    if (!ne_camera_active_position(cam))
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        dir[i] = cam[i] - sphere[i];
+
+    if ((dir[0] | dir[1] | dir[2]) == 0)
+        return false;
+
+    ne_normalize(dir);
+    return true;
+}
+
+void NEA_ImpostorDraw(NEA_Impostor *imp)
+{
+    NEA_AssertPointer(imp, "NULL pointer");
+
+    if (imp->model == NULL)
+        return;
+
+    int32_t sphere[4];
+    ne_impostor_sphere(imp, sphere);
+
+    int32_t cam[3];
+    if (!ne_camera_active_position(cam))
+    {
+        NEA_ModelDraw(imp->model);
+        return;
+    }
+
+    int32_t dist = 0;
+    int32_t dir[3];
+    for (int i = 0; i < 3; i++)
+    {
+        dir[i] = cam[i] - sphere[i];
+        dist += mulf32(dir[i], dir[i]);
+    }
+
+    if (dist < mulf32(imp->distance, imp->distance))
+    {
+        NEA_ModelDraw(imp->model);
+        return;
+    }
+
+    ne_normalize(dir);
+
+    if (!imp->valid || (dotf32(dir, imp->view_dir) < imp->cos_threshold))
+        imp->dirty = true;
+
+    if (!imp->valid)
+    {
+        NEA_ModelDraw(imp->model);
+        return;
+    }
+
+    int32_t right[3] = { inttof32(1), 0, 0 };
+    int32_t up[3] = { 0, inttof32(1), 0 };
+    ne_camera_active_axes(right, up);
+
+    int s0 = (imp->cell & 1) * NEA_IMPOSTOR_CELL_SIZE;
+    int t0 = (imp->cell >> 1) * NEA_IMPOSTOR_CELL_SIZE;
+    int s1 = s0 + NEA_IMPOSTOR_CELL_SIZE;
+    int t1 = t0 + NEA_IMPOSTOR_CELL_SIZE;
+
+    NEA_DisplayListWait();
+
+    MATRIX_PUSH = 0;
+
+    NEA_ViewMoveI(sphere[0], sphere[1], sphere[2]);
+
+    MATRIX_SCALE = sphere[3];
+    MATRIX_SCALE = sphere[3];
+    MATRIX_SCALE = sphere[3];
+
+    ne_material_state_poly_format(POLY_ALPHA(imp->alpha) | POLY_ID(imp->id) |
+                                  NEA_CULL_NONE);
+
+    NEA_MaterialUse(ne_impostor_atlas);
+
+    GFX_COLOR = NEA_White;
+
+    GFX_BEGIN = GL_QUADS;
+
+    // Up-left, down-left, down-right and up-right corners
+    GFX_TEX_COORD = TEXTURE_PACK(inttot16(s0), inttot16(t0));
+    GFX_VERTEX16 = ((up[1] - right[1]) << 16) | ((up[0] - right[0]) & 0xFFFF);
+    GFX_VERTEX16 = (up[2] - right[2]) & 0xFFFF;
+
+    GFX_TEX_COORD = TEXTURE_PACK(inttot16(s0), inttot16(t1));
+    GFX_VERTEX16 = ((-up[1] - right[1]) << 16)
+                 | ((-up[0] - right[0]) & 0xFFFF);
+    GFX_VERTEX16 = (-up[2] - right[2]) & 0xFFFF;
+
+    GFX_TEX_COORD = TEXTURE_PACK(inttot16(s1), inttot16(t1));
+    GFX_VERTEX16 = ((right[1] - up[1]) << 16) | ((right[0] - up[0]) & 0xFFFF);
+    GFX_VERTEX16 = (right[2] - up[2]) & 0xFFFF;
+
+    GFX_TEX_COORD = TEXTURE_PACK(inttot16(s1), inttot16(t0));
+    GFX_VERTEX16 = ((right[1] + up[1]) << 16) | ((right[0] + up[0]) & 0xFFFF);
+    GFX_VERTEX16 = (right[2] + up[2]) & 0xFFFF;
+
+    MATRIX_POP = 1;
+}
+
+// Returns true if there is a picture that has to be refreshed
+static bool ne_impostor_refresh_needed(void)
+{
+    for (int i = 0; i < NEA_IMPOSTOR_MAX; i++)
+    {
+        if (ne_impostor_used[i] && ne_impostors[i].dirty)
+            return true;
+    }
+
+    return false;
+}
+
+// Renders the pictures that have to be refreshed in their cells
+static void ne_impostor_draw_atlas(void)
+{
+    int32_t right[3] = { inttof32(1), 0, 0 };
+    int32_t up[3] = { 0, inttof32(1), 0 };
+    ne_camera_active_axes(right, up);
+
+    // Don't cull the models against the frustum of the camera of the scene
+    bool culling = ne_model_frustum_culling;
+    ne_model_frustum_culling = false;
+
+    for (int i = 0; i < NEA_IMPOSTOR_MAX; i++)
+    {
+        NEA_Impostor *imp = &ne_impostors[i];
+
+        if (!ne_impostor_used[i] || !imp->dirty)
+            continue;
+
+        int32_t sphere[4];
+        ne_impostor_sphere(imp, sphere);
+        if (!ne_impostor_view_dir(sphere, imp->next_dir))
+            continue;
+
+        // The viewport origin is the bottom left corner of the screen
+        int x1 = (imp->cell & 1) * NEA_IMPOSTOR_CELL_SIZE;
+        int y2 = 191 - (imp->cell >> 1) * NEA_IMPOSTOR_CELL_SIZE;
+        int x2 = x1 + NEA_IMPOSTOR_CELL_SIZE - 1;
+        int y1 = y2 - NEA_IMPOSTOR_CELL_SIZE + 1;
+        GFX_VIEWPORT = x1 | (y1 << 8) | (x2 << 16) | (y2 << 24);
+
+        // The sphere fills the cell. The eye is far enough to see all of it.
+        int32_t r = sphere[3];
+
+        ne_material_state_matrix_mode(GL_PROJECTION);
+        MATRIX_IDENTITY = 0;
+        glOrthof32(-r, r, -r, r, r, 3 * r);
+
+        ne_material_state_matrix_mode(GL_MODELVIEW);
+        MATRIX_IDENTITY = 0;
+        gluLookAtf32(sphere[0] + 2 * mulf32(imp->next_dir[0], r),
+                     sphere[1] + 2 * mulf32(imp->next_dir[1], r),
+                     sphere[2] + 2 * mulf32(imp->next_dir[2], r),
+                     sphere[0], sphere[1], sphere[2],
+                     up[0], up[1], up[2]);
+
+        NEA_ModelDraw(imp->model);
+
+        imp->dirty = false;
+        imp->capturing = true;
+    }
+
+    ne_model_frustum_culling = culling;
+}
+
+// Called when the atlas has been copied to the texture
+static void ne_impostor_copy_done(void *arg)
+{
+    (void)arg;
+
+    ne_impostor_copy_pending = false;
+
+    for (int i = 0; i < NEA_IMPOSTOR_MAX; i++)
+    {
+        NEA_Impostor *imp = &ne_impostors[i];
+
+        if (!imp->capturing)
+            continue;
+
+        imp->capturing = false;
+
+        if (imp->model == NULL)
+        {
+            // Deleted while it was being captured
+            ne_impostor_used[i] = false;
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+            imp->view_dir[j] = imp->next_dir[j];
+        imp->valid = true;
+    }
+}
+
+// Internal use... see NEAGeneral.c. It's called by NEA_Process() before
+// drawing the scene. It returns true if the scene has to be skipped because
+// the atlas has been drawn instead.
+bool ne_impostor_capture_pass(void)
+{
+    if (!ne_impostor_inited)
+        return false;
+
+    switch (ne_impostor_step)
+    {
+        case NE_IMPOSTOR_IDLE:
+        {
+            if (ne_impostor_cooldown > 0)
+                ne_impostor_cooldown--;
+
+            if ((ne_impostor_cooldown > 0) || ne_impostor_copy_pending ||
+                !ne_impostor_refresh_needed())
+                return false;
+
+            // Save the next frame that is displayed, it will be displayed
+            // again while the atlas is rendered.
+            REG_DISPCAPCNT = DCAP_BANK(DCAP_BANK_VRAM_D)
+                           | DCAP_SIZE(DCAP_SIZE_256x192)
+                           | DCAP_MODE(DCAP_MODE_A)
+                           | DCAP_SRC_A(DCAP_SRC_A_COMPOSITED)
+                           | DCAP_ENABLE;
+
+            ne_impostor_step = NE_IMPOSTOR_SNAPSHOT_ARMED;
+            return false;
+        }
+
+        case NE_IMPOSTOR_SNAPSHOT:
+        {
+            ne_impostor_draw_atlas();
+
+            REG_DISPCAPCNT = DCAP_BANK(DCAP_BANK_VRAM_D)
+                           | DCAP_SIZE(DCAP_SIZE_128x128)
+                           | DCAP_OFFSET(3) // Write with an offset of 0x18000
+                           | DCAP_MODE(DCAP_MODE_A)
+                           | DCAP_SRC_A(DCAP_SRC_A_3DONLY)
+                           | DCAP_ENABLE;
+
+            // The empty texels of the atlas have to be transparent
+            GFX_CLEAR_COLOR = NEA_ClearColorGet() & ~(0x1F << 16);
+
+            ne_impostor_step = NE_IMPOSTOR_ATLAS_ARMED;
+            return true;
+        }
+
+        case NE_IMPOSTOR_ATLAS:
+        {
+            GFX_CLEAR_COLOR = NEA_ClearColorGet();
+            return false;
+        }
+
+        default:
+        {
+            // The vertical blank hasn't been reached since the last step
+            return false;
+        }
+    }
+}
+
+// Internal use... see NEAGeneral.c. It's called by NEA_WaitForVBL() right
+// after the start of the vertical blank.
+void ne_impostor_vblank(void)
+{
+    if (!ne_impostor_inited)
+        return;
+
+    switch (ne_impostor_step)
+    {
+        case NE_IMPOSTOR_SNAPSHOT_ARMED:
+        {
+            ne_impostor_step = NE_IMPOSTOR_SNAPSHOT;
+            break;
+        }
+
+        case NE_IMPOSTOR_ATLAS_ARMED:
+        {
+            // The 3D engine is going to display the atlas, show the saved
+            // frame instead.
+            ne_impostor_dispcnt = REG_DISPCNT;
+            REG_DISPCNT = (ne_impostor_dispcnt & ~(0xF << 16)) | MODE_FB3;
+
+            ne_impostor_step = NE_IMPOSTOR_ATLAS;
+            break;
+        }
+
+        case NE_IMPOSTOR_ATLAS:
+        {
+            REG_DISPCNT = ne_impostor_dispcnt;
+
+            const void *src = (const u8 *)VRAM_D + NE_IMPOSTOR_ATLAS_OFFSET;
+            size_t size = NE_IMPOSTOR_ATLAS_SIZE * NE_IMPOSTOR_ATLAS_SIZE * 2;
+
+            if (ne_texture_copy_async(ne_impostor_atlas, src, size,
+                                      ne_impostor_copy_done, NULL) == 0)
+            {
+                // Try again in the next refresh
+                for (int i = 0; i < NEA_IMPOSTOR_MAX; i++)
+                {
+                    NEA_Impostor *imp = &ne_impostors[i];
+                    if (imp->capturing)
+                    {
+                        imp->capturing = false;
+                        imp->dirty = (imp->model != NULL);
+                        if (imp->model == NULL)
+                            ne_impostor_used[i] = false;
+                    }
+                }
+            }
+            else
+            {
+                ne_impostor_copy_pending = true;
+            }
+
+            ne_impostor_cooldown = NEA_IMPOSTOR_REFRESH_INTERVAL;
+            ne_impostor_step = NE_IMPOSTOR_IDLE;
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAJob.c
+
+// Internal use... see NEAProfile.c
+void ne_cycles_start(void);
+u32 ne_cycles_now(void);
+
+typedef struct {
+    NEA_JobFunc fn; // NULL if the entry is free
+    void *arg;
+    int priority;
+    u32 cost;       // Estimated cost in bus cycles
+    u32 order;      // Jobs with the same priority run in this order
+} ne_job_t;
+
+static ne_job_t ne_jobs[NEA_JOB_QUEUE_SIZE];
+static int ne_job_count;
+static u32 ne_job_order;
+static u32 ne_job_wait_budget = NEA_JOB_DEFAULT_WAIT_BUDGET;
+static bool ne_job_running; // Jobs can wait for the GPU too
+
+// Cycles of a scanline
+#define NE_JOB_LINE_CYCLES 2130
+
+int NEA_JobAdd(NEA_JobFunc fn, void *arg, int priority, u32 cost)
+{
+    NEA_AssertPointer(fn, "NULL function pointer");
+
+    if (ne_job_count == NEA_JOB_QUEUE_SIZE)
+    {
+        NEA_DebugPrint("Job queue full");
+        return 0;
+    }
+
+    ne_cycles_start();
+
+    for (int i = 0; i < NEA_JOB_QUEUE_SIZE; i++)
+    {
+        ne_job_t *job = &ne_jobs[i];
+        if (job->fn != NULL)
+            continue;
+
+        job->fn = fn;
+        job->arg = arg;
+        job->priority = priority;
+        job->cost = cost;
+        job->order = ne_job_order++;
+        ne_job_count++;
+        return 1;
+    }
+
+    return 0;
+}
+
+void NEA_JobCancel(NEA_JobFunc fn, void *arg)
+{
+    for (int i = 0; i < NEA_JOB_QUEUE_SIZE; i++)
+    {
+        ne_job_t *job = &ne_jobs[i];
+        if (job->fn == fn && job->arg == arg && fn != NULL)
+        {
+            job->fn = NULL;
+            ne_job_count--;
+        }
+    }
+}
+
+int NEA_JobGetCount(void)
+{
+    return ne_job_count;
+}
+
+void NEA_JobSetWaitBudget(u32 cycles)
+{
+    ne_job_wait_budget = cycles;
+}
+
+// Returns the job with the highest priority that fits in the budget
+static ne_job_t *ne_job_pick(u32 budget)
+{
+    ne_job_t *best = NULL;
+
+    for (int i = 0; i < NEA_JOB_QUEUE_SIZE; i++)
+    {
+        ne_job_t *job = &ne_jobs[i];
+        if (job->fn == NULL || job->cost > budget)
+            continue;
+
+        if (best == NULL || job->priority > best->priority ||
+            (job->priority == best->priority &&
+             (s32)(job->order - best->order) < 0))
+            best = job;
+    }
+
+    return best;
+}
+
+static void ne_job_run_one(ne_job_t *job)
+{
+    ne_job_running = true;
+
+    NEA_JobFunc fn = job->fn;
+
+    u32 start = ne_cycles_now();
+    bool done = fn(job->arg);
+    u32 elapsed = ne_cycles_now() - start;
+
+    ne_job_running = false;
+
+    // The job may have cancelled itself
+    if (job->fn != fn)
+        return;
+
+    if (done)
+    {
+        job->fn = NULL;
+        ne_job_count--;
+        return;
+    }
+
+    // Slow runs raise the estimate right away, fast ones lower it slowly
+    if (elapsed > job->cost)
+        job->cost = elapsed;
+    else
+        job->cost = (job->cost * 3 + elapsed) / 4;
+
+    job->order = ne_job_order++;
+}
+
+int NEA_JobRun(u32 cycles)
+{
+    if (ne_job_running || ne_job_count == 0)
+        return 0;
+
+    NEA_ProfileBegin(NEA_PROFILE_JOBS);
+
+    int count = 0;
+    u32 start = ne_cycles_now();
+
+    while (ne_job_count > 0)
+    {
+        u32 elapsed = ne_cycles_now() - start;
+        if (elapsed >= cycles)
+            break;
+
+        ne_job_t *job = ne_job_pick(cycles - elapsed);
+        if (job == NULL)
+            break;
+
+        ne_job_run_one(job);
+        count++;
+    }
+
+    NEA_ProfileEnd(NEA_PROFILE_JOBS);
+
+    return count;
+}
+
+void NEA_JobFlush(void)
+{
+    if (ne_job_running)
+        return;
+
+    while (ne_job_count > 0)
+        ne_job_run_one(ne_job_pick(UINT32_MAX));
+}
+
+// Internal use... see NEADisplayList.c. Runs one job while waiting for the GPU.
+void ne_job_idle(void)
+{
+    if (ne_job_running || ne_job_count == 0 || ne_job_wait_budget == 0)
+        return;
+
+    ne_job_t *job = ne_job_pick(ne_job_wait_budget);
+    if (job == NULL)
+        return;
+
+    NEA_ProfileBegin(NEA_PROFILE_JOBS);
+    ne_job_run_one(job);
+    NEA_ProfileEnd(NEA_PROFILE_JOBS);
+}
+
+// Internal use... see NEAGeneral.c. Runs jobs until the vertical blank, leaving
+// one line of margin.
+void ne_job_before_vbl(void)
+{
+    int vcount = REG_VCOUNT;
+    if (vcount >= 191)
+        return;
+
+    NEA_JobRun((191 - vcount) * NE_JOB_LINE_CYCLES);
+}
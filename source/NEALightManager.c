@@ -0,0 +1,621 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEALightManager.c
+
+// The grid is a hash of cells on the XZ plane. Cells that are further apart
+// than the size of the grid share the same bucket, the distance test rejects
+// the lights that are too far.
+#define NE_LIGHT_GRID_DIM   8
+#define NE_LIGHT_GRID_CELLS (NE_LIGHT_GRID_DIM * NE_LIGHT_GRID_DIM)
+
+#define NE_LIGHT_HW_LIGHTS  4
+
+struct NEA_LightManager_ {
+    NEA_SceneLight *lights;
+    int max_lights;
+    int32_t cell_size;
+
+    // The grid is built again before the next selection if this is set
+    bool dirty;
+
+    // Lights of each bucket, bucket i is [cell_start[i], cell_start[i + 1])
+    int cell_start[NE_LIGHT_GRID_CELLS + 1];
+    int *cell_items;
+    int cell_capacity;
+
+    int *directional;
+    int num_directional;
+
+    // Lights that appear in several buckets are only tested once per query
+    u32 *stamp;
+    u32 query;
+};
+
+// Internal use... see NEAModel.c
+void ne_model_sphere_transform(const NEA_Model *model, const m4x3 *mat,
+                               int32_t *out);
+
+static NEA_LightManager *ne_light_manager_active = NULL;
+
+// Values written to the hardware registers
+static u32 ne_light_hw_vector[NE_LIGHT_HW_LIGHTS];
+static u32 ne_light_hw_color[NE_LIGHT_HW_LIGHTS];
+static int ne_light_hw_source[NE_LIGHT_HW_LIGHTS] = { -1, -1, -1, -1 };
+static u32 ne_light_hw_valid = 0; // One bit per hardware light
+
+NEA_LightManager *NEA_LightManagerCreate(int max_lights)
+{
+    NEA_Assert(max_lights > 0, "Invalid number of lights");
+
+    NEA_LightManager *mgr = calloc(1, sizeof(NEA_LightManager));
+    if (mgr == NULL)
+        goto error;
+
+    mgr->lights = calloc(max_lights, sizeof(NEA_SceneLight));
+    mgr->directional = calloc(max_lights, sizeof(int));
+    mgr->stamp = calloc(max_lights, sizeof(u32));
+    if ((mgr->lights == NULL) || (mgr->directional == NULL) ||
+        (mgr->stamp == NULL))
+        goto error;
+
+    mgr->max_lights = max_lights;
+    mgr->cell_size = NEA_LIGHT_MANAGER_CELL_SIZE;
+    mgr->dirty = true;
+
+    return mgr;
+
+error:
+    NEA_DebugPrint("Not enough memory");
+    if (mgr != NULL)
+    {
+        free(mgr->lights);
+        free(mgr->directional);
+        free(mgr->stamp);
+        free(mgr);
+    }
+    return NULL;
+}
+
+void NEA_LightManagerDelete(NEA_LightManager *mgr)
+{
+    NEA_AssertPointer(mgr, "NULL manager pointer");
+
+    if (ne_light_manager_active == mgr)
+        NEA_LightManagerUse(NULL);
+
+    free(mgr->lights);
+    free(mgr->directional);
+    free(mgr->stamp);
+    free(mgr->cell_items);
+    free(mgr);
+}
+
+void NEA_LightManagerUse(NEA_LightManager *mgr)
+{
+    if (ne_light_manager_active == mgr)
+        return;
+
+    ne_light_manager_active = mgr;
+
+    // The indices of the lights in the hardware slots refer to the old manager
+    for (int i = 0; i < NE_LIGHT_HW_LIGHTS; i++)
+        ne_light_hw_source[i] = -1;
+}
+
+void NEA_LightManagerSetCellSizeI(NEA_LightManager *mgr, int32_t size)
+{
+    NEA_AssertPointer(mgr, "NULL manager pointer");
+    NEA_Assert(size > 0, "Invalid cell size");
+
+    mgr->cell_size = size;
+    mgr->dirty = true;
+}
+
+void NEA_LightManagerInvalidate(void)
+{
+    ne_light_hw_valid = 0;
+}
+
+// Returns the cell that contains a coordinate, rounding towards minus infinity
+static int ne_light_cell(int32_t v, int32_t size)
+{
+    if (v >= 0)
+        return v / size;
+
+    return -((-v + size - 1) / size);
+}
+
+// Gets the range of cells touched by [v - r, v + r]. The range never has more
+// cells than the grid, because the cells after that would be repeated.
+static void ne_light_cell_range(int32_t v, int32_t r, int32_t size,
+                                int *first, int *last)
+{
+    *first = ne_light_cell(v - r, size);
+    *last = ne_light_cell(v + r, size);
+
+    if (*last - *first >= NE_LIGHT_GRID_DIM)
+        *last = *first + NE_LIGHT_GRID_DIM - 1;
+}
+
+static inline int ne_light_bucket(int cx, int cz)
+{
+    return (cx & (NE_LIGHT_GRID_DIM - 1))
+         + (cz & (NE_LIGHT_GRID_DIM - 1)) * NE_LIGHT_GRID_DIM;
+}
+
+// Builds the grid with a counting sort: the first pass counts the lights of
+// each bucket, the second one stores them.
+static int ne_light_manager_rebuild(NEA_LightManager *mgr)
+{
+    int *count = mgr->cell_start;
+
+    for (int i = 0; i <= NE_LIGHT_GRID_CELLS; i++)
+        count[i] = 0;
+
+    mgr->num_directional = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int i = 0; i < mgr->max_lights; i++)
+        {
+            const NEA_SceneLight *light = &mgr->lights[i];
+
+            if (!light->used || !light->enabled)
+                continue;
+
+            if (light->type == NEA_LIGHT_DIRECTIONAL)
+            {
+                if (pass == 0)
+                    mgr->directional[mgr->num_directional++] = i;
+                continue;
+            }
+
+            int x0, x1, z0, z1;
+            ne_light_cell_range(light->position.x, light->radius,
+                                mgr->cell_size, &x0, &x1);
+            ne_light_cell_range(light->position.z, light->radius,
+                                mgr->cell_size, &z0, &z1);
+
+            for (int cz = z0; cz <= z1; cz++)
+            {
+                for (int cx = x0; cx <= x1; cx++)
+                {
+                    int bucket = ne_light_bucket(cx, cz);
+
+                    if (pass == 0)
+                        count[bucket + 1]++;
+                    else
+                        mgr->cell_items[count[bucket]++] = i;
+                }
+            }
+        }
+
+        if (pass == 1)
+            break;
+
+        // Convert the counts into the start of each bucket
+        for (int i = 0; i < NE_LIGHT_GRID_CELLS; i++)
+            count[i + 1] += count[i];
+
+        int total = count[NE_LIGHT_GRID_CELLS];
+        if (total > mgr->cell_capacity)
+        {
+            int *items = malloc(total * sizeof(int));
+            if (items == NULL)
+            {
+                NEA_DebugPrint("Not enough memory");
+                return 0;
+            }
+
+            free(mgr->cell_items);
+            mgr->cell_items = items;
+            mgr->cell_capacity = total;
+        }
+    }
+
+    // The second pass has moved the start of each bucket to the start of the
+    // next one, move them back.
+    for (int i = NE_LIGHT_GRID_CELLS; i > 0; i--)
+        count[i] = count[i - 1];
+    count[0] = 0;
+
+    mgr->dirty = false;
+    return 1;
+}
+
+typedef struct {
+    int index;     // Index of the light
+    int32_t score; // Influence on the sphere (f32)
+    int32_t dist;  // Distance from the light to the center (f32)
+} ne_light_pick;
+
+// Adds a light to the list of the best lights if it's better than one of them.
+// The list is sorted from the best to the worst light.
+static void ne_light_pick_add(ne_light_pick *best, int *num_best,
+                              int index, int32_t score, int32_t dist)
+{
+    int pos = *num_best;
+    if (pos == NE_LIGHT_HW_LIGHTS)
+    {
+        if (score <= best[pos - 1].score)
+            return;
+        pos--;
+    }
+    else
+    {
+        (*num_best)++;
+    }
+
+    while ((pos > 0) && (best[pos - 1].score < score))
+    {
+        best[pos] = best[pos - 1];
+        pos--;
+    }
+
+    best[pos].index = index;
+    best[pos].score = score;
+    best[pos].dist = dist;
+}
+
+static void ne_light_test_point(const NEA_LightManager *mgr, int index,
+                                const int32_t *sphere, ne_light_pick *best,
+                                int *num_best)
+{
+    const NEA_SceneLight *light = &mgr->lights[index];
+
+    int64_t dx = sphere[0] - light->position.x;
+    int64_t dy = sphere[1] - light->position.y;
+    int64_t dz = sphere[2] - light->position.z;
+    int32_t dist = sqrt64(dx * dx + dy * dy + dz * dz);
+
+    // Distance from the light to the closest point of the sphere
+    int32_t d = dist - sphere[3];
+    if (d < 0)
+        d = 0;
+
+    if (d >= light->radius)
+        return;
+
+    int32_t att = inttof32(1) - divf32(d, light->radius);
+    int32_t score = mulf32(mulf32(att, att), light->intensity);
+    if (score <= 0)
+        return;
+
+    ne_light_pick_add(best, num_best, index, score, dist);
+}
+
+// Multiplies the components of a RGB15 color by a value between 0 and 1 (f32)
+static u32 ne_light_scale_color(u32 color, int32_t scale)
+{
+    if (scale >= inttof32(1))
+        return color & 0x7FFF;
+
+    u32 r = ((color & 0x1F) * scale) >> 12;
+    u32 g = (((color >> 5) & 0x1F) * scale) >> 12;
+    u32 b = (((color >> 10) & 0x1F) * scale) >> 12;
+
+    return r | (g << 5) | (b << 10);
+}
+
+static inline u32 ne_light_v10(int32_t v)
+{
+    v >>= 3; // f32 to v10
+    if (v > 511)
+        v = 511;
+    else if (v < -512)
+        v = -512;
+    return v & 0x3FF;
+}
+
+// Calculates the values of the registers of a selected light
+static void ne_light_hw_values(const NEA_LightManager *mgr,
+                               const ne_light_pick *pick,
+                               const int32_t *sphere, u32 *vector, u32 *color)
+{
+    const NEA_SceneLight *light = &mgr->lights[pick->index];
+
+    int32_t x, y, z, scale;
+
+    if (light->type == NEA_LIGHT_DIRECTIONAL)
+    {
+        x = light->direction.x;
+        y = light->direction.y;
+        z = light->direction.z;
+        scale = light->intensity;
+    }
+    else
+    {
+        // The light goes from the light to the center of the sphere
+        if (pick->dist == 0)
+        {
+            x = 0;
+            y = inttof32(-1);
+            z = 0;
+        }
+        else
+        {
+            int32_t inv = divf32(inttof32(1), pick->dist);
+            x = mulf32(sphere[0] - light->position.x, inv);
+            y = mulf32(sphere[1] - light->position.y, inv);
+            z = mulf32(sphere[2] - light->position.z, inv);
+        }
+        scale = pick->score;
+    }
+
+    *vector = (ne_light_v10(z) << 20) | (ne_light_v10(y) << 10)
+            | ne_light_v10(x);
+    *color = ne_light_scale_color(light->color, scale);
+}
+
+static void ne_light_hw_write(int slot, u32 vector, u32 color)
+{
+    vector |= slot << 30;
+    color |= slot << 30;
+
+    bool valid = ne_light_hw_valid & BIT(slot);
+
+    if (!valid || (ne_light_hw_vector[slot] != vector))
+    {
+        GFX_LIGHT_VECTOR = vector;
+        ne_light_hw_vector[slot] = vector;
+    }
+
+    if (!valid || (ne_light_hw_color[slot] != color))
+    {
+        GFX_LIGHT_COLOR = color;
+        ne_light_hw_color[slot] = color;
+    }
+
+    ne_light_hw_valid |= BIT(slot);
+}
+
+// Switches off a hardware light by making it black. The vector is left as it
+// is, it doesn't matter.
+static void ne_light_hw_off(int slot)
+{
+    u32 color = slot << 30;
+
+    if ((ne_light_hw_valid & BIT(slot)) && (ne_light_hw_color[slot] == color))
+        return;
+
+    GFX_LIGHT_COLOR = color;
+    ne_light_hw_color[slot] = color;
+
+    // The vector is still unknown if it has never been written
+    if (!(ne_light_hw_valid & BIT(slot)))
+        ne_light_hw_vector[slot] = UINT32_MAX;
+
+    ne_light_hw_valid |= BIT(slot);
+}
+
+static int ne_light_manager_apply(NEA_LightManager *mgr, const int32_t *sphere)
+{
+    if (mgr->dirty)
+    {
+        if (ne_light_manager_rebuild(mgr) == 0)
+            return 0;
+    }
+
+    ne_light_pick best[NE_LIGHT_HW_LIGHTS];
+    int num_best = 0;
+
+    for (int i = 0; i < mgr->num_directional; i++)
+    {
+        int index = mgr->directional[i];
+        ne_light_pick_add(best, &num_best, index,
+                          mgr->lights[index].intensity, 0);
+    }
+
+    // Look for point lights in the cells touched by the sphere
+    mgr->query++;
+    if (mgr->query == 0)
+    {
+        // Start again after the counter overflows
+        for (int i = 0; i < mgr->max_lights; i++)
+            mgr->stamp[i] = 0;
+        mgr->query = 1;
+    }
+
+    int x0, x1, z0, z1;
+    ne_light_cell_range(sphere[0], sphere[3], mgr->cell_size, &x0, &x1);
+    ne_light_cell_range(sphere[2], sphere[3], mgr->cell_size, &z0, &z1);
+
+    for (int cz = z0; cz <= z1; cz++)
+    {
+        for (int cx = x0; cx <= x1; cx++)
+        {
+            int bucket = ne_light_bucket(cx, cz);
+
+            for (int j = mgr->cell_start[bucket];
+                 j < mgr->cell_start[bucket + 1]; j++)
+            {
+                int index = mgr->cell_items[j];
+                if (mgr->stamp[index] == mgr->query)
+                    continue;
+                mgr->stamp[index] = mgr->query;
+
+                ne_light_test_point(mgr, index, sphere, best, &num_best);
+            }
+        }
+    }
+
+    // Keep the lights that were already selected in the same hardware slot, so
+    // that their registers may not need to change.
+    int slot_of[NE_LIGHT_HW_LIGHTS];
+    bool slot_used[NE_LIGHT_HW_LIGHTS] = { false };
+
+    for (int i = 0; i < num_best; i++)
+    {
+        slot_of[i] = -1;
+        for (int s = 0; s < NE_LIGHT_HW_LIGHTS; s++)
+        {
+            if (ne_light_hw_source[s] == best[i].index)
+            {
+                slot_of[i] = s;
+                slot_used[s] = true;
+                break;
+            }
+        }
+    }
+
+    for (int i = 0; i < num_best; i++)
+    {
+        if (slot_of[i] != -1)
+            continue;
+
+        for (int s = 0; s < NE_LIGHT_HW_LIGHTS; s++)
+        {
+            if (!slot_used[s])
+            {
+                slot_of[i] = s;
+                slot_used[s] = true;
+                break;
+            }
+        }
+    }
+
+    for (int s = 0; s < NE_LIGHT_HW_LIGHTS; s++)
+        ne_light_hw_source[s] = -1;
+
+    for (int i = 0; i < num_best; i++)
+    {
+        u32 vector, color;
+        ne_light_hw_values(mgr, &best[i], sphere, &vector, &color);
+        ne_light_hw_write(slot_of[i], vector, color);
+        ne_light_hw_source[slot_of[i]] = best[i].index;
+    }
+
+    for (int s = 0; s < NE_LIGHT_HW_LIGHTS; s++)
+    {
+        if (!slot_used[s])
+            ne_light_hw_off(s);
+    }
+
+    return num_best;
+}
+
+int NEA_LightManagerApplyI(int32_t x, int32_t y, int32_t z, int32_t radius)
+{
+    NEA_Assert(radius >= 0, "Negative radius");
+
+    if (ne_light_manager_active == NULL)
+        return 0;
+
+    NEA_DisplayListWait();
+
+    int32_t sphere[4] = { x, y, z, radius };
+    return ne_light_manager_apply(ne_light_manager_active, sphere);
+}
+
+// Internal use... see NEAModel.c
+void ne_light_manager_apply_model(const NEA_Model *model, const m4x3 *mat)
+{
+    if (ne_light_manager_active == NULL)
+        return;
+
+    int32_t sphere[4];
+    ne_model_sphere_transform(model, mat, sphere);
+
+    ne_light_manager_apply(ne_light_manager_active, sphere);
+}
+
+NEA_SceneLight *NEA_SceneLightCreate(NEA_LightManager *mgr,
+                                     NEA_LightType type)
+{
+    NEA_AssertPointer(mgr, "NULL manager pointer");
+
+    for (int i = 0; i < mgr->max_lights; i++)
+    {
+        NEA_SceneLight *light = &mgr->lights[i];
+        if (light->used)
+            continue;
+
+        light->manager = mgr;
+        light->type = type;
+        light->used = true;
+        light->enabled = true;
+        light->color = NEA_White;
+        light->intensity = inttof32(1);
+        light->position = NEA_Vec3Make(0, 0, 0);
+        light->direction = NEA_Vec3Make(0, inttof32(-1), 0);
+        light->radius = inttof32(1);
+
+        mgr->dirty = true;
+        return light;
+    }
+
+    NEA_DebugPrint("No free lights");
+    return NULL;
+}
+
+void NEA_SceneLightDelete(NEA_SceneLight *light)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+
+    NEA_LightManager *mgr = light->manager;
+    int index = light - mgr->lights;
+
+    // Don't let the next selection think that this light is still in the
+    // hardware, a new light may use the same index.
+    if (ne_light_manager_active == mgr)
+    {
+        for (int s = 0; s < NE_LIGHT_HW_LIGHTS; s++)
+        {
+            if (ne_light_hw_source[s] == index)
+                ne_light_hw_source[s] = -1;
+        }
+    }
+
+    light->used = false;
+    mgr->dirty = true;
+}
+
+void NEA_SceneLightSetEnabled(NEA_SceneLight *light, bool enabled)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+
+    light->enabled = enabled;
+    light->manager->dirty = true;
+}
+
+void NEA_SceneLightSetColor(NEA_SceneLight *light, u32 color,
+                            int32_t intensity)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+    NEA_Assert(intensity >= 0, "Negative intensity");
+
+    light->color = color;
+    light->intensity = intensity;
+}
+
+void NEA_SceneLightSetPositionI(NEA_SceneLight *light,
+                                int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+
+    light->position = NEA_Vec3Make(x, y, z);
+    light->manager->dirty = true;
+}
+
+void NEA_SceneLightSetDirectionI(NEA_SceneLight *light,
+                                 int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+
+    light->direction = NEA_Vec3Normalize(NEA_Vec3Make(x, y, z));
+}
+
+void NEA_SceneLightSetRadiusI(NEA_SceneLight *light, int32_t radius)
+{
+    NEA_AssertPointer(light, "NULL light pointer");
+    NEA_Assert(radius > 0, "Invalid radius");
+
+    light->radius = radius;
+    light->manager->dirty = true;
+}
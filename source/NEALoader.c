@@ -0,0 +1,456 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+
+/// @file NEALoader.c
+
+typedef enum {
+    NE_LOADER_FILE,
+    NE_LOADER_TEXTURE,
+    NE_LOADER_GRF,
+    NE_LOADER_MESH,
+    NE_LOADER_COLMESH
+} ne_loader_type_t;
+
+typedef struct {
+    ne_loader_type_t type;
+    char path[NEA_LOADER_PATH_LEN];
+    void *target;           // Material, model or argument of the callback
+    NEA_Palette *pal;       // NE_LOADER_GRF only
+    NEA_TextureFormat fmt;  // NE_LOADER_TEXTURE only
+    int sizex, sizey;       // NE_LOADER_TEXTURE only
+    NEA_TextureFlags flags; // NE_LOADER_TEXTURE and NE_LOADER_GRF
+    NEA_LoaderCallback callback; // NE_LOADER_FILE only
+    NEA_FATStream *stream;  // NULL until the first read
+    u8 *data;
+    size_t size;
+    size_t done;            // Bytes already read
+    bool building;          // NE_LOADER_COLMESH being processed after the read
+} ne_loader_job_t;
+
+static ne_loader_job_t ne_loader_queue[NEA_LOADER_QUEUE_SIZE];
+static int ne_loader_head;
+static int ne_loader_count;
+static size_t ne_loader_budget = NEA_LOADER_DEFAULT_BUDGET;
+
+static size_t ne_loader_done;
+static size_t ne_loader_total;
+
+static NEA_LoaderProgressCallback ne_loader_progress_callback;
+static void *ne_loader_progress_arg;
+
+// Weak references: the collision system is only linked if the user uses it
+extern int NEA_ColMeshLoadStart(NEA_ColMesh *mesh, const void *data,
+                                bool free_data) __attribute__((weak));
+extern bool NEA_ColMeshLoadStep(NEA_ColMesh *mesh, int max_triangles)
+                                __attribute__((weak));
+
+static ne_loader_job_t *ne_loader_add(ne_loader_type_t type, const char *path,
+                                      void *target)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    if (ne_loader_count == NEA_LOADER_QUEUE_SIZE)
+    {
+        NEA_DebugPrint("Loader queue full");
+        return NULL;
+    }
+
+    if (strlen(path) >= NEA_LOADER_PATH_LEN)
+    {
+        NEA_DebugPrint("Path too long: %s", path);
+        return NULL;
+    }
+
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
+        return NULL;
+
+    if (ne_loader_count == 0)
+    {
+        ne_loader_done = 0;
+        ne_loader_total = 0;
+    }
+
+    int index = (ne_loader_head + ne_loader_count) % NEA_LOADER_QUEUE_SIZE;
+    ne_loader_job_t *job = &ne_loader_queue[index];
+
+    memset(job, 0, sizeof(ne_loader_job_t));
+    job->type = type;
+    strcpy(job->path, path);
+    job->target = target;
+    job->size = size;
+
+    ne_loader_count++;
+    ne_loader_total += size;
+
+    return job;
+}
+
+int NEA_LoaderAddFile(const char *path, NEA_LoaderCallback callback,
+                      void *arg)
+{
+    NEA_AssertPointer(callback, "NULL callback pointer");
+
+    ne_loader_job_t *job = ne_loader_add(NE_LOADER_FILE, path, arg);
+    if (job == NULL)
+        return 0;
+
+    job->callback = callback;
+
+    return 1;
+}
+
+int NEA_LoaderAddTexture(NEA_Material *tex, NEA_TextureFormat fmt,
+                         int sizeX, int sizeY, NEA_TextureFlags flags,
+                         const char *path)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+
+    ne_loader_job_t *job = ne_loader_add(NE_LOADER_TEXTURE, path, tex);
+    if (job == NULL)
+        return 0;
+
+    job->fmt = fmt;
+    job->sizex = sizeX;
+    job->sizey = sizeY;
+    job->flags = flags;
+
+    return 1;
+}
+
+int NEA_LoaderAddTextureGRF(NEA_Material *tex, NEA_Palette *pal,
+                            NEA_TextureFlags flags, const char *path)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+
+    ne_loader_job_t *job = ne_loader_add(NE_LOADER_GRF, path, tex);
+    if (job == NULL)
+        return 0;
+
+    job->pal = pal;
+    job->flags = flags;
+
+    return 1;
+}
+
+int NEA_LoaderAddStaticMesh(NEA_Model *model, const char *path)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    ne_loader_job_t *job = ne_loader_add(NE_LOADER_MESH, path, model);
+    if (job == NULL)
+        return 0;
+
+    return 1;
+}
+
+int NEA_LoaderAddColMesh(NEA_ColMesh *mesh, const char *path)
+{
+    NEA_AssertPointer(mesh, "NULL mesh pointer");
+
+    ne_loader_job_t *job = ne_loader_add(NE_LOADER_COLMESH, path, mesh);
+    if (job == NULL)
+        return 0;
+
+    return 1;
+}
+
+static void ne_loader_free_callback(void *arg)
+{
+    free(arg);
+}
+
+// Hands the data of a job to its destination. The data is NULL if the file
+// couldn't be read.
+static void ne_loader_finish(ne_loader_job_t *job)
+{
+    u8 *data = job->data;
+
+    // The data belongs to its destination from now on
+    ne_heap_untrack(NEA_HEAP_LOADER, data);
+
+    if (job->type == NE_LOADER_FILE)
+    {
+        job->callback(job->path, data, job->size, job->target);
+        return;
+    }
+
+    if (data == NULL)
+    {
+        NEA_DebugPrint("Failed to load %s", job->path);
+        return;
+    }
+
+    switch (job->type)
+    {
+        case NE_LOADER_TEXTURE:
+            // The data is freed when it has been copied to VRAM
+            if (NEA_MaterialTexLoadAsync(job->target, job->fmt, job->sizex,
+                                         job->sizey, job->flags, data,
+                                         ne_loader_free_callback, data) == 0)
+            {
+                NEA_DebugPrint("Failed to load texture %s", job->path);
+                free(data);
+            }
+            break;
+
+        case NE_LOADER_GRF:
+            if (NEA_MaterialTexLoadGRFAsync(job->target, job->pal, job->flags,
+                                            data) == 0)
+            {
+                NEA_DebugPrint("Failed to load GRF %s", job->path);
+            }
+            free(data);
+            break;
+
+        case NE_LOADER_MESH:
+            if (NEA_ModelLoadStaticMesh(job->target, data) == 0)
+            {
+                NEA_DebugPrint("Failed to load mesh %s", job->path);
+                free(data);
+                break;
+            }
+            NEA_ModelFreeMeshWhenDeleted(job->target);
+            break;
+
+        default:
+            free(data);
+            break;
+    }
+}
+
+// Opens the file of a job and allocates its buffer. It returns 0 on error.
+static int ne_loader_start(ne_loader_job_t *job)
+{
+    job->stream = NEA_FATStreamOpen(job->path);
+    if (job->stream == NULL)
+        return 0;
+
+    // The file may have changed since it was added to the queue
+    if (job->stream->size != job->size)
+    {
+        ne_loader_total += job->stream->size;
+        ne_loader_total -= job->size;
+        job->size = job->stream->size;
+    }
+
+    // Compressed data is written in 16-bit or 32-bit units. Also, allocate at
+    // least some bytes so that empty files aren't seen as errors.
+    job->data = ne_heap_malloc(NEA_HEAP_LOADER, (job->size + 4) & ~3);
+    if (job->data == NULL)
+    {
+        NEA_DebugPrint("Not enough memory to load %s", job->path);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Gives the data of a NE_LOADER_COLMESH job that has been read to its mesh, so
+// that the job can process the triangles in the next steps. It returns 0 on
+// error, and ne_loader_finish() reports it.
+static int ne_loader_start_colmesh(ne_loader_job_t *job)
+{
+    u8 *data = job->data;
+
+    // The data belongs to the mesh from now on, even if it fails
+    ne_heap_untrack(NEA_HEAP_LOADER, data);
+    job->data = NULL;
+
+    NEA_FATStreamClose(job->stream);
+    job->stream = NULL;
+
+    if (NEA_ColMeshLoadStart(job->target, data, true) == 0)
+        return 0;
+
+    job->building = true;
+    return 1;
+}
+
+// Processes the triangles of a NE_LOADER_COLMESH job. Each triangle counts as
+// many bytes as it uses in RAM. It returns the number of bytes used.
+static size_t ne_loader_build_colmesh(ne_loader_job_t *job, size_t budget)
+{
+    size_t max = budget / sizeof(NEA_ColTriangle);
+    if (max == 0)
+        max = 1;
+    else if (max > UINT16_MAX)
+        max = UINT16_MAX;
+
+    if (NEA_ColMeshLoadStep(job->target, max))
+        job->building = false;
+
+    return max * sizeof(NEA_ColTriangle);
+}
+
+// Removes the job at the head of the queue. The data of the job isn't freed.
+static void ne_loader_pop(void)
+{
+    ne_loader_job_t *job = &ne_loader_queue[ne_loader_head];
+
+    if (job->stream != NULL)
+        NEA_FATStreamClose(job->stream);
+
+    ne_loader_head = (ne_loader_head + 1) % NEA_LOADER_QUEUE_SIZE;
+    ne_loader_count--;
+}
+
+static size_t ne_loader_process(size_t budget)
+{
+    size_t copied = 0;
+    bool progress = false;
+
+    while ((ne_loader_count > 0) && (copied < budget))
+    {
+        ne_loader_job_t *job = &ne_loader_queue[ne_loader_head];
+        bool error = false;
+
+        // The job stays at the head of the queue until its mesh is complete
+        if (job->building)
+        {
+            copied += ne_loader_build_colmesh(job, budget - copied);
+            if (job->building)
+                break;
+
+            ne_loader_pop();
+            continue;
+        }
+
+        if (job->stream == NULL)
+        {
+            if (ne_loader_start(job) == 0)
+                error = true;
+        }
+
+        if (!error)
+        {
+            // Compressed files are decompressed in one step
+            size_t len = job->size - job->done;
+            if ((len > budget - copied) && (job->stream->compression == 0))
+                len = budget - copied;
+
+            if (NEA_FATStreamRead(job->stream, job->data + job->done, len)
+                != len)
+            {
+                NEA_DebugPrint("Failed to read %s", job->path);
+                error = true;
+            }
+            else
+            {
+                job->done += len;
+                copied += len;
+                ne_loader_done += len;
+                progress = true;
+
+                if (job->done < job->size)
+                    break;
+            }
+        }
+
+        if (error)
+        {
+            // Count the file as done so that the progress reaches the total
+            ne_loader_done += job->size - job->done;
+            progress = true;
+
+            ne_heap_free(NEA_HEAP_LOADER, job->data);
+            job->data = NULL;
+        }
+        else if (job->type == NE_LOADER_COLMESH)
+        {
+            if (ne_loader_start_colmesh(job))
+                continue;
+        }
+
+        // Remove the job from the queue before handing its data, in case the
+        // callbacks add more files to the queue.
+        ne_loader_job_t finished = *job;
+        finished.stream = NULL;
+        ne_loader_pop();
+
+        ne_loader_finish(&finished);
+    }
+
+    if (progress && ne_loader_progress_callback)
+    {
+        ne_loader_progress_callback(ne_loader_done, ne_loader_total,
+                                    ne_loader_progress_arg);
+    }
+
+    return copied;
+}
+
+void NEA_LoaderCancel(const void *target)
+{
+    if (target == NULL)
+        return;
+
+    int count = 0;
+
+    for (int i = 0; i < ne_loader_count; i++)
+    {
+        int from = (ne_loader_head + i) % NEA_LOADER_QUEUE_SIZE;
+        ne_loader_job_t *job = &ne_loader_queue[from];
+
+        if ((job->target == target) || (job->pal == target))
+        {
+            if (job->stream != NULL)
+                NEA_FATStreamClose(job->stream);
+            ne_heap_free(NEA_HEAP_LOADER, job->data);
+
+            ne_loader_total -= job->size - job->done;
+            continue;
+        }
+
+        int to = (ne_loader_head + count) % NEA_LOADER_QUEUE_SIZE;
+        if (to != from)
+            ne_loader_queue[to] = *job;
+        count++;
+    }
+
+    ne_loader_count = count;
+}
+
+void NEA_LoaderSetBudget(size_t bytes)
+{
+    if (bytes == 0)
+        bytes = NEA_LOADER_DEFAULT_BUDGET;
+
+    ne_loader_budget = bytes;
+}
+
+size_t NEA_LoaderUpdate(void)
+{
+    return ne_loader_process(ne_loader_budget);
+}
+
+void NEA_LoaderFlush(void)
+{
+    ne_loader_process(SIZE_MAX);
+}
+
+bool NEA_LoaderIsIdle(void)
+{
+    return ne_loader_count == 0;
+}
+
+void NEA_LoaderGetProgress(size_t *done, size_t *total)
+{
+    if (done)
+        *done = ne_loader_done;
+    if (total)
+        *total = ne_loader_total;
+}
+
+void NEA_LoaderSetProgressCallback(NEA_LoaderProgressCallback callback,
+                                   void *arg)
+{
+    ne_loader_progress_callback = callback;
+    ne_loader_progress_arg = arg;
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAMath.h"
+#include "NEATCM.h"
+
+/// @file NEAMath.c
+
+// Reciprocal square roots of the middle of 48 intervals of [0.25, 1), with 14
+// fractional bits. Entry i is 1 / sqrt((i + 16.5) / 64).
+static const u16 ne_rsqrt_table[48] = {
+    0x7E0C, 0x7A64, 0x770A, 0x73F2, 0x7115, 0x6E6C, 0x6BF0, 0x699E,
+    0x6771, 0x6564, 0x6376, 0x61A2, 0x5FE8, 0x5E44, 0x5CB5, 0x5B3A,
+    0x59D0, 0x5876, 0x572B, 0x55EF, 0x54BF, 0x539C, 0x5284, 0x5177,
+    0x5074, 0x4F7A, 0x4E8A, 0x4DA1, 0x4CC1, 0x4BE7, 0x4B15, 0x4A4A,
+    0x4985, 0x48C6, 0x480C, 0x4758, 0x46AA, 0x4600, 0x455B, 0x44BA,
+    0x441E, 0x4385, 0x42F1, 0x4260, 0x41D3, 0x414A, 0x40C3, 0x4040,
+};
+
+// The value is split as m * 2^e, with m in [0.25, 1) and e even, so that
+// 1 / sqrt(value) = 1 / sqrt(m) * 2^(-e / 2). The estimate of the table has a
+// relative error below 1.2%, and one Newton-Raphson iteration brings it below
+// 0.04%. It never overestimates the result.
+NEA_HOT_CODE
+uint32_t ne_rsqrt64(uint64_t value, int *shift)
+{
+    int e = 64 - __builtin_clzll(value);
+    e += e & 1;
+
+    uint32_t m = (e >= 31) ? (uint32_t)(value >> (e - 31))
+                           : (uint32_t)(value << (31 - e)); // 31 frac bits
+
+    uint32_t y = ne_rsqrt_table[(m >> 25) - 16]; // 14 frac bits
+
+    // y = y * (3 - m * y^2) / 2, the result has 30 fractional bits
+    uint32_t my2 = ((uint64_t)m * (y * y)) >> 31; // 28 frac bits
+    uint32_t t = (3 << 28) - my2;
+
+    *shift = 30 + e / 2;
+    return ((uint64_t)y * t) >> 13;
+}
+
+NEA_HOT_CODE
+void ne_normalize_fast(int32_t *v)
+{
+    uint64_t len_sq = (uint64_t)((int64_t)v[0] * v[0])
+                    + (uint64_t)((int64_t)v[1] * v[1])
+                    + (uint64_t)((int64_t)v[2] * v[2]);
+    if (len_sq == 0)
+        return;
+
+    // The length has 24 fractional bits, so the reciprocal of its square root
+    // already gives a result in f32 after shifting it 12 bits less.
+    int shift;
+    uint32_t recip = ne_rsqrt64(len_sq, &shift);
+    shift -= 12;
+
+    for (int i = 0; i < 3; i++)
+        v[i] = ((int64_t)v[i] * recip) >> shift;
+}
@@ -19,3 +19,82 @@ int32_t ne_div_result(void)
 {
     return div32_result();
 }
+
+// Start/result pairs of the hardware divider and square root units. Both units
+// work at the same time as the CPU, and at the same time as each other, so an
+// operation can be started as soon as its operands are known, and its result
+// read when it's needed. Only one division and one square root can be in
+// progress at any time: nothing that runs between the start and the result can
+// use the same unit, including divf32(), sqrtf32() and the functions of libnds
+// that use them.
+
+static inline
+void ne_divf32_start(int32_t num, int32_t den)
+{
+    divf32_asynch(num, den);
+}
+
+static inline
+int32_t ne_divf32_result(void)
+{
+    return divf32_result();
+}
+
+static inline
+void ne_sqrt64_start(uint64_t a)
+{
+    sqrt64_asynch(a);
+}
+
+static inline
+uint32_t ne_sqrt64_result(void)
+{
+    return sqrt64_result();
+}
+
+// Reciprocals of lengths, with NE_RECIP_SHIFT fractional bits. They only fit
+// in 32 bits if the length (f32) is bigger than NE_RECIP_MIN_LEN. One division
+// and three multiplications are faster than three divisions.
+#define NE_RECIP_SHIFT   24
+#define NE_RECIP_MIN_LEN (1 << (12 + NE_RECIP_SHIFT - 31))
+
+static inline
+void ne_recip_start(int32_t len)
+{
+    div64_asynch(1LL << (12 + NE_RECIP_SHIFT), len);
+}
+
+static inline
+int32_t ne_recip_result(void)
+{
+    return div64_result();
+}
+
+static inline
+int32_t ne_recip_mul(int32_t v, int32_t recip)
+{
+    return ((int64_t)v * recip) >> NE_RECIP_SHIFT;
+}
+
+// Approximate reciprocal square root of a value. It returns r and sets shift
+// so that 1 / sqrt(value) = r / 2^shift. The value can't be 0. The relative
+// error is below 0.04%. See NEAMath.c
+uint32_t ne_rsqrt64(uint64_t value, int *shift);
+
+// Normalizes a vector of 3 f32 components with ne_rsqrt64(). A zero vector is
+// left unchanged. Components of the result are off by 3 units at most.
+void ne_normalize_fast(int32_t *v);
+
+// Normalization of vectors that don't need to be exact: camera basis vectors,
+// view directions, axes of decals, etc. If the library is built with
+// "make NEA_FAST_NORMALIZE=1" it uses ne_normalize_fast() instead of the
+// hardware square root and divider.
+static inline
+void ne_normalize(int32_t *v)
+{
+#ifdef NEA_FAST_NORMALIZE
+    ne_normalize_fast(v);
+#else
+    normalizef32(v);
+#endif
+}
@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAMemReport.c
+
+static NEA_MemFailCallback ne_mem_fail_callback = NULL;
+
+// Internal use... see NEAHw2D.c. Adds a free block to a report that isn't
+// generated by NEAAlloc.
+void ne_mem_report_add_free_block(NEA_MemReport *report, size_t size)
+{
+    if (size == 0)
+        return;
+
+    report->free += size;
+    report->free_blocks++;
+    if (size > report->largest_free)
+        report->largest_free = size;
+
+    unsigned int entry = 0;
+    while ((entry < NEA_MEM_HISTOGRAM_SIZE - 1) && ((size >> (entry + 5)) > 0))
+        entry++;
+    report->histogram[entry]++;
+
+    report->fragmentation = ((report->free - report->largest_free) * 100)
+                            / report->free;
+}
+
+int NEA_MemGetReport(NEA_MemPool pool, NEA_MemReport *report)
+{
+    NEA_AssertPointer(report, "NULL pointer");
+
+    switch (pool)
+    {
+        case NEA_MEM_POOL_TEXTURE:
+            return NEA_TextureGetMemReport(report);
+        case NEA_MEM_POOL_PALETTE:
+            return NEA_PaletteGetMemReport(report);
+        case NEA_MEM_POOL_HW2D_MAIN:
+            return NEA_Hw2DGetMemReport(NEA_ENGINE_MAIN, report);
+        case NEA_MEM_POOL_HW2D_SUB:
+            return NEA_Hw2DGetMemReport(NEA_ENGINE_SUB, report);
+        default:
+            NEA_DebugPrint("Invalid pool %d", pool);
+            return 0;
+    }
+}
+
+bool NEA_MemReportIsFragmented(const NEA_MemReport *report, size_t size)
+{
+    NEA_AssertPointer(report, "NULL pointer");
+
+    return (report->free >= size) && (report->largest_free < size);
+}
+
+void NEA_MemSetFailCallback(NEA_MemFailCallback callback)
+{
+    ne_mem_fail_callback = callback;
+}
+
+// Internal use... see NEATexture.c, NEAPalette.c and NEAHw2D.c. It must be
+// called when an allocation of a pool fails because of lack of memory.
+void ne_mem_report_failure(NEA_MemPool pool, size_t size)
+{
+#ifndef NEA_DEBUG
+    // Don't generate the report if nobody is going to read it
+    if (ne_mem_fail_callback == NULL)
+        return;
+#endif
+
+    NEA_MemReport report;
+    if (!NEA_MemGetReport(pool, &report))
+        return;
+
+    NEA_DebugPrint("Pool %d full: %u bytes requested, %u free, %u largest",
+                   pool, (unsigned int)size, (unsigned int)report.free,
+                   (unsigned int)report.largest_free);
+
+    if (ne_mem_fail_callback)
+        ne_mem_fail_callback(pool, size, &report);
+}
@@ -9,20 +9,86 @@
 #include "dsma/dsma.h"
 
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+#include "NEAPool.h"
+#include "NEAStats.h"
+#include "NEATCM.h"
 
 /// @file NEAModel.c
 
+// Internal use... see NEADisplayList.c
+void ne_display_list_draw_default(const void *list, bool flushed);
+
 typedef struct {
     void *address;
+    const void *data; // Mesh data, after the optional bounding sphere chunk
     int uses; // Number of models that use this mesh
     bool has_to_free;
+    bool clean; // The mesh has been flushed from the data cache
 } ne_mesh_info_t;
 
 static ne_mesh_info_t *NEA_Mesh = NULL;
-static NEA_Model **NEA_ModelPointers;
+static ne_pool_t ne_model_pool;
 static int NEA_MAX_MODELS;
 static bool ne_model_system_inited = false;
 
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_model_static, NEA_Model, NEA_STATIC_MAX_MODELS);
+static ne_mesh_info_t ne_mesh_static[NEA_STATIC_MAX_MODELS];
+static NEA_AnimInfo ne_model_animinfo_static[NEA_STATIC_MAX_MODELS][2];
+static m4x3 ne_model_mat_static[NEA_STATIC_MAX_MODELS];
+#endif
+
+// Allocates the animation state of a model that isn't in a group. In static
+// builds it's stored in the slot of the model.
+static NEA_AnimInfo *ne_model_animinfo_alloc(int slot, int i)
+{
+#ifdef NEA_STATIC_POOLS
+    NEA_AnimInfo *animinfo = &ne_model_animinfo_static[slot][i];
+    memset(animinfo, 0, sizeof(NEA_AnimInfo));
+    return animinfo;
+#else
+    (void)slot;
+    (void)i;
+    return ne_heap_calloc(NEA_HEAP_MODEL, 1, sizeof(NEA_AnimInfo));
+#endif
+}
+
+static void ne_model_animinfo_free(NEA_AnimInfo *animinfo)
+{
+#ifdef NEA_STATIC_POOLS
+    (void)animinfo;
+#else
+    ne_heap_free(NEA_HEAP_MODEL, animinfo);
+#endif
+}
+
+// Internal use... see NEACamera.c
+bool ne_model_frustum_culling = false;
+
+static bool ne_model_box_test_culling = false;
+
+// If the mesh file starts with a bounding sphere chunk, read it into the model
+// and return a pointer to the mesh data after it. If not, the model is left
+// without bounding sphere.
+static const void *ne_mesh_read_bounds(NEA_Model *model, const void *pointer)
+{
+    const int32_t *chunk = pointer;
+
+    if ((uint32_t)chunk[0] != NEA_MESH_BOUNDS_MAGIC)
+    {
+        model->bound_radius = 0;
+        return pointer;
+    }
+
+    model->bound_center[0] = chunk[1];
+    model->bound_center[1] = chunk[2];
+    model->bound_center[2] = chunk[3];
+    model->bound_radius = chunk[4];
+
+    return chunk + 5;
+}
+
 static void ne_mesh_delete(int mesh_index)
 {
     int slot = mesh_index;
@@ -34,7 +100,7 @@ static void ne_mesh_delete(int mesh_index)
     if (NEA_Mesh[slot].uses == 0)
     {
         if (NEA_Mesh[slot].has_to_free)
-            free(NEA_Mesh[slot].address);
+            ne_heap_free(NEA_HEAP_MODEL, NEA_Mesh[slot].address);
 
         NEA_Mesh[slot].address = NULL;
     }
@@ -53,6 +119,119 @@ static int ne_model_get_free_mesh_slot(void)
     return NEA_NO_MESH;
 }
 
+// Display lists of static meshes are flushed from the data cache once, when
+// they are loaded or after NEA_ModelInvalidateMesh(), instead of every time
+// they are drawn.
+static void ne_mesh_flush(ne_mesh_info_t *mesh)
+{
+    NEA_DisplayListFlush(mesh->data);
+    mesh->clean = true;
+}
+
+static void ne_mesh_draw(ne_mesh_info_t *mesh)
+{
+    if (!mesh->clean)
+        ne_mesh_flush(mesh);
+
+    ne_display_list_draw_default(mesh->data, true);
+}
+
+static void ne_multimesh_flush(NEA_MultiMeshData *multi)
+{
+    if (multi->flushed)
+        return;
+
+    for (int i = 0; i < multi->num_submeshes; i++)
+    {
+        if (multi->submeshes[i].dl_data != NULL)
+            NEA_DisplayListFlush(multi->submeshes[i].dl_data);
+    }
+
+    multi->flushed = true;
+}
+
+// Creates multi-mesh data for one model, with the submesh table after it
+NEA_MultiMeshData *ne_multimesh_create(int num_submeshes)
+{
+    size_t size = sizeof(NEA_MultiMeshData)
+                + num_submeshes * sizeof(NEA_SubMesh);
+
+    NEA_MultiMeshData *multi = ne_heap_calloc(NEA_HEAP_MODEL, 1, size);
+    if (multi == NULL)
+        return NULL;
+
+    multi->submeshes = (NEA_SubMesh *)(multi + 1);
+    multi->num_submeshes = num_submeshes;
+    multi->refcount = 1;
+    return multi;
+}
+
+// Removes a user of some multi-mesh data. The last one frees it.
+static void ne_multimesh_release(NEA_MultiMeshData *multi)
+{
+    multi->refcount--;
+    if (multi->refcount > 0)
+        return;
+
+    void *data = multi->base_has_to_free ? multi->base_data : NULL;
+
+    if (!multi->in_place)
+        ne_heap_free(NEA_HEAP_MODEL, multi);
+
+    ne_heap_free(NEA_HEAP_MODEL, data);
+}
+
+static void ne_model_multimesh_remove(NEA_Model *model)
+{
+    if (model->multi == NULL)
+        return;
+
+    ne_multimesh_release(model->multi);
+    model->multi = NULL;
+
+    ne_heap_free(NEA_HEAP_MODEL, model->submesh_materials);
+    model->submesh_materials = NULL;
+}
+
+static NEA_Material *ne_model_submesh_material(const NEA_Model *model, int i)
+{
+    if (model->submesh_materials != NULL)
+        return model->submesh_materials[i];
+
+    return model->multi->submeshes[i].material;
+}
+
+// The submeshes are shared with the clones of the model. The material is only
+// stored in the submesh if no other model uses it.
+static int ne_model_submesh_set_material(NEA_Model *model, int i,
+                                         NEA_Material *material)
+{
+    NEA_MultiMeshData *multi = model->multi;
+
+    if (model->submesh_materials == NULL)
+    {
+        if (multi->refcount == 1)
+        {
+            multi->submeshes[i].material = material;
+            return 1;
+        }
+
+        size_t size = multi->num_submeshes * sizeof(NEA_Material *);
+        model->submesh_materials = ne_heap_malloc(NEA_HEAP_MODEL, size);
+        if (model->submesh_materials == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        for (int j = 0; j < multi->num_submeshes; j++)
+            model->submesh_materials[j] = multi->submeshes[j].material;
+    }
+
+    model->submesh_materials[i] = material;
+    return 1;
+}
+
 static int ne_model_load_ram_common(NEA_Model *model, const void *pointer)
 {
     NEA_AssertPointer(model, "NULL model pointer");
@@ -71,9 +250,14 @@ static int ne_model_load_ram_common(NEA_Model *model, const void *pointer)
     ne_mesh_info_t *mesh = &NEA_Mesh[slot];
 
     mesh->address = (void *)pointer;
+    mesh->data = ne_mesh_read_bounds(model, pointer);
     mesh->has_to_free = false;
+    mesh->clean = false;
     mesh->uses = 1;
 
+    if (model->modeltype == NEA_Static)
+        ne_mesh_flush(mesh);
+
     return 1;
 }
 
@@ -94,14 +278,21 @@ static int ne_model_load_filesystem_common(NEA_Model *model, const char *path)
     if (pointer == NULL)
         return 0;
 
+    ne_heap_track(NEA_HEAP_MODEL, pointer);
+
     model->meshindex = slot;
 
     ne_mesh_info_t *mesh = &NEA_Mesh[slot];
 
     mesh->address = pointer;
+    mesh->data = ne_mesh_read_bounds(model, pointer);
     mesh->has_to_free = true;
+    mesh->clean = false;
     mesh->uses = 1;
 
+    if (model->modeltype == NEA_Static)
+        ne_mesh_flush(mesh);
+
     return 1;
 }
 
@@ -115,31 +306,23 @@ NEA_Model *NEA_ModelCreate(NEA_ModelType type)
         return NULL;
     }
 
-    NEA_Model *model = calloc(1, sizeof(NEA_Model));
+    NEA_Model *model = ne_pool_object_alloc(&ne_model_pool, sizeof(NEA_Model));
     if (model == NULL)
     {
         NEA_DebugPrint("Not enough memory");
         return NULL;
     }
 
-    int i = 0;
-    while (1)
+    int slot = ne_pool_add(&ne_model_pool, model);
+    if (slot < 0)
     {
-        if (NEA_ModelPointers[i] == NULL)
-        {
-            NEA_ModelPointers[i] = model;
-            break;
-        }
-        i++;
-        if (i == NEA_MAX_MODELS)
-        {
-            NEA_DebugPrint("No free slots");
-            free(model);
-            return NULL;
-        }
+        NEA_DebugPrint("No free slots");
+        ne_pool_object_free(&ne_model_pool, model);
+        return NULL;
     }
 
     model->sx = model->sy = model->sz = inttof32(1);
+    model->transform_dirty = true;
 
     model->mat = NULL;
 
@@ -150,7 +333,7 @@ NEA_Model *NEA_ModelCreate(NEA_ModelType type)
     {
         for (int i = 0; i < 2; i++)
         {
-            model->animinfo[i] = calloc(sizeof(NEA_AnimInfo), 1);
+            model->animinfo[i] = ne_model_animinfo_alloc(slot, i);
             NEA_AssertPointer(model->animinfo[i],
                              "Couldn't allocate animation info");
         }
@@ -159,6 +342,22 @@ NEA_Model *NEA_ModelCreate(NEA_ModelType type)
     return model;
 }
 
+// Removes a model from its animation group and deletes the group if it was the
+// last member. The model is left without animation state.
+static void ne_model_anim_group_remove(NEA_Model *model)
+{
+    NEA_ModelAnimGroup *group = model->anim_group;
+
+    model->anim_group = NULL;
+    model->anim_phase = 0;
+    model->animinfo[0] = NULL;
+    model->animinfo[1] = NULL;
+
+    group->members--;
+    if (group->members == 0)
+        ne_heap_free(NEA_HEAP_MODEL, group);
+}
+
 void NEA_ModelDelete(NEA_Model *model)
 {
     if (!ne_model_system_inited)
@@ -166,49 +365,43 @@ void NEA_ModelDelete(NEA_Model *model)
 
     NEA_AssertPointer(model, "NULL pointer");
 
-    int i = 0;
-    while (1)
+    int slot = ne_pool_find(&ne_model_pool, model);
+    if (slot < 0)
     {
-        if (i == NEA_MAX_MODELS)
-        {
-            NEA_DebugPrint("Model not found");
-            return;
-        }
-        if (NEA_ModelPointers[i] == model)
-        {
-            NEA_ModelPointers[i] = NULL;
-            break;
-        }
-        i++;
+        NEA_DebugPrint("Model not found");
+        return;
     }
 
+    ne_pool_remove(&ne_model_pool, slot);
+
+    NEA_LoaderCancel(model);
+
     if (model->modeltype == NEA_Animated)
     {
-        for (int i = 0; i < 2; i++)
-            free(model->animinfo[i]);
+        if (model->anim_group != NULL)
+        {
+            ne_model_anim_group_remove(model);
+        }
+        else
+        {
+            for (int i = 0; i < 2; i++)
+                ne_model_animinfo_free(model->animinfo[i]);
+        }
     }
 
+#ifndef NEA_STATIC_POOLS
     if (model->mat != NULL)
-        free(model->mat);
+        ne_heap_free(NEA_HEAP_MODEL, model->mat);
+#endif
 
     // If there is an asigned mesh
     if (model->meshindex != NEA_NO_MESH)
         ne_mesh_delete(model->meshindex);
 
     // Clean up multi-mesh data if present
-    if (model->multi != NULL)
-    {
-        (*model->multi->base_refcount)--;
-        if (*model->multi->base_refcount == 0)
-        {
-            if (model->multi->base_has_to_free)
-                free(model->multi->base_data);
-            free(model->multi->base_refcount);
-        }
-        free(model->multi);
-    }
+    ne_model_multimesh_remove(model);
 
-    free(model);
+    ne_pool_object_free(&ne_model_pool, model);
 }
 
 int NEA_ModelLoadStaticMeshFAT(NEA_Model *model, const char *path)
@@ -237,10 +430,23 @@ void NEA_ModelFreeMeshWhenDeleted(NEA_Model *model)
     if (model->meshindex != NEA_NO_MESH)
     {
         ne_mesh_info_t *mesh = &NEA_Mesh[model->meshindex];
+        if (!mesh->has_to_free)
+            ne_heap_track(NEA_HEAP_MODEL, mesh->address);
         mesh->has_to_free = true;
     }
 }
 
+void NEA_ModelInvalidateMesh(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    if (model->multi != NULL)
+        model->multi->flushed = false;
+
+    if (model->meshindex != NEA_NO_MESH)
+        NEA_Mesh[model->meshindex].clean = false;
+}
+
 void NEA_ModelSetMaterial(NEA_Model *model, NEA_Material *material)
 {
     NEA_AssertPointer(model, "NULL model pointer");
@@ -268,54 +474,443 @@ void NEA_ModelSetAnimationSecondary(NEA_Model *model, NEA_Animation *anim)
     model->animinfo[1]->numframes = frames;
 }
 
+void NEA_ModelSetAnimationMask(NEA_Model *model, const uint16_t *mask)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+    NEA_Assert(model->modeltype == NEA_Animated, "Not an animated model");
+    model->anim_mask = mask;
+}
+
 //---------------------------------------------------------
 
 // Internal use... see below
 extern bool NEA_TestTouch;
 
-void NEA_ModelDraw(const NEA_Model *model)
+// Internal use... see NEADisplayList.c
+void ne_display_list_matrix_pop(void);
+
+// Internal use... see NEAGeneral.c
+bool ne_two_pass_culling_active(void);
+
+// Internal use... see NEATexture.c
+void ne_material_state_tex_format(u32 value);
+void ne_material_state_diffuse_ambient(u32 value);
+void ne_material_state_specular_emission(u32 value);
+void ne_material_state_poly_format(u32 value);
+
+// Internal use... see NEAPolygon.c
+extern u32 ne_poly_format_last;
+
+// Weak reference: the light manager is only linked if the user uses it. See
+// NEALightManager.c
+extern void ne_light_manager_apply_model(const NEA_Model *model,
+                                         const m4x3 *mat) __attribute__((weak));
+
+// Selects the lights of a model before its matrix is multiplied, because the
+// light vectors are transformed by the current matrix when they are written.
+static inline void ne_model_apply_lights(const NEA_Model *model,
+                                         const m4x3 *mat)
+{
+    if (ne_light_manager_apply_model && !NEA_TestTouch)
+        ne_light_manager_apply_model(model, mat);
+}
+
+void NEA_ModelSetBoundingSphereI(NEA_Model *model, int x, int y, int z,
+                                 int radius)
 {
     NEA_AssertPointer(model, "NULL pointer");
-    if (model->multi == NULL && model->meshindex == NEA_NO_MESH)
-        return;
+    NEA_Assert(radius >= 0, "Negative radius");
+    model->bound_center[0] = x;
+    model->bound_center[1] = y;
+    model->bound_center[2] = z;
+    model->bound_radius = radius;
+}
 
-    if (model->modeltype == NEA_Animated)
+void NEA_ModelFrustumCulling(bool enable)
+{
+    ne_model_frustum_culling = enable;
+}
+
+void NEA_ModelBoxTestCulling(bool enable)
+{
+    ne_model_box_test_culling = enable;
+}
+
+// Internal use: transforms a sphere by a matrix. The result is (x, y, z,
+// radius). See NEAScene.c
+ARM_CODE void ne_sphere_transform(const int32_t *center, int32_t radius,
+                                  const m4x3 *mat, int32_t *out)
+{
+    int32_t cx = center[0];
+    int32_t cy = center[1];
+    int32_t cz = center[2];
+
+    // Row vectors: v' = v * M, with the translation in the last row.
+    const int32_t *m = &mat->m[0];
+
+    out[0] = mulf32(cx, m[0]) + mulf32(cy, m[3]) + mulf32(cz, m[6]) + m[9];
+    out[1] = mulf32(cx, m[1]) + mulf32(cy, m[4]) + mulf32(cz, m[7]) + m[10];
+    out[2] = mulf32(cx, m[2]) + mulf32(cy, m[5]) + mulf32(cz, m[8]) + m[11];
+
+    // The Frobenius norm is an upper bound of the scale of the matrix
+    int64_t norm2 = 0;
+    for (int i = 0; i < 9; i++)
+        norm2 += (int64_t)m[i] * m[i];
+
+    out[3] = mulf32(radius, sqrt64(norm2));
+}
+
+static void ne_model_current_sphere(const NEA_Model *model, int32_t *center,
+                                    int32_t *radius);
+
+// Internal use: transforms the bounding sphere of a model by a matrix. See
+// NEAScene.c
+ARM_CODE void ne_model_sphere_transform(const NEA_Model *model,
+                                        const m4x3 *mat, int32_t *out)
+{
+    int32_t center[3], radius;
+    ne_model_current_sphere(model, center, &radius);
+
+    ne_sphere_transform(center, radius, mat, out);
+}
+
+// Transforms the bounding sphere of a model by a matrix and tests it against the
+// frustum. The radius of the sphere must not be 0.
+ARM_CODE static bool ne_model_sphere_test_matrix(const NEA_Model *model,
+                                                 const m4x3 *mat)
+{
+    int32_t sphere[4];
+    ne_model_sphere_transform(model, mat, sphere);
+
+    return NEA_CameraFrustumTestSphereI(sphere[0], sphere[1], sphere[2],
+                                        sphere[3]);
+}
+
+ARM_CODE bool NEA_ModelIsInFrustum(const NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    if (model->bound_radius == 0)
+        return true;
+
+    if (model->mat != NULL)
+        return ne_model_sphere_test_matrix(model, model->mat);
+
+    int32_t center[3], bound_radius;
+    ne_model_current_sphere(model, center, &bound_radius);
+
+    // Same order as NEA_ModelDraw(): scale, rotate Z, Y, X, translate
+    int32_t cx = mulf32(center[0], model->sx);
+    int32_t cy = mulf32(center[1], model->sy);
+    int32_t cz = mulf32(center[2], model->sz);
+
+    if (model->rz != 0)
     {
-        // The base animation must always be present. The secondary animation
-        // isn't required to draw the model.
-        if (model->animinfo[0]->animation == NULL)
-            return;
+        int32_t s = sinLerp(model->rz << 6);
+        int32_t c = cosLerp(model->rz << 6);
+        int32_t x = mulf32(cx, c) - mulf32(cy, s);
+        cy = mulf32(cx, s) + mulf32(cy, c);
+        cx = x;
+    }
+    if (model->ry != 0)
+    {
+        int32_t s = sinLerp(model->ry << 6);
+        int32_t c = cosLerp(model->ry << 6);
+        int32_t x = mulf32(cx, c) + mulf32(cz, s);
+        cz = mulf32(cz, c) - mulf32(cx, s);
+        cx = x;
+    }
+    if (model->rx != 0)
+    {
+        int32_t s = sinLerp(model->rx << 6);
+        int32_t c = cosLerp(model->rx << 6);
+        int32_t y = mulf32(cy, c) - mulf32(cz, s);
+        cz = mulf32(cy, s) + mulf32(cz, c);
+        cy = y;
     }
 
-    MATRIX_PUSH = 0;
+    cx += model->x;
+    cy += model->y;
+    cz += model->z;
 
-    if (model->mat != NULL)
+    int32_t scale = abs(model->sx);
+    if (abs(model->sy) > scale)
+        scale = abs(model->sy);
+    if (abs(model->sz) > scale)
+        scale = abs(model->sz);
+
+    int32_t radius = mulf32(bound_radius, scale);
+
+    return NEA_CameraFrustumTestSphereI(cx, cy, cz, radius);
+}
+
+// Multiplies two 3x3 f32 matrices: out = a * b
+static void ne_model_mat3_mul(int32_t out[3][3], int32_t a[3][3],
+                              int32_t b[3][3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            out[i][j] = mulf32(a[i][0], b[0][j]) + mulf32(a[i][1], b[1][j])
+                      + mulf32(a[i][2], b[2][j]);
+        }
+    }
+}
+
+// Internal use: builds a transformation matrix from a position, rotation and
+// scale. The result is the same as issuing MATRIX_TRANSLATE, glRotateXi(),
+// glRotateYi(), glRotateZi() and MATRIX_SCALE in that order.
+NEA_HOT_CODE void ne_model_build_transform(m4x3 *out, int x, int y, int z,
+                                           int rx, int ry, int rz,
+                                           int sx, int sy, int sz)
+{
+    // Row vectors: v' = v * S * Rz * Ry * Rx + T
+    int32_t r[3][3] = {
+        { inttof32(1), 0, 0 },
+        { 0, inttof32(1), 0 },
+        { 0, 0, inttof32(1) },
+    };
+
+    if (rz != 0)
+    {
+        int32_t s = sinLerp(rz << 6);
+        int32_t c = cosLerp(rz << 6);
+        r[0][0] = c;  r[0][1] = s;
+        r[1][0] = -s; r[1][1] = c;
+    }
+    if (ry != 0)
+    {
+        int32_t s = sinLerp(ry << 6);
+        int32_t c = cosLerp(ry << 6);
+        int32_t mry[3][3] = {
+            { c, 0, -s },
+            { 0, inttof32(1), 0 },
+            { s, 0, c },
+        };
+        int32_t tmp[3][3];
+        ne_model_mat3_mul(tmp, r, mry);
+        memcpy(r, tmp, sizeof(r));
+    }
+    if (rx != 0)
+    {
+        int32_t s = sinLerp(rx << 6);
+        int32_t c = cosLerp(rx << 6);
+        int32_t mrx[3][3] = {
+            { inttof32(1), 0, 0 },
+            { 0, c, s },
+            { 0, -s, c },
+        };
+        int32_t tmp[3][3];
+        ne_model_mat3_mul(tmp, r, mrx);
+        memcpy(r, tmp, sizeof(r));
+    }
+
+    int32_t scale[3] = { sx, sy, sz };
+    int32_t *m = &out->m[0];
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            m[i * 3 + j] = mulf32(scale[i], r[i][j]);
+    }
+
+    m[9] = x;
+    m[10] = y;
+    m[11] = z;
+}
+
+// Internal use: builds the cached transformation matrix of a model again if
+// its position, rotation or scale have changed.
+ARM_CODE void ne_model_update_transform(NEA_Model *model)
+{
+    if (!model->transform_dirty)
+        return;
+
+    ne_model_build_transform(&model->transform,
+                             model->x, model->y, model->z,
+                             model->rx, model->ry, model->rz,
+                             model->sx, model->sy, model->sz);
+
+    model->transform_dirty = false;
+}
+
+// Internal use: returns the frame of one animation layer of a model, moved by
+// the offset of its phase if it's a member of an animation group.
+int32_t ne_model_anim_phase_frame(const NEA_Model *model, int layer)
+{
+    const NEA_AnimInfo *animinfo = model->animinfo[layer];
+    int32_t frame = animinfo->currframe;
+
+    if (model->anim_group == NULL)
+        return frame;
+
+    int32_t offset = model->anim_group->phase_offset[model->anim_phase];
+    if (offset == 0)
+        return frame;
+
+    frame += offset;
+
+    if (animinfo->type == NEA_ANIM_LOOP)
     {
-        glMultMatrix4x3(model->mat);
+        int32_t endval = inttof32(animinfo->numframes);
+        if (endval <= 0)
+            return animinfo->currframe;
+
+        frame %= endval;
+        if (frame < 0)
+            frame += endval;
     }
     else
     {
-        MATRIX_TRANSLATE = model->x;
-        MATRIX_TRANSLATE = model->y;
-        MATRIX_TRANSLATE = model->z;
+        int32_t endval = inttof32(animinfo->numframes - 1);
+        if (frame > endval)
+            frame = endval;
+        else if (frame < 0)
+            frame = 0;
+    }
+
+    return frame;
+}
+
+// Returns the blend factor of the animations of a model.
+static inline int32_t ne_model_anim_blend(const NEA_Model *model)
+{
+    if (model->anim_group != NULL)
+        return model->anim_group->anim_blend;
+
+    return model->anim_blend;
+}
+
+// Sets the blend factor of the animations of a model, or of its group.
+static inline void ne_model_anim_blend_set(NEA_Model *model, int32_t factor)
+{
+    if (model->anim_group != NULL)
+        model->anim_group->anim_blend = factor;
+    else
+        model->anim_blend = factor;
+}
+
+// Returns the frame of one animation layer of a model that has to be drawn. In
+// NEA_ANIM_LOD_SNAP the frame is rounded down to a whole keyframe.
+static int32_t ne_model_anim_frame(const NEA_Model *model, int layer)
+{
+    int32_t frame = ne_model_anim_phase_frame(model, layer);
+
+    if (model->anim_lod_level == NEA_ANIM_LOD_SNAP)
+        frame &= ~(inttof32(1) - 1);
 
-        if (model->rx != 0)
-            glRotateXi(model->rx << 6);
-        if (model->ry != 0)
-            glRotateYi(model->ry << 6);
-        if (model->rz != 0)
-            glRotateZi(model->rz << 6);
+    return frame;
+}
+
+// Gets the box that contains an animated model in the poses that are drawn if
+// its animations have bounds. Blended animations use both boxes.
+static bool ne_model_anim_bounds(const NEA_Model *model, int32_t *min,
+                                 int32_t *max)
+{
+    if (model->modeltype != NEA_Animated)
+        return false;
+
+    const NEA_Animation *anim_1 = model->animinfo[0]->animation;
+    const NEA_Animation *anim_2 = model->animinfo[1]->animation;
+    if (anim_1 == NULL)
+        return false;
+
+    int32_t blend = ne_model_anim_blend(model);
+
+    if ((anim_2 == NULL) || (blend <= 0))
+        return NEA_AnimationGetBounds(anim_1, ne_model_anim_frame(model, 0),
+                                      min, max);
+
+    if (blend >= inttof32(1))
+        return NEA_AnimationGetBounds(anim_2, ne_model_anim_frame(model, 1),
+                                      min, max);
 
-        MATRIX_SCALE = model->sx;
-        MATRIX_SCALE = model->sy;
-        MATRIX_SCALE = model->sz;
+    int32_t min2[3], max2[3];
+    if (!NEA_AnimationGetBounds(anim_1, ne_model_anim_frame(model, 0),
+                                min, max))
+        return false;
+    if (!NEA_AnimationGetBounds(anim_2, ne_model_anim_frame(model, 1),
+                                min2, max2))
+        return false;
+
+    for (int i = 0; i < 3; i++)
+    {
+        if (min2[i] < min[i])
+            min[i] = min2[i];
+        if (max2[i] > max[i])
+            max[i] = max2[i];
     }
 
-    if (NEA_TestTouch)
+    return true;
+}
+
+// Returns the bounding sphere of a model in model space. Models with animation
+// bounds use the sphere around the box of the poses that are drawn.
+static void ne_model_current_sphere(const NEA_Model *model, int32_t *center,
+                                    int32_t *radius)
+{
+    int32_t min[3], max[3];
+
+    if ((model->bound_radius == 0) || !ne_model_anim_bounds(model, min, max))
     {
-        PosTest_Asynch(0, 0, 0);
+        for (int i = 0; i < 3; i++)
+            center[i] = model->bound_center[i];
+        *radius = model->bound_radius;
+        return;
     }
-    else if (model->multi != NULL)
+
+    int64_t len2 = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        center[i] = (min[i] + max[i]) / 2;
+        int32_t half = max[i] - center[i];
+        len2 += (int64_t)half * half;
+    }
+
+    // Round up to account for the rounding of the center
+    *radius = sqrt64(len2) + 1;
+}
+
+bool NEA_ModelGetBounds(const NEA_Model *model, int32_t *min, int32_t *max)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    if (model->bound_radius == 0)
+        return false;
+
+    if (ne_model_anim_bounds(model, min, max))
+        return true;
+
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = model->bound_center[i] - model->bound_radius;
+        max[i] = model->bound_center[i] + model->bound_radius;
+    }
+
+    return true;
+}
+
+// The secondary animation is a layer on top of the main one, with the blending
+// factor as weight and the mask of the model.
+static void ne_model_anim_layers(const NEA_Model *model, DSMA_Layer *layers)
+{
+    layers[0].dsa_file = model->animinfo[0]->animation->data;
+    layers[0].frame_interp = ne_model_anim_frame(model, 0);
+    layers[0].weight = inttof32(1);
+    layers[0].mask = NULL;
+
+    layers[1].dsa_file = model->animinfo[1]->animation->data;
+    layers[1].frame_interp = ne_model_anim_frame(model, 1);
+    layers[1].weight = ne_model_anim_blend(model);
+    layers[1].mask = model->anim_mask;
+}
+
+// Sends the mesh of a model to the GPU, with its materials, using the current
+// matrix as model transformation.
+static void ne_model_draw_mesh(const NEA_Model *model)
+{
+    if (model->multi != NULL)
     {
         // Multi-material draw path
         // For animated models, set up bone matrices first
@@ -324,38 +919,40 @@ void NEA_ModelDraw(const NEA_Model *model)
             int ret;
             if (model->animinfo[0]->animation && model->animinfo[1]->animation)
             {
-                ret = DSMA_PrepareBonesBlend(
-                        model->animinfo[0]->animation->data,
-                        model->animinfo[0]->currframe,
-                        model->animinfo[1]->animation->data,
-                        model->animinfo[1]->currframe,
-                        model->anim_blend);
+                DSMA_Layer layers[2];
+                ne_model_anim_layers(model, layers);
+                ret = DSMA_PrepareBonesLayers(layers, 2);
             }
             else
             {
-                ret = DSMA_PrepareBones(
+                ret = DSMA_PrepareBonesBaked(
                         model->animinfo[0]->animation->data,
-                        model->animinfo[0]->currframe);
+                        model->animinfo[0]->animation->baked,
+                        ne_model_anim_frame(model, 0));
             }
             NEA_Assert(ret == DSMA_SUCCESS,
                        "Failed to prepare bones for animated model");
         }
 
+        ne_multimesh_flush(model->multi);
+
         for (int i = 0; i < model->multi->num_submeshes; i++)
         {
             NEA_SubMesh *sub = &model->multi->submeshes[i];
-            if (sub->material != NULL)
+            NEA_Material *material = ne_model_submesh_material(model, i);
+            if (material != NULL)
             {
-                NEA_MaterialUse(sub->material);
+                NEA_MaterialUse(material);
             }
             else
             {
-                GFX_DIFFUSE_AMBIENT = sub->diffuse_ambient;
-                GFX_SPECULAR_EMISSION = sub->specular_emission;
+                NEA_DisplayListWait();
+                ne_material_state_diffuse_ambient(sub->diffuse_ambient);
+                ne_material_state_specular_emission(sub->specular_emission);
                 GFX_COLOR = sub->color;
-                GFX_TEX_FORMAT = 0;
+                ne_material_state_tex_format(0);
             }
-            NEA_DisplayListDrawDefault(sub->dl_data);
+            ne_display_list_draw_default(sub->dl_data, true);
         }
 
         if (model->modeltype == NEA_Animated)
@@ -369,36 +966,344 @@ void NEA_ModelDraw(const NEA_Model *model)
         if (model->texture != NULL)
             NEA_MaterialUse(model->texture);
 
-        ne_mesh_info_t *mesh = &NEA_Mesh[model->meshindex];
-        const void *meshdata = mesh->address;
+        ne_mesh_info_t *mesh = &NEA_Mesh[model->meshindex];
+        const void *meshdata = mesh->data;
+
+        if (model->modeltype == NEA_Static)
+        {
+            ne_mesh_draw(mesh);
+        }
+        else // if(model->modeltype == NEA_Animated)
+        {
+            if (DSMA_IsBatched(meshdata) && !model->animinfo[1]->animation)
+            {
+                // Bone batches are uploaded while they are drawn
+                int ret = DSMA_DrawModel(meshdata,
+                                         model->animinfo[0]->animation->data,
+                                         ne_model_anim_frame(model, 0));
+                NEA_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+            }
+            else if (model->animinfo[0]->animation && model->animinfo[1]->animation)
+            {
+                DSMA_Layer layers[2];
+                ne_model_anim_layers(model, layers);
+                int ret = DSMA_DrawModelLayers(meshdata, layers, 2);
+                NEA_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+            }
+            else // if (model->animinfo[0]->animation)
+            {
+                const NEA_Animation *anim = model->animinfo[0]->animation;
+                int ret = DSMA_PrepareBonesBaked(anim->data, anim->baked,
+                                                 ne_model_anim_frame(model, 0));
+                NEA_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+                if (ret == DSMA_SUCCESS)
+                {
+                    ne_display_list_draw_default(meshdata, false);
+                    DSMA_FinishDraw();
+                }
+            }
+        }
+    }
+}
+
+// Returns true if models have to be tested against the frustum. In two-pass
+// modes the frustum only covers the half of the screen of the current pass.
+// Models aren't culled during touch tests, they need a PosTest result.
+static inline bool ne_model_culling_enabled(void)
+{
+    if (NEA_TestTouch)
+        return false;
+
+    return ne_model_frustum_culling || ne_two_pass_culling_active();
+}
+
+// Internal use: returns true if models are culled. See NEAScene.c
+bool ne_model_culling_active(void)
+{
+    return ne_model_culling_enabled();
+}
+
+// Internal use: returns true if the model is outside of the frustum and
+// culling is enabled. See NEAScene.c
+bool ne_model_culled(const NEA_Model *model)
+{
+    if (!ne_model_culling_enabled())
+        return false;
+
+    // The model will be tested by NEA_ModelDraw() after setting its matrix
+    if (ne_model_box_test_culling)
+        return false;
+
+    return !NEA_ModelIsInFrustum(model);
+}
+
+// Biggest scale applied to the matrix to fit the box of a model in the
+// coordinates of the box test. The matrix is restored exactly by the inverse
+// scale as long as its elements don't overflow.
+#define NE_BOX_TEST_MAX_SHIFT 8
+
+// Tests the bounds of a model (see NEA_ModelGetBounds()) with the box test of
+// the GPU, which uses the current matrix and the projection that is really
+// used, including the half of the screen of the current pass in two-pass modes.
+// Returns false if the box is completely outside of the view volume.
+ARM_CODE static bool ne_model_box_visible(const NEA_Model *model)
+{
+    int32_t min[3], size[3];
+    if (!NEA_ModelGetBounds(model, min, size))
+        return true;
+
+    for (int i = 0; i < 3; i++)
+        size[i] -= min[i];
+
+    // The box is sent as 4.12 fixed point values. Bigger boxes are tested in a
+    // scaled down space, with the matrix scaled up by the same factor.
+    int32_t max = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (abs(min[i]) > max)
+            max = abs(min[i]);
+        if (size[i] > max)
+            max = size[i];
+    }
+
+    int shift = 0;
+    while ((max >> shift) > 0x7FFF)
+        shift++;
+
+    if (shift > NE_BOX_TEST_MAX_SHIFT)
+        return true;
+
+    if (shift > 0)
+    {
+        MATRIX_SCALE = inttof32(1) << shift;
+        MATRIX_SCALE = inttof32(1) << shift;
+        MATRIX_SCALE = inttof32(1) << shift;
+    }
+
+    // The test only works with far plane intersecting and 1-dot polygons
+    // enabled, and polygon attributes are only applied by a BEGIN command.
+    ne_material_state_poly_format(POLY_RENDER_FAR_POLYS |
+                                  POLY_RENDER_1DOT_POLYS);
+    GFX_BEGIN = GL_TRIANGLES;
+    GFX_END = 0;
+
+    GFX_BOX_TEST = VERTEX_PACK(min[0] >> shift, min[1] >> shift);
+    GFX_BOX_TEST = VERTEX_PACK(min[2] >> shift, size[0] >> shift);
+    GFX_BOX_TEST = VERTEX_PACK(size[1] >> shift, size[2] >> shift);
+
+    // The polygons of the model will use the format set before the test
+    ne_material_state_poly_format(ne_poly_format_last);
+
+    if (shift > 0)
+    {
+        MATRIX_SCALE = inttof32(1) >> shift;
+        MATRIX_SCALE = inttof32(1) >> shift;
+        MATRIX_SCALE = inttof32(1) >> shift;
+    }
+
+    while (GFX_STATUS & BIT(0));
+
+    return GFX_STATUS & BIT(1);
+}
+
+// Internal use: draws a model that has already been tested with
+// ne_model_culled(), so that the scene doesn't test it twice. See NEAScene.c
+void ne_model_draw_unculled(const NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    if (model->multi == NULL && model->meshindex == NEA_NO_MESH)
+        return;
+
+    if (model->modeltype == NEA_Animated)
+    {
+        // The base animation must always be present. The secondary animation
+        // isn't required to draw the model.
+        if (model->animinfo[0]->animation == NULL)
+            return;
+    }
+
+    // Wait for any asynchronous display list that is still being sent
+    NEA_DisplayListWait();
+
+    const m4x3 *mat = model->mat;
+    if (mat == NULL)
+    {
+        // The cached matrix isn't really part of the state of the model, it
+        // is fine to update it here.
+        ne_model_update_transform((NEA_Model *)model);
+        mat = &model->transform;
+    }
+
+    ne_model_apply_lights(model, mat);
+
+    MATRIX_PUSH = 0;
+
+    glMultMatrix4x3(mat);
+
+    // Touch tests need the PosTest result of all models
+    if (ne_model_box_test_culling && !NEA_TestTouch &&
+        (model->bound_radius != 0) && !ne_model_box_visible(model))
+    {
+        ne_display_list_matrix_pop();
+        NE_STAT_ADD(models_culled, 1);
+        return;
+    }
+
+    NE_STAT_ADD(models_drawn, 1);
+
+    if (NEA_TestTouch)
+        PosTest_Asynch(0, 0, 0);
+    else
+        ne_model_draw_mesh(model);
+
+    ne_display_list_matrix_pop();
+}
+
+void NEA_ModelDraw(const NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    if (model->multi == NULL && model->meshindex == NEA_NO_MESH)
+        return;
+
+    if (ne_model_culled(model))
+    {
+        NE_STAT_ADD(models_culled, 1);
+        return;
+    }
+
+    ne_model_draw_unculled(model);
+}
+
+// Returns true if the instance has to be skipped by frustum culling
+static inline bool ne_model_instance_culled(const NEA_Model *model,
+                                            const m4x3 *mat)
+{
+    if (!ne_model_culling_enabled())
+        return false;
+
+    if (model->bound_radius == 0)
+        return false;
+
+    return !ne_model_sphere_test_matrix(model, mat);
+}
+
+ARM_CODE void NEA_ModelDrawInstanced(const NEA_Model *model,
+                                     const m4x3 *transforms, int count)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    NEA_AssertPointer(transforms, "NULL transforms pointer");
+    NEA_Assert(count >= 0, "Invalid instance count");
+
+    if (model->multi == NULL && model->meshindex == NEA_NO_MESH)
+        return;
+
+    if (model->modeltype == NEA_Animated)
+    {
+        if (model->animinfo[0]->animation == NULL)
+            return;
+    }
+
+    // Animated models need to set up their bones for each instance because the
+    // bone matrices are multiplied by the current matrix. Touch tests need one
+    // PosTest per instance. Draw them as regular models.
+    if (NEA_TestTouch || model->modeltype == NEA_Animated)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (ne_model_instance_culled(model, &transforms[i]))
+            {
+                NE_STAT_ADD(models_culled, 1);
+                continue;
+            }
+
+            NE_STAT_ADD(models_drawn, 1);
+
+            NEA_DisplayListWait();
+            ne_model_apply_lights(model, &transforms[i]);
+            MATRIX_PUSH = 0;
+            glMultMatrix4x3(&transforms[i]);
+
+            if (NEA_TestTouch)
+                PosTest_Asynch(0, 0, 0);
+            else
+                ne_model_draw_mesh(model);
+
+            ne_display_list_matrix_pop();
+        }
+        return;
+    }
+
+    if (model->multi != NULL)
+    {
+        ne_multimesh_flush(model->multi);
 
-        if (model->modeltype == NEA_Static)
+        // Bind each material once and draw that submesh for all instances
+        for (int j = 0; j < model->multi->num_submeshes; j++)
         {
-            NEA_DisplayListDrawDefault(meshdata);
-        }
-        else // if(model->modeltype == NEA_Animated)
-        {
-            if (model->animinfo[0]->animation && model->animinfo[1]->animation)
+            NEA_SubMesh *sub = &model->multi->submeshes[j];
+            NEA_Material *material = ne_model_submesh_material(model, j);
+            if (material != NULL)
             {
-                int ret = DSMA_DrawModelBlendAnimation(meshdata,
-                        model->animinfo[0]->animation->data,
-                        model->animinfo[0]->currframe,
-                        model->animinfo[1]->animation->data,
-                        model->animinfo[1]->currframe,
-                        model->anim_blend);
-                NEA_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+                NEA_MaterialUse(material);
             }
-            else // if (model->animinfo[0]->animation)
+            else
             {
-                int ret = DSMA_DrawModel(meshdata,
-                                         model->animinfo[0]->animation->data,
-                                         model->animinfo[0]->currframe);
-                NEA_Assert(ret == DSMA_SUCCESS, "Failed to draw animated model");
+                NEA_DisplayListWait();
+                ne_material_state_diffuse_ambient(sub->diffuse_ambient);
+                ne_material_state_specular_emission(sub->specular_emission);
+                GFX_COLOR = sub->color;
+                ne_material_state_tex_format(0);
+            }
+
+            for (int i = 0; i < count; i++)
+            {
+                // Instances are counted with the first submesh only
+                if (ne_model_instance_culled(model, &transforms[i]))
+                {
+                    if (j == 0)
+                        NE_STAT_ADD(models_culled, 1);
+                    continue;
+                }
+
+                if (j == 0)
+                    NE_STAT_ADD(models_drawn, 1);
+
+                NEA_DisplayListWait();
+                ne_model_apply_lights(model, &transforms[i]);
+                MATRIX_PUSH = 0;
+                glMultMatrix4x3(&transforms[i]);
+                ne_display_list_draw_default(sub->dl_data, true);
+                ne_display_list_matrix_pop();
             }
         }
+        return;
     }
 
-    MATRIX_POP = 1;
+    if (model->texture != NULL)
+        NEA_MaterialUse(model->texture);
+
+    ne_mesh_info_t *mesh = &NEA_Mesh[model->meshindex];
+
+    if (!mesh->clean)
+        ne_mesh_flush(mesh);
+
+    for (int i = 0; i < count; i++)
+    {
+        if (ne_model_instance_culled(model, &transforms[i]))
+        {
+            NE_STAT_ADD(models_culled, 1);
+            continue;
+        }
+
+        NE_STAT_ADD(models_drawn, 1);
+
+        NEA_DisplayListWait();
+        ne_model_apply_lights(model, &transforms[i]);
+        MATRIX_PUSH = 0;
+        glMultMatrix4x3(&transforms[i]);
+        ne_display_list_draw_default(mesh->data, true);
+        ne_display_list_matrix_pop();
+    }
 }
 
 void NEA_ModelClone(NEA_Model *dest, NEA_Model *source)
@@ -410,9 +1315,25 @@ void NEA_ModelClone(NEA_Model *dest, NEA_Model *source)
 
     if (dest->modeltype == NEA_Animated)
     {
-        memcpy(dest->animinfo[0], source->animinfo[0], sizeof(NEA_AnimInfo));
-        memcpy(dest->animinfo[1], source->animinfo[1], sizeof(NEA_AnimInfo));
+        if (source->anim_group != NULL)
+        {
+            NEA_ModelAnimGroupJoin(source->anim_group, dest,
+                                   source->anim_phase);
+        }
+        else
+        {
+            if (dest->anim_group != NULL)
+                NEA_ModelAnimGroupLeave(dest);
+
+            memcpy(dest->animinfo[0], source->animinfo[0],
+                   sizeof(NEA_AnimInfo));
+            memcpy(dest->animinfo[1], source->animinfo[1],
+                   sizeof(NEA_AnimInfo));
+        }
         dest->anim_blend = source->anim_blend;
+        dest->anim_mask = source->anim_mask;
+        for (int i = 0; i < 3; i++)
+            dest->anim_lod_distance[i] = source->anim_lod_distance[i];
     }
 
     dest->x = source->x;
@@ -424,6 +1345,12 @@ void NEA_ModelClone(NEA_Model *dest, NEA_Model *source)
     dest->sx = source->sx;
     dest->sy = source->sy;
     dest->sz = source->sz;
+    dest->transform_dirty = true;
+
+    dest->bound_center[0] = source->bound_center[0];
+    dest->bound_center[1] = source->bound_center[1];
+    dest->bound_center[2] = source->bound_center[2];
+    dest->bound_radius = source->bound_radius;
 
     dest->texture = source->texture;
     dest->meshindex = source->meshindex;
@@ -436,17 +1363,22 @@ void NEA_ModelClone(NEA_Model *dest, NEA_Model *source)
         mesh->uses++;
     }
 
-    // Clone multi-mesh data if present
+    // Share multi-mesh data if present. Only the materials of the source model
+    // are copied, if it has its own ones.
+    dest->multi = source->multi;
+    dest->submesh_materials = NULL;
     if (source->multi != NULL)
     {
-        dest->multi = calloc(1, sizeof(NEA_MultiMeshData));
-        NEA_AssertPointer(dest->multi, "Not enough memory for multi-mesh clone");
-        memcpy(dest->multi, source->multi, sizeof(NEA_MultiMeshData));
-        (*dest->multi->base_refcount)++;
-    }
-    else
-    {
-        dest->multi = NULL;
+        source->multi->refcount++;
+
+        if (source->submesh_materials != NULL)
+        {
+            size_t size = source->multi->num_submeshes * sizeof(NEA_Material *);
+            dest->submesh_materials = ne_heap_malloc(NEA_HEAP_MODEL, size);
+            NEA_AssertPointer(dest->submesh_materials,
+                              "Not enough memory for multi-mesh clone");
+            memcpy(dest->submesh_materials, source->submesh_materials, size);
+        }
     }
 }
 
@@ -456,6 +1388,7 @@ void NEA_ModelScaleI(NEA_Model *model, int x, int y, int z)
     model->sx = x;
     model->sy = y;
     model->sz = z;
+    model->transform_dirty = true;
 }
 
 void NEA_ModelTranslateI(NEA_Model *model, int x, int y, int z)
@@ -464,6 +1397,7 @@ void NEA_ModelTranslateI(NEA_Model *model, int x, int y, int z)
     model->x += x;
     model->y += y;
     model->z += z;
+    model->transform_dirty = true;
 }
 
 void NEA_ModelSetCoordI(NEA_Model *model, int x, int y, int z)
@@ -472,6 +1406,7 @@ void NEA_ModelSetCoordI(NEA_Model *model, int x, int y, int z)
     model->x = x;
     model->y = y;
     model->z = z;
+    model->transform_dirty = true;
 }
 
 void NEA_ModelRotate(NEA_Model *model, int rx, int ry, int rz)
@@ -480,6 +1415,7 @@ void NEA_ModelRotate(NEA_Model *model, int rx, int ry, int rz)
     model->rx = (model->rx + rx + 512) & 0x1FF;
     model->ry = (model->ry + ry + 512) & 0x1FF;
     model->rz = (model->rz + rz + 512) & 0x1FF;
+    model->transform_dirty = true;
 }
 
 void NEA_ModelSetRot(NEA_Model *model, int rx, int ry, int rz)
@@ -488,6 +1424,7 @@ void NEA_ModelSetRot(NEA_Model *model, int rx, int ry, int rz)
     model->rx = rx;
     model->ry = ry;
     model->rz = rz;
+    model->transform_dirty = true;
 }
 
 int NEA_ModelSetMatrix(NEA_Model *model, m4x3 *mat)
@@ -497,9 +1434,16 @@ int NEA_ModelSetMatrix(NEA_Model *model, m4x3 *mat)
 
     if (model->mat == NULL)
     {
-        model->mat = malloc(sizeof(m4x3));
+#ifdef NEA_STATIC_POOLS
+        int slot = ne_pool_find(&ne_model_pool, model);
+        if (slot < 0)
+            return 0;
+        model->mat = &ne_model_mat_static[slot];
+#else
+        model->mat = ne_heap_malloc(NEA_HEAP_MODEL, sizeof(m4x3));
         if (model->mat == NULL)
             return 0;
+#endif
     }
 
     memcpy(model->mat, mat, sizeof(m4x3));
@@ -514,7 +1458,182 @@ void NEA_ModelClearMatrix(NEA_Model *model)
     if (model->mat == NULL)
         return;
 
-    free(model->mat);
+#ifndef NEA_STATIC_POOLS
+    ne_heap_free(NEA_HEAP_MODEL, model->mat);
+#endif
+    model->mat = NULL;
+}
+
+void NEA_ModelTransformChanged(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    model->transform_dirty = true;
+}
+
+// Internal use... see NEACamera.c
+bool ne_camera_active_position(int32_t *pos);
+uint32_t ne_camera_active_stamp(void);
+
+// Internal use: returns the location of a model in world space. See NEASound.c
+void ne_model_world_position(const NEA_Model *model, int32_t *pos)
+{
+    if (model->mat != NULL)
+    {
+        pos[0] = model->mat->m[9];
+        pos[1] = model->mat->m[10];
+        pos[2] = model->mat->m[11];
+    }
+    else
+    {
+        pos[0] = model->x;
+        pos[1] = model->y;
+        pos[2] = model->z;
+    }
+}
+
+// Calculates the distance from the camera used last to a model, unless it's
+// already cached for the same locations of both. It returns false if there is
+// no camera.
+static bool ne_model_camera_cache_update(NEA_Model *model)
+{
+    uint32_t stamp = ne_camera_active_stamp();
+    if (stamp == 0)
+        return false;
+
+    int32_t pos[3];
+    ne_model_world_position(model, pos);
+
+    if ((model->cam_stamp == stamp) && (model->cam_pos[0] == pos[0]) &&
+        (model->cam_pos[1] == pos[1]) && (model->cam_pos[2] == pos[2]))
+        return true;
+
+    int32_t cam[3];
+    ne_camera_active_position(cam);
+
+    int64_t dx = pos[0] - cam[0];
+    int64_t dy = pos[1] - cam[1];
+    int64_t dz = pos[2] - cam[2];
+
+    model->cam_dist2 = dx * dx + dy * dy + dz * dz;
+    model->cam_dist = -1;
+    model->cam_stamp = stamp;
+    for (int i = 0; i < 3; i++)
+        model->cam_pos[i] = pos[i];
+
+    return true;
+}
+
+// Internal use: gets the squared distance from the camera used last to a model
+// (f32 * f32). It returns false if there is no camera. See NEAModelLOD.c and
+// NEASound.c
+bool ne_model_camera_dist2(NEA_Model *model, int64_t *dist2)
+{
+    if (!ne_model_camera_cache_update(model))
+        return false;
+
+    *dist2 = model->cam_dist2;
+    return true;
+}
+
+int32_t NEA_ModelGetCameraDistance(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    if (!ne_model_camera_cache_update(model))
+        return -1;
+
+    // The square root is only calculated the first time it's needed
+    if (model->cam_dist < 0)
+        model->cam_dist = sqrt64(model->cam_dist2);
+
+    return model->cam_dist;
+}
+
+static int ne_model_anim_lod_select(NEA_Model *model, int32_t scale)
+{
+    int64_t dist2;
+    if (!ne_model_camera_dist2(model, &dist2))
+        return NEA_ANIM_LOD_FULL;
+
+    for (int i = NEA_ANIM_LOD_SNAP; i > NEA_ANIM_LOD_FULL; i--)
+    {
+        if (model->anim_lod_distance[i - 1] == 0)
+            continue;
+
+        int64_t d = mulf32(model->anim_lod_distance[i - 1], scale);
+
+        if (dist2 >= d * d)
+            return i;
+    }
+
+    return NEA_ANIM_LOD_FULL;
+}
+
+static void ne_model_anim_advance(NEA_AnimInfo *animinfo, int frames)
+{
+    animinfo->currframe += animinfo->speed * frames;
+
+    if (animinfo->type ==  NEA_ANIM_LOOP)
+    {
+        int32_t endval = inttof32(animinfo->numframes);
+        if (endval <= 0)
+            return;
+
+        // Several frames may have been skipped, so it can be out of range by
+        // more than one loop.
+        if ((animinfo->currframe >= endval) || (animinfo->currframe < 0))
+        {
+            animinfo->currframe %= endval;
+            if (animinfo->currframe < 0)
+                animinfo->currframe += endval;
+        }
+    }
+    else if (animinfo->type ==  NEA_ANIM_ONESHOT)
+    {
+        int32_t endval = inttof32(animinfo->numframes - 1);
+        if (animinfo->currframe > endval)
+        {
+            animinfo->currframe = endval;
+            animinfo->speed = 0;
+        }
+        else if (animinfo->currframe < 0)
+        {
+            animinfo->currframe = 0;
+            animinfo->speed = 0;
+        }
+    }
+}
+
+// Asks the ARM7 for the poses that DSMA_PrepareBones() will need to draw the
+// animated models (see NEAPoseService.c). Poses that are drawn in other ways
+// aren't requested.
+static void ne_model_request_poses(void)
+{
+    extern int NEA_PoseServiceRequest(const void *dsa_file,
+                                      uint32_t frame_interp)
+                                      __attribute__((weak));
+
+    for (int i = 0; i < ne_pool_count(&ne_model_pool); i++)
+    {
+        NEA_Model *model = ne_pool_get(&ne_model_pool, i);
+
+        if ((model == NULL) || (model->modeltype != NEA_Animated))
+            continue;
+
+        const NEA_Animation *anim = model->animinfo[0]->animation;
+        if ((anim == NULL) || (model->animinfo[1]->animation != NULL))
+            continue;
+
+        if ((model->multi == NULL) &&
+            DSMA_IsBatched(NEA_Mesh[model->meshindex].data))
+            continue;
+
+        int32_t frame = ne_model_anim_frame(model, 0);
+        if ((anim->baked != NULL) && ((frame & (inttof32(1) - 1)) == 0))
+            continue;
+
+        NEA_PoseServiceRequest(anim->data, frame);
+    }
 }
 
 void NEA_ModelAnimateAll(void)
@@ -522,44 +1641,84 @@ void NEA_ModelAnimateAll(void)
     if (!ne_model_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_MODELS; i++)
+    static unsigned int tick = 0;
+    tick++;
+
+    // Weak reference: the budget governor is only linked if the user uses it
+    extern int32_t NEA_BudgetGetLODScale(void) __attribute__((weak));
+    int32_t scale = NEA_BudgetGetLODScale ? NEA_BudgetGetLODScale()
+                                          : inttof32(1);
+
+    ne_pool_lock(&ne_model_pool);
+
+    for (int i = 0; i < ne_pool_count(&ne_model_pool); i++)
     {
-        if (NEA_ModelPointers[i] == NULL)
+        NEA_Model *model = ne_pool_get(&ne_model_pool, i);
+
+        if (model == NULL)
             continue;
 
-        if (NEA_ModelPointers[i]->modeltype != NEA_Animated)
+        if (model->modeltype != NEA_Animated)
             continue;
 
-        for (int j = 0; j < 2; j++)
-        {
-            NEA_AnimInfo *animinfo = NEA_ModelPointers[i]->animinfo[j];
+        int level = ne_model_anim_lod_select(model, scale);
 
-            animinfo->currframe += animinfo->speed;
+        model->anim_lod_level = level;
 
-            if (animinfo->type ==  NEA_ANIM_LOOP)
-            {
-                int32_t endval = inttof32(animinfo->numframes);
-                if (animinfo->currframe >= endval)
-                    animinfo->currframe -= endval;
-                else if (animinfo->currframe < 0)
-                    animinfo->currframe += endval;
-            }
-            else if (animinfo->type ==  NEA_ANIM_ONESHOT)
+        // The state of a group is advanced by the first member that is found.
+        // The LOD level of each member is still used to snap its pose.
+        NEA_ModelAnimGroup *group = model->anim_group;
+        if (group != NULL)
+        {
+            if (group->tick != tick)
             {
-                int32_t endval = inttof32(animinfo->numframes - 1);
-                if (animinfo->currframe > endval)
-                {
-                    animinfo->currframe = endval;
-                    animinfo->speed = 0;
-                }
-                else if (animinfo->currframe < 0)
-                {
-                    animinfo->currframe = 0;
-                    animinfo->speed = 0;
-                }
+                group->tick = tick;
+                for (int j = 0; j < 2; j++)
+                    ne_model_anim_advance(&group->animinfo[j], 1);
             }
+            continue;
         }
+
+        model->anim_lod_pending++;
+
+        // Use the slot of the model to spread the updates over the frames
+        if (level > NEA_ANIM_LOD_QUARTER)
+            level = NEA_ANIM_LOD_QUARTER;
+        unsigned int period_mask = (1 << level) - 1;
+        int slot = ne_pool_slot(&ne_model_pool, i);
+        if (((tick + slot) & period_mask) != 0)
+            continue;
+
+        for (int j = 0; j < 2; j++)
+            ne_model_anim_advance(model->animinfo[j], model->anim_lod_pending);
+
+        model->anim_lod_pending = 0;
     }
+
+    ne_pool_unlock(&ne_model_pool);
+
+    extern bool NEA_PoseServiceIsActive(void) __attribute__((weak));
+    if (NEA_PoseServiceIsActive && NEA_PoseServiceIsActive())
+        ne_model_request_poses();
+}
+
+void NEA_ModelAnimSetLODI(NEA_Model *model, int32_t half, int32_t quarter,
+                          int32_t snap)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    NEA_Assert(model->modeltype == NEA_Animated, "Not an animated model");
+    NEA_Assert((half >= 0) && (quarter >= 0) && (snap >= 0),
+               "Invalid distance");
+
+    model->anim_lod_distance[0] = half;
+    model->anim_lod_distance[1] = quarter;
+    model->anim_lod_distance[2] = snap;
+}
+
+int NEA_ModelAnimGetLODLevel(const NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    return model->anim_lod_level;
 }
 
 void NEA_ModelAnimStart(NEA_Model *model, NEA_AnimationType type, int32_t speed)
@@ -579,7 +1738,7 @@ void NEA_ModelAnimSecondaryStart(NEA_Model *model, NEA_AnimationType type,
     model->animinfo[1]->type = type;
     model->animinfo[1]->speed = speed;
     model->animinfo[1]->currframe = 0;
-    model->anim_blend = 0;
+    ne_model_anim_blend_set(model, 0);
 }
 
 void NEA_ModelAnimSetSpeed(NEA_Model *model, int32_t speed)
@@ -634,7 +1793,7 @@ void NEA_ModelAnimSecondarySetFactor(NEA_Model *model, int32_t factor)
         factor = 0;
     if (factor > inttof32(1))
         factor = inttof32(1);
-    model->anim_blend = factor;
+    ne_model_anim_blend_set(model, factor);
 }
 
 void NEA_ModelAnimSecondaryClear(NEA_Model *model, bool replace_base_anim)
@@ -652,6 +1811,117 @@ void NEA_ModelAnimSecondaryClear(NEA_Model *model, bool replace_base_anim)
     memset(model->animinfo[1], 0, sizeof(NEA_AnimInfo));
 }
 
+NEA_ModelAnimGroup *NEA_ModelAnimGroupCreate(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    NEA_Assert(model->modeltype == NEA_Animated, "Not an animated model");
+
+    if (model->anim_group != NULL)
+    {
+        NEA_DebugPrint("Model already in a group");
+        return NULL;
+    }
+
+    NEA_ModelAnimGroup *group = ne_heap_calloc(NEA_HEAP_MODEL,
+                                               1, sizeof(NEA_ModelAnimGroup));
+    if (group == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    memcpy(&group->animinfo[0], model->animinfo[0], sizeof(NEA_AnimInfo));
+    memcpy(&group->animinfo[1], model->animinfo[1], sizeof(NEA_AnimInfo));
+    group->anim_blend = model->anim_blend;
+
+    for (int i = 0; i < 2; i++)
+    {
+        ne_model_animinfo_free(model->animinfo[i]);
+        model->animinfo[i] = &group->animinfo[i];
+    }
+
+    model->anim_group = group;
+    model->anim_phase = 0;
+    group->members = 1;
+
+    return group;
+}
+
+int NEA_ModelAnimGroupJoin(NEA_ModelAnimGroup *group, NEA_Model *model,
+                           int phase)
+{
+    NEA_AssertPointer(group, "NULL group pointer");
+    NEA_AssertPointer(model, "NULL model pointer");
+    NEA_Assert(model->modeltype == NEA_Animated, "Not an animated model");
+
+    if (phase < 0 || phase >= NEA_ANIM_GROUP_MAX_PHASES)
+    {
+        NEA_DebugPrint("Invalid phase");
+        return 0;
+    }
+
+    if (model->anim_group == group)
+    {
+        model->anim_phase = phase;
+        return 1;
+    }
+
+    if (model->anim_group != NULL)
+    {
+        ne_model_anim_group_remove(model);
+    }
+    else
+    {
+        for (int i = 0; i < 2; i++)
+            ne_model_animinfo_free(model->animinfo[i]);
+    }
+
+    for (int i = 0; i < 2; i++)
+        model->animinfo[i] = &group->animinfo[i];
+
+    model->anim_group = group;
+    model->anim_phase = phase;
+    model->anim_lod_pending = 0;
+    group->members++;
+
+    return 1;
+}
+
+void NEA_ModelAnimGroupLeave(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    NEA_ModelAnimGroup *group = model->anim_group;
+    if (group == NULL)
+        return;
+
+    int slot = ne_pool_find(&ne_model_pool, model);
+
+    NEA_AnimInfo *animinfo[2];
+    for (int i = 0; i < 2; i++)
+    {
+        animinfo[i] = ne_model_animinfo_alloc(slot, i);
+        NEA_AssertPointer(animinfo[i], "Couldn't allocate animation info");
+        memcpy(animinfo[i], &group->animinfo[i], sizeof(NEA_AnimInfo));
+    }
+    model->anim_blend = group->anim_blend;
+
+    ne_model_anim_group_remove(model);
+
+    model->animinfo[0] = animinfo[0];
+    model->animinfo[1] = animinfo[1];
+}
+
+void NEA_ModelAnimGroupSetPhaseI(NEA_ModelAnimGroup *group, int phase,
+                                 int32_t offset)
+{
+    NEA_AssertPointer(group, "NULL pointer");
+    NEA_Assert(phase >= 0 && phase < NEA_ANIM_GROUP_MAX_PHASES,
+               "Invalid phase");
+
+    group->phase_offset[phase] = offset;
+}
+
 int NEA_ModelLoadDSMFAT(NEA_Model *model, const char *path)
 {
     if (!ne_model_system_inited)
@@ -677,11 +1947,27 @@ int NEA_ModelLoadDSM(NEA_Model *model, const void *pointer)
 //--------------------------------------------------------------------------
 
 #define DLMM_HEADER_SIZE         12
+#define DLMM_V2_HEADER_SIZE      32
 #define DLMM_SUBMESH_HEADER_SIZE 56
 
+// Submesh records are used as NEA_SubMesh structs. Version 2 files reserve the
+// end of the header for the NEA_MultiMeshData struct.
+#if UINTPTR_MAX == UINT32_MAX
+_Static_assert(sizeof(NEA_SubMesh) == DLMM_SUBMESH_HEADER_SIZE,
+               "Update DLMM_SUBMESH_HEADER_SIZE, obj2dl and md5_to_dsma");
+_Static_assert(offsetof(NEA_SubMesh, diffuse_ambient) == 8,
+               "Submesh layout changed");
+_Static_assert(offsetof(NEA_SubMesh, name) == 24, "Submesh layout changed");
+_Static_assert(sizeof(NEA_MultiMeshData)
+               <= DLMM_V2_HEADER_SIZE - DLMM_HEADER_SIZE,
+               "Multi-mesh data doesn't fit in the DLMM header");
+#endif
+
 static int ne_multimesh_load(NEA_Model *model, void *data, bool has_to_free)
 {
-    const u8 *ptr = (const u8 *)data;
+    // Offsets inside the DLMM file are relative to the start of the DLMM
+    // header, after the optional bounding sphere chunk.
+    u8 *ptr = (u8 *)ne_mesh_read_bounds(model, data);
 
     // Read file header
     u32 magic = *(const u32 *)(ptr + 0);
@@ -691,90 +1977,87 @@ static int ne_multimesh_load(NEA_Model *model, void *data, bool has_to_free)
     if (magic != NEA_DLMM_MAGIC)
     {
         NEA_DebugPrint("Invalid DLMM magic");
-        if (has_to_free)
-            free(data);
-        return 0;
+        goto error;
     }
 
-    if (version != 1)
+    if (version != 1 && version != 2)
     {
         NEA_DebugPrint("Unsupported DLMM version");
-        if (has_to_free)
-            free(data);
-        return 0;
+        goto error;
     }
 
     if (num_submeshes == 0 || num_submeshes > NEA_MAX_SUBMESHES)
     {
         NEA_DebugPrint("Invalid submesh count");
-        if (has_to_free)
-            free(data);
-        return 0;
+        goto error;
     }
 
-    // Free existing multi-mesh if present
-    if (model->multi != NULL)
+    size_t header_size = version == 1 ? DLMM_HEADER_SIZE : DLMM_V2_HEADER_SIZE;
+    NEA_SubMesh *records = (NEA_SubMesh *)(ptr + header_size);
+    u32 lists_start = header_size + num_submeshes * DLMM_SUBMESH_HEADER_SIZE;
+
+    // The lists are sent to the GPU with DMA, so they must be word-aligned
+    for (u32 i = 0; i < num_submeshes; i++)
     {
-        (*model->multi->base_refcount)--;
-        if (*model->multi->base_refcount == 0)
+        u32 dl_offset = (uintptr_t)records[i].dl_data;
+        if (dl_offset < lists_start || (dl_offset & 3) != 0)
         {
-            if (model->multi->base_has_to_free)
-                free(model->multi->base_data);
-            free(model->multi->base_refcount);
+            NEA_DebugPrint("Invalid display list offset");
+            goto error;
         }
-        free(model->multi);
-        model->multi = NULL;
     }
 
-    // Allocate multi-mesh data
-    NEA_MultiMeshData *multi = calloc(1, sizeof(NEA_MultiMeshData));
-    if (multi == NULL)
+    // Free existing multi-mesh if present
+    ne_model_multimesh_remove(model);
+
+    NEA_MultiMeshData *multi;
+    if (version == 2 && has_to_free)
     {
-        NEA_DebugPrint("Not enough memory");
-        if (has_to_free)
-            free(data);
-        return 0;
+        // The file belongs to the model, so its header and submesh records are
+        // used in place.
+        multi = (NEA_MultiMeshData *)(ptr + DLMM_HEADER_SIZE);
+        memset(multi, 0, sizeof(NEA_MultiMeshData));
+        multi->submeshes = records;
+        multi->num_submeshes = num_submeshes;
+        multi->refcount = 1;
+        multi->in_place = true;
     }
-
-    multi->base_refcount = malloc(sizeof(int));
-    if (multi->base_refcount == NULL)
+    else
     {
-        NEA_DebugPrint("Not enough memory");
-        free(multi);
-        if (has_to_free)
-            free(data);
-        return 0;
+        multi = ne_multimesh_create(num_submeshes);
+        if (multi == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            goto error;
+        }
+
+        memcpy(multi->submeshes, records,
+               num_submeshes * sizeof(NEA_SubMesh));
     }
 
-    *multi->base_refcount = 1;
     multi->base_data = data;
     multi->base_has_to_free = has_to_free;
-    multi->num_submeshes = (int)num_submeshes;
 
-    // Parse submesh headers
-    const u8 *hdr = ptr + DLMM_HEADER_SIZE;
-    for (int i = 0; i < (int)num_submeshes; i++)
+    // Replace the offsets of the lists by pointers. Version 1 files store the
+    // size of the list in the material field.
+    for (u32 i = 0; i < num_submeshes; i++)
     {
         NEA_SubMesh *sub = &multi->submeshes[i];
 
-        u32 dl_offset = *(const u32 *)(hdr + 0);
-        sub->diffuse_ambient = *(const u32 *)(hdr + 8);
-        sub->specular_emission = *(const u32 *)(hdr + 12);
-        sub->color = *(const u32 *)(hdr + 16);
-        sub->alpha = *(const u16 *)(hdr + 20);
-        sub->flags = *(const u16 *)(hdr + 22);
-
-        memcpy(sub->name, hdr + 24, NEA_MATERIAL_NAME_LEN);
-        sub->name[NEA_MATERIAL_NAME_LEN - 1] = '\0';
-
-        sub->dl_data = (void *)(ptr + dl_offset);
+        sub->dl_data = ptr + (uintptr_t)sub->dl_data;
         sub->material = NULL;
-
-        hdr += DLMM_SUBMESH_HEADER_SIZE;
+        sub->name[NEA_MATERIAL_NAME_LEN - 1] = '\0';
     }
 
+    ne_multimesh_flush(multi);
+
     model->multi = multi;
     return 1;
+
+error:
+    if (has_to_free)
+        ne_heap_free(NEA_HEAP_MODEL, data);
+    return 0;
 }
 
 int NEA_ModelLoadMultiMesh(NEA_Model *model, const void *pointer)
@@ -800,6 +2083,8 @@ int NEA_ModelLoadMultiMeshFAT(NEA_Model *model, const char *path)
     if (data == NULL)
         return 0;
 
+    ne_heap_track(NEA_HEAP_MODEL, data);
+
     return ne_multimesh_load(model, data, true);
 }
 
@@ -821,8 +2106,7 @@ int NEA_ModelSetSubMeshMaterial(NEA_Model *model, int submesh_index,
         return 0;
     }
 
-    model->multi->submeshes[submesh_index].material = material;
-    return 1;
+    return ne_model_submesh_set_material(model, submesh_index, material);
 }
 
 int NEA_ModelSetSubMeshMaterialByName(NEA_Model *model, const char *name,
@@ -841,10 +2125,7 @@ int NEA_ModelSetSubMeshMaterialByName(NEA_Model *model, const char *name,
     for (int i = 0; i < model->multi->num_submeshes; i++)
     {
         if (strcmp(model->multi->submeshes[i].name, name) == 0)
-        {
-            model->multi->submeshes[i].material = material;
-            return 1;
-        }
+            return ne_model_submesh_set_material(model, i, material);
     }
 
     NEA_DebugPrint("Submesh name not found");
@@ -865,7 +2146,7 @@ void NEA_ModelAutoBindMaterials(NEA_Model *model)
         {
             NEA_Material *mat = NEA_MaterialFindByName(sub->name);
             if (mat != NULL)
-                sub->material = mat;
+                ne_model_submesh_set_material(model, i, mat);
         }
     }
 }
@@ -898,10 +2179,11 @@ void NEA_ModelDeleteAll(void)
     if (!ne_model_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_MODELS; i++)
+    for (int i = ne_pool_count(&ne_model_pool) - 1; i >= 0; i--)
     {
-        if (NEA_ModelPointers[i] != NULL)
-            NEA_ModelDelete(NEA_ModelPointers[i]);
+        NEA_Model *model = ne_pool_get(&ne_model_pool, i);
+        if (model != NULL)
+            NEA_ModelDelete(model);
     }
 }
 
@@ -915,16 +2197,24 @@ int NEA_ModelSystemReset(int max_models)
     else
         NEA_MAX_MODELS = max_models;
 
-    NEA_Mesh = calloc(NEA_MAX_MODELS, sizeof(ne_mesh_info_t));
-    NEA_ModelPointers = calloc(NEA_MAX_MODELS, sizeof(NEA_ModelPointers));
-    if ((NEA_Mesh == NULL) || (NEA_ModelPointers == NULL))
+    NEA_MAX_MODELS = NE_STATIC_CAPACITY(NEA_MAX_MODELS, NEA_STATIC_MAX_MODELS);
+
+    NEA_Mesh = NE_STATIC_CALLOC(ne_mesh_static, NEA_MAX_MODELS,
+                                sizeof(ne_mesh_info_t));
+    if (NEA_Mesh == NULL)
     {
-        free(NEA_Mesh);
-        free(NEA_ModelPointers);
         NEA_DebugPrint("Not enough memory");
         return -1;
     }
 
+    if (NE_POOL_INIT(&ne_model_pool, ne_model_static, NEA_MAX_MODELS) == 0)
+    {
+        NE_STATIC_FREE(ne_mesh_static, NEA_Mesh);
+        return -1;
+    }
+
+    ne_pool_set_heap_tag(&ne_model_pool, NEA_HEAP_MODEL);
+
     ne_model_system_inited = true;
     return 0;
 }
@@ -936,8 +2226,8 @@ void NEA_ModelSystemEnd(void)
 
     NEA_ModelDeleteAll();
 
-    free(NEA_Mesh);
-    free(NEA_ModelPointers);
+    NE_STATIC_FREE(ne_mesh_static, NEA_Mesh);
+    ne_pool_end(&ne_model_pool);
 
     ne_model_system_inited = false;
 }
@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAModelLOD.c
+
+// Internal use... see NEAModel.c
+void ne_model_update_transform(NEA_Model *model);
+bool ne_model_camera_dist2(NEA_Model *model, int64_t *dist2);
+
+NEA_ModelLOD *NEA_ModelLODCreate(NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    NEA_ModelLOD *lod = calloc(1, sizeof(NEA_ModelLOD));
+    if (lod == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    lod->model = model;
+    lod->level[0] = model;
+    lod->distance[0] = 0;
+    lod->num_levels = 1;
+    lod->last_level = -1;
+
+    return lod;
+}
+
+void NEA_ModelLODDelete(NEA_ModelLOD *lod)
+{
+    NEA_AssertPointer(lod, "NULL pointer");
+
+    free(lod);
+}
+
+int NEA_ModelLODSetLevelI(NEA_ModelLOD *lod, int level, const NEA_Model *mesh,
+                          int32_t distance)
+{
+    NEA_AssertPointer(lod, "NULL LOD pointer");
+    NEA_AssertMinMax(0, level, NEA_MODEL_LOD_MAX_LEVELS - 1,
+                     "Invalid level %d", level);
+
+    if (level > lod->num_levels)
+    {
+        NEA_DebugPrint("Levels must be set in order");
+        return 0;
+    }
+
+    if (mesh == NULL)
+    {
+        if (level != 0)
+        {
+            NEA_DebugPrint("Only level 0 can use the base model");
+            return 0;
+        }
+        mesh = lod->model;
+    }
+
+    if (mesh->modeltype != lod->model->modeltype)
+    {
+        NEA_DebugPrint("Mesh type doesn't match the base model");
+        return 0;
+    }
+
+    if ((mesh->meshindex == NEA_NO_MESH) && (mesh->multi == NULL))
+    {
+        NEA_DebugPrint("Model doesn't have a mesh");
+        return 0;
+    }
+
+    if (distance < 0)
+    {
+        NEA_DebugPrint("Invalid distance");
+        return 0;
+    }
+
+    if (level > 0)
+    {
+        int32_t prev = lod->distance[level - 1];
+
+        if ((prev == 0) || ((distance != 0) && (distance <= prev)))
+        {
+            NEA_DebugPrint("Distance must be higher than the previous level");
+            return 0;
+        }
+    }
+
+    lod->level[level] = mesh;
+    lod->distance[level] = distance;
+
+    // Setting a level removes the ones after it
+    lod->num_levels = level + 1;
+
+    return 1;
+}
+
+int NEA_ModelLODSelect(const NEA_ModelLOD *lod)
+{
+    NEA_AssertPointer(lod, "NULL pointer");
+
+    // Compare squared distances to avoid the square root
+    int64_t dist2;
+    if (!ne_model_camera_dist2(lod->model, &dist2))
+        return 0;
+
+    // The budget governor makes the simpler levels start closer. Weak
+    // reference: it's only linked if the user uses it.
+    extern int32_t NEA_BudgetGetLODScale(void) __attribute__((weak));
+    int32_t scale = NEA_BudgetGetLODScale ? NEA_BudgetGetLODScale()
+                                          : inttof32(1);
+
+    for (int i = 0; i < lod->num_levels; i++)
+    {
+        if (lod->distance[i] == 0)
+            return i;
+
+        int64_t d = mulf32(lod->distance[i], scale);
+
+        if (dist2 <= d * d)
+            return i;
+    }
+
+    return -1;
+}
+
+void NEA_ModelLODDraw(NEA_ModelLOD *lod)
+{
+    NEA_AssertPointer(lod, "NULL pointer");
+
+    int level = NEA_ModelLODSelect(lod);
+
+    lod->last_level = level;
+
+    if (level < 0)
+        return;
+
+    const NEA_Model *mesh = lod->level[level];
+
+    if (mesh == lod->model)
+    {
+        NEA_ModelDraw(lod->model);
+        return;
+    }
+
+    // Draw a copy of the base model that uses the mesh of the selected level.
+    // The transformation, material and animation state are shared. Update the
+    // cached matrix first so that the copy doesn't have to build it.
+    ne_model_update_transform(lod->model);
+
+    NEA_Model tmp = *lod->model;
+
+    tmp.meshindex = mesh->meshindex;
+    tmp.multi = mesh->multi;
+    tmp.submesh_materials = mesh->submesh_materials;
+    for (int i = 0; i < 3; i++)
+        tmp.bound_center[i] = mesh->bound_center[i];
+    tmp.bound_radius = mesh->bound_radius;
+
+    NEA_ModelDraw(&tmp);
+}
+
+int NEA_ModelLODGetLevel(const NEA_ModelLOD *lod)
+{
+    NEA_AssertPointer(lod, "NULL pointer");
+
+    return lod->last_level;
+}
@@ -0,0 +1,344 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAPack.c
+
+#define NEA_PACK_MAGIC   0x4B50454E // "NEPK"
+#define NEA_PACK_VERSION 1
+
+// Format of the packs generated by neapack. All values are little endian. The
+// header is followed by the directory, sorted by hash, and by the table of
+// paths. The data of the files starts after them.
+typedef struct {
+    u32 magic;
+    u16 version;
+    u16 alignment;
+    u32 num_entries;
+    u32 names_size;
+} ne_pack_header_t;
+
+typedef struct {
+    u32 hash;        // Hash of the normalized path
+    u32 offset;      // Offset of the data from the start of the pack
+    u32 size;        // Size of the data
+    u32 name_offset; // Offset of the path in the table of paths
+} ne_pack_entry_t;
+
+static NEA_Pack *ne_pack_mounted[NEA_PACK_MAX_MOUNTED];
+
+// Internal use... see NEAFAT.c
+int ne_fat_stream_check_compression(NEA_FATStream *stream);
+char *ne_fat_stream_load(NEA_FATStream *stream);
+
+// Internal use... see NEACache.c. Removes the parts of a path that don't
+// identify a file inside a pack.
+const char *ne_pack_normalize(const char *path)
+{
+    if (strncmp(path, "nitro:", 6) == 0)
+        path += 6;
+
+    while (*path == '/')
+        path++;
+
+    return path;
+}
+
+// Internal use... see NEACache.c. FNV-1a hash of a normalized path. It must
+// match the one used by neapack.
+u32 ne_pack_hash(const char *path)
+{
+    u32 hash = 2166136261U;
+
+    while (*path != '\0')
+    {
+        hash ^= (u8)*path++;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+NEA_Pack *NEA_PackOpen(const char *path)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    NEA_Pack *pack = calloc(1, sizeof(NEA_Pack));
+    if (pack == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    pack->file = fopen(path, "rb");
+    if (pack->file == NULL)
+    {
+        NEA_DebugPrint("%s could't be opened", path);
+        free(pack);
+        return NULL;
+    }
+
+    if (fseek(pack->file, 0, SEEK_END) != 0)
+    {
+        NEA_DebugPrint("Failed to fseek: %s", path);
+        goto error;
+    }
+
+    long end = ftell(pack->file);
+    if (end < (long)sizeof(ne_pack_header_t))
+    {
+        NEA_DebugPrint("%s is too small", path);
+        goto error;
+    }
+
+    pack->size = end;
+    rewind(pack->file);
+
+    ne_pack_header_t header;
+    if (fread(&header, sizeof(header), 1, pack->file) != 1)
+    {
+        NEA_DebugPrint("Failed to read header of %s", path);
+        goto error;
+    }
+
+    if (header.magic != NEA_PACK_MAGIC)
+    {
+        NEA_DebugPrint("%s isn't a pack", path);
+        goto error;
+    }
+
+    if (header.version != NEA_PACK_VERSION)
+    {
+        NEA_DebugPrint("Unsupported pack version %d", header.version);
+        goto error;
+    }
+
+    // Check the sizes against the size of the file before multiplying or
+    // adding them so that they can't overflow.
+    size_t max_size = pack->size - sizeof(header);
+
+    if ((header.names_size == 0) ||
+        (header.num_entries > max_size / sizeof(ne_pack_entry_t)))
+    {
+        NEA_DebugPrint("Invalid directory size");
+        goto error;
+    }
+
+    size_t entries_size = header.num_entries * sizeof(ne_pack_entry_t);
+
+    if (header.names_size > max_size - entries_size)
+    {
+        NEA_DebugPrint("Invalid directory size");
+        goto error;
+    }
+
+    size_t dir_size = entries_size + header.names_size;
+
+    // The directory and the table of paths are loaded in one block
+    u8 *dir = malloc(dir_size);
+    if (dir == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for the directory");
+        goto error;
+    }
+
+    if (fread(dir, 1, dir_size, pack->file) != dir_size)
+    {
+        NEA_DebugPrint("Failed to read directory of %s", path);
+        free(dir);
+        goto error;
+    }
+
+    const ne_pack_entry_t *entries = (const ne_pack_entry_t *)dir;
+    const char *names = (const char *)(dir + entries_size);
+
+    if (names[header.names_size - 1] != '\0')
+    {
+        NEA_DebugPrint("Invalid table of paths");
+        free(dir);
+        goto error;
+    }
+
+    for (u32 i = 0; i < header.num_entries; i++)
+    {
+        const ne_pack_entry_t *e = &entries[i];
+
+        if ((e->name_offset >= header.names_size) ||
+            (e->offset > pack->size) || (e->size > pack->size - e->offset))
+        {
+            NEA_DebugPrint("Invalid entry %u", (unsigned int)i);
+            free(dir);
+            goto error;
+        }
+    }
+
+    pack->num_entries = header.num_entries;
+    pack->entries = entries;
+    pack->names = names;
+
+    return pack;
+
+error:
+    fclose(pack->file);
+    free(pack);
+    return NULL;
+}
+
+void NEA_PackClose(NEA_Pack *pack)
+{
+    NEA_AssertPointer(pack, "NULL pointer");
+
+    NEA_PackUnmount(pack);
+
+    fclose(pack->file);
+    // The table of paths is part of the same allocation
+    free((void *)pack->entries);
+    free(pack);
+}
+
+int NEA_PackMount(NEA_Pack *pack)
+{
+    NEA_AssertPointer(pack, "NULL pointer");
+
+    NEA_PackUnmount(pack);
+
+    if (ne_pack_mounted[NEA_PACK_MAX_MOUNTED - 1] != NULL)
+    {
+        NEA_DebugPrint("Too many mounted packs");
+        return 0;
+    }
+
+    // Keep the most recently mounted pack at the start of the list
+    for (int i = NEA_PACK_MAX_MOUNTED - 1; i > 0; i--)
+        ne_pack_mounted[i] = ne_pack_mounted[i - 1];
+
+    ne_pack_mounted[0] = pack;
+
+    return 1;
+}
+
+void NEA_PackUnmount(NEA_Pack *pack)
+{
+    NEA_AssertPointer(pack, "NULL pointer");
+
+    for (int i = 0; i < NEA_PACK_MAX_MOUNTED; i++)
+    {
+        if (ne_pack_mounted[i] != pack)
+            continue;
+
+        for (int j = i; j < NEA_PACK_MAX_MOUNTED - 1; j++)
+            ne_pack_mounted[j] = ne_pack_mounted[j + 1];
+
+        ne_pack_mounted[NEA_PACK_MAX_MOUNTED - 1] = NULL;
+        return;
+    }
+}
+
+int NEA_PackFind(const NEA_Pack *pack, const char *path)
+{
+    NEA_AssertPointer(pack, "NULL pack pointer");
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    path = ne_pack_normalize(path);
+
+    const ne_pack_entry_t *entries = pack->entries;
+    u32 hash = ne_pack_hash(path);
+
+    // Look for the first entry with this hash
+    u32 low = 0;
+    u32 high = pack->num_entries;
+
+    while (low < high)
+    {
+        u32 mid = (low + high) / 2;
+
+        if (entries[mid].hash < hash)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    // Different paths may have the same hash
+    for (u32 i = low; (i < pack->num_entries) && (entries[i].hash == hash); i++)
+    {
+        if (strcmp(pack->names + entries[i].name_offset, path) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+size_t NEA_PackFileSize(NEA_Pack *pack, const char *path)
+{
+    // Compressed files have to be opened to read their size
+    NEA_FATStream *stream = NEA_PackStreamOpen(pack, path);
+    if (stream == NULL)
+        return -1;
+
+    size_t size = stream->size;
+    NEA_FATStreamClose(stream);
+    return size;
+}
+
+char *NEA_PackLoadData(NEA_Pack *pack, const char *path)
+{
+    NEA_FATStream *stream = NEA_PackStreamOpen(pack, path);
+    if (stream == NULL)
+        return NULL;
+
+    return ne_fat_stream_load(stream);
+}
+
+NEA_FATStream *NEA_PackStreamOpen(NEA_Pack *pack, const char *path)
+{
+    int index = NEA_PackFind(pack, path);
+    if (index < 0)
+    {
+        NEA_DebugPrint("%s not found in pack", path);
+        return NULL;
+    }
+
+    const ne_pack_entry_t *e = &((const ne_pack_entry_t *)pack->entries)[index];
+
+    NEA_FATStream *stream = malloc(sizeof(NEA_FATStream));
+    if (stream == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    stream->file = pack->file;
+    stream->size = e->size;
+    stream->offset = e->offset;
+    stream->position = 0;
+    stream->shared = true;
+
+    if (!ne_fat_stream_check_compression(stream))
+    {
+        free(stream);
+        return NULL;
+    }
+
+    return stream;
+}
+
+// Internal use... see NEAFAT.c. Returns the most recently mounted pack that
+// contains the file, or NULL if no mounted pack contains it.
+NEA_Pack *ne_pack_find_mounted(const char *path)
+{
+    for (int i = 0; i < NEA_PACK_MAX_MOUNTED; i++)
+    {
+        NEA_Pack *pack = ne_pack_mounted[i];
+        if (pack == NULL)
+            break;
+
+        if (NEA_PackFind(pack, path) >= 0)
+            return pack;
+    }
+
+    return NULL;
+}
@@ -6,21 +6,42 @@
 
 #include "NEAMain.h"
 #include "NEAAlloc.h"
+#include "NEAPool.h"
 
 /// @file NEAPalette.c
 
 typedef struct {
     u16 *pointer;
     int format;
+    bool upload_pending; // The data is still in the upload queue
+    int uses;            // Number of palette objects that use this slot
+    size_t size;         // Size of the data in bytes
+    u32 hash;            // Hash of the data, if it can be shared
+    bool shareable;      // False if the data may differ from the hash
 } ne_palinfo_t;
 
 static ne_palinfo_t *NEA_PalInfo = NULL;
 static NEA_Palette **NEA_UserPalette = NULL;
 
+#ifdef NEA_STATIC_POOLS
+static ne_palinfo_t ne_palinfo_static[NEA_STATIC_MAX_PALETTES];
+static NEA_Palette *ne_user_palette_static[NEA_STATIC_MAX_PALETTES];
+static NEA_Palette ne_palette_static[NEA_STATIC_MAX_PALETTES];
+#endif
+
 static NEAChunk *NEA_PalAllocList; // See NEAAlloc.h
 
 static bool ne_palette_system_inited = false;
 
+static bool ne_palette_sharing = true;
+
+// A palette has been deleted since the memory was fully defragmented
+static bool ne_palette_defrag_pending = false;
+
+// Palette being modified with NEA_PaletteModificationStart()
+static u16 *palette_adress = NULL;
+static int palette_format;
+
 static int NEA_MAX_PALETTES;
 
 // Which VRAM bank(s) back the palette allocator (snapshot from NEA_GetTexPaletteBank)
@@ -28,8 +49,32 @@ static NEA_VRAMBankFlags ne_pal_banks;
 // LCD-mode base address of the palette VRAM region (for GFX_PAL_FORMAT offset calc)
 static uintptr_t ne_pal_lcd_base;
 
-// Switch palette bank(s) to LCD mode (enables CPU writes)
-static void ne_pal_to_lcd(void)
+typedef struct {
+    int index;   // Index of the palette in NEA_PalInfo
+    int first;   // First color to write
+    int offset;  // Position of the colors in the staging buffer
+    int count;   // Number of colors
+} ne_pal_queue_range_t;
+
+// Colors waiting to be written to VRAM by NEA_PaletteQueueUpdate()
+static u16 ne_pal_queue_colors[NEA_PALETTE_QUEUE_COLORS];
+static int ne_pal_queue_used;
+static ne_pal_queue_range_t ne_pal_queue[NEA_PALETTE_QUEUE_RANGES];
+static int ne_pal_queue_count;
+
+// Internal use... see NEAMemReport.c
+void ne_mem_report_failure(NEA_MemPool pool, size_t size);
+
+// Internal use... see NEAUpload.c
+int ne_upload_add(bool palette, void *dst, const void *src, size_t size,
+                  bool set_alpha, bool *pending,
+                  NEA_UploadCallback callback, void *arg);
+void ne_upload_cancel(const void *dst);
+void ne_upload_cancel_all(bool palette);
+
+// Switch palette bank(s) to LCD mode (enables CPU writes). Internal use... see
+// NEAUpload.c as well.
+void ne_pal_to_lcd(void)
 {
     if (ne_pal_banks & NEA_VRAM_E)
         vramSetBankE(VRAM_E_LCD);
@@ -40,7 +85,7 @@ static void ne_pal_to_lcd(void)
 }
 
 // Switch palette bank(s) back to TEX_PALETTE mode
-static void ne_pal_to_tex(void)
+void ne_pal_to_tex(void)
 {
     if (ne_pal_banks & NEA_VRAM_E)
         vramSetBankE(VRAM_E_TEX_PALETTE);
@@ -103,7 +148,11 @@ NEA_Palette *NEA_PaletteCreate(void)
         if (NEA_UserPalette[i] != NULL)
             continue;
 
+#ifdef NEA_STATIC_POOLS
+        NEA_Palette *ptr = &ne_palette_static[i];
+#else
         NEA_Palette *ptr = malloc(sizeof(NEA_Palette));
+#endif
         if (ptr == NULL)
         {
             NEA_DebugPrint("Not enough memory");
@@ -143,8 +192,91 @@ int NEA_PaletteLoadFAT(NEA_Palette *pal, const char *path, NEA_TextureFormat for
     return ret;
 }
 
-int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
-                   NEA_TextureFormat format)
+// FNV-1a hash of the palette data
+static u32 ne_palette_hash(const void *data, size_t size)
+{
+    const u8 *p = data;
+    u32 hash = 2166136261U;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+// Returns the slot of a loaded palette with the same data and format, or
+// NEA_NO_PALETTE if there isn't any.
+static int ne_palette_find_shared(const void *data, size_t size, u32 hash,
+                                  int format)
+{
+    for (int i = 0; i < NEA_MAX_PALETTES; i++)
+    {
+        ne_palinfo_t *info = &NEA_PalInfo[i];
+
+        // The VRAM of palettes in the upload queue doesn't have the data yet
+        if ((info->pointer == NULL) || !info->shareable || info->upload_pending)
+            continue;
+
+        if ((info->hash != hash) || (info->size != size) ||
+            (info->format != format))
+            continue;
+
+        // Make sure that it isn't a hash collision
+        ne_pal_to_lcd();
+        int diff = memcmp(info->pointer, data, size);
+        ne_pal_to_tex();
+
+        if (diff == 0)
+            return i;
+    }
+
+    return NEA_NO_PALETTE;
+}
+
+// Releases the reference of a palette object to its data. The VRAM is freed
+// when no other palette object uses it.
+static void ne_palette_release(NEA_Palette *pal)
+{
+    if (pal->index == NEA_NO_PALETTE)
+        return;
+
+    ne_palinfo_t *info = &NEA_PalInfo[pal->index];
+
+    pal->index = NEA_NO_PALETTE;
+
+    info->uses--;
+    if (info->uses > 0)
+        return;
+
+    if (info->upload_pending)
+        ne_upload_cancel(info->pointer);
+
+    // Remove the queued colors of the palette. The staging buffer is only
+    // reclaimed when the queue is emptied.
+    int count = 0;
+    for (int i = 0; i < ne_pal_queue_count; i++)
+    {
+        if (&NEA_PalInfo[ne_pal_queue[i].index] == info)
+            continue;
+        ne_pal_queue[count++] = ne_pal_queue[i];
+    }
+    ne_pal_queue_count = count;
+    if (count == 0)
+        ne_pal_queue_used = 0;
+
+    NEA_Free(NEA_PalAllocList, (void *)info->pointer);
+    info->pointer = NULL;
+    info->upload_pending = false;
+
+    ne_palette_defrag_pending = true;
+}
+
+static int ne_palette_load(NEA_Palette *pal, const void *pointer, u16 numcolor,
+                           NEA_TextureFormat format, bool async,
+                           NEA_UploadCallback callback, void *arg)
 {
     if (!ne_palette_system_inited)
         return 0;
@@ -154,7 +286,28 @@ int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
     if (pal->index != NEA_NO_PALETTE)
     {
         NEA_DebugPrint("Palette already loaded");
-        NEA_PaletteDelete(pal);
+        ne_palette_release(pal);
+    }
+
+    size_t size = (numcolor / 2) * 4;
+    u32 hash = 0;
+
+    if (ne_palette_sharing)
+    {
+        hash = ne_palette_hash(pointer, size);
+
+        int shared = ne_palette_find_shared(pointer, size, hash, format);
+        if (shared != NEA_NO_PALETTE)
+        {
+            NEA_PalInfo[shared].uses++;
+            pal->index = shared;
+
+            // There is nothing to copy
+            if (callback)
+                callback(arg);
+
+            return 1;
+        }
     }
 
     int slot = NEA_NO_PALETTE;
@@ -176,13 +329,43 @@ int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
 
     NEA_PalInfo[slot].pointer = NEA_Alloc(NEA_PalAllocList, numcolor << 1);
     // Aligned to 16 bytes (except 8 bytes for NEA_PAL4).
+
+    // There may be enough free memory, but not in one single gap
+    if ((NEA_PalInfo[slot].pointer == NULL) &&
+        ((size_t)NEA_PaletteFreeMem() >= (size_t)(numcolor << 1)))
+    {
+        NEA_PaletteDefragMem();
+        NEA_PalInfo[slot].pointer = NEA_Alloc(NEA_PalAllocList, numcolor << 1);
+    }
+
     if (NEA_PalInfo[slot].pointer == NULL)
     {
         NEA_DebugPrint("Not enough memory");
+        ne_mem_report_failure(NEA_MEM_POOL_PALETTE, numcolor << 1);
         return 0;
     }
 
     NEA_PalInfo[slot].format = format;
+    NEA_PalInfo[slot].uses = 1;
+    NEA_PalInfo[slot].size = size;
+    NEA_PalInfo[slot].hash = hash;
+    NEA_PalInfo[slot].shareable = ne_palette_sharing;
+
+    if (async)
+    {
+        if (ne_upload_add(true, NEA_PalInfo[slot].pointer, pointer,
+                          size, false,
+                          &NEA_PalInfo[slot].upload_pending,
+                          callback, arg) != 0)
+        {
+            NEA_Free(NEA_PalAllocList, NEA_PalInfo[slot].pointer);
+            NEA_PalInfo[slot].pointer = NULL;
+            return 0;
+        }
+
+        pal->index = slot;
+        return 1;
+    }
 
     pal->index = slot;
 
@@ -194,6 +377,21 @@ int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
     return 1;
 }
 
+int NEA_PaletteLoad(NEA_Palette *pal, const void *pointer, u16 numcolor,
+                   NEA_TextureFormat format)
+{
+    return ne_palette_load(pal, pointer, numcolor, format, false, NULL, NULL);
+}
+
+int NEA_PaletteLoadAsync(NEA_Palette *pal, const void *pointer, u16 numcolor,
+                         NEA_TextureFormat format,
+                         NEA_UploadCallback callback, void *arg)
+{
+    NEA_AssertPointer(pointer, "NULL palette data pointer");
+
+    return ne_palette_load(pal, pointer, numcolor, format, true, callback, arg);
+}
+
 int NEA_PaletteLoadSize(NEA_Palette *pal, const void *pointer, size_t size,
                        NEA_TextureFormat format)
 {
@@ -207,19 +405,19 @@ void NEA_PaletteDelete(NEA_Palette *pal)
 
     NEA_AssertPointer(pal, "NULL pointer");
 
-    // If there is an asigned palette...
-    if (pal->index != NEA_NO_PALETTE)
-    {
-        NEA_Free(NEA_PalAllocList, (void *)NEA_PalInfo[pal->index].pointer);
-        NEA_PalInfo[pal->index].pointer = NULL;
-    }
+    NEA_LoaderCancel(pal);
+
+    // If there is an asigned palette, release it
+    ne_palette_release(pal);
 
     for (int i = 0; i < NEA_MAX_PALETTES; i++)
     {
         if (NEA_UserPalette[i] == pal)
         {
             NEA_UserPalette[i] = NULL;
+#ifndef NEA_STATIC_POOLS
             free(pal);
+#endif
             return;
         }
     }
@@ -227,13 +425,47 @@ void NEA_PaletteDelete(NEA_Palette *pal)
     NEA_DebugPrint("Material not found");
 }
 
-void NEA_PaletteUse(const NEA_Palette *pal)
+void NEA_PaletteSharing(bool enable)
+{
+    ne_palette_sharing = enable;
+}
+
+int NEA_PaletteGetUses(const NEA_Palette *pal)
+{
+    NEA_AssertPointer(pal, "NULL pointer");
+
+    if (pal->index == NEA_NO_PALETTE)
+        return 0;
+
+    return NEA_PalInfo[pal->index].uses;
+}
+
+// Internal use... see NEATexture.c
+void ne_material_state_pal_format(u32 value);
+
+// Internal use... see NEAGUI.c. Returns the value of the palette format
+// register used by a palette.
+u32 ne_palette_format(const NEA_Palette *pal)
 {
     NEA_AssertPointer(pal, "NULL pointer");
     NEA_Assert(pal->index != NEA_NO_PALETTE, "No asigned palette");
     unsigned int shift = 4 - (NEA_PalInfo[pal->index].format == NEA_PAL4);
-    GFX_PAL_FORMAT = ((uintptr_t)NEA_PalInfo[pal->index].pointer
-                      - ne_pal_lcd_base) >> shift;
+    return ((uintptr_t)NEA_PalInfo[pal->index].pointer - ne_pal_lcd_base)
+           >> shift;
+}
+
+// Internal use... see NEATexture.c. Returns false if the palette is still
+// waiting to be copied to VRAM.
+bool ne_palette_is_ready(const NEA_Palette *pal)
+{
+    NEA_AssertPointer(pal, "NULL pointer");
+    NEA_Assert(pal->index != NEA_NO_PALETTE, "No asigned palette");
+    return !NEA_PalInfo[pal->index].upload_pending;
+}
+
+void NEA_PaletteUse(const NEA_Palette *pal)
+{
+    ne_material_state_pal_format(ne_palette_format(pal));
 }
 
 int NEA_PaletteSystemReset(int max_palettes)
@@ -246,8 +478,14 @@ int NEA_PaletteSystemReset(int max_palettes)
     else
         NEA_MAX_PALETTES = max_palettes;
 
-    NEA_PalInfo = calloc(NEA_MAX_PALETTES, sizeof(ne_palinfo_t));
-    NEA_UserPalette = calloc(NEA_MAX_PALETTES, sizeof(NEA_UserPalette));
+    NEA_MAX_PALETTES = NE_STATIC_CAPACITY(NEA_MAX_PALETTES,
+                                          NEA_STATIC_MAX_PALETTES);
+
+    NEA_PalInfo = NE_STATIC_CALLOC(ne_palinfo_static, NEA_MAX_PALETTES,
+                                   sizeof(ne_palinfo_t));
+    NEA_UserPalette = NE_STATIC_CALLOC(ne_user_palette_static,
+                                       NEA_MAX_PALETTES,
+                                       sizeof(NEA_UserPalette));
     if ((NEA_PalInfo == NULL) || (NEA_UserPalette == NULL))
         goto cleanup;
 
@@ -259,7 +497,8 @@ int NEA_PaletteSystemReset(int max_palettes)
     {
         ne_pal_lcd_base = (uintptr_t)pal_start;
 
-        if (NEA_AllocInit(&NEA_PalAllocList, pal_start, pal_end) != 0)
+        if (NEA_AllocInitMode(&NEA_PalAllocList, pal_start, pal_end,
+                              NEA_ALLOC_SEGREGATED) != 0)
             goto cleanup;
     }
     else
@@ -270,15 +509,18 @@ int NEA_PaletteSystemReset(int max_palettes)
         NEA_PalAllocList = NULL;
     }
 
+    NEA_DisplayListWait();
+
     GFX_PAL_FORMAT = 0;
+    NEA_MaterialStateInvalidate();
 
     ne_palette_system_inited = true;
     return 0;
 
 cleanup:
     NEA_DebugPrint("Not enough memory");
-    free(NEA_PalInfo);
-    free(NEA_UserPalette);
+    NE_STATIC_FREE(ne_palinfo_static, NEA_PalInfo);
+    NE_STATIC_FREE(ne_user_palette_static, NEA_UserPalette);
     return -1;
 }
 
@@ -293,6 +535,23 @@ int NEA_PaletteFreeMem(void)
     return info.free;
 }
 
+int NEA_PaletteGetMemReport(NEA_MemReport *report)
+{
+    NEA_AssertPointer(report, "NULL pointer");
+
+    if (!ne_palette_system_inited || (NEA_PalAllocList == NULL))
+        return 0;
+
+    if (NEA_AllocGetReport(NEA_PalAllocList, report) != 0)
+        return 0;
+
+    // Only palettes are allocated here
+    report->owner[NEA_MEM_OWNER_PALETTE] = report->used;
+    report->owner[NEA_MEM_OWNER_OTHER] = 0;
+
+    return 1;
+}
+
 int NEA_PaletteFreeMemPercent(void)
 {
     if (!ne_palette_system_inited)
@@ -304,43 +563,131 @@ int NEA_PaletteFreeMemPercent(void)
     return info.free_percent;
 }
 
-void NEA_PaletteDefragMem(void)
+// Returns the palette that starts at the provided address, or NEA_NO_PALETTE
+// if there isn't any.
+static int ne_palette_find_by_address(const void *address)
 {
-    NEA_Assert(0, "This function doesn't work");
-    return;
-
-    // TODO: Fix
+    for (int i = 0; i < NEA_MAX_PALETTES; i++)
+    {
+        if (NEA_PalInfo[i].pointer == address)
+            return i;
+    }
 
-    /*
-    if (!ne_palette_system_inited)
-        return;
+    return NEA_NO_PALETTE;
+}
 
-    vramSetBankE(VRAM_E_LCD);
-    bool ok = false;
-    while (!ok)
+// Moves the lowest palette that has free space right before it to the start of
+// that free space. Palettes are allocated from the start of VRAM, so this joins
+// the free gaps at the end. Returns the number of bytes copied, or 0 if no
+// palette can be moved.
+static size_t ne_palette_defrag_one(void)
+{
+    for (NEAChunk *this = NEA_PalAllocList; this != NULL; this = this->next)
     {
-        ok = true;
-        for (int i = 0; i < NEA_MAX_PALETTES; i++)
+        NEAChunk *prev = this->previous;
+
+        if ((this->state != NEA_STATE_USED) || (prev == NULL) ||
+            (prev->state != NEA_STATE_FREE))
+            continue;
+
+        int index = ne_palette_find_by_address(this->start);
+        if (index == NEA_NO_PALETTE)
+            continue;
+
+        // The upload queue has the address of the palette
+        if (NEA_PalInfo[index].upload_pending)
+            continue;
+
+        // All chunks are multiples of NEA_ALLOC_MIN_SIZE, so the new address
+        // keeps the alignment of 16 bytes (8 bytes for NEA_PAL4) that the
+        // palette format register needs.
+        u32 *old_addr = this->start;
+        u32 *new_addr = prev->start;
+        size_t size = (uintptr_t)this->end - (uintptr_t)this->start;
+
+        // The free chunk is merged with this one, so the new allocation can't
+        // fail because of a lack of space.
+        NEA_Free(NEA_PalAllocList, old_addr);
+        if (NEA_AllocAddress(NEA_PalAllocList, new_addr, size) != 0)
         {
-            int size = NEA_GetSize(NEA_PalAllocList, (void*)NEA_PalInfo[i].pointer);
+            NEA_DebugPrint("Can't reallocate palette");
+            NEA_AllocAddress(NEA_PalAllocList, old_addr, size);
+            return 0;
+        }
+
+        // The destination is lower, so copying forwards is safe even if both
+        // ranges overlap.
+        for (size_t i = 0; i < size / 4; i++)
+            new_addr[i] = old_addr[i];
+
+        // Materials refer to the palette object, so they use the new address
+        // the next time they are used.
+        NEA_PalInfo[index].pointer = (u16 *)new_addr;
+
+        return size;
+    }
+
+    return 0;
+}
 
-            NEA_Free(NEA_PalAllocList, (void*)NEA_PalInfo[i].pointer);
-            void *pointer = NEA_Alloc(NEA_PalAllocList, size);
-            // Aligned to 16 bytes (except 8 bytes for NEA_PAL4).
+// If wait_vblank is true, it stops as soon as the 3D engine starts rendering,
+// because it needs to read the palettes.
+static size_t ne_palette_defrag(size_t max_bytes, bool wait_vblank)
+{
+    if (!ne_palette_system_inited)
+        return 0;
 
-            NEA_AssertPointer(pointer, "Couldn't reallocate palette");
+    if (!ne_palette_defrag_pending)
+        return 0;
 
-            if ((int)pointer != (int)NEA_PalInfo[i].pointer)
-            {
-                dmaCopy((void *)NEA_PalInfo[i].pointer, pointer, size);
+    // The address of the active palette can't change
+    if (palette_adress != NULL)
+        return 0;
 
-                NEA_PalInfo[i].pointer = (void*)pointer;
-                ok = false;
-            }
+    if (wait_vblank && NEA_GPUIsRendering())
+        return 0;
+
+    ne_pal_to_lcd();
+
+    size_t moved = 0;
+
+    while (moved < max_bytes)
+    {
+        if (wait_vblank && NEA_GPUIsRendering())
+            break;
+
+        size_t size = ne_palette_defrag_one();
+        if (size == 0)
+        {
+            // Nothing else can be moved until another palette is deleted
+            ne_palette_defrag_pending = false;
+            break;
         }
+
+        moved += size;
     }
-    vramSetBankE(VRAM_E_TEX_PALETTE);
-    */
+
+    ne_pal_to_tex();
+
+    if (moved > 0)
+    {
+        // The GUI keeps a copy of the palette format of its materials
+        extern void NEA_GUIInvalidate(void) __attribute__((weak));
+        if (NEA_GUIInvalidate)
+            NEA_GUIInvalidate();
+    }
+
+    return moved;
+}
+
+size_t NEA_PaletteDefragMemStep(size_t max_bytes)
+{
+    return ne_palette_defrag(max_bytes, true);
+}
+
+void NEA_PaletteDefragMem(void)
+{
+    ne_palette_defrag(SIZE_MAX, false);
 }
 
 void NEA_PaletteSystemEnd(void)
@@ -348,24 +695,28 @@ void NEA_PaletteSystemEnd(void)
     if (!ne_palette_system_inited)
         return;
 
+    ne_upload_cancel_all(true);
+
+    ne_pal_queue_count = 0;
+    ne_pal_queue_used = 0;
+
     NEA_AllocEnd(&NEA_PalAllocList);
 
-    free(NEA_PalInfo);
+    NE_STATIC_FREE(ne_palinfo_static, NEA_PalInfo);
 
+#ifndef NEA_STATIC_POOLS
     for (int i = 0; i < NEA_MAX_PALETTES; i++)
     {
         if (NEA_UserPalette[i])
             free(NEA_UserPalette[i]);
     }
+#endif
 
-    free(NEA_UserPalette);
+    NE_STATIC_FREE(ne_user_palette_static, NEA_UserPalette);
 
     ne_palette_system_inited = false;
 }
 
-static u16 *palette_adress = NULL;
-static int palette_format;
-
 void *NEA_PaletteModificationStart(const NEA_Palette *pal)
 {
     NEA_AssertPointer(pal, "NULL pointer");
@@ -375,6 +726,9 @@ void *NEA_PaletteModificationStart(const NEA_Palette *pal)
     palette_adress = NEA_PalInfo[pal->index].pointer;
     palette_format = NEA_PalInfo[pal->index].format;
 
+    // The data won't match the hash anymore
+    NEA_PalInfo[pal->index].shareable = false;
+
     // Enable CPU accesses to palette VRAM
     ne_pal_to_lcd();
 
@@ -398,3 +752,110 @@ void NEA_PaletteModificationEnd(void)
 
     palette_adress = NULL;
 }
+
+int NEA_PaletteQueueColors(const NEA_Palette *pal, int first,
+                           const u16 *colors, int count)
+{
+    NEA_AssertPointer(pal, "NULL pointer");
+    NEA_AssertPointer(colors, "NULL colors pointer");
+    NEA_Assert(pal->index != NEA_NO_PALETTE, "No asigned palette");
+
+    ne_palinfo_t *info = &NEA_PalInfo[pal->index];
+
+    if ((first < 0) || (count < 0) ||
+        ((size_t)(first + count) > info->size / 2))
+    {
+        NEA_DebugPrint("Colors out of the palette");
+        return 0;
+    }
+
+    if (count == 0)
+        return 1;
+
+    if (ne_pal_queue_used + count > NEA_PALETTE_QUEUE_COLORS)
+    {
+        NEA_DebugPrint("Palette queue full");
+        return 0;
+    }
+
+    // Extend the last range if the new colors follow it
+    ne_pal_queue_range_t *range = NULL;
+    if (ne_pal_queue_count > 0)
+    {
+        ne_pal_queue_range_t *last = &ne_pal_queue[ne_pal_queue_count - 1];
+        if ((last->index == pal->index) &&
+            (last->first + last->count == first) &&
+            (last->offset + last->count == ne_pal_queue_used))
+            range = last;
+    }
+
+    if (range == NULL)
+    {
+        if (ne_pal_queue_count == NEA_PALETTE_QUEUE_RANGES)
+        {
+            NEA_DebugPrint("Palette queue full");
+            return 0;
+        }
+
+        range = &ne_pal_queue[ne_pal_queue_count++];
+        range->index = pal->index;
+        range->first = first;
+        range->offset = ne_pal_queue_used;
+        range->count = 0;
+    }
+
+    memcpy(&ne_pal_queue_colors[ne_pal_queue_used], colors, count * 2);
+    ne_pal_queue_used += count;
+    range->count += count;
+
+    // The data won't match the hash anymore
+    info->shareable = false;
+
+    return 1;
+}
+
+int NEA_PaletteQueueSetColor(const NEA_Palette *pal, int index, u16 color)
+{
+    return NEA_PaletteQueueColors(pal, index, &color, 1);
+}
+
+int NEA_PaletteQueueUpdate(void)
+{
+    if (ne_pal_queue_count == 0)
+        return 0;
+
+    if (NEA_GPUIsRendering())
+        return 0;
+
+    DC_FlushRange(ne_pal_queue_colors, ne_pal_queue_used * 2);
+
+    ne_pal_to_lcd();
+
+    int written = 0;
+    int count = 0;
+
+    for (int i = 0; i < ne_pal_queue_count; i++)
+    {
+        ne_pal_queue_range_t *range = &ne_pal_queue[i];
+        ne_palinfo_t *info = &NEA_PalInfo[range->index];
+
+        // The upload of the palette would overwrite the colors
+        if (info->upload_pending)
+        {
+            ne_pal_queue[count++] = *range;
+            continue;
+        }
+
+        dmaCopyHalfWords(3, &ne_pal_queue_colors[range->offset],
+                         info->pointer + range->first, range->count * 2);
+        written += range->count;
+    }
+
+    ne_pal_to_tex();
+
+    ne_pal_queue_count = count;
+    if (count == 0)
+        ne_pal_queue_used = 0;
+
+    return written;
+}
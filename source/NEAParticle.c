@@ -0,0 +1,419 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEATCM.h"
+
+/// @file NEAParticle.c
+
+// Vertices are sent with this shift and the matrix is scaled up to compensate,
+// so that particles can be sent with GFX_VERTEX16 further away from the origin.
+#define NEA_PARTICLE_SHIFT 4
+
+static NEA_ParticlePool **ne_particle_pools = NULL;
+static int ne_particle_max_pools;
+static bool ne_particle_system_inited = false;
+
+// Internal use... see NEACamera.c
+bool ne_camera_active_axes(int32_t *right, int32_t *up);
+
+// Internal use... see NEATexture.c
+void ne_material_state_poly_format(u32 value);
+
+NEA_ParticlePool *NEA_ParticlePoolCreate(int max_particles)
+{
+    if (!ne_particle_system_inited)
+    {
+        NEA_DebugPrint("System not initialized");
+        return NULL;
+    }
+
+    NEA_AssertMinMax(1, max_particles, 0xFFFF, "Invalid number of particles %d",
+                     max_particles);
+
+    for (int i = 0; i < ne_particle_max_pools; i++)
+    {
+        if (ne_particle_pools[i] != NULL)
+            continue;
+
+        NEA_ParticlePool *pool = calloc(1, sizeof(NEA_ParticlePool));
+        if (pool == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return NULL;
+        }
+
+        pool->particles = calloc(max_particles, sizeof(NEA_Particle));
+        if (pool->particles == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            free(pool);
+            return NULL;
+        }
+
+        pool->max_particles = max_particles;
+        pool->size_start = inttof32(1) / 4;
+        pool->size_end = inttof32(1) / 4;
+        pool->color_start = NEA_White;
+        pool->color_end = NEA_White;
+        pool->visible = true;
+        pool->alpha = 31;
+
+        ne_particle_pools[i] = pool;
+
+        return pool;
+    }
+
+    NEA_DebugPrint("No free slots");
+    return NULL;
+}
+
+void NEA_ParticlePoolDelete(NEA_ParticlePool *pool)
+{
+    if (!ne_particle_system_inited)
+        return;
+
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    for (int i = 0; i < ne_particle_max_pools; i++)
+    {
+        if (ne_particle_pools[i] != pool)
+            continue;
+
+        ne_particle_pools[i] = NULL;
+        free(pool->particles);
+        free(pool);
+
+        return;
+    }
+
+    NEA_DebugPrint("Object not found");
+}
+
+void NEA_ParticlePoolDeleteAll(void)
+{
+    if (!ne_particle_system_inited)
+        return;
+
+    for (int i = 0; i < ne_particle_max_pools; i++)
+    {
+        if (ne_particle_pools[i] != NULL)
+            NEA_ParticlePoolDelete(ne_particle_pools[i]);
+    }
+}
+
+void NEA_ParticlePoolSetMaterial(NEA_ParticlePool *pool, NEA_Material *mat)
+{
+    NEA_AssertPointer(pool, "NULL pool pointer");
+    NEA_AssertPointer(mat, "NULL material pointer");
+
+    pool->mat = mat;
+
+    pool->tl = 0;
+    pool->tr = NEA_TextureGetSizeX(mat);
+    pool->tt = 0;
+    pool->tb = NEA_TextureGetSizeY(mat);
+}
+
+void NEA_ParticlePoolSetMaterialCanvas(NEA_ParticlePool *pool,
+                                       int tl, int tt, int tr, int tb)
+{
+    NEA_AssertPointer(pool, "NULL pool pointer");
+    NEA_AssertPointer(pool->mat, "Pool doesn't have a material");
+
+    pool->tl = tl;
+    pool->tr = tr;
+    pool->tt = tt;
+    pool->tb = tb;
+}
+
+void NEA_ParticlePoolSetCoordI(NEA_ParticlePool *pool,
+                               int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->x = x;
+    pool->y = y;
+    pool->z = z;
+}
+
+void NEA_ParticlePoolSetGravityI(NEA_ParticlePool *pool,
+                                 int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->gx = x;
+    pool->gy = y;
+    pool->gz = z;
+}
+
+void NEA_ParticlePoolSetSizeI(NEA_ParticlePool *pool,
+                              int32_t start, int32_t end)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->size_start = start;
+    pool->size_end = end;
+}
+
+void NEA_ParticlePoolSetColors(NEA_ParticlePool *pool, u32 start, u32 end)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->color_start = start;
+    pool->color_end = end;
+}
+
+void NEA_ParticlePoolSetParams(NEA_ParticlePool *pool, u8 alpha, u8 id)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    NEA_AssertMinMax(0, alpha, 31, "Invalid alpha value %d", alpha);
+    NEA_AssertMinMax(0, id, 63, "Invalid polygon ID %d", id);
+
+    pool->alpha = alpha;
+    pool->id = id;
+}
+
+void NEA_ParticlePoolVisible(NEA_ParticlePool *pool, bool visible)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->visible = visible;
+}
+
+int NEA_ParticleEmitI(NEA_ParticlePool *pool, int32_t x, int32_t y, int32_t z,
+                      int32_t vx, int32_t vy, int32_t vz, int frames)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    if (frames < 1)
+    {
+        NEA_DebugPrint("Invalid lifetime %d", frames);
+        return 0;
+    }
+
+    if (pool->num_particles == pool->max_particles)
+        return 0;
+
+    NEA_Particle *p = &pool->particles[pool->num_particles++];
+
+    p->x = x;
+    p->y = y;
+    p->z = z;
+    p->vx = vx;
+    p->vy = vy;
+    p->vz = vz;
+    p->age = 0;
+    // Round up so that the particle never lives longer than requested
+    p->age_step = (inttof32(1) + frames - 1) / frames;
+
+    return 1;
+}
+
+int NEA_ParticlePoolGetCount(const NEA_ParticlePool *pool)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    return pool->num_particles;
+}
+
+void NEA_ParticlePoolClear(NEA_ParticlePool *pool)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    pool->num_particles = 0;
+}
+
+NEA_HOT_CODE void NEA_ParticlePoolUpdate(NEA_ParticlePool *pool)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    NEA_Particle *p = pool->particles;
+    int count = pool->num_particles;
+
+    int32_t gx = pool->gx;
+    int32_t gy = pool->gy;
+    int32_t gz = pool->gz;
+
+    int i = 0;
+    while (i < count)
+    {
+        NEA_Particle *cur = &p[i];
+
+        cur->age += cur->age_step;
+        if (cur->age >= inttof32(1))
+        {
+            // The order doesn't matter, replace it by the last one
+            count--;
+            *cur = p[count];
+            continue;
+        }
+
+        cur->vx += gx;
+        cur->vy += gy;
+        cur->vz += gz;
+
+        cur->x += cur->vx;
+        cur->y += cur->vy;
+        cur->z += cur->vz;
+
+        i++;
+    }
+
+    pool->num_particles = count;
+}
+
+void NEA_ParticleUpdateAll(void)
+{
+    if (!ne_particle_system_inited)
+        return;
+
+    for (int i = 0; i < ne_particle_max_pools; i++)
+    {
+        if (ne_particle_pools[i] != NULL)
+            NEA_ParticlePoolUpdate(ne_particle_pools[i]);
+    }
+}
+
+static inline void ne_particle_vertex(u32 texcoord,
+                                      int32_t x, int32_t y, int32_t z)
+{
+    x >>= NEA_PARTICLE_SHIFT;
+    y >>= NEA_PARTICLE_SHIFT;
+    z >>= NEA_PARTICLE_SHIFT;
+
+    GFX_TEX_COORD = texcoord;
+    GFX_VERTEX16 = (y << 16) | (x & 0xFFFF);
+    GFX_VERTEX16 = z & 0xFFFF;
+}
+
+ARM_CODE void NEA_ParticlePoolDraw(const NEA_ParticlePool *pool)
+{
+    NEA_DisplayListWait();
+
+    if (!ne_particle_system_inited)
+        return;
+
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    if (!pool->visible || (pool->num_particles == 0))
+        return;
+
+    if (pool->mat == NULL)
+    {
+        NEA_DebugPrint("Pool doesn't have a material");
+        return;
+    }
+
+    int32_t right[3] = { inttof32(1), 0, 0 };
+    int32_t up[3] = { 0, inttof32(1), 0 };
+    ne_camera_active_axes(right, up);
+
+    // Diagonals of a quad with a half size of 1 that faces the camera
+    int32_t diag_a[3], diag_b[3];
+    for (int i = 0; i < 3; i++)
+    {
+        diag_a[i] = right[i] + up[i];
+        diag_b[i] = right[i] - up[i];
+    }
+
+    // Same texture coordinates as NEA_2DDrawTexturedQuadColorCanvas()
+    u32 tex_ul = TEXTURE_PACK(inttot16(pool->tl), inttot16(pool->tt));
+    u32 tex_dl = TEXTURE_PACK(inttot16(pool->tl), inttot16(pool->tb));
+    u32 tex_dr = TEXTURE_PACK(inttot16(pool->tr), inttot16(pool->tb));
+    u32 tex_ur = TEXTURE_PACK(inttot16(pool->tr), inttot16(pool->tt));
+
+    int r0 = pool->color_start & 0x1F;
+    int g0 = (pool->color_start >> 5) & 0x1F;
+    int b0 = (pool->color_start >> 10) & 0x1F;
+    int dr = (int)(pool->color_end & 0x1F) - r0;
+    int dg = (int)((pool->color_end >> 5) & 0x1F) - g0;
+    int db = (int)((pool->color_end >> 10) & 0x1F) - b0;
+
+    int32_t size0 = pool->size_start;
+    int32_t dsize = pool->size_end - size0;
+
+    MATRIX_PUSH = 0;
+
+    NEA_ViewMoveI(pool->x, pool->y, pool->z);
+
+    MATRIX_SCALE = inttof32(1 << NEA_PARTICLE_SHIFT);
+    MATRIX_SCALE = inttof32(1 << NEA_PARTICLE_SHIFT);
+    MATRIX_SCALE = inttof32(1 << NEA_PARTICLE_SHIFT);
+
+    ne_material_state_poly_format(POLY_ALPHA(pool->alpha) | POLY_ID(pool->id) |
+                                  NEA_CULL_NONE);
+
+    NEA_MaterialUse(pool->mat);
+
+    GFX_BEGIN = GL_QUADS;
+
+    const NEA_Particle *p = pool->particles;
+
+    for (int i = 0; i < pool->num_particles; i++, p++)
+    {
+        int32_t t = p->age;
+
+        GFX_COLOR = RGB15(r0 + ((dr * t) >> 12), g0 + ((dg * t) >> 12),
+                          b0 + ((db * t) >> 12));
+
+        int32_t size = size0 + mulf32(dsize, t);
+
+        int32_t ax = mulf32(diag_a[0], size);
+        int32_t ay = mulf32(diag_a[1], size);
+        int32_t az = mulf32(diag_a[2], size);
+        int32_t bx = mulf32(diag_b[0], size);
+        int32_t by = mulf32(diag_b[1], size);
+        int32_t bz = mulf32(diag_b[2], size);
+
+        ne_particle_vertex(tex_ul, p->x - bx, p->y - by, p->z - bz); // Up-left
+        ne_particle_vertex(tex_dl, p->x - ax, p->y - ay, p->z - az); // Down-left
+        ne_particle_vertex(tex_dr, p->x + bx, p->y + by, p->z + bz); // Down-right
+        ne_particle_vertex(tex_ur, p->x + ax, p->y + ay, p->z + az); // Up-right
+    }
+
+    MATRIX_POP = 1;
+}
+
+void NEA_ParticleDrawAll(void)
+{
+    if (!ne_particle_system_inited)
+        return;
+
+    for (int i = 0; i < ne_particle_max_pools; i++)
+    {
+        if (ne_particle_pools[i] != NULL)
+            NEA_ParticlePoolDraw(ne_particle_pools[i]);
+    }
+}
+
+int NEA_ParticleSystemReset(int max_pools)
+{
+    if (ne_particle_system_inited)
+        NEA_ParticleSystemEnd();
+
+    if (max_pools < 1)
+        ne_particle_max_pools = NEA_DEFAULT_PARTICLE_POOLS;
+    else
+        ne_particle_max_pools = max_pools;
+
+    ne_particle_pools = calloc(ne_particle_max_pools,
+                               sizeof(NEA_ParticlePool *));
+    if (ne_particle_pools == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return -1;
+    }
+
+    ne_particle_system_inited = true;
+    return 0;
+}
+
+void NEA_ParticleSystemEnd(void)
+{
+    if (!ne_particle_system_inited)
+        return;
+
+    NEA_ParticlePoolDeleteAll();
+
+    free(ne_particle_pools);
+    ne_particle_pools = NULL;
+
+    ne_particle_system_inited = false;
+}
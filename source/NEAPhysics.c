@@ -6,14 +6,63 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAPool.h"
+#include "NEATCM.h"
 
 /// @file NEAPhysics.c
 
-static NEA_Physics **NEA_PhysicsPointers;
 static bool ne_physics_system_inited = false;
 
+// All objects are stored in one array, so that NEA_PhysicsUpdateAll() reads
+// them from consecutive addresses. The object of a slot is always at the same
+// index of the array. The slots in use are tracked by a pool.
+static NEA_Physics *ne_physics_pool;
+static ne_pool_t ne_physics_slots;
+
+// Sleeping state of the objects, indexed by slot. Objects that have stayed
+// close to the same position for NEA_PHYSICS_SLEEP_TIME frames are put to
+// sleep with all the objects they touch (their island), and they are skipped
+// by NEA_PhysicsUpdateAll() until something wakes them up.
+typedef struct {
+    NEA_Vec3 anchor;   // Position where the object stopped moving
+    int island;        // Island of a sleeping object
+    uint16_t frames;   // Frames spent close to the anchor
+    bool sleeping;
+    bool allowed;      // False if the object must never sleep
+    bool island_rest;  // Only used in the root of each island
+} ne_physics_sleep_t;
+
+static ne_physics_sleep_t *ne_physics_sleep;
+static int *ne_physics_island_parent; // Islands of the current frame
+
 static int NEA_MAX_PHYSICS;
 
+// Broadphase of NEA_PhysicsUpdateAll(). The boxes of the objects are kept
+// sorted by their minimum X coordinate, so the objects close to a box are
+// found with a binary search. The order barely changes between frames, so it
+// is sorted again with an insertion sort.
+typedef struct {
+    NEA_Vec3 min, max;
+} ne_physics_box_t;
+
+static ne_physics_box_t *ne_physics_boxes; // Indexed by slot
+static int *ne_physics_order;     // Slots of the objects with boxes, sorted
+static int *ne_physics_rank;      // Index of each slot in the order, or -1
+static int ne_physics_order_count;
+static int *ne_physics_unboxed;   // Slots of the objects without boxes
+static int ne_physics_unboxed_count;
+static int *ne_physics_candidates; // Objects to test against one object
+static int32_t ne_physics_max_width; // Max width of the boxes in the X axis
+static bool ne_physics_broadphase_active;
+
+// Collisions found by NEA_PhysicsUpdateAll() if the events are deferred
+static NEA_PhysicsEventMode ne_physics_event_mode;
+static NEA_PhysicsEvent *ne_physics_events;
+static int ne_physics_events_max;
+static int ne_physics_events_count;
+static int ne_physics_events_dropped;
+static bool ne_physics_events_active; // NEA_PhysicsUpdateAll() is running
+
 // =========================================================================
 // Internal helpers
 // =========================================================================
@@ -30,6 +79,7 @@ static inline void ne_physics_set_pos(NEA_Physics *p, NEA_Vec3 pos)
     p->model->x = pos.x;
     p->model->y = pos.y;
     p->model->z = pos.z;
+    p->model->transform_dirty = true;
 }
 
 // Compute separation vector: normal * neg_depth with ceiling for positive
@@ -50,6 +100,393 @@ static inline NEA_Vec3 ne_separation_vec(NEA_Vec3 normal, int32_t neg_depth)
     return v;
 }
 
+// =========================================================================
+// Broadphase
+// =========================================================================
+
+// Box around the shape of an object at a position. ColMeshes and objects
+// without shape don't have boxes.
+static bool ne_physics_get_box(const NEA_Physics *p, NEA_Vec3 pos,
+                               ne_physics_box_t *box)
+{
+    const NEA_ColShape *shape = &p->col_shape;
+    NEA_Vec3 half;
+
+    switch (shape->type)
+    {
+        case NEA_COL_AABB:
+            half = shape->shape.aabb.half;
+            break;
+        case NEA_COL_SPHERE:
+        {
+            int32_t r = shape->shape.sphere.radius;
+            half = NEA_Vec3Make(r, r, r);
+            break;
+        }
+        case NEA_COL_CAPSULE:
+        {
+            int32_t r = shape->shape.capsule.radius;
+            half = NEA_Vec3Make(r, shape->shape.capsule.half_height + r, r);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    box->min = NEA_Vec3Sub(pos, half);
+    box->max = NEA_Vec3Add(pos, half);
+    return true;
+}
+
+// Moves the object at an index of the order until the order is sorted again
+static void ne_physics_broadphase_sort_one(int index)
+{
+    int slot = ne_physics_order[index];
+    int32_t key = ne_physics_boxes[slot].min.x;
+
+    while ((index > 0) &&
+           (ne_physics_boxes[ne_physics_order[index - 1]].min.x > key))
+    {
+        ne_physics_order[index] = ne_physics_order[index - 1];
+        ne_physics_rank[ne_physics_order[index]] = index;
+        index--;
+    }
+
+    while ((index < ne_physics_order_count - 1) &&
+           (ne_physics_boxes[ne_physics_order[index + 1]].min.x < key))
+    {
+        ne_physics_order[index] = ne_physics_order[index + 1];
+        ne_physics_rank[ne_physics_order[index]] = index;
+        index++;
+    }
+
+    ne_physics_order[index] = slot;
+    ne_physics_rank[slot] = index;
+}
+
+// Updates the boxes of all objects, and sorts them again
+static void ne_physics_broadphase_build(void)
+{
+    int count = 0;
+
+    for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+        ne_physics_rank[ne_pool_slot(&ne_physics_slots, i)] = -1;
+
+    // Keep the objects of the previous frame in the same order
+    for (int i = 0; i < ne_physics_order_count; i++)
+    {
+        int slot = ne_physics_order[i];
+        NEA_Physics *p = ne_pool_at(&ne_physics_slots, slot);
+
+        if ((p == NULL) || (p->col_shape.type == NEA_COL_NONE) ||
+            !ne_physics_get_box(p, ne_physics_get_pos(p),
+                                &ne_physics_boxes[slot]))
+            continue;
+
+        ne_physics_order[count] = slot;
+        ne_physics_rank[slot] = count;
+        count++;
+    }
+
+    ne_physics_unboxed_count = 0;
+    ne_physics_max_width = 0;
+
+    for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        NEA_Physics *p = ne_pool_at(&ne_physics_slots, slot);
+        if ((p == NULL) || (p->col_shape.type == NEA_COL_NONE))
+            continue;
+
+        if (ne_physics_rank[slot] < 0)
+        {
+            if (!ne_physics_get_box(p, ne_physics_get_pos(p),
+                                    &ne_physics_boxes[slot]))
+            {
+                ne_physics_unboxed[ne_physics_unboxed_count++] = slot;
+                continue;
+            }
+
+            ne_physics_order[count] = slot;
+            ne_physics_rank[slot] = count;
+            count++;
+        }
+
+        const ne_physics_box_t *box = &ne_physics_boxes[slot];
+        if (box->max.x - box->min.x > ne_physics_max_width)
+            ne_physics_max_width = box->max.x - box->min.x;
+    }
+
+    ne_physics_order_count = count;
+
+    // Insertion sort, which is fast when the order barely changes. Only the
+    // start of the order is sorted, so don't use sort_one() here.
+    for (int i = 1; i < count; i++)
+    {
+        int slot = ne_physics_order[i];
+        int32_t key = ne_physics_boxes[slot].min.x;
+        int j = i;
+
+        while ((j > 0) &&
+               (ne_physics_boxes[ne_physics_order[j - 1]].min.x > key))
+        {
+            ne_physics_order[j] = ne_physics_order[j - 1];
+            ne_physics_rank[ne_physics_order[j]] = j;
+            j--;
+        }
+
+        ne_physics_order[j] = slot;
+        ne_physics_rank[slot] = j;
+    }
+}
+
+// Updates the box of an object after it has moved
+static void ne_physics_broadphase_move(int slot)
+{
+    NEA_Physics *p = ne_pool_at(&ne_physics_slots, slot);
+    int index = ne_physics_rank[slot];
+    if ((p == NULL) || (index < 0))
+        return;
+
+    ne_physics_box_t *box = &ne_physics_boxes[slot];
+    ne_physics_get_box(p, ne_physics_get_pos(p), box);
+    if (box->max.x - box->min.x > ne_physics_max_width)
+        ne_physics_max_width = box->max.x - box->min.x;
+
+    ne_physics_broadphase_sort_one(index);
+}
+
+// Adds a candidate to the list, which is kept sorted by slot
+static inline int ne_physics_add_candidate(int count, int slot)
+{
+    int i = count;
+    while ((i > 0) && (ne_physics_candidates[i - 1] > slot))
+    {
+        ne_physics_candidates[i] = ne_physics_candidates[i - 1];
+        i--;
+    }
+    ne_physics_candidates[i] = slot;
+    return count + 1;
+}
+
+// Finds the objects that may collide with an object at a position, starting
+// from a slot. They are stored in ne_physics_candidates sorted by slot, so
+// that they are tested in the same order as without broadphase. Objects
+// without boxes are always candidates.
+NEA_HOT_CODE static
+int ne_physics_get_candidates(const NEA_Physics *pointer, NEA_Vec3 pos,
+                              int first_slot)
+{
+    int count = 0;
+    ne_physics_box_t query;
+
+    if (!ne_physics_broadphase_active ||
+        !ne_physics_get_box(pointer, pos, &query))
+    {
+        for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+        {
+            int slot = ne_pool_slot(&ne_physics_slots, i);
+            NEA_Physics *other = ne_pool_at(&ne_physics_slots, slot);
+            if ((slot >= first_slot) && (other != NULL) &&
+                (other != pointer) && (pointer->groupmask & other->groupmask))
+                count = ne_physics_add_candidate(count, slot);
+        }
+        return count;
+    }
+
+    // First box that can overlap the query box in the X axis
+    int32_t start_x = query.min.x - ne_physics_max_width;
+    int lo = 0, hi = ne_physics_order_count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (ne_physics_boxes[ne_physics_order[mid]].min.x < start_x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (int i = lo; i < ne_physics_order_count; i++)
+    {
+        int slot = ne_physics_order[i];
+        const ne_physics_box_t *box = &ne_physics_boxes[slot];
+
+        if (box->min.x > query.max.x)
+            break;
+
+        if ((slot < first_slot) || (box->max.x < query.min.x) ||
+            (box->max.y < query.min.y) || (box->min.y > query.max.y) ||
+            (box->max.z < query.min.z) || (box->min.z > query.max.z))
+            continue;
+
+        NEA_Physics *other = ne_pool_at(&ne_physics_slots, slot);
+        if ((other == NULL) || (other == pointer) ||
+            ((pointer->groupmask & other->groupmask) == 0))
+            continue;
+
+        count = ne_physics_add_candidate(count, slot);
+    }
+
+    for (int i = 0; i < ne_physics_unboxed_count; i++)
+    {
+        int slot = ne_physics_unboxed[i];
+        NEA_Physics *other = ne_pool_at(&ne_physics_slots, slot);
+
+        if ((slot < first_slot) || (other == NULL) || (other == pointer) ||
+            ((pointer->groupmask & other->groupmask) == 0))
+            continue;
+
+        count = ne_physics_add_candidate(count, slot);
+    }
+
+    return count;
+}
+
+// =========================================================================
+// Sleeping
+// =========================================================================
+
+static inline int ne_physics_slot(const NEA_Physics *p)
+{
+    return p - ne_physics_pool;
+}
+
+static int ne_physics_island_find(int slot)
+{
+    while (ne_physics_island_parent[slot] != slot)
+    {
+        int parent = ne_physics_island_parent[slot];
+        ne_physics_island_parent[slot] = ne_physics_island_parent[parent];
+        slot = parent;
+    }
+    return slot;
+}
+
+static void ne_physics_island_join(int a, int b)
+{
+    a = ne_physics_island_find(a);
+    b = ne_physics_island_find(b);
+    if (a != b)
+        ne_physics_island_parent[b] = a;
+}
+
+// Wakes up an object and the rest of its island. If it is awake, it starts
+// counting the frames at rest again.
+static void ne_physics_wake_slot(int slot)
+{
+    ne_physics_sleep_t *sleep = &ne_physics_sleep[slot];
+
+    if (!sleep->sleeping)
+    {
+        sleep->frames = 0;
+        return;
+    }
+
+    int island = sleep->island;
+
+    for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        ne_physics_sleep_t *other = &ne_physics_sleep[slot];
+        if ((ne_pool_at(&ne_physics_slots, slot) == NULL) ||
+            !other->sleeping || (other->island != island))
+            continue;
+
+        other->sleeping = false;
+        other->frames = 0;
+    }
+}
+
+static inline void ne_physics_wake(const NEA_Physics *p)
+{
+    if (ne_physics_system_inited)
+        ne_physics_wake_slot(ne_physics_slot(p));
+}
+
+// Returns true if a sleeping object has been moved or pushed since it fell
+// asleep.
+static inline bool ne_physics_sleep_disturbed(const NEA_Physics *p, int slot)
+{
+    const ne_physics_sleep_t *sleep = &ne_physics_sleep[slot];
+    NEA_Vec3 pos = ne_physics_get_pos(p);
+
+    return (p->xspeed != 0) || (p->yspeed != 0) || (p->zspeed != 0) ||
+           (pos.x != sleep->anchor.x) || (pos.y != sleep->anchor.y) ||
+           (pos.z != sleep->anchor.z);
+}
+
+// Counts the frames that an object has stayed close to the same position
+static void ne_physics_sleep_track(const NEA_Physics *p, int slot)
+{
+    ne_physics_sleep_t *sleep = &ne_physics_sleep[slot];
+
+    if (!sleep->allowed || !p->enabled || p->is_static)
+    {
+        sleep->frames = 0;
+        return;
+    }
+
+    NEA_Vec3 pos = ne_physics_get_pos(p);
+
+    if ((abs(pos.x - sleep->anchor.x) > NEA_PHYSICS_SLEEP_DISTANCE) ||
+        (abs(pos.y - sleep->anchor.y) > NEA_PHYSICS_SLEEP_DISTANCE) ||
+        (abs(pos.z - sleep->anchor.z) > NEA_PHYSICS_SLEEP_DISTANCE))
+    {
+        sleep->anchor = pos;
+        sleep->frames = 0;
+    }
+    else if (sleep->frames < NEA_PHYSICS_SLEEP_TIME)
+    {
+        sleep->frames++;
+    }
+}
+
+// Puts to sleep the islands in which all objects have been at rest for long
+// enough. Objects that touch each other are in the same island, so a stack
+// of objects only sleeps when all of them have stopped.
+static void ne_physics_sleep_islands(void)
+{
+    int count = ne_pool_count(&ne_physics_slots);
+
+    for (int i = 0; i < count; i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        if (!ne_physics_sleep[slot].sleeping)
+            ne_physics_sleep[ne_physics_island_find(slot)].island_rest = true;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        if (ne_physics_sleep[slot].sleeping)
+            continue;
+
+        if (ne_physics_sleep[slot].frames < NEA_PHYSICS_SLEEP_TIME)
+            ne_physics_sleep[ne_physics_island_find(slot)].island_rest = false;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        NEA_Physics *p = ne_pool_at(&ne_physics_slots, slot);
+        ne_physics_sleep_t *sleep = &ne_physics_sleep[slot];
+
+        if (sleep->sleeping)
+            continue;
+
+        int root = ne_physics_island_find(slot);
+        if (!ne_physics_sleep[root].island_rest)
+            continue;
+
+        sleep->sleeping = true;
+        sleep->island = root;
+        sleep->anchor = ne_physics_get_pos(p);
+        p->xspeed = 0;
+        p->yspeed = 0;
+        p->zspeed = 0;
+    }
+}
+
 // =========================================================================
 // Object creation and destruction
 // =========================================================================
@@ -63,29 +500,21 @@ static NEA_Physics *ne_physics_create_common(void)
         return NULL;
     }
 
-    NEA_Physics *temp = calloc(1, sizeof(NEA_Physics));
-    if (temp == NULL)
+    int slot = ne_pool_next_slot(&ne_physics_slots);
+    if (slot < 0)
     {
-        NEA_DebugPrint("Not enough memory");
+        NEA_DebugPrint("No free slots");
         return NULL;
     }
 
-    int i = 0;
-    while (1)
-    {
-        if (i == NEA_MAX_PHYSICS)
-        {
-            free(temp);
-            NEA_DebugPrint("No free slots");
-            return NULL;
-        }
-        if (NEA_PhysicsPointers[i] == NULL)
-        {
-            NEA_PhysicsPointers[i] = temp;
-            break;
-        }
-        i++;
-    }
+    NEA_Physics *temp = &ne_physics_pool[slot];
+    memset(temp, 0, sizeof(NEA_Physics));
+    ne_pool_add(&ne_physics_slots, temp);
+
+    memset(&ne_physics_sleep[slot], 0, sizeof(ne_physics_sleep_t));
+    ne_physics_sleep[slot].allowed = true;
+    ne_physics_island_parent[slot] = slot;
+    ne_physics_rank[slot] = -1;
 
     // Defaults
     temp->keptpercent = 50;
@@ -165,23 +594,18 @@ void NEA_PhysicsDelete(NEA_Physics *pointer)
 
     NEA_AssertPointer(pointer, "NULL pointer");
 
-    int i = 0;
-    while (1)
+    int slot = pointer - ne_physics_pool;
+    if ((pointer < ne_physics_pool) || (slot >= NEA_MAX_PHYSICS) ||
+        (ne_pool_at(&ne_physics_slots, slot) != pointer))
     {
-        if (i == NEA_MAX_PHYSICS)
-        {
-            NEA_DebugPrint("Object not found");
-            return;
-        }
-
-        if (NEA_PhysicsPointers[i] == pointer)
-        {
-            NEA_PhysicsPointers[i] = NULL;
-            free(pointer);
-            return;
-        }
-        i++;
+        NEA_DebugPrint("Object not found");
+        return;
     }
+
+    // The objects that rest on this one need to fall
+    ne_physics_wake_slot(slot);
+
+    ne_pool_remove(&ne_physics_slots, slot);
 }
 
 void NEA_PhysicsDeleteAll(void)
@@ -189,8 +613,38 @@ void NEA_PhysicsDeleteAll(void)
     if (!ne_physics_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_PHYSICS; i++)
-        NEA_PhysicsDelete(NEA_PhysicsPointers[i]);
+    for (int i = ne_pool_count(&ne_physics_slots) - 1; i >= 0; i--)
+    {
+        NEA_Physics *p = ne_pool_get(&ne_physics_slots, i);
+        if (p != NULL)
+            NEA_PhysicsDelete(p);
+    }
+}
+
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE_SLOTS(ne_physics_slots_static, NEA_STATIC_MAX_PHYSICS);
+static NEA_Physics ne_physics_pool_static[NEA_STATIC_MAX_PHYSICS];
+static ne_physics_sleep_t ne_physics_sleep_static[NEA_STATIC_MAX_PHYSICS];
+static int ne_physics_island_parent_static[NEA_STATIC_MAX_PHYSICS];
+static ne_physics_box_t ne_physics_boxes_static[NEA_STATIC_MAX_PHYSICS];
+static int ne_physics_order_static[NEA_STATIC_MAX_PHYSICS];
+static int ne_physics_rank_static[NEA_STATIC_MAX_PHYSICS];
+static int ne_physics_unboxed_static[NEA_STATIC_MAX_PHYSICS];
+static int ne_physics_candidates_static[NEA_STATIC_MAX_PHYSICS];
+static NEA_PhysicsEvent ne_physics_events_static[NEA_STATIC_MAX_PHYSICS_EVENTS];
+#endif
+
+// Frees the tables of the objects, indexed by slot
+static void ne_physics_free_tables(void)
+{
+    NE_STATIC_FREE(ne_physics_pool_static, ne_physics_pool);
+    NE_STATIC_FREE(ne_physics_sleep_static, ne_physics_sleep);
+    NE_STATIC_FREE(ne_physics_island_parent_static, ne_physics_island_parent);
+    NE_STATIC_FREE(ne_physics_boxes_static, ne_physics_boxes);
+    NE_STATIC_FREE(ne_physics_order_static, ne_physics_order);
+    NE_STATIC_FREE(ne_physics_rank_static, ne_physics_rank);
+    NE_STATIC_FREE(ne_physics_unboxed_static, ne_physics_unboxed);
+    NE_STATIC_FREE(ne_physics_candidates_static, ne_physics_candidates);
 }
 
 int NEA_PhysicsSystemReset(int max_objects)
@@ -203,13 +657,47 @@ int NEA_PhysicsSystemReset(int max_objects)
     else
         NEA_MAX_PHYSICS = max_objects;
 
-    NEA_PhysicsPointers = calloc(NEA_MAX_PHYSICS, sizeof(NEA_PhysicsPointers));
-    if (NEA_PhysicsPointers == NULL)
+    NEA_MAX_PHYSICS = NE_STATIC_CAPACITY(NEA_MAX_PHYSICS,
+                                         NEA_STATIC_MAX_PHYSICS);
+
+    ne_physics_pool = NE_STATIC_CALLOC(ne_physics_pool_static, NEA_MAX_PHYSICS,
+                                       sizeof(NEA_Physics));
+    ne_physics_sleep = NE_STATIC_CALLOC(ne_physics_sleep_static,
+                                        NEA_MAX_PHYSICS,
+                                        sizeof(ne_physics_sleep_t));
+    ne_physics_island_parent = NE_STATIC_CALLOC(ne_physics_island_parent_static,
+                                                NEA_MAX_PHYSICS, sizeof(int));
+    ne_physics_boxes = NE_STATIC_CALLOC(ne_physics_boxes_static,
+                                        NEA_MAX_PHYSICS,
+                                        sizeof(ne_physics_box_t));
+    ne_physics_order = NE_STATIC_CALLOC(ne_physics_order_static,
+                                        NEA_MAX_PHYSICS, sizeof(int));
+    ne_physics_rank = NE_STATIC_CALLOC(ne_physics_rank_static, NEA_MAX_PHYSICS,
+                                       sizeof(int));
+    ne_physics_unboxed = NE_STATIC_CALLOC(ne_physics_unboxed_static,
+                                          NEA_MAX_PHYSICS, sizeof(int));
+    ne_physics_candidates = NE_STATIC_CALLOC(ne_physics_candidates_static,
+                                             NEA_MAX_PHYSICS, sizeof(int));
+    if ((ne_physics_pool == NULL) || (ne_physics_sleep == NULL) ||
+        (ne_physics_island_parent == NULL) || (ne_physics_boxes == NULL) ||
+        (ne_physics_order == NULL) || (ne_physics_rank == NULL) ||
+        (ne_physics_unboxed == NULL) || (ne_physics_candidates == NULL))
     {
+        ne_physics_free_tables();
         NEA_DebugPrint("Not enough memory");
         return -1;
     }
 
+    if (NE_POOL_INIT_SLOTS(&ne_physics_slots, ne_physics_slots_static,
+                           NEA_MAX_PHYSICS) == 0)
+    {
+        ne_physics_free_tables();
+        return -1;
+    }
+
+    ne_physics_order_count = 0;
+    ne_physics_unboxed_count = 0;
+
     ne_physics_system_inited = true;
     return 0;
 }
@@ -221,7 +709,14 @@ void NEA_PhysicsSystemEnd(void)
 
     NEA_PhysicsDeleteAll();
 
-    free(NEA_PhysicsPointers);
+    ne_pool_end(&ne_physics_slots);
+    ne_physics_free_tables();
+
+    NE_STATIC_FREE(ne_physics_events_static, ne_physics_events);
+    ne_physics_events = NULL;
+    ne_physics_events_max = 0;
+    ne_physics_events_count = 0;
+    ne_physics_event_mode = NEA_PHYSICS_EVENTS_IMMEDIATE;
 
     ne_physics_system_inited = false;
 }
@@ -235,6 +730,7 @@ void NEA_PhysicsSetColShape(NEA_Physics *physics, const NEA_ColShape *shape)
     NEA_AssertPointer(physics, "NULL physics pointer");
     NEA_AssertPointer(shape, "NULL shape pointer");
     physics->col_shape = *shape;
+    ne_physics_wake(physics);
 }
 
 void NEA_PhysicsSetRadiusI(NEA_Physics *pointer, int radius)
@@ -248,6 +744,8 @@ void NEA_PhysicsSetRadiusI(NEA_Physics *pointer, int radius)
         pointer->col_shape.shape.sphere.radius = radius;
     else if (pointer->col_shape.type == NEA_COL_CAPSULE)
         pointer->col_shape.shape.capsule.radius = radius;
+
+    ne_physics_wake(pointer);
 }
 
 void NEA_PhysicsSetSpeedI(NEA_Physics *pointer, int x, int y, int z)
@@ -256,6 +754,7 @@ void NEA_PhysicsSetSpeedI(NEA_Physics *pointer, int x, int y, int z)
     pointer->xspeed = x;
     pointer->yspeed = y;
     pointer->zspeed = z;
+    ne_physics_wake(pointer);
 }
 
 void NEA_PhysicsSetSizeI(NEA_Physics *pointer, int x, int y, int z)
@@ -273,12 +772,15 @@ void NEA_PhysicsSetSizeI(NEA_Physics *pointer, int x, int y, int z)
         pointer->col_shape.shape.aabb.half.y = y >> 1;
         pointer->col_shape.shape.aabb.half.z = z >> 1;
     }
+
+    ne_physics_wake(pointer);
 }
 
 void NEA_PhysicsSetGravityI(NEA_Physics *pointer, int gravity)
 {
     NEA_AssertPointer(pointer, "NULL pointer");
     pointer->gravity = gravity;
+    ne_physics_wake(pointer);
 }
 
 void NEA_PhysicsSetFrictionI(NEA_Physics *pointer, int friction)
@@ -299,6 +801,7 @@ void NEA_PhysicsEnable(NEA_Physics *pointer, bool value)
 {
     NEA_AssertPointer(pointer, "NULL pointer");
     pointer->enabled = value;
+    ne_physics_wake(pointer);
 }
 
 void NEA_PhysicsSetModel(NEA_Physics *physics, NEA_Model *modelpointer)
@@ -306,6 +809,7 @@ void NEA_PhysicsSetModel(NEA_Physics *physics, NEA_Model *modelpointer)
     NEA_AssertPointer(physics, "NULL physics pointer");
     NEA_AssertPointer(modelpointer, "NULL model pointer");
     physics->model = modelpointer;
+    ne_physics_wake(physics);
 }
 
 void NEA_PhysicsSetGroup(NEA_Physics *physics, int group)
@@ -313,12 +817,14 @@ void NEA_PhysicsSetGroup(NEA_Physics *physics, int group)
     NEA_AssertPointer(physics, "NULL pointer");
     NEA_Assert(group >= 0 && group < 32, "Group must be 0-31");
     physics->groupmask = (uint32_t)1 << group;
+    ne_physics_wake(physics);
 }
 
 void NEA_PhysicsSetGroupMask(NEA_Physics *physics, uint32_t mask)
 {
     NEA_AssertPointer(physics, "NULL pointer");
     physics->groupmask = mask;
+    ne_physics_wake(physics);
 }
 
 void NEA_PhysicsOnCollision(NEA_Physics *physics, NEA_OnCollision action)
@@ -350,6 +856,13 @@ void NEA_PhysicsSetStatic(NEA_Physics *physics, bool is_static)
 {
     NEA_AssertPointer(physics, "NULL pointer");
     physics->is_static = is_static;
+    ne_physics_wake(physics);
+}
+
+void NEA_PhysicsSetContinuous(NEA_Physics *physics, bool enable)
+{
+    NEA_AssertPointer(physics, "NULL pointer");
+    physics->continuous = enable;
 }
 
 bool NEA_PhysicsIsColliding(const NEA_Physics *pointer)
@@ -358,6 +871,111 @@ bool NEA_PhysicsIsColliding(const NEA_Physics *pointer)
     return pointer->iscolliding;
 }
 
+void NEA_PhysicsAllowSleep(NEA_Physics *physics, bool allow)
+{
+    NEA_AssertPointer(physics, "NULL pointer");
+
+    int slot = ne_physics_slot(physics);
+    ne_physics_wake_slot(slot);
+    ne_physics_sleep[slot].allowed = allow;
+}
+
+void NEA_PhysicsWake(NEA_Physics *physics)
+{
+    NEA_AssertPointer(physics, "NULL pointer");
+    ne_physics_wake(physics);
+}
+
+bool NEA_PhysicsIsSleeping(const NEA_Physics *pointer)
+{
+    NEA_AssertPointer(pointer, "NULL pointer");
+    return ne_physics_sleep[ne_physics_slot(pointer)].sleeping;
+}
+
+// =========================================================================
+// Collision events
+// =========================================================================
+
+int NEA_PhysicsSetEventMode(NEA_PhysicsEventMode mode, int max_events)
+{
+    if (!ne_physics_system_inited)
+        return 0;
+
+    NE_STATIC_FREE(ne_physics_events_static, ne_physics_events);
+    ne_physics_events = NULL;
+    ne_physics_events_max = 0;
+    ne_physics_events_count = 0;
+    ne_physics_events_dropped = 0;
+    ne_physics_event_mode = NEA_PHYSICS_EVENTS_IMMEDIATE;
+
+    if (mode == NEA_PHYSICS_EVENTS_IMMEDIATE)
+        return 1;
+
+    if (max_events < 1)
+        max_events = NEA_DEFAULT_PHYSICS_EVENTS;
+
+    max_events = NE_STATIC_CAPACITY(max_events, NEA_STATIC_MAX_PHYSICS_EVENTS);
+
+    ne_physics_events = NE_STATIC_CALLOC(ne_physics_events_static, max_events,
+                                         sizeof(NEA_PhysicsEvent));
+    if (ne_physics_events == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    ne_physics_events_max = max_events;
+    ne_physics_event_mode = mode;
+    return 1;
+}
+
+int NEA_PhysicsGetEvents(const NEA_PhysicsEvent **events)
+{
+    NEA_AssertPointer(events, "NULL pointer");
+
+    *events = ne_physics_events;
+    return ne_physics_events_count;
+}
+
+int NEA_PhysicsGetDroppedEvents(void)
+{
+    return ne_physics_events_dropped;
+}
+
+static void ne_physics_event_add(NEA_Physics *self, NEA_Physics *other,
+                                 const NEA_ColResult *result)
+{
+    if (ne_physics_events_count == ne_physics_events_max)
+    {
+        ne_physics_events_dropped++;
+        return;
+    }
+
+    NEA_PhysicsEvent *e = &ne_physics_events[ne_physics_events_count++];
+    e->self = self;
+    e->other = other;
+    e->result = *result;
+}
+
+// Calls the callbacks of the saved events. The pool is still locked, so the
+// objects deleted by a callback are NULL in the pool until the end.
+static void ne_physics_event_dispatch(void)
+{
+    for (int i = 0; i < ne_physics_events_count; i++)
+    {
+        NEA_PhysicsEvent *e = &ne_physics_events[i];
+
+        if ((ne_pool_at(&ne_physics_slots, ne_physics_slot(e->self))
+             != e->self) ||
+            (ne_pool_at(&ne_physics_slots, ne_physics_slot(e->other))
+             != e->other))
+            continue;
+
+        if (e->self->on_collision_cb != NULL)
+            e->self->on_collision_cb(e->self, e->other, &e->result);
+    }
+}
+
 // =========================================================================
 // Update
 // =========================================================================
@@ -367,14 +985,248 @@ void NEA_PhysicsUpdateAll(void)
     if (!ne_physics_system_inited)
         return;
 
-    for (int i = 0; i < NEA_MAX_PHYSICS; i++)
+    ne_physics_events_count = 0;
+    ne_physics_events_dropped = 0;
+    ne_physics_events_active =
+        ne_physics_event_mode != NEA_PHYSICS_EVENTS_IMMEDIATE;
+
+    ne_physics_broadphase_build();
+    ne_physics_broadphase_active = true;
+
+    for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        ne_physics_island_parent[slot] = slot;
+    }
+
+    // Collision callbacks may delete objects
+    ne_pool_lock(&ne_physics_slots);
+
+    for (int i = 0; i < ne_pool_count(&ne_physics_slots); i++)
+    {
+        int slot = ne_pool_slot(&ne_physics_slots, i);
+        NEA_Physics *p = ne_pool_at(&ne_physics_slots, slot);
+        if (p == NULL)
+            continue;
+
+        if (ne_physics_sleep[slot].sleeping)
+        {
+            if (!ne_physics_sleep_disturbed(p, slot))
+                continue;
+
+            ne_physics_wake_slot(slot);
+        }
+
+        NEA_PhysicsUpdate(p);
+        ne_physics_broadphase_move(slot);
+        ne_physics_sleep_track(p, slot);
+    }
+
+    ne_physics_broadphase_active = false;
+    ne_physics_events_active = false;
+
+    if (ne_physics_event_mode == NEA_PHYSICS_EVENTS_DEFERRED)
+        ne_physics_event_dispatch();
+
+    ne_pool_unlock(&ne_physics_slots);
+
+    ne_physics_sleep_islands();
+}
+
+// Pushes an object out of another one and changes its velocity with the
+// response of the object to one contact.
+static void ne_physics_respond(NEA_Physics *pointer, NEA_Physics *other,
+                               const NEA_ColResult *r, NEA_Vec3 *pos,
+                               NEA_Vec3 *vel)
+{
+    NEA_Vec3 new_pos = *pos;
+    NEA_Vec3 velocity = *vel;
+
+    if (pointer->oncollision == NEA_ColBounce)
+    {
+        // Separate objects: push this object out along collision normal
+        NEA_Vec3 separation = ne_separation_vec(r->normal, -r->depth);
+        new_pos = NEA_Vec3Add(new_pos, separation);
+        ne_physics_set_pos(pointer, new_pos);
+
+        // Compute velocity component along collision normal
+        int32_t v_dot_n = NEA_Vec3Dot(velocity, r->normal);
+
+        if (v_dot_n > 0) // Only respond if moving toward the surface
+        {
+            // Determine restitution
+            int32_t e = (pointer->keptpercent << 12) / 100;
+
+            // Remove normal velocity component and apply restitution
+            // v_new = v - (1 + e) * (v . n) * n
+            int32_t impulse_scale = mulf32(inttof32(1) + e, v_dot_n);
+
+            // Mass-based impulse distribution
+            if (other->mass > 0 && !other->is_static
+                && other->enabled)
+            {
+                if (pointer->mass > 0)
+                {
+                    // Both dynamic: ratio = m_other / (m_self + m_other)
+                    int32_t mass_sum = pointer->mass + other->mass;
+                    int32_t ratio_self = divf32(other->mass, mass_sum);
+                    int32_t ratio_other = inttof32(1) - ratio_self;
+
+                    // Apply to self
+                    NEA_Vec3 self_impulse = NEA_Vec3Scale(
+                        r->normal,
+                        mulf32(impulse_scale, ratio_self));
+                    velocity = NEA_Vec3Sub(velocity, self_impulse);
+
+                    // Apply to other
+                    NEA_Vec3 other_vel = NEA_Vec3Make(
+                        other->xspeed, other->yspeed, other->zspeed);
+                    NEA_Vec3 other_impulse = NEA_Vec3Scale(
+                        r->normal,
+                        mulf32(-impulse_scale, ratio_other));
+                    other_vel = NEA_Vec3Sub(other_vel, other_impulse);
+                    other->xspeed = other_vel.x;
+                    other->yspeed = other_vel.y;
+                    other->zspeed = other_vel.z;
+                }
+                else
+                {
+                    // This object has infinite mass, push other fully
+                    NEA_Vec3 other_vel = NEA_Vec3Make(
+                        other->xspeed, other->yspeed, other->zspeed);
+                    NEA_Vec3 other_impulse = NEA_Vec3Scale(
+                        r->normal, -impulse_scale);
+                    other_vel = NEA_Vec3Sub(other_vel, other_impulse);
+                    other->xspeed = other_vel.x;
+                    other->yspeed = other_vel.y;
+                    other->zspeed = other_vel.z;
+                }
+            }
+            else
+            {
+                // Other object is static/disabled: full impulse on self
+                NEA_Vec3 impulse_vec = NEA_Vec3Scale(r->normal,
+                                                    impulse_scale);
+                velocity = NEA_Vec3Sub(velocity, impulse_vec);
+            }
+
+            // Minimum bounce speed check on gravity axis
+            if (pointer->gravity != 0)
+            {
+                if (abs(velocity.y) <= NEA_MIN_BOUNCE_SPEED)
+                    velocity.y = 0;
+            }
+        }
+
+        pointer->xspeed = velocity.x;
+        pointer->yspeed = velocity.y;
+        pointer->zspeed = velocity.z;
+    }
+    else if (pointer->oncollision == NEA_ColStop)
+    {
+        // Push out along normal
+        NEA_Vec3 separation = ne_separation_vec(r->normal, -r->depth);
+        new_pos = NEA_Vec3Add(new_pos, separation);
+        ne_physics_set_pos(pointer, new_pos);
+
+        // Zero all velocity
+        pointer->xspeed = 0;
+        pointer->yspeed = 0;
+        pointer->zspeed = 0;
+        velocity = NEA_Vec3Make(0, 0, 0);
+    }
+    else if (pointer->oncollision == NEA_ColSlide)
+    {
+        // Push out along normal
+        NEA_Vec3 separation = ne_separation_vec(r->normal, -r->depth);
+        new_pos = NEA_Vec3Add(new_pos, separation);
+        ne_physics_set_pos(pointer, new_pos);
+
+        // Remove velocity component along the normal (slide)
+        int32_t v_dot_n = NEA_Vec3Dot(velocity, r->normal);
+        if (v_dot_n > 0)
+        {
+            NEA_Vec3 normal_vel = NEA_Vec3Scale(r->normal, v_dot_n);
+            velocity = NEA_Vec3Sub(velocity, normal_vel);
+        }
+
+        pointer->xspeed = velocity.x;
+        pointer->yspeed = velocity.y;
+        pointer->zspeed = velocity.z;
+    }
+    // NEA_ColNothing: do nothing (sensor)
+
+    *pos = new_pos;
+    *vel = velocity;
+}
+
+// Continuous collision of an object that has moved from "from" to "*pos". If
+// its sphere or capsule goes into a mesh during the step, it's moved back to
+// the first point where that happens. The spheres are swept with half of their
+// radius, so surfaces touched at the start of the step don't stop the object,
+// and the discrete test pushes it out of the mesh with the right depth.
+static void ne_physics_sweep(NEA_Physics *pointer, NEA_Vec3 from,
+                             NEA_Vec3 *pos)
+{
+    const NEA_ColShape *shape = &pointer->col_shape;
+    int32_t radius, h;
+
+    if (shape->type == NEA_COL_SPHERE)
+    {
+        radius = shape->shape.sphere.radius;
+        h = 0;
+    }
+    else if (shape->type == NEA_COL_CAPSULE)
+    {
+        radius = shape->shape.capsule.radius;
+        h = shape->shape.capsule.half_height;
+    }
+    else
+    {
+        return;
+    }
+
+    // The discrete test can't miss a mesh if the object moves less than this
+    NEA_Vec3 motion = NEA_Vec3Sub(*pos, from);
+    if (NEA_Vec3LengthSq(motion) <= mulf32(radius, radius))
+        return;
+
+    NEA_ColSphere sphere = { .radius = radius / 2 };
+    int32_t best = INT32_MAX;
+
+    int num_candidates = ne_physics_get_candidates(pointer, *pos, 0);
+
+    for (int c = 0; c < num_candidates; c++)
     {
-        if (NEA_PhysicsPointers[i] != NULL)
-            NEA_PhysicsUpdate(NEA_PhysicsPointers[i]);
+        NEA_Physics *other = ne_pool_at(&ne_physics_slots,
+                                        ne_physics_candidates[c]);
+        if ((other == NULL) || (other->col_shape.type != NEA_COL_TRIMESH))
+            continue;
+
+        NEA_Vec3 other_pos = ne_physics_get_pos(other);
+
+        // Capsules sweep the spheres at both ends of their segment
+        for (int e = 0; e < ((h > 0) ? 2 : 1); e++)
+        {
+            NEA_Vec3 offset = NEA_Vec3Make(0, (e == 0) ? -h : h, 0);
+            NEA_ColRayResult r = NEA_ColSweepSphere(&sphere,
+                                                    NEA_Vec3Add(from, offset),
+                                                    NEA_Vec3Add(*pos, offset),
+                                                    &other->col_shape,
+                                                    other_pos);
+            if (r.hit && (r.distance < best))
+                best = r.distance;
+        }
     }
+
+    if (best == INT32_MAX)
+        return;
+
+    *pos = NEA_Vec3Add(from, NEA_Vec3Scale(NEA_Vec3Normalize(motion), best));
+    ne_physics_set_pos(pointer, *pos);
 }
 
-ARM_CODE void NEA_PhysicsUpdate(NEA_Physics *pointer)
+NEA_HOT_CODE void NEA_PhysicsUpdate(NEA_Physics *pointer)
 {
     if (!ne_physics_system_inited)
         return;
@@ -390,172 +1242,110 @@ ARM_CODE void NEA_PhysicsUpdate(NEA_Physics *pointer)
     if (pointer->is_static)
         return;
 
+    int self_slot = ne_physics_slot(pointer);
+    if (ne_physics_sleep[self_slot].sleeping)
+        ne_physics_wake_slot(self_slot);
+
     pointer->iscolliding = false;
 
     // Apply gravity on Y axis
     pointer->yspeed -= pointer->gravity;
 
+    NEA_Vec3 old_pos = ne_physics_get_pos(pointer);
+
     // Apply velocity
     NEA_Model *model = pointer->model;
     model->x += pointer->xspeed;
     model->y += pointer->yspeed;
     model->z += pointer->zspeed;
+    model->transform_dirty = true;
 
     NEA_Vec3 new_pos = ne_physics_get_pos(pointer);
 
+    if (pointer->continuous)
+        ne_physics_sweep(pointer, old_pos, &new_pos);
+
     // --- Collision detection and response ---
 
     NEA_Vec3 velocity = NEA_Vec3Make(pointer->xspeed, pointer->yspeed,
                                      pointer->zspeed);
 
-    for (int i = 0; i < NEA_MAX_PHYSICS; i++)
-    {
-        if (NEA_PhysicsPointers[i] == NULL)
-            continue;
-
-        NEA_Physics *other = NEA_PhysicsPointers[i];
+    // The candidates are found again from the next object every time this
+    // object is pushed, because its box has moved.
+    int next_slot = 0;
+    int num_candidates = ne_physics_get_candidates(pointer, new_pos, 0);
 
-        // Skip self
-        if (other == pointer)
-            continue;
+    for (int c = 0; c < num_candidates; c++)
+    {
+        int i = ne_physics_candidates[c];
+        next_slot = i + 1;
 
-        // Group mask check: collide if masks overlap
-        if ((pointer->groupmask & other->groupmask) == 0)
+        NEA_Physics *other = ne_pool_at(&ne_physics_slots, i);
+        if (other == NULL)
             continue;
 
         NEA_Vec3 other_pos = ne_physics_get_pos(other);
 
-        // Perform collision test using the new system
-        NEA_ColResult result = NEA_ColTest(&pointer->col_shape, new_pos,
-                                           &other->col_shape, other_pos);
-
-        if (!result.hit)
+        // Perform collision test using the new system. Meshes can give more
+        // than one contact, sorted from the deepest one.
+        NEA_ColResult contacts[NEA_PHYSICS_MAX_CONTACTS];
+        int num_contacts = NEA_ColTestContacts(&pointer->col_shape, new_pos,
+                                               &other->col_shape, other_pos,
+                                               contacts,
+                                               NEA_PHYSICS_MAX_CONTACTS);
+        if (num_contacts == 0)
             continue;
 
         pointer->iscolliding = true;
 
-        // Fire callback if set
-        if (pointer->on_collision_cb != NULL)
-            pointer->on_collision_cb(pointer, other, &result);
+        // Objects pushed by this one wake up, and objects that touch each
+        // other fall asleep at the same time.
+        if (pointer->oncollision != NEA_ColNothing)
+        {
+            if (ne_physics_sleep[i].sleeping)
+                ne_physics_wake_slot(i);
 
-        // --- Collision response ---
+            if (other->enabled && !other->is_static)
+                ne_physics_island_join(self_slot, i);
+        }
 
-        if (pointer->oncollision == NEA_ColBounce)
+        // Fire callback if set, or save the collision for later
+        if (ne_physics_events_active)
         {
-            // Separate objects: push this object out along collision normal
-            NEA_Vec3 separation = ne_separation_vec(result.normal,
-                                                    -result.depth);
-            new_pos = NEA_Vec3Add(new_pos, separation);
-            ne_physics_set_pos(pointer, new_pos);
+            if ((ne_physics_event_mode == NEA_PHYSICS_EVENTS_BUFFERED) ||
+                (pointer->on_collision_cb != NULL))
+                ne_physics_event_add(pointer, other, &contacts[0]);
+        }
+        else if (pointer->on_collision_cb != NULL)
+        {
+            pointer->on_collision_cb(pointer, other, &contacts[0]);
+        }
 
-            // Compute velocity component along collision normal
-            int32_t v_dot_n = NEA_Vec3Dot(velocity, result.normal);
+        // --- Collision response ---
 
-            if (v_dot_n > 0) // Only respond if moving toward the surface
+        // All the contacts with a mesh are resolved together. The push of the
+        // previous contacts is taken away from the depth of the next ones.
+        NEA_Vec3 start_pos = new_pos;
+        for (int k = 0; k < num_contacts; k++)
+        {
+            NEA_ColResult contact = contacts[k];
+            if (k > 0)
             {
-                // Determine restitution
-                int32_t e = (pointer->keptpercent << 12) / 100;
-
-                // Remove normal velocity component and apply restitution
-                // v_new = v - (1 + e) * (v . n) * n
-                int32_t impulse_scale = mulf32(inttof32(1) + e, v_dot_n);
-
-                // Mass-based impulse distribution
-                if (other->mass > 0 && !other->is_static
-                    && other->enabled)
-                {
-                    if (pointer->mass > 0)
-                    {
-                        // Both dynamic: ratio = m_other / (m_self + m_other)
-                        int32_t mass_sum = pointer->mass + other->mass;
-                        int32_t ratio_self = divf32(other->mass, mass_sum);
-                        int32_t ratio_other = inttof32(1) - ratio_self;
-
-                        // Apply to self
-                        NEA_Vec3 self_impulse = NEA_Vec3Scale(
-                            result.normal,
-                            mulf32(impulse_scale, ratio_self));
-                        velocity = NEA_Vec3Sub(velocity, self_impulse);
-
-                        // Apply to other
-                        NEA_Vec3 other_vel = NEA_Vec3Make(
-                            other->xspeed, other->yspeed, other->zspeed);
-                        NEA_Vec3 other_impulse = NEA_Vec3Scale(
-                            result.normal,
-                            mulf32(-impulse_scale, ratio_other));
-                        other_vel = NEA_Vec3Sub(other_vel, other_impulse);
-                        other->xspeed = other_vel.x;
-                        other->yspeed = other_vel.y;
-                        other->zspeed = other_vel.z;
-                    }
-                    else
-                    {
-                        // This object has infinite mass, push other fully
-                        NEA_Vec3 other_vel = NEA_Vec3Make(
-                            other->xspeed, other->yspeed, other->zspeed);
-                        NEA_Vec3 other_impulse = NEA_Vec3Scale(
-                            result.normal, -impulse_scale);
-                        other_vel = NEA_Vec3Sub(other_vel, other_impulse);
-                        other->xspeed = other_vel.x;
-                        other->yspeed = other_vel.y;
-                        other->zspeed = other_vel.z;
-                    }
-                }
-                else
-                {
-                    // Other object is static/disabled: full impulse on self
-                    NEA_Vec3 impulse_vec = NEA_Vec3Scale(result.normal,
-                                                        impulse_scale);
-                    velocity = NEA_Vec3Sub(velocity, impulse_vec);
-                }
-
-                // Minimum bounce speed check on gravity axis
-                if (pointer->gravity != 0)
-                {
-                    if (abs(velocity.y) <= NEA_MIN_BOUNCE_SPEED)
-                        velocity.y = 0;
-                }
+                NEA_Vec3 pushed = NEA_Vec3Sub(new_pos, start_pos);
+                contact.depth += NEA_Vec3Dot(pushed, contact.normal);
+                if (contact.depth <= 0)
+                    continue;
             }
 
-            pointer->xspeed = velocity.x;
-            pointer->yspeed = velocity.y;
-            pointer->zspeed = velocity.z;
+            ne_physics_respond(pointer, other, &contact, &new_pos, &velocity);
         }
-        else if (pointer->oncollision == NEA_ColStop)
-        {
-            // Push out along normal
-            NEA_Vec3 separation = ne_separation_vec(result.normal,
-                                                    -result.depth);
-            new_pos = NEA_Vec3Add(new_pos, separation);
-            ne_physics_set_pos(pointer, new_pos);
 
-            // Zero all velocity
-            pointer->xspeed = 0;
-            pointer->yspeed = 0;
-            pointer->zspeed = 0;
-            velocity = NEA_Vec3Make(0, 0, 0);
-        }
-        else if (pointer->oncollision == NEA_ColSlide)
+        if (pointer->oncollision != NEA_ColNothing)
         {
-            // Push out along normal
-            NEA_Vec3 separation = ne_separation_vec(result.normal,
-                                                    -result.depth);
-            new_pos = NEA_Vec3Add(new_pos, separation);
-            ne_physics_set_pos(pointer, new_pos);
-
-            // Remove velocity component along the normal (slide)
-            int32_t v_dot_n = NEA_Vec3Dot(velocity, result.normal);
-            if (v_dot_n > 0)
-            {
-                NEA_Vec3 normal_vel = NEA_Vec3Scale(result.normal, v_dot_n);
-                velocity = NEA_Vec3Sub(velocity, normal_vel);
-            }
-
-            pointer->xspeed = velocity.x;
-            pointer->yspeed = velocity.y;
-            pointer->zspeed = velocity.z;
+            num_candidates = ne_physics_get_candidates(pointer, new_pos,
+                                                       next_slot);
+            c = -1;
         }
-        // NEA_ColNothing: do nothing (sensor), iscolliding is already set
     }
 
     // Clamp tiny velocities to zero to prevent drift from fixed-point errors
@@ -0,0 +1,283 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAPick.c
+
+// Radius of the bounds of scene subtrees that can't be culled. It must match
+// NE_BOUNDS_INFINITE in NEAScene.c
+#define NEA_PICK_BOUNDS_INFINITE INT32_MAX
+
+// Internal use... see NEACamera.c, NEAGeneral.c and NEAModel.c
+bool ne_camera_get_basis(NEA_Camera *cam, int32_t *pos, int32_t *right,
+                         int32_t *up, int32_t *back);
+void ne_projection_get(int32_t *tan_half_fov, int32_t *ratio, int32_t *znear,
+                       int32_t *zfar, uint32_t *viewport);
+void ne_model_update_transform(NEA_Model *model);
+void ne_sphere_transform(const int32_t *center, int32_t radius,
+                         const m4x3 *mat, int32_t *out);
+void ne_model_sphere_transform(const NEA_Model *model, const m4x3 *mat,
+                               int32_t *out);
+
+void NEA_PickStartRay(NEA_Pick *pick, NEA_Vec3 from, NEA_Vec3 to)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+
+    pick->from = from;
+    pick->to = to;
+    pick->hit = false;
+    pick->type = NEA_PICK_NONE;
+    pick->object = NULL;
+    pick->distance = 0;
+    pick->point = from;
+}
+
+int NEA_PickStart(NEA_Pick *pick, NEA_Camera *cam, int px, int py)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+
+    int32_t pos[3], right[3], up[3], back[3];
+    if (!ne_camera_get_basis(cam, pos, right, up, back))
+    {
+        NEA_DebugPrint("No camera");
+        return 0;
+    }
+
+    int32_t tan_half_fov, ratio, znear, zfar;
+    uint32_t viewport;
+    ne_projection_get(&tan_half_fov, &ratio, &znear, &zfar, &viewport);
+
+    int x1 = viewport & 0xFF;
+    int y1 = (viewport >> 8) & 0xFF;
+    int x2 = (viewport >> 16) & 0xFF;
+    int y2 = (viewport >> 24) & 0xFF;
+
+    // The Y axis of the viewport goes up from the bottom of the screen. Use
+    // the center of the pixel.
+    int32_t nx = divf32(inttof32(2 * (px - x1) + 1), inttof32(x2 - x1 + 1))
+               - inttof32(1);
+    int32_t ny = divf32(inttof32(2 * (191 - py - y1) + 1),
+                        inttof32(y2 - y1 + 1))
+               - inttof32(1);
+
+    int32_t kx = mulf32(mulf32(nx, tan_half_fov), ratio);
+    int32_t ky = mulf32(ny, tan_half_fov);
+
+    // Direction of the ray. Its length along the view direction is 1, so the
+    // points at the clipping planes are at the distance of the planes.
+    NEA_Vec3 dir = NEA_Vec3Make(
+            mulf32(right[0], kx) + mulf32(up[0], ky) - back[0],
+            mulf32(right[1], kx) + mulf32(up[1], ky) - back[1],
+            mulf32(right[2], kx) + mulf32(up[2], ky) - back[2]);
+
+    NEA_Vec3 origin = NEA_Vec3Make(pos[0], pos[1], pos[2]);
+
+    NEA_PickStartRay(pick, NEA_Vec3Add(origin, NEA_Vec3Scale(dir, znear)),
+                     NEA_Vec3Add(origin, NEA_Vec3Scale(dir, zfar)));
+
+    return 1;
+}
+
+// Casts the part of the ray that is left against a shape. It only returns a
+// hit if it is closer than the closest hit so far.
+static bool ne_pick_raycast(const NEA_Pick *pick, const NEA_ColShape *shape,
+                            NEA_Vec3 pos, NEA_ColRayResult *result)
+{
+    // Nothing can be closer than a hit at the start of the ray. This also
+    // avoids casting a ray of length 0.
+    if (pick->hit && pick->distance == 0)
+        return false;
+
+    *result = NEA_ColRaycast(pick->from, pick->to, shape, pos);
+
+    return result->hit;
+}
+
+// Saves a hit as the closest one and shortens the ray, so that the following
+// tests can't find hits behind it.
+static void ne_pick_save(NEA_Pick *pick, const NEA_ColRayResult *result,
+                         NEA_PickType type, void *object)
+{
+    pick->hit = true;
+    pick->type = type;
+    pick->object = object;
+    pick->point = result->point;
+    pick->to = result->point;
+
+    // Distances of the raycast are measured from the same start
+    pick->distance = result->distance;
+}
+
+static bool ne_pick_sphere(NEA_Pick *pick, const int32_t *sphere,
+                           NEA_PickType type, void *object)
+{
+    NEA_ColShape shape;
+    NEA_ColShapeInitSphereI(&shape, sphere[3]);
+
+    NEA_ColRayResult result;
+    if (!ne_pick_raycast(pick, &shape,
+                         NEA_Vec3Make(sphere[0], sphere[1], sphere[2]),
+                         &result))
+        return false;
+
+    if (type != NEA_PICK_NONE)
+        ne_pick_save(pick, &result, type, object);
+
+    return true;
+}
+
+bool NEA_PickSphereI(NEA_Pick *pick, int32_t x, int32_t y, int32_t z,
+                     int32_t radius, void *object)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+    NEA_Assert(radius > 0, "Invalid radius");
+
+    int32_t sphere[4] = { x, y, z, radius };
+
+    return ne_pick_sphere(pick, sphere, NEA_PICK_SPHERE, object);
+}
+
+bool NEA_PickModel(NEA_Pick *pick, NEA_Model *model)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    if (model->bound_radius == 0)
+        return false;
+
+    if (model->multi == NULL && model->meshindex == NEA_NO_MESH)
+        return false;
+
+    const m4x3 *mat = model->mat;
+    if (mat == NULL)
+    {
+        ne_model_update_transform(model);
+        mat = &model->transform;
+    }
+
+    int32_t sphere[4];
+    ne_model_sphere_transform(model, mat, sphere);
+
+    return ne_pick_sphere(pick, sphere, NEA_PICK_MODEL, model);
+}
+
+bool NEA_PickShape(NEA_Pick *pick, const NEA_ColShape *shape, NEA_Vec3 pos,
+                   void *object)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+    NEA_AssertPointer(shape, "NULL shape pointer");
+
+    NEA_ColRayResult result;
+    if (!ne_pick_raycast(pick, shape, pos, &result))
+        return false;
+
+    ne_pick_save(pick, &result, NEA_PICK_SHAPE, object);
+
+    return true;
+}
+
+// Gets the bounding sphere of the model of a node in world space, like
+// NEAScene.c does to build the bounds of the subtrees.
+static bool ne_pick_node_sphere(const NEA_Scene *scene, int index,
+                                int32_t *sphere)
+{
+    const NEA_SceneNode *node = &scene->nodes[index];
+    const m4x3 *world = &scene->world[index];
+
+    if (node->type != NEA_NODE_MESH || node->model == NULL)
+        return false;
+
+    const NEA_Model *model = node->model;
+
+    if ((model->bound_radius != 0) &&
+        (model->multi != NULL || model->meshindex != NEA_NO_MESH))
+    {
+        ne_model_sphere_transform(model, world, sphere);
+        return true;
+    }
+
+    if (scene->local_bounds != NULL && scene->local_bounds[index].radius >= 0)
+    {
+        const NEA_SceneBounds *local = &scene->local_bounds[index];
+        ne_sphere_transform(local->center, local->radius, world, sphere);
+        return true;
+    }
+
+    return false;
+}
+
+static NEA_SceneNode *ne_pick_scene_node(NEA_Pick *pick,
+                                         const NEA_Scene *scene,
+                                         NEA_SceneNode *node)
+{
+    if (!node->visible)
+        return NULL;
+
+    if (node->type == NEA_NODE_ROOM && !node->room_visible)
+        return NULL;
+
+    int index = node - scene->nodes;
+
+    // Skip the subtree if the ray doesn't touch its bounds before the closest
+    // hit found so far.
+    const NEA_SceneBounds *b = &scene->bounds[index];
+    if (b->radius < 0)
+        return NULL;
+
+    if (b->radius != NEA_PICK_BOUNDS_INFINITE)
+    {
+        int32_t sphere[4] = { b->center[0], b->center[1], b->center[2],
+                              b->radius };
+        if (!ne_pick_sphere(pick, sphere, NEA_PICK_NONE, NULL))
+            return NULL;
+    }
+
+    NEA_SceneNode *best = NULL;
+
+    int32_t sphere[4];
+    if (ne_pick_node_sphere(scene, index, sphere))
+    {
+        if (ne_pick_sphere(pick, sphere, NEA_PICK_NODE, node))
+            best = node;
+    }
+
+    if (node->type == NEA_NODE_SECTOR)
+    {
+        uint16_t slot = node->ref.sector.slot;
+        if (slot < scene->num_sectors && scene->sectors[slot].node == node)
+        {
+            const NEA_Scene *sector = scene->sectors[slot].scene;
+            if (sector != NULL)
+            {
+                NEA_SceneNode *hit = NEA_PickScene(pick, sector);
+                if (hit != NULL)
+                    best = hit;
+            }
+        }
+    }
+
+    for (NEA_SceneNode *child = node->first_child; child != NULL;
+         child = child->next_sibling)
+    {
+        NEA_SceneNode *hit = ne_pick_scene_node(pick, scene, child);
+        if (hit != NULL)
+            best = hit;
+    }
+
+    return best;
+}
+
+NEA_SceneNode *NEA_PickScene(NEA_Pick *pick, const NEA_Scene *scene)
+{
+    NEA_AssertPointer(pick, "NULL pick pointer");
+    NEA_AssertPointer(scene, "NULL scene pointer");
+
+    if (!scene->loaded || scene->root == NULL || scene->bounds == NULL)
+        return NULL;
+
+    return ne_pick_scene_node(pick, scene, scene->root);
+}
@@ -8,28 +8,49 @@
 
 /// @file NEAPolygon.c
 
+// The light manager remembers the values of the light registers, it has to
+// write them again after they are modified by these functions.
+static void ne_light_manager_invalidate(void)
+{
+    extern void NEA_LightManagerInvalidate(void) __attribute__((weak));
+    if (NEA_LightManagerInvalidate)
+        NEA_LightManagerInvalidate();
+}
+
 void NEA_LightOff(int index)
 {
+    NEA_DisplayListWait();
+
     NEA_AssertMinMax(0, index, 3, "Invalid light index %d", index);
 
     GFX_LIGHT_VECTOR = (index & 3) << 30;
     GFX_LIGHT_COLOR = (index & 3) << 30;
+
+    ne_light_manager_invalidate();
 }
 
 void NEA_LightSetColor(int index, u32 color)
 {
+    NEA_DisplayListWait();
+
     NEA_AssertMinMax(0, index, 3, "Invalid light number %d", index);
 
     GFX_LIGHT_COLOR = ((index & 3) << 30) | color;
+
+    ne_light_manager_invalidate();
 }
 
 void NEA_LightSetI(int index, u32 color, int x, int y, int z)
 {
+    NEA_DisplayListWait();
+
     NEA_AssertMinMax(0, index, 3, "Invalid light number %d", index);
 
     GFX_LIGHT_VECTOR = ((index & 3) << 30)
                      | ((z & 0x3FF) << 20) | ((y & 0x3FF) << 10) | (x & 0x3FF);
     GFX_LIGHT_COLOR = ((index & 3) << 30) | color;
+
+    ne_light_manager_invalidate();
 }
 
 void NEA_ShininessTableGenerate(NEA_ShininessFunction function)
@@ -82,14 +103,30 @@ void NEA_ShininessTableGenerate(NEA_ShininessFunction function)
         GFX_SHININESS = table[i];
 }
 
+// Internal use: last polygon format set with NEA_PolyFormat() or by the engine
+// before drawing a model. The BoxTest culling of models restores it after each
+// test. See NEAModel.c
+u32 ne_poly_format_last = 0;
+
+// Internal use... see NEATexture.c
+void ne_material_state_poly_format(u32 value);
+
 void NEA_PolyFormat(u32 alpha, u32 id, NEA_LightEnum lights,
                    NEA_CullingEnum culling, NEA_OtherFormatEnum other)
 {
     NEA_AssertMinMax(0, alpha, 31, "Invalid alpha value %lu", alpha);
     NEA_AssertMinMax(0, id, 63, "Invalid polygon ID %lu", id);
 
-    GFX_POLY_FORMAT = POLY_ALPHA(alpha) | POLY_ID(id)
-                    | lights | culling | other;
+    u32 format = POLY_ALPHA(alpha) | POLY_ID(id) | lights | culling | other;
+
+    if (ne_dl_recorder != NULL)
+    {
+        ne_dl_record(FIFO_POLY_FORMAT, 1, format, 0);
+        return;
+    }
+
+    ne_material_state_poly_format(format);
+    ne_poly_format_last = format;
 }
 
 void NEA_OutliningSetColor(u32 index, u32 color)
@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAPool.h"
+#include "NEAHeapAlloc.h"
+
+/// @file NEAPool.c
+
+int ne_pool_init(ne_pool_t *pool, int max)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    NEA_Assert(max > 0, "Invalid size");
+
+    memset(pool, 0, sizeof(ne_pool_t));
+
+    pool->objects = calloc(max, sizeof(void *));
+    pool->link = calloc(max, sizeof(int));
+    pool->dense = calloc(max, sizeof(int));
+    if ((pool->objects == NULL) || (pool->link == NULL) ||
+        (pool->dense == NULL))
+    {
+        ne_pool_end(pool);
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    pool->max = max;
+    pool->heap_tag = -1;
+
+    // Slots are used from the first one
+    for (int i = 0; i < max; i++)
+        pool->link[i] = (i + 1 < max) ? i + 1 : -1;
+    pool->free_head = 0;
+
+    return 1;
+}
+
+int ne_pool_init_static(ne_pool_t *pool, int max, void **objects, int *link,
+                        int *dense, void *storage, size_t object_size)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+    NEA_Assert(max > 0, "Invalid size");
+
+    memset(pool, 0, sizeof(ne_pool_t));
+
+    pool->objects = objects;
+    pool->link = link;
+    pool->dense = dense;
+    pool->max = max;
+    pool->is_static = true;
+    pool->storage = storage;
+    pool->object_size = object_size;
+    pool->heap_tag = -1;
+
+    memset(objects, 0, max * sizeof(void *));
+
+    for (int i = 0; i < max; i++)
+        pool->link[i] = (i + 1 < max) ? i + 1 : -1;
+    pool->free_head = 0;
+
+    return 1;
+}
+
+void ne_pool_end(ne_pool_t *pool)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    if (!pool->is_static)
+    {
+        free(pool->objects);
+        free(pool->link);
+        free(pool->dense);
+    }
+
+    memset(pool, 0, sizeof(ne_pool_t));
+    pool->free_head = -1;
+    pool->heap_tag = -1;
+}
+
+void ne_pool_set_heap_tag(ne_pool_t *pool, NEA_HeapTag tag)
+{
+    NEA_AssertPointer(pool, "NULL pointer");
+
+    pool->heap_tag = tag;
+}
+
+void *ne_pool_object_alloc(ne_pool_t *pool, size_t size)
+{
+    if (pool->storage == NULL)
+    {
+        if (pool->heap_tag >= 0)
+            return ne_heap_calloc(pool->heap_tag, 1, size);
+        return calloc(1, size);
+    }
+
+    NEA_Assert(size <= pool->object_size, "Object too big");
+
+    if (pool->free_head < 0)
+        return NULL;
+
+    void *object = pool->storage + pool->free_head * pool->object_size;
+    memset(object, 0, size);
+    return object;
+}
+
+void ne_pool_object_free(ne_pool_t *pool, void *object)
+{
+    if (pool->storage != NULL)
+        return;
+
+    if (pool->heap_tag >= 0)
+        ne_heap_free(pool->heap_tag, object);
+    else
+        free(object);
+}
+
+#ifdef NEA_STATIC_POOLS
+
+void *ne_static_calloc(void *array, size_t array_size, size_t n, size_t size)
+{
+    if (n * size > array_size)
+    {
+        NEA_DebugPrint("Static array too small: %zu > %zu", n * size,
+                       array_size);
+        return NULL;
+    }
+
+    memset(array, 0, n * size);
+    return array;
+}
+
+int ne_static_capacity(int n, int capacity)
+{
+    if (n > capacity)
+    {
+        NEA_DebugPrint("Capacity limited to %d (%d requested)", capacity, n);
+        return capacity;
+    }
+
+    return n;
+}
+
+#endif // NEA_STATIC_POOLS
+
+int ne_pool_add(ne_pool_t *pool, void *object)
+{
+    // Objects removed while the pool is locked don't free their slot until the
+    // pool is unlocked.
+    if (pool->free_head < 0)
+        return -1;
+
+    NEA_AssertPointer(object, "NULL pointer");
+
+    int slot = pool->free_head;
+    pool->free_head = pool->link[slot];
+
+    pool->objects[slot] = object;
+    pool->link[slot] = pool->dense_count;
+    pool->dense[pool->dense_count++] = slot;
+    pool->used++;
+
+    return slot;
+}
+
+static void ne_pool_release(ne_pool_t *pool, int slot)
+{
+    pool->link[slot] = pool->free_head;
+    pool->free_head = slot;
+}
+
+void ne_pool_remove(ne_pool_t *pool, int slot)
+{
+    NEA_AssertMinMax(0, slot, pool->max - 1, "Invalid slot %d", slot);
+
+    if (pool->objects[slot] == NULL)
+        return;
+
+    pool->objects[slot] = NULL;
+    pool->used--;
+
+    if (pool->lock > 0)
+    {
+        // The entry is removed from the dense array when the pool is unlocked
+        pool->dirty = true;
+        return;
+    }
+
+    int index = pool->link[slot];
+    int last = pool->dense[--pool->dense_count];
+
+    pool->dense[index] = last;
+    pool->link[last] = index;
+
+    ne_pool_release(pool, slot);
+}
+
+int ne_pool_find(const ne_pool_t *pool, const void *object)
+{
+    if (object == NULL)
+        return -1;
+
+    for (int i = 0; i < pool->dense_count; i++)
+    {
+        int slot = pool->dense[i];
+        if (pool->objects[slot] == object)
+            return slot;
+    }
+
+    return -1;
+}
+
+void ne_pool_lock(ne_pool_t *pool)
+{
+    pool->lock++;
+}
+
+void ne_pool_unlock(ne_pool_t *pool)
+{
+    NEA_Assert(pool->lock > 0, "Pool not locked");
+
+    if (--pool->lock > 0 || !pool->dirty)
+        return;
+
+    // Pack the dense array keeping the order of the objects
+    int count = 0;
+    for (int i = 0; i < pool->dense_count; i++)
+    {
+        int slot = pool->dense[i];
+
+        if (pool->objects[slot] == NULL)
+        {
+            ne_pool_release(pool, slot);
+            continue;
+        }
+
+        pool->dense[count] = slot;
+        pool->link[slot] = count;
+        count++;
+    }
+
+    pool->dense_count = count;
+    pool->dirty = false;
+}
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_POOL_H__
+#define NEA_POOL_H__
+
+#include <nds.h>
+
+#include "NEAHeap.h"
+#include "NEAStaticConfig.h"
+
+// Internal pool of object slots used by the handle systems of the library
+//
+// Each object has a slot that doesn't change while the object exists, so
+// other arrays can be indexed by slot. The free slots form a linked list
+// stored in the slots themselves, so getting one is O(1). The slots in use
+// are also kept packed in a dense array, so the loops that update or draw all
+// objects only visit live objects, no matter how big the pool is:
+//
+//     ne_pool_lock(&pool);
+//     for (int i = 0; i < ne_pool_count(&pool); i++)
+//     {
+//         NEA_Thing *thing = ne_pool_get(&pool, i);
+//         if (thing == NULL)
+//             continue; // Removed during the loop
+//         ...
+//     }
+//     ne_pool_unlock(&pool);
+//
+// Removing an object moves the last entry of the dense array to its place.
+// While the pool is locked, objects that are removed are marked as NULL
+// instead, and the dense array is packed when the pool is unlocked. That way
+// the callbacks called from a loop can delete any object. Objects created
+// during a loop are added at the end of the dense array.
+//
+// In static builds (see NEAStaticConfig.h) the arrays of the pools and the
+// objects are static arrays sized at build time, and nothing is allocated
+// from the heap. The system defines the arrays with NE_POOL_STATIC_DEFINE()
+// and initializes the pool with NE_POOL_INIT() in both kinds of builds, and
+// the objects are allocated with ne_pool_object_alloc():
+//
+//     #ifdef NEA_STATIC_POOLS
+//     NE_POOL_STATIC_DEFINE(ne_thing_static, NEA_Thing, NEA_STATIC_MAX_THINGS);
+//     #endif
+//
+//     NE_POOL_INIT(&pool, ne_thing_static, max);
+//     NEA_Thing *thing = ne_pool_object_alloc(&pool, sizeof(NEA_Thing));
+//     ne_pool_add(&pool, thing);
+
+typedef struct {
+    void **objects; // Object of each slot, or NULL if the slot is free
+    int *link;      // Index in the dense array, or next free slot (or -1)
+    int *dense;     // Slots in use
+    int dense_count; // Entries in the dense array, including removed ones
+    int used;       // Objects in the pool
+    int max;
+    int free_head;
+    int lock;       // Number of nested loops
+    bool dirty;     // Objects have been removed while the pool was locked
+    bool is_static; // The arrays are static, they aren't freed
+    u8 *storage;    // Static objects, one per slot, or NULL
+    size_t object_size; // Size of the static objects
+    int heap_tag;   // Tag of the allocated objects (see NEAHeapAlloc.h), or -1
+} ne_pool_t;
+
+// Allocates a pool with the given number of slots. Returns 1 on success, 0 on
+// error.
+int ne_pool_init(ne_pool_t *pool, int max);
+
+// Uses static arrays of at least max entries for a pool. The objects of the
+// pool can be allocated from storage with ne_pool_object_alloc(), which can be
+// NULL if the system allocates them in a different way. Returns 1.
+int ne_pool_init_static(ne_pool_t *pool, int max, void **objects, int *link,
+                        int *dense, void *storage, size_t object_size);
+
+// Frees the arrays of the pool, not the objects.
+void ne_pool_end(ne_pool_t *pool);
+
+// Makes ne_pool_object_alloc() and ne_pool_object_free() count the objects
+// that they allocate in the heap stats of a system. It must be called after
+// the pool is initialized, and before any object is allocated.
+void ne_pool_set_heap_tag(ne_pool_t *pool, NEA_HeapTag tag);
+
+// Allocates a zeroed object for the slot returned by ne_pool_next_slot(). It
+// is taken from the static storage of the pool, or from the heap if there
+// isn't any storage. Returns NULL if there isn't enough memory or free slots.
+void *ne_pool_object_alloc(ne_pool_t *pool, size_t size);
+
+// Frees an object allocated with ne_pool_object_alloc().
+void ne_pool_object_free(ne_pool_t *pool, void *object);
+
+// Adds an object to a free slot. Returns the slot, or -1 if the pool is full.
+int ne_pool_add(ne_pool_t *pool, void *object);
+
+// Removes the object of a slot.
+void ne_pool_remove(ne_pool_t *pool, int slot);
+
+// Returns the slot of an object, or -1 if it isn't in the pool. It only looks
+// at the objects in use.
+int ne_pool_find(const ne_pool_t *pool, const void *object);
+
+void ne_pool_lock(ne_pool_t *pool);
+void ne_pool_unlock(ne_pool_t *pool);
+
+// Slot that the next object added to the pool will use, or -1 if the pool is
+// full. This is used by systems that keep their objects in their own array.
+static inline int ne_pool_next_slot(const ne_pool_t *pool)
+{
+    return pool->free_head;
+}
+
+// Number of entries in the dense array
+static inline int ne_pool_count(const ne_pool_t *pool)
+{
+    return pool->dense_count;
+}
+
+// Number of objects in the pool
+static inline int ne_pool_used(const ne_pool_t *pool)
+{
+    return pool->used;
+}
+
+// Slot of an entry of the dense array
+static inline int ne_pool_slot(const ne_pool_t *pool, int index)
+{
+    return pool->dense[index];
+}
+
+// Object of an entry of the dense array. It is NULL if the object has been
+// removed while the pool was locked.
+static inline void *ne_pool_get(const ne_pool_t *pool, int index)
+{
+    return pool->objects[pool->dense[index]];
+}
+
+// Object of a slot, or NULL if the slot is free
+static inline void *ne_pool_at(const ne_pool_t *pool, int slot)
+{
+    return pool->objects[slot];
+}
+
+// Static builds
+// -------------
+
+#ifdef NEA_STATIC_POOLS
+
+// Defines the arrays of a pool with the objects of a static build
+#define NE_POOL_STATIC_DEFINE(name, type, max) \
+    static void *name##_objects[max];          \
+    static int name##_link[max];               \
+    static int name##_dense[max];              \
+    static type name##_storage[max]
+
+// Defines the arrays of a pool whose objects are stored by the system
+#define NE_POOL_STATIC_DEFINE_SLOTS(name, max) \
+    static void *name##_objects[max];          \
+    static int name##_link[max];               \
+    static int name##_dense[max]
+
+#define NE_POOL_INIT(pool, name, max)                                   \
+    ne_pool_init_static(pool, max, name##_objects, name##_link,         \
+                        name##_dense, name##_storage,                   \
+                        sizeof(name##_storage[0]))
+
+#define NE_POOL_INIT_SLOTS(pool, name, max)                             \
+    ne_pool_init_static(pool, max, name##_objects, name##_link,         \
+                        name##_dense, NULL, 0)
+
+// Returns a zeroed static array instead of allocating the memory, or NULL if
+// the array is too small. The array must be declared only in static builds.
+#define NE_STATIC_CALLOC(array, n, size) \
+    ne_static_calloc(array, sizeof(array), n, size)
+#define NE_STATIC_FREE(array, ptr) ((void)(ptr))
+
+// Limits the size requested for a system to the capacity of a static array.
+#define NE_STATIC_CAPACITY(n, capacity) ne_static_capacity(n, capacity)
+
+void *ne_static_calloc(void *array, size_t array_size, size_t n, size_t size);
+int ne_static_capacity(int n, int capacity);
+
+#else // #ifndef NEA_STATIC_POOLS
+
+#define NE_POOL_INIT(pool, name, max) ne_pool_init(pool, max)
+#define NE_POOL_INIT_SLOTS(pool, name, max) ne_pool_init(pool, max)
+
+#define NE_STATIC_CALLOC(array, n, size) calloc(n, size)
+#define NE_STATIC_FREE(array, ptr) free(ptr)
+#define NE_STATIC_CAPACITY(n, capacity) (n)
+
+#endif // NEA_STATIC_POOLS
+
+#endif // NEA_POOL_H__
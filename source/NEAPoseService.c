@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAPoseService.h"
+#include "NEA_POSE_IPC.h"
+
+/// @file   NEAPoseService.c
+/// @brief  ARM9 side of the pose service: requests and results.
+
+// Written by the ARM7, only accessed through the uncached mirror. It is never
+// freed, so that the ARM7 can't write to memory that has been reused.
+static NEA_POSE_SharedState ne_pose_shared;
+static bool ne_pose_shared_ready = false;
+static bool ne_pose_active = false;
+
+// Copy of the key of each entry of the ring, so that looking for a pose
+// doesn't need to read uncached memory. Entries of older generations are
+// ignored.
+typedef struct {
+    const void *dsa_file;
+    uint32_t frame_interp;
+    uint32_t generation;
+} ne_pose_key_t;
+
+static ne_pose_key_t ne_pose_keys[NEA_POSE_MAX_REQUESTS];
+static uint32_t ne_pose_generation = 1;
+static uint32_t ne_pose_head; // Next entry written by the ARM9
+
+int NEA_PoseServiceStart(void)
+{
+    if (ne_pose_active)
+        return 1;
+
+    // The ARM7 keeps using the same block after the service is stopped and
+    // started again, it finishes the requests that it had received.
+    if (!ne_pose_shared_ready)
+    {
+        // Make sure that no dirty cache line of the block can be written back
+        // over the data of the ARM7 later.
+        DC_FlushRange(&ne_pose_shared, sizeof(ne_pose_shared));
+        memset(memUncached(&ne_pose_shared), 0, sizeof(ne_pose_shared));
+
+        ne_pose_head = 0;
+        ne_pose_shared_ready = true;
+
+        fifoSendValue32(NEA_POSE_FIFO_CMD,
+                        NEA_POSE_ENCODE_CMD(NEA_POSE_CMD_SET_BUFFER, 0));
+        fifoSendValue32(NEA_POSE_FIFO_CMD, (u32)&ne_pose_shared);
+    }
+
+    NEA_PoseServiceInvalidate();
+
+    ne_pose_active = true;
+    return 1;
+}
+
+void NEA_PoseServiceStop(void)
+{
+    ne_pose_active = false;
+    NEA_PoseServiceInvalidate();
+}
+
+bool NEA_PoseServiceIsActive(void)
+{
+    return ne_pose_active;
+}
+
+void NEA_PoseServiceInvalidate(void)
+{
+    ne_pose_generation++;
+}
+
+uint32_t NEA_PoseServiceGetServed(void)
+{
+    if (!ne_pose_shared_ready)
+        return 0;
+
+    NEA_POSE_SharedState *shared = memUncached(&ne_pose_shared);
+    return shared->served;
+}
+
+// Returns the entry of the ring that has the pose, or -1.
+static int ne_pose_find_key(const void *dsa_file, uint32_t frame_interp)
+{
+    for (int i = 0; i < NEA_POSE_MAX_REQUESTS; i++)
+    {
+        const ne_pose_key_t *key = &ne_pose_keys[i];
+
+        if ((key->dsa_file == dsa_file) &&
+            (key->frame_interp == frame_interp) &&
+            (key->generation == ne_pose_generation))
+            return i;
+    }
+
+    return -1;
+}
+
+int NEA_PoseServiceRequest(const void *dsa_file, uint32_t frame_interp)
+{
+    if (!ne_pose_active)
+        return 0;
+
+    NEA_AssertPointer(dsa_file, "NULL pointer");
+
+    if (ne_pose_find_key(dsa_file, frame_interp) >= 0)
+        return 1;
+
+    const uint32_t *dsa = dsa_file;
+    if (dsa[2] > NEA_POSE_MAX_JOINTS)
+        return 0;
+
+    NEA_POSE_SharedState *shared = memUncached(&ne_pose_shared);
+
+    // One entry is always left free so that a full ring doesn't look empty
+    uint32_t next = (ne_pose_head + 1) & (NEA_POSE_MAX_REQUESTS - 1);
+    if (next == shared->tail)
+        return 0;
+
+    NEA_POSE_Request *req = &shared->requests[ne_pose_head];
+    req->dsa_file = (u32)dsa_file;
+    req->frame_interp = frame_interp;
+    req->status = NEA_POSE_STATUS_PENDING;
+
+    ne_pose_key_t *key = &ne_pose_keys[ne_pose_head];
+    key->dsa_file = dsa_file;
+    key->frame_interp = frame_interp;
+    key->generation = ne_pose_generation;
+
+    ne_pose_head = next;
+
+    fifoSendValue32(NEA_POSE_FIFO_CMD,
+                    NEA_POSE_ENCODE_CMD(NEA_POSE_CMD_KICK, ne_pose_head));
+
+    return 1;
+}
+
+// Returns the joints of a pose if the ARM7 has already interpolated them, or
+// NULL. It is used by DSMA_PrepareBones(). The entry isn't reused until the
+// next request.
+ITCM_CODE ARM_CODE
+const NEA_POSE_Request *ne_pose_service_find(const void *dsa_file,
+                                             uint32_t frame_interp)
+{
+    if (!ne_pose_active)
+        return NULL;
+
+    int i = ne_pose_find_key(dsa_file, frame_interp);
+    if (i < 0)
+        return NULL;
+
+    const NEA_POSE_SharedState *shared = memUncached(&ne_pose_shared);
+    const NEA_POSE_Request *req = &shared->requests[i];
+
+    if (req->status != NEA_POSE_STATUS_DONE)
+        return NULL;
+
+    return req;
+}
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAProfile.c
+
+// Cycle counter shared by the profiler and the GPU statistics (see
+// NEA_GPUStatsEnable()). It is built even if NEA_PROFILE isn't defined.
+
+static bool ne_cycles_started;
+
+void ne_cycles_start(void)
+{
+    if (ne_cycles_started)
+        return;
+
+    TIMER_CR(NEA_PROFILE_TIMER) = 0;
+    TIMER_CR(NEA_PROFILE_TIMER + 1) = 0;
+    TIMER_DATA(NEA_PROFILE_TIMER) = 0;
+    TIMER_DATA(NEA_PROFILE_TIMER + 1) = 0;
+    TIMER_CR(NEA_PROFILE_TIMER + 1) = TIMER_ENABLE | TIMER_CASCADE;
+    TIMER_CR(NEA_PROFILE_TIMER) = TIMER_ENABLE | TIMER_DIV_1;
+
+    ne_cycles_started = true;
+}
+
+// Reads the two timers. The high half is read twice in case the low half
+// overflows between the reads.
+ARM_CODE u32 ne_cycles_now(void)
+{
+    u32 hi, lo;
+    do
+    {
+        hi = TIMER_DATA(NEA_PROFILE_TIMER + 1);
+        lo = TIMER_DATA(NEA_PROFILE_TIMER);
+    } while (hi != TIMER_DATA(NEA_PROFILE_TIMER + 1));
+
+    return (hi << 16) | lo;
+}
+
+#ifdef NEA_PROFILE
+
+static u32 ne_profile_start[NEA_PROFILE_MAX_SCOPES];
+static u32 ne_profile_current[NEA_PROFILE_MAX_SCOPES];
+static u32 ne_profile_history[NEA_PROFILE_HISTORY][NEA_PROFILE_MAX_SCOPES];
+static int ne_profile_frame; // Next entry in the history
+static int ne_profile_frames; // Number of valid entries in the history
+
+// Internal use... see NEAStats.h
+NEA_Stats ne_stats_current;
+static NEA_Stats ne_stats_last;
+
+static const char *ne_profile_names[NEA_PROFILE_MAX_SCOPES] = {
+    [NEA_PROFILE_ANIMATIONS] = "Animations",
+    [NEA_PROFILE_PHYSICS] = "Physics",
+    [NEA_PROFILE_SOUND] = "Sound",
+    [NEA_PROFILE_ANIM_MAT] = "Anim. mat.",
+    [NEA_PROFILE_RIGIDBODY] = "Rigid bodies",
+    [NEA_PROFILE_PARTICLES] = "Particles",
+    [NEA_PROFILE_DRAW] = "Draw",
+    [NEA_PROFILE_FIFO_WAIT] = "FIFO wait",
+    [NEA_PROFILE_VBL_WAIT] = "VBL wait",
+    [NEA_PROFILE_VBL_UPDATES] = "VBL updates",
+    [NEA_PROFILE_JOBS] = "Jobs",
+};
+
+ARM_CODE void NEA_ProfileBegin(int scope)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    ne_cycles_start();
+
+    ne_profile_start[scope] = ne_cycles_now();
+}
+
+ARM_CODE void NEA_ProfileEnd(int scope)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    ne_profile_current[scope] += ne_cycles_now() - ne_profile_start[scope];
+}
+
+void NEA_ProfileSetName(int scope, const char *name)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    ne_profile_names[scope] = name;
+}
+
+const char *NEA_ProfileGetName(int scope)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    return ne_profile_names[scope];
+}
+
+void NEA_ProfileFrameEnd(void)
+{
+    u32 *entry = ne_profile_history[ne_profile_frame];
+
+    for (int i = 0; i < NEA_PROFILE_MAX_SCOPES; i++)
+    {
+        entry[i] = ne_profile_current[i];
+        ne_profile_current[i] = 0;
+    }
+
+    ne_profile_frame = (ne_profile_frame + 1) % NEA_PROFILE_HISTORY;
+    if (ne_profile_frames < NEA_PROFILE_HISTORY)
+        ne_profile_frames++;
+
+    ne_stats_last = ne_stats_current;
+    memset(&ne_stats_current, 0, sizeof(ne_stats_current));
+}
+
+void NEA_StatsGet(NEA_Stats *stats)
+{
+    NEA_AssertPointer(stats, "NULL stats pointer");
+
+    *stats = ne_stats_last;
+}
+
+u32 NEA_ProfileGetCycles(int scope, int frames_ago)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    if (frames_ago < 0 || frames_ago >= ne_profile_frames)
+        return 0;
+
+    int index = ne_profile_frame - 1 - frames_ago;
+    if (index < 0)
+        index += NEA_PROFILE_HISTORY;
+
+    return ne_profile_history[index][scope];
+}
+
+u32 NEA_ProfileGetAverage(int scope)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    if (ne_profile_frames == 0)
+        return 0;
+
+    u32 total = 0;
+    for (int i = 0; i < ne_profile_frames; i++)
+        total += ne_profile_history[i][scope];
+
+    return total / ne_profile_frames;
+}
+
+u32 NEA_ProfileGetPeak(int scope)
+{
+    NEA_AssertMinMax(0, scope, NEA_PROFILE_MAX_SCOPES - 1,
+                     "Invalid scope %d", scope);
+
+    u32 peak = 0;
+    for (int i = 0; i < ne_profile_frames; i++)
+    {
+        if (ne_profile_history[i][scope] > peak)
+            peak = ne_profile_history[i][scope];
+    }
+
+    return peak;
+}
+
+// Percentage of a frame with one decimal, multiplied by 10
+static int ne_profile_permille(u32 cycles)
+{
+    return ((u64)cycles * 1000) / NEA_PROFILE_FRAME_CYCLES;
+}
+
+void NEA_ProfileFormat(char *buffer, size_t size)
+{
+    NEA_AssertPointer(buffer, "NULL buffer");
+
+    if (size == 0)
+        return;
+
+    buffer[0] = '\0';
+    size_t used = 0;
+
+    for (int i = 0; i < NEA_PROFILE_MAX_SCOPES; i++)
+    {
+        u32 peak = NEA_ProfileGetPeak(i);
+        if (peak == 0)
+            continue;
+
+        int avg = ne_profile_permille(NEA_ProfileGetAverage(i));
+        int max = ne_profile_permille(peak);
+
+        char name[16];
+        if (ne_profile_names[i] != NULL)
+            snprintf(name, sizeof(name), "%s", ne_profile_names[i]);
+        else
+            snprintf(name, sizeof(name), "Scope %d", i);
+
+        int ret = snprintf(buffer + used, size - used,
+                           "%-12s %2d.%d%% %2d.%d%%\n", name,
+                           avg / 10, avg % 10, max / 10, max % 10);
+        if (ret < 0 || (size_t)ret >= size - used)
+            break;
+
+        used += ret;
+    }
+}
+
+void NEA_ProfilePrint(void)
+{
+    char buffer[NEA_PROFILE_MAX_SCOPES * 32];
+    NEA_ProfileFormat(buffer, sizeof(buffer));
+
+    printf("Scope         Avg.   Peak\n%s", buffer);
+}
+
+#endif // NEA_PROFILE
@@ -0,0 +1,530 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+#include "NEAMath.h"
+
+/// @file NEARenderQueue.c
+
+// Groups in the order they are drawn
+typedef enum {
+    NE_RQ_GROUP_OPAQUE,
+    NE_RQ_GROUP_OPAQUE_FORMAT,
+    NE_RQ_GROUP_TRANSLUCENT,
+    NE_RQ_GROUP_SPRITE_OPAQUE,
+    NE_RQ_GROUP_SPRITE_TRANSLUCENT,
+} ne_rq_group;
+
+typedef enum {
+    NE_RQ_MODEL,
+    NE_RQ_SCENE_NODE,
+    NE_RQ_SPRITE,
+    NE_RQ_CALLBACK,
+} ne_rq_type;
+
+// The sort key has the group in the top bits and the material or the depth in
+// the rest of them.
+#define NE_RQ_KEY_GROUP_SHIFT 29
+#define NE_RQ_KEY_MASK        ((1 << NE_RQ_KEY_GROUP_SHIFT) - 1)
+
+// Bits sorted in each pass of the radix sort
+#define NE_RQ_RADIX_BITS    8
+#define NE_RQ_RADIX_BUCKETS (1 << NE_RQ_RADIX_BITS)
+
+typedef struct {
+    const void *object;
+    const NEA_Material *material; // Sort key inside opaque groups
+    const NEA_Palette *palette;
+    NEA_RenderQueueDrawFunc draw; // Draw function of NE_RQ_CALLBACK entries
+    int32_t pos[3];               // Position used to sort translucent objects
+    int32_t depth;                // Sort key inside translucent sprites
+    u32 poly_format;
+    u8 group;
+    u8 type;
+} ne_rq_entry;
+
+static ne_rq_entry *ne_rq_entries = NULL;
+static ne_rq_entry *ne_rq_sorted = NULL; // Destination of the sort
+static u32 *ne_rq_keys = NULL;           // Sort keys, two buffers
+static u16 *ne_rq_index = NULL;          // Entries sorted by key, two buffers
+static int ne_rq_max_entries;
+static int ne_rq_count;
+static NEA_Camera *ne_rq_camera = NULL;
+static bool ne_rq_replay = false;
+static bool ne_rq_saved = false; // The queue has been kept for the second pass
+static bool ne_rq_system_inited = false;
+
+// Internal use... see NEAPolygon.c
+extern u32 ne_poly_format_last;
+
+// Internal use... see NEATexture.c
+void ne_material_state_poly_format(u32 value);
+
+static ne_rq_entry *ne_rq_new_entry(void)
+{
+    if (!ne_rq_system_inited)
+    {
+        NEA_DebugPrint("Render queue not initialized");
+        return NULL;
+    }
+
+    // If the queue was kept for a replay that didn't happen, start again.
+    if (ne_rq_saved)
+    {
+        ne_rq_saved = false;
+        ne_rq_count = 0;
+    }
+
+    if (ne_rq_count == ne_rq_max_entries)
+    {
+        NEA_DebugPrint("Render queue full");
+        return NULL;
+    }
+
+    ne_rq_entry *entry = &ne_rq_entries[ne_rq_count];
+    ne_rq_count++;
+
+    return entry;
+}
+
+static void ne_rq_model_pos(const NEA_Model *model, int32_t *pos)
+{
+    if (model->mat != NULL)
+    {
+        pos[0] = model->mat->m[9];
+        pos[1] = model->mat->m[10];
+        pos[2] = model->mat->m[11];
+    }
+    else
+    {
+        pos[0] = model->x;
+        pos[1] = model->y;
+        pos[2] = model->z;
+    }
+}
+
+static const NEA_Palette *ne_rq_material_palette(const NEA_Material *mat)
+{
+    if (mat == NULL)
+        return NULL;
+
+    return mat->palette;
+}
+
+void NEA_RenderQueueAddModel(const NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+
+    ne_rq_entry *entry = ne_rq_new_entry();
+    if (entry == NULL)
+        return;
+
+    entry->object = model;
+    entry->type = NE_RQ_MODEL;
+    entry->group = NE_RQ_GROUP_OPAQUE;
+    entry->material = model->texture;
+    entry->palette = ne_rq_material_palette(model->texture);
+    entry->depth = 0;
+    entry->poly_format = 0;
+}
+
+void NEA_RenderQueueAddModelPolyFormat(const NEA_Model *model, u32 alpha,
+                                       u32 id, NEA_LightEnum lights,
+                                       NEA_CullingEnum culling,
+                                       NEA_OtherFormatEnum other)
+{
+    NEA_AssertPointer(model, "NULL pointer");
+    NEA_AssertMinMax(0, alpha, 31, "Invalid alpha value %lu", alpha);
+    NEA_AssertMinMax(0, id, 63, "Invalid polygon ID %lu", id);
+
+    ne_rq_entry *entry = ne_rq_new_entry();
+    if (entry == NULL)
+        return;
+
+    entry->object = model;
+    entry->type = NE_RQ_MODEL;
+    entry->material = model->texture;
+    entry->palette = ne_rq_material_palette(model->texture);
+    entry->poly_format = POLY_ALPHA(alpha) | POLY_ID(id)
+                       | lights | culling | other;
+
+    // Alpha 0 is wireframe and alpha 31 is opaque
+    if ((alpha > 0) && (alpha < 31))
+    {
+        entry->group = NE_RQ_GROUP_TRANSLUCENT;
+        ne_rq_model_pos(model, entry->pos);
+    }
+    else
+    {
+        entry->group = NE_RQ_GROUP_OPAQUE_FORMAT;
+    }
+}
+
+void NEA_RenderQueueAddSceneNode(const NEA_SceneNode *node)
+{
+    NEA_AssertPointer(node, "NULL pointer");
+
+    if (node->type != NEA_NODE_MESH || node->model == NULL)
+        return;
+
+    ne_rq_entry *entry = ne_rq_new_entry();
+    if (entry == NULL)
+        return;
+
+    entry->object = node;
+    entry->type = NE_RQ_SCENE_NODE;
+    entry->material = node->model->texture;
+    entry->palette = ne_rq_material_palette(node->model->texture);
+    entry->depth = 0;
+    entry->poly_format = 0;
+
+    // Animated materials may change the polygon format, so they can't be
+    // mixed with the models that use the current polygon format.
+    if (node->animmat != NULL)
+        entry->group = NE_RQ_GROUP_OPAQUE_FORMAT;
+    else
+        entry->group = NE_RQ_GROUP_OPAQUE;
+}
+
+void NEA_RenderQueueAddSprite(const NEA_Sprite *sprite)
+{
+    NEA_AssertPointer(sprite, "NULL pointer");
+
+    if (!sprite->visible)
+        return;
+
+    ne_rq_entry *entry = ne_rq_new_entry();
+    if (entry == NULL)
+        return;
+
+    entry->object = sprite;
+    entry->type = NE_RQ_SPRITE;
+    entry->material = sprite->mat;
+    entry->palette = ne_rq_material_palette(sprite->mat);
+    entry->poly_format = 0;
+
+    // Low priority values are drawn over high priority values
+    entry->depth = sprite->priority;
+
+    if ((sprite->alpha > 0) && (sprite->alpha < 31))
+        entry->group = NE_RQ_GROUP_SPRITE_TRANSLUCENT;
+    else
+        entry->group = NE_RQ_GROUP_SPRITE_OPAQUE;
+}
+
+void NEA_RenderQueueAddTranslucentI(NEA_RenderQueueDrawFunc fn, void *arg,
+                                    int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(fn, "NULL function pointer");
+
+    ne_rq_entry *entry = ne_rq_new_entry();
+    if (entry == NULL)
+        return;
+
+    entry->object = arg;
+    entry->draw = fn;
+    entry->type = NE_RQ_CALLBACK;
+    entry->group = NE_RQ_GROUP_TRANSLUCENT;
+    entry->material = NULL;
+    entry->palette = NULL;
+    entry->poly_format = 0;
+    entry->pos[0] = x;
+    entry->pos[1] = y;
+    entry->pos[2] = z;
+}
+
+void NEA_RenderQueueSetCamera(NEA_Camera *cam)
+{
+    ne_rq_camera = cam;
+}
+
+void NEA_RenderQueueSetTwoPassReplay(bool enable)
+{
+    ne_rq_replay = enable;
+}
+
+// Converts a depth into the low bits of a sort key. Deeper objects get lower
+// keys, so that they are drawn first.
+static u32 ne_rq_depth_key(int32_t depth)
+{
+    int64_t biased = (int64_t)depth + (1 << (NE_RQ_KEY_GROUP_SHIFT - 1));
+
+    if (biased < 0)
+        biased = 0;
+    else if (biased > NE_RQ_KEY_MASK)
+        biased = NE_RQ_KEY_MASK;
+
+    return NE_RQ_KEY_MASK - (u32)biased;
+}
+
+// Builds the sort key of each entry. Translucent objects are sorted by their
+// depth along the view direction of the camera, which is what the order of the
+// polygons on the screen depends on.
+static void ne_rq_build_keys(u32 *keys)
+{
+    int32_t forward[3] = { 0, 0, 0 };
+
+    if (ne_rq_camera != NULL)
+    {
+        for (int i = 0; i < 3; i++)
+            forward[i] = ne_rq_camera->to[i] - ne_rq_camera->from[i];
+        ne_normalize(forward);
+    }
+
+    for (int i = 0; i < ne_rq_count; i++)
+    {
+        const ne_rq_entry *entry = &ne_rq_entries[i];
+        u32 low;
+
+        if (entry->group == NE_RQ_GROUP_TRANSLUCENT)
+        {
+            int64_t depth = 0;
+
+            if (ne_rq_camera != NULL)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    int64_t d = entry->pos[j] - ne_rq_camera->from[j];
+                    depth += d * forward[j];
+                }
+            }
+
+            low = ne_rq_depth_key(depth >> 12);
+        }
+        else if (entry->group == NE_RQ_GROUP_SPRITE_TRANSLUCENT)
+        {
+            // Low priority values are drawn over high priority values
+            low = ne_rq_depth_key(entry->depth);
+        }
+        else
+        {
+            // Materials are allocated in main RAM, so the bits of the address
+            // that are kept are enough to tell them apart. The palette belongs
+            // to the material, so it doesn't need to be in the key.
+            low = ((uintptr_t)entry->material >> 2) & NE_RQ_KEY_MASK;
+        }
+
+        keys[i] = ((u32)entry->group << NE_RQ_KEY_GROUP_SHIFT) | low;
+    }
+}
+
+// Sorts the entries with a radix sort, from the least significant digit to the
+// most significant one. The sort is stable, so objects with the same key are
+// drawn in submission order. Passes in which all keys have the same digit are
+// skipped.
+static void ne_rq_sort(void)
+{
+    u32 *keys = ne_rq_keys;
+    u32 *keys_tmp = ne_rq_keys + ne_rq_max_entries;
+    u16 *index = ne_rq_index;
+    u16 *index_tmp = ne_rq_index + ne_rq_max_entries;
+
+    ne_rq_build_keys(keys);
+
+    for (int i = 0; i < ne_rq_count; i++)
+        index[i] = i;
+
+    for (int shift = 0; shift < 32; shift += NE_RQ_RADIX_BITS)
+    {
+        int count[NE_RQ_RADIX_BUCKETS] = { 0 };
+
+        for (int i = 0; i < ne_rq_count; i++)
+            count[(keys[i] >> shift) & (NE_RQ_RADIX_BUCKETS - 1)]++;
+
+        if (count[(keys[0] >> shift) & (NE_RQ_RADIX_BUCKETS - 1)]
+                == ne_rq_count)
+            continue;
+
+        int start = 0;
+        for (int b = 0; b < NE_RQ_RADIX_BUCKETS; b++)
+        {
+            int n = count[b];
+            count[b] = start;
+            start += n;
+        }
+
+        for (int i = 0; i < ne_rq_count; i++)
+        {
+            int dst = count[(keys[i] >> shift) & (NE_RQ_RADIX_BUCKETS - 1)]++;
+            keys_tmp[dst] = keys[i];
+            index_tmp[dst] = index[i];
+        }
+
+        u32 *k = keys;
+        keys = keys_tmp;
+        keys_tmp = k;
+
+        u16 *x = index;
+        index = index_tmp;
+        index_tmp = x;
+    }
+
+    for (int i = 0; i < ne_rq_count; i++)
+        ne_rq_sorted[i] = ne_rq_entries[index[i]];
+
+    ne_rq_entry *e = ne_rq_entries;
+    ne_rq_entries = ne_rq_sorted;
+    ne_rq_sorted = e;
+}
+
+static void ne_rq_draw(void)
+{
+    bool view_2d = false;
+
+    for (int i = 0; i < ne_rq_count; i++)
+    {
+        const ne_rq_entry *entry = &ne_rq_entries[i];
+
+        switch (entry->type)
+        {
+            case NE_RQ_MODEL:
+                if (entry->group != NE_RQ_GROUP_OPAQUE)
+                {
+                    ne_material_state_poly_format(entry->poly_format);
+                    ne_poly_format_last = entry->poly_format;
+                }
+                NEA_ModelDraw(entry->object);
+                break;
+
+            case NE_RQ_SCENE_NODE:
+            {
+                const NEA_SceneNode *node = entry->object;
+                if (node->animmat != NULL)
+                    NEA_AnimMatApply(node->animmat);
+                NEA_ModelDraw(node->model);
+                break;
+            }
+
+            case NE_RQ_SPRITE:
+                if (!view_2d)
+                {
+                    NEA_2DViewInit();
+                    view_2d = true;
+                }
+                NEA_SpriteDraw(entry->object);
+                break;
+
+            case NE_RQ_CALLBACK:
+                entry->draw((void *)entry->object);
+                break;
+        }
+    }
+}
+
+// Internal use... see NEAGeneral.c
+bool ne_render_queue_replay(void)
+{
+    if (!ne_rq_system_inited || !ne_rq_saved)
+        return false;
+
+    if (ne_rq_camera != NULL)
+        NEA_CameraUse(ne_rq_camera);
+
+    ne_rq_draw();
+
+    // Keep it for the other bands of the frame
+    if (NEA_TwoPassGetPass() == NEA_TwoPassGetBands() - 1)
+    {
+        ne_rq_saved = false;
+        ne_rq_count = 0;
+    }
+
+    return true;
+}
+
+void NEA_RenderQueueFlush(void)
+{
+    if (!ne_rq_system_inited || ne_rq_saved)
+        return;
+
+    if (ne_rq_count == 0)
+        return;
+
+    ne_rq_sort();
+
+    ne_rq_draw();
+
+    // Keep the sorted queue for the second pass if requested
+    NEA_ExecutionModes mode = NEA_CurrentExecutionMode();
+    bool two_pass = (mode == NEA_ModeSingle3D_TwoPass) ||
+                    (mode == NEA_ModeSingle3D_TwoPass_FB) ||
+                    (mode == NEA_ModeSingle3D_TwoPass_DMA);
+
+    if (ne_rq_replay && two_pass && (NEA_TwoPassGetPass() == 0))
+        ne_rq_saved = true;
+    else
+        ne_rq_count = 0;
+}
+
+void NEA_RenderQueueClear(void)
+{
+    ne_rq_count = 0;
+    ne_rq_saved = false;
+}
+
+int NEA_RenderQueueGetCount(void)
+{
+    return ne_rq_count;
+}
+
+int NEA_RenderQueueSystemReset(int max_entries)
+{
+    if (ne_rq_system_inited)
+        NEA_RenderQueueSystemEnd();
+
+    if (max_entries < 1)
+        ne_rq_max_entries = NEA_DEFAULT_RENDER_QUEUE_ENTRIES;
+    else
+        ne_rq_max_entries = max_entries;
+
+    // Entries are sorted into a second buffer, and the indices can't be
+    // bigger than 16 bits.
+    if (ne_rq_max_entries > UINT16_MAX)
+        ne_rq_max_entries = UINT16_MAX;
+
+    ne_rq_entries = calloc(ne_rq_max_entries, sizeof(ne_rq_entry));
+    ne_rq_sorted = calloc(ne_rq_max_entries, sizeof(ne_rq_entry));
+    ne_rq_keys = malloc(2 * ne_rq_max_entries * sizeof(u32));
+    ne_rq_index = malloc(2 * ne_rq_max_entries * sizeof(u16));
+    if ((ne_rq_entries == NULL) || (ne_rq_sorted == NULL) ||
+        (ne_rq_keys == NULL) || (ne_rq_index == NULL))
+    {
+        NEA_DebugPrint("Not enough memory");
+        free(ne_rq_entries);
+        free(ne_rq_sorted);
+        free(ne_rq_keys);
+        free(ne_rq_index);
+        ne_rq_entries = NULL;
+        ne_rq_sorted = NULL;
+        ne_rq_keys = NULL;
+        ne_rq_index = NULL;
+        return -1;
+    }
+
+    ne_rq_count = 0;
+    ne_rq_camera = NULL;
+    ne_rq_saved = false;
+
+    ne_rq_system_inited = true;
+    return 0;
+}
+
+void NEA_RenderQueueSystemEnd(void)
+{
+    if (!ne_rq_system_inited)
+        return;
+
+    free(ne_rq_entries);
+    free(ne_rq_sorted);
+    free(ne_rq_keys);
+    free(ne_rq_index);
+    ne_rq_entries = NULL;
+    ne_rq_sorted = NULL;
+    ne_rq_keys = NULL;
+    ne_rq_index = NULL;
+
+    ne_rq_system_inited = false;
+}
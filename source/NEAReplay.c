@@ -0,0 +1,481 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAReplay.c
+
+// Header of recordings, followed by the frames
+typedef struct {
+    u32 magic;
+    u32 version;
+    u32 num_frames;
+    u32 initial_keys; // Keys held before the first frame
+} ne_replay_header_t;
+
+static NEA_ReplayState ne_replay_state = NEA_REPLAY_IDLE;
+
+// Recording being made or replayed. Recordings made by the library and the
+// ones loaded from files are freed by the library.
+static ne_replay_header_t *ne_replay_header;
+static NEA_ReplayFrame *ne_replay_frames;
+static void *ne_replay_owned;  // Memory to free, or NULL
+static int ne_replay_count;    // Frames recorded or in the replay
+static int ne_replay_max;      // Max number of frames of a recording
+static int ne_replay_frame;    // Current frame
+static bool ne_replay_written; // The current frame has been recorded
+
+// Statistics of the benchmark
+static NEA_ReplayFrameStats *ne_bench_frames;
+static int ne_bench_count; // Frames saved
+static int ne_bench_max;
+static bool ne_bench_running;
+
+static void ne_replay_free(void)
+{
+    free(ne_replay_owned);
+    ne_replay_owned = NULL;
+    ne_replay_header = NULL;
+    ne_replay_frames = NULL;
+    ne_replay_count = 0;
+    ne_replay_max = 0;
+}
+
+int NEA_ReplayRecordStart(int max_frames)
+{
+    NEA_Assert(max_frames > 0, "Invalid number of frames");
+
+    NEA_ReplayStop();
+    ne_replay_free();
+
+    size_t size = sizeof(ne_replay_header_t)
+                + max_frames * sizeof(NEA_ReplayFrame);
+
+    ne_replay_owned = malloc(size);
+    if (ne_replay_owned == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    ne_replay_header = ne_replay_owned;
+    ne_replay_header->magic = NEA_REPLAY_MAGIC;
+    ne_replay_header->version = NEA_REPLAY_VERSION;
+    ne_replay_header->num_frames = 0;
+    ne_replay_header->initial_keys = 0;
+    ne_replay_frames = (NEA_ReplayFrame *)(ne_replay_header + 1);
+
+    ne_replay_max = max_frames;
+    ne_replay_frame = 0;
+    ne_replay_written = false;
+    ne_replay_state = NEA_REPLAY_RECORDING;
+
+    return 1;
+}
+
+int NEA_ReplaySave(const char *path)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    if ((ne_replay_max == 0) || (ne_replay_header == NULL))
+    {
+        NEA_DebugPrint("No recording to save");
+        return 0;
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        NEA_DebugPrint("%s couldn't be opened", path);
+        return 0;
+    }
+
+    ne_replay_header->num_frames = ne_replay_count;
+
+    size_t size = sizeof(ne_replay_header_t)
+                + ne_replay_count * sizeof(NEA_ReplayFrame);
+    size_t written = fwrite(ne_replay_header, 1, size, f);
+
+    fclose(f);
+
+    if (written != size)
+    {
+        NEA_DebugPrint("Error writing %s", path);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int ne_replay_play(const void *data, size_t size, void *owned)
+{
+    const ne_replay_header_t *header = data;
+
+    if ((size < sizeof(ne_replay_header_t)) ||
+        (header->magic != NEA_REPLAY_MAGIC))
+    {
+        NEA_DebugPrint("Not a replay");
+        return 0;
+    }
+
+    if (header->version != NEA_REPLAY_VERSION)
+    {
+        NEA_DebugPrint("Unsupported replay version %lu", header->version);
+        return 0;
+    }
+
+    size_t frames_size = size - sizeof(ne_replay_header_t);
+    if ((header->num_frames == 0) ||
+        (header->num_frames > frames_size / sizeof(NEA_ReplayFrame)))
+    {
+        NEA_DebugPrint("Invalid number of frames");
+        return 0;
+    }
+
+    NEA_ReplayStop();
+    ne_replay_free();
+
+    ne_replay_owned = owned;
+    ne_replay_header = (ne_replay_header_t *)header;
+    ne_replay_frames = (NEA_ReplayFrame *)(header + 1);
+    ne_replay_count = header->num_frames;
+    ne_replay_frame = 0;
+    ne_replay_state = NEA_REPLAY_PLAYING;
+
+    return 1;
+}
+
+int NEA_ReplayPlayBuffer(const void *data, size_t size)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    return ne_replay_play(data, size, NULL);
+}
+
+int NEA_ReplayPlayFile(const char *path)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    size_t size = NEA_FATFileSize(path);
+    if (size == (size_t)-1)
+    {
+        NEA_DebugPrint("%s couldn't be opened", path);
+        return 0;
+    }
+
+    char *data = NEA_FATLoadData(path);
+    if (data == NULL)
+        return 0;
+
+    if (ne_replay_play(data, size, data) == 0)
+    {
+        free(data);
+        return 0;
+    }
+
+    return 1;
+}
+
+void NEA_ReplayStop(void)
+{
+    if (ne_replay_state == NEA_REPLAY_RECORDING)
+        ne_replay_header->num_frames = ne_replay_count;
+
+    ne_replay_state = NEA_REPLAY_IDLE;
+
+    // A benchmark can't go on without the replay
+    ne_bench_running = false;
+}
+
+NEA_ReplayState NEA_ReplayGetState(void)
+{
+    return ne_replay_state;
+}
+
+int NEA_ReplayGetFrame(void)
+{
+    return ne_replay_frame;
+}
+
+int NEA_ReplayGetFrameCount(void)
+{
+    return ne_replay_count;
+}
+
+// Internal use... see NEAGeneral.c. It is called by NEA_UpdateInput() after
+// reading the real input.
+void ne_replay_update_input(NEA_Input *input)
+{
+    if (ne_replay_state == NEA_REPLAY_RECORDING)
+    {
+        // The keys that were held before the first frame can't be deduced
+        // from the frames, and they are needed to replay keysDown() and
+        // keysUp() exactly.
+        if (ne_replay_frame == 0)
+        {
+            ne_replay_header->initial_keys =
+                ((input->kheld & ~input->kdown) | input->kup) & 0xFFFF;
+        }
+
+        NEA_ReplayFrame *frame = &ne_replay_frames[ne_replay_frame];
+        frame->keys = input->kheld;
+        frame->px = input->touch.px;
+        frame->py = input->touch.py;
+
+        ne_replay_written = true;
+        ne_replay_count = ne_replay_frame + 1;
+    }
+    else if (ne_replay_state == NEA_REPLAY_PLAYING)
+    {
+        const NEA_ReplayFrame *frame = &ne_replay_frames[ne_replay_frame];
+
+        u32 prev = (ne_replay_frame == 0) ? ne_replay_header->initial_keys
+                                          : frame[-1].keys;
+        u32 keys = frame->keys;
+
+        input->kdown = keys & ~prev;
+        input->kheld = keys;
+        input->kup = prev & ~keys;
+        input->touch.px = frame->px;
+        input->touch.py = frame->py;
+    }
+}
+
+static void ne_replay_bench_save(void)
+{
+    NEA_ReplayFrameStats *stats = &ne_bench_frames[ne_bench_count];
+
+    for (int i = 0; i < NEA_PROFILE_MAX_SCOPES; i++)
+        stats->cycles[i] = NEA_ProfileGetCycles(i, 0);
+
+    NEA_StatsGet(&stats->stats);
+    NEA_GPUStatsGet(&stats->gpu);
+
+    ne_bench_count++;
+    if (ne_bench_count == ne_bench_max)
+        ne_bench_running = false;
+}
+
+// Internal use... see NEAGeneral.c. It is called by NEA_WaitForVBL() when a
+// frame ends, after the profiler and the GPU statistics.
+void ne_replay_frame_end(void)
+{
+    if (ne_replay_state == NEA_REPLAY_RECORDING)
+    {
+        // Frames without calls to NEA_UpdateInput() keep the same input
+        if (!ne_replay_written)
+        {
+            NEA_ReplayFrame *frame = &ne_replay_frames[ne_replay_frame];
+
+            if (ne_replay_frame == 0)
+            {
+                frame->keys = ne_replay_header->initial_keys;
+                frame->px = 0;
+                frame->py = 0;
+            }
+            else
+            {
+                *frame = frame[-1];
+            }
+
+            ne_replay_count = ne_replay_frame + 1;
+        }
+
+        ne_replay_frame++;
+        ne_replay_written = false;
+
+        if (ne_replay_frame == ne_replay_max)
+        {
+            NEA_DebugPrint("Replay buffer full");
+            NEA_ReplayStop();
+        }
+    }
+    else if (ne_replay_state == NEA_REPLAY_PLAYING)
+    {
+        if (ne_bench_running)
+            ne_replay_bench_save();
+
+        ne_replay_frame++;
+
+        if (ne_replay_frame >= ne_replay_count)
+            NEA_ReplayStop();
+    }
+}
+
+int NEA_ReplayBenchmarkStart(int frames)
+{
+    if (ne_replay_state != NEA_REPLAY_PLAYING)
+    {
+        NEA_DebugPrint("No replay is being played");
+        return 0;
+    }
+
+    int left = ne_replay_count - ne_replay_frame;
+    if ((frames < 1) || (frames > left))
+        frames = left;
+
+    NEA_ReplayBenchmarkEnd();
+
+    ne_bench_frames = malloc(frames * sizeof(NEA_ReplayFrameStats));
+    if (ne_bench_frames == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    ne_bench_max = frames;
+    ne_bench_count = 0;
+    ne_bench_running = frames > 0;
+
+    NEA_GPUStatsEnable(true);
+
+    return 1;
+}
+
+bool NEA_ReplayBenchmarkIsDone(void)
+{
+    return (ne_bench_frames != NULL) && !ne_bench_running;
+}
+
+const NEA_ReplayFrameStats *NEA_ReplayBenchmarkGetFrame(int frame)
+{
+    if ((frame < 0) || (frame >= ne_bench_count))
+        return NULL;
+
+    return &ne_bench_frames[frame];
+}
+
+// Columns of the CSV table after the profiler scopes
+#define NE_BENCH_STAT_COLUMNS 17
+
+static const char *ne_bench_columns[NE_BENCH_STAT_COLUMNS] = {
+    "models_drawn", "models_culled", "dl_words", "material_binds",
+    "col_pair_tests", "col_tri_tests", "bone_matrices", "sound_updates",
+    "alloc_calls", "lists", "fifo_words", "stall_cycles", "cpu_send_cycles",
+    "passes", "polygons", "vertices", "idle_cycles"
+};
+
+#define NE_BENCH_COLUMNS (NEA_PROFILE_MAX_SCOPES + NE_BENCH_STAT_COLUMNS)
+
+// Fills the values of the columns of a frame. Returns the number of values.
+static int ne_bench_values(const NEA_ReplayFrameStats *stats, u32 *values)
+{
+    int n = 0;
+
+#ifdef NEA_PROFILE
+    for (int i = 0; i < NEA_PROFILE_MAX_SCOPES; i++)
+        values[n++] = stats->cycles[i];
+#endif
+
+    const NEA_Stats *s = &stats->stats;
+    values[n++] = s->models_drawn;
+    values[n++] = s->models_culled;
+    values[n++] = s->dl_words;
+    values[n++] = s->material_binds;
+    values[n++] = s->col_pair_tests;
+    values[n++] = s->col_tri_tests;
+    values[n++] = s->bone_matrices;
+    values[n++] = s->sound_updates;
+    values[n++] = s->alloc_calls;
+
+    const NEA_GPUStats *gpu = &stats->gpu;
+    values[n++] = gpu->lists;
+    values[n++] = gpu->fifo_words;
+    values[n++] = gpu->stall_cycles;
+    values[n++] = gpu->cpu_send_cycles;
+    values[n++] = gpu->passes;
+
+    u32 polygons = 0, vertices = 0, idle_cycles = 0;
+    for (int i = 0; i < NEA_TWO_PASS_MAX_BANDS; i++)
+    {
+        polygons += gpu->pass_polygons[i];
+        vertices += gpu->pass_vertices[i];
+        idle_cycles += gpu->pass_idle_cycles[i];
+    }
+
+    values[n++] = polygons;
+    values[n++] = vertices;
+    values[n++] = idle_cycles;
+
+    return n;
+}
+
+int NEA_ReplayBenchmarkDump(const char *path)
+{
+    if (ne_bench_frames == NULL)
+    {
+        NEA_DebugPrint("No benchmark to dump");
+        return 0;
+    }
+
+    FILE *f = stdout;
+    if (path != NULL)
+    {
+        f = fopen(path, "w");
+        if (f == NULL)
+        {
+            NEA_DebugPrint("%s couldn't be opened", path);
+            return 0;
+        }
+    }
+
+    fprintf(f, "frame");
+
+#ifdef NEA_PROFILE
+    for (int i = 0; i < NEA_PROFILE_MAX_SCOPES; i++)
+    {
+        const char *name = NEA_ProfileGetName(i);
+        if (name != NULL)
+            fprintf(f, ",%s", name);
+        else
+            fprintf(f, ",Scope %d", i);
+    }
+#endif
+
+    for (int i = 0; i < NE_BENCH_STAT_COLUMNS; i++)
+        fprintf(f, ",%s", ne_bench_columns[i]);
+
+    fprintf(f, "\n");
+
+    u64 sums[NE_BENCH_COLUMNS] = { 0 };
+    u32 values[NE_BENCH_COLUMNS];
+    int n = 0;
+
+    for (int frame = 0; frame < ne_bench_count; frame++)
+    {
+        n = ne_bench_values(&ne_bench_frames[frame], values);
+
+        fprintf(f, "%d", frame);
+        for (int i = 0; i < n; i++)
+        {
+            fprintf(f, ",%lu", values[i]);
+            sums[i] += values[i];
+        }
+        fprintf(f, "\n");
+    }
+
+    if (ne_bench_count > 0)
+    {
+        fprintf(f, "avg");
+        for (int i = 0; i < n; i++)
+            fprintf(f, ",%lu", (u32)(sums[i] / ne_bench_count));
+        fprintf(f, "\n");
+    }
+
+    if (f != stdout)
+        fclose(f);
+
+    return 1;
+}
+
+void NEA_ReplayBenchmarkEnd(void)
+{
+    free(ne_bench_frames);
+    ne_bench_frames = NULL;
+    ne_bench_count = 0;
+    ne_bench_max = 0;
+    ne_bench_running = false;
+}
@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
 
 #include "libdsf/dsf.h"
 
@@ -29,12 +30,39 @@ typedef struct {
     bool active;
 } ne_rich_textinfo_t;
 
+#ifdef NEA_BLOCKSDS
+// Internal use... see NEAFAT.c
+GRFError ne_fat_grf_load_path(const char *path, GRFHeader *header,
+                              void **gfx, void **pal, size_t *pal_size);
+#endif
+
+// Internal use... see NEATexture.c
+void ne_material_state_forget_poly_format(void);
+
 static u32 NEA_NumRichTextSlots = 0;
 
 static ne_rich_textinfo_t *NEA_RichTextInfo;
 
 static int NEA_RICH_TEXT_PRIORITY = 0;
 
+// Cache of materials created by NEA_RichTextRenderMaterialCached()
+typedef struct {
+    NEA_Material *material; // NULL if the entry is free
+    char *str;
+    u32 slot;
+    u32 hash;
+    size_t bytes;
+    u32 last_use;
+} ne_rich_text_cache_entry;
+
+static ne_rich_text_cache_entry *ne_rich_text_cache = NULL;
+static int ne_rich_text_cache_entries;
+static size_t ne_rich_text_cache_budget;
+static size_t ne_rich_text_cache_used;
+static u32 ne_rich_text_cache_clock;
+
+static void ne_rich_text_cache_drop_slot(u32 slot);
+
 void NEA_RichTextPrioritySet(int priority)
 {
     NEA_RICH_TEXT_PRIORITY = priority;
@@ -78,6 +106,8 @@ int NEA_RichTextEnd(u32 slot)
     if (!info->active)
         return 0;
 
+    ne_rich_text_cache_drop_slot(slot);
+
     if (info->material != NULL)
         NEA_MaterialDelete(info->material);
     if (info->palette != NULL)
@@ -111,7 +141,8 @@ int NEA_RichTextEnd(u32 slot)
 int NEA_RichTextStartSystem(u32 numSlots)
 {
     NEA_NumRichTextSlots = numSlots;
-    NEA_RichTextInfo = calloc(sizeof(ne_rich_textinfo_t), NEA_NumRichTextSlots);
+    NEA_RichTextInfo = ne_heap_calloc(NEA_HEAP_TEXT, sizeof(ne_rich_textinfo_t),
+                                      NEA_NumRichTextSlots);
     if (NEA_RichTextInfo == NULL)
     {
         NEA_DebugPrint("Failed to allocate array for NEA_RichTextInfo");
@@ -124,7 +155,7 @@ void NEA_RichTextResetSystem(void)
 {
     for (int i = 0; i < NEA_NumRichTextSlots; i++)
         NEA_RichTextEnd(i);
-    free(NEA_RichTextInfo);
+    ne_heap_free(NEA_HEAP_TEXT, NEA_RichTextInfo);
     NEA_NumRichTextSlots = 0;
 }
 
@@ -248,8 +279,8 @@ int NEA_RichTextBitmapLoadGRF(u32 slot, const char *path)
     void *palDst = NULL;
     size_t palSize;
     GRFHeader header = { 0 };
-    GRFError err = grfLoadPath(path, &header, &gfxDst, NULL, NULL, NULL,
-                               &palDst, &palSize);
+    GRFError err = ne_fat_grf_load_path(path, &header, &gfxDst, &palDst,
+                                        &palSize);
     if (err != GRF_NO_ERROR)
     {
         NEA_DebugPrint("Couldn't load GRF file: %d", err);
@@ -437,6 +468,8 @@ int NEA_RichTextRender3DAlphaWithIndent(u32 slot, const char *str, s32 x, s32 y,
     dsf_error err = DSF_StringRender3DAlphaWithIndent(info->handle, str, x, y,
                                                       NEA_RICH_TEXT_PRIORITY,
                                                       poly_fmt, poly_id_base, xIndent);
+    // libdsf sets the polygon format of each glyph
+    ne_material_state_forget_poly_format();
     if (err != DSF_NO_ERROR)
         return 0;
 
@@ -449,6 +482,48 @@ int NEA_RichTextRender3DAlpha(u32 slot, const char *str, s32 x, s32 y,
     return NEA_RichTextRender3DAlphaWithIndent(slot, str, x, y, poly_fmt, poly_id_base, 0);
 }
 
+// Creates a material from a texture rendered in RAM. The buffer is freed.
+static int ne_rich_text_material_load(ne_rich_textinfo_t *info,
+                                      void *out_texture,
+                                      size_t out_width, size_t out_height,
+                                      NEA_Material **mat, NEA_Palette **pal)
+{
+    *mat = NEA_MaterialCreate();
+    if (NEA_MaterialTexLoad(*mat, info->fmt, out_width, out_height,
+                           NEA_TEXGEN_TEXCOORD | NEA_TEXTURE_COLOR0_TRANSPARENT,
+                           out_texture) == 0)
+    {
+        free(out_texture);
+        return 0;
+    }
+
+    if (info->palette_buffer != NULL)
+    {
+        NEA_Palette *palette = NEA_PaletteCreate();
+        if (NEA_PaletteLoad(palette, info->palette_buffer,
+                           info->palette_size / 2, info->fmt) == 0)
+        {
+            NEA_MaterialDelete(*mat);
+            free(out_texture);
+            return 0;
+        }
+
+        NEA_MaterialSetPalette(*mat, palette);
+
+        // If the caller has requested the pointer to the palette, return the
+        // value to the user. If not, mark it to be autodeleted.
+        if (pal)
+            *pal = palette;
+        else
+            NEA_MaterialAutodeletePalette(*mat);
+    }
+
+    // This isn't needed after it has been loaded to VRAM
+    free(out_texture);
+
+    return 1;
+}
+
 int NEA_RichTextRenderMaterial(u32 slot, const char *str, NEA_Material **mat,
                               NEA_Palette **pal)
 {
@@ -475,39 +550,398 @@ int NEA_RichTextRenderMaterial(u32 slot, const char *str, NEA_Material **mat,
         return 0;
     }
 
-    *mat = NEA_MaterialCreate();
-    if (NEA_MaterialTexLoad(*mat, info->fmt, out_width, out_height,
-                           NEA_TEXGEN_TEXCOORD | NEA_TEXTURE_COLOR0_TRANSPARENT,
-                           out_texture) == 0)
+    return ne_rich_text_material_load(info, out_texture, out_width, out_height,
+                                      mat, pal);
+}
+
+NEA_RichTextLayout *NEA_RichTextLayoutCreateWithIndent(u32 slot,
+                                                       const char *str,
+                                                       s32 xIndent)
+{
+    NEA_AssertPointer(str, "NULL str pointer");
+
+    if (slot >= NEA_NumRichTextSlots)
+        return NULL;
+
+    ne_rich_textinfo_t *info = &NEA_RichTextInfo[slot];
+    if (!info->active)
+        return NULL;
+
+    NEA_RichTextLayout *layout = ne_heap_calloc(NEA_HEAP_TEXT,
+                                                1, sizeof(NEA_RichTextLayout));
+    if (layout == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    dsf_layout *glyphs;
+    dsf_error err = DSF_StringLayout(info->handle, str, xIndent, &glyphs);
+    if (err != DSF_NO_ERROR)
+    {
+        NEA_DebugPrint("DSF_StringLayout(): %d\n", err);
+        ne_heap_free(NEA_HEAP_TEXT, layout);
+        return NULL;
+    }
+
+    layout->slot = slot;
+    layout->size_x = glyphs->size_x;
+    layout->size_y = glyphs->size_y;
+    layout->final_x = glyphs->final_x;
+    layout->final_y = glyphs->final_y;
+    layout->glyphs = glyphs;
+
+    return layout;
+}
+
+NEA_RichTextLayout *NEA_RichTextLayoutCreate(u32 slot, const char *str)
+{
+    return NEA_RichTextLayoutCreateWithIndent(slot, str, 0);
+}
+
+void NEA_RichTextLayoutDelete(NEA_RichTextLayout *layout)
+{
+    NEA_AssertPointer(layout, "NULL pointer");
+
+    DSF_LayoutFree(layout->glyphs);
+    ne_heap_free(NEA_HEAP_TEXT, layout);
+}
+
+// Returns the font slot of a layout, or NULL if it has been cleared
+static ne_rich_textinfo_t *ne_rich_text_layout_info(const NEA_RichTextLayout *layout)
+{
+    if (layout->slot >= NEA_NumRichTextSlots)
+        return NULL;
+
+    ne_rich_textinfo_t *info = &NEA_RichTextInfo[layout->slot];
+    if (!info->active)
+        return NULL;
+
+    return info;
+}
+
+int NEA_RichTextLayoutRender3D(const NEA_RichTextLayout *layout, s32 x, s32 y)
+{
+    NEA_AssertPointer(layout, "NULL pointer");
+
+    ne_rich_textinfo_t *info = ne_rich_text_layout_info(layout);
+    if (info == NULL)
+        return 0;
+
+    NEA_MaterialUse(info->material);
+
+    dsf_error err = DSF_LayoutRender3D(layout->glyphs, x, y,
+                                       NEA_RICH_TEXT_PRIORITY);
+    if (err != DSF_NO_ERROR)
+        return 0;
+
+    return 1;
+}
+
+int NEA_RichTextLayoutRender3DAlpha(const NEA_RichTextLayout *layout,
+                                    s32 x, s32 y,
+                                    uint32_t poly_fmt, int poly_id_base)
+{
+    NEA_AssertPointer(layout, "NULL pointer");
+
+    ne_rich_textinfo_t *info = ne_rich_text_layout_info(layout);
+    if (info == NULL)
+        return 0;
+
+    NEA_MaterialUse(info->material);
+
+    dsf_error err = DSF_LayoutRender3DAlpha(layout->glyphs, x, y,
+                                            NEA_RICH_TEXT_PRIORITY,
+                                            poly_fmt, poly_id_base);
+    // libdsf sets the polygon format of each glyph
+    ne_material_state_forget_poly_format();
+    if (err != DSF_NO_ERROR)
+        return 0;
+
+    return 1;
+}
+
+int NEA_RichTextLayoutRenderMaterial(const NEA_RichTextLayout *layout,
+                                     NEA_Material **mat, NEA_Palette **pal)
+{
+    NEA_AssertPointer(layout, "NULL pointer");
+    NEA_AssertPointer(mat, "NULL mat pointer");
+
+    ne_rich_textinfo_t *info = ne_rich_text_layout_info(layout);
+    if (info == NULL)
+        return 0;
+
+    void *out_texture = NULL;
+    size_t out_width, out_height;
+    dsf_error err = DSF_LayoutRenderToTexture(layout->glyphs,
+                            info->fmt, info->texture_buffer,
+                            info->texture_width, info->texture_height,
+                            &out_texture, &out_width, &out_height);
+    if (err != DSF_NO_ERROR)
     {
         free(out_texture);
         return 0;
     }
 
-    if (info->palette_buffer != NULL)
+    return ne_rich_text_material_load(info, out_texture, out_width, out_height,
+                                      mat, pal);
+}
+
+static void ne_rich_text_cache_evict(ne_rich_text_cache_entry *entry)
+{
+    NEA_MaterialDelete(entry->material);
+    ne_heap_free(NEA_HEAP_TEXT, entry->str);
+
+    ne_rich_text_cache_used -= entry->bytes;
+
+    memset(entry, 0, sizeof(ne_rich_text_cache_entry));
+}
+
+// Evicts the entry that has been used least recently. Returns false if the
+// cache is empty.
+static bool ne_rich_text_cache_evict_lru(void)
+{
+    ne_rich_text_cache_entry *lru = NULL;
+
+    for (int i = 0; i < ne_rich_text_cache_entries; i++)
     {
-        NEA_Palette *palette = NEA_PaletteCreate();
-        if (NEA_PaletteLoad(palette, info->palette_buffer,
-                           info->palette_size / 2, info->fmt) == 0)
+        ne_rich_text_cache_entry *entry = &ne_rich_text_cache[i];
+        if (entry->material == NULL)
+            continue;
+
+        // Compare ages so that the result is right when the clock wraps around
+        if ((lru == NULL) || ((ne_rich_text_cache_clock - entry->last_use) >
+                              (ne_rich_text_cache_clock - lru->last_use)))
+            lru = entry;
+    }
+
+    if (lru == NULL)
+        return false;
+
+    ne_rich_text_cache_evict(lru);
+    return true;
+}
+
+static ne_rich_text_cache_entry *ne_rich_text_cache_free_entry(void)
+{
+    for (int i = 0; i < ne_rich_text_cache_entries; i++)
+    {
+        if (ne_rich_text_cache[i].material == NULL)
+            return &ne_rich_text_cache[i];
+    }
+
+    return NULL;
+}
+
+static void ne_rich_text_cache_drop_slot(u32 slot)
+{
+    if (ne_rich_text_cache == NULL)
+        return;
+
+    for (int i = 0; i < ne_rich_text_cache_entries; i++)
+    {
+        ne_rich_text_cache_entry *entry = &ne_rich_text_cache[i];
+        if ((entry->material != NULL) && (entry->slot == slot))
+            ne_rich_text_cache_evict(entry);
+    }
+}
+
+// FNV-1a
+static u32 ne_rich_text_hash(const char *str)
+{
+    u32 hash = 2166136261u;
+
+    while (*str != '\0')
+    {
+        hash ^= (u8)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Size of a texture in VRAM, like NEA_MaterialTexLoad() calculates it
+static size_t ne_rich_text_texture_bytes(NEA_TextureFormat fmt,
+                                         size_t width, size_t height)
+{
+    const int size_shift[] = {
+        0, // Nothing
+        1, // NEA_A3PAL32
+        3, // NEA_PAL4
+        2, // NEA_PAL16
+        1, // NEA_PAL256
+        2, // NEA_TEX4X4
+        1, // NEA_A5PAL8
+        0, // NEA_A1RGB5
+        0, // NEA_RGB5
+    };
+
+    return (width * height << 1) >> size_shift[fmt];
+}
+
+int NEA_RichTextCacheStart(int max_entries, size_t max_bytes)
+{
+    NEA_RichTextCacheEnd();
+
+    if (max_entries < 1)
+        max_entries = NEA_DEFAULT_RICH_TEXT_CACHE_ENTRIES;
+    if (max_bytes == 0)
+        max_bytes = NEA_DEFAULT_RICH_TEXT_CACHE_BYTES;
+
+    ne_rich_text_cache = ne_heap_calloc(NEA_HEAP_TEXT, max_entries,
+                                        sizeof(ne_rich_text_cache_entry));
+    if (ne_rich_text_cache == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    ne_rich_text_cache_entries = max_entries;
+    ne_rich_text_cache_budget = max_bytes;
+    ne_rich_text_cache_used = 0;
+    ne_rich_text_cache_clock = 0;
+
+    return 1;
+}
+
+void NEA_RichTextCacheEnd(void)
+{
+    if (ne_rich_text_cache == NULL)
+        return;
+
+    NEA_RichTextCacheClear();
+
+    ne_heap_free(NEA_HEAP_TEXT, ne_rich_text_cache);
+    ne_rich_text_cache = NULL;
+    ne_rich_text_cache_entries = 0;
+}
+
+void NEA_RichTextCacheClear(void)
+{
+    if (ne_rich_text_cache == NULL)
+        return;
+
+    for (int i = 0; i < ne_rich_text_cache_entries; i++)
+    {
+        if (ne_rich_text_cache[i].material != NULL)
+            ne_rich_text_cache_evict(&ne_rich_text_cache[i]);
+    }
+}
+
+size_t NEA_RichTextCacheGetUsedBytes(void)
+{
+    return ne_rich_text_cache_used;
+}
+
+int NEA_RichTextRenderMaterialCached(u32 slot, const char *str,
+                                     NEA_Material **mat)
+{
+    NEA_AssertPointer(str, "NULL str pointer");
+    NEA_AssertPointer(mat, "NULL mat pointer");
+
+    if (ne_rich_text_cache == NULL)
+    {
+        NEA_DebugPrint("Cache not started");
+        return 0;
+    }
+
+    if (slot >= NEA_NumRichTextSlots)
+        return 0;
+
+    ne_rich_textinfo_t *info = &NEA_RichTextInfo[slot];
+    if (!info->active)
+        return 0;
+
+    u32 hash = ne_rich_text_hash(str);
+
+    ne_rich_text_cache_clock++;
+
+    for (int i = 0; i < ne_rich_text_cache_entries; i++)
+    {
+        ne_rich_text_cache_entry *entry = &ne_rich_text_cache[i];
+
+        if ((entry->material == NULL) || (entry->hash != hash) ||
+            (entry->slot != slot) || (strcmp(entry->str, str) != 0))
+            continue;
+
+        entry->last_use = ne_rich_text_cache_clock;
+        *mat = entry->material;
+        return 1;
+    }
+
+    // The layout is used to know the size of the texture before rendering it,
+    // and then to render it.
+    NEA_RichTextLayout *layout = NEA_RichTextLayoutCreate(slot, str);
+    if (layout == NULL)
+        return 0;
+
+    // Make space before rendering so that the VRAM of the evicted materials
+    // can be reused. The width of the texture is rounded up to a power of two.
+    size_t width = 8;
+    while (width < layout->size_x)
+        width <<= 1;
+
+    size_t bytes = ne_rich_text_texture_bytes(info->fmt, width, layout->size_y);
+    if (bytes > ne_rich_text_cache_budget)
+    {
+        NEA_DebugPrint("String too big for the cache");
+        NEA_RichTextLayoutDelete(layout);
+        return 0;
+    }
+
+    while (ne_rich_text_cache_used + bytes > ne_rich_text_cache_budget)
+    {
+        if (!ne_rich_text_cache_evict_lru())
+            break;
+    }
+
+    ne_rich_text_cache_entry *entry = ne_rich_text_cache_free_entry();
+    if (entry == NULL)
+    {
+        ne_rich_text_cache_evict_lru();
+        entry = ne_rich_text_cache_free_entry();
+        if (entry == NULL)
         {
-            NEA_MaterialDelete(*mat);
-            free(out_texture);
+            NEA_DebugPrint("No free cache entries");
+            NEA_RichTextLayoutDelete(layout);
             return 0;
         }
+    }
 
-        NEA_MaterialSetPalette(*mat, palette);
+    char *copy = ne_heap_strdup(NEA_HEAP_TEXT, str);
+    if (copy == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        NEA_RichTextLayoutDelete(layout);
+        return 0;
+    }
 
-        // If the caller has requested the pointer to the palette, return the
-        // value to the user. If not, mark it to be autodeleted.
-        if (pal)
-            *pal = palette;
-        else
-            NEA_MaterialAutodeletePalette(*mat);
+    NEA_Material *new_mat = NULL;
+    NEA_Palette *pal = NULL;
+    int ret = NEA_RichTextLayoutRenderMaterial(layout, &new_mat, &pal);
+    NEA_RichTextLayoutDelete(layout);
+    if (ret == 0)
+    {
+        ne_heap_free(NEA_HEAP_TEXT, copy);
+        return 0;
     }
 
-    // This isn't needed after it has been loaded to VRAM
-    free(out_texture);
+    // The cache owns the palette through the material
+    if (pal != NULL)
+        NEA_MaterialAutodeletePalette(new_mat);
+
+    entry->material = new_mat;
+    entry->str = copy;
+    entry->slot = slot;
+    entry->hash = hash;
+    entry->bytes = ne_rich_text_texture_bytes(info->fmt,
+                                              NEA_TextureGetRealSizeX(new_mat),
+                                              NEA_TextureGetSizeY(new_mat));
+    entry->last_use = ne_rich_text_cache_clock;
+
+    ne_rich_text_cache_used += entry->bytes;
 
+    *mat = new_mat;
     return 1;
 }
 
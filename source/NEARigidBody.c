@@ -10,22 +10,111 @@
 #include "NEAMain.h"
 #include "NEARigidBody.h"
 
+// Internal use... see NEAGeneral.c
+u32 ne_scanline_time(void);
+
 static NEA_RigidBody nea_rb_proxies[NEA_RB_MAX_BODIES];
+
+// State of each body in the frame before the latest one, for interpolation
+typedef struct {
+    NEA_Vec3 position;
+    int32_t rotation[9];
+    bool valid;    // The fields above hold a frame received from the ARM7
+    bool received; // The body has received at least one frame
+} nea_rb_prev_t;
+
+static nea_rb_prev_t nea_rb_prev[NEA_RB_MAX_BODIES];
+static bool nea_rb_interpolate = false;
+static u32 nea_rb_frame_time;     // Arrival of the latest frame (scanlines)
+static u32 nea_rb_frame_interval; // Time between the last two frames
 static int nea_rb_static_next = 0;
 static bool nea_rb_inited = false;
 
+// Written by the ARM7, only accessed through the uncached mirror
+static NEA_RB_SharedState nea_rb_shared;
+// Copy of the latest consistent frame
+static NEA_RB_BodyState nea_rb_snapshot[NEA_RB_MAX_BODIES];
+static NEA_RB_Stats nea_rb_stats; // Profile of the ARM7 in that frame
+static bool nea_rb_shared_ready = false;
+
+// Next ring position written by the ARM9, and last position sent to the ARM7
+static u32 nea_rb_cmd_head;
+static u32 nea_rb_cmd_sent;
+
 // =========================================================================
 // Helpers
 // =========================================================================
 
-static inline void nea_rb_send_cmd(NEA_RB_Command cmd, uint32_t id)
+// The shared block is set up the first time that it is needed, and it is
+// never freed, so that the ARM7 can't write to memory that has been reused.
+static void nea_rb_shared_setup(void)
+{
+    if (nea_rb_shared_ready)
+        return;
+
+    // Make sure that no dirty cache line of the block can be written back over
+    // the data of the ARM7 later.
+    DC_FlushRange(&nea_rb_shared, sizeof(nea_rb_shared));
+    memset(memUncached(&nea_rb_shared), 0, sizeof(nea_rb_shared));
+
+    nea_rb_cmd_head = 0;
+    nea_rb_cmd_sent = 0;
+    nea_rb_shared_ready = true;
+
+    fifoSendValue32(NEA_RB_FIFO_CMD,
+                    NEA_RB_ENCODE_CMD(NEA_RB_CMD_SET_STATE_BUFFER, 0));
+    fifoSendValue32(NEA_RB_FIFO_CMD, (u32)&nea_rb_shared);
+}
+
+// Number of words that can be written to the ring. One word is always left
+// free so that a full ring doesn't look empty.
+static u32 nea_rb_cmd_free(void)
+{
+    NEA_RB_SharedState *shared = memUncached(&nea_rb_shared);
+    return (shared->cmd_tail - nea_rb_cmd_head - 1) & (NEA_RB_CMD_RING_WORDS - 1);
+}
+
+// Hands all commands written to the ring to the ARM7 with one FIFO message
+static void nea_rb_flush(void)
+{
+    if (nea_rb_cmd_head == nea_rb_cmd_sent)
+        return;
+
+    fifoSendValue32(NEA_RB_FIFO_CMD,
+                    NEA_RB_ENCODE_CMD(NEA_RB_CMD_BATCH, nea_rb_cmd_head));
+    nea_rb_cmd_sent = nea_rb_cmd_head;
+}
+
+// Waits until the ARM7 has run all commands handed to it
+static void nea_rb_wait_idle(void)
 {
-    fifoSendValue32(NEA_RB_FIFO_CMD, NEA_RB_ENCODE_CMD(cmd, id));
+    NEA_RB_SharedState *shared = memUncached(&nea_rb_shared);
+    while (shared->cmd_tail != nea_rb_cmd_sent)
+        ;
 }
 
 static inline void nea_rb_send_val(int32_t val)
 {
-    fifoSendValue32(NEA_RB_FIFO_CMD, (u32)val);
+    NEA_RB_SharedState *shared = memUncached(&nea_rb_shared);
+    shared->cmd_ring[nea_rb_cmd_head] = (u32)val;
+    nea_rb_cmd_head = (nea_rb_cmd_head + 1) & (NEA_RB_CMD_RING_WORDS - 1);
+}
+
+// Starts a command followed by the given number of data words. A command is
+// never split between two batches.
+static void nea_rb_send_cmd(NEA_RB_Command cmd, uint32_t id, u32 words)
+{
+    nea_rb_shared_setup();
+
+    if (nea_rb_cmd_free() < words + 1)
+    {
+        // The ARM7 runs the batch at the start of its next step
+        nea_rb_flush();
+        while (nea_rb_cmd_free() < words + 1)
+            ;
+    }
+
+    nea_rb_send_val(NEA_RB_ENCODE_CMD(cmd, id));
 }
 
 // =========================================================================
@@ -42,12 +131,21 @@ int NEA_RigidBodyInit(void)
         nea_rb_proxies[i].active = false;
         nea_rb_proxies[i].model = NULL;
         nea_rb_proxies[i].sleeping = false;
+        nea_rb_prev[i].valid = false;
+        nea_rb_prev[i].received = false;
     }
     nea_rb_static_next = 0;
     nea_rb_inited = true;
 
+    nea_rb_shared_setup();
+
+    // Forget frames announced before this point
+    while (fifoCheckValue32(NEA_RB_FIFO_STATE))
+        fifoGetValue32(NEA_RB_FIFO_STATE);
+
     // Tell ARM7 to start simulation
-    nea_rb_send_cmd(NEA_RB_CMD_START, 0);
+    nea_rb_send_cmd(NEA_RB_CMD_START, 0, 0);
+    nea_rb_flush();
 
     return 0;
 }
@@ -57,7 +155,11 @@ void NEA_RigidBodyEnd(void)
     if (!nea_rb_inited)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_RESET, 0);
+    // The reset also removes the mesh collider. Wait for it so that the mesh
+    // can be freed after this.
+    nea_rb_send_cmd(NEA_RB_CMD_RESET, 0, 0);
+    nea_rb_flush();
+    nea_rb_wait_idle();
 
     for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
         nea_rb_proxies[i].active = false;
@@ -66,101 +168,225 @@ void NEA_RigidBodyEnd(void)
     nea_rb_inited = false;
 }
 
-void NEA_RigidBodySync(void)
+// Sets the transformation of the model of a body
+static void nea_rb_update_model(NEA_RigidBody *rb, const NEA_Vec3 *position,
+                                const int32_t *rotation)
 {
-    if (!nea_rb_inited)
-        return;
+    NEA_Model *m = rb->model;
+
+    // Also keep x/y/z updated for user queries
+    m->x = position->x;
+    m->y = position->y;
+    m->z = position->z;
+    m->transform_dirty = true;
+
+    // Build a m4x3 matrix from rotation + position.
+    // m4x3 is column-major with int m[12]:
+    //   Col 0: m[0..2], Col 1: m[3..5], Col 2: m[6..8]
+    //   Translation: m[9..11]
+    // Our rotation is row-major:
+    //   rotation[0..2] = row 0
+    //   rotation[3..5] = row 1
+    //   rotation[6..8] = row 2
+
+    m4x3 mat;
+    // Column 0
+    mat.m[0]  = rotation[0];
+    mat.m[1]  = rotation[3];
+    mat.m[2]  = rotation[6];
+    // Column 1
+    mat.m[3]  = rotation[1];
+    mat.m[4]  = rotation[4];
+    mat.m[5]  = rotation[7];
+    // Column 2
+    mat.m[6]  = rotation[2];
+    mat.m[7]  = rotation[5];
+    mat.m[8]  = rotation[8];
+    // Translation
+    mat.m[9]  = position->x;
+    mat.m[10] = position->y;
+    mat.m[11] = position->z;
+
+    NEA_ModelSetMatrix(m, &mat);
+}
 
-    // Read all state packets from ARM7
-    while (fifoCheckValue32(NEA_RB_FIFO_STATE))
+static inline int32_t nea_rb_lerp(int32_t a, int32_t b, int32_t alpha)
+{
+    return a + (int32_t)(((int64_t)(b - a) * alpha) >> 12);
+}
+
+// Copies the frame announced with the given sequence number. It returns the
+// number of bodies, or -1 if the ARM7 started writing over the frame while it
+// was being copied.
+static int nea_rb_read_frame(u32 seq)
+{
+    NEA_RB_SharedState *shared = memUncached(&nea_rb_shared);
+    NEA_RB_StateBuffer *buf = &shared->buffers[seq & 1];
+
+    if (buf->seq_end != seq)
+        return -1;
+
+    __asm__ volatile("" ::: "memory");
+
+    int count = buf->count;
+    if (count > NEA_RB_MAX_BODIES)
+        return -1;
+
+    memcpy(nea_rb_snapshot, buf->bodies, count * sizeof(NEA_RB_BodyState));
+    NEA_RB_Stats stats = buf->stats;
+
+    __asm__ volatile("" ::: "memory");
+
+    if (buf->seq != seq)
+        return -1;
+
+    nea_rb_stats = stats;
+
+    return count;
+}
+
+// Reads the latest frame of the ARM7, if there is a new one
+static void nea_rb_read_state(void)
+{
+    // Only the latest frame announced by the ARM7 matters
+    bool fresh = false;
+    u32 seq = 0;
+    int count = -1;
+
+    for (int tries = 0; tries < 4; tries++)
     {
-        u32 hdr = fifoGetValue32(NEA_RB_FIFO_STATE);
+        while (fifoCheckValue32(NEA_RB_FIFO_STATE))
+        {
+            seq = fifoGetValue32(NEA_RB_FIFO_STATE);
+            fresh = true;
+        }
 
-        // Check for end-of-frame sentinel
-        if (hdr == NEA_RB_STATE_END)
+        if (!fresh)
+            return;
+
+        // This can only fail if the ARM7 has finished another frame since the
+        // last check, so it is announced in the FIFO.
+        count = nea_rb_read_frame(seq);
+        if (count >= 0)
             break;
+    }
 
-        u32 id = NEA_RB_STATE_DECODE_ID(hdr);
-        u32 flags = NEA_RB_STATE_DECODE_FLAGS(hdr);
+    for (int n = 0; n < count; n++)
+    {
+        const NEA_RB_BodyState *st = &nea_rb_snapshot[n];
+
+        u32 id = NEA_RB_STATE_DECODE_ID(st->hdr);
+        u32 flags = NEA_RB_STATE_DECODE_FLAGS(st->hdr);
 
         if (id >= NEA_RB_MAX_BODIES)
-        {
-            // Skip invalid body — drain remaining words
-            for (int w = 0; w < NEA_RB_STATE_WORDS - 1; w++)
-            {
-                fifoWaitValue32(NEA_RB_FIFO_STATE);
-                fifoGetValue32(NEA_RB_FIFO_STATE);
-            }
             continue;
-        }
 
         NEA_RigidBody *rb = &nea_rb_proxies[id];
+        nea_rb_prev_t *prev = &nea_rb_prev[id];
+
+        prev->position = rb->position;
+        for (int j = 0; j < 9; j++)
+            prev->rotation[j] = rb->rotation[j];
+        prev->valid = prev->received;
+        prev->received = true;
 
-        // Read position (3 words)
-        fifoWaitValue32(NEA_RB_FIFO_STATE);
-        rb->position.x = (int32_t)fifoGetValue32(NEA_RB_FIFO_STATE);
-        fifoWaitValue32(NEA_RB_FIFO_STATE);
-        rb->position.y = (int32_t)fifoGetValue32(NEA_RB_FIFO_STATE);
-        fifoWaitValue32(NEA_RB_FIFO_STATE);
-        rb->position.z = (int32_t)fifoGetValue32(NEA_RB_FIFO_STATE);
+        rb->position.x = st->position[0];
+        rb->position.y = st->position[1];
+        rb->position.z = st->position[2];
 
-        // Read rotation matrix (9 words)
         for (int j = 0; j < 9; j++)
+            rb->rotation[j] = st->rotation[j];
+
+        rb->sleeping = (flags & NEA_RB_STATE_FLAG_SLEEP) != 0;
+
+        if (!nea_rb_interpolate)
         {
-            fifoWaitValue32(NEA_RB_FIFO_STATE);
-            rb->rotation[j] = (int32_t)fifoGetValue32(NEA_RB_FIFO_STATE);
+            if (rb->active && rb->model != NULL)
+                nea_rb_update_model(rb, &rb->position, rb->rotation);
         }
+    }
 
-        rb->sleeping = (flags & NEA_RB_STATE_FLAG_SLEEP) != 0;
+    if (count < 0)
+        return;
+
+    if (nea_rb_interpolate)
+    {
+        u32 now = ne_scanline_time();
+        nea_rb_frame_interval = now - nea_rb_frame_time;
+        nea_rb_frame_time = now;
+    }
+}
+
+void NEA_RigidBodySync(void)
+{
+    // Hand the commands of this frame to the ARM7
+    nea_rb_flush();
 
-        // Update linked model if present
-        if (rb->active && rb->model != NULL)
+    if (!nea_rb_inited)
+        return;
+
+    nea_rb_read_state();
+
+    if (!nea_rb_interpolate)
+        return;
+
+    int32_t alpha = NEA_RigidBodyGetAlpha();
+
+    for (int i = 0; i < NEA_RB_MAX_BODIES; i++)
+    {
+        NEA_RigidBody *rb = &nea_rb_proxies[i];
+        const nea_rb_prev_t *prev = &nea_rb_prev[i];
+
+        if (!rb->active || rb->model == NULL)
+            continue;
+
+        if (!prev->valid)
         {
-            NEA_Model *m = rb->model;
-
-            // Also keep x/y/z updated for user queries
-            m->x = rb->position.x;
-            m->y = rb->position.y;
-            m->z = rb->position.z;
-
-            // Build a m4x3 matrix from rotation + position.
-            // m4x3 is column-major with int m[12]:
-            //   Col 0: m[0..2], Col 1: m[3..5], Col 2: m[6..8]
-            //   Translation: m[9..11]
-            // Our rotation is row-major:
-            //   rb->rotation[0..2] = row 0
-            //   rb->rotation[3..5] = row 1
-            //   rb->rotation[6..8] = row 2
-
-            m4x3 mat;
-            // Column 0
-            mat.m[0]  = rb->rotation[0];
-            mat.m[1]  = rb->rotation[3];
-            mat.m[2]  = rb->rotation[6];
-            // Column 1
-            mat.m[3]  = rb->rotation[1];
-            mat.m[4]  = rb->rotation[4];
-            mat.m[5]  = rb->rotation[7];
-            // Column 2
-            mat.m[6]  = rb->rotation[2];
-            mat.m[7]  = rb->rotation[5];
-            mat.m[8]  = rb->rotation[8];
-            // Translation
-            mat.m[9]  = rb->position.x;
-            mat.m[10] = rb->position.y;
-            mat.m[11] = rb->position.z;
-
-            NEA_ModelSetMatrix(m, &mat);
+            nea_rb_update_model(rb, &rb->position, rb->rotation);
+            continue;
         }
+
+        // The rows of the interpolated matrix aren't exactly unit vectors,
+        // but the error is small for the rotation of one step.
+        NEA_Vec3 position;
+        position.x = nea_rb_lerp(prev->position.x, rb->position.x, alpha);
+        position.y = nea_rb_lerp(prev->position.y, rb->position.y, alpha);
+        position.z = nea_rb_lerp(prev->position.z, rb->position.z, alpha);
+
+        int32_t rotation[9];
+        for (int j = 0; j < 9; j++)
+            rotation[j] = nea_rb_lerp(prev->rotation[j], rb->rotation[j], alpha);
+
+        nea_rb_update_model(rb, &position, rotation);
     }
 }
 
+void NEA_RigidBodySetInterpolation(bool enable)
+{
+    nea_rb_interpolate = enable;
+    nea_rb_frame_time = ne_scanline_time();
+    nea_rb_frame_interval = 0;
+}
+
+int32_t NEA_RigidBodyGetAlpha(void)
+{
+    if (!nea_rb_interpolate || nea_rb_frame_interval == 0)
+        return 1 << 12;
+
+    u32 elapsed = ne_scanline_time() - nea_rb_frame_time;
+    if (elapsed >= nea_rb_frame_interval)
+        return 1 << 12;
+
+    // The interval can be long enough for elapsed << 12 to overflow 32 bits
+    return (int32_t)(((uint64_t)elapsed << 12) / nea_rb_frame_interval);
+}
+
 // =========================================================================
 // Body creation / destruction
 // =========================================================================
 
-NEA_RigidBody *NEA_RigidBodyCreateI(int32_t mass,
-                                     int32_t hx, int32_t hy, int32_t hz)
+static NEA_RigidBody *nea_rb_create(NEA_RB_Shape shape, int32_t mass,
+                                    int32_t hx, int32_t hy, int32_t hz)
 {
     if (!nea_rb_inited)
     {
@@ -191,17 +417,20 @@ NEA_RigidBody *NEA_RigidBodyCreateI(int32_t mass,
     rb->model = NULL;
     rb->position = NEA_Vec3Make(0, 0, 0);
     rb->sleeping = false;
+    nea_rb_prev[slot].valid = false;
+    nea_rb_prev[slot].received = false;
     for (int i = 0; i < 9; i++)
         rb->rotation[i] = 0;
     rb->rotation[0] = rb->rotation[4] = rb->rotation[8] = 1 << 12;
 
-    // Cache half-extents for collision bridge
+    // Cache shape and half-extents for collision bridge
+    rb->shape = shape;
     rb->half_extents[0] = hx;
     rb->half_extents[1] = hy;
     rb->half_extents[2] = hz;
 
     // Send ADD_BODY command to ARM7
-    nea_rb_send_cmd(NEA_RB_CMD_ADD_BODY, (uint32_t)slot);
+    nea_rb_send_cmd(NEA_RB_CMD_ADD_BODY, NEA_RB_ENCODE_BODY(slot, shape), 7);
     nea_rb_send_val(hx);
     nea_rb_send_val(hy);
     nea_rb_send_val(hz);
@@ -213,12 +442,30 @@ NEA_RigidBody *NEA_RigidBodyCreateI(int32_t mass,
     return rb;
 }
 
+NEA_RigidBody *NEA_RigidBodyCreateI(int32_t mass,
+                                     int32_t hx, int32_t hy, int32_t hz)
+{
+    return nea_rb_create(NEA_RB_SHAPE_BOX, mass, hx, hy, hz);
+}
+
+NEA_RigidBody *NEA_RigidBodyCreateSphereI(int32_t mass, int32_t radius)
+{
+    return nea_rb_create(NEA_RB_SHAPE_SPHERE, mass, radius, radius, radius);
+}
+
+NEA_RigidBody *NEA_RigidBodyCreateCapsuleI(int32_t mass, int32_t radius,
+                                            int32_t half_height)
+{
+    return nea_rb_create(NEA_RB_SHAPE_CAPSULE, mass,
+                         radius, half_height + radius, radius);
+}
+
 void NEA_RigidBodyDelete(NEA_RigidBody *rb)
 {
     if (rb == NULL || !rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_KILL_BODY, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_KILL_BODY, (uint32_t)rb->id, 0);
     rb->active = false;
     rb->model = NULL;
 }
@@ -241,7 +488,7 @@ void NEA_RigidBodySetPositionI(NEA_RigidBody *rb,
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_SET_POSITION, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_POSITION, (uint32_t)rb->id, 3);
     nea_rb_send_val(x);
     nea_rb_send_val(y);
     nea_rb_send_val(z);
@@ -253,7 +500,12 @@ void NEA_RigidBodySetPositionI(NEA_RigidBody *rb,
         rb->model->x = x;
         rb->model->y = y;
         rb->model->z = z;
+        rb->model->transform_dirty = true;
     }
+
+    // Don't interpolate from the old position
+    nea_rb_prev[rb->id].valid = false;
+    nea_rb_prev[rb->id].received = false;
 }
 
 void NEA_RigidBodySetVelocityI(NEA_RigidBody *rb,
@@ -263,7 +515,7 @@ void NEA_RigidBodySetVelocityI(NEA_RigidBody *rb,
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_SET_VELOCITY, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_VELOCITY, (uint32_t)rb->id, 3);
     nea_rb_send_val(vx);
     nea_rb_send_val(vy);
     nea_rb_send_val(vz);
@@ -275,7 +527,7 @@ void NEA_RigidBodySetRestitutionI(NEA_RigidBody *rb, int32_t e)
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_SET_RESTITUTION, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_RESTITUTION, (uint32_t)rb->id, 1);
     nea_rb_send_val(e);
 }
 
@@ -285,7 +537,7 @@ void NEA_RigidBodySetFrictionI(NEA_RigidBody *rb, int32_t mu)
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_SET_FRICTION, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_FRICTION, (uint32_t)rb->id, 1);
     nea_rb_send_val(mu);
 }
 
@@ -301,7 +553,7 @@ void NEA_RigidBodyApplyForceI(NEA_RigidBody *rb,
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_APPLY_FORCE, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_APPLY_FORCE, (uint32_t)rb->id, 6);
     nea_rb_send_val(fx);
     nea_rb_send_val(fy);
     nea_rb_send_val(fz);
@@ -318,7 +570,7 @@ void NEA_RigidBodyApplyImpulseI(NEA_RigidBody *rb,
     if (!rb->active)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_APPLY_IMPULSE, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_APPLY_IMPULSE, (uint32_t)rb->id, 6);
     nea_rb_send_val(jx);
     nea_rb_send_val(jy);
     nea_rb_send_val(jz);
@@ -333,10 +585,33 @@ void NEA_RigidBodyApplyImpulseI(NEA_RigidBody *rb,
 
 void NEA_RigidBodySetGravityI(int32_t g)
 {
-    nea_rb_send_cmd(NEA_RB_CMD_SET_GRAVITY, 0);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_GRAVITY, 0, 1);
     nea_rb_send_val(g);
 }
 
+void NEA_RigidBodySetStepBudget(u32 cycles)
+{
+    NEA_Assert(cycles <= (0xFFFFFFFFu >> NEA_RB_CMD_BITS),
+               "Budget too big: %lu", cycles);
+    nea_rb_send_cmd(NEA_RB_CMD_SET_STEP_BUDGET, cycles, 0);
+}
+
+int NEA_RigidBodyGetSubsteps(void)
+{
+    return nea_rb_stats.substeps;
+}
+
+u32 NEA_RigidBodyGetStepCycles(void)
+{
+    return nea_rb_stats.cycles;
+}
+
+void NEA_RigidBodyGetStats(NEA_RB_Stats *stats)
+{
+    NEA_AssertPointer(stats, "NULL pointer");
+    *stats = nea_rb_stats;
+}
+
 // =========================================================================
 // Static colliders
 // =========================================================================
@@ -353,7 +628,7 @@ int NEA_RigidBodyAddStaticI(int32_t px, int32_t py, int32_t pz,
 
     int id = nea_rb_static_next++;
 
-    nea_rb_send_cmd(NEA_RB_CMD_ADD_STATIC, (uint32_t)id);
+    nea_rb_send_cmd(NEA_RB_CMD_ADD_STATIC, (uint32_t)id, 9);
     nea_rb_send_val(px);
     nea_rb_send_val(py);
     nea_rb_send_val(pz);
@@ -372,7 +647,59 @@ void NEA_RigidBodyRemoveStatic(int id)
     if (id < 0 || id >= NEA_RB_MAX_STATICS)
         return;
 
-    nea_rb_send_cmd(NEA_RB_CMD_REMOVE_STATIC, (uint32_t)id);
+    nea_rb_send_cmd(NEA_RB_CMD_REMOVE_STATIC, (uint32_t)id, 0);
+}
+
+// The ARM7 reads mesh colliders with these layouts
+_Static_assert(sizeof(NEA_RB_MeshTriangle) == sizeof(NEA_ColTriangle),
+               "NEA_RB_MeshTriangle doesn't match NEA_ColTriangle");
+_Static_assert(offsetof(NEA_RB_MeshTriangle, edge_normal) ==
+               offsetof(NEA_ColTriangle, edge_normal),
+               "NEA_RB_MeshTriangle doesn't match NEA_ColTriangle");
+_Static_assert(sizeof(NEA_RB_MeshNode) == sizeof(NEA_ColBVHNode),
+               "NEA_RB_MeshNode doesn't match NEA_ColBVHNode");
+
+int NEA_RigidBodySetMeshI(const NEA_ColMesh *mesh,
+                          int32_t x, int32_t y, int32_t z)
+{
+    u32 tris = 0, nodes = 0, counts = 0;
+
+    if (mesh != NULL)
+    {
+        if (mesh->flags != NEA_COLMESH_STATIC)
+        {
+            NEA_DebugPrint("Only static meshes are supported");
+            return 0;
+        }
+
+        // The ARM7 doesn't see the data cache of the ARM9
+        DC_FlushRange(mesh->triangles,
+                      mesh->num_triangles * sizeof(NEA_ColTriangle));
+        tris = (u32)mesh->triangles;
+        counts = mesh->num_triangles;
+
+        if (mesh->nodes != NULL)
+        {
+            DC_FlushRange(mesh->nodes,
+                          mesh->num_nodes * sizeof(NEA_ColBVHNode));
+            nodes = (u32)mesh->nodes;
+            counts |= (u32)mesh->num_nodes << 16;
+        }
+    }
+
+    nea_rb_send_cmd(NEA_RB_CMD_SET_MESH, 0, 6);
+    nea_rb_send_val(tris);
+    nea_rb_send_val(nodes);
+    nea_rb_send_val(counts);
+    nea_rb_send_val(x);
+    nea_rb_send_val(y);
+    nea_rb_send_val(z);
+
+    // Wait until the ARM7 has stopped using the previous mesh
+    nea_rb_flush();
+    nea_rb_wait_idle();
+
+    return 1;
 }
 
 // =========================================================================
@@ -405,11 +732,27 @@ int NEA_RigidBodyCollideWithI(NEA_RigidBody *rb,
     if (!rb->active || !nea_rb_inited)
         return 0;
 
-    // Construct AABB from rigid body's position + half-extents
+    // Construct the shape from the rigid body's position + half-extents. The
+    // rotation of the body is ignored.
     NEA_ColShape rb_shape;
-    rb_shape.type = NEA_COL_AABB;
-    rb_shape.shape.aabb.half = NEA_Vec3Make(
-        rb->half_extents[0], rb->half_extents[1], rb->half_extents[2]);
+    if (rb->shape == NEA_RB_SHAPE_SPHERE)
+    {
+        rb_shape.type = NEA_COL_SPHERE;
+        rb_shape.shape.sphere.radius = rb->half_extents[0];
+    }
+    else if (rb->shape == NEA_RB_SHAPE_CAPSULE)
+    {
+        rb_shape.type = NEA_COL_CAPSULE;
+        rb_shape.shape.capsule.radius = rb->half_extents[0];
+        rb_shape.shape.capsule.half_height =
+            rb->half_extents[1] - rb->half_extents[0];
+    }
+    else
+    {
+        rb_shape.type = NEA_COL_AABB;
+        rb_shape.shape.aabb.half = NEA_Vec3Make(
+            rb->half_extents[0], rb->half_extents[1], rb->half_extents[2]);
+    }
 
     NEA_Vec3 rb_pos = rb->position;
     NEA_Vec3 shape_pos = NEA_Vec3Make(sx, sy, sz);
@@ -421,7 +764,7 @@ int NEA_RigidBodyCollideWithI(NEA_RigidBody *rb,
         return 0;
 
     // Inject contact into ARM7 via FIFO
-    nea_rb_send_cmd(NEA_RB_CMD_INJECT_CONTACT, (uint32_t)rb->id);
+    nea_rb_send_cmd(NEA_RB_CMD_INJECT_CONTACT, (uint32_t)rb->id, 7);
     nea_rb_send_val(result.normal.x);
     nea_rb_send_val(result.normal.y);
     nea_rb_send_val(result.normal.z);
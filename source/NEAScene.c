@@ -4,13 +4,29 @@
 //
 // This file is part of Nitro Engine Advanced
 
+#include <stddef.h>
+
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+#include "NEATCM.h"
 
 /// @file NEAScene.c
 
 static int ne_scene_max_nodes = 0;
 static bool ne_scene_system_inited = false;
 
+// Flags of NEA_SceneNode.dirty
+#define NE_NODE_DIRTY_LOCAL     (1 << 0) // The local transform has changed
+#define NE_NODE_DIRTY_CHILD     (1 << 1) // A node of the subtree has changed
+#define NE_NODE_INACTIVE        (1 << 2) // Not updated, tested or drawn
+#define NE_NODE_FROZEN          (1 << 3) // Not updated or tested
+#define NE_NODE_DORMANT         (1 << 4) // The node or a parent is one of both
+
+#define NE_NODE_DIRTY_MASK      (NE_NODE_DIRTY_LOCAL | NE_NODE_DIRTY_CHILD)
+
+// Radius of the bounds of subtrees that must always be drawn
+#define NE_BOUNDS_INFINITE      INT32_MAX
+
 // =========================================================================
 // .neascene binary format structures
 // =========================================================================
@@ -27,6 +43,117 @@ typedef struct {
 #define NEASCENE_ASSET_SIZE    64
 #define NEASCENE_MATREF_SIZE   80
 #define NEASCENE_NODE_SIZE     128
+#define NEASCENE_V1_MAX_TAGS   3
+
+// Version 2 adds the location of the node and trigger tables. The nodes are
+// stored as NEA_SceneNode structs. Pointers to nodes and triggers are stored as
+// indices plus one (0 means NULL), and all other pointers are 0.
+typedef struct {
+    neascene_header_t base;
+    uint32_t node_size;       // Must be sizeof(NEA_SceneNode)
+    uint32_t nodes_offset;    // From the start of the file, 4-byte aligned
+    uint16_t num_triggers;
+    uint16_t reserved;
+    uint32_t triggers_offset; // From the start of the file, 4-byte aligned
+} neascene_header_v2_t;
+
+// Version 3 adds optional bounds and a tree of triggers. The bounds table has
+// the local bounds of all nodes followed by the bounds of their subtrees, both
+// stored as NEA_SceneBounds.
+typedef struct {
+    neascene_header_v2_t v2;
+    uint32_t bounds_offset;   // From the start of the file, 0 if there are none
+    uint32_t tree_offset;     // From the start of the file, 0 if there is none
+    uint16_t num_tree_nodes;
+    uint16_t num_tree_items;
+} neascene_header_v3_t;
+
+// Nodes of the tree of triggers are stored in depth-first order, so the first
+// child of an inner node is the next node. If the box of a node isn't touched,
+// the search continues at "skip", so it doesn't need a stack. The tree is
+// followed by the list of items of the leaves (node indices as uint16_t).
+typedef struct {
+    int32_t min[3];           // Box in world space (f32)
+    int32_t max[3];
+    uint16_t skip;            // Next node after this subtree
+    uint16_t first;           // First item of a leaf
+    uint16_t count;           // Number of items of a leaf, 0 for inner nodes
+    uint16_t reserved;
+} neascene_tree_node_t;
+
+typedef struct {
+    uint8_t shape;            // 1 = sphere, 2 = AABB
+    uint8_t script_id;
+    uint16_t reserved;
+    int32_t params[3];        // Radius, or half extents of the AABB
+} neascene_trigger_t;
+
+// The exporter writes nodes with this layout. Enums may be 1 or 4 bytes long,
+// the type is followed by 4-byte aligned fields so that it doesn't matter.
+#if UINTPTR_MAX == UINT32_MAX
+_Static_assert(sizeof(NEA_SceneNode) == NEA_SCENE_NODE_SIZE,
+               "Update NEA_SCENE_NODE_SIZE and neascene_export.py");
+_Static_assert(offsetof(NEA_SceneNode, name) == 12, "Node layout changed");
+_Static_assert(offsetof(NEA_SceneNode, num_tags) == 132, "Node layout changed");
+_Static_assert(offsetof(NEA_SceneNode, type) == 136, "Node layout changed");
+_Static_assert(offsetof(NEA_SceneNode, x) == 140, "Node layout changed");
+_Static_assert(offsetof(NEA_SceneNode, ref) == 188, "Node layout changed");
+_Static_assert(offsetof(NEA_SceneNode, trigger) == 212, "Node layout changed");
+#endif
+
+// Size of a table of the arena of a scene, rounded up to keep the tables after
+// it aligned
+#define NE_ARENA_SIZE(n, type)  ((((n) * sizeof(type)) + 7) & ~(size_t)7)
+
+// Allocates all the tables of a scene that have one entry per node, or per node
+// of a type, as one zeroed block. It holds the nodes of version 1 scenes too,
+// version 2 and 3 scenes keep their nodes in the file.
+static int ne_scene_arena_alloc(NEA_Scene *scene, bool nodes, int num_triggers,
+                                int num_portals, int num_sectors)
+{
+    int num_nodes = scene->num_nodes;
+
+    size_t world_size = NE_ARENA_SIZE(num_nodes, m4x3);
+    size_t bounds_size = NE_ARENA_SIZE(num_nodes, NEA_SceneBounds);
+    size_t nodes_size = nodes ? NE_ARENA_SIZE(num_nodes, NEA_SceneNode) : 0;
+    size_t triggers_size = NE_ARENA_SIZE(num_triggers, NEA_TriggerData);
+    size_t portals_size = NE_ARENA_SIZE(num_portals, NEA_SceneNode *);
+    size_t sectors_size = NE_ARENA_SIZE(num_sectors, NEA_SceneSector);
+
+    uint8_t *arena = ne_heap_calloc(NEA_HEAP_SCENE, 1,
+                                    world_size + bounds_size + nodes_size +
+                                    triggers_size + portals_size +
+                                    sectors_size);
+    if (arena == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for scene arena");
+        return 0;
+    }
+
+    scene->arena = arena;
+
+    scene->world = (m4x3 *)arena;
+    arena += world_size;
+    scene->bounds = (NEA_SceneBounds *)arena;
+    arena += bounds_size;
+
+    if (nodes)
+        scene->nodes = (NEA_SceneNode *)arena;
+    arena += nodes_size;
+
+    if (num_triggers > 0)
+        scene->triggers = (NEA_TriggerData *)arena;
+    arena += triggers_size;
+
+    if (num_portals > 0)
+        scene->portals = (NEA_SceneNode **)arena;
+    arena += portals_size;
+
+    if (num_sectors > 0)
+        scene->sectors = (NEA_SceneSector *)arena;
+
+    return 1;
+}
 
 // =========================================================================
 // System lifecycle
@@ -67,80 +194,263 @@ static bool ne_node_has_tag(const NEA_SceneNode *node, const char *tag)
 }
 
 // =========================================================================
-// Scene loading (binary .neascene)
+// Name and tag lookup
 // =========================================================================
 
-static NEA_Scene *ne_scene_parse(const void *data, size_t size)
+// Internal use... see NEAPack.c
+u32 ne_pack_hash(const char *path);
+
+// Internal use... see NEACache.c
+NEA_Material *ne_cache_get_texture(const char *path, NEA_TextureFlags flags);
+NEA_Material *ne_cache_add_texture(const char *path, NEA_TextureFlags flags,
+                                   NEA_Material *mat);
+
+// The hash tables are built when the scene is loaded, and they use open
+// addressing with linear probing. Nodes aren't added or removed later.
+
+typedef struct {
+    u32 hash;
+    const char *tag;    // Tag string of the first node that has it
+    int16_t first;      // First node in the list of nodes of the tag
+    int16_t count;      // Number of nodes (0 = free slot)
+} ne_scene_tag_t;
+
+typedef struct {
+    u32 name_mask;        // Size of the table of names minus one
+    u32 tag_mask;         // Size of the table of tags minus one
+    ne_scene_tag_t *tags;
+    u32 *name_hashes;     // Hash of the name of each node
+    int16_t *names;       // Node indices (-1 = free slot)
+    int16_t *tag_nodes;   // Node indices, grouped by tag
+} ne_scene_lookup_t;
+
+static u32 ne_scene_table_size(int count)
 {
-    if (size < sizeof(neascene_header_t))
+    u32 size = 4;
+    while (size < (u32)count * 2)
+        size <<= 1;
+    return size;
+}
+
+// Returns the slot of a tag, or the free slot where it should be added
+static ne_scene_tag_t *ne_scene_tag_slot(const ne_scene_lookup_t *lookup,
+                                         const char *tag, u32 hash)
+{
+    u32 i = hash & lookup->tag_mask;
+
+    while (1)
     {
-        NEA_DebugPrint("Scene data too small");
-        return NULL;
+        ne_scene_tag_t *slot = &lookup->tags[i];
+        if (slot->count == 0)
+            return slot;
+        if ((slot->hash == hash) && (strcmp(slot->tag, tag) == 0))
+            return slot;
+        i = (i + 1) & lookup->tag_mask;
     }
+}
 
-    const neascene_header_t *hdr = (const neascene_header_t *)data;
+static const ne_scene_tag_t *ne_scene_tag_find(const NEA_Scene *scene,
+                                               const char *tag)
+{
+    const ne_scene_lookup_t *lookup = scene->lookup;
 
-    if (hdr->magic != NEA_SCENE_MAGIC)
+    const ne_scene_tag_t *slot = ne_scene_tag_slot(lookup, tag,
+                                                   ne_pack_hash(tag));
+    return (slot->count == 0) ? NULL : slot;
+}
+
+// Returns true if the tag appears in a previous slot of the node
+static bool ne_node_tag_repeated(const NEA_SceneNode *node, int t)
+{
+    for (int i = 0; i < t; i++)
     {
-        NEA_DebugPrint("Invalid .neascene magic");
-        return NULL;
+        if (strcmp(node->tags[i], node->tags[t]) == 0)
+            return true;
     }
-    if (hdr->version != NEA_SCENE_VERSION)
+    return false;
+}
+
+static void ne_scene_build_lookup(NEA_Scene *scene)
+{
+    int num_nodes = scene->num_nodes;
+
+    int num_refs = 0;
+    for (int i = 0; i < num_nodes; i++)
+        num_refs += scene->nodes[i].num_tags;
+
+    if (num_nodes > INT16_MAX || num_refs > INT16_MAX)
+        return;
+
+    u32 name_size = ne_scene_table_size(num_nodes);
+    u32 tag_size = ne_scene_table_size(num_refs);
+
+    // Everything goes in one allocation
+    size_t size = sizeof(ne_scene_lookup_t)
+                + tag_size * sizeof(ne_scene_tag_t)
+                + num_nodes * sizeof(u32)
+                + (name_size + num_refs) * sizeof(int16_t);
+
+    ne_scene_lookup_t *lookup = ne_heap_calloc(NEA_HEAP_SCENE, 1, size);
+    if (lookup == NULL)
     {
-        NEA_DebugPrint("Unsupported .neascene version");
-        return NULL;
+        // Nodes can still be found by looking at all of them
+        NEA_DebugPrint("Not enough memory for lookup tables");
+        return;
     }
 
-    int num_nodes = hdr->num_nodes;
-    if (num_nodes < 1 || num_nodes > ne_scene_max_nodes)
+    lookup->name_mask = name_size - 1;
+    lookup->tag_mask = tag_size - 1;
+    lookup->tags = (ne_scene_tag_t *)(lookup + 1);
+    lookup->name_hashes = (u32 *)(lookup->tags + tag_size);
+    lookup->names = (int16_t *)(lookup->name_hashes + num_nodes);
+    lookup->tag_nodes = lookup->names + name_size;
+
+    for (u32 i = 0; i < name_size; i++)
+        lookup->names[i] = -1;
+
+    // Names. Nodes are added in order, so the first node with a name is found
+    // first, like in a linear search.
+    for (int i = 0; i < num_nodes; i++)
     {
-        NEA_DebugPrint("Invalid node count");
-        return NULL;
+        u32 hash = ne_pack_hash(scene->nodes[i].name);
+        lookup->name_hashes[i] = hash;
+
+        u32 slot = hash & lookup->name_mask;
+        while (lookup->names[slot] >= 0)
+            slot = (slot + 1) & lookup->name_mask;
+        lookup->names[slot] = i;
     }
 
-    NEA_Scene *scene = calloc(1, sizeof(NEA_Scene));
-    if (scene == NULL)
+    // Count the nodes of each tag
+    for (int i = 0; i < num_nodes; i++)
     {
-        NEA_DebugPrint("Not enough memory for scene");
-        return NULL;
+        NEA_SceneNode *node = &scene->nodes[i];
+
+        for (int t = 0; t < node->num_tags; t++)
+        {
+            if (ne_node_tag_repeated(node, t))
+                continue;
+
+            u32 hash = ne_pack_hash(node->tags[t]);
+            ne_scene_tag_t *slot = ne_scene_tag_slot(lookup, node->tags[t],
+                                                     hash);
+            if (slot->count == 0)
+            {
+                slot->hash = hash;
+                slot->tag = node->tags[t];
+            }
+            slot->count++;
+        }
     }
 
-    scene->nodes = calloc(num_nodes, sizeof(NEA_SceneNode));
-    if (scene->nodes == NULL)
+    // Point each tag to the end of its list, and fill the lists backwards so
+    // that the nodes are sorted like in the node array.
+    int end = 0;
+    for (u32 i = 0; i < tag_size; i++)
     {
-        NEA_DebugPrint("Not enough memory for nodes");
-        free(scene);
-        return NULL;
+        end += lookup->tags[i].count;
+        lookup->tags[i].first = end;
     }
 
-    scene->num_nodes = num_nodes;
-    scene->num_assets = hdr->num_assets;
-    scene->num_mat_refs = hdr->num_mat_refs;
+    for (int i = num_nodes - 1; i >= 0; i--)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
 
-    const uint8_t *ptr = (const uint8_t *)data + sizeof(neascene_header_t);
+        for (int t = 0; t < node->num_tags; t++)
+        {
+            if (ne_node_tag_repeated(node, t))
+                continue;
 
-    // --- Parse asset table ---
-    for (int i = 0; i < scene->num_assets && i < NEA_SCENE_MAX_ASSETS; i++)
+            ne_scene_tag_t *slot = ne_scene_tag_slot(lookup, node->tags[t],
+                                            ne_pack_hash(node->tags[t]));
+            lookup->tag_nodes[--slot->first] = i;
+        }
+    }
+
+    scene->lookup = lookup;
+}
+
+// =========================================================================
+// Scene loading (binary .neascene)
+// =========================================================================
+
+static void ne_scene_batch_if_loaded(NEA_Scene *scene);
+
+// Called by the background loader when a mesh of a scene has been loaded
+static void ne_scene_asset_loaded(const char *path, void *data, size_t size,
+                                  void *arg)
+{
+    (void)size;
+
+    NEA_Scene *scene = arg;
+
+    if (data == NULL)
     {
-        memcpy(scene->assets[i].path, ptr, 48);
-        scene->assets[i].path[47] = '\0';
-        scene->assets[i].type = ptr[48];
-        scene->assets[i].loaded = false;
-        scene->assets[i].data = NULL;
-        ptr += NEASCENE_ASSET_SIZE;
+        NEA_DebugPrint("Can't load %s", path);
+        return;
     }
 
-    // --- Parse material ref table ---
-    for (int i = 0; i < scene->num_mat_refs && i < NEA_SCENE_MAX_MATERIALS; i++)
+    for (int ai = 0; ai < scene->num_assets; ai++)
     {
-        memcpy(scene->mat_refs[i].name, ptr, 32);
-        scene->mat_refs[i].name[31] = '\0';
-        memcpy(scene->mat_refs[i].tex_path, ptr + 32, 48);
-        scene->mat_refs[i].tex_path[47] = '\0';
-        ptr += NEASCENE_MATREF_SIZE;
+        NEA_SceneAsset *asset = &scene->assets[ai];
+
+        if (asset->loaded || (strcmp(asset->path, path) != 0))
+            continue;
+
+        // Another scene may have loaded the same file in the meantime
+        asset->data = NEA_CacheAdd(NEA_CACHE_MESH, path, data);
+        if (asset->data == NULL)
+            return;
+
+        asset->loaded = true;
+
+        for (int i = 0; i < scene->num_nodes; i++)
+        {
+            NEA_SceneNode *node = &scene->nodes[i];
+
+            if ((node->type != NEA_NODE_MESH) || (node->model == NULL) ||
+                (node->ref.mesh.asset_index != ai))
+                continue;
+
+            // The data belongs to the cache, see NEA_SceneFree()
+            NEA_ModelLoadStaticMesh(node->model, asset->data);
+
+            // The bounds of the model have changed
+            NEA_SceneNodeTransformChanged(node);
+        }
+
+        ne_scene_batch_if_loaded(scene);
+        return;
     }
 
-    // --- Parse node table ---
+    free(data);
+}
+
+// Version 1: nodes are copied from the file to a new array
+static int ne_scene_parse_nodes_v1(NEA_Scene *scene, const uint8_t *ptr)
+{
+    int num_nodes = scene->num_nodes;
+    int num_triggers = 0, num_portals = 0, num_sectors = 0;
+
+    // The size of the arena depends on the types of the nodes
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NEA_NodeType type = ptr[i * NEASCENE_NODE_SIZE + 24];
+
+        if (type == NEA_NODE_TRIGGER)
+            num_triggers++;
+        else if (type == NEA_NODE_PORTAL)
+            num_portals++;
+        else if (type == NEA_NODE_SECTOR)
+            num_sectors++;
+    }
+
+    if (!ne_scene_arena_alloc(scene, true, num_triggers, num_portals,
+                              num_sectors))
+        return 0;
+
+    NEA_TriggerData *trigger = scene->triggers;
+
     for (int i = 0; i < num_nodes; i++)
     {
         NEA_SceneNode *node = &scene->nodes[i];
@@ -154,8 +464,8 @@ static NEA_Scene *ne_scene_parse(const void *data, size_t size)
         node->type = (NEA_NodeType)np[24];
         uint8_t parent_idx = np[25];
         node->num_tags = np[26];
-        if (node->num_tags > NEA_NODE_MAX_TAGS)
-            node->num_tags = NEA_NODE_MAX_TAGS;
+        if (node->num_tags > NEASCENE_V1_MAX_TAGS)
+            node->num_tags = NEASCENE_V1_MAX_TAGS;
         node->visible = (np[27] & 1) != 0;
 
         // Position (f32 x3 at offset 28)
@@ -185,6 +495,7 @@ static NEA_Scene *ne_scene_parse(const void *data, size_t size)
             node->ref.mesh.asset_index = mesh_data[0];
             node->ref.mesh.material_index = mesh_data[1];
             node->ref.mesh.is_animated = td[4];
+            node->ref.mesh.is_static = td[5];
         }
         else if (node->type == NEA_NODE_CAMERA)
         {
@@ -198,19 +509,44 @@ static NEA_Scene *ne_scene_parse(const void *data, size_t size)
         }
         else if (node->type == NEA_NODE_TRIGGER)
         {
-            node->trigger = calloc(1, sizeof(NEA_TriggerData));
-            if (node->trigger != NULL)
-            {
-                uint8_t shape_type = td[0];
-                node->trigger->script_id = td[1];
-
-                const int32_t *sp = (const int32_t *)(td + 4);
-                if (shape_type == 1) // sphere
-                    NEA_ColShapeInitSphereI(&node->trigger->shape, sp[0]);
-                else if (shape_type == 2) // AABB
-                    NEA_ColShapeInitAABBI(&node->trigger->shape,
-                                          sp[0], sp[1], sp[2]);
-            }
+            node->trigger = trigger++;
+
+            uint8_t shape_type = td[0];
+            node->trigger->script_id = td[1];
+
+            const int32_t *sp = (const int32_t *)(td + 4);
+            if (shape_type == 1) // sphere
+                NEA_ColShapeInitSphereI(&node->trigger->shape, sp[0]);
+            else if (shape_type == 2) // AABB
+                NEA_ColShapeInitAABBI(&node->trigger->shape,
+                                      sp[0], sp[1], sp[2]);
+        }
+        else if (node->type == NEA_NODE_ROOM)
+        {
+            const int32_t *half = (const int32_t *)td;
+            node->ref.room.half[0] = half[0];
+            node->ref.room.half[1] = half[1];
+            node->ref.room.half[2] = half[2];
+            scene->num_rooms++;
+        }
+        else if (node->type == NEA_NODE_PORTAL)
+        {
+            const int32_t *half = (const int32_t *)td;
+            node->ref.portal.half[0] = half[0];
+            node->ref.portal.half[1] = half[1];
+            node->ref.portal.half[2] = half[2];
+            node->ref.portal.room_a = td[12];
+            node->ref.portal.room_b = td[13];
+            scene->num_portals++;
+        }
+        else if (node->type == NEA_NODE_SECTOR)
+        {
+            const uint16_t *sector_data = (const uint16_t *)td;
+            const int32_t *radius = (const int32_t *)(td + 4);
+            node->ref.sector.asset_index = sector_data[0];
+            node->ref.sector.load_radius = radius[0];
+            node->ref.sector.unload_radius = radius[1];
+            scene->num_sectors++;
         }
 
         // Tags at offset 80 (3 * 16 = 48 bytes)
@@ -249,485 +585,2932 @@ static NEA_Scene *ne_scene_parse(const void *data, size_t size)
         // Initialize runtime pointers
         node->model = NULL;
         node->camera = NULL;
+        node->room_visible = true;
         node->animmat = NULL;
         node->user_data = NULL;
 
         ptr += NEASCENE_NODE_SIZE;
     }
 
-    // --- Create engine objects for mesh and camera nodes ---
-    for (int i = 0; i < num_nodes; i++)
-    {
-        NEA_SceneNode *node = &scene->nodes[i];
+    return 1;
+}
 
-        if (node->type == NEA_NODE_MESH)
+// Converts an index plus one, as stored in version 2 files, into a pointer to
+// a node. Returns false if the index is invalid.
+static bool ne_scene_relocate_node(NEA_SceneNode **ref, NEA_SceneNode *nodes,
+                                   int num_nodes)
+{
+    uintptr_t index = (uintptr_t)*ref;
+
+    if (index > (uintptr_t)num_nodes)
+        return false;
+
+    *ref = (index == 0) ? NULL : &nodes[index - 1];
+    return true;
+}
+
+// Checks that a table of a scene file is inside the file and aligned
+static bool ne_scene_table_valid(uint32_t offset, size_t table_size,
+                                 size_t size)
+{
+    return !(offset & 3) && (offset <= size) && (table_size <= size - offset);
+}
+
+// Version 3: the bounds of the nodes and the tree of triggers are used in
+// place.
+// The tree is only checked here, it is used by the trigger grid.
+static int ne_scene_parse_tables_v3(NEA_Scene *scene, const void *blob,
+                                    size_t size)
+{
+    const neascene_header_v3_t *hdr = blob;
+    int num_nodes = scene->num_nodes;
+
+    if (hdr->bounds_offset != 0)
+    {
+        size_t bounds_size = 2 * num_nodes * sizeof(NEA_SceneBounds);
+        if (!ne_scene_table_valid(hdr->bounds_offset, bounds_size, size))
         {
-            node->model = NEA_ModelCreate(
-                node->ref.mesh.is_animated ? NEA_Animated : NEA_Static);
+            NEA_DebugPrint("Invalid bounds table");
+            return 0;
+        }
 
-            if (node->model != NULL)
-            {
-                // Load mesh from asset table if available
-                uint16_t ai = node->ref.mesh.asset_index;
-                if (ai < scene->num_assets && scene->assets[ai].path[0] != '\0')
-                {
-                    if (!scene->assets[ai].loaded)
-                    {
-                        scene->assets[ai].data =
-                            NEA_FATLoadData(scene->assets[ai].path);
-                        if (scene->assets[ai].data != NULL)
-                            scene->assets[ai].loaded = true;
-                    }
+        scene->local_bounds = (const NEA_SceneBounds *)
+                ((const uint8_t *)blob + hdr->bounds_offset);
+    }
 
-                    if (scene->assets[ai].loaded)
-                    {
-                        NEA_ModelLoadStaticMesh(node->model,
-                                                scene->assets[ai].data);
-                        NEA_ModelFreeMeshWhenDeleted(node->model);
-                    }
-                }
+    if (hdr->tree_offset != 0)
+    {
+        int num_tree_nodes = hdr->num_tree_nodes;
+        int num_items = hdr->num_tree_items;
+        size_t tree_size = num_tree_nodes * sizeof(neascene_tree_node_t)
+                         + num_items * sizeof(uint16_t);
 
-                // Apply initial transform
-                NEA_ModelSetCoordI(node->model, node->x, node->y, node->z);
-                NEA_ModelSetRot(node->model, node->rx, node->ry, node->rz);
-                NEA_ModelScaleI(node->model, node->sx, node->sy, node->sz);
-            }
+        if (!ne_scene_table_valid(hdr->tree_offset, tree_size, size))
+        {
+            NEA_DebugPrint("Invalid trigger tree");
+            return 0;
         }
-        else if (node->type == NEA_NODE_CAMERA)
+
+        const neascene_tree_node_t *tree = (const neascene_tree_node_t *)
+                ((const uint8_t *)blob + hdr->tree_offset);
+        const uint16_t *items = (const uint16_t *)(tree + num_tree_nodes);
+
+        // The search always moves forward, so it ends
+        for (int i = 0; i < num_tree_nodes; i++)
         {
-            node->camera = NEA_CameraCreate();
-            if (node->camera != NULL)
+            const neascene_tree_node_t *tn = &tree[i];
+            if ((tn->skip <= i) || (tn->skip > num_tree_nodes) ||
+                (tn->first + tn->count > num_items) ||
+                (tn->count == 0 && tn->skip == i + 1))
             {
-                NEA_CameraSetI(node->camera,
-                               node->x, node->y, node->z,
-                               node->ref.cam.to[0], node->ref.cam.to[1],
-                               node->ref.cam.to[2],
-                               node->ref.cam.up[0], node->ref.cam.up[1],
-                               node->ref.cam.up[2]);
+                NEA_DebugPrint("Invalid trigger tree node %d", i);
+                return 0;
             }
         }
-    }
-
-    // Set root
-    scene->root = &scene->nodes[0];
 
-    // Set active camera
-    if (hdr->active_camera_idx != 0xFFFF &&
-        hdr->active_camera_idx < num_nodes)
-    {
-        NEA_SceneNode *cam = &scene->nodes[hdr->active_camera_idx];
-        if (cam->type == NEA_NODE_CAMERA)
-            scene->active_camera = cam;
+        for (int i = 0; i < num_items; i++)
+        {
+            if (items[i] >= num_nodes)
+            {
+                NEA_DebugPrint("Invalid trigger tree item %d", i);
+                return 0;
+            }
+        }
     }
 
-    scene->loaded = true;
-    return scene;
+    return 1;
 }
 
-NEA_Scene *NEA_SceneLoad(const void *data, size_t size)
+// Version 2: nodes are stored with the layout of NEA_SceneNode, so they are
+// used in place. Only the node and trigger references need to be patched. The
+// scene takes ownership of the blob.
+static int ne_scene_relocate_nodes_v2(NEA_Scene *scene, void *blob, size_t size)
 {
-    NEA_AssertPointer(data, "NULL data pointer");
+    const neascene_header_v2_t *hdr = blob;
+    int num_nodes = scene->num_nodes;
 
-    if (!ne_scene_system_inited)
+    scene->blob = blob;
+
+    if (hdr->node_size != sizeof(NEA_SceneNode))
     {
-        NEA_DebugPrint("Scene system not initialized");
-        return NULL;
+        NEA_DebugPrint("Invalid node size: %u", (unsigned int)hdr->node_size);
+        return 0;
     }
 
-    return ne_scene_parse(data, size);
-}
-
-NEA_Scene *NEA_SceneLoadFAT(const char *path)
-{
-    NEA_AssertPointer(path, "NULL path");
+    size_t nodes_size = num_nodes * sizeof(NEA_SceneNode);
+    size_t triggers_size = hdr->num_triggers * sizeof(neascene_trigger_t);
 
-    if (!ne_scene_system_inited)
+    if ((hdr->nodes_offset & 3) || (hdr->triggers_offset & 3) ||
+        (hdr->nodes_offset > size) ||
+        (nodes_size > size - hdr->nodes_offset) ||
+        (hdr->triggers_offset > size) ||
+        (triggers_size > size - hdr->triggers_offset))
     {
-        NEA_DebugPrint("Scene system not initialized");
-        return NULL;
+        NEA_DebugPrint("Invalid scene tables");
+        return 0;
     }
 
-    FILE *f = fopen(path, "rb");
-    if (f == NULL)
+    NEA_SceneNode *nodes = (NEA_SceneNode *)((uint8_t *)blob +
+                                             hdr->nodes_offset);
+
+    // The size of the arena depends on the types of the nodes
+    int num_portals = 0, num_sectors = 0;
+    for (int i = 0; i < num_nodes; i++)
     {
-        NEA_DebugPrint("Can't open %s", path);
-        return NULL;
+        if (nodes[i].type == NEA_NODE_PORTAL)
+            num_portals++;
+        else if (nodes[i].type == NEA_NODE_SECTOR)
+            num_sectors++;
     }
 
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    if (!ne_scene_arena_alloc(scene, false, hdr->num_triggers, num_portals,
+                              num_sectors))
+        return 0;
 
-    void *data = malloc(fsize);
-    if (data == NULL)
+    if (hdr->num_triggers > 0)
     {
-        NEA_DebugPrint("Not enough memory");
-        fclose(f);
-        return NULL;
-    }
+        const neascene_trigger_t *t = (const neascene_trigger_t *)
+                ((const uint8_t *)blob + hdr->triggers_offset);
 
-    fread(data, 1, fsize, f);
-    fclose(f);
+        for (int i = 0; i < hdr->num_triggers; i++)
+        {
+            NEA_TriggerData *trigger = &scene->triggers[i];
 
-    NEA_Scene *scene = ne_scene_parse(data, (size_t)fsize);
-    free(data);
+            trigger->script_id = t[i].script_id;
 
-    if (scene == NULL)
-        return NULL;
+            if (t[i].shape == 1) // sphere
+            {
+                NEA_ColShapeInitSphereI(&trigger->shape, t[i].params[0]);
+            }
+            else if (t[i].shape == 2) // AABB
+            {
+                NEA_ColShapeInitAABBI(&trigger->shape, t[i].params[0],
+                                      t[i].params[1], t[i].params[2]);
+            }
+        }
+    }
 
-    // --- Auto-load GRF textures from material references ---
-    for (int i = 0; i < scene->num_mat_refs; i++)
-    {
-        scene->materials[i] = NULL;
+    scene->nodes = nodes;
 
-        if (scene->mat_refs[i].tex_path[0] == '\0')
-            continue;
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NEA_SceneNode *node = &nodes[i];
 
-        NEA_Material *mat = NEA_MaterialCreate();
-        if (mat == NULL)
+        if (!ne_scene_relocate_node(&node->parent, nodes, num_nodes) ||
+            !ne_scene_relocate_node(&node->first_child, nodes, num_nodes) ||
+            !ne_scene_relocate_node(&node->next_sibling, nodes, num_nodes))
         {
-            NEA_DebugPrint("Can't create material %d", i);
-            continue;
+            NEA_DebugPrint("Invalid links in node %d", i);
+            return 0;
         }
 
-        if (NEA_MaterialTexLoadGRF(mat, NULL,
-                                    NEA_TEXGEN_TEXCOORD,
-                                    scene->mat_refs[i].tex_path) == 0)
-        {
-            NEA_DebugPrint("Failed to load GRF: %s",
-                           scene->mat_refs[i].tex_path);
-            NEA_MaterialDelete(mat);
-            continue;
-        }
+        uintptr_t trigger = (uintptr_t)node->trigger;
+        if ((node->type != NEA_NODE_TRIGGER) ||
+            (trigger > hdr->num_triggers))
+            trigger = 0;
+        node->trigger = (trigger == 0) ? NULL : &scene->triggers[trigger - 1];
+
+        // Don't trust the contents of the file
+        node->name[NEA_NODE_NAME_LEN - 1] = '\0';
+        if (node->num_tags > NEA_NODE_MAX_TAGS)
+            node->num_tags = NEA_NODE_MAX_TAGS;
+        for (int t = 0; t < node->num_tags; t++)
+            node->tags[t][NEA_NODE_TAG_LEN - 1] = '\0';
+
+        node->wx = node->wy = node->wz = 0;
+        node->model = NULL;
+        node->camera = NULL;
+        node->room_visible = true;
+        node->animmat = NULL;
+        node->user_data = NULL;
+
+        if (node->type == NEA_NODE_ROOM)
+            scene->num_rooms++;
+        else if (node->type == NEA_NODE_PORTAL)
+            scene->num_portals++;
+        else if (node->type == NEA_NODE_SECTOR)
+            scene->num_sectors++;
+    }
+
+    if (hdr->base.version >= 3)
+        return ne_scene_parse_tables_v3(scene, blob, size);
+
+    return 1;
+}
+
+// Frees the nodes of a scene, but not the objects created for them
+static void ne_scene_free_nodes(NEA_Scene *scene)
+{
+    // The nodes of version 2 and 3 scenes are part of the blob, the nodes of
+    // version 1 scenes are part of the arena
+    ne_heap_free(NEA_HEAP_SCENE, scene->blob);
+    ne_heap_free(NEA_HEAP_SCENE, scene->arena);
+    ne_heap_free(NEA_HEAP_SCENE, scene->trigger_grid);
+    ne_heap_free(NEA_HEAP_SCENE, scene->lookup);
+}
+
+static void ne_scene_update(NEA_Scene *scene, bool build_bounds);
+static void ne_scene_build_trigger_grid(NEA_Scene *scene, bool use_tree);
+
+// Parses a scene file. Version 2 and 3 scenes keep the file in RAM. If "owned"
+// is true, the scene uses the provided buffer and it will free it (the caller
+// must check scene->blob). If not, the file is copied.
+static NEA_Scene *ne_scene_parse(void *data, size_t size, bool owned,
+                                 bool async)
+{
+    if (size < sizeof(neascene_header_t))
+    {
+        NEA_DebugPrint("Scene data too small");
+        return NULL;
+    }
+
+    const neascene_header_t *hdr = (const neascene_header_t *)data;
+
+    if (hdr->magic != NEA_SCENE_MAGIC)
+    {
+        NEA_DebugPrint("Invalid .neascene magic");
+        return NULL;
+    }
+
+    size_t header_size;
+    if (hdr->version == 1)
+    {
+        header_size = sizeof(neascene_header_t);
+    }
+    else if (hdr->version == 2)
+    {
+        header_size = sizeof(neascene_header_v2_t);
+    }
+    else if (hdr->version == NEA_SCENE_VERSION)
+    {
+        header_size = sizeof(neascene_header_v3_t);
+    }
+    else
+    {
+        NEA_DebugPrint("Unsupported .neascene version");
+        return NULL;
+    }
+
+    int num_nodes = hdr->num_nodes;
+    if (num_nodes < 1 || num_nodes > ne_scene_max_nodes)
+    {
+        NEA_DebugPrint("Invalid node count");
+        return NULL;
+    }
+
+    if (hdr->num_assets > NEA_SCENE_MAX_ASSETS ||
+        hdr->num_mat_refs > NEA_SCENE_MAX_MATERIALS ||
+        size < header_size + hdr->num_assets * NEASCENE_ASSET_SIZE +
+               hdr->num_mat_refs * NEASCENE_MATREF_SIZE)
+    {
+        NEA_DebugPrint("Invalid scene tables");
+        return NULL;
+    }
+
+    NEA_Scene *scene = ne_heap_calloc(NEA_HEAP_SCENE, 1, sizeof(NEA_Scene));
+    if (scene == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for scene");
+        return NULL;
+    }
+
+    scene->num_nodes = num_nodes;
+    scene->num_assets = hdr->num_assets;
+    scene->num_mat_refs = hdr->num_mat_refs;
+
+    const uint8_t *ptr = (const uint8_t *)data + header_size;
+
+    // --- Parse asset table ---
+    for (int i = 0; i < scene->num_assets; i++)
+    {
+        memcpy(scene->assets[i].path, ptr, 48);
+        scene->assets[i].path[47] = '\0';
+        scene->assets[i].type = ptr[48];
+        scene->assets[i].loaded = false;
+        scene->assets[i].data = NULL;
+        ptr += NEASCENE_ASSET_SIZE;
+    }
+
+    // --- Parse material ref table ---
+    for (int i = 0; i < scene->num_mat_refs; i++)
+    {
+        memcpy(scene->mat_refs[i].name, ptr, 32);
+        scene->mat_refs[i].name[31] = '\0';
+        memcpy(scene->mat_refs[i].tex_path, ptr + 32, 48);
+        scene->mat_refs[i].tex_path[47] = '\0';
+        ptr += NEASCENE_MATREF_SIZE;
+    }
+
+    // --- Parse node table ---
+    int ok;
+    if (hdr->version == 1)
+    {
+        if (size < (size_t)(ptr - (const uint8_t *)data) +
+                   num_nodes * NEASCENE_NODE_SIZE)
+        {
+            NEA_DebugPrint("Scene data too small");
+            ne_heap_free(NEA_HEAP_SCENE, scene);
+            return NULL;
+        }
+
+        ok = ne_scene_parse_nodes_v1(scene, ptr);
+    }
+    else
+    {
+        void *blob = data;
+        if (!owned)
+        {
+            blob = ne_heap_malloc(NEA_HEAP_SCENE, size);
+            if (blob == NULL)
+            {
+                NEA_DebugPrint("Not enough memory for scene data");
+                ne_heap_free(NEA_HEAP_SCENE, scene);
+                return NULL;
+            }
+            memcpy(blob, data, size);
+        }
+
+        ok = ne_scene_relocate_nodes_v2(scene, blob, size);
+    }
+
+    if (!ok)
+        goto error;
+
+    // The world matrices and bounds are computed by NEA_SceneUpdate(), but the
+    // bounds of the subtrees in the file are used until something changes
+    if (scene->local_bounds != NULL)
+    {
+        memcpy(scene->bounds, scene->local_bounds + num_nodes,
+               num_nodes * sizeof(NEA_SceneBounds));
+    }
+
+    for (int i = 0; i < num_nodes; i++)
+        scene->nodes[i].dirty = NE_NODE_DIRTY_LOCAL;
+
+    // --- Build the list of portals ---
+    scene->portal_culling = true;
+
+    if (scene->num_portals > 0)
+    {
+        int n = 0;
+        for (int i = 0; i < num_nodes; i++)
+        {
+            NEA_SceneNode *node = &scene->nodes[i];
+            if (node->type != NEA_NODE_PORTAL)
+                continue;
+
+            // Portals that don't join two rooms are never crossed
+            uint8_t a = node->ref.portal.room_a;
+            uint8_t b = node->ref.portal.room_b;
+            if (a >= num_nodes || scene->nodes[a].type != NEA_NODE_ROOM ||
+                b >= num_nodes || scene->nodes[b].type != NEA_NODE_ROOM)
+            {
+                NEA_DebugPrint("Portal %s doesn't join two rooms", node->name);
+                continue;
+            }
+
+            scene->portals[n++] = node;
+        }
+        scene->num_portals = n;
+    }
+
+    // --- Build the list of sectors ---
+    if (scene->num_sectors > 0)
+    {
+        int n = 0;
+        for (int i = 0; i < num_nodes; i++)
+        {
+            NEA_SceneNode *node = &scene->nodes[i];
+            if (node->type != NEA_NODE_SECTOR)
+                continue;
+
+            // Sectors without a scene are never loaded
+            node->ref.sector.slot = 0xFFFF;
+
+            uint16_t ai = node->ref.sector.asset_index;
+            if (ai >= scene->num_assets || scene->assets[ai].type != 5)
+            {
+                NEA_DebugPrint("Sector %s has no scene", node->name);
+                continue;
+            }
+
+            node->ref.sector.slot = n;
+            scene->sectors[n++].node = node;
+        }
+        scene->num_sectors = n;
+    }
+
+    // --- Create engine objects for mesh and camera nodes ---
+    for (int i = 0; i < num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+
+        if (node->type == NEA_NODE_MESH)
+        {
+            node->model = NEA_ModelCreate(
+                node->ref.mesh.is_animated ? NEA_Animated : NEA_Static);
+
+            if (node->model != NULL)
+            {
+                // Load mesh from asset table if available
+                uint16_t ai = node->ref.mesh.asset_index;
+                if (ai < scene->num_assets &&
+                    scene->assets[ai].path[0] != '\0')
+                {
+                    NEA_SceneAsset *asset = &scene->assets[ai];
+
+                    // Only the first node that uses an asset loads it
+                    bool requested = false;
+                    for (int j = 0; j < i; j++)
+                    {
+                        const NEA_SceneNode *prev = &scene->nodes[j];
+                        if (prev->type == NEA_NODE_MESH && prev->model &&
+                            prev->ref.mesh.asset_index == ai)
+                        {
+                            requested = true;
+                            break;
+                        }
+                    }
+
+                    if (!requested)
+                    {
+                        // Meshes used by other scenes are already cached
+                        asset->data = NEA_CacheGet(NEA_CACHE_MESH, asset->path);
+                        if (asset->data == NULL)
+                        {
+                            if (async)
+                            {
+                                NEA_LoaderAddFile(asset->path,
+                                                  ne_scene_asset_loaded, scene);
+                            }
+                            else
+                            {
+                                asset->data = NEA_CacheLoadMesh(asset->path);
+                            }
+                        }
+
+                        asset->loaded = asset->data != NULL;
+                    }
+
+                    if (asset->loaded)
+                    {
+                        // The data belongs to the cache, see NEA_SceneFree()
+                        NEA_ModelLoadStaticMesh(node->model, asset->data);
+                    }
+                }
+            }
+        }
+        else if (node->type == NEA_NODE_CAMERA)
+        {
+            node->camera = NEA_CameraCreate();
+            if (node->camera != NULL)
+            {
+                NEA_CameraSetI(node->camera,
+                               node->x, node->y, node->z,
+                               node->ref.cam.to[0], node->ref.cam.to[1],
+                               node->ref.cam.to[2],
+                               node->ref.cam.up[0], node->ref.cam.up[1],
+                               node->ref.cam.up[2]);
+            }
+        }
+    }
+
+    // --- Load collision meshes ---
+    for (int i = 0; i < scene->num_assets; i++)
+    {
+        NEA_SceneAsset *asset = &scene->assets[i];
+        if (asset->type != 3 || asset->path[0] == '\0') // colmesh
+            continue;
+
+        asset->data = NEA_CacheGet(NEA_CACHE_COLMESH, asset->path);
+        if (asset->data == NULL)
+        {
+            if (async)
+            {
+                // The mesh is filled in by the loader, a few triangles per
+                // update, and it can be used in the meantime.
+                NEA_ColMesh *mesh = NEA_ColMeshCreate();
+                if ((mesh != NULL) &&
+                    (NEA_LoaderAddColMesh(mesh, asset->path) == 0))
+                {
+                    NEA_ColMeshFree(mesh);
+                    mesh = NULL;
+                }
+                if (mesh != NULL)
+                {
+                    asset->data = NEA_CacheAdd(NEA_CACHE_COLMESH, asset->path,
+                                               mesh);
+                }
+            }
+            else
+            {
+                asset->data = NEA_CacheLoadColMesh(asset->path);
+            }
+        }
+
+        asset->loaded = asset->data != NULL;
+    }
+
+    // Set root
+    scene->root = &scene->nodes[0];
+
+    // Set active camera
+    if (hdr->active_camera_idx != 0xFFFF &&
+        hdr->active_camera_idx < num_nodes)
+    {
+        NEA_SceneNode *cam = &scene->nodes[hdr->active_camera_idx];
+        if (cam->type == NEA_NODE_CAMERA)
+            scene->active_camera = cam;
+    }
+
+    scene->loaded = true;
+
+    // Place the models and cameras in the world
+    ne_scene_update(scene, scene->local_bounds == NULL);
+
+    ne_scene_build_trigger_grid(scene, true);
+    ne_scene_build_lookup(scene);
+
+    return scene;
+
+error:
+    if (owned && (scene->blob == data))
+    {
+        // The buffer is freed by the caller
+        ne_heap_free(NEA_HEAP_SCENE, scene->arena);
+    }
+    else
+    {
+        ne_scene_free_nodes(scene);
+    }
+
+    ne_heap_free(NEA_HEAP_SCENE, scene);
+    return NULL;
+}
+
+NEA_Scene *NEA_SceneLoad(const void *data, size_t size)
+{
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    if (!ne_scene_system_inited)
+    {
+        NEA_DebugPrint("Scene system not initialized");
+        return NULL;
+    }
+
+    return ne_scene_parse((void *)data, size, false, false);
+}
+
+static NEA_Scene *ne_scene_load_fat(const char *path, bool async)
+{
+    NEA_AssertPointer(path, "NULL path");
+
+    if (!ne_scene_system_inited)
+    {
+        NEA_DebugPrint("Scene system not initialized");
+        return NULL;
+    }
+
+    size_t fsize = NEA_FATFileSize(path);
+    if (fsize == (size_t)-1)
+        return NULL;
+
+    void *data = NEA_FATLoadData(path);
+    if (data == NULL)
+        return NULL;
+
+    ne_heap_track(NEA_HEAP_SCENE, data);
+
+    // Version 2 and 3 scenes keep the buffer of the file
+    NEA_Scene *scene = ne_scene_parse(data, fsize, true, async);
+    if ((scene == NULL) || (scene->blob != data))
+        ne_heap_free(NEA_HEAP_SCENE, data);
+
+    if (scene == NULL)
+        return NULL;
+
+    // --- Auto-load GRF textures from material references ---
+    for (int i = 0; i < scene->num_mat_refs; i++)
+    {
+        scene->materials[i] = NULL;
+
+        if (scene->mat_refs[i].tex_path[0] == '\0')
+            continue;
+
+        const char *tex_path = scene->mat_refs[i].tex_path;
+        NEA_Material *mat;
+
+        if (async)
+        {
+            mat = ne_cache_get_texture(tex_path, NEA_TEXGEN_TEXCOORD);
+            if (mat == NULL)
+            {
+                mat = NEA_MaterialCreate();
+                if (mat == NULL)
+                {
+                    NEA_DebugPrint("Can't create material %d", i);
+                    continue;
+                }
+
+                if (NEA_LoaderAddTextureGRF(mat, NULL, NEA_TEXGEN_TEXCOORD,
+                                            tex_path) == 0)
+                {
+                    NEA_MaterialDelete(mat);
+                    mat = NULL;
+                }
+                else
+                {
+                    // The material can be shared before its texture is loaded
+                    mat = ne_cache_add_texture(tex_path, NEA_TEXGEN_TEXCOORD,
+                                               mat);
+                }
+            }
+        }
+        else
+        {
+            mat = NEA_CacheLoadTextureGRF(tex_path, NEA_TEXGEN_TEXCOORD);
+        }
+
+        if (mat == NULL)
+        {
+            NEA_DebugPrint("Failed to load GRF: %s", tex_path);
+            continue;
+        }
 
         scene->materials[i] = mat;
     }
 
-    // --- Bind auto-loaded materials to mesh nodes ---
+    // --- Bind auto-loaded materials to mesh nodes ---
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+        if (node->type != NEA_NODE_MESH || node->model == NULL)
+            continue;
+
+        uint16_t mi = node->ref.mesh.material_index;
+        if (mi == 0xFFFF || mi >= scene->num_mat_refs)
+            continue;
+
+        if (scene->materials[mi] != NULL)
+            NEA_ModelSetMaterial(node->model, scene->materials[mi]);
+    }
+
+    // Meshes that were already in the cache are ready to be merged. The
+    // others are merged when the last one has been loaded.
+    ne_scene_batch_if_loaded(scene);
+
+    return scene;
+}
+
+NEA_Scene *NEA_SceneLoadFAT(const char *path)
+{
+    return ne_scene_load_fat(path, false);
+}
+
+NEA_Scene *NEA_SceneLoadFATAsync(const char *path)
+{
+    return ne_scene_load_fat(path, true);
+}
+
+static void ne_scene_sector_free(NEA_Scene *scene, NEA_SceneSector *sector)
+{
+    if (sector->scene == NULL)
+        return;
+
+    if (scene->sector_callback != NULL)
+    {
+        scene->sector_callback(sector->node, sector->scene, false,
+                               scene->sector_callback_arg);
+    }
+
+    NEA_SceneFree(sector->scene);
+    sector->scene = NULL;
+}
+
+void NEA_SceneFree(NEA_Scene *scene)
+{
+    if (scene == NULL)
+        return;
+
+    // Stop loading the meshes of the scene
+    NEA_LoaderCancel(scene);
+
+    for (int i = 0; i < scene->num_sectors; i++)
+        ne_scene_sector_free(scene, &scene->sectors[i]);
+
+    for (int i = 0; i < scene->num_batches; i++)
+        NEA_ModelDelete(scene->batches[i].model);
+    ne_heap_free(NEA_HEAP_SCENE, scene->batches);
+
+    // Delete engine objects
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+
+        if (node->model != NULL)
+            NEA_ModelDelete(node->model);
+        if (node->camera != NULL)
+            NEA_CameraDelete(node->camera);
+        if (node->animmat != NULL)
+            NEA_AnimMatDelete(node->animmat);
+    }
+
+    // Release auto-loaded materials. They are only deleted if no other scene
+    // uses them.
+    for (int i = 0; i < scene->num_mat_refs; i++)
+        NEA_CacheRelease(scene->materials[i]);
+
+    // Release loaded assets
+    for (int i = 0; i < scene->num_assets; i++)
+    {
+        if (scene->assets[i].loaded)
+            NEA_CacheRelease(scene->assets[i].data);
+    }
+
+    ne_scene_free_nodes(scene);
+    ne_heap_free(NEA_HEAP_SCENE, scene);
+}
+
+// =========================================================================
+// Node access
+// =========================================================================
+
+NEA_SceneNode *NEA_SceneGetRoot(const NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    return scene->root;
+}
+
+NEA_SceneNode *NEA_SceneFindNode(const NEA_Scene *scene, const char *name)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(name, "NULL name");
+
+    const ne_scene_lookup_t *lookup = scene->lookup;
+
+    if (lookup != NULL)
+    {
+        u32 hash = ne_pack_hash(name);
+        u32 slot = hash & lookup->name_mask;
+
+        while (lookup->names[slot] >= 0)
+        {
+            int i = lookup->names[slot];
+            if ((lookup->name_hashes[i] == hash) &&
+                (strcmp(scene->nodes[i].name, name) == 0))
+                return &scene->nodes[i];
+
+            slot = (slot + 1) & lookup->name_mask;
+        }
+
+        return NULL;
+    }
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        if (strcmp(scene->nodes[i].name, name) == 0)
+            return &scene->nodes[i];
+    }
+    return NULL;
+}
+
+NEA_SceneNode *NEA_SceneGetActiveCamera(const NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    return scene->active_camera;
+}
+
+void NEA_SceneSetActiveCamera(NEA_Scene *scene, NEA_SceneNode *cam_node)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    if (cam_node != NULL)
+        NEA_Assert(cam_node->type == NEA_NODE_CAMERA,
+                   "Node is not a camera");
+    scene->active_camera = cam_node;
+}
+
+// =========================================================================
+// Tag queries
+// =========================================================================
+
+NEA_SceneNode *NEA_SceneFindByTag(const NEA_Scene *scene, const char *tag)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(tag, "NULL tag");
+
+    if (scene->lookup != NULL)
+    {
+        const ne_scene_lookup_t *lookup = scene->lookup;
+        const ne_scene_tag_t *entry = ne_scene_tag_find(scene, tag);
+        if (entry == NULL)
+            return NULL;
+
+        return &scene->nodes[lookup->tag_nodes[entry->first]];
+    }
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        if (ne_node_has_tag(&scene->nodes[i], tag))
+            return &scene->nodes[i];
+    }
+    return NULL;
+}
+
+int NEA_SceneForEachTag(const NEA_Scene *scene, const char *tag,
+                        NEA_NodeVisitor visitor, void *arg)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(tag, "NULL tag");
+    NEA_AssertPointer(visitor, "NULL visitor");
+
+    if (scene->lookup != NULL)
+    {
+        const ne_scene_lookup_t *lookup = scene->lookup;
+        const ne_scene_tag_t *entry = ne_scene_tag_find(scene, tag);
+        if (entry == NULL)
+            return 0;
+
+        for (int i = 0; i < entry->count; i++)
+            visitor(&scene->nodes[lookup->tag_nodes[entry->first + i]], arg);
+
+        return entry->count;
+    }
+
+    int count = 0;
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        if (ne_node_has_tag(&scene->nodes[i], tag))
+        {
+            visitor(&scene->nodes[i], arg);
+            count++;
+        }
+    }
+    return count;
+}
+
+int NEA_SceneCountByTag(const NEA_Scene *scene, const char *tag)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(tag, "NULL tag");
+
+    if (scene->lookup != NULL)
+    {
+        const ne_scene_tag_t *entry = ne_scene_tag_find(scene, tag);
+        return (entry == NULL) ? 0 : entry->count;
+    }
+
+    int count = 0;
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        if (ne_node_has_tag(&scene->nodes[i], tag))
+            count++;
+    }
+    return count;
+}
+
+// =========================================================================
+// Node manipulation
+// =========================================================================
+
+void NEA_SceneNodeSetCoordI(NEA_SceneNode *node,
+                             int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->x = x;
+    node->y = y;
+    node->z = z;
+    NEA_SceneNodeTransformChanged(node);
+}
+
+void NEA_SceneNodeSetRot(NEA_SceneNode *node, int rx, int ry, int rz)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->rx = rx;
+    node->ry = ry;
+    node->rz = rz;
+    NEA_SceneNodeTransformChanged(node);
+}
+
+void NEA_SceneNodeSetScaleI(NEA_SceneNode *node,
+                             int32_t sx, int32_t sy, int32_t sz)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->sx = sx;
+    node->sy = sy;
+    node->sz = sz;
+    NEA_SceneNodeTransformChanged(node);
+}
+
+void NEA_SceneNodeTransformChanged(NEA_SceneNode *node)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->dirty |= NE_NODE_DIRTY_LOCAL;
+
+    // If a parent is already marked, all the nodes above it are marked too
+    NEA_SceneNode *parent = node->parent;
+    while (parent != NULL && !(parent->dirty & NE_NODE_DIRTY_CHILD))
+    {
+        parent->dirty |= NE_NODE_DIRTY_CHILD;
+        parent = parent->parent;
+    }
+}
+
+void NEA_SceneNodeSetVisible(NEA_SceneNode *node, bool visible)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->visible = visible;
+}
+
+// Triggers and sectors don't look at their parents, so the flags of the
+// subtree are updated when a branch is disabled or enabled.
+static void ne_scene_node_set_dormant(NEA_SceneNode *node, bool dormant)
+{
+    dormant |= (node->dirty & (NE_NODE_INACTIVE | NE_NODE_FROZEN)) != 0;
+
+    if (dormant)
+        node->dirty |= NE_NODE_DORMANT;
+    else
+        node->dirty &= ~NE_NODE_DORMANT;
+
+    for (NEA_SceneNode *c = node->first_child; c != NULL; c = c->next_sibling)
+        ne_scene_node_set_dormant(c, dormant);
+}
+
+static void ne_scene_node_set_flag(NEA_SceneNode *node, uint8_t flag, bool set)
+{
+    uint8_t old = node->dirty;
+
+    if (set)
+        node->dirty |= flag;
+    else
+        node->dirty &= ~flag;
+
+    if (node->dirty == old)
+        return;
+
+    bool parent_dormant = (node->parent != NULL) &&
+                          (node->parent->dirty & NE_NODE_DORMANT);
+    ne_scene_node_set_dormant(node, parent_dormant);
+
+    // The subtree has missed the changes of its parents while it was disabled
+    if (!(node->dirty & (NE_NODE_INACTIVE | NE_NODE_FROZEN)))
+        NEA_SceneNodeTransformChanged(node);
+}
+
+void NEA_SceneNodeSetActive(NEA_SceneNode *node, bool active)
+{
+    NEA_AssertPointer(node, "NULL node");
+    ne_scene_node_set_flag(node, NE_NODE_INACTIVE, !active);
+}
+
+void NEA_SceneNodeSetFrozen(NEA_SceneNode *node, bool frozen)
+{
+    NEA_AssertPointer(node, "NULL node");
+    ne_scene_node_set_flag(node, NE_NODE_FROZEN, frozen);
+}
+
+bool NEA_SceneNodeIsDormant(const NEA_SceneNode *node)
+{
+    NEA_AssertPointer(node, "NULL node");
+    return node->dirty & NE_NODE_DORMANT;
+}
+
+void NEA_SceneNodeSetUserData(NEA_SceneNode *node, void *data)
+{
+    NEA_AssertPointer(node, "NULL node");
+    node->user_data = data;
+}
+
+void *NEA_SceneNodeGetUserData(const NEA_SceneNode *node)
+{
+    NEA_AssertPointer(node, "NULL node");
+    return node->user_data;
+}
+
+// =========================================================================
+// Scene update
+// =========================================================================
+
+// Internal use... see NEAModel.c
+void ne_model_build_transform(m4x3 *out, int x, int y, int z,
+                              int rx, int ry, int rz,
+                              int sx, int sy, int sz);
+
+// Builds the world matrix of a node. With row vectors, the world matrix is the
+// local matrix multiplied by the world matrix of the parent.
+ARM_CODE static void ne_scene_node_world(m4x3 *world, const NEA_SceneNode *node,
+                                         const m4x3 *parent)
+{
+    if (parent == NULL)
+    {
+        ne_model_build_transform(world, node->x, node->y, node->z,
+                                 node->rx, node->ry, node->rz,
+                                 node->sx, node->sy, node->sz);
+        return;
+    }
+
+    m4x3 local;
+    ne_model_build_transform(&local, node->x, node->y, node->z,
+                             node->rx, node->ry, node->rz,
+                             node->sx, node->sy, node->sz);
+
+    const int32_t *l = &local.m[0];
+    const int32_t *p = &parent->m[0];
+    int32_t *w = &world->m[0];
+
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            w[i * 3 + j] = mulf32(l[i * 3 + 0], p[0 * 3 + j])
+                         + mulf32(l[i * 3 + 1], p[1 * 3 + j])
+                         + mulf32(l[i * 3 + 2], p[2 * 3 + j]);
+        }
+    }
+
+    // The translation row is a point, add the translation of the parent
+    w[9] += p[9];
+    w[10] += p[10];
+    w[11] += p[11];
+}
+
+// Internal use... see NEAModel.c
+void ne_sphere_transform(const int32_t *center, int32_t radius,
+                         const m4x3 *mat, int32_t *out);
+void ne_model_sphere_transform(const NEA_Model *model, const m4x3 *mat,
+                               int32_t *out);
+
+// Adds a sphere to a box
+static void ne_scene_box_add(int32_t *min, int32_t *max, const int32_t *center,
+                             int32_t radius)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (center[i] - radius < min[i])
+            min[i] = center[i] - radius;
+        if (center[i] + radius > max[i])
+            max[i] = center[i] + radius;
+    }
+}
+
+// Builds the bounds of the subtree of a node from the bounds of its model and
+// the bounds of its children. The box that contains all the spheres is
+// computed first, and the bounds are the sphere around that box.
+ARM_CODE static void ne_scene_node_bounds(NEA_Scene *scene, NEA_SceneNode *node)
+{
+    int index = node - scene->nodes;
+    NEA_SceneBounds *bounds = &scene->bounds[index];
+    const m4x3 *world = &scene->world[index];
+
+    int32_t min[3] = { INT32_MAX, INT32_MAX, INT32_MAX };
+    int32_t max[3] = { INT32_MIN, INT32_MIN, INT32_MIN };
+    bool empty = true;
+
+    // Bounds exported with the scene, if any
+    const NEA_SceneBounds *local = NULL;
+    if (scene->local_bounds != NULL && scene->local_bounds[index].radius >= 0)
+        local = &scene->local_bounds[index];
+
+    int32_t sphere[4];
+
+    if (node->type == NEA_NODE_SECTOR)
+    {
+        // The scenes of sectors have their own bounds. They can only be culled
+        // if the file says where they are.
+        if (local == NULL)
+        {
+            bounds->radius = NE_BOUNDS_INFINITE;
+            return;
+        }
+
+        ne_sphere_transform(local->center, local->radius, world, sphere);
+        ne_scene_box_add(min, max, sphere, sphere[3]);
+        empty = false;
+    }
+    else if (node->type == NEA_NODE_MESH && node->model != NULL)
+    {
+        NEA_Model *model = node->model;
+
+        if ((model->bound_radius != 0) &&
+            (model->multi != NULL || model->meshindex != NEA_NO_MESH))
+        {
+            ne_model_sphere_transform(model, world, sphere);
+        }
+        else if (local != NULL)
+        {
+            // The mesh has no bounds, or it hasn't been loaded yet
+            ne_sphere_transform(local->center, local->radius, world, sphere);
+        }
+        else
+        {
+            // Models without bounds are always drawn. Models without mesh are
+            // treated the same way, their mesh may be loaded before the next
+            // update.
+            bounds->radius = NE_BOUNDS_INFINITE;
+            return;
+        }
+
+        ne_scene_box_add(min, max, sphere, sphere[3]);
+        empty = false;
+    }
+
+    NEA_SceneNode *child = node->first_child;
+    while (child != NULL)
+    {
+        const NEA_SceneBounds *b = &scene->bounds[child - scene->nodes];
+
+        if (b->radius == NE_BOUNDS_INFINITE)
+        {
+            bounds->radius = NE_BOUNDS_INFINITE;
+            return;
+        }
+
+        if (b->radius >= 0)
+        {
+            ne_scene_box_add(min, max, b->center, b->radius);
+            empty = false;
+        }
+
+        child = child->next_sibling;
+    }
+
+    if (empty)
+    {
+        bounds->radius = -1;
+        return;
+    }
+
+    int64_t len2 = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int32_t half = (max[i] - min[i] + 1) / 2;
+        bounds->center[i] = min[i] + half;
+        len2 += (int64_t)half * half;
+    }
+
+    bounds->radius = sqrt64(len2) + 1;
+}
+
+static void ne_scene_grid_move(NEA_Scene *scene, NEA_SceneNode *node);
+
+// Recursive transform propagation. Subtrees without changes are skipped, and
+// only nodes that have changed, or whose parent has changed, are computed.
+ARM_CODE static void ne_scene_update_recursive(NEA_Scene *scene,
+                                                NEA_SceneNode *node,
+                                                const m4x3 *parent,
+                                                bool parent_changed,
+                                                bool build_bounds)
+{
+    // Disabled branches keep their flags until they are enabled again, and
+    // changes inside them don't mark the nodes above them.
+    if (node->dirty & (NE_NODE_INACTIVE | NE_NODE_FROZEN))
+        return;
+
+    bool changed = parent_changed || (node->dirty & NE_NODE_DIRTY_LOCAL);
+
+    if (!changed && !(node->dirty & NE_NODE_DIRTY_CHILD))
+        return;
+
+    node->dirty &= ~NE_NODE_DIRTY_MASK;
+
+    m4x3 *world = &scene->world[node - scene->nodes];
+
+    if (changed)
+    {
+        ne_scene_node_world(world, node, parent);
+
+        node->wx = world->m[9];
+        node->wy = world->m[10];
+        node->wz = world->m[11];
+
+        // Sync to engine objects
+        if (node->type == NEA_NODE_MESH && node->model != NULL)
+        {
+            if (NEA_ModelSetMatrix(node->model, world) == 0)
+                NEA_DebugPrint("Not enough memory for matrix");
+
+            // Some systems only look at the position of the model
+            NEA_ModelSetCoordI(node->model, node->wx, node->wy, node->wz);
+        }
+        else if (node->type == NEA_NODE_CAMERA && node->camera != NULL)
+        {
+            // Update camera from position. If the camera has a look-at target
+            // stored in ref.cam.to, offset it by world position.
+            node->camera->from[0] = node->wx;
+            node->camera->from[1] = node->wy;
+            node->camera->from[2] = node->wz;
+            node->camera->to[0] = node->wx + node->ref.cam.to[0];
+            node->camera->to[1] = node->wy + node->ref.cam.to[1];
+            node->camera->to[2] = node->wz + node->ref.cam.to[2];
+            node->camera->up[0] = node->ref.cam.up[0];
+            node->camera->up[1] = node->ref.cam.up[1];
+            node->camera->up[2] = node->ref.cam.up[2];
+            node->camera->matrix_is_updated = false;
+        }
+        else if (node->type == NEA_NODE_TRIGGER && scene->trigger_grid != NULL)
+        {
+            ne_scene_grid_move(scene, node);
+        }
+    }
+
+    // Recurse children
+    NEA_SceneNode *child = node->first_child;
+    while (child != NULL)
+    {
+        ne_scene_update_recursive(scene, child, world, changed, build_bounds);
+        child = child->next_sibling;
+    }
+
+    // The children are up to date, so the bounds can be built
+    if (build_bounds)
+        ne_scene_node_bounds(scene, node);
+}
+
+// When the scene is loaded, the bounds of the file don't need to be built
+static void ne_scene_update(NEA_Scene *scene, bool build_bounds)
+{
+    ne_scene_update_recursive(scene, scene->root, NULL, false, build_bounds);
+}
+
+void NEA_SceneUpdate(NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+
+    if (!scene->loaded || scene->root == NULL)
+        return;
+
+    ne_scene_update(scene, true);
+
+    for (int i = 0; i < scene->num_sectors; i++)
+    {
+        NEA_SceneSector *sector = &scene->sectors[i];
+        if (sector->scene != NULL && !(sector->node->dirty & NE_NODE_DORMANT))
+            NEA_SceneUpdate(sector->scene);
+    }
+}
+
+// =========================================================================
+// Trigger testing
+// =========================================================================
+
+// Triggers are sorted in a uniform grid over the X and Z axes. It is a loose
+// grid: each trigger is only added to the cell that contains its center, and
+// queries also look at the cells around them, as far as the biggest trigger
+// reaches. Positions outside of the grid are clamped to the cells of the
+// border, so triggers that move away from the grid are still found.
+//
+// Version 3 scenes may have a tree of boxes around the triggers built by the
+// exporter. It is used instead of the cells until a trigger moves.
+
+#define NE_SCENE_GRID_MAX_DIM   16 // Max number of cells on each axis
+
+typedef struct {
+    NEA_SceneNode *node;
+    int16_t next;           // Next trigger in the same cell, or -1
+    int16_t cell;           // Cell that contains the center of the trigger
+    uint16_t stamp;         // Last query that has tested the trigger
+    bool listed;            // The trigger is in the list of active triggers
+} ne_scene_grid_item_t;
+
+typedef struct {
+    int32_t min_x, min_z;   // Corner of the grid (f32)
+    int shift;              // Size of the cells is (1 << shift) (f32)
+    int dim_x, dim_z;       // Number of cells
+    int32_t reach_x, reach_z; // Max extents of the triggers from their centers
+    uint16_t stamp;         // Current query
+    int num_items;
+    int num_active;
+    int16_t *cells;         // First trigger of each cell, or -1
+    int16_t *node_item;     // Index of the trigger of each node, or -1
+    int16_t *active;        // Triggers that have something inside
+    ne_scene_grid_item_t *items;
+    const neascene_tree_node_t *tree; // Tree of the file, or NULL
+    const uint16_t *tree_items;
+    int tree_nodes;
+} ne_scene_grid_t;
+
+// Extents of a shape from its position on each axis
+static void ne_scene_shape_extents(const NEA_ColShape *shape, int32_t *ex,
+                                   int32_t *ey, int32_t *ez)
+{
+    switch (shape->type)
+    {
+        case NEA_COL_AABB:
+            *ex = shape->shape.aabb.half.x;
+            *ey = shape->shape.aabb.half.y;
+            *ez = shape->shape.aabb.half.z;
+            break;
+        case NEA_COL_SPHERE:
+            *ex = *ey = *ez = shape->shape.sphere.radius;
+            break;
+        case NEA_COL_CAPSULE:
+            *ex = *ez = shape->shape.capsule.radius;
+            *ey = shape->shape.capsule.radius
+                + shape->shape.capsule.half_height;
+            break;
+        case NEA_COL_TRIMESH:
+        {
+            const NEA_ColMesh *mesh = shape->shape.mesh;
+            if (mesh == NULL)
+            {
+                *ex = *ey = *ez = 0;
+                break;
+            }
+            *ex = abs(mesh->center.x) + mesh->bounds.half.x;
+            *ey = abs(mesh->center.y) + mesh->bounds.half.y;
+            *ez = abs(mesh->center.z) + mesh->bounds.half.z;
+            break;
+        }
+        default:
+            *ex = *ey = *ez = 0;
+            break;
+    }
+}
+
+static int ne_scene_grid_cell_x(const ne_scene_grid_t *grid, int32_t x)
+{
+    int32_t c = (x - grid->min_x) >> grid->shift;
+    if (c < 0)
+        return 0;
+    if (c >= grid->dim_x)
+        return grid->dim_x - 1;
+    return c;
+}
+
+static int ne_scene_grid_cell_z(const ne_scene_grid_t *grid, int32_t z)
+{
+    int32_t c = (z - grid->min_z) >> grid->shift;
+    if (c < 0)
+        return 0;
+    if (c >= grid->dim_z)
+        return grid->dim_z - 1;
+    return c;
+}
+
+static int ne_scene_grid_cell(const ne_scene_grid_t *grid,
+                              const NEA_SceneNode *node)
+{
+    return ne_scene_grid_cell_z(grid, node->wz) * grid->dim_x
+           + ne_scene_grid_cell_x(grid, node->wx);
+}
+
+// The tree of the file is only valid for the positions and shapes of the
+// triggers when the scene is loaded.
+static void ne_scene_build_trigger_grid(NEA_Scene *scene, bool use_tree)
+{
+    ne_heap_free(NEA_HEAP_SCENE, scene->trigger_grid);
+    scene->trigger_grid = NULL;
+
+    int count = 0;
+    int32_t min_x = INT32_MAX, min_z = INT32_MAX;
+    int32_t max_x = INT32_MIN, max_z = INT32_MIN;
+    int32_t reach_x = 0, reach_z = 0;
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+        if (node->type != NEA_NODE_TRIGGER || node->trigger == NULL)
+            continue;
+
+        int32_t ex, ey, ez;
+        ne_scene_shape_extents(&node->trigger->shape, &ex, &ey, &ez);
+
+        reach_x = (ex > reach_x) ? ex : reach_x;
+        reach_z = (ez > reach_z) ? ez : reach_z;
+        min_x = (node->wx < min_x) ? node->wx : min_x;
+        min_z = (node->wz < min_z) ? node->wz : min_z;
+        max_x = (node->wx > max_x) ? node->wx : max_x;
+        max_z = (node->wz > max_z) ? node->wz : max_z;
+
+        count++;
+    }
+
+    // Scenes with few triggers are faster to test without the grid
+    if (count < 2 || count > INT16_MAX)
+        return;
+
+    // Cells should be at least as big as the triggers, but there is a limit to
+    // the number of cells.
+    int shift = 12;
+    while ((shift < 30) && ((1 << shift) < reach_x || (1 << shift) < reach_z))
+        shift++;
+    while ((shift < 30) &&
+           ((((max_x - min_x) >> shift) >= NE_SCENE_GRID_MAX_DIM) ||
+            (((max_z - min_z) >> shift) >= NE_SCENE_GRID_MAX_DIM)))
+        shift++;
+
+    int dim_x = ((max_x - min_x) >> shift) + 1;
+    int dim_z = ((max_z - min_z) >> shift) + 1;
+    int num_cells = dim_x * dim_z;
+
+    // Everything goes in one allocation
+    size_t size = sizeof(ne_scene_grid_t)
+                + count * sizeof(ne_scene_grid_item_t)
+                + (num_cells + scene->num_nodes + count) * sizeof(int16_t);
+
+    ne_scene_grid_t *grid = ne_heap_malloc(NEA_HEAP_SCENE, size);
+    if (grid == NULL)
+    {
+        // Triggers can still be tested one by one
+        NEA_DebugPrint("Not enough memory for trigger grid");
+        return;
+    }
+
+    grid->items = (ne_scene_grid_item_t *)(grid + 1);
+    grid->cells = (int16_t *)(grid->items + count);
+    grid->node_item = grid->cells + num_cells;
+    grid->active = grid->node_item + scene->num_nodes;
+
+    grid->min_x = min_x;
+    grid->min_z = min_z;
+    grid->shift = shift;
+    grid->dim_x = dim_x;
+    grid->dim_z = dim_z;
+    grid->reach_x = reach_x;
+    grid->reach_z = reach_z;
+    grid->stamp = 0;
+    grid->num_items = 0;
+    grid->num_active = 0;
+    grid->tree = NULL;
+    grid->tree_items = NULL;
+    grid->tree_nodes = 0;
+
+    const neascene_header_v3_t *hdr = scene->blob;
+    if (use_tree && (hdr != NULL) && (hdr->v2.base.version >= 3) &&
+        (hdr->tree_offset != 0))
+    {
+        // It has been checked by ne_scene_parse_tables_v3()
+        grid->tree = (const neascene_tree_node_t *)
+                ((const uint8_t *)hdr + hdr->tree_offset);
+        grid->tree_items = (const uint16_t *)(grid->tree + hdr->num_tree_nodes);
+        grid->tree_nodes = hdr->num_tree_nodes;
+    }
+
+    for (int i = 0; i < num_cells; i++)
+        grid->cells[i] = -1;
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+        grid->node_item[i] = -1;
+
+        if (node->type != NEA_NODE_TRIGGER || node->trigger == NULL)
+            continue;
+
+        int index = grid->num_items++;
+        ne_scene_grid_item_t *item = &grid->items[index];
+        int cell = ne_scene_grid_cell(grid, node);
+
+        item->node = node;
+        item->cell = cell;
+        item->next = grid->cells[cell];
+        item->stamp = 0;
+        item->listed = node->trigger->is_active;
+        grid->cells[cell] = index;
+        grid->node_item[i] = index;
+
+        if (item->listed)
+            grid->active[grid->num_active++] = index;
+    }
+
+    scene->trigger_grid = grid;
+}
+
+void NEA_SceneRebuildTriggerGrid(NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+
+    ne_scene_build_trigger_grid(scene, false);
+}
+
+// Moves a trigger to the cell of its current position
+static void ne_scene_grid_move(NEA_Scene *scene, NEA_SceneNode *node)
+{
+    ne_scene_grid_t *grid = scene->trigger_grid;
+
+    int index = grid->node_item[node - scene->nodes];
+    if (index < 0)
+        return;
+
+    // The boxes of the tree don't contain the trigger anymore
+    grid->tree = NULL;
+
+    ne_scene_grid_item_t *item = &grid->items[index];
+    int cell = ne_scene_grid_cell(grid, node);
+    if (cell == item->cell)
+        return;
+
+    int16_t *link = &grid->cells[item->cell];
+    while (*link != index)
+        link = &grid->items[*link].next;
+    *link = item->next;
+
+    item->cell = cell;
+    item->next = grid->cells[cell];
+    grid->cells[cell] = index;
+}
+
+// Tests one trigger and calls its callback. Returns true if the shape has
+// entered the trigger.
+static bool ne_scene_trigger_test(NEA_SceneNode *node, const NEA_ColShape *shape,
+                                  NEA_Vec3 pos, void *user_data)
+{
+    NEA_Vec3 trigger_pos = NEA_Vec3Make(node->wx, node->wy, node->wz);
+
+    NEA_ColResult result = NEA_ColTest(&node->trigger->shape, trigger_pos,
+                                       shape, pos);
+
+    bool was_active = node->trigger->is_active;
+    bool is_inside = result.hit;
+
+    if (is_inside && !was_active)
+    {
+        // Enter
+        node->trigger->is_active = true;
+        if (node->trigger->on_event)
+            node->trigger->on_event(node, NEA_TRIGGER_ENTER, user_data);
+        return true;
+    }
+    else if (is_inside && was_active)
+    {
+        // Tick (still inside)
+        if (node->trigger->on_event)
+            node->trigger->on_event(node, NEA_TRIGGER_TICK, user_data);
+    }
+    else if (!is_inside && was_active)
+    {
+        // Exit
+        node->trigger->is_active = false;
+        if (node->trigger->on_event)
+            node->trigger->on_event(node, NEA_TRIGGER_EXIT, user_data);
+    }
+
+    return false;
+}
+
+// Tests a trigger of the grid and adds it to the list of active triggers if
+// the shape has entered it
+static void ne_scene_grid_test_item(ne_scene_grid_t *grid, int index,
+                                    const NEA_ColShape *shape, NEA_Vec3 pos,
+                                    void *user_data)
+{
+    ne_scene_grid_item_t *item = &grid->items[index];
+    NEA_SceneNode *node = item->node;
+
+    item->stamp = grid->stamp;
+
+    if (node->visible && !(node->dirty & NE_NODE_DORMANT) &&
+        ne_scene_trigger_test(node, shape, pos, user_data) && !item->listed)
+    {
+        item->listed = true;
+        grid->active[grid->num_active++] = index;
+    }
+}
+
+// Tests the triggers of the leaves of the tree whose boxes touch the box of the
+// shape
+static void ne_scene_tree_test(ne_scene_grid_t *grid, const NEA_ColShape *shape,
+                               NEA_Vec3 pos, void *user_data)
+{
+    int32_t ex, ey, ez;
+    ne_scene_shape_extents(shape, &ex, &ey, &ez);
+
+    int32_t min[3] = { pos.x - ex, pos.y - ey, pos.z - ez };
+    int32_t max[3] = { pos.x + ex, pos.y + ey, pos.z + ez };
+
+    int i = 0;
+    while (i < grid->tree_nodes)
+    {
+        const neascene_tree_node_t *tn = &grid->tree[i];
+
+        if ((tn->min[0] > max[0]) || (tn->max[0] < min[0]) ||
+            (tn->min[1] > max[1]) || (tn->max[1] < min[1]) ||
+            (tn->min[2] > max[2]) || (tn->max[2] < min[2]))
+        {
+            i = tn->skip;
+            continue;
+        }
+
+        if (tn->count == 0)
+        {
+            i++;
+            continue;
+        }
+
+        for (int j = 0; j < tn->count; j++)
+        {
+            int index = grid->node_item[grid->tree_items[tn->first + j]];
+            if (index >= 0)
+                ne_scene_grid_test_item(grid, index, shape, pos, user_data);
+        }
+
+        i = tn->skip;
+    }
+}
+
+static void ne_scene_grid_test(ne_scene_grid_t *grid, const NEA_ColShape *shape,
+                               NEA_Vec3 pos, void *user_data)
+{
+    // Reset the stamps when the counter wraps around
+    grid->stamp++;
+    if (grid->stamp == 0)
+    {
+        for (int i = 0; i < grid->num_items; i++)
+            grid->items[i].stamp = 0;
+        grid->stamp = 1;
+    }
+
+    if (grid->tree != NULL)
+    {
+        ne_scene_tree_test(grid, shape, pos, user_data);
+    }
+    else
+    {
+        int32_t ex, ey, ez;
+        ne_scene_shape_extents(shape, &ex, &ey, &ez);
+        ex += grid->reach_x;
+        ez += grid->reach_z;
+
+        int x0 = ne_scene_grid_cell_x(grid, pos.x - ex);
+        int x1 = ne_scene_grid_cell_x(grid, pos.x + ex);
+        int z0 = ne_scene_grid_cell_z(grid, pos.z - ez);
+        int z1 = ne_scene_grid_cell_z(grid, pos.z + ez);
+
+        for (int cz = z0; cz <= z1; cz++)
+        {
+            for (int cx = x0; cx <= x1; cx++)
+            {
+                int index = grid->cells[cz * grid->dim_x + cx];
+                while (index >= 0)
+                {
+                    int next = grid->items[index].next;
+                    ne_scene_grid_test_item(grid, index, shape, pos,
+                                            user_data);
+                    index = next;
+                }
+            }
+        }
+    }
+
+    // Triggers that had something inside and haven't been tested are too far
+    // from the shape, so it has left them.
+    int n = 0;
+    for (int i = 0; i < grid->num_active; i++)
+    {
+        int index = grid->active[i];
+        ne_scene_grid_item_t *item = &grid->items[index];
+        NEA_SceneNode *node = item->node;
+        NEA_TriggerData *trigger = node->trigger;
+
+        if ((item->stamp != grid->stamp) && node->visible &&
+            !(node->dirty & NE_NODE_DORMANT) && trigger->is_active)
+        {
+            trigger->is_active = false;
+            if (trigger->on_event)
+                trigger->on_event(node, NEA_TRIGGER_EXIT, user_data);
+        }
+
+        if (trigger->is_active)
+            grid->active[n++] = index;
+        else
+            item->listed = false;
+    }
+    grid->num_active = n;
+}
+
+void NEA_SceneTestTriggers(NEA_Scene *scene, const NEA_ColShape *shape,
+                           NEA_Vec3 pos, void *user_data)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(shape, "NULL shape");
+
+    if (scene->trigger_grid != NULL)
+    {
+        ne_scene_grid_test(scene->trigger_grid, shape, pos, user_data);
+    }
+    else
+    {
+        for (int i = 0; i < scene->num_nodes; i++)
+        {
+            NEA_SceneNode *node = &scene->nodes[i];
+            if (node->type != NEA_NODE_TRIGGER || node->trigger == NULL)
+                continue;
+            if (!node->visible || (node->dirty & NE_NODE_DORMANT))
+                continue;
+
+            ne_scene_trigger_test(node, shape, pos, user_data);
+        }
+    }
+
+    for (int i = 0; i < scene->num_sectors; i++)
+    {
+        NEA_SceneSector *sector = &scene->sectors[i];
+        if (sector->scene != NULL && !(sector->node->dirty & NE_NODE_DORMANT))
+            NEA_SceneTestTriggers(sector->scene, shape, pos, user_data);
+    }
+}
+
+// =========================================================================
+// Portal visibility
+// =========================================================================
+
+// Internal use... see NEACamera.c
+const int32_t *ne_camera_frustum_clip(void);
+
+// Region of the screen in normalized device coordinates (f32)
+typedef struct {
+    int32_t x0, y0, x1, y1;
+} ne_portal_rect_t;
+
+void NEA_ScenePortalCulling(NEA_Scene *scene, bool enable)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    scene->portal_culling = enable;
+}
+
+NEA_SceneNode *NEA_SceneGetCameraRoom(const NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+    return scene->camera_room;
+}
+
+bool NEA_SceneRoomIsVisible(const NEA_SceneNode *room)
+{
+    NEA_AssertPointer(room, "NULL node");
+    NEA_Assert(room->type == NEA_NODE_ROOM, "Node isn't a room");
+    return room->room_visible;
+}
+
+static bool ne_scene_point_in_room(const NEA_SceneNode *room,
+                                   const int32_t *p)
+{
+    const int32_t *half = room->ref.room.half;
+
+    return (p[0] >= room->wx - half[0]) && (p[0] <= room->wx + half[0]) &&
+           (p[1] >= room->wy - half[1]) && (p[1] <= room->wy + half[1]) &&
+           (p[2] >= room->wz - half[2]) && (p[2] <= room->wz + half[2]);
+}
+
+// Converts a clip coordinate to a normalized device coordinate, clamped to
+// [-2, 2] so that the hardware divider can be used. The divisor of the divider
+// is 32-bit, so big values of w are scaled down together with c.
+static int32_t ne_scene_clip_to_ndc(int64_t c, int64_t w)
+{
+    if (c >= 2 * w)
+        return inttof32(2);
+    if (c <= -2 * w)
+        return -inttof32(2);
+
+    while (w > INT32_MAX)
+    {
+        c >>= 1;
+        w >>= 1;
+    }
+
+    return div64(c << 12, (int32_t)w);
+}
+
+// Projects the box of a portal to the screen and clips it against the region
+// it is seen through. Returns false if nothing can be seen through it.
+ARM_CODE static bool ne_scene_portal_rect(const NEA_SceneNode *portal,
+                                          const int32_t *m,
+                                          const ne_portal_rect_t *in,
+                                          ne_portal_rect_t *out)
+{
+    const int32_t *half = portal->ref.portal.half;
+
+    int32_t x0 = inttof32(2), y0 = inttof32(2);
+    int32_t x1 = -inttof32(2), y1 = -inttof32(2);
+    int behind = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        int64_t px = portal->wx + ((i & 1) ? half[0] : -half[0]);
+        int64_t py = portal->wy + ((i & 2) ? half[1] : -half[1]);
+        int64_t pz = portal->wz + ((i & 4) ? half[2] : -half[2]);
+
+        // Row vector times the clip matrix, only x, y and w are needed
+        int64_t cx = ((px * m[0] + py * m[4] + pz * m[8]) >> 12) + m[12];
+        int64_t cy = ((px * m[1] + py * m[5] + pz * m[9]) >> 12) + m[13];
+        int64_t cw = ((px * m[3] + py * m[7] + pz * m[11]) >> 12) + m[15];
+
+        if (cw <= 0)
+        {
+            behind++;
+            continue;
+        }
+
+        int32_t sx = ne_scene_clip_to_ndc(cx, cw);
+        int32_t sy = ne_scene_clip_to_ndc(cy, cw);
+
+        if (sx < x0)
+            x0 = sx;
+        if (sx > x1)
+            x1 = sx;
+        if (sy < y0)
+            y0 = sy;
+        if (sy > y1)
+            y1 = sy;
+    }
+
+    if (behind == 8)
+        return false;
+
+    if (behind > 0)
+    {
+        // The box crosses the plane of the camera (the camera is standing in
+        // the doorway, for example), so the projection isn't valid. Let the
+        // whole region through if the box is inside the frustum at all.
+        int32_t radius = half[0] + half[1] + half[2];
+        if (!NEA_CameraFrustumTestSphereI(portal->wx, portal->wy, portal->wz,
+                                          radius))
+            return false;
+
+        *out = *in;
+        return true;
+    }
+
+    out->x0 = (x0 > in->x0) ? x0 : in->x0;
+    out->y0 = (y0 > in->y0) ? y0 : in->y0;
+    out->x1 = (x1 < in->x1) ? x1 : in->x1;
+    out->y1 = (y1 < in->y1) ? y1 : in->y1;
+
+    return (out->x0 < out->x1) && (out->y0 < out->y1);
+}
+
+// Marks a room as visible and goes through all the portals of the room that
+// can be seen from the region of the screen of the room. The rooms of the
+// current path aren't entered again.
+ARM_CODE static void ne_scene_portal_flood(NEA_Scene *scene,
+                                           NEA_SceneNode *room,
+                                           const int32_t *m,
+                                           const ne_portal_rect_t *rect,
+                                           NEA_SceneNode **path, int depth)
+{
+    room->room_visible = true;
+    path[depth] = room;
+
+    if (depth + 1 >= NEA_SCENE_MAX_PORTAL_DEPTH)
+        return;
+
+    int index = room - scene->nodes;
+
+    for (int i = 0; i < scene->num_portals; i++)
+    {
+        NEA_SceneNode *portal = scene->portals[i];
+
+        // Hidden portals are closed doors
+        if (!portal->visible || (portal->dirty & NE_NODE_INACTIVE))
+            continue;
+
+        int next;
+        if (portal->ref.portal.room_a == index)
+            next = portal->ref.portal.room_b;
+        else if (portal->ref.portal.room_b == index)
+            next = portal->ref.portal.room_a;
+        else
+            continue;
+
+        NEA_SceneNode *other = &scene->nodes[next];
+
+        bool on_path = false;
+        for (int j = 0; j <= depth; j++)
+        {
+            if (path[j] == other)
+            {
+                on_path = true;
+                break;
+            }
+        }
+        if (on_path)
+            continue;
+
+        ne_portal_rect_t clipped;
+        if (!ne_scene_portal_rect(portal, m, rect, &clipped))
+            continue;
+
+        ne_scene_portal_flood(scene, other, m, &clipped, path, depth + 1);
+    }
+}
+
+// Decides which rooms are drawn. It must be called after NEA_CameraUse().
+static void ne_scene_update_rooms(NEA_Scene *scene, NEA_Camera *cam)
+{
+    scene->camera_room = NULL;
+
+    if (scene->num_rooms == 0)
+        return;
+
+    NEA_SceneNode *start = NULL;
+
+    if (scene->portal_culling && cam != NULL)
+    {
+        for (int i = 0; i < scene->num_nodes; i++)
+        {
+            NEA_SceneNode *node = &scene->nodes[i];
+            if (node->type != NEA_NODE_ROOM)
+                continue;
+
+            if (ne_scene_point_in_room(node, cam->from))
+            {
+                start = node;
+                break;
+            }
+        }
+    }
+
+    // If the camera isn't inside any room, all of them are drawn
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        NEA_SceneNode *node = &scene->nodes[i];
+        if (node->type == NEA_NODE_ROOM)
+            node->room_visible = (start == NULL);
+    }
+
+    if (start == NULL)
+        return;
+
+    scene->camera_room = start;
+
+    const int32_t *m = ne_camera_frustum_clip();
+    if (m == NULL)
+    {
+        NEA_CameraFrustumUpdate();
+        m = ne_camera_frustum_clip();
+    }
+
+    ne_portal_rect_t rect = {
+        -inttof32(1), -inttof32(1), inttof32(1), inttof32(1)
+    };
+    NEA_SceneNode *path[NEA_SCENE_MAX_PORTAL_DEPTH];
+
+    ne_scene_portal_flood(scene, start, m, &rect, path, 0);
+}
+
+// Decides which rooms of a scene and its sectors are drawn
+static void ne_scene_update_all_rooms(NEA_Scene *scene, NEA_Camera *cam)
+{
+    ne_scene_update_rooms(scene, cam);
+
+    for (int i = 0; i < scene->num_sectors; i++)
+    {
+        if (scene->sectors[i].scene != NULL)
+            ne_scene_update_all_rooms(scene->sectors[i].scene, cam);
+    }
+}
+
+// =========================================================================
+// Static batching
+// =========================================================================
+
+// Value of ref.mesh.is_static for nodes merged into a batch
+#define NE_MESH_BATCHED 2
+
+// Writes GX commands packed in groups of 4. If "p" is NULL it only counts the
+// words and measures the vertices.
+typedef struct {
+    uint32_t *p;            // Next word, or NULL to measure the lists
+    uint32_t *commands;     // Word with the IDs of the current group
+    int slot;               // Commands in the current group
+    size_t words;           // Words written or measured
+    int32_t min[3], max[3]; // Box of the vertices in world space (f32)
+    int32_t origin[3];      // Center of the batch (f32)
+    int shift;              // Vertices are divided by 1 << shift
+} ne_scene_batch_writer_t;
+
+static void ne_scene_batch_command(ne_scene_batch_writer_t *w, uint32_t id)
+{
+    if (w->slot == 4)
+    {
+        w->words++;
+        if (w->p != NULL)
+        {
+            w->commands = w->p++;
+            *w->commands = 0;
+        }
+        w->slot = 0;
+    }
+
+    if (w->p != NULL)
+        *w->commands |= id << (w->slot * 8);
+    w->slot++;
+}
+
+static inline void ne_scene_batch_param(ne_scene_batch_writer_t *w,
+                                        uint32_t value)
+{
+    w->words++;
+    if (w->p != NULL)
+        *w->p++ = value;
+}
+
+// Number of parameters of a GX command that can be merged, or -1 if the list
+// can't be merged (invalid commands, matrix commands and tests)
+static int ne_scene_batch_command_params(unsigned int id)
+{
+    switch (id)
+    {
+        case 0x00: // NOP
+        case 0x41: // END_VTXS
+            return 0;
+        case 0x20: // COLOR
+        case 0x21: // NORMAL
+        case 0x22: // TEXCOORD
+        case 0x24: // VTX_10
+        case 0x25: // VTX_XY
+        case 0x26: // VTX_XZ
+        case 0x27: // VTX_YZ
+        case 0x28: // VTX_DIFF
+        case 0x29: // POLYGON_ATTR
+        case 0x2A: // TEXIMAGE_PARAM
+        case 0x2B: // PLTT_BASE
+        case 0x30: // DIF_AMB
+        case 0x31: // SPE_EMI
+        case 0x32: // LIGHT_VECTOR
+        case 0x33: // LIGHT_COLOR
+        case 0x40: // BEGIN_VTXS
+            return 1;
+        case 0x23: // VTX_16
+            return 2;
+        case 0x34: // SHININESS
+            return 32;
+        default:
+            return -1;
+    }
+}
+
+// Sign-extends a field of a packed parameter
+static inline int32_t ne_scene_batch_field(uint32_t value, int shift, int bits)
+{
+    return (int32_t)(value << (32 - shift - bits)) >> (32 - bits);
+}
+
+static void ne_scene_batch_vertex(ne_scene_batch_writer_t *w, const m4x3 *mat,
+                                  const int32_t *v)
+{
+    // Row vectors: v' = v * M, with the translation in the last row
+    const int32_t *m = &mat->m[0];
+    int32_t out[3];
+
+    for (int i = 0; i < 3; i++)
+    {
+        out[i] = mulf32(v[0], m[i]) + mulf32(v[1], m[3 + i])
+               + mulf32(v[2], m[6 + i]) + m[9 + i];
+    }
+
+    if (w->p == NULL)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (out[i] < w->min[i])
+                w->min[i] = out[i];
+            if (out[i] > w->max[i])
+                w->max[i] = out[i];
+        }
+    }
+
+    int32_t x = (out[0] - w->origin[0]) >> w->shift;
+    int32_t y = (out[1] - w->origin[1]) >> w->shift;
+    int32_t z = (out[2] - w->origin[2]) >> w->shift;
+
+    ne_scene_batch_command(w, FIFO_VERTEX16);
+    ne_scene_batch_param(w, (y << 16) | (x & 0xFFFF));
+    ne_scene_batch_param(w, z & 0xFFFF);
+}
+
+// Normals are multiplied by the cofactor matrix (the inverse transpose scaled
+// by the determinant), so they stay perpendicular to non-uniformly scaled
+// surfaces.
+static uint32_t ne_scene_batch_normal(const NEA_Vec3 *cof, uint32_t normal)
+{
+    int32_t n[3];
+    for (int i = 0; i < 3; i++)
+        n[i] = ne_scene_batch_field(normal, i * 10, 10) << 3;
+
+    NEA_Vec3 r = NEA_Vec3Add(NEA_Vec3Add(NEA_Vec3Scale(cof[0], n[0]),
+                                         NEA_Vec3Scale(cof[1], n[1])),
+                             NEA_Vec3Scale(cof[2], n[2]));
+    if (r.x == 0 && r.y == 0 && r.z == 0)
+        return normal;
+
+    r = NEA_Vec3Normalize(r);
+
+    int32_t c[3] = { r.x >> 3, r.y >> 3, r.z >> 3 };
+    uint32_t out = 0;
+    for (int i = 0; i < 3; i++)
+        out |= (NEA_Clamp(c[i], -512, 511) & 0x3FF) << (i * 10);
+
+    return out;
+}
+
+// Adds a display list transformed by a matrix to a batch. Returns false if the
+// list can't be merged.
+static bool ne_scene_batch_list(ne_scene_batch_writer_t *w,
+                                const uint32_t *list, const m4x3 *mat)
+{
+    const int32_t *m = &mat->m[0];
+    NEA_Vec3 row[3] = {
+        NEA_Vec3Make(m[0], m[1], m[2]),
+        NEA_Vec3Make(m[3], m[4], m[5]),
+        NEA_Vec3Make(m[6], m[7], m[8])
+    };
+    NEA_Vec3 cof[3] = {
+        NEA_Vec3Cross(row[1], row[2]),
+        NEA_Vec3Cross(row[2], row[0]),
+        NEA_Vec3Cross(row[0], row[1])
+    };
+
+    // Mirrored transformations flip the cofactor matrix
+    if (NEA_Vec3Dot(row[0], cof[0]) < 0)
+    {
+        for (int i = 0; i < 3; i++)
+            cof[i] = NEA_Vec3Scale(cof[i], -inttof32(1));
+    }
+
+    const uint32_t *p = list;
+    uint32_t words = *p++;
+    const uint32_t *end = p + words;
+
+    int32_t v[3] = { 0, 0, 0 };
+
+    while (p < end)
+    {
+        uint32_t commands = *p++;
+
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned int id = (commands >> (i * 8)) & 0xFF;
+
+            int params = ne_scene_batch_command_params(id);
+            if ((params < 0) || (p + params > end))
+                return false;
+
+            uint32_t arg = (params > 0) ? p[0] : 0;
+            bool vertex = true;
+
+            switch (id)
+            {
+                case 0x00: // NOP
+                    vertex = false;
+                    break;
+                case 0x21: // NORMAL
+                    ne_scene_batch_command(w, id);
+                    ne_scene_batch_param(w, ne_scene_batch_normal(cof, arg));
+                    vertex = false;
+                    break;
+                case 0x23: // VTX_16
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[1] = (int16_t)(arg >> 16);
+                    v[2] = (int16_t)(p[1] & 0xFFFF);
+                    break;
+                case 0x24: // VTX_10
+                    for (int k = 0; k < 3; k++)
+                        v[k] = ne_scene_batch_field(arg, k * 10, 10) << 6;
+                    break;
+                case 0x25: // VTX_XY
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[1] = (int16_t)(arg >> 16);
+                    break;
+                case 0x26: // VTX_XZ
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[2] = (int16_t)(arg >> 16);
+                    break;
+                case 0x27: // VTX_YZ
+                    v[1] = (int16_t)(arg & 0xFFFF);
+                    v[2] = (int16_t)(arg >> 16);
+                    break;
+                case 0x28: // VTX_DIFF
+                    for (int k = 0; k < 3; k++)
+                        v[k] += ne_scene_batch_field(arg, k * 10, 10) << 3;
+                    break;
+                default:
+                    // Other commands are copied as they are
+                    ne_scene_batch_command(w, id);
+                    for (int k = 0; k < params; k++)
+                        ne_scene_batch_param(w, p[k]);
+                    vertex = false;
+                    break;
+            }
+
+            p += params;
+
+            if (vertex)
+                ne_scene_batch_vertex(w, mat, v);
+        }
+    }
+
+    return true;
+}
+
+// Returns the static display list of a node that can be merged, or NULL
+static const uint32_t *ne_scene_batch_node_list(const NEA_Scene *scene,
+                                                const NEA_SceneNode *node)
+{
+    if (node->type != NEA_NODE_MESH || node->ref.mesh.is_static != 1)
+        return NULL;
+
+    const NEA_Model *model = node->model;
+    if (model == NULL || model->modeltype != NEA_Static ||
+        model->multi != NULL || model->meshindex == NEA_NO_MESH ||
+        model->texture == NULL || node->animmat != NULL)
+        return NULL;
+
+    uint16_t ai = node->ref.mesh.asset_index;
+    if (ai >= scene->num_assets || !scene->assets[ai].loaded ||
+        scene->assets[ai].type != 0)
+        return NULL;
+
+    // Skip the bounding sphere chunk, like NEA_ModelLoadStaticMesh()
+    const uint32_t *list = scene->assets[ai].data;
+    if (list[0] == NEA_MESH_BOUNDS_MAGIC)
+        list += 5;
+
+    return list;
+}
+
+// Returns the room that contains a node, or NULL if it isn't in a room. The
+// node can't be merged if it or a parent under the room is hidden.
+static bool ne_scene_batch_node_room(NEA_SceneNode *node, NEA_SceneNode **room)
+{
+    *room = NULL;
+
+    for (NEA_SceneNode *n = node; n != NULL; n = n->parent)
+    {
+        if (n->type == NEA_NODE_ROOM)
+        {
+            *room = n;
+            break;
+        }
+
+        if (!n->visible || (n->dirty & NE_NODE_INACTIVE))
+            return false;
+    }
+
+    return true;
+}
+
+typedef struct {
+    NEA_SceneNode *room;
+    const NEA_Material *material;
+} ne_scene_batch_group_t;
+
+// Adds the lists of the nodes of some groups to a batch, one submesh per group
+static bool ne_scene_batch_encode(const NEA_Scene *scene,
+                                  ne_scene_batch_writer_t *w,
+                                  const int *node_group, int first, int count,
+                                  NEA_MultiMeshData *multi)
+{
+    for (int g = 0; g < count; g++)
+    {
+        size_t start = w->words;
+        uint32_t *list = w->p;
+
+        // Word count of the list
+        ne_scene_batch_param(w, 0);
+        w->slot = 4;
+
+        // MTX_SCALE only modifies the position matrix, so normals aren't
+        // scaled. The push and pop keep the matrix of the model for the next
+        // submeshes.
+        if (w->shift > 0)
+        {
+            ne_scene_batch_command(w, 0x11); // MTX_PUSH
+            ne_scene_batch_command(w, 0x1B); // MTX_SCALE
+            for (int k = 0; k < 3; k++)
+                ne_scene_batch_param(w, inttof32(1) << w->shift);
+        }
+
+        for (int i = 0; i < scene->num_nodes; i++)
+        {
+            if (node_group[i] != first + g)
+                continue;
+
+            const uint32_t *src = ne_scene_batch_node_list(scene,
+                                                           &scene->nodes[i]);
+            if (!ne_scene_batch_list(w, src, &scene->world[i]))
+                return false;
+        }
+
+        if (w->shift > 0)
+        {
+            ne_scene_batch_command(w, 0x12); // MTX_POP
+            ne_scene_batch_param(w, 1);
+        }
+
+        if (list != NULL)
+        {
+            list[0] = w->words - start - 1;
+            multi->submeshes[g].dl_data = list;
+        }
+    }
+
+    return true;
+}
+
+// Internal use... see NEAModel.c
+NEA_MultiMeshData *ne_multimesh_create(int num_submeshes);
+
+// Builds the model of a batch with some groups of nodes of the same room
+static NEA_Model *ne_scene_batch_build(const NEA_Scene *scene,
+                                       const int *node_group,
+                                       const ne_scene_batch_group_t *groups,
+                                       int first, int count)
+{
+    // Measure the vertices and the size of the lists
+    ne_scene_batch_writer_t w = { 0 };
+    for (int k = 0; k < 3; k++)
+    {
+        w.min[k] = INT32_MAX;
+        w.max[k] = INT32_MIN;
+    }
+
+    if (!ne_scene_batch_encode(scene, &w, node_group, first, count, NULL))
+        return NULL;
+
+    if (w.min[0] > w.max[0])
+        return NULL; // No vertices
+
+    // VTX_16 only has 3 bits of integer part. If the batch doesn't fit, the
+    // vertices are divided by a power of two and the list scales them back.
+    int32_t half[3];
+    for (int k = 0; k < 3; k++)
+    {
+        w.origin[k] = w.min[k] + ((w.max[k] - w.min[k]) >> 1);
+        half[k] = w.max[k] - w.origin[k];
+    }
+
+    int32_t max_half = half[0];
+    if (half[1] > max_half)
+        max_half = half[1];
+    if (half[2] > max_half)
+        max_half = half[2];
+
+    while ((max_half >> w.shift) > 0x7FFF)
+        w.shift++;
+
+    if (w.shift > 0)
+    {
+        // Measure again with the commands that scale the vertices
+        w.words = 0;
+        w.slot = 0;
+        ne_scene_batch_encode(scene, &w, node_group, first, count, NULL);
+    }
+
+    NEA_Model *model = NEA_ModelCreate(NEA_Static);
+    if (model == NULL)
+    {
+        NEA_DebugPrint("Can't create batch model");
+        return NULL;
+    }
+
+    NEA_MultiMeshData *multi = ne_multimesh_create(count);
+    uint32_t *data = ne_heap_malloc(NEA_HEAP_MODEL, w.words * sizeof(uint32_t));
+    if (multi == NULL || data == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for batch");
+        ne_heap_free(NEA_HEAP_MODEL, multi);
+        ne_heap_free(NEA_HEAP_MODEL, data);
+        NEA_ModelDelete(model);
+        return NULL;
+    }
+
+    w.p = data;
+    w.words = 0;
+    w.slot = 0;
+    ne_scene_batch_encode(scene, &w, node_group, first, count, multi);
+
+    // The model frees the lists when it is deleted, so they are counted as
+    // memory of the model system.
+    multi->base_data = data;
+    multi->base_has_to_free = true;
+
+    for (int g = 0; g < count; g++)
+    {
+        NEA_SubMesh *sub = &multi->submeshes[g];
+        sub->material = (NEA_Material *)groups[first + g].material;
+        sub->flags = NEA_SUBMESH_HAS_TEXTURE;
+    }
+
+    model->multi = multi;
+
+    // The model is only translated to the center of the batch
+    m4x3 mat = {{
+        inttof32(1), 0, 0,
+        0, inttof32(1), 0,
+        0, 0, inttof32(1),
+        w.origin[0], w.origin[1], w.origin[2]
+    }};
+    if (NEA_ModelSetMatrix(model, &mat) == 0)
+    {
+        NEA_DebugPrint("Not enough memory for batch");
+        NEA_ModelDelete(model);
+        return NULL;
+    }
+
+    int64_t r2 = (int64_t)half[0] * half[0] + (int64_t)half[1] * half[1]
+               + (int64_t)half[2] * half[2];
+    NEA_ModelSetBoundingSphereI(model, 0, 0, 0, sqrt64(r2) + 1);
+
+    return model;
+}
+
+// Merges the static nodes of a scene once all their meshes have been loaded
+static void ne_scene_batch_if_loaded(NEA_Scene *scene)
+{
+    bool found = false;
+
+    for (int i = 0; i < scene->num_nodes; i++)
+    {
+        const NEA_SceneNode *node = &scene->nodes[i];
+        if (node->type != NEA_NODE_MESH || node->model == NULL ||
+            node->ref.mesh.is_static != 1)
+            continue;
+
+        uint16_t ai = node->ref.mesh.asset_index;
+        if (ai < scene->num_assets && scene->assets[ai].path[0] != '\0' &&
+            !scene->assets[ai].loaded)
+            return;
+
+        found = true;
+    }
+
+    if (found)
+        NEA_SceneBatchStatic(scene);
+}
+
+int NEA_SceneBatchStatic(NEA_Scene *scene)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+
+    if (!scene->loaded)
+        return 0;
+
+    int *node_group = ne_heap_malloc(NEA_HEAP_SCENE,
+                                     scene->num_nodes * sizeof(int));
+    ne_scene_batch_group_t *groups =
+            ne_heap_malloc(NEA_HEAP_SCENE,
+                           scene->num_nodes * sizeof(ne_scene_batch_group_t));
+    if (node_group == NULL || groups == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for batches");
+        ne_heap_free(NEA_HEAP_SCENE, node_group);
+        ne_heap_free(NEA_HEAP_SCENE, groups);
+        return -1;
+    }
+
+    // Sort the nodes that can be merged in groups by room and material
+    int num_groups = 0;
+
     for (int i = 0; i < scene->num_nodes; i++)
     {
         NEA_SceneNode *node = &scene->nodes[i];
-        if (node->type != NEA_NODE_MESH || node->model == NULL)
+        node_group[i] = -1;
+
+        const uint32_t *list = ne_scene_batch_node_list(scene, node);
+        if (list == NULL)
             continue;
 
-        uint16_t mi = node->ref.mesh.material_index;
-        if (mi == 0xFFFF || mi >= scene->num_mat_refs)
+        NEA_SceneNode *room;
+        if (!ne_scene_batch_node_room(node, &room))
             continue;
 
-        if (scene->materials[mi] != NULL)
-            NEA_ModelSetMaterial(node->model, scene->materials[mi]);
+        // Check that the list can be merged
+        ne_scene_batch_writer_t w = { 0 };
+        if (!ne_scene_batch_list(&w, list, &scene->world[i]))
+        {
+            NEA_DebugPrint("Can't merge node %s", node->name);
+            continue;
+        }
+
+        const NEA_Material *material = node->model->texture;
+
+        int g = 0;
+        while (g < num_groups &&
+               (groups[g].room != room || groups[g].material != material))
+            g++;
+
+        if (g == num_groups)
+        {
+            groups[g].room = room;
+            groups[g].material = material;
+            num_groups++;
+        }
+
+        node_group[i] = g;
     }
 
-    return scene;
-}
+    if (num_groups == 0)
+    {
+        ne_heap_free(NEA_HEAP_SCENE, node_group);
+        ne_heap_free(NEA_HEAP_SCENE, groups);
+        return 0;
+    }
 
-void NEA_SceneFree(NEA_Scene *scene)
-{
-    if (scene == NULL)
-        return;
+    // Groups of the same room are built together, so they are sorted by room.
+    // A room may need more than one model, but never more than one per group.
+    ne_scene_batch_group_t *sorted =
+            ne_heap_malloc(NEA_HEAP_SCENE,
+                           num_groups * sizeof(ne_scene_batch_group_t));
+    int *remap = ne_heap_malloc(NEA_HEAP_SCENE, num_groups * sizeof(int));
+    NEA_SceneBatch *batches = ne_heap_realloc(NEA_HEAP_SCENE, scene->batches,
+            (scene->num_batches + num_groups) * sizeof(NEA_SceneBatch));
+    if (batches != NULL)
+        scene->batches = batches;
+
+    if (sorted == NULL || remap == NULL || batches == NULL)
+    {
+        NEA_DebugPrint("Not enough memory for batches");
+        ne_heap_free(NEA_HEAP_SCENE, sorted);
+        ne_heap_free(NEA_HEAP_SCENE, remap);
+        ne_heap_free(NEA_HEAP_SCENE, node_group);
+        ne_heap_free(NEA_HEAP_SCENE, groups);
+        return -1;
+    }
 
-    // Delete engine objects
-    for (int i = 0; i < scene->num_nodes; i++)
+    for (int g = 0; g < num_groups; g++)
+        remap[g] = -1;
+
+    int n = 0;
+    for (int g = 0; g < num_groups; g++)
     {
-        NEA_SceneNode *node = &scene->nodes[i];
+        if (remap[g] >= 0)
+            continue;
 
-        if (node->model != NULL)
-            NEA_ModelDelete(node->model);
-        if (node->camera != NULL)
-            NEA_CameraDelete(node->camera);
-        if (node->trigger != NULL)
-            free(node->trigger);
-        if (node->animmat != NULL)
-            NEA_AnimMatDelete(node->animmat);
+        for (int j = g; j < num_groups; j++)
+        {
+            if (groups[j].room == groups[g].room)
+            {
+                remap[j] = n;
+                sorted[n++] = groups[j];
+            }
+        }
     }
 
-    // Free auto-loaded materials
-    for (int i = 0; i < scene->num_mat_refs; i++)
+    for (int i = 0; i < scene->num_nodes; i++)
     {
-        if (scene->materials[i] != NULL)
-            NEA_MaterialDelete(scene->materials[i]);
+        if (node_group[i] >= 0)
+            node_group[i] = remap[node_group[i]];
     }
 
-    // Free loaded assets
-    for (int i = 0; i < scene->num_assets; i++)
+    // Build the models, with up to NEA_MAX_SUBMESHES materials each
+    int merged = 0;
+    int first = 0;
+
+    while (first < num_groups)
     {
-        if (scene->assets[i].loaded && scene->assets[i].data != NULL)
-            free(scene->assets[i].data);
+        int count = 1;
+        while ((first + count < num_groups) && (count < NEA_MAX_SUBMESHES) &&
+               (sorted[first + count].room == sorted[first].room))
+            count++;
+
+        NEA_Model *model = ne_scene_batch_build(scene, node_group, sorted,
+                                                first, count);
+        if (model != NULL)
+        {
+            NEA_SceneBatch *batch = &scene->batches[scene->num_batches++];
+            batch->model = model;
+            batch->room = sorted[first].room;
+
+            for (int i = 0; i < scene->num_nodes; i++)
+            {
+                if (node_group[i] < first || node_group[i] >= first + count)
+                    continue;
+
+                scene->nodes[i].ref.mesh.is_static = NE_MESH_BATCHED;
+                merged++;
+            }
+        }
+
+        first += count;
     }
 
-    free(scene->nodes);
-    free(scene);
+    ne_heap_free(NEA_HEAP_SCENE, sorted);
+    ne_heap_free(NEA_HEAP_SCENE, remap);
+    ne_heap_free(NEA_HEAP_SCENE, node_group);
+    ne_heap_free(NEA_HEAP_SCENE, groups);
+
+    return merged;
 }
 
 // =========================================================================
-// Node access
+// Scene draw
 // =========================================================================
 
-NEA_SceneNode *NEA_SceneGetRoot(const NEA_Scene *scene)
-{
-    NEA_AssertPointer(scene, "NULL scene");
-    return scene->root;
-}
+// Internal use... see NEAModel.c
+bool ne_model_culled(const NEA_Model *model);
+bool ne_model_culling_active(void);
+void ne_model_draw_unculled(const NEA_Model *model);
 
-NEA_SceneNode *NEA_SceneFindNode(const NEA_Scene *scene, const char *name)
+// Returns the scene of a sector node, or NULL if it isn't loaded
+static NEA_Scene *ne_scene_sector_scene(const NEA_Scene *scene,
+                                        const NEA_SceneNode *node)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-    NEA_AssertPointer(name, "NULL name");
+    if (node->type != NEA_NODE_SECTOR)
+        return NULL;
 
-    for (int i = 0; i < scene->num_nodes; i++)
-    {
-        if (strcmp(scene->nodes[i].name, name) == 0)
-            return &scene->nodes[i];
-    }
-    return NULL;
-}
+    uint16_t slot = node->ref.sector.slot;
+    if (slot >= scene->num_sectors || scene->sectors[slot].node != node)
+        return NULL;
 
-NEA_SceneNode *NEA_SceneGetActiveCamera(const NEA_Scene *scene)
-{
-    NEA_AssertPointer(scene, "NULL scene");
-    return scene->active_camera;
+    return scene->sectors[slot].scene;
 }
 
-void NEA_SceneSetActiveCamera(NEA_Scene *scene, NEA_SceneNode *cam_node)
+// Returns true if nothing in the subtree of a node can be seen
+static bool ne_scene_subtree_culled(const NEA_Scene *scene,
+                                    const NEA_SceneNode *node, bool cull)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-    if (cam_node != NULL)
-        NEA_Assert(cam_node->type == NEA_NODE_CAMERA,
-                   "Node is not a camera");
-    scene->active_camera = cam_node;
-}
+    const NEA_SceneBounds *b = &scene->bounds[node - scene->nodes];
 
-// =========================================================================
-// Tag queries
-// =========================================================================
+    if (b->radius < 0)
+        return true;
 
-NEA_SceneNode *NEA_SceneFindByTag(const NEA_Scene *scene, const char *tag)
+    if (!cull || b->radius == NE_BOUNDS_INFINITE)
+        return false;
+
+    return !NEA_CameraFrustumTestSphereI(b->center[0], b->center[1],
+                                         b->center[2], b->radius);
+}
+
+// Returns true if a batch is hidden with its room or the parents of the room
+static bool ne_scene_batch_hidden(const NEA_Scene *scene,
+                                  const NEA_SceneBatch *batch)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-    NEA_AssertPointer(tag, "NULL tag");
+    const NEA_SceneNode *node = batch->room;
+    if (node == NULL)
+        node = scene->root;
 
-    for (int i = 0; i < scene->num_nodes; i++)
+    for (; node != NULL; node = node->parent)
     {
-        if (ne_node_has_tag(&scene->nodes[i], tag))
-            return &scene->nodes[i];
+        if (!node->visible || (node->dirty & NE_NODE_INACTIVE))
+            return true;
+        if (node->type == NEA_NODE_ROOM && !node->room_visible)
+            return true;
     }
-    return NULL;
+
+    return false;
 }
 
-int NEA_SceneForEachTag(const NEA_Scene *scene, const char *tag,
-                        NEA_NodeVisitor visitor, void *arg)
+// Batches are culled by NEA_ModelDraw() like any other model
+static void ne_scene_draw_batches(const NEA_Scene *scene)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-    NEA_AssertPointer(tag, "NULL tag");
-    NEA_AssertPointer(visitor, "NULL visitor");
+    for (int i = 0; i < scene->num_batches; i++)
+    {
+        const NEA_SceneBatch *batch = &scene->batches[i];
+        if (!ne_scene_batch_hidden(scene, batch))
+            NEA_ModelDraw(batch->model);
+    }
+}
 
-    int count = 0;
-    for (int i = 0; i < scene->num_nodes; i++)
+static void ne_scene_submit_batches(const NEA_Scene *scene)
+{
+    for (int i = 0; i < scene->num_batches; i++)
     {
-        if (ne_node_has_tag(&scene->nodes[i], tag))
-        {
-            visitor(&scene->nodes[i], arg);
-            count++;
-        }
+        const NEA_SceneBatch *batch = &scene->batches[i];
+        if (!ne_scene_batch_hidden(scene, batch) &&
+            !ne_model_culled(batch->model))
+            NEA_RenderQueueAddModel(batch->model);
     }
-    return count;
 }
 
-int NEA_SceneCountByTag(const NEA_Scene *scene, const char *tag)
+NEA_HOT_CODE static void ne_scene_draw_recursive(const NEA_Scene *scene,
+                                                 NEA_SceneNode *node, bool cull)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-    NEA_AssertPointer(tag, "NULL tag");
+    if (node == NULL || !node->visible || (node->dirty & NE_NODE_INACTIVE))
+        return;
 
-    int count = 0;
-    for (int i = 0; i < scene->num_nodes; i++)
+    if (node->type == NEA_NODE_ROOM && !node->room_visible)
+        return;
+
+    if (ne_scene_subtree_culled(scene, node, cull))
+        return;
+
+    // Skip culled models before applying their animated material. Merged
+    // nodes are drawn by their batch.
+    if (node->type == NEA_NODE_MESH && node->model != NULL &&
+        node->ref.mesh.is_static != NE_MESH_BATCHED &&
+        !ne_model_culled(node->model))
     {
-        if (ne_node_has_tag(&scene->nodes[i], tag))
-            count++;
+        if (node->animmat != NULL)
+            NEA_AnimMatApply(node->animmat);
+        ne_model_draw_unculled(node->model);
     }
-    return count;
-}
 
-// =========================================================================
-// Node manipulation
-// =========================================================================
+    const NEA_Scene *sector = ne_scene_sector_scene(scene, node);
+    if (sector != NULL)
+    {
+        ne_scene_draw_batches(sector);
+        ne_scene_draw_recursive(sector, sector->root, cull);
+    }
 
-void NEA_SceneNodeSetCoordI(NEA_SceneNode *node,
-                             int32_t x, int32_t y, int32_t z)
-{
-    NEA_AssertPointer(node, "NULL node");
-    node->x = x;
-    node->y = y;
-    node->z = z;
+    NEA_SceneNode *child = node->first_child;
+    while (child != NULL)
+    {
+        ne_scene_draw_recursive(scene, child, cull);
+        child = child->next_sibling;
+    }
 }
 
-void NEA_SceneNodeSetRot(NEA_SceneNode *node, int rx, int ry, int rz)
+void NEA_SceneDraw(void *arg)
 {
-    NEA_AssertPointer(node, "NULL node");
-    node->rx = rx;
-    node->ry = ry;
-    node->rz = rz;
-}
+    NEA_Scene *scene = (NEA_Scene *)arg;
+    if (scene == NULL || !scene->loaded)
+        return;
 
-void NEA_SceneNodeSetVisible(NEA_SceneNode *node, bool visible)
-{
-    NEA_AssertPointer(node, "NULL node");
-    node->visible = visible;
-}
+    NEA_Camera *cam = NULL;
+    if (scene->active_camera != NULL)
+        cam = scene->active_camera->camera;
 
-void NEA_SceneNodeSetUserData(NEA_SceneNode *node, void *data)
-{
-    NEA_AssertPointer(node, "NULL node");
-    node->user_data = data;
+    if (cam != NULL)
+        NEA_CameraUse(cam);
+
+    ne_scene_update_all_rooms(scene, cam);
+
+    ne_scene_draw_batches(scene);
+    ne_scene_draw_recursive(scene, scene->root, ne_model_culling_active());
 }
 
-void *NEA_SceneNodeGetUserData(const NEA_SceneNode *node)
+static void ne_scene_submit_recursive(const NEA_Scene *scene,
+                                      NEA_SceneNode *node, bool cull)
 {
-    NEA_AssertPointer(node, "NULL node");
-    return node->user_data;
-}
+    if (node == NULL || !node->visible || (node->dirty & NE_NODE_INACTIVE))
+        return;
 
-// =========================================================================
-// Scene update
-// =========================================================================
+    if (node->type == NEA_NODE_ROOM && !node->room_visible)
+        return;
 
-// Recursive transform propagation. Computes world position by adding
-// parent's world position. Uses hardware mulf32 for any rotated offsets.
-ARM_CODE static void ne_scene_update_recursive(NEA_SceneNode *node,
-                                                int32_t parent_wx,
-                                                int32_t parent_wy,
-                                                int32_t parent_wz)
-{
-    if (node == NULL)
+    if (ne_scene_subtree_culled(scene, node, cull))
         return;
 
-    // Compute world position (parent world + local offset)
-    node->wx = parent_wx + node->x;
-    node->wy = parent_wy + node->y;
-    node->wz = parent_wz + node->z;
+    if (node->type != NEA_NODE_MESH ||
+        node->ref.mesh.is_static != NE_MESH_BATCHED)
+        NEA_RenderQueueAddSceneNode(node);
 
-    // Sync to engine objects
-    if (node->type == NEA_NODE_MESH && node->model != NULL)
-    {
-        NEA_ModelSetCoordI(node->model, node->wx, node->wy, node->wz);
-        NEA_ModelSetRot(node->model, node->rx, node->ry, node->rz);
-        NEA_ModelScaleI(node->model, node->sx, node->sy, node->sz);
-    }
-    else if (node->type == NEA_NODE_CAMERA && node->camera != NULL)
+    const NEA_Scene *sector = ne_scene_sector_scene(scene, node);
+    if (sector != NULL)
     {
-        // Update camera from position. If the camera has a look-at target
-        // stored in ref.cam.to, offset it by world position.
-        node->camera->from[0] = node->wx;
-        node->camera->from[1] = node->wy;
-        node->camera->from[2] = node->wz;
-        node->camera->to[0] = node->wx + node->ref.cam.to[0];
-        node->camera->to[1] = node->wy + node->ref.cam.to[1];
-        node->camera->to[2] = node->wz + node->ref.cam.to[2];
-        node->camera->up[0] = node->ref.cam.up[0];
-        node->camera->up[1] = node->ref.cam.up[1];
-        node->camera->up[2] = node->ref.cam.up[2];
-        node->camera->matrix_is_updated = false;
+        ne_scene_submit_batches(sector);
+        ne_scene_submit_recursive(sector, sector->root, cull);
     }
 
-    // Recurse children
     NEA_SceneNode *child = node->first_child;
     while (child != NULL)
     {
-        ne_scene_update_recursive(child, node->wx, node->wy, node->wz);
+        ne_scene_submit_recursive(scene, child, cull);
         child = child->next_sibling;
     }
 }
 
-void NEA_SceneUpdate(NEA_Scene *scene)
+void NEA_SceneDrawQueued(void *arg)
 {
-    NEA_AssertPointer(scene, "NULL scene");
-
-    if (!scene->loaded || scene->root == NULL)
+    NEA_Scene *scene = (NEA_Scene *)arg;
+    if (scene == NULL || !scene->loaded)
         return;
 
-    ne_scene_update_recursive(scene->root, 0, 0, 0);
+    NEA_Camera *cam = NULL;
+    if (scene->active_camera != NULL)
+        cam = scene->active_camera->camera;
+
+    if (cam != NULL)
+        NEA_CameraUse(cam);
+
+    NEA_RenderQueueSetCamera(cam);
+
+    ne_scene_update_all_rooms(scene, cam);
+
+    ne_scene_submit_batches(scene);
+    ne_scene_submit_recursive(scene, scene->root, ne_model_culling_active());
 }
 
 // =========================================================================
-// Trigger testing
+// Sector streaming
 // =========================================================================
 
-void NEA_SceneTestTriggers(NEA_Scene *scene, const NEA_ColShape *shape,
-                           NEA_Vec3 pos, void *user_data)
+void NEA_SceneStreamSetTarget(NEA_Scene *scene, const NEA_SceneNode *node)
 {
     NEA_AssertPointer(scene, "NULL scene");
-    NEA_AssertPointer(shape, "NULL shape");
+    scene->stream_target = node;
+}
 
-    for (int i = 0; i < scene->num_nodes; i++)
+void NEA_SceneStreamSetCallback(NEA_Scene *scene, NEA_SectorCallback callback,
+                                void *arg)
+{
+    NEA_AssertPointer(scene, "NULL scene");
+
+    scene->sector_callback = callback;
+    scene->sector_callback_arg = arg;
+
+    // Sectors of sectors call the same function
+    for (int i = 0; i < scene->num_sectors; i++)
     {
-        NEA_SceneNode *node = &scene->nodes[i];
-        if (node->type != NEA_NODE_TRIGGER || node->trigger == NULL)
-            continue;
-        if (!node->visible)
-            continue;
+        if (scene->sectors[i].scene != NULL)
+            NEA_SceneStreamSetCallback(scene->sectors[i].scene, callback, arg);
+    }
+}
+
+static void ne_scene_sector_load(NEA_Scene *scene, NEA_SceneSector *sector)
+{
+    const NEA_SceneAsset *asset =
+            &scene->assets[sector->node->ref.sector.asset_index];
+
+    NEA_Scene *sub = NEA_SceneLoadFATAsync(asset->path);
+    if (sub == NULL)
+    {
+        // Don't try again until the target leaves the sector
+        NEA_DebugPrint("Can't load sector %s", sector->node->name);
+        sector->failed = true;
+        return;
+    }
+
+    sub->sector_callback = scene->sector_callback;
+    sub->sector_callback_arg = scene->sector_callback_arg;
+    sector->scene = sub;
+
+    if (scene->sector_callback != NULL)
+    {
+        scene->sector_callback(sector->node, sub, true,
+                               scene->sector_callback_arg);
+    }
+}
 
-        NEA_Vec3 trigger_pos = NEA_Vec3Make(node->wx, node->wy, node->wz);
+static void ne_scene_stream(NEA_Scene *scene, const int32_t *pos)
+{
+    for (int i = 0; i < scene->num_sectors; i++)
+    {
+        NEA_SceneSector *sector = &scene->sectors[i];
+        const NEA_SceneNode *node = sector->node;
+
+        int32_t load = node->ref.sector.load_radius;
+        int32_t unload = node->ref.sector.unload_radius;
+        if (unload < load)
+            unload = load;
+
+        int64_t d[3] = {
+            (int64_t)pos[0] - node->wx,
+            (int64_t)pos[1] - node->wy,
+            (int64_t)pos[2] - node->wz
+        };
+
+        // Check each axis first so that the squares don't overflow
+        bool outside = false;
+        uint64_t dist2 = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            if (d[j] > unload || d[j] < -(int64_t)unload)
+            {
+                outside = true;
+                break;
+            }
+            dist2 += (uint64_t)(d[j] * d[j]);
+        }
 
-        NEA_ColResult result = NEA_ColTest(&node->trigger->shape, trigger_pos,
-                                           shape, pos);
+        if (!outside)
+            outside = dist2 > (uint64_t)((int64_t)unload * unload);
 
-        bool was_active = node->trigger->is_active;
-        bool is_inside = result.hit;
+        bool inside = !outside && (load >= 0) &&
+                      (dist2 <= (uint64_t)((int64_t)load * load));
 
-        if (is_inside && !was_active)
+        if (sector->scene != NULL)
         {
-            // Enter
-            node->trigger->is_active = true;
-            if (node->trigger->on_event)
-                node->trigger->on_event(node, NEA_TRIGGER_ENTER, user_data);
+            if (outside)
+                ne_scene_sector_free(scene, sector);
+            else
+                ne_scene_stream(sector->scene, pos);
         }
-        else if (is_inside && was_active)
+        else if (sector->failed)
         {
-            // Tick (still inside)
-            if (node->trigger->on_event)
-                node->trigger->on_event(node, NEA_TRIGGER_TICK, user_data);
+            if (outside)
+                sector->failed = false;
         }
-        else if (!is_inside && was_active)
+        else if (inside)
         {
-            // Exit
-            node->trigger->is_active = false;
-            if (node->trigger->on_event)
-                node->trigger->on_event(node, NEA_TRIGGER_EXIT, user_data);
+            ne_scene_sector_load(scene, sector);
         }
     }
 }
 
-// =========================================================================
-// Scene draw
-// =========================================================================
-
-ARM_CODE static void ne_scene_draw_recursive(NEA_SceneNode *node)
+void NEA_SceneStreamUpdate(NEA_Scene *scene)
 {
-    if (node == NULL || !node->visible)
+    NEA_AssertPointer(scene, "NULL scene");
+
+    if (!scene->loaded || scene->num_sectors == 0)
         return;
 
-    if (node->type == NEA_NODE_MESH && node->model != NULL)
-    {
-        if (node->animmat != NULL)
-            NEA_AnimMatApply(node->animmat);
-        NEA_ModelDraw(node->model);
-    }
+    const NEA_SceneNode *target = scene->stream_target;
+    if (target == NULL)
+        target = scene->active_camera;
+    if (target == NULL)
+        return;
 
-    NEA_SceneNode *child = node->first_child;
-    while (child != NULL)
-    {
-        ne_scene_draw_recursive(child);
-        child = child->next_sibling;
-    }
+    int32_t pos[3] = { target->wx, target->wy, target->wz };
+
+    ne_scene_stream(scene, pos);
 }
 
-void NEA_SceneDraw(void *arg)
+NEA_Scene *NEA_SceneSectorGetScene(const NEA_Scene *scene,
+                                   const NEA_SceneNode *sector)
 {
-    NEA_Scene *scene = (NEA_Scene *)arg;
-    if (scene == NULL || !scene->loaded)
-        return;
-
-    if (scene->active_camera != NULL && scene->active_camera->camera != NULL)
-        NEA_CameraUse(scene->active_camera->camera);
+    NEA_AssertPointer(scene, "NULL scene");
+    NEA_AssertPointer(sector, "NULL sector");
 
-    ne_scene_draw_recursive(scene->root);
+    return ne_scene_sector_scene(scene, sector);
 }
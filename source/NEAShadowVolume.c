@@ -0,0 +1,972 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAShadowVolume.c
+
+// Internal use... see NEADisplayList.c
+void ne_display_list_matrix_pop(void);
+void ne_display_list_draw_default(const void *list, bool flushed);
+
+// Internal use... see NEAModel.c
+void ne_model_update_transform(NEA_Model *model);
+
+// Mesh building
+// -------------
+
+typedef struct {
+    NEA_Vec3 pos;
+    int index;
+} ne_shadow_weld_t;
+
+// Half of an edge: the edge as seen by one of its triangles
+typedef struct {
+    uint16_t lo, hi; // Vertices sorted by index, used as key
+    uint16_t a, b;   // Vertices in the order of the triangle
+    uint16_t face;
+} ne_shadow_half_edge_t;
+
+static int ne_shadow_weld_cmp(const void *a, const void *b)
+{
+    const NEA_Vec3 *pa = &((const ne_shadow_weld_t *)a)->pos;
+    const NEA_Vec3 *pb = &((const ne_shadow_weld_t *)b)->pos;
+
+    if (pa->x != pb->x)
+        return (pa->x < pb->x) ? -1 : 1;
+    if (pa->y != pb->y)
+        return (pa->y < pb->y) ? -1 : 1;
+    if (pa->z != pb->z)
+        return (pa->z < pb->z) ? -1 : 1;
+    return 0;
+}
+
+static int ne_shadow_edge_cmp(const void *a, const void *b)
+{
+    const ne_shadow_half_edge_t *ea = a;
+    const ne_shadow_half_edge_t *eb = b;
+
+    if (ea->lo != eb->lo)
+        return (int)ea->lo - (int)eb->lo;
+    if (ea->hi != eb->hi)
+        return (int)ea->hi - (int)eb->hi;
+    return (int)ea->face - (int)eb->face;
+}
+
+// Normal of a triangle, reduced so that its components fit in 20 bits. Only
+// its direction is used, so it isn't normalized.
+static NEA_Vec3 ne_shadow_normal(const NEA_Vec3 *v0, const NEA_Vec3 *v1,
+                                 const NEA_Vec3 *v2)
+{
+    int64_t ux = v1->x - v0->x, uy = v1->y - v0->y, uz = v1->z - v0->z;
+    int64_t vx = v2->x - v0->x, vy = v2->y - v0->y, vz = v2->z - v0->z;
+
+    int64_t n[3] = {
+        uy * vz - uz * vy,
+        uz * vx - ux * vz,
+        ux * vy - uy * vx
+    };
+
+    int64_t max = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        int64_t a = (n[i] < 0) ? -n[i] : n[i];
+        if (a > max)
+            max = a;
+    }
+
+    int shift = 0;
+    while ((max >> shift) >= (1 << 20))
+        shift++;
+
+    return NEA_Vec3Make(n[0] >> shift, n[1] >> shift, n[2] >> shift);
+}
+
+void NEA_ShadowVolumeDelete(NEA_ShadowVolume *vol)
+{
+    if (vol == NULL)
+        return;
+
+    // The list may still be in the queue of the asynchronous backend
+    NEA_DisplayListWait();
+
+    free(vol->vertices);
+    free(vol->triangles);
+    free(vol->normals);
+    free(vol->edges);
+    free(vol->lit);
+    free(vol->list);
+    free(vol);
+}
+
+// Merges vertices with the same coordinates. It fills "remap" with the new
+// index of each vertex and returns the number of unique vertices, or -1 on
+// error.
+static int ne_shadow_weld(NEA_ShadowVolume *vol, const NEA_Vec3 *vertices,
+                          int num_vertices, uint16_t *remap)
+{
+    ne_shadow_weld_t *weld = malloc(num_vertices * sizeof(ne_shadow_weld_t));
+    vol->vertices = malloc(num_vertices * sizeof(NEA_Vec3));
+    if ((weld == NULL) || (vol->vertices == NULL))
+    {
+        NEA_DebugPrint("Not enough memory");
+        free(weld);
+        return -1;
+    }
+
+    for (int i = 0; i < num_vertices; i++)
+    {
+        weld[i].pos = vertices[i];
+        weld[i].index = i;
+    }
+
+    qsort(weld, num_vertices, sizeof(ne_shadow_weld_t), ne_shadow_weld_cmp);
+
+    int count = 0;
+    int32_t max_coord = 0;
+
+    for (int i = 0; i < num_vertices; i++)
+    {
+        if ((i == 0) || (ne_shadow_weld_cmp(&weld[i - 1], &weld[i]) != 0))
+        {
+            if (count == NEA_SHADOW_NO_FACE)
+            {
+                NEA_DebugPrint("Too many vertices");
+                free(weld);
+                return -1;
+            }
+
+            const NEA_Vec3 *p = &weld[i].pos;
+            int32_t c[3] = { abs(p->x), abs(p->y), abs(p->z) };
+            for (int k = 0; k < 3; k++)
+            {
+                if (c[k] > max_coord)
+                    max_coord = c[k];
+            }
+
+            vol->vertices[count++] = *p;
+        }
+
+        remap[weld[i].index] = count - 1;
+    }
+
+    free(weld);
+
+    vol->num_vertices = count;
+    vol->max_coord = max_coord;
+
+    return count;
+}
+
+// Finds the edges shared by two triangles. Edges shared by more than two
+// triangles are treated as open edges of each triangle.
+static int ne_shadow_build_edges(NEA_ShadowVolume *vol)
+{
+    int num_half = vol->num_triangles * 3;
+
+    ne_shadow_half_edge_t *half = malloc(num_half * sizeof(*half));
+    vol->edges = malloc(num_half * sizeof(NEA_ShadowEdge));
+    if ((half == NULL) || (vol->edges == NULL))
+    {
+        free(half);
+        return 0;
+    }
+
+    for (int t = 0; t < vol->num_triangles; t++)
+    {
+        const uint16_t *tri = &vol->triangles[t * 3];
+
+        for (int i = 0; i < 3; i++)
+        {
+            ne_shadow_half_edge_t *e = &half[t * 3 + i];
+
+            e->a = tri[i];
+            e->b = tri[(i + 1) % 3];
+            e->lo = (e->a < e->b) ? e->a : e->b;
+            e->hi = (e->a < e->b) ? e->b : e->a;
+            e->face = t;
+        }
+    }
+
+    qsort(half, num_half, sizeof(*half), ne_shadow_edge_cmp);
+
+    int count = 0;
+    int i = 0;
+
+    while (i < num_half)
+    {
+        int j = i + 1;
+        while ((j < num_half) && (half[j].lo == half[i].lo) &&
+               (half[j].hi == half[i].hi))
+            j++;
+
+        if (j - i == 2)
+        {
+            NEA_ShadowEdge *e = &vol->edges[count++];
+            e->v[0] = half[i].a;
+            e->v[1] = half[i].b;
+            e->face[0] = half[i].face;
+            e->face[1] = half[i + 1].face;
+        }
+        else
+        {
+            for (int k = i; k < j; k++)
+            {
+                NEA_ShadowEdge *e = &vol->edges[count++];
+                e->v[0] = half[k].a;
+                e->v[1] = half[k].b;
+                e->face[0] = half[k].face;
+                e->face[1] = NEA_SHADOW_NO_FACE;
+            }
+        }
+
+        i = j;
+    }
+
+    free(half);
+
+    vol->num_edges = count;
+
+    NEA_ShadowEdge *edges = realloc(vol->edges, count * sizeof(NEA_ShadowEdge));
+    if (edges != NULL)
+        vol->edges = edges;
+
+    return 1;
+}
+
+NEA_ShadowVolume *NEA_ShadowVolumeCreate(const NEA_Vec3 *vertices,
+                                         int num_vertices,
+                                         const uint16_t *indices,
+                                         int num_triangles)
+{
+    NEA_AssertPointer(vertices, "NULL vertices pointer");
+    NEA_AssertPointer(indices, "NULL indices pointer");
+
+    if ((num_vertices <= 0) || (num_triangles <= 0) ||
+        (num_triangles >= NEA_SHADOW_NO_FACE))
+    {
+        NEA_DebugPrint("Invalid mesh size");
+        return NULL;
+    }
+
+    NEA_ShadowVolume *vol = calloc(1, sizeof(NEA_ShadowVolume));
+    uint16_t *remap = malloc(num_vertices * sizeof(uint16_t));
+    if ((vol == NULL) || (remap == NULL))
+        goto error_memory;
+
+    vol->extrusion = NEA_SHADOW_DEFAULT_EXTRUSION;
+    vol->threshold = NEA_SHADOW_DEFAULT_THRESHOLD;
+
+    if (ne_shadow_weld(vol, vertices, num_vertices, remap) < 0)
+        goto error;
+
+    vol->triangles = malloc(num_triangles * 3 * sizeof(uint16_t));
+    vol->normals = malloc(num_triangles * sizeof(NEA_Vec3));
+    if ((vol->triangles == NULL) || (vol->normals == NULL))
+        goto error_memory;
+
+    // Triangles with repeated vertices don't have any area, and they would
+    // make edges look like they are shared by more triangles.
+    int count = 0;
+    for (int t = 0; t < num_triangles; t++)
+    {
+        uint16_t v[3];
+        for (int i = 0; i < 3; i++)
+        {
+            int index = indices[t * 3 + i];
+            NEA_AssertMinMax(0, index, num_vertices - 1,
+                             "Invalid vertex index %d", index);
+            v[i] = remap[index];
+        }
+
+        if ((v[0] == v[1]) || (v[1] == v[2]) || (v[2] == v[0]))
+            continue;
+
+        uint16_t *tri = &vol->triangles[count * 3];
+        tri[0] = v[0];
+        tri[1] = v[1];
+        tri[2] = v[2];
+
+        vol->normals[count] = ne_shadow_normal(&vol->vertices[v[0]],
+                                               &vol->vertices[v[1]],
+                                               &vol->vertices[v[2]]);
+        count++;
+    }
+
+    if (count == 0)
+    {
+        NEA_DebugPrint("Mesh without triangles");
+        goto error;
+    }
+
+    vol->num_triangles = count;
+
+    vol->lit = calloc(count, sizeof(uint8_t));
+    if (vol->lit == NULL)
+        goto error_memory;
+
+    if (ne_shadow_build_edges(vol) == 0)
+        goto error_memory;
+
+    free(remap);
+
+    return vol;
+
+error_memory:
+    NEA_DebugPrint("Not enough memory");
+error:
+    free(remap);
+    NEA_ShadowVolumeDelete(vol);
+    return NULL;
+}
+
+NEA_ShadowVolume *NEA_ShadowVolumeCreateFromColMesh(const NEA_ColMesh *mesh)
+{
+    NEA_AssertPointer(mesh, "NULL ColMesh pointer");
+
+    int num_triangles = mesh->num_triangles;
+    if (num_triangles == 0)
+    {
+        NEA_DebugPrint("Mesh without triangles");
+        return NULL;
+    }
+
+    NEA_Vec3 *vertices = malloc(num_triangles * 3 * sizeof(NEA_Vec3));
+    uint16_t *indices = malloc(num_triangles * 3 * sizeof(uint16_t));
+    if ((vertices == NULL) || (indices == NULL))
+    {
+        NEA_DebugPrint("Not enough memory");
+        free(vertices);
+        free(indices);
+        return NULL;
+    }
+
+    for (int t = 0; t < num_triangles; t++)
+    {
+        const NEA_ColTriangle *tri = &mesh->triangles[t];
+
+        vertices[t * 3 + 0] = tri->v0;
+        vertices[t * 3 + 1] = tri->v1;
+        vertices[t * 3 + 2] = tri->v2;
+    }
+
+    for (int i = 0; i < num_triangles * 3; i++)
+        indices[i] = i;
+
+    NEA_ShadowVolume *vol = NEA_ShadowVolumeCreate(vertices, num_triangles * 3,
+                                                   indices, num_triangles);
+
+    free(vertices);
+    free(indices);
+
+    return vol;
+}
+
+// Display list decoding
+// ---------------------
+
+typedef struct {
+    NEA_Vec3 *vertices;
+    int num_vertices;
+    int max_vertices;
+    uint16_t *indices;
+    int num_triangles;
+    int max_triangles;
+} ne_shadow_soup_t;
+
+// Number of parameters of a GX command, or -1 if it isn't valid
+static int ne_shadow_command_params(unsigned int id)
+{
+    switch (id)
+    {
+        case 0x00: // NOP
+        case 0x11: // MTX_PUSH
+        case 0x15: // MTX_IDENTITY
+        case 0x41: // END_VTXS
+            return 0;
+        case 0x10: // MTX_MODE
+        case 0x12: // MTX_POP
+        case 0x13: // MTX_STORE
+        case 0x14: // MTX_RESTORE
+        case 0x20: // COLOR
+        case 0x21: // NORMAL
+        case 0x22: // TEXCOORD
+        case 0x24: // VTX_10
+        case 0x25: // VTX_XY
+        case 0x26: // VTX_XZ
+        case 0x27: // VTX_YZ
+        case 0x28: // VTX_DIFF
+        case 0x29: // POLYGON_ATTR
+        case 0x2A: // TEXIMAGE_PARAM
+        case 0x2B: // PLTT_BASE
+        case 0x30: // DIF_AMB
+        case 0x31: // SPE_EMI
+        case 0x32: // LIGHT_VECTOR
+        case 0x33: // LIGHT_COLOR
+        case 0x40: // BEGIN_VTXS
+        case 0x50: // SWAP_BUFFERS
+        case 0x60: // VIEWPORT
+        case 0x72: // VEC_TEST
+            return 1;
+        case 0x23: // VTX_16
+        case 0x71: // POS_TEST
+            return 2;
+        case 0x1B: // MTX_SCALE
+        case 0x1C: // MTX_TRANS
+        case 0x70: // BOX_TEST
+            return 3;
+        case 0x1A: // MTX_MULT_3x3
+            return 9;
+        case 0x17: // MTX_LOAD_4x3
+        case 0x19: // MTX_MULT_4x3
+            return 12;
+        case 0x16: // MTX_LOAD_4x4
+        case 0x18: // MTX_MULT_4x4
+            return 16;
+        case 0x34: // SHININESS
+            return 32;
+        default:
+            return -1;
+    }
+}
+
+// Returns the index of the new vertex, or -1 on error
+static int ne_shadow_soup_vertex(ne_shadow_soup_t *soup, const int32_t *v)
+{
+    // Indices are 16-bit
+    if (soup->num_vertices == 0x10000)
+    {
+        NEA_DebugPrint("Too many vertices");
+        return -1;
+    }
+
+    if (soup->num_vertices == soup->max_vertices)
+    {
+        int max = (soup->max_vertices == 0) ? 256 : soup->max_vertices * 2;
+        NEA_Vec3 *vertices = realloc(soup->vertices, max * sizeof(NEA_Vec3));
+        if (vertices == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return -1;
+        }
+
+        soup->vertices = vertices;
+        soup->max_vertices = max;
+    }
+
+    soup->vertices[soup->num_vertices] = NEA_Vec3Make(v[0], v[1], v[2]);
+    return soup->num_vertices++;
+}
+
+static int ne_shadow_soup_triangle(ne_shadow_soup_t *soup, int a, int b, int c)
+{
+    if (soup->num_triangles == soup->max_triangles)
+    {
+        int max = (soup->max_triangles == 0) ? 256 : soup->max_triangles * 2;
+        uint16_t *indices = realloc(soup->indices, max * 3 * sizeof(uint16_t));
+        if (indices == NULL)
+            return 0;
+
+        soup->indices = indices;
+        soup->max_triangles = max;
+    }
+
+    uint16_t *tri = &soup->indices[soup->num_triangles * 3];
+    tri[0] = a;
+    tri[1] = b;
+    tri[2] = c;
+    soup->num_triangles++;
+
+    return 1;
+}
+
+// Sign-extends a field of a packed parameter
+static inline int32_t ne_shadow_field(uint32_t value, int shift, int bits)
+{
+    return (int32_t)(value << (32 - shift - bits)) >> (32 - bits);
+}
+
+// Adds the triangles of the primitive that end with the last vertex
+static int ne_shadow_soup_primitive(ne_shadow_soup_t *soup, int type,
+                                    const int *last, int count)
+{
+    switch (type)
+    {
+        case GL_TRIANGLES:
+            if (count % 3 == 0)
+                return ne_shadow_soup_triangle(soup, last[2], last[1], last[0]);
+            break;
+        case GL_QUADS:
+            if (count % 4 == 0)
+            {
+                return ne_shadow_soup_triangle(soup, last[3], last[2], last[1])
+                    && ne_shadow_soup_triangle(soup, last[3], last[1], last[0]);
+            }
+            break;
+        case GL_TRIANGLE_STRIP:
+            if (count < 3)
+                break;
+            // Every other triangle has the opposite winding
+            if (count % 2 == 1)
+                return ne_shadow_soup_triangle(soup, last[2], last[1], last[0]);
+            return ne_shadow_soup_triangle(soup, last[1], last[2], last[0]);
+        case GL_QUAD_STRIP:
+            if ((count < 4) || (count % 2 == 1))
+                break;
+            // The quad is v0, v1, v3, v2
+            return ne_shadow_soup_triangle(soup, last[3], last[2], last[0])
+                && ne_shadow_soup_triangle(soup, last[3], last[0], last[1]);
+    }
+
+    return 1;
+}
+
+NEA_ShadowVolume *NEA_ShadowVolumeCreateFromList(const void *list)
+{
+    NEA_AssertPointer(list, "NULL display list pointer");
+
+    const uint32_t *p = list;
+    uint32_t words = *p++;
+    const uint32_t *end = p + words;
+
+    ne_shadow_soup_t soup = { 0 };
+
+    int32_t v[3] = { 0, 0, 0 };
+    int type = GL_TRIANGLES;
+    int last[4] = { 0, 0, 0, 0 }; // Most recent vertex first
+    int count = 0; // Vertices since the last BEGIN_VTXS
+
+    while (p < end)
+    {
+        uint32_t commands = *p++;
+
+        for (int i = 0; i < 4; i++)
+        {
+            unsigned int id = (commands >> (i * 8)) & 0xFF;
+
+            int params = ne_shadow_command_params(id);
+            if ((params < 0) || (p + params > end))
+            {
+                NEA_DebugPrint("Invalid display list");
+                goto error;
+            }
+
+            bool vertex = true;
+            uint32_t arg = (params > 0) ? p[0] : 0;
+
+            switch (id)
+            {
+                case 0x23: // VTX_16
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[1] = (int16_t)(arg >> 16);
+                    v[2] = (int16_t)(p[1] & 0xFFFF);
+                    break;
+                case 0x24: // VTX_10
+                    for (int k = 0; k < 3; k++)
+                        v[k] = ne_shadow_field(arg, k * 10, 10) << 6;
+                    break;
+                case 0x25: // VTX_XY
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[1] = (int16_t)(arg >> 16);
+                    break;
+                case 0x26: // VTX_XZ
+                    v[0] = (int16_t)(arg & 0xFFFF);
+                    v[2] = (int16_t)(arg >> 16);
+                    break;
+                case 0x27: // VTX_YZ
+                    v[1] = (int16_t)(arg & 0xFFFF);
+                    v[2] = (int16_t)(arg >> 16);
+                    break;
+                case 0x28: // VTX_DIFF
+                    for (int k = 0; k < 3; k++)
+                        v[k] += ne_shadow_field(arg, k * 10, 10) << 3;
+                    break;
+                case 0x40: // BEGIN_VTXS
+                    type = arg & 3;
+                    count = 0;
+                    vertex = false;
+                    break;
+                default:
+                    vertex = false;
+                    break;
+            }
+
+            p += params;
+
+            if (!vertex)
+                continue;
+
+            int index = ne_shadow_soup_vertex(&soup, v);
+            if (index < 0)
+                goto error;
+
+            last[3] = last[2];
+            last[2] = last[1];
+            last[1] = last[0];
+            last[0] = index;
+            count++;
+
+            if (ne_shadow_soup_primitive(&soup, type, last, count) == 0)
+                goto error_memory;
+        }
+    }
+
+    if (soup.num_triangles == 0)
+    {
+        NEA_DebugPrint("Display list without triangles");
+        goto error;
+    }
+
+    NEA_ShadowVolume *vol = NEA_ShadowVolumeCreate(soup.vertices,
+                                                   soup.num_vertices,
+                                                   soup.indices,
+                                                   soup.num_triangles);
+    free(soup.vertices);
+    free(soup.indices);
+    return vol;
+
+error_memory:
+    NEA_DebugPrint("Not enough memory");
+error:
+    free(soup.vertices);
+    free(soup.indices);
+    return NULL;
+}
+
+// Volume generation
+// -----------------
+
+// Writes GX commands packed in groups of 4, like obj2dl does
+typedef struct {
+    uint32_t *p;
+    uint32_t *commands; // Word with the commands of the current group
+    int slot;           // Commands in the current group
+} ne_shadow_writer_t;
+
+static inline void ne_shadow_write_command(ne_shadow_writer_t *w,
+                                           uint32_t id)
+{
+    if (w->slot == 4)
+    {
+        w->commands = w->p++;
+        *w->commands = 0;
+        w->slot = 0;
+    }
+
+    *w->commands |= id << (w->slot * 8);
+    w->slot++;
+}
+
+static inline void ne_shadow_write_vertex(ne_shadow_writer_t *w,
+                                          const NEA_Vec3 *v,
+                                          const NEA_Vec3 *offset, int shift)
+{
+    int32_t x = (v->x + offset->x) >> shift;
+    int32_t y = (v->y + offset->y) >> shift;
+    int32_t z = (v->z + offset->z) >> shift;
+
+    ne_shadow_write_command(w, FIFO_VERTEX16);
+    *w->p++ = (y << 16) | (x & 0xFFFF);
+    *w->p++ = z & 0xFFFF;
+}
+
+static inline bool ne_shadow_lit(const NEA_ShadowVolume *vol, int face)
+{
+    return (face != NEA_SHADOW_NO_FACE) && vol->lit[face];
+}
+
+static int ne_shadow_build_list(NEA_ShadowVolume *vol, NEA_Vec3 e)
+{
+    // Triangles that face the light
+    int num_lit = 0;
+    for (int t = 0; t < vol->num_triangles; t++)
+    {
+        const NEA_Vec3 *n = &vol->normals[t];
+        int64_t d = (int64_t)n->x * e.x + (int64_t)n->y * e.y
+                  + (int64_t)n->z * e.z;
+
+        vol->lit[t] = d < 0;
+        num_lit += vol->lit[t];
+    }
+
+    // Edges between a lit and an unlit triangle, and open edges of lit
+    // triangles
+    int num_sides = 0;
+    for (int i = 0; i < vol->num_edges; i++)
+    {
+        const NEA_ShadowEdge *edge = &vol->edges[i];
+        if (ne_shadow_lit(vol, edge->face[0]) !=
+            ne_shadow_lit(vol, edge->face[1]))
+            num_sides++;
+    }
+
+    // VTX_16 only has 3 bits of integer part. If the extruded volume doesn't
+    // fit, the vertices are divided by a power of two and the list scales
+    // them back.
+    int32_t e_max = abs(e.x);
+    if (abs(e.y) > e_max)
+        e_max = abs(e.y);
+    if (abs(e.z) > e_max)
+        e_max = abs(e.z);
+
+    int32_t max_coord = vol->max_coord + e_max;
+    int shift = 0;
+    while ((max_coord >> shift) > 0x7FFF)
+        shift++;
+
+    int num_commands = 2 + num_lit * 6 + num_sides * 4 + ((shift > 0) ? 1 : 0);
+    int num_params = 2 + (num_lit * 6 + num_sides * 4) * 2
+                   + ((shift > 0) ? 3 : 0);
+    size_t words = 1 + (num_commands + 3) / 4 + num_params;
+
+    // The list may still be in the queue of the asynchronous backend
+    NEA_DisplayListWait();
+
+    if (words > vol->capacity)
+    {
+        uint32_t *list = realloc(vol->list, words * sizeof(uint32_t));
+        if (list == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+
+        vol->list = list;
+        vol->capacity = words;
+    }
+
+    vol->extrude = e;
+    vol->valid = true;
+    vol->rebuilds++;
+
+    if ((num_lit == 0) && (num_sides == 0))
+    {
+        vol->list[0] = 0;
+        return 1;
+    }
+
+    ne_shadow_writer_t w = { &vol->list[1], NULL, 4 };
+    NEA_Vec3 zero = { 0, 0, 0 };
+
+    if (shift > 0)
+    {
+        ne_shadow_write_command(&w, FIFO_SCALE);
+        *w.p++ = inttof32(1 << shift);
+        *w.p++ = inttof32(1 << shift);
+        *w.p++ = inttof32(1 << shift);
+    }
+
+    // Front and back caps. Both sides of the polygons are drawn, so the
+    // winding doesn't matter.
+    ne_shadow_write_command(&w, FIFO_BEGIN);
+    *w.p++ = GL_TRIANGLES;
+
+    for (int t = 0; t < vol->num_triangles; t++)
+    {
+        if (!vol->lit[t])
+            continue;
+
+        const uint16_t *tri = &vol->triangles[t * 3];
+        for (int i = 0; i < 3; i++)
+            ne_shadow_write_vertex(&w, &vol->vertices[tri[i]], &zero, shift);
+        for (int i = 2; i >= 0; i--)
+            ne_shadow_write_vertex(&w, &vol->vertices[tri[i]], &e, shift);
+    }
+
+    // Sides
+    ne_shadow_write_command(&w, FIFO_BEGIN);
+    *w.p++ = GL_QUADS;
+
+    for (int i = 0; i < vol->num_edges; i++)
+    {
+        const NEA_ShadowEdge *edge = &vol->edges[i];
+        bool lit0 = ne_shadow_lit(vol, edge->face[0]);
+        if (lit0 == ne_shadow_lit(vol, edge->face[1]))
+            continue;
+
+        // Keep the winding of the lit triangle
+        const NEA_Vec3 *a = &vol->vertices[edge->v[lit0 ? 0 : 1]];
+        const NEA_Vec3 *b = &vol->vertices[edge->v[lit0 ? 1 : 0]];
+
+        ne_shadow_write_vertex(&w, b, &zero, shift);
+        ne_shadow_write_vertex(&w, a, &zero, shift);
+        ne_shadow_write_vertex(&w, a, &e, shift);
+        ne_shadow_write_vertex(&w, b, &e, shift);
+    }
+
+    vol->list[0] = w.p - &vol->list[1];
+
+    NEA_Assert(vol->list[0] == words - 1, "Wrong display list size");
+
+    return 1;
+}
+
+void NEA_ShadowVolumeSetExtrusionI(NEA_ShadowVolume *vol, int32_t length)
+{
+    NEA_AssertPointer(vol, "NULL pointer");
+    NEA_Assert(length > 0, "Invalid length");
+
+    vol->extrusion = length;
+    vol->valid = false;
+}
+
+void NEA_ShadowVolumeSetThreshold(NEA_ShadowVolume *vol, int32_t threshold)
+{
+    NEA_AssertPointer(vol, "NULL pointer");
+    NEA_Assert(threshold >= 0, "Invalid threshold");
+
+    vol->threshold = threshold;
+}
+
+int NEA_ShadowVolumeUpdateI(NEA_ShadowVolume *vol, const m4x3 *mat,
+                            int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(vol, "NULL pointer");
+
+    if ((x == 0) && (y == 0) && (z == 0))
+    {
+        NEA_DebugPrint("Invalid light direction");
+        return -1;
+    }
+
+    int32_t dir[3] = { x, y, z };
+    normalizef32(dir);
+
+    int32_t w[3];
+    for (int i = 0; i < 3; i++)
+        w[i] = mulf32(dir[i], vol->extrusion);
+
+    // Move the extrusion to model space. The rows of the matrix are the axes of
+    // the model multiplied by their scale, so the inverse of a matrix without
+    // shear is its transpose divided by the squares of the scales.
+    NEA_Vec3 e;
+    if (mat == NULL)
+    {
+        e = NEA_Vec3Make(w[0], w[1], w[2]);
+    }
+    else
+    {
+        int32_t local[3];
+        for (int i = 0; i < 3; i++)
+        {
+            const int32_t *row = &mat->m[i * 3];
+
+            int64_t dot = (int64_t)w[0] * row[0] + (int64_t)w[1] * row[1]
+                        + (int64_t)w[2] * row[2];
+            int64_t len2 = (int64_t)row[0] * row[0] + (int64_t)row[1] * row[1]
+                         + (int64_t)row[2] * row[2];
+            if (len2 == 0)
+            {
+                NEA_DebugPrint("Matrix with a scale of 0");
+                return -1;
+            }
+
+            local[i] = (dot * 4096) / len2;
+        }
+
+        e = NEA_Vec3Make(local[0], local[1], local[2]);
+    }
+
+    if (vol->valid)
+    {
+        int64_t dx = e.x - vol->extrude.x;
+        int64_t dy = e.y - vol->extrude.y;
+        int64_t dz = e.z - vol->extrude.z;
+        int64_t dist2 = dx * dx + dy * dy + dz * dz;
+
+        const NEA_Vec3 *o = &vol->extrude;
+        int64_t len2 = (int64_t)o->x * o->x + (int64_t)o->y * o->y
+                     + (int64_t)o->z * o->z;
+        int64_t t2 = ((int64_t)vol->threshold * vol->threshold) >> 12;
+
+        if (dist2 <= ((t2 * len2) >> 12))
+            return 0;
+    }
+
+    if (ne_shadow_build_list(vol, e) == 0)
+        return -1;
+
+    return 1;
+}
+
+static const m4x3 *ne_shadow_model_matrix(NEA_Model *model)
+{
+    if (model->mat != NULL)
+        return model->mat;
+
+    ne_model_update_transform(model);
+    return &model->transform;
+}
+
+int NEA_ShadowVolumeUpdateModelI(NEA_ShadowVolume *vol, NEA_Model *model,
+                                 int32_t x, int32_t y, int32_t z)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    return NEA_ShadowVolumeUpdateI(vol, ne_shadow_model_matrix(model),
+                                   x, y, z);
+}
+
+// Drawing
+// -------
+
+void NEA_ShadowVolumeDrawList(const NEA_ShadowVolume *vol, const m4x3 *mat)
+{
+    NEA_AssertPointer(vol, "NULL pointer");
+
+    if (!vol->valid || (vol->list[0] == 0))
+        return;
+
+    // Wait for any asynchronous display list that is still being sent
+    NEA_DisplayListWait();
+
+    MATRIX_PUSH = 0;
+
+    if (mat != NULL)
+        glMultMatrix4x3(mat);
+
+    ne_display_list_draw_default(vol->list, false);
+
+    ne_display_list_matrix_pop();
+}
+
+void NEA_ShadowVolumeDrawListModel(const NEA_ShadowVolume *vol,
+                                   NEA_Model *model)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    NEA_ShadowVolumeDrawList(vol, ne_shadow_model_matrix(model));
+}
+
+void NEA_ShadowVolumeDraw(const NEA_ShadowVolume *vol, const m4x3 *mat,
+                          u32 color, u32 alpha, u32 id)
+{
+    NEA_AssertPointer(vol, "NULL pointer");
+    NEA_AssertMinMax(1, alpha, 30, "Invalid alpha value %lu", alpha);
+    NEA_AssertMinMax(1, id, 63, "Invalid polygon ID %lu", id);
+
+    if (!vol->valid || (vol->list[0] == 0))
+        return;
+
+    NEA_MaterialUse(NULL);
+
+    // The mask pass writes to the stencil buffer, not to the color buffer
+    NEA_PolyFormat(1, 0, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
+    NEA_PolyColor(color);
+    NEA_ShadowVolumeDrawList(vol, mat);
+
+    NEA_PolyFormat(alpha, id, 0, NEA_CULL_NONE, NEA_SHADOW_POLYGONS);
+    NEA_PolyColor(color);
+    NEA_ShadowVolumeDrawList(vol, mat);
+}
+
+void NEA_ShadowVolumeDrawModel(const NEA_ShadowVolume *vol, NEA_Model *model,
+                               u32 color, u32 alpha, u32 id)
+{
+    NEA_AssertPointer(model, "NULL model pointer");
+
+    NEA_ShadowVolumeDraw(vol, ne_shadow_model_matrix(model), color, alpha, id);
+}
@@ -7,18 +7,77 @@
 #ifdef NEA_MAXMOD
 
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
+#include "NEAPool.h"
+#include "NEAStats.h"
 
 /// @file NEASound.c
 
-static NEA_SoundSource **ne_sound_sources;
+static ne_pool_t ne_sound_sources;
 static int ne_max_sound_sources;
 static bool ne_sound_system_inited = false;
 static NEA_Camera *ne_sound_listener = NULL;
 
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_sound_static, NEA_SoundSource,
+                      NEA_STATIC_MAX_SOUND_SOURCES);
+#endif
+
+static int ne_sound_max_voices = NEA_DEFAULT_SOUND_VOICES;
+static int ne_sound_voices; // Sources with a Maxmod voice
+static int ne_sound_volume_threshold = 4;
+static int ne_sound_panning_threshold = 4;
+
+// Attenuation curve, indexed by the squared distance between min_dist and
+// max_dist. Entries are volume factors (f32).
+#define NE_SOUND_CURVE_SIZE 64
+static uint16_t ne_sound_curve[NE_SOUND_CURVE_SIZE + 1];
+
+// Right vector of the listener, and the camera state it was computed from
+static NEA_Camera *ne_sound_basis_cam = NULL;
+static int32_t ne_sound_basis_key[9];
+static NEA_Vec3 ne_sound_basis_right;
+
+// Internal use... see NEACamera.c and NEAModel.c
+bool ne_camera_active_position(int32_t *pos);
+void ne_model_world_position(const NEA_Model *model, int32_t *pos);
+bool ne_model_camera_dist2(NEA_Model *model, int64_t *dist2);
+
+// Bonus of the sources that already have a voice, so that sources with a
+// similar volume don't keep taking the voice from each other.
+#define NE_SOUND_VOICE_BONUS 16
+
+// Path of the soundbank loaded with NEA_SoundSystemResetFAT(), or NULL
+static char *ne_sound_bank_path = NULL;
+
+// State of a sample in the SFX cache
+typedef struct {
+    uint32_t size;     // Bytes of RAM used by the sample when it's loaded
+    uint32_t stamp;    // Value of the clock of the cache when it was used
+    mm_sfxhand handle; // Last effect played with the sample
+    uint16_t refs;     // Sound sources that use the sample
+    bool loaded;
+} ne_sfx_entry_t;
+
+static ne_sfx_entry_t *ne_sfx_cache = NULL;
+static int ne_sfx_cache_count;
+static size_t ne_sfx_cache_budget;
+static size_t ne_sfx_cache_used;
+static uint32_t ne_sfx_cache_clock;
+
+static int ne_sfx_cache_request(mm_word sample_id);
+
 // =========================================================================
 // System lifecycle
 // =========================================================================
 
+// The path is only known if the soundbank has been loaded from the filesystem
+static void ne_sound_bank_path_clear(void)
+{
+    ne_heap_free(NEA_HEAP_SOUND, ne_sound_bank_path);
+    ne_sound_bank_path = NULL;
+}
+
 static int ne_sound_alloc_pool(int max_sources)
 {
     if (ne_sound_system_inited)
@@ -29,15 +88,22 @@ static int ne_sound_alloc_pool(int max_sources)
     else
         ne_max_sound_sources = max_sources;
 
-    ne_sound_sources = calloc(ne_max_sound_sources,
-                              sizeof(NEA_SoundSource *));
-    if (ne_sound_sources == NULL)
-    {
-        NEA_DebugPrint("Not enough memory");
+    ne_max_sound_sources = NE_STATIC_CAPACITY(ne_max_sound_sources,
+                                              NEA_STATIC_MAX_SOUND_SOURCES);
+
+    if (NE_POOL_INIT(&ne_sound_sources, ne_sound_static,
+                     ne_max_sound_sources) == 0)
         return -1;
-    }
+
+    ne_pool_set_heap_tag(&ne_sound_sources, NEA_HEAP_SOUND);
 
     ne_sound_listener = NULL;
+    ne_sound_max_voices = NEA_DEFAULT_SOUND_VOICES;
+    ne_sound_voices = 0;
+    ne_sound_volume_threshold = 4;
+    ne_sound_panning_threshold = 4;
+    ne_sound_basis_cam = NULL;
+    NEA_SoundSetAttenuationCurve(NEA_SOUND_CURVE_LINEAR);
     ne_sound_system_inited = true;
     return 0;
 }
@@ -53,6 +119,9 @@ int NEA_SoundSystemReset(mm_addr soundbank, int max_sources)
     if (ret != 0)
         return ret;
 
+    // The soundbank is in RAM, the SFX cache can't use a previous path
+    ne_sound_bank_path_clear();
+
     soundEnable();
     mmInitDefaultMem(soundbank);
     return 0;
@@ -64,16 +133,20 @@ int NEA_SoundSystemResetFAT(const char *soundbank_path, int max_sources)
     if (ret != 0)
         return ret;
 
+    ne_sound_bank_path_clear();
+
     soundEnable();
 
     if (!mmInitDefault((char *)soundbank_path))
     {
         NEA_DebugPrint("mmInitDefault failed");
-        free(ne_sound_sources);
-        ne_sound_sources = NULL;
+        ne_pool_end(&ne_sound_sources);
         ne_sound_system_inited = false;
         return -1;
     }
+
+    // The SFX cache reads the sizes of the samples from the file
+    ne_sound_bank_path = ne_heap_strdup(NEA_HEAP_SOUND, soundbank_path);
     return 0;
 }
 
@@ -83,10 +156,12 @@ void NEA_SoundSystemEnd(void)
         return;
 
     NEA_SoundSourceDeleteAll();
-    free(ne_sound_sources);
-    ne_sound_sources = NULL;
+    NEA_SfxCacheEnd();
+    ne_pool_end(&ne_sound_sources);
     ne_sound_listener = NULL;
     ne_sound_system_inited = false;
+
+    ne_sound_bank_path_clear();
 }
 
 // =========================================================================
@@ -99,6 +174,95 @@ void NEA_SoundSetListener(NEA_Camera *cam)
     ne_sound_listener = cam;
 }
 
+void NEA_SoundSetAttenuationCurve(NEA_SoundCurve curve)
+{
+    for (int i = 0; i <= NE_SOUND_CURVE_SIZE; i++)
+    {
+        // Squared distance, from 0 at min_dist to 1 at max_dist (f32)
+        uint32_t s = (i << 12) / NE_SOUND_CURVE_SIZE;
+
+        if (curve == NEA_SOUND_CURVE_SQUARED)
+            ne_sound_curve[i] = 4096 - s;
+        else
+            ne_sound_curve[i] = 4096 - sqrt64((uint64_t)s << 12);
+    }
+}
+
+// Precomputes the values used to index the attenuation curve
+static void ne_sound_update_range(NEA_SoundSource *source)
+{
+    uint64_t min_sq = (int64_t)source->min_dist * source->min_dist;
+    uint64_t max_sq = (int64_t)source->max_dist * source->max_dist;
+    uint64_t range = max_sq - min_sq;
+
+    int shift = 0;
+    while ((range >> shift) >= (1 << 24))
+        shift++;
+
+    uint32_t r = range >> shift;
+    if (r < 128)
+        r = 128;
+
+    source->atten_shift = shift;
+    source->atten_scale = ((uint64_t)NE_SOUND_CURVE_SIZE << 32) / r;
+}
+
+// =========================================================================
+// Voices
+// =========================================================================
+
+void NEA_SoundSetMaxVoices(int voices)
+{
+    NEA_AssertMinMax(1, voices, NEA_SOUND_MAX_VOICES,
+                     "Invalid number of voices: %d", voices);
+    ne_sound_max_voices = voices;
+}
+
+int NEA_SoundGetVoiceCount(void)
+{
+    return ne_sound_voices;
+}
+
+void NEA_SoundSetUpdateThreshold(int volume, int panning)
+{
+    NEA_Assert(volume >= 0 && volume <= 255, "Volume must be 0-255");
+    NEA_Assert(panning >= 0 && panning <= 255, "Panning must be 0-255");
+    ne_sound_volume_threshold = volume;
+    ne_sound_panning_threshold = panning;
+}
+
+static void ne_sound_voice_start(NEA_SoundSource *source)
+{
+    mm_sound_effect sfx;
+    sfx.id = source->sample_id;
+    sfx.rate = source->ref_rate;
+    sfx.handle = 0;
+    sfx.volume = source->computed_volume;
+    sfx.panning = source->computed_panning;
+
+    if (source->handle == 0)
+        ne_sound_voices++;
+
+    if (ne_sfx_cache != NULL)
+        ne_sfx_cache_request(source->sample_id);
+
+    source->handle = mmEffectEx(&sfx);
+    source->sent_volume = sfx.volume;
+    source->sent_panning = sfx.panning;
+    source->virtual_voice = false;
+    source->had_voice = true;
+}
+
+static void ne_sound_voice_stop(NEA_SoundSource *source)
+{
+    if (source->handle == 0)
+        return;
+
+    mmEffectCancel(source->handle);
+    source->handle = 0;
+    ne_sound_voices--;
+}
+
 // =========================================================================
 // Sound source management
 // =========================================================================
@@ -111,33 +275,38 @@ NEA_SoundSource *NEA_SoundSourceCreate(mm_word sample_id)
         return NULL;
     }
 
-    for (int i = 0; i < ne_max_sound_sources; i++)
+    if (ne_pool_next_slot(&ne_sound_sources) < 0)
     {
-        if (ne_sound_sources[i] != NULL)
-            continue;
-
-        NEA_SoundSource *src = calloc(1, sizeof(NEA_SoundSource));
-        if (src == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
-
-        src->active = true;
-        src->sample_id = sample_id;
-        src->ref_volume = 255;
-        src->ref_rate = 1024;
-        src->min_dist = floattof32(1.0);
-        src->max_dist = floattof32(20.0);
-        src->computed_panning = 128;
-        src->loop_delay = 60; // Default: re-trigger every 1 second
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        ne_sound_sources[i] = src;
-        return src;
+    NEA_SoundSource *src = ne_pool_object_alloc(&ne_sound_sources,
+                                                sizeof(NEA_SoundSource));
+    if (src == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
     }
 
-    NEA_DebugPrint("No free slots");
-    return NULL;
+    src->active = true;
+    src->sample_id = sample_id;
+    src->ref_volume = 255;
+    src->ref_rate = 1024;
+    src->min_dist = floattof32(1.0);
+    src->max_dist = floattof32(20.0);
+    src->computed_panning = 128;
+    src->loop_delay = 60; // Default: re-trigger every 1 second
+    src->priority = NEA_DEFAULT_SOUND_PRIORITY;
+    ne_sound_update_range(src);
+
+    // The sample is loaded when the source is played, and it isn't evicted
+    // from the SFX cache while the source exists.
+    if ((ne_sfx_cache != NULL) && (sample_id < (mm_word)ne_sfx_cache_count))
+        ne_sfx_cache[sample_id].refs++;
+
+    ne_pool_add(&ne_sound_sources, src);
+    return src;
 }
 
 void NEA_SoundSourceDelete(NEA_SoundSource *source)
@@ -148,20 +317,22 @@ void NEA_SoundSourceDelete(NEA_SoundSource *source)
     NEA_AssertPointer(source, "NULL pointer");
 
     // Stop if playing
-    if (source->handle != 0)
-        mmEffectCancel(source->handle);
+    ne_sound_voice_stop(source);
 
-    for (int i = 0; i < ne_max_sound_sources; i++)
+    int slot = ne_pool_find(&ne_sound_sources, source);
+    if (slot < 0)
     {
-        if (ne_sound_sources[i] == source)
-        {
-            ne_sound_sources[i] = NULL;
-            free(source);
-            return;
-        }
+        NEA_DebugPrint("Source not found");
+        return;
     }
 
-    NEA_DebugPrint("Source not found");
+    mm_word id = source->sample_id;
+    if ((ne_sfx_cache != NULL) && (id < (mm_word)ne_sfx_cache_count) &&
+        (ne_sfx_cache[id].refs > 0))
+        ne_sfx_cache[id].refs--;
+
+    ne_pool_remove(&ne_sound_sources, slot);
+    ne_pool_object_free(&ne_sound_sources, source);
 }
 
 void NEA_SoundSourceDeleteAll(void)
@@ -169,10 +340,11 @@ void NEA_SoundSourceDeleteAll(void)
     if (!ne_sound_system_inited)
         return;
 
-    for (int i = 0; i < ne_max_sound_sources; i++)
+    for (int i = ne_pool_count(&ne_sound_sources) - 1; i >= 0; i--)
     {
-        if (ne_sound_sources[i] != NULL)
-            NEA_SoundSourceDelete(ne_sound_sources[i]);
+        NEA_SoundSource *src = ne_pool_get(&ne_sound_sources, i);
+        if (src != NULL)
+            NEA_SoundSourceDelete(src);
     }
 }
 
@@ -203,6 +375,7 @@ void NEA_SoundSourceSetDistanceI(NEA_SoundSource *source,
     NEA_Assert(max_dist > min_dist, "max_dist must be greater than min_dist");
     source->min_dist = min_dist;
     source->max_dist = max_dist;
+    ne_sound_update_range(source);
 }
 
 void NEA_SoundSourceSetVolume(NEA_SoundSource *source, int volume)
@@ -231,6 +404,13 @@ void NEA_SoundSourceSetLoopDelay(NEA_SoundSource *source, uint16_t frames)
     source->loop_delay = frames;
 }
 
+void NEA_SoundSourceSetPriority(NEA_SoundSource *source, int priority)
+{
+    NEA_AssertPointer(source, "NULL pointer");
+    NEA_Assert(priority >= 0 && priority <= 255, "Priority must be 0-255");
+    source->priority = priority;
+}
+
 // =========================================================================
 // Sound source playback
 // =========================================================================
@@ -240,31 +420,26 @@ void NEA_SoundSourcePlay(NEA_SoundSource *source)
     NEA_AssertPointer(source, "NULL pointer");
 
     // Stop previous playback if any
-    if (source->handle != 0)
-        mmEffectCancel(source->handle);
+    ne_sound_voice_stop(source);
 
-    mm_sound_effect sfx;
-    sfx.id = source->sample_id;
-    sfx.rate = source->ref_rate;
-    sfx.handle = 0;
-    sfx.volume = source->computed_volume;
-    sfx.panning = source->computed_panning;
-
-    source->handle = mmEffectEx(&sfx);
     source->playing = true;
+    source->virtual_voice = true;
+    source->had_voice = false;
     source->loop_counter = source->loop_delay;
+
+    // Take a free voice now. If there are none, the next update decides if
+    // this source should get one from a less important source.
+    if (ne_sound_voices < ne_sound_max_voices)
+        ne_sound_voice_start(source);
 }
 
 void NEA_SoundSourceStop(NEA_SoundSource *source)
 {
     NEA_AssertPointer(source, "NULL pointer");
 
-    if (source->handle != 0)
-    {
-        mmEffectCancel(source->handle);
-        source->handle = 0;
-    }
+    ne_sound_voice_stop(source);
     source->playing = false;
+    source->virtual_voice = false;
 }
 
 bool NEA_SoundSourceIsPlaying(const NEA_SoundSource *source)
@@ -273,56 +448,101 @@ bool NEA_SoundSourceIsPlaying(const NEA_SoundSource *source)
     return source->playing;
 }
 
+bool NEA_SoundSourceIsVirtual(const NEA_SoundSource *source)
+{
+    NEA_AssertPointer(source, "NULL pointer");
+    return source->virtual_voice;
+}
+
 // =========================================================================
 // Spatial update
 // =========================================================================
 
-// Compute volume and panning for a single source relative to the listener.
-static void ne_sound_compute_spatial(NEA_SoundSource *source,
-                                      NEA_Vec3 cam_pos, NEA_Vec3 right_vec)
+// Vector from the listener to a source
+static NEA_Vec3 ne_sound_source_offset(const NEA_SoundSource *source,
+                                       NEA_Vec3 cam_pos)
 {
-    // Get source world position
     NEA_Vec3 src_pos;
     if (source->model != NULL)
-        src_pos = NEA_Vec3Make(source->model->x,
-                               source->model->y,
-                               source->model->z);
+    {
+        int32_t pos[3];
+        ne_model_world_position(source->model, pos);
+        src_pos = NEA_Vec3Make(pos[0], pos[1], pos[2]);
+    }
     else
+    {
         src_pos = source->position;
+    }
 
-    // Vector from listener to source
-    NEA_Vec3 diff = NEA_Vec3Sub(src_pos, cam_pos);
+    return NEA_Vec3Sub(src_pos, cam_pos);
+}
 
-    // Distance (64-bit precision, same as NEACollision.c)
-    int64_t dist_sq_64 = (int64_t)diff.x * diff.x
-                       + (int64_t)diff.y * diff.y
-                       + (int64_t)diff.z * diff.z;
-    uint32_t dist = (uint32_t)sqrt64((uint64_t)dist_sq_64);
+// Squared distance from the listener to a source. If the listener is where the
+// camera used last is, sources attached to a model use the distance cached by
+// the model, which the LOD selection of the model uses too.
+static int64_t ne_sound_source_dist2(const NEA_SoundSource *source,
+                                     NEA_Vec3 diff, bool shared)
+{
+    int64_t dist_sq;
+    if (shared && (source->model != NULL) &&
+        ne_model_camera_dist2(source->model, &dist_sq))
+        return dist_sq;
+
+    return (int64_t)diff.x * diff.x
+         + (int64_t)diff.y * diff.y
+         + (int64_t)diff.z * diff.z;
+}
 
-    // --- Volume attenuation (linear) ---
+// Compute the volume of a source from its squared distance to the listener.
+ARM_CODE static void ne_sound_compute_volume(NEA_SoundSource *source,
+                                             int64_t dist_sq)
+{
+    int64_t min_sq = (int64_t)source->min_dist * source->min_dist;
+    int64_t max_sq = (int64_t)source->max_dist * source->max_dist;
 
-    int32_t vol;
-    if (dist <= (uint32_t)source->min_dist)
+    if (dist_sq >= max_sq)
     {
-        vol = source->ref_volume;
-    }
-    else if (dist >= (uint32_t)source->max_dist)
-    {
-        vol = 0;
+        source->computed_volume = 0;
+        return;
     }
-    else
+
+    int32_t factor = 4096;
+    if (dist_sq > min_sq)
     {
-        int32_t range = source->max_dist - source->min_dist;
-        int32_t num = source->max_dist - (int32_t)dist;
-        vol = (int32_t)(((int64_t)source->ref_volume * num) / range);
-        if (vol < 0)
-            vol = 0;
-        if (vol > 255)
-            vol = 255;
+        // Position in the curve with 8 fractional bits
+        uint64_t rel = (uint64_t)(dist_sq - min_sq) >> source->atten_shift;
+        uint32_t pos = (rel * source->atten_scale) >> 24;
+        uint32_t index = pos >> 8;
+        if (index >= NE_SOUND_CURVE_SIZE)
+            index = NE_SOUND_CURVE_SIZE - 1;
+        int32_t frac = pos & 0xFF;
+
+        int32_t a = ne_sound_curve[index];
+        int32_t b = ne_sound_curve[index + 1];
+        factor = a + (((b - a) * frac) >> 8);
     }
+
+    int32_t vol = (source->ref_volume * factor) >> 12;
+    if (vol > 255)
+        vol = 255;
     source->computed_volume = (mm_byte)vol;
+}
 
-    // --- Panning (dot product with camera right vector) ---
+// Compute the panning of a source (dot product with camera right vector). Only
+// sources with a voice need it.
+static void ne_sound_compute_panning(NEA_SoundSource *source, NEA_Vec3 diff,
+                                     NEA_Vec3 right_vec, bool shared)
+{
+    // Distance (64-bit precision, same as NEACollision.c)
+    int32_t cached = -1;
+    if (shared && (source->model != NULL))
+        cached = NEA_ModelGetCameraDistance(source->model);
+
+    uint32_t dist;
+    if (cached >= 0)
+        dist = cached;
+    else
+        dist = sqrt64((uint64_t)ne_sound_source_dist2(source, diff, false));
 
     int32_t pan;
     if (dist > 0)
@@ -345,15 +565,19 @@ static void ne_sound_compute_spatial(NEA_SoundSource *source,
     source->computed_panning = (mm_byte)pan;
 }
 
-ARM_CODE void NEA_SoundUpdateAll(void)
+// Right vector of the listener. NEA_CameraUse() sets matrix_is_updated again,
+// so the position and orientation of the camera are compared as well.
+static NEA_Vec3 ne_sound_listener_right(NEA_Camera *cam)
 {
-    if (!ne_sound_system_inited)
-        return;
-    if (ne_sound_listener == NULL)
-        return;
+    const int32_t key[9] = {
+        cam->from[0], cam->from[1], cam->from[2],
+        cam->to[0], cam->to[1], cam->to[2],
+        cam->up[0], cam->up[1], cam->up[2]
+    };
 
-    NEA_Camera *cam = ne_sound_listener;
-    NEA_Vec3 cam_pos = NEA_Vec3Make(cam->from[0], cam->from[1], cam->from[2]);
+    if (cam == ne_sound_basis_cam && cam->matrix_is_updated &&
+        memcmp(key, ne_sound_basis_key, sizeof(key)) == 0)
+        return ne_sound_basis_right;
 
     // Compute camera right vector (same pattern as NEA_CameraMoveFreeI)
     int32_t vec_front[3], vec_right[3];
@@ -363,43 +587,178 @@ ARM_CODE void NEA_SoundUpdateAll(void)
     crossf32(vec_front, cam->up, vec_right);
     normalizef32(vec_right);
 
-    NEA_Vec3 right = NEA_Vec3Make(vec_right[0], vec_right[1], vec_right[2]);
+    ne_sound_basis_cam = cam;
+    memcpy(ne_sound_basis_key, key, sizeof(key));
+    ne_sound_basis_right = NEA_Vec3Make(vec_right[0], vec_right[1],
+                                        vec_right[2]);
+    return ne_sound_basis_right;
+}
 
-    for (int i = 0; i < ne_max_sound_sources; i++)
+// Advances the loop countdown of a source. Looping voices are re-triggered,
+// and one-shot sources end when the countdown reaches 0.
+static void ne_sound_advance(NEA_SoundSource *src)
+{
+    if (src->loop_counter > 0)
     {
-        NEA_SoundSource *src = ne_sound_sources[i];
+        src->loop_counter--;
+        return;
+    }
+
+    src->loop_counter = src->loop_delay;
+
+    if (src->looping)
+    {
+        // DS maxmod has no mmEffectActive(), so we count frames and
+        // re-trigger after loop_delay frames have elapsed.
+        if (src->handle != 0)
+            ne_sound_voice_start(src);
+        return;
+    }
+
+    // Release the voice instead of cancelling it in case the effect is
+    // longer than loop_delay.
+    if (src->handle != 0)
+    {
+        mmEffectRelease(src->handle);
+        src->handle = 0;
+        ne_sound_voices--;
+    }
+    src->playing = false;
+    src->virtual_voice = false;
+}
+
+// Sources that can't be heard don't compete for voices. One-shot sources that
+// have already lost their voice can't get one back.
+static int ne_sound_voice_score(const NEA_SoundSource *src)
+{
+    if (!src->playing || src->computed_volume == 0)
+        return -1;
+    if (src->handle == 0 && !src->looping && src->had_voice)
+        return -1;
+
+    int score = (src->priority << 9) + src->computed_volume;
+    if (src->handle != 0)
+        score += NE_SOUND_VOICE_BONUS;
+    return score;
+}
+
+ARM_CODE void NEA_SoundUpdateAll(void)
+{
+    if (!ne_sound_system_inited)
+        return;
+    if (ne_sound_listener == NULL)
+        return;
+
+    NEA_Camera *cam = ne_sound_listener;
+    NEA_Vec3 cam_pos = NEA_Vec3Make(cam->from[0], cam->from[1], cam->from[2]);
+
+    // The listener is normally the camera that has drawn the last frame, so
+    // the distances of the models can be shared with the rest of the engine.
+    int32_t active[3];
+    bool shared = ne_camera_active_position(active) &&
+                  (active[0] == cam->from[0]) && (active[1] == cam->from[1]) &&
+                  (active[2] == cam->from[2]);
+
+    // Sources that get a voice, sorted from the highest score
+    NEA_SoundSource *chosen[NEA_SOUND_MAX_VOICES];
+    int chosen_score[NEA_SOUND_MAX_VOICES];
+    int num_chosen = 0;
+
+    for (int i = 0; i < ne_pool_count(&ne_sound_sources); i++)
+    {
+        NEA_SoundSource *src = ne_pool_get(&ne_sound_sources, i);
         if (src == NULL || !src->active || !src->playing)
             continue;
 
-        ne_sound_compute_spatial(src, cam_pos, right);
+        NEA_Vec3 diff = ne_sound_source_offset(src, cam_pos);
+        ne_sound_compute_volume(src, ne_sound_source_dist2(src, diff, shared));
+        ne_sound_advance(src);
+        NE_STAT_ADD(sound_updates, 1);
 
-        if (src->handle != 0)
+        int score = ne_sound_voice_score(src);
+        if (score < 0)
+            continue;
+
+        if (num_chosen == ne_sound_max_voices &&
+            score <= chosen_score[num_chosen - 1])
+            continue;
+
+        int n = num_chosen < ne_sound_max_voices ? num_chosen++ : num_chosen - 1;
+        while (n > 0 && chosen_score[n - 1] < score)
         {
-            mmEffectVolume(src->handle, src->computed_volume);
-            mmEffectPanning(src->handle, src->computed_panning);
+            chosen[n] = chosen[n - 1];
+            chosen_score[n] = chosen_score[n - 1];
+            n--;
         }
+        chosen[n] = src;
+        chosen_score[n] = score;
+    }
 
-        // Re-trigger looping sources using a frame countdown timer.
-        // DS maxmod has no mmEffectActive(), so we count frames and
-        // re-trigger after loop_delay frames have elapsed.
-        if (src->looping)
+    // Take the voices from the sources that haven't been chosen
+    for (int i = 0; i < ne_pool_count(&ne_sound_sources); i++)
+    {
+        NEA_SoundSource *src = ne_pool_get(&ne_sound_sources, i);
+        if (src == NULL || src->handle == 0)
+            continue;
+
+        bool keep = false;
+        for (int n = 0; n < num_chosen; n++)
         {
-            if (src->loop_counter > 0)
+            if (chosen[n] == src)
             {
-                src->loop_counter--;
-            }
-            else
-            {
-                mm_sound_effect sfx;
-                sfx.id = src->sample_id;
-                sfx.rate = src->ref_rate;
-                sfx.handle = 0;
-                sfx.volume = src->computed_volume;
-                sfx.panning = src->computed_panning;
-                src->handle = mmEffectEx(&sfx);
-                src->loop_counter = src->loop_delay;
+                keep = true;
+                break;
             }
         }
+        if (keep)
+            continue;
+
+        ne_sound_voice_stop(src);
+        src->virtual_voice = true;
+
+        // One-shot sources can't be resumed
+        if (!src->looping)
+        {
+            src->playing = false;
+            src->virtual_voice = false;
+        }
+    }
+
+    if (num_chosen == 0)
+        return;
+
+    NEA_Vec3 right = ne_sound_listener_right(cam);
+
+    // Give them to the chosen sources, and update the ones that had one
+    for (int n = 0; n < num_chosen; n++)
+    {
+        NEA_SoundSource *src = chosen[n];
+
+        ne_sound_compute_panning(src, ne_sound_source_offset(src, cam_pos),
+                                 right, shared);
+
+        if (src->handle == 0)
+        {
+            src->loop_counter = src->loop_delay;
+            ne_sound_voice_start(src);
+            continue;
+        }
+
+        int vol = src->computed_volume;
+        int pan = src->computed_panning;
+
+        if ((vol == 0 && src->sent_volume != 0) ||
+            abs(vol - src->sent_volume) >= ne_sound_volume_threshold)
+        {
+            mmEffectVolume(src->handle, vol);
+            src->sent_volume = vol;
+        }
+
+        if (abs(pan - src->sent_panning) >= ne_sound_panning_threshold)
+        {
+            mmEffectPanning(src->handle, pan);
+            src->sent_panning = pan;
+        }
     }
 }
 
@@ -448,35 +807,274 @@ bool NEA_MusicIsPlaying(void)
     return mmActive();
 }
 
+// =========================================================================
+// SFX cache
+// =========================================================================
+
+// Header of a soundbank file created by mmutil. It's followed by the offsets
+// of the samples, and each sample starts with its size.
+typedef struct {
+    uint16_t num_samples;
+    uint16_t num_modules;
+    uint8_t reserved[8];
+} ne_sound_bank_header_t;
+
+// Size of the prefix that Maxmod loads before the data of each sample
+#define NE_SOUND_SAMPLE_PREFIX_SIZE 8
+
+// Reads the number of samples of the soundbank file and their sizes
+static int ne_sfx_cache_read_sizes(void)
+{
+    NEA_FATStream *file = NEA_FATStreamOpen(ne_sound_bank_path);
+    if (file == NULL)
+        return 0;
+
+    int ret = 0;
+
+    ne_sound_bank_header_t hdr;
+    if (NEA_FATStreamRead(file, &hdr, sizeof(hdr)) != sizeof(hdr))
+        goto end;
+
+    ne_sfx_cache = ne_heap_calloc(NEA_HEAP_SOUND,
+                                  hdr.num_samples, sizeof(ne_sfx_entry_t));
+    if ((ne_sfx_cache == NULL) && (hdr.num_samples > 0))
+        goto end;
+
+    ne_sfx_cache_count = hdr.num_samples;
+
+    for (int i = 0; i < hdr.num_samples; i++)
+    {
+        uint32_t offset, size;
+
+        if (!NEA_FATStreamSeek(file, sizeof(hdr) + i * sizeof(offset)) ||
+            (NEA_FATStreamRead(file, &offset, 4) != 4))
+            goto end;
+
+        if (!NEA_FATStreamSeek(file, offset) ||
+            (NEA_FATStreamRead(file, &size, 4) != 4))
+            goto end;
+
+        ne_sfx_cache[i].size = size + NE_SOUND_SAMPLE_PREFIX_SIZE;
+    }
+
+    ret = 1;
+
+end:
+    NEA_FATStreamClose(file);
+    if ((ret == 0) && (ne_sfx_cache != NULL))
+    {
+        ne_heap_free(NEA_HEAP_SOUND, ne_sfx_cache);
+        ne_sfx_cache = NULL;
+    }
+    return ret;
+}
+
+int NEA_SfxCacheInit(size_t budget)
+{
+    NEA_SfxCacheEnd();
+
+    if (ne_sound_bank_path == NULL)
+    {
+        NEA_DebugPrint("No soundbank loaded from a file");
+        return -1;
+    }
+
+    if (ne_sfx_cache_read_sizes() == 0)
+    {
+        NEA_DebugPrint("Can't read soundbank: %s", ne_sound_bank_path);
+        return -1;
+    }
+
+    ne_sfx_cache_budget = budget;
+    ne_sfx_cache_used = 0;
+    ne_sfx_cache_clock = 0;
+    return 0;
+}
+
+void NEA_SfxCacheEnd(void)
+{
+    if (ne_sfx_cache == NULL)
+        return;
+
+    for (int i = 0; i < ne_sfx_cache_count; i++)
+    {
+        if (ne_sfx_cache[i].loaded)
+            mmUnloadEffect(i);
+    }
+
+    ne_heap_free(NEA_HEAP_SOUND, ne_sfx_cache);
+    ne_sfx_cache = NULL;
+    ne_sfx_cache_count = 0;
+    ne_sfx_cache_used = 0;
+}
+
+// Returns true if a loaded sample can be unloaded now
+static bool ne_sfx_cache_can_evict(const ne_sfx_entry_t *e)
+{
+    if (!e->loaded || (e->refs > 0))
+        return false;
+
+    if ((e->handle != 0) && mmEffectActive(e->handle))
+        return false;
+
+    return true;
+}
+
+static void ne_sfx_cache_evict(int index)
+{
+    mmUnloadEffect(index);
+    ne_sfx_cache[index].loaded = false;
+    ne_sfx_cache[index].handle = 0;
+    ne_sfx_cache_used -= ne_sfx_cache[index].size;
+}
+
+// Loads a sample if it isn't loaded, unloading the samples that have been used
+// least recently until it fits in the budget.
+static int ne_sfx_cache_request(mm_word sample_id)
+{
+    if (sample_id >= (mm_word)ne_sfx_cache_count)
+    {
+        NEA_DebugPrint("Invalid sample ID: %u", (unsigned)sample_id);
+        return 0;
+    }
+
+    ne_sfx_entry_t *e = &ne_sfx_cache[sample_id];
+    e->stamp = ++ne_sfx_cache_clock;
+
+    if (e->loaded)
+        return 1;
+
+    while (ne_sfx_cache_used + e->size > ne_sfx_cache_budget)
+    {
+        int oldest = -1;
+        for (int i = 0; i < ne_sfx_cache_count; i++)
+        {
+            const ne_sfx_entry_t *c = &ne_sfx_cache[i];
+            if (!ne_sfx_cache_can_evict(c))
+                continue;
+            if ((oldest < 0) || (c->stamp < ne_sfx_cache[oldest].stamp))
+                oldest = i;
+        }
+
+        // Everything else is in use. The budget is exceeded instead of
+        // failing to play the sound.
+        if (oldest < 0)
+        {
+            NEA_DebugPrint("SFX cache over budget");
+            break;
+        }
+
+        ne_sfx_cache_evict(oldest);
+    }
+
+    mmLoadEffect(sample_id);
+    e->loaded = true;
+    ne_sfx_cache_used += e->size;
+    return 1;
+}
+
+int NEA_SfxCacheRequest(mm_word sample_id)
+{
+    if (ne_sfx_cache == NULL)
+    {
+        NEA_DebugPrint("SFX cache not initialized");
+        return 0;
+    }
+
+    return ne_sfx_cache_request(sample_id);
+}
+
+void NEA_SfxCachePrefetch(const mm_word *sample_ids, int count)
+{
+    NEA_AssertPointer(sample_ids, "NULL pointer");
+
+    for (int i = 0; i < count; i++)
+        NEA_SfxCacheRequest(sample_ids[i]);
+}
+
+bool NEA_SfxCacheIsLoaded(mm_word sample_id)
+{
+    if ((ne_sfx_cache == NULL) || (sample_id >= (mm_word)ne_sfx_cache_count))
+        return false;
+
+    return ne_sfx_cache[sample_id].loaded;
+}
+
+size_t NEA_SfxCacheGetUsed(void)
+{
+    return ne_sfx_cache_used;
+}
+
 // =========================================================================
 // Non-spatial SFX convenience
 // =========================================================================
 
 void NEA_SfxLoad(mm_word sample_id)
 {
+    if (ne_sfx_cache != NULL)
+    {
+        ne_sfx_cache_request(sample_id);
+        return;
+    }
+
     mmLoadEffect(sample_id);
 }
 
 void NEA_SfxUnload(mm_word sample_id)
 {
+    if (ne_sfx_cache != NULL)
+    {
+        if (sample_id >= (mm_word)ne_sfx_cache_count)
+            return;
+
+        if (ne_sfx_cache[sample_id].refs > 0)
+        {
+            NEA_DebugPrint("Sample used by sound sources");
+            return;
+        }
+
+        if (ne_sfx_cache[sample_id].loaded)
+            ne_sfx_cache_evict(sample_id);
+        return;
+    }
+
     mmUnloadEffect(sample_id);
 }
 
 mm_sfxhand NEA_SfxPlay(mm_word sample_id)
 {
-    return mmEffect(sample_id);
+    if (ne_sfx_cache == NULL)
+        return mmEffect(sample_id);
+
+    if (ne_sfx_cache_request(sample_id) == 0)
+        return 0;
+
+    mm_sfxhand handle = mmEffect(sample_id);
+    ne_sfx_cache[sample_id].handle = handle;
+    return handle;
 }
 
 mm_sfxhand NEA_SfxPlayEx(mm_word sample_id, mm_byte volume,
                           mm_byte panning, mm_hword rate)
 {
+    if (ne_sfx_cache != NULL)
+    {
+        if (ne_sfx_cache_request(sample_id) == 0)
+            return 0;
+    }
+
     mm_sound_effect sfx;
     sfx.id = sample_id;
     sfx.rate = rate;
     sfx.handle = 0;
     sfx.volume = volume;
     sfx.panning = panning;
-    return mmEffectEx(&sfx);
+    mm_sfxhand handle = mmEffectEx(&sfx);
+
+    if (ne_sfx_cache != NULL)
+        ne_sfx_cache[sample_id].handle = handle;
+
+    return handle;
 }
 
 void NEA_SfxSetRate(mm_sfxhand handle, mm_hword rate)
@@ -513,10 +1111,350 @@ void NEA_SfxStopAll(void)
 // WAV streaming
 // =========================================================================
 
+// State of the stream played by NEA_StreamOpenFile(). The ring buffer is filled
+// by NEA_StreamUpdate() and emptied by the Maxmod callback, which only copies
+// data. Each side only modifies its own counter, and both only grow.
+static struct {
+    NEA_FATStream *file;
+    uint8_t *ring;
+    uint32_t capacity;      // Size of the ring in bytes (power of two)
+    volatile uint32_t read; // Bytes copied to Maxmod
+    volatile uint32_t write;// Bytes read from the file
+    size_t data_offset;     // Start of the samples in the file
+    size_t data_size;       // Size of the samples in bytes
+    size_t remaining;       // Bytes left to read until the end of the data
+    uint32_t sample_bytes;  // Bytes of one sample of all channels
+    uint32_t underruns;
+    bool unsigned_8bit;     // 8-bit WAV files use unsigned samples
+    bool loop;
+    bool eof;
+} ne_stream;
+
+static bool ne_stream_active = false; // A stream has been opened
+
+static void ne_stream_close_file(void)
+{
+    if (ne_stream.file != NULL)
+        NEA_FATStreamClose(ne_stream.file);
+    ne_heap_free(NEA_HEAP_SOUND, ne_stream.ring);
+
+    ne_stream.file = NULL;
+    ne_stream.ring = NULL;
+}
+
+ARM_CODE static mm_word ne_stream_callback(mm_word length, mm_addr dest,
+                                           mm_stream_formats format)
+{
+    (void)format;
+
+    uint8_t *dst = dest;
+    uint32_t bytes = length * ne_stream.sample_bytes;
+    uint32_t avail = ne_stream.write - ne_stream.read;
+    uint32_t copy = bytes < avail ? bytes : avail;
+
+    uint32_t start = ne_stream.read & (ne_stream.capacity - 1);
+    uint32_t first = ne_stream.capacity - start;
+    if (first > copy)
+        first = copy;
+
+    memcpy(dst, ne_stream.ring + start, first);
+    memcpy(dst + first, ne_stream.ring, copy - first);
+
+    if (copy < bytes)
+    {
+        // Play silence until NEA_StreamUpdate() catches up
+        memset(dst + copy, 0, bytes - copy);
+        if (!ne_stream.eof)
+            ne_stream.underruns++;
+    }
+
+    ne_stream.read += copy;
+
+    return length;
+}
+
+size_t NEA_StreamUpdate(void)
+{
+    if (ne_stream.file == NULL)
+        return 0;
+
+    size_t total = 0;
+
+    while (!ne_stream.eof)
+    {
+        uint32_t free_bytes = ne_stream.capacity
+                            - (ne_stream.write - ne_stream.read);
+        if (free_bytes == 0)
+            break;
+
+        if (ne_stream.remaining == 0)
+        {
+            if (!ne_stream.loop || ne_stream.data_size == 0 ||
+                !NEA_FATStreamSeek(ne_stream.file, ne_stream.data_offset))
+            {
+                ne_stream.eof = true;
+                break;
+            }
+            ne_stream.remaining = ne_stream.data_size;
+        }
+
+        // Read up to the end of the ring, the samples are copied from there
+        uint32_t start = ne_stream.write & (ne_stream.capacity - 1);
+        uint32_t len = ne_stream.capacity - start;
+        if (len > free_bytes)
+            len = free_bytes;
+        if (len > ne_stream.remaining)
+            len = ne_stream.remaining;
+
+        uint8_t *dst = ne_stream.ring + start;
+        size_t got = NEA_FATStreamRead(ne_stream.file, dst, len);
+        if (got == 0)
+        {
+            NEA_DebugPrint("Can't read stream data");
+            ne_stream.eof = true;
+            break;
+        }
+
+        if (ne_stream.unsigned_8bit)
+        {
+            for (size_t i = 0; i < got; i++)
+                dst[i] ^= 0x80;
+        }
+
+        ne_stream.remaining -= got;
+        ne_stream.write += got;
+        total += got;
+    }
+
+    return total;
+}
+
+static int ne_stream_start(mm_word sampling_rate, mm_word format,
+                           mm_word buffer_length, size_t lookahead,
+                           mm_word timer, bool loop)
+{
+    switch (format)
+    {
+        case MM_STREAM_8BIT_MONO:
+            ne_stream.sample_bytes = 1;
+            break;
+        case MM_STREAM_8BIT_STEREO:
+        case MM_STREAM_16BIT_MONO:
+            ne_stream.sample_bytes = 2;
+            break;
+        case MM_STREAM_16BIT_STEREO:
+            ne_stream.sample_bytes = 4;
+            break;
+        default:
+            NEA_DebugPrint("Invalid stream format");
+            return 0;
+    }
+
+    // Only whole samples are copied
+    ne_stream.data_size -= ne_stream.data_size % ne_stream.sample_bytes;
+
+    if (lookahead < buffer_length * 2)
+        lookahead = buffer_length * 2;
+
+    uint32_t capacity = 256;
+    while (capacity < lookahead * ne_stream.sample_bytes)
+        capacity <<= 1;
+
+    ne_stream.ring = ne_heap_malloc(NEA_HEAP_SOUND, capacity);
+    if (ne_stream.ring == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    ne_stream.capacity = capacity;
+    ne_stream.read = 0;
+    ne_stream.write = 0;
+    ne_stream.remaining = ne_stream.data_size;
+    ne_stream.underruns = 0;
+    ne_stream.loop = loop;
+    ne_stream.eof = false;
+
+    if (!NEA_FATStreamSeek(ne_stream.file, ne_stream.data_offset))
+        return 0;
+
+    // Fill the ring before Maxmod asks for the first samples
+    NEA_StreamUpdate();
+
+    mm_stream stream;
+    stream.sampling_rate = sampling_rate;
+    stream.buffer_length = buffer_length;
+    stream.callback = ne_stream_callback;
+    stream.format = format;
+    stream.timer = timer;
+    stream.manual = false;
+    mmStreamOpen(&stream);
+    ne_stream_active = true;
+
+    return 1;
+}
+
+// Finds the "fmt " and "data" chunks of a WAV file
+static int ne_stream_parse_wav(mm_word *sampling_rate, mm_word *format)
+{
+    NEA_FATStream *file = ne_stream.file;
+    uint32_t header[3];
+
+    if (NEA_FATStreamRead(file, header, sizeof(header)) != sizeof(header) ||
+        header[0] != 0x46464952 || header[2] != 0x45564157) // "RIFF", "WAVE"
+    {
+        NEA_DebugPrint("Not a WAV file");
+        return 0;
+    }
+
+    bool has_fmt = false;
+    size_t offset = sizeof(header);
+
+    while (1)
+    {
+        uint32_t chunk[2];
+        if (NEA_FATStreamRead(file, chunk, sizeof(chunk)) != sizeof(chunk))
+        {
+            NEA_DebugPrint("WAV file without data");
+            return 0;
+        }
+
+        offset += sizeof(chunk);
+
+        if (chunk[0] == 0x20746D66) // "fmt "
+        {
+            uint16_t fmt[8];
+            if (chunk[1] < sizeof(fmt) ||
+                NEA_FATStreamRead(file, fmt, sizeof(fmt)) != sizeof(fmt))
+                return 0;
+
+            // fmt[0]: Format, fmt[1]: Channels, fmt[2-3]: Sampling rate,
+            // fmt[7]: Bits per sample
+            if (fmt[0] != 1 || fmt[1] < 1 || fmt[1] > 2 ||
+                (fmt[7] != 8 && fmt[7] != 16))
+            {
+                NEA_DebugPrint("Unsupported WAV format");
+                return 0;
+            }
+
+            bool stereo = fmt[1] == 2;
+            if (fmt[7] == 8)
+                *format = stereo ? MM_STREAM_8BIT_STEREO : MM_STREAM_8BIT_MONO;
+            else
+                *format = stereo ? MM_STREAM_16BIT_STEREO : MM_STREAM_16BIT_MONO;
+
+            *sampling_rate = fmt[2] | (fmt[3] << 16);
+            ne_stream.unsigned_8bit = fmt[7] == 8;
+            has_fmt = true;
+        }
+        else if (chunk[0] == 0x61746164) // "data"
+        {
+            if (!has_fmt)
+            {
+                NEA_DebugPrint("WAV data before format");
+                return 0;
+            }
+
+            ne_stream.data_offset = offset;
+            ne_stream.data_size = chunk[1];
+            if (ne_stream.data_size > file->size - offset)
+                ne_stream.data_size = file->size - offset;
+            return 1;
+        }
+
+        // Chunks are padded to 2 bytes
+        offset += chunk[1] + (chunk[1] & 1);
+        if (!NEA_FATStreamSeek(file, offset))
+            return 0;
+    }
+}
+
+int NEA_StreamOpenFile(const char *path, mm_word buffer_length,
+                       size_t lookahead, mm_word timer, bool loop)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    NEA_StreamClose();
+
+    ne_stream.file = NEA_FATStreamOpen(path);
+    if (ne_stream.file == NULL)
+    {
+        NEA_DebugPrint("Can't open %s", path);
+        return 0;
+    }
+
+    mm_word sampling_rate, format;
+
+    if (ne_stream.file->compression != 0)
+    {
+        NEA_DebugPrint("Compressed files can't be streamed");
+    }
+    else if (ne_stream_parse_wav(&sampling_rate, &format) &&
+             ne_stream_start(sampling_rate, format, buffer_length, lookahead,
+                             timer, loop))
+    {
+        return 1;
+    }
+
+    ne_stream_close_file();
+    return 0;
+}
+
+int NEA_StreamOpenRaw(const char *path, mm_word sampling_rate, mm_word format,
+                      mm_word buffer_length, size_t lookahead, mm_word timer,
+                      bool loop)
+{
+    NEA_AssertPointer(path, "NULL path pointer");
+
+    NEA_StreamClose();
+
+    ne_stream.file = NEA_FATStreamOpen(path);
+    if (ne_stream.file == NULL)
+    {
+        NEA_DebugPrint("Can't open %s", path);
+        return 0;
+    }
+
+    if (ne_stream.file->compression != 0)
+    {
+        NEA_DebugPrint("Compressed files can't be streamed");
+        ne_stream_close_file();
+        return 0;
+    }
+
+    ne_stream.data_offset = 0;
+    ne_stream.data_size = ne_stream.file->size;
+    ne_stream.unsigned_8bit = false;
+
+    if (!ne_stream_start(sampling_rate, format, buffer_length, lookahead,
+                         timer, loop))
+    {
+        ne_stream_close_file();
+        return 0;
+    }
+
+    return 1;
+}
+
+bool NEA_StreamIsPlaying(void)
+{
+    if (ne_stream.file == NULL)
+        return false;
+
+    return !ne_stream.eof || ne_stream.write != ne_stream.read;
+}
+
+uint32_t NEA_StreamGetUnderruns(void)
+{
+    return ne_stream.underruns;
+}
+
 void NEA_StreamOpen(mm_word sampling_rate, mm_word buffer_length,
                     mm_stream_func callback, mm_word format,
                     mm_word timer)
 {
+    NEA_StreamClose();
+
     mm_stream stream;
     stream.sampling_rate = sampling_rate;
     stream.buffer_length = buffer_length;
@@ -525,11 +1463,15 @@ void NEA_StreamOpen(mm_word sampling_rate, mm_word buffer_length,
     stream.timer = timer;
     stream.manual = false;
     mmStreamOpen(&stream);
+    ne_stream_active = true;
 }
 
 void NEA_StreamClose(void)
 {
-    mmStreamClose();
+    if (ne_stream_active)
+        mmStreamClose();
+    ne_stream_active = false;
+    ne_stream_close_file();
 }
 
 mm_word NEA_StreamGetPosition(void)
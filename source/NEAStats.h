@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_STATS_H__
+#define NEA_STATS_H__
+
+#include "NEAProfile.h"
+
+// Internal counters of the hot paths of the library
+//
+// They are only built if the library is built with "make NEA_PROFILE=1". If
+// not, NE_STAT_ADD() doesn't generate any code, and the arguments aren't
+// evaluated. See NEA_StatsGet().
+
+#ifdef NEA_PROFILE
+
+// Internal use... see NEAProfile.c
+extern NEA_Stats ne_stats_current;
+
+# define NE_STAT_ADD(field, n) (ne_stats_current.field += (n))
+#else
+# define NE_STAT_ADD(field, n) do { } while (0)
+#endif
+
+#endif // NEA_STATS_H__
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#ifndef NEA_TCM_H__
+#define NEA_TCM_H__
+
+#include <nds.h>
+
+// Internal placement of hot code and data
+//
+// The ARM9 only has an 8 KB instruction cache, and the code of the physics,
+// collision and scene systems is big enough to evict itself when it runs. If
+// the library is built with "make NEA_ITCM=1" the hottest kernels are placed
+// in ITCM and their scratch buffers in DTCM, which are never cached and have
+// no wait states. Only small and hot functions should use NEA_HOT_CODE: ITCM
+// is 32 KB, and DSMA already uses part of it.
+//
+// If not, they are built as ARM code in main RAM like the other hot
+// functions of the library.
+
+#ifdef NEA_ITCM
+# define NEA_HOT_CODE ITCM_CODE ARM_CODE
+# define NEA_HOT_BSS  DTCM_BSS
+#else
+# define NEA_HOT_CODE ARM_CODE
+# define NEA_HOT_BSS
+#endif
+
+#endif // NEA_TCM_H__
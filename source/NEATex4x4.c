@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEATex4x4.c
+
+// Modes of the palette index of a block
+#define NE_TEX4X4_MODE_TRANSPARENT (1 << 14) // c0, c1, (c0 + c1) / 2, clear
+#define NE_TEX4X4_MODE_INTERPOLATE (3 << 14) // c0, c1, 5:3 and 3:5 mixes
+
+static bool ne_tex4x4_size_is_valid(int size)
+{
+    return (size >= 8) && (size <= 512) && ((size & (size - 1)) == 0);
+}
+
+int NEA_Tex4x4EncoderInit(NEA_Tex4x4Encoder *enc, const u16 *src,
+                          int sizeX, int sizeY)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+    NEA_AssertPointer(src, "NULL source pointer");
+
+    memset(enc, 0, sizeof(NEA_Tex4x4Encoder));
+
+    if (!ne_tex4x4_size_is_valid(sizeX) || !ne_tex4x4_size_is_valid(sizeY))
+    {
+        NEA_DebugPrint("Invalid size: %dx%d", sizeX, sizeY);
+        return 0;
+    }
+
+    int blocks = (sizeX / 4) * (sizeY / 4);
+
+    // Two colors per block in the worst case
+    enc->texels = malloc(blocks * sizeof(u32));
+    enc->indices = malloc(blocks * sizeof(u16));
+    enc->palette = malloc(blocks * 2 * sizeof(u16));
+    if ((enc->texels == NULL) || (enc->indices == NULL) ||
+        (enc->palette == NULL))
+    {
+        NEA_DebugPrint("Not enough memory");
+        NEA_Tex4x4EncoderEnd(enc);
+        return 0;
+    }
+
+    enc->src = src;
+    enc->sizex = sizeX;
+    enc->sizey = sizeY;
+
+    return 1;
+}
+
+static int ne_tex4x4_luma(u16 color)
+{
+    return (color & 0x1F) + ((color >> 4) & 0x3E) + ((color >> 10) & 0x1F);
+}
+
+// Encodes one block. The two colors are the darkest and the brightest pixels
+// of the block, and every pixel uses the nearest of the colors of the mode
+// along the line between them.
+static void ne_tex4x4_encode_block(NEA_Tex4x4Encoder *enc, int bx, int by)
+{
+    const u16 *src = enc->src + (by * 4) * enc->sizex + bx * 4;
+    int block = by * (enc->sizex / 4) + bx;
+
+    u16 c0 = 0, c1 = 0;
+    int min_luma = 1 << 30, max_luma = -1;
+    bool transparent = false;
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            u16 color = src[y * enc->sizex + x];
+            if ((color & BIT(15)) == 0)
+            {
+                transparent = true;
+                continue;
+            }
+
+            int luma = ne_tex4x4_luma(color);
+            if (luma < min_luma)
+            {
+                min_luma = luma;
+                c0 = color & 0x7FFF;
+            }
+            if (luma > max_luma)
+            {
+                max_luma = luma;
+                c1 = color & 0x7FFF;
+            }
+        }
+    }
+
+    int dr = (c1 & 0x1F) - (c0 & 0x1F);
+    int dg = ((c1 >> 5) & 0x1F) - ((c0 >> 5) & 0x1F);
+    int db = ((c1 >> 10) & 0x1F) - ((c0 >> 10) & 0x1F);
+    int len2 = dr * dr + dg * dg + db * db;
+
+    u32 texels = 0;
+
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            u16 color = src[y * enc->sizex + x];
+            u32 index;
+
+            if ((color & BIT(15)) == 0)
+            {
+                index = 3;
+            }
+            else if (len2 == 0)
+            {
+                index = 0;
+            }
+            else
+            {
+                // Position of the pixel along the line, times 16 * len2
+                int pr = (color & 0x1F) - (c0 & 0x1F);
+                int pg = ((color >> 5) & 0x1F) - ((c0 >> 5) & 0x1F);
+                int pb = ((color >> 10) & 0x1F) - ((c0 >> 10) & 0x1F);
+                int t = 16 * (pr * dr + pg * dg + pb * db);
+
+                if (transparent)
+                {
+                    // Colors at 0, 1/2 and 1
+                    if (t < 4 * len2)
+                        index = 0;
+                    else if (t < 12 * len2)
+                        index = 2;
+                    else
+                        index = 1;
+                }
+                else
+                {
+                    // Colors at 0, 3/8, 5/8 and 1
+                    if (t < 3 * len2)
+                        index = 0;
+                    else if (t < 8 * len2)
+                        index = 2;
+                    else if (t < 13 * len2)
+                        index = 3;
+                    else
+                        index = 1;
+                }
+            }
+
+            texels |= index << (y * 8 + x * 2);
+        }
+    }
+
+    enc->texels[block] = texels;
+
+    // Reuse the colors of the previous block if they are the same
+    int offset;
+    int n = enc->num_colors;
+    if ((n >= 2) && (enc->palette[n - 2] == c0) && (enc->palette[n - 1] == c1))
+    {
+        offset = (n - 2) / 2;
+    }
+    else
+    {
+        enc->palette[n] = c0;
+        enc->palette[n + 1] = c1;
+        enc->num_colors = n + 2;
+        offset = n / 2;
+    }
+
+    enc->indices[block] = offset | (transparent ? NE_TEX4X4_MODE_TRANSPARENT
+                                                : NE_TEX4X4_MODE_INTERPOLATE);
+}
+
+bool NEA_Tex4x4EncoderRun(NEA_Tex4x4Encoder *enc, int rows)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+    NEA_Assert(enc->src != NULL, "Encoder not initialized");
+
+    int total = enc->sizey / 4;
+
+    for (int i = 0; (i < rows) && (enc->next_row < total); i++)
+    {
+        for (int bx = 0; bx < enc->sizex / 4; bx++)
+            ne_tex4x4_encode_block(enc, bx, enc->next_row);
+
+        enc->next_row++;
+    }
+
+    return enc->next_row >= total;
+}
+
+static bool ne_tex4x4_job(void *arg)
+{
+    NEA_Tex4x4Encoder *enc = arg;
+
+    if (!NEA_Tex4x4EncoderRun(enc, NEA_TEX4X4_JOB_ROWS))
+        return false;
+
+    enc->job = false;
+    return true;
+}
+
+int NEA_Tex4x4EncoderStartJob(NEA_Tex4x4Encoder *enc, int priority)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+    NEA_Assert(enc->src != NULL, "Encoder not initialized");
+
+    if (enc->job)
+        return 1;
+
+    u32 cost = NEA_TEX4X4_JOB_COST * (enc->sizex / 64);
+    if (cost == 0)
+        cost = NEA_TEX4X4_JOB_COST;
+
+    if (NEA_JobAdd(ne_tex4x4_job, enc, priority, cost) == 0)
+        return 0;
+
+    enc->job = true;
+    return 1;
+}
+
+bool NEA_Tex4x4EncoderIsDone(const NEA_Tex4x4Encoder *enc)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+
+    return (enc->src != NULL) && (enc->next_row >= enc->sizey / 4);
+}
+
+int NEA_Tex4x4EncoderLoad(const NEA_Tex4x4Encoder *enc, NEA_Material *tex,
+                          NEA_Palette *pal, NEA_TextureFlags flags)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(pal, "NULL palette pointer");
+
+    if (!NEA_Tex4x4EncoderIsDone(enc))
+    {
+        NEA_DebugPrint("The image hasn't been encoded");
+        return 0;
+    }
+
+    if (NEA_PaletteLoad(pal, enc->palette, enc->num_colors, NEA_TEX4X4) == 0)
+        return 0;
+
+    if (NEA_MaterialTex4x4Load(tex, enc->sizex, enc->sizey, flags,
+                               enc->texels, enc->indices) == 0)
+        return 0;
+
+    NEA_MaterialSetPalette(tex, pal);
+
+    return 1;
+}
+
+void NEA_Tex4x4EncoderEnd(NEA_Tex4x4Encoder *enc)
+{
+    NEA_AssertPointer(enc, "NULL encoder pointer");
+
+    if (enc->job)
+        NEA_JobCancel(ne_tex4x4_job, enc);
+
+    free(enc->texels);
+    free(enc->indices);
+    free(enc->palette);
+
+    memset(enc, 0, sizeof(NEA_Tex4x4Encoder));
+}
+
+int NEA_MaterialTex4x4Compress(NEA_Material *tex, NEA_Palette *pal,
+                               const u16 *src, int sizeX, int sizeY,
+                               NEA_TextureFlags flags)
+{
+    NEA_Tex4x4Encoder enc;
+
+    if (NEA_Tex4x4EncoderInit(&enc, src, sizeX, sizeY) == 0)
+        return 0;
+
+    NEA_Tex4x4EncoderRun(&enc, sizeY / 4);
+
+    int ret = NEA_Tex4x4EncoderLoad(&enc, tex, pal, flags);
+
+    NEA_Tex4x4EncoderEnd(&enc);
+
+    return ret;
+}
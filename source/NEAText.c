@@ -5,6 +5,7 @@
 // This file is part of Nitro Engine Advanced
 
 #include "NEAMain.h"
+#include "NEAHeapAlloc.h"
 
 /// @file NEAText.c
 
@@ -88,6 +89,204 @@ static void _ne_charprint(const ne_textinfo_t * textinfo, int xcrd1, int ycrd1,
                          xcoord, ycoord, xcoord2, ycoord2);
 }
 
+// Compiled text
+// -------------
+//
+// The list starts with a BEGIN command. Each character takes 8 commands (a
+// texture coordinate and a vertex for each corner) packed in 2 command words,
+// and 9 parameter words.
+
+#define NE_TEXT_LIST_HEADER_WORDS 2
+#define NE_TEXT_LIST_CHAR_WORDS   11
+
+// Internal use... see NEADisplayList.c
+void ne_display_list_matrix_pop(void);
+void ne_display_list_draw_default(const void *list, bool flushed);
+
+static int ne_text_compiled_chars(const char *text)
+{
+    int chars = 0;
+
+    for (int i = 0; text[i] != '\0'; i++)
+    {
+        if (text[i] != '\n')
+            chars++;
+    }
+
+    return chars;
+}
+
+static uint32_t *ne_text_compile_char(uint32_t *p, const ne_textinfo_t *textinfo,
+                                      int x1, int y1, char character)
+{
+    int tx1 = (character & 31) * textinfo->sizex;
+    int tx2 = tx1 + textinfo->sizex;
+    int ty1 = (character >> 5) * textinfo->sizey;
+    int ty2 = ty1 + textinfo->sizey;
+
+    int x2 = x1 + textinfo->sizex;
+    int y2 = y1 + textinfo->sizey;
+
+    // Same quad as _ne_texturecuadprint(), but the priority is applied when
+    // the list is drawn.
+    *p++ = FIFO_COMMAND_PACK(FIFO_TEX_COORD, FIFO_VERTEX16,
+                             FIFO_TEX_COORD, FIFO_VERTEX_XY);
+    *p++ = TEXTURE_PACK(inttot16(tx1), inttot16(ty1));
+    *p++ = (y1 << 16) | (x1 & 0xFFFF);
+    *p++ = 0;
+    *p++ = TEXTURE_PACK(inttot16(tx1), inttot16(ty2));
+    *p++ = (y2 << 16) | (x1 & 0xFFFF);
+
+    *p++ = FIFO_COMMAND_PACK(FIFO_TEX_COORD, FIFO_VERTEX_XY,
+                             FIFO_TEX_COORD, FIFO_VERTEX_XY);
+    *p++ = TEXTURE_PACK(inttot16(tx2), inttot16(ty2));
+    *p++ = (y2 << 16) | (x2 & 0xFFFF);
+    *p++ = TEXTURE_PACK(inttot16(tx2), inttot16(ty1));
+    *p++ = (y1 << 16) | (x2 & 0xFFFF);
+
+    return p;
+}
+
+static void ne_text_compile_list(NEA_TextCompiled *compiled, const char *text)
+{
+    const ne_textinfo_t *textinfo = &NEA_TextInfo[compiled->slot];
+
+    uint32_t *p = &compiled->list[1];
+
+    *p++ = FIFO_COMMAND_PACK(FIFO_BEGIN, FIFO_NOP, FIFO_NOP, FIFO_NOP);
+    *p++ = GL_QUADS;
+
+    int count = 0;
+    int x_ = 0, y_ = 0;
+
+    for (int i = 0; text[i] != '\0'; i++)
+    {
+        if (text[i] == '\n')
+        {
+            y_ += textinfo->sizey;
+            x_ = 0;
+            continue;
+        }
+
+        p = ne_text_compile_char(p, textinfo, x_, y_, text[i]);
+
+        count++;
+        x_ += textinfo->sizex;
+    }
+
+    compiled->count = count;
+    compiled->list[0] = p - &compiled->list[1];
+}
+
+static int ne_text_compiled_alloc(NEA_TextCompiled *compiled, int chars)
+{
+    size_t words = 1 + NE_TEXT_LIST_HEADER_WORDS
+                 + NE_TEXT_LIST_CHAR_WORDS * chars;
+
+    uint32_t *list = ne_heap_realloc(NEA_HEAP_TEXT,
+                                     compiled->list, words * sizeof(uint32_t));
+    if (list == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return 0;
+    }
+
+    compiled->list = list;
+    compiled->capacity = chars;
+
+    return 1;
+}
+
+NEA_TextCompiled *NEA_TextCompile(int slot, const char *text)
+{
+    NEA_AssertMinMax(0, slot, NEA_MAX_TEXT_FONTS, "Invalid slot %d", slot);
+    NEA_AssertPointer(text, "NULL pointer");
+
+    if (NEA_TextInfo[slot].material == NULL)
+    {
+        NEA_DebugPrint("Slot %d doesn't have a font", slot);
+        return NULL;
+    }
+
+    NEA_TextCompiled *compiled = ne_heap_calloc(NEA_HEAP_TEXT,
+                                                1, sizeof(NEA_TextCompiled));
+    if (compiled == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
+    }
+
+    compiled->slot = slot;
+
+    if (ne_text_compiled_alloc(compiled, ne_text_compiled_chars(text)) == 0)
+    {
+        ne_heap_free(NEA_HEAP_TEXT, compiled);
+        return NULL;
+    }
+
+    ne_text_compile_list(compiled, text);
+
+    return compiled;
+}
+
+int NEA_TextRecompile(NEA_TextCompiled *compiled, const char *text)
+{
+    NEA_AssertPointer(compiled, "NULL compiled text pointer");
+    NEA_AssertPointer(text, "NULL text pointer");
+
+    if (NEA_TextInfo[compiled->slot].material == NULL)
+    {
+        NEA_DebugPrint("Slot %d doesn't have a font", compiled->slot);
+        return 0;
+    }
+
+    // The list may still be in the queue of the asynchronous backend
+    NEA_DisplayListWait();
+
+    int chars = ne_text_compiled_chars(text);
+    if (chars > compiled->capacity)
+    {
+        if (ne_text_compiled_alloc(compiled, chars) == 0)
+            return 0;
+    }
+
+    ne_text_compile_list(compiled, text);
+
+    return 1;
+}
+
+void NEA_TextCompiledDraw(const NEA_TextCompiled *compiled, int x, int y,
+                          u32 color)
+{
+    NEA_AssertPointer(compiled, "NULL pointer");
+
+    const ne_textinfo_t *textinfo = &NEA_TextInfo[compiled->slot];
+
+    if ((textinfo->material == NULL) || (compiled->count == 0))
+        return;
+
+    NEA_MaterialUse(textinfo->material);
+    GFX_COLOR = color;
+
+    MATRIX_PUSH = 0;
+
+    NEA_ViewMoveI(x, y, NEA_TEXT_PRIORITY);
+
+    ne_display_list_draw_default(compiled->list, false);
+
+    ne_display_list_matrix_pop();
+}
+
+void NEA_TextCompiledDelete(NEA_TextCompiled *compiled)
+{
+    NEA_AssertPointer(compiled, "NULL pointer");
+
+    NEA_DisplayListWait();
+
+    ne_heap_free(NEA_HEAP_TEXT, compiled->list);
+    ne_heap_free(NEA_HEAP_TEXT, compiled);
+}
+
 int NEA_TextPrint(int slot, int x, int y, u32 color, const char *text)
 {
     NEA_AssertMinMax(0, slot, NEA_MAX_TEXT_FONTS, "Invalid slot %d", slot);
@@ -6,6 +6,8 @@
 
 #include "NEAMain.h"
 #include "NEAAlloc.h"
+#include "NEAPool.h"
+#include "NEAStats.h"
 
 /// @file NEATexture.c
 
@@ -17,21 +19,205 @@ typedef struct {
     char *address;
     int uses; // Number of materials that use this texture
     int sizex, sizey;
+    // Streamed textures keep a copy of their data outside of VRAM, and they are
+    // only uploaded to VRAM after they are used.
+    const void *stream_data; // Copy in RAM, or NULL
+    char *stream_path;       // Path to the file with the data, or NULL
+    u32 stream_last_use;     // Value of ne_texture_stream_stamp when last used
+    NEA_TextureFormat stream_fmt;
+    NEA_TextureFlags stream_flags;
+    bool stream_pending;     // The texture has been used while not in VRAM
+    bool upload_pending;     // The data is still in the upload queue
 } ne_textureinfo_t;
 
+// Internal use... see NEAMemReport.c
+void ne_mem_report_failure(NEA_MemPool pool, size_t size);
+
+// Internal use... see NEAFAT.c
+int ne_fat_stream_read_vram(NEA_FATStream *stream, void *dst, size_t size,
+                            u32 or_mask, bool unlock);
+
+#ifdef NEA_BLOCKSDS
+// Internal use... see NEAFAT.c
+GRFError ne_fat_grf_load_path(const char *path, GRFHeader *header,
+                              void **gfx, void **pal, size_t *pal_size);
+#endif
+
+// Streamed textures fail to be uploaded often while they evict other textures,
+// so they only report the final failure.
+static bool ne_texture_report_failures = true;
+
+// Internal use... see NEAUpload.c
+int ne_upload_add(bool palette, void *dst, const void *src, size_t size,
+                  bool set_alpha, bool *pending,
+                  NEA_UploadCallback callback, void *arg);
+void ne_upload_cancel(const void *dst);
+void ne_upload_cancel_all(bool palette);
+
+// Internal use... see NEAPalette.c
+bool ne_palette_is_ready(const NEA_Palette *pal);
+
 static ne_textureinfo_t *NEA_Texture = NULL;
-static NEA_Material **NEA_UserMaterials = NULL;
+static ne_pool_t ne_material_pool;
 
 static NEAChunk *NEA_TexAllocList; // See NEAAlloc.h
 
 static bool ne_texture_system_inited = false;
+static NEA_VRAMBankFlags ne_texture_banks; // Banks used for textures
+
+// True if a texture has been deleted since the last time that the texture
+// memory was defragmented.
+static bool ne_texture_defrag_pending = false;
+
+static u32 ne_texture_stream_stamp;     // Incremented every frame
+static size_t ne_texture_stream_budget; // Max size of streamed textures in VRAM
+static size_t ne_texture_stream_size;   // Size of streamed textures in VRAM
 
 static int NEA_MAX_TEXTURES;
 
+// Hash table of material names, with one chain of materials per bucket. It is
+// built again by NEA_MaterialFindByName() after materials are created,
+// deleted, cloned or renamed.
+#define NE_MATERIAL_NAME_BUCKETS 64
+
+typedef struct {
+    u32 hash;  // Hash of the name of the material
+    int next;  // Next material in the same bucket, or -1
+} ne_material_name_t;
+
+static int ne_material_buckets[NE_MATERIAL_NAME_BUCKETS];
+static ne_material_name_t *ne_material_names;
+
+#ifdef NEA_STATIC_POOLS
+NE_POOL_STATIC_DEFINE(ne_material_static, NEA_Material,
+                      NEA_STATIC_MAX_MATERIALS);
+static ne_textureinfo_t ne_texture_static[NEA_STATIC_MAX_MATERIALS];
+static ne_material_name_t ne_material_names_static[NEA_STATIC_MAX_MATERIALS];
+#endif
+static bool ne_material_names_dirty;
+
+// Internal use... see NEAPack.c
+u32 ne_pack_hash(const char *path);
+
 // Default material properties
 static u32 ne_default_diffuse_ambient;
 static u32 ne_default_specular_emission;
 
+// Shadow of the material registers of the GPU, and of other GX state that is
+// set by the draw functions of the engine. Registers are only written if their
+// shadow isn't valid or if the new value is different.
+typedef enum {
+    NE_STATE_TEX_FORMAT,
+    NE_STATE_PAL_FORMAT,
+    NE_STATE_DIFFUSE_AMBIENT,
+    NE_STATE_SPECULAR_EMISSION,
+    NE_STATE_POLY_FORMAT,
+    NE_STATE_MATRIX_MODE,
+    NE_STATE_NUM
+} ne_material_state_reg;
+
+static u32 ne_material_state[NE_STATE_NUM];
+static u32 ne_material_state_valid; // Bitmask of valid shadows
+static uint32_t ne_material_avoided_writes;
+
+// Incremented every time that the texture matrix may have been modified
+static uint32_t ne_texture_matrix_stamp;
+// Value of the stamp when the texture matrix was last set to identity
+static uint32_t ne_texture_identity_stamp = UINT32_MAX;
+
+// Incremented every time that the projection matrix may have been modified
+static uint32_t ne_projection_stamp;
+
+static inline void ne_material_state_write(ne_material_state_reg reg,
+                                           vu32 *hwreg, u32 value)
+{
+    if ((ne_material_state_valid & BIT(reg)) && (ne_material_state[reg] == value))
+    {
+        ne_material_avoided_writes++;
+        return;
+    }
+
+    NEA_DisplayListWait();
+
+    *hwreg = value;
+    ne_material_state[reg] = value;
+    ne_material_state_valid |= BIT(reg);
+}
+
+// Internal use: functions used by other modules to write the registers through
+// the shadow, so that it stays up to date.
+
+void ne_material_state_tex_format(u32 value)
+{
+    ne_material_state_write(NE_STATE_TEX_FORMAT, &GFX_TEX_FORMAT, value);
+}
+
+void ne_material_state_pal_format(u32 value)
+{
+    ne_material_state_write(NE_STATE_PAL_FORMAT, &GFX_PAL_FORMAT, value);
+}
+
+void ne_material_state_diffuse_ambient(u32 value)
+{
+    ne_material_state_write(NE_STATE_DIFFUSE_AMBIENT, &GFX_DIFFUSE_AMBIENT,
+                            value);
+}
+
+void ne_material_state_specular_emission(u32 value)
+{
+    ne_material_state_write(NE_STATE_SPECULAR_EMISSION, &GFX_SPECULAR_EMISSION,
+                            value);
+}
+
+void ne_material_state_poly_format(u32 value)
+{
+    ne_material_state_write(NE_STATE_POLY_FORMAT, &GFX_POLY_FORMAT, value);
+}
+
+// Used after code outside of the engine writes the polygon format
+void ne_material_state_forget_poly_format(void)
+{
+    ne_material_state_valid &= ~BIT(NE_STATE_POLY_FORMAT);
+}
+
+// The engine only selects the projection matrix to modify it
+void ne_material_state_matrix_mode(u32 mode)
+{
+    if (mode == GL_PROJECTION)
+        ne_projection_stamp++;
+
+    ne_material_state_write(NE_STATE_MATRIX_MODE, &MATRIX_CONTROL, mode);
+}
+
+// Internal use... see NEAAnimMat.c
+uint32_t ne_texture_matrix_get_stamp(void)
+{
+    return ne_texture_matrix_stamp;
+}
+
+// Internal use... see NEA2D.c
+uint32_t ne_projection_get_stamp(void)
+{
+    return ne_projection_stamp;
+}
+
+void NEA_MaterialStateInvalidate(void)
+{
+    ne_material_state_valid = 0;
+    ne_texture_matrix_stamp++;
+    ne_projection_stamp++;
+}
+
+uint32_t NEA_MaterialStateGetAvoidedWrites(void)
+{
+    return ne_material_avoided_writes;
+}
+
+void NEA_MaterialStateResetAvoidedWrites(void)
+{
+    ne_material_avoided_writes = 0;
+}
+
 static int ne_is_valid_tex_size(int size)
 {
     for (int i = 0; i < 8; i++)
@@ -81,19 +267,99 @@ static inline void *slot1_to_slot2(void *ptr)
     return (void *)((uintptr_t)VRAM_C + (offset1 * 2));
 }
 
-static inline void ne_set_material_tex_param(NEA_Material *tex,
+static inline void ne_set_texture_param(int slot,
                             int sizeX, int sizeY, uint32_t *addr,
                             GL_TEXTURE_TYPE_ENUM mode, u32 param)
 {
-    NEA_AssertPointer(tex, "NULL pointer");
-    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No assigned texture");
-    NEA_Texture[tex->texindex].param =
+    NEA_Texture[slot].param =
             (ne_tex_raw_size(sizeX) << 20) |
             (ne_tex_raw_size(sizeY) << 23) |
             (((uint32_t)addr >> 3) & 0xFFFF) |
             (mode << 26) | param;
 }
 
+static inline bool ne_texture_is_streamed(int slot)
+{
+    return (NEA_Texture[slot].stream_data != NULL) ||
+           (NEA_Texture[slot].stream_path != NULL);
+}
+
+// Returns the size that a texture uses in VRAM, adding both parts of
+// compressed textures.
+static size_t ne_texture_data_size(NEA_TextureFormat fmt, int sizeX, int sizeY)
+{
+    const int size_shift[] = {
+        0, // Nothing
+        1, // NEA_A3PAL32
+        3, // NEA_PAL4
+        2, // NEA_PAL16
+        1, // NEA_PAL256
+        0, // NEA_TEX4X4 (This value isn't used)
+        1, // NEA_A5PAL8
+        0, // NEA_A1RGB5
+        0, // NEA_RGB5
+    };
+
+    if (fmt == NEA_TEX4X4)
+    {
+        size_t size02 = (sizeX * sizeY) >> 2;
+        return size02 + (size02 >> 1);
+    }
+
+    return (sizeX * sizeY << 1) >> size_shift[fmt];
+}
+
+static void ne_texture_gui_invalidate(void)
+{
+    // The GUI keeps a copy of the texture format of its materials
+    extern void NEA_GUIInvalidate(void) __attribute__((weak));
+    if (NEA_GUIInvalidate)
+        NEA_GUIInvalidate();
+}
+
+// Frees the VRAM used by a texture, but it keeps the texture slot.
+static void ne_texture_free_vram(int slot)
+{
+    if (NEA_Texture[slot].address == NULL)
+        return;
+
+    uint32_t fmt = (NEA_Texture[slot].param >> 26) & 7;
+
+    if (fmt == NEA_TEX4X4)
+    {
+        // Check if the texture is allocated in VRAM_A or VRAM_C, and
+        // calculate the corresponding address in VRAM_B.
+        void *slot02 = NEA_Texture[slot].address;
+        void *slot1 = (slot02 < (void *)VRAM_B) ?
+                      slot0_to_slot1(slot02) : slot2_to_slot1(slot02);
+        if (NEA_Texture[slot].upload_pending)
+        {
+            ne_upload_cancel(slot02);
+            ne_upload_cancel(slot1);
+        }
+        NEA_Free(NEA_TexAllocList, slot02);
+        NEA_Free(NEA_TexAllocList, slot1);
+    }
+    else
+    {
+        if (NEA_Texture[slot].upload_pending)
+            ne_upload_cancel(NEA_Texture[slot].address);
+        NEA_Free(NEA_TexAllocList, NEA_Texture[slot].address);
+    }
+
+    if (ne_texture_is_streamed(slot))
+    {
+        ne_texture_stream_size -=
+                ne_texture_data_size(NEA_Texture[slot].stream_fmt,
+                                     NEA_Texture[slot].sizex,
+                                     NEA_Texture[slot].sizey);
+    }
+
+    NEA_Texture[slot].address = NULL;
+
+    ne_texture_defrag_pending = true;
+}
+
 static void ne_texture_delete(int texture_index)
 {
     int slot = texture_index;
@@ -104,24 +370,13 @@ static void ne_texture_delete(int texture_index)
     // If the number of users is zero, delete it.
     if (NEA_Texture[slot].uses == 0)
     {
-        uint32_t fmt = (NEA_Texture[slot].param >> 26) & 7;
+        ne_texture_free_vram(slot);
 
-        if (fmt == NEA_TEX4X4)
-        {
-            // Check if the texture is allocated in VRAM_A or VRAM_C, and
-            // calculate the corresponding address in VRAM_B.
-            void *slot02 = NEA_Texture[slot].address;
-            void *slot1 = (slot02 < (void *)VRAM_B) ?
-                          slot0_to_slot1(slot02) : slot2_to_slot1(slot02);
-            NEA_Free(NEA_TexAllocList, slot02);
-            NEA_Free(NEA_TexAllocList, slot1);
-        }
-        else
-        {
-            NEA_Free(NEA_TexAllocList, NEA_Texture[slot].address);
-        }
+        free(NEA_Texture[slot].stream_path);
+        NEA_Texture[slot].stream_path = NULL;
+        NEA_Texture[slot].stream_data = NULL;
+        NEA_Texture[slot].stream_pending = false;
 
-        NEA_Texture[slot].address = NULL;
         NEA_Texture[slot].param = 0;
     }
 }
@@ -136,32 +391,30 @@ NEA_Material *NEA_MaterialCreate(void)
         return NULL;
     }
 
-    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    if (ne_pool_next_slot(&ne_material_pool) < 0)
     {
-        if (NEA_UserMaterials[i] != NULL)
-            continue;
-
-        NEA_Material *mat = calloc(1, sizeof(NEA_Material));
-        if (mat == NULL)
-        {
-            NEA_DebugPrint("Not enough memory");
-            return NULL;
-        }
-
-        NEA_UserMaterials[i] = mat;
-        mat->texindex = NEA_NO_TEXTURE;
-        mat->palette = NULL;
-        mat->palette_autodelete = false;
-        mat->color = NEA_White;
-        mat->diffuse_ambient = ne_default_diffuse_ambient;
-        mat->specular_emission = ne_default_specular_emission;
+        NEA_DebugPrint("No free slots");
+        return NULL;
+    }
 
-        return mat;
+    NEA_Material *mat = ne_pool_object_alloc(&ne_material_pool,
+                                             sizeof(NEA_Material));
+    if (mat == NULL)
+    {
+        NEA_DebugPrint("Not enough memory");
+        return NULL;
     }
 
-    NEA_DebugPrint("No free slots");
+    ne_pool_add(&ne_material_pool, mat);
+    ne_material_names_dirty = true;
+    mat->texindex = NEA_NO_TEXTURE;
+    mat->palette = NULL;
+    mat->palette_autodelete = false;
+    mat->color = NEA_White;
+    mat->diffuse_ambient = ne_default_diffuse_ambient;
+    mat->specular_emission = ne_default_specular_emission;
 
-    return NULL;
+    return mat;
 }
 
 void NEA_MaterialSetName(NEA_Material *mat, const char *name)
@@ -170,6 +423,7 @@ void NEA_MaterialSetName(NEA_Material *mat, const char *name)
     NEA_AssertPointer(name, "NULL name pointer");
     strncpy(mat->name, name, NEA_MATERIAL_NAME_LEN - 1);
     mat->name[NEA_MATERIAL_NAME_LEN - 1] = '\0';
+    ne_material_names_dirty = true;
 }
 
 const char *NEA_MaterialGetName(const NEA_Material *mat)
@@ -178,6 +432,30 @@ const char *NEA_MaterialGetName(const NEA_Material *mat)
     return mat->name;
 }
 
+static void ne_material_names_build(void)
+{
+    for (int i = 0; i < NE_MATERIAL_NAME_BUCKETS; i++)
+        ne_material_buckets[i] = -1;
+
+    // Add the materials backwards so that each chain is sorted by index, and
+    // the first material with a name is found first.
+    for (int i = NEA_MAX_TEXTURES - 1; i >= 0; i--)
+    {
+        const NEA_Material *mat = ne_pool_at(&ne_material_pool, i);
+        if (mat == NULL)
+            continue;
+
+        u32 hash = ne_pack_hash(mat->name);
+        int bucket = hash % NE_MATERIAL_NAME_BUCKETS;
+
+        ne_material_names[i].hash = hash;
+        ne_material_names[i].next = ne_material_buckets[bucket];
+        ne_material_buckets[bucket] = i;
+    }
+
+    ne_material_names_dirty = false;
+}
+
 NEA_Material *NEA_MaterialFindByName(const char *name)
 {
     NEA_AssertPointer(name, "NULL name pointer");
@@ -185,12 +463,20 @@ NEA_Material *NEA_MaterialFindByName(const char *name)
     if (!ne_texture_system_inited)
         return NULL;
 
-    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    if (ne_material_names_dirty)
+        ne_material_names_build();
+
+    u32 hash = ne_pack_hash(name);
+    int i = ne_material_buckets[hash % NE_MATERIAL_NAME_BUCKETS];
+
+    while (i >= 0)
     {
-        if (NEA_UserMaterials[i] == NULL)
-            continue;
-        if (strcmp(NEA_UserMaterials[i]->name, name) == 0)
-            return NEA_UserMaterials[i];
+        NEA_Material *mat = ne_pool_at(&ne_material_pool, i);
+        if ((ne_material_names[i].hash == hash) &&
+            (strcmp(mat->name, name) == 0))
+            return mat;
+
+        i = ne_material_names[i].next;
     }
 
     return NULL;
@@ -208,27 +494,33 @@ void NEA_MaterialColorDelete(NEA_Material *tex)
     tex->color = NEA_White;
 }
 
-int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
-                          NEA_TextureFlags flags, const char *path)
+#ifdef NEA_BLOCKSDS
+static void ne_texture_free_callback(void *arg)
 {
-#ifndef NEA_BLOCKSDS
-    (void)tex;
-    (void)pal;
-    (void)flags;
-    (void)path;
-    NEA_DebugPrint("%s only supported in BlocksDS", __func__);
-    return 0;
-#else // NEA_BLOCKSDS
-    NEA_AssertPointer(tex, "NULL material pointer");
-    NEA_AssertPointer(path, "NULL path pointer");
+    free(arg);
+}
 
+// Loads a GRF file from the filesystem if data is NULL, or from RAM if not. In
+// async mode the decoded buffers are freed when their uploads finish.
+static int ne_material_tex_load_grf(NEA_Material *tex, NEA_Palette *pal,
+                                    NEA_TextureFlags flags, const char *path,
+                                    const void *data, bool async)
+{
     int ret = 0;
 
     void *gfxDst = NULL;
     void *palDst = NULL;
     GRFHeader header = { 0 };
-    GRFError err = grfLoadPath(path, &header, &gfxDst, NULL, NULL, NULL,
-                               &palDst, NULL);
+    GRFError err;
+    if (data == NULL)
+    {
+        err = ne_fat_grf_load_path(path, &header, &gfxDst, &palDst, NULL);
+    }
+    else
+    {
+        err = grfLoadMem(data, &header, &gfxDst, NULL, NULL, NULL, &palDst,
+                         NULL);
+    }
     if (err != GRF_NO_ERROR)
     {
         NEA_DebugPrint("Couldn't load GRF file: %d", err);
@@ -273,8 +565,21 @@ int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
             goto cleanup;
     }
 
-    if (NEA_MaterialTexLoad(tex, fmt, header.gfxWidth, header.gfxHeight,
-                           flags, gfxDst) == 0)
+    if (async)
+    {
+        if (NEA_MaterialTexLoadAsync(tex, fmt, header.gfxWidth,
+                                     header.gfxHeight, flags, gfxDst,
+                                     ne_texture_free_callback, gfxDst) == 0)
+        {
+            NEA_DebugPrint("Failed to load GRF texture");
+            goto cleanup;
+        }
+
+        // It will be freed when the upload finishes
+        gfxDst = NULL;
+    }
+    else if (NEA_MaterialTexLoad(tex, fmt, header.gfxWidth, header.gfxHeight,
+                                flags, gfxDst) == 0)
     {
         NEA_DebugPrint("Failed to load GRF texture");
         goto cleanup;
@@ -310,7 +615,18 @@ int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
         }
     }
 
-    if (NEA_PaletteLoadSize(pal, palDst, header.palAttr * 2, fmt) == 0)
+    int pal_ok;
+    if (async)
+    {
+        pal_ok = NEA_PaletteLoadAsync(pal, palDst, header.palAttr, fmt,
+                                      ne_texture_free_callback, palDst);
+    }
+    else
+    {
+        pal_ok = NEA_PaletteLoadSize(pal, palDst, header.palAttr * 2, fmt);
+    }
+
+    if (pal_ok == 0)
     {
         NEA_DebugPrint("Failed to load GRF palette");
         if (create_palette)
@@ -318,6 +634,10 @@ int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
         goto cleanup;
     }
 
+    // It will be freed when the upload finishes
+    if (async)
+        palDst = NULL;
+
     NEA_MaterialSetPalette(tex, pal);
 
     if (create_palette)
@@ -329,61 +649,160 @@ cleanup:
     free(gfxDst);
     free(palDst);
     return ret;
-#endif // NEA_BLOCKSDS
 }
+#endif // NEA_BLOCKSDS
 
-int NEA_MaterialTexLoadFAT(NEA_Material *tex, NEA_TextureFormat fmt,
-                          int sizeX, int sizeY, NEA_TextureFlags flags,
-                          const char *path)
+int NEA_MaterialTexLoadGRF(NEA_Material *tex, NEA_Palette *pal,
+                          NEA_TextureFlags flags, const char *path)
 {
+#ifndef NEA_BLOCKSDS
+    (void)tex;
+    (void)pal;
+    (void)flags;
+    (void)path;
+    NEA_DebugPrint("%s only supported in BlocksDS", __func__);
+    return 0;
+#else // NEA_BLOCKSDS
     NEA_AssertPointer(tex, "NULL material pointer");
     NEA_AssertPointer(path, "NULL path pointer");
-    NEA_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
 
-    void *ptr = NEA_FATLoadData(path);
-    if (ptr == NULL)
+    return ne_material_tex_load_grf(tex, pal, flags, path, NULL, false);
+#endif // NEA_BLOCKSDS
+}
+
+int NEA_MaterialTexLoadGRFAsync(NEA_Material *tex, NEA_Palette *pal,
+                               NEA_TextureFlags flags, const void *data)
+{
+#ifndef NEA_BLOCKSDS
+    (void)tex;
+    (void)pal;
+    (void)flags;
+    (void)data;
+    NEA_DebugPrint("%s only supported in BlocksDS", __func__);
+    return 0;
+#else // NEA_BLOCKSDS
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(data, "NULL data pointer");
+
+    return ne_material_tex_load_grf(tex, pal, flags, NULL, data, true);
+#endif // NEA_BLOCKSDS
+}
+
+// Result of the last allocation of a compressed texture
+static NEA_Tex4x4AllocResult ne_tex4x4_alloc_result = NEA_TEX4X4_ALLOC_OK;
+
+// Gets the next free range of the allocator that overlaps [lo, hi), clipped to
+// that range. "it" is the chunk where the search starts, and it is updated to
+// the chunk after the one returned. Returns false if there are no more ranges.
+static bool ne_tex4x4_next_free(NEAChunk **it, uintptr_t lo, uintptr_t hi,
+                                uintptr_t *start, uintptr_t *end)
+{
+    for (NEAChunk *this = *it; this != NULL; this = this->next)
     {
-        NEA_DebugPrint("Couldn't load file from FAT");
-        return 0;
-    }
+        uintptr_t s = (uintptr_t)this->start;
+        uintptr_t e = (uintptr_t)this->end;
+
+        if (s >= hi)
+            break;
 
-    int ret = NEA_MaterialTexLoad(tex, fmt, sizeX, sizeY, flags, ptr);
-    free(ptr);
+        if ((this->state != NEA_STATE_FREE) || (e <= lo))
+            continue;
 
-    return ret;
+        *start = (s < lo) ? lo : s;
+        *end = (e > hi) ? hi : e;
+        *it = this->next;
+        return true;
+    }
+
+    *it = NULL;
+    return false;
 }
 
-int NEA_MaterialTex4x4LoadFAT(NEA_Material *tex, int sizeX, int sizeY,
-                             NEA_TextureFlags flags, const char *path02,
-                             const char *path1)
+// Returns the size of the biggest free range of the allocator inside [lo, hi)
+static size_t ne_tex4x4_largest_free(uintptr_t lo, uintptr_t hi)
 {
-    NEA_AssertPointer(tex, "NULL material pointer");
-    NEA_AssertPointer(path02, "NULL path02 pointer");
-    NEA_AssertPointer(path1, "NULL path1 pointer");
-    NEA_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
+    NEAChunk *it = NEA_TexAllocList;
+    uintptr_t s, e;
+    size_t largest = 0;
 
-    void *texture02 = NEA_FATLoadData(path02);
-    if (texture02 == NULL)
+    while (ne_tex4x4_next_free(&it, lo, hi, &s, &e))
     {
-        NEA_DebugPrint("Couldn't load file from FAT");
-        return 0;
+        if (e - s > largest)
+            largest = e - s;
     }
 
-    void *texture1 = NEA_FATLoadData(path1);
-    if (texture1 == NULL)
+    return largest;
+}
+
+// Looks for a free range of "size02" bytes in [base02, end02) whose matching
+// range in slot 1 (starting at base1) is also free. The free ranges of slot 1
+// are converted to slot 0/2 addresses (each byte of slot 1 corresponds to two
+// bytes of slot 0/2), so that both lists can be walked together and only the
+// ranges that are free in both of them are checked.
+//
+// Of all the ranges that fit, it keeps the smallest one, so that big free
+// ranges are left for big textures. "best_span" is the size of the best range
+// found so far (SIZE_MAX if none), and it's updated if a better one is found.
+static void ne_tex4x4_find_pair(uintptr_t base02, uintptr_t end02,
+                                uintptr_t base1, size_t size02,
+                                size_t size1, uintptr_t *best,
+                                size_t *best_span)
+{
+    uintptr_t end1 = base1 + ((end02 - base02) / 2);
+
+    // Space needed in slot 0/2 coordinates. The part in slot 1 is rounded up
+    // by the allocator, so it may cover more than the part in slot 0/2.
+    size_t size1_alloc = (size1 + NEA_ALLOC_MIN_SIZE - 1)
+                       & ~(size_t)(NEA_ALLOC_MIN_SIZE - 1);
+    size_t need = (size02 > size1_alloc * 2) ? size02 : size1_alloc * 2;
+
+    NEAChunk *it02 = NEA_TexAllocList;
+    NEAChunk *it1 = NEA_TexAllocList;
+    uintptr_t s02, e02, s1, e1;
+
+    if (!ne_tex4x4_next_free(&it02, base02, end02, &s02, &e02))
+        return;
+    if (!ne_tex4x4_next_free(&it1, base1, end1, &s1, &e1))
+        return;
+
+    while (1)
     {
-        NEA_DebugPrint("Couldn't load file from FAT");
-        free(texture02);
-        return 0;
-    }
+        // Range of slot 1 in slot 0/2 coordinates
+        uintptr_t m1_start = base02 + (s1 - base1) * 2;
+        uintptr_t m1_end = base02 + (e1 - base1) * 2;
 
-    int ret = NEA_MaterialTex4x4Load(tex, sizeX, sizeY, flags, texture02,
-                                    texture1);
+        uintptr_t lo = (s02 > m1_start) ? s02 : m1_start;
+        uintptr_t hi = (e02 < m1_end) ? e02 : m1_end;
 
-    free(texture02);
-    free(texture1);
+        // Texture addresses need to be aligned to 8 bytes in slot 1 too
+        lo = (lo + 15) & ~(uintptr_t)15;
 
-    return ret;
+        if (lo < hi)
+        {
+            size_t span = hi - lo;
+            if ((span >= need) && (span < *best_span))
+            {
+                *best = lo;
+                *best_span = span;
+
+                // It can't get any better than this
+                if (span == need)
+                    return;
+            }
+        }
+
+        // Advance the range that ends first
+        if (e02 <= m1_end)
+        {
+            if (!ne_tex4x4_next_free(&it02, base02, end02, &s02, &e02))
+                return;
+        }
+        else
+        {
+            if (!ne_tex4x4_next_free(&it1, base1, end1, &s1, &e1))
+                return;
+        }
+    }
 }
 
 // This function takes as argument the size of the chunk of the compressed
@@ -391,123 +810,104 @@ int NEA_MaterialTex4x4LoadFAT(NEA_Material *tex, int sizeX, int sizeY,
 // always half of this size, so it isn't needed to provide it.
 //
 // It returns 0 on success, as well as pointers to the address where both chunks
-// need to be copied.
+// need to be copied. On error, it returns -1 and the reason is saved so that
+// NEA_TextureGetTex4x4AllocResult() can return it.
 static int ne_alloc_compressed_tex(size_t size, void **slot02, void **slot1)
 {
     size_t size02 = size;
     size_t size1 = size / 2;
 
-    // First, try with slot 0 + slot 1
-    // -------------------------------
+    uintptr_t vram_a = (uintptr_t)VRAM_A;
+    uintptr_t vram_b = (uintptr_t)VRAM_B;
+    uintptr_t vram_b_half = vram_b + (64 * 1024);
+    uintptr_t vram_c = (uintptr_t)VRAM_C;
+    uintptr_t vram_d = (uintptr_t)VRAM_D;
 
-    // Get the first valid range in slot 0
-    void *addr0 = NEA_AllocFindInRange(NEA_TexAllocList, VRAM_A, VRAM_B, size02);
-    if (addr0 != NULL)
-    {
-        // Only use the first half of slot 1 for slot 0
-        void *addr1;
-        void *addr1_end = (void *)((uintptr_t)VRAM_B + (64 * 1024));
+    uintptr_t best = 0;
+    size_t best_span = SIZE_MAX;
 
-        while (1)
-        {
-            // Get the address in bank 1 assigned to the current bank 0 address
-            addr1 = slot0_to_slot1(addr0);
-
-            // Check if this address is free and has enough space
-            addr1 = NEA_AllocFindInRange(NEA_TexAllocList, addr1, addr1_end, size1);
-            if (addr1 == NULL)
-                break;
-
-            // If both addresses match, both of them are free
-            if (addr1 == slot0_to_slot1(addr0))
-            {
-                *slot02 = addr0;
-                *slot1 = addr1;
-                return 0;
-            }
+    // Slot 0 uses the first half of slot 1, and slot 2 uses the second half.
+    // Check both of them and keep the range that fits best.
+    ne_tex4x4_find_pair(vram_a, vram_b, vram_b, size02, size1,
+                        &best, &best_span);
+    if (best_span != size02)
+    {
+        ne_tex4x4_find_pair(vram_c, vram_d, vram_b_half, size02, size1,
+                            &best, &best_span);
+    }
 
-            // Get the address in bank 0 assigned to the current bank 1 address
-            addr0 = slot1_to_slot0(addr1);
+    if (best_span != SIZE_MAX)
+    {
+        *slot02 = (void *)best;
+        *slot1 = (best < vram_b) ? slot0_to_slot1(*slot02)
+                                 : slot2_to_slot1(*slot02);
+        ne_tex4x4_alloc_result = NEA_TEX4X4_ALLOC_OK;
+        return 0;
+    }
 
-            // Check if this address is free and has enough space
-            addr0 = NEA_AllocFindInRange(NEA_TexAllocList, addr0, VRAM_B, size02);
-            if (addr0 == NULL)
-                break;
+    // Find out why it has failed
+    size_t free02 = ne_tex4x4_largest_free(vram_a, vram_b);
+    size_t free2 = ne_tex4x4_largest_free(vram_c, vram_d);
+    if (free2 > free02)
+        free02 = free2;
 
-            // If both addresses match, both of them are free
-            if (addr1 == slot0_to_slot1(addr0))
-            {
-                *slot02 = addr0;
-                *slot1 = addr1;
-                return 0;
-            }
-        }
+    if (free02 < size02)
+    {
+        NEA_DebugPrint("No gap for texel data in slots 0 or 2");
+        ne_tex4x4_alloc_result = NEA_TEX4X4_ALLOC_NO_TEXEL_SPACE;
+    }
+    else if ((ne_tex4x4_largest_free(vram_b, vram_b_half) < size1) &&
+             (ne_tex4x4_largest_free(vram_b_half, vram_c) < size1))
+    {
+        NEA_DebugPrint("No gap for palette index data in slot 1");
+        ne_tex4x4_alloc_result = NEA_TEX4X4_ALLOC_NO_INDEX_SPACE;
+    }
+    else
+    {
+        NEA_DebugPrint("Gaps in slot 0/2 and slot 1 don't match");
+        ne_tex4x4_alloc_result = NEA_TEX4X4_ALLOC_NO_PAIR;
     }
 
-    // Then, try with slot 2 + slot 1
-    // ------------------------------
-
-    // Get the first valid range in slot 2
-    void *addr2 = NEA_AllocFindInRange(NEA_TexAllocList, VRAM_C, VRAM_D, size02);
-    if (addr2 == NULL)
-        return -1;
+    return -1;
+}
 
-    // Only use the second half of slot 1 for slot 2
-    void *addr1;
-    void *addr1_end = VRAM_C;
+NEA_Tex4x4AllocResult NEA_TextureGetTex4x4AllocResult(void)
+{
+    return ne_tex4x4_alloc_result;
+}
 
-    while (1)
+static bool ne_texture_size_is_valid(NEA_TextureFormat fmt,
+                                     int sizeX, int sizeY)
+{
+    if (fmt == NEA_TEX4X4)
     {
-        // Get the address in bank 1 assigned to the current bank 2 address
-        addr1 = slot2_to_slot1(addr2);
-
-        // Check if this address is free and has enough space
-        addr1 = NEA_AllocFindInRange(NEA_TexAllocList, addr1, addr1_end, size1);
-        if (addr1 == NULL)
-            break;
-
-        // If both addresses match, both of them are free
-        if (addr1 == slot2_to_slot1(addr2))
+        // For tex4x4 textures, both width and height must be valid
+        if ((ne_is_valid_tex_size(sizeX) != sizeX)
+            || (ne_is_valid_tex_size(sizeY) != sizeY))
         {
-            *slot02 = addr2;
-            *slot1 = addr1;
-            return 0;
+            NEA_DebugPrint("Width and height of tex4x4 textures must be a power of 2");
+            return false;
         }
 
-        // Get the address in bank 2 assigned to the current bank 1 address
-        addr2 = slot1_to_slot2(addr1);
-
-        // Check if this address is free and has enough space
-        addr2 = NEA_AllocFindInRange(NEA_TexAllocList, addr2, VRAM_B, size02);
-        if (addr2 == NULL)
-            break;
+        return true;
+    }
 
-        // If both addresses match, both of them are free
-        if (addr1 == slot2_to_slot1(addr2))
-        {
-            *slot02 = addr2;
-            *slot1 = addr1;
-            return 0;
-        }
+    // The width of a texture must be a power of 2. The height doesn't need to
+    // be a power of 2, but we will have to cheat later and make the DS believe
+    // it is a power of 2.
+    if (ne_is_valid_tex_size(sizeX) != sizeX)
+    {
+        NEA_DebugPrint("Width of textures must be a power of 2");
+        return false;
     }
 
-    return -1;
+    return true;
 }
 
-int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
-                          NEA_TextureFlags flags, const void *texture02,
-                          const void *texture1)
+// Deletes the texture of a material (if any) and assigns a free texture slot to
+// it. It returns 1 on success, 0 if there are no free slots.
+static int ne_material_new_texture(NEA_Material *tex)
 {
-    NEA_AssertPointer(tex, "NULL material pointer");
-
-    // For tex4x4 textures, both width and height must be valid
-    if ((ne_is_valid_tex_size(sizeX) != sizeX)
-        || (ne_is_valid_tex_size(sizeY) != sizeY))
-    {
-        NEA_DebugPrint("Width and height of tex4x4 textures must be a power of 2");
-        return 0;
-    }
-
     // Check if a texture exists
     if (tex->texindex != NEA_NO_TEXTURE)
         ne_texture_delete(tex->texindex);
@@ -516,19 +916,33 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
     tex->texindex = NEA_NO_TEXTURE;
     for (int i = 0; i < NEA_MAX_TEXTURES; i++)
     {
-        if (NEA_Texture[i].address == NULL)
+        if (NEA_Texture[i].uses == 0)
         {
             tex->texindex = i;
-            break;
+            return 1;
         }
     }
 
-    if (tex->texindex == NEA_NO_TEXTURE)
-    {
-        NEA_DebugPrint("No free slots");
-        return 0;
-    }
+    NEA_DebugPrint("No free slots");
+    return 0;
+}
 
+// Return value of the upload functions when the data can't be read from the
+// stream, as opposed to 0, which means that there isn't enough VRAM.
+#define NE_UPLOAD_READ_ERROR (-1)
+
+// Allocates VRAM for a compressed texture and copies its data there. If the
+// streams aren't NULL, the data is read from them instead of the buffers (which
+// is only supported for synchronous uploads). It returns 1 on success, 0 if
+// there isn't enough VRAM, or NE_UPLOAD_READ_ERROR if the data can't be read.
+static int ne_texture_upload_tex4x4(int slot, int sizeX, int sizeY,
+                                    NEA_TextureFlags flags,
+                                    const void *texture02, const void *texture1,
+                                    NEA_FATStream *stream02,
+                                    NEA_FATStream *stream1,
+                                    bool async, NEA_UploadCallback callback,
+                                    void *arg)
+{
     size_t size02 = (sizeX * sizeY) >> 2;
     size_t size1 = size02 >> 1;
 
@@ -537,6 +951,8 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
     if (ret != 0)
     {
         NEA_DebugPrint("Can't find space for compressed texture");
+        if (ne_texture_report_failures)
+            ne_mem_report_failure(NEA_MEM_POOL_TEXTURE, size02 + size1);
         return 0;
     }
 
@@ -555,12 +971,50 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
         return 0;
     }
 
+    if (async)
+    {
+        // Only the second copy clears the pending flag and calls the callback
+        bool *pending = &NEA_Texture[slot].upload_pending;
+
+        if (ne_upload_add(false, slot02, texture02, size02, false, NULL,
+                          NULL, NULL) != 0)
+            goto async_error;
+
+        if (ne_upload_add(false, slot1, texture1, size1, false, pending,
+                          callback, arg) != 0)
+        {
+            ne_upload_cancel(slot02);
+            goto async_error;
+        }
+    }
+
     // Save information
-    int slot = tex->texindex;
     NEA_Texture[slot].sizex = sizeX;
     NEA_Texture[slot].sizey = sizeY;
     NEA_Texture[slot].address = slot02;
-    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    int hardware_size_y = ne_is_valid_tex_size(sizeY);
+    ne_set_texture_param(slot, sizeX, hardware_size_y, slot02,
+                         NEA_TEX4X4, flags);
+
+    if (async)
+        return 1;
+
+    if (stream02 != NULL)
+    {
+        // The banks are only mapped as LCD memory while each chunk is copied,
+        // so the GPU can keep drawing while the files are read.
+        if (!ne_fat_stream_read_vram(stream02, slot02, size02, 0, true) ||
+            !ne_fat_stream_read_vram(stream1, slot1, size1, 0, true))
+        {
+            NEA_Texture[slot].address = NULL;
+            NEA_Free(NEA_TexAllocList, slot02);
+            NEA_Free(NEA_TexAllocList, slot1);
+            return NE_UPLOAD_READ_ERROR;
+        }
+
+        return 1;
+    }
 
     // Unlock texture memory for writing
     // TODO: Only unlock the banks that Nitro Engine Advanced uses.
@@ -570,96 +1024,130 @@ int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
     swiCopy(texture02, slot02, (size02 >> 2) | COPY_MODE_WORD);
     swiCopy(texture1, slot1, (size1 >> 2) | COPY_MODE_WORD);
 
-    int hardware_size_y = ne_is_valid_tex_size(sizeY);
-    ne_set_material_tex_param(tex, sizeX, hardware_size_y, slot02,
-                              NEA_TEX4X4, flags);
-
     vramRestorePrimaryBanks(vramTemp);
 
     return 1;
+
+async_error:
+    NEA_Free(NEA_TexAllocList, slot02);
+    NEA_Free(NEA_TexAllocList, slot1);
+    return 0;
 }
 
-int NEA_MaterialTexLoad(NEA_Material *tex, NEA_TextureFormat fmt,
-                       int sizeX, int sizeY, NEA_TextureFlags flags,
-                       const void *texture)
+// Allocates VRAM for a texture and copies its data there. Compressed textures
+// must have both parts concatenated. If the stream isn't NULL, the data is read
+// from it instead of the buffer. It returns 1 on success, 0 if there isn't
+// enough VRAM, or NE_UPLOAD_READ_ERROR if the data can't be read.
+static int ne_texture_upload(int slot, NEA_TextureFormat fmt,
+                             int sizeX, int sizeY, NEA_TextureFlags flags,
+                             const void *texture, NEA_FATStream *stream,
+                             bool async, NEA_UploadCallback callback, void *arg)
 {
-    NEA_AssertPointer(tex, "NULL material pointer");
-    NEA_Assert(fmt != 0, "No texture format provided");
-
     if (fmt == NEA_TEX4X4)
     {
         // Split tex4x4 texture into its two parts, that have been concatenated
 
         size_t size02 = (sizeX * sizeY) >> 2;
 
-        const void *texture02 = texture;
-        const void *texture1 = (const void *)((uintptr_t)texture + size02);
-
-        return NEA_MaterialTex4x4Load(tex, sizeX, sizeY, flags,
-                                     texture02, texture1);
-    }
+        // Compressed files can only be read at once, so they are
+        // decompressed to RAM and split there.
+        if ((stream != NULL) && (stream->compression != 0))
+        {
+            if (stream->size < size02 + (size02 >> 1))
+            {
+                NEA_DebugPrint("File is too small");
+                return NE_UPLOAD_READ_ERROR;
+            }
 
-    // The width of a texture must be a power of 2. The height doesn't need to
-    // be a power of 2, but we will have to cheat later and make the DS believe
-    // it is a power of 2.
-    if (ne_is_valid_tex_size(sizeX) != sizeX)
-    {
-        NEA_DebugPrint("Width of textures must be a power of 2");
-        return 0;
-    }
+            void *data = malloc(stream->size);
+            if (data == NULL)
+            {
+                NEA_DebugPrint("Not enough memory to decompress texture");
+                return NE_UPLOAD_READ_ERROR;
+            }
 
-    // Check if a texture exists
-    if (tex->texindex != NEA_NO_TEXTURE)
-        ne_texture_delete(tex->texindex);
+            if (NEA_FATStreamRead(stream, data, stream->size) != stream->size)
+            {
+                free(data);
+                return NE_UPLOAD_READ_ERROR;
+            }
 
-    // Get free slot
-    tex->texindex = NEA_NO_TEXTURE;
-    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
-    {
-        if (NEA_Texture[i].address == NULL)
-        {
-            tex->texindex = i;
-            break;
+            int ret = ne_texture_upload(slot, fmt, sizeX, sizeY, flags, data,
+                                        NULL, false, NULL, NULL);
+            free(data);
+            return ret;
         }
-    }
 
-    if (tex->texindex == NEA_NO_TEXTURE)
-    {
-        NEA_DebugPrint("No free slots");
-        return 0;
+        const void *texture02 = texture;
+        const void *texture1 = (const void *)((uintptr_t)texture + size02);
+
+        // Both parts are read from the same stream, one after the other
+        return ne_texture_upload_tex4x4(slot, sizeX, sizeY, flags,
+                                        texture02, texture1, stream, stream,
+                                        async, callback, arg);
     }
 
     // All non-compressed texture types are handled here
 
-    const int size_shift[] = {
-        0, // Nothing
-        1, // NEA_A3PAL32
-        3, // NEA_PAL4
-        2, // NEA_PAL16
-        1, // NEA_PAL256
-        0, // NEA_TEX4X4 (This value isn't used)
-        1, // NEA_A5PAL8
-        0, // NEA_A1RGB5
-        0, // NEA_RGB5
-    };
-
-    uint32_t size = (sizeX * sizeY << 1) >> size_shift[fmt];
+    uint32_t size = ne_texture_data_size(fmt, sizeX, sizeY);
 
     // This pointer must be aligned to 8 bytes at least
     void *addr = NEA_AllocFromEnd(NEA_TexAllocList, size);
     if (!addr)
     {
-        tex->texindex = NEA_NO_TEXTURE;
         NEA_DebugPrint("Not enough memory");
+        if (ne_texture_report_failures)
+            ne_mem_report_failure(NEA_MEM_POOL_TEXTURE, size);
         return 0;
     }
 
+    if (async)
+    {
+        if (ne_upload_add(false, addr, texture, size, fmt == NEA_RGB5,
+                          &NEA_Texture[slot].upload_pending,
+                          callback, arg) != 0)
+        {
+            NEA_Free(NEA_TexAllocList, addr);
+            return 0;
+        }
+    }
+
     // Save information
-    int slot = tex->texindex;
     NEA_Texture[slot].sizex = sizeX;
     NEA_Texture[slot].sizey = sizeY;
     NEA_Texture[slot].address = addr;
-    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    if (async)
+    {
+        int hardware_size_y = ne_is_valid_tex_size(sizeY);
+        ne_set_texture_param(slot, sizeX, hardware_size_y, addr,
+                             (fmt == NEA_RGB5) ? NEA_A1RGB5 : fmt, flags);
+        return 1;
+    }
+
+    if (stream != NULL)
+    {
+        // NEA_RGB5 is NEA_A1RGB5 with each alpha bit manually set to 1 during
+        // the copy to VRAM.
+        u32 mask = (fmt == NEA_RGB5) ? ((1 << 15) | (1 << 31)) : 0;
+
+        // The banks are only mapped as LCD memory while each chunk is copied,
+        // so the GPU can keep drawing while the file is read.
+        if (!ne_fat_stream_read_vram(stream, addr, size, mask, true))
+        {
+            NEA_Free(NEA_TexAllocList, addr);
+            NEA_Texture[slot].address = NULL;
+            return NE_UPLOAD_READ_ERROR;
+        }
+
+        if (fmt == NEA_RGB5)
+            fmt = NEA_A1RGB5;
+
+        int hardware_size_y = ne_is_valid_tex_size(sizeY);
+        ne_set_texture_param(slot, sizeX, hardware_size_y, addr, fmt, flags);
+
+        return 1;
+    }
 
     // Unlock texture memory for writing
     // TODO: Only unlock the banks that Nitro Engine Advanced uses.
@@ -684,249 +1172,1454 @@ int NEA_MaterialTexLoad(NEA_Material *tex, NEA_TextureFormat fmt,
     }
 
     int hardware_size_y = ne_is_valid_tex_size(sizeY);
-    ne_set_material_tex_param(tex, sizeX, hardware_size_y, addr, fmt, flags);
+    ne_set_texture_param(slot, sizeX, hardware_size_y, addr, fmt, flags);
 
     vramRestorePrimaryBanks(vramTemp);
 
     return 1;
 }
 
-void NEA_MaterialAutodeletePalette(NEA_Material *mat)
+int NEA_MaterialTex4x4Load(NEA_Material *tex, int sizeX, int sizeY,
+                          NEA_TextureFlags flags, const void *texture02,
+                          const void *texture1)
 {
-    NEA_AssertPointer(mat, "NULL material pointer");
+    NEA_AssertPointer(tex, "NULL material pointer");
 
-    mat->palette_autodelete = true;
-}
+    if (!ne_texture_size_is_valid(NEA_TEX4X4, sizeX, sizeY))
+        return 0;
 
-void NEA_MaterialClone(NEA_Material *source, NEA_Material *dest)
-{
-    NEA_AssertPointer(source, "NULL source pointer");
-    NEA_AssertPointer(dest, "NULL dest pointer");
-    NEA_Assert(source->texindex != NEA_NO_TEXTURE,
-              "No texture asigned to source material");
-    // Increase count of materials using this texture
-    NEA_Texture[source->texindex].uses++;
-    memcpy(dest, source, sizeof(NEA_Material));
+    if (ne_material_new_texture(tex) == 0)
+        return 0;
+
+    int slot = tex->texindex;
+
+    if (ne_texture_upload_tex4x4(slot, sizeX, sizeY, flags, texture02, texture1,
+                                 NULL, NULL, false, NULL, NULL) == 0)
+    {
+        tex->texindex = NEA_NO_TEXTURE;
+        return 0;
+    }
+
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
 }
 
-void NEA_MaterialSetPalette(NEA_Material *tex, NEA_Palette *pal)
+int NEA_MaterialTexLoad(NEA_Material *tex, NEA_TextureFormat fmt,
+                       int sizeX, int sizeY, NEA_TextureFlags flags,
+                       const void *texture)
 {
     NEA_AssertPointer(tex, "NULL material pointer");
-    NEA_AssertPointer(pal, "NULL palette pointer");
-    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
-    tex->palette = pal;
-}
+    NEA_Assert(fmt != 0, "No texture format provided");
 
-void NEA_MaterialUse(const NEA_Material *tex)
-{
-    if (tex == NULL)
-    {
-        GFX_TEX_FORMAT = 0;
-        GFX_COLOR = NEA_White;
-        GFX_DIFFUSE_AMBIENT = ne_default_diffuse_ambient;
-        GFX_SPECULAR_EMISSION = ne_default_specular_emission;
-        return;
-    }
+    if (!ne_texture_size_is_valid(fmt, sizeX, sizeY))
+        return 0;
 
-    GFX_DIFFUSE_AMBIENT = tex->diffuse_ambient;
-    GFX_SPECULAR_EMISSION = tex->specular_emission;
+    if (ne_material_new_texture(tex) == 0)
+        return 0;
 
-    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+    int slot = tex->texindex;
 
-    if (tex->palette)
-        NEA_PaletteUse(tex->palette);
+    if (ne_texture_upload(slot, fmt, sizeX, sizeY, flags, texture, NULL,
+                          false, NULL, NULL) == 0)
+    {
+        tex->texindex = NEA_NO_TEXTURE;
+        return 0;
+    }
 
-    GFX_COLOR = tex->color;
-    GFX_TEX_FORMAT = NEA_Texture[tex->texindex].param;
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
 }
 
-int NEA_TextureSystemReset(int max_textures, int max_palettes,
-                          NEA_VRAMBankFlags bank_flags)
+int NEA_MaterialTexLoadFAT(NEA_Material *tex, NEA_TextureFormat fmt,
+                          int sizeX, int sizeY, NEA_TextureFlags flags,
+                          const char *path)
 {
-    if (ne_texture_system_inited)
-        NEA_TextureSystemEnd();
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(path, "NULL path pointer");
+    NEA_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
 
-    NEA_Assert((bank_flags & 0xF) != 0, "No VRAM banks selected");
+    NEA_Assert(fmt != 0, "No texture format provided");
 
-    if (max_textures < 1)
-        NEA_MAX_TEXTURES = NEA_DEFAULT_TEXTURES;
-    else
-        NEA_MAX_TEXTURES = max_textures;
+    if (!ne_texture_size_is_valid(fmt, sizeX, sizeY))
+        return 0;
 
-    if (NEA_PaletteSystemReset(max_palettes) != 0)
-        return -1;
+    // Read the file straight into VRAM instead of loading all of it to RAM
+    NEA_FATStream *stream = NEA_FATStreamOpen(path);
+    if (stream == NULL)
+    {
+        NEA_DebugPrint("Couldn't open file from FAT");
+        return 0;
+    }
 
-    NEA_Texture = calloc(NEA_MAX_TEXTURES, sizeof(ne_textureinfo_t));
-    NEA_UserMaterials = calloc(NEA_MAX_TEXTURES, sizeof(NEA_UserMaterials));
-    if ((NEA_Texture == NULL) || (NEA_UserMaterials == NULL))
-        goto cleanup;
+    if (stream->size < ne_texture_data_size(fmt, sizeX, sizeY))
+    {
+        NEA_DebugPrint("File is too small");
+        NEA_FATStreamClose(stream);
+        return 0;
+    }
+
+    int ret = 0;
 
-    if (NEA_AllocInit(&NEA_TexAllocList, VRAM_A, VRAM_E) != 0)
+    if (ne_material_new_texture(tex) == 0)
         goto cleanup;
 
-    // Prevent user from not selecting any bank
+    int slot = tex->texindex;
+
+    if (ne_texture_upload(slot, fmt, sizeX, sizeY, flags, NULL, stream,
+                          false, NULL, NULL) != 1)
+    {
+        tex->texindex = NEA_NO_TEXTURE;
+        goto cleanup;
+    }
+
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    ret = 1;
+
+cleanup:
+    NEA_FATStreamClose(stream);
+    return ret;
+}
+
+// Internal use: creates the texture of a material and calls the function to
+// write each row straight to VRAM, so that converters don't need a buffer with
+// the whole texture. See NEAFormats.c. VRAM can't be written 8 bits at a time,
+// so rows are written as halfwords.
+int ne_material_tex_load_rows(NEA_Material *tex, NEA_TextureFormat fmt,
+                              int sizeX, int sizeY, NEA_TextureFlags flags,
+                              void (*write_row)(u16 *dst, int y, void *arg),
+                              void *arg)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(write_row, "NULL function pointer");
+    NEA_Assert((fmt != NEA_TEX4X4) && (fmt != NEA_RGB5),
+               "Format not supported");
+
+    if (!ne_texture_size_is_valid(fmt, sizeX, sizeY))
+        return 0;
+
+    if (ne_material_new_texture(tex) == 0)
+        return 0;
+
+    int slot = tex->texindex;
+
+    uint32_t size = ne_texture_data_size(fmt, sizeX, sizeY);
+
+    void *addr = NEA_AllocFromEnd(NEA_TexAllocList, size);
+    if (!addr)
+    {
+        NEA_DebugPrint("Not enough memory");
+        if (ne_texture_report_failures)
+            ne_mem_report_failure(NEA_MEM_POOL_TEXTURE, size);
+        tex->texindex = NEA_NO_TEXTURE;
+        return 0;
+    }
+
+    NEA_Texture[slot].sizex = sizeX;
+    NEA_Texture[slot].sizey = sizeY;
+    NEA_Texture[slot].address = addr;
+
+    // Unlock texture memory for writing
+    u32 vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
+                                       VRAM_D_LCD);
+
+    size_t row_halfwords = (size / sizeY) >> 1;
+
+    u16 *dst = addr;
+    for (int y = 0; y < sizeY; y++)
+    {
+        write_row(dst, y, arg);
+        dst += row_halfwords;
+    }
+
+    int hardware_size_y = ne_is_valid_tex_size(sizeY);
+    ne_set_texture_param(slot, sizeX, hardware_size_y, addr, fmt, flags);
+
+    vramRestorePrimaryBanks(vramTemp);
+
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+int NEA_MaterialTex4x4LoadFAT(NEA_Material *tex, int sizeX, int sizeY,
+                             NEA_TextureFlags flags, const char *path02,
+                             const char *path1)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(path02, "NULL path02 pointer");
+    NEA_AssertPointer(path1, "NULL path1 pointer");
+    NEA_Assert(sizeX > 0 && sizeY > 0, "Size must be positive");
+
+    if (!ne_texture_size_is_valid(NEA_TEX4X4, sizeX, sizeY))
+        return 0;
+
+    int ret = 0;
+
+    NEA_FATStream *stream1 = NULL;
+    NEA_FATStream *stream02 = NEA_FATStreamOpen(path02);
+    if (stream02 == NULL)
+        goto error;
+
+    stream1 = NEA_FATStreamOpen(path1);
+    if (stream1 == NULL)
+        goto error;
+
+    if (ne_material_new_texture(tex) == 0)
+        goto cleanup;
+
+    int slot = tex->texindex;
+
+    if (ne_texture_upload_tex4x4(slot, sizeX, sizeY, flags, NULL, NULL,
+                                 stream02, stream1, false, NULL, NULL) != 1)
+    {
+        tex->texindex = NEA_NO_TEXTURE;
+        goto cleanup;
+    }
+
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    ret = 1;
+    goto cleanup;
+
+error:
+    NEA_DebugPrint("Couldn't open file from FAT");
+cleanup:
+    if (stream02 != NULL)
+        NEA_FATStreamClose(stream02);
+    if (stream1 != NULL)
+        NEA_FATStreamClose(stream1);
+    return ret;
+}
+
+int NEA_MaterialTexLoadAsync(NEA_Material *tex, NEA_TextureFormat fmt,
+                            int sizeX, int sizeY, NEA_TextureFlags flags,
+                            const void *texture,
+                            NEA_UploadCallback callback, void *arg)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(texture, "NULL texture pointer");
+    NEA_Assert(fmt != 0, "No texture format provided");
+
+    if (!ne_texture_size_is_valid(fmt, sizeX, sizeY))
+        return 0;
+
+    if (ne_material_new_texture(tex) == 0)
+        return 0;
+
+    int slot = tex->texindex;
+
+    if (ne_texture_upload(slot, fmt, sizeX, sizeY, flags, texture, NULL,
+                          true, callback, arg) == 0)
+    {
+        tex->texindex = NEA_NO_TEXTURE;
+        return 0;
+    }
+
+    NEA_Texture[slot].uses = 1; // Initially only this material uses the texture
+
+    return 1;
+}
+
+static int ne_material_tex_stream(NEA_Material *tex, NEA_TextureFormat fmt,
+                                  int sizeX, int sizeY, NEA_TextureFlags flags,
+                                  const void *texture, const char *path)
+{
+    if (!ne_texture_size_is_valid(fmt, sizeX, sizeY))
+        return 0;
+
+    char *path_copy = NULL;
+    if (path != NULL)
+    {
+        path_copy = strdup(path);
+        if (path_copy == NULL)
+        {
+            NEA_DebugPrint("Not enough memory");
+            return 0;
+        }
+    }
+
+    if (ne_material_new_texture(tex) == 0)
+    {
+        free(path_copy);
+        return 0;
+    }
+
+    int slot = tex->texindex;
+    ne_textureinfo_t *info = &NEA_Texture[slot];
+
+    info->sizex = sizeX;
+    info->sizey = sizeY;
+    info->address = NULL;
+    info->stream_data = texture;
+    info->stream_path = path_copy;
+    info->stream_fmt = fmt;
+    info->stream_flags = flags;
+    info->stream_last_use = ne_texture_stream_stamp;
+    info->stream_pending = false;
+    info->uses = 1; // Initially only this material uses the texture
+
+    // Save the size and format so that they can be read before the texture is
+    // uploaded. The address is set when it is uploaded.
+    int hardware_size_y = ne_is_valid_tex_size(sizeY);
+    ne_set_texture_param(slot, sizeX, hardware_size_y, NULL,
+                         (fmt == NEA_RGB5) ? NEA_A1RGB5 : fmt, flags);
+
+    return 1;
+}
+
+int NEA_MaterialTexStream(NEA_Material *tex, NEA_TextureFormat fmt,
+                          int sizeX, int sizeY, NEA_TextureFlags flags,
+                          const void *texture)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(texture, "NULL texture pointer");
+    NEA_Assert(fmt != 0, "No texture format provided");
+
+    return ne_material_tex_stream(tex, fmt, sizeX, sizeY, flags, texture, NULL);
+}
+
+int NEA_MaterialTexStreamFAT(NEA_Material *tex, NEA_TextureFormat fmt,
+                             int sizeX, int sizeY, NEA_TextureFlags flags,
+                             const char *path)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(path, "NULL path pointer");
+    NEA_Assert(fmt != 0, "No texture format provided");
+
+    return ne_material_tex_stream(tex, fmt, sizeX, sizeY, flags, NULL, path);
+}
+
+bool NEA_MaterialIsResident(const NEA_Material *tex)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+
+    return NEA_Texture[tex->texindex].address != NULL;
+}
+
+void NEA_MaterialTexEvict(NEA_Material *tex)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+
+    int slot = tex->texindex;
+
+    if (!ne_texture_is_streamed(slot))
+    {
+        NEA_DebugPrint("Material isn't streamed");
+        return;
+    }
+
+    if (NEA_Texture[slot].address == NULL)
+        return;
+
+    ne_texture_free_vram(slot);
+    ne_texture_gui_invalidate();
+}
+
+void NEA_TextureStreamSetBudget(size_t bytes)
+{
+    ne_texture_stream_budget = bytes;
+}
+
+size_t NEA_TextureStreamGetResidentSize(void)
+{
+    return ne_texture_stream_size;
+}
+
+// Evicts the streamed texture that has been used least recently, skipping the
+// ones used in the last two frames because the 3D engine may still be drawing
+// them. It returns true if a texture has been evicted.
+static bool ne_texture_stream_evict_lru(void)
+{
+    int lru = -1;
+    u32 lru_age = 1;
+
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        if ((NEA_Texture[i].address == NULL) || !ne_texture_is_streamed(i))
+            continue;
+
+        u32 age = ne_texture_stream_stamp - NEA_Texture[i].stream_last_use;
+        if (age > lru_age)
+        {
+            lru = i;
+            lru_age = age;
+        }
+    }
+
+    if (lru == -1)
+        return false;
+
+    ne_texture_free_vram(lru);
+    ne_texture_gui_invalidate();
+    return true;
+}
+
+static size_t ne_texture_defrag(size_t max_bytes, bool wait_vblank);
+
+// Uploads a streamed texture to VRAM, evicting other streamed textures if
+// needed. It returns 1 on success, 0 on error. If VRAM is fragmented and the
+// vertical blank ends before it can be defragmented, the texture is left as
+// pending for the next frame.
+static int ne_texture_stream_upload(int slot)
+{
+    ne_textureinfo_t *info = &NEA_Texture[slot];
+
+    size_t size = ne_texture_data_size(info->stream_fmt,
+                                       info->sizex, info->sizey);
+
+    if (ne_texture_stream_budget != 0)
+    {
+        while (ne_texture_stream_size + size > ne_texture_stream_budget)
+        {
+            if (!ne_texture_stream_evict_lru())
+            {
+                NEA_DebugPrint("Streamed texture over budget");
+                return 0;
+            }
+        }
+    }
+
+    // Textures in the filesystem are read straight into VRAM
+    NEA_FATStream *stream = NULL;
+
+    if (info->stream_data == NULL)
+    {
+        stream = NEA_FATStreamOpen(info->stream_path);
+        if (stream == NULL)
+        {
+            NEA_DebugPrint("Couldn't open file from FAT");
+            return 0;
+        }
+    }
+
+    ne_texture_report_failures = false;
+
+    int ret;
+    while ((ret = ne_texture_upload(slot, info->stream_fmt, info->sizex,
+                                    info->sizey, info->stream_flags,
+                                    info->stream_data, stream,
+                                    false, NULL, NULL)) != 1)
+    {
+        // Making space in VRAM doesn't help if the file can't be read. Nothing
+        // has been read from it if there wasn't enough VRAM, but go back to
+        // the start anyway.
+        if ((ret == NE_UPLOAD_READ_ERROR) ||
+            ((stream != NULL) && !NEA_FATStreamSeek(stream, 0)))
+        {
+            NEA_DebugPrint("Couldn't read streamed texture");
+            ne_texture_report_failures = true;
+            if (stream != NULL)
+                NEA_FATStreamClose(stream);
+            return 0;
+        }
+
+        if (ne_texture_stream_evict_lru())
+            continue;
+
+        // There may be enough free memory, but not in one single gap. This is
+        // called from the vertical blank, so only move what fits in it.
+        if ((size_t)NEA_TextureFreeMem() >= size)
+        {
+            if (ne_texture_defrag(NEA_TEXTURE_DEFRAG_STEP_BYTES, true) > 0)
+                continue;
+
+            if (ne_texture_defrag_pending)
+            {
+                info->stream_pending = true;
+                ne_texture_report_failures = true;
+                if (stream != NULL)
+                    NEA_FATStreamClose(stream);
+                return 0;
+            }
+        }
+
+        NEA_DebugPrint("Not enough memory for streamed texture");
+        ne_texture_report_failures = true;
+        ne_mem_report_failure(NEA_MEM_POOL_TEXTURE, size);
+        if (stream != NULL)
+            NEA_FATStreamClose(stream);
+        return 0;
+    }
+
+    ne_texture_report_failures = true;
+
+    if (stream != NULL)
+        NEA_FATStreamClose(stream);
+
+    ne_texture_stream_size += size;
+
+    return 1;
+}
+
+size_t NEA_TextureStreamUpdate(size_t max_bytes)
+{
+    if (!ne_texture_system_inited)
+        return 0;
+
+    size_t uploaded = 0;
+
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        if (uploaded >= max_bytes)
+            break;
+
+        // VRAM can't be unlocked while the 3D engine is reading textures
+        if (NEA_GPUIsRendering())
+            break;
+
+        ne_textureinfo_t *info = &NEA_Texture[i];
+
+        if (!info->stream_pending)
+            continue;
+
+        // If it fails, it will be requested again the next time it is used
+        info->stream_pending = false;
+
+        if (ne_texture_stream_upload(i) == 0)
+            continue;
+
+        uploaded += ne_texture_data_size(info->stream_fmt,
+                                         info->sizex, info->sizey);
+    }
+
+    ne_texture_stream_stamp++;
+
+    if (uploaded > 0)
+        ne_texture_gui_invalidate();
+
+    return uploaded;
+}
+
+void NEA_MaterialAutodeletePalette(NEA_Material *mat)
+{
+    NEA_AssertPointer(mat, "NULL material pointer");
+
+    mat->palette_autodelete = true;
+}
+
+void NEA_MaterialClone(NEA_Material *source, NEA_Material *dest)
+{
+    NEA_AssertPointer(source, "NULL source pointer");
+    NEA_AssertPointer(dest, "NULL dest pointer");
+    NEA_Assert(source->texindex != NEA_NO_TEXTURE,
+              "No texture asigned to source material");
+    // Increase count of materials using this texture
+    NEA_Texture[source->texindex].uses++;
+    memcpy(dest, source, sizeof(NEA_Material));
+    ne_material_names_dirty = true;
+}
+
+void NEA_MaterialSetPalette(NEA_Material *tex, NEA_Palette *pal)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+    NEA_AssertPointer(pal, "NULL palette pointer");
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+    tex->palette = pal;
+}
+
+// Internal use... see NEAGUI.c. Returns the value of the texture format
+// register used by a material. It returns 0 for textures that are still in the
+// upload queue, and for streamed textures that aren't in VRAM (which are queued
+// to be uploaded).
+u32 ne_material_tex_format(const NEA_Material *tex)
+{
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+
+    int slot = tex->texindex;
+
+    // Draw it without texture until the upload queue has copied it
+    if (NEA_Texture[slot].upload_pending)
+        return 0;
+    if ((tex->palette != NULL) && !ne_palette_is_ready(tex->palette))
+        return 0;
+
+    if (ne_texture_is_streamed(slot))
+    {
+        NEA_Texture[slot].stream_last_use = ne_texture_stream_stamp;
+
+        // Request an upload and draw it without texture until it is ready
+        if (NEA_Texture[slot].address == NULL)
+        {
+            NEA_Texture[slot].stream_pending = true;
+            return 0;
+        }
+    }
+
+    return NEA_Texture[slot].param;
+}
+
+// Internal use... see NEAGUI.c. Marks the texture of a material as used in this
+// frame, for lists that are drawn again without calling
+// ne_material_tex_format().
+void ne_material_touch(const NEA_Material *tex)
+{
+    int slot = tex->texindex;
+
+    if ((slot != NEA_NO_TEXTURE) && ne_texture_is_streamed(slot))
+        NEA_Texture[slot].stream_last_use = ne_texture_stream_stamp;
+}
+
+void NEA_MaterialSetTexOffset(NEA_Material *tex, int s, int t)
+{
+    NEA_AssertPointer(tex, "NULL material pointer");
+
+    tex->tex_offset_s = s;
+    tex->tex_offset_t = t;
+}
+
+// Value of the texture matrix stamp after NEA_MaterialUse() applied the offset
+// of a material. If it matches the current stamp, the texture matrix still
+// holds that offset.
+static uint32_t ne_material_offset_stamp = UINT32_MAX;
+static s16 ne_material_offset_s, ne_material_offset_t;
+
+static void ne_material_apply_tex_offset(const NEA_Material *tex, u32 param)
+{
+    // The texture matrix only affects NEA_TEXGEN_TEXCOORD
+    if ((param & (3U << 30)) != NEA_TEXGEN_TEXCOORD)
+        return;
+
+    bool has_offset = (tex->tex_offset_s != 0) || (tex->tex_offset_t != 0);
+    bool applied = (ne_material_offset_stamp == ne_texture_matrix_stamp);
+
+    if (!has_offset)
+    {
+        // Don't let the offset of the previous material leak into this one
+        if (applied)
+        {
+            NEA_TextureMatrixIdentity();
+            ne_material_offset_stamp = UINT32_MAX;
+        }
+        return;
+    }
+
+    if (applied && (ne_material_offset_s == tex->tex_offset_s) &&
+        (ne_material_offset_t == tex->tex_offset_t))
+        return;
+
+    // Texture coordinates have 4 fractional bits, and the translation is
+    // multiplied by 1/16 in NEA_TEXGEN_TEXCOORD mode, so one texel is 1 << 16.
+    // The offsets can be negative, so they are multiplied instead of shifted.
+    NEA_TextureMatrixIdentity();
+    NEA_TextureMatrixTranslateI(tex->tex_offset_s * (1 << 16),
+                                tex->tex_offset_t * (1 << 16));
+
+    ne_material_offset_stamp = ne_texture_matrix_stamp;
+    ne_material_offset_s = tex->tex_offset_s;
+    ne_material_offset_t = tex->tex_offset_t;
+}
+
+void NEA_MaterialUse(const NEA_Material *tex)
+{
+    NE_STAT_ADD(material_binds, 1);
+
+    NEA_DisplayListWait();
+
+    // The vertex color is always written because display lists can modify it
+    if (tex == NULL)
+    {
+        ne_material_state_tex_format(0);
+        GFX_COLOR = NEA_White;
+        ne_material_state_diffuse_ambient(ne_default_diffuse_ambient);
+        ne_material_state_specular_emission(ne_default_specular_emission);
+        return;
+    }
+
+    ne_material_state_diffuse_ambient(tex->diffuse_ambient);
+    ne_material_state_specular_emission(tex->specular_emission);
+
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE, "No texture asigned to material");
+
+    if (tex->palette)
+        NEA_PaletteUse(tex->palette);
+
+    GFX_COLOR = tex->color;
+
+    u32 param = ne_material_tex_format(tex);
+    ne_material_state_tex_format(param);
+    ne_material_apply_tex_offset(tex, param);
+}
+
+int NEA_TextureSystemReset(int max_textures, int max_palettes,
+                          NEA_VRAMBankFlags bank_flags)
+{
+    if (ne_texture_system_inited)
+        NEA_TextureSystemEnd();
+
+    NEA_Assert((bank_flags & 0xF) != 0, "No VRAM banks selected");
+
+    if (max_textures < 1)
+        NEA_MAX_TEXTURES = NEA_DEFAULT_TEXTURES;
+    else
+        NEA_MAX_TEXTURES = max_textures;
+
+    NEA_MAX_TEXTURES = NE_STATIC_CAPACITY(NEA_MAX_TEXTURES,
+                                          NEA_STATIC_MAX_MATERIALS);
+
+    if (NEA_PaletteSystemReset(max_palettes) != 0)
+        return -1;
+
+    NEA_Texture = NE_STATIC_CALLOC(ne_texture_static, NEA_MAX_TEXTURES,
+                                   sizeof(ne_textureinfo_t));
+    ne_material_names = NE_STATIC_CALLOC(ne_material_names_static,
+                                         NEA_MAX_TEXTURES,
+                                         sizeof(ne_material_name_t));
+    if ((NEA_Texture == NULL) || (ne_material_names == NULL) ||
+        (NE_POOL_INIT(&ne_material_pool, ne_material_static,
+                      NEA_MAX_TEXTURES) == 0))
+        goto cleanup;
+
+    ne_material_names_dirty = true;
+
+    if (NEA_AllocInitMode(&NEA_TexAllocList, VRAM_A, VRAM_E,
+                          NEA_ALLOC_SEGREGATED) != 0)
+        goto cleanup;
+
+    // Prevent user from not selecting any bank
     if ((bank_flags & 0xF) == 0)
         bank_flags = NEA_VRAM_ABCD;
 
-    // Exclude banks claimed by the Hw2D system (weak reference)
-    extern NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void) __attribute__((weak));
-    if (NEA_Hw2DGetClaimedBanks)
-        bank_flags &= ~NEA_Hw2DGetClaimedBanks();
+    // Exclude banks claimed by the Hw2D system (weak reference)
+    extern NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void) __attribute__((weak));
+    if (NEA_Hw2DGetClaimedBanks)
+        bank_flags &= ~NEA_Hw2DGetClaimedBanks();
+
+    // VRAM_C and VRAM_D can't be used in dual 3D mode (they are used for
+    // framebuffers). In two-pass FIFO/DMA modes, only VRAM_D is reserved (for
+    // capture), so VRAM_C is available for textures. In two-pass FB mode,
+    // both VRAM_C and VRAM_D alternate as framebuffers/capture destinations.
+    NEA_ExecutionModes mode = NEA_CurrentExecutionMode();
+    if (mode == NEA_ModeSingle3D_TwoPass
+        || mode == NEA_ModeSingle3D_TwoPass_DMA)
+        bank_flags &= ~NEA_VRAM_D;
+    else if (mode != NEA_ModeSingle3D)
+        bank_flags &= ~NEA_VRAM_CD;
+
+    // Now, configure allocation system. The buffer size always sees the
+    // four banks of VRAM. It is needed to allocate and lock one chunk per bank
+    // that isn't allocated to Nitro Engine Advanced.
+
+    if (bank_flags & NEA_VRAM_A)
+    {
+        vramSetBankA(VRAM_A_TEXTURE_SLOT0);
+    }
+    else
+    {
+        NEA_AllocAddress(NEA_TexAllocList, VRAM_A, 128 * 1024);
+        NEA_Lock(NEA_TexAllocList, VRAM_A);
+    }
+
+    if (bank_flags & NEA_VRAM_B)
+    {
+        vramSetBankB(VRAM_B_TEXTURE_SLOT1);
+    }
+    else
+    {
+        NEA_AllocAddress(NEA_TexAllocList, VRAM_B, 128 * 1024);
+        NEA_Lock(NEA_TexAllocList, VRAM_B);
+    }
+
+    if (bank_flags & NEA_VRAM_C)
+    {
+        vramSetBankC(VRAM_C_TEXTURE_SLOT2);
+    }
+    else
+    {
+        NEA_AllocAddress(NEA_TexAllocList, VRAM_C, 128 * 1024);
+        NEA_Lock(NEA_TexAllocList, VRAM_C);
+    }
+
+    if (bank_flags & NEA_VRAM_D)
+    {
+        vramSetBankD(VRAM_D_TEXTURE_SLOT3);
+    }
+    else
+    {
+        NEA_AllocAddress(NEA_TexAllocList, VRAM_D, 128 * 1024);
+        NEA_Lock(NEA_TexAllocList, VRAM_D);
+    }
+
+    ne_texture_banks = bank_flags & NEA_VRAM_ABCD;
 
-    // VRAM_C and VRAM_D can't be used in dual 3D mode (they are used for
-    // framebuffers). In two-pass FIFO/DMA modes, only VRAM_D is reserved (for
-    // capture), so VRAM_C is available for textures. In two-pass FB mode,
-    // both VRAM_C and VRAM_D alternate as framebuffers/capture destinations.
-    NEA_ExecutionModes mode = NEA_CurrentExecutionMode();
-    if (mode == NEA_ModeSingle3D_TwoPass
-        || mode == NEA_ModeSingle3D_TwoPass_DMA)
-        bank_flags &= ~NEA_VRAM_D;
-    else if (mode != NEA_ModeSingle3D)
-        bank_flags &= ~NEA_VRAM_CD;
+    ne_material_state_tex_format(0);
 
-    // Now, configure allocation system. The buffer size always sees the
-    // four banks of VRAM. It is needed to allocate and lock one chunk per bank
-    // that isn't allocated to Nitro Engine Advanced.
+    ne_texture_defrag_pending = false;
+    ne_texture_stream_stamp = 0;
+    ne_texture_stream_budget = 0;
+    ne_texture_stream_size = 0;
+    ne_texture_system_inited = true;
+    return 0;
 
-    if (bank_flags & NEA_VRAM_A)
+cleanup:
+    NEA_DebugPrint("Not enough memory");
+    NEA_PaletteSystemEnd();
+    NE_STATIC_FREE(ne_texture_static, NEA_Texture);
+    ne_pool_end(&ne_material_pool);
+    NE_STATIC_FREE(ne_material_names_static, ne_material_names);
+    return -1;
+}
+
+void NEA_MaterialDelete(NEA_Material *tex)
+{
+    NEA_AssertPointer(tex, "NULL pointer");
+
+    NEA_LoaderCancel(tex);
+
+    // Delete the palette if it has been flagged to be autodeleted
+    if (tex->palette_autodelete)
+        NEA_PaletteDelete(tex->palette);
+
+    // If there is an asigned texture
+    if (tex->texindex != NEA_NO_TEXTURE)
+        ne_texture_delete(tex->texindex);
+
+    int slot = ne_pool_find(&ne_material_pool, tex);
+    if (slot < 0)
     {
-        vramSetBankA(VRAM_A_TEXTURE_SLOT0);
+        NEA_DebugPrint("Object not found");
+        return;
+    }
+
+    ne_pool_remove(&ne_material_pool, slot);
+    ne_material_names_dirty = true;
+    ne_pool_object_free(&ne_material_pool, tex);
+}
+
+int NEA_TextureFreeMem(void)
+{
+    if (!ne_texture_system_inited)
+        return 0;
+
+    NEAMemInfo info;
+    NEA_MemGetInformation(NEA_TexAllocList, &info);
+
+    return info.free;
+}
+
+int NEA_TextureFreeMemPercent(void)
+{
+    if (!ne_texture_system_inited)
+        return 0;
+
+    NEAMemInfo info;
+    NEA_MemGetInformation(NEA_TexAllocList, &info);
+
+    return info.free_percent;
+}
+
+// Returns the chunk of the texture allocator that starts at the provided
+// address, or NULL if there isn't any.
+static NEAChunk *ne_texture_find_chunk(const void *address)
+{
+    for (NEAChunk *this = NEA_TexAllocList; this != NULL; this = this->next)
+    {
+        if (this->start == address)
+            return this;
+    }
+
+    return NULL;
+}
+
+int NEA_TextureGetMemReport(NEA_MemReport *report)
+{
+    NEA_AssertPointer(report, "NULL pointer");
+
+    if (!ne_texture_system_inited)
+        return 0;
+
+    if (NEA_AllocGetReport(NEA_TexAllocList, report) != 0)
+        return 0;
+
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        void *address = NEA_Texture[i].address;
+        if (address == NULL)
+            continue;
+
+        NEAChunk *chunk = ne_texture_find_chunk(address);
+        if (chunk == NULL)
+            continue;
+
+        size_t size = (uintptr_t)chunk->end - (uintptr_t)chunk->start;
+        NEA_MemOwner owner;
+
+        uint32_t fmt = (NEA_Texture[i].param >> 26) & 7;
+
+        if (fmt == NEA_TEX4X4)
+        {
+            void *slot1 = (address < (void *)VRAM_B) ?
+                          slot0_to_slot1(address) : slot2_to_slot1(address);
+
+            chunk = ne_texture_find_chunk(slot1);
+            if (chunk != NULL)
+                size += (uintptr_t)chunk->end - (uintptr_t)chunk->start;
+
+            owner = NEA_MEM_OWNER_TEXTURE_TEX4X4;
+        }
+        else if (ne_texture_is_streamed(i))
+        {
+            owner = NEA_MEM_OWNER_TEXTURE_STREAM;
+        }
+        else
+        {
+            owner = NEA_MEM_OWNER_TEXTURE;
+        }
+
+        report->owner[owner] += size;
+        report->owner[NEA_MEM_OWNER_OTHER] -= size;
+    }
+
+    return 1;
+}
+
+// Returns the texture that starts at the provided address, or -1 if there isn't
+// any. For compressed textures only the address in slot 0 or 2 is found.
+static int ne_texture_find_by_address(const void *address)
+{
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        if (NEA_Texture[i].address == address)
+            return i;
+    }
+
+    return -1;
+}
+
+static void ne_texture_set_address(int index, void *address)
+{
+    NEA_Texture[index].address = address;
+    NEA_Texture[index].param &= ~0xFFFF;
+    NEA_Texture[index].param |= ((uint32_t)address >> 3) & 0xFFFF;
+}
+
+// Copies data inside VRAM. Both ranges may overlap, the data is copied in
+// blocks that never overlap with their destination.
+static void ne_texture_move_data(void *dst, const void *src, size_t size)
+{
+    uintptr_t d = (uintptr_t)dst;
+    uintptr_t s = (uintptr_t)src;
+
+    size_t block = (d > s) ? (d - s) : (s - d);
+    if (block > size)
+        block = size;
+
+    if (d < s)
+    {
+        for (size_t done = 0; done < size; done += block)
+        {
+            size_t len = (size - done < block) ? (size - done) : block;
+            dmaCopyWords(3, (const void *)(s + done), (void *)(d + done), len);
+        }
     }
     else
     {
-        NEA_AllocAddress(NEA_TexAllocList, VRAM_A, 128 * 1024);
-        NEA_Lock(NEA_TexAllocList, VRAM_A);
+        size_t left = size;
+        while (left > 0)
+        {
+            size_t len = (left < block) ? left : block;
+            left -= len;
+            dmaCopyWords(3, (const void *)(s + left), (void *)(d + left), len);
+        }
+    }
+}
+
+// Moves the highest regular texture that has free space right after it to the
+// end of that free space. Regular textures are allocated from the end of VRAM,
+// so this keeps them together and leaves the start of slots 0 and 1 free for
+// compressed textures. Returns the number of bytes copied, or 0 if no texture
+// can be moved.
+static size_t ne_texture_defrag_regular(void)
+{
+    NEAChunk *this = NEA_TexAllocList;
+    while (this->next != NULL)
+        this = this->next;
+
+    for ( ; this != NULL; this = this->previous)
+    {
+        NEAChunk *next = this->next;
+
+        if ((this->state != NEA_STATE_USED) || (next == NULL) ||
+            (next->state != NEA_STATE_FREE))
+            continue;
+
+        int index = ne_texture_find_by_address(this->start);
+        if (index == -1)
+            continue;
+
+        if (((NEA_Texture[index].param >> 26) & 7) == NEA_TEX4X4)
+            continue;
+
+        // The upload queue has the address of the texture
+        if (NEA_Texture[index].upload_pending)
+            continue;
+
+        void *old_addr = this->start;
+        size_t size = (uintptr_t)this->end - (uintptr_t)this->start;
+        void *new_addr = (void *)((uintptr_t)next->end - size);
+
+        // The free chunk is merged with this one, so the new allocation can't
+        // fail because of a lack of space.
+        NEA_Free(NEA_TexAllocList, old_addr);
+        if (NEA_AllocAddress(NEA_TexAllocList, new_addr, size) != 0)
+        {
+            NEA_DebugPrint("Can't reallocate texture");
+            NEA_AllocAddress(NEA_TexAllocList, old_addr, size);
+            return 0;
+        }
+
+        ne_texture_move_data(new_addr, old_addr, size);
+        ne_texture_set_address(index, new_addr);
+
+        return size;
+    }
+
+    return 0;
+}
+
+// Moves the first compressed texture that has free space right before both its
+// slot 0/2 and its slot 1 parts. Both parts are moved together so that the
+// index data in slot 1 still matches the texel data. Returns the number of
+// bytes copied, or 0 if no texture can be moved.
+static size_t ne_texture_defrag_tex4x4(void)
+{
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        if (NEA_Texture[i].address == NULL)
+            continue;
+
+        if (((NEA_Texture[i].param >> 26) & 7) != NEA_TEX4X4)
+            continue;
+
+        if (NEA_Texture[i].upload_pending)
+            continue;
+
+        void *old02 = NEA_Texture[i].address;
+        bool in_slot0 = old02 < (void *)VRAM_B;
+        void *old1 = in_slot0 ? slot0_to_slot1(old02) : slot2_to_slot1(old02);
+
+        NEAChunk *chunk02 = ne_texture_find_chunk(old02);
+        NEAChunk *chunk1 = ne_texture_find_chunk(old1);
+        NEA_AssertPointer(chunk02, "Texture not found in allocator");
+        NEA_AssertPointer(chunk1, "Texture not found in allocator");
+
+        NEAChunk *prev02 = chunk02->previous;
+        NEAChunk *prev1 = chunk1->previous;
+        if ((prev02 == NULL) || (prev02->state != NEA_STATE_FREE) ||
+            (prev1 == NULL) || (prev1->state != NEA_STATE_FREE))
+            continue;
+
+        // The slot 0/2 part can't leave its bank, and the slot 1 part can't
+        // leave the half of slot 1 that corresponds to that bank.
+        uintptr_t min02 = (uintptr_t)(in_slot0 ? VRAM_A : VRAM_C);
+        uintptr_t min1 = (uintptr_t)VRAM_B + (in_slot0 ? 0 : (64 * 1024));
+
+        if ((uintptr_t)prev02->start > min02)
+            min02 = (uintptr_t)prev02->start;
+        if ((uintptr_t)prev1->start > min1)
+            min1 = (uintptr_t)prev1->start;
+
+        size_t free02 = (uintptr_t)old02 - min02;
+        size_t free1 = (uintptr_t)old1 - min1;
+
+        // Slot 1 moves half the distance of slot 0/2. Keep both addresses
+        // aligned to 8 bytes at least.
+        size_t dist = (free02 < free1 * 2) ? free02 : free1 * 2;
+        dist &= ~(size_t)15;
+        if (dist == 0)
+            continue;
+
+        size_t size02 = (uintptr_t)chunk02->end - (uintptr_t)chunk02->start;
+        size_t size1 = (uintptr_t)chunk1->end - (uintptr_t)chunk1->start;
+        void *new02 = (void *)((uintptr_t)old02 - dist);
+        void *new1 = (void *)((uintptr_t)old1 - (dist / 2));
+
+        NEA_Free(NEA_TexAllocList, old02);
+        NEA_Free(NEA_TexAllocList, old1);
+        if ((NEA_AllocAddress(NEA_TexAllocList, new02, size02) != 0) ||
+            (NEA_AllocAddress(NEA_TexAllocList, new1, size1) != 0))
+        {
+            NEA_DebugPrint("Can't reallocate texture");
+            NEA_Free(NEA_TexAllocList, new02);
+            NEA_AllocAddress(NEA_TexAllocList, old02, size02);
+            NEA_AllocAddress(NEA_TexAllocList, old1, size1);
+            return 0;
+        }
+
+        ne_texture_move_data(new02, old02, size02);
+        ne_texture_move_data(new1, old1, size1);
+        ne_texture_set_address(i, new02);
+
+        return size02 + size1;
+    }
+
+    return 0;
+}
+
+// If wait_vblank is true, it stops as soon as the 3D engine starts rendering,
+// because it needs to read the textures.
+static size_t ne_texture_defrag(size_t max_bytes, bool wait_vblank)
+{
+    if (!ne_texture_system_inited)
+        return 0;
+
+    if (!ne_texture_defrag_pending)
+        return 0;
+
+    if (wait_vblank && NEA_GPUIsRendering())
+        return 0;
+
+    // Unlock texture memory for writing
+    // TODO: Only unlock the banks that Nitro Engine Advanced uses.
+    u32 vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
+                                       VRAM_D_LCD);
+
+    size_t moved = 0;
+
+    while (moved < max_bytes)
+    {
+        if (wait_vblank && NEA_GPUIsRendering())
+            break;
+
+        size_t size = ne_texture_defrag_regular();
+        if (size == 0)
+            size = ne_texture_defrag_tex4x4();
+
+        if (size == 0)
+        {
+            // Nothing else can be moved until another texture is deleted
+            ne_texture_defrag_pending = false;
+            break;
+        }
+
+        moved += size;
+    }
+
+    vramRestorePrimaryBanks(vramTemp);
+
+    if (moved > 0)
+        ne_texture_gui_invalidate();
+
+    return moved;
+}
+
+size_t NEA_TextureDefragMemStep(size_t max_bytes)
+{
+    return ne_texture_defrag(max_bytes, true);
+}
+
+void NEA_TextureDefragMem(void)
+{
+    ne_texture_defrag(SIZE_MAX, false);
+}
+
+// Size of each one of the banks VRAM_A to VRAM_D
+#define NE_TEXTURE_BANK_SIZE (128 * 1024)
+
+static uintptr_t ne_texture_bank_start(int bank)
+{
+    return (uintptr_t)VRAM_A + bank * NE_TEXTURE_BANK_SIZE;
+}
+
+// Maps one of the banks VRAM_A to VRAM_D as texture memory or as LCD memory
+static void ne_texture_bank_map(int bank, bool texture)
+{
+    switch (bank)
+    {
+        case 0:
+            vramSetBankA(texture ? VRAM_A_TEXTURE_SLOT0 : VRAM_A_LCD);
+            break;
+        case 1:
+            vramSetBankB(texture ? VRAM_B_TEXTURE_SLOT1 : VRAM_B_LCD);
+            break;
+        case 2:
+            vramSetBankC(texture ? VRAM_C_TEXTURE_SLOT2 : VRAM_C_LCD);
+            break;
+        case 3:
+            vramSetBankD(texture ? VRAM_D_TEXTURE_SLOT3 : VRAM_D_LCD);
+            break;
+    }
+}
+
+// Returns the banks that hold any part of the texture in the provided slot
+static NEA_VRAMBankFlags ne_texture_get_banks(int slot)
+{
+    uintptr_t start = (uintptr_t)NEA_Texture[slot].address;
+    NEAChunk *chunk = ne_texture_find_chunk(NEA_Texture[slot].address);
+    NEA_AssertPointer(chunk, "Texture not found in allocator");
+    uintptr_t end = (uintptr_t)chunk->end;
+
+    int first = (start - (uintptr_t)VRAM_A) / NE_TEXTURE_BANK_SIZE;
+    int last = (end - 1 - (uintptr_t)VRAM_A) / NE_TEXTURE_BANK_SIZE;
+
+    NEA_VRAMBankFlags banks = 0;
+    for (int i = first; i <= last; i++)
+        banks |= 1 << i;
+
+    // The palette index data of compressed textures is always in slot 1
+    if (((NEA_Texture[slot].param >> 26) & 7) == NEA_TEX4X4)
+        banks |= NEA_VRAM_B;
+
+    return banks;
+}
+
+// Looks for free space for a regular texture in the provided banks. Banks next
+// to each other are searched as one range, like the allocator does, so the
+// texture may cross the boundary between them. It returns NULL on error.
+static void *ne_texture_find_space(NEA_VRAMBankFlags banks, size_t size)
+{
+    int i = 0;
+    while (i < 4)
+    {
+        if ((banks & (1 << i)) == 0)
+        {
+            i++;
+            continue;
+        }
+
+        int j = i;
+        while ((j < 4) && (banks & (1 << j)))
+            j++;
+
+        void *addr = NEA_AllocFindInRange(NEA_TexAllocList,
+                                          (void *)ne_texture_bank_start(i),
+                                          (void *)ne_texture_bank_start(j),
+                                          size);
+        if (addr != NULL)
+            return addr;
+
+        i = j;
+    }
+
+    return NULL;
+}
+
+// Moves a texture to free space in the provided banks. VRAM must be unlocked.
+// It returns 1 on success, 0 if there isn't enough space.
+static int ne_texture_relocate(int slot, NEA_VRAMBankFlags banks)
+{
+    void *old02 = NEA_Texture[slot].address;
+    NEAChunk *chunk02 = ne_texture_find_chunk(old02);
+    NEA_AssertPointer(chunk02, "Texture not found in allocator");
+    size_t size02 = (uintptr_t)chunk02->end - (uintptr_t)chunk02->start;
+
+    if (((NEA_Texture[slot].param >> 26) & 7) != NEA_TEX4X4)
+    {
+        void *new_addr = ne_texture_find_space(banks, size02);
+        if ((new_addr == NULL) ||
+            (NEA_AllocAddress(NEA_TexAllocList, new_addr, size02) != 0))
+            return 0;
+
+        ne_texture_move_data(new_addr, old02, size02);
+        NEA_Free(NEA_TexAllocList, old02);
+        ne_texture_set_address(slot, new_addr);
+        return 1;
     }
 
-    if (bank_flags & NEA_VRAM_B)
+    void *old1 = (old02 < (void *)VRAM_B) ?
+                 slot0_to_slot1(old02) : slot2_to_slot1(old02);
+    NEAChunk *chunk1 = ne_texture_find_chunk(old1);
+    NEA_AssertPointer(chunk1, "Texture not found in allocator");
+    size_t size1 = (uintptr_t)chunk1->end - (uintptr_t)chunk1->start;
+
+    // Only the pairs of slots whose banks are both kept can be used
+    uintptr_t best = 0;
+    size_t best_span = SIZE_MAX;
+
+    if ((banks & NEA_VRAM_AB) == NEA_VRAM_AB)
     {
-        vramSetBankB(VRAM_B_TEXTURE_SLOT1);
+        ne_tex4x4_find_pair((uintptr_t)VRAM_A, (uintptr_t)VRAM_B,
+                            (uintptr_t)VRAM_B, size02, size1,
+                            &best, &best_span);
     }
-    else
+    if ((banks & NEA_VRAM_BC) == NEA_VRAM_BC)
     {
-        NEA_AllocAddress(NEA_TexAllocList, VRAM_B, 128 * 1024);
-        NEA_Lock(NEA_TexAllocList, VRAM_B);
+        ne_tex4x4_find_pair((uintptr_t)VRAM_C, (uintptr_t)VRAM_D,
+                            (uintptr_t)VRAM_B + (64 * 1024), size02, size1,
+                            &best, &best_span);
     }
 
-    if (bank_flags & NEA_VRAM_C)
-    {
-        vramSetBankC(VRAM_C_TEXTURE_SLOT2);
-    }
-    else
+    if (best_span == SIZE_MAX)
+        return 0;
+
+    void *new02 = (void *)best;
+    void *new1 = (best < (uintptr_t)VRAM_B) ?
+                 slot0_to_slot1(new02) : slot2_to_slot1(new02);
+
+    if (NEA_AllocAddress(NEA_TexAllocList, new02, size02) != 0)
+        return 0;
+    if (NEA_AllocAddress(NEA_TexAllocList, new1, size1) != 0)
     {
-        NEA_AllocAddress(NEA_TexAllocList, VRAM_C, 128 * 1024);
-        NEA_Lock(NEA_TexAllocList, VRAM_C);
+        NEA_Free(NEA_TexAllocList, new02);
+        return 0;
     }
 
-    if (bank_flags & NEA_VRAM_D)
+    ne_texture_move_data(new02, old02, size02);
+    ne_texture_move_data(new1, old1, size1);
+    NEA_Free(NEA_TexAllocList, old02);
+    NEA_Free(NEA_TexAllocList, old1);
+    ne_texture_set_address(slot, new02);
+    return 1;
+}
+
+int NEA_TextureBanksRelease(NEA_VRAMBankFlags banks)
+{
+    // If the system isn't initialized no bank is used for textures
+    banks &= ne_texture_banks;
+    if (banks == 0)
+        return 1;
+
+    NEA_VRAMBankFlags keep = ne_texture_banks & ~banks;
+    if (keep == 0)
     {
-        vramSetBankD(VRAM_D_TEXTURE_SLOT3);
+        NEA_DebugPrint("Can't release all texture banks");
+        return 0;
     }
-    else
+
+    // Compressed textures need a bank of slot 0 or 2 and bank B
+    bool tex4x4_ok = ((keep & NEA_VRAM_AB) == NEA_VRAM_AB) ||
+                     ((keep & NEA_VRAM_BC) == NEA_VRAM_BC);
+
+    // Check that all textures can be moved before moving any of them
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
     {
-        NEA_AllocAddress(NEA_TexAllocList, VRAM_D, 128 * 1024);
-        NEA_Lock(NEA_TexAllocList, VRAM_D);
-    }
+        if ((NEA_Texture[i].address == NULL) || ne_texture_is_streamed(i))
+            continue;
 
-    GFX_TEX_FORMAT = 0;
+        if ((ne_texture_get_banks(i) & banks) == 0)
+            continue;
 
-    ne_texture_system_inited = true;
-    return 0;
+        // The upload queue has the address of the texture
+        if (NEA_Texture[i].upload_pending)
+        {
+            NEA_DebugPrint("Texture upload pending");
+            return 0;
+        }
 
-cleanup:
-    NEA_DebugPrint("Not enough memory");
-    NEA_PaletteSystemEnd();
-    free(NEA_Texture);
-    free(NEA_UserMaterials);
-    return -1;
-}
+        if (!tex4x4_ok && (((NEA_Texture[i].param >> 26) & 7) == NEA_TEX4X4))
+        {
+            NEA_DebugPrint("No slots left for compressed textures");
+            return 0;
+        }
+    }
 
-void NEA_MaterialDelete(NEA_Material *tex)
-{
-    NEA_AssertPointer(tex, "NULL pointer");
+    // Streamed textures are evicted, they are uploaded again when needed
+    for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+    {
+        if ((NEA_Texture[i].address == NULL) || !ne_texture_is_streamed(i))
+            continue;
 
-    // Delete the palette if it has been flagged to be autodeleted
-    if (tex->palette_autodelete)
-        NEA_PaletteDelete(tex->palette);
+        if (ne_texture_get_banks(i) & banks)
+            ne_texture_free_vram(i);
+    }
 
-    // If there is an asigned texture
-    if (tex->texindex != NEA_NO_TEXTURE)
-        ne_texture_delete(tex->texindex);
+    u32 vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
+                                       VRAM_D_LCD);
+
+    int ret = 1;
 
     for (int i = 0; i < NEA_MAX_TEXTURES; i++)
     {
-        if (NEA_UserMaterials[i] == tex)
+        if (NEA_Texture[i].address == NULL)
+            continue;
+
+        if ((ne_texture_get_banks(i) & banks) == 0)
+            continue;
+
+        if (ne_texture_relocate(i, keep) == 0)
         {
-            NEA_UserMaterials[i] = NULL;
-            free(tex);
-            return;
+            NEA_DebugPrint("Not enough space to move textures");
+            ret = 0;
+            break;
         }
     }
 
-    NEA_DebugPrint("Object not found");
-}
+    vramRestorePrimaryBanks(vramTemp);
 
-int NEA_TextureFreeMem(void)
-{
-    if (!ne_texture_system_inited)
+    ne_texture_gui_invalidate();
+
+    // The textures that have been moved stay in their new place, and all the
+    // banks are kept.
+    if (ret == 0)
         return 0;
 
-    NEAMemInfo info;
-    NEA_MemGetInformation(NEA_TexAllocList, &info);
+    // The banks are empty now. Reserve them like NEA_TextureSystemReset().
+    for (int i = 0; i < 4; i++)
+    {
+        if ((banks & (1 << i)) == 0)
+            continue;
 
-    return info.free;
+        void *start = (void *)ne_texture_bank_start(i);
+        NEA_AllocAddress(NEA_TexAllocList, start, NE_TEXTURE_BANK_SIZE);
+        NEA_Lock(NEA_TexAllocList, start);
+        ne_texture_bank_map(i, false);
+    }
+
+    ne_texture_banks = keep;
+    return 1;
 }
 
-int NEA_TextureFreeMemPercent(void)
+// Internal use... see NEAImpostor.c
+bool ne_impostor_uses_vram_d(void) __attribute__((weak));
+
+int NEA_TextureBanksAcquire(NEA_VRAMBankFlags banks)
 {
     if (!ne_texture_system_inited)
+    {
+        NEA_DebugPrint("Texture system not initialized");
         return 0;
+    }
 
-    NEAMemInfo info;
-    NEA_MemGetInformation(NEA_TexAllocList, &info);
-
-    return info.free_percent;
-}
+    banks &= NEA_VRAM_ABCD & ~ne_texture_banks;
+    if (banks == 0)
+        return 1;
 
-void NEA_TextureDefragMem(void)
-{
-    NEA_Assert(0, "This function doesn't work");
-    return;
-    /*
-    // REALLY OLD CODE -- DOESN'T WORK
+    extern NEA_VRAMBankFlags NEA_Hw2DGetClaimedBanks(void) __attribute__((weak));
+    if (NEA_Hw2DGetClaimedBanks && (NEA_Hw2DGetClaimedBanks() & banks))
+    {
+        NEA_DebugPrint("Bank claimed by Hw2D");
+        return 0;
+    }
 
-    if (!ne_texture_system_inited)
-        return;
+    if ((banks & NEA_VRAM_D) && ne_impostor_uses_vram_d &&
+        ne_impostor_uses_vram_d())
+    {
+        NEA_DebugPrint("VRAM_D is used by impostors");
+        return 0;
+    }
 
-    uint32_t vramTemp = vramSetMainBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
-                                       VRAM_D_LCD);
+    // Same restrictions as NEA_TextureSystemReset()
+    NEA_ExecutionModes mode = NEA_CurrentExecutionMode();
+    NEA_VRAMBankFlags forbidden = 0;
+    if (mode == NEA_ModeSingle3D_TwoPass
+        || mode == NEA_ModeSingle3D_TwoPass_DMA)
+        forbidden = NEA_VRAM_D;
+    else if (mode != NEA_ModeSingle3D)
+        forbidden = NEA_VRAM_CD;
 
-    bool ok = false;
-    while (!ok)
+    if (banks & forbidden)
     {
-        ok = true;
-        int i;
-        for (i = 0; i < NEA_MAX_TEXTURES; i++)
-        {
-            int size = NEA_GetSize(NEA_TexAllocList, (void*)NEA_Texture[i].address);
-            NEA_Free(NEA_TexAllocList,(void*)NEA_Texture[i].address);
-            void *pointer = NEA_Alloc(NEA_TexAllocList, size);
-            // Aligned to 8 bytes
+        NEA_DebugPrint("Bank used by the current execution mode");
+        return 0;
+    }
 
-            NEA_AssertPointer(pointer, "Couldn't reallocate texture");
+    for (int i = 0; i < 4; i++)
+    {
+        if ((banks & (1 << i)) == 0)
+            continue;
 
-            if (pointer != NEA_Texture[i].address)
-            {
-                dmaCopy((void *)NEA_Texture[i].address, pointer, size);
-                NEA_Texture[i].address = pointer;
-                NEA_Texture[i].param &= 0xFFFF0000;
-                NEA_Texture[i].param |= ((uint32_t)pointer >> 3) & 0xFFFF;
-                ok = false;
-            }
-        }
+        void *start = (void *)ne_texture_bank_start(i);
+        NEA_Unlock(NEA_TexAllocList, start);
+        NEA_Free(NEA_TexAllocList, start);
+        ne_texture_bank_map(i, true);
     }
-    vramRestoreMainBanks(vramTemp);
-    */
+
+    ne_texture_banks |= banks;
+    return 1;
 }
 
 void NEA_TextureSystemEnd(void)
@@ -934,22 +2627,36 @@ void NEA_TextureSystemEnd(void)
     if (!ne_texture_system_inited)
         return;
 
-    NEA_AllocEnd(&NEA_TexAllocList);
+    // Weak reference: the atlas of the impostors is a material, and VRAM_D is
+    // given back to the next texture system.
+    extern void NEA_ImpostorSystemEnd(void) __attribute__((weak));
+    if (NEA_ImpostorSystemEnd)
+        NEA_ImpostorSystemEnd();
+
+    ne_upload_cancel_all(false);
 
-    free(NEA_Texture);
+    NEA_AllocEnd(&NEA_TexAllocList);
 
     for (int i = 0; i < NEA_MAX_TEXTURES; i++)
+        free(NEA_Texture[i].stream_path);
+
+    NE_STATIC_FREE(ne_texture_static, NEA_Texture);
+
+    for (int i = 0; i < ne_pool_count(&ne_material_pool); i++)
     {
-        if (NEA_UserMaterials[i])
-            free(NEA_UserMaterials[i]);
+        ne_pool_object_free(&ne_material_pool,
+                            ne_pool_get(&ne_material_pool, i));
     }
 
-    free(NEA_UserMaterials);
+    ne_pool_end(&ne_material_pool);
+    NE_STATIC_FREE(ne_material_names_static, ne_material_names);
 
     NEA_Texture = NULL;
+    ne_material_names = NULL;
 
     NEA_PaletteSystemEnd();
 
+    ne_texture_banks = 0;
     ne_texture_system_inited = false;
 }
 
@@ -1015,8 +2722,8 @@ void NEA_MaterialSetDefaultProperties(u32 diffuse, u32 ambient,
     ne_default_specular_emission = specular | (emission << 16)
                                  | (useshininess << 15);
 
-    GFX_DIFFUSE_AMBIENT = ne_default_diffuse_ambient;
-    GFX_SPECULAR_EMISSION = ne_default_specular_emission;
+    ne_material_state_diffuse_ambient(ne_default_diffuse_ambient);
+    ne_material_state_specular_emission(ne_default_specular_emission);
 }
 
 static u16 *drawingtexture_address = NULL;
@@ -1025,6 +2732,34 @@ static int drawingtexture_type;
 static int drawingtexture_realx;
 static u32 ne_vram_saved;
 
+// Internal use... see NEAImpostor.c. It returns the banks that have been given
+// to the texture allocator.
+NEA_VRAMBankFlags ne_texture_used_banks(void)
+{
+    return ne_texture_banks;
+}
+
+// Internal use... see NEAImpostor.c. It replaces the data of the texture of a
+// material with the upload queue, like the asynchronous loads. The source can
+// be in VRAM in LCD mode. It returns 1 on success, 0 on error.
+int ne_texture_copy_async(const NEA_Material *tex, const void *src,
+                          size_t size, NEA_UploadCallback callback, void *arg)
+{
+    NEA_AssertPointer(tex, "NULL pointer");
+    NEA_Assert(tex->texindex != NEA_NO_TEXTURE,
+               "No texture asigned to material");
+
+    ne_textureinfo_t *info = &NEA_Texture[tex->texindex];
+    if ((info->address == NULL) || info->upload_pending)
+        return 0;
+
+    if (ne_upload_add(false, info->address, src, size, false,
+                      &info->upload_pending, callback, arg) != 0)
+        return 0;
+
+    return 1;
+}
+
 void *NEA_TextureDrawingStart(const NEA_Material *tex)
 {
     NEA_AssertPointer(tex, "NULL pointer");
@@ -1032,6 +2767,8 @@ void *NEA_TextureDrawingStart(const NEA_Material *tex)
 
     NEA_Assert(drawingtexture_address == NULL,
               "Another texture is already active");
+    NEA_Assert(NEA_Texture[tex->texindex].address != NULL,
+              "Texture isn't in VRAM");
 
     drawingtexture_x = NEA_TextureGetSizeX(tex);
     drawingtexture_realx = NEA_TextureGetRealSizeX(tex);
@@ -1076,6 +2813,234 @@ void NEA_TexturePutPixelRGB256(u32 x, u32 y, u8 palettecolor)
     drawingtexture_address[position] |= ((u16) palettecolor) << desp;
 }
 
+// Spans at least this long are filled with DMA instead of with the CPU
+#define NE_TEXTURE_DMA_FILL_MIN 32
+
+static void ne_texture_drawing_check(void)
+{
+    NEA_AssertPointer(drawingtexture_address,
+                     "No texture active for drawing");
+    NEA_Assert(drawingtexture_type == NEA_A1RGB5 ||
+               drawingtexture_type == NEA_PAL256,
+               "Active texture isn't NEA_A1RGB5 or NEA_PAL256");
+}
+
+// Fills the pixels x1 to x2 - 1 of a row. The span must have been clipped.
+static void ne_texture_span(int x1, int x2, int y, u16 value)
+{
+    if (drawingtexture_type == NEA_A1RGB5)
+    {
+        u16 *dst = &drawingtexture_address[x1 + y * drawingtexture_realx];
+        int len = x2 - x1;
+
+        if (len >= NE_TEXTURE_DMA_FILL_MIN)
+        {
+            dmaFillHalfWords(value, dst, len << 1);
+            return;
+        }
+
+        for (int i = 0; i < len; i++)
+            dst[i] = value;
+        return;
+    }
+
+    // 8 bit textures are written one halfword at a time. The halfwords at the
+    // ends of the span may be shared with pixels outside of it.
+    u8 index = value;
+    u16 *row = &drawingtexture_address[(y * drawingtexture_realx) >> 1];
+
+    if (x1 & 1)
+    {
+        row[x1 >> 1] = (row[x1 >> 1] & 0x00FF) | (index << 8);
+        x1++;
+    }
+    if ((x2 & 1) && (x1 < x2))
+    {
+        x2--;
+        row[x2 >> 1] = (row[x2 >> 1] & 0xFF00) | index;
+    }
+
+    int len = (x2 - x1) >> 1; // In halfwords
+    u16 *dst = &row[x1 >> 1];
+    u16 pair = index | (index << 8);
+
+    if (len >= NE_TEXTURE_DMA_FILL_MIN / 2)
+    {
+        dmaFillHalfWords(pair, dst, len << 1);
+        return;
+    }
+
+    for (int i = 0; i < len; i++)
+        dst[i] = pair;
+}
+
+void NEA_TextureDrawSpan(int x, int y, int w, u16 value)
+{
+    ne_texture_drawing_check();
+
+    if ((y < 0) || (y >= drawingtexture_y))
+        return;
+
+    int x1 = (x < 0) ? 0 : x;
+    int x2 = x + w;
+    if (x2 > drawingtexture_x)
+        x2 = drawingtexture_x;
+
+    if (x1 < x2)
+        ne_texture_span(x1, x2, y, value);
+}
+
+void NEA_TextureDrawRect(int x, int y, int w, int h, u16 value)
+{
+    ne_texture_drawing_check();
+
+    int x1 = (x < 0) ? 0 : x;
+    int y1 = (y < 0) ? 0 : y;
+    int x2 = x + w;
+    int y2 = y + h;
+    if (x2 > drawingtexture_x)
+        x2 = drawingtexture_x;
+    if (y2 > drawingtexture_y)
+        y2 = drawingtexture_y;
+
+    if ((x1 >= x2) || (y1 >= y2))
+        return;
+
+    // Full rows are contiguous, fill them all at once
+    if ((x1 == 0) && (x2 == drawingtexture_realx))
+    {
+        int rows = y2 - y1;
+
+        if (drawingtexture_type == NEA_A1RGB5)
+        {
+            dmaFillHalfWords(value, &drawingtexture_address[y1 * x2],
+                             (rows * x2) << 1);
+        }
+        else
+        {
+            u16 pair = (value & 0xFF) | ((value & 0xFF) << 8);
+            dmaFillHalfWords(pair, &drawingtexture_address[(y1 * x2) >> 1],
+                             rows * x2);
+        }
+        return;
+    }
+
+    for (int j = y1; j < y2; j++)
+        ne_texture_span(x1, x2, j, value);
+}
+
+// Writes one pixel that is inside the texture
+static void ne_texture_pixel(int x, int y, u16 value)
+{
+    int pos = x + y * drawingtexture_realx;
+
+    if (drawingtexture_type == NEA_A1RGB5)
+    {
+        drawingtexture_address[pos] = value;
+        return;
+    }
+
+    u16 *dst = &drawingtexture_address[pos >> 1];
+    if (x & 1)
+        *dst = (*dst & 0x00FF) | ((value & 0xFF) << 8);
+    else
+        *dst = (*dst & 0xFF00) | (value & 0xFF);
+}
+
+void NEA_TextureDrawLine(int x1, int y1, int x2, int y2, u16 value)
+{
+    ne_texture_drawing_check();
+
+    int minx = (x1 < x2) ? x1 : x2, maxx = (x1 < x2) ? x2 : x1;
+    int miny = (y1 < y2) ? y1 : y2, maxy = (y1 < y2) ? y2 : y1;
+
+    if ((maxx < 0) || (maxy < 0) || (minx >= drawingtexture_x) ||
+        (miny >= drawingtexture_y))
+        return;
+
+    // Only check each pixel if the line crosses the edges of the texture
+    bool clip = (minx < 0) || (miny < 0) || (maxx >= drawingtexture_x) ||
+                (maxy >= drawingtexture_y);
+
+    int dx = maxx - minx;
+    int dy = -(maxy - miny);
+    int sx = (x1 < x2) ? 1 : -1;
+    int sy = (y1 < y2) ? 1 : -1;
+    int err = dx + dy;
+
+    while (1)
+    {
+        if (!clip || ((x1 >= 0) && (y1 >= 0) && (x1 < drawingtexture_x) &&
+                      (y1 < drawingtexture_y)))
+            ne_texture_pixel(x1, y1, value);
+
+        if ((x1 == x2) && (y1 == y2))
+            break;
+
+        int e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x1 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y1 += sy;
+        }
+    }
+}
+
+void NEA_TextureDrawCircle(int x, int y, int radius, u16 value)
+{
+    ne_texture_drawing_check();
+
+    if (radius < 0)
+        return;
+
+    int r2 = radius * radius + radius; // Rounder edges than radius * radius
+    int dx = radius;
+
+    for (int dy = 0; dy <= radius; dy++)
+    {
+        while ((dx * dx + dy * dy) > r2)
+            dx--;
+
+        NEA_TextureDrawSpan(x - dx, y + dy, 2 * dx + 1, value);
+        if (dy != 0)
+            NEA_TextureDrawSpan(x - dx, y - dy, 2 * dx + 1, value);
+    }
+}
+
+void NEA_TextureDrawStroke(int x1, int y1, int x2, int y2, int radius,
+                           u16 value)
+{
+    ne_texture_drawing_check();
+
+    if (radius <= 0)
+    {
+        NEA_TextureDrawLine(x1, y1, x2, y2, value);
+        return;
+    }
+
+    // Stamp the brush every radius / 2 pixels along the longest axis, so that
+    // there are no gaps between the stamps.
+    int dx = x2 - x1;
+    int dy = y2 - y1;
+    int len = (abs(dx) > abs(dy)) ? abs(dx) : abs(dy);
+    int step = (radius >> 1) + 1;
+    int stamps = len / step + 1;
+
+    for (int i = 0; i < stamps; i++)
+    {
+        int x = x1 + (dx * i) / stamps;
+        int y = y1 + (dy * i) / stamps;
+        NEA_TextureDrawCircle(x, y, radius, value);
+    }
+
+    NEA_TextureDrawCircle(x2, y2, radius, value);
+}
+
 void NEA_TextureDrawingEnd(void)
 {
     NEA_Assert(drawingtexture_address != NULL, "No active texture");
@@ -1087,32 +3052,56 @@ void NEA_TextureDrawingEnd(void)
 
 void NEA_TextureMatrixIdentity(void)
 {
-    MATRIX_CONTROL = GL_TEXTURE;
+    // Nothing has modified the matrix since the last time it was reset
+    if (ne_texture_identity_stamp == ne_texture_matrix_stamp)
+    {
+        ne_material_avoided_writes++;
+        return;
+    }
+
+    NEA_DisplayListWait();
+
+    ne_texture_matrix_stamp++;
+    ne_texture_identity_stamp = ne_texture_matrix_stamp;
+
+    ne_material_state_matrix_mode(GL_TEXTURE);
     MATRIX_IDENTITY = 0;
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 }
 
 void NEA_TextureMatrixTranslateI(int x, int y)
 {
-    MATRIX_CONTROL = GL_TEXTURE;
+    NEA_DisplayListWait();
+
+    ne_texture_matrix_stamp++;
+
+    ne_material_state_matrix_mode(GL_TEXTURE);
     MATRIX_TRANSLATE = x;
     MATRIX_TRANSLATE = y;
     MATRIX_TRANSLATE = 0;
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 }
 
 void NEA_TextureMatrixRotate(int angle)
 {
-    MATRIX_CONTROL = GL_TEXTURE;
+    NEA_DisplayListWait();
+
+    ne_texture_matrix_stamp++;
+
+    ne_material_state_matrix_mode(GL_TEXTURE);
     glRotateZi(angle << 6);
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 }
 
 void NEA_TextureMatrixScaleI(int sx, int sy)
 {
-    MATRIX_CONTROL = GL_TEXTURE;
+    NEA_DisplayListWait();
+
+    ne_texture_matrix_stamp++;
+
+    ne_material_state_matrix_mode(GL_TEXTURE);
     MATRIX_SCALE = sx;
     MATRIX_SCALE = sy;
     MATRIX_SCALE = inttof32(1);
-    MATRIX_CONTROL = GL_MODELVIEW;
+    ne_material_state_matrix_mode(GL_MODELVIEW);
 }
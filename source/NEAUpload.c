@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: MIT
+//
+// Copyright (c) 2026 Warioware64
+//
+// This file is part of Nitro Engine Advanced
+
+#include "NEAMain.h"
+
+/// @file NEAUpload.c
+
+// Size of the blocks copied between checks of the 3D engine state
+#define NE_UPLOAD_BLOCK_SIZE 1024
+
+typedef struct {
+    bool palette;         // Copy to palette VRAM instead of texture VRAM
+    void *dst;
+    const void *src;
+    size_t size;
+    size_t done;          // Bytes already copied
+    bool set_alpha;       // Set the alpha bit of all texels (NEA_RGB5)
+    bool *pending;        // Flag cleared when the copy is finished, or NULL
+    NEA_UploadCallback callback;
+    void *arg;
+} ne_upload_t;
+
+static ne_upload_t ne_upload_queue[NEA_UPLOAD_QUEUE_SIZE];
+static int ne_upload_head;
+static int ne_upload_count;
+static size_t ne_upload_budget = NEA_UPLOAD_DEFAULT_BUDGET;
+
+// Internal use... see NEAPalette.c
+void ne_pal_to_lcd(void);
+void ne_pal_to_tex(void);
+
+// Internal use... see NEATexture.c and NEAPalette.c. It returns 0 on success,
+// -1 if the queue is full.
+int ne_upload_add(bool palette, void *dst, const void *src, size_t size,
+                  bool set_alpha, bool *pending,
+                  NEA_UploadCallback callback, void *arg)
+{
+    if (ne_upload_count == NEA_UPLOAD_QUEUE_SIZE)
+    {
+        NEA_DebugPrint("Upload queue full");
+        return -1;
+    }
+
+    int index = (ne_upload_head + ne_upload_count) % NEA_UPLOAD_QUEUE_SIZE;
+    ne_upload_t *up = &ne_upload_queue[index];
+
+    up->palette = palette;
+    up->dst = dst;
+    up->src = src;
+    up->size = size;
+    up->done = 0;
+    up->set_alpha = set_alpha;
+    up->pending = pending;
+    up->callback = callback;
+    up->arg = arg;
+
+    ne_upload_count++;
+
+    if (pending)
+        *pending = true;
+
+    return 0;
+}
+
+// Removes the pending copies that match a destination address, or all the
+// copies to palettes or to textures if dst is NULL. Their callbacks are called
+// after the queue has been updated, so that they release the source data and
+// they can add more copies.
+static void ne_upload_remove(const void *dst, bool palette)
+{
+    ne_upload_t removed[NEA_UPLOAD_QUEUE_SIZE];
+    int num_removed = 0;
+    int count = 0;
+
+    for (int i = 0; i < ne_upload_count; i++)
+    {
+        int from = (ne_upload_head + i) % NEA_UPLOAD_QUEUE_SIZE;
+        ne_upload_t *up = &ne_upload_queue[from];
+
+        if ((dst != NULL) ? (up->dst == dst) : (up->palette == palette))
+        {
+            if (up->pending)
+                *up->pending = false;
+            removed[num_removed++] = *up;
+            continue;
+        }
+
+        int to = (ne_upload_head + count) % NEA_UPLOAD_QUEUE_SIZE;
+        if (to != from)
+            ne_upload_queue[to] = *up;
+        count++;
+    }
+
+    ne_upload_count = count;
+
+    for (int i = 0; i < num_removed; i++)
+    {
+        if (removed[i].callback)
+            removed[i].callback(removed[i].arg);
+    }
+}
+
+// Internal use... see NEATexture.c and NEAPalette.c. It removes the pending
+// copies to the provided address. It is used when the destination is freed
+// before the copy is finished. The callbacks are still called, because they
+// may have to free the source data.
+void ne_upload_cancel(const void *dst)
+{
+    ne_upload_remove(dst, false);
+}
+
+// Internal use... see NEATexture.c and NEAPalette.c. It removes all pending
+// copies to palettes or to textures, and calls their callbacks.
+void ne_upload_cancel_all(bool palette)
+{
+    ne_upload_remove(NULL, palette);
+}
+
+static void ne_upload_copy(ne_upload_t *up, size_t len)
+{
+    const void *src = (const u8 *)up->src + up->done;
+    void *dst = (u8 *)up->dst + up->done;
+
+    if (up->set_alpha)
+    {
+        // NEA_RGB5 is NEA_A1RGB5 with each alpha bit manually set to 1 during
+        // the copy to VRAM.
+        const uint32_t *s = src;
+        uint32_t *d = dst;
+        for (size_t i = 0; i < len / 4; i++)
+            *d++ = *s++ | ((1 << 15) | (1 << 31));
+    }
+    else
+    {
+        DC_FlushRange(src, len);
+        dmaCopyWords(3, src, dst, len);
+    }
+
+    up->done += len;
+}
+
+static size_t ne_upload_process(size_t budget, bool wait_vblank)
+{
+    size_t copied = 0;
+
+    while ((ne_upload_count > 0) && (copied < budget))
+    {
+        if (wait_vblank && NEA_GPUIsRendering())
+            break;
+
+        ne_upload_t *up = &ne_upload_queue[ne_upload_head];
+
+        // Unlock only the banks that are needed
+        u32 vramTemp = 0;
+        if (!up->palette)
+        {
+            // TODO: Only unlock the banks that Nitro Engine Advanced uses.
+            vramTemp = vramSetPrimaryBanks(VRAM_A_LCD, VRAM_B_LCD, VRAM_C_LCD,
+                                           VRAM_D_LCD);
+        }
+        else
+        {
+            ne_pal_to_lcd();
+        }
+
+        // Copy blocks until the copy is finished, the budget is used or the
+        // 3D engine needs VRAM again.
+        while ((up->done < up->size) && (copied < budget))
+        {
+            if (wait_vblank && NEA_GPUIsRendering())
+                break;
+
+            size_t len = up->size - up->done;
+            if (len > NE_UPLOAD_BLOCK_SIZE)
+                len = NE_UPLOAD_BLOCK_SIZE;
+
+            ne_upload_copy(up, len);
+            copied += len;
+        }
+
+        if (!up->palette)
+            vramRestorePrimaryBanks(vramTemp);
+        else
+            ne_pal_to_tex();
+
+        if (up->done < up->size)
+            break;
+
+        // The copy has finished. Remove it from the queue before calling the
+        // callback, which may add more copies.
+        ne_upload_t finished = *up;
+        ne_upload_head = (ne_upload_head + 1) % NEA_UPLOAD_QUEUE_SIZE;
+        ne_upload_count--;
+
+        if (finished.pending)
+        {
+            *finished.pending = false;
+
+            // The GUI keeps a copy of the texture format of its materials
+            extern void NEA_GUIInvalidate(void) __attribute__((weak));
+            if (NEA_GUIInvalidate)
+                NEA_GUIInvalidate();
+        }
+
+        if (finished.callback)
+            finished.callback(finished.arg);
+    }
+
+    return copied;
+}
+
+void NEA_UploadSetBudget(size_t bytes)
+{
+    if (bytes == 0)
+        bytes = NEA_UPLOAD_DEFAULT_BUDGET;
+
+    ne_upload_budget = bytes;
+}
+
+size_t NEA_UploadUpdate(void)
+{
+    return ne_upload_process(ne_upload_budget, true);
+}
+
+void NEA_UploadFlush(void)
+{
+    ne_upload_process(SIZE_MAX, false);
+}
+
+size_t NEA_UploadGetPendingSize(void)
+{
+    size_t size = 0;
+
+    for (int i = 0; i < ne_upload_count; i++)
+    {
+        const ne_upload_t *up =
+                &ne_upload_queue[(ne_upload_head + i) % NEA_UPLOAD_QUEUE_SIZE];
+        size += up->size - up->done;
+    }
+
+    return size;
+}
@@ -11,6 +11,13 @@
 // Because of Nitro Engine Advanced's safe dual 3D mode, it is required to use Nitro
 // Engine's functions to draw display lists instead of relying on libnds.
 #include "NEAMain.h"
+#include "NEA_POSE_IPC.h"
+#include "../NEAStats.h"
+
+// Internal use... see NEAPoseService.c
+const NEA_POSE_Request *ne_pose_service_find(const void *dsa_file,
+                                             uint32_t frame_interp)
+                                             __attribute__((weak));
 
 // Format of a joint in a DSA file.
 typedef struct {
@@ -19,6 +26,7 @@ typedef struct {
 } dsa_joint_t;
 
 #define DSA_VERSION_NUMBER 1
+#define DSA_VERSION_REDUCED 2
 
 // Format of a DSA file.
 typedef struct {
@@ -28,6 +36,106 @@ typedef struct {
     dsa_joint_t joints[0]; // Array of joints
 } dsa_t;
 
+// Flags of a joint in a reduced DSA file.
+#define DSA_JOINT_POS_ANIMATED      (1 << 0)
+#define DSA_JOINT_ORIENT_ANIMATED   (1 << 1)
+
+// Format of a joint in a reduced DSA file. The parts that are constant during
+// the whole animation are stored here instead of in every key.
+typedef struct {
+    int32_t pos[3];    // Constant translation (x, y, z)
+    int16_t orient[4]; // Constant orientation (w, x, y, z)
+    uint16_t flags;    // DSA_JOINT_* flags
+    uint16_t offset;   // Offset of the animated data of the joint in a key
+} dsa2_joint_t;
+
+// Format of a reduced DSA file (version 2).
+//
+// Only some frames (keys) are stored, the others are interpolated from the
+// keys around them. The first and last frames are always keys. The header is
+// followed by:
+//
+//     uint16_t key_frame[num_keys]; // Padded to a multiple of 4 bytes
+//     dsa2_joint_t joints[num_joints];
+//     uint8_t keys[num_keys][key_size];
+//
+// Each key has the animated data of every joint, in order: int32_t pos[3] if
+// DSA_JOINT_POS_ANIMATED is set, followed by int16_t orient[4] if
+// DSA_JOINT_ORIENT_ANIMATED is set.
+typedef struct {
+    uint32_t version;    // Version number
+    uint32_t num_frames; // Frames of the animation
+    uint32_t num_joints; // Joints per frame
+    uint32_t num_keys;   // Frames stored in the file
+    uint32_t key_size;   // Size of one key in bytes
+    uint16_t key_frame[0];
+} dsa2_t;
+
+// State needed to read the joints of a DSA file at one frame.
+typedef struct {
+    uint32_t num_joints;
+    uint32_t interp;
+    const dsa_joint_t *frame_1; // Version 1
+    const dsa_joint_t *frame_2;
+    const dsa2_joint_t *joints; // Version 2 (NULL in version 1)
+    const uint8_t *key_1;
+    const uint8_t *key_2;
+} dsa_sampler_t;
+
+// Format of a file with baked joint matrices. The header is followed by one
+// 4x3 matrix per joint for every frame of the animation.
+typedef struct {
+    uint32_t magic;      // DSMA_BAKED_MAGIC
+    uint32_t num_frames; // Frames of the animation
+    uint32_t num_joints; // Joints per frame
+    uint32_t reserved;
+    int32_t matrix[0][12];
+} dsa_baked_t;
+
+// Max number of joints of a model. The hardware matrix stack has 31 entries.
+#define DSMA_MAX_JOINTS 30
+
+// Joint matrices of a pose that has been used recently. They are relative to
+// the matrix of the model, so they can be shared by all models drawn with the
+// same animation at the same frame.
+typedef struct {
+    const void *dsa_file; // NULL if the entry is free
+    uint32_t frame_interp;
+    int32_t matrix[DSMA_MAX_JOINTS][12];
+} dsma_pose_t;
+
+static dsma_pose_t dsma_pose_cache[DSMA_POSE_CACHE_ENTRIES];
+static uint32_t dsma_pose_cache_next; // Next entry to replace
+
+// Max number of joints of one bone batch of a DSM file.
+#define DSM_BATCH_MAX_JOINTS 32
+
+// Format of a bone batch of a DSM file.
+typedef struct {
+    uint32_t dl_offset;  // Offset of the display list from the start of the file
+    uint32_t num_joints; // Joints used by the batch
+    uint8_t joint[DSM_BATCH_MAX_JOINTS]; // Joint that goes to each matrix
+} dsm_batch_t;
+
+// Format of a DSM file split in bone batches. Each batch only uses the
+// matrices of up to 'window' joints, which are stored in the last 'window'
+// entries of the matrix stack before drawing its display list.
+typedef struct {
+    uint32_t magic;       // DSMA_BATCHED_MAGIC
+    uint32_t num_batches; // Number of batches
+    uint32_t window;      // Matrix stack entries used by each batch
+    uint32_t reserved;
+    dsm_batch_t batch[0];
+} dsm_batched_t;
+
+// Joint matrices of the pose of the model that is drawn in batches. They are
+// written and read for every batch, so they go to DTCM if the library is built
+// with NEA_ITCM (see NEATCM.h).
+#ifdef NEA_ITCM
+DTCM_BSS
+#endif
+static int32_t dsma_batch_matrix[DSMA_MAX_BATCHED_JOINTS][12];
+
 // Private functions
 // =================
 
@@ -40,10 +148,9 @@ int32_t mulf32_by_2(int32_t a, int32_t b)
 }
 
 // Generates a 4x3 matrix from the orientation in the provided quaternion and
-// the translation in the provided vector. Then, it multiplies the matrix that
-// is currently active in the geometry engine by the generated matrix.
+// the translation in the provided vector, and stores it in 'm'.
 ITCM_CODE ARM_CODE static inline
-void matrix_mult_by_joint(const int32_t *v, const int32_t *q)
+void joint_to_matrix(const int32_t *v, const int32_t *q, int32_t *m)
 {
     int32_t wx = mulf32_by_2(q[0], q[1]);
     int32_t wy = mulf32_by_2(q[0], q[2]);
@@ -55,21 +162,41 @@ void matrix_mult_by_joint(const int32_t *v, const int32_t *q)
     int32_t yz = mulf32_by_2(q[2], q[3]);
     int32_t z2 = mulf32_by_2(q[3], q[3]);
 
-    MATRIX_MULT4x3 = inttof32(1) - y2 - z2;
-    MATRIX_MULT4x3 = xy + wz;
-    MATRIX_MULT4x3 = xz - wy;
+    m[0] = inttof32(1) - y2 - z2;
+    m[1] = xy + wz;
+    m[2] = xz - wy;
+
+    m[3] = xy - wz;
+    m[4] = inttof32(1) - x2 - z2;
+    m[5] = yz + wx;
 
-    MATRIX_MULT4x3 = xy - wz;
-    MATRIX_MULT4x3 = inttof32(1) - x2 - z2;
-    MATRIX_MULT4x3 = yz + wx;
+    m[6] = xz + wy;
+    m[7] = yz - wx;
+    m[8] = inttof32(1) - x2 - y2;
 
-    MATRIX_MULT4x3 = xz + wy;
-    MATRIX_MULT4x3 = yz - wx;
-    MATRIX_MULT4x3 = inttof32(1) - x2 - y2;
+    m[9] = v[0];
+    m[10] = v[1];
+    m[11] = v[2];
+}
 
-    MATRIX_MULT4x3 = v[0];
-    MATRIX_MULT4x3 = v[1];
-    MATRIX_MULT4x3 = v[2];
+// Multiplies the matrix that is currently active in the geometry engine by the
+// provided 4x3 matrix.
+ITCM_CODE ARM_CODE static inline
+void matrix_mult_4x3(const int32_t *m)
+{
+    for (int i = 0; i < 12; i++)
+        MATRIX_MULT4x3 = m[i];
+}
+
+// Generates a 4x3 matrix from the orientation in the provided quaternion and
+// the translation in the provided vector. Then, it multiplies the matrix that
+// is currently active in the geometry engine by the generated matrix.
+ITCM_CODE ARM_CODE static inline
+void matrix_mult_by_joint(const int32_t *v, const int32_t *q)
+{
+    int32_t m[12];
+    joint_to_matrix(v, q, m);
+    matrix_mult_4x3(m);
 }
 
 // Gets a pointer to the list of joints of the specified frame.
@@ -118,31 +245,218 @@ void dsa_interpolate_frames(const int32_t *v_pos_1, const int32_t *q_orient_1,
     q_nlerp(q_orient_1, q_orient_2, interp, q_orient);
 }
 
+// Prepares a sampler to read the joints of a DSA file at the specified frame.
+// It returns a DSMA_* code.
+ITCM_CODE ARM_CODE static inline
+int dsa_sampler_init(dsa_sampler_t *s, const void *dsa_file,
+                     uint32_t frame_interp)
+{
+    const dsa_t *dsa = dsa_file;
+
+    if ((dsa->version != DSA_VERSION_NUMBER) &&
+        (dsa->version != DSA_VERSION_REDUCED))
+        return DSMA_INVALID_VERSION;
+
+    uint32_t num_frames = dsa->num_frames;
+
+    uint32_t frame = frame_interp >> 12;
+    uint32_t interp = frame_interp & 0xFFF;
+
+    if (frame >= num_frames)
+        return DSMA_INVALID_FRAME;
+
+    s->num_joints = dsa->num_joints;
+
+    if (dsa->version == DSA_VERSION_NUMBER)
+    {
+        uint32_t next_frame = frame + 1;
+        if (next_frame == num_frames)
+            next_frame = 0;
+
+        s->interp = interp;
+        s->frame_1 = dsa_get_frame(dsa, frame);
+        s->frame_2 = dsa_get_frame(dsa, next_frame);
+        s->joints = NULL;
+
+        return DSMA_SUCCESS;
+    }
+
+    const dsa2_t *dsa2 = dsa_file;
+    uint32_t num_keys = dsa2->num_keys;
+    const uint16_t *key_frame = dsa2->key_frame;
+
+    const dsa2_joint_t *joints =
+            (const dsa2_joint_t *)&key_frame[(num_keys + 1) & ~1];
+    const uint8_t *keys = (const uint8_t *)&joints[s->num_joints];
+
+    // Look for the last key that isn't after the frame. The first key is
+    // always frame 0.
+    uint32_t lo = 0;
+    uint32_t hi = num_keys;
+    while ((hi - lo) > 1)
+    {
+        uint32_t mid = (lo + hi) >> 1;
+        if (key_frame[mid] <= frame)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    // After the last key the animation goes back to frame 0
+    uint32_t next_key = lo + 1;
+    uint32_t end_frame;
+    if (next_key == num_keys)
+    {
+        next_key = 0;
+        end_frame = num_frames;
+    }
+    else
+    {
+        end_frame = key_frame[next_key];
+    }
+
+    // Convert the position between frames into a position between keys
+    uint32_t start_frame = key_frame[lo];
+    uint32_t len = end_frame - start_frame;
+    if (len > 1)
+        interp = (((frame - start_frame) << 12) + interp) / len;
+
+    s->interp = interp;
+    s->joints = joints;
+    s->key_1 = keys + lo * dsa2->key_size;
+    s->key_2 = keys + next_key * dsa2->key_size;
+
+    return DSMA_SUCCESS;
+}
+
+// Gets the position and orientation of a joint from a sampler.
+ITCM_CODE ARM_CODE static inline
+void dsa_sampler_joint(const dsa_sampler_t *s, uint32_t index,
+                       int32_t *v_pos, int32_t *q_orient)
+{
+    uint32_t interp = s->interp;
+
+    if (s->joints == NULL)
+    {
+        const dsa_joint_t *joint_1 = &s->frame_1[index];
+
+        if (interp == 0)
+        {
+            for (int i = 0; i < 3; i++)
+                v_pos[i] = joint_1->pos[i];
+            for (int i = 0; i < 4; i++)
+                q_orient[i] = joint_1->orient[i];
+            return;
+        }
+
+        const dsa_joint_t *joint_2 = &s->frame_2[index];
+
+        dsa_interpolate_frames(&joint_1->pos[0], &joint_1->orient[0],
+                               &joint_2->pos[0], &joint_2->orient[0],
+                               interp, v_pos, q_orient);
+        return;
+    }
+
+    const dsa2_joint_t *joint = &s->joints[index];
+    uint32_t offset = joint->offset;
+
+    if (joint->flags & DSA_JOINT_POS_ANIMATED)
+    {
+        const int32_t *pos_1 = (const int32_t *)(s->key_1 + offset);
+        const int32_t *pos_2 = (const int32_t *)(s->key_2 + offset);
+
+        for (int i = 0; i < 3; i++)
+            v_pos[i] = lerp(pos_1[i], pos_2[i], interp);
+
+        offset += 3 * sizeof(int32_t);
+    }
+    else
+    {
+        for (int i = 0; i < 3; i++)
+            v_pos[i] = joint->pos[i];
+    }
+
+    if (joint->flags & DSA_JOINT_ORIENT_ANIMATED)
+    {
+        const int16_t *orient_1 = (const int16_t *)(s->key_1 + offset);
+        const int16_t *orient_2 = (const int16_t *)(s->key_2 + offset);
+
+        for (int i = 0; i < 4; i++)
+            q_orient[i] = lerp(orient_1[i], orient_2[i], interp);
+    }
+    else
+    {
+        for (int i = 0; i < 4; i++)
+            q_orient[i] = joint->orient[i];
+    }
+}
+
+// Returns the cached pose of an animation at the specified frame, or NULL if
+// it isn't in the cache.
+ITCM_CODE ARM_CODE static inline
+const dsma_pose_t *dsma_pose_cache_find(const void *dsa_file,
+                                        uint32_t frame_interp)
+{
+    for (int i = 0; i < DSMA_POSE_CACHE_ENTRIES; i++)
+    {
+        const dsma_pose_t *pose = &dsma_pose_cache[i];
+
+        if ((pose->dsa_file == dsa_file) && (pose->frame_interp == frame_interp))
+            return pose;
+    }
+
+    return NULL;
+}
+
 // Public functions
 // ================
 
+void DSMA_PoseCacheClear(void)
+{
+    for (int i = 0; i < DSMA_POSE_CACHE_ENTRIES; i++)
+        dsma_pose_cache[i].dsa_file = NULL;
+
+    dsma_pose_cache_next = 0;
+}
+
 uint32_t DSMA_GetNumFrames(const void *dsa_file)
 {
     const dsa_t *dsa = dsa_file;
     return dsa->num_frames;
 }
 
-ITCM_CODE ARM_CODE
-int DSMA_PrepareBones(const void *dsa_file, uint32_t frame_interp)
+size_t DSMA_GetSize(const void *dsa_file)
 {
     const dsa_t *dsa = dsa_file;
 
-    if (dsa->version != DSA_VERSION_NUMBER)
-        return DSMA_INVALID_VERSION;
+    if (dsa->version != DSA_VERSION_REDUCED)
+    {
+        return sizeof(dsa_t)
+               + dsa->num_frames * dsa->num_joints * sizeof(dsa_joint_t);
+    }
 
-    uint32_t num_joints = dsa->num_joints;
-    uint32_t num_frames = dsa->num_frames;
+    const dsa2_t *dsa2 = dsa_file;
 
-    uint32_t frame = frame_interp >> 12;
-    uint32_t interp = frame_interp & 0xFFF;
+    return sizeof(dsa2_t)
+           + ((dsa2->num_keys + 1) & ~1) * sizeof(uint16_t)
+           + dsa2->num_joints * sizeof(dsa2_joint_t)
+           + dsa2->num_keys * dsa2->key_size;
+}
 
-    if (frame >= num_frames)
-        return DSMA_INVALID_FRAME;
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBones(const void *dsa_file, uint32_t frame_interp)
+{
+    NEA_DisplayListWait();
+
+    dsa_sampler_t sampler;
+    int ret = dsa_sampler_init(&sampler, dsa_file, frame_interp);
+    if (ret != DSMA_SUCCESS)
+        return ret;
+
+    uint32_t num_joints = sampler.num_joints;
+
+    if (num_joints > DSMA_MAX_JOINTS)
+        return DSMA_MATRIX_STACK_FULL;
 
     // Make sure that there is enough space in the matrix stack
     // --------------------------------------------------------
@@ -158,70 +472,289 @@ int DSMA_PrepareBones(const void *dsa_file, uint32_t frame_interp)
 
     MATRIX_PUSH = 0;
 
+    // Reuse the matrices of a model that has been drawn with the same pose
+    // --------------------------------------------------------------------
+
+    const dsma_pose_t *cached = dsma_pose_cache_find(dsa_file, frame_interp);
+    if (cached != NULL)
+    {
+        for (uint32_t i = 0; i < num_joints; i++)
+        {
+            MATRIX_RESTORE = curr_stack_level;
+            matrix_mult_4x3(cached->matrix[i]);
+            MATRIX_STORE = base_matrix + i;
+        }
+
+        return DSMA_SUCCESS;
+    }
+
+    // The new pose replaces the oldest entry of the cache
+    dsma_pose_t *pose = &dsma_pose_cache[dsma_pose_cache_next];
+    dsma_pose_cache_next = (dsma_pose_cache_next + 1) % DSMA_POSE_CACHE_ENTRIES;
+
+    pose->dsa_file = dsa_file;
+    pose->frame_interp = frame_interp;
+
+    NE_STAT_ADD(bone_matrices, num_joints);
+
+    // The ARM7 may have interpolated the joints already (see NEAPoseService.h)
+    const NEA_POSE_Request *arm7_pose = NULL;
+    if (ne_pose_service_find != NULL)
+        arm7_pose = ne_pose_service_find(dsa_file, frame_interp);
+
     // Generate matrices with bone transformations
     // -------------------------------------------
 
-    if (interp != 0)
+    for (uint32_t i = 0; i < num_joints; i++)
     {
-        uint32_t next_frame = frame + 1;
-        if (next_frame == num_frames)
-            next_frame = 0;
+        int32_t v_pos[3];
+        int32_t q_orient[4];
+
+        if (arm7_pose != NULL)
+        {
+            for (int j = 0; j < 3; j++)
+                v_pos[j] = arm7_pose->pos[i][j];
+            for (int j = 0; j < 4; j++)
+                q_orient[j] = arm7_pose->orient[i][j];
+        }
+        else
+        {
+            dsa_sampler_joint(&sampler, i, &v_pos[0], &q_orient[0]);
+        }
+
+        // Generate new matrix
+        joint_to_matrix(v_pos, q_orient, pose->matrix[i]);
+        MATRIX_RESTORE = curr_stack_level;
+        matrix_mult_4x3(pose->matrix[i]);
+
+        // Store it in the right position in the stack
+        MATRIX_STORE = base_matrix + i;
+    }
+
+    return DSMA_SUCCESS;
+}
+
+int DSMA_GetJointTransform(const void *dsa_file, uint32_t frame_interp,
+                           uint32_t joint, int32_t *pos, int32_t *orient)
+{
+    dsa_sampler_t sampler;
+    int ret = dsa_sampler_init(&sampler, dsa_file, frame_interp);
+    if (ret != DSMA_SUCCESS)
+        return ret;
+
+    if (joint >= sampler.num_joints)
+        return DSMA_INVALID_JOINT;
+
+    dsa_sampler_joint(&sampler, joint, pos, orient);
+
+    return DSMA_SUCCESS;
+}
+
+size_t DSMA_GetBakedSize(const void *dsa_file)
+{
+    const dsa_t *dsa = dsa_file;
+
+    return sizeof(dsa_baked_t)
+           + dsa->num_frames * dsa->num_joints * 12 * sizeof(int32_t);
+}
+
+int DSMA_BakeMatrices(const void *dsa_file, void *dest)
+{
+    const dsa_t *dsa = dsa_file;
+    dsa_baked_t *baked = dest;
+
+    uint32_t num_frames = dsa->num_frames;
+    uint32_t num_joints = dsa->num_joints;
+
+    int32_t (*m)[12] = baked->matrix;
 
-        const dsa_joint_t *frame_ptr_1 = dsa_get_frame(dsa, frame);
-        const dsa_joint_t *frame_ptr_2 = dsa_get_frame(dsa, next_frame);
+    for (uint32_t f = 0; f < num_frames; f++)
+    {
+        dsa_sampler_t sampler;
+        int ret = dsa_sampler_init(&sampler, dsa_file, f << 12);
+        if (ret != DSMA_SUCCESS)
+            return ret;
 
         for (uint32_t i = 0; i < num_joints; i++)
         {
             int32_t v_pos[3];
             int32_t q_orient[4];
 
-            dsa_interpolate_frames(&frame_ptr_1->pos[0],
-                                   &frame_ptr_1->orient[0],
-                                   &frame_ptr_2->pos[0],
-                                   &frame_ptr_2->orient[0],
-                                   interp, &v_pos[0], &q_orient[0]);
-            frame_ptr_1++;
-            frame_ptr_2++;
+            dsa_sampler_joint(&sampler, i, &v_pos[0], &q_orient[0]);
+            joint_to_matrix(v_pos, q_orient, *m);
+            m++;
+        }
+    }
 
-            // Generate new matrix
-            MATRIX_RESTORE = curr_stack_level;
-            matrix_mult_by_joint(v_pos, q_orient);
+    baked->magic = DSMA_BAKED_MAGIC;
+    baked->num_frames = num_frames;
+    baked->num_joints = num_joints;
+    baked->reserved = 0;
 
-            // Store it in the right position in the stack
-            MATRIX_STORE = base_matrix + i;
-        }
+    return DSMA_SUCCESS;
+}
+
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBonesBaked(const void *dsa_file, const void *baked_file,
+                           uint32_t frame_interp)
+{
+    // Frames between two keyframes can't use the baked matrices
+    if ((baked_file == NULL) || ((frame_interp & 0xFFF) != 0))
+        return DSMA_PrepareBones(dsa_file, frame_interp);
+
+    NEA_DisplayListWait();
+
+    const dsa_t *dsa = dsa_file;
+    const dsa_baked_t *baked = baked_file;
+
+    if (baked->magic != DSMA_BAKED_MAGIC)
+        return DSMA_INVALID_VERSION;
+
+    uint32_t num_joints = baked->num_joints;
+
+    if ((num_joints != dsa->num_joints) || (baked->num_frames != dsa->num_frames))
+        return DSMA_INCOMPATIBLE_ANIMATIONS;
+
+    if (num_joints > DSMA_MAX_JOINTS)
+        return DSMA_MATRIX_STACK_FULL;
+
+    uint32_t frame = frame_interp >> 12;
+
+    if (frame >= baked->num_frames)
+        return DSMA_INVALID_FRAME;
+
+    // Make sure that there is enough space in the matrix stack
+    // --------------------------------------------------------
+
+    uint32_t base_matrix = 30 - num_joints + 1;
+
+    // Wait for matrix push/pop operations to end
+    while (GFX_STATUS & BIT(14));
+
+    uint32_t curr_stack_level = (GFX_STATUS >> 8) & 0x1F;
+    if (curr_stack_level >= base_matrix)
+        return DSMA_MATRIX_STACK_FULL;
+
+    MATRIX_PUSH = 0;
+
+    // Load the matrices of the frame
+    // ------------------------------
+
+    const int32_t (*m)[12] = &baked->matrix[frame * num_joints];
+
+    for (uint32_t i = 0; i < num_joints; i++)
+    {
+        MATRIX_RESTORE = curr_stack_level;
+        matrix_mult_4x3(m[i]);
+        MATRIX_STORE = base_matrix + i;
     }
-    else
+
+    return DSMA_SUCCESS;
+}
+
+void DSMA_FinishDraw(void)
+{
+    NEA_DisplayListWait();
+
+    MATRIX_POP = 1;
+}
+
+// Draws all bone batches of a DSM file with the joint matrices that have been
+// generated in dsma_batch_matrix.
+ITCM_CODE ARM_CODE static
+int dsma_draw_batches(const void *dsm_file, uint32_t num_joints)
+{
+    const dsm_batched_t *dsm = dsm_file;
+
+    uint32_t window = dsm->window;
+
+    if ((window == 0) || (window > DSMA_MAX_JOINTS))
+        return DSMA_INVALID_VERSION;
+
+    // Make sure that there is enough space in the matrix stack
+    // --------------------------------------------------------
+
+    uint32_t base_matrix = 30 - window + 1;
+
+    // Wait for matrix push/pop operations to end
+    while (GFX_STATUS & BIT(14));
+
+    uint32_t curr_stack_level = (GFX_STATUS >> 8) & 0x1F;
+    if (curr_stack_level >= base_matrix)
+        return DSMA_MATRIX_STACK_FULL;
+
+    MATRIX_PUSH = 0;
+
+    // Upload the matrices of each batch and draw it
+    // ---------------------------------------------
+
+    const uint8_t *file = dsm_file;
+
+    for (uint32_t b = 0; b < dsm->num_batches; b++)
     {
-        const dsa_joint_t *frame_ptr = dsa_get_frame(dsa, frame);
+        const dsm_batch_t *batch = &dsm->batch[b];
 
-        for (uint32_t i = 0; i < num_joints; i++)
+        // The display list of the previous batch may still be in progress
+        NEA_DisplayListWait();
+
+        for (uint32_t i = 0; i < batch->num_joints; i++)
         {
-            // Get transformation
-            const int32_t *v_pos = frame_ptr->pos;
-            const int32_t *q_orient = frame_ptr->orient;
-            frame_ptr++;
+            uint32_t joint = batch->joint[i];
+            if ((joint >= num_joints) || (i >= window))
+            {
+                DSMA_FinishDraw();
+                return DSMA_INCOMPATIBLE_ANIMATIONS;
+            }
 
-            // Generate new matrix
             MATRIX_RESTORE = curr_stack_level;
-            matrix_mult_by_joint(v_pos, q_orient);
-
-            // Store it in the right position in the stack
+            matrix_mult_4x3(dsma_batch_matrix[joint]);
             MATRIX_STORE = base_matrix + i;
         }
+
+        NEA_DisplayListDrawDefault(file + batch->dl_offset);
     }
 
+    DSMA_FinishDraw();
+
     return DSMA_SUCCESS;
 }
 
-void DSMA_FinishDraw(void)
+bool DSMA_IsBatched(const void *dsm_file)
 {
-    MATRIX_POP = 1;
+    const uint32_t *dsm = dsm_file;
+    return dsm[0] == DSMA_BATCHED_MAGIC;
 }
 
 ITCM_CODE ARM_CODE
 int DSMA_DrawModel(const void *dsm_file, const void *dsa_file, uint32_t frame_interp)
 {
+    if (DSMA_IsBatched(dsm_file))
+    {
+        NEA_DisplayListWait();
+
+        dsa_sampler_t sampler;
+        int ret = dsa_sampler_init(&sampler, dsa_file, frame_interp);
+        if (ret != DSMA_SUCCESS)
+            return ret;
+
+        uint32_t num_joints = sampler.num_joints;
+        if (num_joints > DSMA_MAX_BATCHED_JOINTS)
+            return DSMA_MATRIX_STACK_FULL;
+
+        NE_STAT_ADD(bone_matrices, num_joints);
+
+        for (uint32_t i = 0; i < num_joints; i++)
+        {
+            int32_t v_pos[3];
+            int32_t q_orient[4];
+
+            dsa_sampler_joint(&sampler, i, &v_pos[0], &q_orient[0]);
+            joint_to_matrix(v_pos, q_orient, dsma_batch_matrix[i]);
+        }
+
+        return dsma_draw_batches(dsm_file, num_joints);
+    }
+
     int ret = DSMA_PrepareBones(dsa_file, frame_interp);
     if (ret != DSMA_SUCCESS)
         return ret;
@@ -232,42 +765,170 @@ int DSMA_DrawModel(const void *dsm_file, const void *dsa_file, uint32_t frame_in
     return DSMA_SUCCESS;
 }
 
-ITCM_CODE ARM_CODE
-int DSMA_PrepareBonesBlend(const void *dsa_file_1, uint32_t frame_interp_1,
-        const void *dsa_file_2, uint32_t frame_interp_2,
-        uint32_t blend)
+// State of one layer of a layered pose.
+typedef struct {
+    dsa_sampler_t sampler;
+    const void *dsa_file;
+    uint32_t frame_interp;
+    uint32_t weight;
+    const uint16_t *mask;
+    int same_as; // Layer below with the same animation and frame, or -1
+} dsma_layer_state_t;
+
+// Prepares the layers that affect a layered pose. Layers that the ones above
+// them hide completely, and layers with weight 0, are dropped. It returns a
+// DSMA_* code, and the number of layers left in 'count'.
+ITCM_CODE ARM_CODE static
+int dsma_layers_init(dsma_layer_state_t *state, int *count,
+                     uint32_t *num_joints, const DSMA_Layer *layers,
+                     int num_layers)
 {
-    const dsa_t *dsa_1 = dsa_file_1;
-    const dsa_t *dsa_2 = dsa_file_2;
+    if ((num_layers < 1) || (num_layers > DSMA_MAX_LAYERS))
+        return DSMA_INVALID_BLENDING;
 
-    if (dsa_1->version != DSA_VERSION_NUMBER)
-        return DSMA_INVALID_VERSION;
+    int first = 0;
 
-    if (dsa_2->version != DSA_VERSION_NUMBER)
-        return DSMA_INVALID_VERSION;
+    for (int l = 0; l < num_layers; l++)
+    {
+        if (layers[l].weight > inttof32(1))
+            return DSMA_INVALID_BLENDING;
 
-    uint32_t num_joints = dsa_1->num_joints;
+        if ((l > 0) && (layers[l].weight == inttof32(1)) &&
+            (layers[l].mask == NULL))
+            first = l;
+    }
 
-    if (num_joints != dsa_2->num_joints)
-        return DSMA_INCOMPATIBLE_ANIMATIONS;
+    int n = 0;
 
-    uint32_t num_frames_1 = dsa_1->num_frames;
-    uint32_t num_frames_2 = dsa_2->num_frames;
+    for (int l = first; l < num_layers; l++)
+    {
+        const DSMA_Layer *layer = &layers[l];
 
-    uint32_t frame_1 = frame_interp_1 >> 12;
-    uint32_t interp_1 = frame_interp_1 & 0xFFF;
+        if ((l > first) && (layer->weight == 0))
+            continue;
 
-    if (frame_1 >= num_frames_1)
-        return DSMA_INVALID_FRAME;
+        // A layer on top of the same pose doesn't change it
+        int same_as = -1;
+        for (int i = 0; i < n; i++)
+        {
+            if ((state[i].dsa_file == layer->dsa_file) &&
+                (state[i].frame_interp == layer->frame_interp))
+            {
+                same_as = i;
+                break;
+            }
+        }
+        if ((same_as == 0) && (n == 1))
+            continue;
 
-    uint32_t frame_2 = frame_interp_2 >> 12;
-    uint32_t interp_2 = frame_interp_2 & 0xFFF;
+        dsma_layer_state_t *st = &state[n];
 
-    if (frame_2 >= num_frames_2)
-        return DSMA_INVALID_FRAME;
+        int ret = dsa_sampler_init(&st->sampler, layer->dsa_file,
+                                   layer->frame_interp);
+        if (ret != DSMA_SUCCESS)
+            return ret;
 
-    if (blend > inttof32(1))
-        return DSMA_INVALID_BLENDING;
+        if ((n > 0) && (st->sampler.num_joints != state[0].sampler.num_joints))
+            return DSMA_INCOMPATIBLE_ANIMATIONS;
+
+        st->dsa_file = layer->dsa_file;
+        st->frame_interp = layer->frame_interp;
+        st->weight = layer->weight;
+        st->mask = layer->mask;
+        st->same_as = same_as;
+        n++;
+    }
+
+    *count = n;
+    *num_joints = state[0].sampler.num_joints;
+
+    return DSMA_SUCCESS;
+}
+
+// Gets the position and orientation of a joint of a layered pose.
+ITCM_CODE ARM_CODE static inline
+void dsma_layers_joint(const dsma_layer_state_t *state, int count,
+                       uint32_t joint, int32_t *v_pos, int32_t *q_orient)
+{
+    int32_t weight[DSMA_MAX_LAYERS];
+
+    // Start from the last layer that hides the ones below it in this joint
+    int first = 0;
+    for (int l = count - 1; l > 0; l--)
+    {
+        int32_t w = state[l].weight;
+        if (state[l].mask != NULL)
+            w = (w * state[l].mask[joint]) >> 12;
+
+        weight[l] = w;
+
+        if (w >= inttof32(1))
+        {
+            first = l;
+            break;
+        }
+    }
+
+    int32_t v_layer[DSMA_MAX_LAYERS][3];
+    int32_t q_layer[DSMA_MAX_LAYERS][4];
+    uint32_t sampled = 0;
+
+    for (int l = first; l < count; l++)
+    {
+        if ((l > first) && (weight[l] == 0))
+            continue;
+
+        // Reuse the joint of a layer with the same pose if it has been read
+        int same_as = state[l].same_as;
+        if ((same_as >= 0) && (sampled & BIT(same_as)))
+        {
+            for (int i = 0; i < 3; i++)
+                v_layer[l][i] = v_layer[same_as][i];
+            for (int i = 0; i < 4; i++)
+                q_layer[l][i] = q_layer[same_as][i];
+        }
+        else
+        {
+            dsa_sampler_joint(&state[l].sampler, joint,
+                              &v_layer[l][0], &q_layer[l][0]);
+        }
+        sampled |= BIT(l);
+
+        if (l == first)
+        {
+            for (int i = 0; i < 3; i++)
+                v_pos[i] = v_layer[l][i];
+            for (int i = 0; i < 4; i++)
+                q_orient[i] = q_layer[l][i];
+        }
+        else
+        {
+            dsa_interpolate_frames(v_pos, q_orient,
+                                   &v_layer[l][0], &q_layer[l][0],
+                                   weight[l], v_pos, q_orient);
+        }
+    }
+}
+
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBonesLayers(const DSMA_Layer *layers, int num_layers)
+{
+    NEA_DisplayListWait();
+
+    dsma_layer_state_t state[DSMA_MAX_LAYERS];
+    int count;
+    uint32_t num_joints;
+
+    int ret = dsma_layers_init(state, &count, &num_joints, layers, num_layers);
+    if (ret != DSMA_SUCCESS)
+        return ret;
+
+    // Only one pose is visible, it may be in the pose cache
+    if (count == 1)
+        return DSMA_PrepareBones(state[0].dsa_file, state[0].frame_interp);
+
+    if (num_joints > DSMA_MAX_JOINTS)
+        return DSMA_MATRIX_STACK_FULL;
 
     // Make sure that there is enough space in the matrix stack
     // --------------------------------------------------------
@@ -283,53 +944,17 @@ int DSMA_PrepareBonesBlend(const void *dsa_file_1, uint32_t frame_interp_1,
 
     MATRIX_PUSH = 0;
 
+    NE_STAT_ADD(bone_matrices, num_joints);
+
     // Generate matrices with bone transformations
     // -------------------------------------------
 
-    uint32_t next_frame_1 = frame_1 + 1;
-    if (next_frame_1 == num_frames_1)
-        next_frame_1 = 0;
-
-    uint32_t next_frame_2 = frame_2 + 1;
-    if (next_frame_2 == num_frames_2)
-        next_frame_2 = 0;
-
-    const dsa_joint_t *frame_1_ptr_1 = dsa_get_frame(dsa_1, frame_1);
-    const dsa_joint_t *frame_1_ptr_2 = dsa_get_frame(dsa_1, next_frame_1);
-
-    const dsa_joint_t *frame_2_ptr_1 = dsa_get_frame(dsa_2, frame_2);
-    const dsa_joint_t *frame_2_ptr_2 = dsa_get_frame(dsa_2, next_frame_2);
-
     for (uint32_t i = 0; i < num_joints; i++)
     {
-        int32_t v_pos_1[3];
-        int32_t q_orient_1[4];
-
-        dsa_interpolate_frames(&frame_1_ptr_1->pos[0],
-                               &frame_1_ptr_1->orient[0],
-                               &frame_1_ptr_2->pos[0],
-                               &frame_1_ptr_2->orient[0],
-                               interp_1, &v_pos_1[0], &q_orient_1[0]);
-        frame_1_ptr_1++;
-        frame_1_ptr_2++;
-
-        int32_t v_pos_2[3];
-        int32_t q_orient_2[4];
-
-        dsa_interpolate_frames(&frame_2_ptr_1->pos[0],
-                               &frame_2_ptr_1->orient[0],
-                               &frame_2_ptr_2->pos[0],
-                               &frame_2_ptr_2->orient[0],
-                               interp_2, &v_pos_2[0], &q_orient_2[0]);
-        frame_2_ptr_1++;
-        frame_2_ptr_2++;
-
         int32_t v_pos[3];
         int32_t q_orient[4];
 
-        dsa_interpolate_frames(&v_pos_1[0], &q_orient_1[0],
-                               &v_pos_2[0], &q_orient_2[0],
-                               blend, &v_pos[0], &q_orient[0]);
+        dsma_layers_joint(state, count, i, &v_pos[0], &q_orient[0]);
 
         // Generate new matrix
         MATRIX_RESTORE = curr_stack_level;
@@ -343,13 +968,40 @@ int DSMA_PrepareBonesBlend(const void *dsa_file_1, uint32_t frame_interp_1,
 }
 
 ITCM_CODE ARM_CODE
-int DSMA_DrawModelBlendAnimation(const void *dsm_file,
-        const void *dsa_file_1, uint32_t frame_interp_1,
-        const void *dsa_file_2, uint32_t frame_interp_2,
-        uint32_t blend)
+int DSMA_DrawModelLayers(const void *dsm_file, const DSMA_Layer *layers,
+                         int num_layers)
 {
-    int ret = DSMA_PrepareBonesBlend(dsa_file_1, frame_interp_1,
-                                     dsa_file_2, frame_interp_2, blend);
+    if (DSMA_IsBatched(dsm_file))
+    {
+        NEA_DisplayListWait();
+
+        dsma_layer_state_t state[DSMA_MAX_LAYERS];
+        int count;
+        uint32_t num_joints;
+
+        int ret = dsma_layers_init(state, &count, &num_joints, layers,
+                                   num_layers);
+        if (ret != DSMA_SUCCESS)
+            return ret;
+
+        if (num_joints > DSMA_MAX_BATCHED_JOINTS)
+            return DSMA_MATRIX_STACK_FULL;
+
+        NE_STAT_ADD(bone_matrices, num_joints);
+
+        for (uint32_t i = 0; i < num_joints; i++)
+        {
+            int32_t v_pos[3];
+            int32_t q_orient[4];
+
+            dsma_layers_joint(state, count, i, &v_pos[0], &q_orient[0]);
+            joint_to_matrix(v_pos, q_orient, dsma_batch_matrix[i]);
+        }
+
+        return dsma_draw_batches(dsm_file, num_joints);
+    }
+
+    int ret = DSMA_PrepareBonesLayers(layers, num_layers);
     if (ret != DSMA_SUCCESS)
         return ret;
 
@@ -358,3 +1010,30 @@ int DSMA_DrawModelBlendAnimation(const void *dsm_file,
 
     return DSMA_SUCCESS;
 }
+
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBonesBlend(const void *dsa_file_1, uint32_t frame_interp_1,
+        const void *dsa_file_2, uint32_t frame_interp_2,
+        uint32_t blend)
+{
+    const DSMA_Layer layers[2] = {
+        { dsa_file_1, frame_interp_1, inttof32(1), NULL },
+        { dsa_file_2, frame_interp_2, blend, NULL },
+    };
+
+    return DSMA_PrepareBonesLayers(layers, 2);
+}
+
+ITCM_CODE ARM_CODE
+int DSMA_DrawModelBlendAnimation(const void *dsm_file,
+        const void *dsa_file_1, uint32_t frame_interp_1,
+        const void *dsa_file_2, uint32_t frame_interp_2,
+        uint32_t blend)
+{
+    const DSMA_Layer layers[2] = {
+        { dsa_file_1, frame_interp_1, inttof32(1), NULL },
+        { dsa_file_2, frame_interp_2, blend, NULL },
+    };
+
+    return DSMA_DrawModelLayers(dsm_file, layers, 2);
+}
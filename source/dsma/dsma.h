@@ -17,9 +17,41 @@ extern "C" {
 # define ARM_CODE __attribute__((target("arm")))
 #endif
 
+// Number of poses kept by the pose cache.
+#ifndef DSMA_POSE_CACHE_ENTRIES
+# define DSMA_POSE_CACHE_ENTRIES 4
+#endif
+
+// DSA files can use two versions of the format. Version 1 stores the
+// translation and orientation of every joint at every frame. Version 2 is
+// generated by md5_to_dsma with "--reduce-anims": it only stores the frames
+// that can't be interpolated from the ones around them, orientations use 16
+// bits per component, and joints that don't move are only stored once. Both
+// versions are used the same way.
+
+// Max number of joints of animations used with DSM files split in bone
+// batches.
+#ifndef DSMA_MAX_BATCHED_JOINTS
+# define DSMA_MAX_BATCHED_JOINTS 64
+#endif
+
+// Magic number of DSM files split in bone batches ("DSMB" in little-endian).
+#define DSMA_BATCHED_MAGIC 0x424D5344
+
+// Returns true if the DSM file has been split in bone batches by md5_to_dsma
+// with "--bone-batch". Each batch only needs a few entries of the matrix stack,
+// so these models can have more than 30 joints and they can be drawn when
+// the matrix stack is partially used. DSMA_DrawModel() and
+// DSMA_DrawModelBlendAnimation() draw them one batch at a time. They can't be
+// used with DSMA_PrepareBones().
+bool DSMA_IsBatched(const void *dsm_file);
+
 // Returns the number of frames stored in the specified DSA file.
 uint32_t DSMA_GetNumFrames(const void *dsa_file);
 
+// Returns the size in bytes of the specified DSA file.
+size_t DSMA_GetSize(const void *dsa_file);
+
 // Draws the model in the DSM file animated with the data in the specified DSA
 // file, at the requested frame.
 //
@@ -57,15 +89,100 @@ int DSMA_DrawModelBlendAnimation(const void *dsm_file,
 // This is useful for multi-material animated models where you need to draw
 // multiple display lists (one per submesh) with different materials, all
 // sharing the same bone matrices.
+//
+// If the pose service of Nitro Engine Advanced (NEAPoseService.h) has already
+// interpolated the joints of the pose on the ARM7, they are only converted to
+// matrices.
 ITCM_CODE ARM_CODE
 int DSMA_PrepareBones(const void *dsa_file, uint32_t frame_interp);
 
-// Same as DSMA_PrepareBones but blends between two animations.
+// DSMA_PrepareBones() and DSMA_DrawModel() keep the joint matrices of the last
+// poses they have generated, identified by the DSA file and the frame. Models
+// drawn later with the same DSA file and frame reuse them, and they only need
+// to send them to the hardware. Blended animations aren't cached.
+//
+// The cache must be cleared if the data of a DSA file is modified or freed.
+// Nitro Engine Advanced clears it at the start of every frame and when an
+// animation is deleted.
+void DSMA_PoseCacheClear(void);
+
+// Gets the position and orientation of one joint of a DSA file at the
+// requested frame, in the same format as the DSA file (the orientation is a
+// quaternion in w, x, y, z order). The frame is in 20.12 fixed point.
+//
+// It returns a DSMA_* code (0 for success).
+int DSMA_GetJointTransform(const void *dsa_file, uint32_t frame_interp,
+                           uint32_t joint, int32_t *pos, int32_t *orient);
+
+// Magic number of files with baked joint matrices ("DSAM" in little-endian).
+#define DSMA_BAKED_MAGIC 0x4D415344
+
+// Returns the size in bytes of the buffer needed by DSMA_BakeMatrices() for
+// the specified DSA file.
+size_t DSMA_GetBakedSize(const void *dsa_file);
+
+// Generates the joint matrices of all frames of a DSA file and stores them in
+// 'dest', which must be DSMA_GetBakedSize() bytes long. md5_to_dsma can also
+// generate them with "--bake-matrices".
+//
+// It returns a DSMA_* code (0 for success).
+int DSMA_BakeMatrices(const void *dsa_file, void *dest);
+
+// Same as DSMA_PrepareBones(), but it loads the joint matrices from baked data
+// instead of generating them when the frame is a whole frame. Frames between
+// two whole frames, or a NULL 'baked_file', use DSMA_PrepareBones().
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBonesBaked(const void *dsa_file, const void *baked_file,
+                           uint32_t frame_interp);
+
+// Same as DSMA_PrepareBones but blends between two animations. A blending
+// factor of 0.0 or 1.0, or two animations at the same pose, generate just one
+// of the poses. See DSMA_PrepareBonesLayers().
 ITCM_CODE ARM_CODE
 int DSMA_PrepareBonesBlend(const void *dsa_file_1, uint32_t frame_interp_1,
         const void *dsa_file_2, uint32_t frame_interp_2,
         uint32_t blend);
 
+// Max number of layers of DSMA_PrepareBonesLayers() and DSMA_DrawModelLayers().
+#ifndef DSMA_MAX_LAYERS
+# define DSMA_MAX_LAYERS 4
+#endif
+
+// One animation of a layered pose.
+typedef struct {
+    const void *dsa_file;  // DSA file of the animation
+    uint32_t frame_interp; // Frame in 20.12 fixed point
+    uint32_t weight;       // Weight of the layer, from 0.0 to 1.0 (20.12)
+    const uint16_t *mask;  // Weight of each joint (20.12), or NULL for all 1.0
+} DSMA_Layer;
+
+// Same as DSMA_PrepareBones, but the pose is made of several layers.
+//
+// The pose starts as the pose of the first layer, and every other layer is
+// blended on top of the result with its weight multiplied by the weight of the
+// joint in its mask. The weight and mask of the first layer are ignored. For
+// example, an upper body animation can be played on top of a walk cycle by
+// using a mask with 1.0 in the joints of the upper body and 0.0 in the others.
+//
+// All layers are combined in one pass over the joints. Layers with a weight
+// of 0.0 aren't read, nor are the layers below a layer with a weight of 1.0
+// (in the whole pose or in one joint). Layers with the same animation and
+// frame as a layer below them reuse its joints. If only one layer is left,
+// the pose is generated like by DSMA_PrepareBones() and it can use the pose
+// cache.
+//
+// All animations must have the same number of joints.
+ITCM_CODE ARM_CODE
+int DSMA_PrepareBonesLayers(const DSMA_Layer *layers, int num_layers);
+
+// Draws the model in the DSM file with a pose made of several layers. See
+// DSMA_PrepareBonesLayers().
+//
+// It returns a DSMA_* code (0 for success).
+ITCM_CODE ARM_CODE
+int DSMA_DrawModelLayers(const void *dsm_file, const DSMA_Layer *layers,
+                         int num_layers);
+
 // Pops the matrix stack after DSMA_PrepareBones / DSMA_PrepareBonesBlend.
 // Must be called once after you are done drawing all display lists.
 void DSMA_FinishDraw(void);
@@ -76,6 +193,7 @@ void DSMA_FinishDraw(void);
 #define DSMA_INVALID_BLENDING           -3
 #define DSMA_MATRIX_STACK_FULL          -4
 #define DSMA_INCOMPATIBLE_ANIMATIONS    -5
+#define DSMA_INVALID_JOINT              -6
 
 #ifdef __cplusplus
 }
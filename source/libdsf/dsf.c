@@ -10,6 +10,17 @@
 
 #include <dsf.h>
 
+// Nitro Engine Advanced may be sending display lists to the GX FIFO with an
+// asynchronous DMA. The GX registers can't be written until it has finished.
+// The reference is weak so that the library can be used on its own.
+extern void NEA_DisplayListWait(void) __attribute__((weak));
+
+static inline void DSF_GXWait(void)
+{
+    if (NEA_DisplayListWait)
+        NEA_DisplayListWait();
+}
+
 // BMFont format structures
 // ------------------------
 
@@ -69,6 +80,9 @@ typedef struct {
     int16_t  amount;
 } kerning_pair;
 
+// Codepoints below this value are found with a direct lookup table
+#define DSF_DIRECT_CODEPOINTS 256
+
 typedef struct {
     uint16_t      line_height;
     uint16_t      base;
@@ -78,6 +92,17 @@ typedef struct {
     size_t        num_kernings;
     kerning_pair *kernings;
 
+    // Glyphs of the ASCII and Latin-1 codepoints, or NULL if the font doesn't
+    // have them. The rest of the codepoints are searched in the sorted array
+    // of glyphs, starting at the first one that isn't in this table.
+    const block_char *direct_chars[DSF_DIRECT_CODEPOINTS];
+    size_t        first_sorted_char;
+
+    // Open addressing hash table of kerning pairs. Each entry is the index of
+    // a pair plus one, or 0 if it is empty.
+    uint32_t     *kerning_hash;
+    uint32_t      kerning_hash_shift;
+
     // Variables used for the current printing context
     int16_t       pointer_x;
     int16_t       pointer_y;
@@ -100,35 +125,123 @@ static int DSF_block_char_cmp(const void *a, const void *b)
     return a_->id - b_->id;
 }
 
-static int DSF_kerning_pair_cmp(const void *a, const void *b)
-{
-    const kerning_pair *a_ = a;
-    const kerning_pair *b_ = b;
-
-    // Compare the first codepoint. If it matches, compare the second codepoint.
-    if (a_->first != b_->first)
-        return a_->first - b_->first;
-
-    return a_->second - b_->second;
-}
-
 static const block_char *DSF_CodepointFindGlyph(dsf_handle handle,
                                                 uint32_t codepoint)
 {
     dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
 
-    // Codepoint to find
-    block_char key = { 0 };
-    key.id = codepoint;
+    const block_char *ch = NULL;
+
+    if (codepoint < DSF_DIRECT_CODEPOINTS)
+    {
+        ch = font->direct_chars[codepoint];
+    }
+    else
+    {
+        // Binary search without calling a comparison function
+        size_t low = font->first_sorted_char;
+        size_t high = font->num_chars;
+
+        while (low < high)
+        {
+            size_t mid = (low + high) / 2;
+            uint32_t id = font->chars[mid].id;
+
+            if (id == codepoint)
+            {
+                ch = &font->chars[mid];
+                break;
+            }
+
+            if (id < codepoint)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+    }
 
-    const block_char *ch = bsearch(&key, font->chars, font->num_chars,
-                                   sizeof(block_char), DSF_block_char_cmp);
     if (ch == NULL)
         return font->replacement_character;
 
     return ch;
 }
 
+static uint32_t DSF_KerningHash(uint32_t first, uint32_t second, uint32_t shift)
+{
+    // Multiplicative hash. The top bits are the best mixed ones.
+    return (((first << 16) ^ second) * 2654435761u) >> shift;
+}
+
+static dsf_error DSF_KerningHashBuild(dsf_font_internal_state *font)
+{
+    if (font->num_kernings == 0)
+        return DSF_NO_ERROR;
+
+    // Use a table with at least twice as many entries as pairs so that the
+    // chains of entries are short.
+    uint32_t bits = 1;
+    while ((1u << bits) < font->num_kernings * 2)
+        bits++;
+
+    uint32_t size = 1u << bits;
+
+    font->kerning_hash = calloc(size, sizeof(uint32_t));
+    if (font->kerning_hash == NULL)
+        return DSF_NO_MEMORY;
+
+    font->kerning_hash_shift = 32 - bits;
+
+    for (size_t i = 0; i < font->num_kernings; i++)
+    {
+        const kerning_pair *pair = &font->kernings[i];
+
+        uint32_t index = DSF_KerningHash(pair->first, pair->second,
+                                         font->kerning_hash_shift);
+
+        while (1)
+        {
+            uint32_t entry = font->kerning_hash[index];
+            if (entry == 0)
+            {
+                font->kerning_hash[index] = i + 1;
+                break;
+            }
+
+            // Keep the first copy of repeated pairs
+            const kerning_pair *other = &font->kernings[entry - 1];
+            if ((other->first == pair->first) && (other->second == pair->second))
+                break;
+
+            index = (index + 1) & (size - 1);
+        }
+    }
+
+    return DSF_NO_ERROR;
+}
+
+static const kerning_pair *DSF_KerningFind(dsf_font_internal_state *font,
+                                           uint32_t first, uint32_t second)
+{
+    if (font->kerning_hash == NULL)
+        return NULL;
+
+    uint32_t mask = (1u << (32 - font->kerning_hash_shift)) - 1;
+    uint32_t index = DSF_KerningHash(first, second, font->kerning_hash_shift);
+
+    while (1)
+    {
+        uint32_t entry = font->kerning_hash[index];
+        if (entry == 0)
+            return NULL;
+
+        const kerning_pair *pair = &font->kernings[entry - 1];
+        if ((pair->first == first) && (pair->second == second))
+            return pair;
+
+        index = (index + 1) & mask;
+    }
+}
+
 static dsf_error DSF_LoadFile(const char *path, void **data, size_t *_size)
 {
     FILE *f = fopen(path, "rb");
@@ -281,8 +394,6 @@ dsf_error DSF_LoadFontMemory(dsf_handle *handle,
                 src += sizeof(bmf_block_5_kerning_pair);
             }
 
-            qsort(font->kernings, font->num_kernings, sizeof(kerning_pair),
-                  DSF_kerning_pair_cmp);
         }
 
         ptr += block_size + 1 + 4;
@@ -304,6 +415,23 @@ dsf_error DSF_LoadFontMemory(dsf_handle *handle,
         goto error;
     }
 
+    // Build the lookup tables. The glyphs are sorted, so the ones of the direct
+    // table are at the start of the array.
+
+    size_t first_sorted = 0;
+    while ((first_sorted < font->num_chars) &&
+           (font->chars[first_sorted].id < DSF_DIRECT_CODEPOINTS))
+    {
+        const block_char *ch = &font->chars[first_sorted];
+        font->direct_chars[ch->id] = ch;
+        first_sorted++;
+    }
+    font->first_sorted_char = first_sorted;
+
+    ret = DSF_KerningHashBuild(font);
+    if (ret != DSF_NO_ERROR)
+        goto error;
+
     // Look for a replacement character glyph in the font.
 
     // Initialize the value to NULL so that DSF_CodepointFindGlyph() returns
@@ -317,6 +445,7 @@ dsf_error DSF_LoadFontMemory(dsf_handle *handle,
 error:
     free(font->chars);
     free(font->kernings);
+    free(font->kerning_hash);
     free(font);
     return ret;
 }
@@ -330,6 +459,7 @@ dsf_error DSF_FreeFont(dsf_handle *handle)
 
     free(font->chars);
     free(font->kernings);
+    free(font->kerning_hash);
     free(font);
 
     *handle = 0;
@@ -353,7 +483,8 @@ dsf_error DSF_LoadFontFilesystem(dsf_handle *handle, const char *path)
     return error;
 }
 
-static size_t DSF_UTF8_CodepointRead(const char *str, uint32_t *codepoint)
+static size_t DSF_UTF8_CodepointReadMultibyte(const char *str,
+                                              uint32_t *codepoint)
 {
     // https://en.wikipedia.org/wiki/UTF-8#Encoding
 
@@ -362,13 +493,7 @@ static size_t DSF_UTF8_CodepointRead(const char *str, uint32_t *codepoint)
 
     uint32_t b1 = str[0];
 
-    if ((b1 & 0x80) == 0)
-    {
-        size = 1;
-        *codepoint = b1 & 0x7F;
-        return 1;
-    }
-    else if ((b1 & 0xE0) == 0xC0)
+    if ((b1 & 0xE0) == 0xC0)
     {
         size = 2;
         rune = b1 & 0x1F;
@@ -403,30 +528,41 @@ static size_t DSF_UTF8_CodepointRead(const char *str, uint32_t *codepoint)
 
 error:
 
-    // Incorrect encoding. Advance characters until we find one character
-    // that isn't a continuation character.
+    // Incorrect encoding. Skip the continuation characters that follow the
+    // first one. The terminator isn't a continuation character, so this never
+    // goes past the end of the string.
     size = 1;
-    str++;
-
-    while (1)
-    {
-        uint8_t c = *str++;
+    while ((str[size] & 0xC0) == 0x80)
         size++;
-        if ((c & 0xC0) != 0x80)
-            break;
-    }
 
     *codepoint = REPLACEMENT_CHARACTER;
     return size;
 }
 
-dsf_error DSF_CodepointRenderDryRun(dsf_handle handle, uint32_t codepoint)
+static inline size_t DSF_UTF8_CodepointRead(const char *str,
+                                            uint32_t *codepoint)
 {
-    if ((handle == 0) || (codepoint == 0))
-        return DSF_INVALID_ARGUMENT;
+    // Fast path for ASCII characters, which are most of the text
+    uint8_t b1 = str[0];
+    if (b1 < 0x80)
+    {
+        *codepoint = b1;
+        return 1;
+    }
+
+    return DSF_UTF8_CodepointReadMultibyte(str, codepoint);
+}
 
+// Advances the cursor past one codepoint and returns the quad it covers. Line
+// breaks and glyphs without pixels return a glyph with a size of zero.
+static dsf_error DSF_CodepointLayout(dsf_handle handle, uint32_t codepoint,
+                                     dsf_glyph *glyph)
+{
     dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
 
+    glyph->width = 0;
+    glyph->height = 0;
+
     if (codepoint == '\n')
     {
         font->pointer_x = font->box_left;
@@ -438,88 +574,43 @@ dsf_error DSF_CodepointRenderDryRun(dsf_handle handle, uint32_t codepoint)
     if (ch == NULL)
         return DSF_CODEPOINT_NOT_FOUND;
 
-    int x1 = font->pointer_x;
-    int x2 = x1 + ch->width;
-    int y1 = font->pointer_y;
-    int y2 = y1 + ch->height;
-
-    x1 += ch->xoffset;
-    x2 += ch->xoffset;
-    y1 += ch->yoffset;
-    y2 += ch->yoffset;
+    int x1 = font->pointer_x + ch->xoffset;
+    int y1 = font->pointer_y + ch->yoffset;
 
     font->pointer_x += ch->xadvance;
 
-    // Kerning pair to find
-    kerning_pair key = { 0 };
-    key.first = font->last_codepoint;
-    key.second = codepoint;
-
-    const kerning_pair *ker = bsearch(&key, font->kernings, font->num_kernings,
-                                      sizeof(kerning_pair), DSF_kerning_pair_cmp);
+    const kerning_pair *ker = DSF_KerningFind(font, font->last_codepoint,
+                                              codepoint);
     if (ker != NULL)
     {
         x1 += ker->amount;
-        x2 += ker->amount;
         font->pointer_x += ker->amount;
     }
 
     font->last_codepoint = codepoint;
 
+    glyph->x = x1;
+    glyph->y = y1;
+    glyph->tx = ch->x;
+    glyph->ty = ch->y;
+    glyph->width = ch->width;
+    glyph->height = ch->height;
+
     return DSF_NO_ERROR;
 }
 
-static dsf_error DSF_CodepointRender3D(dsf_handle handle, uint32_t codepoint,
-                                       int16_t z)
+static void DSF_GlyphRender3D(const dsf_glyph *glyph,
+                              int32_t x, int32_t y, int16_t z)
 {
-    if ((handle == 0) || (codepoint == 0))
-        return DSF_INVALID_ARGUMENT;
-
-    dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
-
-    if (codepoint == '\n')
-    {
-        font->pointer_x = font->box_left;
-        font->pointer_y += font->line_height;
-        return DSF_NO_ERROR;
-    }
-
-    const block_char *ch = DSF_CodepointFindGlyph(handle, codepoint);
-    if (ch == NULL)
-        return DSF_CODEPOINT_NOT_FOUND;
-
-    int tx1 = ch->x;
-    int tx2 = tx1 + ch->width;
-    int ty1 = ch->y;
-    int ty2 = ty1 + ch->height;
-
-    int x1 = font->pointer_x;
-    int x2 = x1 + ch->width;
-    int y1 = font->pointer_y;
-    int y2 = y1 + ch->height;
-
-    x1 += ch->xoffset;
-    x2 += ch->xoffset;
-    y1 += ch->yoffset;
-    y2 += ch->yoffset;
-
-    font->pointer_x += ch->xadvance;
-
-    // Kerning pair to find
-    kerning_pair key = { 0 };
-    key.first = font->last_codepoint;
-    key.second = codepoint;
+    int tx1 = glyph->tx;
+    int tx2 = tx1 + glyph->width;
+    int ty1 = glyph->ty;
+    int ty2 = ty1 + glyph->height;
 
-    const kerning_pair *ker = bsearch(&key, font->kernings, font->num_kernings,
-                                      sizeof(kerning_pair), DSF_kerning_pair_cmp);
-    if (ker != NULL)
-    {
-        x1 += ker->amount;
-        x2 += ker->amount;
-        font->pointer_x += ker->amount;
-    }
-
-    font->last_codepoint = codepoint;
+    int x1 = x + glyph->x;
+    int x2 = x1 + glyph->width;
+    int y1 = y + glyph->y;
+    int y2 = y1 + glyph->height;
 
     GFX_TEX_COORD = TEXTURE_PACK(inttot16(tx1), inttot16(ty1));
     GFX_VERTEX16 = (y1 << 16) | (x1 & 0xFFFF); // Up-left
@@ -533,6 +624,30 @@ static dsf_error DSF_CodepointRender3D(dsf_handle handle, uint32_t codepoint,
 
     GFX_TEX_COORD = TEXTURE_PACK(inttot16(tx2), inttot16(ty1));
     GFX_VERTEX_XY = (y1 << 16) | (x2 & 0xFFFF); // Up-right
+}
+
+dsf_error DSF_CodepointRenderDryRun(dsf_handle handle, uint32_t codepoint)
+{
+    if ((handle == 0) || (codepoint == 0))
+        return DSF_INVALID_ARGUMENT;
+
+    dsf_glyph glyph;
+    return DSF_CodepointLayout(handle, codepoint, &glyph);
+}
+
+static dsf_error DSF_CodepointRender3D(dsf_handle handle, uint32_t codepoint,
+                                       int16_t z)
+{
+    if ((handle == 0) || (codepoint == 0))
+        return DSF_INVALID_ARGUMENT;
+
+    dsf_glyph glyph;
+    dsf_error ret = DSF_CodepointLayout(handle, codepoint, &glyph);
+    if (ret != DSF_NO_ERROR)
+        return ret;
+
+    if ((glyph.width > 0) && (glyph.height > 0))
+        DSF_GlyphRender3D(&glyph, 0, 0, z);
 
     return DSF_NO_ERROR;
 }
@@ -619,6 +734,8 @@ dsf_error DSF_StringRender3DWithIndent(dsf_handle handle, const char *str,
 
     const char *readptr = str;
 
+    DSF_GXWait();
+
     glBegin(GL_QUADS);
 
     while (*readptr != '\0')
@@ -665,6 +782,8 @@ dsf_error DSF_StringRender3DAlphaWithIndent(dsf_handle handle, const char *str,
 
     int id_index = 0;
 
+    DSF_GXWait();
+
     while (*readptr != '\0')
     {
         uint32_t codepoint;
@@ -691,56 +810,43 @@ dsf_error DSF_StringRender3DAlpha(dsf_handle handle, const char *str,
     return DSF_StringRender3DAlphaWithIndent(handle, str, x, y, z, poly_fmt, poly_id_base, 0);
 }
 
-static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
-                    uint32_t codepoint, unsigned int texture_fmt,
-                    const void *font_texture, size_t font_width, size_t font_height,
+static void DSF_GlyphRenderBuffer(const dsf_glyph *glyph,
+                    unsigned int texture_fmt,
+                    const void *font_texture, size_t font_width,
                     void *out_texture, size_t out_width, size_t out_height)
 {
     // Don't check if the arguments are valid, this is an internal function
 
-    dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
+    int tx1 = glyph->tx;
+    int ty1 = glyph->ty;
 
-    if (codepoint == '\n')
-    {
-        font->pointer_x = font->box_left;
-        font->pointer_y += font->line_height;
-        return DSF_NO_ERROR;
-    }
-
-    const block_char *ch = DSF_CodepointFindGlyph(handle, codepoint);
-    if (ch == NULL)
-        return DSF_CODEPOINT_NOT_FOUND;
-
-    int tx1 = ch->x;
-    int ty1 = ch->y;
-
-    int x1 = font->pointer_x;
-    int x2 = x1 + ch->width;
-    int y1 = font->pointer_y;
-    int y2 = y1 + ch->height;
-
-    x1 += ch->xoffset;
-    x2 += ch->xoffset;
-    y1 += ch->yoffset;
-    y2 += ch->yoffset;
-
-    font->pointer_x += ch->xadvance;
+    int x1 = glyph->x;
+    int y1 = glyph->y;
 
-    // Kerning pair to find
-    kerning_pair key = { 0 };
-    key.first = font->last_codepoint;
-    key.second = codepoint;
+    int w = glyph->width;
+    int h = glyph->height;
 
-    const kerning_pair *ker = bsearch(&key, font->kernings, font->num_kernings,
-                                      sizeof(kerning_pair), DSF_kerning_pair_cmp);
-    if (ker != NULL)
+    // Glyphs can be partially outside of the texture, for example with a
+    // negative indentation. Clip them to the texture.
+    if (x1 < 0)
     {
-        x1 += ker->amount;
-        x2 += ker->amount;
-        font->pointer_x += ker->amount;
+        tx1 -= x1;
+        w += x1;
+        x1 = 0;
     }
+    if (y1 < 0)
+    {
+        ty1 -= y1;
+        h += y1;
+        y1 = 0;
+    }
+    if (x1 + w > (int)out_width)
+        w = (int)out_width - x1;
+    if (y1 + h > (int)out_height)
+        h = (int)out_height - y1;
 
-    font->last_codepoint = codepoint;
+    if ((w <= 0) || (h <= 0))
+        return;
 
     if (texture_fmt == GL_RGB256)
     {
@@ -750,12 +856,12 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
         src += tx1 + ty1 * font_width;
         dst += x1 + y1 * out_width;
 
-        for (int y = 0; y < y2 - y1; y++)
+        for (int y = 0; y < h; y++)
         {
             const uint8_t *src_row = src;
             uint8_t *dst_row = dst;
 
-            for (int x = 0; x < x2 - x1; x++)
+            for (int x = 0; x < w; x++)
             {
                 uint8_t color = *src_row++;
                 if (color != 0)
@@ -775,12 +881,12 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
         src += tx1 + ty1 * font_width;
         dst += x1 + y1 * out_width;
 
-        for (int y = 0; y < y2 - y1; y++)
+        for (int y = 0; y < h; y++)
         {
             const uint16_t *src_row = src;
             uint16_t *dst_row = dst;
 
-            for (int x = 0; x < x2 - x1; x++)
+            for (int x = 0; x < w; x++)
             {
                 uint16_t color = *src_row++;
                 if (color & BIT(15))
@@ -800,12 +906,12 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
         src += tx1 + ty1 * font_width;
         dst += x1 + y1 * out_width;
 
-        for (int y = 0; y < y2 - y1; y++)
+        for (int y = 0; y < h; y++)
         {
             const uint8_t *src_row = src;
             uint8_t *dst_row = dst;
 
-            for (int x = 0; x < x2 - x1; x++)
+            for (int x = 0; x < w; x++)
             {
                 // We can't really blend two different colors because we're
                 // limited by the palette. For that reason, we just directly
@@ -823,12 +929,12 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
         const uint8_t *src = font_texture;
         uint8_t *dst = out_texture;
 
-        for (int y = 0; y < y2 - y1; y++)
+        for (int y = 0; y < h; y++)
         {
             const uint8_t *src_row = src + (((ty1 + y) * font_width) >> 1);
             uint8_t *dst_row = dst + (((y1 + y) * out_width) >> 1);
 
-            for (int x = 0; x < x2 - x1; x++)
+            for (int x = 0; x < w; x++)
             {
                 const uint8_t *src_px = src_row + ((tx1 + x) >> 1);
                 uint8_t *dst_px = dst_row + ((x1 + x) >> 1);
@@ -850,12 +956,12 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
         const uint8_t *src = font_texture;
         uint8_t *dst = out_texture;
 
-        for (int y = 0; y < y2 - y1; y++)
+        for (int y = 0; y < h; y++)
         {
             const uint8_t *src_row = src + (((ty1 + y) * font_width) >> 2);
             uint8_t *dst_row = dst + (((y1 + y) * out_width) >> 2);
 
-            for (int x = 0; x < x2 - x1; x++)
+            for (int x = 0; x < w; x++)
             {
                 const uint8_t *src_px = src_row + ((tx1 + x) >> 2);
                 uint8_t *dst_px = dst_row + ((x1 + x) >> 2);
@@ -872,8 +978,6 @@ static dsf_error DSF_CodepointRenderBuffer(dsf_handle handle,
             }
         }
     }
-
-    return DSF_NO_ERROR;
 }
 
 dsf_error DSF_StringRenderToTexture(dsf_handle handle,
@@ -881,32 +985,171 @@ dsf_error DSF_StringRenderToTexture(dsf_handle handle,
                     const void *font_texture, size_t font_width, size_t font_height,
                     void **out_texture, size_t *out_width, size_t *out_height)
 {
-    if ((handle == 0) || (str == NULL) || (font_texture == NULL) ||
-        (out_texture == NULL) || (out_width == NULL) || (out_height == NULL))
+    if ((handle == 0) || (str == NULL))
         return DSF_INVALID_ARGUMENT;
 
-    if ((texture_fmt < 1) || (texture_fmt > 7) || (texture_fmt == GL_COMPRESSED))
-        return DSF_TEXTURE_BAD_FORMAT;
-
-    if ((font_width == 0) || (font_height == 0))
+    if (strlen(str) == 0)
         return DSF_INVALID_ARGUMENT;
 
-    if (strlen(str) == 0)
+    // Lay out the string once and use the result both to get the size of the
+    // texture and to render the glyphs.
+
+    dsf_layout *layout;
+    dsf_error ret = DSF_StringLayout(handle, str, 0, &layout);
+    if (ret != DSF_NO_ERROR)
+        return ret;
+
+    ret = DSF_LayoutRenderToTexture(layout, texture_fmt,
+                                    font_texture, font_width, font_height,
+                                    out_texture, out_width, out_height);
+
+    DSF_LayoutFree(layout);
+
+    return ret;
+}
+
+dsf_error DSF_StringLayout(dsf_handle handle, const char *str, int32_t xStart,
+                           dsf_layout **layout)
+{
+    if ((handle == 0) || (str == NULL) || (layout == NULL))
         return DSF_INVALID_ARGUMENT;
 
-    // Start process
+    dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
+
+    // Each codepoint uses at least one byte, so this is enough for any string
+    size_t len = strlen(str);
+
+    dsf_layout *l = malloc(sizeof(dsf_layout) + len * sizeof(dsf_glyph));
+    if (l == NULL)
+        return DSF_NO_MEMORY;
 
     dsf_error ret = DSF_NO_ERROR;
 
-    dsf_font_internal_state *font = (dsf_font_internal_state *)handle;
+    font->pointer_x = xStart;
+    font->pointer_y = 0;
+    font->box_left = 0;
+    font->box_top = 0;
+    font->last_codepoint = 0;
 
-    // Get size
+    const char *readptr = str;
+
+    size_t num_glyphs = 0;
+    int32_t max_x = 0;
+    int32_t max_y = 0;
+
+    while (*readptr != '\0')
+    {
+        uint32_t codepoint;
+        size_t size = DSF_UTF8_CodepointRead(readptr, &codepoint);
+        readptr += size;
 
-    size_t tex_width, tex_height;
+        dsf_glyph *glyph = &l->glyphs[num_glyphs];
+
+        ret = DSF_CodepointLayout(handle, codepoint, glyph);
+        if (ret != DSF_NO_ERROR)
+            break;
+
+        // Glyphs without pixels are only needed to move the cursor
+        if ((glyph->width > 0) && (glyph->height > 0))
+            num_glyphs++;
+
+        if (font->pointer_x > max_x)
+            max_x = font->pointer_x;
+        if (font->pointer_y > max_y)
+            max_y = font->pointer_y;
+    }
 
-    ret = DSF_StringRenderDryRun(handle, str, &tex_width, &tex_height);
     if (ret != DSF_NO_ERROR)
+    {
+        free(l);
         return ret;
+    }
+
+    l->num_glyphs = num_glyphs;
+    l->size_x = max_x;
+    l->size_y = (len == 0) ? 0 : max_y + font->line_height;
+    l->final_x = font->pointer_x;
+    l->final_y = font->pointer_y;
+
+    *layout = l;
+
+    return DSF_NO_ERROR;
+}
+
+dsf_error DSF_LayoutFree(dsf_layout *layout)
+{
+    if (layout == NULL)
+        return DSF_INVALID_ARGUMENT;
+
+    free(layout);
+
+    return DSF_NO_ERROR;
+}
+
+dsf_error DSF_LayoutRender3D(const dsf_layout *layout,
+                             int32_t x, int32_t y, int32_t z)
+{
+    if (layout == NULL)
+        return DSF_INVALID_ARGUMENT;
+
+    DSF_GXWait();
+
+    glBegin(GL_QUADS);
+
+    for (size_t i = 0; i < layout->num_glyphs; i++)
+        DSF_GlyphRender3D(&layout->glyphs[i], x, y, z);
+
+    glEnd();
+
+    return DSF_NO_ERROR;
+}
+
+dsf_error DSF_LayoutRender3DAlpha(const dsf_layout *layout,
+                                  int32_t x, int32_t y, int32_t z,
+                                  uint32_t poly_fmt, int poly_id_base)
+{
+    if (layout == NULL)
+        return DSF_INVALID_ARGUMENT;
+
+    int id_index = 0;
+
+    DSF_GXWait();
+
+    for (size_t i = 0; i < layout->num_glyphs; i++)
+    {
+        glPolyFmt(poly_fmt | POLY_ID(poly_id_base + id_index));
+        id_index ^= 1;
+
+        glBegin(GL_QUADS);
+        DSF_GlyphRender3D(&layout->glyphs[i], x, y, z);
+        glEnd();
+    }
+
+    return DSF_NO_ERROR;
+}
+
+dsf_error DSF_LayoutRenderToTexture(const dsf_layout *layout,
+                    unsigned int texture_fmt,
+                    const void *font_texture, size_t font_width, size_t font_height,
+                    void **out_texture, size_t *out_width, size_t *out_height)
+{
+    if ((layout == NULL) || (font_texture == NULL) ||
+        (out_texture == NULL) || (out_width == NULL) || (out_height == NULL))
+        return DSF_INVALID_ARGUMENT;
+
+    if ((texture_fmt < 1) || (texture_fmt > 7) || (texture_fmt == GL_COMPRESSED))
+        return DSF_TEXTURE_BAD_FORMAT;
+
+    if ((font_width == 0) || (font_height == 0))
+        return DSF_INVALID_ARGUMENT;
+
+    if ((layout->size_x == 0) || (layout->size_y == 0))
+        return DSF_INVALID_ARGUMENT;
+
+    // Get size
+
+    size_t tex_width = layout->size_x;
+    size_t tex_height = layout->size_y;
 
     if ((tex_width > 1024) || (tex_height > 1024))
         return DSF_TEXTURE_TOO_BIG;
@@ -943,27 +1186,13 @@ dsf_error DSF_StringRenderToTexture(dsf_handle handle,
     if (tex_buffer == NULL)
         return DSF_NO_MEMORY;
 
-    // Render string
-
-    font->pointer_x = 0;
-    font->pointer_y = 0;
-    font->box_left = 0;
-    font->box_top = 0;
-    font->last_codepoint = 0;
-
-    const char *readptr = str;
+    // Render glyphs
 
-    while (*readptr != '\0')
+    for (size_t i = 0; i < layout->num_glyphs; i++)
     {
-        uint32_t codepoint;
-        size_t size = DSF_UTF8_CodepointRead(readptr, &codepoint);
-        readptr += size;
-
-        ret = DSF_CodepointRenderBuffer(handle, codepoint, texture_fmt,
-                                        font_texture, font_width, font_height,
-                                        tex_buffer, tex_width, tex_height);
-        if (ret != DSF_NO_ERROR)
-            break;
+        DSF_GlyphRenderBuffer(&layout->glyphs[i], texture_fmt,
+                              font_texture, font_width,
+                              tex_buffer, tex_width, tex_height);
     }
 
     // Return texture information
@@ -972,5 +1201,5 @@ dsf_error DSF_StringRenderToTexture(dsf_handle handle,
     *out_width = tex_width;
     *out_height = tex_height;
 
-    return ret;
+    return DSF_NO_ERROR;
 }
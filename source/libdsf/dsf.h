@@ -62,6 +62,26 @@ typedef enum {
 /// Type that represents a DSF font internal state.
 typedef uintptr_t dsf_handle;
 
+/// Position of one glyph of a laid out string.
+typedef struct {
+    int16_t  x;      ///< Left coordinate relative to the origin of the string
+    int16_t  y;      ///< Top coordinate relative to the origin of the string
+    uint16_t tx;     ///< Left coordinate of the glyph in the font texture
+    uint16_t ty;     ///< Top coordinate of the glyph in the font texture
+    uint16_t width;  ///< Width of the glyph
+    uint16_t height; ///< Height of the glyph
+} dsf_glyph;
+
+/// Result of laying out a string with DSF_StringLayout().
+typedef struct {
+    size_t    size_x;     ///< Width of the string
+    size_t    size_y;     ///< Height of the string
+    size_t    final_x;    ///< Final X cursor position
+    size_t    final_y;    ///< Final Y cursor position
+    size_t    num_glyphs; ///< Number of glyphs with pixels
+    dsf_glyph glyphs[];   ///< Glyphs in the order they are drawn
+} dsf_layout;
+
 /// @}
 /// @defgroup libdsf_load_unload Font loading and unloading functions.
 /// @{
@@ -231,6 +251,84 @@ dsf_error DSF_StringRenderToTexture(dsf_handle handle,
                     const void *font_texture, size_t font_width, size_t font_height,
                     void **out_texture, size_t *out_width, size_t *out_height);
 
+/// @}
+/// @defgroup libdsf_layout Functions to lay out strings once and draw them.
+/// @{
+
+/// Calculate the position of all glyphs of a string.
+///
+/// The result can be used to get the size of the string and to draw it as 3D
+/// quads or to a texture as many times as needed without having to decode the
+/// string or look up glyphs and kerning pairs again.
+///
+/// Line breaks return the cursor to X = 0, like DSF_StringRender3D() returns
+/// it to the X coordinate passed to it.
+///
+/// @param handle Handler of the font to use.
+/// @param str    String to lay out.
+/// @param xStart The horizontal component of the cursor's starting offset.
+/// @param layout The pointer to the new layout is returned here. It must be
+///               freed with DSF_LayoutFree().
+///
+/// @return An error code or DSF_NO_ERROR on success.
+dsf_error DSF_StringLayout(dsf_handle handle, const char *str, int32_t xStart,
+                           dsf_layout **layout);
+
+/// Free a layout created by DSF_StringLayout().
+///
+/// @param layout Layout to free.
+///
+/// @return An error code or DSF_NO_ERROR on success.
+dsf_error DSF_LayoutFree(dsf_layout *layout);
+
+/// Render a laid out string by rendering one 3D quad per glyph.
+///
+/// @param layout Layout to draw.
+/// @param x      Top x coordinate (0 to 255, but you can go outside of that).
+/// @param y      Left y coordinate (0 to 191, but you can go outside of that).
+/// @param z      Z coordinate (depth).
+///
+/// @return An error code or DSF_NO_ERROR on success.
+dsf_error DSF_LayoutRender3D(const dsf_layout *layout,
+                             int32_t x, int32_t y, int32_t z);
+
+/// Render a laid out string by rendering one 3D quad per glyph with
+/// alternating polygon IDs.
+///
+/// See DSF_StringRender3DAlpha() for more information.
+///
+/// @param layout       Layout to draw.
+/// @param x            Top x coordinate (0 to 255, but you can go outside of that).
+/// @param y            Left y coordinate (0 to 191, but you can go outside of that).
+/// @param z            Z coordinate (depth).
+/// @param poly_fmt     Polygon formats to apply to the characters.
+/// @param poly_id_base poly_id_base and poly_id_base + 1 will be used.
+///
+/// @return An error code or DSF_NO_ERROR on success.
+dsf_error DSF_LayoutRender3DAlpha(const dsf_layout *layout,
+                                  int32_t x, int32_t y, int32_t z,
+                                  uint32_t poly_fmt, int poly_id_base);
+
+/// Allocates a buffer and renders a laid out string to that buffer.
+///
+/// This works like DSF_StringRenderToTexture(), but it uses the size and
+/// glyph positions of the layout.
+///
+/// @param layout       Layout to draw.
+/// @param texture_fmt  Texture format (GL_TEXTURE_TYPE_ENUM, NE_TextureFormat).
+/// @param font_texture Pointer to the font texture.
+/// @param font_width   Width of the font texture.
+/// @param font_height  Height of the font texture.
+/// @param out_texture  The pointer to the new buffer is returned here.
+/// @param out_width    The width to the new buffer is returned here.
+/// @param out_height   The height to the new buffer is returned here.
+///
+/// @return An error code or DSF_NO_ERROR on success.
+dsf_error DSF_LayoutRenderToTexture(const dsf_layout *layout,
+                    unsigned int texture_fmt,
+                    const void *font_texture, size_t font_width, size_t font_height,
+                    void **out_texture, size_t *out_width, size_t *out_height);
+
 /// @}
 
 #ifdef __cplusplus
@@ -5,7 +5,8 @@
 // This file is part of Nitro Engine Advanced
 
 // Nitro Engine Advanced comes with a general-purpose memory allocator. This file
-// contains several tests for it.
+// contains several tests for it. All tests are run in both modes of the
+// allocator, and the two modes are compared with a benchmark at the end.
 
 #include <stdio.h>
 
@@ -20,9 +21,12 @@
 #define POOL_START          (void *)POOL_START_ADDR
 #define POOL_END            (void *)POOL_END_ADDR
 
+// Mode used by all tests
+ne_alloc_mode test_mode = NEA_ALLOC_LIST;
+
 #define POOL_INITIALIZE()                           \
     NEAChunk *alloc;                                 \
-    NEA_AllocInit(&alloc, POOL_START, POOL_END);
+    NEA_AllocInitMode(&alloc, POOL_START, POOL_END, test_mode);
 
 #define POOL_DEINITIALIZE()                         \
     NEA_AllocEnd(&alloc);
@@ -422,17 +426,17 @@ void test_internal_list_state(void)
 
     // Test with invalid linked list
 
-    ret = NEA_AllocInit(NULL, POOL_START, POOL_END);
+    ret = NEA_AllocInitMode(NULL, POOL_START, POOL_END, test_mode);
     ASSERT(ret == -1);
 
     // Test with switched start and end
 
-    ret = NEA_AllocInit(&alloc, POOL_END, POOL_START);
+    ret = NEA_AllocInitMode(&alloc, POOL_END, POOL_START, test_mode);
     ASSERT(ret == -2);
 
     // Initialize a valid list
 
-    ret = NEA_AllocInit(&alloc, POOL_START, POOL_END);
+    ret = NEA_AllocInitMode(&alloc, POOL_START, POOL_END, test_mode);
     ASSERT(ret == 0);
 
     count = count_num_chunks(alloc);
@@ -996,11 +1000,53 @@ void test_stress(void)
     POOL_DEINITIALIZE();
 }
 
-int main(int argc, char *argv[])
+// Benchmark that keeps many chunks alive, like a scene with lots of textures,
+// and then replaces random chunks. It returns the number of timer ticks.
+u32 benchmark(ne_alloc_mode mode)
 {
-    // This test doesn't use Nitro Engine Advanced at all. Initialize the default console
-    // of libnds to print the results of the tests.
-    consoleDemoInit();
+#define BENCH_PTRS 512
+#define BENCH_ITERATIONS 20000
+
+    NEAChunk *alloc;
+    NEA_AllocInitMode(&alloc, POOL_START, POOL_END, mode);
+
+    void *ptr[BENCH_PTRS];
+
+    for (int i = 0; i < BENCH_PTRS; i++)
+        ptr[i] = NULL;
+
+    cpuStartTiming(0);
+
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % BENCH_PTRS;
+
+        if (ptr[selected] != NULL)
+        {
+            int ret = NEA_Free(alloc, ptr[selected]);
+            ASSERT(ret == 0);
+        }
+
+        size_t size = ((my_rand() & 0x3FF) + 1) * 16;
+
+        if (size & 16)
+            ptr[selected] = NEA_Alloc(alloc, size);
+        else
+            ptr[selected] = NEA_AllocFromEnd(alloc, size);
+
+        ASSERT(ptr[selected] != NULL);
+    }
+
+    u32 ticks = cpuEndTiming();
+
+    NEA_AllocEnd(&alloc);
+
+    return ticks;
+}
+
+void run_tests(ne_alloc_mode mode)
+{
+    test_mode = mode;
 
     test_alloc_align();
     test_alloc_from_end_align();
@@ -1014,6 +1060,26 @@ int main(int argc, char *argv[])
     test_alloc_range();
     test_find_range();
     test_stress();
+}
+
+int main(int argc, char *argv[])
+{
+    // This test doesn't use Nitro Engine Advanced at all. Initialize the default console
+    // of libnds to print the results of the tests.
+    consoleDemoInit();
+
+    printf("List mode\n");
+    run_tests(NEA_ALLOC_LIST);
+
+    printf("\nSegregated mode\n");
+    run_tests(NEA_ALLOC_SEGREGATED);
+
+    u32 ticks_list = benchmark(NEA_ALLOC_LIST);
+    u32 ticks_seg = benchmark(NEA_ALLOC_SEGREGATED);
+
+    printf("\nBenchmark (%d operations)\n", BENCH_ITERATIONS);
+    printf("List:       %lu us\n", timerTicks2usec(ticks_list));
+    printf("Segregated: %lu us\n", timerTicks2usec(ticks_seg));
 
     printf("Done!");
 
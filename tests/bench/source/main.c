@@ -0,0 +1,513 @@
+// SPDX-License-Identifier: CC0-1.0
+//
+// SPDX-FileContributor: Warioware64, 2026
+//
+// This file is part of Nitro Engine Advanced
+
+// Benchmarks of the hot paths of Nitro Engine Advanced. Every benchmark runs
+// an operation a fixed number of times with the same data and the same random
+// seed, and it measures it with the cascaded timers 0 and 1, which count bus
+// cycles (33.51 MHz).
+//
+// The results are printed on the screen, and they are also sent to the debug
+// console of the emulator (no$gba, melonDS, DeSmuME) with one line per
+// benchmark so that they can be parsed by scripts:
+//
+//     BENCH <name> <iterations> <cycles per iteration>
+//
+// The last line is "BENCH done". The models come from the colmesh,
+// animated_model and multi_material_model examples, the scene from the
+// scene_system example, and the material animations from the
+// animated_material example.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <NEAAlloc.h>
+#include <NEAMain.h>
+#include <dsma.h>
+
+#include "brick_wall_small_bin.h"
+#include "cube_bin.h"
+#include "level_neascene_bin.h"
+#include "light_strobe_bin.h"
+#include "robot_dsm_bin.h"
+#include "robot_walk_dsa_bin.h"
+#include "robot_wave_dsa_bin.h"
+#include "teapot_bin.h"
+#include "teapot_col_bin.h"
+#include "tex_scroll_bin.h"
+#include "text.h"
+
+#define ASSERT(cond)                                \
+    if (!(cond)) {                                  \
+        printf("Line %d\n", __LINE__);              \
+        while (1)                                   \
+            swiWaitForVBlank();                     \
+    }
+
+// Same generator as the allocator test, so that the results don't depend on
+// the implementation of rand() of the C library.
+static unsigned int seed = 12345;
+
+static unsigned int my_rand(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 16;
+}
+
+// Random f32 value between -range and range
+static int32_t rand_f32(int32_t range)
+{
+    return (int32_t)(my_rand() % (2 * range + 1)) - range;
+}
+
+static void bench_begin(void)
+{
+    seed = 12345;
+    cpuStartTiming(0);
+}
+
+static void bench_end(const char *name, int iterations)
+{
+    u32 ticks = cpuEndTiming();
+    u32 cycles = ticks / iterations;
+
+    printf("%-18s %9lu\n", name, cycles);
+
+    char line[64];
+    snprintf(line, sizeof(line), "BENCH %s %d %lu", name, iterations, cycles);
+    nocashMessage(line);
+}
+
+// Benchmarks that draw
+// ====================
+
+#define DRAW_ITERATIONS 32
+
+typedef struct {
+    NEA_Camera *Camera;
+    NEA_Model *Static;
+    NEA_Model *Animated;
+    NEA_Model *Multi;
+    NEA_Scene *Scene;
+} BenchData;
+
+static void bench_draw_static(void *arg)
+{
+    BenchData *Data = arg;
+
+    NEA_CameraUse(Data->Camera);
+
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+        NEA_ModelDraw(Data->Static);
+    bench_end("model_draw_static", DRAW_ITERATIONS);
+}
+
+static void bench_draw_dsm(void *arg)
+{
+    BenchData *Data = arg;
+
+    NEA_CameraUse(Data->Camera);
+
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+        NEA_ModelDraw(Data->Animated);
+    bench_end("model_draw_dsm", DRAW_ITERATIONS);
+}
+
+static void bench_draw_dlmm(void *arg)
+{
+    BenchData *Data = arg;
+
+    NEA_CameraUse(Data->Camera);
+
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+        NEA_ModelDraw(Data->Multi);
+    bench_end("model_draw_dlmm", DRAW_ITERATIONS);
+}
+
+static void bench_dsma_bones(void *arg)
+{
+    BenchData *Data = arg;
+
+    NEA_CameraUse(Data->Camera);
+
+    // Use a different frame every time so that the pose cache isn't used
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+    {
+        DSMA_PrepareBones(robot_walk_dsa_bin, (i << 12) + 0x800);
+        DSMA_FinishDraw();
+    }
+    bench_end("dsma_prepare_bones", DRAW_ITERATIONS);
+}
+
+static void bench_dsma_blend(void *arg)
+{
+    BenchData *Data = arg;
+
+    NEA_CameraUse(Data->Camera);
+
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+    {
+        DSMA_PrepareBonesBlend(robot_walk_dsa_bin, (i << 12) + 0x800,
+                               robot_wave_dsa_bin, (i << 12) + 0x400,
+                               floattof32(0.5));
+        DSMA_FinishDraw();
+    }
+    bench_end("dsma_bones_blend", DRAW_ITERATIONS);
+}
+
+static void bench_scene_draw(void *arg)
+{
+    BenchData *Data = arg;
+
+    bench_begin();
+    for (int i = 0; i < DRAW_ITERATIONS; i++)
+        NEA_SceneDraw(Data->Scene);
+    bench_end("scene_draw", DRAW_ITERATIONS);
+}
+
+static void bench_sprite_draw(void *arg)
+{
+    (void)arg;
+
+    NEA_2DViewInit();
+
+    NEA_SpriteSetBatchMode(false);
+
+    bench_begin();
+    for (int i = 0; i < 4; i++)
+        NEA_SpriteDrawAll();
+    bench_end("sprite_draw_64", 4);
+}
+
+static void bench_sprite_draw_batch(void *arg)
+{
+    (void)arg;
+
+    NEA_2DViewInit();
+
+    NEA_SpriteSetBatchMode(true);
+
+    bench_begin();
+    for (int i = 0; i < 4; i++)
+        NEA_SpriteDrawAll();
+    bench_end("sprite_batch_64", 4);
+
+    NEA_SpriteSetBatchMode(false);
+}
+
+static void bench_text_print(void *arg)
+{
+    (void)arg;
+
+    NEA_2DViewInit();
+
+    bench_begin();
+    for (int i = 0; i < 16; i++)
+    {
+        NEA_TextPrint(0, 0, i, NEA_White,
+                      "Nitro Engine Advanced benchmark");
+    }
+    bench_end("text_print_32", 16);
+}
+
+static NEA_VoidArgfunc draw_benchmarks[] = {
+    bench_draw_static,
+    bench_draw_dsm,
+    bench_draw_dlmm,
+    bench_dsma_bones,
+    bench_dsma_blend,
+    bench_scene_draw,
+    bench_sprite_draw,
+    bench_sprite_draw_batch,
+    bench_text_print,
+};
+
+// Benchmarks that don't draw
+// ==========================
+
+#define COL_ITERATIONS 256
+
+static void bench_colmesh(void)
+{
+    NEA_ColMesh *mesh = NEA_ColMeshLoad(teapot_col_bin);
+    ASSERT(mesh != NULL);
+
+    NEA_ColShape mesh_shape, sphere, aabb, capsule;
+    NEA_ColShapeInitMesh(&mesh_shape, mesh);
+    NEA_ColShapeInitSphere(&sphere, 0.25);
+    NEA_ColShapeInitAABB(&aabb, 0.25, 0.25, 0.25);
+    NEA_ColShapeInitCapsule(&capsule, 0.25, 0.2);
+
+    NEA_Vec3 origin = NEA_Vec3Make(0, 0, 0);
+    NEA_Vec3 pos[COL_ITERATIONS];
+
+    // Points around the teapot, so that some tests hit it and some don't
+    seed = 12345;
+    for (int i = 0; i < COL_ITERATIONS; i++)
+    {
+        pos[i] = NEA_Vec3Make(rand_f32(inttof32(1)), rand_f32(inttof32(1)),
+                              rand_f32(inttof32(1)));
+    }
+
+    volatile int hits = 0;
+
+    bench_begin();
+    for (int i = 0; i < COL_ITERATIONS; i++)
+        hits += NEA_ColTest(&sphere, pos[i], &mesh_shape, origin).hit;
+    bench_end("col_sphere_mesh", COL_ITERATIONS);
+
+    bench_begin();
+    for (int i = 0; i < COL_ITERATIONS; i++)
+        hits += NEA_ColTest(&aabb, pos[i], &mesh_shape, origin).hit;
+    bench_end("col_aabb_mesh", COL_ITERATIONS);
+
+    bench_begin();
+    for (int i = 0; i < COL_ITERATIONS; i++)
+        hits += NEA_ColTest(&capsule, pos[i], &mesh_shape, origin).hit;
+    bench_end("col_capsule_mesh", COL_ITERATIONS);
+
+    bench_begin();
+    for (int i = 0; i < COL_ITERATIONS; i++)
+    {
+        NEA_Vec3 to = pos[(i + 1) % COL_ITERATIONS];
+        hits += NEA_ColRaycast(pos[i], to, &mesh_shape, origin).hit;
+    }
+    bench_end("col_raycast_mesh", COL_ITERATIONS);
+
+    bench_begin();
+    for (int i = 0; i < COL_ITERATIONS; i++)
+    {
+        NEA_Vec3 to = pos[(i + 1) % COL_ITERATIONS];
+        hits += NEA_ColSweepSphere(&sphere.shape.sphere, pos[i], to,
+                                   &mesh_shape, origin).hit;
+    }
+    bench_end("col_sweep_mesh", COL_ITERATIONS);
+
+    NEA_ColMeshFree(mesh);
+}
+
+#define PHYSICS_ITERATIONS 16
+
+static void bench_physics(int count)
+{
+    NEA_PhysicsSystemReset(count);
+
+    NEA_Model **model = malloc(count * sizeof(NEA_Model *));
+    ASSERT(model != NULL);
+
+    // Objects falling on top of each other in a small volume, so that the
+    // broadphase finds many pairs.
+    seed = 12345;
+    for (int i = 0; i < count; i++)
+    {
+        model[i] = NEA_ModelCreate(NEA_Static);
+        ASSERT(model[i] != NULL);
+        NEA_ModelSetCoordI(model[i], rand_f32(inttof32(4)),
+                           rand_f32(inttof32(4)), rand_f32(inttof32(4)));
+
+        NEA_Physics *physics = NEA_PhysicsCreate((i & 1) ? NEA_BoundingBox
+                                                         : NEA_BoundingSphere);
+        ASSERT(physics != NULL);
+        NEA_PhysicsSetModel(physics, model[i]);
+        NEA_PhysicsSetSize(physics, 0.5, 0.5, 0.5);
+        NEA_PhysicsSetRadius(physics, 0.25);
+        NEA_PhysicsSetGravity(physics, 0.001);
+        NEA_PhysicsOnCollision(physics, NEA_ColBounce);
+        NEA_PhysicsEnable(physics, true);
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "physics_update_%d", count);
+
+    swiWaitForVBlank();
+
+    bench_begin();
+    for (int i = 0; i < PHYSICS_ITERATIONS; i++)
+        NEA_PhysicsUpdateAll();
+    bench_end(name, PHYSICS_ITERATIONS);
+
+    NEA_PhysicsSystemEnd();
+
+    for (int i = 0; i < count; i++)
+        NEA_ModelDelete(model[i]);
+
+    free(model);
+}
+
+#define ALLOC_POOL_SIZE (256 * 1024)
+#define ALLOC_PTRS 256
+#define ALLOC_ITERATIONS 4096
+
+static void bench_alloc(void)
+{
+    void *pool = malloc(ALLOC_POOL_SIZE);
+    ASSERT(pool != NULL);
+
+    NEAChunk *alloc;
+    NEA_AllocInit(&alloc, pool, (char *)pool + ALLOC_POOL_SIZE);
+
+    void *ptr[ALLOC_PTRS] = { NULL };
+
+    swiWaitForVBlank();
+
+    // Replace random chunks of random sizes, like the benchmark of the
+    // allocator test
+    bench_begin();
+    for (int i = 0; i < ALLOC_ITERATIONS; i++)
+    {
+        unsigned int selected = my_rand() % ALLOC_PTRS;
+
+        if (ptr[selected] != NULL)
+            NEA_Free(alloc, ptr[selected]);
+
+        size_t size = ((my_rand() & 0x3F) + 1) * 16;
+        ptr[selected] = NEA_Alloc(alloc, size);
+    }
+    bench_end("alloc_free_churn", ALLOC_ITERATIONS);
+
+    NEA_AllocEnd(&alloc);
+    free(pool);
+}
+
+static void bench_scene_update(NEA_Scene *scene)
+{
+    NEA_SceneNode *cubeA = NEA_SceneFindNode(scene, "CubeA");
+    ASSERT(cubeA != NULL);
+
+    swiWaitForVBlank();
+
+    // Move one node every time so that the transforms are updated
+    bench_begin();
+    for (int i = 0; i < 64; i++)
+    {
+        NEA_SceneNodeSetRot(cubeA, 0, i & 0x1FF, 0);
+        NEA_SceneUpdate(scene);
+    }
+    bench_end("scene_update", 64);
+}
+
+static void bench_animmat(void)
+{
+    NEA_AnimMatSystemReset(32);
+
+    NEA_AnimMatData *scroll = NEA_AnimMatDataLoad(tex_scroll_bin);
+    NEA_AnimMatData *strobe = NEA_AnimMatDataLoad(light_strobe_bin);
+    ASSERT(scroll != NULL && strobe != NULL);
+
+    for (int i = 0; i < 32; i++)
+    {
+        NEA_AnimMatInstance *inst = NEA_AnimMatCreate();
+        ASSERT(inst != NULL);
+        NEA_AnimMatSetData(inst, (i & 1) ? strobe : scroll);
+        NEA_AnimMatStart(inst, NEA_ANIM_LOOP, floattof32(0.5) + i * 64);
+    }
+
+    swiWaitForVBlank();
+
+    bench_begin();
+    for (int i = 0; i < 64; i++)
+        NEA_AnimMatUpdateAll();
+    bench_end("animmat_update_32", 64);
+
+    NEA_AnimMatSystemEnd();
+    NEA_AnimMatDataFree(scroll);
+    NEA_AnimMatDataFree(strobe);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchData Data = { 0 };
+
+    irqEnable(IRQ_HBLANK);
+    irqSet(IRQ_VBLANK, NEA_VBLFunc);
+    irqSet(IRQ_HBLANK, NEA_HBLFunc);
+
+    NEA_Init3D();
+    // libnds uses bank C for the demo text console
+    NEA_TextureSystemReset(0, 0, NEA_VRAM_AB);
+    consoleDemoInit();
+
+    printf("Benchmark          cycles/op\n");
+
+    Data.Camera = NEA_CameraCreate();
+    NEA_CameraSet(Data.Camera,
+                  6, 3, -4,
+                  0, 3, 0,
+                  0, 1, 0);
+
+    Data.Static = NEA_ModelCreate(NEA_Static);
+    ASSERT(NEA_ModelLoadStaticMesh(Data.Static, teapot_bin));
+
+    NEA_Animation *Walk = NEA_AnimationCreate();
+    ASSERT(NEA_AnimationLoad(Walk, robot_walk_dsa_bin));
+    Data.Animated = NEA_ModelCreate(NEA_Animated);
+    ASSERT(NEA_ModelLoadDSM(Data.Animated, robot_dsm_bin));
+    NEA_ModelSetAnimation(Data.Animated, Walk);
+    NEA_ModelAnimStart(Data.Animated, NEA_ANIM_LOOP, floattof32(0.1));
+
+    Data.Multi = NEA_ModelCreate(NEA_Static);
+    ASSERT(NEA_ModelLoadMultiMesh(Data.Multi, brick_wall_small_bin));
+
+    NEA_SceneSystemReset(64);
+    Data.Scene = NEA_SceneLoad(level_neascene_bin, level_neascene_bin_size);
+    ASSERT(Data.Scene != NULL);
+
+    NEA_SceneNode *cubeA = NEA_SceneFindNode(Data.Scene, "CubeA");
+    NEA_SceneNode *cubeB = NEA_SceneFindNode(Data.Scene, "CubeB");
+    if (cubeA && cubeA->model)
+        NEA_ModelLoadStaticMesh(cubeA->model, cube_bin);
+    if (cubeB && cubeB->model)
+        NEA_ModelLoadStaticMesh(cubeB->model, cube_bin);
+
+    NEA_Material *Font = NEA_MaterialCreate();
+    NEA_MaterialTexLoad(Font, NEA_A1RGB5, 256, 64, NEA_TEXGEN_TEXCOORD,
+                        textBitmap);
+    NEA_TextInit(0, Font, 8, 8);
+
+    // Sprites with the same material, so that they can be batched
+    NEA_SpriteSystemReset(64);
+    seed = 12345;
+    for (int i = 0; i < 64; i++)
+    {
+        NEA_Sprite *Sprite = NEA_SpriteCreate();
+        ASSERT(Sprite != NULL);
+        NEA_SpriteSetPos(Sprite, my_rand() % 224, my_rand() % 160);
+        NEA_SpriteSetSize(Sprite, 32, 32);
+        NEA_SpriteSetMaterial(Sprite, Font);
+    }
+
+    NEA_LightSet(0, NEA_White, -0.9, 0, 0);
+    NEA_ClearColorSet(NEA_Black, 31, 63);
+
+    bench_colmesh();
+    bench_physics(16);
+    bench_physics(64);
+    bench_physics(128);
+    bench_alloc();
+    bench_scene_update(Data.Scene);
+    bench_animmat();
+
+    // Draw benchmarks run one per frame, so that they start with an empty
+    // geometry FIFO
+    int count = sizeof(draw_benchmarks) / sizeof(draw_benchmarks[0]);
+    for (int i = 0; i < count; i++)
+    {
+        NEA_WaitForVBL(0);
+        NEA_ProcessArg(draw_benchmarks[i], &Data);
+    }
+
+    nocashMessage("BENCH done");
+    printf("Done!\n");
+
+    while (1)
+        NEA_WaitForVBL(0);
+
+    return 0;
+}
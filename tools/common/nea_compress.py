@@ -0,0 +1,119 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2026 Warioware64
+#
+# Compression of files for Nitro Engine Advanced. Compressed files start with
+# the magic "NECZ", followed by a stream in the format of the DS BIOS. The BIOS
+# decompresses them while they are loaded.
+#
+# Only LZ77 is generated. The displacement of all references is at least 2 so
+# that the data can be decompressed straight into VRAM, which can only be
+# written in 16-bit units.
+
+import io
+import struct
+
+NECZ_MAGIC = 0x5A43454E
+
+LZ77_MIN_LEN = 3
+LZ77_MAX_LEN = 18
+LZ77_MIN_DISP = 2
+LZ77_MAX_DISP = 4096
+
+# Max number of previous positions checked for each match
+MAX_CHAIN = 256
+
+# Set by the "--compress" argument of the tools
+enabled = False
+
+
+def lz77_compress(data):
+    size = len(data)
+    if size >= 1 << 24:
+        raise Exception("File too big to be compressed")
+
+    out = bytearray(struct.pack("<I", (size << 8) | 0x10))
+
+    # Positions of previous occurrences of each sequence of 3 bytes
+    chains = {}
+
+    def insert(pos):
+        if pos + LZ77_MIN_LEN <= size:
+            key = data[pos:pos + LZ77_MIN_LEN]
+            chains.setdefault(key, []).append(pos)
+
+    pos = 0
+    while pos < size:
+        flags_index = len(out)
+        out.append(0)
+
+        for bit in range(8):
+            if pos >= size:
+                break
+
+            best_len = 0
+            best_disp = 0
+
+            key = data[pos:pos + LZ77_MIN_LEN]
+            candidates = chains.get(key, [])
+            max_len = min(LZ77_MAX_LEN, size - pos)
+
+            for start in reversed(candidates[-MAX_CHAIN:]):
+                disp = pos - start
+                if disp > LZ77_MAX_DISP:
+                    break
+                if disp < LZ77_MIN_DISP:
+                    continue
+
+                length = 0
+                while length < max_len and \
+                        data[start + length] == data[pos + length]:
+                    length += 1
+
+                if length > best_len:
+                    best_len = length
+                    best_disp = disp
+                    if length == max_len:
+                        break
+
+            if best_len >= LZ77_MIN_LEN:
+                out[flags_index] |= 0x80 >> bit
+                value = ((best_len - 3) << 12) | (best_disp - 1)
+                out += struct.pack(">H", value)
+                for i in range(best_len):
+                    insert(pos + i)
+                pos += best_len
+            else:
+                out.append(data[pos])
+                insert(pos)
+                pos += 1
+
+    # The BIOS reads the stream in 32-bit units
+    out += bytes(-len(out) & 3)
+
+    return bytes(out)
+
+
+def compress(data):
+    return struct.pack("<I", NECZ_MAGIC) + lz77_compress(bytes(data))
+
+
+class _OutputFile(io.BytesIO):
+    def __init__(self, path):
+        super().__init__()
+        self.path = path
+
+    def close(self):
+        if not self.closed:
+            data = self.getvalue()
+            if enabled:
+                data = compress(data)
+            with open(self.path, "wb") as f:
+                f.write(data)
+        super().close()
+
+
+def open_output(path):
+    """Replacement of open(path, "wb") that compresses the file if the
+    compression is enabled."""
+    return _OutputFile(path)
@@ -6,15 +6,26 @@
 
 # This tool depends on pillow: pip3 install pillow (tested with version 9.0.1)
 
+import contextlib
 import os
+import struct
+import sys
 
 from PIL import Image
 
+# nea_compress is shared by all tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..', 'common'))
+
 from palette import Palette
+import nea_compress
+import texture_auto
 
 VALID_TEXTURE_SIZES = [8, 16, 32, 64, 128, 256, 512, 1024]
 VALID_FORMATS = ["A1RGB5", "PAL256", "PAL16", "PAL4", "A3PAL32", "A5PAL8",
-                 "DEPTHBMP"]
+                 "TEX4X4", "DEPTHBMP"]
+
+DEFAULT_MIN_PSNR = 40.0
 
 
 def is_valid_texture_size(size):
@@ -22,7 +33,7 @@ def is_valid_texture_size(size):
 
 
 def save_binary_file(path, byte_list):
-    with open(path, "wb") as f:
+    with nea_compress.open_output(path) as f:
         f.write(bytearray(byte_list))
 
 
@@ -276,6 +287,24 @@ def convert_a5pal8(img):
     return texture, palette
 
 
+def convert_tex4x4(img):
+    print("Converting to TEX4X4:")
+    print("- If image alpha < 128 -> Transparent")
+    print("- The texture has the data of slot 1 after the texels")
+
+    width, height = img.size
+    if width % 4 or height % 4:
+        raise Exception("The size of TEX4X4 textures must be a multiple of 4")
+
+    rgba = img.convert(mode="RGBA")
+    texture, palette, _, _ = texture_auto.encode_tex4x4(list(rgba.getdata()),
+                                                        width, height)
+
+    print(f"Number of colors = {len(palette)}")
+
+    return texture, texture_auto.pack_palette(palette)
+
+
 def convert_depthbmp(img):
     print("Converting to DEPTHBMP:")
     print("- Depth is calculated like this:")
@@ -305,6 +334,98 @@ def convert_depthbmp(img):
     return texture, palette
 
 
+ATLAS_MAGIC = 0x534C5441 # "ATLS"
+ATLAS_VERSION = 1
+ATLAS_NAME_LEN = 24
+
+
+def pack_shelves(sizes, width, padding):
+    """
+    Packs rectangles in rows ("shelves") of the given width, tallest first.
+    Returns the position of each rectangle and the height used, or None if a
+    rectangle is wider than the atlas.
+    """
+    order = sorted(range(len(sizes)), key=lambda i: (-sizes[i][1], -sizes[i][0]))
+
+    positions = [None] * len(sizes)
+    shelf_y = 0
+    shelf_h = 0
+    x = 0
+
+    for i in order:
+        w, h = sizes[i]
+        if w > width:
+            return None
+
+        if x + w > width:
+            shelf_y += shelf_h + padding
+            shelf_h = 0
+            x = 0
+
+        positions[i] = (x, shelf_y)
+        x += w + padding
+        shelf_h = max(shelf_h, h)
+
+    return positions, shelf_y + shelf_h
+
+
+def build_atlas(in_paths, width, padding):
+    """
+    Packs all images into one. If width is None, the power of two that results
+    in the smallest atlas is used. The height is rounded up to a multiple of 8,
+    it doesn't need to be a power of two.
+    """
+    images = []
+    for path in in_paths:
+        with Image.open(path, "r") as img:
+            images.append(img.convert(mode="RGBA"))
+
+    sizes = [img.size for img in images]
+
+    widths = [width] if width is not None else VALID_TEXTURE_SIZES
+
+    best = None
+    for w in widths:
+        result = pack_shelves(sizes, w, padding)
+        if result is None:
+            continue
+        positions, height = result
+        height = (height + 7) & ~7
+        if height > 1024:
+            continue
+        if best is None or w * height < best[0] * best[1]:
+            best = (w, height, positions)
+
+    if best is None:
+        raise Exception("The images don't fit in a 1024 px wide atlas")
+
+    atlas_w, atlas_h, positions = best
+
+    atlas = Image.new("RGBA", (atlas_w, atlas_h), (0, 0, 0, 0))
+    regions = []
+    for path, img, pos in zip(in_paths, images, positions):
+        atlas.paste(img, pos)
+        name = os.path.splitext(os.path.basename(path))[0]
+        regions.append((name, pos[0], pos[1], img.size[0], img.size[1]))
+
+    return atlas, regions
+
+
+def save_atlas_metadata(path, atlas_w, atlas_h, regions):
+    data = struct.pack("<IHHHH", ATLAS_MAGIC, ATLAS_VERSION, len(regions),
+                       atlas_w, atlas_h)
+
+    for name, x, y, w, h in regions:
+        name_bytes = name.encode("ascii")
+        if len(name_bytes) >= ATLAS_NAME_LEN:
+            raise Exception(f"Name too long: {name} (max {ATLAS_NAME_LEN - 1})")
+        data += struct.pack("<HHHH", x, y, w, h)
+        data += name_bytes.ljust(ATLAS_NAME_LEN, b"\0")
+
+    with nea_compress.open_output(path) as f:
+        f.write(data)
+
+
 def convert_img(in_path, out_name, out_folder, out_format):
 
     if out_format not in VALID_FORMATS:
@@ -313,7 +434,13 @@ def convert_img(in_path, out_name, out_folder, out_format):
     texture_path = os.path.join(out_folder, f"{out_name}_tex.bin")
     palette_path = os.path.join(out_folder, f"{out_name}_pal.bin")
 
-    with Image.open(in_path, "r") as img:
+    # The input can be an image that has already been opened
+    if isinstance(in_path, Image.Image):
+        img_ctx = contextlib.nullcontext(in_path)
+    else:
+        img_ctx = Image.open(in_path, "r")
+
+    with img_ctx as img:
         print(f"Original format: {img.mode}")
 
         width, height = img.size
@@ -322,7 +449,7 @@ def convert_img(in_path, out_name, out_folder, out_format):
         if height not in VALID_TEXTURE_SIZES:
             print(f"WARN: Height {height} is not a valid texture size")
 
-        if out_format != "DEPTHBMP":
+        if out_format not in ("DEPTHBMP", "TEX4X4"):
             print(f"WARN: Formats other than DEPTHBMP are deprecated in img2ds.")
             print(f"WARN: Use grit to convert your textures instead.")
 
@@ -340,6 +467,8 @@ def convert_img(in_path, out_name, out_folder, out_format):
             texture, palette = convert_a3pal32(img)
         elif out_format == "A5PAL8":
             texture, palette = convert_a5pal8(img)
+        elif out_format == "TEX4X4":
+            texture, palette = convert_tex4x4(img)
 
     print(f"Saving texture to: {texture_path}")
     save_binary_file(texture_path, texture)
@@ -349,6 +478,146 @@ def convert_img(in_path, out_name, out_folder, out_format):
         save_binary_file(palette_path, palette)
 
 
+def convert_auto(images, out_folder, min_psnr):
+    """
+    Converts a list of (name, image) with the smallest format that has a PSNR
+    of at least min_psnr dB. Images can be paths or opened images.
+
+    Images with the same pixels are only saved once, and palettes are shared
+    between textures when one palette is the same as another one or starts
+    with all its colors. The result is saved to [name]_auto.txt, with one line
+    per image: name, format, width, height, texture file, palette file (or "-")
+    and "color0" if color 0 of the palette must be transparent.
+    """
+    seen = {}       # Pixels -> manifest entry of the first image
+    palettes = []   # [colors, file name, users]
+    entries = []
+
+    for name, in_path in images:
+        if isinstance(in_path, Image.Image):
+            img_ctx = contextlib.nullcontext(in_path)
+        else:
+            img_ctx = Image.open(in_path, "r")
+
+        with img_ctx as img:
+            width, height = img.size
+            pixels = list(img.convert(mode="RGBA").getdata())
+
+        print(f"{name}: {width}x{height}")
+        if width not in VALID_TEXTURE_SIZES:
+            print(f"WARN: Width {width} is not a valid texture size")
+        if height not in VALID_TEXTURE_SIZES:
+            print(f"WARN: Height {height} is not a valid texture size")
+
+        key = (width, height, tuple(pixels))
+        if key in seen:
+            first = seen[key]
+            print(f"  Same image as {first['name']}, not saved again")
+            entries.append(dict(first, name=name))
+            continue
+
+        result, tried = texture_auto.choose_format(pixels, width, height,
+                                                   min_psnr)
+        for t in tried:
+            mark = "*" if t is result else " "
+            print(f"  {mark} {t['format']:8} {t['size']:7} bytes  "
+                  f"{t['psnr']:6.2f} dB")
+        if result["psnr"] < min_psnr:
+            print(f"WARN: No format reaches {min_psnr} dB, "
+                  f"using {result['format']}")
+
+        texture_path = f"{name}_tex.bin"
+        save_binary_file(os.path.join(out_folder, texture_path),
+                         result["texture"])
+
+        palette_path = "-"
+        colors = result["palette"]
+        if colors:
+            # Look for a palette that starts with the same colors, or a
+            # palette that can be extended with the new colors
+            shared = None
+            for pal in palettes:
+                n = min(len(pal[0]), len(colors))
+                if pal[0][:n] == colors[:n]:
+                    shared = pal
+                    break
+
+            if shared is None:
+                shared = [colors, f"{name}_pal.bin", []]
+                palettes.append(shared)
+            else:
+                print(f"  Palette shared with {shared[2][0]}")
+                if len(colors) > len(shared[0]):
+                    shared[0] = colors
+
+            shared[2].append(name)
+            palette_path = shared[1]
+
+        entry = {
+            "name": name,
+            "format": result["format"],
+            "width": width,
+            "height": height,
+            "texture": texture_path,
+            "palette": palette_path,
+            "color0": result["color0_transparent"],
+            "size": len(result["texture"]),
+        }
+        seen[key] = entry
+        entries.append(entry)
+
+    for colors, path, _ in palettes:
+        save_binary_file(os.path.join(out_folder, path),
+                         texture_auto.pack_palette(colors))
+
+    texture_size = sum(e["size"] for e in seen.values())
+    palette_size = sum(len(p[0]) * 2 for p in palettes)
+    direct_size = sum(e["width"] * e["height"] * 2 for e in entries)
+    print(f"Textures: {texture_size} bytes, palettes: {palette_size} bytes "
+          f"({direct_size} bytes as A1RGB5)")
+
+    return entries
+
+
+def save_auto_manifest(path, entries):
+    lines = []
+    for e in entries:
+        line = (f"{e['name']} {e['format']} {e['width']} {e['height']} "
+                f"{e['texture']} {e['palette']}")
+        if e["color0"]:
+            line += " color0"
+        lines.append(line + "\n")
+
+    print(f"Saving list of textures to: {path}")
+    with open(path, "w") as f:
+        f.writelines(lines)
+
+
+def convert_atlas(in_paths, out_name, out_folder, out_format, width, padding,
+                  min_psnr=None):
+
+    if out_format == "DEPTHBMP":
+        raise Exception("DEPTHBMP can't be used for atlases")
+
+    atlas, regions = build_atlas(in_paths, width, padding)
+    atlas_w, atlas_h = atlas.size
+
+    print(f"Atlas size: {atlas_w}x{atlas_h}")
+    for name, x, y, w, h in regions:
+        print(f"  {name}: {x}, {y} ({w}x{h})")
+
+    if out_format is None:
+        entries = convert_auto([(out_name, atlas)], out_folder, min_psnr)
+        save_auto_manifest(os.path.join(out_folder, f"{out_name}_auto.txt"),
+                           entries)
+    else:
+        convert_img(atlas, out_name, out_folder, out_format)
+
+    atlas_path = os.path.join(out_folder, f"{out_name}_atlas.bin")
+    print(f"Saving atlas to: {atlas_path}")
+    save_atlas_metadata(atlas_path, atlas_w, atlas_h, regions)
+
+
 if __name__ == "__main__":
 
     import argparse
@@ -364,19 +633,61 @@ if __name__ == "__main__":
             description='Convert PNG files into NDS textures.')
 
     # Required arguments
-    parser.add_argument("--input", required=True,
-                        help="input file")
+    parser.add_argument("--input", required=True, nargs="+",
+                        help="input file (several files with --atlas)")
     parser.add_argument("--name", required=True,
                         help="output name: [name]_tex.bin, [name]_pal.bin")
     parser.add_argument("--output", required=True,
                         help="output directory")
-    parser.add_argument("--format", required=True, choices=VALID_FORMATS,
-                        help="format of the texture")
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument("--format", choices=VALID_FORMATS,
+                       help="format of the texture")
+    group.add_argument("--auto", action='store_true',
+                       help="use the smallest format that looks good enough "
+                            "(several input files can be converted at once)")
+
+    # Optional arguments
+    parser.add_argument("--atlas", required=False, action='store_true',
+                        help="pack all input files in one texture and save "
+                             "their rectangles to [name]_atlas.bin")
+    parser.add_argument("--atlas-width", required=False, type=int,
+                        choices=VALID_TEXTURE_SIZES, default=None,
+                        help="width of the atlas (default: smallest atlas)")
+    parser.add_argument("--atlas-padding", required=False, type=int,
+                        default=0,
+                        help="empty pixels between images of the atlas")
+    parser.add_argument("--compress", required=False, action='store_true',
+                        help="compress the output files with LZ77")
+    parser.add_argument("--min-psnr", required=False, type=float,
+                        default=DEFAULT_MIN_PSNR,
+                        help="minimum quality of --auto in dB (default: "
+                             f"{DEFAULT_MIN_PSNR})")
 
     args = parser.parse_args()
 
+    nea_compress.enabled = args.compress
+
     try:
-        convert_img(args.input, args.name, args.output, args.format)
+        if args.atlas:
+            convert_atlas(args.input, args.name, args.output, args.format,
+                          args.atlas_width, args.atlas_padding, args.min_psnr)
+        elif args.auto:
+            # Each image is saved as [name]_[file name] if there are several
+            if len(args.input) == 1:
+                images = [(args.name, args.input[0])]
+            else:
+                images = []
+                for path in args.input:
+                    base = os.path.splitext(os.path.basename(path))[0]
+                    images.append((f"{args.name}_{base}", path))
+
+            entries = convert_auto(images, args.output, args.min_psnr)
+            save_auto_manifest(os.path.join(args.output,
+                                            f"{args.name}_auto.txt"), entries)
+        else:
+            if len(args.input) != 1:
+                raise Exception("Only one input file allowed without --atlas")
+            convert_img(args.input[0], args.name, args.output, args.format)
     except BaseException as e:
         print("ERROR: " + str(e))
         traceback.print_exc()
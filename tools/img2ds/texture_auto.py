@@ -0,0 +1,370 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2026 Warioware64
+
+"""
+Encoders used by the automatic format selection of img2ds.
+
+Unlike the converters of img2ds.py, they don't fail if an image has too many
+colors: the colors are reduced with median cut. Each encoder returns the data
+of the texture, the palette (a list of 5-bit RGB colors) and the image as the
+GPU would draw it, so that the result can be compared with the original image.
+
+Pixels are (r, g, b, a) tuples with 8-bit components, in row-major order.
+"""
+
+import math
+
+# Pixels with alpha below this are transparent in formats with 1-bit alpha
+ALPHA_THRESHOLD = 128
+
+
+def expand5(v):
+    """Expands a 5-bit component to 8 bits."""
+    return (v << 3) | (v >> 2)
+
+
+def rgb5(pixel):
+    r, g, b, _ = pixel
+    return (r >> 3, g >> 3, b >> 3)
+
+
+def color_to_rgba(color, alpha=255):
+    return (expand5(color[0]), expand5(color[1]), expand5(color[2]), alpha)
+
+
+def pack_palette(palette):
+    data = []
+    for r, g, b in palette:
+        v = r | (g << 5) | (b << 10)
+        data.extend([v & 0xFF, v >> 8])
+    return data
+
+
+def pack_indices(indices, bits):
+    """Packs indices in bytes, the first index goes to the lowest bits."""
+    per_byte = 8 // bits
+    data = []
+    for i in range(0, len(indices), per_byte):
+        v = 0
+        for j in range(per_byte):
+            v |= indices[i + j] << (j * bits)
+        data.append(v)
+    return data
+
+
+def psnr(original, decoded):
+    """
+    Returns the PSNR in dB of an image drawn by the GPU. The color is weighted
+    by the alpha, so the color of transparent pixels doesn't matter.
+    """
+    total = 0
+    for (r0, g0, b0, a0), (r1, g1, b1, a1) in zip(original, decoded):
+        total += ((r0 * a0 - r1 * a1) ** 2 + (g0 * a0 - g1 * a1) ** 2
+                  + (b0 * a0 - b1 * a1) ** 2) / (255 * 255)
+        total += (a0 - a1) ** 2
+
+    mse = total / (len(original) * 4)
+    if mse == 0:
+        return math.inf
+    return 10 * math.log10(255 * 255 / mse)
+
+
+def median_cut(counts, max_colors):
+    """
+    Reduces a dictionary of {color: number of pixels} to at most max_colors
+    colors. Returns the palette and a dictionary that maps each color to its
+    index in the palette. Palettes of images with few colors are sorted, so
+    that images with the same colors get the same palette.
+    """
+    if len(counts) <= max_colors:
+        palette = sorted(counts.keys())
+        return palette, {c: i for i, c in enumerate(palette)}
+
+    boxes = [list(counts.keys())]
+
+    def box_range(box):
+        return max(max(c[k] for c in box) - min(c[k] for c in box)
+                   for k in range(3))
+
+    while len(boxes) < max_colors:
+        # Split the box with the widest range of colors
+        candidates = [b for b in boxes if len(b) > 1]
+        if not candidates:
+            break
+        box = max(candidates, key=lambda b: (box_range(b),
+                                             sum(counts[c] for c in b)))
+        axis = max(range(3), key=lambda k: max(c[k] for c in box)
+                                           - min(c[k] for c in box))
+        box.sort(key=lambda c: c[axis])
+
+        # Weighted median
+        half = sum(counts[c] for c in box) / 2
+        acc = 0
+        split = 1
+        for i, c in enumerate(box[:-1]):
+            acc += counts[c]
+            split = i + 1
+            if acc >= half:
+                break
+
+        boxes.remove(box)
+        boxes.append(box[:split])
+        boxes.append(box[split:])
+
+    palette = []
+    mapping = {}
+    for box in boxes:
+        weight = sum(counts[c] for c in box)
+        avg = tuple(int(sum(c[k] * counts[c] for c in box) / weight + 0.5)
+                    for k in range(3))
+        for c in box:
+            mapping[c] = len(palette)
+        palette.append(avg)
+
+    return palette, mapping
+
+
+def encode_paletted(pixels, num_colors, bits):
+    """PAL4, PAL16 and PAL256. Transparent pixels use color 0."""
+    transparent = any(p[3] < ALPHA_THRESHOLD for p in pixels)
+    first = 1 if transparent else 0
+
+    counts = {}
+    for p in pixels:
+        if p[3] >= ALPHA_THRESHOLD:
+            c = rgb5(p)
+            counts[c] = counts.get(c, 0) + 1
+
+    palette, mapping = median_cut(counts, num_colors - first)
+
+    indices = []
+    decoded = []
+    for p in pixels:
+        if p[3] < ALPHA_THRESHOLD:
+            indices.append(0)
+            decoded.append((0, 0, 0, 0))
+        else:
+            index = mapping[rgb5(p)]
+            indices.append(index + first)
+            decoded.append(color_to_rgba(palette[index]))
+
+    if transparent:
+        # Make color 0 magenta for VRAM viewers in emulators
+        palette = [(31, 0, 31)] + palette
+
+    return pack_indices(indices, bits), palette, decoded, transparent
+
+
+def encode_translucent(pixels, num_colors, alpha_bits):
+    """A3PAL32 and A5PAL8. Colors are only reduced for visible pixels."""
+    index_bits = 8 - alpha_bits
+    alpha_max = (1 << alpha_bits) - 1
+
+    def quantize_alpha(a):
+        return (a * alpha_max + 127) // 255
+
+    counts = {}
+    for p in pixels:
+        if quantize_alpha(p[3]) > 0:
+            c = rgb5(p)
+            counts[c] = counts.get(c, 0) + 1
+
+    palette, mapping = median_cut(counts, num_colors)
+    if not palette:
+        palette = [(0, 0, 0)]
+
+    texture = []
+    decoded = []
+    for p in pixels:
+        alpha = quantize_alpha(p[3])
+        if alpha == 0:
+            texture.append(0)
+            decoded.append((0, 0, 0, 0))
+            continue
+
+        index = mapping[rgb5(p)]
+        texture.append(index | (alpha << index_bits))
+
+        # The GPU expands the alpha to 5 bits
+        if alpha_bits == 3:
+            alpha5 = (alpha << 2) | (alpha >> 1)
+        else:
+            alpha5 = alpha
+        decoded.append(color_to_rgba(palette[index], alpha5 * 255 // 31))
+
+    return texture, palette, decoded, False
+
+
+def encode_a1rgb5(pixels):
+    texture = []
+    decoded = []
+    for p in pixels:
+        r, g, b = rgb5(p)
+        a = 1 if p[3] >= ALPHA_THRESHOLD else 0
+        v = r | (g << 5) | (b << 10) | (a << 15)
+        texture.extend([v & 0xFF, v >> 8])
+        decoded.append(color_to_rgba((r, g, b)) if a else (0, 0, 0, 0))
+    return texture, [], decoded, False
+
+
+def color_dist2(a, b):
+    return (a[0] - b[0]) ** 2 + (a[1] - b[1]) ** 2 + (a[2] - b[2]) ** 2
+
+
+def tex4x4_colors(c0, c1, mode):
+    """Colors of a block of the 4x4 texel format, None for transparent."""
+    if mode == 1:
+        mid = tuple((c0[k] + c1[k]) // 2 for k in range(3))
+        return [c0, c1, mid, None]
+    mix0 = tuple((c0[k] * 5 + c1[k] * 3) // 8 for k in range(3))
+    mix1 = tuple((c0[k] * 3 + c1[k] * 5) // 8 for k in range(3))
+    return [c0, c1, mix0, mix1]
+
+
+def tex4x4_block(block):
+    """
+    Encodes 16 pixels. Returns (mode, palette colors, indices, error). Blocks
+    with 4 colors or less use them directly (modes 0 and 2). Other blocks use
+    two colors of the block as endpoints (modes 1 and 3).
+    """
+    opaque = [rgb5(p) for p in block if p[3] >= ALPHA_THRESHOLD]
+    transparent = len(opaque) < len(block)
+    unique = sorted(set(opaque))
+
+    if len(unique) <= (3 if transparent else 4):
+        colors = unique + [(0, 0, 0)] * (4 - len(unique))
+        indices = []
+        for p in block:
+            if p[3] < ALPHA_THRESHOLD:
+                indices.append(3)
+            else:
+                indices.append(colors.index(rgb5(p)))
+        return (0 if transparent else 2), colors, indices, 0
+
+    # The pair of colors that are farthest apart, and the same pair moved a bit
+    # towards each other, which is better if the block has outliers.
+    best_pair = max(((a, b) for a in unique for b in unique if a < b),
+                    key=lambda pair: color_dist2(*pair))
+    c0, c1 = best_pair
+    inset = (tuple(c0[k] + (c1[k] - c0[k]) // 8 for k in range(3)),
+             tuple(c1[k] - (c1[k] - c0[k]) // 8 for k in range(3)))
+
+    mode = 1 if transparent else 3
+    best = None
+    for pair in (best_pair, inset):
+        colors = tex4x4_colors(pair[0], pair[1], mode)
+        indices = []
+        error = 0
+        for p in block:
+            if p[3] < ALPHA_THRESHOLD:
+                indices.append(3)
+                continue
+            c = rgb5(p)
+            dists = [color_dist2(c, col) if col is not None else math.inf
+                     for col in colors]
+            index = dists.index(min(dists))
+            indices.append(index)
+            error += dists[index]
+        if best is None or error < best[3]:
+            best = (mode, list(pair), indices, error)
+
+    return best
+
+
+def encode_tex4x4(pixels, width, height):
+    """
+    4x4 texel format. The texel data is followed by the palette index data
+    (the part that goes to texture slot 1), like NEA_MaterialTexLoad() expects.
+    Palette entries are shared between blocks when possible.
+    """
+    palette = []
+    offsets = {}
+    texels = []
+    slot1 = []
+    decoded = [None] * len(pixels)
+
+    for by in range(0, height, 4):
+        for bx in range(0, width, 4):
+            coords = [(bx + x, by + y) for y in range(4) for x in range(4)]
+            block = [pixels[y * width + x] for x, y in coords]
+
+            mode, colors, indices, _ = tex4x4_block(block)
+
+            # Palette offsets are in units of 2 colors
+            key = tuple(colors)
+            if key not in offsets:
+                offsets[key] = len(palette) // 2
+                palette.extend(colors)
+            offset = offsets[key]
+            if offset >= (1 << 14):
+                raise Exception("Too many colors for the 4x4 texel format")
+
+            slot1.extend([offset & 0xFF, (offset >> 8) | (mode << 6)])
+            for y in range(4):
+                row = indices[y * 4:y * 4 + 4]
+                texels.append(row[0] | (row[1] << 2) | (row[2] << 4)
+                              | (row[3] << 6))
+
+            if mode in (0, 2):
+                shown = [colors[0], colors[1], colors[2],
+                         None if mode == 0 else colors[3]]
+            else:
+                shown = tex4x4_colors(colors[0], colors[1], mode)
+            for (x, y), index in zip(coords, indices):
+                col = shown[index]
+                decoded[y * width + x] = (0, 0, 0, 0) if col is None \
+                    else color_to_rgba(col)
+
+    return texels + slot1, palette, decoded, False
+
+
+# Formats tried by the automatic selection, from the smallest to the biggest
+AUTO_FORMATS = [
+    ("PAL4", lambda px, w, h: encode_paletted(px, 4, 2)),
+    ("TEX4X4", encode_tex4x4),
+    ("PAL16", lambda px, w, h: encode_paletted(px, 16, 4)),
+    ("A5PAL8", lambda px, w, h: encode_translucent(px, 8, 5)),
+    ("A3PAL32", lambda px, w, h: encode_translucent(px, 32, 3)),
+    ("PAL256", lambda px, w, h: encode_paletted(px, 256, 8)),
+    ("A1RGB5", lambda px, w, h: encode_a1rgb5(px)),
+]
+
+
+def choose_format(pixels, width, height, min_psnr):
+    """
+    Encodes an image with the smallest format whose PSNR is at least min_psnr.
+    The size of a format is its texture plus its palette. If no format is good
+    enough, the one with the best PSNR is used. Returns the result and the list
+    of all the formats that have been tried.
+
+    The results are compared with the image with 5-bit colors, which is the
+    best that the GPU can show. Otherwise smooth gradients wouldn't reach the
+    threshold in any format.
+    """
+    reference = [color_to_rgba(rgb5(p), p[3]) for p in pixels]
+
+    tried = []
+    for name, encoder in AUTO_FORMATS:
+        if name == "TEX4X4" and (width % 4 or height % 4):
+            continue
+
+        texture, palette, decoded, color0 = encoder(pixels, width, height)
+        result = {
+            "format": name,
+            "texture": texture,
+            "palette": palette,
+            "color0_transparent": color0,
+            "psnr": psnr(reference, decoded),
+            "size": len(texture) + len(palette) * 2,
+        }
+        tried.append(result)
+
+    if not tried:
+        raise Exception("No format can be used for this image")
+
+    good = [r for r in tried if r["psnr"] >= min_psnr]
+    if good:
+        return min(good, key=lambda r: r["size"]), tried
+
+    return max(tried, key=lambda r: r["psnr"]), tried
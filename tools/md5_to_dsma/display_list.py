@@ -2,6 +2,8 @@
 #
 # Copyright (c) 2022 Antonio Niño Díaz <antonio_nd@outlook.com>
 
+import nea_compress
+
 def float_to_v16(val):
     res = int(val * (1 << 12))
     if res < -0x8000:
@@ -176,7 +178,7 @@ class DisplayList():
         return bytes(data)
 
     def save_to_file(self, path):
-        with open(path, "wb") as f:
+        with nea_compress.open_output(path) as f:
             f.write(self.get_binary())
 
     def nop(self):
@@ -6,11 +6,17 @@
 
 import os
 import struct
+import sys
 
 from collections import namedtuple, defaultdict
-from math import sqrt
+from math import ceil, floor, sqrt
+
+# nea_compress is shared by all tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..', 'common'))
 
 from display_list import DisplayList, float_to_f32, float_to_n10
+import nea_compress
 
 class MD5FormatError(Exception):
     pass
@@ -58,10 +64,127 @@ def get_image_dimensions(path):
 
 
 DLMM_MAGIC = 0x4D4D4C44  # "DLMM" in little-endian
-DLMM_VERSION = 1
+DLMM_VERSION = 2
+DLMM_HEADER_SIZE = 32  # the end is reserved for the engine
 DLMM_SUBMESH_HEADER_SIZE = 56  # bytes per submesh header
 
-def save_dlmm(output_file, submeshes):
+BOUNDS_MAGIC = 0x48505342  # "BSPH" in little-endian
+
+def compute_bounds_chunk(joints, meshes, blender_fix):
+    """Return the bounding sphere chunk of the model in its base pose.
+
+    The center is the center of the AABB of all vertices, and the radius is the
+    distance to the furthest vertex. The chunk is placed at the start of the
+    output file, and Nitro Engine Advanced skips it when loading the mesh.
+    """
+    positions = []
+    for mesh in meshes:
+        for vert in mesh.verts:
+            weight = mesh.weights[vert.startWeight]
+            joint = joints[weight.joint]
+            m = joint_info_to_m4x3(joint.orient, joint.pos)
+            pos = weight.pos.mul_m4x3(m)
+            if blender_fix:
+                pos = Vector(pos.x, pos.z, -pos.y)
+            positions.append(pos)
+
+    if len(positions) == 0:
+        return b''
+
+    center = Vector((min(p.x for p in positions) + max(p.x for p in positions)) / 2,
+                    (min(p.y for p in positions) + max(p.y for p in positions)) / 2,
+                    (min(p.z for p in positions) + max(p.z for p in positions)) / 2)
+
+    radius = max(p.sub(center).length() for p in positions)
+
+    # Round the radius up so that the sphere is conservative in f32
+    radius += 1 / (1 << 12)
+
+    print(f"Bounding sphere (base pose): radius {radius}")
+
+    return struct.pack('<IIIII', BOUNDS_MAGIC,
+                       float_to_f32(center.x), float_to_f32(center.y),
+                       float_to_f32(center.z), float_to_f32(radius))
+
+ANIM_BOUNDS_MAGIC = 0x584F4241  # "ABOX" in little-endian
+
+# Number of poses checked between two frames to calculate animation bounds
+ANIM_BOUNDS_SAMPLES = 4
+
+def compute_anim_bounds_chunk(meshes, frames, frames_per_range, blender_fix,
+                              tolerance=0):
+    """Return the animation bounds chunk of an animation.
+
+    The frames are split in ranges of 'frames_per_range' frames, and the chunk
+    has the box that contains the vertices of the mesh in all the poses of
+    each range, including the poses interpolated up to the first frame of the
+    next range (frame 0 after the last frame). The joints are interpolated the
+    same way as dsma.c does it. The chunk is placed at the start of the DSA
+    file, and Nitro Engine Advanced skips it when loading the animation.
+    """
+    verts = []
+    for mesh in meshes:
+        for vert in mesh.verts:
+            weight = mesh.weights[vert.startWeight]
+            verts.append((weight.joint, weight.pos))
+
+    if len(verts) == 0:
+        return b''
+
+    # Reduced animations can be off by the tolerance, which also moves the
+    # vertices that are far from their joint.
+    max_dist = max(pos.length() for _, pos in verts)
+    pad = (tolerance / (1 << 12)) * (1 + 4 * max_dist) + 1 / (1 << 12)
+
+    def lerp(a, b, t):
+        return a + (b - a) * t
+
+    def pose_bounds(joints_1, joints_2, t, box):
+        matrices = []
+        for j1, j2 in zip(joints_1, joints_2):
+            pos = Vector(lerp(j1.pos.x, j2.pos.x, t), lerp(j1.pos.y, j2.pos.y, t),
+                         lerp(j1.pos.z, j2.pos.z, t))
+            # Like q_nlerp() in dsma.c, the result isn't normalized
+            q = Quaternion(lerp(j1.orient.w, j2.orient.w, t),
+                           lerp(j1.orient.x, j2.orient.x, t),
+                           lerp(j1.orient.y, j2.orient.y, t),
+                           lerp(j1.orient.z, j2.orient.z, t))
+            matrices.append(joint_info_to_m4x3(q, pos))
+
+        for joint, pos in verts:
+            p = pos.mul_m4x3(matrices[joint])
+            if blender_fix:
+                p = Vector(p.x, p.z, -p.y)
+            for i, v in enumerate((p.x, p.y, p.z)):
+                box[i] = min(box[i], v)
+                box[i + 3] = max(box[i + 3], v)
+
+    num_frames = len(frames)
+    num_ranges = (num_frames + frames_per_range - 1) // frames_per_range
+
+    data = struct.pack('<3I', ANIM_BOUNDS_MAGIC, num_ranges, frames_per_range)
+
+    for r in range(num_ranges):
+        box = [float('inf')] * 3 + [float('-inf')] * 3
+
+        start = r * frames_per_range
+        end = min(start + frames_per_range, num_frames)
+        for f in range(start, end):
+            next_frame = (f + 1) % num_frames
+            for s in range(ANIM_BOUNDS_SAMPLES + 1):
+                pose_bounds(frames[f], frames[next_frame],
+                            s / ANIM_BOUNDS_SAMPLES, box)
+
+        data += struct.pack('<6i',
+                            *[floor((v - pad) * (1 << 12)) for v in box[:3]],
+                            *[ceil((v + pad) * (1 << 12)) for v in box[3:]])
+
+    print(f"  Animation bounds: {num_ranges} range(s) of {frames_per_range} "
+          "frame(s)")
+
+    return data
+
+def save_dlmm(output_file, submeshes, bounds=b''):
     """Write multi-material model to .dlmm binary format.
 
     Args:
@@ -74,9 +197,10 @@ def save_dlmm(output_file, submeshes):
             'color': u16 RGB15
             'alpha': u16 (0-31)
             'has_texture': bool
+        bounds: optional bounding sphere chunk written before the header
     """
     num = len(submeshes)
-    header_size = 12 + DLMM_SUBMESH_HEADER_SIZE * num
+    header_size = DLMM_HEADER_SIZE + DLMM_SUBMESH_HEADER_SIZE * num
 
     dl_binaries = []
     for sub in submeshes:
@@ -88,8 +212,12 @@ def save_dlmm(output_file, submeshes):
         dl_offsets.append(offset)
         offset += len(dl_bin)
 
-    with open(output_file, 'wb') as f:
+    with nea_compress.open_output(output_file) as f:
+        # Offsets are relative to the DLMM header, not to the bounds chunk
+        f.write(bounds)
+
         f.write(struct.pack('<III', DLMM_MAGIC, DLMM_VERSION, num))
+        f.write(b'\x00' * (DLMM_HEADER_SIZE - 12))
 
         for i, sub in enumerate(submeshes):
             flags = 0
@@ -101,7 +229,7 @@ def save_dlmm(output_file, submeshes):
 
             f.write(struct.pack('<IIIII',
                 dl_offsets[i],
-                len(dl_binaries[i]),
+                0,  # Material pointer, set by the engine
                 sub['diffuse_ambient'],
                 sub['specular_emission'],
                 sub['color']))
@@ -645,18 +773,24 @@ def parse_md5anim(input_file):
 
     return frames
 
-def save_animation(frames, output_file, blender_fix):
+def f32_to_signed(val):
+    if val >= 0x80000000:
+        return val - 0x100000000
+    return val
 
-    version = 1
-    num_frames = len(frames)
-    num_bones = len(frames[0])
+def animation_to_f32(frames, blender_fix):
+    """Returns, for every frame, a list of (pos, orient) tuples of all joints
+    in signed f32 format."""
 
-    u32_array = [version, num_frames, num_bones]
+    num_bones = len(frames[0])
+    result = []
 
     for joints in frames:
         if num_bones != len(joints):
             raise MD5FormatError("Different number of bones across frames")
 
+        frame = []
+
         for joint in joints:
             this_pos = joint.pos
             this_orient = joint.orient
@@ -674,10 +808,175 @@ def save_animation(frames, output_file, blender_fix):
             orient = [float_to_f32(this_orient.w), float_to_f32(this_orient.x),
                       float_to_f32(this_orient.y), float_to_f32(this_orient.z)]
 
+            frame.append(([f32_to_signed(v) for v in pos],
+                          [f32_to_signed(v) for v in orient]))
+
+        result.append(frame)
+
+    return result
+
+def f32_lerp(start, end, pos):
+    # Same as lerp() in dsma.c
+    return start + (((end - start) * pos) >> 12)
+
+def track_is_constant(values, tolerance):
+    first = values[0]
+    for v in values[1:]:
+        for a, b in zip(first, v):
+            if abs(a - b) > tolerance:
+                return False
+    return True
+
+def segment_is_valid(tracks, start, end, tolerance):
+    """Checks if all frames between 'start' and 'end' can be rebuilt by
+    interpolating them, the same way as dsma.c does it."""
+    length = end - start
+    for f in range(start + 1, end):
+        interp = ((f - start) << 12) // length
+        for values in tracks:
+            for a, b, real in zip(values[start], values[end], values[f]):
+                if abs(f32_lerp(a, b, interp) - real) > tolerance:
+                    return False
+    return True
+
+def reduce_keys(tracks, num_frames, tolerance):
+    """Returns the list of frames that have to be stored. The first and last
+    frames are always stored."""
+    keys = [0]
+    start = 0
+    while start < num_frames - 1:
+        end = start + 1
+        while end + 1 < num_frames and \
+              segment_is_valid(tracks, start, end + 1, tolerance):
+            end += 1
+        keys.append(end)
+        start = end
+    return keys
+
+def save_animation_reduced(frames, output_file, tolerance, bounds=b''):
+
+    version = 2
+    num_frames = len(frames)
+    num_bones = len(frames[0])
+
+    # Remove the tracks that don't change
+    joints = []
+    tracks = []
+    key_size = 0
+    for j in range(num_bones):
+        pos = [frame[j][0] for frame in frames]
+        orient = [frame[j][1] for frame in frames]
+
+        flags = 0
+        offset = key_size
+        if not track_is_constant(pos, tolerance):
+            flags |= 1
+            tracks.append(pos)
+            key_size += 3 * 4
+        if not track_is_constant(orient, tolerance):
+            flags |= 2
+            tracks.append(orient)
+            key_size += 4 * 2
+
+        if offset > 0xFFFF:
+            raise MD5FormatError("Too much animated data per frame")
+
+        joints.append((pos[0], orient[0], flags, offset))
+
+    keys = reduce_keys(tracks, num_frames, tolerance)
+    num_keys = len(keys)
+
+    data = struct.pack("<5I", version, num_frames, num_bones, num_keys,
+                       key_size)
+
+    key_frames = list(keys)
+    if len(key_frames) % 2 == 1:
+        key_frames.append(0)
+    data += struct.pack(f"<{len(key_frames)}H", *key_frames)
+
+    for pos, orient, flags, offset in joints:
+        data += struct.pack("<3i4hHH", *pos, *orient, flags, offset)
+
+    for k in keys:
+        for j in range(num_bones):
+            pos, orient = frames[k][j]
+            flags = joints[j][2]
+            if flags & 1:
+                data += struct.pack("<3i", *pos)
+            if flags & 2:
+                data += struct.pack("<4h", *orient)
+
+    with nea_compress.open_output(output_file) as f:
+        f.write(bounds)
+        f.write(data)
+
+    full_size = 12 + num_frames * num_bones * 7 * 4
+    print(f"  {num_keys}/{num_frames} frames stored, "
+          f"{len(data)} bytes (instead of {full_size})")
+
+def f32_mul_by_2(a, b):
+    # Same as mulf32_by_2() in dsma.c
+    return (a * b) >> (12 - 1)
+
+def joint_to_f32_m4x3(pos, q):
+    # Same as joint_to_matrix() in dsma.c, so that the result is identical to
+    # the matrices generated on the DS.
+    wx = f32_mul_by_2(q[0], q[1])
+    wy = f32_mul_by_2(q[0], q[2])
+    wz = f32_mul_by_2(q[0], q[3])
+    x2 = f32_mul_by_2(q[1], q[1])
+    xy = f32_mul_by_2(q[1], q[2])
+    xz = f32_mul_by_2(q[1], q[3])
+    y2 = f32_mul_by_2(q[2], q[2])
+    yz = f32_mul_by_2(q[2], q[3])
+    z2 = f32_mul_by_2(q[3], q[3])
+
+    one = 1 << 12
+
+    return [one - y2 - z2, xy + wz, xz - wy,
+            xy - wz, one - x2 - z2, yz + wx,
+            xz + wy, yz - wx, one - x2 - y2,
+            pos[0], pos[1], pos[2]]
+
+def save_baked_matrices(frames, output_file, blender_fix):
+
+    frames = animation_to_f32(frames, blender_fix)
+
+    magic = 0x4D415344 # "DSAM"
+    num_frames = len(frames)
+    num_bones = len(frames[0])
+
+    data = struct.pack("<4I", magic, num_frames, num_bones, 0)
+
+    for joints in frames:
+        for pos, orient in joints:
+            data += struct.pack("<12i", *joint_to_f32_m4x3(pos, orient))
+
+    with nea_compress.open_output(output_file) as f:
+        f.write(data)
+
+def save_animation(frames, output_file, blender_fix, reduce=False,
+                   tolerance=0, bounds=b''):
+
+    frames = animation_to_f32(frames, blender_fix)
+
+    if reduce:
+        save_animation_reduced(frames, output_file, tolerance, bounds)
+        return
+
+    version = 1
+    num_frames = len(frames)
+    num_bones = len(frames[0])
+
+    u32_array = [version, num_frames, num_bones]
+
+    for joints in frames:
+        for pos, orient in joints:
             u32_array.extend(pos)
             u32_array.extend(orient)
 
-    with open(output_file, "wb") as f:
+    with nea_compress.open_output(output_file) as f:
+        f.write(bounds)
         for u32 in u32_array:
             b = [u32 & 0xFF, \
                 (u32 >> 8) & 0xFF, \
@@ -775,11 +1074,186 @@ def stripify_triangles(resolved_tris):
     return strips, singles
 
 # ---------------------------------------------------------------------------
+# Joint-aware triangle ordering
+# ---------------------------------------------------------------------------
+
+def count_joint_switches(plan, vk_joint, last_joint=None):
+    """Returns the number of MTX_RESTORE commands needed to draw a plan and the
+    joint used by the last vertex."""
+    count = 0
+    for poly_type, vkeys in plan:
+        for vk in vkeys:
+            if vk_joint[vk] != last_joint:
+                count += 1
+                last_joint = vk_joint[vk]
+    return count, last_joint
+
+def plan_triangles(resolved_tris, no_strip):
+    """Returns the list of (poly_type, vertex_keys) that draws the triangles in
+    the order in which they are stripified, without looking at the joints."""
+    if no_strip:
+        strips, singles = [], list(range(len(resolved_tris)))
+    else:
+        strips, singles = stripify_triangles(resolved_tris)
+
+    plan = [("triangle_strip", strip) for strip, _ in strips]
+    if singles:
+        vkeys = []
+        for fi in singles:
+            vkeys.extend(resolved_tris[fi])
+        plan.append(("triangles", vkeys))
+    return plan
+
+def order_by_joints(plan, strips, singles, vk_joint, last_joint):
+    """Appends some strips and separate triangles to a plan so that each one
+    starts with the joint used by the end of the previous one. Separate
+    triangles are rotated so that their first vertex uses the current joint
+    (rotating a triangle keeps its winding). Returns the last joint used."""
+
+    def add(poly_type, vkeys):
+        # Consecutive lists of separate triangles can share one BEGIN_VTXS
+        if poly_type == "triangles" and plan and plan[-1][0] == "triangles":
+            plan[-1][1].extend(vkeys)
+        else:
+            plan.append((poly_type, list(vkeys)))
+
+    pending = list(strips)
+    while pending:
+        index = 0
+        for i, strip in enumerate(pending):
+            if vk_joint[strip[0]] == last_joint:
+                index = i
+                break
+        strip = pending.pop(index)
+        add("triangle_strip", strip)
+        last_joint = vk_joint[strip[-1]]
+
+    pending = list(singles)
+    while pending:
+        best = None
+        for i, tri in enumerate(pending):
+            for rot in range(3):
+                vkeys = tri[rot:] + tri[:rot]
+                cost, _ = count_joint_switches([(None, vkeys)], vk_joint,
+                                               last_joint)
+                if best is None or cost < best[0]:
+                    best = (cost, i, vkeys)
+            if best[0] == 0:
+                break
+        pending.pop(best[1])
+        add("triangles", best[2])
+        last_joint = vk_joint[best[2][-1]]
+
+    return last_joint
+
+def plan_cost(plan, vk_joint, last_joint):
+    """Rough number of GPU commands needed to draw a plan. Each vertex needs a
+    normal, a texture coordinate and a position."""
+    restores, _ = count_joint_switches(plan, vk_joint, last_joint)
+    vertices = sum(len(vkeys) for _, vkeys in plan)
+    return restores + vertices * 3 + len(plan) * 2
+
+def plan_triangles_by_joints(resolved_tris, vk_joint, no_strip,
+                             last_joint=None):
+    """Returns a list of (poly_type, vertex_keys) that draws the triangles with
+    as few joint switches as possible.
+
+    Two orders are tried. In the first one the strips are built from all the
+    triangles and only their order is changed. In the second one the triangles
+    are grouped by the set of joints that they use and strips are only built
+    inside each group, which saves more joint switches but may result in
+    shorter strips. The one that needs fewer commands is returned.
+    """
+    if no_strip:
+        strips, singles = [], list(range(len(resolved_tris)))
+    else:
+        strips, singles = stripify_triangles(resolved_tris)
+
+    global_plan = []
+    order_by_joints(global_plan, [strip for strip, _ in strips],
+                    [resolved_tris[fi] for fi in singles], vk_joint,
+                    last_joint)
+
+    groups = defaultdict(list)
+    for tri in resolved_tris:
+        joints = tuple(sorted(set(vk_joint[vk] for vk in tri)))
+        groups[joints].append(tri)
+
+    remaining = sorted(groups.keys())
+    group_plan = []
+    group_last = last_joint
+
+    while remaining:
+        # Prefer groups that use the current joint, then the smallest ones
+        choice = None
+        for joints in remaining:
+            if group_last in joints:
+                if choice is None or len(joints) < len(choice):
+                    choice = joints
+        if choice is None:
+            choice = remaining[0]
+        remaining.remove(choice)
+
+        tris = groups[choice]
+        if no_strip:
+            strips, singles = [], list(range(len(tris)))
+        else:
+            strips, singles = stripify_triangles(tris)
+
+        group_last = order_by_joints(group_plan, [strip for strip, _ in strips],
+                                     [tris[fi] for fi in singles], vk_joint,
+                                     group_last)
+
+    if (plan_cost(group_plan, vk_joint, last_joint) <
+            plan_cost(global_plan, vk_joint, last_joint)):
+        return group_plan
+    return global_plan
+
+# ---------------------------------------------------------------------------
+# Bone batches
+# ---------------------------------------------------------------------------
+
+DSMB_MAGIC = 0x424D5344 # "DSMB" little-endian
+DSMB_BATCH_MAX_JOINTS = 32 # Size of the array of joints of each batch
+
+def partition_triangles_by_joints(tri_joints, window):
+    """Splits a list of triangles in groups that use at most 'window' joints.
+    tri_joints has the sorted list of joints used by each triangle. Returns a
+    list of (set of joints, list of triangle indices)."""
+    order = sorted(range(len(tri_joints)), key=lambda t: tri_joints[t])
+    groups = []
+    for t in order:
+        joints = set(tri_joints[t])
+        if groups and len(groups[-1][0] | joints) <= window:
+            groups[-1][0].update(joints)
+            groups[-1][1].append(t)
+        else:
+            groups.append((joints, [t]))
+    return groups
+
+def save_dsmb(output_file, batches, window, bounds=b''):
+    """Saves a DSM file split in bone batches. Each batch is a dict with the
+    list of joints it uses and its finalized display list."""
+    header_size = 16 + len(batches) * (8 + DSMB_BATCH_MAX_JOINTS)
+
+    data = struct.pack("<4I", DSMB_MAGIC, len(batches), window, 0)
+    lists = b''
+    for batch in batches:
+        joints = batch['joints'] + [0] * (DSMB_BATCH_MAX_JOINTS - len(batch['joints']))
+        data += struct.pack("<2I", header_size + len(lists), len(batch['joints']))
+        data += bytes(joints)
+        lists += batch['dl'].get_binary()
+
+    with nea_compress.open_output(output_file) as f:
+        f.write(bounds)
+        f.write(data)
+        f.write(lists)
 
 def convert_md5mesh(model_file, name, output_folder, texture_size,
                     draw_normal_polygons, extension_mesh, extension_anim,
                     blender_fix, export_base_pose, no_strip=False,
-                    multi_material=False):
+                    multi_material=False, bounding_sphere=False,
+                    bone_batch=0):
 
     print(f"Converting model: {model_file}")
 
@@ -805,6 +1279,15 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
     model_dir = os.path.dirname(os.path.abspath(model_file))
     base_matrix = 30 - len(joints) + 1
 
+    if bone_batch > 0:
+        if multi_material or draw_normal_polygons:
+            raise MD5FormatError("--bone-batch can't be used with "
+                                 "--multi-material or --draw-normal-polygons")
+        if len(joints) > 255:
+            raise MD5FormatError("Too many joints for bone batches")
+        base_matrix = 30 - bone_batch + 1
+        batches = []
+
     # In multi-material mode, each mesh gets its own DisplayList
     # In single mode, all meshes share one DisplayList
     if not multi_material:
@@ -813,6 +1296,9 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
     last_joint_index = None
     dlmm_submeshes = []  # used only in multi-material mode
 
+    restores_before = 0
+    restores_after = 0
+
     for mesh_index, mesh in enumerate(meshes):
         if multi_material:
             dl = DisplayList()
@@ -922,22 +1408,6 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
                 vkeys.append(vk)
             resolved_tris.append(tuple(vkeys))
 
-        # Stripify (skip when drawing debug normals or when disabled)
-        if draw_normal_polygons or no_strip:
-            tri_strips, tri_singles = [], list(range(len(resolved_tris)))
-        else:
-            tri_strips, tri_singles = stripify_triangles(resolved_tris)
-
-        # Statistics
-        separate_vtx = len(resolved_tris) * 3
-        strip_vtx = (sum(len(s) for s, _ in tri_strips)
-                     + len(tri_singles) * 3)
-        stripped_count = len(resolved_tris) - len(tri_singles)
-        print(f"  Triangle strips: {len(tri_strips)} ({stripped_count} faces stripped, "
-              f"{len(tri_singles)} separate)")
-        print(f"  GPU vertices:    {separate_vtx} -> {strip_vtx} "
-              f"(saved {separate_vtx - strip_vtx})")
-
         # Helper: build lookup from vertex key -> (tri_index, vert_index_in_tri)
         vk_to_src = {}
         for ti, tri in enumerate(mesh.tris):
@@ -950,6 +1420,41 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
                       float_to_n10(d['nz']))
                 vk_to_src[vk] = (ti, vi)
 
+        vk_joint = {vk: all_tri_verts[ti][vi]['joint_index']
+                    for vk, (ti, vi) in vk_to_src.items()}
+
+        # Stripify (skip when drawing debug normals or when disabled). The
+        # triangles are grouped by the joints they use so that the display
+        # list switches matrices as few times as possible.
+        if draw_normal_polygons:
+            tri_plan = [("triangles", [vk for tri in resolved_tris
+                                       for vk in tri])]
+        else:
+            tri_plan = plan_triangles_by_joints(resolved_tris, vk_joint,
+                                                no_strip, last_joint_index)
+
+        # Statistics
+        separate_vtx = len(resolved_tris) * 3
+        strip_vtx = sum(len(vkeys) for _, vkeys in tri_plan)
+        num_strips = sum(1 for t, _ in tri_plan if t == "triangle_strip")
+        num_singles = sum(len(v) // 3 for t, v in tri_plan if t == "triangles")
+        stripped_count = len(resolved_tris) - num_singles
+        print(f"  Triangle strips: {num_strips} ({stripped_count} faces stripped, "
+              f"{num_singles} separate)")
+        print(f"  GPU vertices:    {separate_vtx} -> {strip_vtx} "
+              f"(saved {separate_vtx - strip_vtx})")
+
+        if not draw_normal_polygons and bone_batch == 0:
+            before, _ = count_joint_switches(
+                    plan_triangles(resolved_tris, no_strip), vk_joint,
+                    last_joint_index)
+            after, _ = count_joint_switches(tri_plan, vk_joint,
+                                            last_joint_index)
+            print(f"  Matrix restores: {before} -> {after} "
+                  f"(saved {before - after})")
+            restores_before += before
+            restores_after += after
+
         def emit_md5_vertex(vk):
             nonlocal last_joint_index
             ti, vi = vk_to_src[vk]
@@ -965,19 +1470,88 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
             dl.normal(d['nx'], d['ny'], d['nz'])
             dl.vtx(d['px'], d['py'], d['pz'])
 
+        if bone_batch > 0:
+            print("  Generating bone batches...")
+
+            mesh_before = 0
+            mesh_after = 0
+
+            tri_joints = [sorted(set(d['joint_index'] for d in all_tri_verts[ti]))
+                          for ti in range(len(resolved_tris))]
+
+            for group_joints, group_tris in \
+                    partition_triangles_by_joints(tri_joints, bone_batch):
+                # Add the triangles to the first batch with enough free slots
+                batch = None
+                for b in batches:
+                    if len(group_joints | set(b['joints'])) <= bone_batch:
+                        batch = b
+                        break
+                if batch is None:
+                    batch = {'joints': [], 'dl': DisplayList(), 'last': None}
+                    batches.append(batch)
+                for j in sorted(group_joints):
+                    if j not in batch['joints']:
+                        batch['joints'].append(j)
+
+                bdl = batch['dl']
+
+                def emit_batch_vertex(vk):
+                    ti, vi = vk_to_src[vk]
+                    d = all_tri_verts[ti][vi]
+
+                    bdl.texcoord(d['u'], d['v'])
+
+                    slot = base_matrix + batch['joints'].index(d['joint_index'])
+                    if slot != batch['last']:
+                        bdl.mtx_restore(slot)
+                        batch['last'] = slot
+
+                    bdl.normal(d['nx'], d['ny'], d['nz'])
+                    bdl.vtx(d['px'], d['py'], d['pz'])
+
+                group = [resolved_tris[t] for t in group_tris]
+
+                last_joint = None
+                if batch['last'] is not None:
+                    last_joint = batch['joints'][batch['last'] - base_matrix]
+
+                group_plan = plan_triangles_by_joints(group, vk_joint,
+                                                      no_strip, last_joint)
+
+                before, _ = count_joint_switches(
+                        plan_triangles(group, no_strip), vk_joint, last_joint)
+                after, _ = count_joint_switches(group_plan, vk_joint,
+                                                last_joint)
+                mesh_before += before
+                mesh_after += after
+
+                for poly_type, vkeys in group_plan:
+                    bdl.begin_vtxs(poly_type)
+                    for vk in vkeys:
+                        emit_batch_vertex(vk)
+                    bdl.end_vtxs()
+
+            print(f"  Matrix restores: {mesh_before} -> {mesh_after} "
+                  f"(saved {mesh_before - mesh_after})")
+            restores_before += mesh_before
+            restores_after += mesh_after
+
+            continue
+
         print("  Generating display list...")
 
-        # Emit triangle strips
-        for strip_verts, strip_faces in tri_strips:
-            dl.begin_vtxs("triangle_strip")
-            for vk in strip_verts:
-                emit_md5_vertex(vk)
-            dl.end_vtxs()
+        if not draw_normal_polygons:
+            for poly_type, vkeys in tri_plan:
+                dl.begin_vtxs(poly_type)
+                for vk in vkeys:
+                    emit_md5_vertex(vk)
+                dl.end_vtxs()
 
-        # Emit separate triangles
-        if tri_singles:
+        # Emit separate triangles with the debug normals
+        if draw_normal_polygons:
             dl.begin_vtxs("triangles")
-            for fi in tri_singles:
+            for fi in range(len(resolved_tris)):
                 for vk in resolved_tris[fi]:
                     emit_md5_vertex(vk)
 
@@ -1038,13 +1612,29 @@ def convert_md5mesh(model_file, name, output_folder, texture_size,
             })
             print(f"  Material name: '{mat_name}'")
 
+    if not draw_normal_polygons:
+        print(f"Matrix restores: {restores_before} -> {restores_after} "
+              f"(saved {restores_before - restores_after})")
+
+    bounds = b''
+    if bounding_sphere:
+        bounds = compute_bounds_chunk(joints, meshes, blender_fix)
+
     if multi_material:
         output_path = os.path.join(output_folder, f"{name}{extension_mesh}")
-        save_dlmm(output_path, dlmm_submeshes)
+        save_dlmm(output_path, dlmm_submeshes, bounds)
         print(f"Saved DLMM with {len(dlmm_submeshes)} submesh(es) to {output_path}")
+    elif bone_batch > 0:
+        for batch in batches:
+            batch['dl'].finalize()
+        output_path = os.path.join(output_folder, f"{name}{extension_mesh}")
+        save_dsmb(output_path, batches, bone_batch, bounds)
+        print(f"Saved DSM with {len(batches)} bone batch(es) to {output_path}")
     else:
         dl.finalize()
-        dl.save_to_file(os.path.join(output_folder, f"{name}{extension_mesh}"))
+        with nea_compress.open_output(os.path.join(output_folder, f"{name}{extension_mesh}")) as f:
+            f.write(bounds)
+            f.write(dl.get_binary())
 
 
 # ---------------------------------------------------------------------------
@@ -1163,7 +1753,7 @@ def save_bone_collision(joints, collision_bones, output_path, blender_fix):
         print("  WARNING: No collision bones matched model joints")
         return
 
-    with open(output_path, 'wb') as f:
+    with nea_compress.open_output(output_path) as f:
         # Header: magic, version, num_bones, reserved
         f.write(struct.pack('<IIII', BNCL_MAGIC, BNCL_VERSION, num_bones, 0))
 
@@ -1219,7 +1809,8 @@ def save_bone_collision(joints, collision_bones, output_path, blender_fix):
 
 
 def convert_md5anim(name, output_folder, anim_file, skip_frames, extension_anim,
-                    blender_fix):
+                    blender_fix, reduce, tolerance, extension_baked,
+                    meshes=None, bounds_frames=0):
 
     print(f"Converting animation: {anim_file}")
 
@@ -1230,8 +1821,21 @@ def convert_md5anim(name, output_folder, anim_file, skip_frames, extension_anim,
     anim_name = file_basename.replace(".", "_").lower()
 
     frames = frames[::skip_frames+1]
+
+    bounds = b''
+    if bounds_frames > 0:
+        bounds = compute_anim_bounds_chunk(meshes, frames, bounds_frames,
+                                           blender_fix,
+                                           tolerance if reduce else 0)
+
     save_animation(frames, os.path.join(output_folder,
-                   f"{name}_{anim_name}{extension_anim}"), blender_fix)
+                   f"{name}_{anim_name}{extension_anim}"), blender_fix,
+                   reduce, tolerance, bounds)
+
+    if extension_baked is not None:
+        save_baked_matrices(frames, os.path.join(output_folder,
+                            f"{name}_{anim_name}{extension_baked}"),
+                            blender_fix)
 
 
 if __name__ == "__main__":
@@ -1275,6 +1879,18 @@ if __name__ == "__main__":
     parser.add_argument("--skip-frames", required=False,
                         default=0, type=int,
                         help="number of frames to skip in an animation (0 = export all, 1 = export half, 2 = export 33%%, etc)")
+    parser.add_argument("--reduce-anims", required=False,
+                        action='store_true',
+                        help="export animations in the reduced DSA format (version 2)")
+    parser.add_argument("--anim-tolerance", required=False,
+                        default=0.0, type=float,
+                        help="max error allowed when removing frames with --reduce-anims (in units and quaternion components)")
+    parser.add_argument("--bake-matrices", required=False,
+                        action='store_true',
+                        help="also export the joint matrices of every frame of the animations (DSB files)")
+    parser.add_argument("--bone-batch", required=False,
+                        default=0, type=int,
+                        help="split the mesh in batches that use at most this number of matrix stack entries (3 to 30)")
     parser.add_argument("--draw-normal-polygons", required=False,
                         action='store_true',
                         help="draw polygons with the shape of normals for debugging")
@@ -1285,12 +1901,22 @@ if __name__ == "__main__":
                         action='store_true',
                         help="output DLMM format with per-mesh materials "
                              "(texture sizes auto-detected from shader images)")
+    parser.add_argument("--bounding-sphere", required=False,
+                        action='store_true',
+                        help="prepend a bounding sphere chunk (base pose) used for frustum culling")
+    parser.add_argument("--anim-bounds", required=False,
+                        default=0, type=int,
+                        help="prepend the bounding boxes of the animations to the DSA files, one box every this number of frames (requires --model)")
     parser.add_argument("--collision", required=False, type=str, default=None,
                         help="path to .md5collimesh file for per-bone collision "
                              "data (generates .boncol binary)")
+    parser.add_argument("--compress", required=False, action='store_true',
+                        help="compress the output files with LZ77")
 
     args = parser.parse_args()
 
+    nea_compress.enabled = args.compress
+
     if args.model is not None:
         if args.multi_material:
             # In multi-material mode, --texture is optional (auto-detected from shader)
@@ -1312,12 +1938,27 @@ if __name__ == "__main__":
                 print(f"Invalid texture height. Valid values: {VALID_TEXTURE_SIZES}")
                 sys.exit(1)
 
+    if args.bone_batch != 0 and not (3 <= args.bone_batch <= 30):
+        print("The value of --bone-batch must be between 3 and 30")
+        sys.exit(1)
+
+    if args.anim_bounds < 0:
+        print("The value of --anim-bounds must be 0 or more")
+        sys.exit(1)
+
+    if args.anim_bounds > 0 and args.model is None:
+        print("--anim-bounds requires --model to transform the vertices")
+        sys.exit(1)
+
     # Create output directory if it doesn't exist
     os.makedirs(args.output, exist_ok=True)
 
     # Add '.bin' to the name of the files if requested
     extension_mesh = "_dsm.bin" if args.bin else ".dsm"
     extension_anim = "_dsa.bin" if args.bin else ".dsa"
+    extension_baked = None
+    if args.bake_matrices:
+        extension_baked = "_dsb.bin" if args.bin else ".dsb"
 
     try:
         if args.model is not None:
@@ -1325,11 +1966,19 @@ if __name__ == "__main__":
                             args.draw_normal_polygons, extension_mesh,
                             extension_anim, args.blender_fix,
                             args.export_base_pose, args.no_strip,
-                            args.multi_material)
+                            args.multi_material, args.bounding_sphere,
+                            args.bone_batch)
+
+        meshes = None
+        if args.anim_bounds > 0:
+            _, meshes = parse_md5mesh(args.model)
 
         for anim_file in args.anims:
             convert_md5anim(args.name, args.output, anim_file, args.skip_frames,
-                            extension_anim, args.blender_fix)
+                            extension_anim, args.blender_fix,
+                            args.reduce_anims,
+                            int(round(args.anim_tolerance * (1 << 12))),
+                            extension_baked, meshes, args.anim_bounds)
 
         if args.collision is not None:
             if args.model is None:
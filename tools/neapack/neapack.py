@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2026 Warioware64
+#
+# Packs all files of a folder into a single asset pack.
+#
+# Usage:
+#     python3 neapack.py --input data --output assets.neapack
+
+"""neapack.py -- Asset pack builder.
+
+Binary format (all values little-endian):
+
+FILE HEADER (16 bytes)
+    magic:       uint32  0x4B50454E ("NEPK")
+    version:     uint16  1
+    alignment:   uint16  32
+    num_entries: uint32
+    names_size:  uint32  (size of the table of paths)
+
+DIRECTORY (16 bytes each, sorted by hash)
+    hash:        uint32  (FNV-1a of the path)
+    offset:      uint32  (from the start of the pack, multiple of alignment)
+    size:        uint32
+    name_offset: uint32  (offset of the path in the table of paths)
+
+TABLE OF PATHS
+    NUL-terminated paths relative to the input folder, with "/" as separator
+
+DATA
+    Data of each file, padded to the alignment.
+
+The paths are looked up at runtime without "nitro:" and leading slashes, so a
+folder converted to the NitroFS root with "--input nitrofs" can be loaded with
+the same paths used for the files outside of the pack.
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+NEPK_MAGIC = 0x4B50454E
+NEPK_VERSION = 1
+NEPK_ALIGNMENT = 32
+
+HEADER_SIZE = 16
+ENTRY_SIZE = 16
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h ^= b
+        h = (h * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def align(value):
+    return (value + NEPK_ALIGNMENT - 1) & ~(NEPK_ALIGNMENT - 1)
+
+
+def collect_files(in_folder):
+    files = []
+    for root, dirs, names in os.walk(in_folder):
+        dirs.sort()
+        for name in sorted(names):
+            full = os.path.join(root, name)
+            rel = os.path.relpath(full, in_folder).replace(os.sep, "/")
+            files.append((rel, full))
+    return files
+
+
+def build(in_folder, out_path):
+    files = collect_files(in_folder)
+    if len(files) == 0:
+        raise Exception(f"No files found in {in_folder}")
+
+    entries = []
+    for rel, full in files:
+        name = rel.encode("utf-8")
+        entries.append((fnv1a(name), name, full))
+
+    # The runtime does a binary search by hash
+    entries.sort(key=lambda e: (e[0], e[1]))
+
+    names = bytearray()
+    name_offsets = []
+    for _, name, _ in entries:
+        name_offsets.append(len(names))
+        names += name + b"\0"
+
+    data_start = align(HEADER_SIZE + ENTRY_SIZE * len(entries) + len(names))
+
+    directory = bytearray()
+    data = bytearray()
+    for (h, name, full), name_offset in zip(entries, name_offsets):
+        with open(full, "rb") as f:
+            content = f.read()
+
+        offset = data_start + len(data)
+        directory += struct.pack("<IIII", h, offset, len(content), name_offset)
+
+        data += content
+        data += bytes(align(len(data)) - len(data))
+
+    header = struct.pack("<IHHII", NEPK_MAGIC, NEPK_VERSION, NEPK_ALIGNMENT,
+                         len(entries), len(names))
+
+    out = bytearray(header + directory + names)
+    out += bytes(data_start - len(out))
+    out += data
+
+    with open(out_path, "wb") as f:
+        f.write(out)
+
+    print(f"{len(entries)} files, {len(out)} bytes")
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Pack all files of a folder into a NEA asset pack")
+    parser.add_argument("--input", "-i", required=True,
+                        help="Input folder")
+    parser.add_argument("--output", "-o", required=True,
+                        help="Output .neapack file")
+    args = parser.parse_args()
+
+    try:
+        build(args.input, args.output)
+    except Exception as e:
+        print("ERROR: " + str(e))
+        sys.exit(1)
+
+    print("Done!")
+
+
+if __name__ == '__main__':
+    main()
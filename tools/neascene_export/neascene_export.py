@@ -11,28 +11,42 @@
 
 """neascene_export.py -- JSON to binary .neascene converter.
 
-Binary format (all values little-endian):
+Binary format (all values little-endian). Version 3 is generated by default,
+older versions can be generated with "--scene-version 1" or "--scene-version 2".
 
-FILE HEADER (16 bytes)
+FILE HEADER (16 bytes in version 1, 32 bytes in version 2, 44 in version 3)
     magic:              uint32  0x4E53434E ("NSCN")
-    version:            uint32  1
+    version:            uint32  1 or 2
     num_nodes:          uint16
     num_assets:         uint16
     num_mat_refs:       uint16
     active_camera_idx:  uint16  (0xFFFF = none)
+    Version 2 and 3:
+    node_size:          uint32  232
+    nodes_offset:       uint32  (from the start of the file)
+    num_triggers:       uint16
+    padding:            uint16
+    triggers_offset:    uint32  (from the start of the file)
+    Version 3 only:
+    bounds_offset:      uint32  (from the start of the file, 0 = none)
+    tree_offset:        uint32  (from the start of the file, 0 = none)
+    num_tree_nodes:     uint16
+    num_tree_items:     uint16
 
 ASSET TABLE (64 bytes each)
     path:       char[48]  (null-padded)
-    asset_type: uint8     (0=static, 1=dsm, 2=dsa, 3=colmesh, 4=boncol)
+    asset_type: uint8     (0=static, 1=dsm, 2=dsa, 3=colmesh, 4=boncol,
+                           5=scene)
     padding:    uint8[15]
 
 MATERIAL REF TABLE (80 bytes each)
     name:       char[32]  (null-padded)
     tex_path:   char[48]  (null-padded)
 
-NODE TABLE (128 bytes each)
+NODE TABLE (version 1, 128 bytes each)
     name:       char[24]
-    type:       uint8     (0=empty, 1=mesh, 2=camera, 3=trigger)
+    type:       uint8     (0=empty, 1=mesh, 2=camera, 3=trigger, 4=room,
+                           5=portal, 6=sector)
     parent_idx: uint8     (0xFF = root)
     num_tags:   uint8
     flags:      uint8     (bit 0 = visible)
@@ -42,29 +56,146 @@ NODE TABLE (128 bytes each)
     scale:      int32[3]  (f32 fixed-point)
     type_data:  20 bytes
     tags:       48 bytes  (3 * 16)
+
+MESH TYPE DATA
+    asset_index:    uint16  (index of the mesh in the asset table)
+    material_index: uint16  (index in the material table, 0xFFFF = none)
+    is_animated:    uint8
+    is_static:      uint8   (1 = never moves, it can be merged with other
+                             static nodes by NEA_SceneBatchStatic())
+
+ROOM TYPE DATA
+    half:       int32[3]  (f32 fixed-point, half extents of the room box)
+
+PORTAL TYPE DATA
+    half:       int32[3]  (f32 fixed-point, half extents of the portal box)
+    room_a:     uint8     (node index of one room, 0xFF = none)
+    room_b:     uint8     (node index of the other room, 0xFF = none)
+
+SECTOR TYPE DATA
+    asset_index:   uint16  (index of a scene in the asset table)
+    padding:       uint16
+    load_radius:   int32   (f32 fixed-point)
+    unload_radius: int32   (f32 fixed-point)
+
+Static meshes, rooms, portals and sectors are described in the JSON like
+this:
+
+    {"name": "Wall", "type": "mesh",
+     "mesh": {"asset_index": 0, "material_index": 1, "static": true}}
+    {"name": "Hall", "type": "room", "room": {"half": [4.0, 2.0, 6.0]}}
+    {"name": "Door", "type": "portal",
+     "portal": {"half": [1.0, 1.5, 0.25], "rooms": ["Hall", "Kitchen"]}}
+    {"name": "Town", "type": "sector", "position": [64.0, 0.0, 0.0],
+     "sector": {"asset_index": 2, "load_radius": 48.0, "unload_radius": 56.0}}
+
+NODE TABLE (version 2, 232 bytes each)
+    The nodes have the layout of NEA_SceneNode on the DS, so the runtime uses
+    them in place. Node references are indices plus one (0 = none).
+    parent:       uint32
+    first_child:  uint32
+    next_sibling: uint32
+    name:         char[24]
+    tags:         char[6][16]
+    num_tags:     uint8
+    visible:      uint8
+    padding:      uint8[2]
+    type:         uint32
+    position:     int32[3]  (f32 fixed-point)
+    rotation:     int32[3]  (0-511)
+    scale:        int32[3]  (f32 fixed-point)
+    padding:      uint8[12] (world position, computed at runtime)
+    type_data:    24 bytes  (like in version 1, but without trigger data)
+    trigger:      uint32    (index of the trigger plus one, 0 = none)
+    padding:      uint8[16] (runtime pointers)
+
+TRIGGER TABLE (version 2, 16 bytes each)
+    shape:      uint8     (1 = sphere, 2 = AABB)
+    script_id:  uint8
+    padding:    uint16
+    params:     int32[3]  (radius, or half extents of the AABB)
+
+BOUNDS TABLE (version 3, 16 bytes per node, twice)
+    The local bounds of all nodes, followed by the bounds of the subtrees of
+    all nodes, with the layout of NEA_SceneBounds.
+    center:     int32[3]  (f32 fixed-point)
+    radius:     int32     (f32 fixed-point)
+    Local bounds are in the space of the node, and the radius is -1 if the node
+    has no bounds. Subtree bounds are in world space, and they contain the
+    bounds of the meshes and sectors of the node and its children. Their radius
+    is -1 if there is nothing to draw, and 0x7FFFFFFF if the subtree has a mesh
+    or a sector without bounds (it is always drawn).
+
+TRIGGER TREE (version 3, 32 bytes per node)
+    Tree of boxes around the triggers, stored in depth-first order. The first
+    child of an inner node is the next node. The runtime uses it until a
+    trigger moves.
+    min:        int32[3]  (f32 fixed-point, world space)
+    max:        int32[3]  (f32 fixed-point, world space)
+    skip:       uint16    (next node after this subtree)
+    first:      uint16    (first item of a leaf)
+    count:      uint16    (number of items of a leaf, 0 for inner nodes)
+    padding:    uint16
+    It is followed by the items of the leaves (node indices, uint16 each).
+
+Meshes and sectors can have bounds in the JSON, as a box or a sphere in the
+space of the node. The bounds of a sector must contain all the nodes of its
+scene:
+
+    {"name": "Wall", "type": "mesh",
+     "bounds": {"center": [0.0, 1.0, 0.0], "half": [2.0, 1.0, 0.2]}}
+    {"name": "Town", "type": "sector", "bounds": {"radius": 40.0}, ...}
+
+The rooms of a portal can be node names or node indices. The nodes that belong
+to a room must be its children.
+
+The nodes of the scene of a sector use world coordinates. The position of the
+sector node is the point from which the radii are measured.
 """
 
 import argparse
 import json
+import math
+import os
 import struct
 import sys
 
+# nea_compress is shared by all tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..', 'common'))
+
+import nea_compress
+
 NSCN_MAGIC = 0x4E53434E
-NSCN_VERSION = 1
+NSCN_VERSION = 3
 
 HEADER_SIZE = 16
+HEADER_V2_SIZE = 32
+HEADER_V3_SIZE = 44
 ASSET_SIZE = 64
 MATREF_SIZE = 80
 NODE_SIZE = 128
+NODE_V2_SIZE = 232
+TRIGGER_SIZE = 16
+BOUNDS_SIZE = 16
+TREE_NODE_SIZE = 32
+TREE_LEAF_SIZE = 4
+
+BOUNDS_NONE = -1
+BOUNDS_INFINITE = 0x7FFFFFFF
 
 NODE_NAME_LEN = 24
 TAG_LEN = 16
 MAX_TAGS = 6
+MAX_TAGS_V1 = 3
 
 TYPE_EMPTY = 0
 TYPE_MESH = 1
 TYPE_CAMERA = 2
 TYPE_TRIGGER = 3
+TYPE_ROOM = 4
+TYPE_PORTAL = 5
+TYPE_SECTOR = 6
 
 
 def float_to_f32(val):
@@ -105,7 +236,17 @@ def pack_matref(mat):
     return data
 
 
-def pack_node(node):
+def resolve_node_index(ref, name_map):
+    """Return the index of a node given its name or index (0xFF if unknown)."""
+    if isinstance(ref, int):
+        return ref if 0 <= ref < 0xFF else 0xFF
+    if ref not in name_map:
+        print(f"WARNING: Unknown node '{ref}'")
+        return 0xFF
+    return name_map[ref]
+
+
+def pack_node(node, name_map):
     """Pack a single node entry (128 bytes)."""
     buf = bytearray(NODE_SIZE)
 
@@ -116,13 +257,15 @@ def pack_node(node):
     # Type, parent, num_tags, flags (offset 24-27)
     type_str = node.get('type', 'empty')
     type_map = {'empty': TYPE_EMPTY, 'mesh': TYPE_MESH,
-                'camera': TYPE_CAMERA, 'trigger': TYPE_TRIGGER}
+                'camera': TYPE_CAMERA, 'trigger': TYPE_TRIGGER,
+                'room': TYPE_ROOM, 'portal': TYPE_PORTAL,
+                'sector': TYPE_SECTOR}
     buf[24] = type_map.get(type_str, TYPE_EMPTY)
 
     parent_idx = node.get('parent_idx', 0xFF)
     buf[25] = parent_idx & 0xFF
 
-    tags = node.get('tags', [])[:MAX_TAGS]
+    tags = node.get('tags', [])[:MAX_TAGS_V1]
     buf[26] = len(tags)
 
     flags = 0
@@ -152,10 +295,11 @@ def pack_node(node):
     # Type-specific data at offset 60
     if type_str == 'mesh':
         mesh = node.get('mesh', {})
-        struct.pack_into('<HHB', buf, 60,
+        struct.pack_into('<HHBB', buf, 60,
                          mesh.get('asset_index', 0),
                          mesh.get('material_index', 0xFFFF),
-                         1 if mesh.get('is_animated', False) else 0)
+                         1 if mesh.get('is_animated', False) else 0,
+                         1 if mesh.get('static', False) else 0)
     elif type_str == 'camera':
         cam = node.get('camera', {})
         to = cam.get('to', [0.0, 0.0, -1.0])  # default: look along -Z
@@ -179,16 +323,339 @@ def pack_node(node):
                              float_to_f32(trig.get('half_x', 1.0)),
                              float_to_f32(trig.get('half_y', 1.0)),
                              float_to_f32(trig.get('half_z', 1.0)))
+    elif type_str == 'room':
+        room = node.get('room', {})
+        half = room.get('half', [1.0, 1.0, 1.0])
+        struct.pack_into('<III', buf, 60,
+                         float_to_f32(half[0]), float_to_f32(half[1]),
+                         float_to_f32(half[2]))
+    elif type_str == 'portal':
+        portal = node.get('portal', {})
+        half = portal.get('half', [1.0, 1.0, 1.0])
+        rooms = portal.get('rooms', [])
+        if len(rooms) != 2:
+            print(f"WARNING: Portal '{node.get('name', '')}' must join "
+                  "two rooms")
+            rooms = [0xFF, 0xFF]
+        struct.pack_into('<IIIBB', buf, 60,
+                         float_to_f32(half[0]), float_to_f32(half[1]),
+                         float_to_f32(half[2]),
+                         resolve_node_index(rooms[0], name_map),
+                         resolve_node_index(rooms[1], name_map))
+    elif type_str == 'sector':
+        sector = node.get('sector', {})
+        load_radius = sector.get('load_radius', 0.0)
+        unload_radius = sector.get('unload_radius', load_radius)
+        struct.pack_into('<HHII', buf, 60, sector.get('asset_index', 0), 0,
+                         float_to_f32(load_radius),
+                         float_to_f32(unload_radius))
 
     # Tags at offset 80 (3 * 16 = 48 bytes)
-    for t in range(min(len(tags), MAX_TAGS)):
+    for t in range(len(tags)):
         tag_bytes = pack_string(tags[t], TAG_LEN)
         buf[80 + t * TAG_LEN:80 + (t + 1) * TAG_LEN] = tag_bytes
 
     return bytes(buf)
 
 
-def convert(input_path, output_path):
+def build_links(nodes):
+    """Return the first child and next sibling of every node, as indices."""
+    first_child = [None] * len(nodes)
+    next_sibling = [None] * len(nodes)
+    last_child = [None] * len(nodes)
+
+    for i, node in enumerate(nodes):
+        parent = node.get('parent_idx', 0xFF)
+        if parent == 0xFF or not (0 <= parent < len(nodes)):
+            continue
+        # Children are appended in the order of the node table
+        if first_child[parent] is None:
+            first_child[parent] = i
+        else:
+            next_sibling[last_child[parent]] = i
+        last_child[parent] = i
+
+    return first_child, next_sibling
+
+
+def pack_node_v2(node, index, links, name_map, triggers):
+    """Pack a single node entry (232 bytes) with the layout of NEA_SceneNode.
+
+    Trigger data is appended to the list of triggers.
+    """
+    first_child, next_sibling = links
+    buf = bytearray(NODE_V2_SIZE)
+
+    def ref(i):
+        return 0 if i is None else i + 1
+
+    parent = node.get('parent_idx', 0xFF)
+    if parent == 0xFF or not (0 <= parent < len(first_child)):
+        parent = None
+    struct.pack_into('<III', buf, 0, ref(parent), ref(first_child[index]),
+                     ref(next_sibling[index]))
+
+    buf[12:12 + NODE_NAME_LEN] = pack_string(node.get('name', ''),
+                                             NODE_NAME_LEN)
+
+    tags = node.get('tags', [])[:MAX_TAGS]
+    for t in range(len(tags)):
+        buf[36 + t * TAG_LEN:36 + (t + 1) * TAG_LEN] = \
+            pack_string(tags[t], TAG_LEN)
+    buf[132] = len(tags)
+    buf[133] = 1 if node.get('visible', True) else 0
+
+    type_str = node.get('type', 'empty')
+    type_map = {'empty': TYPE_EMPTY, 'mesh': TYPE_MESH,
+                'camera': TYPE_CAMERA, 'trigger': TYPE_TRIGGER,
+                'room': TYPE_ROOM, 'portal': TYPE_PORTAL,
+                'sector': TYPE_SECTOR}
+    struct.pack_into('<I', buf, 136, type_map.get(type_str, TYPE_EMPTY))
+
+    pos = node.get('position', [0.0, 0.0, 0.0])
+    rot = node.get('rotation', [0, 0, 0])
+    scl = node.get('scale', [1.0, 1.0, 1.0])
+    struct.pack_into('<IIIiiiIII', buf, 140,
+                     float_to_f32(pos[0]), float_to_f32(pos[1]),
+                     float_to_f32(pos[2]),
+                     rot[0] & 0x1FF, rot[1] & 0x1FF, rot[2] & 0x1FF,
+                     float_to_f32(scl[0]), float_to_f32(scl[1]),
+                     float_to_f32(scl[2]))
+
+    # The type-specific data of version 1 is at offset 60, so it can be
+    # reused. Triggers go to their own table.
+    if type_str == 'trigger':
+        v1 = pack_node(node, name_map)
+        triggers.append(v1[60:62] + b'\x00\x00' + v1[64:76])
+        struct.pack_into('<I', buf, 212, len(triggers))
+    else:
+        buf[188:208] = pack_node(node, name_map)[60:80]
+        if type_str == 'camera':
+            # The up vector doesn't fit in the 20 bytes of version 1
+            up = node.get('camera', {}).get('up', [0.0, 1.0, 0.0])
+            struct.pack_into('<III', buf, 200, float_to_f32(up[0]),
+                             float_to_f32(up[1]), float_to_f32(up[2]))
+
+    return bytes(buf)
+
+
+def rotation_matrix(rx, ry, rz):
+    """Rows of Rz * Ry * Rx, like ne_model_build_transform() (0-511 angles)."""
+    def mul(a, b):
+        return [[sum(a[i][k] * b[k][j] for k in range(3)) for j in range(3)]
+                for i in range(3)]
+
+    def angle(a):
+        a = (a & 0x1FF) * 2 * math.pi / 512
+        return math.sin(a), math.cos(a)
+
+    s, c = angle(rz)
+    r = [[c, s, 0], [-s, c, 0], [0, 0, 1]]
+    s, c = angle(ry)
+    r = mul(r, [[c, 0, -s], [0, 1, 0], [s, 0, c]])
+    s, c = angle(rx)
+    r = mul(r, [[1, 0, 0], [0, c, s], [0, -s, c]])
+    return r
+
+
+def world_matrices(nodes):
+    """Return the world matrix of every node as (rows, translation), using row
+    vectors like NEA_SceneUpdate()."""
+    worlds = [None] * len(nodes)
+
+    def world(i, depth=0):
+        if worlds[i] is not None:
+            return worlds[i]
+        node = nodes[i]
+        scl = node.get('scale', [1.0, 1.0, 1.0])
+        rot = node.get('rotation', [0, 0, 0])
+        r = rotation_matrix(rot[0], rot[1], rot[2])
+        rows = [[scl[k] * r[k][j] for j in range(3)] for k in range(3)]
+        trans = list(node.get('position', [0.0, 0.0, 0.0]))
+
+        parent = node.get('parent_idx', 0xFF)
+        if 0 <= parent < len(nodes) and parent != i and depth < len(nodes):
+            prows, ptrans = world(parent, depth + 1)
+            rows = [[sum(rows[k][m] * prows[m][j] for m in range(3))
+                     for j in range(3)] for k in range(3)]
+            trans = [sum(trans[m] * prows[m][j] for m in range(3)) + ptrans[j]
+                     for j in range(3)]
+
+        worlds[i] = (rows, trans)
+        return worlds[i]
+
+    for i in range(len(nodes)):
+        world(i)
+    return worlds
+
+
+def local_bounds(node):
+    """Return the bounds of a mesh or sector node as (center, radius) in the
+    space of the node, or None."""
+    if node.get('type', 'empty') not in ('mesh', 'sector'):
+        return None
+    bounds = node.get('bounds')
+    if bounds is None:
+        return None
+
+    center = bounds.get('center', [0.0, 0.0, 0.0])
+    if 'half' in bounds:
+        radius = math.sqrt(sum(h * h for h in bounds['half']))
+    else:
+        radius = bounds.get('radius', 0.0)
+    return center, radius
+
+
+def sphere_transform(center, radius, world):
+    """Transform a sphere like ne_sphere_transform() does."""
+    rows, trans = world
+    out = [sum(center[m] * rows[m][j] for m in range(3)) + trans[j]
+           for j in range(3)]
+    # The Frobenius norm is an upper bound of the scale of the matrix
+    norm = math.sqrt(sum(v * v for row in rows for v in row))
+    return out, radius * norm
+
+
+def f32_radius(radius):
+    """Convert a radius to f32, rounded up with a margin for the differences
+    between the math of the exporter and the fixed-point math of the DS."""
+    res = math.ceil((radius * 1.01 + 1 / 16) * (1 << 12))
+    if res >= BOUNDS_INFINITE:
+        raise OverflowError(f"{radius} too big for f32")
+    return res
+
+
+def build_bounds(nodes, links, worlds):
+    """Return the local and subtree bounds tables of version 3."""
+    first_child, next_sibling = links
+    local = [local_bounds(node) for node in nodes]
+    subtree = [None] * len(nodes)
+
+    def visit(i, depth=0):
+        # Returns (center, radius), None if empty, or 'infinite'
+        spheres = []
+        node = nodes[i]
+        node_type = node.get('type', 'empty')
+        if node_type in ('mesh', 'sector'):
+            if local[i] is None:
+                subtree[i] = 'infinite'
+            else:
+                spheres.append(sphere_transform(local[i][0], local[i][1],
+                                                worlds[i]))
+
+        child = first_child[i]
+        while child is not None and depth < len(nodes):
+            b = visit(child, depth + 1)
+            if b == 'infinite':
+                subtree[i] = 'infinite'
+            elif b is not None:
+                spheres.append(b)
+            child = next_sibling[child]
+
+        if subtree[i] == 'infinite':
+            return subtree[i]
+
+        if spheres:
+            lo = [min(c[k] - r for c, r in spheres) for k in range(3)]
+            hi = [max(c[k] + r for c, r in spheres) for k in range(3)]
+            half = [(hi[k] - lo[k]) / 2 for k in range(3)]
+            center = [lo[k] + half[k] for k in range(3)]
+            subtree[i] = (center, math.sqrt(sum(h * h for h in half)))
+        return subtree[i]
+
+    for i, node in enumerate(nodes):
+        parent = node.get('parent_idx', 0xFF)
+        if not (0 <= parent < len(nodes)):
+            visit(i)
+
+    def pack(b):
+        if b is None:
+            return struct.pack('<iiii', 0, 0, 0, BOUNDS_NONE)
+        if b == 'infinite':
+            return struct.pack('<iiii', 0, 0, 0, BOUNDS_INFINITE)
+        center, radius = b
+        return struct.pack('<IIIi', float_to_f32(center[0]),
+                           float_to_f32(center[1]), float_to_f32(center[2]),
+                           f32_radius(radius))
+
+    return b''.join(pack(b) for b in local) + \
+        b''.join(pack(b) for b in subtree)
+
+
+def build_trigger_tree(nodes, worlds):
+    """Return the trigger tree of version 3 as (nodes, items) lists, or None
+    if there aren't enough triggers to use it.
+
+    The runtime only uses the trigger grid (and the tree) with 2 triggers or
+    more. The tree is split by the median of the longest axis of the box of the
+    centers of the triggers.
+    """
+    boxes = []
+    for i, node in enumerate(nodes):
+        if node.get('type', 'empty') != 'trigger':
+            continue
+        trig = node.get('trigger', {})
+        if trig.get('shape', 'sphere') == 'aabb':
+            half = [trig.get('half_x', 1.0), trig.get('half_y', 1.0),
+                    trig.get('half_z', 1.0)]
+        else:
+            half = [trig.get('radius', 1.0)] * 3
+
+        pos = worlds[i][1]
+        margin = 1 / 16 + max(abs(v) for v in pos) / 256
+        boxes.append((i, [pos[k] - half[k] - margin for k in range(3)],
+                      [pos[k] + half[k] + margin for k in range(3)]))
+
+    if len(boxes) < 2:
+        return None
+
+    tree = []
+    items = []
+
+    def build(group):
+        lo = [min(b[1][k] for b in group) for k in range(3)]
+        hi = [max(b[2][k] for b in group) for k in range(3)]
+        index = len(tree)
+        entry = {'min': lo, 'max': hi, 'first': 0, 'count': 0}
+        tree.append(entry)
+
+        if len(group) <= TREE_LEAF_SIZE:
+            entry['first'] = len(items)
+            entry['count'] = len(group)
+            items.extend(b[0] for b in group)
+        else:
+            centers = [[(b[1][k] + b[2][k]) / 2 for b in group]
+                       for k in range(3)]
+            axis = max(range(3),
+                       key=lambda k: max(centers[k]) - min(centers[k]))
+            group = sorted(group, key=lambda b: b[1][axis] + b[2][axis])
+            mid = len(group) // 2
+            build(group[:mid])
+            build(group[mid:])
+
+        entry['skip'] = len(tree)
+        return index
+
+    build(boxes)
+
+    if len(tree) > 0xFFFF or len(items) > 0xFFFF:
+        print("WARNING: Too many triggers for the trigger tree")
+        return None
+
+    data = b''
+    for entry in tree:
+        data += struct.pack('<IIIIIIHHHH',
+                            *[float_to_f32(v) for v in entry['min']],
+                            *[float_to_f32(v) for v in entry['max']],
+                            entry['skip'], entry['first'], entry['count'], 0)
+    data += struct.pack(f'<{len(items)}H', *items)
+    if len(data) % 4:
+        data += b'\x00' * (4 - len(data) % 4)
+
+    return data, len(tree), len(items)
+
+
+def convert(input_path, output_path, version=NSCN_VERSION, trigger_tree=True):
     """Read JSON and write binary .neascene."""
     with open(input_path, 'r') as f:
         scene = json.load(f)
@@ -202,30 +669,64 @@ def convert(input_path, output_path):
         print("ERROR: No nodes in scene")
         sys.exit(1)
 
-    # Pack header
-    header = struct.pack('<IIHHHH',
-                         NSCN_MAGIC,
-                         NSCN_VERSION,
-                         len(nodes),
-                         len(assets),
-                         len(mat_refs),
-                         active_camera_idx)
-    assert len(header) == HEADER_SIZE
-
-    with open(output_path, 'wb') as f:
+    name_map = {}
+    for i, node in enumerate(nodes):
+        name_map.setdefault(node.get('name', ''), i)
+
+    tables = b''.join(pack_asset(asset) for asset in assets)
+    tables += b''.join(pack_matref(mat) for mat in mat_refs)
+
+    if version == 1:
+        node_table = b''.join(pack_node(node, name_map) for node in nodes)
+        header = struct.pack('<IIHHHH', NSCN_MAGIC, 1, len(nodes),
+                             len(assets), len(mat_refs), active_camera_idx)
+        assert len(header) == HEADER_SIZE
+        trigger_table = b''
+    else:
+        links = build_links(nodes)
+        triggers = []
+        node_table = b''.join(pack_node_v2(node, i, links, name_map, triggers)
+                              for i, node in enumerate(nodes))
+        trigger_table = b''.join(triggers)
+
+        # Tables are multiples of 4 bytes, so the nodes are aligned
+        header_size = HEADER_V2_SIZE if version == 2 else HEADER_V3_SIZE
+        nodes_offset = header_size + len(tables)
+        triggers_offset = nodes_offset + len(node_table)
+        header = struct.pack('<IIHHHHIIHHI', NSCN_MAGIC, version, len(nodes),
+                             len(assets), len(mat_refs), active_camera_idx,
+                             NODE_V2_SIZE, nodes_offset, len(triggers), 0,
+                             triggers_offset)
+
+        if version >= 3:
+            # The bounds and the tree go after the triggers
+            worlds = world_matrices(nodes)
+            bounds_table = build_bounds(nodes, links, worlds)
+            bounds_offset = triggers_offset + len(trigger_table)
+
+            tree = build_trigger_tree(nodes, worlds) if trigger_tree else None
+            if tree is None:
+                tree_table, num_tree_nodes, num_tree_items = b'', 0, 0
+                tree_offset = 0
+            else:
+                tree_table, num_tree_nodes, num_tree_items = tree
+                tree_offset = bounds_offset + len(bounds_table)
+                print(f"  Trigger tree: {num_tree_nodes} nodes, "
+                      f"{num_tree_items} triggers")
+
+            header += struct.pack('<IIHH', bounds_offset, tree_offset,
+                                  num_tree_nodes, num_tree_items)
+            trigger_table += bounds_table + tree_table
+
+        assert len(header) == header_size
+
+    with nea_compress.open_output(output_path) as f:
         f.write(header)
+        f.write(tables)
+        f.write(node_table)
+        f.write(trigger_table)
 
-        for asset in assets:
-            f.write(pack_asset(asset))
-
-        for mat in mat_refs:
-            f.write(pack_matref(mat))
-
-        for node in nodes:
-            f.write(pack_node(node))
-
-    total = HEADER_SIZE + len(assets) * ASSET_SIZE + \
-        len(mat_refs) * MATREF_SIZE + len(nodes) * NODE_SIZE
+    total = len(header) + len(tables) + len(node_table) + len(trigger_table)
     print(f"  Scene: {len(nodes)} nodes, {len(assets)} assets, "
           f"{len(mat_refs)} materials -> {output_path} ({total} bytes)")
 
@@ -237,9 +738,20 @@ def main():
                         help="Input JSON file")
     parser.add_argument("--output", "-o", required=True,
                         help="Output .neascene binary file")
+    parser.add_argument("--compress", action="store_true",
+                        help="Compress the output file with LZ77")
+    parser.add_argument("--scene-version", type=int, choices=[1, 2, 3],
+                        default=NSCN_VERSION,
+                        help="Version of the .neascene format (default: 3)")
+    parser.add_argument("--no-trigger-tree", action="store_true",
+                        help="Don't add the tree of triggers to version 3 "
+                             "files")
     args = parser.parse_args()
 
-    convert(args.input, args.output)
+    nea_compress.enabled = args.compress
+
+    convert(args.input, args.output, args.scene_version,
+            not args.no_trigger_tree)
     print("Done!")
 
 
@@ -0,0 +1,217 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2026 Warioware64
+
+"""Baking of static lighting into vertex colors.
+
+Static geometry that is lit by lights that never move doesn't need normals or
+hardware lighting. The light that reaches each vertex is calculated once from
+a list of directional lights, an ambient color and, optionally, ambient
+occlusion, and the display list only has COLOR commands.
+
+Ambient occlusion casts rays in a cosine-weighted hemisphere around the normal
+of each vertex, and counts how many of them hit the mesh within a distance.
+The rays are tested against a BVH of the triangles of the mesh.
+"""
+
+import math
+
+from collections import defaultdict
+
+# Rays start this far from the surface (relative to the occlusion distance) so
+# that they don't hit the triangles around the vertex.
+AO_RAY_OFFSET = 1e-3
+
+def _sub(a, b):
+    return [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+
+def _cross(a, b):
+    return [a[1] * b[2] - a[2] * b[1],
+            a[2] * b[0] - a[0] * b[2],
+            a[0] * b[1] - a[1] * b[0]]
+
+def _dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+def _normalize(a):
+    length = math.sqrt(_dot(a, a))
+    if length < 1e-12:
+        return [0.0, 1.0, 0.0]
+    return [a[0] / length, a[1] / length, a[2] / length]
+
+def _smooth_normals(faces, positions):
+    """Area-weighted normal of each position index, for vertices without a
+    normal in the OBJ file."""
+    acc = defaultdict(lambda: [0.0, 0.0, 0.0])
+    for face in faces:
+        p = [positions[vk[0]] for vk in face]
+        for i in range(1, len(p) - 1):
+            n = _cross(_sub(p[i], p[0]), _sub(p[i + 1], p[0]))
+            for vk in (face[0], face[i], face[i + 1]):
+                a = acc[vk[0]]
+                a[0] += n[0]
+                a[1] += n[1]
+                a[2] += n[2]
+    return {vi: _normalize(n) for vi, n in acc.items()}
+
+def _hemisphere_directions(count):
+    """Cosine-weighted directions around +Z, using a Fibonacci spiral so that
+    the result doesn't depend on a random seed."""
+    golden_angle = math.pi * (3.0 - math.sqrt(5.0))
+    dirs = []
+    for i in range(count):
+        u = (i + 0.5) / count
+        r = math.sqrt(u)
+        phi = i * golden_angle
+        dirs.append((r * math.cos(phi), r * math.sin(phi), math.sqrt(1.0 - u)))
+    return dirs
+
+class _Occluders:
+    """Triangles of the mesh with a BVH to test rays against them."""
+
+    def __init__(self, triangles, build_bvh):
+        boxes = []
+        for t in triangles:
+            boxes.append(([min(p[i] for p in t) for i in range(3)],
+                          [max(p[i] for p in t) for i in range(3)]))
+        order, self.nodes = build_bvh(boxes)
+        self.triangles = [triangles[t] for t in order]
+
+    @staticmethod
+    def _ray_box(origin, inv_dir, lo, hi, t_max):
+        t0, t1 = 0.0, t_max
+        for i in range(3):
+            ta = (lo[i] - origin[i]) * inv_dir[i]
+            tb = (hi[i] - origin[i]) * inv_dir[i]
+            if ta > tb:
+                ta, tb = tb, ta
+            t0 = max(t0, ta)
+            t1 = min(t1, tb)
+            if t0 > t1:
+                return False
+        return True
+
+    @staticmethod
+    def _ray_triangle(origin, direction, tri, t_min, t_max):
+        # Moller-Trumbore, both sides of the triangle are hit
+        e1 = _sub(tri[1], tri[0])
+        e2 = _sub(tri[2], tri[0])
+        p = _cross(direction, e2)
+        det = _dot(e1, p)
+        if abs(det) < 1e-12:
+            return False
+        inv_det = 1.0 / det
+        s = _sub(origin, tri[0])
+        u = _dot(s, p) * inv_det
+        if u < 0.0 or u > 1.0:
+            return False
+        q = _cross(s, e1)
+        v = _dot(direction, q) * inv_det
+        if v < 0.0 or u + v > 1.0:
+            return False
+        t = _dot(e2, q) * inv_det
+        return t_min < t < t_max
+
+    def hit(self, origin, direction, t_min, t_max):
+        """Return True if the ray hits any triangle between t_min and t_max."""
+        if not self.nodes:
+            return False
+
+        big = 1e30
+        inv_dir = [1.0 / d if abs(d) > 1e-12 else big for d in direction]
+
+        stack = [0]
+        while stack:
+            index = stack.pop()
+            lo, hi, first, count = self.nodes[index]
+            if not self._ray_box(origin, inv_dir, lo, hi, t_max):
+                continue
+            if count == 0:
+                # The first child is right after this node
+                stack.append(first)
+                stack.append(index + 1)
+                continue
+            for tri in self.triangles[first:first + count]:
+                if self._ray_triangle(origin, direction, tri, t_min, t_max):
+                    return True
+        return False
+
+def bake_vertex_lighting(faces, positions, normals, lights, ambient,
+                         ao_samples, ao_distance, build_bvh):
+    """Calculate the light that reaches each vertex of a mesh.
+
+    faces: list of faces, each one a tuple of (vertex, texcoord, normal) keys.
+    positions: final position of each vertex (after translation and scale).
+    normals: normals of the OBJ file.
+    lights: list of (direction, color) tuples. The direction is the one in
+            which the light travels, like the one of NEA_LightSet().
+    ambient: (r, g, b) light that reaches all vertices.
+    ao_samples: number of ambient occlusion rays per vertex, 0 to disable it.
+    ao_distance: max distance of the ambient occlusion rays.
+    build_bvh: function that builds a BVH from a list of (min, max) boxes.
+
+    Returns a dictionary of vertex keys to (r, g, b) values. The values aren't
+    clamped, they have to be multiplied by the color of the surface.
+    """
+    smooth = None
+    lights = [(_normalize(d), c) for d, c in lights]
+
+    occluders = None
+    if ao_samples > 0:
+        triangles = []
+        for face in faces:
+            p = [positions[vk[0]] for vk in face]
+            for i in range(1, len(p) - 1):
+                triangles.append((p[0], p[i], p[i + 1]))
+        occluders = _Occluders(triangles, build_bvh)
+        hemisphere = _hemisphere_directions(ao_samples)
+
+    # Vertices with the same position and normal get the same occlusion
+    ao_cache = {}
+
+    result = {}
+    for face in faces:
+        for vk in face:
+            if vk in result:
+                continue
+
+            vi, _, ni = vk
+            if ni is not None:
+                n = _normalize(normals[ni])
+            else:
+                if smooth is None:
+                    smooth = _smooth_normals(faces, positions)
+                n = smooth.get(vi, [0.0, 1.0, 0.0])
+
+            ao = 1.0
+            if occluders is not None:
+                key = (vi, tuple(round(c, 4) for c in n))
+                ao = ao_cache.get(key)
+                if ao is None:
+                    # Tangent frame of the normal
+                    helper = [1.0, 0.0, 0.0] if abs(n[0]) < 0.9 \
+                             else [0.0, 1.0, 0.0]
+                    t = _normalize(_cross(helper, n))
+                    b = _cross(n, t)
+                    offset = ao_distance * AO_RAY_OFFSET
+                    p = positions[vi]
+                    origin = [p[i] + n[i] * offset for i in range(3)]
+                    hits = 0
+                    for lx, ly, lz in hemisphere:
+                        d = [t[i] * lx + b[i] * ly + n[i] * lz
+                             for i in range(3)]
+                        if occluders.hit(origin, d, offset, ao_distance):
+                            hits += 1
+                    ao = 1.0 - hits / ao_samples
+                    ao_cache[key] = ao
+
+            light = [ambient[i] * ao for i in range(3)]
+            for direction, color in lights:
+                diffuse = -_dot(direction, n)
+                if diffuse > 0:
+                    for i in range(3):
+                        light[i] += color[i] * diffuse
+
+            result[vk] = tuple(light)
+
+    return result
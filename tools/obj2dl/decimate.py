@@ -0,0 +1,214 @@
+# SPDX-License-Identifier: MIT
+#
+# Copyright (c) 2026 Warioware64
+
+"""Mesh simplification used to generate levels of detail.
+
+The mesh is reduced with edge collapses ordered by quadric error (Garland and
+Heckbert). Vertices are always collapsed into one of the two endpoints of the
+edge, so the texture coordinates and normals of the OBJ file can be reused
+without interpolating them.
+"""
+
+import heapq
+import math
+
+from collections import defaultdict
+
+# Weight of the planes that keep the open borders of the mesh in place
+BORDER_WEIGHT = 1000.0
+
+def _face_vertex_to_str(vk):
+    vi, ti, ni = vk
+    if ni is None:
+        if ti is None:
+            return f"{vi + 1}"
+        return f"{vi + 1}/{ti + 1}"
+    if ti is None:
+        return f"{vi + 1}//{ni + 1}"
+    return f"{vi + 1}/{ti + 1}/{ni + 1}"
+
+def _sub(a, b):
+    return [a[0] - b[0], a[1] - b[1], a[2] - b[2]]
+
+def _cross(a, b):
+    return [a[1] * b[2] - a[2] * b[1],
+            a[2] * b[0] - a[0] * b[2],
+            a[0] * b[1] - a[1] * b[0]]
+
+def _dot(a, b):
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]
+
+def _plane_quadric(n, p, weight):
+    """Quadric of the plane with normal n (normalized) that contains p."""
+    a, b, c = n
+    d = -_dot(n, p)
+    return [weight * v for v in (a * a, a * b, a * c, a * d,
+                                 b * b, b * c, b * d,
+                                 c * c, c * d,
+                                 d * d)]
+
+def _quadric_add(q, r):
+    for i in range(10):
+        q[i] += r[i]
+
+def _quadric_error(q, p):
+    x, y, z = p
+    return (q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+            + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+            + q[7] * z * z + 2 * q[8] * z
+            + q[9])
+
+def decimate(material_faces, vertices, use_vertex_color, ratio,
+             parse_face_vertex):
+    """Return a simplified copy of material_faces.
+
+    material_faces maps material names to lists of faces, each one a list of
+    OBJ face vertex strings. The result has the same format and only contains
+    triangles, about "ratio" times as many as the original mesh (quads count as
+    two triangles).
+    """
+    # Each face is [material, [vk0, vk1, vk2]]
+    faces = []
+    for mat_name, face_list in material_faces.items():
+        for face in face_list:
+            vkeys = [parse_face_vertex(v, use_vertex_color) for v in face]
+            if len(vkeys) == 3:
+                faces.append([mat_name, vkeys])
+            elif len(vkeys) == 4:
+                faces.append([mat_name, [vkeys[0], vkeys[1], vkeys[2]]])
+                faces.append([mat_name, [vkeys[0], vkeys[2], vkeys[3]]])
+
+    target = max(1, int(len(faces) * ratio))
+
+    pos = [list(v[0:3]) for v in vertices]
+
+    def face_normal(corners):
+        p0 = pos[corners[0][0]]
+        p1 = pos[corners[1][0]]
+        p2 = pos[corners[2][0]]
+        return _cross(_sub(p1, p0), _sub(p2, p0))
+
+    quadric = defaultdict(lambda: [0.0] * 10)
+    vertex_faces = defaultdict(set)
+    edge_faces = defaultdict(list)
+    alive = [True] * len(faces)
+
+    for fi, (_, corners) in enumerate(faces):
+        n = face_normal(corners)
+        length = math.sqrt(_dot(n, n))
+        if length == 0:
+            alive[fi] = False
+            continue
+        n = [c / length for c in n]
+
+        # Weight each plane by the area of the triangle
+        q = _plane_quadric(n, pos[corners[0][0]], length / 2)
+        for vk in corners:
+            _quadric_add(quadric[vk[0]], q)
+            vertex_faces[vk[0]].add(fi)
+
+        for i in range(3):
+            a = corners[i][0]
+            b = corners[(i + 1) % 3][0]
+            edge_faces[frozenset((a, b))].append((fi, a, b, n))
+
+    # Keep open borders from shrinking
+    for edge, users in edge_faces.items():
+        if len(users) != 1:
+            continue
+        _, a, b, n = users[0]
+        e = _sub(pos[b], pos[a])
+        border_n = _cross(e, n)
+        length = math.sqrt(_dot(border_n, border_n))
+        if length == 0:
+            continue
+        border_n = [c / length for c in border_n]
+        q = _plane_quadric(border_n, pos[a], BORDER_WEIGHT)
+        _quadric_add(quadric[a], q)
+        _quadric_add(quadric[b], q)
+
+    stamp = defaultdict(int)
+    heap = []
+
+    def push_edge(a, b):
+        q = list(quadric[a])
+        _quadric_add(q, quadric[b])
+        # Collapse into the endpoint with the lowest error
+        cost_a = _quadric_error(q, pos[a])
+        cost_b = _quadric_error(q, pos[b])
+        if cost_a < cost_b:
+            heapq.heappush(heap, (cost_a, b, a, stamp[b], stamp[a]))
+        else:
+            heapq.heappush(heap, (cost_b, a, b, stamp[a], stamp[b]))
+
+    for edge in edge_faces:
+        a, b = tuple(edge)
+        push_edge(a, b)
+
+    live = sum(alive)
+
+    while live > target and heap:
+        _, src, dst, stamp_src, stamp_dst = heapq.heappop(heap)
+
+        # Entries are pushed again when their vertices change
+        if src not in vertex_faces or dst not in vertex_faces:
+            continue
+        if stamp[src] != stamp_src or stamp[dst] != stamp_dst:
+            continue
+
+        # Reject the collapse if it flips any of the remaining triangles
+        flips = False
+        removed = []
+        kept = []
+        for fi in vertex_faces[src]:
+            corners = faces[fi][1]
+            if any(vk[0] == dst for vk in corners):
+                removed.append(fi)
+                continue
+            before = face_normal(corners)
+            after = face_normal([(dst, vk[1], vk[2]) if vk[0] == src else vk
+                                 for vk in corners])
+            if _dot(before, after) <= 0:
+                flips = True
+                break
+            kept.append(fi)
+
+        if flips:
+            continue
+
+        for fi in removed:
+            alive[fi] = False
+            live -= 1
+            for vk in faces[fi][1]:
+                vertex_faces[vk[0]].discard(fi)
+
+        for fi in kept:
+            faces[fi][1] = [(dst, vk[1], vk[2]) if vk[0] == src else vk
+                            for vk in faces[fi][1]]
+            vertex_faces[dst].add(fi)
+
+        del vertex_faces[src]
+        _quadric_add(quadric[dst], quadric[src])
+        stamp[dst] += 1
+
+        neighbours = set()
+        for fi in vertex_faces[dst]:
+            for vk in faces[fi][1]:
+                if vk[0] != dst:
+                    neighbours.add(vk[0])
+        for n in neighbours:
+            push_edge(n, dst)
+
+    result = defaultdict(list)
+    for fi, (mat_name, corners) in enumerate(faces):
+        if alive[fi]:
+            result[mat_name].append([_face_vertex_to_str(vk) for vk in corners])
+
+    # Keep the materials in the same order as the original mesh
+    ordered = {}
+    for mat_name in material_faces:
+        if mat_name in result:
+            ordered[mat_name] = result[mat_name]
+
+    return ordered, len(faces), live
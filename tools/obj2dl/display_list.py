@@ -2,6 +2,8 @@
 #
 # Copyright (c) 2022 Antonio Niño Díaz <antonio_nd@outlook.com>
 
+import nea_compress
+
 def float_to_v16(val):
     res = int(val * (1 << 12))
     if res < -0x8000:
@@ -15,6 +17,11 @@ def float_to_v16(val):
 def v16_to_float(val):
     return val / (1 << 12)
 
+def unsigned_to_signed(val, bits):
+    if val >= (1 << (bits - 1)):
+        val -= 1 << bits
+    return val
+
 def float_to_v10(val):
     res = int(val * (1 << 6))
     if res < -0x200:
@@ -120,16 +127,37 @@ def error(x1, x2, y1, y2, z1, z2):
 
 class DisplayList():
 
-    def __init__(self):
+    def __init__(self, optimize=True):
         self.commands = []
         self.parameters = []
         self.vtx_last = None
+        self.vtx_last_v16 = None # Coordinates of the last vertex in the GPU
         self.texcoord_last = None
         self.normal_last = None
+        self.color_last = None
         self.begin_vtx_last = None
 
+        # If False, all vertices use VTX_16 and all attributes are sent
+        self.optimize = optimize
+
+        # Size of the list without optimizations, to report the savings
+        self.naive_commands = 0
+        self.naive_parameters = 0
+
         self.display_list = []
 
+    def count_naive(self, parameters):
+        self.naive_commands += 1
+        self.naive_parameters += parameters
+
+    def get_naive_size(self):
+        """Return the size in words that the display list would have if all
+        vertices used VTX_16 and all attributes were sent for each vertex.
+
+        Must be called after finalize().
+        """
+        return 1 + (self.naive_commands + 3) // 4 + self.naive_parameters
+
     def add_command(self, command, *args):
         self.commands.append(command)
         if len(args) > 0:
@@ -176,22 +204,33 @@ class DisplayList():
         return bytes(data)
 
     def save_to_file(self, path):
-        with open(path, "wb") as f:
+        with nea_compress.open_output(path) as f:
             f.write(self.get_binary())
 
     def nop(self):
         self.add_command(command_name_to_id("NOP"))
 
     def mtx_restore(self, index):
+        self.count_naive(1)
         self.add_command(command_name_to_id("MTX_RESTORE"), index)
 
     def color(self, r, g, b):
+        self.count_naive(1)
+
         arg = int(r * 31) | (int(g * 31) << 5) | (int(b * 31) << 10)
+
+        # Skip if it's the same color
+        if self.optimize and self.color_last == arg:
+            return
+
         self.add_command(command_name_to_id("COLOR"), arg)
+        self.color_last = arg
 
     def normal(self, x, y, z):
+        self.count_naive(1)
+
         # Skip if it's the same normal
-        if self.normal_last is not None:
+        if self.optimize and self.normal_last is not None:
             if self.normal_last[0] == x and self.normal_last[1] == y and \
                self.normal_last[2] == z:
                 return
@@ -201,8 +240,10 @@ class DisplayList():
         self.normal_last = (x, y, z)
 
     def texcoord(self, u, v):
+        self.count_naive(1)
+
         # Skip if it's the same texcoord
-        if self.texcoord_last is not None:
+        if self.optimize and self.texcoord_last is not None:
             if self.texcoord_last[0] == u and self.texcoord_last[1] == v:
                 return
 
@@ -214,69 +255,120 @@ class DisplayList():
         args = [float_to_v16(x) | (float_to_v16(y) << 16), float_to_v16(z)]
         self.add_command(command_name_to_id("VTX_16"), *args)
         self.vtx_last = (x, y, z)
+        self.vtx_last_v16 = tuple(unsigned_to_signed(float_to_v16(i), 16)
+                                  for i in (x, y, z))
 
     def vtx_10(self, x, y, z):
         arg = float_to_v10(x) | (float_to_v10(y) << 10) | float_to_v10(z) << 20
         self.add_command(command_name_to_id("VTX_10"), arg)
         self.vtx_last = (x, y, z)
+        self.vtx_last_v16 = tuple(unsigned_to_signed(float_to_v10(i), 10) << 6
+                                  for i in (x, y, z))
 
     def vtx_xy(self, x, y):
         arg = float_to_v16(x) | (float_to_v16(y) << 16)
         self.add_command(command_name_to_id("VTX_XY"), arg)
         self.vtx_last = (x, y, self.vtx_last[2])
+        self.vtx_last_v16 = (unsigned_to_signed(float_to_v16(x), 16),
+                             unsigned_to_signed(float_to_v16(y), 16),
+                             self.vtx_last_v16[2])
 
     def vtx_xz(self, x, z):
         arg = float_to_v16(x) | (float_to_v16(z) << 16)
         self.add_command(command_name_to_id("VTX_XZ"), arg)
         self.vtx_last = (x, self.vtx_last[1], z)
+        self.vtx_last_v16 = (unsigned_to_signed(float_to_v16(x), 16),
+                             self.vtx_last_v16[1],
+                             unsigned_to_signed(float_to_v16(z), 16))
 
     def vtx_yz(self, y, z):
         arg = float_to_v16(y) | (float_to_v16(z) << 16)
         self.add_command(command_name_to_id("VTX_YZ"), arg)
         self.vtx_last = (self.vtx_last[0], y, z)
+        self.vtx_last_v16 = (self.vtx_last_v16[0],
+                             unsigned_to_signed(float_to_v16(y), 16),
+                             unsigned_to_signed(float_to_v16(z), 16))
 
     def vtx_diff(self, x, y, z):
-        arg = float_to_diff10(x - self.vtx_last[0]) | \
-             (float_to_diff10(y - self.vtx_last[1]) << 10) | \
-             (float_to_diff10(z - self.vtx_last[2]) << 20)
+        # The GPU adds the difference to the coordinates of the last vertex,
+        # which may not be exactly the ones that were requested.
+        target = [unsigned_to_signed(float_to_v16(i), 16) for i in (x, y, z)]
+        diff = [v16_to_float(target[i] - self.vtx_last_v16[i])
+                for i in range(3)]
+        arg = float_to_diff10(diff[0]) | \
+             (float_to_diff10(diff[1]) << 10) | \
+             (float_to_diff10(diff[2]) << 20)
         self.add_command(command_name_to_id("VTX_DIFF"), arg)
         self.vtx_last = (x, y, z)
+        self.vtx_last_v16 = tuple(self.vtx_last_v16[i] +
+                                  (unsigned_to_signed(
+                                      float_to_diff10(diff[i]), 10) << 3)
+                                  for i in range(3))
+
+    def diff_is_exact(self, x, y, z):
+        """Return True if VTX_DIFF can reach the position without any error.
+
+        The difference has 9 fractional bits, 3 less than VTX_16, and a range of
+        -1.0 to 0.998.
+        """
+        for i, val in enumerate((x, y, z)):
+            delta = unsigned_to_signed(float_to_v16(val), 16) - \
+                    self.vtx_last_v16[i]
+            if (delta & 7) != 0:
+                return False
+            if delta < -0x200 * 8 or delta > 0x1FF * 8:
+                return False
+        return True
 
     def vtx(self, x, y, z):
         """
         Picks the best vtx command based on the previous vertex and the error of
         the conversion.
         """
+        self.count_naive(2)
+
+        if not self.optimize:
+            self.vtx_16(x, y, z)
+            return
+
         # Allow {vtx_xy, vtx_yz, vtx_xz, vtx_diff} if there is a previous vertex
-        allow_diff = self.vtx_last is not None
+        allow_diff = self.vtx_last_v16 is not None
 
         # First, check if any of the coordinates is exactly the same as the
         # previous command. We can trivially use vtx_xy, vtx_xz, vtx_yz because
         # they have the min possible size and the max possible accuracy
         if allow_diff:
-            if float_to_v16(self.vtx_last[0]) == float_to_v16(x):
+            last = self.vtx_last_v16
+            if last[0] == unsigned_to_signed(float_to_v16(x), 16):
                 self.vtx_yz(y, z)
                 return
-            elif float_to_v16(self.vtx_last[1]) == float_to_v16(y):
+            elif last[1] == unsigned_to_signed(float_to_v16(y), 16):
                 self.vtx_xz(x, z)
                 return
-            elif float_to_v16(self.vtx_last[2]) == float_to_v16(z):
+            elif last[2] == unsigned_to_signed(float_to_v16(z), 16):
                 self.vtx_xy(x, y)
                 return
 
-        # If not, there are three options: vtx_16, vtx_10, vtx_diff. Pick the
-        # one with the lowest error.
+            # The position of the last vertex in the GPU is known exactly, so
+            # vtx_diff can be used as many times in a row as needed as long as
+            # it doesn't lose precision.
+            if self.diff_is_exact(x, y, z):
+                self.vtx_diff(x, y, z)
+                return
+
+        # If not, there are two options: vtx_16 and vtx_10. Pick the one with
+        # the lowest error.
 
-        # TODO: Maybe use vtx_diff, but this may cause accuracy issues if it is
-        # used several times in a row.
+        # The results of the conversions are unsigned, they need to be signed
+        # to compare them with the original values.
+        def v16(val):
+            return v16_to_float(unsigned_to_signed(float_to_v16(val), 16))
 
-        error_vtx_16 = error(v16_to_float(float_to_v16(x)), x,
-                             v16_to_float(float_to_v16(y)), y,
-                             v16_to_float(float_to_v16(z)), z)
+        def v10(val):
+            return v10_to_float(unsigned_to_signed(float_to_v10(val), 10))
 
-        error_vtx_10 = error(v10_to_float(float_to_v10(x)), x,
-                             v10_to_float(float_to_v10(y)), y,
-                             v10_to_float(float_to_v10(z)), z)
+        error_vtx_16 = error(v16(x), x, v16(y), y, v16(z), z)
+        error_vtx_10 = error(v10(x), x, v10(y), y, v10(z), z)
 
         if error_vtx_10 <= error_vtx_16:
             self.vtx_10(x, y, z)
@@ -286,10 +378,12 @@ class DisplayList():
         return
 
     def begin_vtxs(self, poly_type):
+        self.count_naive(1)
         self.add_command(command_name_to_id("BEGIN_VTXS"), poly_type_to_id(poly_type))
         self.begin_vtx_last = poly_type
 
     def end_vtxs(self):
+        self.count_naive(0)
         self.add_command(command_name_to_id("END_VTXS"))
         self.begin_vtx_last = None
 
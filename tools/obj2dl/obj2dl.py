@@ -6,12 +6,20 @@
 
 import os
 import struct
+import sys
+
+# nea_compress is shared by all tools
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                '..', 'common'))
 
 from display_list import DisplayList
+from decimate import decimate
+from bake_lighting import bake_vertex_lighting
 from mtl_parser import parse_mtl, float_to_rgb15, pack_diffuse_ambient, pack_specular_emission
 from collections import defaultdict
 
 import math
+import nea_compress
 
 class OBJFormatError(Exception):
     pass
@@ -281,8 +289,13 @@ def stripify_quads(resolved_quads):
 # ---------------------------------------------------------------------------
 
 def emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
-                model_scale, model_translation, use_vertex_color):
-    """Emit all display-list commands for one vertex key."""
+                model_scale, model_translation, use_vertex_color,
+                baked_colors=None):
+    """Emit all display-list commands for one vertex key.
+
+    If baked_colors isn't None, the vertex gets its baked color instead of its
+    normal and its OBJ color.
+    """
     vertex_idx, texcoord_idx, normal_idx = vk
 
     if texcoord_idx is not None:
@@ -293,7 +306,9 @@ def emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
         v *= texture_size[1]
         dl.texcoord(u, v)
 
-    if normal_idx is not None:
+    if baked_colors is not None:
+        dl.color(*baked_colors[vk])
+    elif normal_idx is not None:
         n = normals[normal_idx]
         dl.normal(n[0], n[1], n[2])
 
@@ -304,7 +319,7 @@ def emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
         val *= model_scale
         vtx.append(val)
 
-    if use_vertex_color:
+    if use_vertex_color and baked_colors is None:
         rgb = [vertices[vertex_idx][i] for i in range(3, 6)]
         dl.color(*rgb)
 
@@ -316,7 +331,7 @@ def emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
 
 def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
                           normals, texture_size, model_scale, model_translation,
-                          use_vertex_color, no_strip):
+                          use_vertex_color, no_strip, baked_colors=None):
     """Generate a display list for a group of faces.
 
     Returns a finalized DisplayList instance.
@@ -350,7 +365,8 @@ def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
         dl.begin_vtxs("triangle_strip")
         for vk in strip_verts:
             emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
-                        model_scale, model_translation, use_vertex_color)
+                        model_scale, model_translation, use_vertex_color,
+                        baked_colors)
         dl.end_vtxs()
 
     # Emit separate triangles
@@ -359,7 +375,8 @@ def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
         for fi in tri_singles:
             for vk in resolved_tris[fi]:
                 emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
-                            model_scale, model_translation, use_vertex_color)
+                            model_scale, model_translation, use_vertex_color,
+                            baked_colors)
         dl.end_vtxs()
 
     # Emit quad strips
@@ -367,7 +384,8 @@ def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
         dl.begin_vtxs("quad_strip")
         for vk in strip_verts:
             emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
-                        model_scale, model_translation, use_vertex_color)
+                        model_scale, model_translation, use_vertex_color,
+                        baked_colors)
         dl.end_vtxs()
 
     # Emit separate quads
@@ -376,10 +394,17 @@ def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
         for fi in quad_singles:
             for vk in resolved_quads[fi]:
                 emit_vertex(dl, vk, vertices, texcoords, normals, texture_size,
-                            model_scale, model_translation, use_vertex_color)
+                            model_scale, model_translation, use_vertex_color,
+                            baked_colors)
         dl.end_vtxs()
 
     dl.finalize()
+
+    naive_size = dl.get_naive_size()
+    size = len(dl.get_data())
+    print(f"  Display list:    {naive_size} -> {size} words "
+          f"(saved {naive_size - size})")
+
     return dl
 
 # ---------------------------------------------------------------------------
@@ -387,10 +412,64 @@ def generate_display_list(resolved_tris, resolved_quads, vertices, texcoords,
 # ---------------------------------------------------------------------------
 
 DLMM_MAGIC = 0x4D4D4C44  # "DLMM" in little-endian
-DLMM_VERSION = 1
+DLMM_VERSION = 2
+DLMM_HEADER_SIZE = 32  # the end is reserved for the engine
 DLMM_SUBMESH_HEADER_SIZE = 56  # bytes per submesh header
 
-def save_dlmm(output_file, submeshes):
+# ---------------------------------------------------------------------------
+# Bounding sphere chunk
+# ---------------------------------------------------------------------------
+
+BOUNDS_MAGIC = 0x48505342   # "BSPH" little-endian
+
+def compute_bounds_chunk(vertices, material_faces, model_scale,
+                         model_translation, use_vertex_color):
+    """Return the bounding sphere chunk of all vertices used by faces.
+
+    The center is the center of the AABB of the model, and the radius is the
+    distance to the furthest vertex. The chunk is placed at the start of the
+    output file, and Nitro Engine Advanced skips it when loading the mesh.
+    """
+    used = set()
+    for face_list in material_faces.values():
+        for face in face_list:
+            for v in face:
+                used.add(parse_face_vertex(v, use_vertex_color)[0])
+
+    positions = []
+    for vi in used:
+        pos = []
+        for i in range(3):
+            val = vertices[vi][i]
+            val += model_translation[i]
+            val *= model_scale
+            pos.append(val)
+        positions.append(pos)
+
+    if len(positions) == 0:
+        return b''
+
+    center = []
+    for i in range(3):
+        lo = min(p[i] for p in positions)
+        hi = max(p[i] for p in positions)
+        center.append((lo + hi) / 2)
+
+    radius = 0.0
+    for p in positions:
+        d = math.sqrt(sum((p[i] - center[i]) ** 2 for i in range(3)))
+        radius = max(radius, d)
+
+    # Round the radius up so that the sphere is conservative in f32
+    radius += 1 / (1 << 12)
+
+    print(f"Bounding sphere: center {center}, radius {radius}")
+
+    return struct.pack('<IIIII', BOUNDS_MAGIC,
+                       float_to_f32(center[0]), float_to_f32(center[1]),
+                       float_to_f32(center[2]), float_to_f32(radius))
+
+def save_dlmm(output_file, submeshes, bounds=b''):
     """Write multi-material model to .dlmm binary format.
 
     Args:
@@ -403,9 +482,10 @@ def save_dlmm(output_file, submeshes):
             'color': u16 RGB15
             'alpha': u16 (0-31)
             'has_texture': bool
+        bounds: optional bounding sphere chunk written before the header
     """
     num = len(submeshes)
-    header_size = 12 + DLMM_SUBMESH_HEADER_SIZE * num
+    header_size = DLMM_HEADER_SIZE + DLMM_SUBMESH_HEADER_SIZE * num
 
     # Get binary data for each display list
     dl_binaries = []
@@ -419,9 +499,13 @@ def save_dlmm(output_file, submeshes):
         dl_offsets.append(offset)
         offset += len(dl_bin)
 
-    with open(output_file, 'wb') as f:
+    with nea_compress.open_output(output_file) as f:
+        # Offsets are relative to the DLMM header, not to the bounds chunk
+        f.write(bounds)
+
         # File header
         f.write(struct.pack('<III', DLMM_MAGIC, DLMM_VERSION, num))
+        f.write(b'\x00' * (DLMM_HEADER_SIZE - 12))
 
         # Submesh headers
         for i, sub in enumerate(submeshes):
@@ -435,7 +519,7 @@ def save_dlmm(output_file, submeshes):
 
             f.write(struct.pack('<IIIII',
                 dl_offsets[i],
-                len(dl_binaries[i]),
+                0,  # Material pointer, set by the engine
                 sub['diffuse_ambient'],
                 sub['specular_emission'],
                 sub['color']))
@@ -451,7 +535,13 @@ def save_dlmm(output_file, submeshes):
 # ---------------------------------------------------------------------------
 
 COLM_MAGIC = 0x4D4C4F43   # "COLM" little-endian
-COLM_VERSION = 1
+COLM_VERSION = 2
+COLM_FLAG_BVH = 1 << 0     # The triangles are followed by a BVH
+
+# Max number of triangles in each leaf of the BVH
+COLM_BVH_LEAF_SIZE = 4
+# Max depth of the BVH, see NEA_COLMESH_BVH_MAX_DEPTH
+COLM_BVH_MAX_DEPTH = 32
 
 def float_to_f32(val):
     """Convert a float to NDS f32 (20.12 fixed-point) as unsigned-wrapped int32."""
@@ -464,6 +554,98 @@ def float_to_f32(val):
         res = 0x100000000 + res
     return res
 
+def build_colmesh_bvh(boxes):
+    """Build an AABB tree over the boxes of the triangles.
+
+    Boxes are (min, max) tuples of f32 integers. It returns the order in which
+    the triangles must be written and the list of nodes in depth-first order,
+    as (min, max, first, count) tuples. Leaves have the index of their first
+    triangle, other nodes have the index of their second child and a count of
+    0. The first child of a node is the one after it.
+    """
+    order = list(range(len(boxes)))
+    nodes = []
+
+    def bounds(start, end):
+        lo = [min(boxes[t][0][i] for t in order[start:end]) for i in range(3)]
+        hi = [max(boxes[t][1][i] for t in order[start:end]) for i in range(3)]
+        return lo, hi
+
+    def build(start, end, depth):
+        lo, hi = bounds(start, end)
+        index = len(nodes)
+        nodes.append(None)
+
+        count = end - start
+        if count <= COLM_BVH_LEAF_SIZE or depth == COLM_BVH_MAX_DEPTH:
+            if count > 0xFFFF:
+                raise Exception("Too many triangles in a BVH leaf")
+            nodes[index] = (lo, hi, start, count)
+            return
+
+        # Split at the median along the longest axis of the centers
+        centers = [[boxes[t][0][i] + boxes[t][1][i] for i in range(3)]
+                   for t in order[start:end]]
+        extent = [max(c[i] for c in centers) - min(c[i] for c in centers)
+                  for i in range(3)]
+        axis = extent.index(max(extent))
+
+        order[start:end] = sorted(order[start:end],
+                                  key=lambda t: boxes[t][0][axis] +
+                                                boxes[t][1][axis])
+        mid = (start + end) // 2
+
+        build(start, mid, depth + 1)
+        second = len(nodes)
+        build(mid, end, depth + 1)
+        nodes[index] = (lo, hi, second, 0)
+
+    build(0, len(boxes), 1)
+    return order, nodes
+
+def colmesh_triangle_data(v, n):
+    """Calculate the data of a triangle derived from its vertices, the same way
+    as NEA_ColMeshLoad() does with old files.
+
+    The vertices and the normal are lists of f32 integers. It returns the plane
+    distance, the center and radius of the bounding sphere and the inward
+    normals of the edges.
+    """
+    def div3(val):
+        # Integer division of C, rounded towards zero
+        return abs(val) // 3 if val >= 0 else -(abs(val) // 3)
+
+    plane_d = sum(n[i] * v[0][i] for i in range(3)) >> 12
+    center = [div3(v[0][i] + v[1][i] + v[2][i]) for i in range(3)]
+    radius = max(math.isqrt(sum((p[i] - center[i]) ** 2 for i in range(3)))
+                 for p in v) + 1
+
+    e0 = [v[1][i] - v[0][i] for i in range(3)]
+    e1 = [v[2][i] - v[0][i] for i in range(3)]
+    cross = [e0[1] * e1[2] - e0[2] * e1[1],
+             e0[2] * e1[0] - e0[0] * e1[2],
+             e0[0] * e1[1] - e0[1] * e1[0]]
+    if cross == [0, 0, 0]:
+        # Degenerate triangles are never hit
+        return plane_d, center, -1, [0] * 9
+
+    edge_normals = []
+    for i in range(3):
+        start, end, opposite = v[i], v[(i + 1) % 3], v[(i + 2) % 3]
+        e = [end[j] - start[j] for j in range(3)]
+        en = [n[1] * e[2] - n[2] * e[1],
+              n[2] * e[0] - n[0] * e[2],
+              n[0] * e[1] - n[1] * e[0]]
+        length = math.sqrt(sum(c * c for c in en))
+        if length == 0:
+            return plane_d, center, -1, [0] * 9
+        en = [round(c * 4096 / length) for c in en]
+        if sum(en[j] * (opposite[j] - start[j]) for j in range(3)) < 0:
+            en = [-c for c in en]
+        edge_normals += en
+
+    return plane_d, center, radius, edge_normals
+
 def generate_colmesh(output_file, vertices, material_faces,
                      model_scale, model_translation, use_vertex_color):
     """Generate a .colmesh binary file from parsed OBJ geometry.
@@ -526,13 +708,29 @@ def generate_colmesh(output_file, vertices, material_faces,
 
         triangles.append((verts_f32, (nx, ny, nz)))
 
+    # The BVH uses the same values as the vertices of the file
+    def f32_signed(val):
+        res = float_to_f32(val)
+        return res - 0x100000000 if res & 0x80000000 else res
+
+    boxes = []
+    for verts_f32, normal in triangles:
+        v = [[f32_signed(p[i]) for i in range(3)] for p in verts_f32]
+        boxes.append(([min(p[i] for p in v) for i in range(3)],
+                      [max(p[i] for p in v) for i in range(3)]))
+
+    order, nodes = build_colmesh_bvh(boxes)
+    if len(nodes) > 0xFFFF:
+        raise Exception("Too many BVH nodes in collision mesh")
+    triangles = [triangles[t] for t in order]
+
     # Write .colmesh binary
     colmesh_path = os.path.splitext(output_file)[0] + '.colmesh'
 
-    with open(colmesh_path, 'wb') as f:
+    with nea_compress.open_output(colmesh_path) as f:
         # Header
         f.write(struct.pack('<IIII',
-            COLM_MAGIC, COLM_VERSION, len(triangles), 0))
+            COLM_MAGIC, COLM_VERSION, len(triangles), COLM_FLAG_BVH))
 
         # Bounding AABB (min, max)
         for i in range(3):
@@ -542,13 +740,72 @@ def generate_colmesh(output_file, vertices, material_faces,
 
         # Triangles
         for verts_f32, normal in triangles:
-            for v in verts_f32:
-                for i in range(3):
-                    f.write(struct.pack('<I', float_to_f32(v[i])))
-            for i in range(3):
-                f.write(struct.pack('<I', float_to_f32(normal[i])))
+            v = [[f32_signed(p[i]) for i in range(3)] for p in verts_f32]
+            n = [f32_signed(normal[i]) for i in range(3)]
+            plane_d, center, radius, edge_normals = \
+                colmesh_triangle_data(v, n)
+
+            for p in v:
+                f.write(struct.pack('<iii', *p))
+            f.write(struct.pack('<iii', *n))
+            f.write(struct.pack('<i', plane_d))
+            f.write(struct.pack('<iii', *center))
+            f.write(struct.pack('<i', radius))
+            f.write(struct.pack('<9hh', *edge_normals, 0))
+
+        # BVH
+        f.write(struct.pack('<I', len(nodes)))
+        for lo, hi, first, count in nodes:
+            f.write(struct.pack('<iiiiiiHH', *lo, *hi, first, count))
+
+    print(f"Collision mesh: {len(triangles)} triangles, {len(nodes)} BVH nodes "
+          f"-> {colmesh_path}")
+
+# ---------------------------------------------------------------------------
+# Static lighting
+# ---------------------------------------------------------------------------
+
+def bake_mesh_lighting(vertices, normals, material_faces, model_scale,
+                       model_translation, bake):
+    """Calculate the light that reaches each vertex key of the mesh.
+
+    All materials are baked together, so that they occlude each other.
+    """
+    positions = []
+    for v in vertices:
+        positions.append([(v[i] + model_translation[i]) * model_scale
+                          for i in range(3)])
 
-    print(f"Collision mesh: {len(triangles)} triangles -> {colmesh_path}")
+    faces = []
+    for face_list in material_faces.values():
+        for face in face_list:
+            if len(face) in (3, 4):
+                faces.append(tuple(parse_face_vertex(v, False) for v in face))
+
+    print(f"Baking lighting: {len(bake['lights'])} lights, "
+          f"{bake['ao_samples']} occlusion rays per vertex")
+
+    return bake_vertex_lighting(faces, positions, normals, bake['lights'],
+                                bake['ambient'], bake['ao_samples'],
+                                bake['ao_distance'], build_colmesh_bvh)
+
+def baked_vertex_colors(baked_light, faces, vertices, surface_color,
+                        use_vertex_color):
+    """Multiply the baked light of the vertices of some faces by the color of
+    their surface, and clamp the result to what the hardware can show."""
+    colors = {}
+    for face in faces:
+        for vk in face:
+            if vk in colors:
+                continue
+            albedo = list(surface_color)
+            if use_vertex_color:
+                for i in range(3):
+                    albedo[i] *= vertices[vk[0]][3 + i]
+            light = baked_light[vk]
+            colors[vk] = tuple(min(1.0, max(0.0, light[i] * albedo[i]))
+                               for i in range(3))
+    return colors
 
 # ---------------------------------------------------------------------------
 # OBJ parsing
@@ -619,9 +876,15 @@ def parse_obj(input_file, use_vertex_color):
 # Main conversion
 # ---------------------------------------------------------------------------
 
+def lod_output_path(output_file, level):
+    """Return the path of the file of an LOD level ("model_lod1.bin", etc)."""
+    base, ext = os.path.splitext(output_file)
+    return f"{base}_lod{level}{ext}"
+
 def convert_obj(input_file, output_file, texture_size,
                 model_scale, model_translation, use_vertex_color,
-                no_strip=False, multi_material=False, collision=False):
+                no_strip=False, multi_material=False, collision=False,
+                bounding_sphere=False, lod_ratios=[], bake=None):
 
     vertices, texcoords, normals, material_faces, mtl_file = \
         parse_obj(input_file, use_vertex_color)
@@ -646,6 +909,56 @@ def convert_obj(input_file, output_file, texture_size,
         print(f"Warning: MTL file not found: {mtl_file}")
         print("")
 
+    save_mesh(input_file, output_file, texture_size, model_scale,
+              model_translation, use_vertex_color, no_strip, multi_material,
+              bounding_sphere, vertices, texcoords, normals, material_faces,
+              mtl_file, materials, bake)
+
+    # Generate collision mesh if requested
+    if collision:
+        generate_colmesh(output_file, vertices, material_faces,
+                         model_scale, model_translation, use_vertex_color)
+
+    # Generate simplified versions of the mesh, one file per level
+    for level, ratio in enumerate(lod_ratios, start=1):
+        lod_file = lod_output_path(output_file, level)
+        lod_faces, tris_before, tris_after = decimate(
+                material_faces, vertices, use_vertex_color, ratio,
+                parse_face_vertex)
+
+        print("")
+        print(f"LOD {level}: ratio {ratio}, {tris_before} -> {tris_after} "
+              f"triangles")
+        print("")
+
+        save_mesh(input_file, lod_file, texture_size, model_scale,
+                  model_translation, use_vertex_color, no_strip,
+                  multi_material, bounding_sphere, vertices, texcoords,
+                  normals, lod_faces, mtl_file, materials, bake)
+
+def save_mesh(input_file, output_file, texture_size, model_scale,
+              model_translation, use_vertex_color, no_strip, multi_material,
+              bounding_sphere, vertices, texcoords, normals, material_faces,
+              mtl_file, materials, bake=None):
+    """Convert the faces of a parsed OBJ file and write them to output_file.
+
+    If bake isn't None, the lighting is baked into vertex colors and the
+    display lists don't have normals.
+    """
+
+    bounds = b''
+    if bounding_sphere:
+        bounds = compute_bounds_chunk(vertices, material_faces, model_scale,
+                                      model_translation, use_vertex_color)
+
+    baked_light = None
+    if bake is not None:
+        baked_light = bake_mesh_lighting(vertices, normals, material_faces,
+                                         model_scale, model_translation, bake)
+
+    # Baking needs the normals even if the OBJ file has vertex colors
+    keep_normals = not use_vertex_color or bake is not None
+
     # Determine if we should use multi-material mode
     use_multi = multi_material and len(material_faces) > 1
 
@@ -668,18 +981,27 @@ def convert_obj(input_file, output_file, texture_size,
                     f"Unsupported polygons with {n} faces. "
                     "Please, split the polygons in your model to triangles."
                 )
-            vkeys = tuple(parse_face_vertex(v, use_vertex_color) for v in face)
+            vkeys = tuple(parse_face_vertex(v, not keep_normals) for v in face)
             if n == 3:
                 resolved_tris.append(vkeys)
             else:
                 resolved_quads.append(vkeys)
 
+        baked_colors = None
+        if baked_light is not None:
+            baked_colors = baked_vertex_colors(baked_light,
+                                               resolved_tris + resolved_quads,
+                                               vertices, (1.0, 1.0, 1.0),
+                                               use_vertex_color)
+
         print("Single-material mode:")
         dl = generate_display_list(resolved_tris, resolved_quads, vertices,
                                     texcoords, normals, texture_size,
                                     model_scale, model_translation,
-                                    use_vertex_color, no_strip)
-        dl.save_to_file(output_file)
+                                    use_vertex_color, no_strip, baked_colors)
+        with nea_compress.open_output(output_file) as f:
+            f.write(bounds)
+            f.write(dl.get_binary())
     else:
         # ---- Multi-material path ----
         # Resolve base directory for texture image lookups
@@ -701,7 +1023,8 @@ def convert_obj(input_file, output_file, texture_size,
                         f"Unsupported polygons with {n} faces in material '{mat_name}'. "
                         "Please, split the polygons in your model to triangles."
                     )
-                vkeys = tuple(parse_face_vertex(v, use_vertex_color) for v in face)
+                vkeys = tuple(parse_face_vertex(v, not keep_normals)
+                              for v in face)
                 if n == 3:
                     resolved_tris.append(vkeys)
                 else:
@@ -724,12 +1047,21 @@ def convert_obj(input_file, output_file, texture_size,
                 else:
                     print(f"  Warning: texture not found: {tex_path}")
 
+            kd = mat_props.get('Kd', (1.0, 1.0, 1.0))
+
+            baked_colors = None
+            if baked_light is not None:
+                baked_colors = baked_vertex_colors(baked_light,
+                                                   resolved_tris + resolved_quads,
+                                                   vertices, kd,
+                                                   use_vertex_color)
+
             dl = generate_display_list(resolved_tris, resolved_quads, vertices,
                                         texcoords, normals, mat_tex_size,
                                         model_scale, model_translation,
-                                        use_vertex_color, no_strip)
+                                        use_vertex_color, no_strip,
+                                        baked_colors)
 
-            kd = mat_props.get('Kd', (1.0, 1.0, 1.0))
             ka = mat_props.get('Ka', (0.0, 0.0, 0.0))
             ks = mat_props.get('Ks', (0.0, 0.0, 0.0))
             ke = mat_props.get('Ke', (0.0, 0.0, 0.0))
@@ -750,12 +1082,7 @@ def convert_obj(input_file, output_file, texture_size,
         print(f"Total faces: {total_faces}")
         print(f"Submeshes:   {len(submeshes)}")
         print(f"Output:      {output_file} (DLMM format)")
-        save_dlmm(output_file, submeshes)
-
-    # Generate collision mesh if requested
-    if collision:
-        generate_colmesh(output_file, vertices, material_faces,
-                         model_scale, model_translation, use_vertex_color)
+        save_dlmm(output_file, submeshes, bounds)
 
 if __name__ == "__main__":
 
@@ -798,9 +1125,40 @@ if __name__ == "__main__":
     parser.add_argument("--collision", required=False,
                         action='store_true',
                         help="generate .colmesh collision mesh alongside display list")
+    parser.add_argument("--bounding-sphere", required=False,
+                        action='store_true',
+                        help="prepend a bounding sphere chunk used for frustum culling")
+    parser.add_argument("--lod", default=[], type=float,
+                        nargs="+", action="extend",
+                        help="also generate simplified meshes with these ratios "
+                             "of triangles (e.g. '--lod 0.5 0.25' generates "
+                             "model_lod1.bin and model_lod2.bin)")
+    parser.add_argument("--compress", required=False, action='store_true',
+                        help="compress the output files with LZ77")
+    parser.add_argument("--bake-lighting", required=False,
+                        action='store_true',
+                        help="bake static lighting into vertex colors and "
+                             "don't emit normals")
+    parser.add_argument("--bake-light", default=[], type=float, nargs=6,
+                        action="append",
+                        metavar=("DX", "DY", "DZ", "R", "G", "B"),
+                        help="directional light used by --bake-lighting: the "
+                             "direction in which the light travels and its "
+                             "color (0.0 - 1.0). It can be repeated")
+    parser.add_argument("--bake-ambient", default=[0.25, 0.25, 0.25],
+                        type=float, nargs=3, metavar=("R", "G", "B"),
+                        help="ambient light used by --bake-lighting")
+    parser.add_argument("--bake-ao", default=0, type=int,
+                        help="number of ambient occlusion rays per vertex "
+                             "used by --bake-lighting (0 disables it)")
+    parser.add_argument("--bake-ao-distance", default=1.0, type=float,
+                        help="max distance of the ambient occlusion rays, "
+                             "after scaling the model")
 
     args = parser.parse_args()
 
+    nea_compress.enabled = args.compress
+
     # Texture size: required for single-material, optional for multi-material
     texture_size = [0, 0]
     if args.texture is not None:
@@ -822,10 +1180,33 @@ if __name__ == "__main__":
         print("Please, provide exactly 3 values to the --translation argument")
         sys.exit(1)
 
+    if len(args.lod) > 3:
+        print("Please, provide at most 3 values to the --lod argument")
+        sys.exit(1)
+    for ratio in args.lod:
+        if ratio <= 0 or ratio >= 1:
+            print("Values of the --lod argument must be between 0 and 1")
+            sys.exit(1)
+
+    bake = None
+    if args.bake_lighting:
+        if args.bake_ao < 0 or args.bake_ao_distance <= 0:
+            print("Invalid ambient occlusion settings")
+            sys.exit(1)
+        if len(args.bake_light) == 0 and args.bake_ao == 0:
+            print("Warning: Baking lighting with the ambient light only")
+        bake = {
+            'lights': [(l[0:3], l[3:6]) for l in args.bake_light],
+            'ambient': args.bake_ambient,
+            'ao_samples': args.bake_ao,
+            'ao_distance': args.bake_ao_distance,
+        }
+
     try:
         convert_obj(args.input, args.output, texture_size,
                     args.scale, args.translation, args.use_vertex_color,
-                    args.no_strip, args.multi_material, args.collision)
+                    args.no_strip, args.multi_material, args.collision,
+                    args.bounding_sphere, args.lod, bake)
     except BaseException as e:
         print("ERROR: " + str(e))
         traceback.print_exc()